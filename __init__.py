@@ -2,9 +2,64 @@
 # This source code is licensed under the GPL-3.0 license found in the
 # LICENSE file in the root directory of this source tree.
 
-from .bindings import BaseRenderer, LightType, ShapeType
-from .plugin import RenderingPlugin
+import importlib
 
-__all__ = ('BaseRenderer', 'RenderingPlugin', 'ShapeType', 'LightType')
+# names exported by each module, imported at their first access so that importing the package
+# neither registers the bindings nor imports the plugin wrapper, see __getattr__
+_EXPORTS = {
+    'bindings': ('AABB', 'BVH', 'AssetPrefetch', 'AssetTable', 'AutoRenderer', 'BaseRenderer',
+                 'BatchRenderer',
+                 'ColorFormat', 'DepthFormat', 'DevicePolicy', 'EventCamera', 'FrameRecorder',
+                 'FrameRing',
+                 'LensDistortion', 'LensModel', 'Light', 'LightType', 'LodPolicy', 'MaskFormat',
+                 'OutputChannel', 'PathTracer', 'PointFrame', 'Projection', 'Quality',
+                 'Randomization', 'RaySensor', 'RemoteRenderer', 'RenderScheduler', 'RenderServer',
+                 'SceneLayer', 'SceneState',
+                 'SceneStateDecoder', 'SceneStateEncoder', 'SceneStateSnapshot', 'SceneTables',
+                 'SegmentationMode', 'SensorNoise', 'ShapeMatrices',
+                 'ShapeType', 'TextureFilter', 'ThreadAffinity',
+                 'VertexBufferMode', 'acquire_device', 'capture_trace_outliers',
+                 'compress_texture_file',
+                 'count_mask_pixels', 'device_loads',
+                 'get_process_memory_report', 'get_thread_topology', 'load_bitmap',
+                 'preload_assets', 'render_camera',
+                 'set_device_count', 'set_device_numa_node', 'set_device_policy',
+                 'set_mesh_cache_directory', 'set_shader_cache_directory',
+                 'set_texture_cache_directory', 'set_texture_prefetch', 'set_thread_affinity',
+                 'set_vertex_buffer_mode', 'start_trace',
+                 'stop_trace', 'trace_captured_frames', 'trace_dropped_events', 'write_trace'),
+    'host': ('RendererHost',),
+    'plugin': ('BulkCameraTransfer', 'RenderingPlugin', 'get_encoded_camera_image',
+               'render_batch'),
+    'replay': ('TrajectoryRecorder', 'load_trajectory', 'replay'),
+}
+# built only with --with-egl, --with-tinyrenderer and --with-vulkan
+_OPTIONAL = ('EGLRenderer', 'TinyRendererBackend', 'VulkanRenderer')
+_MODULES = {name: module for module, names in _EXPORTS.items() for name in names}
+_MODULES.update((name, 'bindings') for name in _OPTIONAL)
 
 __version__ = '0.6.5'
+
+
+def __getattr__(name):
+    if name == '__all__':
+        bindings = importlib.import_module('.bindings', __name__)
+        value = tuple(name for names in _EXPORTS.values() for name in names) + tuple(
+            name for name in _OPTIONAL if hasattr(bindings, name))
+        globals()['__all__'] = value
+        return value
+    module = _MODULES.get(name)
+    if module is None:
+        raise AttributeError(f'module {__name__!r} has no attribute {name!r}')
+    module = importlib.import_module('.' + module, __name__)
+    # all the names of the module at once, e.g. the replay function over the replay module
+    for other, source in _MODULES.items():
+        if source == module.__name__.rpartition('.')[2] and hasattr(module, other):
+            globals()[other] = getattr(module, other)
+    if name not in globals():
+        raise AttributeError(f'module {__name__!r} has no attribute {name!r}')
+    return globals()[name]
+
+
+def __dir__():
+    return sorted(set(globals()) | set(_MODULES))
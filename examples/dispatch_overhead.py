@@ -0,0 +1,65 @@
+"""Per-call overhead of dispatching camera image requests to a renderer."""
+
+import argparse
+from timeit import default_timer as timer
+
+import pybullet as pb
+from pybullet_utils.bullet_client import BulletClient
+
+import pybullet_rendering as pr
+from pybullet_rendering import BaseRenderer, RenderingPlugin
+
+parser = argparse.ArgumentParser(formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+parser.add_argument('-n', '--num_calls', type=int, default=100000,
+                    help='Number of 1x1 camera image requests per test')
+
+
+class NullRenderer(BaseRenderer):
+    """Python renderer doing nothing, to time the dispatch alone."""
+
+    def __init__(self):
+        super().__init__()
+
+    def update_scene(self, scene_graph, materials_only):
+        pass
+
+    def render_frame(self, scene_state, scene_view, frame):
+        return True
+
+
+def time_calls(num_calls, renderer=None, cache_overrides=True):
+    """Compute the average duration in microseconds of a 1x1 camera image request.
+
+    Without a renderer, requests are served by the builtin pybullet renderer.
+    """
+    client = BulletClient(pb.DIRECT)
+    if renderer is not None:
+        RenderingPlugin(client).set_renderer(renderer, cache_overrides)
+    client.getCameraImage(1, 1)
+    start = timer()
+    for _ in range(num_calls):
+        client.getCameraImage(1, 1)
+    end = timer()
+    return (end - start) / num_calls * 1e6
+
+
+def main(args):
+    results = {
+        'pybullet builtin': time_calls(args.num_calls),
+        'python, lookup by name': time_calls(args.num_calls, NullRenderer(), False),
+        'python, cached overrides': time_calls(args.num_calls, NullRenderer()),
+    }
+
+    # native renderers release the GIL around each call
+    for name in ('EGLRenderer', 'TinyRendererBackend'):
+        if hasattr(pr, name):
+            results[f'native {name}'] = time_calls(args.num_calls, getattr(pr, name)())
+
+    print('Results:')
+    for name, duration in results.items():
+        print(f'{name}: {duration:.2f} us per call')
+
+
+if __name__ == '__main__':
+    args = parser.parse_args()
+    main(args)
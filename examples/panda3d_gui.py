@@ -1,6 +1,10 @@
 """Simple Panda3d-based GUI app."""
 
 import argparse
+import collections
+import copy
+import threading
+import time
 
 import numpy as np
 import pybullet as pb
@@ -55,8 +59,10 @@ class MyApp(BaseRenderer, ShowBase):
         # bind external renderer to pybullet client
         RenderingPlugin(client, self)
 
-        # setup scene
+        # setup scene, changed by the simulation thread through a queue and snapshots
         self.nodes = {}
+        self.updates = collections.deque()
+        self.snapshot = None
         self.camLens.setNearFar(3, 7)
         self.camLens.setFilmSize(Vec2(0.030, 0.030))
         self.render.setAntialias(AntialiasAttrib.MAuto)
@@ -71,9 +77,12 @@ class MyApp(BaseRenderer, ShowBase):
             filters.setAmbientOcclusion()
 
         # setup periodic tasks
-        self.time = 0
         self.taskMgr.add(self.spinCameraTask, "SpinCameraTask")
-        self.taskMgr.add(self.stepSimulationTask, "StepSimulationTask")
+        self.taskMgr.add(self.applySnapshotTask, "ApplySnapshotTask")
+
+        # the simulation runs at its own rate, never waiting for the display
+        self.simulation = threading.Thread(target=self.simulate, daemon=True)
+        self.simulation.start()
 
         if args.debug:
             self.oobe()
@@ -145,23 +154,52 @@ class MyApp(BaseRenderer, ShowBase):
         self.camera.setHpr(deg, -15, 0)
         return Task.cont
 
-    def stepSimulationTask(self, task):
-        """Update light position
+    def simulate(self):
+        """Step the simulation at 240 Hz on its own thread
         """
-        if task.time - self.time > 1 / 240.:
+        period = 1 / 240.
+        deadline = time.perf_counter()
+        while True:
             self.client.stepSimulation()
             # this call trigger updateScene (if necessary) and draw methods
             self.client.getCameraImage(1, 1)
-            self.time = task.time
+            deadline += period
+            time.sleep(max(deadline - time.perf_counter(), 0))
+
+    def applySnapshotTask(self, task):
+        """Apply the scene changes and the latest state published by the simulation
+        """
+        while self.updates:
+            self.buildScene(self.updates.popleft())
+        snapshot = self.snapshot
+        if snapshot is not None:
+            scene_state, bg_color = snapshot
+            for k, node in self.nodes.items():
+                pose = scene_state.pose(k)
+                node.setPos(*pose.origin)
+                node.setQuat(Quat(*pose.quat))
+                node.setScale(*pose.scale)
+            self.setBackgroundColor(*bg_color)
         return Task.cont
 
     def update_scene(self, scene_graph, materials_only):
-        """Update a scene using scene_graph description
+        """Queue a scene update to the display, called from the simulation thread
 
         Arguments:
             scene_graph {SceneGraph} -- scene description
             materials_only {bool} -- update only shape materials
         """
+        self.updates.append(copy.copy(scene_graph))
+
+    def buildScene(self, scene_graph):
+        """Build the scene of a scene_graph description
+
+        Arguments:
+            scene_graph {SceneGraph} -- scene description
+        """
+        for node in self.nodes.values():
+            node.removeNode()
+        self.nodes = {}
         for k, v in scene_graph.nodes.items():
             node = self.render.attachNewNode(f'node_{k:02d}')
             self.nodes[k] = node
@@ -197,13 +235,8 @@ class MyApp(BaseRenderer, ShowBase):
             scene_view {SceneView} -- view settings, e.g. camera, light, viewport parameters
             frame {FrameData} -- output image buffer, ignore
         """
-        for k, node in self.nodes.items():
-            pose = scene_state.pose(k)
-            node.setPos(*pose.origin)
-            node.setQuat(Quat(*pose.quat))
-            node.setScale(*pose.scale)
-
-        self.setBackgroundColor(*scene_view.bg_color)
+        # the latest one is applied by the next display frame, others are dropped
+        self.snapshot = (copy.copy(scene_state), tuple(scene_view.bg_color))
         return False
 
 
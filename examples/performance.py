@@ -1,93 +1,316 @@
-"""Renderers performance test."""
+"""Renderers benchmark suite.
+
+Every engine renders generated scenes of a given number of objects, either primitives, meshes or
+textured meshes, for each combination of frame size, number of cameras and segmentation mask.
+Frame latency percentiles, throughput and, for engines of the rendering plugin, the duration of
+its stages are printed and written as JSON, to compare engines or track regressions:
+
+    python3 performance.py -e native-egl pyrender -o 10 1000 -s 128x128 512x512 -c 1 4
+    python3 performance.py --full --output v0.6.5.json
+    python3 performance.py --compare v0.6.5.json
+"""
 
 import argparse
+import datetime
+import json
+import math
 import multiprocessing as mp
+import os
 import pkgutil
+import platform
+import tempfile
+from queue import Empty
 from timeit import default_timer as timer
 
 import numpy as np
 import pybullet as pb
-import pybullet_data
 from PIL import Image
 from pybullet_utils.bullet_client import BulletClient
 
+import pybullet_rendering as pr
 from pybullet_rendering import RenderingPlugin
-from pybullet_rendering.render.panda3d import P3dRenderer
-from pybullet_rendering.render.pyrender import PyrRenderer
 from pybullet_rendering.render.utils import depth_from_zbuffer
 
+ENGINES = ['tiny', 'egl', 'pyrender', 'panda3d', 'native-egl', 'native-tiny']
+OBJECT_TYPES = ['primitive', 'mesh', 'textured']
+NUM_TEXTURES = 8  # textured meshes cycle through a few textures to exercise their binds
+
 parser = argparse.ArgumentParser(formatter_class=argparse.ArgumentDefaultsHelpFormatter)
-parser.add_argument('-n', '--num_frames', type=int, default=1000,
-                    help='Render num frames to compute average fps')
-parser.add_argument('-f', '--frame_size', nargs='+', default=[256, 256], help='Frame size')
-parser.add_argument('-e', '--engines', nargs='+',
-                    default=['tiny', 'egl', 'pyrender', 'panda3d'], help='Engines to test')
+parser.add_argument('-e', '--engines', nargs='+', default=['tiny', 'egl', 'pyrender', 'panda3d'],
+                    choices=ENGINES, help='Engines to test, native ones if built')
+parser.add_argument('-o', '--objects', nargs='+', type=int, default=[10, 100, 1000],
+                    help='Numbers of objects of the scenes')
+parser.add_argument('-t', '--object_types', nargs='+', default=OBJECT_TYPES,
+                    choices=OBJECT_TYPES, help='Kinds of objects of the scenes')
+parser.add_argument('-s', '--sizes', nargs='+', default=['256x256'],
+                    help='Frame sizes, as WIDTHxHEIGHT')
+parser.add_argument('-c', '--cameras', nargs='+', type=int, default=[1],
+                    help='Numbers of cameras rendered per frame')
+parser.add_argument('-m', '--mask', nargs='+', default=['on'], choices=['on', 'off'],
+                    help='Render the segmentation mask or not')
+parser.add_argument('-n', '--num_frames', type=int, default=200,
+                    help='Frames timed per configuration')
+parser.add_argument('-w', '--warmup', type=int, default=10,
+                    help='Frames rendered before timing, to upload the assets')
+parser.add_argument('--full', action='store_true',
+                    help='Sweep 10 to 10k objects, 64x64 to 1024x1024, 1 and 4 cameras, '
+                    'mask on and off')
+parser.add_argument('--output', default='benchmark.json', help='JSON results file')
+parser.add_argument('--compare', help='JSON results of a previous run, to print the changes')
+
 
+def parse_size(size):
+    """Parse a WIDTHxHEIGHT frame size."""
+    width, height = size.lower().split('x')
+    return int(width), int(height)
 
-def run_test(num_frames, frame_size, engine, fps_out):
-    """Compute fps of a specific engine."""
-    client = BulletClient(pb.DIRECT)
-    client.setAdditionalSearchPath(pybullet_data.getDataPath())
 
-    # load renderer
+def load_engine(client, engine):
+    """Load an engine, return its rendering plugin if any."""
     if 'tiny' == engine:
-        pass
-    elif 'egl' == engine:
+        return None
+    if 'egl' == engine:
         egl = pkgutil.get_loader('eglRenderer')
         client.loadPlugin(egl.get_filename(), "_eglRendererPlugin")
-    elif 'panda3d' == engine:
-        RenderingPlugin(client, P3dRenderer(multisamples=4))
-    elif 'pyrender' == engine:
-        RenderingPlugin(client, PyrRenderer(platform='egl'))
-
-    # sample scene
-    table = client.loadURDF("table/table.urdf", flags=pb.URDF_USE_MATERIAL_COLORS_FROM_MTL)
-    client.resetBasePositionAndOrientation(table, [0.4, 0.04, -0.7], [0, 0, 0, 1])
-
-    kuka = client.loadSDF("kuka_iiwa/kuka_with_gripper2.sdf")[0]
-    client.resetBasePositionAndOrientation(kuka, [0.0, 0.0, 0.0], [0, 0, 0, 1])
-    client.resetJointState(kuka, 3, -1.57)
-
-    proj_mat = pb.computeProjectionMatrixFOV(fov=60, aspect=1.0, nearVal=0.1, farVal=10)
-    view_mat = pb.computeViewMatrixFromYawPitchRoll((0.4, 0, 0), 2.0, 0, -40, 0, 2)
-
-    # warming up
-    _, _, color, depth, mask = client.getCameraImage(
-        *frame_size, projectionMatrix=proj_mat, viewMatrix=view_mat)
-    if engine in ('tiny', 'egl'):
-        depth = depth_from_zbuffer(depth, 0.1, 10.0)
-    img = Image.fromarray(color[:, :, :3])
-    img.save(f'color_{engine}.png')
-    img = Image.fromarray(((depth / depth.max()) * 255).astype(np.uint8))
-    img.save(f'depth_{engine}.png')
-    img = Image.fromarray(mask.astype(np.uint16))
-    img.save(f'mask_{engine}.png')
-
-    # compute fps
-    start = timer()
-    for _ in range(num_frames):
-        client.getCameraImage(
-            *frame_size, projectionMatrix=proj_mat, viewMatrix=view_mat)
-    end = timer()
-    fps_out.value = num_frames / (end - start)
+        return None
+    if 'panda3d' == engine:
+        from pybullet_rendering.render.panda3d import P3dRenderer
+        return RenderingPlugin(client, P3dRenderer(multisamples=4))
+    if 'pyrender' == engine:
+        from pybullet_rendering.render.pyrender import PyrRenderer
+        return RenderingPlugin(client, PyrRenderer(platform='egl'))
+    if 'native-egl' == engine:
+        # color, metric depth and mask in a single pass
+        return RenderingPlugin(client, pr.EGLRenderer())
+    if 'native-tiny' == engine:
+        return RenderingPlugin(client, pr.TinyRendererBackend())
+    raise ValueError(f'Unknown engine {engine}')
+
+
+def sphere_mesh(stacks=12, slices=24, radius=0.1):
+    """UV sphere of (stacks - 1) * slices * 2 triangles, with normals and texture coordinates."""
+    theta, phi = np.meshgrid(np.linspace(0, np.pi, stacks + 1),
+                             np.linspace(0, 2 * np.pi, slices + 1), indexing='ij')
+    normals = np.stack([np.sin(theta) * np.cos(phi),
+                        np.sin(theta) * np.sin(phi),
+                        np.cos(theta)], axis=-1).reshape(-1, 3)
+    uvs = np.stack([phi / (2 * np.pi), 1 - theta / np.pi], axis=-1).reshape(-1, 2)
+    indices = []
+    for i in range(stacks):
+        for j in range(slices):
+            a, b = i * (slices + 1) + j, (i + 1) * (slices + 1) + j
+            if i > 0:
+                indices += [a, b, a + 1]
+            if i < stacks - 1:
+                indices += [a + 1, b, b + 1]
+    return (normals * radius).tolist(), indices, normals.tolist(), uvs.tolist()
+
+
+def write_textures(directory, count, size=256):
+    """Write random checkerboard textures, return their paths."""
+    rng = np.random.RandomState(0)
+    paths = []
+    checker = (np.indices((size, size)).sum(axis=0) // 32) % 2
+    for i in range(count):
+        colors = rng.randint(0, 256, (2, 3), dtype=np.uint8)
+        path = os.path.join(directory, f'texture_{i}.png')
+        Image.fromarray(colors[checker]).save(path)
+        paths.append(path)
+    return paths
+
+
+def build_scene(client, num_objects, object_type, directory):
+    """Lay out objects on a ground grid, return its side length."""
+    side = int(math.ceil(math.sqrt(num_objects)))
+    spacing = 0.3
+    positions = [[(i % side - (side - 1) / 2) * spacing, (i // side - (side - 1) / 2) * spacing,
+                  0.1] for i in range(num_objects)]
+
+    if 'primitive' == object_type:
+        shape = client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.1, 0.1, 0.1],
+                                         rgbaColor=[0.8, 0.3, 0.2, 1.0])
+    else:
+        vertices, indices, normals, uvs = sphere_mesh()
+        shape = client.createVisualShape(pb.GEOM_MESH, vertices=vertices, indices=indices,
+                                         normals=normals, uvs=uvs)
+    bodies = client.createMultiBody(baseVisualShapeIndex=shape, batchPositions=positions)
+    if isinstance(bodies, int):
+        bodies = range(bodies, bodies + num_objects)
+
+    if 'textured' == object_type:
+        textures = [client.loadTexture(path)
+                    for path in write_textures(directory, min(NUM_TEXTURES, num_objects))]
+        for i, body in enumerate(bodies):
+            client.changeVisualShape(body, -1, textureUniqueId=textures[i % len(textures)])
+
+    ground = client.createVisualShape(pb.GEOM_BOX, halfExtents=[side * spacing] * 2 + [0.01])
+    client.createMultiBody(baseVisualShapeIndex=ground, basePosition=[0, 0, -0.01])
+    return side * spacing
+
+
+def cameras(extent, num_cameras, aspect):
+    """View and projection matrices of cameras around the scene, all of it in view."""
+    distance = max(1.0, 1.2 * extent)
+    proj_mat = pb.computeProjectionMatrixFOV(fov=60, aspect=aspect, nearVal=0.1,
+                                             farVal=3 * distance)
+    view_mats = [pb.computeViewMatrixFromYawPitchRoll((0, 0, 0), distance, i * 360 / num_cameras,
+                                                      -50, 0, 2) for i in range(num_cameras)]
+    return view_mats, [proj_mat] * num_cameras, 3 * distance
+
+
+def summarize(latencies, num_cameras):
+    """Latency percentiles and throughput of timed frames."""
+    latencies = np.asarray(latencies) * 1e3
+    total = latencies.sum() * 1e-3
+    return {
+        'latency_ms': {
+            'mean': float(latencies.mean()),
+            'p50': float(np.percentile(latencies, 50)),
+            'p95': float(np.percentile(latencies, 95)),
+            'p99': float(np.percentile(latencies, 99)),
+            'max': float(latencies.max()),
+        },
+        'frames_per_second': len(latencies) / total,
+        'images_per_second': len(latencies) * num_cameras / total,
+    }
+
+
+def run_scene(args, engine, num_objects, object_type, queue):
+    """Benchmark an engine on a scene for all frame sizes, cameras and masks."""
+    results = []
+    base = {'engine': engine, 'objects': num_objects, 'object_type': object_type}
+    try:
+        client = BulletClient(pb.DIRECT)
+        plugin = load_engine(client, engine)
+        with tempfile.TemporaryDirectory() as directory:
+            extent = build_scene(client, num_objects, object_type, directory)
+        # builtin engines output a Z-buffer, converted in place as the other engines output depth
+        zbuffer = engine in ('tiny', 'egl')
+
+        for size in args.sizes:
+            width, height = parse_size(size)
+            for num_cameras in args.cameras:
+                view_mats, proj_mats, far = cameras(extent, num_cameras, width / height)
+                for mask in args.mask:
+                    flags = 0 if 'on' == mask else pb.ER_NO_SEGMENTATION_MASK
+
+                    def frame():
+                        if plugin is not None and num_cameras > 1:
+                            plugin.render_cameras(width, height, view_mats, proj_mats,
+                                                  flags=flags)
+                            return
+                        for view_mat, proj_mat in zip(view_mats, proj_mats):
+                            _, _, _, depth, _ = client.getCameraImage(
+                                width, height, viewMatrix=view_mat, projectionMatrix=proj_mat,
+                                flags=flags)
+                            if zbuffer:
+                                depth = np.asarray(depth, np.float32)
+                                depth_from_zbuffer(depth, 0.1, far, out=depth)
+
+                    for _ in range(args.warmup):
+                        frame()
+                    if plugin is not None:
+                        plugin.stage_stats(reset=True)
+                    latencies = []
+                    for _ in range(args.num_frames):
+                        start = timer()
+                        frame()
+                        latencies.append(timer() - start)
+
+                    result = dict(base, width=width, height=height, cameras=num_cameras,
+                                  mask='on' == mask, frames=args.num_frames)
+                    result.update(summarize(latencies, num_cameras))
+                    if plugin is not None:
+                        result['stages'] = {
+                            name: {key: stats[key]
+                                   for key in ('count', 'mean', 'p50', 'p90', 'p99', 'max')}
+                            for name, stats in plugin.stage_stats().items() if stats['count']}
+                    results.append(result)
+        client.disconnect()
+    except Exception as error:  # pylint: disable=broad-except
+        results.append(dict(base, error=repr(error)))
+    queue.put(results)
+
+
+def wait_results(proc, queue, base):
+    """Results of a scene process, an error if it died without any, e.g. in a crash."""
+    while True:
+        try:
+            return queue.get(timeout=1.0)
+        except Empty:
+            if not proc.is_alive():
+                return [dict(base, error=f'exit code {proc.exitcode}')]
+
+
+def case_key(result):
+    """Configuration of a result, to match the results of two runs."""
+    return tuple(result.get(key) for key in ('engine', 'objects', 'object_type', 'width',
+                                             'height', 'cameras', 'mask'))
+
+
+def print_results(results, baseline=None):
+    """Print a table of the results, with the change of p50 latency from a baseline run."""
+    previous = {case_key(result): result for result in baseline or [] if 'error' not in result}
+    print(f'{"engine":<12} {"objects":>7} {"type":<9} {"size":>9} {"cams":>4} {"mask":<4} '
+          f'{"p50 ms":>8} {"p95 ms":>8} {"p99 ms":>8} {"fps":>8}' + ('   p50 change' if previous
+                                                                      else ''))
+    for result in results:
+        head = f'{result["engine"]:<12} {result["objects"]:>7} {result["object_type"]:<9}'
+        if 'error' in result:
+            print(f'{head} failed: {result["error"]}')
+            continue
+        latency = result['latency_ms']
+        line = (f'{head} {result["width"]:>4}x{result["height"]:<4} {result["cameras"]:>4} '
+                f'{"on" if result["mask"] else "off":<4} {latency["p50"]:>8.2f} '
+                f'{latency["p95"]:>8.2f} {latency["p99"]:>8.2f} '
+                f'{result["frames_per_second"]:>8.1f}')
+        old = previous.get(case_key(result))
+        if old is not None:
+            line += f'   {100 * (latency["p50"] / old["latency_ms"]["p50"] - 1):+.1f}%'
+        print(line)
 
 
 def main(args):
-    results = {}
+    if args.full:
+        args.objects = [10, 100, 1000, 10000]
+        args.sizes = ['64x64', '256x256', '1024x1024']
+        args.cameras = [1, 4]
+        args.mask = ['on', 'off']
 
+    results = []
     for engine in args.engines:
-        print(f'Testing {engine}...')
-        fps = mp.Value('d', 0.0)
-        proc = mp.Process(target=run_test, args=(args.num_frames, args.frame_size, engine, fps))
-        proc.start()
-        proc.join()
-        results[engine] = fps.value
+        for object_type in args.object_types:
+            for num_objects in args.objects:
+                print(f'Testing {engine} with {num_objects} {object_type} objects...')
+                # a process per scene, so that engines and scenes do not share any state
+                queue = mp.Queue()
+                proc = mp.Process(target=run_scene,
+                                  args=(args, engine, num_objects, object_type, queue))
+                proc.start()
+                results += wait_results(proc, queue, dict(engine=engine, objects=num_objects,
+                                                          object_type=object_type))
+                proc.join()
 
+    baseline = None
+    if args.compare:
+        with open(args.compare) as file:
+            baseline = json.load(file)['results']
     print('Results:')
-    for engine, fps in results.items():
-        print(f'{engine}: {fps:.2f} fps')
+    print_results(results, baseline)
+
+    report = {
+        'version': pr.__version__,
+        'date': datetime.datetime.now().isoformat(timespec='seconds'),
+        'platform': platform.platform(),
+        'python': platform.python_version(),
+        'pybullet': pb.getAPIVersion(),
+        'arguments': {key: value for key, value in vars(args).items() if key != 'compare'},
+        'results': results,
+    }
+    with open(args.output, 'w') as file:
+        json.dump(report, file, indent=2)
+    print(f'Results written to {args.output}')
 
 
 if __name__ == '__main__':
-    args = parser.parse_args()
-    main(args)
+    main(parser.parse_args())
@@ -0,0 +1,204 @@
+"""Soak test of the memory of renderers over episodes.
+
+Every engine loops episodes of loading textured objects and a URDF robot, rendering them, removing
+them and resetting the simulation, thousands of times, in a process of its own. The resident set
+size, the GPU memory of the process and, for engines of the rendering plugin, its memory report
+are sampled along the way. A metric fails when it keeps growing after the warmup: its growth rate
+exceeds the limit and the samples of the last third of the run all lie above those of the first
+third. The script exits with an error if any metric of any engine fails:
+
+    python3 soak.py -e native-egl pyrender panda3d -n 5000
+    python3 soak.py -e native-egl --limit 1 --output soak.json
+"""
+
+import argparse
+import json
+import multiprocessing as mp
+import os
+import sys
+import tempfile
+
+import numpy as np
+import pybullet as pb
+import pybullet_data
+from pybullet_utils.bullet_client import BulletClient
+
+import pybullet_rendering as pr
+from performance import ENGINES, load_engine, sphere_mesh, wait_results, write_textures
+
+parser = argparse.ArgumentParser(formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+parser.add_argument('-e', '--engines', nargs='+', default=['tiny', 'pyrender', 'panda3d'],
+                    choices=ENGINES, help='Engines to test, native ones if built')
+parser.add_argument('-n', '--episodes', type=int, default=2000, help='Episodes per engine')
+parser.add_argument('-o', '--objects', type=int, default=20, help='Objects loaded per episode')
+parser.add_argument('-f', '--frames', type=int, default=2, help='Frames rendered per episode')
+parser.add_argument('-s', '--size', default='128x128', help='Frame size, as WIDTHxHEIGHT')
+parser.add_argument('--sample_every', type=int, default=20, help='Episodes between samples')
+parser.add_argument('--warmup', type=int, default=200,
+                    help='Episodes before the samples fitted, to fill the caches and pools')
+parser.add_argument('--limit', type=float, default=4.0,
+                    help='Growth in MiB per 1000 episodes above which a metric fails')
+parser.add_argument('--output', default='soak.json', help='JSON results file')
+
+MIB = 1 << 20
+
+
+def resident_bytes():
+    """Resident set size of the process, None where /proc is not available."""
+    try:
+        with open('/proc/self/statm') as file:
+            return int(file.read().split()[1]) * os.sysconf('SC_PAGE_SIZE')
+    except (OSError, ValueError):
+        return None
+
+
+class GpuMemory:
+    """GPU memory used by the process on all NVIDIA devices, None without NVML."""
+
+    def __init__(self):
+        try:
+            import pynvml
+            pynvml.nvmlInit()
+            self._nvml = pynvml
+            self._devices = [pynvml.nvmlDeviceGetHandleByIndex(i)
+                             for i in range(pynvml.nvmlDeviceGetCount())]
+        except Exception:  # pylint: disable=broad-except
+            self._nvml = None
+
+    def __call__(self):
+        if self._nvml is None:
+            return None
+        pid, used = os.getpid(), 0
+        for device in self._devices:
+            for query in (self._nvml.nvmlDeviceGetComputeRunningProcesses,
+                          self._nvml.nvmlDeviceGetGraphicsRunningProcesses):
+                used += sum(process.usedGpuMemory or 0 for process in query(device)
+                            if process.pid == pid)
+        return used
+
+
+def sample(episode, plugin, gpu_memory):
+    """Memory metrics of the process and of the plugin, in bytes."""
+    metrics = {'episode': episode, 'rss': resident_bytes(), 'gpu': gpu_memory()}
+    if plugin is not None:
+        report = plugin.memory_report()
+        metrics['plugin_total'] = report['total_bytes']
+        metrics['plugin_assets'] = report['assets']['total_bytes']
+        metrics['renderer_gpu'] = report['renderer']['gpu_bytes']
+        metrics['renderer_host'] = report['renderer']['host_bytes']
+        metrics['frames'] = report['frame_bytes']
+        metrics['asset_cache'] = pr.get_process_memory_report()['cached_bytes']
+    return metrics
+
+
+def run_episode(client, args, mesh, textures):
+    """Load, render and remove a scene, then reset the simulation."""
+    width, height = (int(value) for value in args.size.lower().split('x'))
+    vertices, indices, normals, uvs = mesh
+    shape = client.createVisualShape(pb.GEOM_MESH, vertices=vertices, indices=indices,
+                                     normals=normals, uvs=uvs)
+    bodies = [client.createMultiBody(baseVisualShapeIndex=shape,
+                                     basePosition=[(i % 5 - 2) * 0.3, (i // 5 - 2) * 0.3, 0.1])
+              for i in range(args.objects)]
+    texture_ids = [client.loadTexture(path) for path in textures]
+    for i, body in enumerate(bodies):
+        client.changeVisualShape(body, -1, textureUniqueId=texture_ids[i % len(texture_ids)])
+    bodies.append(client.loadURDF('r2d2.urdf', basePosition=[0, 0, 0.5]))
+
+    view_mat = pb.computeViewMatrixFromYawPitchRoll((0, 0, 0), 3.0, 30, -40, 0, 2)
+    proj_mat = pb.computeProjectionMatrixFOV(60, width / height, 0.1, 10.0)
+    for _ in range(args.frames):
+        client.stepSimulation()
+        client.getCameraImage(width, height, viewMatrix=view_mat, projectionMatrix=proj_mat)
+    for body in bodies:
+        client.removeBody(body)
+    client.resetSimulation()
+
+
+def growth(episodes, values, limit):
+    """Growth of a metric in MiB per 1000 episodes, and whether it keeps growing."""
+    episodes, values = np.asarray(episodes, np.float64), np.asarray(values, np.float64)
+    slope = np.polyfit(episodes, values, 1)[0] * 1000 / MIB if len(values) > 1 else 0.0
+    third = len(values) // 3
+    sustained = third > 0 and values[-third:].min() > values[:third].max()
+    return slope, bool(slope > limit and sustained)
+
+
+def run_engine(args, engine, queue):
+    """Soak an engine, put its samples and verdicts in the queue."""
+    result = {'engine': engine}
+    try:
+        client = BulletClient(pb.DIRECT)
+        client.setAdditionalSearchPath(pybullet_data.getDataPath())
+        plugin = load_engine(client, engine)
+        gpu_memory = GpuMemory()
+        samples = []
+        with tempfile.TemporaryDirectory() as directory:
+            textures = write_textures(directory, 4)
+            mesh = sphere_mesh()
+            for episode in range(args.episodes):
+                run_episode(client, args, mesh, textures)
+                if episode % args.sample_every == 0 or episode == args.episodes - 1:
+                    samples.append(sample(episode, plugin, gpu_memory))
+        client.disconnect()
+
+        fitted = [s for s in samples if s['episode'] >= args.warmup]
+        result['samples'] = samples
+        result['metrics'] = {}
+        for key in samples[0]:
+            if key == 'episode' or samples[0][key] is None:
+                continue
+            slope, failed = growth([s['episode'] for s in fitted], [s[key] for s in fitted],
+                                   args.limit)
+            result['metrics'][key] = {'first_mib': samples[0][key] / MIB,
+                                      'last_mib': samples[-1][key] / MIB,
+                                      'mib_per_1000_episodes': slope, 'failed': failed}
+    except Exception as error:  # pylint: disable=broad-except
+        result['error'] = repr(error)
+    queue.put([result])
+
+
+def print_results(results):
+    """Print a table of the metrics of each engine."""
+    print(f'{"engine":<12} {"metric":<14} {"first MiB":>10} {"last MiB":>10} '
+          f'{"MiB/1000 ep":>12}')
+    for result in results:
+        if 'error' in result:
+            print(f'{result["engine"]:<12} failed: {result["error"]}')
+            continue
+        for key, metric in result['metrics'].items():
+            print(f'{result["engine"]:<12} {key:<14} {metric["first_mib"]:>10.1f} '
+                  f'{metric["last_mib"]:>10.1f} {metric["mib_per_1000_episodes"]:>12.2f}'
+                  + ('   GROWING' if metric['failed'] else ''))
+
+
+def main(args):
+    if args.warmup >= args.episodes:
+        parser.error('the warmup must leave episodes to fit')
+    results = []
+    for engine in args.engines:
+        print(f'Soaking {engine} over {args.episodes} episodes...')
+        # a process per engine, so that each starts from a fresh heap
+        queue = mp.Queue()
+        proc = mp.Process(target=run_engine, args=(args, engine, queue))
+        proc.start()
+        results += wait_results(proc, queue, dict(engine=engine))
+        proc.join()
+
+    print('Results:')
+    print_results(results)
+    with open(args.output, 'w') as file:
+        json.dump({'version': pr.__version__,
+                   'arguments': vars(args),
+                   'results': results}, file, indent=2)
+    print(f'Results written to {args.output}')
+
+    failed = [result['engine'] for result in results
+              if 'error' in result or any(m['failed'] for m in result['metrics'].values())]
+    if failed:
+        print(f'Memory keeps growing or the soak failed for: {", ".join(failed)}')
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main(parser.parse_args())
@@ -0,0 +1,91 @@
+# Copyright (c) 2019-2020 INRIA.
+# This source code is licensed under the LGPLv3 license found in the
+# LICENSE file in the root directory of this source tree.
+
+import itertools
+import multiprocessing
+import os
+import uuid
+from typing import Callable
+
+from .bindings import RemoteRenderer, RenderServer
+
+
+class RendererHost:
+    """Pool of worker processes rendering for the RemoteRenderer clients of this process.
+
+    Python renderers run under the GIL of the simulation, blocking its physics loop, and the
+    Panda3D renderer allows one instance per process. Each renderer() of a host is served by
+    a worker process with its own renderer_factory() renderer: scene updates and poses go
+    through a shared memory channel, and frames are drawn straight into shared frame slots,
+    so that the environments of a vectorized simulation render in parallel.
+
+    A worker serves one renderer at a time, until it is destroyed; renderers beyond the number
+    of processes wait for a worker to be free. Shared memory channels are POSIX only.
+    """
+
+    def __init__(self, renderer_factory: Callable, processes: int = 1):
+        """Start the worker processes.
+
+        Arguments:
+            renderer_factory {callable} -- picklable callable returning a renderer, called by a
+                worker for each renderer it serves
+
+        Keyword Arguments:
+            processes {int} -- number of worker processes (default: 1)
+        """
+        # spawned workers do not inherit GPU contexts nor the Panda3D instance of this process
+        context = multiprocessing.get_context('spawn')
+        self._names = context.Queue()
+        self._workers = [
+            context.Process(target=_serve, args=(renderer_factory, self._names), daemon=True)
+            for _ in range(max(processes, 1))
+        ]
+        for worker in self._workers:
+            worker.start()
+        self._counter = itertools.count()
+
+    @property
+    def processes(self) -> int:
+        """Number of worker processes."""
+        return len(self._workers)
+
+    def renderer(self, max_pending: int = 1, quantize: bool = False,
+                 timeout: float = 30.) -> RemoteRenderer:
+        """Renderer drawn by the next free worker, e.g. for RenderingPlugin.set_renderer.
+
+        Keyword Arguments:
+            max_pending {int} -- requests in flight, see RemoteRenderer (default: 1)
+            quantize {bool} -- quantize the poses sent (default: False)
+            timeout {float} -- seconds to wait for a free worker (default: 30.)
+
+        Raises:
+            RuntimeError -- if no worker served the renderer in time
+        """
+        name = '/pbr_{}_{}_{}'.format(os.getpid(), next(self._counter), uuid.uuid4().hex[:8])
+        self._names.put(name)
+        return RemoteRenderer.shared_memory(name, max_pending=max_pending, quantize=quantize,
+                                            timeout=timeout)
+
+    def close(self):
+        """Stop the workers once their renderers are destroyed."""
+        for _ in self._workers:
+            self._names.put(None)
+        for worker in self._workers:
+            worker.join()
+        self._workers = []
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+
+def _serve(renderer_factory, names):
+    """Serve the channels named by the queue one after the other, until None."""
+    for name in iter(names.get, None):
+        try:
+            RenderServer.serve_shared_memory(renderer_factory, name)
+        except RuntimeError:
+            pass  # the client gave up before the worker was free
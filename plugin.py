@@ -2,14 +2,27 @@
 # This source code is licensed under the LGPLv3 license found in the
 # LICENSE file in the root directory of this source tree.
 
-from typing import Union
+import os
+from typing import Sequence, Union
 
+import numpy as np
 import pybullet as pb
 from pybullet_utils.bullet_client import BulletClient
 
-from .bindings import BaseRenderer
+from .bindings import (AssetPrefetch, BaseRenderer, FrameRing, LensDistortion, Light,
+                       OutputChannel, PointFrame, Projection, Quality)
+from .bindings import SceneLayer, SegmentationMode, SensorNoise
 from .bindings import __file__ as plugin_lib_file
-from .bindings import set_renderer
+from .bindings import _announce_client, _take_registration
+from .bindings import decode_frame
+from .bindings import (Randomization, change_texels, get_camera_boxes, get_camera_depth_pyramid,
+                       get_camera_events, get_camera_keypoints, get_camera_motion,
+                       get_camera_normals, get_camera_pixel_counts, get_camera_points,
+                       get_frame_cache_stats, get_frame_step, get_memory_report, get_stage_stats,
+                       import_links, make_base_layer, next_randomization_episode,
+                       register_texture, render_camera, reset_stage_stats, set_base_layer,
+                       set_camera_batch, clear_camera_batch, set_frame_sink, set_randomization,
+                       set_renderer)
 
 
 class RenderingPlugin:
@@ -18,6 +31,8 @@ class RenderingPlugin:
     def __init__(self, client: Union[int, BulletClient] = 0, renderer: BaseRenderer = None):
         """Load plugin.
 
+        Bodies already loaded are imported with their visual shapes, see import_links.
+
         Arguments:
             physicsClientId {int or BulletClient} -- physics client
 
@@ -25,20 +40,25 @@ class RenderingPlugin:
             renderer {BaseRenderer} -- renderer to load  (default: None)
         """
         self._client_id = client if isinstance(client, int) else client._client
-        # check the simulation world is empty
-        num_bodies = pb.getNumBodies(physicsClientId=self._client_id)
-        assert num_bodies == 0, 'Cannot load the rendering plugin: simulation world is not empty'
-        # load plugin
+        # bodies loaded so far are listed by the current renderer, before the plugin replaces it
+        links = _visual_links(self._client_id)
+        # load plugin, registered with the client by the load itself when run on this thread
+        _announce_client(self._client_id)
         self._plugin_id = pb.loadPlugin(plugin_lib_file,
                                         '_RenderingPlugin',
                                         physicsClientId=self._client_id)
+        registered = _take_registration(self._client_id)
         assert self._plugin_id != -1, 'Cannot load the rendering plugin'
-        # workaround to connect python bindings with a physicsClientId
-        retcode = pb.executePluginCommand(self._plugin_id,
-                                          "register",
-                                          intArgs=[self._client_id],
-                                          physicsClientId=self._client_id)
-        assert retcode != -1, 'Cannot register render interface'
+        if not registered:
+            # workaround to connect python bindings with a physicsClientId
+            retcode = pb.executePluginCommand(self._plugin_id,
+                                              "register",
+                                              intArgs=[self._client_id],
+                                              physicsClientId=self._client_id)
+            assert retcode != -1, 'Cannot register render interface'
+        if links:
+            import_links(links, self._client_id)
+        self._step_time = 0.  # simulated seconds per physics step, see set_render_rate
         # bind a renderer
         self._renderer = None
         if renderer is not None:
@@ -56,18 +76,1382 @@ class RenderingPlugin:
         """
         return self._renderer
 
-    def set_renderer(self, renderer: BaseRenderer):
+    def set_renderer(self, renderer: BaseRenderer, cache_overrides: bool = True):
         """Bind a renderer to a local physics client (DIRECT connection).
 
+        Native renderers run without the GIL, letting other python threads work meanwhile.
+
         Arguments:
             renderer {Renderer} -- Renderer
+
+        Keyword Arguments:
+            cache_overrides {bool} -- resolve the methods of a python renderer once, methods
+                patched on the renderer later are not called (default: True)
         """
-        set_renderer(renderer, self._client_id)
+        set_renderer(renderer, self._client_id, cache_overrides)
         self._renderer = renderer
 
+    def set_async(self, enabled: bool):
+        """Render on a dedicated thread, overlapping physics and rendering.
+
+        In this mode getCameraImage returns the previous completed frame, that is an empty image
+        until the render thread delivers a first frame.
+
+        Arguments:
+            enabled {bool} -- async mode
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "async",
+                                          intArgs=[int(enabled)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change render mode'
+
+    def set_frame_cache(self, enabled: bool):
+        """Reuse the previous frame when neither the scene, the poses nor the camera changed.
+
+        Arguments:
+            enabled {bool} -- frame cache mode
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "frame_cache",
+                                          intArgs=[int(enabled)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change frame cache mode'
+
+    def set_render_rate(self, rate: float = 0., interpolate: bool = False):
+        """Render camera images at a rate of the simulated time only, e.g. 10 Hz of a 240 Hz
+        simulation, so that an agent may request an image every step.
+
+        Other requests return the last frame without syncing the poses of the bodies. With
+        interpolation, frames due between two physics steps pose the bodies at that time from
+        their poses at both steps, the step before being synced for the purpose.
+
+        Keyword Arguments:
+            rate {float} -- frames per simulated second, 0 to render every request (default: 0)
+            interpolate {bool} -- interpolate the poses at the time of the frames
+        """
+        params = pb.getPhysicsEngineParameters(physicsClientId=self._client_id)
+        self._step_time = params['fixedTimeStep'] / max(params['numSubSteps'], 1)
+        frame_period = 1. / (rate * self._step_time) if rate > 0. else 0.
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "render_schedule",
+                                          intArgs=[int(interpolate)],
+                                          floatArgs=[frame_period],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change render rate'
+
+    @property
+    def frame_time(self) -> float:
+        """Simulated time of the last rendered frame, in seconds since set_render_rate."""
+        return get_frame_step(self._client_id) * self._step_time
+
+    def set_static_classification(self, unchanged_syncs: int = 0, fixed_bases: bool = True):
+        """Classify the nodes that do not move as static, native renderers then merge their shapes.
+
+        A node is static once its transform did not change for a number of consecutive
+        simulation steps and, if enabled, from its first pose on for the base of a fixed-base
+        body loaded from then on. Static nodes are dynamic again as soon as they move.
+
+        Arguments:
+            unchanged_syncs {int} -- steps without motion before a node is static, 0 for never
+            fixed_bases {bool} -- bases of fixed-base bodies are static
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "static",
+                                          intArgs=[unchanged_syncs, int(fixed_bases)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change static classification'
+
+    def set_step_sync(self, enabled: bool):
+        """Sync the poses of the bodies once per simulation step rather than per camera image.
+
+        Cameras requested in the same step then skip the poses already synced for the first one,
+        and static classification counts steps. Bodies moved without a step, e.g. by
+        resetBasePositionAndOrientation, are only seen after the next step.
+
+        Arguments:
+            enabled {bool} -- step sync mode
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "step_sync",
+                                          intArgs=[int(enabled)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change step sync mode'
+
+    def set_warm_reset(self, enabled: bool):
+        """Keep the scene across resetSimulation, for episodes reloading the same bodies.
+
+        Bodies loaded again under the same ids with the same meshes and materials keep what the
+        renderer built for them, only the others are rebuilt or removed at the next image.
+        Assets stay in the process-wide asset cache either way.
+
+        Arguments:
+            enabled {bool} -- warm reset mode
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "warm_reset",
+                                          intArgs=[int(enabled)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change reset mode'
+
+    def set_deferred_conversion(self, enabled: bool):
+        """Convert the links of large imports, e.g. loadSDF or loadMJCF, in parallel.
+
+        Links are queued as bullet loads them and converted on all cores before the next step,
+        image or change of the scene, in the same order as without deferral.
+
+        Arguments:
+            enabled {bool} -- deferred conversion mode
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "deferred_conversion",
+                                          intArgs=[int(enabled)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change conversion mode'
+
+    def set_staged_loading(self, enabled: bool, upload_budget: float = 0.002, wait: bool = False):
+        """Add the objects spawned while the simulation runs without stalling the next images.
+
+        New objects stay out of the scene while background workers load their meshes and
+        textures, images showing the scene without them meanwhile. They are then added, their
+        assets uploaded for at most upload_budget seconds per image. Objects changed, e.g.
+        recolored, while staged are added at once.
+
+        Arguments:
+            enabled {bool} -- staged loading mode
+            upload_budget {float} -- seconds of uploads per image, one object at least
+            wait {bool} -- images wait for all the staged objects, for strict consistency
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "staged_loading",
+                                          intArgs=[int(enabled), int(wait)],
+                                          floatArgs=[upload_budget],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change loading mode'
+
+    def save_state(self) -> int:
+        """Save the bullet state and the render-side scene state along, for rollouts.
+
+        The poses of the scene state are saved copy-on-write, sharing the ones unchanged since
+        the last saved or restored state, and the randomized materials by reference.
+
+        Returns:
+            int -- bullet state id, for restore_state and remove_state
+        """
+        state_id = pb.saveState(physicsClientId=self._client_id)
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "snapshot",
+                                          intArgs=[state_id],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot save the scene state'
+        return state_id
+
+    def restore_state(self, state_id: int):
+        """Restore a state saved with save_state, bullet and render-side.
+
+        Only the poses that differ from the saved ones change, so that renderers upload those.
+
+        Arguments:
+            state_id {int} -- state id returned by save_state
+        """
+        pb.restoreState(state_id, physicsClientId=self._client_id)
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "snapshot",
+                                          intArgs=[state_id, 1],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'No scene state saved with this id'
+
+    def remove_state(self, state_id: int):
+        """Forget a state saved with save_state, bullet and render-side.
+
+        Arguments:
+            state_id {int} -- state id returned by save_state
+        """
+        pb.removeState(state_id, physicsClientId=self._client_id)
+        pb.executePluginCommand(self._plugin_id,
+                                "snapshot",
+                                intArgs=[state_id, -1],
+                                physicsClientId=self._client_id)
+
+    def register_camera(self, projection_matrix: Sequence[float],
+                        distortion: LensDistortion = None) -> int:
+        """Register a camera of fixed intrinsics, e.g. those of a sensor.
+
+        Its field of view, clipping distances and aspect ratio are derived once, and renderers
+        may keep objects of their own under its handle from image to image, such as the lookup
+        of its lens distortion: images are drawn through the pinhole projection and remapped by
+        the renderer, colors bilinearly, depth and masks from the nearest pixel.
+
+        Arguments:
+            projection_matrix {list} -- column-major projection matrix (16 floats)
+
+        Keyword Arguments:
+            distortion {LensDistortion} -- Brown-Conrady or fisheye distortion of the lens, with
+                the coefficients of OpenCV, none if None (default: {None})
+
+        Returns:
+            int -- camera handle, for select_camera
+        """
+        floats = [float(v) for v in np.ravel(projection_matrix)]
+        if distortion is not None:
+            floats += [float(int(distortion.model)), distortion.k1, distortion.k2, distortion.k3,
+                       distortion.k4, distortion.p1, distortion.p2]
+        handle = pb.executePluginCommand(self._plugin_id,
+                                         "camera",
+                                         floatArgs=floats,
+                                         physicsClientId=self._client_id)
+        assert handle != -1, 'Cannot register camera'
+        return handle
+
+    def select_camera(self, handle: int = -1):
+        """Render the next camera images with the intrinsics of a registered camera.
+
+        The view matrix of getCameraImage is still used, its projection matrix is ignored.
+
+        Keyword Arguments:
+            handle {int} -- handle returned by register_camera, -1 for none (default: {-1})
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "camera",
+                                          intArgs=[handle],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Unknown camera {}'.format(handle)
+
+    def set_projection(self, projection: Projection = Projection.Perspective):
+        """Render the next camera images all around the camera position in a single frame.
+
+        Cubemap images stack the front, right, back, left, up and down faces of width x width
+        pixels, request them with a height of 6 x width. Equirectangular images span longitudes
+        along their width, the camera direction in the middle, and latitudes along their height;
+        their depth is the distance to the camera. Only the clipping distances of the projection
+        matrix of getCameraImage are used.
+
+        Keyword Arguments:
+            projection {Projection} -- projection of the images (default: {Projection.Perspective})
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "projection",
+                                          intArgs=[int(projection)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change projection'
+
+    def set_multiview(self, poses: Sequence = ()):
+        """Render the next camera images together with those of other views of a rig.
+
+        Each view is at a pose in the frame of the camera of getCameraImage (x right, y up,
+        looking along -z), with its projection, e.g. the other eye of a stereo rig at
+        (baseline, 0, 0). Images are stacked top to bottom, the camera one first: request them
+        with a height of (len(poses) + 1) x height. The scene is synced and culled once for all
+        views, the EGL renderer drawing them in a single pass. Color, depth and mask only; regions
+        of interest, render scales and lens distortion are ignored.
+
+        Keyword Arguments:
+            poses {list} -- 4x4 poses of up to 7 other views, none for single views
+                (default: {()})
+        """
+        floats = [float(v) for pose in poses for v in np.ravel(np.asarray(pose).T)]
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "multiview",
+                                          floatArgs=floats,
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot render {} views'.format(len(poses) + 1)
+
+    def set_lights(self, lights: Sequence[Light] = ()):
+        """Light the next camera images by point and spot lights, besides the main light.
+
+        The EGL renderer shades them with clustered forward shading: the view is split into
+        screen tiles and depth slices listing the lights reaching them, so that a pixel is lit by
+        the nearest lights around it, at most 32, however many the scene holds. Lights without a
+        range light every pixel, up to 8 of them. Lights shine their color and cast no shadows.
+
+        Keyword Arguments:
+            lights {list} -- lights of type PointLight or SpotLight, none to remove them
+                (default: {()})
+        """
+        floats = []
+        for light in lights:
+            floats += [float(int(light.type)), *light.position, *light.direction, *light.color,
+                       light.range, light.spot_angle]
+        # a command carries 10 lights at most
+        total = len(lights)
+        for first in range(0, max(total, 1), 10):
+            retcode = pb.executePluginCommand(self._plugin_id,
+                                              "lights",
+                                              intArgs=[first, total],
+                                              floatArgs=floats[first * 12:(first + 10) * 12],
+                                              physicsClientId=self._client_id)
+            assert retcode != -1, 'Cannot set lights of types {}'.format(
+                [light.type for light in lights])
+
+    def set_roi(self, x: int = 0, y: int = 0, width: int = 0, height: int = 0):
+        """Render a region of interest of the next camera images only.
+
+        getCameraImage then returns images of the region size, drawn with the projection matrix
+        restricted to the region, so that only its pixels are rasterized and copied. The region
+        is clipped to the requested image, regions of zero size or out of the image render the
+        whole image, as do panoramic projections.
+
+        Keyword Arguments:
+            x {int} -- column of the top-left pixel of the region (default: {0})
+            y {int} -- row of the top-left pixel of the region (default: {0})
+            width {int} -- region width, 0 for the whole image (default: {0})
+            height {int} -- region height, 0 for the whole image (default: {0})
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "roi",
+                                          intArgs=[x, y, width, height],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change region of interest'
+
+    def set_quality(self, quality: Quality = None):
+        """Render the next camera images at a quality tier.
+
+        Renderers honor the features their pipeline has, e.g. Quality.fast() drops the
+        multisampling, shadows and specular highlights of the renderer and samples the nearest
+        texels, for small policy images.
+
+        Keyword Arguments:
+            quality {Quality} -- quality tier, the renderer defaults if None (default: {None})
+        """
+        quality = Quality() if quality is None else quality
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "quality",
+                                          intArgs=[quality.multisamples, int(quality.shadows),
+                                                   int(quality.specular),
+                                                   int(quality.texture_filter)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change quality'
+
+    def set_sensor_noise(self, noise: SensorNoise = None):
+        """Apply the noise models of a sensor to the next camera images.
+
+        Disparity quantization, axial noise and edge dropout of depth sensors, and vignetting,
+        white balance, shot and read noise of color sensors, applied to the images by the plugin
+        instead of numpy. Noise is drawn from the seed and the frame, the frame cache does not
+        reuse noised images.
+
+        Keyword Arguments:
+            noise {SensorNoise} -- noise models, none if None (default: {None})
+        """
+        noise = SensorNoise() if noise is None else noise
+        balance = noise.white_balance
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "sensor_noise",
+                                          intArgs=[(noise.seed ^ 0x80000000) - 0x80000000],
+                                          floatArgs=[noise.baseline, noise.subpixel,
+                                                     noise.axial_sigma, noise.edge_dropout,
+                                                     noise.edge_threshold, noise.vignetting,
+                                                     balance[0], balance[1], balance[2],
+                                                     noise.shot_noise, noise.read_noise],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change sensor noise'
+
+    def set_render_scale(self, scale: float = 1.0):
+        """Render the next camera images at a scaled internal resolution, resampled to their size.
+
+        A scale of 4 renders 16 pixels per image pixel and box filters them, e.g. for small
+        policy images, a scale of 0.5 renders a quarter of the pixels and upsamples them
+        bilinearly, e.g. for large dashboard images. Depth and masks are those of the nearest
+        surface under each pixel. The EGL renderer resamples on the GPU, other renderers on the
+        CPU; panoramic projections ignore the scale.
+
+        Keyword Arguments:
+            scale {float} -- internal resolution over the image size, 1 for none (default: {1.0})
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "render_scale",
+                                          floatArgs=[scale],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change render scale'
+
+    def set_point_output(self, enabled: bool = True, frame: PointFrame = PointFrame.Camera,
+                         compact: bool = False):
+        """Also render the XYZ points of the pixels of the next camera images.
+
+        Points are computed by the renderer, in a shader for the EGL renderer, instead of
+        unprojecting the depth in numpy; read them with get_points() after getCameraImage.
+
+        Keyword Arguments:
+            enabled {bool} -- render points (default: {True})
+            frame {PointFrame} -- camera frame, looking along -z with y up, or world frame
+                (default: {PointFrame.Camera})
+            compact {bool} -- keep the points of the pixels where something was drawn only, with
+                their segmentation ids (default: {False})
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "points",
+                                          intArgs=[int(enabled), int(frame), int(compact)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change point output'
+
+    def get_points(self):
+        """Points of the last camera image (DIRECT connection), see set_point_output.
+
+        Returns:
+            tuple -- points (H,W,3), zero where nothing was drawn, and None, or compact points
+                (N,3) and their segmentation ids (N,), -1 with ER_NO_SEGMENTATION_MASK; None if
+                the image had no points
+        """
+        return get_camera_points(self._client_id)
+
+    def set_motion_output(self, enabled: bool = True):
+        """Also render the motion of the pixels of the next camera images since the previous ones.
+
+        The motion of a pixel is its position minus that of the same surface point in the previous
+        image, x to the right and y down, by the previous camera at the previous poses of the
+        bodies; zero where nothing was drawn, for the first image and for panoramic projections.
+        Read it with get_motion() after getCameraImage.
+
+        Keyword Arguments:
+            enabled {bool} -- render motion (default: {True})
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "motion",
+                                          intArgs=[int(enabled)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change motion output'
+
+    def get_motion(self):
+        """Motion of the last camera image (DIRECT connection), see set_motion_output.
+
+        Returns:
+            np.ndarray -- float16 (H,W,2) pixel motion, or None if the image had no motion
+        """
+        return get_camera_motion(self._client_id)
+
+    def set_normal_output(self, enabled: bool = True):
+        """Also render the surface normals of the pixels of the next camera images.
+
+        Normals are unit vectors in the camera frame, looking along -z with y up, facing the
+        camera; zero where nothing was drawn. The EGL renderer draws them from the mesh normals,
+        other renderers and panoramic views estimate them from the depth. Read them with
+        get_normals() after getCameraImage.
+
+        Keyword Arguments:
+            enabled {bool} -- render normals (default: {True})
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "normals",
+                                          intArgs=[int(enabled)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change normal output'
+
+    def get_normals(self):
+        """Normals of the last camera image (DIRECT connection), see set_normal_output.
+
+        Returns:
+            np.ndarray -- float16 (H,W,3) camera frame normals, or None if the image had none
+        """
+        return get_camera_normals(self._client_id)
+
+    def set_depth_pyramid_output(self, levels: int = 3):
+        """Also reduce the depth of the next camera images into a depth pyramid.
+
+        Each level halves the previous one, the first the image, rounding up; each texel holds the
+        nearest and the farthest depth of the pixels under it, infinite where nothing was drawn.
+        The EGL renderer reduces the frame on the GPU, sharing the mip chain of occlusion culling,
+        others on the CPU. Read the levels with get_depth_pyramid() after getCameraImage.
+
+        Keyword Arguments:
+            levels {int} -- levels at 1/2 to 1/2^levels of the image size, 0 for none, at most 16
+                (default: {3})
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "depth_pyramid",
+                                          intArgs=[int(levels)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change depth pyramid output'
+
+    def get_depth_pyramid(self):
+        """Depth pyramid of the last camera image (DIRECT connection), see
+        set_depth_pyramid_output.
+
+        Returns:
+            list -- (H/2^l,W/2^l,2) float32 nearest and farthest depths of the levels l from 1,
+                views of a single packed buffer, or None if the image had no pyramid
+        """
+        return get_camera_depth_pyramid(self._client_id)
+
+    def set_event_output(self, enabled: bool = True, threshold: float = 0.2,
+                         time_step: float = 1. / 240.):
+        """Also find the events of an event camera in the next camera images.
+
+        A pixel fires an event each time its log luminance, log(1 + Y) of the 8-bit luma, moves by
+        the threshold away from that of its previous event, the first image of the camera only
+        setting it; events are timed linearly between the previous image and this one, at the
+        physics steps of their poses. The EGL renderer keeps the previous log luminance on the GPU
+        and reads back the events only, others compare the color images on the CPU. Read them with
+        get_events() after getCameraImage.
+
+        Keyword Arguments:
+            enabled {bool} -- find the events (default: {True})
+            threshold {float} -- change of log luminance per event (default: {0.2})
+            time_step {float} -- seconds per physics step (default: {1/240})
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "events",
+                                          intArgs=[int(enabled)],
+                                          floatArgs=[threshold, time_step],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change event output'
+
+    def get_events(self):
+        """Events of the last camera image since the previous one (DIRECT connection), see
+        set_event_output.
+
+        Returns:
+            np.ndarray -- float32 (N,4) x, y from the top, time in seconds and polarity (1 or -1)
+                of each event, or None if the image had no events requested
+        """
+        return get_camera_events(self._client_id)
+
+    def set_visibility_output(self, enabled: bool = True, boxes: bool = False):
+        """Also count the pixels of each segmentation id seen in the next camera images.
+
+        Ids are those of the segmentation mask. The EGL renderer counts them on the GPU for the
+        shapes in view and reads back the counts only, the mask being read back only if
+        requested, others count the mask on the CPU. Read them with get_pixel_counts() after
+        getCameraImage, e.g. with flags=pb.ER_NO_SEGMENTATION_MASK, and the boxes bounding their
+        pixels with get_boxes(), found in the same pass.
+
+        Keyword Arguments:
+            enabled {bool} -- count the pixels (default: {True})
+            boxes {bool} -- also bound the pixels of each id (default: {False})
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "visibility",
+                                          intArgs=[int(enabled), int(boxes)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change visibility output'
+
+    def get_pixel_counts(self):
+        """Pixels of each segmentation id seen in the last camera image (DIRECT connection), see
+        set_visibility_output.
+
+        Returns:
+            np.ndarray -- int32 (N,2) segmentation id and pixels of each id seen, by increasing
+                id, or None if the image had no pixel counts requested
+        """
+        return get_camera_pixel_counts(self._client_id)
+
+    def get_boxes(self):
+        """Image bounds of the segmentation ids seen in the last camera image (DIRECT connection),
+        see set_visibility_output.
+
+        Returns:
+            np.ndarray -- int32 (N,4) x0, y0, x1, y1 of the first and last columns and rows from
+                the top holding pixels of each id, in the order of get_pixel_counts(), or None if
+                the image had no boxes requested
+        """
+        return get_camera_boxes(self._client_id)
+
+    def set_keypoints(self, body_ids: Sequence[int], link_ids: Sequence[int],
+                      positions: Sequence) -> int:
+        """Project points of links into the next camera images, e.g. for keypoint annotations.
+
+        Points are posed with their links and projected by the camera, through its lens if any,
+        in a single batched pass after each image; those hidden by a nearer surface of the depth
+        image are flagged as such. Read them with get_keypoints() after getCameraImage. They
+        replace the previous ones and are kept until resetSimulation, empty sequences stop.
+
+        Arguments:
+            body_ids {Sequence[int]} -- body unique ids
+            link_ids {Sequence[int]} -- link indices, -1 for the bases
+            positions {Sequence} -- XYZ of each point in the frame of its link, that of its center
+                of mass as given by getLinkState, or getBasePositionAndOrientation for the bases
+
+        Returns:
+            int -- number of keypoints
+        """
+        count = len(body_ids)
+        ints = np.empty((count, 2), dtype=int)
+        ints[:, 0] = body_ids
+        ints[:, 1] = link_ids
+        floats = np.asarray(positions, dtype=float).reshape(count, 3)
+
+        retcode = 0
+        for begin in range(0, max(count, 1), 32):  # plugin arguments hold at most 128 values
+            retcode = pb.executePluginCommand(
+                self._plugin_id,
+                "keypoints",
+                intArgs=[begin] + ints[begin:begin + 32].ravel().tolist(),
+                floatArgs=floats[begin:begin + 32].ravel().tolist(),
+                physicsClientId=self._client_id)
+            assert retcode != -1, 'Cannot set keypoints'
+        return retcode
+
+    def get_keypoints(self):
+        """Keypoints projected into the last camera image (DIRECT connection), see
+        set_keypoints.
+
+        Returns:
+            np.ndarray -- float32 (N,4) x, y in pixels from the top left corner, depth and 1 if
+                visible or 0 if behind the camera, outside the image or occluded, NaN for points
+                of links not in the scene, or None if the image had no keypoints
+        """
+        return get_camera_keypoints(self._client_id)
+
+    def change_materials(self, body_ids: Sequence[int], link_ids: Sequence[int],
+                         shape_ids: Sequence[int] = None, colors: Sequence = None,
+                         texture_ids: Sequence[int] = None) -> int:
+        """Change the colors and textures of many visual shapes, e.g. for domain randomization.
+
+        Equivalent to a changeVisualShape call per shape, but sent in commands of 32 changes and
+        renderers update the materials of the shapes in place instead of rebuilding their nodes.
+
+        Arguments:
+            body_ids {Sequence[int]} -- body unique ids
+            link_ids {Sequence[int]} -- link indices, -1 for the bases
+
+        Keyword Arguments:
+            shape_ids {Sequence[int]} -- shape indices within the links, -1 for all their
+                shapes (default: all shapes)
+            colors {Sequence} -- RGBA colors, a negative alpha keeps the color of a shape
+                (default: colors kept)
+            texture_ids {Sequence[int]} -- texture unique ids, -1 to remove the texture, -2 to
+                keep it (default: textures kept)
+
+        Returns:
+            int -- number of changed shapes
+        """
+        count = len(body_ids)
+        ints = np.empty((count, 4), dtype=int)
+        ints[:, 0] = body_ids
+        ints[:, 1] = link_ids
+        ints[:, 2] = -1 if shape_ids is None else shape_ids
+        ints[:, 3] = -2 if texture_ids is None else texture_ids
+        floats = None if colors is None else np.asarray(colors, dtype=float).reshape(count, 4)
+
+        changed = 0
+        for begin in range(0, count, 32):  # plugin arguments hold at most 128 values
+            retcode = pb.executePluginCommand(
+                self._plugin_id,
+                "materials",
+                intArgs=ints[begin:begin + 32].ravel().tolist(),
+                floatArgs=[] if floats is None else floats[begin:begin + 32].ravel().tolist(),
+                physicsClientId=self._client_id)
+            assert retcode != -1, 'Cannot change materials'
+            changed += retcode
+        return changed
+
+    def set_segmentation_mode(self, mode: SegmentationMode = SegmentationMode.BodyLink):
+        """Choose the values the renderers draw into the segmentation masks.
+
+        BodyLink draws body + ((link + 1) << 24), Instance the instance ids of set_segmentation_ids
+        and Semantic their semantic class ids, 0 for shapes without any. The scene is rebuilt
+        with the next image; the mode is kept across resetSimulation.
+
+        Keyword Arguments:
+            mode {SegmentationMode} -- id scheme (default: {SegmentationMode.BodyLink})
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "segmentation_mode",
+                                          intArgs=[int(mode)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot change segmentation mode'
+
+    def set_segmentation_ids(self, body_ids: Sequence[int], link_ids: Sequence[int],
+                             shape_ids: Sequence[int] = None, instance_ids: Sequence[int] = None,
+                             semantic_ids: Sequence[int] = None) -> int:
+        """Assign the instance and semantic class ids drawn into the masks by set_segmentation_mode.
+
+        Ids of a link apply to its shapes without ids of their own. They are also given to links
+        loaded later under the same body and link, until resetSimulation.
+
+        Arguments:
+            body_ids {Sequence[int]} -- body unique ids
+            link_ids {Sequence[int]} -- link indices, -1 for the bases
+
+        Keyword Arguments:
+            shape_ids {Sequence[int]} -- shape indices within the links, -1 for the links
+                themselves (default: the links)
+            instance_ids {Sequence[int]} -- instance ids, -1 for none (default: none)
+            semantic_ids {Sequence[int]} -- semantic class ids, -1 for none (default: none)
+
+        Returns:
+            int -- number of changed links or shapes already in the scene
+        """
+        count = len(body_ids)
+        ints = np.empty((count, 5), dtype=int)
+        ints[:, 0] = body_ids
+        ints[:, 1] = link_ids
+        ints[:, 2] = -1 if shape_ids is None else shape_ids
+        ints[:, 3] = -1 if instance_ids is None else instance_ids
+        ints[:, 4] = -1 if semantic_ids is None else semantic_ids
+
+        changed = 0
+        for begin in range(0, count, 25):  # plugin arguments hold at most 128 values
+            retcode = pb.executePluginCommand(self._plugin_id,
+                                              "segmentation",
+                                              intArgs=ints[begin:begin + 25].ravel().tolist(),
+                                              physicsClientId=self._client_id)
+            assert retcode != -1, 'Cannot change segmentation ids'
+            changed += retcode
+        return changed
+
+    def set_visibility_layers(self, body_ids: Sequence[int], link_ids: Sequence[int],
+                              layers: Sequence[int], shape_ids: Sequence[int] = None) -> int:
+        """Put links or shapes in visibility layers, drawn only by cameras seeing one of them.
+
+        Layers are bitmasks of 24 layers, all of them by default; cameras see the layers set
+        with configure('layers', bits). Nothing of the scene is rebuilt, renderers skip the
+        shapes of other layers as they cull them, e.g. the arm of a robot in its wrist camera
+        or debug markers in training images. Same as changeVisualShape with flags=layers << 8.
+        Layers of a link are also given to links loaded later under the same body and link,
+        until resetSimulation.
+
+        Arguments:
+            body_ids {Sequence[int]} -- body unique ids
+            link_ids {Sequence[int]} -- link indices, -1 for the bases
+            layers {Sequence[int]} -- bitmasks of layers, 0xffffff for all
+
+        Keyword Arguments:
+            shape_ids {Sequence[int]} -- shape indices within the links, -1 for the links
+                themselves (default: the links)
+
+        Returns:
+            int -- number of changed links or shapes already in the scene
+        """
+        count = len(body_ids)
+        ints = np.empty((count, 4), dtype=int)
+        ints[:, 0] = body_ids
+        ints[:, 1] = link_ids
+        ints[:, 2] = -1 if shape_ids is None else shape_ids
+        ints[:, 3] = layers
+
+        changed = 0
+        for begin in range(0, count, 32):  # plugin arguments hold at most 128 values
+            retcode = pb.executePluginCommand(self._plugin_id,
+                                              "visibility",
+                                              intArgs=ints[begin:begin + 32].ravel().tolist(),
+                                              physicsClientId=self._client_id)
+            assert retcode != -1, 'Cannot change visibility layers'
+            changed += retcode
+        return changed
+
+    def register_texture(self, pixels: np.ndarray) -> int:
+        """Register a texture wrapping an array without copying it.
+
+        Unlike loadTexture, renderers read the pixels from the array itself: write into it,
+        then call update_texture so that they upload the new pixels, e.g. for procedural or
+        video textures. The array is neither copied nor converted, hence must have the
+        expected type and layout.
+
+        Arguments:
+            pixels {np.ndarray} -- C-contiguous uint8 array of shape (H, W, C), C from 1 to 4
+
+        Returns:
+            int -- texture unique id, usable with changeVisualShape, change_materials and
+                Randomization.textures
+        """
+        return register_texture(pixels, self._client_id)
+
+    def update_texture(self, texture_id: int) -> int:
+        """Upload the pixels of a texture of register_texture rewritten in place.
+
+        Arguments:
+            texture_id {int} -- texture unique id
+
+        Returns:
+            int -- number of links whose shapes use the texture
+        """
+        count = change_texels(texture_id, self._client_id)
+        assert count != -1, 'Unknown texture'
+        return count
+
+    def make_base_layer(self, body_ids: Sequence[int]) -> SceneLayer:
+        """Freeze the links of static bodies at their current poses into a shareable layer.
+
+        Vectorized environments loading the same scenery give the layer of one of them to
+        set_base_layer of the others, whose renderers then keep its meshes once.
+
+        Arguments:
+            body_ids {Sequence[int]} -- unique ids of the bodies of the layer
+
+        Returns:
+            SceneLayer -- immutable nodes of the bodies
+        """
+        return make_base_layer(set(body_ids), self._client_id)
+
+    def set_base_layer(self, layer: SceneLayer = None, body_ids: Sequence[int] = None):
+        """Draw a shared layer under the scene in place of the links of some bodies.
+
+        The bodies are the copies of the layer bodies loaded by this client, the bodies of the
+        layer itself by default, as for the client that made it. Their links are left out of the
+        scene only for renderers drawing layers, the EGL renderer, which merge the layer once per
+        context and share it between clients; other renderers keep drawing the links. Changes
+        to those links are ignored while the layer is drawn.
+
+        Keyword Arguments:
+            layer {SceneLayer} -- layer of make_base_layer, None to stop (default: None)
+            body_ids {Sequence[int]} -- bodies the layer replaces (default: None)
+        """
+        set_base_layer(layer, set(body_ids or ()), self._client_id)
+
+    def set_randomization(self, randomization: Randomization = None, log_path: str = None):
+        """Draw camera images with randomized materials and light, the scene is left as is.
+
+        Samples are drawn natively from seeded random streams, per episode or per frame, and
+        drawn by the EGL renderer; other renderers find them in SceneView.material_overrides.
+
+        Keyword Arguments:
+            randomization {Randomization} -- distributions, None to stop (default: None)
+            log_path {str} -- file the samples are appended to as lines of json (default: None)
+        """
+        set_randomization(randomization, log_path or '', self._client_id)
+
+    def next_episode(self) -> int:
+        """Draw a new sample of a per-episode randomization with the next camera image.
+
+        Returns:
+            int -- index of the episode
+        """
+        return next_randomization_episode(self._client_id)
+
+    def set_frame_sink(self, name: str, width: int = 0, height: int = 0, num_slots: int = 4):
+        """Publish rendered frames into a shared-memory ring read by other processes.
+
+        Frames of another size than width x height are not published, nor are cached frames.
+        Other processes open the ring with FrameRing(name) and map its frames as NumPy arrays.
+
+        Arguments:
+            name {str} -- shared memory name, None or an empty name to stop publishing
+
+        Keyword Arguments:
+            width {int} -- frame width (default: 0)
+            height {int} -- frame height (default: 0)
+            num_slots {int} -- number of frames kept (default: 4)
+        """
+        set_frame_sink(self._client_id, name or '', width, height, num_slots)
+
+    def start_video(self, output: str, width: int, height: int, fps: int = 30,
+                    encoder: str = 'libx264', segment_seconds: int = 0, camera: int = -1):
+        """Encode the color frames of a camera into a video, with an ffmpeg process.
+
+        Frames of another size than width x height are not encoded. Frames are queued for the
+        encoder, those rendered while it lags behind are dropped. The ffmpeg executable is
+        taken from the PYBULLET_RENDERING_FFMPEG environment variable, "ffmpeg" by default.
+
+        Arguments:
+            output {str} -- video file, MP4 segment pattern such as 'run_%03d.mp4', or
+                'rtp://host:port' url
+            width {int} -- frame width
+            height {int} -- frame height
+
+        Keyword Arguments:
+            fps {int} -- frame rate (default: 30)
+            encoder {str} -- ffmpeg encoder, e.g. 'h264_nvenc', 'hevc_vaapi' (default: libx264)
+            segment_seconds {int} -- split the output into MP4 segments, 0 for one file
+                (default: 0)
+            camera {int} -- index of a camera of render_cameras, -1 for getCameraImage
+                requests (default: -1)
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "video {} {}".format(encoder, output),
+                                          intArgs=[camera, width, height, fps, segment_seconds],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot start video encoding'
+
+    def stop_video(self, camera: int = -1):
+        """Stop encoding a camera, waiting for the encoder to finalize the video.
+
+        Keyword Arguments:
+            camera {int} -- camera passed to start_video (default: -1)
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "video",
+                                          intArgs=[camera],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot stop video encoding'
+
+    def start_recording(self, directory: str, chunk_frames: int = 64, compress: bool = True,
+                        queue_size: int = 16):
+        """Write rendered frames, camera matrices and node poses into a zarr v2 dataset.
+
+        Frames of getCameraImage requests and of render_cameras are written by a background
+        thread, those rendered while it lags behind or of another size than the first frame
+        are dropped. The dataset holds the arrays color (N,H,W,4), depth (N,H,W), mask (N,H,W),
+        view_matrix (N,16), projection_matrix (N,16), pose_begin (N,), and node_id (P,) and
+        pose (P,16) for the node poses of all frames, those of frame i starting at
+        pose_begin[i]. Open it with zarr.open(directory).
+
+        Arguments:
+            directory {str} -- dataset directory, created if missing
+
+        Keyword Arguments:
+            chunk_frames {int} -- frames per chunk (default: 64)
+            compress {bool} -- LZ4 chunks, otherwise raw chunks which can be memory mapped
+                (default: True)
+            queue_size {int} -- frames waiting for the writer before drops (default: 16)
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "record {}".format(directory),
+                                          intArgs=[chunk_frames, int(compress), queue_size],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot start recording'
+
+    def stop_recording(self):
+        """Stop recording, waiting for the dataset to be written."""
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "record",
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot stop recording'
+
+    @property
+    def frame_cache_stats(self):
+        """Frame cache statistics since it was enabled (DIRECT connection).
+
+        Returns:
+            tuple -- number of hits and misses
+        """
+        return get_frame_cache_stats(self._client_id)
+
+    def stage_stats(self, reset: bool = False) -> dict:
+        """Durations of the steps of the camera images, to find where a slow one spends time.
+
+        Stages are 'scene_sync' (scene changes passed to the renderer), 'state_sync' (poses
+        applied by native renderers, within their render stage), 'python' (calls into python
+        renderers), 'render', 'readback' (EGL images read from the GPU, waiting for the drawing)
+        and 'copy' (images copied into pybullet buffers). The EGL renderer also times its GPU
+        passes with timer queries, read two frames later: 'gpu_shadow', 'gpu_prepass'
+        (occluders, with occlusion culling), 'gpu_main', 'gpu_resolve' (multisample resolve,
+        resampling, panorama faces) and 'gpu_readback'; a GPU pass time close to its CPU stage
+        means the renderer is GPU bound, a far longer CPU stage that it waits on the GPU. Clients
+        of a RenderScheduler also record 'queue', the wait of their requests for a worker. Each
+        is summarized over its last 512 samples in milliseconds: mean, p50, p90, p99, max, and a
+        histogram whose bucket k counts the durations of [2^k, 2^(k+1)) microseconds. Also
+        available without the bindings with executePluginCommand(plugin_id, "stats",
+        intArgs=[stage index, percentile]), which returns microseconds.
+
+        Keyword Arguments:
+            reset {bool} -- forget the durations once read (default: False)
+
+        Returns:
+            dict -- stage name -> dict of count, window, mean, p50, p90, p99, max, histogram
+        """
+        stats = get_stage_stats(self._client_id)
+        if reset:
+            reset_stage_stats(self._client_id)
+        return stats
+
+    def memory_report(self) -> dict:
+        """Memory held for this client, to find which assets fill the memory (DIRECT connection).
+
+        Assets are meshes, textures and heightfields of the scene graph, each counted once however
+        many shapes and clients share it; 'shared_bytes' is what sharing saves. Each node entry
+        has the bytes of its assets and 'owned_bytes', those of its assets no other node uses.
+        The renderer entry has its GPU memory, with its high-water mark, and its host copies,
+        e.g. the bitmaps of texture files. 'peak_bytes' is the highest total, sampled after each
+        rendered camera image. See pybullet_rendering.get_process_memory_report() for all
+        clients at once.
+
+        Returns:
+            dict -- assets, nodes, renderer, frame_bytes, total_bytes and peak_bytes
+        """
+        return get_memory_report(self._client_id)
+
+    def prefetch_assets(self, filenames: Sequence[str], upload: bool = True,
+                        num_threads: int = 0) -> AssetPrefetch:
+        """Load the mesh and texture files of the next episode in the background.
+
+        Files are parsed and decoded into the process asset cache on threads of their own, then
+        uploaded to the GPU of a native renderer if upload, so that the first camera image of a
+        scene loading them pays no loading cost. Call prefetch.wait() before, or let the frame
+        wait for the assets still loading, and prefetch.times() for the seconds each file took.
+
+        Arguments:
+            filenames {Sequence[str]} -- Wavefront OBJ and STL meshes, image files otherwise
+
+        Keyword Arguments:
+            upload {bool} -- upload to the current renderer too (default: {True})
+            num_threads {int} -- loading threads, 0 for one per core up to 8 (default: {0})
+
+        Returns:
+            AssetPrefetch -- keeps the assets cached until deleted
+        """
+        renderer = self._renderer if upload else None
+        return AssetPrefetch(list(filenames), renderer, num_threads)
+
+    def configure(self, key: str, value: int):
+        """Change a runtime setting while the simulation runs, over any connection.
+
+        Settings are 'async', 'frame_cache', 'step_sync' and 'trace' (0 or 1, the trace written
+        to PYBULLET_RENDERING_TRACE when stopped), 'channels' (bits of OutputChannel.Points,
+        Motion, Normals, DepthPyramid, Events and Visibility, the other extra outputs are
+        dropped, and Mask for mask-only images drawing neither color nor depth), 'quality' (0
+        for Quality.fast(), 1 for the renderer defaults), 'asset_cache' (prune the asset cache
+        of the process if it holds more entries), 'numa_node' (NUMA node of the async render
+        thread once pinned by set_thread_affinity(), -1 for that of the GPU) and 'layers'
+        (bits of the visibility layers the cameras see, see set_visibility_layers()). Same as
+        executePluginCommand(plugin_id, "config <key>", intArgs=[value]).
+
+        Arguments:
+            key {str} -- setting name
+            value {int} -- new value
+        """
+        retcode = pb.executePluginCommand(self._plugin_id,
+                                          "config {}".format(key),
+                                          intArgs=[int(value)],
+                                          physicsClientId=self._client_id)
+        assert retcode != -1, 'Cannot configure {}'.format(key)
+
+    def config(self, key: str) -> int:
+        """Current value of a runtime setting, see configure(), over any connection.
+
+        Also 'memory' and 'memory_peak', the total and highest memory of the client in KiB, see
+        memory_report(), and 'staged_nodes', the nodes waiting for their assets, see
+        set_staged_loading(). 'quality' reads 2 for tiers set otherwise than by configure().
+
+        Arguments:
+            key {str} -- setting name, see configure()
+
+        Returns:
+            int -- value of the setting
+        """
+        value = pb.executePluginCommand(self._plugin_id,
+                                        "config {}".format(key),
+                                        physicsClientId=self._client_id)
+        assert value != -1, 'Unknown setting {}'.format(key)
+        return value
+
+    def render_cameras(self, width: int, height: int, view_matrices: Sequence,
+                       projection_matrices: Sequence, **kwargs):
+        """Render several cameras in a single getCameraImage round-trip (DIRECT connection).
+
+        The scene is synchronized once and all views are rendered back to back.
+
+        Arguments:
+            width {int} -- image width
+            height {int} -- image height
+            view_matrices {list} -- one view matrix (16 floats) per camera
+            projection_matrices {list} -- one projection matrix (16 floats) per camera
+
+        Keyword Arguments:
+            kwargs -- other pybullet.getCameraImage arguments (light, flags, etc.)
+
+        Returns:
+            tuple -- stacked color (N,H,W,4), depth (N,H,W) and mask (N,H,W) images
+        """
+        num_views = len(view_matrices)
+        color = np.zeros((num_views, height, width, 4), np.uint8)
+        depth = np.zeros((num_views, height, width), np.float32)
+        mask = np.zeros((num_views, height, width), np.int32)
+        if num_views == 0:
+            return color, depth, mask
+
+        set_camera_batch(self._client_id, view_matrices, projection_matrices, color, depth, mask)
+        try:
+            pb.getCameraImage(width, height,
+                              viewMatrix=view_matrices[0],
+                              projectionMatrix=projection_matrices[0],
+                              physicsClientId=self._client_id,
+                              **kwargs)
+        finally:
+            # a failed request leaves the batch armed, the next one would write into it
+            clear_camera_batch(self._client_id)
+        return color, depth, mask
+
+    def render_camera(self, width: int, height: int, view_matrix: Sequence[float],
+                      projection_matrix: Sequence[float], out: tuple = None):
+        """Render a camera straight into arrays, without a getCameraImage call (DIRECT connection).
+
+        The scene is synchronized and drawn as for a getCameraImage request with these matrices
+        and no light nor flag arguments, with the GIL released, but the request skips the physics
+        server, the frame cache and the conversion of the images into python lists.
+
+        Arguments:
+            width {int} -- image width
+            height {int} -- image height
+            view_matrix {list} -- view matrix (16 floats)
+            projection_matrix {list} -- projection matrix (16 floats)
+
+        Keyword Arguments:
+            out {tuple} -- color (H,W,4) uint8, depth (H,W) float32 and mask (H,W) int32 arrays
+                to write into, None depth or mask to skip them (default: new arrays)
+
+        Returns:
+            tuple -- color, depth and mask images, None if the plugin has no renderer
+
+        Raises:
+            RuntimeError -- in async mode, whose images are those of the previous request
+        """
+        if out is None:
+            out = (np.zeros((height, width, 4), np.uint8), np.zeros((height, width), np.float32),
+                   np.zeros((height, width), np.int32))
+        color, depth, mask = out
+        assert color.shape == (height, width, 4), 'Color buffer shape must be (H, W, 4)'
+        rendered = render_camera(self._client_id, view_matrix, projection_matrix, color,
+                                 np.empty(0, np.float32) if depth is None else depth,
+                                 np.empty(0, np.int32) if mask is None else mask)
+        if not rendered and self.config('async'):
+            raise RuntimeError('render_camera needs a synchronous renderer, async mode is on')
+        return (color, depth, mask) if rendered else None
+
     def unload(self):
         """Unload plugin."""
         if self._plugin_id != -1:
             pb.unloadPlugin(self._plugin_id, physicsClientId=self._client_id)
             self._plugin_id = -1
             self._renderer = None
+
+
+def _visual_links(client_id: int) -> list:
+    """Links of all bodies of a physics client, with their visual shapes.
+
+    Visual frames are moved from the link frame to the inertial frame, whose world pose bullet
+    syncs.
+
+    Arguments:
+        client_id {int} -- physics client
+
+    Returns:
+        list -- (body, link, inertial frame, fixed base, shapes) tuples, see import_links
+    """
+    links = []
+    for i in range(pb.getNumBodies(physicsClientId=client_id)):
+        body = pb.getBodyUniqueId(i, physicsClientId=client_id)
+        shapes = {}
+        for data in pb.getVisualShapeData(body, physicsClientId=client_id):
+            shapes.setdefault(data[1], []).append(data)
+        for link in range(-1, pb.getNumJoints(body, physicsClientId=client_id)):
+            if link == -1:
+                frame = pb.getBasePositionAndOrientation(body, physicsClientId=client_id)
+            else:
+                frame = pb.getLinkState(body, link, physicsClientId=client_id)[:2]
+            dynamics = pb.getDynamicsInfo(body, link, physicsClientId=client_id)
+            inertial = pb.invertTransform(*dynamics[3:5])
+            link_shapes = []
+            for data in shapes.get(link, []):
+                geometry, dimensions, filename, position, orientation, rgba = data[2:8]
+                position, orientation = pb.multiplyTransforms(*inertial, position, orientation)
+                if isinstance(filename, bytes):
+                    filename = filename.decode()
+                link_shapes.append((geometry, tuple(dimensions), filename,
+                                    (*position, *orientation), tuple(rgba)))
+            links.append((body, link, (*frame[0], *frame[1]), link == -1 and dynamics[0] == 0,
+                          link_shapes))
+    return links
+
+
+def get_encoded_camera_image(plugin_id: int, width: int, height: int, physicsClientId: int = 0,
+                             num_pixels: int = None, **kwargs):
+    """Camera image of the rendering plugin of a physics server, transferred compressed.
+
+    Suits clients connected over TCP, UDP or gRPC: the plugin compresses the frame once
+    rendered, the bytes travel packed into the pixels of getCameraImage requests of height 1,
+    and are decoded here. The first request typically carries the whole frame, otherwise a
+    second one fetches it.
+
+    Arguments:
+        plugin_id {int} -- plugin id on the server, e.g. from pybullet.loadPlugin
+        width {int} -- image width
+        height {int} -- image height
+
+    Keyword Arguments:
+        physicsClientId {int} -- physics client (default: 0)
+        num_pixels {int} -- pixels of the first request, width * height / 16 by default
+        kwargs -- other pybullet.getCameraImage arguments (viewMatrix, flags, etc.)
+
+    Returns:
+        tuple -- width, height, color (H,W,4), depth (H,W) and mask (H,W) images, None for
+            images not rendered
+    """
+    retcode = pb.executePluginCommand(plugin_id,
+                                      "encode",
+                                      intArgs=[width, height],
+                                      physicsClientId=physicsClientId)
+    assert retcode != -1, 'Cannot request an encoded frame'
+
+    # bytes fill the colors of the requested pixels, then their masks
+    with_mask = not kwargs.get('flags', 0) & pb.ER_NO_SEGMENTATION_MASK
+    bytes_per_pixel = 8 if with_mask else 4
+    num_pixels = max(num_pixels or width * height // 16, 1)
+    while True:
+        _, _, color, _, mask = pb.getCameraImage(num_pixels, 1,
+                                                 physicsClientId=physicsClientId,
+                                                 **kwargs)
+        data = np.asarray(color, np.uint8).tobytes()
+        if with_mask:
+            data += np.asarray(mask, np.int32).tobytes()
+        size = int(np.frombuffer(data, np.uint32, 1)[0]) + 4
+        if size <= len(data):
+            break
+        num_pixels = -(-size // bytes_per_pixel)
+
+    if size == 4:
+        return 0, 0, None, None, None
+    color, depth, mask = decode_frame(memoryview(data)[4:size])
+    return width, height, color, depth, mask
+
+
+# buffers of render_batch kept across calls, by dtype and shape
+_batch_buffers = {}
+
+
+def _batch_buffer(shape: tuple, dtype) -> np.ndarray:
+    key = (np.dtype(dtype).str, shape)
+    if key not in _batch_buffers:
+        _batch_buffers[key] = np.zeros(shape, dtype)
+    return _batch_buffers[key]
+
+
+def render_batch(client_ids: Sequence[int], view_matrices: Sequence,
+                 projection_matrices: Sequence, size: Sequence[int], channels: int = None,
+                 out: tuple = None, copy: bool = True, **kwargs):
+    """Render cameras of several physics clients into stacked images (DIRECT connections).
+
+    Cameras of a client are set as a batch, see RenderingPlugin.render_cameras, and rendered by
+    a single getCameraImage request of one pixel, which syncs the poses: one round-trip per
+    client instead of one per camera. Images are written in place, without the GIL while the
+    buffers are handed over, into out or into buffers pooled across calls, those of the cameras
+    of a client being passed as is when they are consecutive.
+
+    Arguments:
+        client_ids {list} -- physics client of each camera, with a rendering plugin loaded
+        view_matrices {list} -- one view matrix (16 floats) per camera
+        projection_matrices {list} -- one projection matrix (16 floats) per camera
+        size {tuple} -- image width and height
+
+    Keyword Arguments:
+        channels {int} -- OutputChannel bitmask of the Color, Depth and Mask images returned
+            (default: {None}, all three)
+        out {tuple} -- color (B,H,W,4) uint8, depth (B,H,W) float32 and mask (B,H,W) int32
+            arrays to write into, None for those to pool (default: {None})
+        copy {bool} -- return copies of the pooled buffers, otherwise the buffers themselves,
+            overwritten by the next call of the same sizes (default: {True})
+        kwargs -- other pybullet.getCameraImage arguments (light, flags, etc.)
+
+    Returns:
+        tuple -- color (B,H,W,4), depth (B,H,W) and mask (B,H,W) images, None for channels not
+            requested
+    """
+    width, height = size
+    client_ids = np.asarray(client_ids, int)
+    count = len(client_ids)
+    assert len(view_matrices) == count and len(projection_matrices) == count, \
+        'One view and projection matrix per camera'
+    if channels is None:
+        channels = int(OutputChannel.Color) | int(OutputChannel.Depth) | int(OutputChannel.Mask)
+    wanted = [bool(channels & int(channel))
+              for channel in (OutputChannel.Color, OutputChannel.Depth, OutputChannel.Mask)]
+    planes = [((count, height, width, 4), np.uint8), ((count, height, width), np.float32),
+              ((count, height, width), np.int32)]
+
+    # color is always rendered, into a pooled buffer if not requested
+    images, pooled = [], []
+    for k, (shape, dtype) in enumerate(planes):
+        image = out[k] if out is not None and wanted[k] else None
+        pooled.append(image is None)
+        if image is None and (wanted[k] or k == 0):
+            image = _batch_buffer(shape, dtype)
+        if image is not None and (image.shape != shape or image.dtype != dtype or
+                                  not image.flags.c_contiguous):
+            raise ValueError('Buffer must be a contiguous {} array of shape {}'.format(
+                np.dtype(dtype).name, shape))
+        images.append(image)
+
+    for client_id in np.unique(client_ids):
+        indices = np.flatnonzero(client_ids == client_id)
+        first, last = indices[0], indices[-1] + 1
+        consecutive = last - first == len(indices)
+        # cameras spread over the batch are rendered into pooled buffers, then scattered;
+        # empty buffers skip their channel
+        buffers = []
+        for image, (shape, dtype) in zip(images, planes):
+            if image is None:
+                buffers.append(np.zeros((0,) * len(shape[1:]), dtype))
+            elif consecutive:
+                buffers.append(image[first:last])
+            else:
+                buffers.append(_batch_buffer((len(indices),) + shape[1:], dtype))
+        set_camera_batch(int(client_id), [view_matrices[i] for i in indices],
+                         [projection_matrices[i] for i in indices], *buffers)
+        try:
+            pb.getCameraImage(1, 1,
+                              viewMatrix=view_matrices[indices[0]],
+                              projectionMatrix=projection_matrices[indices[0]],
+                              physicsClientId=int(client_id),
+                              **kwargs)
+        finally:
+            clear_camera_batch(int(client_id))
+        if not consecutive:
+            for image, buffer in zip(images, buffers):
+                if image is not None:
+                    image[indices] = buffer
+
+    return tuple(None if not wanted[k] else image.copy() if copy and pooled[k] else image
+                 for k, image in enumerate(images))
+
+
+class BulkCameraTransfer:
+    """Camera images of the rendering plugin of a physics server, through shared memory.
+
+    Suits clients on the same host as the server, e.g. over a SHARED_MEMORY connection: the
+    plugin publishes each requested frame into a shared-memory ring negotiated once, and the
+    getCameraImage round-trip only carries the frame sequence number, whatever the image size.
+    Requests of this client are rendered at the ring size until close().
+    """
+
+    def __init__(self, plugin_id: int, width: int, height: int, num_slots: int = 2,
+                 physicsClientId: int = 0):
+        """Open the ring on the server.
+
+        Arguments:
+            plugin_id {int} -- plugin id on the server, e.g. from pybullet.loadPlugin
+            width {int} -- image width
+            height {int} -- image height
+
+        Keyword Arguments:
+            num_slots {int} -- number of frames kept, frames returned without copy stay
+                valid until as many newer frames are requested (default: 2)
+            physicsClientId {int} -- physics client (default: 0)
+        """
+        self._plugin_id = plugin_id
+        self._client_id = physicsClientId
+        key = int.from_bytes(os.urandom(4), 'little') >> 1
+        retcode = pb.executePluginCommand(plugin_id,
+                                          "bulk",
+                                          intArgs=[key, width, height, num_slots],
+                                          physicsClientId=physicsClientId)
+        assert retcode != -1, 'Cannot open a bulk transfer'
+        self._ring = FrameRing('pybullet_rendering_bulk_{}'.format(key))
+
+    @property
+    def ring(self) -> FrameRing:
+        """Shared-memory ring of the frames."""
+        return self._ring
+
+    def get_camera_image(self, copy: bool = True, **kwargs):
+        """Render a camera image on the server.
+
+        Keyword Arguments:
+            copy {bool} -- copy the images out of the ring (default: True)
+            kwargs -- other pybullet.getCameraImage arguments (viewMatrix, flags, etc.)
+
+        Returns:
+            tuple -- width, height, color (H,W,4), depth (H,W) and mask (H,W) images, None for
+                images not rendered
+        """
+        _, _, color, _, mask = pb.getCameraImage(1, 1, physicsClientId=self._client_id, **kwargs)
+        sequence = int(np.asarray(color, np.uint8).reshape(-1)[:4].view(np.uint32)[0])
+        if not kwargs.get('flags', 0) & pb.ER_NO_SEGMENTATION_MASK:
+            sequence |= int(np.asarray(mask, np.int64).reshape(-1)[0] & 0xffffffff) << 32
+        else:
+            # a frame of the ring has the high bits of the latest one, unless lapped
+            sequence |= self._ring.latest & ~0xffffffff
+        if sequence == 0:
+            return 0, 0, None, None, None
+
+        _, color, depth, mask = self._ring.frame(sequence)
+        if copy:
+            color, depth, mask = (None if image is None else image.copy()
+                                  for image in (color, depth, mask))
+            if not self._ring.valid(sequence):
+                raise KeyError('Frame {} was overwritten while copied'.format(sequence))
+        return self._ring.width, self._ring.height, color, depth, mask
+
+    def close(self):
+        """Stop the transfer, requests return regular camera images again."""
+        if self._ring is not None:
+            pb.executePluginCommand(self._plugin_id, "bulk", physicsClientId=self._client_id)
+            self._ring = None
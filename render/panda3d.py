@@ -1,3 +1,4 @@
+import collections
 import os
 
 import numpy as np
@@ -5,10 +6,14 @@ import panda3d.core as p3d
 
 import pybullet_rendering as pr
 
-from .utils import decompose, depth_from_zbuffer, primitive_mesh
+from .utils import (asset_keyed_cache, depth_from_zbuffer, evict_pruned_assets, instance_groups,
+                    lent_planes)
 
 __all__ = ('P3dRenderer')
 
+_mesh_cache = asset_keyed_cache()
+_primitive_cache = {}
+
 
 class P3dRenderer(pr.BaseRenderer):
     """Panda3D-based renderer.
@@ -20,7 +25,12 @@ class P3dRenderer(pr.BaseRenderer):
                  callback_fn=None,
                  multisamples=0,
                  srgb_color=False,
-                 show_window=False):
+                 show_window=False,
+                 instancing=False,
+                 pipelined=False,
+                 warm_up=True,
+                 shared_transforms=False,
+                 callback_views=False):
         """Construct a Renderer.
 
         Keyword Arguments:
@@ -28,11 +38,19 @@ class P3dRenderer(pr.BaseRenderer):
             multisamples {bool} -- antialiasing multisamples: 0 (disabled), 2, 4, etc. (default: {0})
             srgb_color {bool} -- enable sRGB recoloring (default: False)
             show_window {bool} -- open a window (mostly for debug purposes) (default: False)
+            instancing {bool} -- draw nodes sharing a mesh and a material in one call (default: False)
+            pipelined {bool} -- return the previous frame while drawing the current one, like the plugin async mode, see RenderingPlugin.set_async (default: False)
+            warm_up {bool} -- generate and compile the shaders of all materials now (default: True)
+            shared_transforms {bool} -- pose links from a table of all matrices, see Scene (default: False)
+            callback_views {bool} -- pass callback_fn read-only views of the images read back into bullet's buffers, see lent_planes (default: False)
         """
         pr.BaseRenderer.__init__(self)
         self._callback_fn = callback_fn
-        self._scene = Scene()
-        self._renderer = Renderer(multisamples, srgb_color, show_window)
+        self._callback_views = callback_views
+        self._scene = Scene(instancing, shared_transforms)
+        self._renderer = Renderer(multisamples, srgb_color, show_window, pipelined)
+        if warm_up:
+            self._renderer.warm_up(self._scene)
 
     @property
     def scene(self):
@@ -52,6 +70,15 @@ class P3dRenderer(pr.BaseRenderer):
         """
         self._scene.update_graph(scene_graph, materials_only)
 
+    def apply_scene_delta(self, scene_graph, delta):
+        """Apply changes made to a scene graph since the previous update.
+
+        Arguments:
+            scene_graph {SceneGraph} -- scene description
+            delta {SceneGraphDelta} -- added, removed and changed nodes
+        """
+        self._scene.apply_delta(scene_graph, delta)
+
     def render_frame(self, scene_state, scene_view, frame):
         """Render a scene at scene_state with a scene_view settings
 
@@ -61,142 +88,360 @@ class P3dRenderer(pr.BaseRenderer):
             frame {FrameData} -- output image buffer
         """
         self._scene.update_state(scene_state)
-        self._scene.update_view(scene_view)
+        return self._render_view(scene_view, frame)
+
+    def render_frames(self, scene_state, scene_views, frames):
+        """Render a scene at scene_state from several views.
 
-        color, depth, mask = self._renderer.render_frame(
-            self._scene, *scene_view.viewport)
+        The scene state is applied once for all views.
+
+        Arguments:
+            scene_state {SceneState} -- scene state, e.g. transformations of all objects
+            scene_views {list} -- view settings, one per frame
+            frames {list} -- output image buffers
+        """
+        self._scene.update_state(scene_state)
+        rendered = [self._render_view(view, frame) for view, frame in zip(scene_views, frames)]
+        return all(rendered)
+
+    def _render_view(self, scene_view, frame):
+        """Render the current scene with a scene_view settings.
+
+        Arguments:
+            scene_view {SceneView} -- view settings, e.g. camera, light, viewport parameters
+            frame {FrameData} -- output image buffer
+        """
+        self._scene.update_view(scene_view)
 
+        # skip readbacks for channels nobody asked for, regions of interest are cropped from
+        # images of the whole viewport
+        lent = self._callback_fn is not None and self._callback_views
+        planes = frame.planes if self._callback_fn is None or lent else (None, None, None)
+        roi = scene_view.roi if scene_view.has_roi else None
+        multisamples = scene_view.quality.multisamples
+        images = self._renderer.render_frame(
+            self._scene, *scene_view.viewport,
+            color=scene_view.has_output_channel(pr.OutputChannel.Color),
+            depth=scene_view.has_output_channel(pr.OutputChannel.Depth),
+            out=planes[:2] if roi is None else None,
+            multisamples=multisamples if multisamples >= 0 else None)
+        if images is None:
+            # the first pipelined frame is still being drawn
+            return False
+        if roi is not None:
+            x, y, width, height = roi
+            images = tuple(None if image is None else image[y:y + height, x:x + width]
+                           for image in images)
+            for image, plane in zip(images, planes[:2]):
+                if image is not None and plane is not None:
+                    np.copyto(plane, image)
+
+        if lent:
+            # images were read back into the frame planes once, the callback sees them there
+            with lent_planes(frame) as views:
+                # as with images, no mask is drawn
+                self._callback_fn(*views[:2], None)
+            return True
         if self._callback_fn is not None:
             # pass result to a callback function
-            self._callback_fn(color, depth, mask)
+            self._callback_fn(*images)
             return False
 
-        # pass result to bullet
-        if color is not None:
-            frame.color_img[:] = color
-        if depth is not None:
-            frame.depth_img[:] = depth
-        if mask is not None:
-            frame.mask_img[:] = mask
+        # images were read back into the frame planes
         return True
 
 
 class Renderer:
     """Internal renderer implementation."""
 
-    def __init__(self, multisamples=0, srgb_color=False, show_window=False):
+    def __init__(self, multisamples=0, srgb_color=False, show_window=False, pipelined=False):
         """Construct a Renderer.
 
         Keyword Arguments:
             multisamples {bool} -- antialiasing multisamples: 0 (disabled), 2, 4, etc. (default: {0})
             srgb_color {bool} -- enable sRGB recoloring (default: False)
             show_window {bool} -- open a window (default: False)
+            pipelined {bool} -- draw on a separate thread, reading back the previous frame of
+                                each buffer (default: False)
         """
         self._multisamples = multisamples
         self._srgb_color = srgb_color
         self._show_window = show_window
+        self._pipelined = pipelined
 
         p3d.ConfigVariableBool('allow-incomplete-render').set_value(False)
 
         self._engine = p3d.GraphicsEngine.get_global_ptr()
+        if pipelined:
+            # applies to buffers made from now on, the draw stage of frame N then runs while
+            # the images of frame N-1 are read back
+            self._engine.set_threading_model(p3d.GraphicsThreadingModel('Cull/Draw'))
         self._pipe = p3d.GraphicsPipeSelection.get_global_ptr().make_default_pipe()
-        self._buffer_size = None
-        self._buffer = None
-        self._region = None
-        self._depth_tex = None
-        self._color_tex = None
-
-    def render_frame(self, scene, width, height):
+        # buffers share the state guardian of the first one, with its compiled shaders
+        self._gsg = None
+        # offscreen buffers by size, multisamples and channels read back, least recently used
+        # first, only the one drawing the current frame is active
+        self._targets = collections.OrderedDict()
+        self._active = None
+
+    def render_frame(self, scene, width, height, color=True, depth=True, out=None,
+                     multisamples=None):
         """Render one frame.
 
+        Cameras of different sizes, multisamples or channels draw into buffers of their own,
+        kept from frame to frame, so that alternating cameras do not make buffers again; each
+        camera of the scene draws through a display region of its own in each buffer.
+
         Arguments:
             scene {Scene} -- scene to render
             width {int} -- target frame size
             height {int} -- target frame size
-        """
-        if self._buffer is None:
-            self._make_buffer(width, height)
-        elif self._buffer.get_size() != (width, height):
-            self._remove_buffer()
-            self._make_buffer(width, height)
 
-        if self._region.camera != scene.camera:
-            self._region.camera = scene.camera
-            # TODO: shadows don't appear without this dummy rendering
-            self._engine.render_frame()
+        Keyword Arguments:
+            color {bool} -- read back the color image (default: {True})
+            depth {bool} -- read back the depth image (default: {True})
+            out {tuple} -- color and depth arrays to read back into, e.g. FrameData planes,
+                           None items are allocated (default: {None})
+            multisamples {int} -- antialiasing multisamples, those of the renderer if None
+                                  (default: {None})
 
-        self._buffer.set_clear_color(scene.bg_color)
+        Returns:
+            tuple -- color, depth and mask images, None if no pipelined frame is complete yet
+        """
+        target = self._target(width, height, color, depth, multisamples)
+        target.use_camera(scene.camera, self._engine)
+        lens = scene.camera.node().get_lens()
+        lens_range = (lens.near, lens.far)
+
+        target.buffer.set_clear_color(scene.bg_color)
         self._engine.render_frame()
+        target.frames_drawn += 1
+        if self._pipelined:
+            # the images read back are those of the previous frame, drawn through its own lens
+            lens_range, target.lens_range = target.lens_range, lens_range
+            if target.frames_drawn < 2:
+                return None
+
+        # the buffer is rendered upside down, so that images come top row first, and the RAM
+        # images are viewed in place, then converted straight into the output arrays
+        color_out, depth_out = out if out is not None else (None, None)
+
+        color_image = None
+        if color:
+            bgra = np.frombuffer(target.color_tex.getRamImage(), np.uint8)
+            bgra = bgra.reshape(height, width, 4)
+            color_image = np.empty_like(bgra) if color_out is None else color_out
+            np.copyto(color_image[..., :3], bgra[..., 2::-1])
+            np.copyto(color_image[..., 3], bgra[..., 3])
+
+        depth_image = None
+        if depth:
+            zbuffer = np.frombuffer(target.depth_tex.getRamImage(), np.float32)
+            zbuffer = zbuffer.reshape(height, width)
+            depth_image = depth_from_zbuffer(zbuffer, *lens_range, out=depth_out)
 
-        data = self._color_tex.getRamImageAs('RGBA')
-        color_image = np.frombuffer(data, np.uint8)
-        color_image.shape = (height, width, 4)
-        color_image = np.flipud(color_image)
+        return color_image, depth_image, None
 
-        data = self._depth_tex.getRamImage()
-        depth_image = np.frombuffer(data, np.float32)
-        depth_image.shape = height, width
-        lens = scene.camera.node().get_lens()
-        depth_image = depth_from_zbuffer(depth_image, lens.near, lens.far)
-        depth_image = np.flipud(depth_image)
+    def warm_up(self, scene):
+        """Generate and compile the shaders of all material permutations of a scene.
 
-        return color_image, depth_image, None
+        The shader generator makes a shader for each combination of vertex format, material,
+        texture, transparency and lights on first use, stalling the first frames by a compile
+        each; drawing a throwaway shape of each combination once, with and without shadows and
+        for each set of channels read back, moves the stalls to the renderer construction.
+
+        Arguments:
+            scene {Scene} -- scene whose lights and attributes are warmed up
+        """
+        warm_np = scene.make_warm_up_shapes()
+        dlight = scene.directional_light
+        shadow_caster = dlight.is_shadow_caster()
+        try:
+            for caster in (True, False):
+                dlight.set_shadow_caster(caster)
+                for color, depth in ((True, True), (True, False), (False, True)):
+                    target = self._target(WARM_UP_SIZE, WARM_UP_SIZE, color, depth)
+                    target.use_camera(scene.camera, self._engine)
+                    self._engine.render_frame()
+            # pipelined frames are drawn by the next call
+            self._engine.render_frame()
+        finally:
+            dlight.set_shadow_caster(shadow_caster)
+            warm_np.remove_node()
+            # no warm-up image is read back as a pipelined frame
+            for target in self._targets.values():
+                target.frames_drawn = 0
+                target.lens_range = None
 
     def destroy(self):
         """Clean up resources."""
-        self._remove_buffer()
+        for target in self._targets.values():
+            self._engine.remove_window(target.buffer)
+        self._targets.clear()
+        self._active = None
 
-    def _make_buffer(self, width, height):
-        """Make an offscreen buffer.
+    def _target(self, width, height, color, depth, multisamples=None):
+        """Buffer of a frame size and channels, made if there is none, the only one active.
 
         Arguments:
             width {int} -- target buffer width
             height {int} -- target buffer height
+            color {bool} -- color image read back
+            depth {bool} -- depth image read back
+
+        Keyword Arguments:
+            multisamples {int} -- antialiasing multisamples, those of the renderer if None
+                                  (default: {None})
+
+        Returns:
+            RenderTarget -- buffer and textures
         """
-        fb_prop = p3d.FrameBufferProperties(p3d.FrameBufferProperties.get_default())
-        fb_prop.set_multisamples(self._multisamples)
-        fb_prop.set_srgb_color(self._srgb_color)
+        if multisamples is None:
+            multisamples = self._multisamples
+        key = (width, height, multisamples, color, depth)
+        target = self._targets.get(key)
+        if target is None:
+            if len(self._targets) >= MAX_RENDER_TARGETS:
+                _, oldest = self._targets.popitem(last=False)
+                self._engine.remove_window(oldest.buffer)
+                if oldest is self._active:
+                    self._active = None
+            target = RenderTarget(self._engine, self._pipe, width, height, color, depth,
+                                  self._gsg, multisamples)
+            self._gsg = target.buffer.get_gsg()
+            self._targets[key] = target
+        self._targets.move_to_end(key)
+
+        if target is not self._active:
+            if self._active is not None:
+                self._active.buffer.set_active(False)
+            target.buffer.set_active(True)
+            self._active = target
+        return target
 
-        self._buffer = self._engine.make_output(
-            self._pipe, name="offscreen", sort=0,
-            fb_prop=p3d.FrameBufferProperties.get_default(),
-            win_prop=p3d.WindowProperties(size=(width, height)),
-            flags=p3d.GraphicsPipe.BFRefuseWindow)
+    def __del__(self):
+        """Clean up resources."""
+        self.destroy()
 
-        self._region = self._buffer.make_display_region()
 
-        self._depth_tex = p3d.Texture()
-        self._depth_tex.setFormat(p3d.Texture.FDepthComponent)
-        self._buffer.addRenderTexture(
-            self._depth_tex, p3d.GraphicsOutput.RTMCopyRam, p3d.GraphicsOutput.RTPDepth)
+# buffers kept by a renderer, the least recently used one is removed beyond
+MAX_RENDER_TARGETS = 8
 
-        self._color_tex = p3d.Texture()
-        self._color_tex.setFormat(p3d.Texture.FRgba8)
-        self._buffer.addRenderTexture(
-            self._color_tex, p3d.GraphicsOutput.RTMCopyRam, p3d.GraphicsOutput.RTPColor)
+# side of the buffers shaders are warmed up in
+WARM_UP_SIZE = 16
 
-    def _remove_buffer(self):
-        """Remove existing offscreen buffer."""
-        if self._buffer is not None:
-            self._engine.remove_window(self._buffer)
-            self._buffer = None
-            self._region = None
 
-    def __del__(self):
-        """Clean up resources."""
-        self.destroy()
+class RenderTarget:
+    """Offscreen buffer of a size, with the textures of the channels read back."""
+
+    def __init__(self, engine, pipe, width, height, color=True, depth=True, gsg=None,
+                 multisamples=0):
+        """Make an offscreen buffer.
+
+        Arguments:
+            engine {GraphicsEngine} -- graphics engine
+            pipe {GraphicsPipe} -- graphics pipe
+            width {int} -- target buffer width
+            height {int} -- target buffer height
+
+        Keyword Arguments:
+            color {bool} -- copy the color image to RAM (default: {True})
+            depth {bool} -- copy the depth image to RAM (default: {True})
+            gsg {GraphicsStateGuardian} -- state guardian to share, a new one if None
+                                           (default: {None})
+            multisamples {int} -- antialiasing multisamples, 0 for none (default: {0})
+        """
+        fb_prop = p3d.FrameBufferProperties(p3d.FrameBufferProperties.get_default())
+        if multisamples > 0:
+            fb_prop.set_multisamples(multisamples)
+        self.buffer = engine.make_output(
+            pipe, name="offscreen", sort=0,
+            fb_prop=fb_prop,
+            win_prop=p3d.WindowProperties(size=(width, height)),
+            flags=p3d.GraphicsPipe.BFRefuseWindow, gsg=gsg)
+        self.buffer.set_inverted(True)
+        self.regions = {}
+        self.region = None
+        self.frames_drawn = 0
+        # near and far distances of the lens of the last frame drawn, for pipelined read backs
+        self.lens_range = None
+
+        self.depth_tex = None
+        if depth:
+            self.depth_tex = p3d.Texture()
+            self.depth_tex.setFormat(p3d.Texture.FDepthComponent)
+            self.buffer.addRenderTexture(
+                self.depth_tex, p3d.GraphicsOutput.RTMCopyRam, p3d.GraphicsOutput.RTPDepth)
+
+        self.color_tex = None
+        if color:
+            self.color_tex = p3d.Texture()
+            self.color_tex.setFormat(p3d.Texture.FRgba8)
+            self.buffer.addRenderTexture(
+                self.color_tex, p3d.GraphicsOutput.RTMCopyRam, p3d.GraphicsOutput.RTPColor)
+
+    def use_camera(self, camera_np, engine):
+        """Draw the next frames through the display region of a camera, made if there is none.
+
+        Arguments:
+            camera_np {NodePath} -- camera node path
+            engine {GraphicsEngine} -- graphics engine
+        """
+        region = self.regions.get(camera_np)
+        if region is not None and region is self.region:
+            return
+        if self.region is not None:
+            self.region.set_active(False)
+        if region is None:
+            region = self.buffer.make_display_region()
+            region.camera = camera_np
+            self.regions[camera_np] = region
+            self.region = region
+            # TODO: shadows don't appear without this dummy rendering
+            engine.render_frame()
+        region.set_active(True)
+        self.region = region
 
 
 class Scene:
     """Internal scene implementation."""
 
-    def __init__(self):
-        """Construct a Scene."""
+    def __init__(self, instancing=False, shared_transforms=False):
+        """Construct a Scene.
+
+        With shared transforms, link nodes keep an identity transform: the matrices of the scene
+        state are copied at once into a buffer texture read by the vertex shader of the links,
+        rather than set node by node, which also spares panda the bounds of moved nodes. Links
+        are then lit by the ambient and directional lights only, without shadows or specular
+        highlights.
+
+        Keyword Arguments:
+            instancing {bool} -- combine instance groups into one draw each (default: {False})
+            shared_transforms {bool} -- pose links from a table of all matrices (default: {False})
+        """
+        if instancing and shared_transforms:
+            raise ValueError('Instance groups combine the transforms of their nodes')
+        self._instancing = instancing
         self._nodes = {}
+        self._shapes = {}
+        self._combiners = {}
+        self._instanced = {}
         self._seg_node_map = {}
         self._loader = p3d.Loader.get_global_ptr()
         self._render = p3d.NodePath('#scene')
         self._bg_color = (0.7, 0.7, 0.8, 0.0)
+        self._transforms = None
+        self._transform_ids = None
+        # world bounds of the nodes, to fit the shadows of the light to those in view
+        self._scene_graph = None
+        self._bvh = pr.BVH()
+        if shared_transforms:
+            self._transforms = p3d.Texture('#transforms')
+            self._transforms.setup_buffer_texture(4, p3d.Texture.T_float, p3d.Texture.F_rgba32,
+                                                  p3d.GeomEnums.UH_dynamic)
+            self._transform_shader = p3d.Shader.make(p3d.Shader.SL_GLSL,
+                                                     vertex=TRANSFORM_VERTEX_SHADER,
+                                                     fragment=TRANSFORM_FRAGMENT_SHADER)
 
         # setup attributes
         self._render.set_attrib(p3d.RescaleNormalAttrib.makeDefault(), 1)
@@ -210,6 +455,8 @@ class Scene:
         self._camera_np = self._render.attach_new_node(camera)
         self._camera_np.set_pos(0.0, -2.0, 3.0)
         self._camera_np.look_at(0.0, 0.0, 0.0)
+        self._default_camera_np = self._camera_np
+        self._cameras = {}
 
         # setup ambient light
         alight = p3d.AmbientLight('#alight')
@@ -227,66 +474,332 @@ class Scene:
         self._dlight_np.set_pos(-0.8, -0.2, 2.0)
         self._dlight_np.look_at(0.0, 0.0, 0.0)
         self._render.set_light(self._dlight_np)
+        # light settings of the last view, the quality tier of each view may drop some
+        self._shadow_caster = True
+        self._specular_color = (0.3, 0.3, 0.3, 0.0)
 
     def update_graph(self, scene_graph, materials_only):
         """Update scene graph.
 
-        This function rebuild scene completely each time when something changed.
-        TODO: update changed nodes instead.
+        This function rebuild scene completely.
 
         Arguments:
             scene_graph {SceneGraph} -- scene description
             materials_only {bool} -- update only shape materials
         """
+        self._scene_graph = scene_graph
         for uid, model_np in self._nodes.items():
             model_np.detach_node()
+        for combiner_np in self._combiners.values():
+            combiner_np.detach_node()
         self._nodes = {}
+        self._shapes = {}
+        self._combiners = {}
         self._seg_node_map = {}
 
+        groups = instance_groups(scene_graph) if self._instancing else {}
+        self._instanced = {uid: group for group, ids in groups.items() for uid in ids}
+
         for uid, link in scene_graph.nodes.items():
-            model_np = self._render.attach_new_node(
-                p3d.ModelNode(f'#link_{link.body}_{link.link}'))
-            model_np.node().set_preserve_transform(p3d.ModelNode.PTLocal)
-            self._nodes[uid] = model_np
-
-            for shape in link.shapes:
-                if shape.mesh is None:
-                    mesh = Mesh.from_trimesh(primitive_mesh(shape))
-                elif shape.mesh.data is None:
-                    filename = os.path.abspath(shape.mesh.filename)
-                    mesh = self._loader.load_sync(filename)
-                else:
-                    mesh = Mesh.from_mesh_data(shape.mesh.data)
-
-                mesh_np = model_np.attach_new_node(mesh)
-                mesh_np.set_mat((*shape.pose.matrix.ravel(),))
-
-                if shape.material is not None:
-                    mesh_np.set_color((*shape.material.diffuse_color,))
-
-                    material = p3d.Material()
-                    material.set_diffuse((*shape.material.diffuse_color,))
-                    material.set_ambient((*shape.material.diffuse_color,))
-                    material.set_specular((*shape.material.specular_color, 0.0))
-                    material.set_roughness(0.4)
-                    mesh_np.set_material(material, 1)
-
-                    if shape.material.diffuse_color[3] < 1.0:
-                        mesh_np.set_transparency(p3d.TransparencyAttrib.M_alpha)
-
-                    if shape.material.diffuse_texture:
-                        filename = os.path.abspath(shape.material.diffuse_texture.filename)
-                        texture = p3d.TexturePool.load_texture(filename)
-                        mesh_np.set_texture(texture, 1)
+            self._add_link(uid, link)
+        self._collect(groups.keys())
+
+    def apply_delta(self, scene_graph, delta):
+        """Update only nodes affected by a scene graph delta.
+
+        Arguments:
+            scene_graph {SceneGraph} -- scene description
+            delta {SceneGraphDelta} -- added, removed and changed nodes
+        """
+        self._scene_graph = scene_graph
+        # colors and textures change in place, unless they may move nodes between groups or
+        # their meshes were deformed too
+        if delta.materials_only and not delta.geometry_changed and not self._instancing:
+            nodes = scene_graph.nodes
+            for uid in delta.changed:
+                for index, mesh_np in self._shapes.get(uid, {}).items():
+                    self._set_material(mesh_np, nodes[uid].shapes[index].material)
+            return
+
+        # deformed meshes are rebuilt from their updated data
+        rebuilt = delta.changed | delta.geometry_changed
+        for uid in delta.removed | rebuilt:
+            self._shapes.pop(uid, None)
+            model_np = self._nodes.pop(uid, None)
+            if model_np is not None:
+                model_np.detach_node()
+
+        groups = instance_groups(scene_graph) if self._instancing else {}
+        instanced = {uid: group for group, ids in groups.items() for uid in ids}
+        changed_groups = {instanced.get(uid) for uid in delta.added | rebuilt}
+        changed_groups.update(self._instanced.get(uid) for uid in delta.removed | rebuilt)
+
+        # move nodes joining or leaving a group
+        for uid, model_np in self._nodes.items():
+            group = instanced.get(uid)
+            if group != self._instanced.get(uid):
+                changed_groups.update((group, self._instanced.get(uid)))
+                self._instanced[uid] = group
+                model_np.reparent_to(self._parent(uid))
+        self._instanced = instanced
+
+        nodes = scene_graph.nodes
+        for uid in delta.added | rebuilt:
+            self._add_link(uid, nodes[uid])
+        self._collect(changed_groups - {None})
+
+    def _parent(self, uid):
+        """Parent of a link node, the combiner of its instance group if any.
+
+        Arguments:
+            uid {int} -- unique node id
+
+        Returns:
+            NodePath -- parent node path
+        """
+        group = self._instanced.get(uid)
+        if group is None:
+            return self._render
+
+        combiner_np = self._combiners.get(group)
+        if combiner_np is None:
+            combiner_np = self._render.attach_new_node(p3d.RigidBodyCombiner(f'#group_{group}'))
+            self._combiners[group] = combiner_np
+        return combiner_np
+
+    def _collect(self, groups):
+        """Rebuild combined geometry of instance groups, dropping empty ones.
+
+        Arguments:
+            groups {iterable} -- instance group ids
+        """
+        for group in groups:
+            combiner_np = self._combiners.get(group)
+            if combiner_np is None:
+                continue
+            if combiner_np.get_num_children() == 0:
+                combiner_np.detach_node()
+                del self._combiners[group]
+            else:
+                combiner_np.node().collect()
+
+    def _add_link(self, uid, link):
+        """Append a link node with all its shapes.
+
+        Arguments:
+            uid {int} -- unique node id
+            link {Node} -- node description
+        """
+        model_np = self._parent(uid).attach_new_node(
+            p3d.ModelNode(f'#link_{link.body}_{link.link}'))
+        model_np.node().set_preserve_transform(p3d.ModelNode.PTLocal)
+        if self._transforms is not None:
+            # posed by the vertex shader, at a slot set by the next update_state()
+            model_np.set_shader(self._transform_shader, 2)
+            model_np.set_shader_input('transforms', self._transforms)
+            model_np.set_shader_input('transform_index', 0.0)
+            model_np.node().set_bounds(p3d.OmniBoundingVolume())
+            model_np.node().set_final(True)
+            self._transform_ids = None
+        self._nodes[uid] = model_np
+        shapes = self._shapes[uid] = {}
+
+        for index, shape in enumerate(link.shapes):
+            if shape.mesh is None:
+                node = self._load_primitive(shape)
+                if node is None:
+                    continue
+                mesh_np = model_np.attach_new_node('#shape_primitive')
+                mesh_np.attach_new_node(node)
+            else:
+                # cached geometry is shared, keep per-shape state on a parent node
+                mesh_np = model_np.attach_new_node(f'#shape_{shape.mesh.asset_id}')
+                mesh_np.attach_new_node(self._load_mesh(shape.mesh))
+            mesh_np.set_mat((*shape.pose.matrix.ravel(),))
+            self._set_material(mesh_np, shape.material)
+            shapes[index] = mesh_np
+
+    @staticmethod
+    def _set_material(mesh_np, material):
+        """Apply a shape material to its node, replacing the previous one.
+
+        Arguments:
+            mesh_np {NodePath} -- shape node
+            material {Material} -- shape material, None for the mesh colors
+        """
+        mesh_np.clear_color()
+        mesh_np.clear_material()
+        mesh_np.clear_transparency()
+        mesh_np.clear_texture()
+        if material is None:
+            return
+
+        texture = None
+        if material.diffuse_texture:
+            filename = os.path.abspath(material.diffuse_texture.filename)
+            texture = p3d.TexturePool.load_texture(filename)
+        Scene._apply_material(mesh_np, material.diffuse_color, material.specular_color, texture)
+
+    @staticmethod
+    def _apply_material(mesh_np, diffuse_color, specular_color, texture=None):
+        """Apply material attributes to a cleared shape node.
+
+        Arguments:
+            mesh_np {NodePath} -- shape node
+            diffuse_color {tuple} -- RGBA diffuse color, transparent below an alpha of 1
+            specular_color {tuple} -- RGB specular color
+
+        Keyword Arguments:
+            texture {Texture} -- diffuse texture (default: {None})
+        """
+        mesh_np.set_color((*diffuse_color,))
+
+        p3d_material = p3d.Material()
+        p3d_material.set_diffuse((*diffuse_color,))
+        p3d_material.set_ambient((*diffuse_color,))
+        p3d_material.set_specular((*specular_color, 0.0))
+        p3d_material.set_roughness(0.4)
+        mesh_np.set_material(p3d_material, 1)
+
+        if diffuse_color[3] < 1.0:
+            mesh_np.set_transparency(p3d.TransparencyAttrib.M_alpha)
+
+        if texture is not None:
+            mesh_np.set_texture(texture, 1)
+
+    def make_warm_up_shapes(self):
+        """Attach a shape of each vertex format and material permutation in front of the camera.
+
+        Mesh files come with or without normals and uvs, primitives with both; materials are
+        absent, opaque or transparent, textured or not, as _set_material() applies them.
+
+        Returns:
+            NodePath -- parent of the shapes, to be removed once drawn
+        """
+        texture = p3d.Texture('#warm_up')
+        texture.setup_2d_texture(1, 1, p3d.Texture.T_unsigned_byte, p3d.Texture.F_rgba8)
+        texture.set_ram_image(b'\xff' * 4)
+
+        triangle = np.array([[-1, 0, -1], [1, 0, -1], [0, 0, 1]], np.float32)
+        normals = np.tile(np.array([0, -1, 0], np.float32), (3, 1))
+        uvs = np.array([[0, 0], [1, 0], [0.5, 1]], np.float32)
+        formats = ((p3d.GeomVertexFormat.get_v3(), triangle),
+                   (p3d.GeomVertexFormat.get_v3n3(), np.column_stack((triangle, normals))),
+                   (p3d.GeomVertexFormat.get_v3t2(), np.column_stack((triangle, uvs))),
+                   (p3d.GeomVertexFormat.get_v3n3t2(),
+                    np.column_stack((triangle, normals, uvs))))
+        materials = [None] + [(alpha, tex) for alpha in (1.0, 0.5) for tex in (None, texture)]
+
+        warm_np = self._camera_np.attach_new_node('#warm_up')
+        warm_np.set_pos(0.0, 2.0, 0.0)
+        for vformat, vertices in formats:
+            node = Mesh._make(vformat, vertices, np.arange(3))
+            for material in materials:
+                mesh_np = warm_np.attach_new_node('#shape_warm_up')
+                mesh_np.attach_new_node(node)
+                if material is not None:
+                    alpha, tex = material
+                    self._apply_material(mesh_np, (0.5, 0.5, 0.5, alpha), (0.5, 0.5, 0.5), tex)
+        return warm_np
+
+    def _load_primitive(self, shape):
+        """Tessellate a primitive shape as a panda node.
+
+        Primitives are tessellated once per process for each set of dimensions, heightfields
+        at each call.
+
+        Arguments:
+            shape {Shape} -- primitive shape
+
+        Returns:
+            p3d.PandaNode -- mesh node, must not be modified, None if not a primitive
+        """
+        if shape.heightfield is not None:
+            data = pr.bindings.primitive_mesh(shape)
+            return Mesh.from_mesh_data(data) if data is not None else None
+
+        key = (int(shape.type), tuple(shape.extents))
+        node = _primitive_cache.get(key)
+        if node is None:
+            data = pr.bindings.primitive_mesh(shape)
+            if data is None:
+                return None
+            node = Mesh.from_mesh_data(data)
+            _primitive_cache[key] = node
+        return node
+
+    def _load_mesh(self, mesh):
+        """Load a mesh description as a panda node.
+
+        Meshes with an asset id are loaded once per process and shared by all scenes, until the
+        asset cache drops them.
+
+        Arguments:
+            mesh {Mesh} -- mesh description
+
+        Returns:
+            p3d.PandaNode -- mesh node, must not be modified
+        """
+        evict_pruned_assets()
+        node = _mesh_cache.get(mesh.asset_id) if mesh.asset_id >= 0 else None
+        if node is not None:
+            return node
+
+        if mesh.data is None:
+            node = self._loader.load_sync(os.path.abspath(mesh.filename))
+        else:
+            node = Mesh.from_mesh_data(mesh.data)
+
+        if mesh.asset_id >= 0:
+            _mesh_cache[mesh.asset_id] = node
+        return node
 
     def update_state(self, scene_state):
         """Apply scene state.
 
+        Only nodes moved since the previous frame are updated.
+
         Arguments:
             scene_state {SceneState} -- transformations of all objects in the scene
         """
-        for uid, node in self._nodes.items():
-            node.set_mat(p3d.Mat4(*scene_state.matrix(uid).ravel()))
+        if self._scene_graph is not None:
+            self._bvh.update(self._scene_graph, scene_state)
+        ids, matrices = scene_state.ids, scene_state.matrices
+        if self._transforms is not None:
+            self._update_transforms(ids, matrices, scene_state.dirty)
+            return
+        for i in np.flatnonzero(scene_state.dirty):
+            node = self._nodes.get(ids[i])
+            if node is not None:
+                node.set_mat(p3d.Mat4(*matrices[i].ravel()))
+
+    def _update_transforms(self, ids, matrices, dirty):
+        """Copy all matrices into the transform table, in the order of the scene state slots.
+
+        Arguments:
+            ids {ndarray} -- node id of each slot
+            matrices {ndarray} -- world matrix of each slot
+            dirty {ndarray} -- slots moved since the previous frame
+        """
+        layout_changed = self._transform_ids is None or not np.array_equal(
+            ids, self._transform_ids)
+        if layout_changed:
+            # slots only move when nodes are added or removed
+            if self._transforms.get_x_size() < len(ids) * 4:
+                self._transforms.setup_buffer_texture(
+                    len(ids) * 4, p3d.Texture.T_float, p3d.Texture.F_rgba32,
+                    p3d.GeomEnums.UH_dynamic)
+            for slot, uid in enumerate(ids):
+                node = self._nodes.get(uid)
+                if node is not None:
+                    node.set_shader_input('transform_index', float(slot))
+            self._transform_ids = np.array(ids)
+        elif not np.any(dirty):
+            return
+
+        # four texels of columns per matrix, as numpy holds them transposed in row-major order
+        table = np.frombuffer(self._transforms.modify_ram_image(), np.float32)
+        table[:matrices.size] = matrices.ravel()
 
     def update_view(self, scene_view):
         """Apply scene state.
@@ -294,21 +807,89 @@ class Scene:
         Arguments:
             settings {SceneView} -- view settings, e.g. camera, light, viewport parameters
         """
-        if scene_view.camera is not None:
-            yfov, znear, zfar, aspect = decompose(scene_view.camera.projection_matrix)
+        camera = scene_view.camera
+        if camera is not None:
+            # registered cameras have a node of their own, whose lens is set once
+            self._camera_np = self._cameras.get(camera.handle, self._default_camera_np)
+            if camera.handle < 0 or camera.handle not in self._cameras:
+                if camera.handle >= 0:
+                    self._camera_np = self._render.attach_new_node(
+                        p3d.Camera('#camera{}'.format(camera.handle), p3d.PerspectiveLens()))
+                    self._cameras[camera.handle] = self._camera_np
+                yfov, znear, zfar, aspect = camera.intrinsics
+                self._camera_np.node().get_lens().set_near_far(znear, zfar)
+                self._camera_np.node().get_lens().set_fov(np.rad2deg(yfov*aspect),
+                                                          np.rad2deg(yfov))
             conv_mat = p3d.Mat4.convert_mat(p3d.CSZupRight, p3d.CSYupRight)
-            self._camera_np.set_mat(conv_mat * p3d.Mat4(*scene_view.camera.pose_matrix.ravel(), ))
-            self._camera_np.node().get_lens().set_near_far(znear, zfar)
-            self._camera_np.node().get_lens().set_fov(np.rad2deg(yfov*aspect), np.rad2deg(yfov))
+            self._camera_np.set_mat(conv_mat * p3d.Mat4(*camera.pose_matrix.ravel(), ))
 
         if scene_view.light is not None:
             self._alight_np.node().set_color((*scene_view.light.ambient_color, 0.0))
             self._dlight_np.node().set_color((*scene_view.light.diffuse_color, 0.0))
-            self._dlight_np.node().set_specular_color((*scene_view.light.specular_color, 0.0))
-            self._dlight_np.node().set_shadow_caster(scene_view.light.shadow_caster)
+            self._specular_color = (*scene_view.light.specular_color, 0.0)
+            self._shadow_caster = scene_view.light.shadow_caster
             self._dlight_np.set_pos(*scene_view.light.position)
             self._dlight_np.look_at(0, 0, 0)
 
+        # shaders of both shadow states are generated by the warm-up
+        quality = scene_view.quality
+        dlight = self._dlight_np.node()
+        dlight.set_specular_color(self._specular_color if quality.specular else (0, 0, 0, 0))
+        if dlight.is_shadow_caster() != (self._shadow_caster and quality.shadows):
+            dlight.set_shadow_caster(self._shadow_caster and quality.shadows)
+        if camera is not None and dlight.is_shadow_caster():
+            self._fit_light(camera)
+
+    def _fit_light(self, camera):
+        """Fit the shadow frustum of the directional light to the nodes a camera sees.
+
+        Across the rays the lens covers the finite nodes in view, all of them if it sees none,
+        its film centered on whole texels so that shadows do not crawl as the camera moves;
+        along the rays it reaches every node of the scene, so that casters out of view still
+        shadow the nodes in view. The lens is left as is for an empty scene.
+
+        Arguments:
+            camera {Camera} -- camera of the view
+        """
+        scene_bounds = self._bvh.bounds
+        if scene_bounds.empty:
+            return
+        boxes = [self._bvh.world_bounds(uid) for uid in self._bvh.query(camera)]
+        boxes = [box for box in boxes if not box.empty and not box.infinite]
+        if boxes:
+            lower = np.min([box.lower for box in boxes], axis=0)
+            upper = np.max([box.upper for box in boxes], axis=0)
+        else:
+            lower, upper = np.array(scene_bounds.lower), np.array(scene_bounds.upper)
+
+        # light frame: x across the rays, y up across them, z along them
+        forward = np.array(self._dlight_np.get_quat(self._render).get_forward())
+        up = np.array([0.0, 0.0, 1.0]) if abs(forward[2]) < 0.9 else np.array([0.0, 1.0, 0.0])
+        x = np.cross(forward, up)
+        x /= np.linalg.norm(x)
+        axes = np.array([x, np.cross(x, forward), forward])
+
+        def corners(low, high):
+            return np.array([[(high if i & (1 << k) else low)[k] for k in range(3)]
+                             for i in range(8)]) @ axes.T
+
+        receivers = corners(lower, upper)
+        casters = corners(np.array(scene_bounds.lower), np.array(scene_bounds.upper))
+        low, high = receivers.min(axis=0), receivers.max(axis=0)
+        size = np.maximum(high[:2] - low[:2], 1e-3)
+        texel = size / np.array(self._dlight_np.node().get_shadow_buffer_size())
+        center = np.round((low[:2] + high[:2]) / 2 / texel) * texel
+        near = min(casters[:, 2].min(), low[2]) - 0.1
+
+        # the light looks along the rays from in front of the nearest caster
+        position = axes[:2].T @ center + forward * near
+        self._dlight_np.set_pos(*position)
+        self._dlight_np.look_at(p3d.Point3(*(position + forward)), p3d.Vec3(*up))
+        lens = self._dlight_np.node().get_lens()
+        lens.set_film_size(*(size + 2 * texel))
+        lens.set_film_offset(0, 0)
+        lens.set_near_far(0.05, high[2] - near + 0.05)
+
     @property
     def render(self):
         """Scene root node.
@@ -318,6 +899,15 @@ class Scene:
         """
         return self._render
 
+    @property
+    def directional_light(self):
+        """Directional light, casting shadows by default.
+
+        Returns:
+            DirectionalLight -- light node
+        """
+        return self._dlight_np.node()
+
     @property
     def camera(self):
         """Camera node.
@@ -341,6 +931,60 @@ class Scene:
         self._bg_color = value
 
 
+TRANSFORM_VERTEX_SHADER = """
+#version 150
+uniform mat4 p3d_ViewProjectionMatrix;
+uniform mat4 p3d_ViewMatrix;
+uniform mat4 p3d_ModelMatrix; // shape pose in the link, links keep an identity transform
+uniform samplerBuffer transforms;
+uniform float transform_index;
+in vec4 p3d_Vertex;
+in vec3 p3d_Normal;
+in vec2 p3d_MultiTexCoord0;
+in vec4 p3d_Color;
+out vec3 eye_normal;
+out vec2 texcoord;
+out vec4 color;
+void main()
+{
+    int texel = int(transform_index) * 4;
+    mat4 link = mat4(texelFetch(transforms, texel), texelFetch(transforms, texel + 1),
+                     texelFetch(transforms, texel + 2), texelFetch(transforms, texel + 3));
+    mat4 model = link * p3d_ModelMatrix;
+    eye_normal = mat3(p3d_ViewMatrix) * transpose(inverse(mat3(model))) * p3d_Normal;
+    texcoord = p3d_MultiTexCoord0;
+    color = p3d_Color;
+    gl_Position = p3d_ViewProjectionMatrix * model * p3d_Vertex;
+}
+"""
+
+TRANSFORM_FRAGMENT_SHADER = """
+#version 150
+uniform sampler2D p3d_Texture0; // white without a texture
+uniform vec4 p3d_ColorScale;
+uniform struct {
+    vec4 ambient;
+} p3d_LightModel;
+uniform struct {
+    vec4 color;
+    vec4 position; // towards the light in eye space for directional lights
+} p3d_LightSource[1];
+in vec3 eye_normal;
+in vec2 texcoord;
+in vec4 color;
+out vec4 p3d_FragColor;
+void main()
+{
+    vec4 albedo = color * p3d_ColorScale * texture(p3d_Texture0, texcoord);
+    float lambert = 0.0;
+    if (dot(eye_normal, eye_normal) > 0.0)
+        lambert = max(dot(normalize(eye_normal), normalize(p3d_LightSource[0].position.xyz)), 0.0);
+    vec3 light = p3d_LightModel.ambient.rgb + p3d_LightSource[0].color.rgb * lambert;
+    p3d_FragColor = vec4(albedo.rgb * light, albedo.a);
+}
+"""
+
+
 class Mesh:
     """Mesh helper class."""
 
@@ -354,6 +998,15 @@ class Mesh:
         Returns:
             NodePath -- created geometry node
         """
+        buffer = mesh.vertex_buffer
+        if buffer is not None and not buffer.half_attributes:
+            # already interleaved by the asset caches, uploaded without restacking
+            vformat = {(-1, -1): p3d.GeomVertexFormat.get_v3(),
+                       (12, -1): p3d.GeomVertexFormat.get_v3n3(),
+                       (-1, 12): p3d.GeomVertexFormat.get_v3t2(),
+                       (12, 24): p3d.GeomVertexFormat.get_v3n3t2()}[
+                           (buffer.normal_offset, buffer.uv_offset)]
+            return Mesh._make(vformat, buffer.vertices.view(np.float32), buffer.indices)
         if len(mesh.normals) > 0 and len(mesh.uvs) > 0:
             vformat = p3d.GeomVertexFormat.get_v3n3t2()
             vertices = np.column_stack((mesh.vertices, mesh.normals, mesh.uvs))
@@ -366,7 +1019,7 @@ class Mesh:
         else:
             vformat = p3d.GeomVertexFormat.get_v3()
             vertices = mesh.vertices
-        return Mesh._make(vformat, vertices, mesh.faces)
+        return Mesh._make(vformat, vertices, mesh.indices)
 
     @staticmethod
     def from_trimesh(mesh):
@@ -384,16 +1037,22 @@ class Mesh:
         return Mesh._make(vformat, vertices, mesh.faces)
 
     @staticmethod
-    def _make(vformat, vertices, faces):
+    def _make(vformat, vertices, indices):
         vdata = p3d.GeomVertexData('#vdata', vformat, p3d.Geom.UHStatic)
         vdata.unclean_set_num_rows(len(vertices))
-        vdata.modify_array_handle(0).set_subdata(0, len(vertices), vertices.astype(np.float32))
+        vdata.modify_array_handle(0).set_subdata(
+            0, len(vertices), vertices.astype(np.float32, copy=False))
 
+        # indices copied in one block, 16 bits wide when the vertex count allows
+        indices = np.ravel(indices)
         prim = p3d.GeomTriangles(p3d.Geom.UHStatic)
-        prim.clear_vertices()
-        for v1, v2, v3 in faces:
-            prim.add_vertices(v1, v2, v3)
-        prim.close_primitive()
+        if len(vertices) < 0xffff:
+            prim.set_index_type(p3d.Geom.NT_uint16)
+            indices = indices.astype(np.uint16, copy=False)
+        else:
+            prim.set_index_type(p3d.Geom.NT_uint32)
+            indices = indices.astype(np.uint32, copy=False)
+        prim.modify_vertices(len(indices)).modify_handle().copy_data_from(indices)
 
         geom = p3d.Geom(vdata)
         geom.add_primitive(prim)
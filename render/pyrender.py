@@ -1,17 +1,67 @@
+import collections
+import copy
 import os, sys
+import pickle
 
 import numpy as np
 import pyrender as pyr
 import trimesh
 from PIL import Image
 sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '../'))
-from ..bindings import BaseRenderer
+from ..bindings import (BaseRenderer, OutputChannel, acquire_device, load_bitmap,
+                        set_texture_prefetch)
 
-from .utils import decompose, mask_to_rgb, primitive_mesh, rgb_to_mask
+from .utils import (asset_keyed_cache, evict_pruned_assets, instance_groups, lent_planes,
+                    load_trimesh, mask_value_to_rgb, primitive_mesh, rgb_to_mask)
 
 __all__ = ('PyrRenderer', 'PyrViewer')
 
 
+_texture_cache = asset_keyed_cache()
+
+
+def _load_texture(texture):
+    """Load a texture description, once per process for each content.
+
+    Textures are shared by all the shapes, materials and scene rebuilds using them, keyed by
+    their asset id, or the address of their pixels for uncached bitmaps, and created again only
+    once the pixels of a bitmap get a new revision or the asset cache drops them.
+
+    Arguments:
+        texture {Texture} -- texture description
+
+    Returns:
+        pyr.Texture -- texture, shared by all materials using it
+    """
+    bitmap = texture.bitmap
+    if bitmap is None and texture.asset_id >= 0:
+        # decoded by the loader workers since the plugin converted the material, else here
+        bitmap = load_bitmap(texture)
+    if bitmap is not None:
+        # pixels are uploaded from the bitmap buffer as is, without a PIL copy
+        pixels = np.asarray(bitmap)
+        key = texture.asset_id if texture.asset_id >= 0 else ('pixels', pixels.ctypes.data)
+        revision = bitmap.revision
+    else:
+        key = texture.asset_id if texture.asset_id >= 0 else os.path.abspath(texture.filename)
+        revision = 0
+
+    evict_pruned_assets()
+    cached = _texture_cache.get(key)
+    if cached is not None and cached[0] == revision:
+        return cached[1]
+
+    if bitmap is not None:
+        channels = pixels.shape[2] if pixels.ndim == 3 else 1
+        result = pyr.Texture(source=pixels, source_channels='RGBA'[:channels])
+    else:
+        image = Image.open(os.path.abspath(texture.filename))
+        result = pyr.Texture(source=image, source_channels=image.mode)
+
+    _texture_cache[key] = (revision, result)
+    return result
+
+
 class PyrRenderer(BaseRenderer):
     """Pyrender-based offscreen renderer."""
 
@@ -20,7 +70,9 @@ class PyrRenderer(BaseRenderer):
                  render_mask=True,
                  shadows=True,
                  platform=None,
-                 device_id=0
+                 device_id=None,
+                 instancing=False,
+                 callback_views=False
                  ):
         """Construct a Renderer.
 
@@ -29,22 +81,31 @@ class PyrRenderer(BaseRenderer):
             render_mask {bool} -- render segmentation mask or not (default: {False})
             shadows {bool} -- render shadows for all lights (default: {True})
             platform {str} -- PyOpenGL platform ('egl', 'osmesa', etc.) (default: {None})
-            device_id {int} -- EGL device id if platform is 'egl' (default: {0})
+            device_id {int} -- EGL device id if platform is 'egl', None for the GPU least loaded by the renderers of the process (default: {None})
+            instancing {bool} -- draw nodes sharing a mesh and a material in one call, ignored with render_mask as instances cannot be told apart in the mask (default: {False})
+            callback_views {bool} -- pass callback_fn read-only views of the images copied into bullet's buffers, see lent_planes (default: {False})
         """
         super().__init__()
+        # textures are taken decoded from the loader workers, see _load_texture
+        set_texture_prefetch(True)
 
         self._render_mask = render_mask
         self._flags = pyr.RenderFlags.NONE
         self._callback_fn = callback_fn
+        self._callback_views = callback_views
 
         if shadows:
             self._flags |= pyr.RenderFlags.SHADOWS_DIRECTIONAL
 
+        self._device_lease = None
         if platform is not None:
             os.environ["PYOPENGL_PLATFORM"] = platform
+            if device_id is None:
+                self._device_lease = acquire_device()
+                device_id = self._device_lease.device if self._device_lease is not None else 0
             os.environ["EGL_DEVICE_ID"] = str(device_id)
         self._renderer = pyr.OffscreenRenderer(0, 0)
-        self._scene = Scene()
+        self._scene = Scene(instancing=instancing and not render_mask)
 
     @property
     def scene(self):
@@ -64,6 +125,15 @@ class PyrRenderer(BaseRenderer):
         """
         self._scene.update_graph(scene_graph, materials_only)
 
+    def apply_scene_delta(self, scene_graph, delta):
+        """Apply changes made to a scene graph since the previous update.
+
+        Arguments:
+            scene_graph {SceneGraph} -- scene description
+            delta {SceneGraphDelta} -- added, removed and changed nodes
+        """
+        self._scene.apply_delta(scene_graph, delta)
+
     def render_frame(self, scene_state, scene_view, frame):
         """Render a scene at scene_state with a scene_view settings.
 
@@ -73,42 +143,83 @@ class PyrRenderer(BaseRenderer):
             frame {FrameData} -- output image buffer
         """
         self._scene.update_state(scene_state)
+        return self._render_view(scene_view, frame)
+
+    def render_frames(self, scene_state, scene_views, frames):
+        """Render a scene at scene_state from several views.
+
+        The scene state is applied once for all views.
+
+        Arguments:
+            scene_state {SceneState} -- scene state, e.g. transformations of all objects
+            scene_views {list} -- view settings, one per frame
+            frames {list} -- output image buffers
+        """
+        self._scene.update_state(scene_state)
+        rendered = [self._render_view(view, frame) for view, frame in zip(scene_views, frames)]
+        return all(rendered)
+
+    def _render_view(self, scene_view, frame):
+        """Render the current scene with a scene_view settings.
+
+        Arguments:
+            scene_view {SceneView} -- view settings, e.g. camera, light, viewport parameters
+            frame {FrameData} -- output image buffer
+        """
         self._scene.update_view(scene_view)
 
         self._renderer.viewport_width = scene_view.viewport[0]
         self._renderer.viewport_height = scene_view.viewport[1]
 
-        # render color and depth
-        flags = self._flags | pyr.RenderFlags.RGBA
+        # skip passes for channels nobody asked for
+        render_color = scene_view.has_output_channel(OutputChannel.Color)
+        render_depth = scene_view.has_output_channel(OutputChannel.Depth)
+        render_mask = self._render_mask and scene_view.has_output_channel(OutputChannel.Mask)
 
+        # the quality tier of the view drops the shadows of the renderer and of the light
+        flags = self._flags
         if scene_view.light and scene_view.light.shadow_caster:
             flags |= pyr.RenderFlags.SHADOWS_DIRECTIONAL
+        if not scene_view.quality.shadows:
+            flags &= ~pyr.RenderFlags.SHADOWS_DIRECTIONAL
 
-        ret = self._renderer.render(self._scene, flags)
-        color, depth = ret if isinstance(ret, tuple) else (None, ret)
+        # regions of interest are cropped from images of the whole viewport
+        x, y = scene_view.roi[:2] if scene_view.has_roi else (0, 0)
+        width, height = scene_view.image_size
+        crop = np.s_[y:y + height, x:x + width]
+
+        # render color and depth
+        color, depth = None, None
+        if render_color:
+            color, depth = self._renderer.render(self._scene, flags | pyr.RenderFlags.RGBA)
+            color, depth = color[crop], depth[crop]
+        elif render_depth:
+            depth = self._renderer.render(self._scene, flags | pyr.RenderFlags.DEPTH_ONLY)[crop]
 
         # render segment mask
-        if not self._render_mask:
-            mask = None
-        else:
+        mask = None
+        lent = self._callback_fn is not None and self._callback_views
+        planes = frame.planes if self._callback_fn is None or lent else (None, None, None)
+        if render_mask:
             flags |= pyr.RenderFlags.SEG
-            flags &= ~pyr.RenderFlags.RGBA
             mask_rgb, _ = self._renderer.render(
                 self._scene, flags, self._scene._seg_node_map)
-            mask = rgb_to_mask(mask_rgb)
+            mask = rgb_to_mask(mask_rgb[crop], out=planes[2])
 
-        if self._callback_fn is not None:
+        if self._callback_fn is not None and not lent:
             # pass result to a callback function
             self._callback_fn(color, depth, mask)
             return False
 
-        # pass result to bullet
-        if color is not None:
-            frame.color_img[:] = color
-        if depth is not None:
-            frame.depth_img[:] = depth
-        if mask is not None:
-            frame.mask_img[:] = mask
+        # pass result to bullet, pyrender owns its readback so images are copied once
+        color_img, depth_img, _ = planes
+        if color is not None and color_img is not None:
+            np.copyto(color_img, color)
+        if depth is not None and depth_img is not None:
+            np.copyto(depth_img, depth)
+        if lent:
+            with lent_planes(frame) as views:
+                self._callback_fn(*views)
         return True
 
 
@@ -118,13 +229,31 @@ class PyrViewer(BaseRenderer):
     Use for debug purposes only.
     This class cannot return rendered data.
     You should call pybullet.getCameraImage(...) to trigger window update.
+
+    In decoupled mode, camera images only publish a copy of the scene state and view: the
+    viewer thread applies the latest one at each of its frames, at its own rate, so that the
+    simulation never waits for the display. Scene changes are queued to the viewer thread in
+    order; states published between two viewer frames are dropped.
     """
 
-    def __init__(self):
-        """Construct a PyrenderViewer."""
+    def __init__(self, decoupled=False, refresh_rate=30.0):
+        """Construct a PyrenderViewer.
+
+        Keyword Arguments:
+            decoupled {bool} -- draw snapshots on the viewer thread only (default: {False})
+            refresh_rate {float} -- viewer frames per second (default: {30.0})
+        """
         super().__init__()
         self._scene = Scene()
         self._viewer = None
+        self._decoupled = decoupled
+        self._refresh_rate = refresh_rate
+        # published by the simulation thread, taken by the viewer thread, neither waits
+        self._updates = collections.deque()
+        self._snapshot = None  # (sequence, scene state, scene view) of the last camera image
+        self._sequence = 0
+        self._shown = 0  # sequence of the snapshot drawn last
+        self._stale = False  # the scene changed since, all poses are applied again
 
     @property
     def scene(self):
@@ -142,8 +271,23 @@ class PyrViewer(BaseRenderer):
             scene_graph {SceneGraph} -- scene description
             materials_only {bool} -- update only shape materials
         """
+        if self._decoupled:
+            self._updates.append((copy.copy(scene_graph), materials_only, None))
+            return
         self._scene.update_graph(scene_graph, materials_only)
 
+    def apply_scene_delta(self, scene_graph, delta):
+        """Apply changes made to a scene graph since the previous update.
+
+        Arguments:
+            scene_graph {SceneGraph} -- scene description
+            delta {SceneGraphDelta} -- added, removed and changed nodes
+        """
+        if self._decoupled:
+            self._updates.append((copy.copy(scene_graph), False, copy.copy(delta)))
+            return
+        self._scene.apply_delta(scene_graph, delta)
+
     def render_frame(self, scene_state, scene_view, frame):
         """Render scene at scene_state with a scene_view settings.
 
@@ -152,23 +296,80 @@ class PyrViewer(BaseRenderer):
             scene_view {SceneView} -- view settings, e.g. camera, light, viewport parameters
             frame {FrameData} -- output image buffer
         """
+        if self._decoupled:
+            # the view is pickled to copy its camera and light too
+            self._sequence += 1
+            self._snapshot = (self._sequence, copy.copy(scene_state),
+                              pickle.loads(pickle.dumps(scene_view)))
+        else:
+            self._scene.update_state(scene_state)
+            self._scene.update_view(scene_view)
+
+        if self._viewer is None and self._decoupled:
+            # no viewer thread yet, the first scene frames the default viewer camera
+            self._apply_snapshot()
+            self._viewer = _SnapshotViewer(self._scene, self, run_in_thread=True,
+                                           refresh_rate=self._refresh_rate)
+        elif self._viewer is None:
+            self._viewer = pyr.Viewer(self._scene, run_in_thread=True,
+                                      refresh_rate=self._refresh_rate)
+
+        return False
+
+    def _apply_snapshot(self):
+        """Apply the queued scene changes and the latest snapshot, on the viewer thread."""
+        while self._updates:
+            scene_graph, materials_only, delta = self._updates.popleft()
+            if delta is None:
+                self._scene.update_graph(scene_graph, materials_only)
+            else:
+                self._scene.apply_delta(scene_graph, delta)
+            self._stale = True
+
+        snapshot = self._snapshot
+        if snapshot is None or snapshot[0] == self._shown:
+            return
+        sequence, scene_state, scene_view = snapshot
+        # poses moved in dropped snapshots, or of nodes added since, are not flagged in this one
+        if self._stale or sequence != self._shown + 1:
+            scene_state.mark_all_dirty()
+        self._shown = sequence
+        self._stale = False
         self._scene.update_state(scene_state)
         self._scene.update_view(scene_view)
 
-        if self._viewer is None:
-            self._viewer = pyr.Viewer(self._scene, run_in_thread=True)
 
-        return False
+class _SnapshotViewer(pyr.Viewer):
+    """Viewer applying the snapshots of a decoupled PyrViewer before drawing each frame."""
+
+    def __init__(self, scene, source, **kwargs):
+        # the viewer thread may draw before the constructor returns
+        self._source = source
+        super().__init__(scene, **kwargs)
+
+    def on_draw(self):
+        self._source._apply_snapshot()
+        super().on_draw()
 
 
 class Scene(pyr.Scene):
     """Helper Scene wrapper."""
 
-    def __init__(self):
-        """Construct a Scene."""
+    def __init__(self, instancing=False):
+        """Construct a Scene.
+
+        Keyword Arguments:
+            instancing {bool} -- draw instance groups with one instanced mesh (default: {False})
+        """
         super().__init__()
+        self._instancing = instancing
+        self._scene_graph = None
         self._bullet_nodes = {}
+        self._shape_meshes = {}
         self._seg_node_map = {}
+        self._groups = {}
+        self._group_nodes = {}
+        self._instanced = {}
         self.bg_color = (0.7, 0.7, 0.8)
         self.ambient_light = (0.2, 0.2, 0.2)
 
@@ -177,6 +378,7 @@ class Scene(pyr.Scene):
             translation=(0.0, -2.0, 3.0),
             rotation=(-0.472, 0.0, 0.0, 0.882))
         self.add_node(self._camera_node)
+        self._lens_handle = -1
 
         self._light_node = pyr.Node(
             light=pyr.DirectionalLight(color=(0.8, 0.8, 0.8), intensity=5.0),
@@ -187,65 +389,202 @@ class Scene(pyr.Scene):
     def update_graph(self, scene_graph, materials_only):
         """Update scene graph.
 
-        This function rebuild scene completely each time when something changed.
-        TODO: update changed nodes instead.
+        This function rebuild scene completely.
 
         Arguments:
             scene_graph {SceneGraph} -- scene description
             materials_only {bool} -- update only shape materials
         """
-        for uid, node in self._bullet_nodes.items():
-            self.remove_node(node)
-        self._bullet_nodes = {}
+        for uid in list(self._bullet_nodes):
+            self._remove_body(uid)
+        for group in list(self._groups):
+            self._remove_group(group)
         self._seg_node_map = {}
 
+        self._scene_graph = scene_graph
+        self._groups = instance_groups(scene_graph) if self._instancing else {}
+        self._instanced = {uid: group for group, ids in self._groups.items() for uid in ids}
+
         for uid, body in scene_graph.nodes.items():
-            node = pyr.Node(uid)
-            self.add_node(node)
-            self._bullet_nodes[uid] = node
-
-            for shape in body.shapes:
-                if shape.material is None:
-                    material = None
-                else:
-                    material = pyr.MetallicRoughnessMaterial(
-                        baseColorFactor=shape.material.diffuse_color,
-                        metallicFactor=0.2,
-                        roughnessFactor=0.8,
-                        alphaMode='BLEND')
-                    texture = shape.material.diffuse_texture
-                    if texture is not None:
-                        if texture.bitmap is not None:
-                            image = Image.fromarray(texture.bitmap)
-                        else:
-                            image = Image.open(os.path.abspath(texture.filename))
-                        texture = pyr.Texture(source=image, source_channels=image.mode)
-                        material.baseColorTexture = texture
-
-                if shape.mesh is None:
-                    mesh = primitive_mesh(shape)
-                elif shape.mesh.data is None:
-                    mesh = trimesh.load(os.path.abspath(shape.mesh.filename), force='mesh')
-                else:
-                    data = shape.mesh.data
-                    mesh = trimesh.Trimesh(
-                        vertices=data.vertices,
-                        vertex_normals=data.normals,
-                        faces=data.faces,
-                        visual=trimesh.visual.TextureVisuals(uv=data.uvs))
-
-                mesh = pyr.Mesh.from_trimesh(mesh, material=material)
-                mesh_node = self.add(mesh, pose=shape.pose.matrix.T, parent_node=node)
-                self._seg_node_map[mesh_node] = mask_to_rgb(body.body, body.link)
+            if uid not in self._instanced:
+                self._add_body(uid, body)
+
+    def apply_delta(self, scene_graph, delta):
+        """Update only nodes affected by a scene graph delta.
+
+        Arguments:
+            scene_graph {SceneGraph} -- scene description
+            delta {SceneGraphDelta} -- added, removed and changed nodes
+        """
+        # pixels rewritten in place are uploaded again with new textures, instanced groups
+        # with their next drawing
+        self._scene_graph = scene_graph
+        nodes = scene_graph.nodes
+        for uid in delta.texels_changed:
+            if uid in self._instanced:
+                node = self._group_nodes.pop(self._instanced[uid], None)
+                if node is not None:
+                    self.remove_node(node)
+            for index, mesh in self._shape_meshes.get(uid, {}).items():
+                material = self._make_material(nodes[uid].shapes[index].material)
+                for primitive in mesh.primitives:
+                    primitive.material = material
+        if delta.texels_only:
+            return
+
+        # colors and textures change in place, unless they may move nodes between groups or
+        # their meshes were deformed too
+        if delta.materials_only and not delta.geometry_changed and not self._instancing:
+            self._scene_graph = scene_graph
+            nodes = scene_graph.nodes
+            for uid in delta.changed:
+                for index, mesh in self._shape_meshes.get(uid, {}).items():
+                    material = self._make_material(nodes[uid].shapes[index].material)
+                    for primitive in mesh.primitives:
+                        primitive.material = material
+            return
+
+        # deformed meshes are rebuilt from their updated data
+        rebuilt = delta.changed | delta.geometry_changed
+        for uid in delta.removed | rebuilt:
+            self._remove_body(uid)
+
+        self._scene_graph = scene_graph
+        groups = instance_groups(scene_graph) if self._instancing else {}
+        instanced = {uid: group for group, ids in groups.items() for uid in ids}
+
+        # instanced meshes are rebuilt when their members change
+        for group in list(self._groups):
+            if groups.get(group) != self._groups[group]:
+                self._remove_group(group)
+        self._groups.update(groups)
+
+        # nodes joining a group are not drawn on their own any more, leaving ones are drawn again
+        for uid in instanced.keys() - self._instanced.keys():
+            self._remove_body(uid)
+        left = self._instanced.keys() - instanced.keys() - delta.removed
+        self._instanced = instanced
+
+        nodes = scene_graph.nodes
+        for uid in (delta.added | rebuilt | left) - instanced.keys():
+            self._add_body(uid, nodes[uid])
+
+    def _remove_body(self, uid):
+        """Remove a body node with all its shapes.
+
+        Arguments:
+            uid {int} -- unique node id
+        """
+        self._shape_meshes.pop(uid, None)
+        node = self._bullet_nodes.pop(uid, None)
+        if node is not None:
+            for mesh_node in self.get_children(node):
+                self._seg_node_map.pop(mesh_node, None)
+            self.remove_node(node)
+
+    def _add_body(self, uid, body):
+        """Append a body node with all its shapes.
+
+        Arguments:
+            uid {int} -- unique node id
+            body {Node} -- node description
+        """
+        node = pyr.Node(uid)
+        self.add_node(node)
+        self._bullet_nodes[uid] = node
+        meshes = self._shape_meshes[uid] = {}
+        mode = self._scene_graph.segmentation_mode
+
+        for index, shape in enumerate(body.shapes):
+            if shape.mesh is None:
+                mesh = primitive_mesh(shape)
+            else:
+                mesh = load_trimesh(shape.mesh)
+
+            mesh = pyr.Mesh.from_trimesh(mesh, material=self._make_material(shape.material))
+            mesh_node = self.add(mesh, pose=shape.pose.matrix.T, parent_node=node)
+            meshes[index] = mesh
+            self._seg_node_map[mesh_node] = mask_value_to_rgb(body.segmentation(index, mode))
+
+    def _remove_group(self, group):
+        """Remove an instance group.
+
+        Arguments:
+            group {int} -- instance group id
+        """
+        self._groups.pop(group, None)
+        node = self._group_nodes.pop(group, None)
+        if node is not None:
+            self.remove_node(node)
+
+    def _update_group(self, group, scene_state):
+        """Draw an instance group with one instanced mesh at the current poses.
+
+        Instance poses are baked into the mesh, so that it is rebuilt as members move.
+
+        Arguments:
+            group {int} -- instance group id
+            scene_state {SceneState} -- transformations of all objects in the scene
+        """
+        node = self._group_nodes.pop(group, None)
+        if node is not None:
+            self.remove_node(node)
+
+        ids = self._groups[group]
+        poses = BaseRenderer.instance_matrices(self._scene_graph, scene_state, ids)
+        if len(poses) == 0:
+            return
+
+        shape = self._scene_graph.nodes[ids[0]].shapes[0]
+        mesh = primitive_mesh(shape) if shape.mesh is None else load_trimesh(shape.mesh)
+        mesh = pyr.Mesh.from_trimesh(mesh,
+                                     material=self._make_material(shape.material),
+                                     poses=np.transpose(poses, (0, 2, 1)))
+        self._group_nodes[group] = self.add(mesh)
+
+    @staticmethod
+    def _make_material(material):
+        """Convert a material description.
+
+        Arguments:
+            material {Material} -- material description, may be None
+
+        Returns:
+            pyr.Material -- material, None if no description
+        """
+        if material is None:
+            return None
+
+        result = pyr.MetallicRoughnessMaterial(
+            baseColorFactor=material.diffuse_color,
+            metallicFactor=0.2,
+            roughnessFactor=0.8,
+            alphaMode='BLEND' if material.transparent else 'OPAQUE')
+        texture = material.diffuse_texture
+        if texture is not None:
+            result.baseColorTexture = _load_texture(texture)
+        return result
 
     def update_state(self, scene_state):
         """Apply scene state.
 
+        Only nodes moved since the previous frame are updated.
+
         Arguments:
             scene_state {SceneState} -- transformations of all objects in the scene
         """
-        for uid, node in self._bullet_nodes.items():
-            self.set_pose(node, scene_state.pose(uid).matrix.T)
+        ids, matrices = scene_state.ids, scene_state.matrices
+        moved = np.flatnonzero(scene_state.dirty)
+        for i in moved:
+            node = self._bullet_nodes.get(ids[i])
+            if node is not None:
+                self.set_pose(node, matrices[i].T)
+
+        # groups added since the previous frame or with moved members
+        stale = {group for group in self._groups if group not in self._group_nodes}
+        stale.update(self._instanced[uid] for uid in ids[moved] if uid in self._instanced)
+        for group in stale:
+            self._update_group(group, scene_state)
 
     def update_view(self, scene_view):
         """Apply scene state.
@@ -258,10 +597,14 @@ class Scene(pyr.Scene):
             self._light_node.light.color = scene_view.light.diffuse_color
             self._light_node.translation = scene_view.light.position
 
-        if scene_view.camera is not None:
-            yfov, znear, zfar, aspect = decompose(scene_view.camera.projection_matrix)
-            self._camera_node.camera.yfov = yfov
-            self._camera_node.camera.znear = znear
-            self._camera_node.camera.zfar = zfar
-            self._camera_node.camera.aspectRatio = aspect
-            self._camera_node.matrix = scene_view.camera.pose_matrix.T
+        camera = scene_view.camera
+        if camera is not None:
+            # the lens of a registered camera is set once while it renders
+            if camera.handle < 0 or camera.handle != self._lens_handle:
+                yfov, znear, zfar, aspect = camera.intrinsics
+                self._camera_node.camera.yfov = yfov
+                self._camera_node.camera.znear = znear
+                self._camera_node.camera.zfar = zfar
+                self._camera_node.camera.aspectRatio = aspect
+                self._lens_handle = camera.handle
+            self._camera_node.matrix = camera.pose_matrix.T
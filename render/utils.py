@@ -1,9 +1,14 @@
+import contextlib
+import os
+
 import numpy as np
 import trimesh
 
 import pybullet_rendering as pr
 
-__all__ = ('decompose', 'mask_to_rgb', 'rgb_to_mask', 'depth_from_zbuffer', 'primitive_mesh')
+__all__ = ('decompose', 'mask_to_rgb', 'mask_value_to_rgb', 'rgb_to_mask', 'depth_from_zbuffer',
+           'primitive_mesh', 'load_trimesh', 'instance_groups', 'lent_planes', 'asset_keyed_cache',
+           'evict_pruned_assets')
 
 
 def decompose(matrix):
@@ -38,19 +43,37 @@ def mask_to_rgb(body_id, link_id):
     return (body_id + 1) & 0x00ff, ((body_id + 1) & 0xff00) >> 8, link_id+1
 
 
-def rgb_to_mask(mask_rgb):
+def mask_value_to_rgb(value):
+    """Encode a segmentation mask value as a RGB color, as decoded by rgb_to_mask.
+
+    Values of SegmentationMode.BodyLink, or ids below 65535, are kept: bits 16 to 23 do not fit.
+
+    Arguments:
+        value {int} -- mask value, see Node.segmentation
+
+    Returns:
+        tuple -- RGB values
+    """
+    value += 1
+    return value & 0x00ff, (value & 0xff00) >> 8, (value >> 24) & 0xff
+
+
+def rgb_to_mask(mask_rgb, out=None):
     """Decode segmentation mask value from RGB image.
 
     Arguments:
         mask_rgb {ndarray} -- RGB-encoded segmentation image
 
+    Keyword Arguments:
+        out {ndarray} -- int32 array written in place, e.g. FrameData.mask_img (default: {None})
+
     Returns:
         ndarray -- segmentation mask
     """
-    return np.dot(mask_rgb, np.int32([1, 1 << 8, 1 << 24])) - 1
+    return pr.bindings.rgb_to_mask(mask_rgb, out)
 
 
-def depth_from_zbuffer(zbuffer, znear, zfar):
+def depth_from_zbuffer(zbuffer, znear, zfar, out=None):
     """Convert OpenGL Z-buffer values to metric depth.
 
     Arguments:
@@ -58,33 +81,184 @@ def depth_from_zbuffer(zbuffer, znear, zfar):
         znear {float} -- near z limit
         zfar {float} -- far z limit
 
+    Keyword Arguments:
+        out {ndarray} -- float32 array written in place, may be zbuffer itself or
+                         FrameData.depth_img (default: {None})
+
     Returns:
         ndarray -- metric depth
     """
-    if zbuffer.dtype != np.float32:
+    if zbuffer.dtype.kind in 'iu':
         zbuffer = np.divide(zbuffer, np.iinfo(zbuffer.dtype).max, dtype=np.float32)
+    return pr.bindings.depth_from_zbuffer(zbuffer, znear, zfar, out)
 
-    depth = np.zeros_like(zbuffer)
-    noninf = np.not_equal(zbuffer, 1.0)
-    depth[noninf] = znear * zfar / (zfar - zbuffer[noninf] * (zfar - znear))
-    return depth
+
+_primitive_cache = {}
 
 
 def primitive_mesh(shape):
     """Make primitive shape.
 
+    Primitives are tessellated natively, once per process for each set of dimensions,
+    heightfields at each call.
+
     Arguments:
         shape {Shape} -- primitive shape
+
+    Returns:
+        trimesh.Trimesh -- mesh, must not be modified, None if the shape is not a primitive
+    """
+    key = None if shape.heightfield is not None else (int(shape.type), tuple(shape.extents))
+    result = _primitive_cache.get(key)
+    if result is not None:
+        return result
+
+    data = pr.bindings.primitive_mesh(shape)
+    if data is None:
+        return None
+    result = trimesh.Trimesh(
+        vertices=data.vertices,
+        vertex_normals=data.normals,
+        faces=data.faces,
+        visual=trimesh.visual.TextureVisuals(uv=data.uvs),
+        process=False)
+    if key is not None:
+        _primitive_cache[key] = result
+    return result
+
+
+_asset_keyed_caches = []
+_asset_cache_revision = None
+
+
+def asset_keyed_cache():
+    """Make a dict of python objects made of assets, evicted with the asset cache.
+
+    Entries keyed by the asset id of a mesh or texture are kept until the asset cache drops it,
+    on prune_asset_cache, the asset_cache setting of a plugin or a clear; entries of other keys,
+    e.g. of assets out of the asset cache, at each prune. See evict_pruned_assets.
+
+    Returns:
+        dict -- asset id -> object
+    """
+    cache = {}
+    _asset_keyed_caches.append(cache)
+    return cache
+
+
+def evict_pruned_assets():
+    """Evict the entries of the asset keyed caches whose asset left the asset cache.
+
+    Only compares the prune revision of the asset cache unless it was pruned since the last call,
+    cheap enough to call before each lookup.
+    """
+    global _asset_cache_revision
+    if pr.bindings.asset_cache_revision() == _asset_cache_revision:
+        return
+    ids, _asset_cache_revision = pr.bindings.asset_cache_ids()
+    ids = set(ids)
+    for cache in _asset_keyed_caches:
+        for key in [key for key in cache if not isinstance(key, int) or key not in ids]:
+            del cache[key]
+
+
+_trimesh_cache = asset_keyed_cache()
+
+
+def _load_mesh_file(filename):
+    """Load a mesh file, parsed once per file content if the persistent mesh cache is enabled."""
+    if not pr.bindings.mesh_cache_directory():
+        return trimesh.load(filename, force='mesh')
+
+    data = pr.bindings.load_cached_mesh(filename, 'trimesh')
+    if data is not None:
+        return trimesh.Trimesh(
+            vertices=data.vertices,
+            vertex_normals=data.normals,
+            faces=data.faces,
+            visual=trimesh.visual.TextureVisuals(uv=data.uvs) if len(data.uvs) else None,
+            process=False)
+
+    result = trimesh.load(filename, force='mesh')
+    # colors of the file are not cached
+    if result.visual.kind in (None, 'texture'):
+        uvs = getattr(result.visual, 'uv', None)
+        pr.bindings.store_cached_mesh(filename, 'trimesh', result.vertices,
+                                      np.zeros((0, 2)) if uvs is None else uvs,
+                                      result.vertex_normals, result.faces)
+    return result
+
+
+def load_trimesh(mesh):
+    """Load a mesh description as a trimesh object.
+
+    Meshes with an asset id are loaded once per process and shared by all scenes, until the
+    asset cache drops them.
+
+    Arguments:
+        mesh {Mesh} -- mesh description
+
+    Returns:
+        trimesh.Trimesh -- mesh, must not be modified
+    """
+    evict_pruned_assets()
+    result = _trimesh_cache.get(mesh.asset_id) if mesh.asset_id >= 0 else None
+    if result is not None:
+        return result
+
+    if mesh.data is None:
+        result = _load_mesh_file(os.path.abspath(mesh.filename))
+        # mesh files learn their bounds once loaded, for view frustum culling
+        mesh.bounds = pr.AABB(*result.bounds)
+    else:
+        data = mesh.data
+        result = trimesh.Trimesh(
+            vertices=data.vertices,
+            vertex_normals=data.normals,
+            faces=data.faces,
+            visual=trimesh.visual.TextureVisuals(uv=data.uvs))
+
+    if mesh.asset_id >= 0:
+        _trimesh_cache[mesh.asset_id] = result
+    return result
+
+
+def instance_groups(scene_graph, min_count=2):
+    """Select instance groups worth an instanced draw.
+
+    Arguments:
+        scene_graph {SceneGraph} -- scene description
+
+    Keyword Arguments:
+        min_count {int} -- minimum number of nodes in a group (default: {2})
+
+    Returns:
+        dict -- group id -> ids of nodes sharing a mesh and a material
+    """
+    return {group: ids for group, ids in scene_graph.instance_groups.items()
+            if len(ids) >= min_count}
+
+
+@contextlib.contextmanager
+def lent_planes(frame):
+    """Lend read-only views of the planes of a frame, released when the with block exits.
+
+    The views share the memory bullet reads the image from once render_frame returns, so that
+    callbacks see the frame without another copy; keep a copy of what must outlive the block.
+    Views are memoryviews: using one after the block raises ValueError, and arrays made of a
+    view, e.g. by numpy.asarray, still referenced when the block exits make it raise BufferError.
+
+    Arguments:
+        frame {FrameData} -- output image buffer, already written
+
+    Yields:
+        tuple -- color, depth and mask views, None for planes not requested
     """
-    if pr.ShapeType.Cube == shape.type:
-        return trimesh.creation.box(extents=shape.extents)
-    elif pr.ShapeType.Cylinder == shape.type:
-        return trimesh.creation.cylinder(height=shape.height, radius=shape.radius)
-    elif pr.ShapeType.Plane == shape.type:
-        return trimesh.creation.box(extents=(10.0, 10.0, 0.0))
-    elif pr.ShapeType.Sphere == shape.type:
-        return trimesh.creation.uv_sphere(radius=shape.radius)
-    elif pr.ShapeType.Capsule == shape.type:
-        mesh = trimesh.creation.capsule(height=shape.height, radius=shape.radius)
-        mesh.vertices[:, 2] -= shape.height / 2.0
-        return mesh
+    views = tuple(None if plane is None else memoryview(plane).toreadonly()
+                  for plane in frame.planes)
+    try:
+        yield views
+    finally:
+        for view in views:
+            if view is not None:
+                view.release()
@@ -0,0 +1,166 @@
+# Copyright (c) 2019-2020 INRIA.
+# This source code is licensed under the LGPLv3 license found in the
+# LICENSE file in the root directory of this source tree.
+
+import multiprocessing
+import os
+import pickle
+from typing import Callable, Sequence
+
+import numpy as np
+
+from .bindings import BaseRenderer, FrameRecorder, SceneView
+
+
+class TrajectoryRecorder(BaseRenderer):
+    """Renderer recording the scene and the poses of each camera image request into a file.
+
+    The scene graph is written once, and again after each change, followed by the scene
+    state and view of each request. Rendering is forwarded to an optional renderer, otherwise
+    requests return empty images: a getCameraImage(1, 1) call per step then records a
+    trajectory at little cost, to re-render later with replay().
+    """
+
+    def __init__(self, path: str, renderer: BaseRenderer = None):
+        """Open the trajectory file.
+
+        Arguments:
+            path {str} -- trajectory file, overwritten
+
+        Keyword Arguments:
+            renderer {BaseRenderer} -- renderer drawing the requests (default: None)
+        """
+        super().__init__()
+        self._file = open(path, 'wb')
+        self._renderer = renderer
+        self._num_steps = 0
+
+    @property
+    def num_steps(self) -> int:
+        """Number of recorded steps."""
+        return self._num_steps
+
+    def update_scene(self, scene_graph, materials_only):
+        self._write('graph', self._num_steps, scene_graph)
+        if self._renderer is not None:
+            self._renderer.update_scene(scene_graph, materials_only)
+
+    def apply_scene_delta(self, scene_graph, delta):
+        self._write('graph', self._num_steps, scene_graph)
+        if self._renderer is not None:
+            self._renderer.apply_scene_delta(scene_graph, delta)
+
+    def render_frame(self, scene_state, scene_view, frame):
+        self._write('state', scene_state, scene_view)
+        self._num_steps += 1
+        if self._renderer is not None:
+            return self._renderer.render_frame(scene_state, scene_view, frame)
+        return False
+
+    def close(self):
+        """Close the trajectory file."""
+        if not self._file.closed:
+            self._file.close()
+
+    def _write(self, *record):
+        pickle.dump(record, self._file, pickle.HIGHEST_PROTOCOL)
+
+
+def load_trajectory(path: str):
+    """Read a trajectory written by a TrajectoryRecorder.
+
+    Arguments:
+        path {str} -- trajectory file
+
+    Returns:
+        tuple -- list of (first step, scene graph), list of (scene state, scene view) steps
+    """
+    graphs, steps = [], []
+    with open(path, 'rb') as file:
+        while True:
+            try:
+                record = pickle.load(file)
+            except EOFError:
+                break
+            if record[0] == 'graph':
+                graphs.append(record[1:])
+            else:
+                steps.append(record[1:])
+    return graphs, steps
+
+
+def replay(path: str, views: Sequence[SceneView], renderer_factory: Callable, directory: str,
+           num_workers: int = 1, chunk_frames: int = 64, compress: bool = True):
+    """Re-render a recorded trajectory from new views, on a pool of worker processes.
+
+    Bullet is not involved: each worker creates its renderer with renderer_factory(worker),
+    e.g. to pick the GPU of a worker, and renders one contiguous range of steps. Its frames
+    are written in the dataset layout of RenderingPlugin.start_recording, into the group
+    directory/part_<worker>, frame i * len(views) + v of a part being view v of its i-th step.
+
+    Arguments:
+        path {str} -- trajectory written by a TrajectoryRecorder
+        views {list} -- views of the same viewport to render at each step, those without light
+            take the light of the recorded view
+        renderer_factory {callable} -- picklable callable returning a renderer for a worker
+        directory {str} -- output directory, created if missing
+
+    Keyword Arguments:
+        num_workers {int} -- number of worker processes, 0 to render in this process
+            (default: 1)
+        chunk_frames {int} -- frames per chunk (default: 64)
+        compress {bool} -- LZ4 chunks (default: True)
+
+    Returns:
+        list -- (dataset directory, first step, number of steps) of each part
+    """
+    if len({tuple(view.viewport) for view in views}) > 1:
+        raise ValueError('All views must have the same viewport')
+    _, steps = load_trajectory(path)
+    os.makedirs(directory, exist_ok=True)
+    num_parts = max(min(num_workers, len(steps)), 1)
+    bounds = [len(steps) * i // num_parts for i in range(num_parts + 1)]
+    tasks = [(path, list(views), renderer_factory, i, bounds[i], bounds[i + 1],
+              os.path.join(directory, 'part_{}'.format(i)), chunk_frames, compress)
+             for i in range(num_parts)]
+
+    if num_workers <= 0:
+        return [_replay_part(task) for task in tasks]
+    # spawned workers do not inherit GPU contexts of this process
+    with multiprocessing.get_context('spawn').Pool(num_parts) as pool:
+        return pool.map(_replay_part, tasks)
+
+
+def _replay_part(task):
+    """Render steps [begin, end) of a trajectory into a dataset."""
+    path, views, renderer_factory, worker, begin, end, directory, chunk_frames, compress = task
+    graphs, steps = load_trajectory(path)
+    renderer = renderer_factory(worker)
+    # replayed frames wait for the writer instead of being dropped
+    recorder = FrameRecorder(directory, chunk_frames=chunk_frames, compress=compress,
+                             blocking=True)
+
+    graph_index = -1
+    for step in range(begin, end):
+        # loaded states have all their nodes dirty, as after a scene update
+        index = graph_index
+        while index + 1 < len(graphs) and graphs[index + 1][0] <= step:
+            index += 1
+        if index != graph_index:
+            renderer.update_scene(graphs[index][1], False)
+            graph_index = index
+
+        state, recorded_view = steps[step]
+        for view in views:
+            if view.light is None:
+                view = pickle.loads(pickle.dumps(view))
+                view.light = recorded_view.light
+            images = renderer.render_view(state, view)
+            color, depth, mask = images if images is not None else (None, None, None)
+            if color is None:
+                width, height = view.viewport
+                color = np.zeros((height, width, 4), np.uint8)
+            recorder.push(color, depth, mask, state, view.camera)
+
+    del recorder
+    return directory, begin, end - begin
@@ -37,6 +37,23 @@ def build_parser():
                         dest="build_tests",
                         action="store_true",
                         help="Build tests")
+    parser.add_argument("--with-egl",
+                        dest="with_egl",
+                        action="store_true",
+                        help="Build the native EGL renderer")
+    parser.add_argument("--with-cuda",
+                        dest="with_cuda",
+                        action="store_true",
+                        help="Let the native EGL renderer keep images on the GPU, "
+                        "requires --with-egl and the CUDA toolkit")
+    parser.add_argument("--with-tinyrenderer",
+                        dest="with_tinyrenderer",
+                        action="store_true",
+                        help="Build the native TinyRenderer backend, requires --bullet_dir")
+    parser.add_argument("--with-vulkan",
+                        dest="with_vulkan",
+                        action="store_true",
+                        help="Build the native headless Vulkan renderer, requires the Vulkan SDK")
     return parser
 
 
@@ -106,6 +123,14 @@ class CMakeBuild(build_ext):
 
         # cmake_args += ["-DBULLET_ROOT_PATH={}".format(args.bullet_dir)]
         cmake_args += ["-DBUILD_TEST={}".format("ON" if args.build_tests else "OFF")]
+        cmake_args += ["-DWITH_EGL={}".format("ON" if args.with_egl else "OFF")]
+        cmake_args += ["-DWITH_CUDA={}".format("ON" if args.with_cuda else "OFF")]
+        cmake_args += ["-DWITH_VULKAN={}".format("ON" if args.with_vulkan else "OFF")]
+        if args.with_tinyrenderer:
+            if not args.bullet_dir:
+                raise RuntimeError("--with-tinyrenderer requires a bullet source tree, "
+                                   "see --bullet_dir")
+            cmake_args += ["-DWITH_TINYRENDERER=ON", "-DBULLET_ROOT_PATH=" + args.bullet_dir]
 
         env = os.environ.copy()
         env["CXXFLAGS"] = '{} -DVERSION_INFO=\\"{}\\"'.format(env.get("CXXFLAGS", ""),
@@ -130,8 +130,12 @@ struct EGLRendererVisualShapeConverterInternalData
 	btAlignedObjectArray<unsigned char> m_rgbaPixelBuffer1;
 	btAlignedObjectArray<float> m_depthBuffer1;
 
-	btAlignedObjectArray<unsigned char> m_segmentationMaskSourceRgbaPixelBuffer;
-	btAlignedObjectArray<float> m_segmentationMaskSourceDepthBuffer;
+	// pixel pack buffers of the color, depth and segmentation reads, the two sets used in turn
+	// so that a read does not wait for the driver to release the buffers of the previous frame
+	GLuint m_readbackBuffers[2][3];
+	int m_readbackBufferSizes[2][3];
+	int m_readbackSet;
+	btAlignedObjectArray<int> m_sourceColumns;  // source column of each destination column
 
 	btAlignedObjectArray<int> m_graphicsIndexToSegmentationMask;
 	btHashMap<btHashInt, EGLRendererObjectArray*> m_swRenderInstances;
@@ -144,8 +148,6 @@ struct EGLRendererVisualShapeConverterInternalData
 	int m_upAxis;
 	int m_swWidth;
 	int m_swHeight;
-	btAlignedObjectArray<unsigned char> m_sourceRgbaPixelBuffer;
-	btAlignedObjectArray<float> m_sourceDepthBuffer;
 
 	TGAImage m_rgbColorBuffer;
 	b3AlignedObjectArray<MyTexture3> m_textures;
@@ -206,9 +208,12 @@ struct EGLRendererVisualShapeConverterInternalData
 		m_mouseMoveMultiplier(0.4f),
 		m_mouseXpos(0.f),
 		m_mouseYpos(0.f),
-		m_mouseInitialized(false)
+		m_mouseInitialized(false),
+		m_readbackSet(0)
 		
 	{
+		memset(m_readbackBuffers, 0, sizeof(m_readbackBuffers));
+		memset(m_readbackBufferSizes, 0, sizeof(m_readbackBufferSizes));
 		m_depthBuffer.resize(m_swWidth * m_swHeight);
 		m_shadowBuffer.resize(m_swWidth * m_swHeight);
 		m_segmentationMaskBuffer.resize(m_swWidth * m_swHeight, -1);
@@ -258,6 +263,7 @@ struct EGLRendererVisualShapeConverterInternalData
 
 	virtual ~EGLRendererVisualShapeConverterInternalData()
 	{
+		glDeleteBuffers(6, &m_readbackBuffers[0][0]);
 		delete m_instancingRenderer;
 		m_window->closeWindow();
 		delete m_window;
@@ -1539,6 +1545,38 @@ void EGLRendererVisualShapeConverter::setProjectiveTexture(bool useProjectiveTex
 }
 
 //copied from OpenGLGuiHelper.cpp
+// Queue a read of the framebuffer into a pixel pack buffer, grown as needed, returning at once
+static void readPixelsAsync(GLuint& buffer, int& capacity, int width, int height, GLenum format, GLenum type, int numBytes)
+{
+	if (!buffer)
+	{
+		glGenBuffers(1, &buffer);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+	if (capacity < numBytes)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, numBytes, 0, GL_STREAM_READ);
+		capacity = numBytes;
+	}
+	glReadPixels(0, 0, width, height, format, type, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Map the pixels of a read queued by readPixelsAsync, waiting for the transfer
+static const void* mapPixels(GLuint buffer, int numBytes)
+{
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+	const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, numBytes, GL_MAP_READ_BIT);
+	b3Assert(pixels);
+	return pixels;
+}
+
+static void unmapPixels()
+{
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
 void EGLRendererVisualShapeConverter::copyCameraImageDataGL(
 	unsigned char* pixelsRGBA, int rgbaBufferSizeInPixels,
 	float* depthBuffer, int depthBufferSizeInPixels,
@@ -1575,179 +1613,155 @@ void EGLRendererVisualShapeConverter::copyCameraImageDataGL(
 
 			m_data->m_instancingRenderer->renderScene();
 
-			int numBytesPerPixel = 4;  //RGBA
+			int numSourcePixels = sourceWidth * sourceHeight;
+			GLuint* buffers = m_data->m_readbackBuffers[m_data->m_readbackSet];
+			int* bufferSizes = m_data->m_readbackBufferSizes[m_data->m_readbackSet];
+			m_data->m_readbackSet = 1 - m_data->m_readbackSet;
 
-			if (pixelsRGBA || depthBuffer)
+			// reads of the main pass transfer while the segmentation pass draws, whose mask is
+			// background where the depth of the main pass, drawing the same geometry, is 1
 			{
+				BT_PROFILE("getScreenPixels");
+				if (pixelsRGBA)
+				{
+					readPixelsAsync(buffers[0], bufferSizes[0], sourceWidth, sourceHeight, GL_RGBA, GL_UNSIGNED_BYTE, numSourcePixels * numBytesPerPixel);
+				}
+				if (depthBuffer || segmentationMaskBuffer)
 				{
-					BT_PROFILE("copy pixels");
+					readPixelsAsync(buffers[1], bufferSizes[1], sourceWidth, sourceHeight, GL_DEPTH_COMPONENT, GL_FLOAT, numSourcePixels * sizeof(float));
+				}
+				b3Assert(glGetError() == GL_NO_ERROR);
+			}
+			if (segmentationMaskBuffer)
+			{
+				m_data->m_window->startRendering();
+				glViewport(0,0, sourceWidth*m_data->m_window->getRetinaScale(), sourceHeight*m_data->m_window->getRetinaScale());
+				BT_PROFILE("renderScene");
+				m_data->m_instancingRenderer->renderSceneInternal(B3_SEGMENTATION_MASK_RENDERMODE);
+				readPixelsAsync(buffers[2], bufferSizes[2], sourceWidth, sourceHeight, GL_RGBA, GL_UNSIGNED_BYTE, numSourcePixels * numBytesPerPixel);
+				b3Assert(glGetError() == GL_NO_ERROR);
+			}
+
+			// rescale and flip, by whole rows when the sizes match
+			bool sameSize = sourceWidth == destinationWidth && sourceHeight == destinationHeight;
+			btAlignedObjectArray<int>& sourceColumns = m_data->m_sourceColumns;
+			sourceColumns.resize(destinationWidth);
+			for (int i = 0; i < destinationWidth; i++)
+			{
+				int xIndex = int(float(i) * (float(sourceWidth) / float(destinationWidth)));
+				btClamp(xIndex, 0, sourceWidth - 1);
+				sourceColumns[i] = xIndex;
+			}
+			float rowScale = float(sourceHeight) / float(destinationHeight);
 
-					//copy the image into our local cache
-					m_data->m_sourceRgbaPixelBuffer.resize(sourceWidth * sourceHeight * numBytesPerPixel);
-					m_data->m_sourceDepthBuffer.resize(sourceWidth * sourceHeight);
+			if (pixelsRGBA)
+			{
+				BT_PROFILE("resize and flip rgba");
+				m_data->m_rgbaPixelBuffer1.resize(numTotalPixels * numBytesPerPixel);
+				const unsigned int* source = (const unsigned int*)mapPixels(buffers[0], numSourcePixels * numBytesPerPixel);
+				unsigned int* destination = (unsigned int*)&m_data->m_rgbaPixelBuffer1[0];
+				for (int j = 0; j < destinationHeight; j++)
+				{
+					int yIndex = int(float(destinationHeight - 1 - j) * rowScale);
+					btClamp(yIndex, 0, sourceHeight - 1);
+					const unsigned int* sourceRow = source + yIndex * sourceWidth;
+					unsigned int* destinationRow = destination + j * destinationWidth;
+					if (sameSize)
 					{
-						BT_PROFILE("getScreenPixels");
-						int rgbaBufferSizeInPixels = m_data->m_sourceRgbaPixelBuffer.size();
-						int depthBufferSizeInPixels = m_data->m_sourceDepthBuffer.size();
-						// Copied from SimpleOpenGL3App::getScreenPixels
-						b3Assert((sourceWidth * sourceHeight * 4) == rgbaBufferSizeInPixels);
-						//glClear(GL_COLOR_BUFFER_BIT);
-						//b3Warning("EGL\n");
-						if ((sourceWidth * sourceHeight * 4) == rgbaBufferSizeInPixels)  // remove this if
-						{
-							glReadPixels(0, 0, sourceWidth, sourceHeight, GL_RGBA, GL_UNSIGNED_BYTE, &(m_data->m_sourceRgbaPixelBuffer[0]));
-							int glstat;
-							glstat = glGetError();
-							b3Assert(glstat == GL_NO_ERROR);
-						}
-						if ((sourceWidth * sourceHeight) == depthBufferSizeInPixels)
-						{
-							glReadPixels(0, 0, sourceWidth, sourceHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &(m_data->m_sourceDepthBuffer[0]));
-							int glstat;
-							glstat = glGetError();
-							b3Assert(glstat == GL_NO_ERROR);
-						}
+						memcpy(destinationRow, sourceRow, destinationWidth * sizeof(unsigned int));
 					}
-				}
-			
-				m_data->m_rgbaPixelBuffer1.resize((*widthPtr) * (*heightPtr) * numBytesPerPixel);
-				m_data->m_depthBuffer1.resize((*widthPtr) * (*heightPtr));
-				//rescale and flip
-				{
-					BT_PROFILE("resize and flip");
-					for (int j = 0; j < *heightPtr; j++)
+					else
 					{
-						for (int i = 0; i < *widthPtr; i++)
+						for (int i = 0; i < destinationWidth; i++)
 						{
-							int xIndex = int(float(i) * (float(sourceWidth) / float(*widthPtr)));
-							int yIndex = int(float(*heightPtr - 1 - j) * (float(sourceHeight) / float(*heightPtr)));
-							btClamp(xIndex, 0, sourceWidth);
-							btClamp(yIndex, 0, sourceHeight);
-							int bytesPerPixel = 4;  //RGBA
-
-							int sourcePixelIndex = (xIndex + yIndex * sourceWidth) * bytesPerPixel;
-							int sourceDepthIndex = xIndex + yIndex * sourceWidth;
-	#define COPY4PIXELS 1
-	#ifdef COPY4PIXELS
-							int* dst = (int*)&m_data->m_rgbaPixelBuffer1[(i + j * (*widthPtr)) * 4 + 0];
-							int* src = (int*)&m_data->m_sourceRgbaPixelBuffer[sourcePixelIndex + 0];
-							*dst = *src;
-
-	#else
-							m_data->m_rgbaPixelBuffer1[(i + j * widthPtr) * 4 + 0] = sourceRgbaPixelBuffer[sourcePixelIndex + 0];
-							m_data->m_rgbaPixelBuffer1[(i + j * widthPtr) * 4 + 1] = sourceRgbaPixelBuffer[sourcePixelIndex + 1];
-							m_data->m_rgbaPixelBuffer1[(i + j * widthPtr) * 4 + 2] = sourceRgbaPixelBuffer[sourcePixelIndex + 2];
-							m_data->m_rgbaPixelBuffer1[(i + j * widthPtr) * 4 + 3] = 255;
-	#endif
-							if (depthBuffer)
-							{
-								m_data->m_depthBuffer1[i + j * (*widthPtr)] = m_data->m_sourceDepthBuffer[sourceDepthIndex];
-							}
+							destinationRow[i] = sourceRow[sourceColumns[i]];
 						}
 					}
 				}
+				unmapPixels();
 			}
 
-			if (segmentationMaskBuffer)
+			if (depthBuffer || segmentationMaskBuffer)
 			{
+				const float* sourceDepth = (const float*)mapPixels(buffers[1], numSourcePixels * sizeof(float));
+				if (depthBuffer)
 				{
-					m_data->m_window->startRendering();
-					glViewport(0,0, sourceWidth*m_data->m_window->getRetinaScale(), sourceHeight*m_data->m_window->getRetinaScale());
-					BT_PROFILE("renderScene");
-					m_data->m_instancingRenderer->renderSceneInternal(B3_SEGMENTATION_MASK_RENDERMODE);
-				}
-
-				{
-					BT_PROFILE("copy pixels");
-
-					//copy the image into our local cache
-					m_data->m_segmentationMaskSourceRgbaPixelBuffer.resize(sourceWidth * sourceHeight * numBytesPerPixel);
-					m_data->m_segmentationMaskSourceDepthBuffer.resize(sourceWidth * sourceHeight);
+					BT_PROFILE("resize and flip depth");
+					m_data->m_depthBuffer1.resize(numTotalPixels);
+					for (int j = 0; j < destinationHeight; j++)
 					{
-						BT_PROFILE("getScreenPixels");
+						int yIndex = int(float(destinationHeight - 1 - j) * rowScale);
+						btClamp(yIndex, 0, sourceHeight - 1);
+						const float* sourceRow = sourceDepth + yIndex * sourceWidth;
+						float* destinationRow = &m_data->m_depthBuffer1[j * destinationWidth];
+						if (sameSize)
 						{
-							glReadPixels(0, 0, sourceWidth, sourceHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &(m_data->m_segmentationMaskSourceDepthBuffer[0]));
-							int glstat;
-							glstat = glGetError();
-							b3Assert(glstat == GL_NO_ERROR);
+							memcpy(destinationRow, sourceRow, destinationWidth * sizeof(float));
 						}
+						else
 						{
-							glReadPixels(0, 0, sourceWidth, sourceHeight, GL_RGBA, GL_UNSIGNED_BYTE, &(m_data->m_segmentationMaskSourceRgbaPixelBuffer[0]));
-							int glstat;
-							glstat = glGetError();
-							b3Assert(glstat == GL_NO_ERROR);
+							for (int i = 0; i < destinationWidth; i++)
+							{
+								destinationRow[i] = sourceRow[sourceColumns[i]];
+							}
 						}
 					}
 				}
-				m_data->m_segmentationMaskBuffer.resize(destinationWidth * destinationHeight, -1);
-
-				//rescale and flip
+				if (segmentationMaskBuffer)
 				{
-					BT_PROFILE("resize and flip");
+					BT_PROFILE("resize and flip segmentation");
+					m_data->m_segmentationMaskBuffer.resize(numTotalPixels, -1);
+					// the depth stays mapped while the mask is, both pack buffers being distinct
+					const unsigned int* sourceMask = (const unsigned int*)mapPixels(buffers[2], numSourcePixels * numBytesPerPixel);
 					for (int j = 0; j < destinationHeight; j++)
 					{
+						int yIndex = int(float(destinationHeight - 1 - j) * rowScale);
+						btClamp(yIndex, 0, sourceHeight - 1);
+						const unsigned int* maskRow = sourceMask + yIndex * sourceWidth;
+						const float* depthRow = sourceDepth + yIndex * sourceWidth;
+						int* destinationRow = &m_data->m_segmentationMaskBuffer[j * destinationWidth];
+						// branchless, vectorized by the compiler: rgb of little endian texels
 						for (int i = 0; i < destinationWidth; i++)
 						{
-							int xIndex = int(float(i) * (float(sourceWidth) / float(destinationWidth)));
-							int yIndex = int(float(destinationHeight - 1 - j) * (float(sourceHeight) / float(destinationHeight)));
-							btClamp(xIndex, 0, sourceWidth);
-							btClamp(yIndex, 0, sourceHeight);
-							int bytesPerPixel = 4;  //RGBA
-							int sourcePixelIndex = (xIndex + yIndex * sourceWidth) * bytesPerPixel;
-							int sourceDepthIndex = xIndex + yIndex * sourceWidth;
-
-							if (segmentationMaskBuffer)
-							{
-								float depth = m_data->m_segmentationMaskSourceDepthBuffer[sourceDepthIndex];
-								if (depth < 1)
-								{
-									int segMask = m_data->m_segmentationMaskSourceRgbaPixelBuffer[sourcePixelIndex + 0] + 256 * (m_data->m_segmentationMaskSourceRgbaPixelBuffer[sourcePixelIndex + 1]) + 256 * 256 * (m_data->m_segmentationMaskSourceRgbaPixelBuffer[sourcePixelIndex + 2]);
-									m_data->m_segmentationMaskBuffer[i + j * destinationWidth] = segMask;
-								}
-								else
-								{
-									m_data->m_segmentationMaskBuffer[i + j * destinationWidth] = -1;
-								}
-							}
+							int x = sameSize ? i : sourceColumns[i];
+							int segMask = int(maskRow[x] & 0xffffff);
+							destinationRow[i] = depthRow[x] < 1 ? segMask : -1;
 						}
 					}
+					glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[1]);
 				}
+				unmapPixels();
 			}
 			glViewport(0, 0, m_data->m_window->getWidth() * m_data->m_window->getRetinaScale(), m_data->m_window->getHeight() * m_data->m_window->getRetinaScale());
 		}
 		if (pixelsRGBA)
 		{
 			BT_PROFILE("copy rgba pixels");
-			for (int i = 0; i < numRequestedPixels * numBytesPerPixel; i++)
-			{
-				pixelsRGBA[i] = m_data->m_rgbaPixelBuffer1[i + startPixelIndex * numBytesPerPixel];
-			}
+			memcpy(pixelsRGBA, &m_data->m_rgbaPixelBuffer1[startPixelIndex * numBytesPerPixel], numRequestedPixels * numBytesPerPixel);
 		}
 		if (depthBuffer)
 		{
 			BT_PROFILE("copy depth buffer pixels");
-			for (int i = 0; i < numRequestedPixels; i++)
-			{
-				depthBuffer[i] = m_data->m_depthBuffer1[i + startPixelIndex];
-			}
+			memcpy(depthBuffer, &m_data->m_depthBuffer1[startPixelIndex], numRequestedPixels * sizeof(float));
 		}
 		if (segmentationMaskBuffer)
 		{
 			BT_PROFILE("copy segmentation mask buffer pixels");
+			int numSegmentationMasks = m_data->m_graphicsIndexToSegmentationMask.size();
+			const int* graphicsIndexToSegmentationMask = numSegmentationMasks ? &m_data->m_graphicsIndexToSegmentationMask[0] : 0;
+			int objectMask = (m_data->m_flags & ER_SEGMENTATION_MASK_OBJECT_AND_LINKINDEX) ? -1 : ((1 << 24) - 1);
 			for (int i = 0; i < numRequestedPixels; i++)
 			{
 				int graphicsIndexSegMask = m_data->m_segmentationMaskBuffer[i + startPixelIndex];
 				int segMask = -1;
-				if (graphicsIndexSegMask >= 0 && graphicsIndexSegMask < m_data->m_graphicsIndexToSegmentationMask.size())
+				if (graphicsIndexSegMask >= 0 && graphicsIndexSegMask < numSegmentationMasks)
 				{
-					segMask = m_data->m_graphicsIndexToSegmentationMask[graphicsIndexSegMask];
+					segMask = graphicsIndexToSegmentationMask[graphicsIndexSegMask];
 				}
-				if ((m_data->m_flags & ER_SEGMENTATION_MASK_OBJECT_AND_LINKINDEX) == 0)
+				if (segMask >= 0)
 				{
-					if (segMask >= 0)
-					{
-						segMask &= ((1 << 24) - 1);
-					}
+					segMask &= objectMask;
 				}
 				segmentationMaskBuffer[i] = segMask;
 			}
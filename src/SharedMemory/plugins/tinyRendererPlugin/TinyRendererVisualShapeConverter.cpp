@@ -33,6 +33,7 @@ subject to the following restrictions:
 #include "../TinyRenderer/model.h"
 #include "stb_image/stb_image.h"
 #include "../OpenGLWindow/ShapeData.h"
+#include "LinearMath/btThreads.h"
 struct MyTexture2
 {
 	unsigned char* textureData1;
@@ -92,6 +93,8 @@ struct TinyRendererVisualShapeConverterInternalData
 	bool m_hasShadow;
 	int m_flags;
 	SimpleCamera m_camera;
+	int m_numThreads;  // threads rasterizing the objects, 0 for those of the task scheduler, 1 for the physics thread alone
+	btAlignedObjectArray<TinyRenderObjectData*> m_renderObjects;  // objects of the frame, in drawing order
 
 	TinyRendererVisualShapeConverterInternalData()
 		: m_upAxis(2),
@@ -111,7 +114,8 @@ struct TinyRendererVisualShapeConverterInternalData
 		m_lightSpecularCoeff(0.05),
 		m_hasLightSpecularCoeff(false),
 		m_hasShadow(false),
-		m_flags(0)
+		m_flags(0),
+		m_numThreads(0)
 	{
 		m_depthBuffer.resize(m_swWidth * m_swHeight);
 		m_shadowBuffer.resize(m_swWidth * m_swHeight);
@@ -123,6 +127,22 @@ struct TinyRendererVisualShapeConverterInternalData
 	}
 };
 
+// process-wide task scheduler of btParallelFor, multithreaded if Bullet is built with BT_THREADSAFE
+static btITaskScheduler* tinyRendererTaskScheduler()
+{
+	static btITaskScheduler* scheduler = 0;
+	if (0 == scheduler)
+	{
+		btITaskScheduler* taskScheduler = btCreateDefaultTaskScheduler();
+		if (taskScheduler)
+		{
+			btSetTaskScheduler(taskScheduler);
+		}
+		scheduler = btGetTaskScheduler();
+	}
+	return scheduler;
+}
+
 TinyRendererVisualShapeConverter::TinyRendererVisualShapeConverter()
 {
 	m_data = new TinyRendererVisualShapeConverterInternalData();
@@ -167,6 +187,11 @@ void TinyRendererVisualShapeConverter::setFlags(int flags)
 	m_data->m_flags = flags;
 }
 
+void TinyRendererVisualShapeConverter::setNumThreads(int numThreads)
+{
+	m_data->m_numThreads = btMax(numThreads, 0);
+}
+
 void TinyRendererVisualShapeConverter::setLightAmbientCoeff(float ambientCoeff)
 {
 	m_data->m_lightAmbientCoeff = ambientCoeff;
@@ -1046,6 +1071,7 @@ void TinyRendererVisualShapeConverter::updateShape(int shapeUniqueId, const btVe
 						norms[i].z = normal.z();
 					}
 				}
+				renderObj->invalidateTriangles();
 			}
 		}
 	}
@@ -1099,6 +1125,7 @@ void TinyRendererVisualShapeConverter::changeInstanceFlags(int bodyUniqueId, int
 					if (shapeIndex < 0 || q == shapeIndex)
 					{
 						visuals->m_renderObjects[q]->m_doubleSided = doubleSided;
+						visuals->m_renderObjects[q]->invalidateTriangles();
 					}
 				}
 			}
@@ -1310,6 +1337,7 @@ void TinyRendererVisualShapeConverter::render(const float viewMat[16], const flo
 		}
 	}
 
+	m_data->m_renderObjects.resize(0);
 	for (int n = 0; n < m_data->m_swRenderInstances.size(); n++)
 	{
 		TinyRendererObjectArray** visualArrayPtr = m_data->m_swRenderInstances.getAtIndex(n);
@@ -1341,8 +1369,28 @@ void TinyRendererVisualShapeConverter::render(const float viewMat[16], const flo
 			renderObj->m_lightAmbientCoeff = lightAmbientCoeff;
 			renderObj->m_lightDiffuseCoeff = lightDiffuseCoeff;
 			renderObj->m_lightSpecularCoeff = lightSpecularCoeff;
-			TinyRenderer::renderObject(*renderObj);
+			m_data->m_renderObjects.push_back(renderObj);
+		}
+	}
+
+	int numObjects = m_data->m_renderObjects.size();
+	if (m_data->m_numThreads == 1 || numObjects < 2)
+	{
+		for (int i = 0; i < numObjects; i++)
+		{
+			TinyRenderer::renderObject(*m_data->m_renderObjects[i]);
+		}
+	}
+	else
+	{
+		// triangles of all the objects binned into screen tiles, rasterized in parallel by btParallelFor, each tile
+		// drawing its objects in order so that the images match those drawn object by object
+		btITaskScheduler* scheduler = tinyRendererTaskScheduler();
+		if (m_data->m_numThreads > 0)
+		{
+			scheduler->setNumThreads(btMin(m_data->m_numThreads, scheduler->getMaxNumThreads()));
 		}
+		TinyRenderer::renderObjects(&m_data->m_renderObjects[0], numObjects);
 	}
 	//printf("write tga \n");
 	//m_data->m_rgbColorBuffer.write_tga_file("camera.tga");
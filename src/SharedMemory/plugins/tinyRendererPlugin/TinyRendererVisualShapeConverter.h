@@ -49,6 +49,10 @@ struct TinyRendererVisualShapeConverter : public UrdfRenderingInterface
 	virtual void setShadow(bool hasShadow);
 	virtual void setFlags(int flags);
 
+	// threads rasterizing the objects of a frame through btParallelFor, 0 for all those of the task scheduler, 1 to
+	// render on the calling thread alone
+	void setNumThreads(int numThreads);
+
 	virtual void copyCameraImageData(unsigned char* pixelsRGBA, int rgbaBufferSizeInPixels, float* depthBuffer, int depthBufferSizeInPixels, int* segmentationMaskBuffer, int segmentationMaskSizeInPixels, int startPixelIndex, int* widthPtr, int* heightPtr, int* numPixelsCopied);
 
 	virtual void render();
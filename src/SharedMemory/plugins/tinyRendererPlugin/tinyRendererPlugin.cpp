@@ -17,6 +17,7 @@ while (1):
 #include "../../SharedMemoryPublic.h"
 #include "../b3PluginContext.h"
 #include <stdio.h>
+#include <string.h>
 
 struct MyRendererPluginClass
 {
@@ -43,9 +44,16 @@ B3_SHARED_API int initPlugin_tinyRendererPlugin(struct b3PluginContext* context)
 	return SHARED_MEMORY_MAGIC_NUMBER;
 }
 
+// settings of the renderer, e.g. p.executePluginCommand(plugin, "numThreads", [4]) for 4 rasterizing threads, 0 for
+// those of the task scheduler and 1 for the physics thread alone
 B3_SHARED_API int executePluginCommand_tinyRendererPlugin(struct b3PluginContext* context, const struct b3PluginArguments* arguments)
 {
 	MyRendererPluginClass* obj = (MyRendererPluginClass*)context->m_userPointer;
+	if (strcmp(arguments->m_text, "numThreads") == 0 && arguments->m_numInts == 1)
+	{
+		obj->m_renderer.setNumThreads(arguments->m_ints[0]);
+		return 0;
+	}
 	if (obj->m_returnData==0)
 	{
 		obj->m_returnData = new b3UserDataValue();
@@ -11,16 +11,21 @@
 #include "Bullet3Common/b3Logging.h"
 #include "Bullet3Common/b3MinMax.h"
 #include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btThreads.h"
 #include "LinearMath/btVector3.h"
 #include "geometry.h"
 #include "model.h"
 #include "our_gl.h"
+#include "rasterizer.h"
 #include "tgaimage.h"
 
 using namespace TinyRender;
 
-struct DepthShader : public IShader
+// shaders are plain classes rather than IShader, so that shadeTriangle() calls their fragment method directly
+struct DepthShader
 {
+	float m_nearPlane;
+	float m_farPlane;
 	Model* m_model;
 	Matrix& m_modelMat;
 	Matrix m_invModelMat;
@@ -48,7 +53,7 @@ struct DepthShader : public IShader
 
 		m_invModelMat = m_modelMat.invert_transpose();
 	}
-	virtual Vec4f vertex(int iface, int nthvert)
+	Vec4f vertex(int iface, int nthvert)
 	{
 		Vec2f uv = m_model->uv(iface, nthvert);
 		varying_uv.set_col(nthvert, uv);
@@ -62,7 +67,7 @@ struct DepthShader : public IShader
 		return gl_Vertex;
 	}
 
-	virtual bool fragment(Vec3f bar, TGAColor& color)
+	bool fragment(Vec3f bar, TGAColor& color)
 	{
 		Vec4f p = varying_tri * bar;
 		color = TGAColor(255, 255, 255) * (p[2] / m_lightDistance);
@@ -70,8 +75,11 @@ struct DepthShader : public IShader
 	}
 };
 
-struct Shader : public IShader
+// fragments are shaded by ShaderVariant, specialized on the diffuse map and on the shadow buffer
+struct Shader
 {
+	float m_nearPlane;
+	float m_farPlane;
 	Model* m_model;
 	Vec3f m_light_dir_local;
 	Vec3f m_light_color;
@@ -96,6 +104,8 @@ struct Shader : public IShader
 
 	int m_index;
 
+	float m_textureLod;  // mip level of the diffuse texture for the current triangle, written by VS, read by FS
+
 	mat<2, 3, float> varying_uv;   // triangle uv coordinates, written by the vertex shader, read by the fragment shader
 	mat<4, 3, float> varying_tri;  // triangle coordinates (clip coordinates), written by VS, read by FS
 	mat<4, 3, float> varying_tri_light_view;
@@ -119,7 +129,8 @@ struct Shader : public IShader
 
 		  m_shadowBuffer(shadowBuffer),
 		  m_width(width),
-		  m_height(height)
+		  m_height(height),
+		  m_textureLod(0.f)
 
 	{
 		m_nearPlane = m_projectionMat.col(3)[2] / (m_projectionMat.col(2)[2] - 1);
@@ -129,7 +140,7 @@ struct Shader : public IShader
 		m_projectionModelViewMat = m_projectionMat * m_modelView1;
 		m_projectionLightViewMat = m_projectionMat * m_lightModelView;
 	}
-	virtual Vec4f vertex(int iface, int nthvert)
+	Vec4f vertex(int iface, int nthvert)
 	{
 		//B3_PROFILE("vertex");
 		Vec2f uv = m_model->uv(iface, nthvert);
@@ -145,23 +156,68 @@ struct Shader : public IShader
 		world_tri.set_col(nthvert, world_Vertex);
 		Vec4f gl_VertexLightView = m_projectionLightViewMat * embed<4>(scaledVert);
 		varying_tri_light_view.set_col(nthvert, gl_VertexLightView);
+		if (nthvert == 2)
+			updateTextureLod();
 		return gl_Vertex;
 	}
 
-	virtual bool fragment(Vec3f bar, TGAColor& color)
+	// select the diffuse mip level from the screen footprint of the triangle, the base level is used for
+	// triangles crossing the near plane
+	void updateTextureLod()
 	{
-		//B3_PROFILE("fragment");
-		Vec4f p = m_viewportMat * (varying_tri_light_view * bar);
-		float depth = p[2];
-		p = p / p[3];
+		m_textureLod = 0.f;
+		Vec2f uvs[3], xy[3];
+		for (int k = 0; k < 3; k++)
+		{
+			Vec4f p = m_viewportMat * varying_tri.col(k);
+			if (!(p[3] > 0.f))
+				return;
+			xy[k] = Vec2f(p[0] / p[3], p[1] / p[3]);
+			uvs[k] = varying_uv.col(k);
+		}
+		m_textureLod = m_model->diffuseLod(uvs, xy);
+	}
+
+	bool textured() const
+	{
+		return m_model->hasDiffuseTexture();
+	}
+
+	// inputs of the fragment stage only, which may change while the matrices are kept
+	void setLighting(Vec3f light_color, const Vec4f& colorRGBA, b3AlignedObjectArray<float>* shadowBuffer, float ambient_coefficient, float diffuse_coefficient, float specular_coefficient)
+	{
+		m_light_color = light_color;
+		m_colorRGBA = colorRGBA;
+		m_shadowBuffer = shadowBuffer;
+		m_ambient_coefficient = ambient_coefficient;
+		m_diffuse_coefficient = diffuse_coefficient;
+		m_specular_coefficient = specular_coefficient;
+	}
+
+	bool shadowed() const
+	{
+		return m_shadowBuffer && m_shadowBuffer->size();
+	}
 
-		float index_x = b3Max(float(0.0), b3Min(float(m_width - 1), p[0]));
-		float index_y = b3Max(float(0.0), b3Min(float(m_height - 1), p[1]));
-		int idx = int(index_x) + int(index_y) * m_width;                       // index in the shadowbuffer array
+	// fragment of the variant, Textured and Shadowed being textured() and shadowed()
+	template <bool Textured, bool Shadowed>
+	bool shade(Vec3f bar, TGAColor& color)
+	{
+		//B3_PROFILE("fragment");
 		float shadow = 1.0;
-		if (m_shadowBuffer && idx >=0 && idx <m_shadowBuffer->size())
+		if (Shadowed)
 		{
-			shadow = 0.8 + 0.2 * (m_shadowBuffer->at(idx) < -depth + 0.05);  // magic coeff to avoid z-fighting
+			Vec4f p = m_viewportMat * (varying_tri_light_view * bar);
+			float depth = p[2];
+			p = p / p[3];
+
+			float index_x = b3Max(float(0.0), b3Min(float(m_width - 1), p[0]));
+			float index_y = b3Max(float(0.0), b3Min(float(m_height - 1), p[1]));
+			int idx = int(index_x) + int(index_y) * m_width;  // index in the shadowbuffer array
+			if (idx >= 0 && idx < m_shadowBuffer->size())
+			{
+				shadow = 0.8 + 0.2 * (m_shadowBuffer->at(idx) < -depth + 0.05);  // magic coeff to avoid z-fighting
+			}
 		}
 		Vec3f bn = (varying_nrm * bar).normalize();
 		Vec2f uv = varying_uv * bar;
@@ -171,7 +227,7 @@ struct Shader : public IShader
                                     m_model->specular(uv));
         float diffuse = b3Max(0.f, bn * m_light_dir_local);
 
-        color = m_model->diffuse(uv);
+        color = Textured ? m_model->diffuse(uv, m_textureLod) : TGAColor(255, 255, 255, 255);
 		color[0] *= m_colorRGBA[0];
 		color[1] *= m_colorRGBA[1];
 		color[2] *= m_colorRGBA[2];
@@ -190,8 +246,74 @@ struct Shader : public IShader
 
 		return false;
 	}
+
+	// index of the ShaderVariant drawing the triangles of the object, see dispatchShaderVariant
+	int variant(bool writeMask) const
+	{
+		return (textured() ? 1 : 0) | (shadowed() ? 2 : 0) | (writeMask ? 4 : 0);
+	}
+};
+
+// Shader specialized at compile time, without branches on the diffuse map and the shadow buffer in the per pixel path
+template <bool Textured, bool Shadowed>
+struct ShaderVariant : public Shader
+{
+	explicit ShaderVariant(const Shader& shader) : Shader(shader) {}
+
+	bool fragment(Vec3f bar, TGAColor& color)
+	{
+		return shade<Textured, Shadowed>(bar, color);
+	}
 };
 
+// call body.run<Textured, Shadowed, WriteMask>() for a variant index of Shader::variant, so that the variant is
+// selected once per object
+template <class Body>
+static void dispatchShaderVariant(int variant, Body& body)
+{
+	switch (variant)
+	{
+		case 0:
+			body.template run<false, false, false>();
+			break;
+		case 1:
+			body.template run<true, false, false>();
+			break;
+		case 2:
+			body.template run<false, true, false>();
+			break;
+		case 3:
+			body.template run<true, true, false>();
+			break;
+		case 4:
+			body.template run<false, false, true>();
+			break;
+		case 5:
+			body.template run<true, false, true>();
+			break;
+		case 6:
+			body.template run<false, true, true>();
+			break;
+		default:
+			body.template run<true, true, true>();
+			break;
+	}
+}
+
+// viewport of the buffers of an object, mapping the top of the view to the last row or, if m_topRowFirst, to the
+// first one
+static Matrix objectViewport(const TinyRenderObjectData& renderData, int width, int height)
+{
+	Matrix viewportMatrix = viewport(0, 0, width, height);
+	if (renderData.m_topRowFirst)
+	{
+		// rows y are stored at height - 1 - y
+		viewportMatrix[1][3] = height - 1 - viewportMatrix[1][3];
+		viewportMatrix[1][1] = -viewportMatrix[1][1];
+	}
+	return viewportMatrix;
+}
+
 TinyRenderObjectData::TinyRenderObjectData(TGAImage& rgbColorBuffer, b3AlignedObjectArray<float>& depthBuffer, b3AlignedObjectArray<float>* shadowBuffer)
 	: m_model(0),
 	  m_rgbColorBuffer(rgbColorBuffer),
@@ -201,7 +323,10 @@ TinyRenderObjectData::TinyRenderObjectData(TGAImage& rgbColorBuffer, b3AlignedOb
 	  m_userData(0),
 	  m_userIndex(-1),
 	  m_objectIndex(-1),
-	  m_doubleSided(false)
+	  m_doubleSided(false),
+	  m_rgbaBuffer(0),
+	  m_topRowFirst(false),
+	  m_stage(0)
 {
 	Vec3f eye(1, 1, 3);
 	Vec3f center(0, 0, 0);
@@ -225,7 +350,10 @@ TinyRenderObjectData::TinyRenderObjectData(TGAImage& rgbColorBuffer, b3AlignedOb
 	  m_userIndex(-1),
 	  m_objectIndex(objectIndex),
 	  m_linkIndex(linkIndex),
-	  m_doubleSided(false)
+	  m_doubleSided(false),
+	  m_rgbaBuffer(0),
+	  m_topRowFirst(false),
+	  m_stage(0)
 {
 	Vec3f eye(1, 1, 3);
 	Vec3f center(0, 0, 0);
@@ -248,7 +376,10 @@ TinyRenderObjectData::TinyRenderObjectData(TGAImage& rgbColorBuffer, b3AlignedOb
 	  m_userData(0),
 	  m_userIndex(-1),
 	  m_objectIndex(-1),
-	m_doubleSided(false)
+	m_doubleSided(false),
+	m_rgbaBuffer(0),
+	m_topRowFirst(false),
+	m_stage(0)
 {
 	Vec3f eye(1, 1, 3);
 	Vec3f center(0, 0, 0);
@@ -271,7 +402,10 @@ TinyRenderObjectData::TinyRenderObjectData(TGAImage& rgbColorBuffer, b3AlignedOb
 	  m_userData(0),
 	  m_userIndex(-1),
 	  m_objectIndex(objectIndex),
-	m_doubleSided(false)
+	m_doubleSided(false),
+	m_rgbaBuffer(0),
+	m_topRowFirst(false),
+	m_stage(0)
 {
 	Vec3f eye(1, 1, 3);
 	Vec3f center(0, 0, 0);
@@ -428,17 +562,16 @@ void TinyRenderObjectData::createCube(float halfExtentsX, float halfExtentsY, fl
 	}
 }
 
-TinyRenderObjectData::~TinyRenderObjectData()
-{
-	delete m_model;
-}
-
 static bool equals(const Vec4f& vA, const Vec4f& vB)
 {
 	return false;
 }
 
-static void clipEdge(const mat<4, 3, float>& triangleIn, int vertexIndexA, int vertexIndexB, b3AlignedObjectArray<Vec4f>& vertices)
+// each of the 3 clipped edges adds at most 2 vertices, making a fan of at most 4 triangles
+static const int kMaxClippedVertices = 6;
+static const int kMaxClippedTriangles = kMaxClippedVertices - 2;
+
+static void clipEdge(const mat<4, 3, float>& triangleIn, int vertexIndexA, int vertexIndexB, Vec4f* vertices, int& numVertices)
 {
 	Vec4f v0New = triangleIn.col(vertexIndexA);
 	Vec4f v1New = triangleIn.col(vertexIndexB);
@@ -469,15 +602,16 @@ static void clipEdge(const mat<4, 3, float>& triangleIn, int vertexIndexA, int v
 		return;
 	}
 
-	if (vertices.size() == 0 || !(equals(vertices[vertices.size() - 1], v0New)))
+	if (numVertices == 0 || !(equals(vertices[numVertices - 1], v0New)))
 	{
-		vertices.push_back(v0New);
+		vertices[numVertices++] = v0New;
 	}
 
-	vertices.push_back(v1New);
+	vertices[numVertices++] = v1New;
 }
 
-static bool clipTriangleAgainstNearplane(const mat<4, 3, float>& triangleIn, b3AlignedObjectArray<mat<4, 3, float> >& clippedTrianglesOut)
+// clippedTrianglesOut must hold kMaxClippedTriangles triangles
+static bool clipTriangleAgainstNearplane(const mat<4, 3, float>& triangleIn, mat<4, 3, float>* clippedTrianglesOut, int& numClippedTrianglesOut)
 {
 	//discard triangle if all vertices are behind near-plane
 	if (triangleIn[3][0] < 0 && triangleIn[3][1] < 0 && triangleIn[3][2] < 0)
@@ -488,30 +622,28 @@ static bool clipTriangleAgainstNearplane(const mat<4, 3, float>& triangleIn, b3A
 	//accept triangle if all vertices are in front of the near-plane
 	if (triangleIn[3][0] >= 0 && triangleIn[3][1] >= 0 && triangleIn[3][2] >= 0)
 	{
-		clippedTrianglesOut.push_back(triangleIn);
+		clippedTrianglesOut[numClippedTrianglesOut++] = triangleIn;
 		return false;
 	}
 
-	Vec4f vtxCache[5];
-
-	b3AlignedObjectArray<Vec4f> vertices;
-	vertices.initializeFromBuffer(vtxCache, 0, 5);
-	clipEdge(triangleIn, 0, 1, vertices);
-	clipEdge(triangleIn, 1, 2, vertices);
-	clipEdge(triangleIn, 2, 0, vertices);
+	Vec4f vertices[kMaxClippedVertices];
+	int numVertices = 0;
+	clipEdge(triangleIn, 0, 1, vertices, numVertices);
+	clipEdge(triangleIn, 1, 2, vertices, numVertices);
+	clipEdge(triangleIn, 2, 0, vertices, numVertices);
 
-	if (vertices.size() < 3)
+	if (numVertices < 3)
 		return true;
 
-	if (equals(vertices[0], vertices[vertices.size() - 1]))
+	if (equals(vertices[0], vertices[numVertices - 1]))
 	{
-		vertices.pop_back();
+		numVertices--;
 	}
 
 	//create a fan of triangles
-	for (int i = 1; i < vertices.size() - 1; i++)
+	for (int i = 1; i < numVertices - 1; i++)
 	{
-		mat<4, 3, float>& vtx = clippedTrianglesOut.expand();
+		mat<4, 3, float>& vtx = clippedTrianglesOut[numClippedTrianglesOut++];
 		vtx.set_col(0, vertices[0]);
 		vtx.set_col(1, vertices[i]);
 		vtx.set_col(2, vertices[i + 1]);
@@ -519,11 +651,82 @@ static bool clipTriangleAgainstNearplane(const mat<4, 3, float>& triangleIn, b3A
 	return true;
 }
 
+// face loop of renderObject, for the shader variant of the object
+struct RenderFacesBody
+{
+	TinyRenderObjectData& m_renderData;
+	const Shader& m_shader;
+	float* m_zbuffer;
+	int* m_segmentationMaskBuffer;
+	btVector3 m_eye;
+
+	RenderFacesBody(TinyRenderObjectData& renderData, const Shader& shader, float* zbuffer, int* segmentationMaskBuffer, const btVector3& eye)
+		: m_renderData(renderData), m_shader(shader), m_zbuffer(zbuffer), m_segmentationMaskBuffer(segmentationMaskBuffer), m_eye(eye)
+	{
+	}
+
+	template <bool Textured, bool Shadowed, bool WriteMask>
+	void run()
+	{
+		if (m_renderData.m_rgbaBuffer)
+			draw<Textured, Shadowed, WriteMask>(*m_renderData.m_rgbaBuffer);
+		else
+			draw<Textured, Shadowed, WriteMask>(m_renderData.m_rgbColorBuffer);
+	}
+
+	template <bool Textured, bool Shadowed, bool WriteMask, class Image>
+	void draw(Image& image)
+	{
+		B3_PROFILE("face");
+		ShaderVariant<Textured, Shadowed> shader(m_shader);
+		TinyRenderObjectData& renderData = m_renderData;
+		Model* model = renderData.m_model;
+		const btVector3& P = m_eye;
+		int objectAndLinkIndex = renderData.m_objectIndex + ((renderData.m_linkIndex + 1) << 24);
+
+		for (int i = 0; i < model->nfaces(); i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				shader.vertex(i, j);
+			}
+
+			if (!renderData.m_doubleSided)
+			{
+				// backface culling
+				btVector3 v0(shader.world_tri.col(0)[0], shader.world_tri.col(0)[1], shader.world_tri.col(0)[2]);
+				btVector3 v1(shader.world_tri.col(1)[0], shader.world_tri.col(1)[1], shader.world_tri.col(1)[2]);
+				btVector3 v2(shader.world_tri.col(2)[0], shader.world_tri.col(2)[1], shader.world_tri.col(2)[2]);
+				btVector3 N = (v1 - v0).cross(v2 - v0);
+				if ((v0 - P).dot(N) >= 0)
+					continue;
+			}
+
+			mat<4, 3, float> clippedTriangles[kMaxClippedTriangles];
+			int numClippedTriangles = 0;
+			bool hasClipped = clipTriangleAgainstNearplane(shader.varying_tri, clippedTriangles, numClippedTriangles);
+
+			const int scissor[4] = {0, 0, renderData.frameWidth() - 1, renderData.frameHeight() - 1};
+			if (hasClipped)
+			{
+				for (int t = 0; t < numClippedTriangles; t++)
+				{
+					shadeTriangleClipped<ShaderVariant<Textured, Shadowed>, WriteMask>(clippedTriangles[t], shader.varying_tri, shader, image, m_zbuffer, m_segmentationMaskBuffer, renderData.m_viewportMatrix, objectAndLinkIndex, scissor);
+				}
+			}
+			else
+			{
+				shadeTriangle<ShaderVariant<Textured, Shadowed>, WriteMask>(shader.varying_tri, shader, image, m_zbuffer, m_segmentationMaskBuffer, renderData.m_viewportMatrix, objectAndLinkIndex, scissor);
+			}
+		}
+	}
+};
+
 void TinyRenderer::renderObject(TinyRenderObjectData& renderData)
 {
 	B3_PROFILE("renderObject");
-	int width = renderData.m_rgbColorBuffer.get_width();
-	int height = renderData.m_rgbColorBuffer.get_height();
+	int width = renderData.frameWidth();
+	int height = renderData.frameHeight();
 
 	Vec3f light_dir_local = Vec3f(renderData.m_lightDirWorld[0], renderData.m_lightDirWorld[1], renderData.m_lightDirWorld[2]);
 	Vec3f light_color = Vec3f(renderData.m_lightColor[0], renderData.m_lightColor[1], renderData.m_lightColor[2]);
@@ -535,14 +738,12 @@ void TinyRenderer::renderObject(TinyRenderObjectData& renderData)
 	if (model->getColorRGBA()[3] == 0)
 		return;
 
-	renderData.m_viewportMatrix = viewport(0, 0, width, height);
+	renderData.m_viewportMatrix = objectViewport(renderData, width, height);
 
 	b3AlignedObjectArray<float>& zbuffer = renderData.m_depthBuffer;
 	b3AlignedObjectArray<float>* shadowBufferPtr = renderData.m_shadowBuffer;
 	int* segmentationMaskBufferPtr = (renderData.m_segmentationMaskBufferPtr && renderData.m_segmentationMaskBufferPtr->size()) ? &renderData.m_segmentationMaskBufferPtr->at(0) : 0;
 
-	TGAImage& frame = renderData.m_rgbColorBuffer;
-
 	{
 		// light target is set to be the origin, and the up direction is set to be vertical up.
 		Matrix lightViewMatrix = lookat(light_dir_local * light_distance, Vec3f(0.0, 0.0, 0.0), Vec3f(0.0, 0.0, 1.0));
@@ -554,54 +755,599 @@ void TinyRenderer::renderObject(TinyRenderObjectData& renderData)
 
 		Shader shader(model, light_dir_local, light_color, modelViewMatrix, lightModelViewMatrix, renderData.m_projectionMatrix, renderData.m_modelMatrix, renderData.m_viewportMatrix, localScaling, model->getColorRGBA(), width, height, shadowBufferPtr, renderData.m_lightAmbientCoeff, renderData.m_lightDiffuseCoeff, renderData.m_lightSpecularCoeff);
 
+		RenderFacesBody body(renderData, shader, &zbuffer[0], segmentationMaskBufferPtr, P);
+		dispatchShaderVariant(shader.variant(segmentationMaskBufferPtr != 0), body);
+	}
+}
+
+// screen pixels covered by the clip space triangle clipc, {xmin, ymin, xmax, ymax}, false if none
+static bool screenBoundingBox(const mat<4, 3, float>& clipc, const Matrix& viewportMatrix, int width, int height, int bbox[4])
+{
+	mat<3, 4, float> screenSpacePts = (viewportMatrix * clipc).transpose();
+	float bboxmin[2] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+	float bboxmax[2] = {-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max()};
+	for (int k = 0; k < 3; k++)
+	{
+		Vec2f p = proj<2>(screenSpacePts[k] / screenSpacePts[k][3]);
+		for (int d = 0; d < 2; d++)
 		{
-			B3_PROFILE("face");
+			bboxmin[d] = b3Min(bboxmin[d], p[d]);
+			bboxmax[d] = b3Max(bboxmax[d], p[d]);
+		}
+	}
+	// NaN coordinates of degenerate triangles are binned nowhere
+	if (!(bboxmin[0] <= bboxmax[0] && bboxmin[1] <= bboxmax[1]) || bboxmax[0] < 0 || bboxmax[1] < 0 ||
+		bboxmin[0] > width - 1 || bboxmin[1] > height - 1)
+		return false;
 
-			for (int i = 0; i < model->nfaces(); i++)
+	bbox[0] = b3Max(0, int(bboxmin[0]));
+	bbox[1] = b3Max(0, int(bboxmin[1]));
+	bbox[2] = b3Min(width - 1, int(bboxmax[0]));
+	bbox[3] = b3Min(height - 1, int(bboxmax[1]));
+	return true;
+}
+
+// empty the first numBins bins, keeping their memory
+static void resetBins(b3AlignedObjectArray<b3AlignedObjectArray<int> >& bins, int numBins)
+{
+	if (bins.size() < numBins)
+		bins.resize(numBins);
+	for (int i = 0; i < numBins; i++)
+		bins[i].resize(0);
+}
+
+// append the (object, triangle) pairs overlapping each tile to its bin, in submission order, stages[i] being the
+// stage of object i
+template <class Stages>
+static void binTriangles(const Stages& stages, int numObjects, int tileSize, int tilesX, b3AlignedObjectArray<b3AlignedObjectArray<int> >& bins)
+{
+	B3_PROFILE("binning");
+	for (int i = 0; i < numObjects; i++)
+	{
+		for (int t = 0; t < stages[i].triangles.size(); t++)
+		{
+			const int* bbox = stages[i].triangles[t].bbox;
+			for (int ty = bbox[1] / tileSize; ty <= bbox[3] / tileSize; ty++)
 			{
-				for (int j = 0; j < 3; j++)
+				for (int tx = bbox[0] / tileSize; tx <= bbox[2] / tileSize; tx++)
 				{
-					shader.vertex(i, j);
+					b3AlignedObjectArray<int>& bin = bins[ty * tilesX + tx];
+					bin.push_back(i);
+					bin.push_back(t);
 				}
+			}
+		}
+	}
+}
 
-				if (!renderData.m_doubleSided)
-				{
-					// backface culling
-					btVector3 v0(shader.world_tri.col(0)[0], shader.world_tri.col(0)[1], shader.world_tri.col(0)[2]);
-					btVector3 v1(shader.world_tri.col(1)[0], shader.world_tri.col(1)[1], shader.world_tri.col(1)[2]);
-					btVector3 v2(shader.world_tri.col(2)[0], shader.world_tri.col(2)[1], shader.world_tri.col(2)[2]);
-					btVector3 N = (v1 - v0).cross(v2 - v0);
-					if ((v0 - P).dot(N) >= 0)
-						continue;
-				}
+// clipped triangle waiting for rasterization, with the varyings of the shader that transformed it
+struct BinnedTriangle
+{
+	mat<4, 3, float> clipc;     // clip coordinates to rasterize
+	mat<4, 3, float> orgClipc;  // clip coordinates before near plane clipping, used for interpolation
+	mat<2, 3, float> uv;
+	mat<3, 3, float> nrm;
+	mat<4, 3, float> lightView;
+	float textureLod;
+	bool clipped;
+	int bbox[4];  // screen pixels covered, {xmin, ymin, xmax, ymax}
+};
+
+static bool sameMatrix(const Matrix& a, const Matrix& b)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			if (a[i][j] != b[i][j])
+				return false;
+		}
+	}
+	return true;
+}
+
+// per object state shared by the stages of renderObjects, owned by the object: its triangles, the shader matrices
+// (model view projection, normal and light space ones) included, are those of the last call, transformed again
+// only when the inputs they were computed from change
+struct TinyRenderObjectStage
+{
+	Matrix lightModelViewMatrix;
+	Matrix modelViewMatrix;
+	Shader* shader;
+	b3AlignedObjectArray<BinnedTriangle> triangles;
+
+	// inputs of the triangles, valid is false until they are computed
+	bool valid;
+	Model* model;
+	Matrix modelMatrix;
+	Matrix viewMatrix;
+	Matrix projectionMatrix;
+	btVector3 localScaling;
+	btVector3 lightDirWorld;
+	float lightDistance;
+	int width;
+	int height;
+	bool topRowFirst;
+	bool doubleSided;
+
+	TinyRenderObjectStage() : shader(0), valid(false) {}
+	~TinyRenderObjectStage() { delete shader; }
+
+	bool matches(const TinyRenderObjectData& renderData, int frameWidth, int frameHeight) const
+	{
+		return valid && model == renderData.m_model && sameMatrix(modelMatrix, renderData.m_modelMatrix) &&
+			   sameMatrix(viewMatrix, renderData.m_viewMatrix) && sameMatrix(projectionMatrix, renderData.m_projectionMatrix) &&
+			   localScaling == renderData.m_localScaling && lightDirWorld == renderData.m_lightDirWorld &&
+			   lightDistance == renderData.m_lightDistance && width == frameWidth && height == frameHeight &&
+			   topRowFirst == renderData.m_topRowFirst && doubleSided == renderData.m_doubleSided;
+	}
+
+	void setInputs(const TinyRenderObjectData& renderData, int frameWidth, int frameHeight)
+	{
+		valid = true;
+		model = renderData.m_model;
+		modelMatrix = renderData.m_modelMatrix;
+		viewMatrix = renderData.m_viewMatrix;
+		projectionMatrix = renderData.m_projectionMatrix;
+		localScaling = renderData.m_localScaling;
+		lightDirWorld = renderData.m_lightDirWorld;
+		lightDistance = renderData.m_lightDistance;
+		width = frameWidth;
+		height = frameHeight;
+		topRowFirst = renderData.m_topRowFirst;
+		doubleSided = renderData.m_doubleSided;
+	}
+};
+
+TinyRenderObjectData::~TinyRenderObjectData()
+{
+	delete m_stage;
+	delete m_model;
+}
+
+void TinyRenderObjectData::invalidateTriangles()
+{
+	if (m_stage)
+		m_stage->valid = false;
+}
+
+// stages of the objects of a renderObjects call, indexed as the objects
+struct ObjectStages
+{
+	TinyRenderObjectData** m_renderData;
+
+	explicit ObjectStages(TinyRenderObjectData** renderData) : m_renderData(renderData) {}
+	TinyRenderObjectStage& operator[](int i) const { return *m_renderData[i]->m_stage; }
+};
+
+struct VertexStageBody : public btIParallelForBody
+{
+	TinyRenderObjectData** m_renderData;
+
+	explicit VertexStageBody(TinyRenderObjectData** renderData)
+		: m_renderData(renderData)
+	{
+	}
+
+	virtual void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			process(*m_renderData[i], *m_renderData[i]->m_stage);
+		}
+	}
 
-				mat<4, 3, float> stackTris[3];
+	static void process(TinyRenderObjectData& renderData, TinyRenderObjectStage& stage)
+	{
+		B3_PROFILE("vertexStage");
+		int width = renderData.frameWidth();
+		int height = renderData.frameHeight();
+
+		Vec3f light_dir_local = Vec3f(renderData.m_lightDirWorld[0], renderData.m_lightDirWorld[1], renderData.m_lightDirWorld[2]);
+		Vec3f light_color = Vec3f(renderData.m_lightColor[0], renderData.m_lightColor[1], renderData.m_lightColor[2]);
+		float light_distance = renderData.m_lightDistance;
+		Model* model = renderData.m_model;
+		//discard invisible objects (zero alpha)
+		if (0 == model || model->getColorRGBA()[3] == 0)
+		{
+			stage.triangles.resize(0);
+			stage.valid = false;
+			return;
+		}
+
+		renderData.m_viewportMatrix = objectViewport(renderData, width, height);
+
+		// unchanged triangles are only shaded with the current colors and light
+		if (stage.matches(renderData, width, height))
+		{
+			stage.shader->setLighting(light_color, model->getColorRGBA(), renderData.m_shadowBuffer, renderData.m_lightAmbientCoeff, renderData.m_lightDiffuseCoeff, renderData.m_lightSpecularCoeff);
+			return;
+		}
+		stage.setInputs(renderData, width, height);
+		stage.triangles.resize(0);
 
-				b3AlignedObjectArray<mat<4, 3, float> > clippedTriangles;
-				clippedTriangles.initializeFromBuffer(stackTris, 0, 3);
+		// light target is set to be the origin, and the up direction is set to be vertical up.
+		Matrix lightViewMatrix = lookat(light_dir_local * light_distance, Vec3f(0.0, 0.0, 0.0), Vec3f(0.0, 0.0, 1.0));
+		stage.lightModelViewMatrix = lightViewMatrix * renderData.m_modelMatrix;
+		stage.modelViewMatrix = renderData.m_viewMatrix * renderData.m_modelMatrix;
+		Vec3f localScaling(renderData.m_localScaling[0], renderData.m_localScaling[1], renderData.m_localScaling[2]);
+		Matrix viewMatrixInv = renderData.m_viewMatrix.invert();
+		btVector3 P(viewMatrixInv[0][3], viewMatrixInv[1][3], viewMatrixInv[2][3]);
 
-				bool hasClipped = clipTriangleAgainstNearplane(shader.varying_tri, clippedTriangles);
+		delete stage.shader;
+		stage.shader = new Shader(model, light_dir_local, light_color, stage.modelViewMatrix, stage.lightModelViewMatrix, renderData.m_projectionMatrix, renderData.m_modelMatrix, renderData.m_viewportMatrix, localScaling, model->getColorRGBA(), width, height, renderData.m_shadowBuffer, renderData.m_lightAmbientCoeff, renderData.m_lightDiffuseCoeff, renderData.m_lightSpecularCoeff);
+		Shader& shader = *stage.shader;
 
-				if (hasClipped)
+		stage.triangles.reserve(model->nfaces());
+		for (int i = 0; i < model->nfaces(); i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				shader.vertex(i, j);
+			}
+
+			if (!renderData.m_doubleSided)
+			{
+				// backface culling
+				btVector3 v0(shader.world_tri.col(0)[0], shader.world_tri.col(0)[1], shader.world_tri.col(0)[2]);
+				btVector3 v1(shader.world_tri.col(1)[0], shader.world_tri.col(1)[1], shader.world_tri.col(1)[2]);
+				btVector3 v2(shader.world_tri.col(2)[0], shader.world_tri.col(2)[1], shader.world_tri.col(2)[2]);
+				btVector3 N = (v1 - v0).cross(v2 - v0);
+				if ((v0 - P).dot(N) >= 0)
+					continue;
+			}
+
+			mat<4, 3, float> clippedTriangles[kMaxClippedTriangles];
+			int numClippedTriangles = 0;
+			bool hasClipped = clipTriangleAgainstNearplane(shader.varying_tri, clippedTriangles, numClippedTriangles);
+
+			for (int t = 0; t < numClippedTriangles; t++)
+			{
+				int bbox[4];
+				if (!screenBoundingBox(clippedTriangles[t], renderData.m_viewportMatrix, width, height, bbox))
+					continue;
+
+				BinnedTriangle& tri = stage.triangles.expand();
+				tri.clipc = clippedTriangles[t];
+				tri.orgClipc = shader.varying_tri;
+				tri.uv = shader.varying_uv;
+				tri.nrm = shader.varying_nrm;
+				tri.lightView = shader.varying_tri_light_view;
+				tri.textureLod = shader.m_textureLod;
+				tri.clipped = hasClipped;
+				for (int k = 0; k < 4; k++)
+					tri.bbox[k] = bbox[k];
+			}
+		}
+	}
+};
+
+struct TileStageBody : public btIParallelForBody
+{
+	TinyRenderObjectData** m_renderData;
+	ObjectStages m_stages;
+	const b3AlignedObjectArray<b3AlignedObjectArray<int> >& m_bins;  // triangles of each tile, object index in the high bits
+	int m_tileSize;
+	int m_tilesX;
+	int m_width;
+	int m_height;
+
+	TileStageBody(TinyRenderObjectData** renderData, const b3AlignedObjectArray<b3AlignedObjectArray<int> >& bins, int tileSize, int tilesX, int width, int height)
+		: m_renderData(renderData), m_stages(renderData), m_bins(bins), m_tileSize(tileSize), m_tilesX(tilesX), m_width(width), m_height(height)
+	{
+	}
+
+	virtual void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			process(i);
+		}
+	}
+
+	void process(int tile) const
+	{
+		B3_PROFILE("tileStage");
+		const b3AlignedObjectArray<int>& bin = m_bins[tile];
+		int scissor[4];
+		scissor[0] = (tile % m_tilesX) * m_tileSize;
+		scissor[1] = (tile / m_tilesX) * m_tileSize;
+		scissor[2] = b3Min(scissor[0] + m_tileSize, m_width) - 1;
+		scissor[3] = b3Min(scissor[1] + m_tileSize, m_height) - 1;
+
+		// farthest depth of the blocks of the tile, computed again when the depth buffer changes
+		static thread_local DepthBlocks depthBlocks;
+		depthBlocks.m_zbuffer = 0;
+
+		for (int i = 0; i < bin.size();)
+		{
+			TileObjectBody body(*this, bin, i, scissor, depthBlocks);
+			dispatchShaderVariant(m_stages[bin[i]].shader->variant(segmentationMaskBuffer(*m_renderData[bin[i]]) != 0), body);
+			i = body.m_end;
+		}
+	}
+
+	static int* segmentationMaskBuffer(TinyRenderObjectData& renderData)
+	{
+		return (renderData.m_segmentationMaskBufferPtr && renderData.m_segmentationMaskBufferPtr->size()) ? &renderData.m_segmentationMaskBufferPtr->at(0) : 0;
+	}
+
+	// consecutive triangles of an object in the bin of a tile, drawn with the shader variant of the object
+	struct TileObjectBody
+	{
+		const TileStageBody& m_stage;
+		const b3AlignedObjectArray<int>& m_bin;
+		int m_begin;
+		int m_end;  // set by run, first entry of the bin after the triangles of the object
+		const int* m_scissor;
+		DepthBlocks& m_depthBlocks;
+
+		TileObjectBody(const TileStageBody& stage, const b3AlignedObjectArray<int>& bin, int begin, const int scissor[4], DepthBlocks& depthBlocks)
+			: m_stage(stage), m_bin(bin), m_begin(begin), m_end(begin), m_scissor(scissor), m_depthBlocks(depthBlocks)
+		{
+		}
+
+		template <bool Textured, bool Shadowed, bool WriteMask>
+		void run()
+		{
+			TinyRenderObjectData& renderData = *m_stage.m_renderData[m_bin[m_begin]];
+			if (renderData.m_rgbaBuffer)
+				draw<Textured, Shadowed, WriteMask>(*renderData.m_rgbaBuffer);
+			else
+				draw<Textured, Shadowed, WriteMask>(renderData.m_rgbColorBuffer);
+		}
+
+		template <bool Textured, bool Shadowed, bool WriteMask, class Image>
+		void draw(Image& image)
+		{
+			// the shader of an object is copied on the stack so that tiles do not share varyings
+			int object = m_bin[m_begin];
+			ShaderVariant<Textured, Shadowed> shader(*m_stage.m_stages[object].shader);
+			TinyRenderObjectData& renderData = *m_stage.m_renderData[object];
+			b3AlignedObjectArray<float>& zbuffer = renderData.m_depthBuffer;
+			int* segmentationMaskBufferPtr = segmentationMaskBuffer(renderData);
+			int objectAndLinkIndex = renderData.m_objectIndex + ((renderData.m_linkIndex + 1) << 24);
+			if (m_depthBlocks.m_zbuffer != &zbuffer[0])
+				m_depthBlocks.reset(&zbuffer[0], renderData.frameWidth(), m_scissor);
+
+			int i = m_begin;
+			for (; i < m_bin.size() && m_bin[i] == object; i += 2)
+			{
+				BinnedTriangle& tri = m_stage.m_stages[object].triangles[m_bin[i + 1]];
+				shader.varying_uv = tri.uv;
+				shader.varying_nrm = tri.nrm;
+				shader.varying_tri = tri.orgClipc;
+				shader.varying_tri_light_view = tri.lightView;
+				shader.m_textureLod = tri.textureLod;
+
+				if (tri.clipped)
 				{
-					for (int t = 0; t < clippedTriangles.size(); t++)
-					{
-						triangleClipped(clippedTriangles[t], shader.varying_tri, shader, frame, &zbuffer[0], segmentationMaskBufferPtr, renderData.m_viewportMatrix, renderData.m_objectIndex + ((renderData.m_linkIndex + 1) << 24));
-					}
+					shadeTriangleClipped<ShaderVariant<Textured, Shadowed>, WriteMask>(tri.clipc, tri.orgClipc, shader, image, &zbuffer[0], segmentationMaskBufferPtr, renderData.m_viewportMatrix, objectAndLinkIndex, m_scissor, &m_depthBlocks);
 				}
 				else
 				{
-					triangle(shader.varying_tri, shader, frame, &zbuffer[0], segmentationMaskBufferPtr, renderData.m_viewportMatrix, renderData.m_objectIndex + ((renderData.m_linkIndex + 1) << 24));
+					shadeTriangle<ShaderVariant<Textured, Shadowed>, WriteMask>(tri.clipc, shader, image, &zbuffer[0], segmentationMaskBufferPtr, renderData.m_viewportMatrix, objectAndLinkIndex, m_scissor, &m_depthBlocks);
 				}
 			}
+			m_end = i;
+		}
+	};
+};
+
+void TinyRenderer::renderObjects(TinyRenderObjectData** renderData, int numObjects, int tileSize)
+{
+	B3_PROFILE("renderObjects");
+	if (numObjects <= 0 || tileSize <= 0)
+		return;
+
+	int width = renderData[0]->frameWidth();
+	int height = renderData[0]->frameHeight();
+
+	// per thread scratch memory, only growing so that rendering similar frames does not allocate
+	static thread_local b3AlignedObjectArray<b3AlignedObjectArray<int> > bins;
+
+	// transform, cull and clip the triangles of the objects which changed in parallel
+	for (int i = 0; i < numObjects; i++)
+	{
+		if (!renderData[i]->m_stage)
+			renderData[i]->m_stage = new TinyRenderObjectStage();
+	}
+	btParallelFor(0, numObjects, 1, VertexStageBody(renderData));
+
+	// bin triangles into tiles in submission order, so that each tile draws in the order of renderObject
+	int tilesX = (width + tileSize - 1) / tileSize;
+	int tilesY = (height + tileSize - 1) / tileSize;
+	resetBins(bins, tilesX * tilesY);
+	binTriangles(ObjectStages(renderData), numObjects, tileSize, tilesX, bins);
+
+	// rasterize tiles in parallel, tiles do not overlap so they never write the same pixel
+	btParallelFor(0, tilesX * tilesY, 1, TileStageBody(renderData, bins, tileSize, tilesX, width, height));
+}
+
+// clipped triangle of a depth only render
+struct DepthTriangle
+{
+	mat<4, 3, float> clipc;
+	bool clipped;
+	int bbox[4];
+};
+
+// per object state of renderObjectsDepthOnly, kept across calls to reuse its memory
+struct DepthObjectStage
+{
+	b3AlignedObjectArray<Vec4f> clipVertices;  // position stream, in clip coordinates
+	b3AlignedObjectArray<DepthTriangle> triangles;
+	float nearPlane;
+	float farPlane;
+};
+
+struct DepthVertexStageBody : public btIParallelForBody
+{
+	TinyRenderObjectData** m_renderData;
+	DepthObjectStage* m_stages;
+
+	DepthVertexStageBody(TinyRenderObjectData** renderData, DepthObjectStage* stages)
+		: m_renderData(renderData), m_stages(stages)
+	{
+	}
+
+	virtual void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			process(*m_renderData[i], m_stages[i]);
+		}
+	}
+
+	static void process(TinyRenderObjectData& renderData, DepthObjectStage& stage)
+	{
+		B3_PROFILE("depthVertexStage");
+		stage.triangles.resize(0);
+		int width = renderData.frameWidth();
+		int height = renderData.frameHeight();
+		Model* model = renderData.m_model;
+		if (0 == model || renderData.m_depthBuffer.size() == 0)
+			return;
+		//discard invisible objects (zero alpha)
+		if (model->getColorRGBA()[3] == 0)
+			return;
+
+		renderData.m_viewportMatrix = objectViewport(renderData, width, height);
+
+		const Matrix& projectionMatrix = renderData.m_projectionMatrix;
+		stage.nearPlane = projectionMatrix.col(3)[2] / (projectionMatrix.col(2)[2] - 1);
+		stage.farPlane = projectionMatrix.col(3)[2] / (projectionMatrix.col(2)[2] + 1);
+
+		// transform each vertex position once, normals and uvs are not needed
+		Matrix scaling = Matrix::identity();
+		for (int k = 0; k < 3; k++)
+			scaling[k][k] = renderData.m_localScaling[k];
+		Matrix projectionModelView = projectionMatrix * renderData.m_viewMatrix * renderData.m_modelMatrix * scaling;
+		stage.clipVertices.resize(model->nverts());
+		for (int v = 0; v < model->nverts(); v++)
+		{
+			stage.clipVertices[v] = projectionModelView * embed<4>(model->vert(v));
+		}
+
+		stage.triangles.reserve(model->nfaces());
+		for (int i = 0; i < model->nfaces(); i++)
+		{
+			const Vec3i* face = model->faceIndices(i);
+			mat<4, 3, float> clipc;
+			for (int j = 0; j < 3; j++)
+			{
+				clipc.set_col(j, stage.clipVertices[face[j][0]]);
+			}
+
+			if (!renderData.m_doubleSided && clipc[3][0] > 0 && clipc[3][1] > 0 && clipc[3][2] > 0)
+			{
+				// backface culling on the projected triangle winding
+				Vec2f p0(clipc[0][0] / clipc[3][0], clipc[1][0] / clipc[3][0]);
+				Vec2f p1(clipc[0][1] / clipc[3][1], clipc[1][1] / clipc[3][1]);
+				Vec2f p2(clipc[0][2] / clipc[3][2], clipc[1][2] / clipc[3][2]);
+				if ((p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y) <= 0)
+					continue;
+			}
+
+			mat<4, 3, float> clippedTriangles[kMaxClippedTriangles];
+			int numClippedTriangles = 0;
+			bool hasClipped = clipTriangleAgainstNearplane(clipc, clippedTriangles, numClippedTriangles);
+
+			for (int t = 0; t < numClippedTriangles; t++)
+			{
+				int bbox[4];
+				if (!screenBoundingBox(clippedTriangles[t], renderData.m_viewportMatrix, width, height, bbox))
+					continue;
+
+				DepthTriangle& tri = stage.triangles.expand();
+				tri.clipc = clippedTriangles[t];
+				tri.clipped = hasClipped;
+				for (int k = 0; k < 4; k++)
+					tri.bbox[k] = bbox[k];
+			}
+		}
+	}
+};
+
+struct DepthTileStageBody : public btIParallelForBody
+{
+	TinyRenderObjectData** m_renderData;
+	DepthObjectStage* m_stages;
+	const b3AlignedObjectArray<b3AlignedObjectArray<int> >& m_bins;
+	int m_tileSize;
+	int m_tilesX;
+	int m_width;
+	int m_height;
+
+	DepthTileStageBody(TinyRenderObjectData** renderData, DepthObjectStage* stages, const b3AlignedObjectArray<b3AlignedObjectArray<int> >& bins, int tileSize, int tilesX, int width, int height)
+		: m_renderData(renderData), m_stages(stages), m_bins(bins), m_tileSize(tileSize), m_tilesX(tilesX), m_width(width), m_height(height)
+	{
+	}
+
+	virtual void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			process(i);
 		}
 	}
+
+	void process(int tile) const
+	{
+		B3_PROFILE("depthTileStage");
+		const b3AlignedObjectArray<int>& bin = m_bins[tile];
+		int scissor[4];
+		scissor[0] = (tile % m_tilesX) * m_tileSize;
+		scissor[1] = (tile / m_tilesX) * m_tileSize;
+		scissor[2] = b3Min(scissor[0] + m_tileSize, m_width) - 1;
+		scissor[3] = b3Min(scissor[1] + m_tileSize, m_height) - 1;
+
+		static thread_local DepthBlocks depthBlocks;
+		depthBlocks.m_zbuffer = 0;
+
+		for (int i = 0; i < bin.size(); i += 2)
+		{
+			TinyRenderObjectData& renderData = *m_renderData[bin[i]];
+			DepthObjectStage& stage = m_stages[bin[i]];
+			DepthTriangle& tri = stage.triangles[bin[i + 1]];
+			// as in renderObject, only unclipped triangles are tested against the near and far planes
+			float nearPlane = tri.clipped ? std::numeric_limits<float>::max() : stage.nearPlane;
+			float farPlane = tri.clipped ? std::numeric_limits<float>::max() : stage.farPlane;
+			if (depthBlocks.m_zbuffer != &renderData.m_depthBuffer[0])
+				depthBlocks.reset(&renderData.m_depthBuffer[0], m_width, scissor);
+			triangleDepth(tri.clipc, &renderData.m_depthBuffer[0], m_width, renderData.m_viewportMatrix, scissor, nearPlane, farPlane, &depthBlocks);
+		}
+	}
+};
+
+void TinyRenderer::renderObjectsDepthOnly(TinyRenderObjectData** renderData, int numObjects, int tileSize)
+{
+	B3_PROFILE("renderObjectsDepthOnly");
+	if (numObjects <= 0 || tileSize <= 0)
+		return;
+
+	int width = renderData[0]->frameWidth();
+	int height = renderData[0]->frameHeight();
+
+	static thread_local b3AlignedObjectArray<DepthObjectStage> stages;
+	static thread_local b3AlignedObjectArray<b3AlignedObjectArray<int> > bins;
+
+	if (stages.size() < numObjects)
+		stages.resize(numObjects);
+	btParallelFor(0, numObjects, 1, DepthVertexStageBody(renderData, &stages[0]));
+
+	int tilesX = (width + tileSize - 1) / tileSize;
+	int tilesY = (height + tileSize - 1) / tileSize;
+	resetBins(bins, tilesX * tilesY);
+	binTriangles(&stages[0], numObjects, tileSize, tilesX, bins);
+
+	btParallelFor(0, tilesX * tilesY, 1, DepthTileStageBody(renderData, &stages[0], bins, tileSize, tilesX, width, height));
 }
 
 void TinyRenderer::renderObjectDepth(TinyRenderObjectData& renderData)
 {
-	int width = renderData.m_rgbColorBuffer.get_width();
-	int height = renderData.m_rgbColorBuffer.get_height();
+	int width = renderData.frameWidth();
+	int height = renderData.frameHeight();
 
 	Vec3f light_dir_local = Vec3f(renderData.m_lightDirWorld[0], renderData.m_lightDirWorld[1], renderData.m_lightDirWorld[2]);
 	float light_distance = renderData.m_lightDistance;
@@ -609,12 +1355,13 @@ void TinyRenderer::renderObjectDepth(TinyRenderObjectData& renderData)
 	if (0 == model)
 		return;
 
-	renderData.m_viewportMatrix = viewport(0, 0, width, height);
+	renderData.m_viewportMatrix = objectViewport(renderData, width, height);
 
 	float* shadowBufferPtr = (renderData.m_shadowBuffer && renderData.m_shadowBuffer->size()) ? &renderData.m_shadowBuffer->at(0) : 0;
-	int* segmentationMaskBufferPtr = 0;
+	if (0 == shadowBufferPtr)
+		return;
 
-	TGAImage depthFrame(width, height, TGAImage::RGB);
+	const int scissor[4] = {0, 0, width - 1, height - 1};
 
 	{
 		// light target is set to be the origin, and the up direction is set to be vertical up.
@@ -631,23 +1378,21 @@ void TinyRenderer::renderObjectDepth(TinyRenderObjectData& renderData)
 				shader.vertex(i, j);
 			}
 
-			mat<4, 3, float> stackTris[3];
-
-			b3AlignedObjectArray<mat<4, 3, float> > clippedTriangles;
-			clippedTriangles.initializeFromBuffer(stackTris, 0, 3);
-
-			bool hasClipped = clipTriangleAgainstNearplane(shader.varying_tri, clippedTriangles);
+			mat<4, 3, float> clippedTriangles[kMaxClippedTriangles];
+			int numClippedTriangles = 0;
+			bool hasClipped = clipTriangleAgainstNearplane(shader.varying_tri, clippedTriangles, numClippedTriangles);
 
+			// only depth is written, as in renderObjectsDepthOnly the clipped triangles are not tested against the near and far planes
 			if (hasClipped)
 			{
-				for (int t = 0; t < clippedTriangles.size(); t++)
+				for (int t = 0; t < numClippedTriangles; t++)
 				{
-					triangleClipped(clippedTriangles[t], shader.varying_tri, shader, depthFrame, shadowBufferPtr, segmentationMaskBufferPtr, renderData.m_viewportMatrix, renderData.m_objectIndex);
+					triangleDepth(clippedTriangles[t], shadowBufferPtr, width, renderData.m_viewportMatrix, scissor, std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
 				}
 			}
 			else
 			{
-				triangle(shader.varying_tri, shader, depthFrame, shadowBufferPtr, segmentationMaskBufferPtr, renderData.m_viewportMatrix, renderData.m_objectIndex);
+				triangleDepth(shader.varying_tri, shadowBufferPtr, width, renderData.m_viewportMatrix, scissor, shader.m_nearPlane, shader.m_farPlane);
 			}
 		}
 	}
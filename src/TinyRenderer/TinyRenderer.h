@@ -10,6 +10,31 @@
 
 #include "tgaimage.h"
 
+// RGBA pixels written by the renderer instead of a TGAImage, for instance the color plane of the caller, with an
+// opaque alpha. Rows are in the order of the other buffers, see TinyRenderObjectData::m_topRowFirst.
+struct TinyRenderRgbaImage
+{
+	unsigned char* m_pixels;
+	int m_width;
+	int m_height;
+
+	TinyRenderRgbaImage() : m_pixels(0), m_width(0), m_height(0) {}
+
+	int get_width() const { return m_width; }
+	int get_height() const { return m_height; }
+
+	bool set(int x, int y, const TGAColor& c)
+	{
+		// colors keep the byte order of the TGAImage buffer of TinyRenderer, that of its textures
+		unsigned char* p = m_pixels + (size_t(x) + size_t(y) * m_width) * 4;
+		p[0] = c.bgra[0];
+		p[1] = c.bgra[1];
+		p[2] = c.bgra[2];
+		p[3] = 255;
+		return true;
+	}
+};
+
 struct TinyRenderObjectData
 {
 	//Camera
@@ -54,6 +79,17 @@ struct TinyRenderObjectData
 	int m_objectIndex;
 	int m_linkIndex;
 	bool m_doubleSided;
+	TinyRenderRgbaImage* m_rgbaBuffer;  //optional, written instead of m_rgbColorBuffer by renderObjects and renderObject
+	bool m_topRowFirst;                 // buffers store the top row first rather than the bottom row, as TGA images
+	struct TinyRenderObjectStage* m_stage;  // transformed triangles of the last renderObjects call, null before
+
+	// forget the triangles transformed by renderObjects, after editing the vertices of m_model in place: they are
+	// otherwise reused while the matrices, the light and the size of the buffers are unchanged
+	void invalidateTriangles();
+
+	// size of the output buffers, that of m_rgbaBuffer if set
+	int frameWidth() { return m_rgbaBuffer ? m_rgbaBuffer->get_width() : m_rgbColorBuffer.get_width(); }
+	int frameHeight() { return m_rgbaBuffer ? m_rgbaBuffer->get_height() : m_rgbColorBuffer.get_height(); }
 };
 
 class TinyRenderer
@@ -61,6 +97,16 @@ class TinyRenderer
 public:
 	static void renderObjectDepth(TinyRenderObjectData& renderData);
 	static void renderObject(TinyRenderObjectData& renderData);
+
+	// render several objects at once: triangles are clipped and binned into square screen tiles, then tiles are
+	// rasterized in parallel with btParallelFor, each tile writing only its own pixels. Output buffers of all
+	// objects must have the same size, objects are drawn in order as with renderObject and appear once. Objects
+	// keep their transformed triangles and shader matrices for the next calls, see invalidateTriangles.
+	static void renderObjects(TinyRenderObjectData** renderData, int numObjects, int tileSize = 32);
+
+	// same as renderObjects, only writing the depth buffers: fragments are not shaded and neither the color nor
+	// the segmentation mask buffers are touched
+	static void renderObjectsDepthOnly(TinyRenderObjectData** renderData, int numObjects, int tileSize = 32);
 };
 
 #endif  // TINY_RENDERER_Hbla
@@ -51,11 +51,14 @@ Model::Model(const char *filename) : verts_(), faces_(), norms_(), uv_(), diffus
 				for (int i = 0; i < 3; i++) tmp[i]--;  // in wavefront obj all indices start at 1, not zero
 				f.push_back(tmp);
 			}
-			faces_.push_back(f);
+			// only the first three vertices of a face are rendered
+			if (f.size() >= 3)
+				faces_.insert(faces_.end(), f.begin(), f.begin() + 3);
 		}
 	}
-	std::cerr << "# v# " << verts_.size() << " f# " << faces_.size() << " vt# " << uv_.size() << " vn# " << norms_.size() << std::endl;
+	std::cerr << "# v# " << verts_.size() << " f# " << nfaces() << " vt# " << uv_.size() << " vn# " << norms_.size() << std::endl;
 	load_texture(filename, "_diffuse.tga", diffusemap_);
+	updateDiffuseTexture();
 	load_texture(filename, "_nm_tangent.tga", normalmap_);
 	load_texture(filename, "_spec.tga", specularmap_);
 }
@@ -82,11 +85,20 @@ void Model::setDiffuseTextureFromData(unsigned char *textureImage, int textureWi
 		B3_PROFILE("flip_vertically");
 		diffusemap_.flip_vertically();
 	}
+	updateDiffuseTexture();
 }
 
 void Model::loadDiffuseTexture(const char *relativeFileName)
 {
 	diffusemap_.read_tga_file(relativeFileName);
+	updateDiffuseTexture();
+}
+
+void Model::updateDiffuseTexture()
+{
+	B3_PROFILE("build mip levels");
+	diffuseTexture_.build(diffusemap_);
+	diffusemap_ = TGAImage();
 }
 
 void Model::reserveMemory(int numVertices, int numIndices)
@@ -107,11 +119,9 @@ void Model::addTriangle(int vertexposIndex0, int normalIndex0, int uvIndex0,
 						int vertexposIndex1, int normalIndex1, int uvIndex1,
 						int vertexposIndex2, int normalIndex2, int uvIndex2)
 {
-	std::vector<Vec3i> f;
-	f.push_back(Vec3i(vertexposIndex0, normalIndex0, uvIndex0));
-	f.push_back(Vec3i(vertexposIndex1, normalIndex1, uvIndex1));
-	f.push_back(Vec3i(vertexposIndex2, normalIndex2, uvIndex2));
-	faces_.push_back(f);
+	faces_.push_back(Vec3i(vertexposIndex0, normalIndex0, uvIndex0));
+	faces_.push_back(Vec3i(vertexposIndex1, normalIndex1, uvIndex1));
+	faces_.push_back(Vec3i(vertexposIndex2, normalIndex2, uvIndex2));
 }
 
 Model::~Model() {}
@@ -123,16 +133,16 @@ int Model::nverts()
 
 int Model::nfaces()
 {
-	return (int)faces_.size();
+	return (int)faces_.size() / 3;
 }
 
 std::vector<int> Model::face(int idx)
 {
 	std::vector<int> face;
-        face.reserve((int)faces_[idx].size());
-        for (int i = 0; i < (int)faces_[idx].size(); i++)
-          face.push_back(faces_[idx][i][0]);
-        return face;
+	face.reserve(3);
+	for (int i = 0; i < 3; i++)
+		face.push_back(faces_[idx * 3 + i][0]);
+	return face;
 }
 
 
@@ -143,7 +153,7 @@ Vec3f Model::vert(int i)
 
 Vec3f Model::vert(int iface, int nthvert)
 {
-	return verts_[faces_[iface][nthvert][0]];
+	return verts_[faces_[iface * 3 + nthvert][0]];
 }
 
 void Model::load_texture(std::string filename, const char *suffix, TGAImage &img)
@@ -160,25 +170,14 @@ void Model::load_texture(std::string filename, const char *suffix, TGAImage &img
 
 TGAColor Model::diffuse(Vec2f uvf)
 {
-	if (diffusemap_.get_width() && diffusemap_.get_height())
+	return diffuse(uvf, 0.f);
+}
+
+TGAColor Model::diffuse(Vec2f uvf, float lod)
+{
+	if (!diffuseTexture_.empty())
 	{
-		double val;
-		//		bool repeat = true;
-		//		if (repeat)
-		{
-			uvf[0] = std::modf(uvf[0], &val);
-			if (uvf[0] < 0) 
-			{
-				uvf[0] = uvf[0] + 1;
-			}
-			uvf[1] = std::modf(uvf[1], &val);
-			if (uvf[1] < 0) 
-			{
-				uvf[1] = uvf[1] + 1;
-			}
-		}
-        	Vec2i uv(uvf[0] * diffusemap_.get_width(), uvf[1] * diffusemap_.get_height());
-		return diffusemap_.get(uv[0], uv[1]);
+		return diffuseTexture_.sample(uvf, lod);
 	}
 	return TGAColor(255, 255, 255, 255);
 }
@@ -196,7 +195,7 @@ Vec3f Model::normal(Vec2f uvf)
 
 Vec2f Model::uv(int iface, int nthvert)
 {
-	return uv_[faces_[iface][nthvert][1]];
+	return uv_[faces_[iface * 3 + nthvert][1]];
 }
 
 float Model::specular(Vec2f uvf)
@@ -211,7 +210,7 @@ float Model::specular(Vec2f uvf)
 
 Vec3f Model::normal(int iface, int nthvert)
 {
-	int idx = faces_[iface][nthvert][2];
+	int idx = faces_[iface * 3 + nthvert][2];
 	return norms_[idx].normalize();
 }
 }
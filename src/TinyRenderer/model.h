@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include "geometry.h"
+#include "texture.h"
 #include "tgaimage.h"
 
 namespace TinyRender
@@ -11,15 +12,17 @@ class Model
 {
 private:
 	std::vector<Vec3f> verts_;
-	std::vector<std::vector<Vec3i> > faces_;  // attention, this Vec3i means vertex/uv/normal
+	std::vector<Vec3i> faces_;  // 3 per triangle, attention, this Vec3i means vertex/uv/normal
 	std::vector<Vec3f> norms_;
 	std::vector<Vec2f> uv_;
-	TGAImage diffusemap_;
+	TGAImage diffusemap_;  // staging image, released once converted to diffuseTexture_
+	MipTexture diffuseTexture_;
 	TGAImage normalmap_;
 	TGAImage specularmap_;
 	Vec4f m_colorRGBA;
 
 	void load_texture(std::string filename, const char* suffix, TGAImage& img);
+	void updateDiffuseTexture();
 
 public:
 	Model(const char* filename);
@@ -54,6 +57,11 @@ public:
 	Vec3f normal(Vec2f uv);
 	Vec3f vert(int i);
 	Vec3f vert(int iface, int nthvert);
+	// the 3 vertex/uv/normal indices of face iface, without copying them as face() does
+	const Vec3i* faceIndices(int iface) const
+	{
+		return &faces_[iface * 3];
+	}
 	Vec3f* readWriteVertices() 
 	{
 		if (verts_.size() == 0)
@@ -71,6 +79,18 @@ public:
 
 	Vec2f uv(int iface, int nthvert);
 	TGAColor diffuse(Vec2f uv);
+	// bilinear diffuse color in the mip level closest to lod
+	TGAColor diffuse(Vec2f uv, float lod);
+	// diffuse map level of detail for a triangle with texture coordinates uv and screen coordinates xy
+	float diffuseLod(const Vec2f uv[3], const Vec2f xy[3]) const
+	{
+		return diffuseTexture_.lod(uv, xy);
+	}
+	// a diffuse map is set, diffuse() returns white otherwise
+	bool hasDiffuseTexture() const
+	{
+		return !diffuseTexture_.empty();
+	}
 	float specular(Vec2f uv);
 	std::vector<int> face(int idx);
 };
@@ -1,8 +1,7 @@
 #include <cmath>
 #include <limits>
 #include <cstdlib>
-#include "our_gl.h"
-#include "Bullet3Common/b3MinMax.h"
+#include "rasterizer.h"
 
 namespace TinyRender
 {
@@ -82,82 +81,53 @@ Vec3d barycentric(Vec2f A1, Vec2f B1, Vec2f C1, Vec2f P1)
 	return Vec3d(-1., 1., 1.);  // in this case generate negative coordinates, it will be thrown away by the rasterizator
 }
 
-void triangleClipped(mat<4, 3, float> &clipc, mat<4, 3, float> &orgClipc, IShader &shader, TGAImage &image, float *zbuffer, const Matrix &viewPortMatrix)
+void DepthBlocks::reset(const float *zbuffer, int width, const int rect[4])
 {
-	triangleClipped(clipc, orgClipc, shader, image, zbuffer, 0, viewPortMatrix, 0);
+	m_zbuffer = zbuffer;
+	m_width = width;
+	for (int i = 0; i < 4; i++)
+		m_rect[i] = rect[i];
+	m_origin[0] = rect[0] - rect[0] % kDepthBlockSize;
+	m_origin[1] = rect[1] - rect[1] % kDepthBlockSize;
+	m_cols = b3Max(0, (rect[2] - m_origin[0]) / kDepthBlockSize + 1);
+	const int rows = b3Max(0, (rect[3] - m_origin[1]) / kDepthBlockSize + 1);
+	m_farthest.resize(m_cols * rows);
+	for (int y = m_origin[1]; y <= rect[3]; y += kDepthBlockSize)
+		for (int x = m_origin[0]; x <= rect[2]; x += kDepthBlockSize)
+			refresh(x, y);
 }
 
-void triangleClipped(mat<4, 3, float> &clipc, mat<4, 3, float> &orgClipc, IShader &shader, TGAImage &image, float *zbuffer, int *segmentationMaskBuffer, const Matrix &viewPortMatrix, int objectAndLinkIndex)
+void DepthBlocks::refresh(int x, int y)
 {
-	mat<3, 4, float> screenSpacePts = (viewPortMatrix * clipc).transpose();  // transposed to ease access to each of the points
-
-	mat<3, 2, float> pts2;
-	for (int i = 0; i < 3; i++)
-	{
-		pts2[i] = proj<2>(screenSpacePts[i] / screenSpacePts[i][3]);
-	}
-
-	Vec2f bboxmin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-	Vec2f bboxmax(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
-	Vec2f clamp(image.get_width() - 1, image.get_height() - 1);
-
-	for (int i = 0; i < 3; i++)
+	const int x0 = b3Max(x - x % kDepthBlockSize, m_rect[0]), x1 = b3Min(x - x % kDepthBlockSize + kDepthBlockSize - 1, m_rect[2]);
+	const int y0 = b3Max(y - y % kDepthBlockSize, m_rect[1]), y1 = b3Min(y - y % kDepthBlockSize + kDepthBlockSize - 1, m_rect[3]);
+	float farthestDepth = std::numeric_limits<float>::max();
+	for (int py = y0; py <= y1; py++)
 	{
-		for (int j = 0; j < 2; j++)
-		{
-			bboxmin[j] = b3Max(0.f, b3Min(bboxmin[j], pts2[i][j]));
-			bboxmax[j] = b3Min(clamp[j], b3Max(bboxmax[j], pts2[i][j]));
-		}
+		const float *row = m_zbuffer + py * m_width;
+		for (int px = x0; px <= x1; px++)
+			farthestDepth = b3Min(farthestDepth, row[px]);
 	}
+	farthest(x, y) = farthestDepth;
+}
 
-	Vec2i P;
-	TGAColor color;
-
-	mat<3, 4, float> orgScreenSpacePts = (viewPortMatrix * orgClipc).transpose();  // transposed to ease access to each of the points
+void triangleClipped(mat<4, 3, float> &clipc, mat<4, 3, float> &orgClipc, IShader &shader, TGAImage &image, float *zbuffer, const Matrix &viewPortMatrix)
+{
+	triangleClipped(clipc, orgClipc, shader, image, zbuffer, 0, viewPortMatrix, 0);
+}
 
-	mat<3, 2, float> orgPts2;
-	for (int i = 0; i < 3; i++)
-	{
-		orgPts2[i] = proj<2>(orgScreenSpacePts[i] / orgScreenSpacePts[i][3]);
-	}
+void triangleClipped(mat<4, 3, float> &clipc, mat<4, 3, float> &orgClipc, IShader &shader, TGAImage &image, float *zbuffer, int *segmentationMaskBuffer, const Matrix &viewPortMatrix, int objectAndLinkIndex)
+{
+	const int scissor[4] = {0, 0, image.get_width() - 1, image.get_height() - 1};
+	triangleClipped(clipc, orgClipc, shader, image, zbuffer, segmentationMaskBuffer, viewPortMatrix, objectAndLinkIndex, scissor);
+}
 
-	for (P.x = bboxmin.x; P.x <= bboxmax.x; P.x++)
-	{
-		for (P.y = bboxmin.y; P.y <= bboxmax.y; P.y++)
-		{
-			double frag_depth = 0;
-			{
-				Vec3d bc_screen = barycentric(pts2[0], pts2[1], pts2[2], P);
-				Vec3d bc_clip = Vec3d(bc_screen.x / screenSpacePts[0][3], bc_screen.y / screenSpacePts[1][3], bc_screen.z / screenSpacePts[2][3]);
-				bc_clip = bc_clip / (bc_clip.x + bc_clip.y + bc_clip.z);
-				Vec3d clipd(clipc[2].x, clipc[2].y, clipc[2].z);
-				frag_depth = -1. * (clipd * bc_clip);
-
-				if (bc_screen.x < 0 || bc_screen.y < 0 || bc_screen.z < 0 ||
-					zbuffer[P.x + P.y * image.get_width()] > frag_depth)
-					continue;
-			}
-
-			Vec3d bc_screen2 = barycentric(orgPts2[0], orgPts2[1], orgPts2[2], P);
-			Vec3d bc_clip2 = Vec3d(bc_screen2.x / orgScreenSpacePts[0][3], bc_screen2.y / orgScreenSpacePts[1][3], bc_screen2.z / orgScreenSpacePts[2][3]);
-			bc_clip2 = bc_clip2 / (bc_clip2.x + bc_clip2.y + bc_clip2.z);
-			Vec3d orgClipd(orgClipc[2].x, orgClipc[2].y, orgClipc[2].z);
-			double frag_depth2 = -1. * (orgClipd * bc_clip2);
-
-			Vec3f bc_clip2f(bc_clip2.x, bc_clip2.y, bc_clip2.z);
-			bool discard = shader.fragment(bc_clip2f, color);
-			
-			if (!discard)
-			{
-				zbuffer[P.x + P.y * image.get_width()] = frag_depth;
-				if (segmentationMaskBuffer)
-				{
-					segmentationMaskBuffer[P.x + P.y * image.get_width()] = objectAndLinkIndex;
-				}
-				image.set(P.x, P.y, color);
-			}
-		}
-	}
+void triangleClipped(mat<4, 3, float> &clipc, mat<4, 3, float> &orgClipc, IShader &shader, TGAImage &image, float *zbuffer, int *segmentationMaskBuffer, const Matrix &viewPortMatrix, int objectAndLinkIndex, const int scissor[4])
+{
+	if (segmentationMaskBuffer)
+		shadeTriangleClipped<IShader, true>(clipc, orgClipc, shader, image, zbuffer, segmentationMaskBuffer, viewPortMatrix, objectAndLinkIndex, scissor);
+	else
+		shadeTriangleClipped<IShader, false>(clipc, orgClipc, shader, image, zbuffer, 0, viewPortMatrix, objectAndLinkIndex, scissor);
 }
 
 void triangle(mat<4, 3, float> &clipc, IShader &shader, TGAImage &image, float *zbuffer, const Matrix &viewPortMatrix)
@@ -166,56 +136,32 @@ void triangle(mat<4, 3, float> &clipc, IShader &shader, TGAImage &image, float *
 }
 
 void triangle(mat<4, 3, float> &clipc, IShader &shader, TGAImage &image, float *zbuffer, int *segmentationMaskBuffer, const Matrix &viewPortMatrix, int objectAndLinkIndex)
+{
+	const int scissor[4] = {0, 0, image.get_width() - 1, image.get_height() - 1};
+	triangle(clipc, shader, image, zbuffer, segmentationMaskBuffer, viewPortMatrix, objectAndLinkIndex, scissor);
+}
+
+void triangle(mat<4, 3, float> &clipc, IShader &shader, TGAImage &image, float *zbuffer, int *segmentationMaskBuffer, const Matrix &viewPortMatrix, int objectAndLinkIndex, const int scissor[4])
+{
+	if (segmentationMaskBuffer)
+		shadeTriangle<IShader, true>(clipc, shader, image, zbuffer, segmentationMaskBuffer, viewPortMatrix, objectAndLinkIndex, scissor);
+	else
+		shadeTriangle<IShader, false>(clipc, shader, image, zbuffer, 0, viewPortMatrix, objectAndLinkIndex, scissor);
+}
+
+void triangleDepth(mat<4, 3, float> &clipc, float *zbuffer, int width, const Matrix &viewPortMatrix, const int scissor[4], float nearPlane, float farPlane, DepthBlocks *depthBlocks)
 {
 	mat<3, 4, float> pts = (viewPortMatrix * clipc).transpose();  // transposed to ease access to each of the points
 
 	mat<3, 2, float> pts2;
 	for (int i = 0; i < 3; i++) pts2[i] = proj<2>(pts[i] / pts[i][3]);
 
-	Vec2f bboxmin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-	Vec2f bboxmax(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
-	Vec2f clamp(image.get_width() - 1, image.get_height() - 1);
-
-	for (int i = 0; i < 3; i++)
-	{
-		for (int j = 0; j < 2; j++)
-		{
-			bboxmin[j] = b3Max(0.f, b3Min(bboxmin[j], pts2[i][j]));
-			bboxmax[j] = b3Min(clamp[j], b3Max(bboxmax[j], pts2[i][j]));
-		}
-	}
+	Vec2f bboxmin, bboxmax;
+	boundingBox(pts2, scissor, bboxmin, bboxmax);
 
-	Vec2i P;
-	TGAColor color;
-	for (P.x = bboxmin.x; P.x <= bboxmax.x; P.x++)
-	{
-		for (P.y = bboxmin.y; P.y <= bboxmax.y; P.y++)
-		{
-			Vec3d bc_screen = barycentric(pts2[0], pts2[1], pts2[2], P);
-			Vec3d bc_clip = Vec3d(bc_screen.x / pts[0][3], bc_screen.y / pts[1][3], bc_screen.z / pts[2][3]);
-			bc_clip = bc_clip / (bc_clip.x + bc_clip.y + bc_clip.z);
-			Vec3d clipd(clipc[2].x, clipc[2].y, clipc[2].z);
-			double frag_depth = -1. * (clipd * bc_clip);
-			if (bc_screen.x < 0 || bc_screen.y < 0 || bc_screen.z < 0 ||
-				zbuffer[P.x + P.y * image.get_width()] > frag_depth)
-				continue;
-			Vec3f bc_clipf(bc_clip.x, bc_clip.y, bc_clip.z);
-			bool discard = shader.fragment(bc_clipf, color);
-			if (frag_depth < -shader.m_farPlane)
-				discard = true;
-			if (frag_depth > shader.m_nearPlane)
-				discard = true;
-
-			if (!discard)
-			{
-				zbuffer[P.x + P.y * image.get_width()] = frag_depth;
-				if (segmentationMaskBuffer)
-				{
-					segmentationMaskBuffer[P.x + P.y * image.get_width()] = objectAndLinkIndex;
-				}
-				image.set(P.x, P.y, color);
-			}
-		}
-	}
+	rasterize(pts, pts2, clipc[2], zbuffer, width, bboxmin, bboxmax, [&](int x, int y, const Vec3f &, float frag_depth) {
+		if (frag_depth >= -farPlane && frag_depth <= nearPlane)
+			zbuffer[x + y * width] = frag_depth;
+	}, depthBlocks);
 }
 }
@@ -2,6 +2,7 @@
 #define __OUR_GL_H__
 #include "tgaimage.h"
 #include "geometry.h"
+#include <vector>
 
 namespace TinyRender
 {
@@ -18,10 +19,45 @@ struct IShader
 	virtual bool fragment(Vec3f bar, TGAColor &color) = 0;
 };
 
+// Farthest depth of the square blocks of the rasterizer inside a rectangle of a depth buffer, blocks being aligned on
+// multiples of their size and clipped to the rectangle. Depths only grow as the depth test keeps the nearest
+// fragments, so that a value not refreshed yet stays a lower bound: triangles skip the blocks whose farthest depth
+// is nearer than their nearest vertex, and refresh the blocks they write to.
+struct DepthBlocks
+{
+	const float *m_zbuffer;  // depth buffer of the blocks, null before reset
+	int m_width;             // of the depth buffer
+	int m_rect[4];           // inclusive rectangle {xmin, ymin, xmax, ymax}
+	int m_origin[2];         // first pixel of the first block
+	int m_cols;              // blocks per row
+	std::vector<float> m_farthest;
+
+	DepthBlocks() : m_zbuffer(0), m_width(0), m_cols(0) {}
+
+	// compute the blocks of the rectangle rect of zbuffer, keeping the memory of the previous ones
+	void reset(const float *zbuffer, int width, const int rect[4]);
+	// compute again the block of pixel (x, y)
+	void refresh(int x, int y);
+	float &farthest(int x, int y)
+	{
+		return m_farthest[(y - m_origin[1]) / kDepthBlockSize * m_cols + (x - m_origin[0]) / kDepthBlockSize];
+	}
+
+	static const int kDepthBlockSize = 8;  // side of the blocks, those of the rasterizer
+};
+
 void triangle(mat<4, 3, float> &pts, IShader &shader, TGAImage &image, float *zbuffer, const Matrix &viewPortMatrix);
 void triangle(mat<4, 3, float> &pts, IShader &shader, TGAImage &image, float *zbuffer, int *segmentationMaskBuffer, const Matrix &viewPortMatrix, int objectIndex);
 void triangleClipped(mat<4, 3, float> &clippedPts, mat<4, 3, float> &pts, IShader &shader, TGAImage &image, float *zbuffer, const Matrix &viewPortMatrix);
 void triangleClipped(mat<4, 3, float> &clippedPts, mat<4, 3, float> &pts, IShader &shader, TGAImage &image, float *zbuffer, int *segmentationMaskBuffer, const Matrix &viewPortMatrix, int objectIndex);
+
+// same as above, only writing pixels inside the inclusive rectangle scissor = {xmin, ymin, xmax, ymax}
+void triangle(mat<4, 3, float> &pts, IShader &shader, TGAImage &image, float *zbuffer, int *segmentationMaskBuffer, const Matrix &viewPortMatrix, int objectIndex, const int scissor[4]);
+void triangleClipped(mat<4, 3, float> &clippedPts, mat<4, 3, float> &pts, IShader &shader, TGAImage &image, float *zbuffer, int *segmentationMaskBuffer, const Matrix &viewPortMatrix, int objectIndex, const int scissor[4]);
+
+// only write the depth of pixels inside the scissor rectangle, without shading, discarding depths out of [-farPlane, nearPlane],
+// skipping the blocks of depthBlocks hidden if set
+void triangleDepth(mat<4, 3, float> &pts, float *zbuffer, int width, const Matrix &viewPortMatrix, const int scissor[4], float nearPlane, float farPlane, DepthBlocks *depthBlocks = 0);
 }
 
 #endif  //__OUR_GL_H__
@@ -0,0 +1,387 @@
+#ifndef __RASTERIZER_H__
+#define __RASTERIZER_H__
+#include <cmath>
+#include <limits>
+#include "our_gl.h"
+#include "Bullet3Common/b3MinMax.h"
+
+// the SIMD rasterizer is selected at compile time, define TINYRENDER_NO_SIMD to use the scalar one
+#if !defined(TINYRENDER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define TINYRENDER_SIMD_SSE2
+#elif !defined(TINYRENDER_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TINYRENDER_SIMD_NEON
+#endif
+
+namespace TinyRender
+{
+Vec3d barycentric(Vec2f A1, Vec2f B1, Vec2f C1, Vec2f P1);
+
+// Edge functions of a projected triangle in fixed point, vertices being snapped to 1 / 2^kSubPixelBits of a pixel.
+// Integer edge functions are exact, so that pixels on an edge shared by two triangles are found on it by both, and
+// a fill rule gives them to one triangle only, as the top-left rule of GPUs: neither cracks nor pixels drawn twice
+// between adjacent triangles, whatever the order they are drawn in. Edge k is the one opposite vertex k, positive
+// inside the triangle whatever its winding, its value over m_area being the barycentric coordinate of vertex k.
+struct TriangleEdges
+{
+	static const int kSubPixelBits = 8;
+	long long m_stepx[3];  // increment of the edge functions from a pixel to the next one of a row
+	long long m_stepy[3];  // from a pixel to the next one of a column
+	long long m_offset[3];  // at pixel (0, 0)
+	long long m_bias[3];  // smallest value of the edge functions inside, 1 for the edges not owning their pixels
+	long long m_area;  // sum of the edge functions, twice the area of the triangle
+
+	// false for a degenerate triangle, covering no pixel
+	bool setup(const mat<3, 2, float> &pts2)
+	{
+		// coordinates beyond a million pixels are clamped, keeping products of coordinates in 64 bits
+		const double limit = double(1 << 20);
+		long long vx[3], vy[3];
+		for (int i = 0; i < 3; i++)
+		{
+			if (!(pts2[i].x == pts2[i].x && pts2[i].y == pts2[i].y))
+				return false;
+			vx[i] = (long long)std::floor(b3Max(-limit, b3Min(limit, double(pts2[i].x))) * (1 << kSubPixelBits) + 0.5);
+			vy[i] = (long long)std::floor(b3Max(-limit, b3Min(limit, double(pts2[i].y))) * (1 << kSubPixelBits) + 0.5);
+		}
+		long long a[3], b[3], c[3];
+		for (int k = 0; k < 3; k++)
+		{
+			// edge from vertex k + 1 to vertex k + 2, E(P) = a P.x + b P.y + c
+			const int i = (k + 1) % 3, j = (k + 2) % 3;
+			a[k] = vy[i] - vy[j];
+			b[k] = vx[j] - vx[i];
+			c[k] = -(a[k] * vx[i] + b[k] * vy[i]);
+		}
+		m_area = a[0] * vx[0] + b[0] * vy[0] + c[0];
+		if (m_area == 0)
+			return false;
+		const long long sign = m_area > 0 ? 1 : -1;
+		m_area *= sign;
+		for (int k = 0; k < 3; k++)
+		{
+			a[k] *= sign;
+			b[k] *= sign;
+			m_stepx[k] = a[k] * (1 << kSubPixelBits);
+			m_stepy[k] = b[k] * (1 << kSubPixelBits);
+			m_offset[k] = c[k] * sign;
+			m_bias[k] = (b[k] > 0 || (b[k] == 0 && a[k] > 0)) ? 0 : 1;
+		}
+		return true;
+	}
+
+	// edge function k at pixel (x, y)
+	long long at(int k, int x, int y) const { return m_offset[k] + m_stepx[k] * x + m_stepy[k] * y; }
+};
+
+#if defined(TINYRENDER_SIMD_SSE2) || defined(TINYRENDER_SIMD_NEON)
+
+// four float lanes
+#if defined(TINYRENDER_SIMD_SSE2)
+typedef __m128 Float4;
+static inline Float4 splat4(float a) { return _mm_set1_ps(a); }
+static inline Float4 ramp4(float a) { return _mm_setr_ps(a, a + 1.f, a + 2.f, a + 3.f); }
+static inline Float4 load4(const float *p) { return _mm_loadu_ps(p); }
+static inline void store4(float *p, Float4 a) { _mm_storeu_ps(p, a); }
+static inline Float4 add4(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+static inline Float4 sub4(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+static inline Float4 mul4(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+static inline Float4 div4(Float4 a, Float4 b) { return _mm_div_ps(a, b); }
+// bit i set if lane i of a >= b
+static inline int geMask4(Float4 a, Float4 b) { return _mm_movemask_ps(_mm_cmpge_ps(a, b)); }
+// bit i set if lane i of a > b
+static inline int gtMask4(Float4 a, Float4 b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+#else
+typedef float32x4_t Float4;
+static inline Float4 splat4(float a) { return vdupq_n_f32(a); }
+static inline Float4 ramp4(float a)
+{
+	const float r[4] = {a, a + 1.f, a + 2.f, a + 3.f};
+	return vld1q_f32(r);
+}
+static inline Float4 load4(const float *p) { return vld1q_f32(p); }
+static inline void store4(float *p, Float4 a) { vst1q_f32(p, a); }
+static inline Float4 add4(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+static inline Float4 sub4(Float4 a, Float4 b) { return vsubq_f32(a, b); }
+static inline Float4 mul4(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+static inline Float4 div4(Float4 a, Float4 b) { return vdivq_f32(a, b); }
+static inline int laneBits4(uint32x4_t m)
+{
+	const uint32_t bits[4] = {1, 2, 4, 8};
+	return int(vaddvq_u32(vandq_u32(m, vld1q_u32(bits))));
+}
+static inline int geMask4(Float4 a, Float4 b) { return laneBits4(vcgeq_f32(a, b)); }
+static inline int gtMask4(Float4 a, Float4 b) { return laneBits4(vcgtq_f32(a, b)); }
+#endif
+
+static const int kBlockSize = DepthBlocks::kDepthBlockSize;  // side of the pixel blocks tested at once against the triangle edges
+
+// Rasterize the screen space triangle pts (pts2 being its projection) inside the box [bboxmin, bboxmax], 4 pixels
+// at a time, the coverage being that of TriangleEdges. Calls fragment(x, y, bc_clip, frag_depth) for each pixel
+// inside the triangle passing the depth test, bc_clip being the perspective correct barycentric coordinates. Blocks
+// of depthBlocks, if computed from zbuffer, are skipped when hidden and refreshed when drawn.
+template <class Fragment>
+static void rasterize(const mat<3, 4, float> &pts, const mat<3, 2, float> &pts2, const Vec3f &clipz, const float *zbuffer, int width, const Vec2f &bboxmin, const Vec2f &bboxmax, Fragment fragment, DepthBlocks *depthBlocks = 0)
+{
+	TriangleEdges edges;
+	if (!edges.setup(pts2))
+		return;  // degenerate triangle
+	const float invArea = float(1. / double(edges.m_area));
+	const float stepx[3] = {float(edges.m_stepx[0]) * invArea, float(edges.m_stepx[1]) * invArea, float(edges.m_stepx[2]) * invArea};
+
+	// perspective correction, interpolating b_i / w_i and z_i / w_i
+	const float iw[3] = {1.f / pts[0][3], 1.f / pts[1][3], 1.f / pts[2][3]};
+	const float zw[3] = {clipz[0] * iw[0], clipz[1] * iw[1], clipz[2] * iw[2]};
+
+	const int xmin = int(bboxmin.x), ymin = int(bboxmin.y);
+	const int xmax = int(std::floor(bboxmax.x)), ymax = int(std::floor(bboxmax.y));
+
+	// the depth of the triangle is a convex combination of the depths of its vertices in front of the camera
+	if (depthBlocks && (depthBlocks->m_zbuffer != zbuffer || !(iw[0] > 0.f && iw[1] > 0.f && iw[2] > 0.f)))
+		depthBlocks = 0;
+	const float nearest = b3Max(-clipz[0], b3Max(-clipz[1], -clipz[2]));
+
+	// blocks aligned on multiples of their size, as those of depthBlocks
+	const Float4 zero = splat4(0.f), one = splat4(1.f), ramp = ramp4(0.f);
+	for (int by0 = ymin - ymin % kBlockSize; by0 <= ymax; by0 += kBlockSize)
+	{
+		const int by = b3Max(by0, ymin), by1 = b3Min(by0 + kBlockSize - 1, ymax);
+		for (int bx0 = xmin - xmin % kBlockSize; bx0 <= xmax; bx0 += kBlockSize)
+		{
+			const int bx = b3Max(bx0, xmin), bx1 = b3Min(bx0 + kBlockSize - 1, xmax);
+
+			// the edge functions are linear, their extrema over the block at its corners: reject if outside one
+			// edge, skip edge tests if inside all edges
+			bool outside = false, covered = true;
+			for (int k = 0; k < 3; k++)
+			{
+				const long long e00 = edges.at(k, bx, by), e10 = e00 + edges.m_stepx[k] * (bx1 - bx);
+				const long long e01 = e00 + edges.m_stepy[k] * (by1 - by), e11 = e10 + (e01 - e00);
+				outside = outside || b3Max(b3Max(e00, e10), b3Max(e01, e11)) < edges.m_bias[k];
+				covered = covered && b3Min(b3Min(e00, e10), b3Min(e01, e11)) >= edges.m_bias[k];
+			}
+			if (outside)
+				continue;
+
+			// hidden by the fragments drawn in the block, farther ones failing the depth test anyway
+			if (depthBlocks && depthBlocks->farthest(bx, by) > nearest)
+				continue;
+			bool drawn = false;
+
+			long long erow[3] = {edges.at(0, bx, by), edges.at(1, bx, by), edges.at(2, bx, by)};
+			for (int y = by; y <= by1; y++)
+			{
+				long long e[3] = {erow[0], erow[1], erow[2]};
+				for (int x = bx; x <= bx1; x += 4)
+				{
+					const int lanes = b3Min(4, bx1 - x + 1);
+					int mask = (1 << lanes) - 1;
+					if (!covered)
+					{
+						for (int i = 0; i < lanes; i++)
+						{
+							for (int k = 0; k < 3; k++)
+							{
+								if (e[k] + edges.m_stepx[k] * i < edges.m_bias[k])
+									mask &= ~(1 << i);
+							}
+						}
+					}
+
+					const Float4 b0 = add4(splat4(float(e[0]) * invArea), mul4(ramp, splat4(stepx[0])));
+					const Float4 b1 = add4(splat4(float(e[1]) * invArea), mul4(ramp, splat4(stepx[1])));
+					const Float4 b2 = add4(splat4(float(e[2]) * invArea), mul4(ramp, splat4(stepx[2])));
+					for (int k = 0; k < 3; k++)
+						e[k] += edges.m_stepx[k] * 4;
+					if (!mask)
+						continue;
+
+					const Float4 q0 = mul4(b0, splat4(iw[0]));
+					const Float4 q1 = mul4(b1, splat4(iw[1]));
+					const Float4 q2 = mul4(b2, splat4(iw[2]));
+					const Float4 den = add4(add4(q0, q1), q2);
+					const Float4 z = add4(add4(mul4(b0, splat4(zw[0])), mul4(b1, splat4(zw[1]))), mul4(b2, splat4(zw[2])));
+					const Float4 depth = div4(sub4(zero, z), den);
+
+					// depth test, the last pixels of a row may not be loaded at once
+					const float *zrow = zbuffer + x + y * width;
+					float ztail[4] = {0.f, 0.f, 0.f, 0.f};
+					if (lanes < 4)
+					{
+						for (int i = 0; i < lanes; i++)
+							ztail[i] = zrow[i];
+					}
+					mask &= ~gtMask4(lanes < 4 ? load4(ztail) : load4(zrow), depth);
+					if (!(mask & 15))
+						continue;
+
+					float laneDepth[4], laneQ0[4], laneQ1[4], laneQ2[4];
+					const Float4 invDen = div4(one, den);
+					store4(laneDepth, depth);
+					store4(laneQ0, mul4(q0, invDen));
+					store4(laneQ1, mul4(q1, invDen));
+					store4(laneQ2, mul4(q2, invDen));
+					for (int i = 0; i < lanes; i++)
+					{
+						if (mask & (1 << i))
+							fragment(x + i, y, Vec3f(laneQ0[i], laneQ1[i], laneQ2[i]), laneDepth[i]);
+					}
+					drawn = true;
+				}
+				for (int k = 0; k < 3; k++)
+					erow[k] += edges.m_stepy[k];
+			}
+			if (drawn && depthBlocks)
+				depthBlocks->refresh(bx, by);
+		}
+	}
+}
+
+#else
+
+// Rasterize the screen space triangle pts (pts2 being its projection) inside the box [bboxmin, bboxmax], one pixel
+// at a time, the coverage being that of TriangleEdges. Calls fragment(x, y, bc_clip, frag_depth) for each pixel
+// inside the triangle passing the depth test, bc_clip being the perspective correct barycentric coordinates. Depth
+// blocks are only tested by the SIMD rasterizer, they are left as computed and stay lower bounds.
+template <class Fragment>
+static void rasterize(const mat<3, 4, float> &pts, const mat<3, 2, float> &pts2, const Vec3f &clipz, const float *zbuffer, int width, const Vec2f &bboxmin, const Vec2f &bboxmax, Fragment fragment, DepthBlocks * = 0)
+{
+	TriangleEdges edges;
+	if (!edges.setup(pts2))
+		return;  // degenerate triangle
+	const double invArea = 1. / double(edges.m_area);
+
+	const int xmin = int(bboxmin.x), ymin = int(bboxmin.y);
+	const int xmax = int(std::floor(bboxmax.x)), ymax = int(std::floor(bboxmax.y));
+	long long erow[3] = {edges.at(0, xmin, ymin), edges.at(1, xmin, ymin), edges.at(2, xmin, ymin)};
+	for (int y = ymin; y <= ymax; y++)
+	{
+		long long e[3] = {erow[0], erow[1], erow[2]};
+		for (int x = xmin; x <= xmax; x++)
+		{
+			const bool inside = e[0] >= edges.m_bias[0] && e[1] >= edges.m_bias[1] && e[2] >= edges.m_bias[2];
+			const Vec3d bc_screen(double(e[0]) * invArea, double(e[1]) * invArea, double(e[2]) * invArea);
+			for (int k = 0; k < 3; k++)
+				e[k] += edges.m_stepx[k];
+			if (!inside)
+				continue;
+
+			Vec3d bc_clip = Vec3d(bc_screen.x / pts[0][3], bc_screen.y / pts[1][3], bc_screen.z / pts[2][3]);
+			bc_clip = bc_clip / (bc_clip.x + bc_clip.y + bc_clip.z);
+			Vec3d clipd(clipz.x, clipz.y, clipz.z);
+			double frag_depth = -1. * (clipd * bc_clip);
+			if (zbuffer[x + y * width] > frag_depth)
+				continue;
+			fragment(x, y, Vec3f(bc_clip.x, bc_clip.y, bc_clip.z), frag_depth);
+		}
+		for (int k = 0; k < 3; k++)
+			erow[k] += edges.m_stepy[k];
+	}
+}
+
+#endif
+
+// bounding box of the projected triangle pts2 clamped to the inclusive rectangle scissor
+static inline void boundingBox(const mat<3, 2, float> &pts2, const int scissor[4], Vec2f &bboxmin, Vec2f &bboxmax)
+{
+	bboxmin = Vec2f(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+	bboxmax = Vec2f(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+	Vec2f lower(scissor[0], scissor[1]);
+	Vec2f upper(scissor[2], scissor[3]);
+
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			bboxmin[j] = b3Max(lower[j], b3Min(bboxmin[j], pts2[i][j]));
+			bboxmax[j] = b3Min(upper[j], b3Max(bboxmax[j], pts2[i][j]));
+		}
+	}
+}
+
+// Shade the clip space triangle clipc inside the inclusive rectangle scissor, as triangle(). Shader is any class
+// with the m_nearPlane and m_farPlane members and the fragment method of IShader, called directly: instantiated
+// with a final or non virtual shader and WriteMask known at compile time, the per pixel path has neither virtual
+// calls nor branches on the segmentation mask. Image is a TGAImage or any class with its get_width and set methods.
+template <class Shader, bool WriteMask, class Image>
+void shadeTriangle(mat<4, 3, float> &clipc, Shader &shader, Image &image, float *zbuffer, int *segmentationMaskBuffer, const Matrix &viewPortMatrix, int objectAndLinkIndex, const int scissor[4], DepthBlocks *depthBlocks = 0)
+{
+	mat<3, 4, float> pts = (viewPortMatrix * clipc).transpose();  // transposed to ease access to each of the points
+
+	mat<3, 2, float> pts2;
+	for (int i = 0; i < 3; i++) pts2[i] = proj<2>(pts[i] / pts[i][3]);
+
+	Vec2f bboxmin, bboxmax;
+	boundingBox(pts2, scissor, bboxmin, bboxmax);
+
+	const int width = image.get_width();
+	rasterize(pts, pts2, clipc[2], zbuffer, width, bboxmin, bboxmax, [&](int x, int y, const Vec3f &bc_clip, float frag_depth) {
+		TGAColor color;
+		bool discard = shader.fragment(bc_clip, color);
+		if (frag_depth < -shader.m_farPlane)
+			discard = true;
+		if (frag_depth > shader.m_nearPlane)
+			discard = true;
+
+		if (!discard)
+		{
+			zbuffer[x + y * width] = frag_depth;
+			if (WriteMask)
+			{
+				segmentationMaskBuffer[x + y * width] = objectAndLinkIndex;
+			}
+			image.set(x, y, color);
+		}
+	}, depthBlocks);
+}
+
+// same as shadeTriangle, interpolating the attributes over the triangle orgClipc before near plane clipping, as
+// triangleClipped()
+template <class Shader, bool WriteMask, class Image>
+void shadeTriangleClipped(mat<4, 3, float> &clipc, mat<4, 3, float> &orgClipc, Shader &shader, Image &image, float *zbuffer, int *segmentationMaskBuffer, const Matrix &viewPortMatrix, int objectAndLinkIndex, const int scissor[4], DepthBlocks *depthBlocks = 0)
+{
+	mat<3, 4, float> screenSpacePts = (viewPortMatrix * clipc).transpose();  // transposed to ease access to each of the points
+
+	mat<3, 2, float> pts2;
+	for (int i = 0; i < 3; i++)
+	{
+		pts2[i] = proj<2>(screenSpacePts[i] / screenSpacePts[i][3]);
+	}
+
+	Vec2f bboxmin, bboxmax;
+	boundingBox(pts2, scissor, bboxmin, bboxmax);
+
+	mat<3, 4, float> orgScreenSpacePts = (viewPortMatrix * orgClipc).transpose();  // transposed to ease access to each of the points
+
+	mat<3, 2, float> orgPts2;
+	for (int i = 0; i < 3; i++)
+	{
+		orgPts2[i] = proj<2>(orgScreenSpacePts[i] / orgScreenSpacePts[i][3]);
+	}
+
+	const int width = image.get_width();
+	rasterize(screenSpacePts, pts2, clipc[2], zbuffer, width, bboxmin, bboxmax, [&](int x, int y, const Vec3f &, float frag_depth) {
+		// attributes are interpolated over the triangle before clipping
+		Vec3d bc_screen2 = barycentric(orgPts2[0], orgPts2[1], orgPts2[2], Vec2f(x, y));
+		Vec3d bc_clip2 = Vec3d(bc_screen2.x / orgScreenSpacePts[0][3], bc_screen2.y / orgScreenSpacePts[1][3], bc_screen2.z / orgScreenSpacePts[2][3]);
+		bc_clip2 = bc_clip2 / (bc_clip2.x + bc_clip2.y + bc_clip2.z);
+
+		TGAColor color;
+		Vec3f bc_clip2f(bc_clip2.x, bc_clip2.y, bc_clip2.z);
+		bool discard = shader.fragment(bc_clip2f, color);
+
+		if (!discard)
+		{
+			zbuffer[x + y * width] = frag_depth;
+			if (WriteMask)
+			{
+				segmentationMaskBuffer[x + y * width] = objectAndLinkIndex;
+			}
+			image.set(x, y, color);
+		}
+	}, depthBlocks);
+}
+}
+
+#endif  //__RASTERIZER_H__
@@ -0,0 +1,189 @@
+#ifndef __TEXTURE_H__
+#define __TEXTURE_H__
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "geometry.h"
+#include "tgaimage.h"
+
+// the SIMD sampler is selected at compile time, define TINYRENDER_NO_SIMD to use the scalar one
+#if !defined(TINYRENDER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define TINYRENDER_TEXTURE_SSE2
+#endif
+
+namespace TinyRender
+{
+// RGBA8 texture with its mip levels. Texels are stored in 4x4 tiles of 64 bytes, so that a bilinear footprint
+// spans at most four cache lines whatever the orientation of the textured surface on screen.
+class MipTexture
+{
+public:
+	MipTexture() : m_bytespp(0) {}
+
+	// build all levels from image, keeping its byte order, missing alpha is set to 255
+	void build(TGAImage &image)
+	{
+		m_levels.clear();
+		m_bytespp = image.get_bytespp();
+		int width = image.get_width();
+		int height = image.get_height();
+		if (width <= 0 || height <= 0 || !image.buffer())
+			return;
+
+		m_levels.push_back(Level(width, height));
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				TGAColor c = image.get(x, y);
+				if (m_bytespp == 1)
+					c = TGAColor(c[0], c[0], c[0]);
+				else if (m_bytespp == 3)
+					c[3] = 255;
+				m_levels[0].texel(x, y) = pack(c.bgra);
+			}
+		}
+
+		// box filtered levels down to a single texel
+		while (width > 1 || height > 1)
+		{
+			const Level &src = m_levels.back();
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+			Level dst(width, height);
+			for (int y = 0; y < height; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					int x0 = 2 * x < src.width ? 2 * x : src.width - 1, x1 = 2 * x + 1 < src.width ? 2 * x + 1 : src.width - 1;
+					int y0 = 2 * y < src.height ? 2 * y : src.height - 1, y1 = 2 * y + 1 < src.height ? 2 * y + 1 : src.height - 1;
+					unsigned int t[4] = {src.texel(x0, y0), src.texel(x1, y0), src.texel(x0, y1), src.texel(x1, y1)};
+					unsigned char c[4];
+					for (int i = 0; i < 4; i++)
+					{
+						int sum = 2;
+						for (int k = 0; k < 4; k++)
+							sum += (t[k] >> (8 * i)) & 255;
+						c[i] = (unsigned char)(sum / 4);
+					}
+					dst.texel(x, y) = pack(c);
+				}
+			}
+			m_levels.push_back(dst);
+		}
+	}
+
+	bool empty() const
+	{
+		return m_levels.empty();
+	}
+
+	int levels() const
+	{
+		return (int)m_levels.size();
+	}
+
+	// level of detail of a triangle with texture coordinates uv and screen coordinates xy (in pixels), computed from
+	// the derivatives of the level 0 texel coordinates along the screen axes
+	float lod(const Vec2f uv[3], const Vec2f xy[3]) const
+	{
+		if (m_levels.size() < 2)
+			return 0.f;
+		float e1x = xy[1].x - xy[0].x, e1y = xy[1].y - xy[0].y;
+		float e2x = xy[2].x - xy[0].x, e2y = xy[2].y - xy[0].y;
+		float det = e1x * e2y - e2x * e1y;
+		if (!(std::abs(det) > 1e-6f))
+			return 0.f;
+		float w = (float)m_levels[0].width, h = (float)m_levels[0].height;
+		float t1u = (uv[1].x - uv[0].x) * w, t1v = (uv[1].y - uv[0].y) * h;
+		float t2u = (uv[2].x - uv[0].x) * w, t2v = (uv[2].y - uv[0].y) * h;
+		float dudx = (t1u * e2y - t2u * e1y) / det, dvdx = (t1v * e2y - t2v * e1y) / det;
+		float dudy = (t2u * e1x - t1u * e2x) / det, dvdy = (t2v * e1x - t1v * e2x) / det;
+		float rho2 = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+		return rho2 > 1.f ? 0.5f * std::log2(rho2) : 0.f;
+	}
+
+	// bilinear sample at uv, wrapped to [0, 1), in the level closest to lod
+	TGAColor sample(Vec2f uv, float lod) const
+	{
+		int level = lod > 0.f ? (int)(lod + 0.5f) : 0;
+		const Level &l = m_levels[level < (int)m_levels.size() ? level : m_levels.size() - 1];
+
+		float x = (uv.x - std::floor(uv.x)) * l.width - 0.5f;
+		float y = (uv.y - std::floor(uv.y)) * l.height - 0.5f;
+		float fx0 = std::floor(x), fy0 = std::floor(y);
+		float fx = x - fx0, fy = y - fy0;
+		int x0 = (int)fx0, y0 = (int)fy0;
+		int x1 = x0 + 1 < l.width ? x0 + 1 : 0, y1 = y0 + 1 < l.height ? y0 + 1 : 0;
+		if (x0 < 0) x0 = l.width - 1;
+		if (y0 < 0) y0 = l.height - 1;
+
+		unsigned int t00 = l.texel(x0, y0), t10 = l.texel(x1, y0), t01 = l.texel(x0, y1), t11 = l.texel(x1, y1);
+		float w00 = (1.f - fx) * (1.f - fy), w10 = fx * (1.f - fy), w01 = (1.f - fx) * fy, w11 = fx * fy;
+
+		unsigned int packed;
+#ifdef TINYRENDER_TEXTURE_SSE2
+		__m128 sum = _mm_mul_ps(unpack(t00), _mm_set1_ps(w00));
+		sum = _mm_add_ps(sum, _mm_mul_ps(unpack(t10), _mm_set1_ps(w10)));
+		sum = _mm_add_ps(sum, _mm_mul_ps(unpack(t01), _mm_set1_ps(w01)));
+		sum = _mm_add_ps(sum, _mm_mul_ps(unpack(t11), _mm_set1_ps(w11)));
+		__m128i c = _mm_cvtps_epi32(sum);
+		c = _mm_packs_epi32(c, c);
+		packed = (unsigned int)_mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+#else
+		packed = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			float c = w00 * ((t00 >> (8 * i)) & 255) + w10 * ((t10 >> (8 * i)) & 255) +
+					  w01 * ((t01 >> (8 * i)) & 255) + w11 * ((t11 >> (8 * i)) & 255);
+			packed |= (unsigned int)(c + 0.5f) << (8 * i);
+		}
+#endif
+		TGAColor color;
+		for (int i = 0; i < 4; i++)
+			color.bgra[i] = (unsigned char)(packed >> (8 * i));
+		color.bytespp = (unsigned char)m_bytespp;
+		return color;
+	}
+
+private:
+	struct Level
+	{
+		int width;
+		int height;
+		int tilesX;
+		std::vector<unsigned int> texels;  // 4x4 tiles, row major in tiles and in texels
+
+		Level(int w, int h) : width(w), height(h), tilesX((w + 3) / 4), texels(size_t(tilesX) * ((h + 3) / 4) * 16) {}
+
+		unsigned int &texel(int x, int y)
+		{
+			return texels[((y >> 2) * tilesX + (x >> 2)) * 16 + (y & 3) * 4 + (x & 3)];
+		}
+		unsigned int texel(int x, int y) const
+		{
+			return texels[((y >> 2) * tilesX + (x >> 2)) * 16 + (y & 3) * 4 + (x & 3)];
+		}
+	};
+
+	static unsigned int pack(const unsigned char c[4])
+	{
+		return c[0] | (c[1] << 8) | (c[2] << 16) | ((unsigned int)c[3] << 24);
+	}
+
+#ifdef TINYRENDER_TEXTURE_SSE2
+	static __m128 unpack(unsigned int t)
+	{
+		__m128i zero = _mm_setzero_si128();
+		__m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)t), zero);
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(c, zero));
+	}
+#endif
+
+	std::vector<Level> m_levels;
+	int m_bytespp;
+};
+}
+
+#endif  //__TEXTURE_H__
@@ -0,0 +1,174 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Counts the heap allocations of the camera images of a steady scene, calling the rendering
+// interface as pybullet does for getCameraImage: moved poses, light settings, camera matrices
+// and the copy of the images. The renderer is a stub filling the frames, to measure the plugin
+// alone, or "tiny", "egl", "egl-occlusion" and "egl-shadows" when built. Fails if frames
+// allocate once warmed up.
+
+#include <plugin/RenderingInterface.h>
+#ifdef WITH_EGL
+#include <render/EGLRenderer.h>
+#endif
+#ifdef WITH_TINYRENDERER
+#include <render/TinyRendererBackend.h>
+#endif
+
+#include <CommonInterfaces/CommonRenderInterface.h>
+#include <LinearMath/btAlignedAllocator.h>
+#include <SharedMemory/SharedMemoryPublic.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+
+std::atomic<long> gAllocations(0);
+
+void* countedAlloc(size_t size)
+{
+    ++gAllocations;
+    return std::malloc(size);
+}
+
+void countedFree(void* ptr) { std::free(ptr); }
+
+/**
+ * @brief Renderer filling the planes, so that only the plugin allocates
+ */
+class StubRenderer : public render::BaseRenderer
+{
+  public:
+    void updateScene(const std::shared_ptr<scene::SceneGraph>&, bool) override {}
+
+    bool renderFrame(const std::shared_ptr<scene::SceneState>&,
+                     const std::shared_ptr<scene::SceneView>&,
+                     render::FrameData& outputFrame) override
+    {
+        const size_t pixels = size_t(outputFrame.cols) * size_t(outputFrame.rows);
+        std::fill_n(outputFrame.color, pixels * 4, uint8_t(128));
+        std::fill_n(outputFrame.depth, pixels, 1.f);
+        if (outputFrame.mask)
+            std::fill_n(outputFrame.mask, pixels, 0);
+        return true;
+    }
+};
+
+std::shared_ptr<render::BaseRenderer> makeRenderer(const char* name)
+{
+#ifdef WITH_EGL
+    if (!std::strcmp(name, "egl"))
+        return std::make_shared<render::EGLRenderer>();
+    if (!std::strcmp(name, "egl-occlusion")) {
+        auto renderer = std::make_shared<render::EGLRenderer>();
+        renderer->setOcclusionCulling(true);
+        return renderer;
+    }
+    if (!std::strcmp(name, "egl-shadows"))
+        return std::make_shared<render::EGLRenderer>();
+#endif
+#ifdef WITH_TINYRENDERER
+    if (!std::strcmp(name, "tiny"))
+        return std::make_shared<render::TinyRendererBackend>(0);
+#endif
+    if (!std::strcmp(name, "stub"))
+        return std::make_shared<StubRenderer>();
+    return nullptr;
+}
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    if (void* ptr = countedAlloc(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { countedFree(ptr); }
+
+int main(int argc, char** argv)
+{
+    btAlignedAllocSetCustom(countedAlloc, countedFree);
+
+    const char* name = argc > 1 ? argv[1] : "stub";
+    const bool shadows = !std::strcmp(name, "egl-shadows");
+    const auto renderer = makeRenderer(name);
+    if (!renderer) {
+        std::printf("unknown or not built renderer %s\n", name);
+        return EXIT_FAILURE;
+    }
+
+    const int cols = 320, rows = 240, bodies = 64, warmup = 5, frames = 50;
+    RenderingInterface interface;
+    interface.setRenderer(renderer);
+
+    // boxes registered as createVisualShape meshes, one body each
+    const float n = 0.1f;
+    const float vertices[] = {
+        -n, -n, -n, 1.f, 0.f, 0.f, -1.f, 0.f, 0.f, n,  -n, -n, 1.f, 0.f, 0.f, -1.f, 1.f, 0.f,
+        n,  n,  -n, 1.f, 0.f, 0.f, -1.f, 1.f, 1.f, -n, n,  -n, 1.f, 0.f, 0.f, -1.f, 0.f, 1.f,
+        -n, -n, n,  1.f, 0.f, 0.f, 1.f,  0.f, 0.f, n,  -n, n,  1.f, 0.f, 0.f, 1.f,  1.f, 0.f,
+        n,  n,  n,  1.f, 0.f, 0.f, 1.f,  1.f, 1.f, -n, n,  n,  1.f, 0.f, 0.f, 1.f,  0.f, 1.f};
+    const int indices[] = {0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4,
+                           1, 2, 6, 1, 6, 5, 2, 3, 7, 2, 7, 6, 3, 0, 4, 3, 4, 7};
+    for (int body = 0; body < bodies; ++body) {
+        b3VisualShapeData shape{};
+        shape.m_objectUniqueId = body;
+        shape.m_linkIndex = -1;
+        shape.m_rgbaColor[0] = shape.m_rgbaColor[3] = 1.0;
+        interface.registerShapeAndInstance(shape, vertices, 8, indices, 36, B3_GL_TRIANGLES, -1,
+                                           body, body, -1);
+    }
+
+    const float c = std::sqrt(0.5f), f = 100.f, z = 0.1f, t = 1.f / std::tan(0.5f);
+    const float proj[16] = {t * rows / cols, 0.f, 0.f, 0.f, 0.f, t, 0.f, 0.f, 0.f, 0.f,
+                            -(f + z) / (f - z), -1.f, 0.f, 0.f, -2 * f * z / (f - z), 0.f};
+    float view[16] = {1.f, 0.f, 0.f, 0.f, 0.f, c, -c, 0.f, 0.f, c, c, 0.f, 0.f, -c, -5.f, 1.f};
+
+    std::vector<unsigned char> color(size_t(cols) * rows * 4);
+    std::vector<float> depth(size_t(cols) * rows);
+    std::vector<int> mask(size_t(cols) * rows);
+
+    const auto frame = [&](int index) {
+        // bodies move and the camera orbits, so that every frame renders
+        for (int body = 0; body < bodies; ++body) {
+            const btScalar angle = 0.01 * (index + body);
+            interface.syncTransform(body,
+                                    btTransform(btQuaternion(btVector3(0, 0, 1), angle),
+                                                btVector3(0.3 * (body % 8) - 1.2,
+                                                          0.3 * (body / 8) - 1.2, 0.1)),
+                                    btVector3(1, 1, 1));
+        }
+        view[12] = 0.01f * index;
+        interface.setWidthAndHeight(cols, rows);
+        interface.setLightDirection(0.4f, -0.25f, -0.86f);
+        interface.setShadow(shadows);
+        interface.render(view, proj);
+        int width = cols, height = rows, copied = 0;
+        interface.copyCameraImageData(color.data(), cols * rows, depth.data(), cols * rows,
+                                      mask.data(), cols * rows, 0, &width, &height, &copied);
+        return copied == cols * rows;
+    };
+
+    for (int i = 0; i < warmup; ++i)
+        if (!frame(i)) {
+            std::printf("%s did not render\n", name);
+            return EXIT_FAILURE;
+        }
+
+    const long before = gAllocations;
+    for (int i = warmup; i < warmup + frames; ++i)
+        frame(i);
+    const double allocations = double(gAllocations - before) / frames;
+
+    std::printf("%s renderer: %.2f allocations per frame\n", name, allocations);
+    return allocations == 0. ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,413 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Times the conversions and copies the plugin runs per body, per step or per camera image, with
+// the heap allocations of each call: pose and mesh conversions from bullet, shape creation,
+// state updates, scene graph copies and binary serialization. Sizes are those of typical scenes:
+// meshes of a thousand to a hundred thousand vertices, scenes of a thousand nodes. Benchmarks
+// whose name contains the first argument run, all if none is given. The batched math kernels
+// are first checked against their scalar functions, the run failing if any result differs.
+
+#include <plugin/utils.h>
+#include <scene/Bounds.h>
+#include <scene/SceneGraph.h>
+#include <scene/SceneState.h>
+#include <utils/serialization.h>
+
+#include <LinearMath/btAlignedAllocator.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+namespace {
+
+std::atomic<long> gAllocations(0);
+
+void* countedAlloc(size_t size)
+{
+    ++gAllocations;
+    return std::malloc(size);
+}
+
+void countedFree(void* ptr) { std::free(ptr); }
+
+const void* volatile gSink = nullptr;
+
+/**
+ * @brief Keep a result alive so that the compiler does not remove the benchmarked call
+ */
+template <class T>
+void keep(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    gSink = &value;
+#endif
+}
+
+const char* gFilter = nullptr;
+bool gMismatch = false;
+
+/**
+ * @brief Report a batched kernel whose results differ from those of its scalar function
+ */
+void check(const char* name, bool equal)
+{
+    if (equal)
+        return;
+    std::printf("%-36s differs from its scalar function\n", name);
+    gMismatch = true;
+}
+
+/**
+ * @brief Run \p fn until it took a quarter of a second, print its time and allocations per call
+ */
+template <class F>
+void bench(const char* name, F&& fn)
+{
+    if (gFilter && !std::strstr(name, gFilter))
+        return;
+    using Clock = std::chrono::steady_clock;
+
+    fn(); // warm up caches and lazily allocated buffers
+    long iterations = 0;
+    long allocations = 0;
+    double seconds = 0.;
+    for (long batch = 1; seconds < 0.25; batch *= 2) {
+        const long before = gAllocations;
+        const auto start = Clock::now();
+        for (long i = 0; i < batch; ++i)
+            fn();
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        allocations += gAllocations - before;
+        iterations += batch;
+    }
+    std::printf("%-36s %14.1f %14.2f %12ld\n", name, 1e9 * seconds / iterations,
+                double(allocations) / iterations, iterations);
+}
+
+btTransform makeTransform(int i)
+{
+    const btScalar angle = 0.001 * i;
+    return btTransform(btQuaternion(btVector3(0.3, 0.5, 0.8).normalized(), angle),
+                       btVector3(0.1 * i, -0.2 * i, 1.0));
+}
+
+/**
+ * @brief Deformed sphere of about \p numVertices vertices, as bullet hands over in-memory meshes
+ */
+UrdfShape makeMeshShape(int numVertices, bool withNormals)
+{
+    const int side = std::max(2, int(std::sqrt(double(numVertices))));
+    UrdfShape shape;
+    shape.m_linkLocalFrame = makeTransform(1);
+    auto& geometry = shape.m_geometry;
+    geometry.m_type = URDF_GEOM_MESH;
+    geometry.m_meshFileType = UrdfGeometry::MEMORY_VERTICES;
+    geometry.m_meshScale = btVector3(0.5, 0.5, 0.5);
+    for (int j = 0; j < side; ++j) {
+        for (int i = 0; i < side; ++i) {
+            const btScalar theta = SIMD_PI * j / (side - 1), phi = SIMD_2_PI * i / (side - 1);
+            const btVector3 normal(std::sin(theta) * std::cos(phi),
+                                   std::sin(theta) * std::sin(phi), std::cos(theta));
+            geometry.m_vertices.push_back(normal * (1.0 + 0.1 * std::sin(5 * phi)));
+            geometry.m_uvs.push_back(btVector3(btScalar(i) / side, btScalar(j) / side, 0.));
+            if (withNormals)
+                geometry.m_normals.push_back(normal);
+        }
+    }
+    for (int j = 0; j + 1 < side; ++j) {
+        for (int i = 0; i + 1 < side; ++i) {
+            const int v = j * side + i;
+            for (int index : {v, v + 1, v + side + 1, v, v + side + 1, v + side})
+                geometry.m_indices.push_back(index);
+        }
+    }
+    return shape;
+}
+
+/**
+ * @brief Graphics vertex buffer of \p numVertices vertices, 9 floats each
+ */
+std::vector<float> makeVertexBuffer(int numVertices)
+{
+    std::vector<float> vertices(size_t(numVertices) * 9);
+    for (int i = 0; i < numVertices; ++i) {
+        float* vertex = &vertices[size_t(i) * 9];
+        const float t = 0.01f * i;
+        const float values[] = {std::cos(t), std::sin(t), 0.001f * i, 1.f, std::cos(t),
+                                std::sin(t), 0.f, 0.5f + 0.5f * std::cos(t), 0.5f};
+        std::copy(values, values + 9, vertex);
+    }
+    return vertices;
+}
+
+/**
+ * @brief Scene of \p numNodes links: boxes sharing a material and meshes sharing a few ones
+ */
+scene::SceneGraph makeSceneGraph(int numNodes, const std::shared_ptr<scene::Mesh>& mesh)
+{
+    using namespace scene;
+    SceneGraph graph;
+    for (int nodeId = 0; nodeId < numNodes; ++nodeId) {
+        const auto material = std::make_shared<Material>(
+            Color4f{0.1f * (nodeId % 8), 0.5f, 0.5f, 1.f}, Color3f{1.f, 1.f, 1.f});
+        std::vector<Shape> shapes{
+            Shape(ShapeType::Cube, makePose(makeTransform(nodeId)), Vector3f{0.1f, 0.2f, 0.3f},
+                  material),
+            Shape(ShapeType::Mesh, makePose(makeTransform(-nodeId)), mesh, material)};
+        graph.appendNode(nodeId, Node(nodeId / 8, nodeId % 8 - 1, std::move(shapes)));
+    }
+    graph.resetDelta();
+    return graph;
+}
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    if (void* ptr = countedAlloc(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { countedFree(ptr); }
+
+int main(int argc, char** argv)
+{
+    btAlignedAllocSetCustom(countedAlloc, countedFree);
+    gFilter = argc > 1 ? argv[1] : nullptr;
+
+    const int kNodes = 1000;
+    std::printf("%-36s %14s %14s %12s\n", "benchmark", "ns/call", "allocs/call", "calls");
+
+    // per body and per step conversions
+    // inputs cycle so that calls are not hoisted out of the loops
+    const int kInputs = 1024;
+    std::vector<btTransform> transforms;
+    std::vector<Affine3f> affines;
+    for (int i = 0; i < kInputs; ++i) {
+        transforms.push_back(makeTransform(i));
+        affines.push_back(makePose(transforms.back(), btVector3(0.5, 1.0, 2.0)));
+    }
+    int input = 0;
+    const btVector3 scale(0.5, 1.0, 2.0);
+    bench("makePose", [&] { keep(makePose(transforms[++input % kInputs], scale)); });
+    {
+        const std::vector<btVector3> scales(kInputs, scale);
+        std::vector<Affine3f> poses(kInputs);
+        bench("makePoses/1k", [&] {
+            makePoses(transforms.data(), scales.data(), kInputs, poses.data());
+            keep(poses[++input % kInputs]);
+        });
+    }
+    bench("Affine3f::matrix", [&] { keep(affines[++input % kInputs].matrix()); });
+
+    // batched kernels give the results of their scalar functions, with a tail shorter than the
+    // lanes, empty and infinite boxes, and at their use sites
+    {
+        const int count = kInputs - 1;
+        std::vector<Vector3f> origins, scales;
+        std::vector<Quaternionf> quats;
+        std::vector<Matrix4f> expected, matrices(count), results(count);
+        std::vector<scene::AABB> boxes, transformed(count);
+        for (int i = 0; i < count; ++i) {
+            const auto& pose = affines[i];
+            origins.push_back(pose.origin);
+            quats.push_back(pose.quat);
+            scales.push_back(pose.scale);
+            expected.push_back(pose.matrix());
+            if (i % 7 == 0)
+                boxes.push_back(scene::AABB::Empty());
+            else if (i % 11 == 0)
+                boxes.push_back(scene::AABB::Infinite());
+            else
+                boxes.push_back(scene::AABB{pose.origin, {pose.origin[0] + 1.f,
+                                                          pose.origin[1] + 2.f,
+                                                          pose.origin[2] + 3.f}});
+        }
+
+        poseMatrices(origins.data(), quats.data(), scales.data(), count, matrices.data());
+        check("poseMatrices", matrices == expected);
+        multiplyMatrices(expected[1], expected.data(), count, results.data());
+        bool equal = true;
+        for (int i = 0; i < count; ++i)
+            equal = equal && results[i] == multiply(expected[1], expected[i]);
+        check("multiplyMatrices", equal);
+        multiplyMatrices(expected.data(), expected.data() + 1, count - 1, results.data());
+        equal = true;
+        for (int i = 0; i + 1 < count; ++i)
+            equal = equal && results[i] == multiply(expected[i], expected[i + 1]);
+        check("multiplyMatrices/pairs", equal);
+        affineInverses(expected.data(), count, results.data());
+        equal = true;
+        for (int i = 0; i < count; ++i)
+            equal = equal && results[i] == affineInverse(expected[i]);
+        check("affineInverses", equal);
+        transformBoxes(boxes.data(), expected.data(), count, transformed.data());
+        equal = true;
+        for (int i = 0; i < count; ++i) {
+            const auto box = boxes[i].transformed(expected[i]);
+            equal = equal && transformed[i].lower == box.lower && transformed[i].upper == box.upper;
+        }
+        check("transformBoxes", equal);
+
+        // restore() and load() convert poses in batches, setPose() one at a time
+        scene::SceneState state;
+        for (int i = 0; i < count; ++i) {
+            state.appendNode(i);
+            state.setPose(i, affines[i]);
+        }
+        const auto snapshot = state.snapshot();
+        for (int i = 0; i < count; ++i)
+            state.setPose(i, affines[count - i]);
+        state.restore(*snapshot);
+        scene::SceneState loaded;
+        BinaryDeserialize(BinarySerialize(state), loaded);
+        bool restored = true, equalLoaded = true;
+        for (int i = 0; i < count; ++i) {
+            restored = restored && state.matrix(i) == expected[i];
+            equalLoaded = equalLoaded && loaded.matrix(i) == expected[i];
+        }
+        check("SceneState::restore", restored);
+        check("SceneState::load", equalLoaded);
+    }
+
+    // batched kernels over dense arrays, next to their scalar loops
+    {
+        std::vector<Vector3f> origins, scales;
+        std::vector<Quaternionf> quats;
+        std::vector<scene::AABB> boxes;
+        for (const auto& pose : affines) {
+            origins.push_back(pose.origin);
+            quats.push_back(pose.quat);
+            scales.push_back(pose.scale);
+            boxes.push_back(scene::AABB{pose.origin, {pose.origin[0] + 1.f, pose.origin[1] + 2.f,
+                                                      pose.origin[2] + 3.f}});
+        }
+        std::vector<Matrix4f> matrices(kInputs), results(kInputs);
+        std::vector<scene::AABB> transformed(kInputs);
+        bench("Affine3f::matrix/1k", [&] {
+            for (int i = 0; i < kInputs; ++i)
+                matrices[i] = affines[i].matrix();
+            keep(matrices[++input % kInputs]);
+        });
+        bench("poseMatrices/1k", [&] {
+            poseMatrices(origins.data(), quats.data(), scales.data(), kInputs, matrices.data());
+            keep(matrices[++input % kInputs]);
+        });
+        bench("multiply/1k", [&] {
+            for (int i = 0; i < kInputs; ++i)
+                results[i] = multiply(matrices[input % kInputs], matrices[i]);
+            keep(results[++input % kInputs]);
+        });
+        bench("multiplyMatrices/1k", [&] {
+            multiplyMatrices(matrices[input % kInputs], matrices.data(), kInputs, results.data());
+            keep(results[++input % kInputs]);
+        });
+        bench("affineInverse/1k", [&] {
+            for (int i = 0; i < kInputs; ++i)
+                results[i] = affineInverse(matrices[i]);
+            keep(results[++input % kInputs]);
+        });
+        bench("affineInverses/1k", [&] {
+            affineInverses(matrices.data(), kInputs, results.data());
+            keep(results[++input % kInputs]);
+        });
+        bench("AABB::transformed/1k", [&] {
+            for (int i = 0; i < kInputs; ++i)
+                transformed[i] = boxes[i].transformed(matrices[i]);
+            keep(transformed[++input % kInputs]);
+        });
+        bench("transformBoxes/1k", [&] {
+            transformBoxes(boxes.data(), matrices.data(), kInputs, transformed.data());
+            keep(transformed[++input % kInputs]);
+        });
+    }
+
+    // in-memory meshes of createVisualShape and createCollisionShape
+    for (int numVertices : {1000, 100000}) {
+        const auto withNormals = makeMeshShape(numVertices, true);
+        const auto withoutNormals = makeMeshShape(numVertices, false);
+        const std::string size = std::to_string(numVertices / 1000) + "k";
+        bench(("getMeshData/urdf/" + size).c_str(),
+              [&] { keep(getMeshData(withNormals.m_geometry)); });
+        bench(("getMeshData/urdf/smooth normals/" + size).c_str(),
+              [&] { keep(getMeshData(withoutNormals.m_geometry)); });
+
+        const auto vertices = makeVertexBuffer(numVertices);
+        const auto& indices = withNormals.m_geometry.m_indices;
+        bench(("getMeshData/vertex buffer/" + size).c_str(), [&] {
+            keep(getMeshData(vertices.data(), numVertices, &indices[0], indices.size()));
+        });
+    }
+
+    // shapes of loaded links, meshes deduplicated by the asset cache
+    UrdfMaterial urdfMaterial;
+    urdfMaterial.m_matColor.m_rgbaColor = btVector4(0.8, 0.2, 0.2, 1.0);
+    urdfMaterial.m_matColor.m_specularColor = btVector3(1.0, 1.0, 1.0);
+    const auto inertiaFrame = makeTransform(7);
+    UrdfShape box;
+    box.m_linkLocalFrame = makeTransform(3);
+    box.m_geometry.m_type = URDF_GEOM_BOX;
+    box.m_geometry.m_boxSize = btVector3(0.1, 0.2, 0.3);
+    bench("makeShape/box", [&] { keep(makeShape(box, urdfMaterial, inertiaFrame, 0)); });
+    // materials interned by value as the plugin converts links, an equal one in the scene
+    scene::SceneGraph materials;
+    const auto sceneMaterial = materials.internMaterial(makeMaterial(urdfMaterial));
+    bench("makeShape/box/interned material", [&] {
+        keep(makeShape(box, materials.internMaterial(makeMaterial(urdfMaterial)), inertiaFrame, 0));
+    });
+    const auto meshShape = makeMeshShape(10000, true);
+    bench("makeShape/memory mesh/10k",
+          [&] { keep(makeShape(meshShape, urdfMaterial, inertiaFrame, 0)); });
+
+    // poses synced once per step for every body link
+    scene::SceneState state;
+    for (int nodeId = 0; nodeId < kNodes; ++nodeId)
+        state.appendNode(nodeId);
+    std::vector<Affine3f> poses[2];
+    for (int i = 0; i < kNodes; ++i) {
+        poses[0].push_back(makePose(makeTransform(i)));
+        poses[1].push_back(makePose(makeTransform(i + 1)));
+    }
+    int step = 0;
+    bench("SceneState::setPose/moved/1k", [&] {
+        const auto& stepPoses = poses[++step % 2];
+        for (int nodeId = 0; nodeId < kNodes; ++nodeId)
+            state.setPose(nodeId, stepPoses[nodeId]);
+    });
+    bench("SceneState::setPose/static/1k", [&] {
+        for (int nodeId = 0; nodeId < kNodes; ++nodeId)
+            state.setPose(nodeId, poses[0][nodeId]);
+    });
+
+    // scene graph snapshots of the async renderer and messages of the remote renderer
+    const auto mesh = AssetCache::instance().memoryMesh(getMeshData(meshShape.m_geometry));
+    const auto graph = makeSceneGraph(kNodes, mesh);
+    bench("SceneGraph copy/1k", [&] { keep(std::make_shared<scene::SceneGraph>(graph)); });
+
+    bench("BinarySerialize/SceneGraph/1k", [&] { keep(BinarySerialize(graph)); });
+    const auto graphBuffer = BinarySerialize(graph);
+    bench("BinaryDeserialize/SceneGraph/1k", [&] {
+        scene::SceneGraph copy;
+        BinaryDeserialize(graphBuffer, copy);
+        keep(copy);
+    });
+    bench("BinarySerialize/SceneState/1k", [&] { keep(BinarySerialize(state)); });
+    const auto stateBuffer = BinarySerialize(state);
+    scene::SceneState stateCopy;
+    bench("BinaryDeserialize/SceneState/1k", [&] {
+        BinaryDeserialize(stateBuffer, stateCopy);
+        keep(stateCopy);
+    });
+    return gMismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Counts the heap allocations made by the TinyRenderer backend per frame for grids of an
+// increasing number of triangles, part of them crossing the near plane. Fails if allocations
+// grow with the number of triangles.
+
+#include <render/TinyRendererBackend.h>
+
+#include <Bullet3Common/b3AlignedAllocator.h>
+#include <LinearMath/btAlignedAllocator.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<long> gAllocations(0);
+
+void* countedAlloc(size_t size)
+{
+    ++gAllocations;
+    return std::malloc(size);
+}
+
+void countedFree(void* ptr) { std::free(ptr); }
+
+/**
+ * @brief Square grid of 2 * n * n triangles in the z = 0 plane, facing up
+ */
+std::shared_ptr<scene::MeshData> makeGrid(int n, float size)
+{
+    std::vector<float> vertices, uvs, normals;
+    std::vector<int> indices;
+    for (int j = 0; j <= n; ++j) {
+        for (int i = 0; i <= n; ++i) {
+            vertices.insert(vertices.end(), {size * (float(i) / n - 0.5f),
+                                             size * (float(j) / n - 0.5f), 0.f});
+            uvs.insert(uvs.end(), {float(i) / n, float(j) / n});
+            normals.insert(normals.end(), {0.f, 0.f, 1.f});
+        }
+    }
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < n; ++i) {
+            const int v = j * (n + 1) + i;
+            indices.insert(indices.end(), {v, v + 1, v + n + 2, v, v + n + 2, v + n + 1});
+        }
+    }
+    return std::make_shared<scene::MeshData>(std::move(vertices), std::move(uvs),
+                                             std::move(normals), std::move(indices));
+}
+
+/**
+ * @brief Camera one unit above the grid center looking down at 45 degrees
+ */
+std::shared_ptr<scene::Camera> makeCamera(int cols, int rows)
+{
+    const float c = std::sqrt(0.5f);
+    // rows of the rotation are the right, up and backward camera axes
+    const Matrix4f view{1.f, 0.f, 0.f, 0.f, 0.f, c, -c, 0.f, 0.f, c, c, 0.f, 0.f, -c, -c, 1.f};
+    const float n = 0.1f, f = 100.f, t = 1.f / std::tan(0.5f);
+    const Matrix4f proj{t * rows / cols, 0.f, 0.f, 0.f, 0.f, t, 0.f, 0.f,
+                        0.f, 0.f, -(f + n) / (f - n), -1.f, 0.f, 0.f, -2 * f * n / (f - n), 0.f};
+    return std::make_shared<scene::Camera>(view, proj);
+}
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    if (void* ptr = countedAlloc(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { countedFree(ptr); }
+
+int main(int argc, char** argv)
+{
+    btAlignedAllocSetCustom(countedAlloc, countedFree);
+    b3AlignedAllocSetCustom(countedAlloc, countedFree);
+
+    const int cols = 320, rows = 240, warmup = 3, frames = 20;
+    const int numThreads = argc > 1 ? std::atoi(argv[1]) : 0;
+    render::TinyRendererBackend renderer(numThreads);
+
+    std::vector<uint8_t> color(cols * rows * 4);
+    std::vector<float> depth(cols * rows);
+    std::vector<int> mask(cols * rows);
+    render::FrameData frame{cols, rows, color.data(), depth.data(), mask.data()};
+
+    auto state = std::make_shared<scene::SceneState>();
+    state->appendNode(0);
+    auto material = std::make_shared<scene::Material>(Color4f{0.8f, 0.8f, 0.8f, 1.f},
+                                                      Color3f{1.f, 1.f, 1.f});
+
+    std::printf("%10s %8s %12s %16s %18s\n", "triangles", "mode", "ms/frame", "allocs/frame",
+                "allocs/triangle");
+    long firstAllocations = -1;
+    bool constant = true;
+    for (int n : {16, 64, 256}) {
+        auto mesh = std::make_shared<scene::Mesh>(makeGrid(n, 20.f));
+        std::vector<scene::Shape> shapes{
+            scene::Shape(scene::ShapeType::Mesh, Affine3f::Identity(), mesh, material)};
+        auto graph = std::make_shared<scene::SceneGraph>();
+        graph->appendNode(0, scene::Node(0, -1, std::move(shapes)));
+        renderer.updateScene(graph, false);
+
+        for (int channels : {int(scene::OutputChannel::Color) | int(scene::OutputChannel::Depth) |
+                                 int(scene::OutputChannel::Mask),
+                             int(scene::OutputChannel::Depth)}) {
+            auto view = std::make_shared<scene::SceneView>();
+            view->setCamera(makeCamera(cols, rows));
+            view->setOutputChannels(channels);
+
+            for (int i = 0; i < warmup; ++i)
+                renderer.renderFrame(state, view, frame);
+
+            const long before = gAllocations;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < frames; ++i)
+                renderer.renderFrame(state, view, frame);
+            const double ms = std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+            const long allocations = (gAllocations - before) / frames;
+
+            const int triangles = 2 * n * n;
+            std::printf("%10d %8s %12.2f %16ld %18.6f\n", triangles,
+                        channels == int(scene::OutputChannel::Depth) ? "depth" : "all",
+                        ms / frames, allocations, double(allocations) / triangles);
+            if (firstAllocations < 0)
+                firstAllocations = allocations;
+            constant = constant && allocations <= firstAllocations;
+        }
+    }
+    if (!constant)
+        std::printf("allocations grow with the number of triangles\n");
+    return constant ? EXIT_SUCCESS : EXIT_FAILURE;
+}
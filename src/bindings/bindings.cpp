@@ -18,8 +18,25 @@ PYBIND11_MODULE(bindings, m)
 {
     m.doc() = "PyBullet rendering plugin binding";
 
-    bindUtils(m);
-    bindRender(m);
-    bindScene(m);
-    bindPlugin(m);
+    // the plugin loads this module again, only the natives of its load are bound at import,
+    // the rest at the first access to any other name
+    bindPluginEntry(m);
+    py::handle module = m;
+    m.def("__getattr__", [module](const std::string& name) -> py::object {
+        static bool bound = false;
+        py::dict names = module.attr("__dict__");
+        if (!bound && name.compare(0, 2, "__") != 0) {
+            bound = true;
+            py::module m = py::reinterpret_borrow<py::module>(module);
+            bindUtils(m);
+            bindRender(m);
+            bindScene(m);
+            bindPlugin(m);
+        }
+        if (names.contains(name))
+            return names[name.c_str()];
+        PyErr_SetString(PyExc_AttributeError,
+                        ("module 'bindings' has no attribute '" + name + "'").c_str());
+        throw py::error_already_set();
+    });
 }
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <render/BaseRenderer.h>
+
+#include <scene/SceneGraph.h>
+#include <scene/SceneState.h>
+#include <scene/SceneView.h>
+
+/**
+ * @brief Native renderer bound to a physics client, releasing the GIL while it works
+ *
+ * pybullet holds the GIL through getCameraImage and the simulation calls driving the render
+ * interface, so that other python threads would wait for the whole native render. The GIL is
+ * released only when the calling thread holds it, e.g. not on the thread of an async renderer.
+ */
+class NativeRenderer : public render::BaseRenderer
+{
+  public:
+    /**
+     * @brief Construct a new Native Renderer object
+     *
+     * @param renderer - native renderer, not implemented in python
+     */
+    explicit NativeRenderer(const std::shared_ptr<render::BaseRenderer>& renderer)
+        : _renderer(renderer)
+    {
+    }
+
+    void updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                     bool materialsOnly) override
+    {
+        released([&] { _renderer->updateScene(sceneGraph, materialsOnly); });
+    }
+
+    void applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                         const scene::SceneGraphDelta& delta) override
+    {
+        released([&] { _renderer->applySceneDelta(sceneGraph, delta); });
+    }
+
+    bool updateShapeGeometry(int nodeId, int shapeIndex,
+                             const std::shared_ptr<scene::MeshData>& meshData) override
+    {
+        return released(
+            [&] { return _renderer->updateShapeGeometry(nodeId, shapeIndex, meshData); });
+    }
+
+    bool updateShapeHeightfield(int nodeId, int shapeIndex,
+                                const std::shared_ptr<scene::Heightfield>& heightfield) override
+    {
+        return released(
+            [&] { return _renderer->updateShapeHeightfield(nodeId, shapeIndex, heightfield); });
+    }
+
+    bool updateShapeMaterial(int nodeId, int shapeIndex,
+                             const std::shared_ptr<scene::Material>& material) override
+    {
+        return released(
+            [&] { return _renderer->updateShapeMaterial(nodeId, shapeIndex, material); });
+    }
+
+    bool updateShapeTexels(int nodeId, int shapeIndex,
+                           const std::shared_ptr<scene::Texture>& texture) override
+    {
+        return released(
+            [&] { return _renderer->updateShapeTexels(nodeId, shapeIndex, texture); });
+    }
+
+    bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                     const std::shared_ptr<scene::SceneView>& sceneView,
+                     render::FrameData& outputFrame) override
+    {
+        return released(
+            [&] { return _renderer->renderFrame(sceneState, sceneView, outputFrame); });
+    }
+
+    bool renderFrames(const std::shared_ptr<scene::SceneState>& sceneState,
+                      const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                      std::vector<render::FrameData>& outputFrames) override
+    {
+        return released(
+            [&] { return _renderer->renderFrames(sceneState, sceneViews, outputFrames); });
+    }
+
+    render::RendererMemory memoryUsage() const override { return _renderer->memoryUsage(); }
+
+    int numaNode() const override { return _renderer->numaNode(); }
+
+    bool uploadAssets(const scene::Shape& shape) override
+    {
+        return released([&] { return _renderer->uploadAssets(shape); });
+    }
+
+    bool drawsBaseLayer() const override { return _renderer->drawsBaseLayer(); }
+
+    void blockingWait(const std::function<void()>& wait) override
+    {
+        released([&] { _renderer->blockingWait(wait); });
+    }
+
+  private:
+    /**
+     * @brief Call \p function without the GIL if the calling thread holds it
+     */
+    template <class Function>
+    static auto released(const Function& function) -> decltype(function())
+    {
+        if (!PyGILState_Check())
+            return function();
+        py::gil_scoped_release release;
+        return function();
+    }
+
+    std::shared_ptr<render::BaseRenderer> _renderer;
+};
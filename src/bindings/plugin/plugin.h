@@ -1,18 +1,759 @@
 #pragma once
 
+#include "../render/PyRenderer.h"
+#include "../render/render.h"
+#include "NativeRenderer.h"
+
+#include <plugin/AssetPrefetch.h>
+#include <plugin/CameraDepthPyramid.h>
+#include <plugin/CameraEvents.h>
+#include <plugin/CameraMotion.h>
+#include <plugin/CameraNormals.h>
+#include <plugin/CameraKeypoints.h>
+#include <plugin/CameraPixelCounts.h>
+#include <plugin/CameraPoints.h>
+#include <plugin/FrameRecorder.h>
+#include <plugin/FrameRing.h>
+#include <plugin/ImportedLink.h>
+#include <plugin/MemoryReport.h>
 #include <render/BaseRenderer.h>
+#include <render/StageStats.h>
+#include <scene/Randomization.h>
+#include <scene/SceneLayer.h>
+#include <scene/SceneView.h>
 
 extern void gSetRenderer(const std::shared_ptr<render::BaseRenderer>& renderer,
                          int physicsClientId);
+extern void gImportLinks(std::vector<ImportedLink> links, int physicsClientId);
+extern std::shared_ptr<const void>
+    gSetCameraBatch(const std::vector<std::shared_ptr<scene::Camera>>& cameras,
+                    const std::vector<render::FrameData>& frames,
+                    const std::shared_ptr<const void>& owner, int physicsClientId);
+extern bool gRenderCamera(const Matrix4f& viewMatrix, const Matrix4f& projMatrix,
+                          const render::FrameData& frame, int physicsClientId);
+extern void gSetFrameSink(const std::string& name, int cols, int rows, int numSlots,
+                          int physicsClientId);
+extern void gSetRandomization(const std::shared_ptr<scene::Randomization>& randomization,
+                              const std::string& logPath, int physicsClientId);
+extern uint64_t gNextRandomizationEpisode(int physicsClientId);
+extern int gRegisterTexture(const std::shared_ptr<scene::Bitmap>& bitmap, int physicsClientId);
+extern int gChangeTexels(int textureId, int physicsClientId);
+extern std::shared_ptr<scene::SceneLayer> gMakeBaseLayer(const std::set<int>& bodies,
+                                                         int physicsClientId);
+extern void gSetBaseLayer(const std::shared_ptr<scene::SceneLayer>& layer,
+                          const std::set<int>& bodies, int physicsClientId);
+extern std::pair<uint64_t, uint64_t> gGetFrameCacheStats(int physicsClientId);
+extern double gGetFrameStep(int physicsClientId);
+extern CameraPoints gGetCameraPoints(int physicsClientId);
+extern CameraMotion gGetCameraMotion(int physicsClientId);
+extern CameraNormals gGetCameraNormals(int physicsClientId);
+extern CameraDepthPyramid gGetCameraDepthPyramid(int physicsClientId);
+extern CameraEvents gGetCameraEvents(int physicsClientId);
+extern CameraPixelCounts gGetCameraPixelCounts(int physicsClientId);
+extern CameraKeypoints gGetCameraKeypoints(int physicsClientId);
+extern std::vector<render::StageSummary> gGetStageStats(int physicsClientId);
+extern void gResetStageStats(int physicsClientId);
+extern MemoryReport gGetMemoryReport(int physicsClientId);
+extern ProcessMemoryReport gGetProcessMemoryReport();
+extern void gPruneAssetCache();
+extern std::pair<std::vector<int>, uint64_t> gAssetCacheIds();
+extern uint64_t gAssetCacheRevision();
+extern int gPreloadAssets(const std::vector<std::string>& filenames);
+extern void gStartTrace(const std::string& path);
+extern bool gStopTrace();
+extern bool gWriteTrace(const std::string& path);
+extern uint64_t gTraceDroppedEvents();
+extern void gCaptureTraceOutliers(const std::string& directory, int frames, double thresholdMs,
+                                  double medianFactor);
+extern int gTraceCapturedFrames();
+extern void gAnnounceClient(int physicsClientId);
+extern bool gTakeRegistration(int physicsClientId);
+
+/**
+ * @brief Read-only view of a shared frame plane kept alive by \p owner, None if not published
+ */
+template <class T>
+py::object sharedPlane(const T* data, bool published, std::initializer_list<int> shape,
+                       const py::object& owner)
+{
+    if (!published)
+        return py::none();
+    py::array_t<T> array(std::vector<ssize_t>(shape.begin(), shape.end()), data, owner);
+    array.attr("setflags")("write"_a = false);
+    return std::move(array);
+}
+
+/**
+ * @brief Keep a python object alive from C++, released with the GIL from any thread
+ */
+std::shared_ptr<const void> pythonOwner(py::object object)
+{
+    return std::shared_ptr<const void>(new py::object(std::move(object)), [](const void* p) {
+        const auto object = static_cast<const py::object*>(p);
+        if (!Py_IsInitialized())
+            return; //<- leaked at interpreter teardown
+        py::gil_scoped_acquire gil;
+        delete object;
+    });
+}
+
+/**
+ * @brief Dict of the memory of scene assets
+ */
+py::dict assetMemoryDict(const scene::AssetMemory& assets)
+{
+    py::dict result;
+    result["mesh_bytes"] = assets.meshBytes;
+    result["texture_bytes"] = assets.textureBytes;
+    result["heightfield_bytes"] = assets.heightfieldBytes;
+    result["shared_bytes"] = assets.sharedBytes;
+    result["meshes"] = assets.meshes;
+    result["textures"] = assets.textures;
+    result["heightfields"] = assets.heightfields;
+    result["total_bytes"] = assets.total();
+    return result;
+}
+
+/**
+ * @brief Dict of the memory of a renderer
+ */
+py::dict rendererMemoryDict(const render::RendererMemory& memory)
+{
+    py::dict result;
+    result["gpu_bytes"] = memory.gpuBytes;
+    result["peak_gpu_bytes"] = memory.peakGpuBytes;
+    result["host_bytes"] = memory.hostBytes;
+    return result;
+}
+
+/**
+ * @brief Bind the natives loading the plugin, kept light as they are bound at import
+ */
+void bindPluginEntry(py::module& m)
+{
+    m.def("_announce_client", &gAnnounceClient, py::arg("physics_client_id"),
+          "Announce the client of the next plugin load on this thread, registered by the load");
+    m.def("_take_registration", &gTakeRegistration, py::arg("physics_client_id"),
+          "Whether the last plugin load on this thread registered the announced client");
+}
 
 void bindPlugin(py::module& m)
 {
     using namespace render;
 
     // Module-level function
-    m.def("set_renderer", //
-          [](std::shared_ptr<BaseRenderer>& render, int physicsClientId) {
-              gSetRenderer(render, physicsClientId);
+    // the GIL is released while waiting for the lock of a client interface, which a native
+    // render holds without the GIL
+    m.def("set_renderer",
+          [](std::shared_ptr<BaseRenderer>& render, int physicsClientId, bool cacheOverrides) {
+              std::shared_ptr<BaseRenderer> renderer = render;
+              if (auto pyRenderer = std::dynamic_pointer_cast<PyRenderer>(render)) {
+                  if (cacheOverrides)
+                      pyRenderer->cacheOverrides();
+              }
+              else if (render) {
+                  renderer = std::make_shared<NativeRenderer>(render);
+              }
+              py::gil_scoped_release release;
+              gSetRenderer(renderer, physicsClientId);
+          },
+          py::arg("renderer"), py::arg("physics_client_id"), py::arg("cache_overrides") = true,
+          "Set renderer for a specific client, python overrides being resolved once if "
+          "cache_overrides");
+
+    // (geometry type, dimensions, mesh file, frame in the inertial frame, rgba)
+    using ShapeTuple = std::tuple<int, std::array<double, 3>, std::string, std::array<double, 7>,
+                                  std::array<double, 4>>;
+    // (body, link, world frame of the inertial frame, fixed base, shapes)
+    using LinkTuple =
+        std::tuple<int, int, std::array<double, 7>, bool, std::vector<ShapeTuple>>;
+    m.def(
+        "import_links",
+        [](const std::vector<LinkTuple>& linkTuples, int physicsClientId) {
+            std::vector<ImportedLink> links;
+            for (const auto& link : linkTuples) {
+                links.push_back({std::get<0>(link), std::get<1>(link), std::get<2>(link),
+                                 std::get<3>(link), {}});
+                for (const auto& shape : std::get<4>(link))
+                    links.back().shapes.push_back({std::get<0>(shape), std::get<1>(shape),
+                                                   std::get<2>(shape), std::get<3>(shape),
+                                                   std::get<4>(shape)});
+            }
+            py::gil_scoped_release release;
+            gImportLinks(std::move(links), physicsClientId);
+        },
+        py::arg("links"), py::arg("physics_client_id"),
+        "Add the links of the bodies a specific client loaded before the plugin, as tuples of "
+        "(body, link, inertial frame, fixed base, shapes)");
+
+    m.def("set_camera_batch",
+          [](int physicsClientId, const std::vector<Matrix4f>& viewMatrices,
+             const std::vector<Matrix4f>& projMatrices,
+             py::array_t<uint8_t, py::array::c_style> color,
+             py::array_t<float, py::array::c_style> depth,
+             py::array_t<int, py::array::c_style> mask) {
+              const auto count = ssize_t(viewMatrices.size());
+              if (ssize_t(projMatrices.size()) != count)
+                  throw std::invalid_argument("Number of view and projection matrices mismatch");
+              if (color.ndim() != 4 || color.shape(0) != count || color.shape(3) != 4)
+                  throw std::invalid_argument("Color buffer shape must be (N, H, W, 4)");
+
+              // empty depth or mask buffers skip their channel
+              const auto rows = color.shape(1), cols = color.shape(2);
+              const bool hasDepth = depth.size() != 0, hasMask = mask.size() != 0;
+              if (hasDepth && (depth.ndim() != 3 || depth.shape(0) != count ||
+                               depth.shape(1) != rows || depth.shape(2) != cols))
+                  throw std::invalid_argument("Depth buffer shape must be (N, H, W)");
+              if (hasMask && (mask.ndim() != 3 || mask.shape(0) != count ||
+                              mask.shape(1) != rows || mask.shape(2) != cols))
+                  throw std::invalid_argument("Mask buffer shape must be (N, H, W)");
+
+              std::vector<std::shared_ptr<scene::Camera>> cameras;
+              std::vector<FrameData> frames;
+              for (ssize_t i = 0; i < count; ++i) {
+                  cameras.push_back(
+                      std::make_shared<scene::Camera>(viewMatrices[i], projMatrices[i]));
+                  frames.push_back(FrameData{int(cols), int(rows), color.mutable_data(i),
+                                             hasDepth ? depth.mutable_data(i) : nullptr,
+                                             hasMask ? mask.mutable_data(i) : nullptr});
+              }
+              // the interface writes into the arrays until the batch is replaced or cleared
+              const auto owner = pythonOwner(py::make_tuple(color, depth, mask));
+              std::shared_ptr<const void> previous;
+              {
+                  py::gil_scoped_release release;
+                  previous = gSetCameraBatch(cameras, frames, owner, physicsClientId);
+              }
           },
-          "Set renderer for a specific client");
+          py::arg("physics_client_id"), py::arg("view_matrices"),
+          py::arg("projection_matrices"), py::arg("color").noconvert(),
+          py::arg("depth").noconvert(), py::arg("mask").noconvert(),
+          "Render several cameras with the next camera image request of a specific client, "
+          "into (N,H,W,4) colors and (N,H,W) depth and masks, channels of empty buffers being "
+          "skipped; the arrays are referenced until clear_camera_batch() or the next batch");
+
+    m.def(
+        "clear_camera_batch",
+        [](int physicsClientId) {
+            std::shared_ptr<const void> previous;
+            {
+                py::gil_scoped_release release;
+                previous = gSetCameraBatch({}, {}, nullptr, physicsClientId);
+            }
+        },
+        py::arg("physics_client_id"),
+        "Drop the camera batch of a specific client and its reference to the arrays");
+
+    m.def(
+        "render_camera",
+        [](int physicsClientId, const Matrix4f& viewMatrix, const Matrix4f& projMatrix,
+           py::array_t<uint8_t, py::array::c_style> color,
+           py::array_t<float, py::array::c_style> depth,
+           py::array_t<int, py::array::c_style> mask) {
+            if (color.ndim() != 3 || color.shape(2) != 4 || !color.writeable())
+                throw std::invalid_argument("Color buffer must be a writeable (H, W, 4) array");
+
+            // empty depth or mask buffers skip their channel
+            const auto rows = color.shape(0), cols = color.shape(1);
+            const bool hasDepth = depth.size() != 0, hasMask = mask.size() != 0;
+            if (hasDepth && (depth.ndim() != 2 || depth.shape(0) != rows ||
+                             depth.shape(1) != cols || !depth.writeable()))
+                throw std::invalid_argument("Depth buffer must be a writeable (H, W) array");
+            if (hasMask && (mask.ndim() != 2 || mask.shape(0) != rows ||
+                            mask.shape(1) != cols || !mask.writeable()))
+                throw std::invalid_argument("Mask buffer must be a writeable (H, W) array");
+
+            const FrameData frame{int(cols), int(rows), color.mutable_data(),
+                                  hasDepth ? depth.mutable_data() : nullptr,
+                                  hasMask ? mask.mutable_data() : nullptr};
+            py::gil_scoped_release release;
+            return gRenderCamera(viewMatrix, projMatrix, frame, physicsClientId);
+        },
+        py::arg("physics_client_id"), py::arg("view_matrix"), py::arg("projection_matrix"),
+        py::arg("color").noconvert(), py::arg("depth").noconvert(),
+        py::arg("mask").noconvert(),
+        "Render a camera of a DIRECT client straight into (H,W,4) color and (H,W) depth and "
+        "mask buffers, without the physics server, channels of empty buffers being skipped; "
+        "False without renderer");
+
+    m.def(
+        "set_frame_sink",
+        [](int physicsClientId, const std::string& name, int width, int height, int numSlots) {
+            py::gil_scoped_release release;
+            gSetFrameSink(name, width, height, numSlots, physicsClientId);
+        },
+        py::arg("physics_client_id"), py::arg("name"), py::arg("width") = 0,
+        py::arg("height") = 0, py::arg("num_slots") = 4,
+        "Publish rendered frames of a specific client into a shared-memory ring, an empty "
+        "name stops publishing");
+
+    py::class_<FrameRing, std::shared_ptr<FrameRing>>(m, "FrameRing")
+        .def(py::init(&FrameRing::open), py::arg("name"),
+             "Open a ring of frames published with set_frame_sink, possibly by another process")
+        .def_property_readonly("name", &FrameRing::name, "Shared memory name")
+        .def_property_readonly("width", &FrameRing::cols, "Frame width")
+        .def_property_readonly("height", &FrameRing::rows, "Frame height")
+        .def_property_readonly("num_slots", &FrameRing::numSlots, "Number of frames kept")
+        .def_property_readonly("latest", &FrameRing::latest,
+                               "Sequence of the last published frame, 0 if none")
+        .def(
+            "valid",
+            [](const FrameRing& self, uint64_t sequence) {
+                return sequence > 0 && self.slotSequence(self.slotOf(sequence)) == sequence;
+            },
+            py::arg("sequence"), "Whether a frame is still in the ring and not being overwritten")
+        .def(
+            "frame",
+            [](py::object self, uint64_t sequence) {
+                const auto& ring = self.cast<const FrameRing&>();
+                if (sequence == 0)
+                    sequence = ring.latest();
+                const int slot = sequence > 0 ? ring.slotOf(sequence) : 0;
+                if (sequence == 0 || ring.slotSequence(slot) != sequence)
+                    throw py::key_error("Frame " + std::to_string(sequence) +
+                                        " is not in the ring");
+
+                const int channels = ring.slotChannels(slot);
+                const auto has = [channels](scene::OutputChannel channel) {
+                    return bool(channels & int(channel));
+                };
+                const int rows = ring.rows(), cols = ring.cols();
+                return py::make_tuple(
+                    sequence,
+                    sharedPlane(ring.color(slot), has(scene::OutputChannel::Color),
+                                {rows, cols, 4}, self),
+                    sharedPlane(ring.depth(slot), has(scene::OutputChannel::Depth),
+                                {rows, cols}, self),
+                    sharedPlane(ring.mask(slot), has(scene::OutputChannel::Mask), {rows, cols},
+                                self));
+            },
+            py::arg("sequence") = 0,
+            "Sequence and read-only color, depth and mask views of a frame, the latest one by "
+            "default; the views are overwritten num_slots frames later, check valid(sequence) "
+            "after reading them");
+
+    py::class_<FrameRecorder, std::shared_ptr<FrameRecorder>>(m, "FrameRecorder")
+        .def(py::init([](const std::string& directory, int chunkFrames, bool compress,
+                         size_t queueSize, bool blocking) {
+                 FrameRecorder::Options options;
+                 options.directory = directory;
+                 options.chunkFrames = chunkFrames;
+                 options.compress = compress;
+                 options.queueSize = queueSize;
+                 options.blocking = blocking;
+                 return FrameRecorder::create(options);
+             }),
+             py::arg("directory"), py::arg("chunk_frames") = 64, py::arg("compress") = true,
+             py::arg("queue_size") = 16, py::arg("blocking") = false,
+             "Dataset of frames in the layout of RenderingPlugin.start_recording, complete once "
+             "the recorder is deleted")
+        .def_property_readonly("dropped", &FrameRecorder::dropped, "Number of frames dropped")
+        .def(
+            "push",
+            [](FrameRecorder& self, py::array_t<uint8_t, py::array::c_style> color,
+               py::object depth, py::object mask, const scene::SceneState& sceneState,
+               const std::shared_ptr<scene::Camera>& camera) {
+                if (color.ndim() != 3 || color.shape(2) != 4)
+                    throw std::invalid_argument("Color image shape must be (H, W, 4)");
+                const auto rows = color.shape(0), cols = color.shape(1);
+                const auto checked = [rows, cols](const py::object& image, auto type) {
+                    using T = decltype(type);
+                    if (image.is_none())
+                        return py::array_t<T, py::array::c_style>();
+                    auto array = py::array_t<T, py::array::c_style>::ensure(image);
+                    if (!array || array.ndim() != 2 || array.shape(0) != rows ||
+                        array.shape(1) != cols)
+                        throw std::invalid_argument("Depth and mask shapes must be (H, W)");
+                    return array;
+                };
+                const auto depthPlane = checked(depth, float());
+                const auto maskPlane = checked(mask, int());
+                const FrameData frame{int(cols), int(rows), color.mutable_data(),
+                                      depth.is_none() ? nullptr
+                                                      : const_cast<float*>(depthPlane.data()),
+                                      mask.is_none() ? nullptr
+                                                     : const_cast<int*>(maskPlane.data())};
+                // arguments keep the planes alive while a blocking push waits
+                py::gil_scoped_release release;
+                return self.push(frame, camera, sceneState);
+            },
+            py::arg("color"), py::arg("depth"), py::arg("mask"), py::arg("scene_state"),
+            py::arg("camera") = nullptr,
+            "Queue a frame, returns False if it was dropped, waits for room in the queue if "
+            "blocking");
+
+    py::class_<AssetPrefetch, std::shared_ptr<AssetPrefetch>>(m, "AssetPrefetch")
+        .def(py::init([](const std::vector<std::string>& filenames,
+                         const std::shared_ptr<BaseRenderer>& renderer, int numThreads) {
+                 // python renderers load their assets themselves
+                 auto native =
+                     std::dynamic_pointer_cast<PyRenderer>(renderer) ? nullptr : renderer;
+                 return std::make_shared<AssetPrefetch>(filenames, native, numThreads);
+             }),
+             py::arg("filenames"), py::arg("renderer") = nullptr, py::arg("num_threads") = 0,
+             "Load mesh and image files into the asset cache on background threads, then "
+             "upload them to the GPU of a native renderer if given; the assets stay cached "
+             "until the prefetch is deleted")
+        .def("done", &AssetPrefetch::done, "All files are loaded, or failed to")
+        .def("wait", &AssetPrefetch::wait, py::arg("timeout") = 0.0,
+             py::call_guard<py::gil_scoped_release>(),
+             "Wait for all files, at most timeout seconds if positive, returns True if done")
+        .def(
+            "times",
+            [](const AssetPrefetch& self) {
+                py::list result;
+                for (const auto& time : self.times()) {
+                    py::dict values;
+                    values["filename"] = time.filename;
+                    values["loaded"] = time.loaded;
+                    values["uploaded"] = time.uploaded;
+                    values["load_seconds"] = time.loadSeconds;
+                    values["upload_seconds"] = time.uploadSeconds;
+                    result.append(values);
+                }
+                return result;
+            },
+            "Load and upload seconds of each file of the manifest, in order, zero for the "
+            "files not done yet");
+
+    m.def("set_randomization", &gSetRandomization, py::arg("randomization"),
+          py::arg("log_path"), py::arg("physics_client_id"),
+          py::call_guard<py::gil_scoped_release>(),
+          "Randomize materials and light of the images of a specific client, None to stop; "
+          "samples are appended to log_path as lines of json unless empty");
+
+    m.def("next_randomization_episode", &gNextRandomizationEpisode,
+          py::arg("physics_client_id"), py::call_guard<py::gil_scoped_release>(),
+          "Start the next randomization episode of a specific client, returns its index");
+
+    m.def(
+        "register_texture",
+        [](py::array_t<uint8_t, py::array::c_style> pixels, int physicsClientId) {
+            if (pixels.ndim() != 3 || pixels.shape(2) < 1 || pixels.shape(2) > 4)
+                throw std::invalid_argument("Texture shape must be (H, W, C), C from 1 to 4");
+            // the bitmap keeps the array alive, released with the GIL held
+            auto owner = new py::object(pixels);
+            const std::shared_ptr<const uint8_t> data(pixels.data(), [owner](const uint8_t*) {
+                py::gil_scoped_acquire gil;
+                delete owner;
+            });
+            auto bitmap = std::make_shared<scene::Bitmap>(
+                data, size_t(pixels.size()),
+                scene::Size2i{int(pixels.shape(1)), int(pixels.shape(0))});
+            py::gil_scoped_release release;
+            return gRegisterTexture(bitmap, physicsClientId);
+        },
+        py::arg("pixels").noconvert(), py::arg("physics_client_id"),
+        "Register a texture of a specific client wrapping a uint8 (H, W, C) array without "
+        "copying it, returns its id; call change_texels after writing into the array");
+
+    m.def("change_texels", &gChangeTexels, py::arg("texture_id"), py::arg("physics_client_id"),
+          py::call_guard<py::gil_scoped_release>(),
+          "Notify a specific client that the pixels of a registered texture were rewritten, "
+          "returns the number of nodes using it, -1 for unknown textures");
+
+    m.def("make_base_layer", &gMakeBaseLayer, py::arg("body_ids"), py::arg("physics_client_id"),
+          py::call_guard<py::gil_scoped_release>(),
+          "Freeze the nodes of some bodies of a specific client at their current poses into a "
+          "layer other clients can share");
+
+    m.def("set_base_layer", &gSetBaseLayer, py::arg("layer"), py::arg("body_ids"),
+          py::arg("physics_client_id"), py::call_guard<py::gil_scoped_release>(),
+          "Draw a layer under the scene of a specific client in place of the nodes of some "
+          "bodies, the bodies of the layer if empty, None to stop");
+
+    m.def("get_frame_cache_stats", &gGetFrameCacheStats,
+          py::call_guard<py::gil_scoped_release>(),
+          "Frame cache hits and misses of a specific client");
+
+    m.def(
+        "get_camera_points",
+        [](int physicsClientId) -> py::object {
+            CameraPoints points;
+            {
+                py::gil_scoped_release release;
+                points = gGetCameraPoints(physicsClientId);
+            }
+            if (points.count == 0 && !points.compact)
+                return py::none();
+            const ssize_t count = points.count;
+            const auto shape = points.compact
+                                   ? std::vector<ssize_t>{count, 3}
+                                   : std::vector<ssize_t>{points.rows, points.cols, 3};
+            py::array_t<float> xyz(shape);
+            std::copy(points.points.begin(), points.points.end(), xyz.mutable_data());
+            if (!points.compact)
+                return py::make_tuple(xyz, py::none());
+            py::array_t<int> ids(count);
+            std::copy(points.ids.begin(), points.ids.end(), ids.mutable_data());
+            return py::make_tuple(xyz, ids);
+        },
+        py::arg("physics_client_id"),
+        "Points of the last camera image of a specific client, (H,W,3) and None or (N,3) and "
+        "segmentation ids (N,) if compact, None if no points were rendered");
+
+    m.def(
+        "get_camera_motion",
+        [](int physicsClientId) -> py::object {
+            CameraMotion motion;
+            {
+                py::gil_scoped_release release;
+                motion = gGetCameraMotion(physicsClientId);
+            }
+            if (motion.motion.empty())
+                return py::none();
+            py::array_t<uint16_t> halves({ssize_t(motion.rows), ssize_t(motion.cols), ssize_t(2)});
+            std::copy(motion.motion.begin(), motion.motion.end(), halves.mutable_data());
+            return halves.attr("view")("float16");
+        },
+        py::arg("physics_client_id"),
+        "Motion of the pixels of the last camera image of a specific client since the previous "
+        "one, (H,W,2) float16, None if no motion was rendered");
+
+    m.def(
+        "get_camera_normals",
+        [](int physicsClientId) -> py::object {
+            CameraNormals normals;
+            {
+                py::gil_scoped_release release;
+                normals = gGetCameraNormals(physicsClientId);
+            }
+            if (normals.normals.empty())
+                return py::none();
+            py::array_t<uint16_t> halves(
+                {ssize_t(normals.rows), ssize_t(normals.cols), ssize_t(3)});
+            std::copy(normals.normals.begin(), normals.normals.end(), halves.mutable_data());
+            return halves.attr("view")("float16");
+        },
+        py::arg("physics_client_id"),
+        "Camera frame normals of the pixels of the last camera image of a specific client, "
+        "(H,W,3) float16 facing the camera, zero where nothing was drawn, None if no normals "
+        "were rendered");
+
+    m.def(
+        "get_camera_depth_pyramid",
+        [](int physicsClientId) -> py::object {
+            CameraDepthPyramid pyramid;
+            {
+                py::gil_scoped_release release;
+                pyramid = gGetCameraDepthPyramid(physicsClientId);
+            }
+            if (pyramid.depths.empty())
+                return py::none();
+            return depthLevels(pyramid.cols, pyramid.rows, pyramid.levels, pyramid.depths.data());
+        },
+        py::arg("physics_client_id"),
+        "Depth pyramid of the last camera image of a specific client, a list of (H/2^l,W/2^l,2) "
+        "nearest and farthest depths of the levels l from 1, views of a single packed buffer, "
+        "None if no pyramid was rendered");
+
+    m.def(
+        "get_camera_events",
+        [](int physicsClientId) -> py::object {
+            CameraEvents events;
+            {
+                py::gil_scoped_release release;
+                events = gGetCameraEvents(physicsClientId);
+            }
+            if (!events.found)
+                return py::none();
+            py::array_t<float> list({ssize_t(events.events.size() / 4), ssize_t(4)});
+            std::copy(events.events.begin(), events.events.end(), list.mutable_data());
+            return list;
+        },
+        py::arg("physics_client_id"),
+        "Events of the last camera image of a specific client since the previous one, (N,4) "
+        "float32 of x, y from the top, time in seconds and polarity, None if no events were "
+        "requested");
+
+    m.def(
+        "get_camera_pixel_counts",
+        [](int physicsClientId) -> py::object {
+            CameraPixelCounts pixelCounts;
+            {
+                py::gil_scoped_release release;
+                pixelCounts = gGetCameraPixelCounts(physicsClientId);
+            }
+            if (!pixelCounts.counted)
+                return py::none();
+            py::array_t<int> list({ssize_t(pixelCounts.counts.size() / 2), ssize_t(2)});
+            std::copy(pixelCounts.counts.begin(), pixelCounts.counts.end(), list.mutable_data());
+            return list;
+        },
+        py::arg("physics_client_id"),
+        "Segmentation ids seen in the last camera image of a specific client and their pixels, "
+        "(N,2) int32 by increasing id, None if no pixel counts were requested");
+
+    m.def(
+        "get_camera_boxes",
+        [](int physicsClientId) -> py::object {
+            CameraPixelCounts pixelCounts;
+            {
+                py::gil_scoped_release release;
+                pixelCounts = gGetCameraPixelCounts(physicsClientId);
+            }
+            if (!pixelCounts.counted || pixelCounts.boxes.size() != pixelCounts.counts.size() * 2)
+                return py::none();
+            py::array_t<int> list({ssize_t(pixelCounts.boxes.size() / 4), ssize_t(4)});
+            std::copy(pixelCounts.boxes.begin(), pixelCounts.boxes.end(), list.mutable_data());
+            return list;
+        },
+        py::arg("physics_client_id"),
+        "Image bounds of the segmentation ids seen in the last camera image of a specific client, "
+        "(N,4) int32 x0, y0, x1, y1 of the first and last columns and rows from the top, in the "
+        "order of get_camera_pixel_counts, None if no boxes were requested");
+
+    m.def(
+        "get_camera_keypoints",
+        [](int physicsClientId) -> py::object {
+            CameraKeypoints keypoints;
+            {
+                py::gil_scoped_release release;
+                keypoints = gGetCameraKeypoints(physicsClientId);
+            }
+            if (!keypoints.projected)
+                return py::none();
+            py::array_t<float> list({ssize_t(keypoints.keypoints.size() / 4), ssize_t(4)});
+            std::copy(keypoints.keypoints.begin(), keypoints.keypoints.end(),
+                      list.mutable_data());
+            return list;
+        },
+        py::arg("physics_client_id"),
+        "Keypoints projected into the last camera image of a specific client, (N,4) float32 x, "
+        "y in pixels from the top left corner, depth and 1 if visible or 0, NaN for the points "
+        "of links not in the scene, None if there were no keypoints");
+
+    m.def("get_frame_step", &gGetFrameStep, py::arg("physics_client_id"),
+          py::call_guard<py::gil_scoped_release>(),
+          "Physics step the last frame of a specific client was rendered at, counted since its "
+          "render schedule was set, fractional for interpolated poses");
+
+    m.def(
+        "get_stage_stats",
+        [](int physicsClientId) {
+            std::vector<StageSummary> summaries;
+            {
+                py::gil_scoped_release release;
+                summaries = gGetStageStats(physicsClientId);
+            }
+            py::dict result;
+            for (int stage = 0; stage < int(Stage::Count); ++stage) {
+                const auto& summary = summaries[stage];
+                py::dict values;
+                values["count"] = summary.count;
+                values["window"] = summary.window;
+                values["mean"] = summary.mean;
+                values["p50"] = summary.p50;
+                values["p90"] = summary.p90;
+                values["p99"] = summary.p99;
+                values["max"] = summary.max;
+                values["histogram"] = std::vector<uint32_t>(summary.histogram.begin(),
+                                                            summary.histogram.end());
+                result[stageName(Stage(stage))] = values;
+            }
+            return result;
+        },
+        py::arg("physics_client_id"),
+        "Durations in milliseconds of the steps of the camera images of a specific client, by "
+        "stage, over their last samples; histogram bucket k counts durations of [2^k, 2^(k+1)) "
+        "microseconds");
+
+    m.def(
+        "get_memory_report",
+        [](int physicsClientId) {
+            MemoryReport report;
+            {
+                py::gil_scoped_release release;
+                report = gGetMemoryReport(physicsClientId);
+            }
+            py::list nodes;
+            for (const auto& it : report.nodes) {
+                py::dict node;
+                node["node"] = it.first;
+                node["body"] = it.second.body;
+                node["link"] = it.second.link;
+                node["bytes"] = it.second.bytes;
+                node["owned_bytes"] = it.second.ownedBytes;
+                nodes.append(node);
+            }
+            py::dict result;
+            result["assets"] = assetMemoryDict(report.assets);
+            result["nodes"] = nodes;
+            result["renderer"] = rendererMemoryDict(report.renderer);
+            result["frame_bytes"] = report.frameBytes;
+            result["total_bytes"] = report.totalBytes;
+            result["peak_bytes"] = report.peakBytes;
+            return result;
+        },
+        py::arg("physics_client_id"),
+        "Memory in bytes of the scene assets, nodes, renderer and frame buffers of a specific "
+        "client, with its high-water mark");
+
+    m.def(
+        "get_process_memory_report",
+        []() {
+            ProcessMemoryReport report;
+            {
+                py::gil_scoped_release release;
+                report = gGetProcessMemoryReport();
+            }
+            py::dict result;
+            result["assets"] = assetMemoryDict(report.assets);
+            result["cached_bytes"] = report.cachedBytes;
+            result["renderers"] = rendererMemoryDict(report.renderers);
+            result["frame_bytes"] = report.frameBytes;
+            result["total_bytes"] = report.totalBytes;
+            result["peak_bytes"] = report.peakBytes;
+            result["clients"] = report.clients;
+            return result;
+        },
+        "Memory in bytes of all clients and of the asset cache, assets shared between clients "
+        "counted once");
+
+    m.def("reset_stage_stats", &gResetStageStats, py::arg("physics_client_id"),
+          py::call_guard<py::gil_scoped_release>(),
+          "Forget the durations of the steps of the camera images of a specific client");
+
+    m.def("prune_asset_cache", &gPruneAssetCache,
+          "Drop cached meshes and textures not used by any client");
+
+    m.def("asset_cache_ids", &gAssetCacheIds, py::call_guard<py::gil_scoped_release>(),
+          "Asset ids of the cached meshes and textures, with the revision of the cache");
+
+    m.def("asset_cache_revision", &gAssetCacheRevision,
+          "Number of prunes and clears of the asset cache, python objects made of assets are "
+          "evicted when it changes");
+
+    m.def("preload_assets", &gPreloadAssets, py::arg("filenames"),
+          py::call_guard<py::gil_scoped_release>(),
+          "Load mesh and image files into the asset cache before forking, kept by "
+          "prune_asset_cache, return the number of files loaded");
+
+    m.def("start_trace", &gStartTrace, py::arg("path") = "",
+          py::call_guard<py::gil_scoped_release>(),
+          "Start recording a timeline of the rendering work of all clients and threads, "
+          "written in the Chrome trace format to path when stopped or a plugin is unloaded");
+
+    m.def("stop_trace", &gStopTrace, py::call_guard<py::gil_scoped_release>(),
+          "Stop recording and write the trace to the path given to start_trace, if any, "
+          "return False if the file could not be written");
+
+    m.def("write_trace", &gWriteTrace, py::arg("path") = "",
+          py::call_guard<py::gil_scoped_release>(),
+          "Write the trace recorded so far, to the path given to start_trace if empty, "
+          "return False if the file could not be written");
+
+    m.def("trace_dropped_events", &gTraceDroppedEvents,
+          "Events dropped by threads whose trace buffer was full");
+
+    m.def("capture_trace_outliers", &gCaptureTraceOutliers, py::arg("directory"),
+          py::arg("frames") = 120, py::arg("threshold_ms") = 0.,
+          py::arg("median_factor") = 10., py::call_guard<py::gil_scoped_release>(),
+          "Start recording the last events of each thread only, writing those of the last "
+          "frames camera images to outlier_<n>.json in directory each time an image takes "
+          "longer than threshold_ms or median_factor times the median of the last images, "
+          "either ignored if 0, until stop_trace");
+
+    m.def("trace_captured_frames", &gTraceCapturedFrames,
+          "Outliers written since capture_trace_outliers");
 }
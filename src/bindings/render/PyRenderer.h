@@ -1,17 +1,70 @@
 #pragma once
 
 #include <render/BaseRenderer.h>
+#include <render/PanoramaFaces.h>
+#include <render/ScaledFrame.h>
+#include <render/StageStats.h>
 
 #include <scene/SceneGraph.h>
 #include <scene/SceneState.h>
 #include <scene/SceneView.h>
 
+#include <memory>
+#include <utility>
+
 class PyRenderer : public render::BaseRenderer
 {
   public:
     /* Default constructor */
     PyRenderer() {}
 
+    /* Destructor, may run on a thread not holding the GIL */
+    ~PyRenderer() override
+    {
+        if (!_overrides)
+            return;
+        if (!Py_IsInitialized()) {
+            // the interpreter already freed the functions and wrappers
+            _overrides.release();
+            _state.object.release();
+            _view.object.release();
+            _frameObject.release();
+            return;
+        }
+        py::gil_scoped_acquire gil;
+        _overrides.reset();
+        _state.object = py::object();
+        _view.object = py::object();
+        _frameObject = py::object();
+    }
+
+    /**
+     * @brief Resolve the python overrides once, calls then skip their lookup by name
+     *
+     * Overrides are looked up on the first call only: methods patched on the object later are
+     * not seen. Methods the python class does not override call the C++ defaults without
+     * taking the GIL. Renderers overriding a method with another callable than a plain function
+     * keep the lookup by name. Must be called with the GIL held.
+     */
+    void cacheOverrides()
+    {
+        if (_overrides)
+            return;
+        auto overrides = std::make_unique<Overrides>();
+        bool cacheable = true;
+        overrides->updateScene = findOverride("update_scene", cacheable);
+        overrides->applySceneDelta = findOverride("apply_scene_delta", cacheable);
+        overrides->updateShapeGeometry = findOverride("update_shape_geometry", cacheable);
+        overrides->updateShapeMaterial = findOverride("update_shape_material", cacheable);
+        overrides->updateShapeTexels = findOverride("update_shape_texels", cacheable);
+        overrides->renderFrame = findOverride("render_frame", cacheable);
+        overrides->renderFrames = findOverride("render_frames", cacheable);
+        if (!cacheable)
+            return;
+        _typeInfo = py::detail::get_type_info(typeid(render::BaseRenderer));
+        _overrides = std::move(overrides);
+    }
+
     /**
      * @brief Update a scene using \p sceneGraph description
      *
@@ -21,10 +74,115 @@ class PyRenderer : public render::BaseRenderer
     void updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
                      bool materialsOnly) override
     {
+        render::StageTimer timer(render::Stage::Python);
+        if (_overrides) {
+            py::gil_scoped_acquire gil;
+            if (callCached(_overrides->updateScene, sceneGraph, materialsOnly))
+                return;
+        }
         PYBIND11_OVERLOAD_PURE_NAME(void, render::BaseRenderer, "update_scene", updateScene,
                                     sceneGraph, materialsOnly);
     };
 
+    /**
+     * @brief Apply changes \p delta made to a scene since the previous update
+     *
+     * @param sceneGraph - scene description, already containing the changes
+     * @param delta - ids of added, removed and material-changed nodes
+     */
+    void applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                         const scene::SceneGraphDelta& delta) override
+    {
+        if (_overrides) {
+            if (!_overrides->applySceneDelta)
+                return render::BaseRenderer::applySceneDelta(sceneGraph, delta);
+            render::StageTimer timer(render::Stage::Python);
+            py::gil_scoped_acquire gil;
+            if (callCached(_overrides->applySceneDelta, sceneGraph, delta))
+                return;
+        }
+        PYBIND11_OVERLOAD_NAME(void, render::BaseRenderer, "apply_scene_delta", applySceneDelta,
+                               sceneGraph, delta);
+    };
+
+    /**
+     * @brief Upload mesh vertices and normals rewritten in place
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node
+     * @param meshData - mesh data holding the new vertices and normals
+     *
+     * @return True if updated
+     */
+    bool updateShapeGeometry(int nodeId, int shapeIndex,
+                             const std::shared_ptr<scene::MeshData>& meshData) override
+    {
+        if (_overrides) {
+            if (!_overrides->updateShapeGeometry)
+                return render::BaseRenderer::updateShapeGeometry(nodeId, shapeIndex, meshData);
+            render::StageTimer timer(render::Stage::Python);
+            py::gil_scoped_acquire gil;
+            const auto result =
+                callCached(_overrides->updateShapeGeometry, nodeId, shapeIndex, meshData);
+            if (result)
+                return result.cast<bool>();
+        }
+        PYBIND11_OVERLOAD_NAME(bool, render::BaseRenderer, "update_shape_geometry",
+                               updateShapeGeometry, nodeId, shapeIndex, meshData);
+    };
+
+    /**
+     * @brief Change the color and texture of a shape in place
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node
+     * @param material - new shape material, may be null
+     *
+     * @return True if updated
+     */
+    bool updateShapeMaterial(int nodeId, int shapeIndex,
+                             const std::shared_ptr<scene::Material>& material) override
+    {
+        if (_overrides) {
+            if (!_overrides->updateShapeMaterial)
+                return render::BaseRenderer::updateShapeMaterial(nodeId, shapeIndex, material);
+            render::StageTimer timer(render::Stage::Python);
+            py::gil_scoped_acquire gil;
+            const auto result =
+                callCached(_overrides->updateShapeMaterial, nodeId, shapeIndex, material);
+            if (result)
+                return result.cast<bool>();
+        }
+        PYBIND11_OVERLOAD_NAME(bool, render::BaseRenderer, "update_shape_material",
+                               updateShapeMaterial, nodeId, shapeIndex, material);
+    };
+
+    /**
+     * @brief Upload the pixels of a shape texture rewritten in place
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node
+     * @param texture - diffuse texture of the shape, same bitmap with new pixels
+     *
+     * @return True if updated
+     */
+    bool updateShapeTexels(int nodeId, int shapeIndex,
+                           const std::shared_ptr<scene::Texture>& texture) override
+    {
+        if (_overrides) {
+            if (!_overrides->updateShapeTexels)
+                return render::BaseRenderer::updateShapeTexels(nodeId, shapeIndex, texture);
+            render::StageTimer timer(render::Stage::Python);
+            py::gil_scoped_acquire gil;
+            const auto result =
+                callCached(_overrides->updateShapeTexels, nodeId, shapeIndex, texture);
+            if (result)
+                return result.cast<bool>();
+        }
+        PYBIND11_OVERLOAD_NAME(bool, render::BaseRenderer, "update_shape_texels",
+                               updateShapeTexels, nodeId, shapeIndex, texture);
+    };
+
     /**
      * @brief Render a scene at state \p sceneState with a view settings \p sceneView
      *
@@ -32,14 +190,177 @@ class PyRenderer : public render::BaseRenderer
      * @param sceneView - view settings, e.g. camera, light, viewport size
      * @param outputFrame - rendered images
      *
+     * Panoramic views are rendered as the perspective views of their faces, see
+     * render::PanoramaFaces, views of a render scale at their internal resolution, see
+     * render::ScaledFrame.
+     *
      * @return True if rendered
      */
     bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
                      const std::shared_ptr<scene::SceneView>& sceneView,
                      render::FrameData& outputFrame) override
     {
+        if (sceneView->projection() != scene::Projection::Perspective)
+            return _panorama.render(*this, sceneState, *sceneView, outputFrame);
+        if (sceneView->hasRenderScale())
+            return _scaled.render(*this, sceneState, *sceneView, outputFrame);
+        render::StageTimer timer(render::Stage::Python);
+        if (_overrides) {
+            py::gil_scoped_acquire gil;
+            const auto result = callCached(_overrides->renderFrame, pooled(_state, sceneState),
+                                           pooled(_view, sceneView), pooledFrame(outputFrame));
+            if (result)
+                return result.cast<bool>();
+        }
         PYBIND11_OVERLOAD_PURE_NAME(bool, render::BaseRenderer, "render_frame", renderFrame,
                                     sceneState, sceneView, outputFrame);
         return false;
     };
+
+    /**
+     * @brief Render a scene at state \p sceneState from several views at once
+     *
+     * @param sceneState - scene state, e.g. transformations of all objects
+     * @param sceneViews - view settings, one per output frame
+     * @param outputFrames - rendered images
+     *
+     * @return True if all views rendered
+     */
+    bool renderFrames(const std::shared_ptr<scene::SceneState>& sceneState,
+                      const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                      std::vector<render::FrameData>& outputFrames) override
+    {
+        if (_overrides) {
+            if (!_overrides->renderFrames)
+                return render::BaseRenderer::renderFrames(sceneState, sceneViews, outputFrames);
+            render::StageTimer timer(render::Stage::Python);
+            py::gil_scoped_acquire gil;
+            const auto result =
+                callCached(_overrides->renderFrames, sceneState, sceneViews, outputFrames);
+            if (result)
+                return result.cast<bool>();
+        }
+        PYBIND11_OVERLOAD_NAME(bool, render::BaseRenderer, "render_frames", renderFrames,
+                               sceneState, sceneViews, outputFrames);
+    };
+
+    /**
+     * @brief Run \p wait without the GIL if the calling thread holds it, another thread may
+     * be waiting for it in a python override
+     */
+    void blockingWait(const std::function<void()>& wait) override
+    {
+        if (!Py_IsInitialized() || !PyGILState_Check())
+            return wait();
+        py::gil_scoped_release release;
+        wait();
+    }
+
+  private:
+    /**
+     * @brief Unbound python functions overriding the renderer methods, null if not overridden
+     */
+    struct Overrides {
+        py::object updateScene;
+        py::object applySceneDelta;
+        py::object updateShapeGeometry;
+        py::object updateShapeMaterial;
+        py::object updateShapeTexels;
+        py::object renderFrame;
+        py::object renderFrames;
+    };
+
+    /**
+     * @brief Function of a python override, null if the method is not overridden
+     *
+     * The function is kept rather than the bound method, which would reference the python
+     * object from its own C++ part.
+     *
+     * @param name - python method name
+     * @param cacheable - set to false if the override is not a method
+     */
+    py::object findOverride(const char* name, bool& cacheable) const
+    {
+        const auto method = py::get_overload(static_cast<const render::BaseRenderer*>(this), name);
+        if (!method)
+            return py::object();
+        if (!py::hasattr(method, "__func__")) {
+            cacheable = false;
+            return py::object();
+        }
+        return method.attr("__func__");
+    }
+
+    /**
+     * @brief Call a cached override, with the GIL held
+     *
+     * @return Result of the override, null if not cached or the python object is gone
+     */
+    template <class... Args>
+    py::object callCached(const py::object& function, Args&&... args) const
+    {
+        if (!function)
+            return py::object();
+        const auto self = py::detail::get_object_handle(
+            static_cast<const render::BaseRenderer*>(this), _typeInfo);
+        if (!self)
+            return py::object();
+        return function.operator()<py::return_value_policy::reference>(
+            self, std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Python wrapper of the last object passed to an override
+     */
+    struct Wrapper {
+        const void* pointer = nullptr; //<- kept alive by the wrapper
+        py::object object;
+    };
+
+    /**
+     * @brief Wrapper of an object passed to an override, created only if the object changed
+     *
+     * The scene state and view of the plugin are the same objects from frame to frame, their
+     * wrappers are reused rather than created for each call. Must be called with the GIL held.
+     */
+    template <class T>
+    static const py::object& pooled(Wrapper& wrapper, const std::shared_ptr<T>& value)
+    {
+        if (wrapper.pointer != value.get() || !wrapper.object) {
+            wrapper.object = py::cast(value);
+            wrapper.pointer = value.get();
+        }
+        return wrapper.object;
+    }
+
+    /**
+     * @brief Wrapper of an output frame, reused with its plane views while the caller lends the
+     * same planes at the same size
+     *
+     * Must be called with the GIL held.
+     */
+    const py::object& pooledFrame(const render::FrameData& frame)
+    {
+        const auto* last = _frame.get();
+        if (!last || last->cols != frame.cols || last->rows != frame.rows ||
+            last->color != frame.color || last->depth != frame.depth ||
+            last->mask != frame.mask) {
+            // allocated before the last copy is freed, so that a wrapper kept by python is
+            // never found again at the same address with the views of old planes
+            auto copy = std::make_unique<render::FrameData>(frame);
+            _frameObject = py::cast(copy.get(), py::return_value_policy::reference);
+            _frame = std::move(copy);
+        }
+        return _frameObject;
+    }
+
+    std::unique_ptr<Overrides> _overrides; //<- null until cacheOverrides()
+    py::detail::type_info* _typeInfo = nullptr;
+    // wrappers of the arguments of render_frame, see pooled()
+    Wrapper _state;
+    Wrapper _view;
+    std::unique_ptr<render::FrameData> _frame; //<- copy of the last output frame
+    py::object _frameObject; //<- wrapper of _frame
+    render::PanoramaFaces _panorama; //<- faces of panoramic views
+    render::ScaledFrame _scaled; //<- views of a render scale
 };
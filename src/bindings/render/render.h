@@ -2,6 +2,113 @@
 
 #include "PyRenderer.h"
 
+#include <render/AssetArchive.h>
+#include <render/AssetLoader.h>
+#include <render/AutoRenderer.h>
+#include <render/BatchRenderer.h>
+#include <render/DepthLevels.h>
+#include <render/DeviceScheduler.h>
+#include <render/EventCamera.h>
+#include <render/Keypoints.h>
+#include <render/MeshCache.h>
+#include <render/MotionVectors.h>
+#include <render/PathTracer.h>
+#include <render/ObjParser.h>
+#include <render/PackedFrame.h>
+#include <render/PixelCounts.h>
+#include <render/PointCloud.h>
+#include <render/RemoteRenderer.h>
+#include <render/RenderScheduler.h>
+#include <render/RenderServer.h>
+#include <render/SensorNoise.h>
+#include <render/ShaderCache.h>
+#include <render/TextureCache.h>
+#include <render/ThreadAffinity.h>
+
+#ifdef WITH_EGL
+#include <render/EGLRenderer.h>
+#endif
+#ifdef WITH_TINYRENDERER
+#include <render/TinyRendererBackend.h>
+#endif
+#ifdef WITH_VULKAN
+#include <render/VulkanRenderer.h>
+#endif
+
+/**
+ * @brief Writable view of a frame plane kept alive by \p owner, None for a null plane
+ */
+template <class T>
+py::object plane(T* data, std::initializer_list<int> shape, const py::object& owner)
+{
+    if (!data)
+        return py::none();
+    return py::array_t<T>(std::vector<ssize_t>(shape.begin(), shape.end()), data, owner);
+}
+
+/**
+ * @brief Color, depth and mask views of a frame, created once per frame wrapper
+ *
+ * Views are cached on the wrapper, which renderers reuse while they lend the same planes. They
+ * reference the planes without keeping the wrapper alive, the planes being lent by the caller.
+ */
+inline py::object framePlanes(FrameData& self)
+{
+    const auto owner = py::cast(self);
+    auto planes = py::getattr(owner, "_planes", py::none());
+    if (planes.is_none()) {
+        const py::capsule lent(self.color ? static_cast<void*>(self.color) : &self);
+        planes = py::make_tuple(plane<uint8_t>(self.color, {self.rows, self.cols, 4}, lent),
+                                plane<float>(self.depth, {self.rows, self.cols}, lent),
+                                plane<int>(self.mask, {self.rows, self.cols}, lent));
+        owner.attr("_planes") = planes;
+    }
+    return planes;
+}
+
+/**
+ * @brief Levels of a packed depth pyramid, (H,W,2) views of a copy of it kept packed, see
+ * render::depthLevelOffset()
+ */
+inline py::list depthLevels(int cols, int rows, int levels, const float* depths)
+{
+    const size_t size = render::depthLevelOffset(cols, rows, levels + 1);
+    py::array_t<float> packed(static_cast<ssize_t>(size));
+    std::copy_n(depths, size, packed.mutable_data());
+    py::list result;
+    for (int level = 1; level <= levels; ++level) {
+        const auto offset = static_cast<ssize_t>(render::depthLevelOffset(cols, rows, level));
+        const ssize_t w = render::depthLevelSize(cols, level);
+        const ssize_t h = render::depthLevelSize(rows, level);
+        result.append(packed[py::slice(offset, offset + w * h * 2, 1)].attr("reshape")(h, w, 2));
+    }
+    return result;
+}
+
+#ifdef WITH_EGL
+/**
+ * @brief Image in CUDA device memory, exposed through __cuda_array_interface__
+ */
+struct CudaImage {
+    std::vector<ssize_t> shape;
+    std::string typestr; //<- numpy array interface type string
+    uintptr_t data; //<- device pointer
+    py::object owner; //<- keeps the memory alive
+};
+
+/**
+ * @brief Wrap a device plane of a renderer, None for a null plane
+ */
+template <class T>
+py::object cudaImage(T* data, std::vector<ssize_t> shape, const py::object& owner)
+{
+    if (!data)
+        return py::none();
+    const auto typestr = py::dtype::of<T>().attr("str").template cast<std::string>();
+    return py::cast(CudaImage{std::move(shape), typestr, reinterpret_cast<uintptr_t>(data), owner});
+}
+#endif
+
 void bindRender(py::module& m)
 {
     using namespace render;
@@ -11,27 +118,805 @@ void bindRender(py::module& m)
         .def(py::init<>())
         .def("update_scene", &BaseRenderer::updateScene,
              "Update a scene using scene graph description")
+        .def("apply_scene_delta", &BaseRenderer::applySceneDelta,
+             "Apply changes made to a scene since the previous update")
+        .def("update_shape_geometry", &BaseRenderer::updateShapeGeometry,
+             "Upload mesh vertices and normals rewritten in place")
+        .def("update_shape_material", &BaseRenderer::updateShapeMaterial,
+             "Change the color and texture of a shape in place")
+        .def("update_shape_texels", &BaseRenderer::updateShapeTexels,
+             "Upload the pixels of a shape texture rewritten in place")
         .def("render_frame", &BaseRenderer::renderFrame,
-             "Render a scene using scene state and view settings");
+             "Render a scene using scene state and view settings")
+        .def("render_frames", &BaseRenderer::renderFrames,
+             "Render a scene from several views using scene state and view settings")
+        .def(
+            "render_view",
+            [](BaseRenderer& self, const std::shared_ptr<scene::SceneState>& sceneState,
+               const std::shared_ptr<scene::SceneView>& sceneView,
+               uint64_t frameIndex) -> py::object {
+                const auto size = sceneView->imageSize();
+                const ssize_t cols = size[0], rows = size[1];
+                py::array_t<uint8_t> color({rows, cols, ssize_t(4)});
+                py::array_t<float> depth({rows, cols});
+                py::array_t<int> mask({rows, cols});
+                const auto has = [&](scene::OutputChannel channel) {
+                    return sceneView->hasOutputChannel(channel);
+                };
+                const bool points = has(scene::OutputChannel::Points);
+                if (points && !has(scene::OutputChannel::Depth))
+                    throw std::invalid_argument("The Points channel requires the Depth channel");
+                const bool compact = points && sceneView->compactPoints();
+                py::array_t<float> xyz(points ? std::vector<ssize_t>{rows, cols, 3}
+                                              : std::vector<ssize_t>{0});
+                py::array_t<int> ids(compact ? rows * cols : 0);
+                // planes of reduced formats, returned instead of the full ones
+                const auto plane = [rows, cols](bool packed, ssize_t channels) {
+                    if (!packed)
+                        return std::vector<ssize_t>{0};
+                    if (channels > 1)
+                        return std::vector<ssize_t>{rows, cols, channels};
+                    return std::vector<ssize_t>{rows, cols};
+                };
+                const bool rgb = has(scene::OutputChannel::Color) &&
+                                 sceneView->colorFormat() == scene::ColorFormat::RGB;
+                const bool shortDepth = has(scene::OutputChannel::Depth) &&
+                                        sceneView->depthFormat() != scene::DepthFormat::Float32;
+                const bool shortMask = has(scene::OutputChannel::Mask) &&
+                                       sceneView->maskFormat() == scene::MaskFormat::UInt16;
+                py::array_t<uint8_t> rgbColor(plane(rgb, 3));
+                py::array_t<uint16_t> packedDepth(plane(shortDepth, 1));
+                py::array_t<uint16_t> packedMask(plane(shortMask, 1));
+                const bool motion = has(scene::OutputChannel::Motion);
+                py::array_t<uint16_t> motionImage(plane(motion, 2));
+                const bool normals = has(scene::OutputChannel::Normals);
+                py::array_t<uint16_t> normalImage(plane(normals, 3));
+                const bool pyramid = has(scene::OutputChannel::DepthPyramid);
+                const int levels = sceneView->depthPyramidLevels();
+                std::vector<float> depthPyramid(
+                    pyramid ? depthLevelOffset(int(cols), int(rows), levels + 1) : 0);
+                const bool events = has(scene::OutputChannel::Events);
+                std::vector<float> eventList(events ? size_t(rows * cols) * 4 : 0);
+                // the mask is scratch for renderers counting its pixels on the CPU
+                const bool visibility = has(scene::OutputChannel::Visibility);
+                std::vector<int> pixelCounts(visibility ? size_t(rows * cols) * 2 : 0);
+                const bool boxes = visibility && has(scene::OutputChannel::Boxes);
+                std::vector<int> boxList(boxes ? size_t(rows * cols) * 4 : 0);
+                const bool keypoints =
+                    has(scene::OutputChannel::Keypoints) && sceneView->keypoints();
+                py::array_t<float> keypointList(
+                    {ssize_t(keypoints ? sceneView->keypoints()->size() : 0), ssize_t(4)});
+                std::vector<int> scratchMask(
+                    visibility && !has(scene::OutputChannel::Mask) ? size_t(rows * cols) : 0);
+                int* maskPlane = has(scene::OutputChannel::Mask) ? mask.mutable_data()
+                                 : visibility                    ? scratchMask.data()
+                                                                 : nullptr;
+                FrameData frame{int(cols),
+                                int(rows),
+                                has(scene::OutputChannel::Color) ? color.mutable_data() : nullptr,
+                                has(scene::OutputChannel::Depth) ? depth.mutable_data() : nullptr,
+                                maskPlane,
+                                points ? xyz.mutable_data() : nullptr,
+                                compact ? ids.mutable_data() : nullptr,
+                                rgb ? rgbColor.mutable_data() : nullptr,
+                                shortDepth ? packedDepth.mutable_data() : nullptr,
+                                shortMask ? packedMask.mutable_data() : nullptr,
+                                motion ? motionImage.mutable_data() : nullptr,
+                                normals ? normalImage.mutable_data() : nullptr,
+                                pyramid ? depthPyramid.data() : nullptr,
+                                events ? eventList.data() : nullptr,
+                                visibility ? pixelCounts.data() : nullptr,
+                                boxes ? boxList.data() : nullptr,
+                                keypoints ? keypointList.mutable_data() : nullptr};
+                bool rendered;
+                {
+                    py::gil_scoped_release release;
+                    rendered = self.renderFrame(sceneState, sceneView, frame);
+                    if (rendered) {
+                        applySensorNoise(*sceneView, frame, frameIndex);
+                        completePoints(*sceneView, frame);
+                        completeMotion(*sceneView, nullptr, *sceneState, frame);
+                        completeNormals(*sceneView, frame);
+                        completeDepthPyramid(*sceneView, frame);
+                        completePixelCounts(*sceneView, frame);
+                        completeKeypoints(*sceneView, *sceneState, frame);
+                        packFrame(*sceneView, frame);
+                    }
+                }
+                if (!rendered)
+                    return py::none();
+                py::object colorImage = frame.color ? py::object(color) : py::none();
+                py::object depthImage = frame.depth ? py::object(depth) : py::none();
+                py::object maskImage =
+                    has(scene::OutputChannel::Mask) ? py::object(mask) : py::none();
+                if (rgb)
+                    colorImage = rgbColor;
+                if (shortDepth) {
+                    const bool half = sceneView->depthFormat() == scene::DepthFormat::Float16;
+                    depthImage =
+                        half ? packedDepth.attr("view")("float16") : py::object(packedDepth);
+                }
+                if (shortMask)
+                    maskImage = packedMask;
+                py::object images = py::make_tuple(colorImage, depthImage, maskImage);
+                if (points) {
+                    if (!compact) {
+                        images = images + py::make_tuple(xyz, py::none());
+                    } else {
+                        // compact points fill the front of the buffers
+                        const auto slice = py::slice(0, std::max(frame.numPoints, 0), 1);
+                        images = images + py::make_tuple(
+                                              xyz.attr("reshape")(rows * cols, 3)[slice],
+                                              ids[slice]);
+                    }
+                }
+                if (motion)
+                    images = images + py::make_tuple(motionImage.attr("view")("float16"));
+                if (normals)
+                    images = images + py::make_tuple(normalImage.attr("view")("float16"));
+                if (pyramid)
+                    images = images + py::make_tuple(depthLevels(int(cols), int(rows), levels,
+                                                                 depthPyramid.data()));
+                if (events && frame.numEvents >= 0) {
+                    py::array_t<float> list({ssize_t(frame.numEvents), ssize_t(4)});
+                    std::copy_n(eventList.data(), size_t(frame.numEvents) * 4,
+                                list.mutable_data());
+                    images = images + py::make_tuple(list);
+                }
+                else if (events) {
+                    images = images + py::make_tuple(py::none());
+                }
+                if (visibility) {
+                    const int count = std::max(frame.numPixelCounts, 0);
+                    py::array_t<int> list({ssize_t(count), ssize_t(2)});
+                    std::copy_n(pixelCounts.data(), size_t(count) * 2, list.mutable_data());
+                    images = images + py::make_tuple(list);
+                }
+                if (boxes) {
+                    const int count = std::max(frame.numPixelCounts, 0);
+                    py::array_t<int> list({ssize_t(count), ssize_t(4)});
+                    std::copy_n(boxList.data(), size_t(count) * 4, list.mutable_data());
+                    images = images + py::make_tuple(list);
+                }
+                if (keypoints)
+                    images = images + py::make_tuple(keypointList);
+                return images;
+            },
+            py::arg("scene_state"), py::arg("scene_view"), py::arg("frame_index") = 0,
+            "Render a view into new color (H,W,4), depth and mask (H,W) images of its "
+            "image_size and formats, e.g. (H,W,3) colors or uint16 depth, None for channels not "
+            "requested, or None if the frame did not render. "
+            "The sensor_noise of the view is drawn for frame_index. "
+            "With the Points channel, also returns points (H,W,3) and None, or points (N,3) and "
+            "their segmentation ids (N,) if compact. "
+            "With the Motion channel, finally returns the float16 motion (H,W,2) since the "
+            "previous_camera, reprojected from depth by renderers not drawing it, then with the "
+            "Normals channel the float16 camera frame normals (H,W,3), then with the "
+            "DepthPyramid channel the list of its levels, see get_camera_depth_pyramid, then "
+            "with the Events channel the (N,4) events found by the renderer, None for those "
+            "leaving them to an EventCamera, then with the Visibility channel the (N,2) "
+            "segmentation ids seen and their pixels, by increasing id, the mask being only read "
+            "back if requested, then with the Boxes channel their (N,4) bounds x0, y0, x1, y1, "
+            "then with the Keypoints channel the (N,4) x, y, depth and visibility of the "
+            "keypoints of the view")
+        .def_static(
+            "instance_matrices",
+            [](const scene::SceneGraph& sceneGraph, const scene::SceneState& sceneState,
+               const std::vector<int>& nodeIds) {
+                const auto matrices =
+                    BaseRenderer::instanceMatrices(sceneGraph, sceneState, nodeIds);
+                py::array_t<float> result({ssize_t(matrices.size()), ssize_t(4), ssize_t(4)});
+                const auto data = reinterpret_cast<const float*>(matrices.data());
+                std::copy_n(data, matrices.size() * 16, result.mutable_data());
+                return result;
+            },
+            py::arg("scene_graph"), py::arg("scene_state"), py::arg("node_ids"),
+            "World matrices (N,4,4) of the nodes of an instance group, laid out as "
+            "SceneState.matrices");
 
-    // FrameData
-    py::class_<FrameData>(m, "FrameData")
+#ifdef WITH_EGL
+    py::class_<EGLRenderer, BaseRenderer, std::shared_ptr<EGLRenderer>>(m, "EGLRenderer")
+        .def(py::init<int, bool>(), py::arg("device") = -1, py::arg("share_resources") = false,
+             "Headless OpenGL renderer on the EGL device of index device, -1 for the default, "
+             "SCHEDULED_DEVICE for the least loaded GPU, sharing meshes and textures with the "
+             "other renderers of the device created with share_resources")
+        .def_readonly_static("SCHEDULED_DEVICE", &EGLRenderer::ScheduledDevice)
+        .def_property_readonly("device", &EGLRenderer::device,
+                               "Index of the EGL device rendered on, -1 for the default display")
+        .def_property_readonly("share_resources", &EGLRenderer::shareResources,
+                               "Meshes and textures are shared with the other renderers of the "
+                               "device created with share_resources")
+        .def_property("gpu_output", &EGLRenderer::gpuOutput, &EGLRenderer::setGpuOutput,
+                      "Keep images on the GPU, read with gpu_frame, requires a build with CUDA")
+        .def(
+            "gpu_frame",
+            [](py::object self) {
+                const auto& frame = self.cast<EGLRenderer&>().gpuFrame();
+                const std::vector<ssize_t> shape{frame.rows, frame.cols};
+                return py::make_tuple(
+                    cudaImage(frame.color, {frame.rows, frame.cols, ssize_t(4)}, self),
+                    cudaImage(frame.depth, shape, self), cudaImage(frame.mask, shape, self));
+            },
+            "Color, depth and mask device images of the last frame rendered with gpu_output, "
+            "valid until the next frame")
+        .def_property("lazy_residency", &EGLRenderer::lazyResidency,
+                      &EGLRenderer::setLazyResidency,
+                      "Load the assets of shapes added from now on only when first in view")
+        .def_property("memory_budget", &EGLRenderer::memoryBudget, &EGLRenderer::setMemoryBudget,
+                      "GPU memory for meshes and textures in bytes, least recently drawn ones "
+                      "being released beyond it, 0 for no limit")
+        .def_property("texture_upload_budget", &EGLRenderer::textureUploadBudget,
+                      &EGLRenderer::setTextureUploadBudget,
+                      "Bytes of mip levels of large textures streamed per frame, coarse levels "
+                      "first, 0 to upload whole textures")
+        .def_property("occlusion_culling", &EGLRenderer::occlusionCulling,
+                      &EGLRenderer::setOcclusionCulling,
+                      "Cull nodes hidden behind the largest ones in view")
+        .def_property("incremental", &EGLRenderer::incremental, &EGLRenderer::setIncremental,
+                      "Redraw only the tiles of static cameras covered by moving nodes")
+        .def_property("indirect_draws", &EGLRenderer::indirectDraws,
+                      &EGLRenderer::setIndirectDraws,
+                      "Draw opaque mesh shapes by multi-draw indirect commands culled on the "
+                      "GPU, OpenGL 4.3")
+        .def_property("occluder_size", &EGLRenderer::occluderSize, &EGLRenderer::setOccluderSize,
+                      "Smallest screen size in pixels of a node drawn first as an occluder")
+        .def_property("shadow_map_size", &EGLRenderer::shadowMapSize,
+                      &EGLRenderer::setShadowMapSize,
+                      "Width and height of the shadow maps in texels, 0 for no shadows")
+        .def_property("shadow_cascades", &EGLRenderer::shadowCascades,
+                      &EGLRenderer::setShadowCascades,
+                      "Shadow cascades fitted to the view, up to 4 sharing the shadow map, 0 "
+                      "for a map covering the scene")
+        .def(
+            "residency_stats",
+            [](const EGLRenderer& self) {
+                const auto stats = self.residencyStats();
+                py::dict result;
+                result["resident_bytes"] = stats.residentBytes;
+                result["peak_resident_bytes"] = stats.peakResidentBytes;
+                result["buffer_bytes"] = stats.bufferBytes;
+                result["texture_bytes"] = stats.textureBytes;
+                result["framebuffer_bytes"] = stats.framebufferBytes;
+                result["resident_meshes"] = stats.residentMeshes;
+                result["resident_textures"] = stats.residentTextures;
+                result["texture_arrays"] = stats.textureArrays;
+                result["loaded_shapes"] = stats.loadedShapes;
+                result["deferred_shapes"] = stats.deferredShapes;
+                result["uploads"] = stats.uploads;
+                result["tile_uploads"] = stats.tileUploads;
+                result["texel_uploads"] = stats.texelUploads;
+                result["streamed_bytes"] = stats.streamedBytes;
+                result["mip_evictions"] = stats.mipEvictions;
+                result["pending_textures"] = stats.pendingTextures;
+                result["unique_materials"] = stats.uniqueMaterials;
+                result["material_switches"] = stats.materialSwitches;
+                result["texture_binds"] = stats.textureBinds;
+                result["static_batches"] = stats.staticBatches;
+                result["batched_shapes"] = stats.batchedShapes;
+                result["drawn_nodes"] = stats.drawnNodes;
+                result["frustum_culled_nodes"] = stats.frustumCulledNodes;
+                result["occluded_nodes"] = stats.occludedNodes;
+                result["opaque_shapes"] = stats.opaqueShapes;
+                result["blended_shapes"] = stats.blendedShapes;
+                result["indirect_shapes"] = stats.indirectShapes;
+                result["multi_draws"] = stats.multiDraws;
+                result["static_shadow_updates"] = stats.staticShadowUpdates;
+                result["shadow_casters"] = stats.shadowCasters;
+                result["redrawn_pixels"] = stats.redrawnPixels;
+                result["evictions"] = stats.evictions;
+                return result;
+            },
+            "GPU memory use and loading state of the scene assets");
+
+    py::class_<CudaImage>(m, "CudaImage")
         .def_property_readonly(
-            "color_img",
-            [](FrameData& self) {
-                return py::array_t<uint8_t>({self.rows, self.cols, 4}, self.color, py::cast(self));
+            "shape", [](const CudaImage& self) { return py::tuple(py::cast(self.shape)); })
+        .def_property_readonly(
+            "__cuda_array_interface__",
+            [](const CudaImage& self) {
+                py::dict interface;
+                interface["shape"] = py::tuple(py::cast(self.shape));
+                interface["typestr"] = self.typestr;
+                interface["data"] = py::make_tuple(self.data, true);
+                interface["strides"] = py::none();
+                interface["version"] = 2;
+                return interface;
+            },
+            "CUDA array interface, e.g. for torch.as_tensor or cupy.asarray");
+#endif
+
+#ifdef WITH_TINYRENDERER
+    py::class_<TinyRendererBackend, BaseRenderer, std::shared_ptr<TinyRendererBackend>>(
+        m, "TinyRendererBackend")
+        .def(py::init<int>(), py::arg("num_threads") = 0,
+             "Multithreaded CPU renderer, num_threads of 0 keeps the scheduler setting")
+        .def_property("front_to_back", &TinyRendererBackend::frontToBack,
+                      &TinyRendererBackend::setFrontToBack,
+                      "Draw objects in view from the nearest to the farthest");
+#endif
+
+#ifdef WITH_VULKAN
+    py::class_<VulkanRenderer, BaseRenderer, std::shared_ptr<VulkanRenderer>>(m, "VulkanRenderer")
+        .def(py::init<int, int, bool>(), py::arg("device") = -1, py::arg("num_threads") = 0,
+             py::arg("external_memory") = false,
+             "Headless Vulkan renderer on the physical device of index device, -1 for the first "
+             "one, recording the views of render_frames on num_threads threads, 0 for one per "
+             "core, and exporting its images instead of reading them back with external_memory")
+        .def_property_readonly("device", &VulkanRenderer::device, "Physical device index")
+        .def_property_readonly("external_memory", &VulkanRenderer::externalMemory,
+                               "Images are exported, see export_frame")
+        .def(
+            "export_frame",
+            [](const VulkanRenderer& self, size_t index) {
+                const auto frame = self.exportFrame(index);
+                py::dict result;
+                result["fd"] = frame.fd;
+                result["size"] = frame.size;
+                result["color_offset"] = frame.colorOffset;
+                result["depth_offset"] = frame.depthOffset;
+                result["mask_offset"] = frame.maskOffset;
+                result["cols"] = frame.cols;
+                result["rows"] = frame.rows;
+                result["timeline_value"] = frame.timelineValue;
+                return result;
+            },
+            py::arg("index") = 0,
+            "New file descriptor of the device memory holding the images of view index, owned "
+            "by the caller, with the offsets of its RGBA8 color, float depth and int mask planes "
+            "and the timeline semaphore value signaled once drawn")
+        .def("export_timeline_semaphore", &VulkanRenderer::exportTimelineSemaphore,
+             "New file descriptor of the timeline semaphore, owned by the caller");
+#endif
+
+    py::class_<PathTracer, BaseRenderer, std::shared_ptr<PathTracer>>(m, "PathTracer")
+        .def(py::init<int>(), py::arg("num_threads") = 0,
+             "CPU path tracer with a denoiser, tracing rows on num_threads threads, 0 for one "
+             "per core")
+        .def_property("samples", &PathTracer::samples, &PathTracer::setSamples,
+                      "Paths traced per pixel")
+        .def_property("bounces", &PathTracer::bounces, &PathTracer::setBounces,
+                      "Diffuse and mirror bounces after the surface seen, 0 to light the scene as "
+                      "rasterizers do")
+        .def_property("denoise", &PathTracer::denoise, &PathTracer::setDenoise,
+                      "Filter the noise of the paths")
+        .def_property("num_threads", &PathTracer::numThreads, &PathTracer::setNumThreads,
+                      "Number of threads tracing rows, 0 for one per core")
+        .def_property_readonly("num_triangles", &PathTracer::numTriangles,
+                               "Number of triangles in the hierarchies of the scene");
+
+    // BatchRenderer
+    py::class_<BatchRenderer, std::shared_ptr<BatchRenderer>>(m, "BatchRenderer")
+        .def(py::init<const std::shared_ptr<BaseRenderer>&>(), py::arg("backend"),
+             "One renderer shared by the physics clients of vectorized environments")
+        .def_property_readonly("backend", &BatchRenderer::backend, "Shared renderer")
+        .def("add_environment", &BatchRenderer::addEnvironment,
+             "Append an environment, returns the renderer to bind to its physics client")
+        .def_property_readonly("num_environments", &BatchRenderer::numEnvironments,
+                               "Number of environments")
+        .def(
+            "set_cameras",
+            [](BatchRenderer& self, int environment, const std::vector<Matrix4f>& viewMatrices,
+               const std::vector<Matrix4f>& projMatrices) {
+                if (viewMatrices.size() != projMatrices.size())
+                    throw std::invalid_argument(
+                        "Number of view and projection matrices mismatch");
+                std::vector<std::shared_ptr<scene::Camera>> cameras;
+                for (size_t i = 0; i < viewMatrices.size(); ++i)
+                    cameras.push_back(
+                        std::make_shared<scene::Camera>(viewMatrices[i], projMatrices[i]));
+                self.setCameras(environment, cameras);
             },
-            py::return_value_policy::reference_internal, "Color image memory buffer")
+            py::arg("environment"), py::arg("view_matrices"), py::arg("projection_matrices"),
+            "Set the cameras of an environment, the same number for all environments")
+        .def(
+            "render_all",
+            [](BatchRenderer& self, int width, int height, bool withMask) {
+                const ssize_t envs = self.numEnvironments(), views = self.numCameras();
+                py::array_t<uint8_t> color({envs, views, ssize_t(height), ssize_t(width),
+                                            ssize_t(4)});
+                py::array_t<float> depth({envs, views, ssize_t(height), ssize_t(width)});
+                py::object mask = py::none();
+                int* maskData = nullptr;
+                if (withMask) {
+                    py::array_t<int> planes({envs, views, ssize_t(height), ssize_t(width)});
+                    maskData = planes.mutable_data();
+                    mask = planes;
+                }
+                uint8_t* colorData = color.mutable_data();
+                float* depthData = depth.mutable_data();
+                {
+                    py::gil_scoped_release release;
+                    self.renderAll(width, height, colorData, depthData, maskData);
+                }
+                return py::make_tuple(color, depth, mask);
+            },
+            py::arg("width"), py::arg("height"), py::arg("mask") = true,
+            "Render the cameras of all environments at their last requested poses, returns "
+            "color (E, C, H, W, 4), depth and mask (E, C, H, W) images");
+
+    // RenderScheduler
+    py::class_<RenderScheduler, std::shared_ptr<RenderScheduler>>(m, "RenderScheduler")
+        .def(py::init<const std::vector<std::shared_ptr<BaseRenderer>>&>(), py::arg("renderers"),
+             "Camera image requests of many clients spread over a pool of renderers, e.g. one "
+             "per GPU")
+        .def("add_client", &RenderScheduler::addClient, py::arg("deadline") = 0.1,
+             "Append a client, returns the renderer to bind to its physics client; requests are "
+             "due to start drawing within deadline seconds")
+        .def_property_readonly("num_workers", &RenderScheduler::numWorkers, "Number of workers")
+        .def("queue_lengths", &RenderScheduler::queueLengths,
+             "Jobs waiting in the deque of each worker")
+        .def(
+            "stats",
+            [](const RenderScheduler& self) {
+                const auto stats = self.stats();
+                py::dict result;
+                result["jobs"] = stats.jobs;
+                result["batches"] = stats.batches;
+                result["scene_switches"] = stats.sceneSwitches;
+                result["steals"] = stats.steals;
+                result["missed_deadlines"] = stats.missedDeadlines;
+                return result;
+            },
+            "Jobs, batches of the same scene, scene switches, steals and missed deadlines since "
+            "the scheduler was created or reset")
+        .def(
+            "queue_latency",
+            [](const RenderScheduler& self) {
+                const auto summary = self.queueLatency();
+                py::dict result;
+                result["count"] = summary.count;
+                result["window"] = summary.window;
+                result["mean"] = summary.mean;
+                result["p50"] = summary.p50;
+                result["p90"] = summary.p90;
+                result["p99"] = summary.p99;
+                result["max"] = summary.max;
+                result["histogram"] =
+                    std::vector<uint32_t>(summary.histogram.begin(), summary.histogram.end());
+                return result;
+            },
+            "Waits in milliseconds of the last jobs of all clients for a worker, as the 'queue' "
+            "stage of the stage stats")
+        .def("reset_stats", &RenderScheduler::resetStats, "Reset the counters and waits");
+
+    // RemoteRenderer
+    py::class_<RemoteRenderer, BaseRenderer, std::shared_ptr<RemoteRenderer>>(m, "RemoteRenderer")
+        .def(py::init<const std::string&, int, int, bool>(), py::arg("host"), py::arg("port"),
+             py::arg("max_pending") = 1, py::arg("quantize") = false,
+             // the server may be a RenderServer of this process waiting for the GIL
+             py::call_guard<py::gil_scoped_release>(),
+             "Renderer of a RenderServer, for max_pending requests in flight")
+        .def_property_readonly("max_pending", &RemoteRenderer::maxPending,
+                               "Requests in flight")
+        .def_property_readonly("connected", &RemoteRenderer::connected,
+                               "The connection to the server works")
+        .def_static("shared_memory", &RemoteRenderer::sharedMemory, py::arg("name"),
+                    py::arg("max_pending") = 1, py::arg("quantize") = false,
+                    py::arg("slot_bytes") = RemoteRenderer::kSlotBytes, py::arg("timeout") = 30.,
+                    // the host may be a thread of this process waiting for the GIL
+                    py::call_guard<py::gil_scoped_release>(),
+                    "Renderer of a host process serving the shared memory channel name, see "
+                    "RenderServer.serve_shared_memory()");
+
+    // AutoRenderer
+    py::class_<AutoRenderer, BaseRenderer, std::shared_ptr<AutoRenderer>>(m, "AutoRenderer")
+        .def(py::init([](const std::map<std::string, std::shared_ptr<BaseRenderer>>& candidates,
+                         int calibrationFrames) {
+                 return std::make_shared<AutoRenderer>(
+                     std::vector<AutoRenderer::Candidate>(candidates.begin(), candidates.end()),
+                     calibrationFrames);
+             }),
+             py::arg("candidates") = std::map<std::string, std::shared_ptr<BaseRenderer>>(),
+             py::arg("calibration_frames") = 3,
+             "Renderer drawing the frames of each size and channel set with the fastest of the "
+             "named candidates, e.g. python renderers, or of the native backends built and able "
+             "to start if none, timed over calibration_frames frames of the actual scene")
+        .def_static("probe_backends", &AutoRenderer::probeBackends, py::arg("device") = -1,
+                    py::arg("num_threads") = 0,
+                    "Native backends built and able to start, as (name, renderer) pairs")
+        .def_property_readonly("candidates", &AutoRenderer::candidates, "Names of the candidates")
+        .def_property_readonly("backend", &AutoRenderer::backend,
+                               "Name of the backend of the last frame")
+        .def(
+            "decisions",
+            [](const AutoRenderer& self) {
+                py::list result;
+                for (const auto& decision : self.decisions()) {
+                    py::dict item;
+                    item["cols"] = decision.cols;
+                    item["rows"] = decision.rows;
+                    item["channels"] = decision.channels;
+                    item["backend"] = decision.backend;
+                    py::dict times;
+                    for (const auto& time : decision.frameTimes)
+                        times[py::str(time.first)] =
+                            time.second < 0.0 ? py::object(py::none()) : py::float_(time.second);
+                    item["frame_times"] = times;
+                    result.append(item);
+                }
+                return result;
+            },
+            "Backends chosen per frame size and channel set, with the seconds per frame of each "
+            "candidate, None for a failure")
+        .def("recalibrate", &AutoRenderer::recalibrate,
+             "Time the candidates again on the next frame of each size and channel set")
+        .def_property("adaptive", &AutoRenderer::adaptive, &AutoRenderer::setAdaptive,
+                      "Calibrate again once a scene update changes the number of shapes by half")
+        .def_property("quiet", &AutoRenderer::quiet, &AutoRenderer::setQuiet,
+                      "Decisions are not logged to stderr");
+
+    // RenderServer
+    py::class_<RenderServer, std::shared_ptr<RenderServer>>(m, "RenderServer")
+        .def(py::init([](const RenderServer::RendererFactory& factory, int port,
+                         const std::string& address) {
+                 // sessions may wait for the GIL to call python renderers
+                 return std::shared_ptr<RenderServer>(
+                     new RenderServer(factory, port, address), [](RenderServer* server) {
+                         if (PyGILState_Check()) {
+                             py::gil_scoped_release release;
+                             delete server;
+                         }
+                         else {
+                             delete server;
+                         }
+                     });
+             }),
+             py::arg("renderer_factory"), py::arg("port") = 0, py::arg("address") = "",
+             "Serve RemoteRenderer clients, each with a renderer of renderer_factory()")
+        .def_property_readonly("port", &RenderServer::port, "Bound port")
+        .def_property_readonly("num_sessions", &RenderServer::numSessions,
+                               "Number of connected clients")
+        .def("stop", &RenderServer::stop, py::call_guard<py::gil_scoped_release>(),
+             "Close the listener and all sessions")
+        .def_static("serve_shared_memory", &RenderServer::serveChannel,
+                    py::arg("renderer_factory"), py::arg("name"), py::arg("timeout") = 30.,
+                    py::call_guard<py::gil_scoped_release>(),
+                    "Serve the RemoteRenderer.shared_memory() client of the channel name with a "
+                    "renderer of renderer_factory(), until it closes");
+
+    py::class_<EventCamera, std::shared_ptr<EventCamera>>(m, "EventCamera")
+        .def(py::init<>(), "Event camera comparing the color images given one after the other")
+        .def(
+            "update",
+            [](EventCamera& self, py::array_t<uint8_t, py::array::c_style> color, double time,
+               float threshold) {
+                if (color.ndim() != 3 || color.shape(2) != 4)
+                    throw std::invalid_argument("Expected an (H,W,4) color image");
+                const int rows = int(color.shape(0)), cols = int(color.shape(1));
+                std::vector<float> events(size_t(rows) * size_t(cols) * 4);
+                int count;
+                {
+                    py::gil_scoped_release release;
+                    count = self.update(cols, rows, color.data(), time, std::max(threshold, 0.01f),
+                                        events.data());
+                }
+                py::array_t<float> list({ssize_t(count), ssize_t(4)});
+                std::copy_n(events.data(), size_t(count) * 4, list.mutable_data());
+                return list;
+            },
+            py::arg("color"), py::arg("time"), py::arg("threshold") = 0.2f,
+            "Events (N,4) of x, y from the top, time and polarity since the previous image, "
+            "none for the first one, from an (H,W,4) uint8 image at time seconds")
+        .def("reset", &EventCamera::reset, "Drop the reference, the next image only setting it");
+
+    m.def(
+        "count_mask_pixels",
+        [](py::array_t<int, py::array::c_style | py::array::forcecast> mask,
+           bool boxes) -> py::object {
+            if (mask.ndim() != 2)
+                throw std::invalid_argument("Expected an (H,W) mask image");
+            const int rows = int(mask.shape(0)), cols = int(mask.shape(1));
+            std::vector<int> counts(size_t(rows) * size_t(cols) * 2);
+            std::vector<int> bounds(boxes ? counts.size() * 2 : 0);
+            int count;
+            {
+                py::gil_scoped_release release;
+                count = countMaskPixels(cols, rows, mask.data(), counts.data(),
+                                        boxes ? bounds.data() : nullptr);
+            }
+            py::array_t<int> list({ssize_t(count), ssize_t(2)});
+            std::copy_n(counts.data(), size_t(count) * 2, list.mutable_data());
+            if (!boxes)
+                return std::move(list);
+            py::array_t<int> boxList({ssize_t(count), ssize_t(4)});
+            std::copy_n(bounds.data(), size_t(count) * 4, boxList.mutable_data());
+            return py::make_tuple(list, boxList);
+        },
+        py::arg("mask"), py::arg("boxes") = false,
+        "Segmentation ids (N,2) seen in an (H,W) mask image and their pixels, by increasing id, "
+        "the background of id -1 left out, and if boxes their (N,4) bounds x0, y0, x1, y1 of the "
+        "first and last columns and rows holding some");
+
+    // FrameData, views of the lent planes valid only within render_frame(s)
+    // wrappers passed to render_frame are reused from frame to frame with their views, as long
+    // as the planes stay the same
+    py::class_<FrameData>(m, "FrameData", py::dynamic_attr())
+        .def_property_readonly("planes", &framePlanes,
+                               "Writable color, depth and mask views, None for planes not "
+                               "requested, to write into directly, not to be kept after "
+                               "render_frame returns")
+        .def_property_readonly(
+            "color_img",
+            [](FrameData& self) -> py::object { return framePlanes(self)[py::int_(0)]; },
+            "Color image memory buffer, None if not requested")
         .def_property_readonly(
             "depth_img",
-            [](FrameData& self) {
-                return py::array_t<float>({self.rows, self.cols}, self.depth, py::cast(self));
-            },
-            py::return_value_policy::reference_internal, "Depth image memory buffer")
+            [](FrameData& self) -> py::object { return framePlanes(self)[py::int_(1)]; },
+            "Depth image memory buffer, None if not requested")
         .def_property_readonly(
             "mask_img",
-            [](FrameData& self) {
-                return py::array_t<int>({self.rows, self.cols}, self.mask, py::cast(self));
-            },
-            py::return_value_policy::reference_internal, "Mask image memory buffer");
+            [](FrameData& self) -> py::object { return framePlanes(self)[py::int_(2)]; },
+            "Mask image memory buffer, None if not requested");
+
+    // persistent mesh cache, also used by python renderers loading meshes themselves
+    m.def("set_mesh_cache_directory", &setMeshCacheDirectory, py::arg("directory"),
+          "Directory of the persistent cache of parsed mesh files, empty to disable it");
+    m.def("mesh_cache_directory", &meshCacheDirectory,
+          "Directory of the persistent mesh cache, empty if disabled");
+    m.def("load_cached_mesh", &loadCachedMesh, py::arg("filename"), py::arg("loader"),
+          py::call_guard<py::gil_scoped_release>(),
+          "Cached mesh data of a mesh file parsed by loader, None if not cached");
+    m.def(
+        "store_cached_mesh",
+        [](const std::string& filename, const std::string& loader,
+           py::array_t<float, py::array::c_style | py::array::forcecast> vertices,
+           py::array_t<float, py::array::c_style | py::array::forcecast> uvs,
+           py::array_t<float, py::array::c_style | py::array::forcecast> normals,
+           py::array_t<int, py::array::c_style | py::array::forcecast> faces) {
+            if (normals.size() != vertices.size() || vertices.size() % 3 || faces.size() % 3)
+                throw py::value_error("expected (N, 3) vertices and normals, (M, 3) faces");
+            const auto vector = [](const auto& array) {
+                return std::vector<typename std::decay_t<decltype(array)>::value_type>(
+                    array.data(), array.data() + array.size());
+            };
+            const scene::MeshData data(vector(vertices), vector(uvs), vector(normals),
+                                       vector(faces));
+            py::gil_scoped_release release;
+            storeCachedMesh(filename, loader, data);
+        },
+        py::arg("filename"), py::arg("loader"), py::arg("vertices"), py::arg("uvs"),
+        py::arg("normals"), py::arg("faces"), "Store the mesh data parsed from a mesh file");
+
+    // persistent cache of block compressed textures, uploaded as is by the EGL renderer
+    m.def("set_texture_cache_directory", &setTextureCacheDirectory, py::arg("directory"),
+          "Directory of the persistent cache of compressed texture files, empty to disable it");
+    m.def("texture_cache_directory", &textureCacheDirectory,
+          "Directory of the persistent texture cache, empty if disabled");
+    m.def("texture_compression", &textureCompression,
+          "Texture files are compressed by native renderers");
+
+    // texture files decoded by the loader workers, for python renderers not decoding them
+    m.def("set_texture_prefetch", &setTexturePrefetch, py::arg("enabled"),
+          "Decode the texture files of new materials on the loader workers");
+    m.def(
+        "load_bitmap",
+        [](const scene::Texture& texture) { return loadBitmap(texture); },
+        py::arg("texture"), py::call_guard<py::gil_scoped_release>(),
+        "RGBA bitmap of a texture, decoded once per process, None if it cannot be decoded");
+    m.def(
+        "compress_texture_file",
+        [](const std::string& filename) { return bool(compressTextureFile(filename)); },
+        py::arg("filename"), py::call_guard<py::gil_scoped_release>(),
+        "Compress a texture file into the persistent texture cache, False if not decoded");
+
+    // persistent cache of the program binaries linked by the EGL renderer
+    m.def("set_shader_cache_directory", &setShaderCacheDirectory, py::arg("directory"),
+          "Directory of the persistent cache of linked shader programs, empty to disable it");
+    m.def("shader_cache_directory", &shaderCacheDirectory,
+          "Directory of the persistent shader cache, empty if disabled");
+
+    // asset files served from memory, e.g. zip archives on network file systems
+    m.def("mount_asset_archive", &mountAssetArchive, py::arg("path"), py::arg("prefix") = "",
+          py::call_guard<py::gil_scoped_release>(),
+          "Serve the entries of a zip archive as mesh and texture files named prefix + their "
+          "path, returns their number, -1 if the file is not a zip archive");
+    m.def(
+        "register_asset_file",
+        [](const std::string& filename, const py::bytes& content) {
+            const std::string bytes = content;
+            registerAssetFile(filename, std::vector<char>(bytes.begin(), bytes.end()));
+        },
+        py::arg("filename"), py::arg("content"),
+        "Serve the bytes content as the mesh or texture file filename");
+    m.def("clear_asset_files", &clearAssetFiles,
+          "Unmount the asset archives and drop the registered asset files");
+
+    m.def("load_obj", &loadObj, py::arg("filename"), py::arg("num_threads") = 0,
+          py::call_guard<py::gil_scoped_release>(),
+          "Mesh data of a Wavefront OBJ file parsed by native renderers, None if invalid");
+
+    // vertex cache and overdraw ordering of the meshes parsed by native renderers
+    m.def("set_mesh_optimization", &setMeshOptimization, py::arg("enabled"),
+          "Reorder meshes parsed from mesh files for GPU vertex caches and overdraw");
+    m.def("mesh_optimization", &meshOptimization, "Parsed meshes are optimized");
+    m.def("mesh_optimization_stats", &meshOptimizationStats,
+          "Cache miss ratios before and after optimization of each mesh file optimized so far");
+
+    // 16 bits attributes of the meshes entering the asset caches
+    m.def("set_mesh_quantization", &setMeshQuantization, py::arg("enabled"),
+          "Quantize new meshes to 16 bits positions, normals and uvs, see MeshData.quantized");
+    m.def("mesh_quantization", &meshQuantization, "New meshes are quantized");
+
+    // interleaved vertex buffers of the meshes entering the asset caches
+    py::enum_<VertexBufferMode>(m, "VertexBufferMode", py::arithmetic())
+        .value("Off", VertexBufferMode::Off)
+        .value("Float", VertexBufferMode::Float)
+        .value("Half", VertexBufferMode::Half);
+    m.def("set_vertex_buffer_mode", &setVertexBufferMode, py::arg("mode"),
+          "Interleave new meshes into GPU-ready vertex buffers, see MeshData.vertex_buffer");
+    m.def("vertex_buffer_mode", &vertexBufferMode, "Vertex buffers made for new meshes");
+
+    // placement of the renderers of the process on the GPUs
+    py::enum_<DevicePolicy>(m, "DevicePolicy", py::arithmetic())
+        .value("LeastSessions", DevicePolicy::LeastSessions)
+        .value("LeastMemory", DevicePolicy::LeastMemory);
+    py::class_<DeviceLease, std::shared_ptr<DeviceLease>>(m, "DeviceLease")
+        .def_property_readonly("device", &DeviceLease::device, "Index of the EGL device")
+        .def_property("bytes", &DeviceLease::bytes, &DeviceLease::setBytes,
+                      "GPU memory of the renderer, at least the bytes expected");
+    m.def("acquire_device", &acquireDevice, py::arg("expected_bytes") = 0,
+          "Place a renderer on the least loaded GPU until the lease is released, None if there "
+          "are no devices");
+    m.def("device_count", &deviceCount, "Number of GPUs renderers are placed on");
+    m.def("set_device_count", &setDeviceCount, py::arg("count"),
+          "Place renderers on the first count GPUs only, -1 for all EGL devices");
+    m.def("device_policy", &devicePolicy, "How GPUs are picked for new renderers");
+    m.def("set_device_policy", &setDevicePolicy, py::arg("policy"),
+          "Pick GPUs by fewest renderers or least memory");
+    m.def(
+        "device_loads",
+        []() {
+            py::list result;
+            for (const auto& load : deviceLoads()) {
+                py::dict item;
+                item["device"] = load.device;
+                item["sessions"] = load.sessions;
+                item["bytes"] = load.bytes;
+                item["numa_node"] = deviceNumaNode(load.device);
+                result.append(item);
+            }
+            return result;
+        },
+        "Renderers, GPU memory and NUMA node of each device, as dicts");
+
+    // pinning of the renderer threads next to their GPU
+    py::enum_<ThreadAffinity>(m, "ThreadAffinity", py::arithmetic())
+        .value("Off", ThreadAffinity::Off)
+        .value("Node", ThreadAffinity::Node)
+        .value("Core", ThreadAffinity::Core);
+    m.def("thread_affinity", &threadAffinity, "How renderer threads are pinned");
+    m.def("set_thread_affinity", &setThreadAffinity, py::arg("affinity"),
+          "Pin render, loader and worker threads to the NUMA node of their GPU, or each to a "
+          "core of it");
+    m.def("set_device_numa_node", &setDeviceNumaNode, py::arg("device"), py::arg("node"),
+          "Place a GPU on a NUMA node, -1 to read it from sysfs");
+    m.def(
+        "get_thread_topology",
+        []() {
+            py::dict result;
+            result["affinity"] = threadAffinity();
+            py::list nodes;
+            for (const auto& node : numaNodes()) {
+                py::dict item;
+                item["id"] = node.id;
+                item["cpus"] = node.cpus;
+                nodes.append(item);
+            }
+            result["nodes"] = nodes;
+            py::list devices;
+            for (int device = 0; device < deviceCount(); ++device)
+                devices.append(deviceNumaNode(device));
+            result["devices"] = devices;
+            py::list threads;
+            for (const auto& placement : threadPlacements()) {
+                py::dict item;
+                item["name"] = placement.name;
+                item["node"] = placement.node;
+                item["cpus"] = placement.cpus;
+                threads.append(item);
+            }
+            result["threads"] = threads;
+            return result;
+        },
+        "NUMA nodes and their CPUs, node of each GPU and pinned threads, as a dict");
 }
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <scene/BVH.h>
+
+void bindBVH(py::module& m)
+{
+    using namespace scene;
+
+    // BVH
+    py::class_<BVH, std::shared_ptr<BVH>>(m, "BVH")
+        .def(py::init<>())
+        .def("update", py::overload_cast<const SceneGraph&, const SceneState&>(&BVH::update),
+             "Rebuild on scene changes, refit the nodes with dirty poses otherwise",
+             py::arg("scene_graph"), py::arg("scene_state"))
+        .def("invalidate", &BVH::invalidate, "Force a rebuild at the next update")
+        .def("clear", &BVH::clear, "Remove all nodes")
+        .def_property_readonly("size", &BVH::size, "Number of nodes")
+        .def_property_readonly("bounds", &BVH::bounds, "Bounds of all nodes")
+        .def("world_bounds", &BVH::worldBounds, "World bounds of a node", py::arg("node_id"))
+        .def("query", py::overload_cast<const Camera&>(&BVH::query, py::const_),
+             "Ids of nodes which may be seen by a camera", py::arg("camera"))
+        .def("query", py::overload_cast<const AABB&>(&BVH::query, py::const_),
+             "Ids of nodes whose bounds overlap a box", py::arg("box"))
+        .def("raycast", &BVH::raycast,
+             "Pairs of node id and entry distance of the bounds hit by a ray, closest first",
+             py::arg("origin"), py::arg("direction"), py::arg("max_distance"));
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <scene/MeshLod.h>
+#include <scene/MeshOptimizer.h>
+
+void bindMeshLod(py::module& m)
+{
+    using namespace scene;
+
+    // LodPolicy
+    py::class_<LodPolicy>(m, "LodPolicy")
+        .def(py::init<float>(), py::arg("full_detail_size") = 256.f)
+        .def_property("full_detail_size", &LodPolicy::fullDetailSize,
+                      &LodPolicy::setFullDetailSize,
+                      "Smallest screen size in pixels drawn at full detail")
+        .def_static("screen_size", &LodPolicy::screenSize,
+                    "Projected diameter in pixels of the bounding sphere of a box",
+                    py::arg("world_bounds"), py::arg("camera"), py::arg("viewport_rows"))
+        .def("select", &LodPolicy::select, "Level to draw a mesh at, 0 for full detail",
+             py::arg("world_bounds"), py::arg("camera"), py::arg("viewport_rows"),
+             py::arg("num_levels"));
+
+    m.def("simplify_mesh", &simplifyMesh, "Simplify a mesh by vertex clustering",
+          py::arg("mesh"), py::arg("resolution"));
+
+    // MeshOptimizationStats
+    py::class_<MeshOptimizationStats>(m, "MeshOptimizationStats")
+        .def_readonly("acmr_before", &MeshOptimizationStats::acmrBefore,
+                      "Average cache miss ratio of the source order")
+        .def_readonly("acmr_after", &MeshOptimizationStats::acmrAfter,
+                      "Average cache miss ratio of the optimized order")
+        .def_readonly("vertices_before", &MeshOptimizationStats::verticesBefore,
+                      "Number of source vertices")
+        .def_readonly("vertices_after", &MeshOptimizationStats::verticesAfter,
+                      "Number of vertices once duplicates are merged")
+        .def_readonly("triangles", &MeshOptimizationStats::triangles,
+                      "Number of triangles, collapsed ones dropped");
+
+    m.def("cache_miss_ratio", &cacheMissRatio,
+          "Average cache miss ratio of triangle indices, vertices transformed per triangle",
+          py::arg("indices"), py::arg("cache_size") = 16);
+    m.def(
+        "optimize_mesh",
+        [](const MeshData& mesh) {
+            MeshOptimizationStats stats;
+            std::shared_ptr<MeshData> optimized;
+            {
+                py::gil_scoped_release release;
+                optimized = optimizeMesh(mesh, &stats);
+            }
+            return py::make_tuple(optimized, stats);
+        },
+        "Reorder a mesh for GPU vertex caches and overdraw, returns the mesh and its stats",
+        py::arg("mesh"));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <render/AssetLoader.h>
+#include <scene/RaySensor.h>
+
+void bindRaySensor(py::module& m)
+{
+    using namespace scene;
+
+    // RaySensor
+    py::class_<RaySensor, std::shared_ptr<RaySensor>>(m, "RaySensor")
+        .def(py::init([] { return std::make_shared<RaySensor>(&render::loadMeshData); }))
+        .def("set_pinhole", &RaySensor::setPinhole,
+             "Sample the pixels of a pinhole camera, ranges being metric depths",
+             py::arg("cols"), py::arg("rows"), py::arg("proj_matrix"))
+        .def("set_lidar", &RaySensor::setLidar,
+             "Sample a spinning LiDAR, ranges being distances to the sensor origin",
+             py::arg("channels"), py::arg("columns"), py::arg("min_elevation"),
+             py::arg("max_elevation"))
+        .def_property_readonly("cols", &RaySensor::cols, "Number of samples per row")
+        .def_property_readonly("rows", &RaySensor::rows, "Number of rows")
+        .def_property(
+            "range",
+            [](const RaySensor& self) { return py::make_tuple(self.minRange(), self.maxRange()); },
+            [](RaySensor& self, const std::pair<float, float>& range) {
+                self.setRange(range.first, range.second);
+            },
+            "Minimum and maximum range of hits")
+        .def_property("num_threads", &RaySensor::numThreads, &RaySensor::setNumThreads,
+                      "Number of threads casting rows, 0 for one per core")
+        .def_property_readonly("num_triangles", &RaySensor::numTriangles,
+                               "Number of triangles in the mesh hierarchies")
+        .def(
+            "cast",
+            [](RaySensor& self, const SceneGraph& sceneGraph, const SceneState& sceneState,
+               const Matrix4f& viewMatrix, const py::object& ranges, const py::object& ids) {
+                const ssize_t rows = self.rows(), cols = self.cols();
+                auto rangeArray = outputArray<float>(ranges, {rows, cols}, rows * cols);
+                auto idArray = outputArray<int>(ids, {rows, cols}, rows * cols);
+                float* rangeData = rangeArray.mutable_data();
+                int* idData = idArray.mutable_data();
+                {
+                    py::gil_scoped_release release;
+                    self.cast(sceneGraph, sceneState, viewMatrix, rangeData, idData);
+                }
+                return py::make_tuple(rangeArray, idArray);
+            },
+            "Cast the sensor rays, returns (H, W) ranges and segmentation ids, 0 and -1 for "
+            "misses",
+            py::arg("scene_graph"), py::arg("scene_state"), py::arg("view_matrix"),
+            py::arg("ranges") = py::none(), py::arg("ids") = py::none());
+}
@@ -1,15 +1,33 @@
 #pragma once
 
+#include <scene/AssetTable.h>
+#include <scene/Primitives.h>
+#include <scene/SceneBounds.h>
 #include <scene/SceneGraph.h>
+#include <scene/VertexBuffer.h>
 
-PYBIND11_MAKE_OPAQUE(std::map<int, scene::Node>);
 PYBIND11_MAKE_OPAQUE(std::vector<scene::Shape>);
 
+/**
+ * @brief Iterator over the nodes of a NodeMap, for values()
+ */
+struct NodeValueIterator {
+    scene::NodeMap::const_iterator it;
+
+    const scene::Node& operator*() const { return it->second; }
+    NodeValueIterator& operator++()
+    {
+        ++it;
+        return *this;
+    }
+    bool operator==(const NodeValueIterator& other) const { return it == other.it; }
+    bool operator!=(const NodeValueIterator& other) const { return it != other.it; }
+};
+
 void bindSceneGraph(py::module& m)
 {
     using namespace scene;
 
-    py::bind_map<std::map<int, Node>>(m, "MapIntNode");
     py::bind_vector<std::vector<Shape>>(m, "VectorShape");
 
     // ShapeType enum
@@ -23,6 +41,26 @@ void bindSceneGraph(py::module& m)
         .value("Capsule", ShapeType::Capsule)
         .value("Heightfield", ShapeType::Heightfield);
 
+    // SegmentationMode enum
+    py::enum_<SegmentationMode>(m, "SegmentationMode")
+        .value("BodyLink", SegmentationMode::BodyLink)
+        .value("Instance", SegmentationMode::Instance)
+        .value("Semantic", SegmentationMode::Semantic);
+
+    // AABB
+    py::class_<AABB>(m, "AABB")
+        .def(py::init([](const Vector3f& lower, const Vector3f& upper) {
+                 return AABB{lower, upper};
+             }),
+             py::arg("lower"), py::arg("upper"))
+        .def_readwrite("lower", &AABB::lower, "Lower corner")
+        .def_readwrite("upper", &AABB::upper, "Upper corner")
+        .def_property_readonly("empty", &AABB::empty, "Box contains nothing")
+        .def_property_readonly("infinite", &AABB::infinite, "Box has an infinite side")
+        // operators
+        .def(py::self == py::self)
+        .def(py::self != py::self);
+
     // Material
     py::class_<Material, std::shared_ptr<Material>>(m, "Material")
         .def_property("diffuse_color", &Material::diffuseColor, &Material::setDiffuseColor,
@@ -31,6 +69,10 @@ void bindSceneGraph(py::module& m)
                       "Specular color")
         .def_property("diffuse_texture", &Material::diffuseTexture, &Material::setDiffuseTexture,
                       "Texture index")
+        .def_property_readonly("transparent", &Material::transparent,
+                               "Blended over opaque shapes, with a diffuse alpha below 1")
+        .def_property_readonly("content_hash", &Material::hash,
+                               "Hash of the colors and texture, equal for equal materials")
         // operators
         .def(py::self == py::self)
         .def(py::self != py::self);
@@ -38,21 +80,78 @@ void bindSceneGraph(py::module& m)
     // Bitmap
     py::class_<Bitmap, std::shared_ptr<Bitmap>>(m, "Bitmap", pybind11::buffer_protocol())
         .def_buffer([](Bitmap& im) -> pybind11::buffer_info {
-            return pybind11::buffer_info(const_cast<unsigned char*>(im.data().data()),
+            if (im.compression() != Bitmap::Compression::None)
+                return pybind11::buffer_info(const_cast<unsigned char*>(im.data()),
+                                             ssize_t(im.size())); //<- blocks
+            return pybind11::buffer_info(const_cast<unsigned char*>(im.data()),
                                          sizeof(unsigned char),
                                          pybind11::format_descriptor<unsigned char>::format(),
                                          ssize_t(3), {im.rows(), im.cols(), im.channels()},
                                          {im.channels() * im.cols(), im.channels(), ssize_t(1)});
-        });
+        })
+        .def_property_readonly("revision", &Bitmap::revision,
+                               "Process-wide unique number of the pixels, renewed when the "
+                               "owner of wrapped pixels rewrites them")
+        .def_property_readonly("wrapped", &Bitmap::wrapped,
+                               "Pixels are owned by another object, e.g. a registered array")
+        .def_property_readonly("content_hash", &Bitmap::hash,
+                               "Hash of the pixels, cached until their revision is renewed")
+        // operators
+        .def(py::self == py::self)
+        .def(py::self != py::self);
 
     // Texture
     py::class_<Texture, std::shared_ptr<Texture>>(m, "Texture")
         .def_property_readonly("filename", &Texture::filename, "Texture filename")
         .def_property_readonly("bitmap", &Texture::bitmap, "Texture bitmap")
+        .def_property_readonly("asset_id", &Texture::assetId,
+                               "Process-wide id shared by identical textures, -1 if not cached")
+        .def_property_readonly("content_hash", &Texture::hash,
+                               "Hash of the file name and bitmap, equal for equal textures")
         // operators
         .def(py::self == py::self)
         .def(py::self != py::self);
 
+    // VertexBuffer
+    py::class_<VertexBuffer, std::shared_ptr<VertexBuffer>>(m, "VertexBuffer")
+        .def_property_readonly(
+            "vertices",
+            [](const VertexBuffer& self) {
+                return py::array_t<uint8_t>(
+                    {ssize_t(self.numVertices()), ssize_t(self.layout().stride)},
+                    self.vertices().data(), py::cast(self));
+            },
+            "Interleaved vertices, one row of stride bytes each")
+        .def_property_readonly(
+            "indices",
+            [](const VertexBuffer& self) -> py::object {
+                if (self.layout().shortIndices)
+                    return py::array_t<uint16_t>(
+                        ssize_t(self.numIndices()),
+                        reinterpret_cast<const uint16_t*>(self.indices().data()),
+                        py::cast(self));
+                return py::array_t<uint32_t>(
+                    ssize_t(self.numIndices()),
+                    reinterpret_cast<const uint32_t*>(self.indices().data()), py::cast(self));
+            },
+            "Vertex indices of the triangles, uint16 or uint32")
+        .def_property_readonly(
+            "stride", [](const VertexBuffer& self) { return self.layout().stride; },
+            "Bytes per vertex")
+        .def_property_readonly(
+            "normal_offset", [](const VertexBuffer& self) { return self.layout().normalOffset; },
+            "Byte offset of the normal in a vertex, -1 without normals")
+        .def_property_readonly(
+            "uv_offset", [](const VertexBuffer& self) { return self.layout().uvOffset; },
+            "Byte offset of the uv in a vertex, -1 without uvs")
+        .def_property_readonly(
+            "half_attributes",
+            [](const VertexBuffer& self) { return self.layout().halfAttributes; },
+            "Normals and uvs are half floats")
+        .def_property_readonly(
+            "short_indices", [](const VertexBuffer& self) { return self.layout().shortIndices; },
+            "Indices are 16 bits wide");
+
     // MeshData
     py::class_<MeshData, std::shared_ptr<MeshData>>(m, "MeshData")
         .def_property_readonly(
@@ -83,6 +182,25 @@ void bindSceneGraph(py::module& m)
                                         self.indices().data(), py::cast(self));
             },
             "Triangle faces")
+        .def_property_readonly(
+            "indices",
+            [](const MeshData& self) {
+                return py::array_t<int>(ssize_t(self.indices().size()), self.indices().data(),
+                                        py::cast(self));
+            },
+            "Vertex indices of the triangles, contiguous, without copy")
+        .def_property_readonly("bounds", &MeshData::bounds, "Bounds of the vertices")
+        .def_property_readonly(
+            "vertex_buffer",
+            [](const MeshData& self) {
+                return std::const_pointer_cast<VertexBuffer>(self.vertexBuffer());
+            },
+            "Interleaved GPU-ready copy of the mesh, None if not made")
+        .def_property_readonly(
+            "quantized", [](const MeshData& self) { return bool(self.quantized()); },
+            "Attributes are stored as 16 bits values, the arrays are decoded on first access")
+        .def_property_readonly("content_hash", &MeshData::hash,
+                               "Hash of the attributes and indices, cached")
         // operators
         .def(py::self == py::self)
         .def(py::self != py::self);
@@ -91,6 +209,46 @@ void bindSceneGraph(py::module& m)
     py::class_<Mesh, std::shared_ptr<Mesh>>(m, "Mesh")
         .def_property_readonly("filename", &Mesh::filename, "Mesh filename")
         .def_property_readonly("data", &Mesh::data, "Mesh in-memory data")
+        .def_property_readonly("asset_id", &Mesh::assetId,
+                               "Process-wide id shared by identical meshes, -1 if not cached")
+        .def_property("bounds", &Mesh::bounds, &Mesh::setBounds,
+                      "Bounds of the vertices, infinite until a mesh file is loaded")
+        .def_property_readonly("lods", &Mesh::lods, "Simplified versions of the mesh, coarser last")
+        .def_property_readonly("content_hash", &Mesh::hash,
+                               "Hash of the file name and data, equal for equal meshes")
+        // operators
+        .def(py::self == py::self)
+        .def(py::self != py::self);
+
+    // Heightfield
+    py::class_<Heightfield, std::shared_ptr<Heightfield>>(m, "Heightfield")
+        .def_property_readonly("columns", &Heightfield::columns, "Number of grid points along x")
+        .def_property_readonly("rows", &Heightfield::rows, "Number of grid points along y")
+        .def_property_readonly("origin", &Heightfield::origin, "xy coordinates of the first point")
+        .def_property_readonly("cell_size", &Heightfield::cellSize,
+                               "Distance between grid points along x and y")
+        .def_property_readonly(
+            "heights",
+            [](const Heightfield& self) {
+                return py::array_t<float>({ssize_t(self.rows()), ssize_t(self.columns())},
+                                          self.heights().data(), py::cast(self));
+            },
+            "Heights of the grid points, a row along x")
+        .def_property_readonly("flip_diagonals", &Heightfield::flipDiagonals,
+                               "Cells split along the diagonal from their first to last point")
+        .def_property_readonly("uv_offset", &Heightfield::uvOffset,
+                               "Texture coordinates of the first grid point")
+        .def_property_readonly("uv_scale", &Heightfield::uvScale,
+                               "Texture coordinates of the last grid point minus the first")
+        .def_property_readonly("bounds", &Heightfield::bounds, "Bounds of the grid")
+        .def_property_readonly("tile_columns", &Heightfield::tileColumns,
+                               "Number of tiles along x")
+        .def_property_readonly("tile_rows", &Heightfield::tileRows, "Number of tiles along y")
+        .def("tile_revision", &Heightfield::tileRevision, "Revision of the heights of a tile",
+             py::arg("tile_column"), py::arg("tile_row"))
+        .def("mesh_data", &Heightfield::meshData, "Triangle mesh of the grid, made at each call")
+        .def_property_readonly("content_hash", &Heightfield::hash,
+                               "Hash of the grid and heights, cached")
         // operators
         .def(py::self == py::self)
         .def(py::self != py::self);
@@ -105,12 +263,27 @@ void bindSceneGraph(py::module& m)
         .def_property_readonly("extents", &Shape::extents, "Box extents")
         .def_property_readonly("mesh", &Shape::mesh, "Mesh description",
                                py::return_value_policy::reference_internal)
+        .def_property_readonly("heightfield", &Shape::heightfield,
+                               "Grid of heights, None if not a heightfield or kept as a mesh",
+                               py::return_value_policy::reference_internal)
         .def_property("material", &Shape::material, &Shape::setMaterial, "Shape material",
                       py::return_value_policy::reference_internal)
+        .def_property_readonly("bounds", &Shape::bounds, "Bounds in the shape frame")
+        .def_property_readonly("instance_id", &Shape::instanceId,
+                               "User instance id, -1 for that of the node")
+        .def_property_readonly("semantic_id", &Shape::semanticId,
+                               "User semantic class id, -1 for that of the node")
+        .def_property_readonly("content_hash", &Shape::hash,
+                               "Hash of the shape and its assets, equal for equal shapes")
         // operators
         .def(py::self == py::self)
         .def(py::self != py::self);
 
+    m.def("primitive_mesh", &primitiveMesh,
+          "Cached triangle mesh of a primitive shape, None if the shape is not a primitive "
+          "(heightfields are triangulated at each call)",
+          py::arg("shape"), py::arg("tessellation") = 1);
+
     // Node
     py::class_<Node>(m, "Node")
         .def_property_readonly("body", &Node::body, "Body index")
@@ -118,17 +291,189 @@ void bindSceneGraph(py::module& m)
         .def_property_readonly("no_cache", &Node::noCache, "Disable caching for child shapes")
         .def_property_readonly("shapes", &Node::shapes, "List of node's child shapes",
                                py::return_value_policy::reference_internal)
+        .def_property_readonly("bounds", &Node::bounds, "Bounds of the shapes in the node frame")
+        .def_property_readonly("instance_id", &Node::instanceId,
+                               "User instance id of the shapes without their own, -1 for none")
+        .def_property_readonly("semantic_id", &Node::semanticId,
+                               "User semantic class id of the shapes without their own, -1 for "
+                               "none")
+        .def("segmentation", &Node::segmentation, "Mask value of a shape in a segmentation mode",
+             py::arg("shape_index"), py::arg("mode"))
+        .def_property_readonly("content_hash", &Node::hash,
+                               "Hash of the node and its shapes, equal for equal nodes")
         // operators
         .def(py::self == py::self)
         .def(py::self != py::self);
 
+    // NodeMap, iterated like a dict of node ids, with arrays of ids, bodies and links
+    py::class_<NodeMap>(m, "NodeMap")
+        .def("__len__", &NodeMap::size)
+        .def("__contains__", [](const NodeMap& self, int nodeId) { return self.count(nodeId) > 0; })
+        .def("__contains__", [](const NodeMap&, const py::object&) { return false; })
+        .def(
+            "__getitem__",
+            [](const NodeMap& self, int nodeId) -> const Node& {
+                const auto it = self.find(nodeId);
+                if (it == self.end())
+                    throw py::key_error(std::to_string(nodeId));
+                return it->second;
+            },
+            py::return_value_policy::reference_internal)
+        .def(
+            "__iter__",
+            [](const NodeMap& self) { return py::make_key_iterator(self.begin(), self.end()); },
+            py::keep_alive<0, 1>())
+        .def(
+            "keys",
+            [](const NodeMap& self) { return py::make_key_iterator(self.begin(), self.end()); },
+            py::keep_alive<0, 1>())
+        .def(
+            "values",
+            [](const NodeMap& self) {
+                return py::make_iterator<py::return_value_policy::reference_internal>(
+                    NodeValueIterator{self.begin()}, NodeValueIterator{self.end()});
+            },
+            py::keep_alive<0, 1>())
+        .def(
+            "items",
+            [](const NodeMap& self) { return py::make_iterator(self.begin(), self.end()); },
+            py::keep_alive<0, 1>())
+        .def_property_readonly(
+            "ids",
+            [](const NodeMap& self) {
+                return py::array_t<int>({ssize_t(self.size())}, self.ids().data(),
+                                        py::cast(self));
+            },
+            "Node ids, in iteration order")
+        .def_property_readonly(
+            "bodies",
+            [](const NodeMap& self) {
+                return py::array_t<int>({ssize_t(self.size())}, self.bodies().data(),
+                                        py::cast(self));
+            },
+            "Body of each node, in iteration order")
+        .def_property_readonly(
+            "links",
+            [](const NodeMap& self) {
+                return py::array_t<int>({ssize_t(self.size())}, self.links().data(),
+                                        py::cast(self));
+            },
+            "Link of each node, in iteration order");
+
+    // SceneGraphDelta
+    py::class_<SceneGraphDelta>(m, "SceneGraphDelta")
+        .def_property_readonly("added", &SceneGraphDelta::added, "Ids of appended nodes")
+        .def_property_readonly("removed", &SceneGraphDelta::removed, "Ids of removed nodes")
+        .def_property_readonly("changed", &SceneGraphDelta::changed,
+                               "Ids of nodes with changed materials")
+        .def_property_readonly("geometry_changed", &SceneGraphDelta::geometryChanged,
+                               "Ids of nodes with mesh vertices rewritten in place")
+        .def_property_readonly("texels_changed", &SceneGraphDelta::texelsChanged,
+                               "Ids of nodes with texture pixels rewritten in place")
+        .def_property_readonly("materials_only", &SceneGraphDelta::materialsOnly,
+                               "Only shape materials changed")
+        .def_property_readonly("texels_only", &SceneGraphDelta::texelsOnly,
+                               "Only texture pixels changed")
+        .def("empty", &SceneGraphDelta::empty, "Nothing changed")
+        // operators
+        .def(py::self == py::self)
+        .def(py::self != py::self)
+        .def("__copy__", [](const SceneGraphDelta& self) { return SceneGraphDelta(self); })
+        // pickle
+        .def(pickle<SceneGraphDelta>());
+
     // SceneGraph
     py::class_<SceneGraph, std::shared_ptr<SceneGraph>>(m, "SceneGraph")
         .def_property_readonly("nodes", &SceneGraph::nodes, "Scene nodes",
                                py::return_value_policy::reference_internal)
+        .def_property_readonly("generation", &SceneGraph::generation,
+                               "Counter incremented each time the scene changes")
+        .def_property_readonly("unique_materials", &SceneGraph::uniqueMaterials,
+                               "Number of distinct materials, equal materials being shared")
+        .def_property_readonly("transparent_shapes", &SceneGraph::transparentShapes,
+                               "Number of shapes blended over the opaque ones")
+        .def_property_readonly(
+            "pooled_materials", [](const SceneGraph& self) { return self.materialPool().used(); },
+            "Number of materials allocated from the pool of the scene, freed at once on reset")
+        .def_property_readonly("instance_groups", &SceneGraph::instanceGroups,
+                               "Map group id - ids of nodes sharing the same mesh")
+        .def("instance_group", &SceneGraph::instanceGroup, "Instance group of a node, -1 if none",
+             py::arg("node_id"))
+        .def_property("segmentation_mode", &SceneGraph::segmentationMode,
+                      &SceneGraph::setSegmentationMode,
+                      "Values drawn into the segmentation masks, all nodes rebuilt on change")
+        .def("segmentation", &SceneGraph::segmentation,
+             "Mask value of a shape in the segmentation mode of the scene", py::arg("node_id"),
+             py::arg("shape_index"))
+        .def("change_segmentation_ids", &SceneGraph::changeSegmentationIds,
+             "Change the user instance and semantic ids of a node, shape_index -1, or of one of "
+             "its shapes, -1 for those of the node",
+             py::arg("node_id"), py::arg("shape_index"), py::arg("instance_id"),
+             py::arg("semantic_id"))
+        .def(
+            "visible_nodes",
+            [](const SceneGraph& self, const SceneState& sceneState, const Camera& camera) {
+                return SceneBounds::visibleNodes(self, sceneState, camera);
+            },
+            "Ids of nodes whose bounds intersect the view frustum of a camera",
+            py::arg("scene_state"), py::arg("camera"))
+        .def(
+            "world_bounds",
+            [](const SceneGraph& self, int nodeId, const SceneState& sceneState) {
+                return self.nodes().at(nodeId).bounds().transformed(sceneState.matrix(nodeId));
+            },
+            "Bounds of a node in world frame", py::arg("node_id"), py::arg("scene_state"))
         // operators
         .def(py::self == py::self)
         .def(py::self != py::self)
+        .def("__copy__", [](const SceneGraph& self) { return SceneGraph(self); },
+             "Copy sharing the meshes, materials and textures")
         // pickle
-        .def(pickle<SceneGraph>());
+        .def(pickle<SceneGraph>())
+        .def("__reduce_ex__", &reduceEx<SceneGraph>, py::arg("protocol"));
+
+    // AssetTable
+    py::class_<AssetTable>(m, "AssetTable")
+        .def(py::init<bool>(), py::arg("embed_new") = false)
+        .def_property_readonly("embed_new", &AssetTable::embedNew,
+                               "New data is written in full once, by hash afterwards")
+        .def(
+            "dumps",
+            [](AssetTable& self, const SceneGraph& sceneGraph) {
+                return py::bytes(serializeWithReferences(sceneGraph, self));
+            },
+            "Serialize a scene graph, the data of cached meshes and textures by content hash",
+            py::arg("scene_graph"))
+        .def(
+            "loads",
+            [](AssetTable& self, const py::buffer& data) {
+                const auto bytes = data.request();
+                auto sceneGraph = std::make_shared<SceneGraph>();
+                deserializeWithReferences(static_cast<const uint8_t*>(bytes.ptr),
+                                          size_t(bytes.size * bytes.itemsize), *sceneGraph, self);
+                return sceneGraph;
+            },
+            "Deserialize a scene graph written by dumps, unknown data left as placeholders",
+            py::arg("data"))
+        .def_property_readonly(
+            "missing",
+            [](const AssetTable& self) {
+                return std::vector<uint64_t>(self.missing().begin(), self.missing().end());
+            },
+            "Hashes of the placeholders, to fetch from the writing table")
+        .def(
+            "fetch",
+            [](const AssetTable& self, const std::vector<uint64_t>& hashes) {
+                return py::bytes(self.fetch(hashes));
+            },
+            "Payloads of the data held for these hashes", py::arg("hashes"))
+        .def(
+            "supply",
+            [](AssetTable& self, const py::bytes& payloads) {
+                return self.supply(std::string(payloads));
+            },
+            "Fill the placeholders with payloads of fetch, returns the number filled",
+            py::arg("payloads"))
+        .def("clear", &AssetTable::clear, "Forget all data")
+        .def("__len__", &AssetTable::size);
 }
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <scene/SceneGraph.h>
+#include <scene/SceneLayer.h>
+
+void bindSceneLayer(py::module& m)
+{
+    using namespace scene;
+
+    // SceneLayer
+    py::class_<SceneLayer, std::shared_ptr<SceneLayer>>(m, "SceneLayer")
+        .def(py::init([](const SceneGraph& sceneGraph, const SceneState& sceneState,
+                         const std::set<int>& bodies) {
+                 return std::make_shared<SceneLayer>(sceneGraph.nodes(), sceneState, bodies);
+             }),
+             "Freeze the nodes of some bodies of a scene at their current poses",
+             py::arg("scene_graph"), py::arg("scene_state"), py::arg("body_ids"))
+        .def_property_readonly(
+            "size", [](const SceneLayer& self) { return self.nodes().size(); }, "Number of nodes")
+        .def_property_readonly(
+            "node_ids",
+            [](const SceneLayer& self) {
+                std::vector<int> ids;
+                for (const auto& it : self.nodes())
+                    ids.push_back(it.first);
+                return ids;
+            },
+            "Ids of the nodes, in the scene the layer was built from")
+        .def_property_readonly("body_ids", &SceneLayer::bodies, "Unique ids of the bodies")
+        .def_property_readonly("bounds", &SceneLayer::bounds, "World bounds of the shapes")
+        .def(
+            "matrix",
+            [](const SceneLayer& self, int nodeId) {
+                return py::array_t<float>({ssize_t(4), ssize_t(4)}, self.matrix(nodeId).data(),
+                                          py::cast(self));
+            },
+            "World matrix 4x4 of a node", py::arg("node_id"));
+}
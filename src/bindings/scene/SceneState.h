@@ -1,23 +1,138 @@
 #pragma once
 
 #include <scene/SceneState.h>
+#include <scene/SceneStateDelta.h>
 
 void bindSceneState(py::module& m)
 {
     using namespace scene;
 
     // SceneState
-    py::class_<SceneState, std::shared_ptr<SceneState>>(m, "SceneState")
-        .def("pose", &SceneState::pose, "Node pose", py::return_value_policy::reference_internal)
+    py::class_<SceneState, std::shared_ptr<SceneState>> sceneState(m, "SceneState");
+
+    py::class_<SceneState::Snapshot, std::shared_ptr<SceneState::Snapshot>>(
+        m, "SceneStateSnapshot", "Poses of a scene state at some point, see SceneState.snapshot")
+        .def("__len__", &SceneState::Snapshot::size);
+
+    sceneState.def(py::init<>())
+        .def("pose", &SceneState::pose, "Node pose")
         .def(
             "matrix",
             [](const SceneState& self, int uid) {
-                return py::array_t<float>({ssize_t(4), ssize_t(4)}, self.pose(uid).matrix().data());
+                return py::array_t<float>({ssize_t(4), ssize_t(4)}, self.matrix(uid).data(),
+                                          py::cast(self));
             },
             "Node transformation matrix 4x4")
+        .def("slot", &SceneState::slot, "Node slot in the contiguous pose arrays")
+        .def_property_readonly(
+            "ids",
+            [](const SceneState& self) {
+                return py::array_t<int>({ssize_t(self.size())}, self.ids().data(),
+                                        py::cast(self));
+            },
+            "Node ids, one per slot")
+        .def_property_readonly(
+            "origins",
+            [](const SceneState& self) {
+                const auto data = reinterpret_cast<const float*>(self.origins().data());
+                return py::array_t<float>({ssize_t(self.size()), ssize_t(3)}, data, py::cast(self));
+            },
+            "Node origins (N,3)")
+        .def_property_readonly(
+            "quats",
+            [](const SceneState& self) {
+                const auto data = reinterpret_cast<const float*>(self.quats().data());
+                return py::array_t<float>({ssize_t(self.size()), ssize_t(4)}, data, py::cast(self));
+            },
+            "Node rotations (N,4) as w,x,y,z")
+        .def_property_readonly(
+            "scales",
+            [](const SceneState& self) {
+                const auto data = reinterpret_cast<const float*>(self.scales().data());
+                return py::array_t<float>({ssize_t(self.size()), ssize_t(3)}, data, py::cast(self));
+            },
+            "Node scales (N,3)")
+        .def_property_readonly(
+            "matrices",
+            [](const SceneState& self) {
+                const auto data = reinterpret_cast<const float*>(self.matrices().data());
+                return py::array_t<float>({ssize_t(self.size()), ssize_t(4), ssize_t(4)}, data,
+                                          py::cast(self));
+            },
+            "Node transformation matrices (N,4,4)")
+        .def_property_readonly(
+            "dirty",
+            [](const SceneState& self) {
+                return py::array_t<uint8_t>({ssize_t(self.size())}, self.dirty().data(),
+                                            py::cast(self));
+            },
+            "Per-slot flags set for poses changed since the previous frame")
+        .def_property_readonly("dirty_ids", &SceneState::dirtyIds,
+                               "Ids of nodes with poses changed since the previous frame")
+        .def("mark_all_dirty", &SceneState::markAllDirty,
+             "Flag all poses as changed, e.g. in a copy following frames never drawn")
+        .def_property_readonly("generation", &SceneState::generation,
+                               "Counter incremented each time any pose changes")
+        .def_property_readonly(
+            "statics",
+            [](const SceneState& self) {
+                return py::array_t<uint8_t>({ssize_t(self.size())}, self.statics().data(),
+                                            py::cast(self));
+            },
+            "Per-slot flags set for nodes classified as static")
+        .def("is_static", &SceneState::isStatic, "Node is classified as static")
+        .def("set_static", &SceneState::setStatic,
+             "Classify a node as static or dynamic, a static node moved is dynamic again")
+        .def_property_readonly("static_generation", &SceneState::staticGeneration,
+                               "Counter incremented each time the set of static nodes changes")
+        .def(
+            "snapshot",
+            [](SceneState& self) {
+                return std::const_pointer_cast<SceneState::Snapshot>(self.snapshot());
+            },
+            "Save the poses, sharing the ones unchanged since the last snapshot or restore")
+        .def("restore", &SceneState::restore, py::arg("snapshot"),
+             "Set the poses of a snapshot, only the ones that differ change")
+        .def("__len__", &SceneState::size)
         // operators
         .def(py::self == py::self)
         .def(py::self != py::self)
+        .def("__copy__", [](const SceneState& self) { return SceneState(self); })
         // pickle
-        .def(pickle<SceneState>());
+        .def(pickle<SceneState>())
+        .def("__reduce_ex__", &reduceEx<SceneState>, py::arg("protocol"));
+
+    // SceneStateEncoder
+    py::class_<SceneStateEncoder>(m, "SceneStateEncoder")
+        .def(py::init<bool>(), py::arg("quantize") = false)
+        .def_property_readonly("quantize", &SceneStateEncoder::quantize,
+                               "Origins and rotations are quantized")
+        .def_property_readonly("generation", &SceneStateEncoder::generation,
+                               "Generation of the last encoded state")
+        .def("reset", &SceneStateEncoder::reset, "Make the next delta a keyframe")
+        .def(
+            "encode",
+            [](SceneStateEncoder& self, const SceneState& sceneState) {
+                std::vector<uint8_t> delta;
+                self.encode(sceneState, delta);
+                return py::bytes(reinterpret_cast<const char*>(delta.data()), delta.size());
+            },
+            "Changes of a state since the previously encoded one", py::arg("scene_state"));
+
+    // SceneStateDecoder
+    py::class_<SceneStateDecoder>(m, "SceneStateDecoder")
+        .def(py::init<>())
+        .def_property_readonly("synchronized", &SceneStateDecoder::synchronized,
+                               "A keyframe was decoded since construction or the last error")
+        .def_property_readonly("generation", &SceneStateDecoder::generation,
+                               "Encoder generation of the last decoded state")
+        .def(
+            "decode",
+            [](SceneStateDecoder& self, py::buffer data, SceneState& sceneState) {
+                const auto buffer = data.request();
+                self.decode(static_cast<const uint8_t*>(buffer.ptr),
+                            size_t(buffer.size * buffer.itemsize), sceneState);
+            },
+            "Apply a delta of a SceneStateEncoder to the state of the previous ones",
+            py::arg("data"), py::arg("scene_state"));
 }
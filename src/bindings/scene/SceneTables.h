@@ -0,0 +1,60 @@
+#pragma once
+
+#include <scene/SceneTables.h>
+
+/**
+ * @brief Structured array viewing the rows of \p records, kept alive by \p owner
+ */
+template <class Record>
+py::array_t<Record> recordArray(const std::vector<Record>& records, const py::object& owner)
+{
+    return py::array_t<Record>({ssize_t(records.size())}, records.data(), owner);
+}
+
+void bindSceneTables(py::module& m)
+{
+    using namespace scene;
+
+    PYBIND11_NUMPY_DTYPE_EX(NodeRecord, uid, "uid", body, "body", link, "link", firstShape,
+                            "first_shape", numShapes, "num_shapes");
+    PYBIND11_NUMPY_DTYPE_EX(ShapeRecord, node, "node", type, "type", dimensions, "dimensions",
+                            matrix, "matrix", mesh, "mesh", heightfield, "heightfield", material,
+                            "material");
+    PYBIND11_NUMPY_DTYPE_EX(MaterialRecord, diffuseColor, "diffuse_color", specularColor,
+                            "specular_color", texture, "texture");
+
+    // SceneTables
+    py::class_<SceneTables, std::shared_ptr<SceneTables>>(m, "SceneTables")
+        .def(py::init<>())
+        .def(py::init([](const SceneGraph& sceneGraph) {
+                 auto tables = std::make_shared<SceneTables>();
+                 tables->update(sceneGraph);
+                 return tables;
+             }),
+             py::arg("scene_graph"))
+        .def("update", &SceneTables::update,
+             "Rebuild the tables if the scene changed, return whether they were",
+             py::arg("scene_graph"))
+        .def("invalidate", &SceneTables::invalidate, "Force a rebuild at the next update")
+        .def_property_readonly(
+            "nodes",
+            [](const SceneTables& self) { return recordArray(self.nodes(), py::cast(self)); },
+            "Structured array of the nodes: uid, body, link, first_shape, num_shapes")
+        .def_property_readonly(
+            "shapes",
+            [](const SceneTables& self) { return recordArray(self.shapes(), py::cast(self)); },
+            "Structured array of the shapes, those of a node consecutive: node (row in nodes), "
+            "type, dimensions (radius and height, or box extents), matrix (local pose, "
+            "column-major), mesh, heightfield and material (rows in meshes, heightfields and "
+            "materials, -1 if none)")
+        .def_property_readonly(
+            "materials",
+            [](const SceneTables& self) { return recordArray(self.materials(), py::cast(self)); },
+            "Structured array of the distinct materials: diffuse_color, specular_color, "
+            "texture (row in textures, -1 if none)")
+        .def_property_readonly("meshes", &SceneTables::meshes, "Distinct meshes of the shapes")
+        .def_property_readonly("heightfields", &SceneTables::heightfields,
+                               "Distinct heightfields of the shapes")
+        .def_property_readonly("textures", &SceneTables::textures,
+                               "Distinct textures of the materials");
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <scene/Randomization.h>
 #include <scene/SceneView.h>
 
 void bindSceneView(py::module& m)
@@ -11,14 +12,18 @@ void bindSceneView(py::module& m)
         .value("Unknown", LightType::Unknown)
         .value("AmbientLight", LightType::AmbientLight)
         .value("DirectionalLight", LightType::DirectionalLight)
-        .value("PointLight", LightType::PointLight);
+        .value("PointLight", LightType::PointLight)
+        .value("SpotLight", LightType::SpotLight);
 
     py::class_<Light, std::shared_ptr<Light>>(m, "Light")
-        .def_property_readonly("type", &Light::type, "Light type")
+        .def(py::init<>())
+        .def(py::init<LightType>(), py::arg("type"))
+        .def_property("type", &Light::type, &Light::setType, "Light type")
         .def_property_readonly("ambient_color", &Light::ambientColor, "Light ambient color")
         .def_property_readonly("diffuse_color", &Light::diffuseColor, "Light diffuse color")
         .def_property_readonly("specular_color", &Light::specularColor, "Light specular color")
-        .def_property_readonly("position", &Light::position, "Light position in world coordinates")
+        .def_property("position", &Light::position, &Light::setPosition,
+                      "Light position in world coordinates, set by moving its target")
         .def_property("target", &Light::target, &Light::setTarget,
                       "Light target position in world coordinates")
         .def_property("direction", &Light::direction, &Light::setDirection,
@@ -33,11 +38,67 @@ void bindSceneView(py::module& m)
                       "Light specular coeffitient")
         .def_property("shadow_caster", &Light::isShadowCaster, &Light::shadowCaster,
                       "Flag indicating whether this light should cast shadows or not")
+        .def_property("range", &Light::range, &Light::setRange,
+                      "Distance beyond which a point or spot light lights nothing, 0 for unbounded")
+        .def_property("spot_angle", &Light::spotAngle, &Light::setSpotAngle,
+                      "Half angle of the cone of a spot light around its direction, in radians")
         // operators
         .def(py::self == py::self)
-        .def(py::self != py::self);
+        .def(py::self != py::self)
+        // pickle
+        .def(pickle<Light>());
+
+    // lens distortion
+    py::enum_<LensModel>(m, "LensModel")
+        .value("Pinhole", LensModel::Pinhole)
+        .value("BrownConrady", LensModel::BrownConrady)
+        .value("Fisheye", LensModel::Fisheye);
+    py::class_<LensDistortion>(m, "LensDistortion")
+        .def(py::init<>(), "No distortion")
+        .def(py::init([](LensModel model, float k1, float k2, float k3, float k4, float p1,
+                         float p2) {
+                 return LensDistortion{model, k1, k2, k3, k4, p1, p2};
+             }),
+             py::arg("model"), py::arg("k1") = 0.f, py::arg("k2") = 0.f, py::arg("k3") = 0.f,
+             py::arg("k4") = 0.f, py::arg("p1") = 0.f, py::arg("p2") = 0.f,
+             "Distortion of a lens model, with the coefficients of OpenCV")
+        .def_readwrite("model", &LensDistortion::model, "Distortion model")
+        .def_readwrite("k1", &LensDistortion::k1, "Radial coefficient")
+        .def_readwrite("k2", &LensDistortion::k2, "Radial coefficient")
+        .def_readwrite("k3", &LensDistortion::k3, "Radial coefficient")
+        .def_readwrite("k4", &LensDistortion::k4, "Radial coefficient of fisheye lenses")
+        .def_readwrite("p1", &LensDistortion::p1, "Tangential coefficient of Brown-Conrady lenses")
+        .def_readwrite("p2", &LensDistortion::p2, "Tangential coefficient of Brown-Conrady lenses")
+        .def_property_readonly("enabled", &LensDistortion::enabled, "The lens distorts images")
+        .def(
+            "distort",
+            [](const LensDistortion& self, float x, float y) {
+                float xd, yd;
+                self.distort(x, y, xd, yd);
+                return py::make_tuple(xd, yd);
+            },
+            py::arg("x"), py::arg("y"),
+            "Distorted normalized coordinates, x right and y down, of undistorted ones")
+        .def(
+            "undistort",
+            [](const LensDistortion& self, float xd, float yd) -> py::object {
+                float x, y;
+                if (!self.undistort(xd, yd, x, y))
+                    return py::none();
+                return py::make_tuple(x, y);
+            },
+            py::arg("x"), py::arg("y"),
+            "Undistorted normalized coordinates of distorted ones, None if no ray is seen there")
+        // operators
+        .def(py::self == py::self)
+        .def(py::self != py::self)
+        // pickle
+        .def(pickle<LensDistortion>());
 
     py::class_<Camera, std::shared_ptr<Camera>>(m, "Camera")
+        .def(py::init<const Matrix4f&, const Matrix4f&>(), py::arg("view_matrix"),
+             py::arg("projection_matrix"),
+             "Camera of column-major view and projection matrices, as in pybullet")
         .def_property_readonly(
             "projection_matrix",
             [](const Camera& self) {
@@ -56,11 +117,111 @@ void bindSceneView(py::module& m)
                 return py::array_t<float>({4, 4}, self.poseMatrix().data());
             },
             "Pose matrix")
+        .def_property_readonly(
+            "intrinsics",
+            [](const Camera& self) {
+                if (!self.hasIntrinsics())
+                    throw py::value_error("Invalid projection matrix");
+                return py::make_tuple(self.yfov(), self.znear(), self.zfar(), self.aspect());
+            },
+            "Vertical field of view, z near, z far and aspect ratio of the projection matrix")
+        .def_property("distortion", &Camera::distortion, &Camera::setDistortion,
+                      "Distortion of the lens, applied by native renderers to perspective views")
+        .def_property("handle", &Camera::handle, &Camera::setHandle,
+                      "Handle of the registered camera, -1 if not registered")
         // operators
         .def(py::self == py::self)
         .def(py::self != py::self);
 
+    // OutputChannel enum
+    py::enum_<OutputChannel>(m, "OutputChannel", py::arithmetic())
+        .value("Color", OutputChannel::Color)
+        .value("Depth", OutputChannel::Depth)
+        .value("Mask", OutputChannel::Mask)
+        .value("Points", OutputChannel::Points)
+        .value("Motion", OutputChannel::Motion)
+        .value("Normals", OutputChannel::Normals)
+        .value("DepthPyramid", OutputChannel::DepthPyramid)
+        .value("Events", OutputChannel::Events)
+        .value("Visibility", OutputChannel::Visibility)
+        .value("Boxes", OutputChannel::Boxes)
+        .value("Keypoints", OutputChannel::Keypoints);
+
+    // PointFrame enum
+    py::enum_<PointFrame>(m, "PointFrame")
+        .value("Camera", PointFrame::Camera)
+        .value("World", PointFrame::World);
+
+    // image formats
+    py::enum_<ColorFormat>(m, "ColorFormat")
+        .value("RGBA", ColorFormat::RGBA)
+        .value("RGB", ColorFormat::RGB);
+    py::enum_<DepthFormat>(m, "DepthFormat")
+        .value("Float32", DepthFormat::Float32)
+        .value("Float16", DepthFormat::Float16)
+        .value("UInt16", DepthFormat::UInt16);
+    py::enum_<MaskFormat>(m, "MaskFormat")
+        .value("Int32", MaskFormat::Int32)
+        .value("UInt16", MaskFormat::UInt16);
+
+    // quality tiers
+    py::enum_<TextureFilter>(m, "TextureFilter")
+        .value("Nearest", TextureFilter::Nearest)
+        .value("Bilinear", TextureFilter::Bilinear)
+        .value("Trilinear", TextureFilter::Trilinear);
+    py::class_<Quality>(m, "Quality")
+        .def(py::init<>(), "Renderer defaults")
+        .def_readwrite("multisamples", &Quality::multisamples,
+                       "MSAA samples per pixel, 0 for none, -1 for the renderer default")
+        .def_readwrite("shadows", &Quality::shadows, "Shadows of shadow casting lights")
+        .def_readwrite("specular", &Quality::specular, "Specular highlights")
+        .def_readwrite("texture_filter", &Quality::textureFilter, "Filtering of textures")
+        .def_static("high", &Quality::High, "Renderer defaults")
+        .def_static("fast", &Quality::Fast,
+                    "No multisampling, shadows or specular highlights, nearest texels")
+        // operators
+        .def(py::self == py::self)
+        .def(py::self != py::self)
+        // pickle
+        .def(pickle<Quality>());
+
+    // sensor noise models
+    py::class_<SensorNoise>(m, "SensorNoise")
+        .def(py::init<>(), "All models off")
+        .def_readwrite("baseline", &SensorNoise::baseline,
+                       "Stereo baseline in meters of quantized disparities, 0 for none")
+        .def_readwrite("subpixel", &SensorNoise::subpixel, "Disparity step in pixels")
+        .def_readwrite("axial_sigma", &SensorNoise::axialSigma,
+                       "Standard deviation of the depth in meters at 1 meter, growing with the "
+                       "square of the depth")
+        .def_readwrite("edge_dropout", &SensorNoise::edgeDropout,
+                       "Probability of a pixel at a depth edge to read no depth")
+        .def_readwrite("edge_threshold", &SensorNoise::edgeThreshold,
+                       "Depth difference in meters with a neighbor at an edge")
+        .def_readwrite("vignetting", &SensorNoise::vignetting,
+                       "Intensity lost at the image corners, falling off quadratically")
+        .def_readwrite("white_balance", &SensorNoise::whiteBalance,
+                       "Gains of the red, green and blue channels")
+        .def_readwrite("shot_noise", &SensorNoise::shotNoise,
+                       "Standard deviation over the square root of 8-bit intensities")
+        .def_readwrite("read_noise", &SensorNoise::readNoise,
+                       "Standard deviation in 8-bit levels")
+        .def_readwrite("seed", &SensorNoise::seed, "Seed of the noise, drawn with the frame index")
+        .def_property_readonly("enabled", &SensorNoise::enabled, "Any model is on")
+        // operators
+        .def(py::self == py::self)
+        .def(py::self != py::self)
+        // pickle
+        .def(pickle<SensorNoise>());
+
+    // Projection enum
+    py::enum_<Projection>(m, "Projection")
+        .value("Perspective", Projection::Perspective)
+        .value("Cubemap", Projection::Cubemap)
+        .value("Equirectangular", Projection::Equirectangular);
+
     py::class_<SceneView, std::shared_ptr<SceneView>>(m, "SceneView")
+        .def(py::init<>())
         .def_property("viewport", &SceneView::viewport, &SceneView::setViewport, "Image size")
         .def_property("bg_color", &SceneView::backgroundColor, &SceneView::setBackgroundColor,
                       "Background color")
@@ -68,12 +229,173 @@ void bindSceneView(py::module& m)
                       "Background texture index")
         .def_property("light", &SceneView::light, &SceneView::setLight,
                       py::return_value_policy::reference_internal, "Light")
+        .def_property("lights", &SceneView::lights, &SceneView::setLights,
+                      "Point and spot lights added to light, clustered over the view by the "
+                      "native backend")
         .def_property("camera", &SceneView::camera, &SceneView::setCamera,
                       py::return_value_policy::reference_internal, "Camera")
+        .def_property("multiview_cameras", &SceneView::multiviewCameras,
+                      &SceneView::setMultiviewCameras,
+                      "Cameras of the views drawn after that of camera in a multiview frame, "
+                      "their images stacked below its own")
+        .def_property_readonly("view_count", &SceneView::viewCount,
+                               "Views of the frame, stacked top to bottom, 1 for single views")
+        .def(
+            "view_camera",
+            [](const SceneView& self, int index) -> py::object {
+                if (!self.camera() || index < 0 || index >= self.viewCount())
+                    return py::none();
+                return py::cast(std::make_shared<Camera>(self.viewCamera(index)));
+            },
+            "Camera of a view of a multiview frame, the image camera for the first one, or None",
+            py::arg("index"))
+        .def(
+            "multiview_intersects",
+            [](const SceneView& self, const AABB& box) {
+                return self.multiviewFrustum().intersects(box);
+            },
+            "A box may be in view, tested against the frustum of all the views at once",
+            py::arg("box"))
+        .def_property("previous_camera", &SceneView::previousCamera,
+                      &SceneView::setPreviousCamera, py::return_value_policy::reference_internal,
+                      "Camera of the previous frame for the Motion channel, None for the camera")
+        .def_property("previous_state", &SceneView::previousState, &SceneView::setPreviousState,
+                      "Scene state of the previous frame for the Motion channel, None for the "
+                      "current one")
+        .def_property("projective_texture", &SceneView::projectiveTexture,
+                      &SceneView::setProjectiveTexture,
+                      py::return_value_policy::reference_internal,
+                      "Projector of the textures of textured shapes, None for their uv")
         .def_property("flags", &SceneView::flags, &SceneView::setFlags, "Flags")
+        .def_property("output_channels", &SceneView::outputChannels,
+                      &SceneView::setOutputChannels, "Bitmask of requested output channels")
+        .def("has_output_channel", &SceneView::hasOutputChannel,
+             "Check whether an output channel is requested")
+        .def_property("projection", &SceneView::projection, &SceneView::setProjection,
+                      "Perspective or panoramic projection around the camera position")
+        .def_property("roi", &SceneView::roi, &SceneView::setRoi,
+                      "Region of interest (x, y, width, height) of the viewport the images are "
+                      "restricted to, ignored if of zero size")
+        .def_property_readonly("has_roi", &SceneView::hasRoi,
+                               "Images are restricted to a region of interest")
+        .def_property_readonly("image_size", &SceneView::imageSize,
+                               "Size of the images, that of the region of interest if any")
+        .def_property_readonly(
+            "image_camera",
+            [](const SceneView& self) -> py::object {
+                if (!self.camera())
+                    return py::none();
+                return py::cast(std::make_shared<Camera>(self.imageCamera()));
+            },
+            "Camera drawing the images, whose projection is restricted to the region of "
+            "interest if any, or None")
+        .def_property("point_frame", &SceneView::pointFrame, &SceneView::setPointFrame,
+                      "Frame of the points of the Points channel")
+        .def_property("depth_pyramid_levels", &SceneView::depthPyramidLevels,
+                      &SceneView::setDepthPyramidLevels,
+                      "Levels of the DepthPyramid channel, 1 to 16, the first of half the image "
+                      "size")
+        .def_property("event_threshold", &SceneView::eventThreshold,
+                      &SceneView::setEventThreshold,
+                      "Change of log luminance firing an event of the Events channel, at least "
+                      "0.01")
+        .def_property("event_time", &SceneView::eventTime, &SceneView::setEventTime,
+                      "Time of the frame in seconds, events being timed between the previous "
+                      "frame of the camera and this one")
+        .def_property("compact_points", &SceneView::compactPoints, &SceneView::setCompactPoints,
+                      "Points of the pixels where something was drawn only, with their "
+                      "segmentation ids")
+        .def_property("color_format", &SceneView::colorFormat, &SceneView::setColorFormat,
+                      "Pixel format of color images, RGBA or RGB")
+        .def_property("depth_format", &SceneView::depthFormat, &SceneView::setDepthFormat,
+                      "Pixel format of depth images, float32, float16 or uint16 scaled by "
+                      "depth_scale")
+        .def_property("mask_format", &SceneView::maskFormat, &SceneView::setMaskFormat,
+                      "Pixel format of masks, int32 or uint16 body ids, 0xFFFF for the background")
+        .def_property("depth_scale", &SceneView::depthScale, &SceneView::setDepthScale,
+                      "Units per meter of uint16 depth, 1000 for millimeters")
+        .def_property("render_scale", &SceneView::renderScale, &SceneView::setRenderScale,
+                      "Internal resolution over the image size, images being resampled to "
+                      "their size, 1 for none")
+        .def_property_readonly("has_render_scale", &SceneView::hasRenderScale,
+                               "Images are rendered at a scaled resolution and resampled")
+        .def_property_readonly("has_lens_distortion", &SceneView::hasLensDistortion,
+                               "The camera lens distorts the images of this perspective view")
+        .def("render_size", &SceneView::renderSize,
+             "Internal resolution of images of a size, at the render scale", py::arg("size"))
+        .def_property("quality", &SceneView::quality, &SceneView::setQuality,
+                      py::return_value_policy::reference_internal,
+                      "Quality tier: multisamples, shadows, specular and texture filtering")
+        .def_property("sensor_noise", &SceneView::sensorNoise, &SceneView::setSensorNoise,
+                      py::return_value_policy::reference_internal,
+                      "Noise models of the sensor applied to the color and depth images")
+        .def_property(
+            "material_overrides",
+            [](const SceneView& self) -> py::object {
+                if (!self.materialOverrides())
+                    return py::none();
+                return py::cast(*self.materialOverrides());
+            },
+            [](SceneView& self, const py::object& overrides) {
+                self.setMaterialOverrides(
+                    overrides.is_none()
+                        ? nullptr
+                        : std::make_shared<MaterialOverrides>(overrides.cast<MaterialOverrides>()));
+            },
+            "Materials drawn instead of those of the scene, by (node id, shape index), e.g. "
+            "randomized ones, or None")
+        .def_property("camera_layers", &SceneView::cameraLayers, &SceneView::setCameraLayers,
+                      "Bitmask of the visibility layers the cameras of the view see")
+        .def("visible", &SceneView::visible, py::arg("node_id"), py::arg("shape_index") = -1,
+             "Whether a shape, or a node for shape index -1, is in a layer the cameras see")
+        .def_property(
+            "keypoints",
+            [](const SceneView& self) -> py::object {
+                if (!self.keypoints())
+                    return py::none();
+                return py::cast(*self.keypoints());
+            },
+            [](SceneView& self, const py::object& keypoints) {
+                self.setKeypoints(keypoints.is_none()
+                                      ? nullptr
+                                      : std::make_shared<Keypoints>(keypoints.cast<Keypoints>()));
+            },
+            "Points projected by the Keypoints channel, a list of (node id, (x, y, z)) in the "
+            "frame of the node, or None")
         // operators
         .def(py::self == py::self)
         .def(py::self != py::self)
         // pickle
         .def(pickle<SceneView>());
+
+    py::class_<Randomization, std::shared_ptr<Randomization>> randomization(m, "Randomization");
+    py::enum_<Randomization::Mode>(randomization, "Mode")
+        .value("PerEpisode", Randomization::Mode::PerEpisode)
+        .value("PerFrame", Randomization::Mode::PerFrame);
+    randomization
+        .def(py::init<>(),
+             "Uniform distributions of the materials and light drawn in the views of a client")
+        .def_readwrite("seed", &Randomization::seed, "Seed of the random streams")
+        .def_readwrite("mode", &Randomization::mode, "New sample per episode or per frame")
+        .def_readwrite("bodies", &Randomization::bodies, "Randomized bodies, all if empty")
+        .def_readwrite("colors", &Randomization::colors, "Draw the diffuse colors")
+        .def_readwrite("color_lower", &Randomization::colorLower, "Lower diffuse color")
+        .def_readwrite("color_upper", &Randomization::colorUpper, "Upper diffuse color")
+        .def_readwrite("textures", &Randomization::textures,
+                       "Atlas of texture unique ids, loaded with pybullet loadTexture")
+        .def_readwrite("texture_probability", &Randomization::textureProbability,
+                       "Chance of a shape to draw a texture from the atlas")
+        .def_readwrite("light", &Randomization::light, "Draw the light parameters")
+        .def_readwrite("light_direction_lower", &Randomization::lightDirectionLower,
+                       "Lower light direction")
+        .def_readwrite("light_direction_upper", &Randomization::lightDirectionUpper,
+                       "Upper light direction")
+        .def_readwrite("light_color_lower", &Randomization::lightColorLower, "Lower light color")
+        .def_readwrite("light_color_upper", &Randomization::lightColorUpper, "Upper light color")
+        .def_readwrite("ambient_range", &Randomization::ambientRange,
+                       "Range of the light ambient coefficient")
+        .def_readwrite("diffuse_range", &Randomization::diffuseRange,
+                       "Range of the light diffuse coefficient")
+        .def_readwrite("specular_range", &Randomization::specularRange,
+                       "Range of the light specular coefficient");
 }
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <scene/ShapeMatrices.h>
+
+void bindShapeMatrices(py::module& m)
+{
+    using namespace scene;
+
+    // ShapeMatrices
+    py::class_<ShapeMatrices, std::shared_ptr<ShapeMatrices>>(m, "ShapeMatrices")
+        .def(py::init<>())
+        .def("update", &ShapeMatrices::update,
+             "Rebuild on scene changes, update the shapes of nodes with dirty poses otherwise",
+             py::arg("scene_graph"), py::arg("scene_state"))
+        .def("invalidate", &ShapeMatrices::invalidate, "Force a rebuild at the next update")
+        .def("offset", &ShapeMatrices::offset,
+             "Index of the first shape of a node, -1 if none", py::arg("node_id"))
+        .def_property_readonly(
+            "matrices",
+            [](const ShapeMatrices& self) {
+                const auto data = reinterpret_cast<const float*>(self.matrices().data());
+                return py::array_t<float>({ssize_t(self.size()), ssize_t(4), ssize_t(4)}, data,
+                                          py::cast(self));
+            },
+            "World matrices of the shapes (N,4,4), column-major as SceneState.matrices")
+        .def_property_readonly(
+            "node_ids",
+            [](const ShapeMatrices& self) {
+                return py::array_t<int>({ssize_t(self.size())}, self.nodeIds().data(),
+                                        py::cast(self));
+            },
+            "Node of each shape")
+        .def_property_readonly(
+            "shape_indices",
+            [](const ShapeMatrices& self) {
+                return py::array_t<int>({ssize_t(self.size())}, self.shapeIndices().data(),
+                                        py::cast(self));
+            },
+            "Index of each shape in its node")
+        .def_property_readonly("updated", &ShapeMatrices::updated,
+                               "Number of matrices computed by the last update")
+        .def("__len__", &ShapeMatrices::size);
+}
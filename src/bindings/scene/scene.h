@@ -1,12 +1,24 @@
 #pragma once
 
+#include "BVH.h"
+#include "MeshLod.h"
+#include "RaySensor.h"
 #include "SceneGraph.h"
+#include "SceneLayer.h"
 #include "SceneState.h"
+#include "SceneTables.h"
 #include "SceneView.h"
+#include "ShapeMatrices.h"
 
 void bindScene(py::module& m)
 {
     bindSceneGraph(m);
+    bindSceneLayer(m);
     bindSceneState(m);
     bindSceneView(m);
+    bindBVH(m);
+    bindShapeMatrices(m);
+    bindSceneTables(m);
+    bindMeshLod(m);
+    bindRaySensor(m);
 }
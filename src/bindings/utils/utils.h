@@ -2,9 +2,33 @@
 
 #include <pybind11/numpy.h>
 
+#include <render/FrameCodec.h>
+#include <utils/image.h>
 #include <utils/math.h>
 #include <utils/serialization.h>
 
+/**
+ * @brief Array written by an image conversion, \p out itself if given, never a converted copy
+ *
+ * @param out - None or a writable C-contiguous array of \p size elements of type T
+ * @param shape - shape of a new array if \p out is None
+ * @param size - expected number of elements
+ * @throw py::value_error - if \p out does not fit
+ */
+template <class T>
+py::array_t<T> outputArray(const py::object& out, const std::vector<ssize_t>& shape, ssize_t size)
+{
+    if (out.is_none())
+        return py::array_t<T>(shape);
+    if (!py::array_t<T, py::array::c_style>::check_(out))
+        throw py::value_error("out must be a C-contiguous array of " +
+                              std::string(py::str(py::dtype::of<T>())));
+    auto array = py::reinterpret_borrow<py::array_t<T>>(out);
+    if (!array.writeable() || array.size() != size)
+        throw py::value_error("out must be writable and have one element per pixel");
+    return array;
+}
+
 void bindUtils(py::module& m)
 {
     // Affine3f
@@ -23,18 +47,199 @@ void bindUtils(py::module& m)
         .def(py::self == py::self)
         .def(py::self != py::self);
 
+    // image conversions, writing into out when given, e.g. a FrameData image
+    m.def(
+        "depth_from_zbuffer",
+        [](py::array_t<float, py::array::c_style | py::array::forcecast> zbuffer, float znear,
+           float zfar, py::object out) {
+            auto depth = outputArray<float>(out, zbuffer.request().shape, zbuffer.size());
+            const float* src = zbuffer.data();
+            float* dst = depth.mutable_data();
+            {
+                py::gil_scoped_release release;
+                depthFromZBuffer(src, size_t(zbuffer.size()), znear, zfar, dst);
+            }
+            return depth;
+        },
+        py::arg("zbuffer"), py::arg("znear"), py::arg("zfar"), py::arg("out") = py::none(),
+        "Metric depth from OpenGL Z-buffer values, 0 on the far plane");
+    m.def(
+        "rgb_to_mask",
+        [](py::array_t<uint8_t, py::array::c_style | py::array::forcecast> rgb, py::object out) {
+            if (rgb.ndim() < 1 || rgb.shape(rgb.ndim() - 1) < 3)
+                throw py::value_error("rgb must have at least 3 channels along the last axis");
+            const auto channels = rgb.shape(rgb.ndim() - 1);
+            const auto count = rgb.size() / channels;
+            auto mask = outputArray<int>(
+                out, std::vector<ssize_t>(rgb.shape(), rgb.shape() + rgb.ndim() - 1), count);
+            const uint8_t* src = rgb.data();
+            int* dst = mask.mutable_data();
+            {
+                py::gil_scoped_release release;
+                rgbToMask(src, size_t(count), int(channels), dst);
+            }
+            return mask;
+        },
+        py::arg("rgb"), py::arg("out") = py::none(),
+        "Segmentation mask from an RGB-encoded image, see mask_to_rgb");
+
+    // lossless frame compression, e.g. for remote clients
+    m.def(
+        "encode_frame",
+        [](py::array_t<uint8_t, py::array::c_style | py::array::forcecast> color,
+           py::object depth, py::object mask) {
+            if (color.ndim() != 3 || color.shape(2) != 4)
+                throw py::value_error("color must be an (H, W, 4) image");
+            const auto rows = color.shape(0), cols = color.shape(1);
+            std::vector<py::array> planes; //<- keeps contiguous copies alive
+            const auto plane = [&](const py::object& image, const char* name) -> void* {
+                if (image.is_none())
+                    return nullptr;
+                auto array = py::array::ensure(image, py::array::c_style);
+                if (!array || array.ndim() != 2 || array.shape(0) != rows ||
+                    array.shape(1) != cols || array.itemsize() != 4)
+                    throw py::value_error(std::string(name) +
+                                          " must be an (H, W) image of 4-byte pixels");
+                planes.push_back(array);
+                return const_cast<void*>(array.data());
+            };
+
+            render::FrameData frame{int(cols), int(rows), const_cast<uint8_t*>(color.data()),
+                                    static_cast<float*>(plane(depth, "depth")),
+                                    static_cast<int*>(plane(mask, "mask"))};
+            std::vector<uint8_t> encoded;
+            {
+                py::gil_scoped_release release;
+                render::encodeFrame(frame, encoded);
+            }
+            return py::bytes(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+        },
+        py::arg("color"), py::arg("depth") = py::none(), py::arg("mask") = py::none(),
+        "Losslessly compress the color, depth and mask images of a frame");
+    m.def(
+        "decode_frame",
+        [](py::buffer data) {
+            const auto buffer = data.request();
+            const auto bytes = static_cast<const uint8_t*>(buffer.ptr);
+            const size_t size = size_t(buffer.size * buffer.itemsize);
+            const auto info = render::encodedFrameInfo(bytes, size);
+            const auto has = [&info](scene::OutputChannel channel) {
+                return bool(info.channels & int(channel));
+            };
+            const ssize_t rows = info.rows, cols = info.cols;
+
+            py::array_t<uint8_t> color({rows, cols, ssize_t(4)});
+            py::array_t<float> depth({rows, cols});
+            py::array_t<int> mask({rows, cols});
+            render::FrameData frame{info.cols, info.rows, color.mutable_data(),
+                                    depth.mutable_data(), mask.mutable_data()};
+            {
+                py::gil_scoped_release release;
+                render::decodeFrame(bytes, size, frame);
+            }
+            return py::make_tuple(
+                has(scene::OutputChannel::Color) ? py::object(color) : py::none(),
+                has(scene::OutputChannel::Depth) ? py::object(depth) : py::none(),
+                has(scene::OutputChannel::Mask) ? py::object(mask) : py::none());
+        },
+        py::arg("data"), "Color, depth and mask images of an encoded frame, None if left out");
+}
+
+/// smallest serialized block pickled out of band with protocol 5, see reduceEx
+constexpr size_t kPickleBufferSize = 1 << 12;
+
+/**
+ * @brief Serialized object written in place into a bytes object
+ *
+ * @param object - object to serialize
+ * @param outOfBandSize - smallest block left out of the bytes
+ * @param blocks - left out blocks, appended to if not null
+ */
+template <class T>
+py::bytes serializedBytes(const T& object,
+                          size_t outOfBandSize = std::numeric_limits<size_t>::max(),
+                          SerializedBlocks* blocks = nullptr)
+{
+    const size_t size = BinarySerializedSize(object, outOfBandSize, blocks);
+    auto bytes =
+        py::reinterpret_steal<py::bytes>(PyBytes_FromStringAndSize(nullptr, ssize_t(size)));
+    if (!bytes)
+        throw py::error_already_set();
+    BinarySerializeInto(object, reinterpret_cast<uint8_t*>(PyBytes_AS_STRING(bytes.ptr())),
+                        outOfBandSize);
+    return bytes;
 }
 
+/**
+ * @brief Pickling as serialized bytes
+ *
+ * The state set may also be the tuple of reduceEx: serialized bytes, out-of-band threshold,
+ * then one buffer per out-of-band block.
+ */
 template <class T>
 auto pickle()
 {
     return py::pickle(
         [](const T& p) { //
-            return py::bytes(BinarySerialize(p));
+            return serializedBytes(p);
         },
-        [](py::bytes& t) {
+        [](const py::object& state) {
             auto p = T();
-            BinaryDeserialize(t.cast<std::string>(), p);
+            if (py::isinstance<py::tuple>(state)) {
+                const auto items = state.cast<py::tuple>();
+                if (items.size() < 2)
+                    throw py::value_error("invalid pickled state");
+                std::vector<py::buffer_info> buffers;
+                SerializedBlocks blocks;
+                for (size_t i = 2; i < items.size(); ++i) {
+                    buffers.push_back(items[i].cast<py::buffer>().request());
+                    blocks.emplace_back(buffers.back().ptr,
+                                        size_t(buffers.back().size * buffers.back().itemsize));
+                }
+                const auto bytes = items[0].cast<py::buffer>().request();
+                BinaryDeserializeFrom(static_cast<const uint8_t*>(bytes.ptr),
+                                      size_t(bytes.size * bytes.itemsize), p,
+                                      items[1].cast<size_t>(), &blocks);
+            }
+            else {
+                const auto bytes = state.cast<py::buffer>().request();
+                BinaryDeserializeFrom(static_cast<const uint8_t*>(bytes.ptr),
+                                      size_t(bytes.size * bytes.itemsize), p);
+            }
             return p;
         });
 }
+
+/**
+ * @brief __reduce_ex__ of classes pickled with pickle(), zero-copy with protocol 5
+ *
+ * With protocol 5, serialized blocks of kPickleBufferSize bytes or more, e.g. mesh vertices
+ * or node poses, are pickled as read-only PickleBuffer views of the object itself instead of
+ * being copied into the state, so that a buffer_callback can send them out of band.
+ */
+template <class T>
+py::tuple reduceEx(const py::object& self, int protocol)
+{
+    const auto& object = self.cast<const T&>();
+    py::object state;
+    if (protocol < 5) {
+        state = serializedBytes(object);
+    }
+    else {
+        SerializedBlocks blocks;
+        py::list items;
+        items.append(serializedBytes(object, kPickleBufferSize, &blocks));
+        items.append(kPickleBufferSize);
+        const auto pickleBuffer = py::module::import("pickle").attr("PickleBuffer");
+        for (const auto& block : blocks) {
+            // the view keeps the object alive
+            py::array_t<uint8_t> view({ssize_t(block.second)}, {ssize_t(1)},
+                                      static_cast<const uint8_t*>(block.first), self);
+            view.attr("setflags")("write"_a = false);
+            items.append(pickleBuffer(view));
+        }
+        state = py::tuple(items);
+    }
+    return py::make_tuple(py::module::import("copyreg").attr("__newobj__"),
+                          py::make_tuple(self.get_type()), state);
+}
@@ -0,0 +1,280 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "AssetCache.h"
+#include <render/AssetLoader.h>
+#include <scene/MeshLod.h>
+#include <utils/hash.h>
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <pthread.h>
+#include <sys/stat.h>
+
+namespace {
+
+/// canonical path if the file exists, as is otherwise, and modification time
+std::pair<std::string, int64_t> makeFileKey(const std::string& filename)
+{
+    char path[PATH_MAX];
+    std::string canonical = realpath(filename.c_str(), path) ? path : filename;
+
+    struct stat info;
+    const int64_t mtime = stat(canonical.c_str(), &info) == 0 ? int64_t(info.st_mtime) : 0;
+    return {canonical, mtime};
+}
+
+/// drop entries only referenced by the cache
+template <class Map>
+void pruneUnused(Map& map)
+{
+    for (auto it = map.begin(); it != map.end();) {
+        if (it->second.use_count() == 1)
+            it = map.erase(it);
+        else
+            ++it;
+    }
+}
+
+/// shapes whose materials are only referenced by the cache, shapes of scenes share them
+bool unusedShapes(const std::vector<scene::Shape>& shapes)
+{
+    for (const auto& shape : shapes)
+        if (shape.material() && shape.material().use_count() > 1)
+            return false;
+    return true;
+}
+
+} // namespace
+
+AssetCache& AssetCache::instance()
+{
+    static AssetCache cache;
+    return cache;
+}
+
+AssetCache::AssetCache()
+{
+    // forked children inherit the cache unlocked
+    pthread_atfork([] { instance()._mutex.lock(); }, [] { instance()._mutex.unlock(); },
+                   [] { instance()._mutex.unlock(); });
+}
+
+std::shared_ptr<scene::Mesh> AssetCache::fileMesh(const std::string& filename)
+{
+    const auto key = makeFileKey(filename);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& mesh = _fileMeshes[key];
+    if (!mesh) {
+        mesh = std::make_shared<scene::Mesh>(filename);
+        mesh->setAssetId(_nextAssetId++);
+    }
+    return mesh;
+}
+
+std::shared_ptr<scene::Mesh> AssetCache::memoryMesh(const std::shared_ptr<scene::MeshData>& data)
+{
+    const auto hash = data->hash();
+
+    // quantized meshes are compared without decoding them
+    const auto quantized = render::meshQuantization() && !data->quantized()
+                               ? scene::QuantizedMesh::make(data->vertices(), data->normals(),
+                                                            data->uvs())
+                               : nullptr;
+    const auto same = [&](const scene::MeshData& cached) {
+        if (quantized && cached.quantized())
+            return cached.indices() == data->indices() && *cached.quantized() == *quantized;
+        return cached == *data;
+    };
+
+    const auto find = [&]() -> std::shared_ptr<scene::Mesh> {
+        const auto range = _memoryMeshes.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+            if (same(*it->second->data()))
+                return it->second;
+        return nullptr;
+    };
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (auto mesh = find())
+            return mesh;
+    }
+
+    // simplified from the float attributes, then interleaved or quantized before being shared;
+    // unlocked, so that links converted in parallel prepare their meshes concurrently
+    auto lods = scene::makeMeshLods(*data);
+    render::prepareMeshData(*data);
+    for (const auto& lod : lods)
+        render::prepareMeshData(*lod);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (auto mesh = find())
+        return mesh; //<- prepared meanwhile by another thread
+    auto mesh = std::make_shared<scene::Mesh>(data);
+    mesh->setAssetId(_nextAssetId++);
+    mesh->setLods(std::move(lods));
+    _memoryMeshes.emplace(hash, mesh);
+    return mesh;
+}
+
+std::shared_ptr<scene::Texture> AssetCache::fileTexture(const std::string& filename)
+{
+    const auto key = makeFileKey(filename);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& texture = _fileTextures[key];
+    if (!texture) {
+        texture = std::make_shared<scene::Texture>(filename);
+        texture->setAssetId(_nextAssetId++);
+    }
+    return texture;
+}
+
+std::shared_ptr<scene::Texture> AssetCache::memoryTexture(const uint8_t* texels, size_t count,
+                                                          const Size2i& size)
+{
+    const auto hash = hashBytes(texels, count, hashBytes(size.data(), sizeof(size)));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto range = _memoryTextures.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        const auto& bitmap = *it->second->bitmap();
+        if (bitmap.rows() == size[0] && bitmap.cols() == size[1] &&
+            bitmap.size() == count && std::equal(texels, texels + count, bitmap.data()))
+            return it->second;
+    }
+
+    auto data = std::vector<uint8_t>{texels, texels + count};
+    auto texture = std::make_shared<scene::Texture>(std::move(data), size);
+    texture->setAssetId(_nextAssetId++);
+    _memoryTextures.emplace(hash, texture);
+    return texture;
+}
+
+bool AssetCache::linkShapes(const LinkKey& key, std::vector<scene::Shape>& shapes) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto it = _linkShapes.find(key);
+    if (it == _linkShapes.end())
+        return false;
+    shapes = it->second;
+    return true;
+}
+
+void AssetCache::storeLinkShapes(const LinkKey& key, const std::vector<scene::Shape>& shapes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _linkShapes[key] = shapes;
+}
+
+int AssetCache::size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return int(_fileMeshes.size() + _memoryMeshes.size() + _fileTextures.size() +
+               _memoryTextures.size());
+}
+
+std::vector<int> AssetCache::assetIds() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<int> ids;
+    for (const auto& it : _fileMeshes)
+        ids.push_back(it.second->assetId());
+    for (const auto& it : _memoryMeshes)
+        ids.push_back(it.second->assetId());
+    for (const auto& it : _fileTextures)
+        ids.push_back(it.second->assetId());
+    for (const auto& it : _memoryTextures)
+        ids.push_back(it.second->assetId());
+    return ids;
+}
+
+uint64_t AssetCache::revision() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _revision;
+}
+
+void AssetCache::account(scene::MemoryAccounting& accounting) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& it : _fileMeshes)
+        accounting.add(*it.second);
+    for (const auto& it : _memoryMeshes)
+        accounting.add(*it.second);
+    for (const auto& it : _fileTextures)
+        accounting.add(*it.second);
+    for (const auto& it : _memoryTextures)
+        accounting.add(*it.second);
+}
+
+scene::Shape AssetCache::fileShape(const std::string& filename)
+{
+    auto extension = filename.substr(std::min(filename.rfind('.'), filename.size()));
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (extension == ".obj" || extension == ".stl")
+        return {scene::ShapeType::Mesh, Affine3f::Identity(), fileMesh(filename), nullptr};
+
+    auto material = std::make_shared<scene::Material>(
+        Color4f{1.f, 1.f, 1.f, 1.f}, Color3f{0.f, 0.f, 0.f}, fileTexture(filename));
+    return {scene::ShapeType::Cube, Affine3f::Identity(), Vector3f{1.f, 1.f, 1.f}, material};
+}
+
+int AssetCache::preload(const std::vector<std::string>& filenames)
+{
+    std::vector<scene::Shape> shapes;
+    for (const auto& filename : filenames)
+        shapes.push_back(fileShape(filename));
+    render::preloadAssets(shapes);
+
+    int loaded = 0;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& shape : shapes) {
+        const auto& mesh = shape.mesh();
+        if (mesh && render::loadMeshData(shape)) {
+            _preloaded.push_back(mesh);
+            ++loaded;
+        }
+        const auto& material = shape.material();
+        const auto texture = material ? material->diffuseTexture() : nullptr;
+        if (texture && (render::loadCompressedBitmap(*texture) || render::loadBitmap(*texture))) {
+            _preloaded.push_back(texture);
+            ++loaded;
+        }
+    }
+    return loaded;
+}
+
+void AssetCache::prune()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    // link shapes first, they hold meshes and textures
+    for (auto it = _linkShapes.begin(); it != _linkShapes.end();) {
+        if (unusedShapes(it->second))
+            it = _linkShapes.erase(it);
+        else
+            ++it;
+    }
+    pruneUnused(_fileMeshes);
+    pruneUnused(_memoryMeshes);
+    pruneUnused(_fileTextures);
+    pruneUnused(_memoryTextures);
+    ++_revision;
+}
+
+void AssetCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _fileMeshes.clear();
+    _memoryMeshes.clear();
+    _fileTextures.clear();
+    _memoryTextures.clear();
+    _linkShapes.clear();
+    _preloaded.clear();
+    ++_revision;
+}
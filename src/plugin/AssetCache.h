@@ -0,0 +1,160 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <scene/MemoryUsage.h>
+#include <scene/Mesh.h>
+#include <scene/Shape.h>
+#include <scene/Texture.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Process-wide mesh and texture asset cache
+ *
+ * Shared by all rendering interfaces of a process and kept across resets, so that the same
+ * robot loaded by many physics clients yields one Mesh object with one asset id.
+ *
+ * File assets are keyed by canonical path and modification time, in-memory assets by a hash of
+ * their content. The converted shapes of model links are kept too, so that loading the same
+ * model again shares their meshes and materials without converting the link description.
+ */
+class AssetCache
+{
+  public:
+    /**
+     * @brief Process-wide instance
+     */
+    static AssetCache& instance();
+
+    /**
+     * @brief Get a cached mesh for a model file
+     *
+     * @param filename - mesh model file on disk
+     * @return std::shared_ptr<scene::Mesh>
+     */
+    std::shared_ptr<scene::Mesh> fileMesh(const std::string& filename);
+
+    /**
+     * @brief Get a cached mesh for in-memory data
+     *
+     * Simplified levels of detail are generated when the data enters the cache.
+     *
+     * @param data - mesh data
+     * @return std::shared_ptr<scene::Mesh>
+     */
+    std::shared_ptr<scene::Mesh> memoryMesh(const std::shared_ptr<scene::MeshData>& data);
+
+    /**
+     * @brief Get a cached texture for an image file
+     *
+     * @param filename - image file on disk
+     * @return std::shared_ptr<scene::Texture>
+     */
+    std::shared_ptr<scene::Texture> fileTexture(const std::string& filename);
+
+    /**
+     * @brief Get a cached texture for in-memory texels
+     *
+     * @param texels - texture texels, copied only if no identical texture is cached
+     * @param count - number of texels bytes
+     * @param size - texture size
+     * @return std::shared_ptr<scene::Texture>
+     */
+    std::shared_ptr<scene::Texture> memoryTexture(const uint8_t* texels, size_t count,
+                                                  const Size2i& size);
+
+    /// model file, link index, loading flags, hash of the link description
+    using LinkKey = std::tuple<std::string, int, int, uint64_t>;
+
+    /**
+     * @brief Get the cached shapes of a model link
+     *
+     * @param key - link key
+     * @param shapes - shapes to fill, sharing meshes and materials with earlier loads
+     * @return bool - true if cached
+     */
+    bool linkShapes(const LinkKey& key, std::vector<scene::Shape>& shapes) const;
+
+    /**
+     * @brief Cache the shapes converted from a model link
+     *
+     * @param key - link key
+     * @param shapes - converted shapes
+     */
+    void storeLinkShapes(const LinkKey& key, const std::vector<scene::Shape>& shapes);
+
+    /**
+     * @brief Number of cached assets
+     */
+    int size() const;
+
+    /**
+     * @brief Asset ids of the cached meshes and textures
+     */
+    std::vector<int> assetIds() const;
+
+    /**
+     * @brief Number of prune() and clear() calls, caches of objects made of assets keyed by
+     * their id evict those no longer cached when it changes, see assetIds()
+     */
+    uint64_t revision() const;
+
+    /**
+     * @brief Account the memory of the cached meshes and textures
+     */
+    void account(scene::MemoryAccounting& accounting) const;
+
+    /**
+     * @brief Shape holding the cached asset of a file, see preload()
+     *
+     * @param filename - Wavefront OBJ and STL files are meshes, other files textures of a cube
+     * @return scene::Shape
+     */
+    scene::Shape fileShape(const std::string& filename);
+
+    /**
+     * @brief Load mesh and image files before the process forks, see render::preloadAssets()
+     *
+     * Preloaded assets are kept by prune(), so that children loading the files share them.
+     *
+     * @param filenames - mesh and image files, see fileShape()
+     * @return int - number of files loaded
+     */
+    int preload(const std::vector<std::string>& filenames);
+
+    /**
+     * @brief Drop cached assets and link shapes not used by any scene any more, but preloaded ones
+     */
+    void prune();
+
+    /**
+     * @brief Drop all cached assets, preloaded ones too, assets still in use by a scene keep their
+     * asset id
+     */
+    void clear();
+
+  private:
+    AssetCache();
+
+    using FileKey = std::pair<std::string, int64_t>; //<- canonical path, modification time
+
+    mutable std::mutex _mutex;
+    std::map<FileKey, std::shared_ptr<scene::Mesh>> _fileMeshes;
+    std::multimap<uint64_t, std::shared_ptr<scene::Mesh>> _memoryMeshes;
+    std::map<FileKey, std::shared_ptr<scene::Texture>> _fileTextures;
+    std::multimap<uint64_t, std::shared_ptr<scene::Texture>> _memoryTextures;
+    std::map<LinkKey, std::vector<scene::Shape>> _linkShapes;
+    std::vector<std::shared_ptr<const void>> _preloaded; //<- meshes and textures kept by prune()
+    int _nextAssetId = 0;
+    uint64_t _revision = 0;
+};
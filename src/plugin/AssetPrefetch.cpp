@@ -0,0 +1,106 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "AssetPrefetch.h"
+#include "AssetCache.h"
+
+#include <render/AssetLoader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+AssetPrefetch::AssetPrefetch(const std::vector<std::string>& filenames,
+                             const std::shared_ptr<render::BaseRenderer>& renderer,
+                             int numThreads)
+    : _renderer(renderer), _times(filenames.size())
+{
+    auto& cache = AssetCache::instance();
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        _shapes.push_back(cache.fileShape(filenames[i]));
+        _times[i].filename = filenames[i];
+    }
+
+    if (numThreads <= 0)
+        numThreads = int(std::min(std::max(std::thread::hardware_concurrency(), 1u), 8u));
+    numThreads = int(std::min(size_t(numThreads), _shapes.size()));
+    for (int i = 0; i < numThreads; ++i)
+        _workers.emplace_back([this] { run(); });
+}
+
+AssetPrefetch::~AssetPrefetch()
+{
+    for (auto& worker : _workers)
+        worker.join();
+}
+
+bool AssetPrefetch::done() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _done == _times.size();
+}
+
+bool AssetPrefetch::wait(double timeout) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    const auto finished = [this] { return _done == _times.size(); };
+    if (timeout <= 0.0) {
+        _finished.wait(lock, finished);
+        return true;
+    }
+    return _finished.wait_for(lock, std::chrono::duration<double>(timeout), finished);
+}
+
+std::vector<AssetLoadTime> AssetPrefetch::times() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _times;
+}
+
+void AssetPrefetch::run()
+{
+    for (size_t i = _next++; i < _shapes.size(); i = _next++) {
+        const auto& shape = _shapes[i];
+        AssetLoadTime time;
+        auto start = Clock::now();
+        if (shape.mesh()) {
+            time.loaded = bool(render::loadMeshData(shape));
+            render::loadMeshLods(shape);
+        }
+        else {
+            const auto& texture = *shape.material()->diffuseTexture();
+            time.loaded = render::loadCompressedBitmap(texture) || render::loadBitmap(texture);
+        }
+        time.loadSeconds = secondsSince(start);
+
+        if (time.loaded && _renderer) {
+            start = Clock::now();
+            try {
+                time.uploaded = _renderer->uploadAssets(shape);
+            }
+            catch (const std::exception&) {
+                // e.g. the context of the renderer cannot be made current on this thread, the
+                // assets are uploaded when drawn
+            }
+            time.uploadSeconds = secondsSince(start);
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        time.filename = std::move(_times[i].filename);
+        _times[i] = std::move(time);
+        if (++_done == _times.size())
+            _finished.notify_all();
+    }
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <render/BaseRenderer.h>
+#include <scene/Shape.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Load time of an asset of a prefetch manifest
+ */
+struct AssetLoadTime {
+    std::string filename;
+    bool loaded = false; //<- mesh parsed or texture decoded, false if the file cannot be loaded
+    bool uploaded = false; //<- uploaded to the GPU of the renderer
+    double loadSeconds = 0.0; //<- parsing or decoding, near 0 if it was already in the cache
+    double uploadSeconds = 0.0;
+};
+
+/**
+ * @brief Mesh and texture files of a manifest loaded into the asset cache in the background
+ *
+ * Files become shapes of the process asset cache as for AssetCache::preload(), then worker
+ * threads of their own parse the meshes with their levels of detail and decode the textures,
+ * compressed ones from the texture cache while texture compression is enabled, timing each
+ * file. With a renderer, each loaded asset is then uploaded through BaseRenderer::uploadAssets().
+ * Scenes loading the files afterwards share the cached assets, so that their first frame neither
+ * parses, decodes nor, with an EGL renderer, uploads them; a frame of the scene meanwhile waits
+ * for the assets being loaded.
+ *
+ * The prefetch keeps its assets in the cache until it is destroyed, which waits for the workers.
+ */
+class AssetPrefetch
+{
+  public:
+    /**
+     * @brief Start loading the files of a manifest
+     *
+     * @param filenames - mesh and image files, see AssetCache::fileShape()
+     * @param renderer - renderer to upload the assets to, null to only load them
+     * @param numThreads - worker threads, 0 for one per core up to 8
+     */
+    AssetPrefetch(const std::vector<std::string>& filenames,
+                  const std::shared_ptr<render::BaseRenderer>& renderer, int numThreads = 0);
+
+    /// wait for the workers
+    ~AssetPrefetch();
+
+    AssetPrefetch(const AssetPrefetch&) = delete;
+    AssetPrefetch& operator=(const AssetPrefetch&) = delete;
+
+    /// all files are loaded, or failed to
+    bool done() const;
+
+    /**
+     * @brief Wait for all files, at most \p timeout seconds if positive
+     *
+     * @return bool - true if done
+     */
+    bool wait(double timeout = 0.0) const;
+
+    /// load times of the manifest files, in order, zero for the files not done yet
+    std::vector<AssetLoadTime> times() const;
+
+  private:
+    void run();
+
+    std::vector<scene::Shape> _shapes; //<- keep the assets in the cache
+    std::shared_ptr<render::BaseRenderer> _renderer;
+    std::vector<AssetLoadTime> _times;
+    std::atomic<size_t> _next{0}; //<- next file to load
+    size_t _done = 0;
+    mutable std::mutex _mutex;
+    mutable std::condition_variable _finished;
+    std::vector<std::thread> _workers;
+};
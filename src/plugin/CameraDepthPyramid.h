@@ -0,0 +1,18 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+/**
+ * @brief Depth pyramid of the last camera image of a client, see
+ * RenderingInterface::cameraDepthPyramid()
+ */
+struct CameraDepthPyramid {
+    int cols = 0; //<- image width
+    int rows = 0; //<- image height
+    int levels = 0; //<- levels from 1, see render::depthLevelOffset()
+    std::vector<float> depths; //<- nearest and farthest depth of each texel, empty if none
+};
@@ -0,0 +1,18 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+/**
+ * @brief Events of the last camera image of a client since the previous one, see
+ * RenderingInterface::cameraEvents()
+ */
+struct CameraEvents {
+    int cols = 0; //<- image width
+    int rows = 0; //<- image height
+    bool found = false; //<- the image had an Events channel, possibly without events
+    std::vector<float> events; //<- (x, y, t, polarity) of each event, see render::EventCamera
+};
@@ -0,0 +1,18 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+/**
+ * @brief Image positions of the keypoints of the last camera image of a client, see
+ * RenderingInterface::cameraKeypoints()
+ */
+struct CameraKeypoints {
+    int cols = 0; //<- image width
+    int rows = 0; //<- image height
+    bool projected = false; //<- the image had keypoints
+    std::vector<float> keypoints; //<- (x, y, depth, visible) of each, see render::projectKeypoints
+};
@@ -0,0 +1,17 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Motion of the last camera image of a client, see RenderingInterface::cameraMotion()
+ */
+struct CameraMotion {
+    int cols = 0; //<- image width
+    int rows = 0; //<- image height
+    std::vector<uint16_t> motion; //<- half floats x, y of each pixel, empty if none was rendered
+};
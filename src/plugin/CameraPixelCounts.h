@@ -0,0 +1,19 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+/**
+ * @brief Pixels of each segmentation id seen in the last camera image of a client, see
+ * RenderingInterface::cameraPixelCounts()
+ */
+struct CameraPixelCounts {
+    int cols = 0; //<- image width
+    int rows = 0; //<- image height
+    bool counted = false; //<- the image had a Visibility channel, possibly seeing nothing
+    std::vector<int> counts; //<- (id, pixels) of each id seen, by increasing id
+    std::vector<int> boxes; //<- (x0, y0, x1, y1) of each id seen, empty if not requested
+};
@@ -0,0 +1,19 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <vector>
+
+/**
+ * @brief Points of the last camera image of a client, see RenderingInterface::cameraPoints()
+ */
+struct CameraPoints {
+    int cols = 0; //<- image width
+    int rows = 0; //<- image height
+    int count = 0; //<- number of points, cols * rows unless compact, 0 if none were rendered
+    bool compact = false; //<- points of the pixels where something was drawn only
+    std::vector<float> points; //<- XYZ of each point
+    std::vector<int> ids; //<- segmentation id of each point of compact points
+};
@@ -0,0 +1,295 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "FrameRecorder.h"
+
+#include <utils/lz4.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+/// order of the arrays, created with the first frame
+enum ArrayIndex {
+    kColor,
+    kDepth,
+    kMask,
+    kViewMatrix,
+    kProjMatrix,
+    kPoseBegin,
+    kNodeId,
+    kPose,
+};
+
+constexpr size_t kPoseChunkRows = 4096;
+
+/// create a directory, return false if it neither exists nor can be created
+bool makeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+/// write a whole file
+void writeFile(const std::string& path, const void* data, size_t size)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(static_cast<const char*>(data), std::streamsize(size));
+    if (!file)
+        throw std::runtime_error("FrameRecorder: cannot write " + path);
+}
+
+/// JSON list of sizes
+std::string jsonShape(size_t rows, const std::vector<size_t>& itemShape)
+{
+    std::string json = "[" + std::to_string(rows);
+    for (size_t size : itemShape)
+        json += ", " + std::to_string(size);
+    return json + "]";
+}
+
+} // namespace
+
+std::shared_ptr<FrameRecorder> FrameRecorder::create(const Options& options)
+{
+    if (options.directory.empty())
+        throw std::invalid_argument("FrameRecorder: no directory");
+    if (options.chunkFrames <= 0 || options.queueSize == 0)
+        throw std::invalid_argument("FrameRecorder: chunks and queue must not be empty");
+    if (!makeDirectory(options.directory))
+        throw std::runtime_error("FrameRecorder: cannot create " + options.directory);
+
+    const std::string group = "{\n    \"zarr_format\": 2\n}\n";
+    writeFile(options.directory + "/.zgroup", group.data(), group.size());
+    return std::shared_ptr<FrameRecorder>(new FrameRecorder(options));
+}
+
+FrameRecorder::FrameRecorder(const Options& options)
+    : _options(options), _cols(0), _rows(0), _dropped(0), _closing(false)
+{
+    _writer = std::thread(&FrameRecorder::writeRecords, this);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closing = true;
+    }
+    _cond.notify_all();
+    _writer.join();
+}
+
+uint64_t FrameRecorder::dropped() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _dropped;
+}
+
+bool FrameRecorder::push(const render::FrameData& frame,
+                         const std::shared_ptr<scene::Camera>& camera,
+                         const scene::SceneState& sceneState)
+{
+    // one producer: the queue cannot fill up between the check and the append
+    Record record;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_options.blocking)
+            _cond.wait(lock, [this] { return _queue.size() < _options.queueSize; });
+        if (_cols == 0) {
+            _cols = frame.cols;
+            _rows = frame.rows;
+        }
+        if (frame.cols != _cols || frame.rows != _rows || _queue.size() >= _options.queueSize) {
+            ++_dropped;
+            return false;
+        }
+        if (!_free.empty()) {
+            record = std::move(_free.back());
+            _free.pop_back();
+        }
+    }
+
+    const size_t numPixels = size_t(frame.cols) * size_t(frame.rows);
+    record.cols = frame.cols;
+    record.rows = frame.rows;
+    if (frame.color)
+        record.color.assign(frame.color, frame.color + numPixels * 4);
+    else
+        record.color.assign(numPixels * 4, 0);
+    if (frame.depth)
+        record.depth.assign(frame.depth, frame.depth + numPixels);
+    else
+        record.depth.assign(numPixels, 0.f);
+    if (frame.mask)
+        record.mask.assign(frame.mask, frame.mask + numPixels);
+    else
+        record.mask.assign(numPixels, -1);
+    record.view = camera ? camera->viewMatrix() : Matrix4f{};
+    record.proj = camera ? camera->projMatrix() : Matrix4f{};
+    record.nodeIds = sceneState.ids();
+    record.poses = sceneState.matrices();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(std::move(record));
+    }
+    _cond.notify_all();
+    return true;
+}
+
+void FrameRecorder::writeRecords()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _cond.wait(lock, [this] { return _closing || !_queue.empty(); });
+        if (_queue.empty())
+            break;
+        Record record = std::move(_queue.front());
+        _queue.pop_front();
+        lock.unlock();
+
+        // a failed write drops the rest of the dataset instead of the process
+        try {
+            appendRecord(record);
+        }
+        catch (const std::exception&) {
+            _arrays.clear();
+        }
+
+        lock.lock();
+        if (_free.size() < _options.queueSize)
+            _free.push_back(std::move(record));
+        _cond.notify_all();
+    }
+    lock.unlock();
+
+    for (auto& array : _arrays) {
+        try {
+            if (array.numRows > array.numChunks * array.chunkRows)
+                writeChunk(array);
+            writeMetadata(array);
+        }
+        catch (const std::exception&) {
+        }
+    }
+}
+
+void FrameRecorder::appendRecord(const Record& record)
+{
+    if (_arrays.empty()) {
+        const size_t chunk = size_t(_options.chunkFrames);
+        const size_t rows = size_t(record.rows), cols = size_t(record.cols);
+        addArray("color", "|u1", {rows, cols, 4}, chunk, 0);
+        addArray("depth", "<f4", {rows, cols}, chunk, 0);
+        addArray("mask", "<i4", {rows, cols}, chunk, -1);
+        addArray("view_matrix", "<f4", {16}, chunk, 0);
+        addArray("projection_matrix", "<f4", {16}, chunk, 0);
+        addArray("pose_begin", "<i8", {}, chunk, 0);
+        addArray("node_id", "<i4", {}, kPoseChunkRows, 0);
+        addArray("pose", "<f4", {16}, kPoseChunkRows, 0);
+    }
+
+    const int64_t poseBegin = int64_t(_arrays[kPose].numRows);
+    appendRows(kColor, record.color.data(), 1);
+    appendRows(kDepth, record.depth.data(), 1);
+    appendRows(kMask, record.mask.data(), 1);
+    appendRows(kViewMatrix, record.view.data(), 1);
+    appendRows(kProjMatrix, record.proj.data(), 1);
+    appendRows(kPoseBegin, &poseBegin, 1);
+    appendRows(kNodeId, record.nodeIds.data(), record.nodeIds.size());
+    appendRows(kPose, record.poses.data(), record.poses.size());
+}
+
+void FrameRecorder::addArray(const std::string& name, const std::string& dtype,
+                             const std::vector<size_t>& itemShape, size_t chunkRows,
+                             int fillValue)
+{
+    size_t itemSize = size_t(dtype[2] - '0');
+    for (size_t size : itemShape)
+        itemSize *= size;
+
+    if (!makeDirectory(_options.directory + "/" + name))
+        throw std::runtime_error("FrameRecorder: cannot create array " + name);
+    _arrays.push_back(Array{name, dtype, itemShape, itemSize, chunkRows, fillValue, {}, 0, 0});
+    _arrays.back().chunk.reserve(itemSize * chunkRows);
+    writeMetadata(_arrays.back());
+}
+
+void FrameRecorder::appendRows(size_t index, const void* rows, size_t count)
+{
+    auto& array = _arrays[index];
+    const auto* bytes = static_cast<const uint8_t*>(rows);
+    while (count > 0) {
+        const size_t chunkRows = array.chunk.size() / array.itemSize;
+        const size_t copied = std::min(count, array.chunkRows - chunkRows);
+        array.chunk.insert(array.chunk.end(), bytes, bytes + copied * array.itemSize);
+        array.numRows += copied;
+        bytes += copied * array.itemSize;
+        count -= copied;
+        if (array.chunk.size() == array.chunkRows * array.itemSize) {
+            writeChunk(array);
+            writeMetadata(array);
+        }
+    }
+}
+
+void FrameRecorder::writeChunk(Array& array)
+{
+    // edge chunks are stored at the full chunk shape
+    array.chunk.resize(array.chunkRows * array.itemSize, 0);
+
+    std::string key = std::to_string(array.numChunks);
+    for (size_t i = 0; i < array.itemShape.size(); ++i)
+        key += ".0";
+    const std::string path = _options.directory + "/" + array.name + "/" + key;
+
+    if (_options.compress) {
+        // numcodecs LZ4: little-endian uncompressed size, then the block
+        const uint32_t size = uint32_t(array.chunk.size());
+        std::vector<uint8_t> compressed(4);
+        std::memcpy(compressed.data(), &size, 4);
+        lz4Compress(array.chunk.data(), array.chunk.size(), compressed);
+        writeFile(path, compressed.data(), compressed.size());
+    }
+    else {
+        writeFile(path, array.chunk.data(), array.chunk.size());
+    }
+    array.chunk.clear();
+    ++array.numChunks;
+}
+
+void FrameRecorder::writeMetadata(const Array& array) const
+{
+    // rows of partial chunks are only part of the shape once written
+    const size_t rows = std::min(array.numRows, array.numChunks * array.chunkRows);
+    std::ostringstream json;
+    json << "{\n"
+         << "    \"chunks\": " << jsonShape(array.chunkRows, array.itemShape) << ",\n"
+         << "    \"compressor\": "
+         << (_options.compress ? "{\"id\": \"lz4\", \"acceleration\": 1}" : "null") << ",\n"
+         << "    \"dtype\": \"" << array.dtype << "\",\n"
+         << "    \"fill_value\": " << array.fillValue << ",\n"
+         << "    \"filters\": null,\n"
+         << "    \"order\": \"C\",\n"
+         << "    \"shape\": " << jsonShape(rows, array.itemShape) << ",\n"
+         << "    \"zarr_format\": 2\n"
+         << "}\n";
+    const std::string text = json.str();
+    writeFile(_options.directory + "/" + array.name + "/.zarray", text.data(), text.size());
+}
@@ -0,0 +1,143 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <render/BaseRenderer.h>
+#include <scene/Camera.h>
+#include <scene/SceneState.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Dataset of rendered frames, written as a zarr v2 group by a background thread
+ *
+ * The group directory holds the arrays, all indexed by frame along their first axis except the
+ * poses of scene nodes, concatenated over frames:
+ *  - color (N, H, W, 4) uint8, depth (N, H, W) float32 and mask (N, H, W) int32, -1 where the
+ *    frame had no mask,
+ *  - view_matrix (N, 16) and projection_matrix (N, 16) float32, column-major as in pybullet,
+ *  - pose_begin (N,) int64, index of the first pose of each frame,
+ *  - node_id (P,) int32 and pose (P, 16) float32, column-major world matrices of the nodes.
+ *
+ * Chunks are LZ4 compressed in the numcodecs format, or raw C-order bytes which can be memory
+ * mapped. push() only copies the frame into a bounded queue: frames pushed while it is full,
+ * unless blocking, or of another size than the first one, are dropped and counted. Array
+ * shapes are updated as chunks are written, the last partial chunks on destruction.
+ */
+class FrameRecorder
+{
+  public:
+    /**
+     * @brief Recording settings
+     */
+    struct Options {
+        std::string directory; //<- group directory, created if missing, its parent must exist
+        int chunkFrames = 64; //<- frames per chunk
+        bool compress = true; //<- LZ4 chunks, raw ones otherwise
+        size_t queueSize = 16; //<- frames waiting for the writer before drops
+        bool blocking = false; //<- push() waits for room in the queue instead of dropping
+    };
+
+    /**
+     * @brief Create a dataset, existing arrays of the directory are overwritten
+     *
+     * @param options - recording settings
+     * @throw std::invalid_argument - if the directory is missing or chunks are empty
+     * @throw std::runtime_error - if the directory cannot be created
+     */
+    static std::shared_ptr<FrameRecorder> create(const Options& options);
+
+    /// write the queued frames and the last chunks
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    /// recording settings
+    const Options& options() const { return _options; }
+
+    /// number of frames dropped
+    uint64_t dropped() const;
+
+    /**
+     * @brief Queue a frame for writing
+     *
+     * @param frame - rendered images, missing planes are written as zeros and masks as -1
+     * @param camera - camera of the frame, null for zero matrices
+     * @param sceneState - node poses of the frame
+     * @return False if the frame was dropped
+     */
+    bool push(const render::FrameData& frame, const std::shared_ptr<scene::Camera>& camera,
+              const scene::SceneState& sceneState);
+
+  private:
+    /// copy of a pushed frame
+    struct Record {
+        int cols;
+        int rows;
+        std::vector<uint8_t> color;
+        std::vector<float> depth;
+        std::vector<int> mask;
+        Matrix4f view;
+        Matrix4f proj;
+        std::vector<int> nodeIds;
+        std::vector<Matrix4f> poses;
+    };
+
+    /// array growing along its first axis, written chunk by chunk
+    struct Array {
+        std::string name;
+        std::string dtype; //<- numpy type string
+        std::vector<size_t> itemShape; //<- shape of one row
+        size_t itemSize; //<- bytes of one row
+        size_t chunkRows;
+        int fillValue;
+        std::vector<uint8_t> chunk; //<- rows of the current chunk
+        size_t numChunks; //<- chunks written
+        size_t numRows;
+    };
+
+    explicit FrameRecorder(const Options& options);
+
+    /// write queued frames until closed
+    void writeRecords();
+
+    /// append the rows of a record to the arrays
+    void appendRecord(const Record& record);
+
+    /// start an array
+    void addArray(const std::string& name, const std::string& dtype,
+                  const std::vector<size_t>& itemShape, size_t chunkRows, int fillValue);
+
+    /// append \p count rows to array \p index
+    void appendRows(size_t index, const void* rows, size_t count);
+
+    /// write the current chunk of an array, padded to the chunk size
+    void writeChunk(Array& array);
+
+    /// write the metadata of an array
+    void writeMetadata(const Array& array) const;
+
+    Options _options;
+    std::vector<Array> _arrays; //<- used by the writer thread only
+    int _cols; //<- frame size, 0 until the first frame
+    int _rows;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<Record> _queue;
+    std::vector<Record> _free; //<- written records, reused by push()
+    uint64_t _dropped;
+    bool _closing;
+    std::thread _writer;
+};
@@ -0,0 +1,289 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "FrameRing.h"
+
+#include <scene/SceneView.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "FrameRing requires lock-free 64-bit atomics");
+
+namespace {
+
+constexpr uint32_t kMagic = 0x52465250; //<- "PRFR"
+constexpr uint32_t kVersion = 1;
+constexpr size_t kAlignment = 64;
+
+/**
+ * @brief Ring layout, written by the creator before the magic number
+ */
+struct RingHeader {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    int32_t cols;
+    int32_t rows;
+    int32_t numSlots;
+    std::atomic<uint64_t> latest; //<- sequence of the last published frame
+};
+
+/**
+ * @brief Slot header, all slot headers being followed by the slot planes
+ */
+struct RingSlot {
+    std::atomic<uint64_t> sequence; //<- 0 while written
+    std::atomic<int32_t> channels;
+};
+
+static_assert(sizeof(RingHeader) <= kAlignment && sizeof(RingSlot) <= kAlignment,
+              "FrameRing: headers must fit in a cache line");
+
+/// bytes of one plane, all planes having 4 bytes per pixel
+size_t planeSize(int cols, int rows)
+{
+    return (size_t(cols) * size_t(rows) * 4 + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+/// total bytes of a ring
+size_t ringSize(int cols, int rows, int numSlots)
+{
+    return kAlignment + size_t(numSlots) * (kAlignment + 3 * planeSize(cols, rows));
+}
+
+RingHeader& header(void* memory)
+{
+    return *static_cast<RingHeader*>(memory);
+}
+
+RingSlot& slotHeader(void* memory, int slot)
+{
+    return *reinterpret_cast<RingSlot*>(static_cast<uint8_t*>(memory) + kAlignment * (slot + 1));
+}
+
+std::string sharedName(const std::string& name)
+{
+#ifdef _WIN32
+    return name;
+#else
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+#endif
+}
+
+} // namespace
+
+std::shared_ptr<FrameRing> FrameRing::create(const std::string& name, int cols, int rows,
+                                             int numSlots)
+{
+    if (cols <= 0 || rows <= 0 || numSlots <= 0)
+        throw std::invalid_argument("FrameRing: frame size and number of slots must be positive");
+
+    const std::string path = sharedName(name);
+    const size_t size = ringSize(cols, rows, numSlots);
+    void* memory = nullptr;
+    void* handle = nullptr;
+    uint64_t inode = 0;
+#ifdef _WIN32
+    handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                DWORD(uint64_t(size) >> 32), DWORD(size), path.c_str());
+    // named mappings live while a process holds them, an existing one cannot be replaced
+    if (handle && GetLastError() != ERROR_ALREADY_EXISTS)
+        memory = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!memory) {
+        if (handle)
+            CloseHandle(handle);
+        throw std::runtime_error("FrameRing: cannot create shared memory " + path);
+    }
+#else
+    shm_unlink(path.c_str());
+    const int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        throw std::runtime_error("FrameRing: cannot create shared memory " + path);
+    struct stat info;
+    if (ftruncate(fd, off_t(size)) == 0 && fstat(fd, &info) == 0) {
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        inode = uint64_t(info.st_ino);
+    }
+    close(fd);
+    if (!memory || memory == MAP_FAILED) {
+        shm_unlink(path.c_str());
+        throw std::runtime_error("FrameRing: cannot map shared memory " + path);
+    }
+#endif
+
+    // new mappings are zero-filled: no frame published, all slots empty
+    auto& ringHeader = header(memory);
+    ringHeader.version = kVersion;
+    ringHeader.cols = cols;
+    ringHeader.rows = rows;
+    ringHeader.numSlots = numSlots;
+    ringHeader.magic.store(kMagic, std::memory_order_release);
+    return std::shared_ptr<FrameRing>(new FrameRing(path, memory, size, true, handle, inode));
+}
+
+std::shared_ptr<FrameRing> FrameRing::open(const std::string& name)
+{
+    const std::string path = sharedName(name);
+    void* memory = nullptr;
+    void* handle = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    handle = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+    if (handle)
+        memory = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (memory && VirtualQuery(memory, &info, sizeof(info)))
+        size = info.RegionSize;
+    if (!memory) {
+        if (handle)
+            CloseHandle(handle);
+        throw std::runtime_error("FrameRing: no shared memory " + path);
+    }
+#else
+    const int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw std::runtime_error("FrameRing: no shared memory " + path);
+    struct stat info;
+    if (fstat(fd, &info) == 0 && size_t(info.st_size) >= kAlignment) {
+        size = size_t(info.st_size);
+        memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (!memory || memory == MAP_FAILED)
+        throw std::runtime_error("FrameRing: cannot map shared memory " + path);
+#endif
+
+    std::shared_ptr<FrameRing> ring(new FrameRing(path, memory, size, false, handle, 0));
+    const auto& ringHeader = header(memory);
+    if (ringHeader.magic.load(std::memory_order_acquire) != kMagic ||
+        ringHeader.version != kVersion ||
+        size < ringSize(ringHeader.cols, ringHeader.rows, ringHeader.numSlots))
+        throw std::runtime_error("FrameRing: " + path + " is not a frame ring");
+    return ring;
+}
+
+FrameRing::FrameRing(const std::string& name, void* memory, size_t size, bool owner,
+                     void* handle, uint64_t inode)
+    : _name(name), _memory(memory), _size(size), _owner(owner), _handle(handle), _inode(inode)
+{
+}
+
+FrameRing::~FrameRing()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(_memory);
+    CloseHandle(_handle);
+#else
+    munmap(_memory, _size);
+    if (!_owner)
+        return;
+    // the name may have been taken over by a newer ring
+    const int fd = shm_open(_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return;
+    struct stat info;
+    const bool same = fstat(fd, &info) == 0 && uint64_t(info.st_ino) == _inode;
+    close(fd);
+    if (same)
+        shm_unlink(_name.c_str());
+#endif
+}
+
+int FrameRing::cols() const
+{
+    return header(_memory).cols;
+}
+
+int FrameRing::rows() const
+{
+    return header(_memory).rows;
+}
+
+int FrameRing::numSlots() const
+{
+    return header(_memory).numSlots;
+}
+
+uint64_t FrameRing::latest() const
+{
+    return header(_memory).latest.load(std::memory_order_acquire);
+}
+
+uint64_t FrameRing::slotSequence(int slot) const
+{
+    return slotHeader(_memory, slot).sequence.load(std::memory_order_acquire);
+}
+
+int FrameRing::slotChannels(int slot) const
+{
+    return slotHeader(_memory, slot).channels.load(std::memory_order_acquire);
+}
+
+uint8_t* FrameRing::plane(int slot, int index) const
+{
+    const size_t size = planeSize(cols(), rows());
+    const size_t planes = kAlignment * (numSlots() + 1);
+    return static_cast<uint8_t*>(_memory) + planes + (size_t(slot) * 3 + index) * size;
+}
+
+const uint8_t* FrameRing::color(int slot) const
+{
+    return plane(slot, 0);
+}
+
+const float* FrameRing::depth(int slot) const
+{
+    return reinterpret_cast<const float*>(plane(slot, 1));
+}
+
+const int* FrameRing::mask(int slot) const
+{
+    return reinterpret_cast<const int*>(plane(slot, 2));
+}
+
+uint64_t FrameRing::publish(const render::FrameData& frame)
+{
+    if (frame.cols != cols() || frame.rows != rows())
+        return 0;
+
+    auto& ringHeader = header(_memory);
+    const uint64_t sequence = ringHeader.latest.load(std::memory_order_relaxed) + 1;
+    const int slot = slotOf(sequence);
+    auto& target = slotHeader(_memory, slot);
+
+    // seqlock: readers seeing the slot sequence unchanged across a read got consistent planes
+    target.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const size_t numPixels = size_t(frame.cols) * size_t(frame.rows);
+    int channels = 0;
+    if (frame.color) {
+        std::memcpy(plane(slot, 0), frame.color, numPixels * 4);
+        channels |= int(scene::OutputChannel::Color);
+    }
+    if (frame.depth) {
+        std::memcpy(plane(slot, 1), frame.depth, numPixels * sizeof(float));
+        channels |= int(scene::OutputChannel::Depth);
+    }
+    if (frame.mask) {
+        std::memcpy(plane(slot, 2), frame.mask, numPixels * sizeof(int));
+        channels |= int(scene::OutputChannel::Mask);
+    }
+
+    target.channels.store(channels, std::memory_order_relaxed);
+    target.sequence.store(sequence, std::memory_order_release);
+    ringHeader.latest.store(sequence, std::memory_order_release);
+    return sequence;
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <render/BaseRenderer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Ring of rendered frames in named shared memory, for out-of-process consumers
+ *
+ * One writer process publishes frames of a fixed size into numSlots() slots, each frame tagged
+ * with an increasing sequence number from 1. Readers in other processes map the same memory
+ * and read the planes in place, without locks: a slot holds the frame of sequence s while
+ * slotSequence() returns s, and is being overwritten while it returns 0. A reader checks the
+ * sequence again after reading a frame, a changed value means the writer lapped it.
+ *
+ * The writer removes the name on destruction, unless a newer ring took it, and readers keep a
+ * valid mapping until they close.
+ */
+class FrameRing
+{
+  public:
+    /**
+     * @brief Create a ring, replacing a previous one of the same name except on Windows
+     *
+     * @param name - shared memory name, a leading '/' is added if missing
+     * @param cols - frame width
+     * @param rows - frame height
+     * @param numSlots - number of frames kept
+     * @throw std::runtime_error - if the shared memory cannot be created
+     */
+    static std::shared_ptr<FrameRing> create(const std::string& name, int cols, int rows,
+                                             int numSlots);
+
+    /**
+     * @brief Open a ring created by another process, or this one
+     *
+     * @param name - shared memory name, a leading '/' is added if missing
+     * @throw std::runtime_error - if there is no such ring
+     */
+    static std::shared_ptr<FrameRing> open(const std::string& name);
+
+    /// unmap the memory, removing the name of a ring created by this object
+    ~FrameRing();
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    /// shared memory name
+    const std::string& name() const { return _name; }
+
+    /// frame width
+    int cols() const;
+
+    /// frame height
+    int rows() const;
+
+    /// number of slots
+    int numSlots() const;
+
+    /// bytes of the mapped memory, header and all slots
+    size_t bytes() const { return _size; }
+
+    /// sequence of the last published frame, 0 if none
+    uint64_t latest() const;
+
+    /// sequence of the frame held by a slot, 0 if empty or being written
+    uint64_t slotSequence(int slot) const;
+
+    /// output channels of the frame held by a slot, a combination of scene::OutputChannel
+    int slotChannels(int slot) const;
+
+    /// slot holding the frame of a sequence, if not overwritten yet
+    int slotOf(uint64_t sequence) const { return int((sequence - 1) % uint64_t(numSlots())); }
+
+    /// RGBA color plane of a slot
+    const uint8_t* color(int slot) const;
+
+    /// metric depth plane of a slot
+    const float* depth(int slot) const;
+
+    /// segmentation mask plane of a slot
+    const int* mask(int slot) const;
+
+    /**
+     * @brief Publish a frame, in the slot of the oldest one
+     *
+     * Planes missing from \p frame are flagged as such in the slot. Only one thread of one
+     * process may publish into a ring.
+     *
+     * @param frame - rendered images
+     * @return Sequence of the published frame, 0 if \p frame is not of the ring size
+     */
+    uint64_t publish(const render::FrameData& frame);
+
+  private:
+    FrameRing(const std::string& name, void* memory, size_t size, bool owner, void* handle,
+              uint64_t inode);
+
+    /// plane \p index of a slot, 0 for colors, 1 for depth and 2 for masks
+    uint8_t* plane(int slot, int index) const;
+
+    std::string _name;
+    void* _memory; //<- mapped header, slots and planes
+    size_t _size;
+    bool _owner; //<- created by this object
+    void* _handle; //<- file mapping handle on Windows
+    uint64_t _inode; //<- shared memory object on other systems
+};
@@ -0,0 +1,34 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Visual shape of a body loaded before the plugin, as getVisualShapeData lists it
+ */
+struct ImportedShape {
+    int geometryType; //<- pybullet GEOM_* type
+    std::array<double, 3> dimensions; //<- box size, radius, length and radius, mesh scale
+    std::string filename; //<- mesh file, empty for primitives
+    std::array<double, 7> frame; //<- position and xyzw quaternion in the link inertial frame
+    std::array<double, 4> rgba;
+};
+
+/**
+ * @brief Link of a body loaded before the plugin
+ *
+ * Bullet only reports the poses of such links under ids the plugin never saw, so that a link is
+ * attached to the first unseen id synced at its pose, see RenderingInterface::importLinks().
+ */
+struct ImportedLink {
+    int body;
+    int link; //<- -1 for the base
+    std::array<double, 7> frame; //<- world position and xyzw quaternion of the inertial frame
+    bool fixedBase; //<- base without mass
+    std::vector<ImportedShape> shapes; //<- none for links without visual shapes
+};
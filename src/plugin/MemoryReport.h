@@ -0,0 +1,36 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <render/BaseRenderer.h>
+#include <scene/MemoryUsage.h>
+
+#include <cstddef>
+#include <map>
+
+/**
+ * @brief Memory of a client, see RenderingInterface::memoryReport()
+ */
+struct MemoryReport {
+    scene::AssetMemory assets; //<- of the scene graph, those shared with other clients included
+    std::map<int, scene::NodeMemory> nodes; //<- by node id
+    render::RendererMemory renderer;
+    size_t frameBytes = 0; //<- frame cache, encoded frame and frame sink ring
+    size_t totalBytes = 0; //<- assets, renderer and frames
+    size_t peakBytes = 0; //<- highest total bytes, sampled after each rendered camera image
+};
+
+/**
+ * @brief Memory of all clients of the process, shared assets counted once
+ */
+struct ProcessMemoryReport {
+    scene::AssetMemory assets; //<- scene graphs of all clients and the asset cache
+    size_t cachedBytes = 0; //<- assets held by the asset cache only
+    render::RendererMemory renderers; //<- sum of the renderers of the clients
+    size_t frameBytes = 0;
+    size_t totalBytes = 0;
+    size_t peakBytes = 0; //<- sum of the high-water marks of the clients
+    int clients = 0;
+};
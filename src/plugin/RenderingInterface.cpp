@@ -4,17 +4,143 @@
 
 #include "RenderingInterface.h"
 #include "utils.h"
+#include <render/AssetArchive.h>
+#include <render/AssetLoader.h>
+#include <render/AsyncRenderer.h>
+#include <render/FrameCodec.h>
+#include <render/DepthLevels.h>
+#include <render/MotionVectors.h>
+#include <render/Keypoints.h>
+#include <render/PixelCounts.h>
+#include <render/PointCloud.h>
+#include <render/SensorNoise.h>
+#include <render/Trace.h>
 #include <scene/Shape.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <tuple>
+#include <sys/stat.h>
+
 #include <CommonInterfaces/CommonFileIOInterface.h>
-#include <Importers/ImportURDFDemo/UrdfParser.h>
+#include <CommonInterfaces/CommonRenderInterface.h>
 #include <SharedMemory/SharedMemoryPublic.h>
 #include <TinyRenderer/tgaimage.h>
 
+namespace {
+
+const size_t kLinksPerThread = 16; //<- pending links per conversion thread, at least
+const int kLayerFlagsShift = 8; //<- instance flags of the visibility layers, above pybullet's
+
+/// region of interest within an image of cols x rows, of zero size if none or out of it
+Vector4i clipRoi(const Vector4i& roi, int cols, int rows)
+{
+    const int x0 = std::max(roi[0], 0), y0 = std::max(roi[1], 0);
+    const int x1 = std::min(roi[0] + roi[2], cols), y1 = std::min(roi[1] + roi[3], rows);
+    if (roi[2] <= 0 || roi[3] <= 0 || x1 <= x0 || y1 <= y0)
+        return {0, 0, 0, 0};
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+/// read an asset file through the file I/O of the physics server, e.g. from a zip archive of the
+/// file I/O plugin, unless it is on disk or already served from memory
+void importAssetFile(const std::string& filename, CommonFileIOInterface* fileIO)
+{
+    struct stat info;
+    if (!fileIO || filename.empty() || render::assetFileInMemory(filename) ||
+        stat(filename.c_str(), &info) == 0)
+        return;
+    const int handle = fileIO->fileOpen(filename.c_str(), "rb");
+    if (handle < 0)
+        return;
+    std::vector<char> bytes(size_t(std::max(fileIO->getFileSize(handle), 0)));
+    const int read = bytes.empty() ? 0 : fileIO->fileRead(handle, bytes.data(), int(bytes.size()));
+    fileIO->fileClose(handle);
+    if (read == int(bytes.size()))
+        render::registerAssetFile(filename, std::move(bytes));
+}
+
+/// material of the i-th collision shape of a link without visual shapes, cycling a palette
+UrdfMaterial collisionUrdfMaterial(int i)
+{
+    static const btVector4 diffuseColor[] = {
+        {0.2, 0.7, 0.3, 1.0}, {0.9, 0.7, 0.1, 1.0}, {0.8, 0.2, 0.2, 1.0}, {0.3, 0.5, 0.9, 1.0}};
+    UrdfMaterial urdfMaterial;
+    urdfMaterial.m_matColor.m_rgbaColor = diffuseColor[i % 4];
+    urdfMaterial.m_matColor.m_specularColor = {1.0, 1.0, 1.0};
+    return urdfMaterial;
+}
+
+/// scene material of collisionUrdfMaterial(), one object per color shared by all collision
+/// shapes of the process, so that converting them allocates no material; thread-safe
+const std::shared_ptr<scene::Material>& collisionMaterial(int i)
+{
+    static const std::shared_ptr<scene::Material> palette[] = {
+        std::make_shared<scene::Material>(makeMaterial(collisionUrdfMaterial(0))),
+        std::make_shared<scene::Material>(makeMaterial(collisionUrdfMaterial(1))),
+        std::make_shared<scene::Material>(makeMaterial(collisionUrdfMaterial(2))),
+        std::make_shared<scene::Material>(makeMaterial(collisionUrdfMaterial(3)))};
+    return palette[i % 4];
+}
+
+/// \p frame without its mask plane, e.g. scratch for the pixel counts, as published
+render::FrameData withoutMask(const render::FrameData& frame)
+{
+    return render::FrameData{frame.cols,
+                             frame.rows,
+                             frame.color,
+                             frame.depth,
+                             nullptr,
+                             frame.points,
+                             frame.pointIds,
+                             frame.packedColor,
+                             frame.packedDepth,
+                             frame.packedMask,
+                             frame.motion,
+                             frame.normals,
+                             frame.depthPyramid,
+                             frame.events,
+                             frame.pixelCounts,
+                             frame.boxes,
+                             frame.keypoints,
+                             frame.numPoints,
+                             frame.packed,
+                             frame.motionDrawn,
+                             frame.normalsDrawn,
+                             frame.depthPyramidDrawn,
+                             frame.numEvents,
+                             frame.numPixelCounts};
+}
+
+} // namespace
+
 RenderingInterface::RenderingInterface()
-    : _sceneGraph{std::make_shared<scene::SceneGraph>()},
+    : _asyncMode{false}, _numaNode{-1}, _warmReset{false}, _deferredConversion{false},
+      _stagedLoading{false}, _stagedWait{false}, _uploadBudget{0.}, //
+      _sceneGraph{std::make_shared<scene::SceneGraph>()}, //
       _sceneState{std::make_shared<scene::SceneState>()}, //
-      _sceneView{std::make_shared<scene::SceneView>()}
+      _sceneView{std::make_shared<scene::SceneView>()}, _selectedCamera{-1}, //
+      _bulkTransfer{false}, _randomIndex{0}, _randomGeneration{0}, _frameCached{false},
+      _frameCols{0}, _frameRows{0}, _roi{0, 0, 0, 0}, _pointOutput{false}, _frameNumPoints{-1},
+      _motionOutput{false}, _normalOutput{false}, _depthPyramidLevels{0},
+      _eventOutput{false}, _eventStepDuration{1. / 240.}, _frameNumEvents{-1},
+      _visibilityOutput{false}, _frameNumPixelCounts{-1}, _boxOutput{false},
+      _maskOnly{false}, _frameMaskOnly{false}, _cameraLayers{scene::VisibilityLayers::kAll},
+      _keypointGeneration{0},
+      _frameSequence{0}, _noiseFrame{0}, _frameCacheEnabled{false},
+      _frameGraphGeneration{0}, _frameStateGeneration{0}, _frameCacheHits{0}, _frameCacheMisses{0},
+      _stageStats{std::make_shared<render::StageStats>()}, _memoryGeneration{~uint64_t(0)},
+      _assetBytes{0}, _memoryPeak{0}, _clientId{-1}, _stepStart{0},
+      _syncBurstStart{0}, _syncBurstEnd{0}, _syncBurstCount{0}, _encodeCols{0}, _encodeRows{0},
+      _encodedPending{false}, _stepSync{false}, _syncStep{0}, _schedule{Schedule::Undecided},
+      _framePeriod{0.},
+      _interpolatePoses{false}, _stepCount{0}, _nextFrameStep{0.}, _frameStep{0.},
+      _syncedStep{-1.}, _poseBlend{1.f}, _staticSyncs{0}, _staticFixedBases{false},
+      _importSynced{false}
 {
     resetAll();
 }
@@ -23,21 +149,680 @@ RenderingInterface::~RenderingInterface() {}
 
 void RenderingInterface::setRenderer(const std::shared_ptr<render::BaseRenderer>& renderer)
 {
-    _renderer = renderer;
+    std::lock_guard<std::mutex> lock(_mutex);
+    setRendererLocked(renderer);
+}
+
+void RenderingInterface::setRendererLocked(const std::shared_ptr<render::BaseRenderer>& renderer)
+{
+    if (_asyncMode && !!renderer) {
+        auto asyncRenderer = std::make_shared<render::AsyncRenderer>(renderer);
+        asyncRenderer->setNumaNode(_numaNode);
+        _renderer = asyncRenderer;
+    }
+    else
+        _renderer = renderer;
     _syncSceneGraph = true;
-    _syncMaterials = true;
+    _frameCached = false;
+}
+
+void RenderingInterface::setAsyncMode(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto asyncRenderer = std::dynamic_pointer_cast<render::AsyncRenderer>(_renderer);
+    _asyncMode = enabled;
+    setRendererLocked(!!asyncRenderer ? asyncRenderer->renderer() : _renderer);
+}
+
+void RenderingInterface::setNumaNode(int node)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _numaNode = std::max(node, -1);
+    if (auto asyncRenderer = std::dynamic_pointer_cast<render::AsyncRenderer>(_renderer))
+        asyncRenderer->setNumaNode(_numaNode);
+}
+
+void RenderingInterface::setFrameCache(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _frameCacheEnabled = enabled;
+    _frameCacheHits = 0;
+    _frameCacheMisses = 0;
+}
+
+int RenderingInterface::registerCamera(const float projMat[16],
+                                       const scene::LensDistortion& distortion)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    scene::Camera camera;
+    camera.setProjMatrix(*reinterpret_cast<const Matrix4f*>(projMat));
+    camera.setDistortion(distortion);
+    camera.setHandle(int(_registeredCameras.size()));
+    _registeredCameras.push_back(camera);
+    return camera.handle();
+}
+
+bool RenderingInterface::selectCamera(int handle)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (handle >= int(_registeredCameras.size()))
+        return false;
+    _selectedCamera = std::max(handle, -1);
+    return true;
+}
+
+void RenderingInterface::setProjection(scene::Projection projection)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sceneView->setProjection(projection);
+}
+
+void RenderingInterface::setMultiview(const std::vector<Matrix4f>& poses)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _multiviewPoses = poses;
+}
+
+void RenderingInterface::setRoi(const Vector4i& roi)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _roi = roi;
+}
+
+void RenderingInterface::setQuality(const scene::Quality& quality)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sceneView->setQuality(quality);
+}
+
+void RenderingInterface::setLights(const std::vector<scene::Light>& lights, int first, int total)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto all = _sceneView->lights();
+    all.resize(size_t(total));
+    for (size_t i = 0; i < lights.size() && first + i < all.size(); ++i)
+        all[first + i] = lights[i];
+    _sceneView->setLights(all);
+}
+
+void RenderingInterface::setSensorNoise(const scene::SensorNoise& noise)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sceneView->setSensorNoise(noise);
+}
+
+void RenderingInterface::setRenderScale(float scale)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sceneView->setRenderScale(scale);
+}
+
+void RenderingInterface::setPointOutput(bool enabled, scene::PointFrame frame, bool compact)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pointOutput = enabled;
+    _sceneView->setPointFrame(frame);
+    _sceneView->setCompactPoints(compact);
+}
+
+CameraPoints RenderingInterface::cameraPoints() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    CameraPoints result;
+    if (!_frameCached || _frameNumPoints < 0)
+        return result;
+    result.cols = _frameCols;
+    result.rows = _frameRows;
+    result.count = _frameNumPoints;
+    result.compact = _frameView.compactPoints();
+    result.points.assign(_framePoints.begin(), _framePoints.begin() + size_t(_frameNumPoints) * 3);
+    if (result.compact)
+        result.ids.assign(_framePointIds.begin(), _framePointIds.begin() + _frameNumPoints);
+    return result;
+}
+
+void RenderingInterface::setMotionOutput(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _motionOutput = enabled;
+    _motionCamera.reset();
+    _motionState.reset();
+}
+
+CameraMotion RenderingInterface::cameraMotion() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    CameraMotion result;
+    if (!_frameCached || _frameMotion.empty())
+        return result;
+    result.cols = _frameCols;
+    result.rows = _frameRows;
+    result.motion = _frameMotion;
+    return result;
+}
+
+void RenderingInterface::setNormalOutput(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _normalOutput = enabled;
+}
+
+CameraNormals RenderingInterface::cameraNormals() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    CameraNormals result;
+    if (!_frameCached || _frameNormals.empty())
+        return result;
+    result.cols = _frameCols;
+    result.rows = _frameRows;
+    result.normals = _frameNormals;
+    return result;
+}
+
+void RenderingInterface::setDepthPyramidOutput(int levels)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _depthPyramidLevels = std::max(levels, 0);
+    if (_depthPyramidLevels)
+        _sceneView->setDepthPyramidLevels(_depthPyramidLevels);
+}
+
+CameraDepthPyramid RenderingInterface::cameraDepthPyramid() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    CameraDepthPyramid result;
+    if (!_frameCached || _frameDepthPyramid.empty())
+        return result;
+    result.cols = _frameCols;
+    result.rows = _frameRows;
+    result.levels = _sceneView->depthPyramidLevels();
+    result.depths = _frameDepthPyramid;
+    return result;
+}
+
+void RenderingInterface::setEventOutput(bool enabled, float threshold, double stepDuration)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (enabled != _eventOutput)
+        _eventCamera.reset();
+    _eventOutput = enabled;
+    _eventStepDuration = std::max(stepDuration, 0.);
+    _sceneView->setEventThreshold(threshold);
+}
+
+CameraEvents RenderingInterface::cameraEvents() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    CameraEvents result;
+    if (!_frameCached || _frameNumEvents < 0)
+        return result;
+    result.cols = _frameCols;
+    result.rows = _frameRows;
+    result.found = true;
+    result.events.assign(_frameEvents.begin(), _frameEvents.begin() + size_t(_frameNumEvents) * 4);
+    return result;
+}
+
+void RenderingInterface::setVisibilityOutput(bool enabled, bool boxes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _visibilityOutput = enabled;
+    _boxOutput = enabled && boxes;
+}
+
+CameraPixelCounts RenderingInterface::cameraPixelCounts() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    CameraPixelCounts result;
+    if (!_frameCached || _frameNumPixelCounts < 0)
+        return result;
+    result.cols = _frameCols;
+    result.rows = _frameRows;
+    result.counted = true;
+    result.counts.assign(_framePixelCounts.begin(),
+                         _framePixelCounts.begin() + size_t(_frameNumPixelCounts) * 2);
+    if (!_frameBoxes.empty())
+        result.boxes.assign(_frameBoxes.begin(),
+                            _frameBoxes.begin() + size_t(_frameNumPixelCounts) * 4);
+    return result;
+}
+
+int RenderingInterface::setKeypoints(int first, const std::vector<Keypoint>& keypoints)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _keypoints.resize(std::min(size_t(std::max(first, 0)), _keypoints.size()));
+    _keypoints.insert(_keypoints.end(), keypoints.begin(), keypoints.end());
+    _viewKeypoints.reset();
+    return int(_keypoints.size());
+}
+
+CameraKeypoints RenderingInterface::cameraKeypoints() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    CameraKeypoints result;
+    if (!_frameCached || _frameKeypoints.empty())
+        return result;
+    result.cols = _frameCols;
+    result.rows = _frameRows;
+    result.projected = true;
+    result.keypoints = _frameKeypoints;
+    return result;
+}
+
+void RenderingInterface::setOutputChannels(int channels)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pointOutput = channels & int(scene::OutputChannel::Points);
+    const bool motion = channels & int(scene::OutputChannel::Motion);
+    if (motion != _motionOutput) {
+        _motionOutput = motion;
+        _motionCamera.reset();
+        _motionState.reset();
+    }
+    _normalOutput = channels & int(scene::OutputChannel::Normals);
+    _depthPyramidLevels = channels & int(scene::OutputChannel::DepthPyramid)
+                              ? _sceneView->depthPyramidLevels()
+                              : 0;
+    const bool events = channels & int(scene::OutputChannel::Events);
+    if (events != _eventOutput)
+        _eventCamera.reset();
+    _eventOutput = events;
+    _boxOutput = channels & int(scene::OutputChannel::Boxes);
+    _visibilityOutput = _boxOutput || (channels & int(scene::OutputChannel::Visibility));
+    _maskOnly = channels & int(scene::OutputChannel::Mask);
+}
+
+int RenderingInterface::outputChannels() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    int channels = 0;
+    if (_pointOutput)
+        channels |= int(scene::OutputChannel::Points);
+    if (_motionOutput)
+        channels |= int(scene::OutputChannel::Motion);
+    if (_normalOutput)
+        channels |= int(scene::OutputChannel::Normals);
+    if (_depthPyramidLevels)
+        channels |= int(scene::OutputChannel::DepthPyramid);
+    if (_eventOutput)
+        channels |= int(scene::OutputChannel::Events);
+    if (_visibilityOutput)
+        channels |= int(scene::OutputChannel::Visibility);
+    if (_boxOutput)
+        channels |= int(scene::OutputChannel::Boxes);
+    if (_maskOnly)
+        channels |= int(scene::OutputChannel::Mask);
+    return channels;
+}
+
+bool RenderingInterface::asyncMode() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _asyncMode;
+}
+
+int RenderingInterface::numaNode() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numaNode;
+}
+
+bool RenderingInterface::frameCache() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _frameCacheEnabled;
+}
+
+bool RenderingInterface::stepSync() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stepSync;
+}
+
+scene::Quality RenderingInterface::quality() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _sceneView->quality();
+}
+
+void RenderingInterface::setStepSync(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stepSync = enabled;
+}
+
+void RenderingInterface::setStaticClassification(int unchangedSyncs, bool fixedBases)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    applySyncedPoses();
+    _staticSyncs = std::max(unchangedSyncs, 0);
+    _staticFixedBases = fixedBases;
+    if (!fixedBases)
+        _fixedBases.clear();
+    // counted again from now on
+    for (auto& it : _syncedTransforms) {
+        it.second.unchangedSyncs = 0;
+        if (!fixedBases)
+            it.second.fixedBase = false;
+    }
+    for (int nodeId : _sceneState->ids())
+        _sceneState->setStatic(nodeId, false);
+}
+
+uint64_t RenderingInterface::frameCacheHits() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _frameCacheHits;
+}
+
+uint64_t RenderingInterface::frameCacheMisses() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _frameCacheMisses;
+}
+
+MemoryReport RenderingInterface::memoryReport(bool withNodes) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    MemoryReport report;
+    scene::MemoryAccounting accounting;
+    accounting.add(*_sceneGraph);
+    report.assets = accounting.assets();
+    if (withNodes)
+        report.nodes = scene::MemoryAccounting::nodes(*_sceneGraph);
+    if (_renderer)
+        report.renderer = _renderer->memoryUsage();
+    report.frameBytes = frameBytes();
+    report.totalBytes = report.assets.total() + report.renderer.gpuBytes +
+                        report.renderer.hostBytes + report.frameBytes;
+    report.peakBytes = std::max(_memoryPeak, report.totalBytes);
+    return report;
+}
+
+void RenderingInterface::accountAssets(scene::MemoryAccounting& accounting) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    accounting.add(*_sceneGraph);
+}
+
+size_t RenderingInterface::frameBytes() const
+{
+    return _frameColor.capacity() + _frameDepth.capacity() * sizeof(float) +
+           (_frameMask.capacity() + _scratchMask.capacity()) * sizeof(int) +
+           _framePoints.capacity() * sizeof(float) + _framePointIds.capacity() * sizeof(int) +
+           _frameMotion.capacity() * sizeof(uint16_t) + _frameNormals.capacity() * sizeof(uint16_t) +
+           _frameDepthPyramid.capacity() * sizeof(float) +
+           _frameEvents.capacity() * sizeof(float) +
+           (_framePixelCounts.capacity() + _frameBoxes.capacity()) * sizeof(int) +
+           _frameKeypoints.capacity() * sizeof(float) + _encoded.capacity() +
+           (_frameSink ? _frameSink->bytes() : 0);
+}
+
+void RenderingInterface::updateMemoryPeak()
+{
+    // assets are accounted again only once the scene changed
+    if (_memoryGeneration != _sceneGraph->generation()) {
+        scene::MemoryAccounting accounting;
+        accounting.add(*_sceneGraph);
+        _assetBytes = accounting.assets().total();
+        _memoryGeneration = _sceneGraph->generation();
+    }
+    const auto renderer = _renderer ? _renderer->memoryUsage() : render::RendererMemory();
+    _memoryPeak = std::max(_memoryPeak, _assetBytes + renderer.gpuBytes + renderer.hostBytes +
+                                            frameBytes());
+}
+
+std::shared_ptr<const void>
+    RenderingInterface::setCameraBatch(const std::vector<std::shared_ptr<scene::Camera>>& cameras,
+                                       const std::vector<render::FrameData>& frames,
+                                       std::shared_ptr<const void> owner)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _batchCameras = cameras;
+    _batchFrames.clear();
+    _batchFrames.reserve(frames.size());
+    for (const auto& frame : frames)
+        _batchFrames.push_back(frame);
+    std::swap(_batchOwner, owner);
+    return owner;
+}
+
+bool RenderingInterface::renderCamera(const Matrix4f& viewMatrix, const Matrix4f& projMatrix,
+                                      const render::FrameData& frame)
+{
+    flushSyncBurst();
+    render::TraceFrame trace("camera_image", _clientId, true);
+    std::lock_guard<std::mutex> lock(_mutex);
+    render::StageStats::Scope stats(_stageStats);
+    // the async renderer is a request behind, as it refuses caller buffers for batches
+    if (!_renderer || _asyncMode)
+        return false;
+
+    // the camera of a request, registered intrinsics included, on a view of its own
+    render(viewMatrix.data(), projMatrix.data());
+    syncScene();
+    auto view = std::make_shared<scene::SceneView>(*_sceneView);
+    view->setMultiviewCameras({});
+    view->setRoi({0, 0, 0, 0});
+    view->setViewport({frame.cols, frame.rows});
+    view->setKeypoints(nullptr);
+    view->setPreviousCamera(nullptr);
+    view->setPreviousState(nullptr);
+    view->setOutputChannels((frame.color ? int(scene::OutputChannel::Color) : 0) |
+                            (frame.depth ? int(scene::OutputChannel::Depth) : 0) |
+                            (frame.mask ? int(scene::OutputChannel::Mask) : 0));
+
+    render::FrameData output = frame;
+    const bool rendered = _renderer->renderFrame(_sceneState, view, output);
+    if (rendered)
+        render::applySensorNoise(*view, output, _noiseFrame++);
+    // the cached frame was drawn before the dirty nodes synced here
+    _sceneState->clearDirty();
+    _frameCached = false;
+    if (rendered)
+        recordFrame(-1, output);
+    updateMemoryPeak();
+    return rendered;
+}
+
+void RenderingInterface::requestEncodedFrame(int cols, int rows)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _encodeCols = std::max(cols, 0);
+    _encodeRows = std::max(rows, 0);
+    _encodedPending = false;
+}
+
+void RenderingInterface::setFrameSink(const std::shared_ptr<FrameRing>& sink)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _frameSink = sink;
+    _bulkTransfer = false;
+    _frameSequence = 0;
+}
+
+void RenderingInterface::setVideoSink(int camera, const std::shared_ptr<VideoSink>& sink)
+{
+    // a stopped sink finishes its queue and output outside the lock
+    std::shared_ptr<VideoSink> previous;
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& entry = _videoSinks[camera];
+    previous = std::move(entry);
+    entry = sink;
+    if (!sink)
+        _videoSinks.erase(camera);
+}
+
+void RenderingInterface::setRecorder(const std::shared_ptr<FrameRecorder>& recorder)
+{
+    // a stopped recorder writes its queue and last chunks outside the lock
+    std::shared_ptr<FrameRecorder> previous;
+    std::lock_guard<std::mutex> lock(_mutex);
+    previous = std::move(_recorder);
+    _recorder = recorder;
+}
+
+void RenderingInterface::setRandomization(
+    const std::shared_ptr<scene::Randomization>& randomization, const std::string& logPath)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _randomization = randomization;
+    _randomAtlas.clear();
+    if (randomization)
+        for (int textureId : randomization->textures)
+            _randomAtlas.push_back(textureId >= 0 && textureId < int(_textures.size())
+                                       ? _textures[textureId]
+                                       : nullptr);
+    if (_randomLog.is_open())
+        _randomLog.close();
+    if (randomization && !logPath.empty())
+        _randomLog.open(logPath, std::ios::app);
+    _randomIndex = 0;
+    _randomMaterials.reset();
+}
+
+uint64_t RenderingInterface::nextRandomizationEpisode()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _randomMaterials.reset();
+    return ++_randomIndex;
+}
+
+void RenderingInterface::setBulkTransfer(const std::shared_ptr<FrameRing>& ring)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _frameSink = ring;
+    _bulkTransfer = !!ring;
+    _frameSequence = 0;
+}
+
+void RenderingInterface::setRenderSchedule(double framePeriod, bool interpolate)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _framePeriod = std::max(framePeriod, 0.);
+    _interpolatePoses = interpolate;
+    _stepCount = 0;
+    _nextFrameStep = 0.;
+    _frameStep = 0.;
+    _syncedStep = -1.;
+}
+
+double RenderingInterface::frameStep() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _frameStep;
+}
+
+void RenderingInterface::setDeferredConversion(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _deferredConversion = enabled;
+    if (!enabled)
+        convertPendingLinks();
+}
+
+void RenderingInterface::setWarmReset(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _warmReset = enabled;
+}
+
+void RenderingInterface::setStagedLoading(bool enabled, double uploadBudget, bool wait)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stagedLoading = enabled;
+    _uploadBudget = std::max(uploadBudget, 0.);
+    _stagedWait = wait;
+}
+
+int RenderingInterface::stagedNodes() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return int(_stagedNodes.size());
+}
+
+void RenderingInterface::importLinks(std::vector<ImportedLink> links)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _importedLinks = std::move(links);
+    _importSynced = false;
+    // objects synced before are unseen again
+    for (auto it = _syncedTransforms.begin(); it != _syncedTransforms.end();)
+        it = _sceneGraph->nodes().count(it->first) ? std::next(it) : _syncedTransforms.erase(it);
+}
+
+void RenderingInterface::saveSnapshot(int stateId)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    applySyncedPoses();
+    _snapshots[stateId] = {_sceneState->snapshot(), _randomMaterials, _randomIndex,
+                           _randomGeneration};
+}
+
+bool RenderingInterface::restoreSnapshot(int stateId)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto it = _snapshots.find(stateId);
+    if (it == _snapshots.end())
+        return false;
+    // poses synced before the restore are older
+    applySyncedPoses();
+    const auto& snapshot = it->second;
+    _sceneState->restore(*snapshot.poses);
+    _randomMaterials = snapshot.randomMaterials;
+    _randomIndex = snapshot.randomIndex;
+    _randomGeneration = snapshot.randomGeneration;
+    return true;
+}
+
+void RenderingInterface::removeSnapshot(int stateId)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _snapshots.erase(stateId);
 }
 
 void RenderingInterface::resetAll()
 {
+    std::lock_guard<std::mutex> lock(_mutex);
     _flags = 0;
-    _syncSceneGraph = true;
-    _syncMaterials = true;
-    _sceneGraph->clear();
-    _sceneState->clear();
+    _snapshots.clear();
+    if (_warmReset) {
+        // the bodies of the next episode are compared with these ones, see appendNode()
+        for (const auto& it : _sceneGraph->nodes())
+            _retiredNodes.insert(it.first);
+    }
+    else {
+        _syncSceneGraph = true;
+        _sceneGraph->clear();
+        _sceneState->clear();
+        _retiredNodes.clear();
+        _layerNodes.clear();
+    }
+    _syncedTransforms.clear();
+    _pendingIds.clear();
+    _pendingFrames.clear();
+    _pendingScales.clear();
+    _pendingFirst.clear();
+    _schedule = Schedule::Undecided;
+    _syncedStep = -1.;
+    _poseBlend = 1.f;
+    _blendedPoses.clear();
+    _fixedBases.clear();
+    _pendingStatic.clear();
+    _importedLinks.clear();
+    _importSynced = false;
+    _pendingLinks.clear();
+    _stagedNodes.clear();
     _visualShapes.clear();
-    _objectIndices.clear();
+    _segmentationIds.clear();
+    _visibilityLayers.clear();
+    _keypoints.clear();
+    _viewKeypoints.reset();
     _textures.clear();
+    _textureIds.clear();
+    _frameCached = false;
+    _motionCamera.reset();
+    _motionState.reset();
 }
 
 int RenderingInterface::convertVisualShapes(int linkIndex, const char* pathPrefix,
@@ -49,58 +834,159 @@ int RenderingInterface::convertVisualShapes(int linkIndex, const char* pathPrefi
     const int numVisual = linkPtr->m_visualArray.size();
     const int numCollision = numVisual ? 0 : linkPtr->m_collisionArray.size();
 
-    std::vector<scene::Shape> sceneShapes;
-    sceneShapes.reserve(numVisual + numCollision);
+    const auto visualMaterial = [urdfModel](const UrdfVisual& urdfShape) -> const UrdfMaterial& {
+        const auto key = btHashString(urdfShape.m_materialName.c_str());
+        return urdfModel->m_materials[key] ? **urdfModel->m_materials[key]
+                                           : urdfShape.m_geometry.m_localMaterial;
+    };
+
+    // the link is copied out of the model, which does not outlive the import
+    PendingLink link;
+    link.nodeId = collisionObjectUid;
+    link.bodyUniqueId = bodyUniqueId;
+    link.linkIndex = linkIndex;
+    link.localInertiaFrame = localInertiaFrame;
+    link.sourceFile = urdfModel->m_sourceFile;
+    link.flags = _flags;
+    // bases of bodies without mass or loaded with useFixedBase do not move unless reset
+    link.fixedBase = _staticFixedBases && linkIndex == -1 &&
+                     (urdfModel->m_overrideFixedBase || linkPtr->m_inertia.m_mass == 0.);
+    link.collision = numCollision > 0;
+    link.shapes.reserve(numVisual + numCollision);
+    link.materials.reserve(numVisual + numCollision);
 
     // Process visual shapes
     for (int i = 0; i < numVisual; ++i) {
         const auto& urdfShape = linkPtr->m_visualArray[i];
-
-        const auto key = btHashString(urdfShape.m_materialName.c_str());
-        const auto& urdfMaterial = urdfModel->m_materials[key]
-                                       ? **urdfModel->m_materials[key]
-                                       : urdfShape.m_geometry.m_localMaterial;
+        const auto& urdfMaterial = visualMaterial(urdfShape);
 
         // append a bullet-specific shape description
-        _visualShapes[bodyUniqueId].emplace_back(makeVisualShapeData(
-            urdfShape, urdfMaterial, localInertiaFrame, bodyUniqueId, linkIndex));
+        _visualShapes.add(bodyUniqueId, linkIndex,
+                          makeVisualShapeData(urdfShape, urdfMaterial, localInertiaFrame,
+                                              bodyUniqueId, linkIndex));
 
-        // append a new shape to render
-        const auto& shape = makeShape(urdfShape, urdfMaterial, localInertiaFrame, _flags);
-        if (shape.valid())
-            sceneShapes.push_back(shape);
+        link.shapes.push_back(urdfShape);
+        link.materials.push_back(urdfMaterial);
     }
 
+    // files the server resolved through its file I/O are loaded from memory
+    for (const auto& shape : link.shapes)
+        if (shape.m_geometry.m_type == URDF_GEOM_MESH &&
+            shape.m_geometry.m_meshFileType != UrdfGeometry::MEMORY_VERTICES)
+            importAssetFile(shape.m_geometry.m_meshFileName, fileIO);
+    for (const auto& material : link.materials)
+        importAssetFile(material.m_textureFilename, fileIO);
+    // texture files decode on the loader workers while the link is converted, not when drawn
+    if (render::texturePrefetch())
+        for (const auto& material : link.materials)
+            if (!material.m_textureFilename.empty())
+                render::prefetchTexture(
+                    AssetCache::instance().fileTexture(material.m_textureFilename));
+
     // Process collision shapes only if an object has no one visual shape
     for (int i = 0; i < numCollision; ++i) {
-        const auto& urdfShape = linkPtr->m_collisionArray[i];
+        link.shapes.push_back(linkPtr->m_collisionArray[i]);
+        link.materials.push_back(collisionUrdfMaterial(i));
+    }
 
-        static btVector4 diffuseColor[] = {
-            {0.2, 0.7, 0.3, 1.0}, {0.9, 0.7, 0.1, 1.0}, {0.8, 0.2, 0.2, 1.0}, {0.3, 0.5, 0.9, 1.0}};
+    // converted before the next use of the scene, all links queued meanwhile in parallel
+    if (link.shapes.empty())
+        return -1;
+    if (_deferredConversion) {
+        _pendingLinks.push_back(std::move(link));
+        return collisionObjectUid;
+    }
 
-        UrdfMaterial urdfMaterial;
-        urdfMaterial.m_matColor.m_rgbaColor = diffuseColor[i % 4];
-        urdfMaterial.m_matColor.m_specularColor = {1.0, 1.0, 1.0};
+    auto sceneShapes = convertLink(link);
+    return appendLink(link, std::move(sceneShapes)) ? collisionObjectUid : -1;
+}
 
-        // append a new shape to render
-        const auto& shape = makeShape(urdfShape, urdfMaterial, localInertiaFrame, _flags);
+std::vector<scene::Shape> RenderingInterface::convertLink(const PendingLink& link)
+{
+    std::vector<scene::Shape> sceneShapes;
+    const int numShapes = int(link.shapes.size());
+
+    // links of a model loaded again reuse the shapes converted the first time
+    uint64_t linkHash = 0;
+    if (!link.sourceFile.empty()) {
+        btScalar frame[16];
+        link.localInertiaFrame.getOpenGLMatrix(frame);
+        linkHash = hashBytes(frame, sizeof(frame));
+        for (int i = 0; i < numShapes && linkHash; ++i)
+            linkHash = hashShape(link.shapes[i], link.materials[i], linkHash);
+    }
+    const auto linkKey = AssetCache::LinkKey{link.sourceFile, link.linkIndex, link.flags, linkHash};
+    if (linkHash && AssetCache::instance().linkShapes(linkKey, sceneShapes))
+        return sceneShapes;
+
+    // materials are interned by appendLink(), the scene graph is not thread-safe; collision
+    // shapes share the palette materials, their primitives the tessellations and instance
+    // groups of all equal primitives, see scene::primitiveMesh()
+    sceneShapes.reserve(numShapes);
+    for (int i = 0; i < numShapes; ++i) {
+        const auto& shape =
+            link.collision
+                ? makeShape(link.shapes[i], collisionMaterial(i), link.localInertiaFrame,
+                            link.flags)
+                : makeShape(link.shapes[i], link.materials[i], link.localInertiaFrame, link.flags);
         if (shape.valid())
             sceneShapes.push_back(shape);
     }
+    if (linkHash)
+        AssetCache::instance().storeLinkShapes(linkKey, sceneShapes);
+    return sceneShapes;
+}
 
-    // if there is something to render adding an object to a scene
-    if (!sceneShapes.empty()) {
-        const auto nodeId = collisionObjectUid;
-        const bool noCache = !(_flags & URDF_ENABLE_CACHED_GRAPHICS_SHAPES);
-        _sceneGraph->appendNode(nodeId, {bodyUniqueId, linkIndex, std::move(sceneShapes), noCache});
-        _sceneState->appendNode(nodeId);
-        _syncSceneGraph = true;
+bool RenderingInterface::appendLink(const PendingLink& link,
+                                    std::vector<scene::Shape>&& sceneShapes)
+{
+    // converted shapes share the equal materials of the scene
+    for (auto& shape : sceneShapes)
+        shape.setMaterial(_sceneGraph->internMaterial(shape.material()));
 
-        _objectIndices.emplace(std::make_pair(bodyUniqueId, linkIndex), collisionObjectUid);
-        return collisionObjectUid;
-    }
+    // meshes and textures load on workers while the rest of the model is converted
+    if (render::assetPrefetch())
+        for (const auto& shape : sceneShapes)
+            render::prefetchAssets(shape);
 
-    return -1;
+    // if there is something to render adding an object to a scene
+    if (sceneShapes.empty())
+        return false;
+    const bool noCache = !(link.flags & URDF_ENABLE_CACHED_GRAPHICS_SHAPES);
+    appendNode(link.nodeId,
+               {link.bodyUniqueId, link.linkIndex, std::move(sceneShapes), noCache});
+    if (link.fixedBase)
+        _fixedBases.insert(link.nodeId);
+    _visualShapes.setNode(link.bodyUniqueId, link.linkIndex, link.nodeId);
+    return true;
+}
+
+void RenderingInterface::convertPendingLinks()
+{
+    if (_pendingLinks.empty())
+        return;
+    render::TraceScope trace("convert_links", _clientId);
+
+    // links are independent, each worker takes the next one; nodes are then appended in the
+    // order bullet converted the links, whatever the worker that converted them
+    std::vector<std::vector<scene::Shape>> converted(_pendingLinks.size());
+    std::atomic<size_t> next{0};
+    const auto work = [&] {
+        for (size_t i = next++; i < _pendingLinks.size(); i = next++)
+            converted[i] = convertLink(_pendingLinks[i]);
+    };
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const size_t numThreads = std::min(cores, _pendingLinks.size() / kLinksPerThread);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; ++i)
+        threads.emplace_back(work);
+    work();
+    for (auto& thread : threads)
+        thread.join();
+
+    for (size_t i = 0; i < _pendingLinks.size(); ++i)
+        appendLink(_pendingLinks[i], std::move(converted[i]));
+    _pendingLinks.clear();
 }
 
 int RenderingInterface::registerShapeAndInstance(const struct b3VisualShapeData& visualShape,
@@ -110,31 +996,95 @@ int RenderingInterface::registerShapeAndInstance(const struct b3VisualShapeData&
                                                  int orgGraphicsUniqueId, int bodyUniqueId,
                                                  int linkIndex)
 {
-    /// @todo: registerShapeAndInstance not implemented
-    return -1;
+    if (!numvertices || !numIndices || primitiveType != B3_GL_TRIANGLES)
+        return -1;
+    convertPendingLinks(); //<- nodes keep the order of the calls
+
+    // bullet ties the graphics instance to the collision object
+    const int nodeId = orgGraphicsUniqueId;
+    if (nodeId < 0 || _stagedNodes.count(nodeId) ||
+        (_sceneGraph->nodes().count(nodeId) && !_retiredNodes.count(nodeId)))
+        return nodeId;
+
+    // identical registrations share one mesh, making them instances of each other
+    const auto mesh = AssetCache::instance().memoryMesh(
+        getMeshData(vertices, numvertices, indices, numIndices));
+
+    const auto& rgba = visualShape.m_rgbaColor;
+    const auto material = _sceneGraph->internMaterial(scene::Material(
+        Color4f{float(rgba[0]), float(rgba[1]), float(rgba[2]), float(rgba[3])},
+        Color3f{1.f, 1.f, 1.f},
+        textureId >= 0 && textureId < int(_textures.size()) ? _textures[textureId] : nullptr));
+
+    // vertices are given in the instance frame
+    std::vector<scene::Shape> sceneShapes;
+    sceneShapes.emplace_back(scene::ShapeType::Mesh, Affine3f::Identity(), mesh, material);
+
+    _visualShapes.add(bodyUniqueId, linkIndex, visualShape);
+    appendNode(nodeId, {bodyUniqueId, linkIndex, std::move(sceneShapes)});
+    _visualShapes.setNode(bodyUniqueId, linkIndex, nodeId);
+    return nodeId;
 }
 
 void RenderingInterface::updateShape(int shapeUniqueId, const btVector3* vertices, int numVertices,
                                      const btVector3* normals, int numNormals)
 {
-    /// @todo: updateShape not implemented
+    convertPendingLinks();
+    admitStagedNode(shapeUniqueId);
+    auto it = _sceneGraph->nodes().find(shapeUniqueId);
+    if (it == _sceneGraph->nodes().end())
+        return;
+
+    // deformable bodies and heightfields carry a single mesh or heightfield shape
+    const auto& shapes = it->second.shapes();
+    for (int i = 0; i < int(shapes.size()); ++i) {
+        if (shapes[i].heightfield()) {
+            // the triangle soup repeats grid points, only changed heights touch their tiles
+            auto& heightfield = _sceneGraph->changeShapeHeightfield(shapeUniqueId, i);
+            int column, row;
+            for (int j = 0; j < numVertices; ++j)
+                if (heightfield.gridPoint(float(vertices[j].x()), float(vertices[j].y()),
+                                          column, row))
+                    heightfield.setHeight(column, row, float(vertices[j].z()));
+            break;
+        }
+        if (!shapes[i].mesh() || !shapes[i].mesh()->data())
+            continue;
+        // vertices not matching those of the mesh have no indices nor uvs, they are skipped
+        if (int(shapes[i].mesh()->data()->numVertices()) != numVertices)
+            break;
+
+        auto& data = _sceneGraph->changeShapeGeometry(shapeUniqueId, i, numVertices);
+        auto& dstVertices = data.mutableVertices();
+        for (int j = 0; j < numVertices; ++j) {
+            dstVertices[j * 3 + 0] = float(vertices[j].x());
+            dstVertices[j * 3 + 1] = float(vertices[j].y());
+            dstVertices[j * 3 + 2] = float(vertices[j].z());
+        }
+        data.updateBounds();
+        if (numNormals == numVertices) {
+            auto& dstNormals = data.mutableNormals();
+            dstNormals.resize(numNormals * 3); //<- meshes loaded without normals get them
+            for (int j = 0; j < numNormals; ++j) {
+                dstNormals[j * 3 + 0] = float(normals[j].x());
+                dstNormals[j * 3 + 1] = float(normals[j].y());
+                dstNormals[j * 3 + 2] = float(normals[j].z());
+            }
+        }
+        break;
+    }
 }
 
 int RenderingInterface::getNumVisualShapes(int bodyUniqueId)
 {
-    auto ptr = _visualShapes.find(bodyUniqueId);
-    if (ptr != _visualShapes.end()) {
-        return static_cast<int>(ptr->second.size());
-    }
-    return 0;
+    return _visualShapes.bodyShapes(bodyUniqueId);
 }
 
 int RenderingInterface::getVisualShapesData(int bodyUniqueId, int shapeIndex,
                                             struct b3VisualShapeData* shapeData)
 {
-    auto ptr = _visualShapes.find(bodyUniqueId);
-    if (ptr != _visualShapes.end() && ptr->second.size() > shapeIndex) {
-        *shapeData = ptr->second.at(shapeIndex);
+    if (const auto* visualShape = _visualShapes.bodyShape(bodyUniqueId, shapeIndex)) {
+        *shapeData = *visualShape;
         return 1;
     }
     return 0;
@@ -143,69 +1093,218 @@ int RenderingInterface::getVisualShapesData(int bodyUniqueId, int shapeIndex,
 void RenderingInterface::changeRGBAColor(int bodyUniqueId, int linkIndex, int shapeIndex,
                                          const double rgba[4])
 {
-    const int collisionObjectUid = _objectIndices.at({bodyUniqueId, linkIndex});
+    convertPendingLinks();
+    const int collisionObjectUid = _visualShapes.node(bodyUniqueId, linkIndex);
+    // nodes drawn by the base layer do not change
+    if (collisionObjectUid < 0 || _layerNodes.count(collisionObjectUid))
+        return;
+    admitStagedNode(collisionObjectUid);
+
+    const auto& slots = _visualShapes.linkSlots(bodyUniqueId, linkIndex);
+    for (int i = 0; i < int(slots.size()); ++i) {
+        if (shapeIndex != i && shapeIndex != -1)
+            continue;
+
+        // update pybullet-specific descriptor
+        auto& visualShape = _visualShapes.shape(slots[i]);
+        for (int j = 0; j < 4; ++j)
+            visualShape.m_rgbaColor[j] = rgba[j];
+
+        // update scene graph
+        _sceneGraph->changeShapeColor(
+            collisionObjectUid, i,
+            {float(rgba[0]), float(rgba[1]), float(rgba[2]), float(rgba[3])});
+    }
+}
 
-    auto ptr = _visualShapes.find(bodyUniqueId);
-    if (ptr != _visualShapes.end()) {
-        int i = -1;
-        for (auto& visualShape : ptr->second) {
-            if (visualShape.m_linkIndex != linkIndex)
+int RenderingInterface::changeShapeMaterials(const std::vector<MaterialChange>& changes)
+{
+    convertPendingLinks();
+    // later changes of a shape override earlier ones, per shape ones override per link ones
+    std::map<std::tuple<int, int, int>, const MaterialChange*> shapeChanges;
+    for (const auto& change : changes)
+        shapeChanges[std::make_tuple(change.body, change.link, std::max(change.shape, -1))] =
+            &change;
+
+    // the per link change of a shape first, then its own
+    const auto changeShape = [&](int bodyUniqueId, int linkIndex, int nodeId, int i,
+                                 b3VisualShapeData& visualShape) {
+        bool shapeChanged = false;
+        for (int shapeIndex : {-1, i}) {
+            const auto jt = shapeChanges.find(std::make_tuple(bodyUniqueId, linkIndex, shapeIndex));
+            if (jt == shapeChanges.end())
                 continue;
 
-            if (shapeIndex != ++i && shapeIndex != -1)
-                continue;
+            const auto& change = *jt->second;
+            if (change.rgba[3] >= 0.) {
+                std::copy_n(change.rgba, 4, visualShape.m_rgbaColor);
+                _sceneGraph->changeShapeColor(nodeId, i,
+                                              {float(change.rgba[0]), float(change.rgba[1]),
+                                               float(change.rgba[2]), float(change.rgba[3])});
+                shapeChanged = true;
+            }
+            if (change.texture >= -1 && change.texture < int(_textures.size())) {
+                visualShape.m_textureUniqueId = change.texture;
+                _sceneGraph->changeShapeTexture(
+                    nodeId, i, change.texture < 0 ? nullptr : _textures[change.texture]);
+                shapeChanged = true;
+            }
+        }
+        return shapeChanged;
+    };
+
+    int changed = 0;
+    for (const auto& it : shapeChanges) {
+        const int bodyUniqueId = std::get<0>(it.first);
+        const int linkIndex = std::get<1>(it.first);
+        const int shapeIndex = std::get<2>(it.first);
+        // shapes of a link changed as a whole were all changed with its per link change
+        if (shapeIndex >= 0 &&
+            shapeChanges.count(std::make_tuple(bodyUniqueId, linkIndex, -1)))
+            continue;
+
+        const int nodeId = _visualShapes.node(bodyUniqueId, linkIndex);
+        if (nodeId < 0 || _layerNodes.count(nodeId))
+            continue;
+        admitStagedNode(nodeId);
+        const auto& slots = _visualShapes.linkSlots(bodyUniqueId, linkIndex);
+        const int numShapes = int(std::min(slots.size(),
+                                           _sceneGraph->nodes().at(nodeId).shapes().size()));
+        const int first = shapeIndex < 0 ? 0 : shapeIndex;
+        const int last = shapeIndex < 0 ? numShapes : std::min(shapeIndex + 1, numShapes);
+        for (int i = first; i < last; ++i)
+            changed += changeShape(bodyUniqueId, linkIndex, nodeId, i,
+                                   _visualShapes.shape(slots[i]));
+    }
+    return changed;
+}
 
-            // update pybullet-specific descriptor
-            for (int j = 0; j < 4; ++j)
-                visualShape.m_rgbaColor[j] = rgba[j];
+int RenderingInterface::changeSegmentationIds(const std::vector<SegmentationChange>& changes)
+{
+    convertPendingLinks();
+    int changed = 0;
+    for (const auto& change : changes) {
+        const int shapeIndex = std::max(change.shape, -1);
+        _segmentationIds[std::make_tuple(change.body, change.link, shapeIndex)] = {
+            change.instance, change.semantic};
+
+        const int nodeId = _visualShapes.node(change.body, change.link);
+        admitStagedNode(nodeId);
+        if (nodeId < 0 || _layerNodes.count(nodeId) ||
+            shapeIndex >= int(_sceneGraph->nodes().at(nodeId).shapes().size()))
+            continue;
+        _sceneGraph->changeSegmentationIds(nodeId, shapeIndex, change.instance, change.semantic);
+        ++changed;
+    }
+    return changed;
+}
 
-            // update scene graph
-            _sceneGraph->changeShapeColor(
-                collisionObjectUid, i,
-                {float(rgba[0]), float(rgba[1]), float(rgba[2]), float(rgba[3])});
-            _syncMaterials = true;
-        }
+int RenderingInterface::changeVisibilityLayers(const std::vector<LayerChange>& changes)
+{
+    convertPendingLinks();
+    int changed = 0;
+    for (const auto& change : changes) {
+        const int shapeIndex = std::max(change.shape, -1);
+        const uint32_t layers = change.layers & scene::VisibilityLayers::kAll;
+        const auto key = std::make_tuple(change.body, change.link, shapeIndex);
+        if (layers == scene::VisibilityLayers::kAll)
+            _visibilityLayers.erase(key);
+        else
+            _visibilityLayers[key] = layers;
+
+        // no node changes, renderers filter the shapes of the next images by layer
+        const int nodeId = _visualShapes.node(change.body, change.link);
+        if (nodeId < 0 || _layerNodes.count(nodeId))
+            continue;
+        _sceneGraph->setVisibilityLayers(nodeId, shapeIndex, layers);
+        ++changed;
     }
+    return changed;
 }
 
-void RenderingInterface::changeInstanceFlags(int bodyUniqueId, int linkIndex, int shapeIndex,
-                                             int flags)
+void RenderingInterface::setCameraLayers(uint32_t layers)
 {
-    /// @todo: changeInstanceFlags not implemented
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cameraLayers = layers & scene::VisibilityLayers::kAll;
 }
 
-void RenderingInterface::changeShapeTexture(int bodyUniqueId, int linkIndex, int shapeIndex,
-                                            int textureUniqueId)
+uint32_t RenderingInterface::cameraLayers() const
 {
-    const int collisionObjectUid = _objectIndices.at({bodyUniqueId, linkIndex});
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _cameraLayers;
+}
 
-    auto ptr = _visualShapes.find(bodyUniqueId);
-    if (ptr != _visualShapes.end()) {
-        int i = -1;
-        for (auto& visualShape : ptr->second) {
-            if (visualShape.m_linkIndex != linkIndex)
-                continue;
+void RenderingInterface::setSegmentationMode(scene::SegmentationMode mode)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sceneGraph->setSegmentationMode(mode);
+    _frameCached = false;
+}
 
-            if (shapeIndex != ++i && shapeIndex != -1)
-                continue;
+std::shared_ptr<scene::SceneLayer> RenderingInterface::makeBaseLayer(const std::set<int>& bodies)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    applySyncedPoses();
+    return std::make_shared<scene::SceneLayer>(_sceneGraph->nodes(), *_sceneState, bodies);
+}
 
-            // update pybullet-specific descriptor
-            visualShape.m_textureUniqueId = textureUniqueId;
+void RenderingInterface::setBaseLayer(const std::shared_ptr<const scene::SceneLayer>& layer,
+                                      const std::set<int>& bodies)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    // nodes out of the scene come back with the next image, see applyBaseLayer()
+    _baseLayer = layer;
+    _layerBodies = !layer ? std::set<int>() : bodies.empty() ? layer->bodies() : bodies;
+    // the same layer over other bodies is applied again from scratch
+    if (layer && layer == _sceneGraph->baseLayer())
+        _sceneGraph->setBaseLayer(nullptr);
+    _frameCached = false;
+}
 
-            // update scene graph
-            _sceneGraph->changeShapeTexture(collisionObjectUid, i,
-                                            textureUniqueId < 0 ? std::shared_ptr<scene::Texture>()
-                                                                : _textures.at(textureUniqueId));
-            _syncMaterials = true;
-        }
+void RenderingInterface::changeInstanceFlags(int bodyUniqueId, int linkIndex, int shapeIndex,
+                                             int flags)
+{
+    // visibility layers in the bits above the flags of pybullet, all layers if none is set
+    const uint32_t layers = uint32_t(flags) >> kLayerFlagsShift;
+    changeVisibilityLayers(
+        {{bodyUniqueId, linkIndex, shapeIndex, layers ? layers : scene::VisibilityLayers::kAll}});
+}
+
+void RenderingInterface::changeShapeTexture(int bodyUniqueId, int linkIndex, int shapeIndex,
+                                            int textureUniqueId)
+{
+    convertPendingLinks();
+    const int collisionObjectUid = _visualShapes.node(bodyUniqueId, linkIndex);
+    // nodes drawn by the base layer do not change
+    if (collisionObjectUid < 0 || _layerNodes.count(collisionObjectUid))
+        return;
+    admitStagedNode(collisionObjectUid);
+
+    const auto& slots = _visualShapes.linkSlots(bodyUniqueId, linkIndex);
+    for (int i = 0; i < int(slots.size()); ++i) {
+        if (shapeIndex != i && shapeIndex != -1)
+            continue;
+
+        // update pybullet-specific descriptor
+        _visualShapes.shape(slots[i]).m_textureUniqueId = textureUniqueId;
+
+        // update scene graph
+        _sceneGraph->changeShapeTexture(collisionObjectUid, i,
+                                        textureUniqueId < 0 ? std::shared_ptr<scene::Texture>()
+                                                            : _textures.at(textureUniqueId));
     }
 }
 
 void RenderingInterface::removeVisualShape(int collisionObjectUid)
 {
+    applySyncedPoses();
     _sceneGraph->removeNode(collisionObjectUid);
     _sceneState->removeNode(collisionObjectUid);
-    _syncSceneGraph = true;
+    _stagedNodes.erase(collisionObjectUid);
+    _layerNodes.erase(collisionObjectUid);
+    _syncedTransforms.erase(collisionObjectUid);
+    _fixedBases.erase(collisionObjectUid);
+    _retiredNodes.erase(collisionObjectUid);
 }
 
 void RenderingInterface::setUpAxis(int axis)
@@ -242,46 +1341,49 @@ void RenderingInterface::setWidthAndHeight(int width, int height)
     _sceneView->setViewport({width, height});
 }
 
+scene::Light& RenderingInterface::requestedLight()
+{
+    if (!_light) {
+        static const auto defaultLight = *makeDefaultLight();
+        _light = pooledObject(_lightPool);
+        *_light = defaultLight;
+    }
+    return *_light;
+}
+
 void RenderingInterface::setLightDirection(float x, float y, float z)
 {
-    _light = !_light ? makeDefaultLight() : _light;
-    _light->setDirection({x, y, z});
+    requestedLight().setDirection({x, y, z});
 }
 
 void RenderingInterface::setLightColor(float r, float g, float b)
 {
-    _light = !_light ? makeDefaultLight() : _light;
-    _light->setColor({r, g, b});
+    requestedLight().setColor({r, g, b});
 }
 
 void RenderingInterface::setLightDistance(float dist)
 {
-    _light = !_light ? makeDefaultLight() : _light;
-    _light->setDistance(dist);
+    requestedLight().setDistance(dist);
 }
 
 void RenderingInterface::setLightAmbientCoeff(float ambientCoeff)
 {
-    _light = !_light ? makeDefaultLight() : _light;
-    _light->setAmbientCoeff(ambientCoeff);
+    requestedLight().setAmbientCoeff(ambientCoeff);
 }
 
 void RenderingInterface::setLightDiffuseCoeff(float diffuseCoeff)
 {
-    _light = !_light ? makeDefaultLight() : _light;
-    _light->setDiffuseCoeff(diffuseCoeff);
+    requestedLight().setDiffuseCoeff(diffuseCoeff);
 }
 
 void RenderingInterface::setLightSpecularCoeff(float specularCoeff)
 {
-    _light = !_light ? makeDefaultLight() : _light;
-    _light->setSpecularCoeff(specularCoeff);
+    requestedLight().setSpecularCoeff(specularCoeff);
 }
 
 void RenderingInterface::setShadow(bool hasShadow)
 {
-    _light = !_light ? makeDefaultLight() : _light;
-    _light->shadowCaster(hasShadow);
+    requestedLight().shadowCaster(hasShadow);
 }
 
 void RenderingInterface::setFlags(int flags)
@@ -291,43 +1393,460 @@ void RenderingInterface::setFlags(int flags)
 
 int RenderingInterface::loadTextureFile(const char* filename, struct CommonFileIOInterface* fileIO)
 {
-    _textures.push_back(std::make_shared<scene::Texture>(filename));
-    return int(_textures.size()) - 1;
+    importAssetFile(filename, fileIO);
+    const auto texture = AssetCache::instance().fileTexture(filename);
+    if (render::texturePrefetch())
+        render::prefetchTexture(texture);
+    std::lock_guard<std::mutex> lock(_mutex);
+    return appendTexture(texture);
 }
 
 int RenderingInterface::registerTexture(unsigned char* texels, int width, int height)
 {
-    auto data = std::vector<unsigned char>{texels, texels + width * height * 4};
-    _textures.push_back(std::make_shared<scene::Texture>(std::move(data), Size2i{width, height}));
+    const size_t count = size_t(width) * size_t(height) * 4;
+    const auto texture = AssetCache::instance().memoryTexture(texels, count, {width, height});
+    std::lock_guard<std::mutex> lock(_mutex);
+    return appendTexture(texture);
+}
+
+int RenderingInterface::registerTexture(const std::shared_ptr<scene::Bitmap>& bitmap)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return appendTexture(std::make_shared<scene::Texture>(bitmap));
+}
+
+int RenderingInterface::changeTexels(int textureId)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (textureId < 0 || textureId >= int(_textures.size()))
+        return -1;
+    return _sceneGraph->changeTexels(_textures[textureId]);
+}
+
+void RenderingInterface::recordFrame(int camera, const render::FrameData& frame)
+{
+    const auto it = _videoSinks.find(camera);
+    if (it != _videoSinks.end())
+        it->second->push(frame);
+    if (_recorder)
+        _recorder->push(frame, camera < 0 ? _sceneView->camera() : _batchCameras[camera],
+                        *_sceneState);
+}
+
+int RenderingInterface::appendTexture(const std::shared_ptr<scene::Texture>& texture)
+{
+    // the same texture loaded again keeps its id
+    auto it = _textureIds.find(texture.get());
+    if (it != _textureIds.end())
+        return it->second;
+
+    _textures.push_back(texture);
+    _textureIds.emplace(texture.get(), int(_textures.size()) - 1);
     return int(_textures.size()) - 1;
 }
 
+void RenderingInterface::appendNode(int nodeId, scene::Node&& node)
+{
+    // user segmentation ids of the link, then of its shapes
+    const auto first = _segmentationIds.lower_bound(std::make_tuple(node.body(), node.link(), -1));
+    for (auto it = first; it != _segmentationIds.end() &&
+                          std::get<0>(it->first) == node.body() &&
+                          std::get<1>(it->first) == node.link();
+         ++it) {
+        const int shapeIndex = std::get<2>(it->first);
+        if (shapeIndex < 0) {
+            node.setInstanceId(it->second.first);
+            node.setSemanticId(it->second.second);
+        }
+        else if (shapeIndex < int(node.shapes().size())) {
+            node.shape(shapeIndex).setInstanceId(it->second.first);
+            node.shape(shapeIndex).setSemanticId(it->second.second);
+        }
+    }
+    if (_retiredNodes.erase(nodeId)) {
+        // shapes of the asset and material caches compare by pointer, the renderer keeps the node
+        if (_sceneGraph->nodes().at(nodeId) == node)
+            return;
+        _sceneGraph->removeNode(nodeId);
+        _sceneState->removeNode(nodeId);
+    }
+    // visibility layers of the link and its shapes, kept by the graph aside from the node
+    const auto layers =
+        _visibilityLayers.lower_bound(std::make_tuple(node.body(), node.link(), -1));
+    for (auto it = layers; it != _visibilityLayers.end() &&
+                           std::get<0>(it->first) == node.body() &&
+                           std::get<1>(it->first) == node.link();
+         ++it)
+        _sceneGraph->setVisibilityLayers(nodeId, std::get<2>(it->first), it->second);
+    if (_stagedLoading) {
+        // prefetched even for python renderers, whose nodes would never be ready otherwise
+        for (const auto& shape : node.shapes())
+            render::prefetchAssets(shape);
+        _stagedNodes.erase(nodeId);
+        _stagedNodes.emplace(nodeId, std::move(node));
+        return;
+    }
+    insertNode(nodeId, std::move(node));
+}
+
+void RenderingInterface::insertNode(int nodeId, scene::Node&& node)
+{
+    _sceneGraph->appendNode(nodeId, std::move(node));
+    _sceneState->appendNode(nodeId);
+
+    // poses synced while the node was staged were skipped by applySyncedPoses()
+    const auto it = _syncedTransforms.find(nodeId);
+    if (it == _syncedTransforms.end())
+        return;
+    const auto& synced = it->second;
+    Affine3f pose;
+    makePoses(&synced.frame, &synced.scale, 1, &pose);
+    _sceneState->setPose(nodeId, pose);
+    if (synced.fixedBase || (_staticSyncs > 0 && synced.unchangedSyncs >= _staticSyncs))
+        _sceneState->setStatic(nodeId, true);
+}
+
+void RenderingInterface::admitStagedNodes()
+{
+    if (_stagedNodes.empty())
+        return;
+    render::TraceScope trace("admit_nodes", _clientId);
+
+    // nodes of loaded assets are uploaded ahead of the scene update, which then finds them on the
+    // GPU, until the budget of the image is spent; waiting images load the others synchronously
+    // nodes staged before staging was disabled are all added at once
+    const bool wait = _stagedWait || !_stagedLoading;
+    const auto start = std::chrono::steady_clock::now();
+    size_t admitted = 0;
+    for (auto it = _stagedNodes.begin(); it != _stagedNodes.end();) {
+        const auto& shapes = it->second.shapes();
+        if (!wait) {
+            if (!std::all_of(shapes.begin(), shapes.end(), render::assetsLoaded)) {
+                ++it;
+                continue;
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (admitted > 0 && elapsed.count() >= _uploadBudget)
+                break;
+            for (const auto& shape : shapes) {
+                try {
+                    _renderer->uploadAssets(shape);
+                }
+                catch (const std::exception&) {
+                    // uploaded by the scene update instead
+                }
+            }
+        }
+        insertNode(it->first, std::move(it->second));
+        it = _stagedNodes.erase(it);
+        ++admitted;
+    }
+}
+
+void RenderingInterface::admitStagedNode(int nodeId)
+{
+    const auto it = _stagedNodes.find(nodeId);
+    if (it == _stagedNodes.end())
+        return;
+    insertNode(nodeId, std::move(it->second));
+    _stagedNodes.erase(it);
+}
+
+void RenderingInterface::applyBaseLayer()
+{
+    const bool layered = _baseLayer && _renderer->drawsBaseLayer();
+    const auto& base = layered ? _baseLayer : nullptr;
+    std::vector<int> hidden;
+    if (base != _sceneGraph->baseLayer()) {
+        for (auto& it : _layerNodes)
+            insertNode(it.first, std::move(it.second));
+        _layerNodes.clear();
+        _sceneGraph->setBaseLayer(base);
+        _syncSceneGraph = true;
+        if (!layered)
+            return;
+        for (const auto& it : _sceneGraph->nodes())
+            hidden.push_back(it.first);
+    }
+    else if (layered) {
+        // bodies of the layer loaded since
+        const auto& added = _sceneGraph->delta().added();
+        hidden.assign(added.begin(), added.end());
+    }
+    for (int nodeId : hidden) {
+        const auto it = _sceneGraph->nodes().find(nodeId);
+        if (it == _sceneGraph->nodes().end() || !_layerBodies.count(it->second.body()))
+            continue;
+        _layerNodes[nodeId] = it->second;
+        _sceneGraph->removeNode(nodeId);
+        _sceneState->removeNode(nodeId);
+    }
+}
+
+void RenderingInterface::dropRetiredNodes()
+{
+    for (int nodeId : _retiredNodes) {
+        _sceneGraph->removeNode(nodeId);
+        _sceneState->removeNode(nodeId);
+    }
+    _retiredNodes.clear();
+}
+
+void RenderingInterface::matchImportedLink(int nodeId, const btTransform& worldTransform)
+{
+    _importSynced = true;
+    if (_syncedTransforms.count(nodeId) || _sceneGraph->nodes().count(nodeId) ||
+        _stagedNodes.count(nodeId))
+        return;
+
+    // both poses come from the same transform of the object, up to a round trip in doubles
+    const auto matches = [&worldTransform](const ImportedLink& link) {
+        const auto& f = link.frame;
+        const btVector3 origin(f[0], f[1], f[2]);
+        const btQuaternion quat(f[3], f[4], f[5], f[6]);
+        return origin.distance2(worldTransform.getOrigin()) < 1e-10 &&
+               std::abs(quat.dot(worldTransform.getRotation())) > 1. - 1e-8;
+    };
+    const auto it = std::find_if(_importedLinks.begin(), _importedLinks.end(), matches);
+    if (it == _importedLinks.end())
+        return;
+    const auto link = std::move(*it);
+    _importedLinks.erase(it);
+
+    std::vector<scene::Shape> sceneShapes;
+    for (const auto& imported : link.shapes) {
+        UrdfShape urdfShape;
+        const auto& f = imported.frame;
+        urdfShape.m_linkLocalFrame = btTransform(btQuaternion(f[3], f[4], f[5], f[6]),
+                                                 btVector3(f[0], f[1], f[2]));
+        auto& geometry = urdfShape.m_geometry;
+        const auto& d = imported.dimensions;
+        geometry.m_type = UrdfGeomTypes(imported.geometryType);
+        geometry.m_boxSize = btVector3(d[0], d[1], d[2]);
+        geometry.m_sphereRadius = d[0];
+        geometry.m_capsuleHeight = d[0];
+        geometry.m_capsuleRadius = d[1];
+        geometry.m_meshScale = btVector3(d[0], d[1], d[2]);
+        geometry.m_meshFileName = imported.filename;
+        // heightfields and in-memory meshes left no file to load
+        if (geometry.m_type == URDF_GEOM_HEIGHTFIELD ||
+            (geometry.m_type == URDF_GEOM_MESH && imported.filename.empty()))
+            continue;
+
+        UrdfMaterial urdfMaterial;
+        const auto& rgba = imported.rgba;
+        urdfMaterial.m_matColor.m_rgbaColor = btVector4(rgba[0], rgba[1], rgba[2], rgba[3]);
+        _visualShapes.add(link.body, link.link,
+                          makeVisualShapeData(urdfShape, urdfMaterial, btTransform::getIdentity(),
+                                              link.body, link.link));
+        const auto& shape =
+            makeShape(urdfShape, _sceneGraph->internMaterial(makeMaterial(urdfMaterial)),
+                      btTransform::getIdentity(), 0);
+        if (shape.valid())
+            sceneShapes.push_back(shape);
+    }
+
+    if (render::assetPrefetch())
+        for (const auto& shape : sceneShapes)
+            render::prefetchAssets(shape);
+    if (sceneShapes.empty())
+        return;
+    appendNode(nodeId, {link.body, link.link, std::move(sceneShapes)});
+    if (_staticFixedBases && link.fixedBase)
+        _fixedBases.insert(nodeId);
+    _visualShapes.setNode(link.body, link.link, nodeId);
+}
+
 void RenderingInterface::setProjectiveTextureMatrices(const float viewMatrix[16],
                                                       const float projectionMatrix[16])
 {
-    /// @todo: setProjectiveTextureMatrices not implemented
+    // a new object, views of the previous images compare theirs by value
+    _projector =
+        std::make_shared<scene::Camera>(*reinterpret_cast<const Matrix4f*>(viewMatrix),
+                                        *reinterpret_cast<const Matrix4f*>(projectionMatrix));
 }
 
-void RenderingInterface::setProjectiveTexture(bool setProjectiveTexture)
+void RenderingInterface::setProjectiveTexture(bool useProjectiveTexture)
 {
-    /// @todo: setProjectiveTexture not implemented
+    _projectiveTexture = useProjectiveTexture;
 }
 
 void RenderingInterface::syncTransform(int collisionObjectUId,
                                        const class btTransform& worldTransform,
                                        const class btVector3& localScaling)
 {
-    if (collisionObjectUId >= 0)
-        _sceneState->setPose(collisionObjectUId, makePose(worldTransform, localScaling));
+    if (collisionObjectUId < 0)
+        return;
+    // images not rendered skip the conversion of the poses
+    if (_schedule == Schedule::Undecided)
+        scheduleRequest();
+    if (_schedule == Schedule::Skip)
+        return;
+    convertPendingLinks(); //<- the first sync after an import classifies the new fixed bases
+
+    // bullet syncs all objects of a step or a request in a row, traced as one span
+    if (render::Trace::enabled()) {
+        _syncBurstEnd = render::Trace::now();
+        if (_syncBurstCount++ == 0)
+            _syncBurstStart = _syncBurstEnd;
+    }
+
+    if (!_importedLinks.empty())
+        matchImportedLink(collisionObjectUId, worldTransform);
+
+    // skip the pose conversion if nothing moved since the previous step, counting the steps a
+    // node stays still to classify it static; moved ones are dynamic again in the scene state
+    bool first = false;
+    auto it = _syncedTransforms.find(collisionObjectUId);
+    if (it != _syncedTransforms.end()) {
+        auto& synced = it->second;
+        // synced for an earlier camera image of the step
+        if (_stepSync && synced.step == _syncStep)
+            return;
+        synced.step = _syncStep;
+        if (synced.frame == worldTransform && synced.scale == localScaling) {
+            const int staticSyncs = synced.fixedBase ? 1 : _staticSyncs;
+            if (synced.unchangedSyncs < staticSyncs && ++synced.unchangedSyncs == staticSyncs)
+                _pendingStatic.push_back(collisionObjectUId);
+            return;
+        }
+        synced.frame = worldTransform;
+        synced.scale = localScaling;
+        synced.unchangedSyncs = 0;
+    }
+    else {
+        // fixed bases are static from their first pose on
+        const bool fixedBase = _fixedBases.erase(collisionObjectUId) > 0;
+        _syncedTransforms.emplace(collisionObjectUId,
+                                  SyncedTransform{worldTransform, localScaling, 0, fixedBase,
+                                                  _syncStep});
+        if (fixedBase)
+            _pendingStatic.push_back(collisionObjectUId);
+        first = true;
+    }
+
+    // converted with the other moved transforms of the step, see applySyncedPoses()
+    _pendingIds.push_back(collisionObjectUId);
+    _pendingFrames.push_back(worldTransform);
+    _pendingScales.push_back(localScaling);
+    _pendingFirst.push_back(first);
 }
 
-void RenderingInterface::render(const float viewMat[16], const float projMat[16])
+void RenderingInterface::applySyncedPoses()
+{
+    // links converted first, so that their first poses apply
+    convertPendingLinks();
+    // nodes interpolated for the last frame go back to their synced poses
+    for (const auto& it : _blendedPoses)
+        if (_sceneState->hasNode(it.first))
+            _sceneState->setPose(it.first, it.second);
+    _blendedPoses.clear();
+    const float blend = _poseBlend;
+    _poseBlend = 1.f;
+    if (_pendingIds.empty() && _pendingStatic.empty())
+        return;
+
+    _pendingPoses.resize(_pendingIds.size());
+    makePoses(_pendingFrames.data(), _pendingScales.data(), _pendingIds.size(),
+              _pendingPoses.data());
+    for (size_t i = 0; i < _pendingIds.size(); ++i) {
+        const int nodeId = _pendingIds[i];
+        if (!_sceneState->hasNode(nodeId))
+            continue;
+        if (blend < 1.f && !_pendingFirst[i]) {
+            _blendedPoses.emplace_back(nodeId, _pendingPoses[i]);
+            _sceneState->setPose(nodeId,
+                                 interpolate(_sceneState->pose(nodeId), _pendingPoses[i], blend));
+        }
+        else {
+            _sceneState->setPose(nodeId, _pendingPoses[i]);
+        }
+    }
+    _pendingIds.clear();
+    _pendingFrames.clear();
+    _pendingScales.clear();
+    _pendingFirst.clear();
+
+    // after the poses, which would make them dynamic again
+    for (int nodeId : _pendingStatic)
+        if (_sceneState->hasNode(nodeId))
+            _sceneState->setStatic(nodeId, true);
+    _pendingStatic.clear();
+}
+
+void RenderingInterface::scheduleRequest()
+{
+    // batches, encoded and bulk frames are always rendered, as are frames with none to return
+    const double step = double(_stepCount);
+    const bool scheduled = _framePeriod > 0. && _batchCameras.empty() && _encodeCols <= 0 &&
+                           !_encodedPending && !_bulkTransfer;
+    _schedule = Schedule::Render;
+    _poseBlend = 1.f;
+    if (!scheduled || (!_frameCached && step < _nextFrameStep)) {
+        _frameStep = step;
+    }
+    else if (step >= _nextFrameStep) {
+        // the latest frame due, earlier ones missed are dropped
+        const double due =
+            _nextFrameStep + std::floor((step - _nextFrameStep) / _framePeriod) * _framePeriod;
+        _nextFrameStep = due + _framePeriod;
+        const bool blend = _interpolatePoses && _syncedStep >= 0. && _syncedStep < due;
+        if (blend)
+            _poseBlend = float((due - _syncedStep) / (step - _syncedStep));
+        _frameStep = blend ? due : step;
+    }
+    else {
+        // synced a step before the frame due, to interpolate the poses from
+        const bool snapshot = _interpolatePoses && step + 1. > _nextFrameStep;
+        _schedule = snapshot ? Schedule::Snapshot : Schedule::Skip;
+    }
+    if (_schedule != Schedule::Skip)
+        _syncedStep = step;
+}
+
+void RenderingInterface::flushSyncBurst()
 {
-    _camera = std::make_shared<scene::Camera>(*reinterpret_cast<const Matrix4f*>(viewMat),
-                                              *reinterpret_cast<const Matrix4f*>(projMat));
+    // all objects are synced at once, imported links not matched by then have no object
+    if (_importSynced) {
+        _importedLinks.clear();
+        _importSynced = false;
+    }
+    applySyncedPoses();
+    if (_syncBurstCount && render::Trace::enabled())
+        render::Trace::complete("sync_transforms", _syncBurstStart, _syncBurstEnd, "count",
+                                _syncBurstCount);
+    _syncBurstCount = 0;
+}
+
+void RenderingInterface::beginStep()
+{
+    flushSyncBurst();
+    _stepStart = render::Trace::enabled() ? render::Trace::now() : 0;
+}
 
-    //               _camera.setViewMatrix(*reinterpret_cast<const Matrix4f*>(viewMat));
-    // _camera.setProjMatrix(*reinterpret_cast<const Matrix4f*>(projMat));
+void RenderingInterface::endStep()
+{
+    flushSyncBurst();
+    ++_stepCount;
+    ++_syncStep;
+    if (_stepStart && render::Trace::enabled())
+        render::Trace::complete("physics_step", _stepStart, render::Trace::now(), "client",
+                                _clientId);
+    _stepStart = 0;
+}
+
+void RenderingInterface::render(const float viewMat[16], const float projMat[16])
+{
+    _camera = pooledObject(_cameraPool);
+    if (_selectedCamera >= 0) {
+        // intrinsics derived once at registration, only the pose changes
+        *_camera = _registeredCameras[_selectedCamera];
+        _camera->setViewMatrix(*reinterpret_cast<const Matrix4f*>(viewMat));
+        return;
+    }
+    _camera->setViewMatrix(*reinterpret_cast<const Matrix4f*>(viewMat));
+    _camera->setProjMatrix(*reinterpret_cast<const Matrix4f*>(projMat));
+    _camera->setHandle(-1);
 }
 
 void RenderingInterface::render()
@@ -341,34 +1860,457 @@ void RenderingInterface::copyCameraImageData(unsigned char* pixelsRGBA, int rgba
                                              int startPixelIndex, int* widthPtr, int* heightPtr,
                                              int* numPixelsCopied)
 {
-    if (!!_renderer) {
-        // update scene if something changed
-        if (_syncSceneGraph || _syncMaterials) {
-            _renderer->updateScene(_sceneGraph, !_syncSceneGraph);
-            _syncSceneGraph = false;
-            _syncMaterials = false;
+    if (startPixelIndex == 0 && _schedule == Schedule::Undecided)
+        scheduleRequest(); //<- nothing synced
+    flushSyncBurst();
+    render::TraceFrame trace("camera_image", _clientId, startPixelIndex == 0);
+    std::lock_guard<std::mutex> lock(_mutex);
+    render::StageStats::Scope stats(_stageStats);
+    const bool scheduled = startPixelIndex != 0 || _schedule == Schedule::Render;
+    if (startPixelIndex == 0)
+        _schedule = Schedule::Undecided;
+
+    // an encoded frame is fetched by requests of height 1, any other request drops it
+    if (_encodedPending && startPixelIndex == 0 && *heightPtr != 1)
+        _encodedPending = false;
+
+    // render once on the first chunk, later chunks are served from the frame cache
+    if (startPixelIndex == 0 && !_encodedPending && scheduled) {
+        if (!_renderer) {
+            _frameCached = false;
         }
+        else {
+            syncScene();
+
+            // render a batch of cameras into caller's buffers instead of the requested image
+            if (!_batchCameras.empty()) {
+                _frameCached = false;
+                renderCameraBatch();
+            }
+            else if (_encodeCols > 0 && _encodeRows > 0) {
+                renderEncodedFrame(maskBuffer != nullptr);
+            }
+            else if (_bulkTransfer) {
+                renderBulkFrame(maskBuffer != nullptr);
+            }
+            else {
+                renderCachedFrame(*widthPtr, *heightPtr, maskBuffer != nullptr, true);
+            }
+            updateMemoryPeak();
+        }
+    }
 
-        // set light and camera
-        _sceneView->setLight(_light);
-        _sceneView->setCamera(_camera);
-        _sceneView->setFlags(_flags);
-
-        _light.reset();
-        _camera.reset();
+    if (_encodedPending) {
+        render::StageTimer timer(render::Stage::Copy);
+        _encodedPending = copyEncodedFrame(
+            pixelsRGBA, rgbaBufferSizeInPixels, depthBuffer, depthBufferSizeInPixels, maskBuffer,
+            maskSizeInPixels, startPixelIndex, *widthPtr, *heightPtr, numPixelsCopied);
+        return;
+    }
 
-        // destination buffer
-        ///@todo: partial buffers, check buffers size
-        render::FrameData frame{*widthPtr, *heightPtr, pixelsRGBA, depthBuffer, maskBuffer};
+    if (_bulkTransfer) {
+        copyBulkSequence(pixelsRGBA, rgbaBufferSizeInPixels, depthBuffer, depthBufferSizeInPixels,
+                         maskBuffer, maskSizeInPixels, startPixelIndex, *widthPtr, *heightPtr,
+                         numPixelsCopied);
+        return;
+    }
 
-        // render
-        if (_renderer->renderFrame(_sceneState, _sceneView, frame)) {
-            *numPixelsCopied = frame.rows * frame.cols;
-            return;
-        }
+    if (_frameCached) {
+        render::StageTimer timer(render::Stage::Copy);
+        const int numPixels = _frameCols * _frameRows;
+        // chunks past the end copy nothing, without iterators past the planes
+        const int start = std::min(std::max(startPixelIndex, 0), numPixels);
+        int count = std::min({numPixels - start, rgbaBufferSizeInPixels,
+                              depthBufferSizeInPixels});
+        if (maskBuffer && !_frameMask.empty())
+            count = std::min(count, maskSizeInPixels);
+        count = std::max(count, 0);
+
+        std::copy_n(_frameColor.begin() + size_t(start) * 4, size_t(count) * 4, pixelsRGBA);
+        std::copy_n(_frameDepth.begin() + start, count, depthBuffer);
+        if (maskBuffer && !_frameMask.empty())
+            std::copy_n(_frameMask.begin() + start, count, maskBuffer);
+
+        *widthPtr = _frameCols;
+        *heightPtr = _frameRows;
+        *numPixelsCopied = count;
+        return;
     }
 
     *widthPtr = 0;
     *heightPtr = 0;
     *numPixelsCopied = 0;
 }
+
+void RenderingInterface::syncScene()
+{
+    // update scene if something changed
+    render::StageTimer timer(render::Stage::SceneSync);
+    dropRetiredNodes();
+    admitStagedNodes();
+    applyBaseLayer();
+    if (_syncSceneGraph) {
+        _renderer->updateScene(_sceneGraph, false);
+        _sceneState->markAllDirty();
+        _syncSceneGraph = false;
+    }
+    else if (!_sceneGraph->delta().empty()) {
+        const auto& delta = _sceneGraph->delta();
+        const uint64_t deltaStart = render::Trace::enabled() ? render::Trace::now() : 0;
+        _renderer->applySceneDelta(_sceneGraph, delta);
+        // rebuilt nodes need their poses again, renderers may rebuild deformed ones too
+        for (int nodeId : delta.added())
+            _sceneState->markDirty(nodeId);
+        for (int nodeId : delta.changed())
+            _sceneState->markDirty(nodeId);
+        for (int nodeId : delta.geometryChanged())
+            _sceneState->markDirty(nodeId);
+        if (deltaStart)
+            render::Trace::complete(
+                "scene_delta", deltaStart, render::Trace::now(), "nodes",
+                int(delta.added().size() + delta.changed().size() + delta.geometryChanged().size() +
+                    delta.removed().size()));
+    }
+    _sceneGraph->resetDelta();
+
+    // set light and camera, a light requested again with the same settings keeps the object of
+    // the previous images, so that renderers can tell it unchanged by identity
+    if (!_light || !_viewLight || *_light != *_viewLight)
+        _viewLight = _light;
+    _sceneView->setLight(_viewLight);
+    _sceneView->setCamera(_camera);
+    // cameras of the other views are new ones too, views compare them by value
+    std::vector<std::shared_ptr<scene::Camera>> views;
+    for (size_t i = 0; _camera && i < _multiviewPoses.size(); ++i) {
+        views.push_back(std::make_shared<scene::Camera>(
+            multiply(affineInverse(_multiviewPoses[i]), _camera->viewMatrix()),
+            _camera->projMatrix()));
+    }
+    _sceneView->setMultiviewCameras(views);
+    _sceneView->setFlags(_flags);
+    _sceneView->setProjectiveTexture(_projectiveTexture ? _projector : nullptr);
+    _sceneView->setMaterialOverrides(nullptr);
+    _sceneView->setVisibilityLayers(_sceneGraph->visibilityLayers());
+    _sceneView->setCameraLayers(_cameraLayers);
+    if (_randomization)
+        randomizeView();
+
+    _light.reset();
+    _camera.reset();
+}
+
+void RenderingInterface::randomizeView()
+{
+    const auto& randomization = *_randomization;
+    const bool perFrame = randomization.mode == scene::Randomization::Mode::PerFrame;
+    // an episode is sampled again for nodes added since, with the same values for the others
+    const bool sample = perFrame || !_randomMaterials ||
+                        _randomGeneration != _sceneGraph->generation();
+    if (perFrame && _randomMaterials)
+        ++_randomIndex;
+    if (sample) {
+        _randomMaterials = randomization.sampleMaterials(_randomIndex, *_sceneGraph, _randomAtlas);
+        _randomGeneration = _sceneGraph->generation();
+    }
+    _sceneView->setMaterialOverrides(_randomMaterials);
+
+    if (randomization.light) {
+        // light values do not depend on the base, only its type, target and distance are kept
+        const auto base =
+            _light ? *_light : scene::Light({1.f, 1.f, 1.f}, {0.8f, 0.2f, -2.f}, 10.f);
+        auto& light = pooledObject(_randomLightPool);
+        *light = randomization.sampleLight(_randomIndex, base);
+        _sceneView->setLight(light);
+    }
+    if (sample && _randomLog.is_open()) {
+        const auto* light = randomization.light ? _sceneView->light().get() : nullptr;
+        _randomLog << randomization.record(_randomIndex, light, *_randomMaterials, *_sceneGraph,
+                                           _randomAtlas)
+                   << std::endl;
+    }
+}
+
+void RenderingInterface::renderCachedFrame(int cols, int rows, bool withMask, bool withRoi)
+{
+    // a region of interest is rendered alone, at its size, frames of fixed sizes have none
+    const auto roi = withRoi ? clipRoi(_roi, cols, rows) : Vector4i{0, 0, 0, 0};
+    _sceneView->setRoi(roi);
+    if (_sceneView->hasRoi()) {
+        _sceneView->setViewport({cols, rows});
+        cols = roi[2];
+        rows = roi[3];
+    }
+
+    // bullet nulls the mask buffer when ER_NO_SEGMENTATION_MASK is requested, mask-only images
+    // draw neither color nor depth unless extra channels are computed from them
+    const bool maskOnly = _maskOnly && withMask && !_pointOutput && !_motionOutput &&
+                          !_normalOutput && !_depthPyramidLevels && !_eventOutput;
+    int channels =
+        maskOnly ? 0 : int(scene::OutputChannel::Color) | int(scene::OutputChannel::Depth);
+    if (withMask)
+        channels |= int(scene::OutputChannel::Mask);
+    if (_pointOutput)
+        channels |= int(scene::OutputChannel::Points);
+    if (_motionOutput)
+        channels |= int(scene::OutputChannel::Motion);
+    if (_normalOutput)
+        channels |= int(scene::OutputChannel::Normals);
+    if (_depthPyramidLevels)
+        channels |= int(scene::OutputChannel::DepthPyramid);
+    if (_eventOutput)
+        channels |= int(scene::OutputChannel::Events);
+    if (_visibilityOutput)
+        channels |= int(scene::OutputChannel::Visibility);
+    if (_boxOutput)
+        channels |= int(scene::OutputChannel::Boxes);
+    // keypoints resolved to the nodes of their links once per scene graph, views compare them
+    // by pointer
+    if (!_keypoints.empty()) {
+        channels |= int(scene::OutputChannel::Keypoints);
+        if (!_viewKeypoints || _keypointGeneration != _sceneGraph->generation()) {
+            auto keypoints = std::make_shared<scene::Keypoints>();
+            keypoints->reserve(_keypoints.size());
+            for (const auto& keypoint : _keypoints)
+                keypoints->emplace_back(_visualShapes.node(keypoint.body, keypoint.link),
+                                        keypoint.position);
+            _viewKeypoints = std::move(keypoints);
+            _keypointGeneration = _sceneGraph->generation();
+        }
+    }
+    else {
+        _viewKeypoints.reset();
+    }
+    _sceneView->setKeypoints(_viewKeypoints);
+    // multiview frames hold images only
+    if (_sceneView->hasMultiview())
+        channels &= int(scene::OutputChannel::Color) | int(scene::OutputChannel::Depth) |
+                    int(scene::OutputChannel::Mask);
+    _sceneView->setOutputChannels(channels);
+    // motion since the previous image, none for the first one
+    _sceneView->setPreviousCamera(_motionCamera);
+    _sceneView->setPreviousState(_motionState);
+    // events since the previous image, at the step of the poses
+    _sceneView->setEventTime(_frameStep * _eventStepDuration);
+
+    // the async renderer hands out frames of a previous request, never reuse them, nor frames
+    // noised by a sensor which draws new noise every frame
+    const bool hit = _frameCacheEnabled && !_asyncMode && _frameCached && //
+                     !_sceneView->sensorNoise().enabled() &&
+                     _frameCols == cols && _frameRows == rows &&
+                     _frameGraphGeneration == _sceneGraph->generation() &&
+                     _frameStateGeneration == _sceneState->generation() &&
+                     _frameView == *_sceneView;
+    if (hit) {
+        ++_frameCacheHits;
+        recordFrame(-1, render::FrameData{cols, rows, _frameColor.data(), _frameDepth.data(),
+                                          _frameMask.empty() ? nullptr : _frameMask.data()});
+        return;
+    }
+    if (_frameCacheEnabled)
+        ++_frameCacheMisses;
+
+    const int numPixels = cols * rows;
+    // planes a mask-only image does not draw are cleared to no color and far depth once, rather
+    // than keep those of an older image
+    const bool clearPlanes =
+        maskOnly && (!_frameMaskOnly || numPixels != int(_frameDepth.size()));
+    _frameMaskOnly = maskOnly;
+    _frameCols = cols;
+    _frameRows = rows;
+    _frameColor.resize(numPixels * 4);
+    _frameDepth.resize(numPixels);
+    if (clearPlanes) {
+        std::fill(_frameColor.begin(), _frameColor.end(), uint8_t(0));
+        std::fill(_frameDepth.begin(), _frameDepth.end(), 1.f);
+    }
+    _frameMask.resize(withMask ? numPixels : 0);
+    // scratch mask of the renderers counting its pixels on the CPU, when not asked for
+    _scratchMask.resize(_visibilityOutput && !withMask ? numPixels : 0);
+    _framePoints.resize(_pointOutput ? size_t(numPixels) * 3 : 0);
+    _framePointIds.resize(_pointOutput && _sceneView->compactPoints() ? numPixels : 0);
+    _frameMotion.resize(_motionOutput ? size_t(numPixels) * 2 : 0);
+    _frameNormals.resize(_normalOutput ? size_t(numPixels) * 3 : 0);
+    _frameDepthPyramid.resize(
+        _depthPyramidLevels ? render::depthLevelOffset(cols, rows, _depthPyramidLevels + 1) : 0);
+    _frameEvents.resize(_eventOutput ? size_t(numPixels) * 4 : 0);
+    _framePixelCounts.resize(_visibilityOutput ? size_t(numPixels) * 2 : 0);
+    _frameBoxes.resize(_boxOutput ? size_t(numPixels) * 4 : 0);
+    _frameKeypoints.resize(_viewKeypoints ? _viewKeypoints->size() * 4 : 0);
+
+    render::FrameData frame{cols,
+                            rows,
+                            maskOnly ? nullptr : _frameColor.data(),
+                            maskOnly ? nullptr : _frameDepth.data(),
+                            withMask ? _frameMask.data()
+                                     : _scratchMask.empty() ? nullptr : _scratchMask.data(),
+                            _pointOutput ? _framePoints.data() : nullptr,
+                            _framePointIds.empty() ? nullptr : _framePointIds.data(),
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            _motionOutput ? _frameMotion.data() : nullptr,
+                            _normalOutput ? _frameNormals.data() : nullptr,
+                            _depthPyramidLevels ? _frameDepthPyramid.data() : nullptr,
+                            _eventOutput ? _frameEvents.data() : nullptr,
+                            _visibilityOutput ? _framePixelCounts.data() : nullptr,
+                            _boxOutput ? _frameBoxes.data() : nullptr,
+                            _frameKeypoints.empty() ? nullptr : _frameKeypoints.data()};
+    _frameCached = _renderer->renderFrame(_sceneState, _sceneView, frame);
+    // points, motion and normals the renderer did not compute are derived from the depth
+    if (_frameCached) {
+        render::applySensorNoise(*_sceneView, frame, _noiseFrame++);
+        render::completePoints(*_sceneView, frame);
+        render::completeMotion(*_sceneView, _sceneGraph.get(), *_sceneState, frame);
+        render::completeNormals(*_sceneView, frame);
+        render::completeDepthPyramid(*_sceneView, frame);
+        // events found by the renderer leave a reference behind on the GPU, not this one
+        if (frame.numEvents >= 0)
+            _eventCamera.reset();
+        _eventCamera.complete(*_sceneView, frame);
+        render::completePixelCounts(*_sceneView, frame);
+        render::completeKeypoints(*_sceneView, *_sceneState, frame);
+    }
+    _frameNumPoints = frame.numPoints;
+    _frameNumEvents = frame.numEvents;
+    _frameNumPixelCounts = frame.numPixelCounts;
+    if (_frameCached && _motionOutput && _sceneView->camera()) {
+        // new objects, views compare the previous state by pointer
+        _motionCamera = std::make_shared<scene::Camera>(*_sceneView->camera());
+        _motionState = std::make_shared<scene::SceneState>(*_sceneState);
+    }
+    _sceneState->clearDirty();
+    const auto published = withMask ? frame : withoutMask(frame);
+    _frameSequence = _frameCached && _frameSink ? _frameSink->publish(published) : 0;
+    if (_frameCached)
+        recordFrame(-1, published);
+
+    _frameGraphGeneration = _sceneGraph->generation();
+    _frameStateGeneration = _sceneState->generation();
+    _frameView = *_sceneView;
+}
+
+void RenderingInterface::renderEncodedFrame(bool withMask)
+{
+    const int cols = _encodeCols, rows = _encodeRows;
+    _encodeCols = _encodeRows = 0;
+
+    _sceneView->setViewport({cols, rows});
+    renderCachedFrame(cols, rows, withMask);
+
+    // a frame which failed to render is sent as an empty frame
+    _encoded.assign(4, 0);
+    if (_frameCached) {
+        std::vector<uint8_t> frame;
+        render::encodeFrame(render::FrameData{cols, rows, _frameColor.data(), _frameDepth.data(),
+                                              withMask ? _frameMask.data() : nullptr},
+                            frame);
+        const uint32_t size = uint32_t(frame.size());
+        std::memcpy(_encoded.data(), &size, 4);
+        _encoded.insert(_encoded.end(), frame.begin(), frame.end());
+    }
+    _encodedPending = true;
+}
+
+void RenderingInterface::renderBulkFrame(bool withMask)
+{
+    const int cols = _frameSink->cols(), rows = _frameSink->rows();
+    _sceneView->setViewport({cols, rows});
+    renderCachedFrame(cols, rows, withMask);
+
+    if (!_frameCached) {
+        _frameSequence = 0;
+        return;
+    }
+
+    // a frame served from the cache may have been lapped by camera batches published since
+    const int slot = _frameSink->slotOf(_frameSequence);
+    if (_frameSequence == 0 || _frameSink->slotSequence(slot) != _frameSequence)
+        _frameSequence = _frameSink->publish(
+            render::FrameData{cols, rows, _frameColor.data(), _frameDepth.data(),
+                              withMask ? _frameMask.data() : nullptr});
+}
+
+void RenderingInterface::copyBulkSequence(unsigned char* pixelsRGBA, int rgbaBufferSizeInPixels,
+                                          float* depthBuffer, int depthBufferSizeInPixels,
+                                          int* maskBuffer, int maskSizeInPixels,
+                                          int startPixelIndex, int width, int height,
+                                          int* numPixelsCopied)
+{
+    const int numPixels = width * height;
+    int count = std::min({numPixels - startPixelIndex, rgbaBufferSizeInPixels,
+                          depthBufferSizeInPixels});
+    if (maskBuffer)
+        count = std::min(count, maskSizeInPixels);
+    count = std::max(count, 0);
+
+    std::fill_n(pixelsRGBA, size_t(count) * 4, 0);
+    std::fill_n(depthBuffer, count, 0.f);
+    if (maskBuffer)
+        std::fill_n(maskBuffer, count, 0);
+    if (startPixelIndex == 0 && count > 0) {
+        const uint32_t low = uint32_t(_frameSequence), high = uint32_t(_frameSequence >> 32);
+        std::memcpy(pixelsRGBA, &low, 4);
+        if (maskBuffer)
+            std::memcpy(maskBuffer, &high, 4);
+    }
+    *numPixelsCopied = count;
+}
+
+bool RenderingInterface::copyEncodedFrame(unsigned char* pixelsRGBA, int rgbaBufferSizeInPixels,
+                                          float* depthBuffer, int depthBufferSizeInPixels,
+                                          int* maskBuffer, int maskSizeInPixels,
+                                          int startPixelIndex, int width, int height,
+                                          int* numPixelsCopied)
+{
+    const int numPixels = width * height;
+    int count = std::min({numPixels - startPixelIndex, rgbaBufferSizeInPixels,
+                          depthBufferSizeInPixels});
+    if (maskBuffer)
+        count = std::min(count, maskSizeInPixels);
+    count = std::max(count, 0);
+
+    // bytes [0, 4N) travel in the colors of the N pixels, bytes [4N, 8N) in their masks
+    const auto copyBytes = [this](size_t offset, size_t length, void* output) {
+        const size_t available = offset < _encoded.size() ? _encoded.size() - offset : 0;
+        const size_t copied = std::min(length, available);
+        std::memcpy(output, _encoded.data() + offset, copied);
+        std::memset(static_cast<uint8_t*>(output) + copied, 0, length - copied);
+    };
+    copyBytes(size_t(startPixelIndex) * 4, size_t(count) * 4, pixelsRGBA);
+    if (maskBuffer)
+        copyBytes((size_t(numPixels) + startPixelIndex) * 4, size_t(count) * 4, maskBuffer);
+    std::fill_n(depthBuffer, count, 0.f);
+    *numPixelsCopied = count;
+
+    const size_t capacity = size_t(numPixels) * (maskBuffer ? 8 : 4);
+    return startPixelIndex + count < numPixels || capacity < _encoded.size();
+}
+
+void RenderingInterface::renderCameraBatch()
+{
+    std::vector<std::shared_ptr<scene::SceneView>> views;
+    views.reserve(_batchCameras.size());
+    for (size_t i = 0; i < _batchCameras.size(); ++i) {
+        auto view = std::make_shared<scene::SceneView>(*_sceneView);
+        view->setCamera(_batchCameras[i]);
+        view->setMultiviewCameras({});
+        view->setViewport({_batchFrames[i].cols, _batchFrames[i].rows});
+        view->setOutputChannels(
+            int(scene::OutputChannel::Color) |
+            (_batchFrames[i].depth ? int(scene::OutputChannel::Depth) : 0) |
+            (_batchFrames[i].mask ? int(scene::OutputChannel::Mask) : 0));
+        views.push_back(view);
+    }
+
+    const bool rendered = _renderer->renderFrames(_sceneState, views, _batchFrames);
+    _sceneState->clearDirty();
+    if (rendered && _frameSink)
+        for (const auto& frame : _batchFrames)
+            _frameSink->publish(frame);
+    if (rendered)
+        for (size_t i = 0; i < _batchFrames.size(); ++i)
+            recordFrame(int(i), _batchFrames[i]);
+
+    _batchCameras.clear();
+    _batchFrames.clear();
+}
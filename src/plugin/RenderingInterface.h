@@ -4,17 +4,50 @@
 
 #pragma once
 
+#include "CameraDepthPyramid.h"
+#include "CameraEvents.h"
+#include "CameraKeypoints.h"
+#include "CameraMotion.h"
+#include "CameraNormals.h"
+#include "CameraPixelCounts.h"
+#include "CameraPoints.h"
+#include "FrameRecorder.h"
+#include "FrameRing.h"
+#include "ImportedLink.h"
+#include "MemoryReport.h"
+#include "VideoSink.h"
+#include "VisualShapeIndex.h"
+
 #include <render/BaseRenderer.h>
+#include <render/EventCamera.h>
+#include <render/PinnedMemory.h>
+#include <render/StageStats.h>
+#include <scene/Randomization.h>
 #include <scene/SceneGraph.h>
+#include <scene/SceneLayer.h>
 #include <scene/SceneState.h>
 #include <scene/SceneView.h>
 
+#include <array>
+#include <fstream>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <vector>
 
+#include <Importers/ImportURDFDemo/UrdfParser.h>
 #include <Importers/ImportURDFDemo/UrdfRenderingInterface.h>
-
+#include <LinearMath/btTransform.h>
+
+/**
+ * @brief Bullet render interface of a physics client
+ *
+ * Bullet calls it from the thread stepping its client, while the python bindings may set the
+ * renderer or camera batches from any thread: these calls and copyCameraImageData are
+ * serialized by a per-client lock. Interfaces of different clients share only thread-safe
+ * caches, so that independent clients may render concurrently, each with its own renderer.
+ */
 class RenderingInterface : public UrdfRenderingInterface
 {
   public:
@@ -27,6 +60,333 @@ class RenderingInterface : public UrdfRenderingInterface
     /// set renderer
     void setRenderer(const std::shared_ptr<render::BaseRenderer>& renderer);
 
+    /// render on a dedicated thread, copyCameraImageData then returns the previous frame
+    void setAsyncMode(bool enabled);
+
+    /// NUMA node of the thread rendering in async mode, -1 for that of the GPU of the renderer,
+    /// see render::placeThread()
+    void setNumaNode(int node);
+
+    /// reuse the previous frame when neither the scene, the poses nor the view changed
+    void setFrameCache(bool enabled);
+
+    /// classify as static the nodes whose transform did not change for \p unchangedSyncs
+    /// consecutive syncTransform calls, 0 for none, and the bases of fixed-base bodies loaded
+    /// from now on if \p fixedBases; static nodes are dynamic again as soon as they move
+    void setStaticClassification(int unchangedSyncs, bool fixedBases);
+
+    /// sync the pose of each object once per physics step: the syncTransform calls bullet makes
+    /// for each camera image skip the objects already synced since the last step, so that the
+    /// cameras of a step compare and convert the poses once and static classification counts
+    /// steps; objects moved without a step, e.g. reset, are then seen at the next step only
+    void setStepSync(bool enabled);
+
+    /// render camera images every \p framePeriod physics steps, fractional periods included, or
+    /// all of them for 0: the others return the previous frame without syncing the poses; with
+    /// \p interpolate, frames due between two steps pose the nodes at that point between the
+    /// poses of both steps, synced for the purpose; steps are counted from this call on
+    void setRenderSchedule(double framePeriod, bool interpolate);
+
+    /// step the poses of the last rendered frame are at, counted since setRenderSchedule()
+    double frameStep() const;
+
+    /// queue the links bullet converts, e.g. the bodies of a loadSDF or loadMJCF call, and
+    /// convert all of them in parallel before the next step, camera image or change of the scene;
+    /// nodes are appended in the order of the links, as without deferral
+    void setDeferredConversion(bool enabled);
+
+    /// keep the scene across resetAll: nodes loaded again under the same id with the same shapes,
+    /// i.e. the same meshes and materials, are kept with what the renderer built for them, the
+    /// others are removed at the next image instead of rebuilding the whole scene
+    void setWarmReset(bool enabled);
+
+    /// keep the nodes of new objects out of the scene until the prefetch workers loaded their
+    /// meshes and textures, images showing the scene without them meanwhile; nodes are then added
+    /// at the next images, their assets uploaded for at most \p uploadBudget seconds per image,
+    /// one node at least; with \p wait, images wait for all the staged nodes instead, for strict
+    /// consistency between bullet and the images; staged nodes changed, e.g. recolored, are added
+    /// at once, removed ones are dropped
+    void setStagedLoading(bool enabled, double uploadBudget, bool wait);
+
+    /// nodes waiting for their assets, see setStagedLoading()
+    int stagedNodes() const;
+
+    /// add the links of bodies loaded before the plugin, whose shapes bullet never converted:
+    /// each one becomes the node of the first unseen object synced at its pose before the end of
+    /// the next sync, links sharing a pose in their order; links left unmatched are dropped
+    void importLinks(std::vector<ImportedLink> links);
+
+    /// keep the poses and randomized materials of the scene under a bullet state id, e.g. the
+    /// one saveState returned, replacing an earlier snapshot of that id; copy-on-write, see
+    /// scene::SceneState::snapshot()
+    void saveSnapshot(int stateId);
+
+    /// go back to the poses and randomized materials of a snapshot, changing only the poses
+    /// that differ; false if there is no snapshot of that id
+    bool restoreSnapshot(int stateId);
+
+    /// forget a snapshot, e.g. after removeState
+    void removeSnapshot(int stateId);
+
+    /// register a camera of fixed intrinsics, the column-major \p projMat and the distortion of
+    /// its lens, returning its handle
+    int registerCamera(const float projMat[16], const scene::LensDistortion& distortion);
+
+    /// use the intrinsics of a registered camera for the next images, whatever projection
+    /// matrix they are requested with, -1 for none; false if there is no such camera
+    bool selectCamera(int handle);
+
+    /// render the next images with a panoramic projection around the camera position, requested
+    /// at the image size of the projection, see scene::Projection
+    void setProjection(scene::Projection projection);
+
+    /// render the next images as multiview frames, with views at the column-major \p poses in
+    /// the frame of their camera, e.g. the other eye of a stereo rig, stacked below its own and
+    /// requested at as many times the image rows; none for single views, see
+    /// scene::SceneView::multiviewCameras()
+    void setMultiview(const std::vector<Matrix4f>& poses);
+
+    /// render the region (x, y, width, height) of the next images only, clipped to them and
+    /// returned at its size, see scene::SceneView::roi(); of zero size for the whole images
+    void setRoi(const Vector4i& roi);
+
+    /// render the next images at a quality tier, see scene::Quality
+    void setQuality(const scene::Quality& quality);
+
+    /// light the next images by \p total point and spot lights, replacing those from \p first
+    /// by \p lights, see scene::SceneView::lights()
+    void setLights(const std::vector<scene::Light>& lights, int first, int total);
+
+    /// apply noise models of a sensor to the next images, see scene::SensorNoise
+    void setSensorNoise(const scene::SensorNoise& noise);
+
+    /// render the next images at their size times \p scale and resample them, 1 for none, see
+    /// scene::SceneView::renderScale()
+    void setRenderScale(float scale);
+
+    /// also render the XYZ points of the next images, in the camera or world frame, packed with
+    /// their segmentation ids if compact; read them back with cameraPoints()
+    void setPointOutput(bool enabled, scene::PointFrame frame, bool compact);
+
+    /// copy of the points of the last camera image, none if not requested
+    CameraPoints cameraPoints() const;
+
+    /// also render the motion of the pixels of the next images since the previous image, from
+    /// its camera and poses; read it back with cameraMotion()
+    void setMotionOutput(bool enabled);
+
+    /// copy of the motion of the last camera image, none if not requested
+    CameraMotion cameraMotion() const;
+
+    /// also render the camera frame normals of the pixels of the next images; read them back
+    /// with cameraNormals()
+    void setNormalOutput(bool enabled);
+
+    /// copy of the normals of the last camera image, none if not requested
+    CameraNormals cameraNormals() const;
+
+    /// also reduce the depth of the next images into a pyramid of \p levels levels, none if 0;
+    /// read it back with cameraDepthPyramid()
+    void setDepthPyramidOutput(int levels);
+
+    /// copy of the depth pyramid of the last camera image, none if not requested
+    CameraDepthPyramid cameraDepthPyramid() const;
+
+    /// also find the events of an event camera of contrast \p threshold in the next images,
+    /// timed by \p stepDuration seconds per physics step; read them back with cameraEvents()
+    void setEventOutput(bool enabled, float threshold, double stepDuration);
+
+    /// copy of the events of the last camera image, none if not requested
+    CameraEvents cameraEvents() const;
+
+    /// also count the pixels of each segmentation id seen in the next images, without reading
+    /// the mask back from renderers counting them on the GPU, and bound them if \p boxes; read
+    /// them with cameraPixelCounts()
+    void setVisibilityOutput(bool enabled, bool boxes = false);
+
+    /// copy of the pixel counts and boxes of the last camera image, none if not requested
+    CameraPixelCounts cameraPixelCounts() const;
+
+    /// a point of a link projected into the images, see setKeypoints
+    struct Keypoint {
+        int body;
+        int link;
+        Vector3f position; //<- in the frame of the link, that of its center of mass
+    };
+
+    /// project \p keypoints into the next images, replacing those from index \p first on;
+    /// points of links not in the scene are projected as NaN, read them with cameraKeypoints()
+    /// @return number of keypoints
+    int setKeypoints(int first, const std::vector<Keypoint>& keypoints);
+
+    /// copy of the keypoints projected into the last camera image, none if there were none
+    CameraKeypoints cameraKeypoints() const;
+
+    /// request the extra channels set in \p channels with the next images and drop the others,
+    /// bits of scene::OutputChannel among Points, Motion, Normals, DepthPyramid, Events,
+    /// Visibility and Boxes, which implies Visibility;
+    /// points keep their frame, the pyramid its last number of levels and events their threshold;
+    /// Mask selects mask-only images: images with a mask and none of the extra channels needing
+    /// depth or color draw and read back the mask alone, bullet getting zero color and far depth
+    void setOutputChannels(int channels);
+
+    /// extra channels requested with the next images, see setOutputChannels()
+    int outputChannels() const;
+
+    /// whether the images are rendered on a dedicated thread, see setAsyncMode()
+    bool asyncMode() const;
+
+    /// NUMA node of the async render thread, see setNumaNode()
+    int numaNode() const;
+
+    /// whether the frame cache is enabled, see setFrameCache()
+    bool frameCache() const;
+
+    /// whether objects are synced once per physics step, see setStepSync()
+    bool stepSync() const;
+
+    /// quality tier of the next images, see setQuality()
+    scene::Quality quality() const;
+
+    /// number of camera images served from the frame cache
+    uint64_t frameCacheHits() const;
+
+    /// number of camera images rendered while the frame cache was enabled
+    uint64_t frameCacheMisses() const;
+
+    /// durations of the steps of the camera images, safe to read while rendering
+    const std::shared_ptr<render::StageStats>& stageStats() const { return _stageStats; }
+
+    /// memory of the scene assets, renderer and frame buffers of the client, nodes optional
+    MemoryReport memoryReport(bool withNodes = true) const;
+
+    /// account the assets of the scene graph, e.g. across all clients
+    void accountAssets(scene::MemoryAccounting& accounting) const;
+
+    /// physics client shown with the spans of this interface in traces
+    void setClientId(int clientId) { _clientId = clientId; }
+
+    /// mark the start of a physics step in the trace, if recording
+    void beginStep();
+
+    /// mark the end of a physics step in the trace, if recording
+    void endStep();
+
+    /// color and texture change of changeShapeMaterials
+    struct MaterialChange {
+        int body;
+        int link;
+        int shape; //<- shape index within the link, -1 for all shapes of the link
+        int texture; //<- texture unique id, -1 for none, -2 to keep the texture
+        double rgba[4]; //<- color, a negative alpha to keep the color
+    };
+
+    /// change the colors and textures of many shapes at once, looking up the changed shapes only;
+    /// changes of unknown links or textures are skipped
+    /// @return number of changed shapes
+    int changeShapeMaterials(const std::vector<MaterialChange>& changes);
+
+    /// user segmentation ids of changeSegmentationIds
+    struct SegmentationChange {
+        int body;
+        int link;
+        int shape; //<- shape index within the link, -1 for the link itself
+        int instance; //<- instance id, -1 for that of the link, or none
+        int semantic; //<- semantic class id, -1 for that of the link, or none
+    };
+
+    /// set the user ids drawn into the masks of the Instance and Semantic segmentation modes;
+    /// kept for links imported later, until resetSimulation
+    /// @return number of changed links already in the scene
+    int changeSegmentationIds(const std::vector<SegmentationChange>& changes);
+
+    /// visibility layers of changeVisibilityLayers
+    struct LayerChange {
+        int body;
+        int link;
+        int shape; //<- shape index within the link, -1 for the link itself
+        uint32_t layers; //<- bitmask of scene::VisibilityLayers, kAll for all layers
+    };
+
+    /// set the visibility layers of links or shapes, drawn only by the cameras seeing one of
+    /// them; kept for links imported later, until resetSimulation
+    /// @return number of changed links already in the scene
+    int changeVisibilityLayers(const std::vector<LayerChange>& changes);
+
+    /// layers the cameras of the next images see, see scene::SceneView::cameraLayers()
+    void setCameraLayers(uint32_t layers);
+
+    /// layers the cameras of the next images see, see setCameraLayers()
+    uint32_t cameraLayers() const;
+
+    /// values drawn into the segmentation masks, kept across resets
+    void setSegmentationMode(scene::SegmentationMode mode);
+
+    /// freeze the nodes of some bodies at their current poses into a layer other clients can
+    /// share, see setBaseLayer()
+    /// @throw std::invalid_argument - if a node of the bodies has no pose yet
+    std::shared_ptr<scene::SceneLayer> makeBaseLayer(const std::set<int>& bodies);
+
+    /// draw \p layer under the scene in place of the nodes of \p bodies, its own bodies if
+    /// empty; renderers not drawing layers keep drawing the nodes, null to stop
+    void setBaseLayer(const std::shared_ptr<const scene::SceneLayer>& layer,
+                      const std::set<int>& bodies);
+
+    /// register a texture wrapping \p bitmap without copying it, its id is usable wherever
+    /// texture unique ids are, like the ones of registerTexture
+    int registerTexture(const std::shared_ptr<scene::Bitmap>& bitmap);
+
+    /// notify that the pixels of a texture were rewritten in place, renderers upload them
+    /// again with the next image
+    /// @return number of nodes using the texture, -1 for unknown textures
+    int changeTexels(int textureId);
+
+    /// draw rendered images with randomized materials and light, the scene graph is left as is;
+    /// null to stop, each sample is appended to \p logPath as a line of json unless empty
+    void setRandomization(const std::shared_ptr<scene::Randomization>& randomization,
+                          const std::string& logPath);
+
+    /// start the next episode of a per-episode randomization, return its index
+    uint64_t nextRandomizationEpisode();
+
+    /// render several cameras at once with the next copyCameraImageData call,
+    /// images are written to the \p frames buffers instead of the bullet ones, kept alive by
+    /// \p owner until the batch is replaced; empty to clear the batch
+    /// @return owner of the previous batch, for the caller to release out of the lock
+    std::shared_ptr<const void>
+        setCameraBatch(const std::vector<std::shared_ptr<scene::Camera>>& cameras,
+                       const std::vector<render::FrameData>& frames,
+                       std::shared_ptr<const void> owner = nullptr);
+
+    /// render a camera straight into the color, depth and mask buffers of \p frame, as a
+    /// camera image request with these matrices would, without going through the physics
+    /// server nor the frame cache; false without renderer and in async mode, whose renderer
+    /// would hand out the frame of an earlier request
+    bool renderCamera(const Matrix4f& viewMatrix, const Matrix4f& projMatrix,
+                      const render::FrameData& frame);
+
+    /// render the next camera image request at \p cols x \p rows and serve it encoded with
+    /// render::encodeFrame, as the bytes of a uint32 size followed by the encoded frame packed
+    /// into the colors then masks of this and following requests of height 1, until one of
+    /// them reaches the end of the bytes
+    void requestEncodedFrame(int cols, int rows);
+
+    /// publish each newly rendered frame of the ring size into \p sink, null to stop
+    void setFrameSink(const std::shared_ptr<FrameRing>& sink);
+
+    /// render camera image requests at the size of \p ring, null to stop, and publish them
+    /// into it: the bullet image then only holds the frame sequence number, its low 32 bits
+    /// in the color of the first pixel and its high 32 bits in the mask
+    void setBulkTransfer(const std::shared_ptr<FrameRing>& ring);
+
+    /// encode the frames of a camera into \p sink, null to stop: -1 for the requested camera,
+    /// otherwise the index of a camera set with setCameraBatch
+    void setVideoSink(int camera, const std::shared_ptr<VideoSink>& sink);
+
+    /// write each frame of the requested camera and of camera batches into \p recorder,
+    /// null to stop
+    void setRecorder(const std::shared_ptr<FrameRecorder>& recorder);
+
     /// given a URDF link, convert all visual shapes into internal renderer (loading graphics
     /// meshes, textures etc)
     /// use the collisionObjectUid as a unique identifier to synchronize the world transform and to
@@ -125,7 +485,8 @@ class RenderingInterface : public UrdfRenderingInterface
     /// render an image using the provided view and projection matrix
     void render(const float viewMat[16], const float projMat[16]) override;
 
-    /// load a texture from file, in png or other popular/supported format
+    /// load a texture from file, in png or other popular/supported format, read through fileIO
+    /// if it is not on disk
     // int loadTextureFile(const char* filename);
     int loadTextureFile(const char* filename, struct CommonFileIOInterface* fileIO) override;
 
@@ -144,19 +505,280 @@ class RenderingInterface : public UrdfRenderingInterface
     // cameraTarget[3]) const;
 
   private:
+    /// set renderer, with the lock held
+    void setRendererLocked(const std::shared_ptr<render::BaseRenderer>& renderer);
+
+    /// light settings of the next image, the default light until changed
+    scene::Light& requestedLight();
+
+    /// pass scene changes, light and camera to the renderer
+    void syncScene();
+
+    /// apply the poses synced since the last flush and record the syncTransform calls as one
+    /// span of the trace
+    void flushSyncBurst();
+
+    /// convert the transforms synced since the last flush and update the scene state
+    void applySyncedPoses();
+
+    /// decide how the camera image being requested is served, see setRenderSchedule()
+    void scheduleRequest();
+
+    /// bytes of the frame buffers of the interface
+    size_t frameBytes() const;
+
+    /// update the high-water mark of the memory, with the lock held
+    void updateMemoryPeak();
+
+    /// set the randomized materials and light of the view, drawing a new sample if needed
+    void randomizeView();
+
+    /// render the requested camera into the frame cache, unless it already holds that frame,
+    /// only the region of interest of the image if withRoi
+    void renderCachedFrame(int cols, int rows, bool withMask, bool withRoi = false);
+
+    /// render cameras set with setCameraBatch
+    void renderCameraBatch();
+
+    /// render the frame requested with requestEncodedFrame and encode it
+    void renderEncodedFrame(bool withMask);
+
+    /// render the requested camera at the frame sink size, keep the sequence of the frame
+    void renderBulkFrame(bool withMask);
+
+    /// copy a chunk of an image holding the sequence of the bulk frame
+    void copyBulkSequence(unsigned char* pixelsRGBA, int rgbaBufferSizeInPixels,
+                          float* depthBuffer, int depthBufferSizeInPixels, int* maskBuffer,
+                          int maskSizeInPixels, int startPixelIndex, int width, int height,
+                          int* numPixelsCopied);
+
+    /// copy a chunk of the encoded bytes, return false once the end was copied
+    bool copyEncodedFrame(unsigned char* pixelsRGBA, int rgbaBufferSizeInPixels,
+                          float* depthBuffer, int depthBufferSizeInPixels, int* maskBuffer,
+                          int maskSizeInPixels, int startPixelIndex, int width, int height,
+                          int* numPixelsCopied);
+
+    /// push a frame to the video sink of a camera and to the recorder, if any
+    void recordFrame(int camera, const render::FrameData& frame);
+
+    /// register a cached texture, return its id, with _mutex held
+    int appendTexture(const std::shared_ptr<scene::Texture>& texture);
+
+    /// add a node to the scene, keeping the node of a warm reset if it has the same shapes
+    void appendNode(int nodeId, scene::Node&& node);
+
+    /// remove the nodes of a warm reset not loaded again
+    void dropRetiredNodes();
+
+    /// add a node to the scene graph and state, at the pose last synced for it
+    void insertNode(int nodeId, scene::Node&& node);
+
+    /// add the staged nodes whose assets are loaded, within the upload budget unless waiting
+    void admitStagedNodes();
+
+    /// add a staged node at once, e.g. before it changes
+    void admitStagedNode(int nodeId);
+
+    /// move the nodes of the base layer bodies out of the scene while the renderer draws the
+    /// layer, back into it otherwise
+    void applyBaseLayer();
+
+    /// link to convert, copied out of the URDF model given to convertVisualShapes
+    struct PendingLink {
+        int nodeId;
+        int bodyUniqueId;
+        int linkIndex;
+        btTransform localInertiaFrame;
+        std::vector<UrdfShape> shapes; //<- visual shapes, or collision ones if there are none
+        std::vector<UrdfMaterial> materials; //<- of each shape
+        bool collision; //<- shapes are the collision ones, drawn with a shared palette
+        std::string sourceFile; //<- model file, empty if not loaded from a file
+        int flags; //<- URDF loading options
+        bool fixedBase; //<- classified static from its first pose on
+    };
+
+    /// shapes of a link, from the asset cache if converted before; thread-safe
+    std::vector<scene::Shape> convertLink(const PendingLink& link);
+
+    /// add the node of a converted link, false if it has nothing to render
+    bool appendLink(const PendingLink& link, std::vector<scene::Shape>&& sceneShapes);
+
+    /// convert the links queued in deferred mode and append their nodes
+    void convertPendingLinks();
+
+    /// make an unseen object the node of the first imported link at its pose, if any
+    void matchImportedLink(int nodeId, const btTransform& worldTransform);
+
+    mutable std::mutex _mutex; //<- serializes rendering and calls from the bindings
     std::shared_ptr<render::BaseRenderer> _renderer;
+    bool _asyncMode; //<- _renderer is wrapped into an AsyncRenderer
+    int _numaNode; //<- of the AsyncRenderer thread, -1 for that of the GPU
 
     int _flags;
-    bool _syncSceneGraph;
-    bool _syncMaterials;
+    bool _syncSceneGraph; //<- full scene update required
+    bool _warmReset; //<- resetAll() retires the nodes instead of clearing the scene
+    bool _deferredConversion; //<- convertVisualShapes queues the links into _pendingLinks
+    std::vector<PendingLink> _pendingLinks; //<- in the order bullet converted them
+    std::set<int> _retiredNodes; //<- nodes of the scene before a warm reset, not loaded again yet
+    bool _stagedLoading; //<- appendNode() stages the new nodes until their assets are loaded
+    bool _stagedWait; //<- images wait for all the staged nodes
+    double _uploadBudget; //<- seconds of uploads per image for the staged nodes
+    std::map<int, scene::Node> _stagedNodes; //<- node id -> node waiting for its assets
+    std::shared_ptr<const scene::SceneLayer> _baseLayer;
+    std::set<int> _layerBodies; //<- bodies drawn by the base layer
+    std::map<int, scene::Node> _layerNodes; //<- node id -> node out of the scene, see applyBaseLayer
+    /// render-side state saved along a bullet state, see saveSnapshot()
+    struct Snapshot {
+        std::shared_ptr<const scene::SceneState::Snapshot> poses;
+        std::shared_ptr<scene::MaterialOverrides> randomMaterials;
+        uint64_t randomIndex;
+        uint64_t randomGeneration;
+    };
+    std::map<int, Snapshot> _snapshots; //<- bullet state id -> snapshot
     std::shared_ptr<scene::SceneGraph> _sceneGraph;
     std::shared_ptr<scene::SceneState> _sceneState;
     std::shared_ptr<scene::SceneView> _sceneView;
-    std::shared_ptr<scene::Light> _light;
-    std::shared_ptr<scene::Camera> _camera;
+    std::shared_ptr<scene::Light> _light; //<- light settings of the next image, null if none
+    std::shared_ptr<scene::Light> _viewLight; //<- light of the last image, kept while unchanged
+    std::shared_ptr<scene::Camera> _camera; //<- camera of the next image, null if none
+    std::shared_ptr<scene::Camera> _projector; //<- matrices of the projective texture mode
+    bool _projectiveTexture = false; //<- ER_USE_PROJECTIVE_TEXTURE for the next image
+    std::vector<Matrix4f> _multiviewPoses; //<- of the other views of the next images
+    // objects reused by the lights and cameras of the images, see pooledObject()
+    std::array<std::shared_ptr<scene::Light>, 2> _lightPool;
+    std::array<std::shared_ptr<scene::Camera>, 2> _cameraPool;
+    std::array<std::shared_ptr<scene::Light>, 2> _randomLightPool;
+    std::vector<scene::Camera> _registeredCameras; //<- handle -> camera of its intrinsics
+    int _selectedCamera; //<- handle of the camera of the next images, -1 if none
     std::vector<std::shared_ptr<scene::Texture>> _textures;
+    std::map<const scene::Texture*, int> _textureIds;
+    std::vector<std::shared_ptr<scene::Camera>> _batchCameras;
+    std::vector<render::FrameData> _batchFrames;
+    std::shared_ptr<const void> _batchOwner; //<- buffers of the last batch, until replaced
+    std::shared_ptr<FrameRing> _frameSink;
+    bool _bulkTransfer; //<- requests are served through _frameSink
+    std::map<int, std::shared_ptr<VideoSink>> _videoSinks; //<- camera index -> sink
+    std::shared_ptr<FrameRecorder> _recorder;
+    // randomization of the view
+    std::shared_ptr<scene::Randomization> _randomization;
+    std::vector<std::shared_ptr<scene::Texture>> _randomAtlas; //<- textures of its texture ids
+    std::ofstream _randomLog;
+    uint64_t _randomIndex; //<- episode or frame of the sample
+    uint64_t _randomGeneration; //<- scene graph generation of the sampled materials
+    std::shared_ptr<scene::MaterialOverrides> _randomMaterials; //<- null until sampled
+
+    // frame rendered on the first chunk of a transfer, copied to bullet buffers chunk by chunk
+    bool _frameCached;
+    int _frameCols;
+    int _frameRows;
+    // page-locked, read back into without a staging copy and reused across frames
+    render::PinnedVector<uint8_t> _frameColor;
+    render::PinnedVector<float> _frameDepth;
+    render::PinnedVector<int> _frameMask;
+    Vector4i _roi; //<- region of interest of the images, unclipped
+    bool _pointOutput; //<- points requested with the images
+    std::vector<float> _framePoints;
+    std::vector<int> _framePointIds;
+    int _frameNumPoints; //<- -1 if the frame has no points
+    bool _motionOutput; //<- motion requested with the images
+    std::vector<uint16_t> _frameMotion; //<- empty if the frame has no motion
+    // camera and poses of the last image rendered with motion, null before the first one
+    std::shared_ptr<scene::Camera> _motionCamera;
+    std::shared_ptr<scene::SceneState> _motionState;
+    bool _normalOutput; //<- normals requested with the images
+    std::vector<uint16_t> _frameNormals; //<- empty if the frame has no normals
+    int _depthPyramidLevels; //<- levels requested with the images, 0 for none
+    std::vector<float> _frameDepthPyramid; //<- empty if the frame has no pyramid
+    bool _eventOutput; //<- events requested with the images
+    double _eventStepDuration; //<- seconds per physics step of the event times
+    std::vector<float> _frameEvents; //<- room for an event per pixel
+    int _frameNumEvents; //<- -1 if the frame has no events
+    render::EventCamera _eventCamera; //<- reference of the events found on the CPU
+    bool _visibilityOutput; //<- pixel counts requested with the images
+    std::vector<int> _framePixelCounts; //<- room for an id per pixel
+    std::vector<int> _scratchMask; //<- mask counted on the CPU when the images have none
+    int _frameNumPixelCounts; //<- -1 if the frame has no pixel counts
+    bool _boxOutput; //<- boxes requested with the pixel counts
+    bool _maskOnly; //<- images draw the mask alone, see setOutputChannels()
+    bool _frameMaskOnly; //<- the frame planes hold a mask-only image, cleared color and depth
+    uint32_t _cameraLayers; //<- layers the cameras see, see setCameraLayers()
+    std::vector<int> _frameBoxes; //<- room for a box per pixel
+    std::vector<Keypoint> _keypoints; //<- projected into the images
+    // keypoints of the view by node, rebuilt as the keypoints or the scene graph change
+    std::shared_ptr<scene::Keypoints> _viewKeypoints;
+    uint64_t _keypointGeneration; //<- of the scene graph _viewKeypoints were resolved in
+    std::vector<float> _frameKeypoints; //<- empty if the frame has no keypoints
+    uint64_t _frameSequence; //<- sequence of the cached frame in _frameSink, 0 if not published
+    uint64_t _noiseFrame; //<- frames rendered, the frame index of sensor noise
+    // frame cache key and statistics
+    bool _frameCacheEnabled;
+    uint64_t _frameGraphGeneration;
+    uint64_t _frameStateGeneration;
+    scene::SceneView _frameView;
+    uint64_t _frameCacheHits;
+    uint64_t _frameCacheMisses;
+    std::shared_ptr<render::StageStats> _stageStats; //<- current while serving camera images
+    // memory high-water mark
+    uint64_t _memoryGeneration; //<- scene graph generation of _assetBytes
+    size_t _assetBytes;
+    size_t _memoryPeak;
+    // trace spans, see render::Trace
+    int _clientId; //<- -1 until registered
+    uint64_t _stepStart; //<- start of the physics step, 0 if not in a step
+    uint64_t _syncBurstStart; //<- first syncTransform since the last flush
+    uint64_t _syncBurstEnd;
+    int _syncBurstCount; //<- syncTransform calls since the last flush
+    // encoded transfer
+    int _encodeCols; //<- size of the requested encoded frame, 0 if none
+    int _encodeRows;
+    bool _encodedPending; //<- _encoded is being transferred
+    std::vector<uint8_t> _encoded; //<- size prefix and encoded frame
 
     // bullet-specific data
-    std::map<int, std::vector<struct b3VisualShapeData>> _visualShapes;
-    std::map<std::pair<int, int>, int> _objectIndices;
+    VisualShapeIndex _visualShapes; //<- shape data and nodes of the links
+    /// (body, link, shape) -> user (instance, semantic) ids, applied to nodes as they are appended
+    std::map<std::tuple<int, int, int>, std::pair<int, int>> _segmentationIds;
+    /// (body, link, shape) -> visibility layers, applied to nodes as they are appended
+    std::map<std::tuple<int, int, int>, uint32_t> _visibilityLayers;
+    /// last transform synced for a node
+    struct SyncedTransform {
+        btTransform frame;
+        btVector3 scale;
+        int unchangedSyncs; //<- consecutive syncs without change
+        bool fixedBase; //<- base of a fixed-base body, static once synced without change
+        uint64_t step; //<- _syncStep of the last sync
+    };
+    std::map<int, SyncedTransform> _syncedTransforms;
+    bool _stepSync; //<- objects synced once per physics step, see setStepSync()
+    uint64_t _syncStep; //<- physics steps since the interface was created
+    // moved transforms synced since the last flush, converted at once by applySyncedPoses()
+    std::vector<int> _pendingIds;
+    std::vector<btTransform> _pendingFrames;
+    std::vector<btVector3> _pendingScales;
+    std::vector<Affine3f> _pendingPoses;
+    std::vector<char> _pendingFirst; //<- first pose of the node, never interpolated
+    // render schedule, see setRenderSchedule()
+    enum class Schedule {
+        Undecided, //<- no camera image requested since the last one
+        Render,    //<- synced and rendered
+        Snapshot,  //<- synced for the interpolation of the next frame, the last frame returned
+        Skip,      //<- not synced, the last frame returned
+    };
+    Schedule _schedule; //<- of the camera image being requested
+    double _framePeriod; //<- physics steps per rendered frame, 0 to render all images
+    bool _interpolatePoses;
+    uint64_t _stepCount; //<- physics steps since the schedule was set
+    double _nextFrameStep; //<- step the next frame is due at
+    double _frameStep; //<- step the poses of the last rendered frame are at
+    double _syncedStep; //<- step of the last synced camera image, -1 if none
+    float _poseBlend; //<- weight of the synced poses over the previous ones, 1 to apply them
+    std::vector<std::pair<int, Affine3f>> _blendedPoses; //<- synced poses of interpolated nodes
+    // static classification, see setStaticClassification()
+    int _staticSyncs; //<- unchanged syncs before a node is static, 0 for never
+    bool _staticFixedBases;
+    std::set<int> _fixedBases; //<- fixed-base nodes not synced yet
+    std::vector<int> _pendingStatic; //<- classified static once the pending poses are applied
+    // bodies loaded before the plugin, see importLinks()
+    std::vector<ImportedLink> _importedLinks; //<- not matched yet
+    bool _importSynced; //<- objects were synced since the links were imported
 };
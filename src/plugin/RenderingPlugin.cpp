@@ -4,7 +4,9 @@
 
 // local imports
 #include "RenderingPlugin.h"
+#include "AssetCache.h"
 #include "RenderingInterface.h"
+#include <render/Trace.h>
 
 // bullet imports
 #include <SharedMemory/SharedMemoryPublic.h>
@@ -12,14 +14,177 @@
 
 // std imports
 #include <algorithm>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
 
 /**
  * @brief Global map physicsClientId -> RenderingingInterface
  *
+ * Read-mostly: lookups share gRegistryMutex just long enough to copy the interface pointer, so
+ * that a call waiting for the lock of an interface never blocks exitPlugin_RenderingPlugin.
+ * An unloaded interface is deleted with its last call in flight. Calls into an interface are
+ * serialized by its own lock, those of different clients may run concurrently.
+ */
+static std::map<int, std::shared_ptr<RenderingInterface>> gRenderingInterfaces;
+static std::shared_timed_mutex gRegistryMutex;
+
+// taken across fork() so that children inherit the registry unlocked, their renderers and
+// clients are those of the parent and must be replaced before they render
+static const int gForkHandlers = pthread_atfork([] { gRegistryMutex.lock(); },
+                                                [] { gRegistryMutex.unlock(); },
+                                                [] { gRegistryMutex.unlock(); });
+
+/**
+ * @brief Call \p function with the interface of a client
+ *
+ * @throw std::out_of_range - if no interface is registered for the client
+ */
+template <class Function>
+static auto withInterface(int physicsClientId, const Function& function)
+{
+    std::shared_ptr<RenderingInterface> render;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(gRegistryMutex);
+        const auto it = gRenderingInterfaces.find(physicsClientId);
+        if (it == gRenderingInterfaces.end())
+            throw std::out_of_range("No rendering plugin registered for physics client " +
+                                    std::to_string(physicsClientId));
+        render = it->second;
+    }
+    return function(*render);
+}
+
+/**
+ * @brief Interface owned by a plugin context, shared with the registry
  */
-static std::map<int, RenderingInterface*> gRenderingInterfaces;
+static std::shared_ptr<RenderingInterface>& contextInterface(struct b3PluginContext* context)
+{
+    return *static_cast<std::shared_ptr<RenderingInterface>*>(context->m_userPointer);
+}
+
+/**
+ * @brief Get or set a runtime setting of a client, the "config <key>" command
+ *
+ * With ints the setting is changed and 0 returned, without it its current value is returned;
+ * -1 for unknown keys, invalid values and read-only keys given values. Keys and values:
+ * async, frame_cache, step_sync and trace [enabled]; channels [bits of the Points, Motion,
+ * Normals, DepthPyramid, Events, Visibility and Boxes output channels]; quality [tier], 0 for
+ * scene::Quality::Fast(), 1 for High(), read as 2 for other settings; asset_cache [max entries],
+ * prunes the cache of the process if it holds more, read as its entries; memory and memory_peak,
+ * read-only, in KiB; staged_nodes, read-only, nodes waiting for their assets; numa_node [node],
+ * of the async render thread, -1 for that of the GPU; layers [bits], visibility layers the
+ * cameras of the next images see.
+ */
+static int configCommand(RenderingInterface& render, const std::string& key,
+                         const struct b3PluginArguments* arguments)
+{
+    const bool set = arguments->m_numInts > 0;
+    const int value = set ? arguments->m_ints[0] : 0;
+    if (key == "async") {
+        if (!set)
+            return render.asyncMode();
+        render.setAsyncMode(value != 0);
+        return 0;
+    }
+    if (key == "numa_node") {
+        if (!set)
+            return render.numaNode();
+        if (value < -1)
+            return -1;
+        render.setNumaNode(value);
+        return 0;
+    }
+    if (key == "frame_cache") {
+        if (!set)
+            return render.frameCache();
+        render.setFrameCache(value != 0);
+        return 0;
+    }
+    if (key == "step_sync") {
+        if (!set)
+            return render.stepSync();
+        render.setStepSync(value != 0);
+        return 0;
+    }
+    if (key == "channels") {
+        const int extra = int(scene::OutputChannel::Points) | int(scene::OutputChannel::Motion) |
+                          int(scene::OutputChannel::Normals) |
+                          int(scene::OutputChannel::DepthPyramid) |
+                          int(scene::OutputChannel::Events) |
+                          int(scene::OutputChannel::Visibility) |
+                          int(scene::OutputChannel::Boxes) | int(scene::OutputChannel::Mask);
+        if (!set)
+            return render.outputChannels();
+        if (value & ~extra)
+            return -1;
+        render.setOutputChannels(value);
+        return 0;
+    }
+    if (key == "layers") {
+        if (!set)
+            return int(render.cameraLayers());
+        if (value < 0 || uint32_t(value) > scene::VisibilityLayers::kAll)
+            return -1;
+        render.setCameraLayers(uint32_t(value));
+        return 0;
+    }
+    if (key == "quality") {
+        if (!set) {
+            const auto quality = render.quality();
+            return quality == scene::Quality::Fast() ? 0
+                   : quality == scene::Quality::High() ? 1
+                                                       : 2;
+        }
+        if (value != 0 && value != 1)
+            return -1;
+        render.setQuality(value ? scene::Quality::High() : scene::Quality::Fast());
+        return 0;
+    }
+    if (key == "asset_cache") {
+        auto& cache = AssetCache::instance();
+        if (!set)
+            return cache.size();
+        if (value < 0)
+            return -1;
+        if (cache.size() > value)
+            cache.prune();
+        return 0;
+    }
+    if (key == "trace") {
+        if (!set)
+            return render::Trace::enabled();
+        if (value != 0) {
+            const char* tracePath = std::getenv("PYBULLET_RENDERING_TRACE");
+            render::Trace::start(tracePath ? tracePath : "");
+            return 0;
+        }
+        return render::Trace::stop() ? 0 : -1;
+    }
+    if (key == "staged_nodes") {
+        if (set)
+            return -1;
+        return render.stagedNodes();
+    }
+    if (key == "memory" || key == "memory_peak") {
+        if (set)
+            return -1;
+        const auto report = render.memoryReport(false);
+        const size_t bytes = key == "memory" ? report.totalBytes : report.peakBytes;
+        return int(std::min<size_t>(bytes >> 10, INT32_MAX));
+    }
+    return -1;
+}
 
 /**
  * @brief Set renderer for a specific client
@@ -27,47 +192,926 @@ static std::map<int, RenderingInterface*> gRenderingInterfaces;
  */
 void gSetRenderer(const std::shared_ptr<render::BaseRenderer>& renderer, int physicsClientId)
 {
-    gRenderingInterfaces.at(physicsClientId)->setRenderer(renderer);
+    withInterface(physicsClientId,
+                  [&](RenderingInterface& render) { render.setRenderer(renderer); });
+}
+
+/**
+ * @brief Add the links of the bodies a specific client loaded before the plugin
+ *
+ */
+void gImportLinks(std::vector<ImportedLink> links, int physicsClientId)
+{
+    withInterface(physicsClientId,
+                  [&](RenderingInterface& render) { render.importLinks(std::move(links)); });
+}
+
+/**
+ * @brief Render several cameras with the next camera image request of a specific client
+ *
+ */
+std::shared_ptr<const void> gSetCameraBatch(
+    const std::vector<std::shared_ptr<scene::Camera>>& cameras,
+    const std::vector<render::FrameData>& frames, const std::shared_ptr<const void>& owner,
+    int physicsClientId)
+{
+    return withInterface(physicsClientId, [&](RenderingInterface& render) {
+        return render.setCameraBatch(cameras, frames, owner);
+    });
+}
+
+/**
+ * @brief Render a camera of a specific client into caller buffers, bypassing the physics server
+ *
+ */
+bool gRenderCamera(const Matrix4f& viewMatrix, const Matrix4f& projMatrix,
+                   const render::FrameData& frame, int physicsClientId)
+{
+    return withInterface(physicsClientId, [&](RenderingInterface& render) {
+        return render.renderCamera(viewMatrix, projMatrix, frame);
+    });
+}
+
+/**
+ * @brief Publish rendered frames of a specific client into a shared-memory ring
+ *
+ */
+void gSetFrameSink(const std::string& name, int cols, int rows, int numSlots,
+                   int physicsClientId)
+{
+    const auto sink = name.empty() ? nullptr : FrameRing::create(name, cols, rows, numSlots);
+    withInterface(physicsClientId,
+                  [&](RenderingInterface& render) { render.setFrameSink(sink); });
+}
+
+/**
+ * @brief Randomize materials and light of the images of a specific client, null to stop
+ *
+ */
+void gSetRandomization(const std::shared_ptr<scene::Randomization>& randomization,
+                       const std::string& logPath, int physicsClientId)
+{
+    withInterface(physicsClientId, [&](RenderingInterface& render) {
+        render.setRandomization(randomization, logPath);
+    });
+}
+
+/**
+ * @brief Start the next randomization episode of a specific client, return its index
+ *
+ */
+uint64_t gNextRandomizationEpisode(int physicsClientId)
+{
+    return withInterface(physicsClientId, [](RenderingInterface& render) {
+        return render.nextRandomizationEpisode();
+    });
+}
+
+/**
+ * @brief Register a texture of a specific client wrapping a bitmap, return its id
+ *
+ */
+int gRegisterTexture(const std::shared_ptr<scene::Bitmap>& bitmap, int physicsClientId)
+{
+    return withInterface(physicsClientId, [&](RenderingInterface& render) {
+        return render.registerTexture(bitmap);
+    });
+}
+
+/**
+ * @brief Notify a specific client that the pixels of a texture changed, return its node count
+ *
+ */
+int gChangeTexels(int textureId, int physicsClientId)
+{
+    return withInterface(physicsClientId, [&](RenderingInterface& render) {
+        return render.changeTexels(textureId);
+    });
+}
+
+/**
+ * @brief Freeze the nodes of some bodies of a specific client into a shareable layer
+ *
+ */
+std::shared_ptr<scene::SceneLayer> gMakeBaseLayer(const std::set<int>& bodies, int physicsClientId)
+{
+    return withInterface(physicsClientId, [&](RenderingInterface& render) {
+        return render.makeBaseLayer(bodies);
+    });
+}
+
+/**
+ * @brief Draw a layer under the scene of a specific client in place of the nodes of some bodies
+ *
+ */
+void gSetBaseLayer(const std::shared_ptr<scene::SceneLayer>& layer, const std::set<int>& bodies,
+                   int physicsClientId)
+{
+    withInterface(physicsClientId,
+                  [&](RenderingInterface& render) { render.setBaseLayer(layer, bodies); });
+}
+
+/**
+ * @brief Frame cache hits and misses of a specific client
+ *
+ */
+std::pair<uint64_t, uint64_t> gGetFrameCacheStats(int physicsClientId)
+{
+    return withInterface(physicsClientId, [](const RenderingInterface& render) {
+        return std::make_pair(render.frameCacheHits(), render.frameCacheMisses());
+    });
+}
+
+/**
+ * @brief Points of the last camera image of a specific client
+ *
+ */
+CameraPoints gGetCameraPoints(int physicsClientId)
+{
+    return withInterface(physicsClientId,
+                         [](const RenderingInterface& render) { return render.cameraPoints(); });
+}
+
+/**
+ * @brief Motion of the last camera image of a specific client
+ *
+ */
+CameraMotion gGetCameraMotion(int physicsClientId)
+{
+    return withInterface(physicsClientId,
+                         [](const RenderingInterface& render) { return render.cameraMotion(); });
+}
+
+/**
+ * @brief Normals of the last camera image of a specific client
+ *
+ */
+CameraNormals gGetCameraNormals(int physicsClientId)
+{
+    return withInterface(physicsClientId,
+                         [](const RenderingInterface& render) { return render.cameraNormals(); });
+}
+
+/**
+ * @brief Depth pyramid of the last camera image of a specific client
+ *
+ */
+CameraDepthPyramid gGetCameraDepthPyramid(int physicsClientId)
+{
+    return withInterface(physicsClientId, [](const RenderingInterface& render) {
+        return render.cameraDepthPyramid();
+    });
+}
+
+/**
+ * @brief Events of the last camera image of a specific client
+ *
+ */
+CameraEvents gGetCameraEvents(int physicsClientId)
+{
+    return withInterface(physicsClientId,
+                         [](const RenderingInterface& render) { return render.cameraEvents(); });
+}
+
+/**
+ * @brief Pixels of each segmentation id seen in the last camera image of a specific client
+ *
+ */
+CameraPixelCounts gGetCameraPixelCounts(int physicsClientId)
+{
+    return withInterface(physicsClientId, [](const RenderingInterface& render) {
+        return render.cameraPixelCounts();
+    });
+}
+
+/**
+ * @brief Get the keypoints projected into the last camera image of a specific client
+ *
+ */
+CameraKeypoints gGetCameraKeypoints(int physicsClientId)
+{
+    return withInterface(physicsClientId, [](const RenderingInterface& render) {
+        return render.cameraKeypoints();
+    });
+}
+
+/**
+ * @brief Step the last frame of a specific client was rendered at, see setRenderSchedule
+ *
+ */
+double gGetFrameStep(int physicsClientId)
+{
+    return withInterface(physicsClientId,
+                         [](const RenderingInterface& render) { return render.frameStep(); });
+}
+
+/**
+ * @brief Durations of the steps of the camera images of a specific client, by stage
+ *
+ */
+std::vector<render::StageSummary> gGetStageStats(int physicsClientId)
+{
+    return withInterface(physicsClientId, [](const RenderingInterface& render) {
+        std::vector<render::StageSummary> summaries;
+        for (int stage = 0; stage < int(render::Stage::Count); ++stage)
+            summaries.push_back(render.stageStats()->summary(render::Stage(stage)));
+        return summaries;
+    });
+}
+
+/**
+ * @brief Memory of the scene assets, renderer and frame buffers of a specific client
+ *
+ */
+MemoryReport gGetMemoryReport(int physicsClientId)
+{
+    return withInterface(physicsClientId,
+                         [](const RenderingInterface& render) { return render.memoryReport(); });
+}
+
+/**
+ * @brief Memory of all clients, scene assets shared between clients counted once
+ *
+ */
+ProcessMemoryReport gGetProcessMemoryReport()
+{
+    std::vector<std::shared_ptr<RenderingInterface>> interfaces;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(gRegistryMutex);
+        for (const auto& it : gRenderingInterfaces)
+            interfaces.push_back(it.second);
+    }
+
+    ProcessMemoryReport report;
+    scene::MemoryAccounting accounting;
+    for (const auto& render : interfaces) {
+        const auto client = render->memoryReport(false);
+        render->accountAssets(accounting);
+        report.renderers.gpuBytes += client.renderer.gpuBytes;
+        report.renderers.peakGpuBytes += client.renderer.peakGpuBytes;
+        report.renderers.hostBytes += client.renderer.hostBytes;
+        report.frameBytes += client.frameBytes;
+        report.peakBytes += client.peakBytes;
+    }
+    // cached assets in use are already accounted, they are not counted as shared again
+    const auto sceneAssets = accounting.assets();
+    AssetCache::instance().account(accounting);
+    report.assets = accounting.assets();
+    report.assets.sharedBytes = sceneAssets.sharedBytes;
+    report.cachedBytes = report.assets.total() - sceneAssets.total();
+    report.totalBytes = report.assets.total() + report.renderers.gpuBytes +
+                        report.renderers.hostBytes + report.frameBytes;
+    report.clients = int(interfaces.size());
+    return report;
+}
+
+/**
+ * @brief Forget the durations of the steps of the camera images of a specific client
+ *
+ */
+void gResetStageStats(int physicsClientId)
+{
+    withInterface(physicsClientId,
+                  [](const RenderingInterface& render) { render.stageStats()->reset(); });
+}
+
+/**
+ * @brief Drop cached meshes and textures not used by any client
+ *
+ */
+void gPruneAssetCache()
+{
+    AssetCache::instance().prune();
+}
+
+/**
+ * @brief Asset ids of the cached meshes and textures, with the prune revision of the cache
+ *
+ */
+std::pair<std::vector<int>, uint64_t> gAssetCacheIds()
+{
+    auto& cache = AssetCache::instance();
+    const uint64_t revision = cache.revision(); //<- first, a later prune changes it again
+    return {cache.assetIds(), revision};
+}
+
+/**
+ * @brief Prune revision of the asset cache
+ *
+ */
+uint64_t gAssetCacheRevision()
+{
+    return AssetCache::instance().revision();
+}
+
+/**
+ * @brief Load mesh and image files into the asset cache before forking workers
+ *
+ */
+int gPreloadAssets(const std::vector<std::string>& filenames)
+{
+    return AssetCache::instance().preload(filenames);
+}
+
+/**
+ * @brief Start recording a trace of all clients, written to \p path when stopped or unloaded
+ *
+ */
+void gStartTrace(const std::string& path)
+{
+    render::Trace::start(path);
+}
+
+/**
+ * @brief Stop recording and write the trace to the path it was started with, if any
+ *
+ */
+bool gStopTrace()
+{
+    return render::Trace::stop();
+}
+
+/**
+ * @brief Write the trace recorded so far, to the path it was started with if \p path is empty
+ *
+ */
+bool gWriteTrace(const std::string& path)
+{
+    return render::Trace::write(path);
+}
+
+/**
+ * @brief Events dropped since the trace was started
+ *
+ */
+uint64_t gTraceDroppedEvents()
+{
+    return render::Trace::droppedEvents();
+}
+
+/**
+ * @brief Start capturing the camera images slower than a threshold into \p directory
+ *
+ */
+void gCaptureTraceOutliers(const std::string& directory, int frames, double thresholdMs,
+                           double medianFactor)
+{
+    render::Trace::startCapture(directory, frames, thresholdMs, medianFactor);
+}
+
+/**
+ * @brief Outliers written since the capture started
+ *
+ */
+int gTraceCapturedFrames()
+{
+    return render::Trace::capturedFrames();
+}
+
+/**
+ * @brief Client announced by the thread about to load the plugin, registered by the load itself
+ *
+ * A DIRECT client loads the plugin on the calling thread, whose interface is then registered
+ * without the "register" command. Other connections load it on a server thread, which sees no
+ * announcement, and fall back to the command.
+ */
+struct Announcement {
+    int client = -1;
+    bool registered = false;
+};
+static thread_local Announcement gAnnouncement;
+
+/**
+ * @brief Announce the client of the next plugin load on this thread
+ *
+ */
+void gAnnounceClient(int physicsClientId)
+{
+    gAnnouncement = Announcement{physicsClientId, false};
+}
+
+/**
+ * @brief Whether the last plugin load on this thread registered the announced client
+ *
+ */
+bool gTakeRegistration(int physicsClientId)
+{
+    const bool registered =
+        gAnnouncement.registered && gAnnouncement.client == physicsClientId;
+    gAnnouncement = Announcement{};
+    return registered;
 }
 
 B3_SHARED_API int initPlugin_RenderingPlugin(struct b3PluginContext* context)
 {
-    auto render = new RenderingInterface();
-    context->m_userPointer = render;
+    // PYBULLET_RENDERING_TRACE records a trace from the start, written at unload
+    const char* tracePath = std::getenv("PYBULLET_RENDERING_TRACE");
+    if (tracePath && *tracePath && !render::Trace::enabled())
+        render::Trace::start(tracePath);
+    render::Trace::setThreadName("physics");
+
+    auto render = std::make_shared<RenderingInterface>();
+    if (gAnnouncement.client >= 0 && !gAnnouncement.registered) {
+        std::unique_lock<std::shared_timed_mutex> lock(gRegistryMutex);
+        gRenderingInterfaces.emplace(gAnnouncement.client, render);
+        render->setClientId(gAnnouncement.client);
+        gAnnouncement.registered = true;
+    }
+    context->m_userPointer = new std::shared_ptr<RenderingInterface>(std::move(render));
     return SHARED_MEMORY_MAGIC_NUMBER;
 }
 
 B3_SHARED_API void exitPlugin_RenderingPlugin(struct b3PluginContext* context)
 {
-    auto render = (RenderingInterface*)context->m_userPointer;
+    auto render = contextInterface(context);
 
-    auto it = std::find_if( //
-        begin(gRenderingInterfaces), end(gRenderingInterfaces),
-        [&render](const auto& it) { return it.second == render; });
-    if (it != end(gRenderingInterfaces))
-        gRenderingInterfaces.erase(it);
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(gRegistryMutex);
+        auto it = std::find_if( //
+            begin(gRenderingInterfaces), end(gRenderingInterfaces),
+            [&render](const auto& it) { return it.second == render; });
+        if (it != end(gRenderingInterfaces))
+            gRenderingInterfaces.erase(it);
+    }
 
-    delete render;
+    delete &contextInterface(context);
     context->m_userPointer = 0;
+
+    // keep recording for other clients, rewrite the file with all events so far
+    if (render::Trace::enabled())
+        render::Trace::write("");
+}
+
+B3_SHARED_API int preTickPluginCallback_RenderingPlugin(struct b3PluginContext* context)
+{
+    contextInterface(context)->beginStep();
+    return 0;
+}
+
+B3_SHARED_API int postTickPluginCallback_RenderingPlugin(struct b3PluginContext* context)
+{
+    contextInterface(context)->endStep();
+    return 0;
 }
 
 B3_SHARED_API UrdfRenderingInterface*
     getRenderInterface_RenderingPlugin(struct b3PluginContext* context)
 {
-    auto render = (RenderingInterface*)context->m_userPointer;
-    return render;
+    return contextInterface(context).get();
 }
 
 B3_SHARED_API int executePluginCommand_RenderingPlugin(struct b3PluginContext* context,
                                                        const struct b3PluginArguments* arguments)
 {
-    auto render = (RenderingInterface*)context->m_userPointer;
+    const auto& render = contextInterface(context);
 
     if (0 == strcmp(arguments->m_text, "register")) {
         int physicsClientId = arguments->m_ints[0];
+        std::unique_lock<std::shared_timed_mutex> lock(gRegistryMutex);
         gRenderingInterfaces.emplace(physicsClientId, render);
+        render->setClientId(physicsClientId);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "async")) {
+        render->setAsyncMode(arguments->m_numInts > 0 && arguments->m_ints[0] != 0);
         return 0;
     }
 
+    if (0 == strcmp(arguments->m_text, "materials")) {
+        // ints [body, link, shape, texture] and floats [r, g, b, a] per change, texture -2
+        // and a negative alpha keep the texture and color, missing floats keep the colors
+        const int count = arguments->m_numInts / 4;
+        if (arguments->m_numInts % 4 ||
+            (arguments->m_numFloats && arguments->m_numFloats != count * 4))
+            return -1;
+        std::vector<RenderingInterface::MaterialChange> changes(count);
+        for (int i = 0; i < count; ++i) {
+            auto& change = changes[i];
+            const int* ints = &arguments->m_ints[i * 4];
+            change = {ints[0], ints[1], ints[2], ints[3], {0., 0., 0., -1.}};
+            if (arguments->m_numFloats)
+                std::copy_n(&arguments->m_floats[i * 4], 4, change.rgba);
+        }
+        return render->changeShapeMaterials(changes);
+    }
+
+    if (0 == strcmp(arguments->m_text, "segmentation")) {
+        // ints [body, link, shape, instance, semantic] per change, shape -1 for the link
+        if (arguments->m_numInts % 5)
+            return -1;
+        std::vector<RenderingInterface::SegmentationChange> changes(arguments->m_numInts / 5);
+        for (int i = 0; i < int(changes.size()); ++i) {
+            const int* ints = &arguments->m_ints[i * 5];
+            changes[i] = {ints[0], ints[1], ints[2], ints[3], ints[4]};
+        }
+        return render->changeSegmentationIds(changes);
+    }
+
+    if (0 == strcmp(arguments->m_text, "visibility")) {
+        // ints [body, link, shape, layers] per change, shape -1 for the link
+        if (arguments->m_numInts % 4)
+            return -1;
+        std::vector<RenderingInterface::LayerChange> changes(arguments->m_numInts / 4);
+        for (int i = 0; i < int(changes.size()); ++i) {
+            const int* ints = &arguments->m_ints[i * 4];
+            if (ints[3] < 0)
+                return -1;
+            changes[i] = {ints[0], ints[1], ints[2], uint32_t(ints[3])};
+        }
+        return render->changeVisibilityLayers(changes);
+    }
+
+    if (0 == strcmp(arguments->m_text, "segmentation_mode")) {
+        // [mode]: 0 body and link, 1 instance ids, 2 semantic ids
+        if (arguments->m_numInts < 1 || arguments->m_ints[0] < 0 || arguments->m_ints[0] > 2)
+            return -1;
+        render->setSegmentationMode(scene::SegmentationMode(arguments->m_ints[0]));
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "encode")) {
+        if (arguments->m_numInts < 2)
+            return -1;
+        render->requestEncodedFrame(arguments->m_ints[0], arguments->m_ints[1]);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "bulk")) {
+        // ints [key, cols, rows, numSlots] open the ring "pybullet_rendering_bulk_<key>",
+        // no ints close it
+        if (arguments->m_numInts == 0) {
+            render->setBulkTransfer(nullptr);
+            return 0;
+        }
+        if (arguments->m_numInts < 4)
+            return -1;
+        try {
+            render->setBulkTransfer(FrameRing::create(
+                "pybullet_rendering_bulk_" + std::to_string(arguments->m_ints[0]),
+                arguments->m_ints[1], arguments->m_ints[2], arguments->m_ints[3]));
+        }
+        catch (const std::exception&) {
+            return -1;
+        }
+        return 0;
+    }
+
+    if (0 == strncmp(arguments->m_text, "video", 5) &&
+        (arguments->m_text[5] == 0 || arguments->m_text[5] == ' ')) {
+        // "video <encoder> <output>" with ints [camera, cols, rows, fps, segmentSeconds]
+        // starts encoding a camera, "video" with ints [camera] stops it
+        if (arguments->m_numInts < 1)
+            return -1;
+        const int camera = arguments->m_ints[0];
+        const std::string text = arguments->m_text;
+        const size_t encoderBegin = text.find_first_not_of(' ', 5);
+        if (encoderBegin == std::string::npos) {
+            render->setVideoSink(camera, nullptr);
+            return 0;
+        }
+        const size_t encoderEnd = text.find(' ', encoderBegin);
+        if (encoderEnd == std::string::npos || arguments->m_numInts < 4)
+            return -1;
+
+        VideoSink::Options options;
+        options.encoder = text.substr(encoderBegin, encoderEnd - encoderBegin);
+        options.output = text.substr(encoderEnd + 1);
+        options.cols = arguments->m_ints[1];
+        options.rows = arguments->m_ints[2];
+        options.fps = arguments->m_ints[3];
+        options.segmentSeconds = arguments->m_numInts > 4 ? arguments->m_ints[4] : 0;
+        try {
+            render->setVideoSink(camera, VideoSink::create(options));
+        }
+        catch (const std::exception&) {
+            return -1;
+        }
+        return 0;
+    }
+
+    if (0 == strncmp(arguments->m_text, "record", 6) &&
+        (arguments->m_text[6] == 0 || arguments->m_text[6] == ' ')) {
+        // "record <directory>" with ints [chunkFrames, compress, queueSize] starts recording,
+        // "record" stops it
+        const std::string text = arguments->m_text;
+        const size_t begin = text.find_first_not_of(' ', 6);
+        if (begin == std::string::npos) {
+            render->setRecorder(nullptr);
+            return 0;
+        }
+
+        FrameRecorder::Options options;
+        options.directory = text.substr(begin);
+        if (arguments->m_numInts > 0)
+            options.chunkFrames = arguments->m_ints[0];
+        if (arguments->m_numInts > 1)
+            options.compress = arguments->m_ints[1] != 0;
+        if (arguments->m_numInts > 2)
+            options.queueSize = size_t(std::max(arguments->m_ints[2], 0));
+        try {
+            render->setRecorder(FrameRecorder::create(options));
+        }
+        catch (const std::exception&) {
+            return -1;
+        }
+        return 0;
+    }
+
+    if (0 == strncmp(arguments->m_text, "config ", 7)) {
+        // "config <key>" with ints sets a setting, without reads it, see configCommand()
+        const std::string text = arguments->m_text;
+        const size_t begin = text.find_first_not_of(' ', 7);
+        if (begin == std::string::npos)
+            return -1;
+        return configCommand(*render, text.substr(begin), arguments);
+    }
+
+    if (0 == strcmp(arguments->m_text, "frame_cache")) {
+        render->setFrameCache(arguments->m_numInts > 0 && arguments->m_ints[0] != 0);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "step_sync")) {
+        // [enabled]: sync the poses once per physics step rather than per camera image
+        render->setStepSync(arguments->m_numInts > 0 && arguments->m_ints[0] != 0);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "static")) {
+        // [unchangedSyncs, fixedBases]: classify still nodes and fixed bases as static
+        render->setStaticClassification(arguments->m_numInts > 0 ? arguments->m_ints[0] : 0,
+                                        arguments->m_numInts > 1 && arguments->m_ints[1] != 0);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "warm_reset")) {
+        // [enabled]: keep the nodes loaded again after resetSimulation
+        render->setWarmReset(arguments->m_numInts > 0 && arguments->m_ints[0] != 0);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "render_schedule")) {
+        // floats [framePeriod], ints [interpolate]: render every framePeriod physics steps
+        render->setRenderSchedule(arguments->m_numFloats > 0 ? arguments->m_floats[0] : 0.,
+                                  arguments->m_numInts > 0 && arguments->m_ints[0] != 0);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "deferred_conversion")) {
+        // [enabled]: convert the links of an import in parallel before the next use of the scene
+        render->setDeferredConversion(arguments->m_numInts > 0 && arguments->m_ints[0] != 0);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "staged_loading")) {
+        // ints [enabled, wait], floats [uploadBudget]: add new nodes once their assets are loaded
+        render->setStagedLoading(arguments->m_numInts > 0 && arguments->m_ints[0] != 0,
+                                 arguments->m_numFloats > 0 ? arguments->m_floats[0] : 0.002,
+                                 arguments->m_numInts > 1 && arguments->m_ints[1] != 0);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "snapshot")) {
+        // [stateId]: save the render-side state along a bullet state, [stateId, 1]: restore it,
+        // [stateId, -1]: forget it
+        if (arguments->m_numInts < 1)
+            return -1;
+        const int stateId = arguments->m_ints[0];
+        const int action = arguments->m_numInts > 1 ? arguments->m_ints[1] : 0;
+        if (action > 0)
+            return render->restoreSnapshot(stateId) ? 0 : -1;
+        if (action < 0)
+            render->removeSnapshot(stateId);
+        else
+            render->saveSnapshot(stateId);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "camera")) {
+        // floats [projection matrix, model, k1, k2, k3, k4, p1, p2]: register a camera of these
+        // intrinsics and lens distortion, if any, returning its handle; ints [handle]: render
+        // the next images with its intrinsics, -1 for none
+        if (arguments->m_numFloats == 16 || arguments->m_numFloats == 23) {
+            float projMat[16];
+            std::copy_n(arguments->m_floats, 16, projMat);
+            scene::LensDistortion distortion;
+            if (arguments->m_numFloats == 23) {
+                const double* f = arguments->m_floats + 16;
+                if (f[0] < 0. || f[0] > int(scene::LensModel::Fisheye))
+                    return -1;
+                distortion.model = scene::LensModel(int(f[0]));
+                distortion.k1 = float(f[1]);
+                distortion.k2 = float(f[2]);
+                distortion.k3 = float(f[3]);
+                distortion.k4 = float(f[4]);
+                distortion.p1 = float(f[5]);
+                distortion.p2 = float(f[6]);
+            }
+            return render->registerCamera(projMat, distortion);
+        }
+        if (arguments->m_numInts < 1)
+            return -1;
+        return render->selectCamera(arguments->m_ints[0]) ? 0 : -1;
+    }
+
+    if (0 == strcmp(arguments->m_text, "projection")) {
+        // [projection]: perspective, cubemap or equirectangular images, see scene::Projection
+        if (arguments->m_numInts < 1 || arguments->m_ints[0] < 0 ||
+            arguments->m_ints[0] > int(scene::Projection::Equirectangular))
+            return -1;
+        render->setProjection(scene::Projection(arguments->m_ints[0]));
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "multiview")) {
+        // floats [pose, ...]: column-major poses of the other views of the next images in the
+        // frame of their camera, 16 floats each, none for single views
+        const int numViews = arguments->m_numFloats / 16;
+        if (arguments->m_numFloats % 16 || numViews >= scene::kMaxViews)
+            return -1;
+        std::vector<Matrix4f> poses(numViews);
+        for (int i = 0; i < numViews; ++i)
+            std::copy_n(arguments->m_floats + i * 16, 16, poses[i].data());
+        render->setMultiview(poses);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "roi")) {
+        // [x, y, width, height]: region of interest of the next images, of zero size for none
+        if (arguments->m_numInts < 4 || arguments->m_ints[2] < 0 || arguments->m_ints[3] < 0)
+            return -1;
+        render->setRoi({arguments->m_ints[0], arguments->m_ints[1], arguments->m_ints[2],
+                        arguments->m_ints[3]});
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "quality")) {
+        // [multisamples, shadows, specular, texture filter]: quality tier of the next images
+        if (arguments->m_numInts < 4 || arguments->m_ints[3] < 0 ||
+            arguments->m_ints[3] > int(scene::TextureFilter::Trilinear))
+            return -1;
+        scene::Quality quality;
+        quality.multisamples = arguments->m_ints[0];
+        quality.shadows = arguments->m_ints[1] != 0;
+        quality.specular = arguments->m_ints[2] != 0;
+        quality.textureFilter = scene::TextureFilter(arguments->m_ints[3]);
+        render->setQuality(quality);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "lights")) {
+        // ints [first, total], floats [type, x, y, z, dx, dy, dz, r, g, b, range, spot angle, ...]:
+        // point and spot lights of the next images from the first one, out of total
+        if (arguments->m_numInts < 2 || arguments->m_ints[0] < 0 ||
+            arguments->m_ints[1] < arguments->m_ints[0] || arguments->m_numFloats % 12)
+            return -1;
+        std::vector<scene::Light> lights(arguments->m_numFloats / 12);
+        for (size_t i = 0; i < lights.size(); ++i) {
+            float f[12];
+            std::copy_n(arguments->m_floats + i * 12, 12, f);
+            const auto type = scene::LightType(int(f[0]));
+            if (type != scene::LightType::PointLight && type != scene::LightType::SpotLight)
+                return -1;
+            auto& light = lights[i];
+            light.setType(type);
+            light.setDirection({f[4], f[5], f[6]});
+            light.setPosition({f[1], f[2], f[3]});
+            light.setColor({f[7], f[8], f[9]});
+            light.setRange(f[10]);
+            light.setSpotAngle(f[11]);
+        }
+        render->setLights(lights, arguments->m_ints[0], arguments->m_ints[1]);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "sensor_noise")) {
+        // [seed], floats [baseline, subpixel, axial sigma, edge dropout, edge threshold,
+        // vignetting, white balance r, g, b, shot noise, read noise]: noise of the next images
+        if (arguments->m_numInts < 1 || arguments->m_numFloats < 11)
+            return -1;
+        const double* f = arguments->m_floats;
+        scene::SensorNoise noise;
+        noise.baseline = float(f[0]);
+        noise.subpixel = float(f[1]);
+        noise.axialSigma = float(f[2]);
+        noise.edgeDropout = float(f[3]);
+        noise.edgeThreshold = float(f[4]);
+        noise.vignetting = float(f[5]);
+        noise.whiteBalance = {float(f[6]), float(f[7]), float(f[8])};
+        noise.shotNoise = float(f[9]);
+        noise.readNoise = float(f[10]);
+        noise.seed = uint32_t(arguments->m_ints[0]);
+        render->setSensorNoise(noise);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "render_scale")) {
+        // floats [scale]: internal resolution of the next images, 1 for their size
+        if (arguments->m_numFloats < 1 || !(arguments->m_floats[0] > 0.))
+            return -1;
+        render->setRenderScale(float(arguments->m_floats[0]));
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "points")) {
+        // [enabled, frame, compact]: XYZ points of the next images, see scene::PointFrame
+        if (arguments->m_numInts < 3 || arguments->m_ints[1] < 0 ||
+            arguments->m_ints[1] > int(scene::PointFrame::World))
+            return -1;
+        render->setPointOutput(arguments->m_ints[0] != 0, scene::PointFrame(arguments->m_ints[1]),
+                               arguments->m_ints[2] != 0);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "motion")) {
+        // [enabled]: motion of the pixels of the next images since the previous one
+        if (arguments->m_numInts < 1)
+            return -1;
+        render->setMotionOutput(arguments->m_ints[0] != 0);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "normals")) {
+        // [enabled]: camera frame normals of the pixels of the next images
+        if (arguments->m_numInts < 1)
+            return -1;
+        render->setNormalOutput(arguments->m_ints[0] != 0);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "depth_pyramid")) {
+        // [levels]: nearest and farthest depth of the next images at 1/2 to 1/2^levels, 0 for none
+        if (arguments->m_numInts < 1 || arguments->m_ints[0] < 0 || arguments->m_ints[0] > 16)
+            return -1;
+        render->setDepthPyramidOutput(arguments->m_ints[0]);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "events")) {
+        // [enabled], floats [threshold, step duration]: events of the next images since the
+        // previous one, of a change of log luminance of threshold, timed in seconds per step
+        if (arguments->m_numInts < 1 || arguments->m_numFloats < 2 ||
+            !(arguments->m_floats[0] > 0.) || !(arguments->m_floats[1] >= 0.))
+            return -1;
+        render->setEventOutput(arguments->m_ints[0] != 0, float(arguments->m_floats[0]),
+                               arguments->m_floats[1]);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "visibility")) {
+        // [enabled, boxes]: pixels of each segmentation id seen in the next images, and their
+        // bounds if boxes is given and nonzero
+        if (arguments->m_numInts < 1)
+            return -1;
+        render->setVisibilityOutput(arguments->m_ints[0] != 0,
+                                    arguments->m_numInts > 1 && arguments->m_ints[1] != 0);
+        return 0;
+    }
+
+    if (0 == strcmp(arguments->m_text, "keypoints")) {
+        // ints [first, then body, link per point] and floats [x, y, z] per point: points
+        // projected into the next images from index first on, those past them dropped
+        const int count = (arguments->m_numInts - 1) / 2;
+        if (arguments->m_numInts < 1 || (arguments->m_numInts - 1) % 2 ||
+            arguments->m_numFloats != count * 3)
+            return -1;
+        std::vector<RenderingInterface::Keypoint> keypoints(count);
+        for (int i = 0; i < count; ++i) {
+            const double* xyz = &arguments->m_floats[i * 3];
+            keypoints[i] = {arguments->m_ints[1 + i * 2], arguments->m_ints[2 + i * 2],
+                            {float(xyz[0]), float(xyz[1]), float(xyz[2])}};
+        }
+        return render->setKeypoints(arguments->m_ints[0], keypoints);
+    }
+
+    if (0 == strcmp(arguments->m_text, "stats")) {
+        // [stage, percentile]: percentile of the last durations of a stage in microseconds, -1
+        // if none; [stage]: number of samples; no arguments: reset
+        auto& stats = *render->stageStats();
+        if (arguments->m_numInts < 1) {
+            stats.reset();
+            return 0;
+        }
+        const int stage = arguments->m_ints[0];
+        if (stage < 0 || stage >= int(render::Stage::Count))
+            return -1;
+        if (arguments->m_numInts < 2)
+            return int(std::min<uint64_t>(stats.summary(render::Stage(stage)).count, INT32_MAX));
+        const double ms = stats.percentile(render::Stage(stage), arguments->m_ints[1] / 100.);
+        return ms < 0. ? -1 : int(std::min(ms * 1e3, double(INT32_MAX)));
+    }
+
+    if (0 == strcmp(arguments->m_text, "trace")) {
+        // [1]: start recording, to the path of PYBULLET_RENDERING_TRACE if set; [0]: stop and
+        // write the file, -1 if it could not be written
+        if (arguments->m_numInts > 0 && arguments->m_ints[0] != 0) {
+            const char* tracePath = std::getenv("PYBULLET_RENDERING_TRACE");
+            render::Trace::start(tracePath ? tracePath : "");
+            return 0;
+        }
+        return render::Trace::stop() ? 0 : -1;
+    }
+
     return -1;
 }
@@ -15,6 +15,8 @@ extern "C"
 	B3_SHARED_API void exitPlugin_RenderingPlugin(struct b3PluginContext *context);
 	B3_SHARED_API struct UrdfRenderingInterface *getRenderInterface_RenderingPlugin(struct b3PluginContext *context);
 	B3_SHARED_API int executePluginCommand_RenderingPlugin(struct b3PluginContext *context, const struct b3PluginArguments *arguments);
+	B3_SHARED_API int preTickPluginCallback_RenderingPlugin(struct b3PluginContext *context);
+	B3_SHARED_API int postTickPluginCallback_RenderingPlugin(struct b3PluginContext *context);
 
 #ifdef __cplusplus
 };
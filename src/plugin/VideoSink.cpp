@@ -0,0 +1,211 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "VideoSink.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <stdio.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+namespace {
+
+/// ffmpeg executable
+std::string encoderExecutable()
+{
+    const char* path = std::getenv("PYBULLET_RENDERING_FFMPEG");
+    return path && *path ? path : "ffmpeg";
+}
+
+/// ffmpeg arguments reading raw RGBA frames from its standard input
+std::vector<std::string> encoderArguments(const VideoSink::Options& options)
+{
+    std::vector<std::string> args = {
+        encoderExecutable(), "-hide_banner", "-loglevel", "error", "-y", //
+        "-f", "rawvideo", "-pix_fmt", "rgba",                            //
+        "-video_size", std::to_string(options.cols) + "x" + std::to_string(options.rows),
+        "-framerate", std::to_string(options.fps), "-i", "-"};
+
+    // VAAPI encoders take frames uploaded to the GPU, others planar YUV
+    const bool vaapi = options.encoder.find("vaapi") != std::string::npos;
+    if (vaapi)
+        args.insert(args.end(), {"-vaapi_device", "/dev/dri/renderD128", //
+                                 "-vf", "format=nv12,hwupload"});
+    args.insert(args.end(), {"-c:v", options.encoder});
+    if (!vaapi)
+        args.insert(args.end(), {"-pix_fmt", "yuv420p"});
+
+    if (options.output.compare(0, 6, "rtp://") == 0)
+        args.insert(args.end(), {"-f", "rtp"});
+    else if (options.segmentSeconds > 0)
+        args.insert(args.end(), {"-f", "segment", "-segment_format", "mp4", //
+                                 "-segment_time", std::to_string(options.segmentSeconds),
+                                 "-reset_timestamps", "1"});
+    args.push_back(options.output);
+    return args;
+}
+
+} // namespace
+
+std::shared_ptr<VideoSink> VideoSink::create(const Options& options)
+{
+    if (options.cols <= 0 || options.rows <= 0 || options.fps <= 0)
+        throw std::invalid_argument("VideoSink: frame size and rate must be positive");
+    if (options.output.empty())
+        throw std::invalid_argument("VideoSink: no output");
+
+    const auto args = encoderArguments(options);
+#ifdef _WIN32
+    std::string command;
+    for (const auto& arg : args)
+        command += (command.empty() ? "\"" : " \"") + arg + "\"";
+    FILE* pipe = _popen(command.c_str(), "wb");
+    if (!pipe)
+        throw std::runtime_error("VideoSink: cannot start " + args[0]);
+    return std::shared_ptr<VideoSink>(new VideoSink(options, pipe, -1, -1));
+#else
+    int fds[2];
+    if (pipe(fds) != 0)
+        throw std::runtime_error("VideoSink: cannot create a pipe");
+    // other processes spawned later must not inherit the write end
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    std::vector<char*> argv;
+    for (const auto& arg : args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    pid_t pid;
+    const int error = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[0]);
+    if (error != 0) {
+        close(fds[1]);
+        throw std::runtime_error("VideoSink: cannot start " + args[0]);
+    }
+    return std::shared_ptr<VideoSink>(new VideoSink(options, nullptr, pid, fds[1]));
+#endif
+}
+
+VideoSink::VideoSink(const Options& options, void* process, int pid, int fd)
+    : _options(options), _process(process), _pid(pid), _fd(fd), _dropped(0), _closing(false),
+      _broken(false)
+{
+    _writer = std::thread(&VideoSink::writeFrames, this);
+}
+
+VideoSink::~VideoSink()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closing = true;
+    }
+    _cond.notify_one();
+    _writer.join();
+
+    // the encoder finalizes its output at the end of its input
+#ifdef _WIN32
+    _pclose(static_cast<FILE*>(_process));
+#else
+    close(_fd);
+    int status;
+    while (waitpid(_pid, &status, 0) < 0 && errno == EINTR)
+        ;
+#endif
+}
+
+uint64_t VideoSink::dropped() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _dropped;
+}
+
+bool VideoSink::push(const render::FrameData& frame)
+{
+    if (!frame.color || frame.cols != _options.cols || frame.rows != _options.rows)
+        return false;
+
+    // one producer: the queue cannot fill up between the check and the append
+    std::vector<uint8_t> buffer;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_broken || _queue.size() >= _options.queueSize) {
+            ++_dropped;
+            return false;
+        }
+        if (!_free.empty()) {
+            buffer = std::move(_free.back());
+            _free.pop_back();
+        }
+    }
+    buffer.assign(frame.color, frame.color + size_t(frame.cols) * size_t(frame.rows) * 4);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(std::move(buffer));
+    }
+    _cond.notify_one();
+    return true;
+}
+
+void VideoSink::writeFrames()
+{
+#ifndef _WIN32
+    // a write to an exited encoder fails with EPIPE instead of killing the process, the
+    // signal stays pending on this thread and is discarded with it
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _cond.wait(lock, [this] { return _closing || !_queue.empty(); });
+        if (_queue.empty())
+            return;
+        std::vector<uint8_t> buffer = std::move(_queue.front());
+        _queue.pop_front();
+        const bool broken = _broken;
+        lock.unlock();
+
+        bool written = true;
+        if (!broken) {
+#ifdef _WIN32
+            written = std::fwrite(buffer.data(), 1, buffer.size(),
+                                  static_cast<FILE*>(_process)) == buffer.size();
+#else
+            for (size_t offset = 0; written && offset < buffer.size();) {
+                const ssize_t count = write(_fd, buffer.data() + offset, buffer.size() - offset);
+                if (count > 0)
+                    offset += size_t(count);
+                else if (count < 0 && errno != EINTR)
+                    written = false;
+            }
+#endif
+        }
+
+        lock.lock();
+        if (broken || !written) {
+            _broken = true;
+            ++_dropped;
+        }
+        if (_free.size() < _options.queueSize)
+            _free.push_back(std::move(buffer));
+    }
+}
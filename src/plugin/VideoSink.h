@@ -0,0 +1,91 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <render/BaseRenderer.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Video encoding of rendered color frames, by an ffmpeg process fed through a pipe
+ *
+ * Frames are queued by push() and written to the encoder by a background thread, so that a
+ * slow encoder never stalls rendering: frames pushed while the queue is full are dropped and
+ * counted. The ffmpeg executable is taken from the PYBULLET_RENDERING_FFMPEG environment
+ * variable, "ffmpeg" by default.
+ */
+class VideoSink
+{
+  public:
+    /**
+     * @brief Encoding settings
+     */
+    struct Options {
+        std::string encoder = "libx264"; //<- ffmpeg encoder, e.g. h264_nvenc or hevc_vaapi
+        std::string output; //<- file, segment pattern such as run_%03d.mp4, or rtp:// url
+        int cols = 0;
+        int rows = 0;
+        int fps = 30;
+        int segmentSeconds = 0; //<- split the output into MP4 segments, 0 for one file
+        size_t queueSize = 8; //<- frames waiting for the encoder before drops
+    };
+
+    /**
+     * @brief Start an encoder
+     *
+     * @param options - encoding settings
+     * @throw std::invalid_argument - if the frame size, rate or output is missing
+     * @throw std::runtime_error - if the encoder process cannot be started
+     */
+    static std::shared_ptr<VideoSink> create(const Options& options);
+
+    /// encode the queued frames and wait for the encoder to finalize its output
+    ~VideoSink();
+
+    VideoSink(const VideoSink&) = delete;
+    VideoSink& operator=(const VideoSink&) = delete;
+
+    /// encoding settings
+    const Options& options() const { return _options; }
+
+    /// number of frames dropped, because the queue was full or the encoder exited
+    uint64_t dropped() const;
+
+    /**
+     * @brief Queue the colors of a frame for encoding
+     *
+     * @param frame - rendered images
+     * @return False if \p frame has no colors, is not of the video size or was dropped
+     */
+    bool push(const render::FrameData& frame);
+
+  private:
+    VideoSink(const Options& options, void* process, int pid, int fd);
+
+    /// write queued frames to the encoder until closed
+    void writeFrames();
+
+    Options _options;
+    void* _process; //<- pipe of the encoder on Windows
+    int _pid; //<- encoder process on other systems
+    int _fd; //<- write end of the pipe on other systems
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<std::vector<uint8_t>> _queue;
+    std::vector<std::vector<uint8_t>> _free; //<- written buffers, reused by push()
+    uint64_t _dropped;
+    bool _closing;
+    bool _broken; //<- the encoder exited or closed its input
+    std::thread _writer;
+};
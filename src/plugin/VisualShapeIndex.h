@@ -0,0 +1,118 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <SharedMemory/SharedMemoryPublic.h>
+
+/**
+ * @brief Visual shapes bullet queries by body, link and shape, in dense arrays
+ *
+ * The shape data of all bodies is kept in one array of slots, in the order the shapes were
+ * added; hash indices map a body to its slots, and a (body, link) pair to the node of the link
+ * in the scene graph and to its slots, so that lookups and per-shape changes do not scan the
+ * shapes of a body. The n-th shape of a link is the n-th shape of its node.
+ */
+class VisualShapeIndex
+{
+  public:
+    /**
+     * @brief Append the shape data of the next shape of a link
+     *
+     * @return int - slot of the shape
+     */
+    int add(int body, int link, const b3VisualShapeData& data)
+    {
+        const int slot = int(_shapes.size());
+        _shapes.push_back(data);
+        _bodies[body].push_back(slot);
+        _links[linkKey(body, link)].slots.push_back(slot);
+        return slot;
+    }
+
+    /**
+     * @brief Set the node of a link, unless it has one already
+     */
+    void setNode(int body, int link, int nodeId)
+    {
+        auto& entry = _links[linkKey(body, link)];
+        if (entry.nodeId < 0)
+            entry.nodeId = nodeId;
+    }
+
+    /**
+     * @brief Node of a link, -1 if it has nothing to render
+     */
+    int node(int body, int link) const
+    {
+        const auto it = _links.find(linkKey(body, link));
+        return it != _links.end() ? it->second.nodeId : -1;
+    }
+
+    /**
+     * @brief Number of shapes of a body
+     */
+    int bodyShapes(int body) const
+    {
+        const auto it = _bodies.find(body);
+        return it != _bodies.end() ? int(it->second.size()) : 0;
+    }
+
+    /**
+     * @brief Data of a shape of a body by its index among all shapes of the body, null if none
+     */
+    b3VisualShapeData* bodyShape(int body, int shapeIndex)
+    {
+        const auto it = _bodies.find(body);
+        if (it == _bodies.end() || shapeIndex < 0 || shapeIndex >= int(it->second.size()))
+            return nullptr;
+        return &_shapes[it->second[shapeIndex]];
+    }
+
+    /**
+     * @brief Slots of the shapes of a link, in order, empty if none
+     */
+    const std::vector<int>& linkSlots(int body, int link) const
+    {
+        static const std::vector<int> none;
+        const auto it = _links.find(linkKey(body, link));
+        return it != _links.end() ? it->second.slots : none;
+    }
+
+    /**
+     * @brief Data of the shape in a slot
+     */
+    b3VisualShapeData& shape(int slot) { return _shapes[slot]; }
+
+    /**
+     * @brief Forget all shapes
+     */
+    void clear()
+    {
+        _shapes.clear();
+        _bodies.clear();
+        _links.clear();
+    }
+
+  private:
+    /// node and shapes of a link
+    struct LinkEntry {
+        int nodeId = -1;
+        std::vector<int> slots;
+    };
+
+    static uint64_t linkKey(int body, int link)
+    {
+        return uint64_t(uint32_t(body)) << 32 | uint32_t(link);
+    }
+
+    std::vector<b3VisualShapeData> _shapes; //<- by slot
+    std::unordered_map<int, std::vector<int>> _bodies; //<- body -> slots
+    std::unordered_map<uint64_t, LinkEntry> _links; //<- (body, link) -> node and slots
+};
@@ -5,7 +5,11 @@
 #pragma once
 
 // project imports
+#include "AssetCache.h"
+#include <scene/Light.h>
+#include <scene/MeshBuilder.h>
 #include <scene/SceneGraph.h>
+#include <utils/hash.h>
 #include <utils/math.h>
 
 // bullet imports
@@ -13,8 +17,17 @@
 #include <SharedMemory/SharedMemoryPublic.h>
 
 // std imports
+#include <algorithm>
+#include <array>
 #include <cstring>
 
+// SSE2 kernels are selected at compile time, define PYBULLET_RENDERING_NO_SIMD for scalar ones
+#if !defined(PYBULLET_RENDERING_NO_SIMD) && defined(BT_USE_DOUBLE_PRECISION) &&                  \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define PYBULLET_RENDERING_POSE_SSE2
+#endif
+
 /**
  * @brief Convert PyBullet's transform and scale to Affine3f
  *
@@ -37,6 +50,121 @@ inline Affine3f makePose(const btTransform& frame, const btVector3& scale = {1.0
     return pose;
 }
 
+/**
+ * @brief Convert PyBullet's transforms and scales to Affine3f, as makePose() for each one
+ *
+ * Rotations of two transforms are converted at once with SSE2, with the arithmetic of
+ * btMatrix3x3::getRotation(), hence the same quaternions, but a single branch per pair: the
+ * mispredicted branches of varied rotations dominate the cost of makePose().
+ *
+ * @param frames - transformations
+ * @param scales - scale vectors, one per transformation
+ * @param count - number of transformations
+ * @param poses - output poses
+ */
+inline void makePoses(const btTransform* frames, const btVector3* scales, size_t count,
+                      Affine3f* poses)
+{
+    size_t i = 0;
+#ifdef PYBULLET_RENDERING_POSE_SSE2
+    const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0), half = _mm_set1_pd(0.5);
+    const __m128d ones = _mm_cmpeq_pd(zero, zero); //<- all bits set
+    const auto select = [](__m128d mask, __m128d a, __m128d b) {
+        return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+    };
+    for (; i + 2 <= count; i += 2) {
+        const auto& a = frames[i].getBasis();
+        const auto& b = frames[i + 1].getBasis();
+        const auto element = [&a, &b](int row, int col) {
+            return _mm_set_pd(b[row][col], a[row][col]);
+        };
+        const __m128d m00 = element(0, 0), m01 = element(0, 1), m02 = element(0, 2);
+        const __m128d m10 = element(1, 0), m11 = element(1, 1), m12 = element(1, 2);
+        const __m128d m20 = element(2, 0), m21 = element(2, 1), m22 = element(2, 2);
+
+        const __m128d trace = _mm_add_pd(_mm_add_pd(m00, m11), m22);
+        const __m128d isW = _mm_cmpgt_pd(trace, zero);
+        const __m128d dx = _mm_sub_pd(m21, m12);
+        const __m128d dy = _mm_sub_pd(m02, m20);
+        const __m128d dz = _mm_sub_pd(m10, m01);
+        __m128d qw, qx, qy, qz;
+        if (_mm_movemask_pd(isW) == 3) {
+            // w is the largest component of both, the common case of moderate rotations
+            const __m128d root = _mm_sqrt_pd(_mm_add_pd(trace, one));
+            const __m128d r = _mm_div_pd(half, root);
+            qw = _mm_mul_pd(root, half);
+            qx = _mm_mul_pd(dx, r);
+            qy = _mm_mul_pd(dy, r);
+            qz = _mm_mul_pd(dz, r);
+        }
+        else {
+            // largest component: w for a positive trace, the largest diagonal axis otherwise
+            const __m128d lt01 = _mm_cmplt_pd(m00, m11);
+            const __m128d lt12 = _mm_cmplt_pd(m11, m22);
+            const __m128d lt02 = _mm_cmplt_pd(m00, m22);
+            const __m128d isX = _mm_andnot_pd(_mm_or_pd(isW, _mm_or_pd(lt01, lt02)), ones);
+            const __m128d isY = _mm_andnot_pd(_mm_or_pd(isW, lt12), lt01);
+            const __m128d isZ = _mm_andnot_pd(_mm_or_pd(isW, _mm_or_pd(isX, isY)), ones);
+
+            const __m128d tw = _mm_add_pd(trace, one);
+            const __m128d tx = _mm_add_pd(_mm_sub_pd(_mm_sub_pd(m00, m11), m22), one);
+            const __m128d ty = _mm_add_pd(_mm_sub_pd(_mm_sub_pd(m11, m22), m00), one);
+            const __m128d tz = _mm_add_pd(_mm_sub_pd(_mm_sub_pd(m22, m00), m11), one);
+            const __m128d t = select(isW, tw, select(isX, tx, select(isY, ty, tz)));
+            const __m128d root = _mm_sqrt_pd(t);
+            const __m128d largest = _mm_mul_pd(root, half);
+            const __m128d r = _mm_div_pd(half, root);
+
+            const __m128d rx = _mm_mul_pd(dx, r), ry = _mm_mul_pd(dy, r);
+            const __m128d rz = _mm_mul_pd(dz, r);
+            const __m128d sxy = _mm_mul_pd(_mm_add_pd(m10, m01), r);
+            const __m128d sxz = _mm_mul_pd(_mm_add_pd(m20, m02), r);
+            const __m128d syz = _mm_mul_pd(_mm_add_pd(m21, m12), r);
+            qw = select(isW, largest, select(isX, rx, select(isY, ry, rz)));
+            qx = select(isX, largest, select(isW, rx, select(isY, sxy, sxz)));
+            qy = select(isY, largest, select(isW, ry, select(isX, sxy, syz)));
+            qz = select(isZ, largest, select(isW, rz, select(isX, sxz, syz)));
+        }
+
+        // narrowed as float() does, w x y z of each lane
+        const __m128 quats[2] = {
+            _mm_movelh_ps(_mm_cvtpd_ps(_mm_unpacklo_pd(qw, qx)),
+                          _mm_cvtpd_ps(_mm_unpacklo_pd(qy, qz))),
+            _mm_movelh_ps(_mm_cvtpd_ps(_mm_unpackhi_pd(qw, qx)),
+                          _mm_cvtpd_ps(_mm_unpackhi_pd(qy, qz)))};
+        for (int lane = 0; lane < 2; ++lane) {
+            const auto& origin = frames[i + lane].getOrigin();
+            const auto& scale = scales[i + lane];
+            auto& pose = poses[i + lane];
+            pose.origin = {float(origin.x()), float(origin.y()), float(origin.z())};
+            _mm_storeu_ps(pose.quat.data(), quats[lane]);
+            pose.scale = {float(scale.x()), float(scale.y()), float(scale.z())};
+        }
+    }
+#endif
+    for (; i < count; ++i)
+        poses[i] = makePose(frames[i], scales[i]);
+}
+
+/**
+ * @brief Narrow the first \p components coordinates of bullet vectors to packed floats
+ *
+ * @param vectors - bullet vectors
+ * @param components - 2 or 3
+ * @return std::vector<float>
+ */
+inline std::vector<float> toFloats(const btAlignedObjectArray<btVector3>& vectors, int components)
+{
+    const int count = vectors.size();
+    std::vector<float> values(size_t(count) * size_t(components));
+    float* out = values.data();
+    // presized, without the capacity checks of push_back
+    for (int i = 0; i < count; ++i, out += components)
+        for (int k = 0; k < components; ++k)
+            out[k] = float(vectors[i][k]);
+    return values;
+}
+
 /**
  * @brief Convert geometry to MeshData
  *
@@ -45,69 +173,103 @@ inline Affine3f makePose(const btTransform& frame, const btVector3& scale = {1.0
  */
 inline std::shared_ptr<scene::MeshData> getMeshData(const UrdfGeometry& geometry)
 {
-    std::vector<float> vertices;
-    std::vector<float> uvs;
-    std::vector<float> normals;
+    auto vertices = toFloats(geometry.m_vertices, 3);
+    auto uvs = toFloats(geometry.m_uvs, 2);
+    auto normals = toFloats(geometry.m_normals, 3);
+
+    const auto& urdfIndices = geometry.m_indices;
     std::vector<int> indices;
+    if (urdfIndices.size())
+        indices.assign(&urdfIndices[0], &urdfIndices[0] + urdfIndices.size());
+
+    // computed once here rather than by every native renderer on a copy of the mesh
+    if (normals.empty())
+        normals = scene::smoothNormals(vertices, indices);
 
-    const int verticesCount = geometry.m_vertices.size();
-    const int uvsCount = geometry.m_uvs.size();
-    const int normalsCount = geometry.m_normals.size();
-    const int indicesCount = geometry.m_indices.size();
-
-    vertices.reserve(verticesCount * 3);
-    uvs.reserve(uvsCount * 2);
-    normals.reserve(normalsCount * 3);
-    indices.reserve(indicesCount);
-
-    for (int i = 0; i < verticesCount; ++i) {
-        const auto& vertex = geometry.m_vertices[i];
-        vertices.push_back(float(vertex.x()));
-        vertices.push_back(float(vertex.y()));
-        vertices.push_back(float(vertex.z()));
-    }
-    for (int i = 0; i < uvsCount; ++i) {
-        const auto& uv = geometry.m_uvs[i];
-        uvs.push_back(float(uv.x()));
-        uvs.push_back(float(uv.y()));
-    }
-    for (int i = 0; i < normalsCount; ++i) {
-        const auto& normal = geometry.m_normals[i];
-        normals.push_back(float(normal.x()));
-        normals.push_back(float(normal.y()));
-        normals.push_back(float(normal.z()));
-    }
-    for (int i = 0; i < indicesCount; ++i) {
-        indices.push_back(geometry.m_indices[i]);
-    }
     return std::make_shared<scene::MeshData>(std::move(vertices), std::move(uvs),
                                              std::move(normals), std::move(indices));
 }
 
+/**
+ * @brief Recover the height grid of a heightfield geometry
+ *
+ * @param geometry - heightfield geometry, a triangle soup of six vertices per cell
+ * @return std::shared_ptr<scene::Heightfield> - null if the triangles are not a regular grid
+ */
+inline std::shared_ptr<scene::Heightfield> getHeightfield(const UrdfGeometry& geometry)
+{
+    const auto& urdfIndices = geometry.m_indices;
+    std::vector<int> indices;
+    if (urdfIndices.size())
+        indices.assign(&urdfIndices[0], &urdfIndices[0] + urdfIndices.size());
+    return scene::Heightfield::fromTriangles(toFloats(geometry.m_vertices, 3),
+                                             toFloats(geometry.m_uvs, 2), indices);
+}
+
+/**
+ * @brief Convert a graphics vertex buffer to MeshData
+ *
+ * @param vertices - interleaved vertices, 9 floats each: position (4), normal (3), uv (2)
+ * @param numVertices - number of vertices
+ * @param indices - triangle indices
+ * @param numIndices - number of indices
+ * @return std::shared_ptr<scene::MeshData>
+ */
+inline std::shared_ptr<scene::MeshData> getMeshData(const float* vertices, int numVertices,
+                                                    const int* indices, int numIndices)
+{
+    std::vector<float> positions;
+    std::vector<float> uvs;
+    std::vector<float> normals;
+
+    positions.reserve(numVertices * 3);
+    uvs.reserve(numVertices * 2);
+    normals.reserve(numVertices * 3);
+
+    for (int i = 0; i < numVertices; ++i) {
+        const float* vertex = vertices + i * 9;
+        positions.insert(positions.end(), vertex, vertex + 3);
+        normals.insert(normals.end(), vertex + 4, vertex + 7);
+        uvs.insert(uvs.end(), vertex + 7, vertex + 9);
+    }
+    return std::make_shared<scene::MeshData>(std::move(positions), std::move(uvs),
+                                             std::move(normals),
+                                             std::vector<int>(indices, indices + numIndices));
+}
+
+/**
+ * @brief Convert URDF material to internal scene::Material description
+ *
+ * @param urdfMaterial - pybullet URDF material description
+ * @return scene::Material
+ */
+inline scene::Material makeMaterial(const UrdfMaterial& urdfMaterial)
+{
+    const auto& filename = urdfMaterial.m_textureFilename;
+    const auto& diff = urdfMaterial.m_matColor.m_rgbaColor;
+    const auto& spec = urdfMaterial.m_matColor.m_specularColor;
+
+    return scene::Material(
+        Color4f{float(diff[0]), float(diff[1]), float(diff[2]), float(diff[3])},
+        Color3f{float(spec[0]), float(spec[1]), float(spec[2])},
+        filename.empty() ? nullptr : AssetCache::instance().fileTexture(filename));
+}
+
 /**
  * @brief Convert URDF shape to internal scene::Shape description
  *
  * @param urdfShape - pybullet URDF shape description
- * @param urdfMaterial - pybullet URDF material description
+ * @param material - shape material, e.g. interned by the scene graph
  * @param localInertiaFrame - link inertia frame
  * @param flags - URDF loading options
  * @return scene::Shape
  */
-inline scene::Shape makeShape(const UrdfShape& urdfShape, const UrdfMaterial& urdfMaterial,
+inline scene::Shape makeShape(const UrdfShape& urdfShape, std::shared_ptr<scene::Material> material,
                               const btTransform& localInertiaFrame, int flags)
 {
     using namespace scene;
     auto frame = localInertiaFrame.inverse() * urdfShape.m_linkLocalFrame;
 
-    const auto& filename = urdfMaterial.m_textureFilename;
-    const auto& diff = urdfMaterial.m_matColor.m_rgbaColor;
-    const auto& spec = urdfMaterial.m_matColor.m_specularColor;
-
-    auto material = std::make_shared<Material>( //
-        Color4f{float(diff[0]), float(diff[1]), float(diff[2]), float(diff[3])},
-        Color3f{float(spec[0]), float(spec[1]), float(spec[2])},
-        filename.empty() ? nullptr : std::make_shared<Texture>(filename));
-
     const auto& geometry = urdfShape.m_geometry;
     if (URDF_GEOM_BOX == geometry.m_type) {
         const auto pose = makePose(frame);
@@ -146,22 +308,91 @@ inline scene::Shape makeShape(const UrdfShape& urdfShape, const UrdfMaterial& ur
     }
     else if (URDF_GEOM_MESH == geometry.m_type) {
         const auto pose = makePose(frame, geometry.m_meshScale);
+        auto& cache = AssetCache::instance();
         const auto mesh = geometry.m_meshFileType == UrdfGeometry::MEMORY_VERTICES
-                              ? std::make_shared<Mesh>(getMeshData(geometry))
-                              : std::make_shared<Mesh>(geometry.m_meshFileName);
+                              ? cache.memoryMesh(getMeshData(geometry))
+                              : cache.fileMesh(geometry.m_meshFileName);
         if (flags & URDF_USE_MATERIAL_COLORS_FROM_MTL)
             material.reset();
         return Shape{ShapeType::Mesh, pose, mesh, material};
     }
     else if (URDF_GEOM_HEIGHTFIELD == geometry.m_type) {
         const auto pose = makePose(frame);
-        const auto mesh = std::make_shared<Mesh>(getMeshData(geometry));
+        if (const auto heightfield = getHeightfield(geometry))
+            return Shape{ShapeType::Heightfield, pose, heightfield, material};
+        // not a regular grid, kept as a triangle mesh
+        const auto mesh = AssetCache::instance().memoryMesh(getMeshData(geometry));
         return Shape{ShapeType::Heightfield, pose, mesh, material};
     }
 
     return Shape{};
 }
 
+/**
+ * @brief Convert URDF shape to internal scene::Shape description, with a material of its own
+ *
+ * @param urdfShape - pybullet URDF shape description
+ * @param urdfMaterial - pybullet URDF material description
+ * @param localInertiaFrame - link inertia frame
+ * @param flags - URDF loading options
+ * @return scene::Shape
+ */
+inline scene::Shape makeShape(const UrdfShape& urdfShape, const UrdfMaterial& urdfMaterial,
+                              const btTransform& localInertiaFrame, int flags)
+{
+    return makeShape(urdfShape, std::make_shared<scene::Material>(makeMaterial(urdfMaterial)),
+                     localInertiaFrame, flags);
+}
+
+/**
+ * @brief Hash of a URDF shape and its material, chained with \p hash
+ *
+ * Covers everything makeShape() converts, except in-memory geometry data.
+ *
+ * @param urdfShape - pybullet URDF shape description
+ * @param urdfMaterial - pybullet URDF material description
+ * @param hash - previous hash value
+ * @return uint64_t - 0 if the shape has in-memory geometry
+ */
+inline uint64_t hashShape(const UrdfShape& urdfShape, const UrdfMaterial& urdfMaterial,
+                          uint64_t hash)
+{
+    const auto& geometry = urdfShape.m_geometry;
+    if (URDF_GEOM_HEIGHTFIELD == geometry.m_type ||
+        (URDF_GEOM_MESH == geometry.m_type &&
+         geometry.m_meshFileType == UrdfGeometry::MEMORY_VERTICES))
+        return 0;
+
+    const auto hashString = [&hash](const std::string& value) {
+        hash = hashBytes(value.c_str(), value.size() + 1, hash);
+    };
+    const auto hashVector = [&hash](const btVector3& value) {
+        const btScalar xyz[] = {value.x(), value.y(), value.z()};
+        hash = hashBytes(xyz, sizeof(xyz), hash);
+    };
+    btScalar frame[16];
+    urdfShape.m_linkLocalFrame.getOpenGLMatrix(frame);
+    hash = hashBytes(frame, sizeof(frame), hash);
+
+    const double dimensions[] = {geometry.m_sphereRadius, geometry.m_capsuleRadius,
+                                 geometry.m_capsuleHeight};
+    hash = hashBytes(&geometry.m_type, sizeof(geometry.m_type), hash);
+    hash = hashBytes(dimensions, sizeof(dimensions), hash);
+    hashVector(geometry.m_boxSize);
+    hashVector(geometry.m_planeNormal);
+    hashVector(geometry.m_meshScale);
+    hashString(geometry.m_meshFileName);
+
+    const auto& color = urdfMaterial.m_matColor;
+    const btScalar colors[] = {color.m_rgbaColor[0], color.m_rgbaColor[1],
+                               color.m_rgbaColor[2], color.m_rgbaColor[3],
+                               color.m_specularColor[0], color.m_specularColor[1],
+                               color.m_specularColor[2]};
+    hash = hashBytes(colors, sizeof(colors), hash);
+    hashString(urdfMaterial.m_textureFilename);
+    return hash ? hash : 1;
+}
+
 /**
  * @brief Convert URDF shape to a pybullet's visual shape representation
  *
@@ -225,4 +456,26 @@ inline std::shared_ptr<scene::Light> makeDefaultLight()
     light->setAmbientCoeff(0.05);
     light->shadowCaster(false);
     return light;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Object of a pool referenced by the pool only, to be changed in place, or a new one
+ *
+ * Objects handed out for previous frames may still be held by the scene view, the frame cache
+ * or a renderer and are never changed: with a pool of two, a camera or light set each frame
+ * takes turns between two objects, without allocating.
+ *
+ * @param pool - objects handed out, null slots for objects not created yet
+ * @return std::shared_ptr<T>& - slot of the object, whose content is left to the caller
+ */
+template <class T, size_t N>
+std::shared_ptr<T>& pooledObject(std::array<std::shared_ptr<T>, N>& pool)
+{
+    for (auto& object : pool)
+        if (object && object.use_count() == 1)
+            return object;
+    // all objects in use, the oldest slot is handed a new one
+    std::rotate(pool.begin(), pool.begin() + 1, pool.end());
+    pool.back() = std::make_shared<T>();
+    return pool.back();
+}
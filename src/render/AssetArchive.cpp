@@ -0,0 +1,526 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "AssetArchive.h"
+
+#include <utils/file.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace render {
+
+namespace {
+
+// zip records, see the PKWARE APPNOTE
+const uint32_t kLocalHeader = 0x04034b50;
+const uint32_t kCentralHeader = 0x02014b50;
+const uint32_t kEndOfDirectory = 0x06054b50;
+const uint32_t kZip64EndOfDirectory = 0x06064b50;
+const uint32_t kZip64Locator = 0x07064b50;
+const uint16_t kZip64Extra = 0x0001;
+const uint16_t kStored = 0;
+const uint16_t kDeflated = 8;
+
+template <typename T>
+T read(const char* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+/**
+ * @brief Decoder of a raw DEFLATE stream, RFC 1951, into an output of known size
+ *
+ * Codes up to kFastBits long are decoded by a table lookup, longer ones bit by bit.
+ */
+class Inflater
+{
+  public:
+    Inflater(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize)
+        : _in(in), _inSize(inSize), _out(out), _outSize(outSize)
+    {
+    }
+
+    /// false if the stream is malformed or does not fill the output exactly
+    bool run()
+    {
+        int last = 0;
+        do {
+            last = bits(1);
+            const int type = bits(2);
+            const bool decoded = type == 0   ? stored()
+                                 : type == 1 ? fixed()
+                                 : type == 2 ? dynamic()
+                                             : false;
+            if (!decoded || _failed)
+                return false;
+        } while (!last);
+        return _outPos == _outSize;
+    }
+
+  private:
+    static const int kFastBits = 9;
+
+    /// canonical Huffman code
+    struct Huffman {
+        int16_t counts[16]; //<- codes of each length
+        int16_t symbols[288]; //<- by code
+        uint16_t fast[1 << kFastBits]; //<- symbol | length << 9 by reversed code, 0 if longer
+    };
+
+    void refill()
+    {
+        while (_bitCount <= 24 && _inPos < _inSize) {
+            _bitBuffer |= uint32_t(_in[_inPos++]) << _bitCount;
+            _bitCount += 8;
+        }
+    }
+
+    int bits(int n)
+    {
+        if (_bitCount < n)
+            refill();
+        if (_bitCount < n) {
+            _failed = true;
+            return 0;
+        }
+        const int value = int(_bitBuffer & ((1u << n) - 1));
+        _bitBuffer >>= n;
+        _bitCount -= n;
+        return value;
+    }
+
+    /// false if the lengths over-subscribe the code, incomplete codes fail when decoding
+    static bool build(Huffman& h, const int16_t* lengths, int n)
+    {
+        std::fill_n(h.counts, 16, int16_t(0));
+        std::fill_n(h.fast, 1 << kFastBits, uint16_t(0));
+        for (int symbol = 0; symbol < n; ++symbol)
+            ++h.counts[lengths[symbol]];
+        if (h.counts[0] == n)
+            return true;
+        int left = 1;
+        for (int length = 1; length < 16; ++length) {
+            left = left * 2 - h.counts[length];
+            if (left < 0)
+                return false;
+        }
+        int16_t offsets[16];
+        offsets[1] = 0;
+        for (int length = 1; length < 15; ++length)
+            offsets[length + 1] = offsets[length] + h.counts[length];
+        for (int symbol = 0; symbol < n; ++symbol)
+            if (lengths[symbol])
+                h.symbols[offsets[lengths[symbol]]++] = int16_t(symbol);
+
+        // codes are read from their most significant bit, the table is indexed by bits as read
+        int code = 0;
+        int index = 0;
+        for (int length = 1; length <= kFastBits; ++length) {
+            for (int k = 0; k < h.counts[length]; ++k, ++code) {
+                int reversed = 0;
+                for (int b = 0; b < length; ++b)
+                    reversed |= ((code >> b) & 1) << (length - 1 - b);
+                const auto entry = uint16_t(h.symbols[index++] | length << 9);
+                for (int r = reversed; r < 1 << kFastBits; r += 1 << length)
+                    h.fast[r] = entry;
+            }
+            code <<= 1;
+        }
+        return true;
+    }
+
+    int decode(const Huffman& h)
+    {
+        if (_bitCount < kFastBits)
+            refill();
+        const int entry = h.fast[_bitBuffer & ((1u << kFastBits) - 1)];
+        const int length = entry >> 9;
+        if (entry && length <= _bitCount) {
+            _bitBuffer >>= length;
+            _bitCount -= length;
+            return entry & 511;
+        }
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len < 16; ++len) {
+            code |= bits(1);
+            if (_failed)
+                return -1;
+            const int count = h.counts[len];
+            if (code - count < first)
+                return h.symbols[index + (code - first)];
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    bool stored()
+    {
+        // byte aligned, the whole bytes left in the bit buffer come first
+        _bitBuffer >>= _bitCount & 7;
+        _bitCount -= _bitCount & 7;
+        const int length = bits(16);
+        const int complement = bits(16);
+        if (_failed || length != (~complement & 0xffff) || _outSize - _outPos < size_t(length))
+            return false;
+        size_t n = size_t(length);
+        for (; n && _bitCount >= 8; --n)
+            _out[_outPos++] = uint8_t(bits(8));
+        if (_inSize - _inPos < n)
+            return false;
+        std::memcpy(_out + _outPos, _in + _inPos, n);
+        _outPos += n;
+        _inPos += n;
+        return true;
+    }
+
+    bool codes()
+    {
+        static const int16_t lengthBase[29] = {3,  4,  5,  6,   7,   8,   9,   10,  11, 13,
+                                               15, 17, 19, 23,  27,  31,  35,  43,  51, 59,
+                                               67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const int16_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const int16_t distanceBase[30] = {
+            1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+            193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static const int16_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                                  6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        for (;;) {
+            int symbol = decode(_lengths);
+            if (symbol < 0)
+                return false;
+            if (symbol < 256) {
+                if (_outPos == _outSize)
+                    return false;
+                _out[_outPos++] = uint8_t(symbol);
+                continue;
+            }
+            if (symbol == 256)
+                return true;
+            symbol -= 257;
+            if (symbol >= 29)
+                return false;
+            const size_t length = size_t(lengthBase[symbol] + bits(lengthExtra[symbol]));
+            const int code = decode(_distances);
+            if (code < 0 || code >= 30)
+                return false;
+            const size_t distance = size_t(distanceBase[code] + bits(distanceExtra[code]));
+            if (_failed || distance > _outPos || _outSize - _outPos < length)
+                return false;
+            // overlapping copies repeat the last bytes
+            uint8_t* to = _out + _outPos;
+            const uint8_t* from = to - distance;
+            for (size_t i = 0; i < length; ++i)
+                to[i] = from[i];
+            _outPos += length;
+        }
+    }
+
+    bool fixed()
+    {
+        int16_t lengths[288];
+        std::fill_n(lengths, 144, int16_t(8));
+        std::fill_n(lengths + 144, 112, int16_t(9));
+        std::fill_n(lengths + 256, 24, int16_t(7));
+        std::fill_n(lengths + 280, 8, int16_t(8));
+        build(_lengths, lengths, 288);
+        std::fill_n(lengths, 30, int16_t(5));
+        build(_distances, lengths, 30);
+        return codes();
+    }
+
+    bool dynamic()
+    {
+        static const uint8_t order[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                          11, 4,  12, 3, 13, 2, 14, 1, 15};
+        const int numLengths = bits(5) + 257;
+        const int numDistances = bits(5) + 1;
+        const int numCodes = bits(4) + 4;
+        if (_failed || numLengths > 286 || numDistances > 30)
+            return false;
+        int16_t lengths[320] = {};
+        for (int i = 0; i < numCodes; ++i)
+            lengths[order[i]] = int16_t(bits(3));
+        if (_failed || !build(_lengths, lengths, 19))
+            return false;
+
+        // lengths of both codes, run length encoded by the code length code
+        int index = 0;
+        while (index < numLengths + numDistances) {
+            int symbol = decode(_lengths);
+            if (symbol < 0)
+                return false;
+            if (symbol < 16) {
+                lengths[index++] = int16_t(symbol);
+                continue;
+            }
+            int16_t length = 0;
+            if (symbol == 16) {
+                if (index == 0)
+                    return false;
+                length = lengths[index - 1];
+                symbol = 3 + bits(2);
+            }
+            else if (symbol == 17) {
+                symbol = 3 + bits(3);
+            }
+            else {
+                symbol = 11 + bits(7);
+            }
+            if (_failed || index + symbol > numLengths + numDistances)
+                return false;
+            while (symbol--)
+                lengths[index++] = length;
+        }
+        if (lengths[256] == 0)
+            return false;
+        return build(_lengths, lengths, numLengths) &&
+               build(_distances, lengths + numLengths, numDistances) && codes();
+    }
+
+    const uint8_t* _in;
+    size_t _inSize;
+    size_t _inPos = 0;
+    uint8_t* _out;
+    size_t _outSize;
+    size_t _outPos = 0;
+    uint32_t _bitBuffer = 0;
+    int _bitCount = 0;
+    bool _failed = false;
+    Huffman _lengths; //<- literal and length code, or code length code
+    Huffman _distances;
+};
+
+/**
+ * @brief Memory mapped zip archive with an index of its central directory
+ */
+class ZipArchive
+{
+  public:
+    explicit ZipArchive(const std::string& path) : _file(path) {}
+
+    /// index the entries, false if the file is not a readable zip archive
+    bool index(const std::string& prefix)
+    {
+        if (!_file.valid() || _file.size() < 22)
+            return false;
+        const char* data = _file.data();
+        const size_t size = _file.size();
+
+        // end of central directory record, before a comment of up to 64 KiB
+        size_t end = size - 22;
+        const size_t lowest = size > 22 + 0xffff ? size - 22 - 0xffff : 0;
+        while (read<uint32_t>(data + end) != kEndOfDirectory) {
+            if (end == lowest)
+                return false;
+            --end;
+        }
+        uint64_t count = read<uint16_t>(data + end + 10);
+        uint64_t directorySize = read<uint32_t>(data + end + 12);
+        uint64_t directoryOffset = read<uint32_t>(data + end + 16);
+        if (end >= 20 && read<uint32_t>(data + end - 20) == kZip64Locator) {
+            const uint64_t record = read<uint64_t>(data + end - 20 + 8);
+            if (record > size - 56 || read<uint32_t>(data + record) != kZip64EndOfDirectory)
+                return false;
+            count = read<uint64_t>(data + record + 32);
+            directorySize = read<uint64_t>(data + record + 40);
+            directoryOffset = read<uint64_t>(data + record + 48);
+        }
+        if (directoryOffset > size || directorySize > size - directoryOffset)
+            return false;
+
+        const char* p = data + directoryOffset;
+        const char* directoryEnd = p + directorySize;
+        _entries.reserve(size_t(std::min<uint64_t>(count, directorySize / 46)));
+        for (uint64_t i = 0; i < count; ++i) {
+            if (directoryEnd - p < 46 || read<uint32_t>(p) != kCentralHeader)
+                return false;
+            Entry entry;
+            const uint16_t flags = read<uint16_t>(p + 8);
+            entry.method = read<uint16_t>(p + 10);
+            entry.compressedSize = read<uint32_t>(p + 20);
+            entry.size = read<uint32_t>(p + 24);
+            const size_t nameLength = read<uint16_t>(p + 28);
+            const size_t extraLength = read<uint16_t>(p + 30);
+            const size_t commentLength = read<uint16_t>(p + 32);
+            entry.header = read<uint32_t>(p + 42);
+            if (size_t(directoryEnd - p) < 46 + nameLength + extraLength + commentLength)
+                return false;
+            const std::string name(p + 46, nameLength);
+
+            // 64-bit values of the fields saturated above, in this order
+            const char* extra = p + 46 + nameLength;
+            const char* extraEnd = extra + extraLength;
+            while (extraEnd - extra >= 4) {
+                const uint16_t id = read<uint16_t>(extra);
+                const uint16_t length = read<uint16_t>(extra + 2);
+                const char* field = extra + 4;
+                const char* fieldEnd = field + std::min<ptrdiff_t>(length, extraEnd - field);
+                if (id == kZip64Extra) {
+                    for (uint64_t* value : {&entry.size, &entry.compressedSize, &entry.header}) {
+                        if (*value != 0xffffffff || fieldEnd - field < 8)
+                            continue;
+                        *value = read<uint64_t>(field);
+                        field += 8;
+                    }
+                }
+                extra = fieldEnd;
+            }
+            p += 46 + nameLength + extraLength + commentLength;
+
+            // directories, encrypted entries and other compression methods are skipped
+            if (name.empty() || name.back() == '/' || (flags & 1) ||
+                (entry.method != kStored && entry.method != kDeflated))
+                continue;
+            _entries[prefix + name] = entry;
+        }
+        return true;
+    }
+
+    size_t size() const { return _entries.size(); }
+
+    bool contains(const std::string& name) const { return _entries.count(name) != 0; }
+
+    /// contents of an entry, \p self keeping stored entries mapped
+    AssetFile open(const std::string& name, const std::shared_ptr<const ZipArchive>& self) const
+    {
+        const auto it = _entries.find(name);
+        if (it == _entries.end())
+            return {};
+        const auto& entry = it->second;
+        const char* data = _file.data();
+        const size_t size = _file.size();
+        if (entry.header > size || size - entry.header < 30 ||
+            read<uint32_t>(data + entry.header) != kLocalHeader)
+            return {};
+        // the local extra field may differ from the central one
+        const uint64_t offset = entry.header + 30 + read<uint16_t>(data + entry.header + 26) +
+                                read<uint16_t>(data + entry.header + 28);
+        if (offset > size || entry.compressedSize > size - offset)
+            return {};
+
+        AssetFile file;
+        if (entry.method == kStored) {
+            if (entry.compressedSize != entry.size)
+                return {};
+            file.data = data + offset;
+            file.size = size_t(entry.size);
+            file.owner = self;
+            return file;
+        }
+        auto bytes = std::make_shared<std::vector<char>>(size_t(entry.size));
+        Inflater inflater(reinterpret_cast<const uint8_t*>(data + offset),
+                          size_t(entry.compressedSize), reinterpret_cast<uint8_t*>(bytes->data()),
+                          bytes->size());
+        if (!inflater.run())
+            return {};
+        file.data = bytes->data();
+        file.size = bytes->size();
+        file.owner = std::move(bytes);
+        return file;
+    }
+
+  private:
+    struct Entry {
+        uint64_t header = 0; //<- offset of the local header
+        uint64_t compressedSize = 0;
+        uint64_t size = 0;
+        uint16_t method = kStored;
+    };
+
+    MappedFile _file;
+    std::unordered_map<std::string, Entry> _entries; //<- by prefixed name
+};
+
+std::mutex gMutex;
+std::vector<std::shared_ptr<const ZipArchive>> gArchives; //<- in mounting order
+std::map<std::string, std::shared_ptr<const std::vector<char>>> gFiles; //<- registered
+
+/// names as resolved by importers, without a leading "./"
+std::string assetName(const std::string& filename)
+{
+    return filename.compare(0, 2, "./") == 0 ? filename.substr(2) : filename;
+}
+
+} // namespace
+
+int mountAssetArchive(const std::string& path, const std::string& prefix)
+{
+    auto archive = std::make_shared<ZipArchive>(path);
+    if (!archive->index(prefix))
+        return -1;
+    std::lock_guard<std::mutex> lock(gMutex);
+    gArchives.push_back(archive);
+    return int(archive->size());
+}
+
+void registerAssetFile(const std::string& filename, std::vector<char> bytes)
+{
+    auto file = std::make_shared<const std::vector<char>>(std::move(bytes));
+    std::lock_guard<std::mutex> lock(gMutex);
+    gFiles[assetName(filename)] = std::move(file);
+}
+
+void clearAssetFiles()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gArchives.clear();
+    gFiles.clear();
+}
+
+bool assetFileInMemory(const std::string& filename)
+{
+    const auto name = assetName(filename);
+    std::lock_guard<std::mutex> lock(gMutex);
+    if (gFiles.count(name))
+        return true;
+    for (const auto& archive : gArchives)
+        if (archive->contains(name))
+            return true;
+    return false;
+}
+
+AssetFile openAssetFile(const std::string& filename)
+{
+    const auto name = assetName(filename);
+    std::shared_ptr<const ZipArchive> archive;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        const auto it = gFiles.find(name);
+        if (it != gFiles.end()) {
+            AssetFile file;
+            file.data = it->second->data();
+            file.size = it->second->size();
+            file.owner = it->second;
+            return file;
+        }
+        for (auto it = gArchives.rbegin(); it != gArchives.rend() && !archive; ++it)
+            if ((*it)->contains(name))
+                archive = *it;
+    }
+    // inflated unlocked, archives are not modified once mounted
+    if (archive)
+        return archive->open(name, archive);
+
+    auto mapped = std::make_shared<MappedFile>(filename);
+    if (!mapped->valid())
+        return {};
+    AssetFile file;
+    file.data = mapped->data();
+    file.size = mapped->size();
+    file.owner = std::move(mapped);
+    return file;
+}
+
+} // namespace render
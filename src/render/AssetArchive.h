@@ -0,0 +1,67 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Contents of an asset file, see openAssetFile()
+ */
+struct AssetFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> owner; //<- mapping or buffer of the bytes, null if not found
+
+    explicit operator bool() const { return bool(owner); }
+};
+
+/**
+ * @brief Serve the entries of a zip archive as asset files, see openAssetFile()
+ *
+ * The archive is memory mapped once and its central directory indexed, so that loading an
+ * entry neither opens nor seeks a file, e.g. on a network file system: stored entries are read
+ * in place and deflated ones inflated from the mapping. Entries are named \p prefix followed by
+ * their path in the archive, e.g. the names a physics server file I/O resolves them to. An
+ * entry of an archive mounted later hides those of the same name.
+ *
+ * @param path - zip file on disk
+ * @param prefix - prepended to the entry names
+ * @return Number of entries served, -1 if the file is not a readable zip archive
+ */
+int mountAssetArchive(const std::string& path, const std::string& prefix = "");
+
+/**
+ * @brief Serve \p bytes as the contents of \p filename, e.g. read through a physics server
+ * file I/O, ahead of the mounted archives and of the file on disk
+ */
+void registerAssetFile(const std::string& filename, std::vector<char> bytes);
+
+/**
+ * @brief Unmount the archives and drop the registered files, assets loaded from them are kept
+ */
+void clearAssetFiles();
+
+/**
+ * @brief \p filename is served from memory, registered or in a mounted archive
+ */
+bool assetFileInMemory(const std::string& filename);
+
+/**
+ * @brief Contents of a mesh or image file
+ *
+ * Registered files first, then the entries of the mounted archives, then the file on disk,
+ * memory mapped.
+ *
+ * @param filename - asset file name
+ * @return AssetFile - contents, empty if not found or not readable
+ */
+AssetFile openAssetFile(const std::string& filename);
+
+} // namespace render
@@ -0,0 +1,698 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "AssetLoader.h"
+
+#include "AssetArchive.h"
+#include "MeshCache.h"
+#include "ObjParser.h"
+#include "TextureCache.h"
+#include "ThreadAffinity.h"
+#include "Trace.h"
+
+#include <scene/MeshBuilder.h>
+#include <scene/MeshLod.h>
+#include <scene/MeshOptimizer.h>
+#include <scene/Primitives.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+#ifdef HAVE_STB_IMAGE
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+// JPEG IDCT and color conversion in SIMD, SSE2 is enabled by stb_image itself on x86-64
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define STBI_NEON
+#endif
+#include <stb_image.h>
+#endif
+
+namespace render {
+
+namespace {
+
+using scene::MeshBuilder;
+
+std::atomic<bool> gOptimizeMeshes(false);
+std::mutex gStatsMutex;
+std::map<std::string, scene::MeshOptimizationStats> gOptimizationStats; //<- filename -> stats
+
+/**
+ * @brief Load a binary or ASCII STL file
+ */
+std::shared_ptr<scene::MeshData> loadStl(const std::string& filename)
+{
+    const auto file = openAssetFile(filename);
+    if (!file)
+        return nullptr;
+
+    const std::string content(file.data, file.size);
+    MeshBuilder mesh;
+
+    uint32_t count = 0;
+    if (content.size() >= 84)
+        std::memcpy(&count, content.data() + 80, sizeof(count));
+
+    if (content.size() == 84 + size_t(count) * 50) {
+        for (uint32_t i = 0; i < count; ++i) {
+            float values[12];
+            std::memcpy(values, content.data() + 84 + i * 50, sizeof(values));
+            const Vector3f n{values[0], values[1], values[2]};
+            const int a = mesh.vertex({values[3], values[4], values[5]}, n);
+            const int b = mesh.vertex({values[6], values[7], values[8]}, n);
+            const int c = mesh.vertex({values[9], values[10], values[11]}, n);
+            mesh.triangle(a, b, c);
+        }
+    }
+    else {
+        std::istringstream in(content);
+        std::string tag;
+        Vector3f n{0.f, 0.f, 0.f};
+        std::vector<int> facet;
+        while (in >> tag) {
+            if (tag == "normal") {
+                in >> n[0] >> n[1] >> n[2];
+            }
+            else if (tag == "vertex") {
+                Vector3f p{0.f, 0.f, 0.f};
+                in >> p[0] >> p[1] >> p[2];
+                facet.push_back(mesh.vertex(p, n));
+            }
+            else if (tag == "endfacet") {
+                if (facet.size() == 3)
+                    mesh.triangle(facet[0], facet[1], facet[2]);
+                facet.clear();
+            }
+        }
+    }
+    mesh.uvs.clear();
+    return mesh.build();
+}
+
+/**
+ * @brief Copy of \p data with smooth normals if it has none
+ */
+std::shared_ptr<scene::MeshData> withNormals(const std::shared_ptr<scene::MeshData>& data)
+{
+    if (!data || data->hasNormals())
+        return data;
+
+    const auto& vertices = data->vertices();
+    const auto& indices = data->indices();
+    auto normals = scene::smoothNormals(vertices, indices);
+    auto uvs = data->uvs();
+    return std::make_shared<scene::MeshData>(std::vector<float>(vertices), std::move(uvs),
+                                             std::move(normals), std::vector<int>(indices));
+}
+
+std::shared_ptr<scene::MeshData> loadMeshFile(const std::string& filename)
+{
+    auto extension = filename.substr(std::min(filename.rfind('.'), filename.size()));
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+
+    if (extension != ".obj" && extension != ".stl")
+        return nullptr;
+
+    // parsed once per file content across processes, see setMeshCacheDirectory()
+    const bool optimize = gOptimizeMeshes;
+    const std::string loader = optimize ? "native-optimized" : "native";
+    if (auto data = loadCachedMesh(filename, loader))
+        return data;
+
+    std::shared_ptr<scene::MeshData> data;
+    try {
+        data = withNormals(extension == ".obj" ? loadObj(filename) : loadStl(filename));
+    }
+    catch (const std::exception&) {
+        // malformed file
+    }
+    if (data && optimize) {
+        scene::MeshOptimizationStats stats;
+        data = scene::optimizeMesh(*data, &stats);
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        gOptimizationStats[filename] = stats;
+    }
+    if (data)
+        storeCachedMesh(filename, loader, *data);
+    return data;
+}
+
+/// mesh data of a shape and, for mesh files, the levels of detail of their Mesh
+struct MeshAsset {
+    std::shared_ptr<scene::MeshData> data;
+    std::vector<std::shared_ptr<scene::MeshData>> lods;
+};
+
+/**
+ * @brief Asset loaded once, by a prefetch worker or by the first thread needing it
+ */
+template <class T>
+class Asset
+{
+  public:
+    /// the loaded value, loading it on this thread unless another one already is
+    template <class Load>
+    const T& get(Load&& load)
+    {
+        std::call_once(_once, [&] {
+            _loading = true;
+            _value = load();
+            _loading = false;
+            _loaded = true;
+        });
+        return _value;
+    }
+
+    /// a thread is loading the value, forked children never see it done
+    bool loading() const { return _loading; }
+
+    /// the value is loaded, get() returns it without waiting
+    bool loaded() const { return _loaded; }
+
+  private:
+    std::once_flag _once;
+    std::atomic<bool> _loading{false};
+    std::atomic<bool> _loaded{false};
+    T _value;
+};
+
+/// asset of an id, and whether it was just created
+template <class T>
+std::pair<std::shared_ptr<Asset<T>>, bool> findAsset(std::map<int, std::shared_ptr<Asset<T>>>& map,
+                                                     int assetId)
+{
+    auto& asset = map[assetId];
+    const bool created = !asset;
+    if (created)
+        asset = std::make_shared<Asset<T>>();
+    return {asset, created};
+}
+
+/// load a mesh on any thread, its description is left unchanged
+MeshAsset loadMeshAsset(const scene::Mesh& mesh)
+{
+    TraceScope trace("load_mesh");
+    MeshAsset asset;
+    asset.data = withNormals(mesh.data() ? mesh.data() : loadMeshFile(mesh.filename()));
+    if (asset.data && asset.data != mesh.data())
+        prepareMeshData(*asset.data);
+    if (asset.data && !mesh.data())
+        asset.lods = scene::makeMeshLods(*asset.data);
+    if (gOptimizeMeshes)
+        for (auto& lod : asset.lods)
+            lod = scene::optimizeMesh(*lod);
+    for (const auto& lod : asset.lods)
+        prepareMeshData(*lod);
+    return asset;
+}
+
+#ifdef HAVE_STB_IMAGE
+/**
+ * @brief Copy of \p bytes in pages of their own, read-only once filled
+ *
+ * Neither the process nor its forked children write these pages, unlike heap pages shared with
+ * other allocations, so that all of them keep sharing a single physical copy.
+ *
+ * @return Pages unmapped with the last reference, null if they cannot be mapped
+ */
+std::shared_ptr<const uint8_t> readOnlyPages(const uint8_t* data, size_t bytes)
+{
+    void* pages = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED)
+        return nullptr;
+    std::memcpy(pages, data, bytes);
+    mprotect(pages, bytes, PROT_READ);
+    return std::shared_ptr<const uint8_t>(static_cast<const uint8_t*>(pages),
+                                          [bytes](const uint8_t* pixels) {
+                                              munmap(const_cast<uint8_t*>(pixels), bytes);
+                                          });
+}
+#endif
+
+/// decode an image file, into read-only pages for preloaded textures
+std::shared_ptr<scene::Bitmap> decodeBitmap(const std::string& filename, bool readOnly = false)
+{
+    TraceScope trace("decode_texture");
+    std::shared_ptr<scene::Bitmap> bitmap;
+#ifdef HAVE_STB_IMAGE
+    const auto file = openAssetFile(filename);
+    int cols = 0, rows = 0, channels = 0;
+    uint8_t* pixels = file ? stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data),
+                                                   int(file.size), &cols, &rows, &channels, 4)
+                           : nullptr;
+    if (pixels) {
+        const size_t bytes = size_t(cols) * size_t(rows) * 4;
+        if (readOnly)
+            if (auto pages = readOnlyPages(pixels, bytes))
+                bitmap = std::make_shared<scene::Bitmap>(pages, bytes, Size2i{rows, cols});
+        if (!bitmap)
+            bitmap = std::make_shared<scene::Bitmap>(std::vector<uint8_t>(pixels, pixels + bytes),
+                                                     Size2i{rows, cols});
+        stbi_image_free(pixels);
+    }
+#else
+    (void)filename;
+    (void)readOnly;
+#endif
+    return bitmap;
+}
+
+std::mutex gMutex;
+std::map<int, std::shared_ptr<Asset<MeshAsset>>> gMeshes; //<- asset id -> mesh
+std::set<int> gMeshesApplied; //<- mesh files whose description learnt bounds and levels
+std::map<int, std::vector<std::shared_ptr<scene::MeshData>>> gMeshLods; //<- asset id -> levels
+std::map<int, std::shared_ptr<Asset<std::shared_ptr<scene::Bitmap>>>> gBitmaps; //<- asset id
+std::map<int, std::shared_ptr<Asset<std::shared_ptr<scene::Bitmap>>>> gCompressedBitmaps;
+std::atomic<bool> gCompressTextures(false);
+bool gPrefetch = false;
+bool gTexturePrefetch = false;
+std::atomic<VertexBufferMode> gVertexBufferMode(VertexBufferMode::Off); //<- read under gMutex too
+std::atomic<bool> gQuantizeMeshes(false);
+
+/**
+ * @brief Workers loading prefetched assets, started by the first job and stopped at exit
+ */
+class LoaderPool
+{
+  public:
+    static LoaderPool& instance()
+    {
+        static LoaderPool pool;
+        return pool;
+    }
+
+    void post(std::function<void()>&& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_workers.empty())
+                start();
+            _jobs.push_back(std::move(job));
+        }
+        _wakeup.notify_one();
+    }
+
+    /// hold the queue across fork()
+    void lock() { _mutex.lock(); }
+
+    /// release the queue after fork(), children start their own workers with their next job
+    void unlock(bool child)
+    {
+        if (child) {
+            // the threads of the parent do not exist here, they can be neither joined nor
+            // destroyed, nor can the condition they waited on
+            new std::vector<std::thread>(std::move(_workers));
+            _workers.clear();
+            new (&_wakeup) std::condition_variable();
+        }
+        _mutex.unlock();
+    }
+
+    ~LoaderPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopped = true;
+        }
+        _wakeup.notify_all();
+        for (auto& worker : _workers)
+            worker.join();
+    }
+
+  private:
+    LoaderPool() = default;
+
+    /// start the workers, with _mutex held
+    void start()
+    {
+        const int numWorkers = int(std::min(std::max(std::thread::hardware_concurrency(), 2u), 8u));
+        for (int i = 0; i < numWorkers; ++i)
+            _workers.emplace_back(&LoaderPool::work, this, i);
+    }
+
+    void work(int index)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _wakeup.wait(lock, [this] { return _stopped || !_jobs.empty(); });
+            if (_stopped)
+                return; //<- assets not loaded yet are loaded when needed
+            auto job = std::move(_jobs.front());
+            _jobs.pop_front();
+            lock.unlock();
+            // workers spread over the nodes of the GPUs, decoding assets into their memory
+            const auto nodes = threadAffinity() != ThreadAffinity::Off
+                                   ? deviceNumaNodes()
+                                   : std::vector<int>();
+            placeThread("asset loader", nodes.empty() ? -1 : nodes[index % nodes.size()]);
+            job();
+            lock.lock();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+    std::deque<std::function<void()>> _jobs;
+    bool _stopped = false;
+    std::vector<std::thread> _workers;
+};
+
+/// forget the assets a thread of the parent was loading when it forked, children load them again
+template <class T>
+void forgetLoading(std::map<int, std::shared_ptr<Asset<T>>>& map)
+{
+    for (auto& it : map)
+        if (it.second->loading())
+            it.second = std::make_shared<Asset<T>>();
+}
+
+/// take the locks of the loader across fork(), so that children inherit consistent state
+void prepareFork()
+{
+    gMutex.lock();
+    gStatsMutex.lock();
+    LoaderPool::instance().lock();
+}
+
+void parentAfterFork()
+{
+    LoaderPool::instance().unlock(false);
+    gStatsMutex.unlock();
+    gMutex.unlock();
+}
+
+void childAfterFork()
+{
+    forgetLoading(gMeshes);
+    forgetLoading(gBitmaps);
+    forgetLoading(gCompressedBitmaps);
+    LoaderPool::instance().unlock(true);
+    gStatsMutex.unlock();
+    gMutex.unlock();
+}
+
+const int gForkHandlers = pthread_atfork(prepareFork, parentAfterFork, childAfterFork);
+
+/// bitmap of a texture file with an asset id, decoded once
+std::shared_ptr<scene::Bitmap> loadBitmapAsset(const scene::Texture& texture, bool readOnly)
+{
+    std::shared_ptr<Asset<std::shared_ptr<scene::Bitmap>>> asset;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        asset = findAsset(gBitmaps, texture.assetId()).first;
+    }
+    return asset->get([&] { return decodeBitmap(texture.filename(), readOnly); });
+}
+
+/// job decoding a texture file not queued yet, compressed if \p compressed, with gMutex held
+void queueTexture(const std::shared_ptr<scene::Texture>& texture, bool compressed, bool readOnly,
+                  std::vector<std::function<void()>>& jobs)
+{
+    if (texture->bitmap() || texture->assetId() < 0)
+        return;
+    if (compressed) {
+        const auto asset = findAsset(gCompressedBitmaps, texture->assetId());
+        if (asset.second)
+            jobs.emplace_back([asset, texture] {
+                asset.first->get([&] { return compressTextureFile(texture->filename()); });
+            });
+    }
+    else {
+        const auto asset = findAsset(gBitmaps, texture->assetId());
+        if (asset.second)
+            jobs.emplace_back([asset, texture, readOnly] {
+                asset.first->get([&] { return decodeBitmap(texture->filename(), readOnly); });
+            });
+    }
+}
+
+/// jobs loading the assets of a shape not queued yet, with gMutex held
+void queueAssets(const scene::Shape& shape, bool compressed, bool readOnly,
+                 std::vector<std::function<void()>>& jobs)
+{
+    const auto& mesh = shape.mesh();
+    if (mesh && mesh->assetId() >= 0) {
+        const auto asset = findAsset(gMeshes, mesh->assetId());
+        if (asset.second)
+            jobs.emplace_back([asset, mesh] {
+                asset.first->get([&] { return loadMeshAsset(*mesh); });
+            });
+    }
+    const auto& material = shape.material();
+    if (material && material->diffuseTexture())
+        queueTexture(material->diffuseTexture(), compressed, readOnly, jobs);
+}
+
+} // namespace
+
+std::shared_ptr<scene::MeshData> loadMeshData(const scene::Shape& shape)
+{
+    const auto& mesh = shape.mesh();
+    if (!mesh)
+        return scene::primitiveMesh(shape);
+
+    // meshes rewritten in place (e.g. deformable bodies) are not cached
+    if (mesh->assetId() < 0)
+        return withNormals(mesh->data() ? mesh->data() : loadMeshFile(mesh->filename()));
+
+    std::shared_ptr<Asset<MeshAsset>> asset;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        asset = findAsset(gMeshes, mesh->assetId()).first;
+    }
+    // parsed without the lock, other meshes load concurrently
+    const auto& loaded = asset->get([&] { return loadMeshAsset(*mesh); });
+
+    // file meshes learn their bounds and levels of detail once loaded, on the rendering thread
+    std::lock_guard<std::mutex> lock(gMutex);
+    if (loaded.data && !mesh->data() && gMeshesApplied.insert(mesh->assetId()).second) {
+        mesh->setBounds(loaded.data->bounds());
+        if (mesh->lods().empty())
+            mesh->setLods(std::vector<std::shared_ptr<scene::MeshData>>(loaded.lods));
+    }
+    return loaded.data;
+}
+
+std::vector<std::shared_ptr<scene::MeshData>> loadMeshLods(const scene::Shape& shape)
+{
+    const auto& mesh = shape.mesh();
+    if (!mesh || mesh->assetId() < 0)
+        return {};
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    auto it = gMeshLods.find(mesh->assetId());
+    if (it == gMeshLods.end()) {
+        // a file mesh not loaded yet has no levels, do not cache them
+        if (mesh->lods().empty())
+            return {};
+        std::vector<std::shared_ptr<scene::MeshData>> lods;
+        for (const auto& lod : mesh->lods()) {
+            lods.push_back(withNormals(lod));
+            if (lods.back() != lod)
+                prepareMeshData(*lods.back());
+        }
+        it = gMeshLods.emplace(mesh->assetId(), std::move(lods)).first;
+    }
+    return it->second;
+}
+
+std::shared_ptr<scene::Bitmap> loadBitmap(const scene::Texture& texture)
+{
+    if (texture.bitmap())
+        return texture.bitmap();
+    if (texture.assetId() < 0)
+        return decodeBitmap(texture.filename());
+    return loadBitmapAsset(texture, false);
+}
+
+std::shared_ptr<scene::Bitmap> loadCompressedBitmap(const scene::Texture& texture)
+{
+    if (texture.bitmap() || texture.filename().empty() || !textureCompression())
+        return nullptr;
+    if (texture.assetId() < 0)
+        return compressTextureFile(texture.filename());
+
+    std::shared_ptr<Asset<std::shared_ptr<scene::Bitmap>>> asset;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        asset = findAsset(gCompressedBitmaps, texture.assetId()).first;
+    }
+    return asset->get([&] { return compressTextureFile(texture.filename()); });
+}
+
+std::shared_ptr<scene::Bitmap> compressTextureFile(const std::string& filename)
+{
+    auto bitmap = loadCachedTexture(filename);
+    if (bitmap)
+        return bitmap;
+    const auto decoded = decodeBitmap(filename);
+    bitmap = decoded ? compressBitmap(*decoded) : nullptr;
+    if (bitmap)
+        storeCachedTexture(filename, *bitmap);
+    return bitmap;
+}
+
+void setTextureCompression(bool enabled) { gCompressTextures = enabled; }
+
+bool textureCompression() { return gCompressTextures && !textureCacheDirectory().empty(); }
+
+void prefetchAssets(const scene::Shape& shape)
+{
+    const bool compressed = textureCompression();
+    std::vector<std::function<void()>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        queueAssets(shape, compressed, false, jobs);
+    }
+    for (auto& job : jobs)
+        LoaderPool::instance().post(std::move(job));
+}
+
+void prefetchTexture(const std::shared_ptr<scene::Texture>& texture)
+{
+    const bool compressed = textureCompression();
+    std::vector<std::function<void()>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        queueTexture(texture, compressed, false, jobs);
+    }
+    for (auto& job : jobs)
+        LoaderPool::instance().post(std::move(job));
+}
+
+bool assetsLoaded(const scene::Shape& shape)
+{
+    const auto loaded = [](const auto& map, int assetId) {
+        const auto it = map.find(assetId);
+        return it != map.end() && it->second->loaded();
+    };
+    const bool compressed = textureCompression();
+    const auto& mesh = shape.mesh();
+    const auto& material = shape.material();
+    const auto texture = material ? material->diffuseTexture() : nullptr;
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    if (mesh && mesh->assetId() >= 0 && !loaded(gMeshes, mesh->assetId()))
+        return false;
+    if (texture && !texture->bitmap() && texture->assetId() >= 0 &&
+        !loaded(compressed ? gCompressedBitmaps : gBitmaps, texture->assetId()))
+        return false;
+    return true;
+}
+
+void prefetchAssets(const scene::SceneGraph& sceneGraph)
+{
+    for (const auto& it : sceneGraph.nodes())
+        for (const auto& shape : it.second.shapes())
+            prefetchAssets(shape);
+}
+
+void preloadAssets(const std::vector<scene::Shape>& shapes)
+{
+    const bool compressed = textureCompression();
+    std::vector<std::function<void()>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        for (const auto& shape : shapes)
+            queueAssets(shape, compressed, true, jobs);
+    }
+    for (auto& job : jobs)
+        LoaderPool::instance().post(std::move(job));
+
+    // wait for the workers, levels of detail and bounds are applied as by a renderer
+    for (const auto& shape : shapes) {
+        if (shape.mesh() && shape.mesh()->assetId() >= 0) {
+            loadMeshData(shape);
+            loadMeshLods(shape);
+        }
+        const auto& material = shape.material();
+        const auto texture = material ? material->diffuseTexture() : nullptr;
+        if (texture && !texture->bitmap() && texture->assetId() >= 0 &&
+            !(compressed && loadCompressedBitmap(*texture)))
+            loadBitmapAsset(*texture, true);
+    }
+}
+
+void preloadAssets(const scene::SceneGraph& sceneGraph)
+{
+    std::vector<scene::Shape> shapes;
+    for (const auto& it : sceneGraph.nodes())
+        shapes.insert(shapes.end(), it.second.shapes().begin(), it.second.shapes().end());
+    preloadAssets(shapes);
+}
+
+void setAssetPrefetch(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gPrefetch = enabled;
+}
+
+bool assetPrefetch()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    return gPrefetch;
+}
+
+void setTexturePrefetch(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gTexturePrefetch = enabled;
+}
+
+bool texturePrefetch()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    return gPrefetch || gTexturePrefetch;
+}
+
+void setMeshOptimization(bool enabled) { gOptimizeMeshes = enabled; }
+
+bool meshOptimization() { return gOptimizeMeshes; }
+
+std::map<std::string, scene::MeshOptimizationStats> meshOptimizationStats()
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    return gOptimizationStats;
+}
+
+void setVertexBufferMode(VertexBufferMode mode) { gVertexBufferMode = mode; }
+
+VertexBufferMode vertexBufferMode() { return gVertexBufferMode; }
+
+void setMeshQuantization(bool enabled) { gQuantizeMeshes = enabled; }
+
+bool meshQuantization() { return gQuantizeMeshes; }
+
+void prepareMeshData(scene::MeshData& data)
+{
+    if (gQuantizeMeshes && data.quantize())
+        return;
+    const auto mode = vertexBufferMode();
+    if (mode != VertexBufferMode::Off && !data.vertexBuffer() && !data.quantized())
+        data.setVertexBuffer(
+            std::make_shared<scene::VertexBuffer>(data, mode == VertexBufferMode::Half));
+}
+
+} // namespace render
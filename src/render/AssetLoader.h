@@ -0,0 +1,243 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <scene/Mesh.h>
+#include <scene/MeshOptimizer.h>
+#include <scene/SceneGraph.h>
+#include <scene/Shape.h>
+#include <scene/Texture.h>
+#include <scene/VertexBuffer.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Triangle mesh of a shape, for native renderers
+ *
+ * Primitives are tessellated, mesh files in Wavefront OBJ and STL formats are loaded from disk or
+ * from memory, see openAssetFile(). Meshes with an asset id are loaded once per process, parsed
+ * mesh files are kept in the persistent mesh cache if enabled, see setMeshCacheDirectory().
+ * Missing normals are computed.
+ *
+ * @param shape - shape description
+ * @return std::shared_ptr<scene::MeshData> - mesh data, null if the shape cannot be loaded
+ */
+std::shared_ptr<scene::MeshData> loadMeshData(const scene::Shape& shape);
+
+/**
+ * @brief Simplified versions of the triangle mesh of a shape, coarser last
+ *
+ * Only meshes with an asset id have levels of detail, generated once per process when the mesh
+ * enters the asset cache or, for mesh files, when loadMeshData() first loads them. Missing
+ * normals are computed.
+ *
+ * @param shape - shape description
+ * @return Simplified meshes, empty for primitives and meshes not worth simplifying
+ */
+std::vector<std::shared_ptr<scene::MeshData>> loadMeshLods(const scene::Shape& shape);
+
+/**
+ * @brief Bitmap of a texture, for native renderers
+ *
+ * Texture files, on disk or in memory as for loadMeshData(), are decoded only if the library was
+ * built with stb_image. Textures with an asset id are decoded once per process.
+ *
+ * @param texture - texture description
+ * @return std::shared_ptr<scene::Bitmap> - bitmap, null if the texture cannot be loaded
+ */
+std::shared_ptr<scene::Bitmap> loadBitmap(const scene::Texture& texture);
+
+/**
+ * @brief Block compressed bitmap of a texture file, with all its mip levels
+ *
+ * Only while texture compression is enabled, see setTextureCompression(). Compressed bitmaps
+ * are mapped from the persistent texture cache, or decoded, compressed and stored there, see
+ * setTextureCacheDirectory(). Textures with an asset id are loaded once per process.
+ *
+ * @param texture - texture description
+ * @return std::shared_ptr<scene::Bitmap> - compressed bitmap, null for memory textures, files
+ * which cannot be decoded, or if compression is disabled: use loadBitmap() then
+ */
+std::shared_ptr<scene::Bitmap> loadCompressedBitmap(const scene::Texture& texture);
+
+/**
+ * @brief Compress a texture file into the persistent texture cache, e.g. offline
+ *
+ * @param filename - texture file on disk
+ * @return std::shared_ptr<scene::Bitmap> - compressed bitmap, null if the file cannot be
+ * decoded
+ */
+std::shared_ptr<scene::Bitmap> compressTextureFile(const std::string& filename);
+
+/**
+ * @brief Let loadCompressedBitmap() compress texture files while the texture cache is enabled
+ *
+ * Enabled by the EGL renderer when it is created, if the GPU decodes S3TC blocks.
+ */
+void setTextureCompression(bool enabled);
+
+/**
+ * @brief Texture files are compressed, i.e. compression and the texture cache are enabled
+ */
+bool textureCompression();
+
+/**
+ * @brief Start loading the mesh and texture of a shape on worker threads
+ *
+ * Only assets with an asset id are prefetched, loadMeshData() and loadBitmap(), or
+ * loadCompressedBitmap() while texture files are compressed, then return them without parsing
+ * or decoding, or wait for the worker loading them.
+ *
+ * @param shape - shape description
+ */
+void prefetchAssets(const scene::Shape& shape);
+
+/** @overload */
+void prefetchAssets(const scene::SceneGraph& sceneGraph);
+
+/**
+ * @brief Start decoding a texture file on worker threads, e.g. as soon as a material names it
+ *
+ * Decoded into RGBA, or block compressed with its mip levels while texture files are
+ * compressed, for loadBitmap() or loadCompressedBitmap(), as prefetchAssets() does. Only
+ * textures with an asset id are prefetched.
+ *
+ * @param texture - texture description
+ */
+void prefetchTexture(const std::shared_ptr<scene::Texture>& texture);
+
+/**
+ * @brief The mesh and texture of a shape are loaded, loadMeshData() and loadBitmap() returning
+ * them without parsing, decoding or waiting
+ *
+ * Assets without an asset id, e.g. primitives and memory meshes, are loaded when used and count
+ * as loaded. Those with an id only are once prefetched, see prefetchAssets(), or used.
+ *
+ * @param shape - shape description
+ */
+bool assetsLoaded(const scene::Shape& shape);
+
+/**
+ * @brief Load the meshes and textures of shapes before the process forks, e.g. into workers
+ *
+ * Loads as prefetchAssets() on the worker threads, then waits for them, so that children of the
+ * process find the assets with an asset id loaded. Textures are decoded into read-only pages of
+ * their own, compressed textures are mapped from the texture cache: neither the process nor its
+ * children write them, they all share one copy. Meshes are not written once loaded either, only
+ * the heap pages they share with other allocations may be copied by a child. Assets loaded
+ * earlier are kept as they are.
+ *
+ * The asset loader and caches stay usable in children: fork() waits for their locks, and assets
+ * still loading on a thread of the parent are loaded again by children needing them.
+ *
+ * @param shapes - shape descriptions
+ */
+void preloadAssets(const std::vector<scene::Shape>& shapes);
+
+/** @overload */
+void preloadAssets(const scene::SceneGraph& sceneGraph);
+
+/**
+ * @brief Let scene builders, e.g. the rendering plugin, prefetch the assets of new shapes
+ *
+ * Enabled by native renderers when they are created, python renderers load assets themselves.
+ */
+void setAssetPrefetch(bool enabled);
+
+/**
+ * @brief New shapes should be prefetched, see setAssetPrefetch()
+ */
+bool assetPrefetch();
+
+/**
+ * @brief Let scene builders prefetch the texture files of new materials, see prefetchTexture()
+ *
+ * For python renderers taking the decoded bitmaps from loadBitmap() rather than decoding the
+ * files themselves. Texture files are prefetched with all assets too, see setAssetPrefetch().
+ */
+void setTexturePrefetch(bool enabled);
+
+/**
+ * @brief Texture files of new materials should be prefetched, see setTexturePrefetch()
+ */
+bool texturePrefetch();
+
+/**
+ * @brief Reorder the meshes parsed from mesh files for GPU vertex caches and overdraw
+ *
+ * Parsed meshes and their levels of detail go through scene::optimizeMesh(), once per file
+ * content when the persistent mesh cache is enabled: optimized meshes have their own entries.
+ * Costs one or two seconds per million triangles. Disabled by default.
+ */
+void setMeshOptimization(bool enabled);
+
+/**
+ * @brief Meshes parsed from mesh files are optimized, see setMeshOptimization()
+ */
+bool meshOptimization();
+
+/**
+ * @brief Cache miss ratios before and after optimization of the mesh files optimized so far
+ *
+ * Files mapped from the persistent mesh cache were optimized, and reported, by an earlier
+ * process.
+ *
+ * @return Statistics of each mesh file
+ */
+std::map<std::string, scene::MeshOptimizationStats> meshOptimizationStats();
+
+/**
+ * @brief Vertex buffers made for meshes entering the asset caches
+ */
+enum class VertexBufferMode {
+    Off,   //<- meshes kept planar only
+    Float, //<- v3n3t2 floats
+    Half,  //<- float positions, half float normals and uvs
+};
+
+/**
+ * @brief Interleave meshes into GPU-ready vertex buffers when they enter the asset caches
+ *
+ * Buffers are made once per mesh and level of detail, before they are shared, so that
+ * backends upload them as is. They take about as much memory as the planar mesh data.
+ * Enabled with floats by the EGL renderer when it is created.
+ */
+void setVertexBufferMode(VertexBufferMode mode);
+
+/**
+ * @brief Vertex buffers made for new meshes, see setVertexBufferMode()
+ */
+VertexBufferMode vertexBufferMode();
+
+/**
+ * @brief Quantize the meshes entering the asset caches, see scene::MeshData::quantize()
+ *
+ * Memory meshes and the meshes parsed from mesh files, with their levels of detail, keep 16
+ * bits positions, normals and uvs instead of floats, also in serialized scene graphs. The EGL
+ * renderer draws them as is, other consumers decode them on first access. Disabled by default.
+ */
+void setMeshQuantization(bool enabled);
+
+/**
+ * @brief Meshes entering the asset caches are quantized, see setMeshQuantization()
+ */
+bool meshQuantization();
+
+/**
+ * @brief Quantize mesh data or give it the vertex buffer of the current mode, as enabled
+ *
+ * Only for data not shared with other threads yet, e.g. a mesh entering an asset cache.
+ * Quantized data has no vertex buffer.
+ *
+ * @param data - new mesh data
+ */
+void prepareMeshData(scene::MeshData& data);
+
+} // namespace render
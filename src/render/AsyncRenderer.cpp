@@ -0,0 +1,205 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "AsyncRenderer.h"
+#include "ThreadAffinity.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace render {
+
+AsyncRenderer::AsyncRenderer(const std::shared_ptr<BaseRenderer>& renderer)
+    : _state(std::make_shared<State>())
+{
+    _state->renderer = renderer;
+    _thread = std::thread(&AsyncRenderer::run, _state);
+}
+
+AsyncRenderer::~AsyncRenderer()
+{
+    _state->stop = true;
+    wake();
+    // the running job may wait for resources held by the caller (e.g. python GIL)
+    _state->renderer->blockingWait([this] { _thread.join(); });
+}
+
+void AsyncRenderer::updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                                bool materialsOnly)
+{
+    SceneUpdate update;
+    update.sceneGraph = std::make_shared<scene::SceneGraph>(*sceneGraph);
+    update.fullUpdate = true;
+    update.materialsOnly = materialsOnly;
+    push(std::move(update));
+}
+
+void AsyncRenderer::applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                                    const scene::SceneGraphDelta& delta)
+{
+    SceneUpdate update;
+    update.sceneGraph = std::make_shared<scene::SceneGraph>(*sceneGraph);
+    update.delta = delta;
+    push(std::move(update));
+}
+
+bool AsyncRenderer::renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                                const std::shared_ptr<scene::SceneView>& sceneView,
+                                FrameData& outputFrame)
+{
+    push(SceneUpdate()); //<- retries an overflowed update
+
+    // copies into the back slot, reusing its buffers unless the renderer still holds them
+    auto& slot = _state->frames.back();
+    if (slot.sceneState && slot.sceneState.use_count() == 1)
+        *slot.sceneState = *sceneState;
+    else
+        slot.sceneState = std::make_shared<scene::SceneState>(*sceneState);
+    if (slot.sceneView && slot.sceneView.use_count() == 1)
+        *slot.sceneView = *sceneView;
+    else
+        slot.sceneView = std::make_shared<scene::SceneView>(*sceneView);
+    slot.cols = outputFrame.cols;
+    slot.rows = outputFrame.rows;
+    slot.sceneUpdates = _pushedUpdates + (_overflowPending ? 1 : 0);
+    slot.stats = StageStats::current();
+
+    // poses moved in frames not taken yet are dirty in this one, which may supersede them
+    for (int nodeId : _carriedIds)
+        if (slot.sceneState->hasNode(nodeId))
+            slot.sceneState->markDirty(nodeId);
+    auto moved = sceneState->dirtyIds();
+    if (_state->frames.publish()) {
+        // the previous frame was superseded, keep carrying its moves with those of this one
+        _carriedIds.insert(_carriedIds.end(), moved.begin(), moved.end());
+    }
+    else {
+        _carriedIds = std::move(moved);
+    }
+    wake();
+
+    // hand out the last completed frame
+    _state->images.take();
+    const auto& buffer = _state->images.front();
+    if (buffer.cols == 0 || buffer.cols != outputFrame.cols || buffer.rows != outputFrame.rows)
+        return false;
+
+    if (outputFrame.color)
+        std::copy(buffer.color.begin(), buffer.color.end(), outputFrame.color);
+    if (outputFrame.depth)
+        std::copy(buffer.depth.begin(), buffer.depth.end(), outputFrame.depth);
+    if (outputFrame.mask)
+        std::copy(buffer.mask.begin(), buffer.mask.end(), outputFrame.mask);
+    return true;
+}
+
+bool AsyncRenderer::renderFrames(const std::shared_ptr<scene::SceneState>&,
+                                 const std::vector<std::shared_ptr<scene::SceneView>>&,
+                                 std::vector<FrameData>&)
+{
+    return false;
+}
+
+void AsyncRenderer::push(SceneUpdate&& update)
+{
+    // an overflowed update goes first, later ones are coalesced into it
+    if (_overflowPending && _state->updates.push(std::move(_overflow))) {
+        _overflowPending = false;
+        ++_pushedUpdates;
+    }
+    if (!update.sceneGraph)
+        return;
+    update.stats = StageStats::current();
+    if (!_overflowPending && _state->updates.push(std::move(update))) {
+        ++_pushedUpdates;
+    }
+    else {
+        // each update carries the whole scene graph, the latest one as a full update applies
+        // all of those waiting
+        update.fullUpdate = true;
+        update.materialsOnly = false;
+        update.delta = scene::SceneGraphDelta();
+        _overflow = std::move(update);
+        _overflowPending = true;
+    }
+    wake();
+}
+
+void AsyncRenderer::wake()
+{
+    // a notification missed by a thread about to wait delays it by its wait period at most
+    _state->condition.notify_one();
+}
+
+RendererMemory AsyncRenderer::memoryUsage() const
+{
+    auto memory = _state->renderer->memoryUsage();
+    memory.hostBytes += _state->bufferBytes;
+    return memory;
+}
+
+int AsyncRenderer::numaNode() const
+{
+    const int node = _state->node;
+    return node >= 0 ? node : _state->renderer->numaNode();
+}
+
+void AsyncRenderer::run(std::shared_ptr<State> state)
+{
+    Trace::setThreadName("async render");
+    FrameSlot* frame = nullptr; //<- taken, waiting for the scene updates pushed before it
+    uint64_t appliedUpdates = 0;
+    while (!state->stop) {
+        const int node = state->node;
+        placeThread("async render", node >= 0 ? node : state->renderer->numaNode());
+        if (!frame && state->frames.take())
+            frame = &state->frames.front();
+
+        SceneUpdate update;
+        while ((!frame || appliedUpdates < frame->sceneUpdates) && state->updates.pop(update)) {
+            // stages are timed into the stats of the client which pushed the update
+            StageStats::Scope stats(update.stats);
+            TraceScope trace("async_scene_update");
+            if (update.fullUpdate)
+                state->renderer->updateScene(update.sceneGraph, update.materialsOnly);
+            else
+                state->renderer->applySceneDelta(update.sceneGraph, update.delta);
+            ++appliedUpdates;
+        }
+
+        if (frame && appliedUpdates >= frame->sceneUpdates) {
+            StageStats::Scope stats(frame->stats);
+            TraceScope trace("async_frame");
+            auto& buffer = state->images.back();
+            const size_t pixels = size_t(frame->cols) * size_t(frame->rows);
+            // only this thread resizes the buffers, of 4 bytes per pixel in each plane
+            state->bufferBytes -= buffer.color.size() * 3;
+            buffer.cols = frame->cols;
+            buffer.rows = frame->rows;
+            buffer.color.resize(pixels * 4);
+            buffer.depth.resize(pixels);
+            buffer.mask.resize(pixels);
+            state->bufferBytes += buffer.color.size() * 3;
+
+            const auto& view = *frame->sceneView;
+            FrameData output{
+                buffer.cols, buffer.rows,
+                view.hasOutputChannel(scene::OutputChannel::Color) ? buffer.color.data() : nullptr,
+                view.hasOutputChannel(scene::OutputChannel::Depth) ? buffer.depth.data() : nullptr,
+                view.hasOutputChannel(scene::OutputChannel::Mask) ? buffer.mask.data() : nullptr};
+            if (state->renderer->renderFrame(frame->sceneState, frame->sceneView, output))
+                state->images.publish();
+            frame = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->condition.wait_for(lock, std::chrono::milliseconds(1), [&] {
+            return state->stop || !state->updates.empty() || (!frame && state->frames.fresh());
+        });
+    }
+}
+
+} // namespace render
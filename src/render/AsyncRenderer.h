@@ -0,0 +1,186 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+#include "LockFree.h"
+#include "StageStats.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Renderer running another renderer on a dedicated thread
+ *
+ * Scene updates and frames are snapshotted and queued to the render thread, so that the caller
+ * does not wait for rendering to complete. renderFrame() returns the last completed frame, that
+ * is with one request of latency, and returns false until the first frame is ready.
+ *
+ * The caller never blocks on the render thread: frames are published through a lock-free
+ * triple buffer of scene state and view copies, scene updates through a bounded lock-free
+ * queue, and completed images come back through another triple buffer. Frames requested while
+ * the previous one is still queued supersede it, its moved poses flagged dirty in the next one;
+ * scene updates overflowing the queue are coalesced into a full update.
+ */
+class AsyncRenderer : public BaseRenderer
+{
+  public:
+    /**
+     * @brief Construct a new Async Renderer object
+     *
+     * @param renderer - renderer to run on the render thread
+     */
+    explicit AsyncRenderer(const std::shared_ptr<BaseRenderer>& renderer);
+
+    /**
+     * @brief Stop the render thread
+     *
+     * Joins the thread after the job it is running, if any, through blockingWait() so that a
+     * wrapped python renderer can finish its call.
+     */
+    ~AsyncRenderer() override;
+
+    /**
+     * @brief Wrapped renderer
+     */
+    const std::shared_ptr<BaseRenderer>& renderer() const { return _state->renderer; }
+
+    /**
+     * @brief NUMA node the render thread is placed on, that of the wrapped renderer if -1, see
+     * placeThread()
+     *
+     * The images of the render thread are first touched by it, so local to its node.
+     */
+    int numaNode() const override;
+    /** @overload */
+    void setNumaNode(int node) { _state->node = node; }
+
+    /**
+     * @brief The wrapped renderer draws base layers
+     */
+    bool drawsBaseLayer() const override { return _state->renderer->drawsBaseLayer(); }
+
+    /**
+     * @brief Upload through the wrapped renderer, safe while the render thread draws
+     */
+    bool uploadAssets(const scene::Shape& shape) override
+    {
+        return _state->renderer->uploadAssets(shape);
+    }
+
+    /**
+     * @brief Wait as the wrapped renderer does
+     */
+    void blockingWait(const std::function<void()>& wait) override
+    {
+        _state->renderer->blockingWait(wait);
+    }
+
+    /**
+     * @brief Queue a full scene update
+     */
+    void updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                     bool materialsOnly) override;
+
+    /**
+     * @brief Queue an incremental scene update
+     */
+    void applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                         const scene::SceneGraphDelta& delta) override;
+
+    /**
+     * @brief Queue a frame and copy the last completed one to \p outputFrame
+     *
+     * @return True if a completed frame matching the \p outputFrame size was copied
+     */
+    bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                     const std::shared_ptr<scene::SceneView>& sceneView,
+                     FrameData& outputFrame) override;
+
+    /**
+     * @brief Batches write to caller memory synchronously, not supported in this mode
+     *
+     * @return False
+     */
+    bool renderFrames(const std::shared_ptr<scene::SceneState>& sceneState,
+                      const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                      std::vector<FrameData>& outputFrames) override;
+
+    /**
+     * @brief Memory of the wrapped renderer, with the buffers of the render thread
+     */
+    RendererMemory memoryUsage() const override;
+
+  private:
+    /**
+     * @brief Rendered images owned by the render thread until published
+     */
+    struct FrameBuffer {
+        int cols = 0;
+        int rows = 0;
+        std::vector<uint8_t> color;
+        std::vector<float> depth;
+        std::vector<int> mask;
+    };
+
+    /**
+     * @brief Published frame request
+     */
+    struct FrameSlot {
+        std::shared_ptr<scene::SceneState> sceneState;
+        std::shared_ptr<scene::SceneView> sceneView;
+        int cols = 0;
+        int rows = 0;
+        uint64_t sceneUpdates = 0; //<- scene updates pushed before the frame, applied first
+        std::shared_ptr<StageStats> stats; //<- stats current on the publishing thread
+    };
+
+    /**
+     * @brief Queued scene update
+     */
+    struct SceneUpdate {
+        std::shared_ptr<scene::SceneGraph> sceneGraph;
+        scene::SceneGraphDelta delta;
+        bool fullUpdate = false;
+        bool materialsOnly = false;
+        std::shared_ptr<StageStats> stats;
+    };
+
+    /**
+     * @brief State shared with the render thread
+     */
+    struct State {
+        std::shared_ptr<BaseRenderer> renderer;
+        TripleBuffer<FrameSlot> frames;   //<- caller to render thread
+        SpscQueue<SceneUpdate> updates{64};
+        TripleBuffer<FrameBuffer> images; //<- render thread to caller
+        std::atomic<size_t> bufferBytes{0}; //<- size of the three image buffers
+        std::atomic<bool> stop{false};
+        std::atomic<int> node{-1}; //<- set by setNumaNode()
+        // wakes the render thread, notified without the lock
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+
+    static void run(std::shared_ptr<State> state);
+    void push(SceneUpdate&& update);
+    void wake();
+
+    std::shared_ptr<State> _state;
+    std::thread _thread;
+    // caller side
+    uint64_t _pushedUpdates = 0; //<- scene updates pushed to the queue
+    SceneUpdate _overflow; //<- full update waiting for room in the queue
+    bool _overflowPending = false;
+    std::vector<int> _carriedIds; //<- moved in frames published since the last one taken
+};
+
+} // namespace render
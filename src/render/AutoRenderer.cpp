@@ -0,0 +1,326 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "AutoRenderer.h"
+
+#ifdef WITH_EGL
+#include "EGLRenderer.h"
+#endif
+#ifdef WITH_TINYRENDERER
+#include "TinyRendererBackend.h"
+#endif
+#ifdef WITH_VULKAN
+#include "VulkanRenderer.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+
+namespace render {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const size_t NoBackend = std::numeric_limits<size_t>::max();
+
+size_t countShapes(const scene::SceneGraph& sceneGraph)
+{
+    size_t shapes = 0;
+    for (const auto& it : sceneGraph.nodes())
+        shapes += it.second.shapes().size();
+    return shapes;
+}
+
+} // namespace
+
+AutoRenderer::AutoRenderer(std::vector<Candidate> candidates, int calibrationFrames)
+    : _calibrationFrames(std::max(calibrationFrames, 1))
+{
+    if (candidates.empty())
+        candidates = probeBackends();
+    if (candidates.empty())
+        throw std::invalid_argument("AutoRenderer: no backend available");
+    for (auto& candidate : candidates) {
+        if (!candidate.second)
+            throw std::invalid_argument("AutoRenderer: null backend " + candidate.first);
+        Backend backend;
+        backend.name = std::move(candidate.first);
+        backend.renderer = std::move(candidate.second);
+        _backends.push_back(std::move(backend));
+    }
+}
+
+std::vector<AutoRenderer::Candidate> AutoRenderer::probeBackends(int device, int numThreads)
+{
+    // backends failing to start, e.g. without a GPU, are left out
+    std::vector<Candidate> candidates;
+#ifdef WITH_EGL
+    try {
+        candidates.emplace_back("egl", std::make_shared<EGLRenderer>(device));
+    }
+    catch (const std::exception&) {
+    }
+#endif
+#ifdef WITH_VULKAN
+    try {
+        candidates.emplace_back("vulkan", std::make_shared<VulkanRenderer>(device));
+    }
+    catch (const std::exception&) {
+    }
+#endif
+#ifdef WITH_TINYRENDERER
+    candidates.emplace_back("tiny", std::make_shared<TinyRendererBackend>(numThreads));
+#endif
+    (void)device;
+    (void)numThreads;
+    return candidates;
+}
+
+std::vector<std::string> AutoRenderer::candidates() const
+{
+    std::vector<std::string> names;
+    for (const auto& backend : _backends)
+        names.push_back(backend.name);
+    return names;
+}
+
+std::string AutoRenderer::backend() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _current;
+}
+
+std::vector<AutoDecision> AutoRenderer::decisions() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _decisions;
+}
+
+void AutoRenderer::recalibrate()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _choices.clear();
+    for (auto& backend : _backends)
+        backend.chosen = false;
+}
+
+void AutoRenderer::updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                               bool materialsOnly)
+{
+    _sceneGraph = sceneGraph;
+    if (!materialsOnly) {
+        _shapes = countShapes(*sceneGraph);
+        const size_t change =
+            _shapes > _calibratedShapes ? _shapes - _calibratedShapes : _calibratedShapes - _shapes;
+        if (_adaptive && !_choices.empty() && change * 2 >= std::max(_calibratedShapes, size_t(1)))
+            recalibrate();
+    }
+    for (auto& backend : _backends) {
+        if (backend.chosen && backend.synced)
+            backend.renderer->updateScene(sceneGraph, materialsOnly);
+        else
+            backend.synced = false; //<- whole scene passed once needed
+    }
+}
+
+void AutoRenderer::applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                                   const scene::SceneGraphDelta& delta)
+{
+    _sceneGraph = sceneGraph;
+    for (auto& backend : _backends) {
+        if (backend.chosen && backend.synced)
+            backend.renderer->applySceneDelta(sceneGraph, delta);
+        else
+            backend.synced = false;
+    }
+}
+
+bool AutoRenderer::uploadAssets(const scene::Shape& shape)
+{
+    std::vector<std::shared_ptr<BaseRenderer>> renderers;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto& backend : _backends)
+            if (backend.chosen)
+                renderers.push_back(backend.renderer);
+    }
+    bool uploaded = false;
+    for (const auto& renderer : renderers)
+        uploaded = renderer->uploadAssets(shape) || uploaded;
+    return uploaded;
+}
+
+bool AutoRenderer::drawsBaseLayer() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return std::all_of(_backends.begin(), _backends.end(), [](const Backend& backend) {
+        return backend.renderer->drawsBaseLayer();
+    });
+}
+
+void AutoRenderer::blockingWait(const std::function<void()>& wait)
+{
+    std::vector<std::shared_ptr<BaseRenderer>> renderers;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto& backend : _backends)
+            renderers.push_back(backend.renderer);
+    }
+    // nested, the innermost wait runs with the locks of all the backends released
+    std::function<void(size_t)> waitFrom = [&](size_t index) {
+        if (index == renderers.size())
+            wait();
+        else
+            renderers[index]->blockingWait([&] { waitFrom(index + 1); });
+    };
+    waitFrom(0);
+}
+
+void AutoRenderer::sync(Backend& backend)
+{
+    if (backend.synced)
+        return;
+    if (_sceneGraph)
+        backend.renderer->updateScene(_sceneGraph, false);
+    backend.synced = true;
+}
+
+size_t AutoRenderer::calibrate(const Key& key, const std::shared_ptr<scene::SceneState>& sceneState,
+                               const std::shared_ptr<scene::SceneView>& sceneView,
+                               FrameData& outputFrame)
+{
+    AutoDecision decision;
+    std::tie(decision.cols, decision.rows, decision.channels) = key;
+    size_t fastest = NoBackend;
+    double fastestTime = 0.0;
+    for (size_t i = 0; i < _backends.size(); ++i) {
+        auto& backend = _backends[i];
+        // best time after the warm-up frame uploading the assets
+        double best = std::numeric_limits<double>::infinity();
+        try {
+            sync(backend);
+            for (int f = 0; f < _calibrationFrames; ++f) {
+                FrameData frame = outputFrame;
+                const auto start = Clock::now();
+                if (!backend.renderer->renderFrame(sceneState, sceneView, frame)) {
+                    best = -1.0;
+                    break;
+                }
+                if (f > 0 || _calibrationFrames == 1)
+                    best = std::min(
+                        best, std::chrono::duration<double>(Clock::now() - start).count());
+            }
+        }
+        catch (const std::exception&) {
+            best = -1.0;
+        }
+        decision.frameTimes.emplace_back(backend.name, best);
+        if (best >= 0.0 && (fastest == NoBackend || best < fastestTime)) {
+            fastest = i;
+            fastestTime = best;
+        }
+    }
+    if (fastest == NoBackend)
+        return NoBackend; //<- calibrated again on the next frame
+
+    decision.backend = _backends[fastest].name;
+    if (!_quiet) {
+        std::string times;
+        for (const auto& time : decision.frameTimes) {
+            char text[64];
+            if (time.second < 0.0)
+                std::snprintf(text, sizeof(text), "%s failed", time.first.c_str());
+            else
+                std::snprintf(text, sizeof(text), "%s %.2f ms", time.first.c_str(),
+                              time.second * 1e3);
+            times += (times.empty() ? "" : ", ") + std::string(text);
+        }
+        std::fprintf(stderr, "AutoRenderer: %s for %dx%d frames of channels %d (%s)\n",
+                     decision.backend.c_str(), decision.cols, decision.rows, decision.channels,
+                     times.c_str());
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _choices[key] = fastest;
+    _backends[fastest].chosen = true;
+    _calibratedShapes = _shapes;
+    _decisions.push_back(std::move(decision));
+    return fastest;
+}
+
+size_t AutoRenderer::backendOf(const std::shared_ptr<scene::SceneState>& sceneState,
+                               const std::shared_ptr<scene::SceneView>& sceneView,
+                               FrameData& outputFrame)
+{
+    const Key key{outputFrame.cols, outputFrame.rows, sceneView->outputChannels()};
+    const auto it = _choices.find(key);
+    const size_t index =
+        it != _choices.end() ? it->second : calibrate(key, sceneState, sceneView, outputFrame);
+    if (index != NoBackend) {
+        sync(_backends[index]);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _current = _backends[index].name;
+    }
+    return index;
+}
+
+bool AutoRenderer::renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                               const std::shared_ptr<scene::SceneView>& sceneView,
+                               FrameData& outputFrame)
+{
+    if (!sceneView->camera() || outputFrame.cols <= 0 || outputFrame.rows <= 0)
+        return false;
+    const size_t index = backendOf(sceneState, sceneView, outputFrame);
+    if (index == NoBackend)
+        return false;
+    return _backends[index].renderer->renderFrame(sceneState, sceneView, outputFrame);
+}
+
+bool AutoRenderer::renderFrames(const std::shared_ptr<scene::SceneState>& sceneState,
+                                const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                                std::vector<FrameData>& outputFrames)
+{
+    const size_t count = std::min(sceneViews.size(), outputFrames.size());
+    std::vector<size_t> indices(count, NoBackend);
+    bool shared = count > 0;
+    for (size_t i = 0; i < count; ++i) {
+        const auto& frame = outputFrames[i];
+        if (sceneViews[i]->camera() && frame.cols > 0 && frame.rows > 0)
+            indices[i] = backendOf(sceneState, sceneViews[i], outputFrames[i]);
+        shared = shared && indices[i] == indices[0];
+    }
+    // views of one backend drawn at once, e.g. by its parallel or instanced paths
+    if (shared && indices[0] != NoBackend)
+        return _backends[indices[0]].renderer->renderFrames(sceneState, sceneViews, outputFrames);
+
+    bool rendered = true;
+    for (size_t i = 0; i < count; ++i) {
+        if (indices[i] == NoBackend)
+            rendered = false;
+        else
+            rendered = _backends[indices[i]].renderer->renderFrame(sceneState, sceneViews[i],
+                                                                   outputFrames[i]) &&
+                       rendered;
+    }
+    return rendered;
+}
+
+RendererMemory AutoRenderer::memoryUsage() const
+{
+    RendererMemory memory;
+    for (const auto& backend : _backends) {
+        const auto usage = backend.renderer->memoryUsage();
+        memory.gpuBytes += usage.gpuBytes;
+        memory.peakGpuBytes += usage.peakGpuBytes;
+        memory.hostBytes += usage.hostBytes;
+    }
+    return memory;
+}
+
+} // namespace render
@@ -0,0 +1,178 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Backend chosen by an AutoRenderer for a frame size and channel set
+ */
+struct AutoDecision {
+    int cols = 0;
+    int rows = 0;
+    int channels = 0; //<- scene::OutputChannel flags of the views
+    std::string backend; //<- name of the fastest candidate
+    std::vector<std::pair<std::string, double>> frameTimes; //<- seconds, -1 for a failure
+};
+
+/**
+ * @brief Renderer drawing each frame with the fastest of several backends
+ *
+ * Backends are either given, e.g. python renderers, or probed at construction: the EGL renderer
+ * of the device, the TinyRenderer backend with the threads of the scheduler and the Vulkan
+ * renderer, those built and able to start. The first frame of each size and channel set is
+ * drawn by every candidate a few times on the actual scene, the fastest one, by its best time
+ * after a warm-up frame, drawing the frames of that size and channel set from then on. Each
+ * decision is kept, see decisions(), and logged to stderr unless quiet.
+ *
+ * Scene updates are passed to the chosen backends only; the others get the whole scene again
+ * when calibrated. Adaptive renderers calibrate again once a full scene update changes the
+ * number of shapes by half or more, switching backends if another one got faster.
+ */
+class AutoRenderer : public BaseRenderer
+{
+  public:
+    using Candidate = std::pair<std::string, std::shared_ptr<BaseRenderer>>;
+
+    /**
+     * @brief Create a renderer choosing among \p candidates
+     *
+     * @param candidates - named backends, probed ones if empty, see probeBackends()
+     * @param calibrationFrames - frames drawn by each candidate per calibration, warm-up included
+     * @throw std::invalid_argument - if there is no backend or one is null
+     */
+    explicit AutoRenderer(std::vector<Candidate> candidates = {}, int calibrationFrames = 3);
+
+    /**
+     * @brief Native backends built and able to start, "egl", "vulkan" then "tiny"
+     *
+     * @param device - EGL and Vulkan device index, -1 for the default one
+     * @param numThreads - TinyRenderer threads, 0 for the scheduler setting
+     */
+    static std::vector<Candidate> probeBackends(int device = -1, int numThreads = 0);
+
+    /**
+     * @brief Names of the candidates
+     */
+    std::vector<std::string> candidates() const;
+
+    /**
+     * @brief Name of the backend of the last frame, empty before the first one
+     */
+    std::string backend() const;
+
+    /**
+     * @brief Decisions made, the latest last
+     */
+    std::vector<AutoDecision> decisions() const;
+
+    /**
+     * @brief Calibrate again on the next frame of each size and channel set
+     */
+    void recalibrate();
+
+    /**
+     * @brief Calibrate again after full scene updates changing the number of shapes by half
+     */
+    bool adaptive() const { return _adaptive; }
+    /** @overload */
+    void setAdaptive(bool adaptive) { _adaptive = adaptive; }
+
+    /**
+     * @brief Decisions are not logged to stderr
+     */
+    bool quiet() const { return _quiet; }
+    /** @overload */
+    void setQuiet(bool quiet) { _quiet = quiet; }
+
+    /**
+     * @brief Update the scene of the chosen backends, the others being updated when calibrated
+     */
+    void updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                     bool materialsOnly) override;
+
+    /**
+     * @brief Apply changes to the scene of the chosen backends
+     */
+    void applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                         const scene::SceneGraphDelta& delta) override;
+
+    /**
+     * @brief Upload the assets of a shape to the chosen backends
+     */
+    bool uploadAssets(const scene::Shape& shape) override;
+
+    /**
+     * @brief All the backends draw base layers, any of them may render a frame
+     */
+    bool drawsBaseLayer() const override;
+
+    /**
+     * @brief Wait as each of the backends does
+     */
+    void blockingWait(const std::function<void()>& wait) override;
+
+    /**
+     * @brief Render with the backend of the frame size and channel set, calibrated first
+     */
+    bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                     const std::shared_ptr<scene::SceneView>& sceneView,
+                     FrameData& outputFrame) override;
+
+    /**
+     * @brief Render views at once if they share a backend, one by one otherwise
+     */
+    bool renderFrames(const std::shared_ptr<scene::SceneState>& sceneState,
+                      const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                      std::vector<FrameData>& outputFrames) override;
+
+    /**
+     * @brief Memory of all the candidates
+     */
+    RendererMemory memoryUsage() const override;
+
+  private:
+    using Key = std::tuple<int, int, int>; //<- cols, rows, channels
+
+    /**
+     * @brief Candidate backend and the state of its scene
+     */
+    struct Backend {
+        std::string name;
+        std::shared_ptr<BaseRenderer> renderer;
+        bool synced = false; //<- has the current scene
+        bool chosen = false; //<- by a decision, receives scene updates
+    };
+
+    size_t backendOf(const std::shared_ptr<scene::SceneState>& sceneState,
+                     const std::shared_ptr<scene::SceneView>& sceneView, FrameData& outputFrame);
+    size_t calibrate(const Key& key, const std::shared_ptr<scene::SceneState>& sceneState,
+                     const std::shared_ptr<scene::SceneView>& sceneView, FrameData& outputFrame);
+    void sync(Backend& backend);
+
+    std::vector<Backend> _backends;
+    int _calibrationFrames = 3;
+    bool _adaptive = false;
+    bool _quiet = false;
+    std::shared_ptr<scene::SceneGraph> _sceneGraph; //<- last scene, for backends not synced
+    size_t _shapes = 0; //<- shapes of the last scene
+    size_t _calibratedShapes = 0; //<- shapes of the scene at the last calibration
+    std::map<Key, size_t> _choices; //<- backend index per frame size and channel set
+    mutable std::mutex _mutex; //<- decisions read by other threads
+    std::vector<AutoDecision> _decisions;
+    std::string _current;
+};
+
+} // namespace render
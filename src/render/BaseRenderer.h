@@ -8,11 +8,40 @@
 #include <scene/SceneState.h>
 #include <scene/SceneView.h>
 
+#include <functional>
+#include <vector>
+
 namespace render {
 
 /**
  * @brief Memory buffer to write rendered frame
  *
+ * Planes of channels not requested by the scene view output channels are null. Planes are lent
+ * by the caller for the duration of a renderFrame() or renderFrames() call only: a renderer
+ * writes into them directly, e.g. reading pixels back into them, and must not keep them, nor
+ * views of them, once the call returned as they may be reallocated for the next frame.
+ *
+ * Renderers computing the points of the Points channel themselves set numPoints to cols * rows,
+ * the others leave it to completePoints() to unproject the depth plane.
+ *
+ * Channels of reduced formats, see scene::SceneView::colorFormat(), have a packed plane besides
+ * the full one. Renderers converting them on the GPU write the packed planes, leaving the full
+ * ones of those channels untouched unless points are requested, and set packed; the others
+ * write the full planes and leave the conversion to packFrame().
+ *
+ * Renderers drawing the Motion channel themselves set motionDrawn, the others leave it to
+ * completeMotion() to reproject the depth plane. Likewise for normalsDrawn and completeNormals(),
+ * and depthPyramidDrawn and completeDepthPyramid().
+ *
+ * Renderers finding the events of the Events channel themselves set numEvents, the others leave
+ * it to EventCamera::complete() to compare the color plane with that of the previous frame.
+ *
+ * Renderers counting the pixels of the Visibility channel themselves set numPixelCounts, the
+ * others leave it to completePixelCounts() to count the mask plane. With the Visibility channel
+ * but not the Mask one, the mask plane is scratch for the latter: renderers counting the pixels
+ * do not read it back. With the Boxes channel, whichever counts the pixels also bounds them.
+ *
+ * The Keypoints channel is projected by completeKeypoints().
  */
 struct FrameData {
     const int cols; //<- image width
@@ -20,11 +49,45 @@ struct FrameData {
     uint8_t* const color; //<- pointer to the color plane memory
     float* const depth; //<- pointer to the depth plane memory
     int* const mask; //<- pointer to the mask plane memory
+    float* const points = nullptr; //<- pointer to the XYZ points memory, 3 floats per pixel
+    int* const pointIds = nullptr; //<- pointer to the segmentation ids of compacted points
+    uint8_t* const packedColor = nullptr; //<- pointer to the RGB plane memory
+    uint16_t* const packedDepth = nullptr; //<- pointer to the half float or scaled depth plane
+    uint16_t* const packedMask = nullptr; //<- pointer to the 16-bit mask plane memory
+    uint16_t* const motion = nullptr; //<- pointer to the motion plane memory, 2 half floats
+    uint16_t* const normals = nullptr; //<- pointer to the camera frame normals, 3 half floats
+    float* const depthPyramid = nullptr; //<- pointer to the depth pyramid, see depthLevelOffset()
+    float* const events = nullptr; //<- (x, y, t, polarity) of each event, room for cols * rows
+    int* const pixelCounts = nullptr; //<- (id, pixels) of each id seen, room for cols * rows
+    int* const boxes = nullptr; //<- (x0, y0, x1, y1) of each id of pixelCounts, same room
+    float* const keypoints = nullptr; //<- (x, y, depth, visible) of each view keypoint
+    int numPoints = -1; //<- points written, -1 until computed, see completePoints()
+    bool packed = false; //<- packed planes written by the renderer, see packFrame()
+    bool motionDrawn = false; //<- motion plane written by the renderer, see completeMotion()
+    bool normalsDrawn = false; //<- normals written by the renderer, see completeNormals()
+    bool depthPyramidDrawn = false; //<- pyramid written by the renderer
+    int numEvents = -1; //<- events written, -1 until computed, see EventCamera::complete()
+    int numPixelCounts = -1; //<- ids written, -1 until counted, see completePixelCounts()
+};
+
+/**
+ * @brief Memory held by a renderer besides the scene graph assets, see memoryUsage()
+ */
+struct RendererMemory {
+    size_t gpuBytes = 0; //<- meshes, textures and render targets on the GPU
+    size_t peakGpuBytes = 0; //<- highest GPU bytes since the renderer was created
+    size_t hostBytes = 0; //<- frame buffers and copies of the assets in memory
 };
 
 /**
  * @brief Interface for all renderers
  *
+ * Renderers wrapping another one, NativeRenderer of the bindings, AsyncRenderer and
+ * AutoRenderer, hide the overrides of the wrapped renderer: a virtual added here must be
+ * considered for each of them. Defaults returning false to fall back to a full update, like
+ * those of the updateShape*() calls, are safe to keep; defaults of capabilities, like
+ * numaNode(), drawsBaseLayer(), uploadAssets() and blockingWait(), silently disable them unless
+ * forwarded.
  */
 class BaseRenderer
 {
@@ -44,6 +107,217 @@ class BaseRenderer
     virtual void updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
                              bool materialsOnly) = 0;
 
+    /**
+     * @brief Apply changes \p delta made to a scene since the previous update
+     *
+     * The default implementation streams texture pixels through updateShapeTexels(), mesh
+     * vertices through updateShapeGeometry() and materials through updateShapeMaterial(), a node
+     * may go through both, and falls back to a full updateScene() when nodes were added or
+     * removed or a shape was not updated.
+     *
+     * @param sceneGraph - scene description, already containing the changes
+     * @param delta - ids of added, removed and material-changed nodes
+     */
+    virtual void applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                                 const scene::SceneGraphDelta& delta)
+    {
+        // pixels change in place whatever else changed, otherwise materials are updated again
+        bool texels = true;
+        for (int nodeId : delta.texelsChanged()) {
+            const auto& shapes = sceneGraph->nodes().at(nodeId).shapes();
+            for (int i = 0; i < int(shapes.size()); ++i) {
+                const auto& material = shapes[i].material();
+                if (material && material->diffuseTexture())
+                    texels = updateShapeTexels(nodeId, i, material->diffuseTexture()) && texels;
+            }
+        }
+        if (!texels) {
+            updateScene(sceneGraph, delta.materialsOnly() || delta.texelsOnly());
+            return;
+        }
+        if (delta.texelsOnly())
+            return;
+        if (delta.added().empty() && delta.removed().empty()) {
+            bool updated = true;
+            for (int nodeId : delta.geometryChanged()) {
+                const auto& shapes = sceneGraph->nodes().at(nodeId).shapes();
+                for (int i = 0; i < int(shapes.size()); ++i) {
+                    const auto& mesh = shapes[i].mesh();
+                    if (mesh && mesh->data())
+                        updated = updateShapeGeometry(nodeId, i, mesh->data()) && updated;
+                    else if (const auto& heightfield = shapes[i].heightfield())
+                        updated = updateShapeHeightfield(nodeId, i, heightfield) && updated;
+                }
+            }
+            for (int nodeId : delta.changed()) {
+                const auto& shapes = sceneGraph->nodes().at(nodeId).shapes();
+                for (int i = 0; i < int(shapes.size()); ++i)
+                    updated = updateShapeMaterial(nodeId, i, shapes[i].material()) && updated;
+            }
+            if (updated)
+                return;
+        }
+        updateScene(sceneGraph, delta.materialsOnly());
+    }
+
+    /**
+     * @brief Upload mesh vertices and normals rewritten in place, e.g. for a deformable body
+     *
+     * Called by the default applySceneDelta() when only geometry changed. Indices, uvs and the
+     * vertex count are unchanged, so a GPU backend may update its vertex buffers in place.
+     * The default implementation returns false, falling back to a full updateScene().
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node
+     * @param meshData - mesh data holding the new vertices and normals
+     *
+     * @return True if updated
+     */
+    virtual bool updateShapeGeometry(int /*nodeId*/, int /*shapeIndex*/,
+                                     const std::shared_ptr<scene::MeshData>& /*meshData*/)
+    {
+        return false;
+    }
+
+    /**
+     * @brief Upload heights rewritten in place of a heightfield shape
+     *
+     * Called by the default applySceneDelta() when only geometry changed. The grid size is
+     * unchanged, tiles whose revision differs from the drawn ones have new heights. The default
+     * implementation returns false, falling back to a full updateScene().
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node
+     * @param heightfield - heightfield holding the new heights
+     *
+     * @return True if updated
+     */
+    virtual bool updateShapeHeightfield(int /*nodeId*/, int /*shapeIndex*/,
+                                        const std::shared_ptr<scene::Heightfield>& /*heightfield*/)
+    {
+        return false;
+    }
+
+    /**
+     * @brief Change the color and texture of a shape in place
+     *
+     * Called by the default applySceneDelta() for every shape of the nodes whose materials
+     * changed, e.g. by a batch of changeVisualShape calls for domain randomization, so that a
+     * backend only updates its per-shape uniforms. The default implementation returns false,
+     * falling back to a full updateScene().
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node
+     * @param material - new shape material, may be null
+     *
+     * @return True if updated
+     */
+    virtual bool updateShapeMaterial(int /*nodeId*/, int /*shapeIndex*/,
+                                     const std::shared_ptr<scene::Material>& /*material*/)
+    {
+        return false;
+    }
+
+    /**
+     * @brief Upload texture pixels rewritten in place, e.g. a video frame
+     *
+     * Called by the default applySceneDelta() for every textured shape of the nodes whose
+     * texture pixels changed, see scene::SceneGraph::changeTexels(). The bitmap size is
+     * unchanged and its revision differs from the uploaded one, a GPU backend may update the
+     * texture with a sub-image upload, once for all shapes sharing it. The default
+     * implementation returns false, falling back to an updateScene() of the materials.
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node
+     * @param texture - shape diffuse texture, holding the new pixels
+     *
+     * @return True if updated
+     */
+    virtual bool updateShapeTexels(int /*nodeId*/, int /*shapeIndex*/,
+                                   const std::shared_ptr<scene::Texture>& /*texture*/)
+    {
+        return false;
+    }
+
+    /**
+     * @brief World matrices of the instances of a group, for one instanced draw
+     *
+     * Each matrix is the node pose combined with the local pose of its mesh shape, in the
+     * column-major layout of SceneState::matrices(). Nodes without a state are skipped.
+     *
+     * @param sceneGraph - scene description
+     * @param sceneState - scene state
+     * @param nodeIds - ids of the nodes of an instance group
+     *
+     * @return One matrix per instance
+     */
+    static std::vector<Matrix4f> instanceMatrices(const scene::SceneGraph& sceneGraph,
+                                                  const scene::SceneState& sceneState,
+                                                  const std::vector<int>& nodeIds)
+    {
+        std::vector<Matrix4f> matrices;
+        matrices.reserve(nodeIds.size());
+        for (int nodeId : nodeIds) {
+            const auto node = sceneGraph.nodes().find(nodeId);
+            if (node == sceneGraph.nodes().end() || !sceneState.hasNode(nodeId))
+                continue;
+            const auto& shapePose = node->second.shape(0).pose();
+            matrices.push_back(multiply(sceneState.matrix(nodeId), shapePose.matrix()));
+        }
+        return matrices;
+    }
+
+    /**
+     * @brief Memory held by the renderer, safe to call while another thread renders
+     *
+     * The default implementation reports nothing, e.g. for python renderers.
+     */
+    virtual RendererMemory memoryUsage() const { return {}; }
+
+    /**
+     * @brief NUMA node of the GPU the renderer draws on, -1 if unknown
+     *
+     * Threads driving the renderer are placed on it, see placeThread(). The default
+     * implementation knows of no GPU, e.g. for python renderers.
+     */
+    virtual int numaNode() const { return -1; }
+
+    /**
+     * @brief Draw the base layer of the scene graphs, see scene::SceneGraph::baseLayer()
+     *
+     * Clients keep the nodes of the bodies of a base layer out of the scene graph of a renderer
+     * drawing it, and in it otherwise. The default implementation draws none, e.g. for python
+     * renderers.
+     */
+    virtual bool drawsBaseLayer() const { return false; }
+
+    /**
+     * @brief Upload the loaded mesh and texture of a shape ahead of the frames drawing it
+     *
+     * Safe to call while another thread renders. Uploads not used by the scene of the next frame
+     * may be released by it. The default implementation uploads nothing, e.g. for python
+     * renderers.
+     *
+     * @param shape - shape whose assets were loaded, see loadMeshData() and loadBitmap()
+     *
+     * @return True if something was uploaded
+     */
+    virtual bool uploadAssets(const scene::Shape& /*shape*/)
+    {
+        return false;
+    }
+
+    /**
+     * @brief Run \p wait, blocking until another thread driving the renderer is done
+     *
+     * Renderers calling into an interpreter release its lock around \p wait when the calling
+     * thread holds it, so that the other thread can finish its call, e.g. python renderers and
+     * the GIL. The default implementation just runs \p wait.
+     *
+     * @param wait - blocks until the other thread is done
+     */
+    virtual void blockingWait(const std::function<void()>& wait) { wait(); }
+
     /**
      * @brief Render a scene at state \p sceneState with a view settings \p sceneView
      *
@@ -56,6 +330,27 @@ class BaseRenderer
     virtual bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
                              const std::shared_ptr<scene::SceneView>& sceneView,
                              FrameData& outputFrame) = 0;
+
+    /**
+     * @brief Render a scene at state \p sceneState from several views at once
+     *
+     * The default implementation calls renderFrame() for each view.
+     *
+     * @param sceneState - scene state, e.g. transformations of all objects
+     * @param sceneViews - view settings, one per output frame
+     * @param outputFrames - rendered images
+     *
+     * @return True if all views rendered
+     */
+    virtual bool renderFrames(const std::shared_ptr<scene::SceneState>& sceneState,
+                              const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                              std::vector<FrameData>& outputFrames)
+    {
+        bool rendered = true;
+        for (size_t i = 0; i < sceneViews.size() && i < outputFrames.size(); ++i)
+            rendered = renderFrame(sceneState, sceneViews[i], outputFrames[i]) && rendered;
+        return rendered;
+    }
 };
 
 } // namespace render
@@ -0,0 +1,122 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "BatchRenderer.h"
+
+#include <stdexcept>
+
+namespace render {
+
+void BatchRenderer::Environment::updateScene(const std::shared_ptr<scene::SceneGraph>& graph,
+                                             bool)
+{
+    sceneGraph = graph;
+    changed = true;
+}
+
+void BatchRenderer::Environment::applySceneDelta(const std::shared_ptr<scene::SceneGraph>& graph,
+                                                 const scene::SceneGraphDelta&)
+{
+    sceneGraph = graph;
+    changed = true;
+}
+
+bool BatchRenderer::Environment::updateShapeGeometry(int, int,
+                                                     const std::shared_ptr<scene::MeshData>&)
+{
+    changed = true;
+    return true;
+}
+
+bool BatchRenderer::Environment::renderFrame(const std::shared_ptr<scene::SceneState>& state,
+                                             const std::shared_ptr<scene::SceneView>& view,
+                                             FrameData&)
+{
+    // dirty flags are cleared by the caller, poses of earlier requests may not be drawn yet
+    sceneState = std::make_shared<scene::SceneState>(*state);
+    sceneState->markAllDirty();
+    sceneView = std::make_shared<scene::SceneView>(*view);
+    return false;
+}
+
+BatchRenderer::BatchRenderer(const std::shared_ptr<BaseRenderer>& backend) : _backend(backend)
+{
+    if (!_backend)
+        throw std::invalid_argument("BatchRenderer: null backend");
+}
+
+std::shared_ptr<BaseRenderer> BatchRenderer::addEnvironment()
+{
+    _environments.push_back(std::make_shared<Environment>());
+    return _environments.back();
+}
+
+void BatchRenderer::setCameras(int environment,
+                               const std::vector<std::shared_ptr<scene::Camera>>& cameras)
+{
+    _environments.at(environment)->cameras = cameras;
+}
+
+int BatchRenderer::numCameras() const
+{
+    if (_environments.empty())
+        return 0;
+    const size_t count = _environments.front()->cameras.size();
+    for (const auto& environment : _environments)
+        if (environment->cameras.size() != count)
+            throw std::invalid_argument("BatchRenderer: environments have different cameras");
+    return int(count);
+}
+
+bool BatchRenderer::renderAll(int cols, int rows, uint8_t* color, float* depth, int* mask)
+{
+    const int numViews = numCameras();
+    const size_t numPixels = size_t(cols) * rows;
+    int channels = 0;
+    if (color)
+        channels |= int(scene::OutputChannel::Color);
+    if (depth)
+        channels |= int(scene::OutputChannel::Depth);
+    if (mask)
+        channels |= int(scene::OutputChannel::Mask);
+
+    bool rendered = true;
+    for (int e = 0; e < numEnvironments(); ++e) {
+        auto& environment = *_environments[e];
+        if (!environment.sceneGraph)
+            environment.sceneGraph = std::make_shared<scene::SceneGraph>();
+        if (!environment.sceneState)
+            environment.sceneState = std::make_shared<scene::SceneState>();
+        if (!environment.sceneView)
+            environment.sceneView = std::make_shared<scene::SceneView>();
+
+        if (e != _current || environment.changed) {
+            _backend->updateScene(environment.sceneGraph, false);
+            environment.sceneState->markAllDirty();
+            environment.changed = false;
+            _current = e;
+        }
+
+        std::vector<std::shared_ptr<scene::SceneView>> views;
+        std::vector<FrameData> frames;
+        for (int c = 0; c < numViews; ++c) {
+            auto view = std::make_shared<scene::SceneView>(*environment.sceneView);
+            view->setCamera(environment.cameras[c]);
+            view->setViewport({cols, rows});
+            view->setOutputChannels(channels);
+            views.push_back(std::move(view));
+
+            const size_t offset = (size_t(e) * numViews + c) * numPixels;
+            frames.push_back(FrameData{cols, rows, color ? color + offset * 4 : nullptr,
+                                       depth ? depth + offset : nullptr,
+                                       mask ? mask + offset : nullptr});
+        }
+        if (!frames.empty())
+            rendered = _backend->renderFrames(environment.sceneState, views, frames) && rendered;
+        environment.sceneState->clearDirty();
+    }
+    return rendered;
+}
+
+} // namespace render
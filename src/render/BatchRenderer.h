@@ -0,0 +1,113 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+#include <memory>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief One renderer shared by the physics clients of vectorized environments
+ *
+ * Each environment gets a lightweight renderer from addEnvironment(), to bind to its physics
+ * client. It records the scene, poses and view of the client at each camera image request,
+ * returning an empty frame, and renderAll() then draws the cameras of every environment with
+ * the shared backend into one (E, C, H, W) batch of images.
+ *
+ * The backend switches scenes between environments with a full scene update. Renderers keep
+ * GPU meshes and textures keyed by the asset cache data shared by all clients, so a switch
+ * between environments loading the same assets uploads nothing.
+ *
+ * Not thread-safe: environments and renderAll() are driven from one thread.
+ */
+class BatchRenderer
+{
+  public:
+    /**
+     * @brief Construct a new Batch Renderer object
+     *
+     * @param backend - renderer drawing all environments
+     */
+    explicit BatchRenderer(const std::shared_ptr<BaseRenderer>& backend);
+
+    /**
+     * @brief Shared renderer
+     */
+    const std::shared_ptr<BaseRenderer>& backend() const { return _backend; }
+
+    /**
+     * @brief Append an environment
+     *
+     * @return Renderer to bind to the physics client of the environment, E - 1 being its index
+     */
+    std::shared_ptr<BaseRenderer> addEnvironment();
+
+    /**
+     * @brief Number of environments E
+     */
+    int numEnvironments() const { return int(_environments.size()); }
+
+    /**
+     * @brief Set the cameras of an environment
+     *
+     * @param environment - environment index
+     * @param cameras - cameras, the same number C for all environments
+     * @throw std::out_of_range - if there is no such environment
+     */
+    void setCameras(int environment, const std::vector<std::shared_ptr<scene::Camera>>& cameras);
+
+    /**
+     * @brief Number of cameras C of all environments
+     *
+     * @throw std::invalid_argument - if environments have different numbers of cameras
+     */
+    int numCameras() const;
+
+    /**
+     * @brief Render the cameras of all environments, at their last requested poses
+     *
+     * Planes are laid out as (E, C, rows, cols) images, of 4 channels for colors. Environments
+     * which did not request a camera image yet are drawn with a default light.
+     *
+     * @param cols - image width
+     * @param rows - image height
+     * @param color - color planes, null to skip
+     * @param depth - depth planes, null to skip
+     * @param mask - mask planes, null to skip
+     * @return True if all views rendered
+     */
+    bool renderAll(int cols, int rows, uint8_t* color, float* depth, int* mask);
+
+  private:
+    /**
+     * @brief Scene of an environment as last requested by its client
+     */
+    struct Environment : public BaseRenderer {
+        void updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                         bool materialsOnly) override;
+        void applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                             const scene::SceneGraphDelta& delta) override;
+        bool updateShapeGeometry(int nodeId, int shapeIndex,
+                                 const std::shared_ptr<scene::MeshData>& meshData) override;
+        bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                         const std::shared_ptr<scene::SceneView>& sceneView,
+                         FrameData& outputFrame) override;
+
+        std::shared_ptr<scene::SceneGraph> sceneGraph; //<- live scene of the client
+        std::shared_ptr<scene::SceneState> sceneState; //<- poses of the last request
+        std::shared_ptr<scene::SceneView> sceneView; //<- light and flags of the last request
+        std::vector<std::shared_ptr<scene::Camera>> cameras;
+        bool changed = true; //<- scene changed since the backend last drew it
+    };
+
+    std::shared_ptr<BaseRenderer> _backend;
+    std::vector<std::shared_ptr<Environment>> _environments;
+    int _current = -1; //<- environment whose scene the backend holds
+};
+
+} // namespace render
@@ -0,0 +1,71 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "DepthLevels.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace render {
+
+size_t depthLevelOffset(int cols, int rows, int level)
+{
+    size_t offset = 0;
+    for (int l = 1; l < level; ++l)
+        offset += size_t(depthLevelSize(cols, l)) * size_t(depthLevelSize(rows, l)) * 2;
+    return offset;
+}
+
+void reduceDepthLevels(int cols, int rows, const float* depth, int levels, float* pyramid)
+{
+    const float far = std::numeric_limits<float>::infinity();
+    for (int level = 1; level <= levels; ++level) {
+        const int srcCols = depthLevelSize(cols, level - 1);
+        const int srcRows = depthLevelSize(rows, level - 1);
+        const float* src = level > 1 ? pyramid + depthLevelOffset(cols, rows, level - 1) : nullptr;
+        float* dst = pyramid + depthLevelOffset(cols, rows, level);
+        const int levelCols = depthLevelSize(cols, level);
+        const int levelRows = depthLevelSize(rows, level);
+        // nearest and farthest depth of a texel of the level below, rows top first
+        const auto bounds = [&](int col, int row, float& nearest, float& farthest) {
+            const size_t i = size_t(row) * srcCols + col;
+            if (src) {
+                nearest = std::min(nearest, src[i * 2]);
+                farthest = std::max(farthest, src[i * 2 + 1]);
+                return;
+            }
+            const float d = depth[i] > 0.f ? depth[i] : far;
+            nearest = std::min(nearest, d);
+            farthest = std::max(farthest, d);
+        };
+        for (int row = 0; row < levelRows; ++row) {
+            // 2 x 2 texels below counted from the bottom row
+            const int bottom = levelRows - 1 - row;
+            const int y0 = srcRows - 1 - 2 * bottom;
+            const int y1 = srcRows - 1 - std::min(2 * bottom + 1, srcRows - 1);
+            for (int col = 0; col < levelCols; ++col) {
+                const int x0 = 2 * col, x1 = std::min(2 * col + 1, srcCols - 1);
+                float nearest = far, farthest = 0.f;
+                bounds(x0, y0, nearest, farthest);
+                bounds(x1, y0, nearest, farthest);
+                bounds(x0, y1, nearest, farthest);
+                bounds(x1, y1, nearest, farthest);
+                float* texel = dst + (size_t(row) * levelCols + col) * 2;
+                texel[0] = nearest;
+                texel[1] = farthest;
+            }
+        }
+    }
+}
+
+void completeDepthPyramid(const scene::SceneView& sceneView, FrameData& frame)
+{
+    if (!frame.depthPyramid || !frame.depth || frame.depthPyramidDrawn ||
+        !sceneView.hasOutputChannel(scene::OutputChannel::DepthPyramid))
+        return;
+    reduceDepthLevels(frame.cols, frame.rows, frame.depth, sceneView.depthPyramidLevels(),
+                      frame.depthPyramid);
+}
+
+} // namespace render
@@ -0,0 +1,58 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+#include <cstddef>
+
+namespace render {
+
+/**
+ * @brief Texels along a side of \p size pixels of a level of the depth pyramid, halving the
+ * previous level at each, rounding up
+ */
+inline int depthLevelSize(int size, int level) { return (size + (1 << level) - 1) >> level; }
+
+/**
+ * @brief Offset of a level in the depth pyramid of an image, in floats
+ *
+ * The pyramid of the DepthPyramid channel packs levels 1 to scene::SceneView::depthPyramidLevels()
+ * one after the other, each top row first with the nearest then the farthest depth of each texel,
+ * so that the offset of a level only depends on the image size. The offset of the level after the
+ * last one is the size of the pyramid.
+ *
+ * Texels of a level cover 2^level pixels a side from the bottom left corner of the image, as
+ * reduced by OpenGL, those of the top row and right column fewer when the image size is not a
+ * multiple of it.
+ *
+ * @param cols - image width
+ * @param rows - image height
+ * @param level - level from 1
+ */
+size_t depthLevelOffset(int cols, int rows, int level);
+
+/**
+ * @brief Reduce a metric depth image into the levels of its depth pyramid
+ *
+ * Pixels where nothing was drawn, of zero depth, are infinitely far.
+ *
+ * @param cols - image width
+ * @param rows - image height
+ * @param depth - metric depth of each pixel
+ * @param levels - levels of the pyramid
+ * @param pyramid - output, depthLevelOffset() of the level after the last floats
+ */
+void reduceDepthLevels(int cols, int rows, const float* depth, int levels, float* pyramid);
+
+/**
+ * @brief Finish the DepthPyramid channel of a frame rendered with \p sceneView
+ *
+ * Reduces the depth plane by reduceDepthLevels() unless the renderer reduced it. Frames without
+ * a pyramid or a depth plane are left untouched.
+ */
+void completeDepthPyramid(const scene::SceneView& sceneView, FrameData& frame);
+
+} // namespace render
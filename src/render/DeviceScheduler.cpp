@@ -0,0 +1,137 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "DeviceScheduler.h"
+
+#ifdef WITH_EGL
+#include "EGLRenderer.h"
+#endif
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+namespace render {
+
+namespace {
+
+struct DeviceState {
+    int sessions = 0;
+    size_t bytes = 0;
+};
+
+std::mutex gMutex;
+int gCount = -1; //<- devices set by setDeviceCount(), -1 to enumerate
+int gEnumerated = -1; //<- EGL devices, -1 until enumerated
+DevicePolicy gPolicy = DevicePolicy::LeastSessions;
+std::vector<DeviceState> gDevices; //<- at least the devices holding leases
+
+/// devices to place renderers on, with gMutex held
+int countLocked()
+{
+    if (gCount >= 0)
+        return gCount;
+    if (gEnumerated < 0) {
+#ifdef WITH_EGL
+        gEnumerated = EGLRenderer::deviceCount();
+#else
+        gEnumerated = 0;
+#endif
+    }
+    return gEnumerated;
+}
+
+} // namespace
+
+DeviceLease::DeviceLease(int device, size_t expectedBytes)
+    : _device(device), _expectedBytes(expectedBytes), _bytes(0)
+{
+}
+
+DeviceLease::~DeviceLease()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    auto& state = gDevices[_device];
+    --state.sessions;
+    state.bytes -= std::max(_bytes, _expectedBytes);
+}
+
+size_t DeviceLease::bytes() const
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    return std::max(_bytes, _expectedBytes);
+}
+
+void DeviceLease::setBytes(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    auto& state = gDevices[_device];
+    state.bytes -= std::max(_bytes, _expectedBytes);
+    _bytes = bytes;
+    state.bytes += std::max(_bytes, _expectedBytes);
+}
+
+int deviceCount()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    return countLocked();
+}
+
+void setDeviceCount(int count)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gCount = std::max(count, -1);
+}
+
+DevicePolicy devicePolicy()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    return gPolicy;
+}
+
+void setDevicePolicy(DevicePolicy policy)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gPolicy = policy;
+}
+
+std::shared_ptr<DeviceLease> acquireDevice(size_t expectedBytes)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    const int count = countLocked();
+    if (count <= 0)
+        return nullptr;
+    if (int(gDevices.size()) < count)
+        gDevices.resize(count);
+
+    const auto load = [](const DeviceState& state) {
+        const auto sessions = size_t(state.sessions);
+        return gPolicy == DevicePolicy::LeastMemory ? std::make_pair(state.bytes, sessions)
+                                                    : std::make_pair(sessions, state.bytes);
+    };
+    int best = 0;
+    for (int device = 1; device < count; ++device)
+        if (load(gDevices[device]) < load(gDevices[best]))
+            best = device;
+
+    std::shared_ptr<DeviceLease> lease(new DeviceLease(best, expectedBytes));
+    ++gDevices[best].sessions;
+    gDevices[best].bytes += expectedBytes;
+    return lease;
+}
+
+std::vector<DeviceLoad> deviceLoads()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    const int count = countLocked();
+    std::vector<DeviceLoad> loads;
+    for (int device = 0; device < std::max(count, int(gDevices.size())); ++device) {
+        const auto state = device < int(gDevices.size()) ? gDevices[device] : DeviceState();
+        if (device < count || state.sessions > 0)
+            loads.push_back({device, state.sessions, state.bytes});
+    }
+    return loads;
+}
+
+} // namespace render
@@ -0,0 +1,102 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief How acquireDevice() picks a GPU
+ */
+enum class DevicePolicy {
+    LeastSessions, //<- fewest renderers, then least memory
+    LeastMemory,   //<- least GPU memory in use, then fewest renderers
+};
+
+/**
+ * @brief Renderers placed on a GPU and their memory
+ */
+struct DeviceLoad {
+    int device;
+    int sessions; //<- leases held
+    size_t bytes; //<- GPU memory reported or expected by the leases
+};
+
+/**
+ * @brief Placement of a renderer on a GPU, released with the last reference
+ *
+ * Renderers measuring their GPU memory report it with setBytes(), so that later placements by
+ * memory see it; until then a lease counts the bytes expected when it was acquired.
+ */
+class DeviceLease
+{
+  public:
+    ~DeviceLease();
+
+    DeviceLease(const DeviceLease&) = delete;
+    DeviceLease& operator=(const DeviceLease&) = delete;
+
+    /**
+     * @brief Index of the EGL device
+     */
+    int device() const { return _device; }
+
+    /**
+     * @brief GPU memory of the renderer, at least the bytes expected
+     */
+    size_t bytes() const;
+    /** @overload */
+    void setBytes(size_t bytes);
+
+  private:
+    friend std::shared_ptr<DeviceLease> acquireDevice(size_t expectedBytes);
+
+    DeviceLease(int device, size_t expectedBytes);
+
+    int _device;
+    size_t _expectedBytes;
+    size_t _bytes; //<- last reported
+};
+
+/**
+ * @brief Number of GPUs renderers are placed on
+ *
+ * Defaults to the EGL devices of the system when built with EGL, 0 otherwise.
+ */
+int deviceCount();
+
+/**
+ * @brief Place renderers on the first \p count GPUs only, -1 for all EGL devices
+ *
+ * Leases on devices beyond are kept until released.
+ */
+void setDeviceCount(int count);
+
+/**
+ * @brief How GPUs are picked, least sessions by default
+ */
+DevicePolicy devicePolicy();
+/** @overload */
+void setDevicePolicy(DevicePolicy policy);
+
+/**
+ * @brief Place a new renderer on the least loaded GPU of the process
+ *
+ * Thread-safe. Ties go to the lowest device index.
+ *
+ * @param expectedBytes - GPU memory the renderer is expected to use until it reports its own
+ * @return std::shared_ptr<DeviceLease> - placement, null if there are no devices
+ */
+std::shared_ptr<DeviceLease> acquireDevice(size_t expectedBytes = 0);
+
+/**
+ * @brief Renderers and memory of each GPU, by device index
+ */
+std::vector<DeviceLoad> deviceLoads();
+
+} // namespace render
@@ -0,0 +1,215 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "DistortedFrame.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace render {
+
+namespace {
+
+std::atomic<uint64_t> gLensRevision{0};
+
+} // namespace
+
+bool LensMap::matches(const scene::SceneView& sceneView, int cols, int rows) const
+{
+    const auto& camera = *sceneView.camera();
+    return this->cols == cols && this->rows == rows && projection == camera.projMatrix() &&
+           distortion == camera.distortion() && viewport == sceneView.viewport() &&
+           roi == sceneView.roi() && renderScale == sceneView.renderScale();
+}
+
+LensMap makeLensMap(const scene::SceneView& sceneView, int cols, int rows)
+{
+    const auto& camera = *sceneView.camera();
+    LensMap map;
+    map.cols = cols;
+    map.rows = rows;
+    map.projection = camera.projMatrix();
+    map.distortion = camera.distortion();
+    map.viewport = sceneView.viewport();
+    map.roi = sceneView.roi();
+    map.renderScale = sceneView.renderScale();
+    map.revision = ++gLensRevision;
+
+    // pixels of the region of interest in the whole image, normalized by the pinhole projection
+    const auto& p = map.projection;
+    const int width = map.viewport[0], height = map.viewport[1];
+    const int left = sceneView.hasRoi() ? map.roi[0] : 0;
+    const int top = sceneView.hasRoi() ? map.roi[1] : 0;
+    const size_t numPixels = size_t(cols) * size_t(rows);
+    map.rays.resize(numPixels * 2);
+    float xmin = std::numeric_limits<float>::max(), ymin = xmin;
+    float xmax = -xmin, ymax = -xmin;
+    for (int row = 0; row < rows; ++row) {
+        const float ny = 1.f - (top + row + 0.5f) / height * 2.f;
+        for (int col = 0; col < cols; ++col) {
+            const float nx = (left + col + 0.5f) / width * 2.f - 1.f;
+            float* ray = map.rays.data() + (size_t(row) * cols + col) * 2;
+            // y down for the lens
+            float x, y;
+            if (!map.distortion.undistort((nx + p[8]) / p[0], -(ny + p[9]) / p[5], x, y)) {
+                ray[0] = ray[1] = std::numeric_limits<float>::quiet_NaN();
+                continue;
+            }
+            ray[0] = x;
+            ray[1] = -y;
+            xmin = std::min(xmin, ray[0]);
+            xmax = std::max(xmax, ray[0]);
+            ymin = std::min(ymin, ray[1]);
+            ymax = std::max(ymax, ray[1]);
+        }
+    }
+    if (xmin > xmax) {
+        // the lens sees nothing, a pinhole image of a pixel
+        xmin = ymin = -1.f;
+        xmax = ymax = 1.f;
+    }
+
+    // a pixel of the camera around the rays, at its density times the render scale
+    const float scale = sceneView.renderScale() > 0.f ? sceneView.renderScale() : 1.f;
+    const float pixelX = 2.f / (width * p[0]), pixelY = 2.f / (height * p[5]);
+    xmin -= pixelX;
+    xmax += pixelX;
+    ymin -= pixelY;
+    ymax += pixelY;
+    const int maxSize = 4 * std::max(cols, rows);
+    map.sourceCols =
+        std::min(std::max(int(std::ceil((xmax - xmin) / pixelX * scale)), 1), maxSize);
+    map.sourceRows =
+        std::min(std::max(int(std::ceil((ymax - ymin) / pixelY * scale)), 1), maxSize);
+    map.sourceProjection = p;
+    map.sourceProjection[0] = 2.f / (xmax - xmin);
+    map.sourceProjection[8] = map.sourceProjection[0] * xmin + 1.f;
+    map.sourceProjection[5] = 2.f / (ymax - ymin);
+    map.sourceProjection[9] = map.sourceProjection[5] * ymin + 1.f;
+
+    map.coords.resize(numPixels * 2);
+    const float sx = map.sourceCols / (xmax - xmin), sy = map.sourceRows / (ymax - ymin);
+    for (size_t i = 0; i < numPixels; ++i) {
+        const float* ray = map.rays.data() + i * 2;
+        float* coord = map.coords.data() + i * 2;
+        if (std::isnan(ray[0])) {
+            coord[0] = coord[1] = -1.f;
+            continue;
+        }
+        coord[0] = (ray[0] - xmin) * sx;
+        coord[1] = (ymax - ray[1]) * sy;
+    }
+    return map;
+}
+
+const LensMap& LensMaps::get(const scene::SceneView& sceneView, int cols, int rows)
+{
+    auto& map = _maps[sceneView.camera()->handle()];
+    if (!map.matches(sceneView, cols, rows))
+        map = makeLensMap(sceneView, cols, rows);
+    return map;
+}
+
+void remapImages(const LensMap& map, const uint8_t* srcColor, const float* srcDepth,
+                 const int* srcMask, uint8_t* color, float* depth, int* mask)
+{
+    const int srcCols = map.sourceCols, srcRows = map.sourceRows;
+    const size_t numPixels = size_t(map.cols) * size_t(map.rows);
+    for (size_t i = 0; i < numPixels; ++i) {
+        const float* coord = map.coords.data() + i * 2;
+        if (coord[0] < 0.f) {
+            if (color)
+                std::fill_n(color + i * 4, 4, uint8_t(0));
+            if (depth)
+                depth[i] = 0.f;
+            if (mask)
+                mask[i] = -1;
+            continue;
+        }
+        if (color) {
+            // bilinear taps clamped to the edges, as GL_LINEAR
+            const float x = coord[0] - 0.5f, y = coord[1] - 0.5f;
+            const int x0 = int(std::floor(x)), y0 = int(std::floor(y));
+            const float wx = x - x0, wy = y - y0;
+            const int c0 = std::min(std::max(x0, 0), srcCols - 1);
+            const int c1 = std::min(std::max(x0 + 1, 0), srcCols - 1);
+            const int r0 = std::min(std::max(y0, 0), srcRows - 1);
+            const int r1 = std::min(std::max(y0 + 1, 0), srcRows - 1);
+            const auto texel = [&](int r, int c) {
+                return srcColor + (size_t(r) * size_t(srcCols) + size_t(c)) * 4;
+            };
+            const uint8_t *p00 = texel(r0, c0), *p01 = texel(r0, c1);
+            const uint8_t *p10 = texel(r1, c0), *p11 = texel(r1, c1);
+            for (int c = 0; c < 4; ++c) {
+                const float upper = p00[c] + (p01[c] - p00[c]) * wx;
+                const float lower = p10[c] + (p11[c] - p10[c]) * wx;
+                color[i * 4 + c] = uint8_t(upper + (lower - upper) * wy + 0.5f);
+            }
+        }
+        const size_t src = size_t(std::min(int(coord[1]), srcRows - 1)) * size_t(srcCols) +
+                           size_t(std::min(int(coord[0]), srcCols - 1));
+        if (depth)
+            depth[i] = srcDepth ? srcDepth[src] : 0.f;
+        if (mask)
+            mask[i] = srcMask ? srcMask[src] : -1;
+    }
+}
+
+DistortedFrame::DistortedFrame()
+    : _sourceView(std::make_shared<scene::SceneView>()),
+      _sourceCamera(std::make_shared<scene::Camera>())
+{
+}
+
+bool DistortedFrame::render(BaseRenderer& renderer,
+                            const std::shared_ptr<scene::SceneState>& sceneState,
+                            const scene::SceneView& sceneView, FrameData& outputFrame)
+{
+    if (!sceneView.camera())
+        return false;
+    const auto& map = _maps.get(sceneView, outputFrame.cols, outputFrame.rows);
+
+    // a pinhole camera of the same pose, of another handle as its intrinsics differ
+    *_sourceCamera = *sceneView.camera();
+    _sourceCamera->setProjMatrix(map.sourceProjection);
+    _sourceCamera->setDistortion(scene::LensDistortion());
+    _sourceCamera->setHandle(-1);
+    *_sourceView = sceneView;
+    _sourceView->setRoi({0, 0, 0, 0});
+    _sourceView->setRenderScale(1.f);
+    _sourceView->setViewport({map.sourceCols, map.sourceRows});
+    _sourceView->setCamera(_sourceCamera);
+    _sourceView->setPreviousCamera(nullptr);
+
+    // planes of channels not requested are left untouched, the others are left to the caller
+    const bool hasColor =
+        outputFrame.color && sceneView.hasOutputChannel(scene::OutputChannel::Color);
+    const bool hasDepth =
+        outputFrame.depth && sceneView.hasOutputChannel(scene::OutputChannel::Depth);
+    const bool hasMask = outputFrame.mask && sceneView.hasOutputChannel(scene::OutputChannel::Mask);
+    _sourceView->setOutputChannels(sceneView.outputChannels() &
+                                   (int(scene::OutputChannel::Color) |
+                                    int(scene::OutputChannel::Depth) |
+                                    int(scene::OutputChannel::Mask)));
+    const size_t pixels = size_t(map.sourceCols) * size_t(map.sourceRows);
+    if (hasColor)
+        _color.resize(pixels * 4);
+    if (hasDepth)
+        _depth.resize(pixels);
+    if (hasMask)
+        _mask.resize(pixels);
+
+    FrameData sourceFrame{map.sourceCols, map.sourceRows, hasColor ? _color.data() : nullptr,
+                          hasDepth ? _depth.data() : nullptr, hasMask ? _mask.data() : nullptr};
+    if (!renderer.renderFrame(sceneState, _sourceView, sourceFrame))
+        return false;
+    remapImages(map, sourceFrame.color, sourceFrame.depth, sourceFrame.mask,
+                hasColor ? outputFrame.color : nullptr, hasDepth ? outputFrame.depth : nullptr,
+                hasMask ? outputFrame.mask : nullptr);
+    return true;
+}
+
+} // namespace render
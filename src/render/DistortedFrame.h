@@ -0,0 +1,110 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Lookup of the images of a view distorted by its camera lens in pinhole images
+ *
+ * The pinhole images, drawn by the source projection at the source size, cover the rays of all
+ * the pixels of the images, at the pixel density of the projection of the camera at the image
+ * center times the render scale of the view. See scene::SceneView::hasLensDistortion().
+ */
+struct LensMap {
+    int cols = 0; //<- of the images
+    int rows = 0;
+    int sourceCols = 0; //<- of the pinhole images
+    int sourceRows = 0;
+    Matrix4f sourceProjection{}; //<- of the pinhole images, without region of interest
+    std::vector<float> rays; //<- undistorted x, y up over the depth of each pixel, NaN if none
+    std::vector<float> coords; //<- pinhole column and row of each pixel, top row first, or -1
+    uint64_t revision = 0; //<- distinct for each map built, e.g. to upload it once
+    // key of the view the map was built for
+    Matrix4f projection{};
+    scene::LensDistortion distortion;
+    Size2i viewport{};
+    Vector4i roi{};
+    float renderScale = 0.f;
+
+    /**
+     * @brief The map is that of \p sceneView, for images of \p cols x \p rows pixels
+     */
+    bool matches(const scene::SceneView& sceneView, int cols, int rows) const;
+};
+
+/**
+ * @brief Build the lens map of a view with lens distortion, for images of \p cols x \p rows
+ * pixels, those of its region of interest
+ *
+ * Rays are those of the pixel centers undistorted by scene::LensDistortion::undistort(), the
+ * pixels of no ray read nothing.
+ */
+LensMap makeLensMap(const scene::SceneView& sceneView, int cols, int rows);
+
+/**
+ * @brief Lens maps of the cameras drawn, built once by camera handle
+ */
+class LensMaps
+{
+  public:
+    /**
+     * @brief Map of \p sceneView for images of \p cols x \p rows pixels, built again if the
+     * camera of its handle changed
+     */
+    const LensMap& get(const scene::SceneView& sceneView, int cols, int rows);
+
+  private:
+    std::map<int, LensMap> _maps; //<- by camera handle, -1 for unregistered cameras
+};
+
+/**
+ * @brief Remap the pinhole images of a lens map into its distorted images
+ *
+ * Colors are bilinear, depth and masks those of the nearest pixel so that they keep drawn values.
+ * Pixels of no ray are black, without depth and of mask -1. Null planes are skipped.
+ */
+void remapImages(const LensMap& map, const uint8_t* srcColor, const float* srcDepth,
+                 const int* srcMask, uint8_t* color, float* depth, int* mask);
+
+/**
+ * @brief Views with lens distortion rendered as pinhole images and remapped to the frame
+ *
+ * For renderers without a remapping path of their own, as ScaledFrame: the view is rendered
+ * through BaseRenderer::renderFrame() by a pinhole camera of the source projection into buffers
+ * kept across frames, then remapped by remapImages(). Points and normals are left to the caller,
+ * which computes them along the rays of the lens, as is the motion, reprojected without the
+ * lens.
+ */
+class DistortedFrame
+{
+  public:
+    DistortedFrame();
+
+    /**
+     * @brief Render the distorted view \p sceneView through \p renderer
+     *
+     * @return False if the view has no camera or was not rendered
+     */
+    bool render(BaseRenderer& renderer, const std::shared_ptr<scene::SceneState>& sceneState,
+                const scene::SceneView& sceneView, FrameData& outputFrame);
+
+  private:
+    LensMaps _maps;
+    std::shared_ptr<scene::SceneView> _sourceView; //<- the view of the pinhole images
+    std::shared_ptr<scene::Camera> _sourceCamera;
+    std::vector<uint8_t> _color;
+    std::vector<float> _depth;
+    std::vector<int> _mask;
+};
+
+} // namespace render
@@ -0,0 +1,5558 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "EGLRenderer.h"
+#include "AssetLoader.h"
+#include "DepthLevels.h"
+#include "LightClusters.h"
+#include "ShaderCache.h"
+#include "StageStats.h"
+
+#include <scene/MeshBuilder.h>
+#include <scene/SceneLayer.h>
+
+#define EGL_EGLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#ifdef WITH_CUDA
+#include <cuda_gl_interop.h>
+#include <cuda_runtime.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+namespace render {
+
+namespace {
+
+const int kTileLevels = 5; //<- levels of detail of heightfield tiles, down to 4 x 4 cells
+const int kPackedTextureSize = 256; //<- textures up to this size share arrays with others
+const int kStreamedTextureSize = 64; //<- streamed textures start from their level of this size
+const int kOcclusionSize = 128; //<- largest side of the depth pyramid level read back
+
+const char* kVertexShader = R"(
+#version 330 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+layout(location = 3) in int vertexSegmentation; //<- merged static shapes only
+layout(location = 4) in int drawIndex; //<- indirect draws, from the base instance of the command
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 viewProj;
+// normalized 16 bits attributes of quantized meshes, identity otherwise
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform vec2 uvOffset;
+uniform vec2 uvScale;
+uniform bool octNormals;
+// heightfield tiles, vertices generated from their index over a texture of heights
+uniform bool heightfield;
+uniform sampler2D heights;
+uniform ivec2 tileOrigin; //<- first grid point of the tile
+uniform int tileStep; //<- grid points between vertices
+uniform int tileVertices; //<- vertices along a side, skirt included
+uniform float skirtDepth;
+uniform int segmentation;
+uniform bool batched; //<- world space vertices of static shapes, segmentation per vertex
+uniform mat4 lightViewProj; //<- projection of the shadow map
+uniform bool pointsInWorld; //<- points in the world frame, the camera frame otherwise
+uniform mat4 previousModel; //<- model and projection of the previous frame, for the motion
+uniform mat4 previousViewProj;
+uniform mat4 projectorViewProj; //<- projection of the projective texture
+// model and previous model of each draw, 8 texels from 8 * transformIndex, the uniforms if -1
+uniform samplerBuffer transforms;
+uniform int transformIndex;
+// indirect draws, 2 texels from 2 * drawIndex: transform index, segmentation, texture layer or
+// -1 if untextured, then the bits of the diffuse color
+uniform bool indirect;
+uniform isamplerBuffer drawRecords;
+// multiview frames, each instance drawing a view into its band of rows of the targets
+uniform int viewCount; //<- views drawn by instance, a single one through view and viewProj if 1
+uniform mat4 viewMatrices[8]; //<- scene::kMaxViews of each
+uniform mat4 viewProjs[8];
+uniform float viewBands[8]; //<- clip y offset of the band of each view, over w
+uniform bool maskOnly; //<- flat ids and depth alone, see the fragment shader
+out float gl_ClipDistance[2];
+out vec3 worldNormal;
+out vec3 worldPosition;
+out vec2 texCoord;
+out float eyeDepth;
+out vec3 pointPosition;
+flat out int vertexMask;
+out vec3 lightCoord;
+out vec4 clipPosition;
+out vec4 previousClipPosition;
+out vec3 eyeNormal;
+out vec3 eyePosition;
+out vec4 projectorCoord;
+flat out vec4 recordDiffuse;
+flat out int recordLayer;
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+float gridHeight(ivec2 p)
+{
+    return texelFetch(heights, p, 0).r;
+}
+mat4 streamedMatrix(int texel)
+{
+    return mat4(texelFetch(transforms, texel), texelFetch(transforms, texel + 1),
+                texelFetch(transforms, texel + 2), texelFetch(transforms, texel + 3));
+}
+void main()
+{
+    bool multiview = viewCount > 1;
+    mat4 drawView = multiview ? viewMatrices[gl_InstanceID] : view;
+    mat4 drawViewProj = multiview ? viewProjs[gl_InstanceID] : viewProj;
+    mat4 drawModel = model;
+    mat4 drawPreviousModel = previousModel;
+    int drawTransform = transformIndex;
+    int drawSegmentation = segmentation;
+    recordDiffuse = vec4(1.0);
+    recordLayer = -1;
+    if (indirect) {
+        ivec4 record = texelFetch(drawRecords, drawIndex * 2);
+        drawTransform = record.x;
+        drawSegmentation = record.y;
+        recordLayer = record.z;
+        recordDiffuse = intBitsToFloat(texelFetch(drawRecords, drawIndex * 2 + 1));
+    }
+    if (drawTransform >= 0) {
+        drawModel = streamedMatrix(drawTransform * 8);
+        drawPreviousModel = streamedMatrix(drawTransform * 8 + 4);
+    }
+    vec3 objectPosition = positionOffset + position * positionScale;
+    vec3 objectNormal = octNormals ? octDecode(normal.xy) : normal;
+    vec2 objectUv = uvOffset + uv * uvScale;
+    if (heightfield) {
+        // a ring of skirt vertices around the tile hides cracks along coarser neighbors
+        ivec2 size = textureSize(heights, 0);
+        ivec2 local = ivec2(gl_VertexID % tileVertices, gl_VertexID / tileVertices) - 1;
+        int last = tileVertices - 3;
+        ivec2 p = min(tileOrigin + clamp(local, 0, last) * tileStep, size - 1);
+        // none along the outer border, it would hang below the edges
+        bool skirt = (any(lessThan(local, ivec2(0))) || any(greaterThan(local, ivec2(last)))) &&
+                     all(greaterThan(p, ivec2(0))) && all(lessThan(p, size - 1));
+        objectPosition = positionOffset + vec3(vec2(p), gridHeight(p)) * positionScale;
+        objectPosition.z -= skirt ? skirtDepth : 0.0;
+        ivec2 p0 = max(p - 1, 0), p1 = min(p + 1, size - 1);
+        vec2 slope = vec2(gridHeight(ivec2(p1.x, p.y)) - gridHeight(ivec2(p0.x, p.y)),
+                          gridHeight(ivec2(p.x, p1.y)) - gridHeight(ivec2(p.x, p0.y))) /
+                     (vec2(p1 - p0) * positionScale.xy);
+        objectNormal = normalize(vec3(-slope, 1.0));
+        objectUv = uvOffset + vec2(p) / vec2(size - 1) * uvScale;
+    }
+    worldNormal = maskOnly ? objectNormal : transpose(inverse(mat3(drawModel))) * objectNormal;
+    // bitmaps are stored top row first
+    texCoord = vec2(objectUv.x, 1.0 - objectUv.y);
+    vec4 world = drawModel * vec4(objectPosition, 1.0);
+    worldPosition = world.xyz;
+    vec4 eye = drawView * world;
+    eyeDepth = -eye.z;
+    eyeNormal = mat3(drawView) * worldNormal;
+    eyePosition = eye.xyz;
+    pointPosition = pointsInWorld ? world.xyz : eye.xyz;
+    vertexMask = batched ? vertexSegmentation : drawSegmentation;
+    lightCoord = (lightViewProj * world).xyz * 0.5 + 0.5;
+    projectorCoord = projectorViewProj * world;
+    gl_Position = drawViewProj * world;
+    clipPosition = gl_Position;
+    previousClipPosition = previousViewProj * drawPreviousModel * vec4(objectPosition, 1.0);
+    if (multiview) {
+        // squeezed into the band of the view, clipped to it at its top and bottom
+        gl_ClipDistance[0] = gl_Position.w - gl_Position.y;
+        gl_ClipDistance[1] = gl_Position.w + gl_Position.y;
+        gl_Position.y += viewBands[gl_InstanceID] * gl_Position.w;
+        gl_Position.y /= float(viewCount);
+    }
+}
+)";
+
+const char* kFragmentShader = R"(
+#version 330 core
+in vec3 worldNormal;
+in vec3 worldPosition;
+in vec2 texCoord;
+in float eyeDepth;
+in vec3 pointPosition;
+flat in int vertexMask;
+in vec3 lightCoord;
+in vec4 clipPosition;
+in vec4 previousClipPosition;
+in vec3 eyeNormal;
+in vec3 eyePosition;
+in vec4 projectorCoord;
+flat in vec4 recordDiffuse;
+flat in int recordLayer;
+uniform vec4 diffuse;
+uniform bool textured;
+uniform bool indirect; //<- material of the draw record, see the vertex shader
+uniform bool projective; //<- textures sampled where the projector sees the surface
+uniform sampler2DArray diffuseTexture;
+uniform int textureLayer;
+uniform vec3 lightDirection;
+uniform vec3 ambientColor;
+uniform vec3 diffuseColor;
+// point and spot lights, 3 texels each from 3 * index, see render::LightClusters
+uniform samplerBuffer localLights;
+uniform int unboundedLights; //<- first lights, lighting every pixel
+uniform int boundedLights; //<- next lights, listed by the clusters of the view
+uniform bool clustered; //<- bounded lights looked up by cluster, all of them lit otherwise
+uniform usamplerBuffer lightClusters; //<- offset and count of the indices of each cluster
+uniform ivec3 clusterGrid; //<- tiles across and down, depth slices
+uniform vec2 clusterDepth; //<- eye depth of the first slice, slices per unit of log depth
+uniform bool shadowed;
+uniform sampler2DShadow shadowMap;
+// cascades fitted to the view, tiles of the map, none for the map of the scene, see
+// render::ShadowCascades
+uniform int shadowCascades;
+uniform mat4 cascadeViewProjs[4];
+uniform vec4 cascadeTiles[4]; //<- offset and scale in the map, farthest eye depth
+uniform float depthScale; //<- units per meter of 16-bit depth
+uniform vec2 imageSize; //<- of the frame targets, for the motion in pixels
+uniform bool maskOnly; //<- neither textured nor lit, color left undefined
+layout(location = 0) out vec4 color;
+layout(location = 1) out int mask;
+layout(location = 2) out float depth;
+layout(location = 3) out vec4 point;
+layout(location = 4) out uvec2 shortDepthMask;
+layout(location = 5) out vec2 motion;
+layout(location = 6) out vec3 surfaceNormal;
+vec3 localLight(int index, vec3 n)
+{
+    vec4 position = texelFetch(localLights, index * 3);
+    vec4 color = texelFetch(localLights, index * 3 + 1);
+    vec4 spot = texelFetch(localLights, index * 3 + 2);
+    vec3 l = position.xyz - worldPosition;
+    float distance2 = dot(l, l);
+    l *= inversesqrt(max(distance2, 1e-8));
+    // inverse square, smoothly windowed to zero at the range
+    float falloff = 1.0 / (1.0 + distance2);
+    if (position.w > 0.0) {
+        float x = distance2 / (position.w * position.w);
+        float window = clamp(1.0 - x * x, 0.0, 1.0);
+        falloff *= window * window;
+    }
+    if (color.w > -1.5)
+        falloff *= smoothstep(color.w, spot.w, dot(-l, spot.xyz));
+    return color.rgb * abs(dot(n, l)) * falloff;
+}
+vec3 localLighting(vec3 n)
+{
+    vec3 light = vec3(0.0);
+    for (int i = 0; i < unboundedLights; ++i)
+        light += localLight(i, n);
+    if (boundedLights == 0) {
+        return light;
+    } else if (!clustered) {
+        for (int i = unboundedLights; i < unboundedLights + boundedLights; ++i)
+            light += localLight(i, n);
+        return light;
+    }
+    // nothing lit in front of the first slice and past the last one
+    int slice = int(floor(log(eyeDepth / clusterDepth.x) * clusterDepth.y));
+    if (slice < 0 || slice >= clusterGrid.z)
+        return light;
+    vec2 ndc = clipPosition.xy / clipPosition.w;
+    ivec2 tile = clamp(ivec2(floor((ndc * 0.5 + 0.5) * vec2(clusterGrid.xy))), ivec2(0),
+                       clusterGrid.xy - 1);
+    int cluster = (slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x;
+    int offset = int(texelFetch(lightClusters, cluster * 2).r);
+    int count = int(texelFetch(lightClusters, cluster * 2 + 1).r);
+    for (int i = 0; i < count; ++i)
+        light += localLight(int(texelFetch(lightClusters, offset + i).r), n);
+    return light;
+}
+void main()
+{
+    mask = vertexMask;
+    // metric depth, read back as is
+    depth = eyeDepth;
+    // discarded unless 16-bit depth or masks are requested
+    shortDepthMask = uvec2(clamp(round(eyeDepth * depthScale), 0.0, 65535.0),
+                           uint(vertexMask) & 0xFFFFu);
+    if (maskOnly)
+        return;
+    vec4 albedo = indirect ? recordDiffuse : diffuse;
+    bool drawTextured = indirect ? recordLayer >= 0 : textured;
+    int layer = indirect ? recordLayer : textureLayer;
+    if (drawTextured && !projective) {
+        albedo *= texture(diffuseTexture, vec3(texCoord, layer));
+    } else if (drawTextured) {
+        // diffuse color alone outside of the projector frustum and behind it
+        vec2 uv = projectorCoord.xy / projectorCoord.w * 0.5 + 0.5;
+        if (projectorCoord.w > 0.0 && all(greaterThanEqual(uv, vec2(0.0))) &&
+            all(lessThanEqual(uv, vec2(1.0))))
+            albedo *= texture(diffuseTexture, vec3(uv.x, 1.0 - uv.y, layer));
+    }
+    // faces are not culled, light both sides
+    vec3 n = normalize(worldNormal);
+    float lambert = abs(dot(n, normalize(lightDirection)));
+    // 2 x 2 filtered depth comparisons, outside of the map is lit
+    vec3 shadowCoord = lightCoord;
+    vec4 tile = vec4(0.0, 0.0, 1.0, 0.0);
+    if (shadowCascades > 0) {
+        int cascade = 0;
+        while (cascade < shadowCascades - 1 && eyeDepth > cascadeTiles[cascade].w)
+            ++cascade;
+        shadowCoord = (cascadeViewProjs[cascade] * vec4(worldPosition, 1.0)).xyz * 0.5 + 0.5;
+        tile = cascadeTiles[cascade];
+    }
+    bool inMap = all(greaterThan(shadowCoord, vec3(0.0))) &&
+                 all(lessThan(shadowCoord, vec3(1.0)));
+    if (shadowed && inMap) {
+        // filtered texels kept within the tile
+        vec2 margin = vec2(0.5 / (float(textureSize(shadowMap, 0).x) * tile.z));
+        vec2 uv = tile.xy + clamp(shadowCoord.xy, margin, 1.0 - margin) * tile.z;
+        lambert *= texture(shadowMap, vec3(uv, shadowCoord.z - 0.0005));
+    }
+    color = vec4(albedo.rgb * (ambientColor + diffuseColor * lambert + localLighting(n)), albedo.a);
+    // discarded unless points are requested
+    point = vec4(pointPosition, 1.0);
+    // discarded unless motion is requested, in pixels with rows going down
+    vec2 ndcMotion = clipPosition.xy / clipPosition.w -
+                     previousClipPosition.xy / previousClipPosition.w;
+    motion = vec2(ndcMotion.x, -ndcMotion.y) * 0.5 * imageSize;
+    // discarded unless normals are requested, both sides facing the camera
+    vec3 e = normalize(eyeNormal);
+    surfaceNormal = dot(e, eyePosition) > 0.0 ? -e : e;
+}
+)";
+
+// nearest and farthest depth of 2 x 2 texels of the level below, drawn by a single triangle over
+// the level
+const char* kReduceVertexShader = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+const char* kReduceFragmentShader = R"(
+#version 330 core
+uniform sampler2D source; //<- level below, as the only level of the texture
+uniform bool finest; //<- the level below is the metric depth copy
+layout(location = 0) out vec2 depth;
+vec2 bounds(ivec2 p)
+{
+    vec2 d = texelFetch(source, p, 0).rg;
+    if (!finest)
+        return d;
+    // metric depth is zero where nothing was drawn, which hides nothing
+    float f = d.r > 0.0 ? d.r : 3.0e38;
+    return vec2(f, f);
+}
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 q = min(p + 1, textureSize(source, 0) - 1);
+    vec2 a = bounds(p), b = bounds(ivec2(q.x, p.y)), c = bounds(ivec2(p.x, q.y)), d = bounds(q);
+    depth = vec2(min(min(a.x, b.x), min(c.x, d.x)), max(max(a.y, b.y), max(c.y, d.y)));
+}
+)";
+
+// equirectangular image looked up in the cubemap faces, drawn by the reduction vertex shader,
+// faces and image bottom row first as drawn, see scene::Projection
+const char* kPanoramaFragmentShader = R"(
+#version 330 core
+uniform sampler2DArray colors;
+uniform isampler2DArray masks;
+uniform sampler2DArray depths;
+uniform vec2 imageSize;
+uniform int faceSize;
+layout(location = 0) out vec4 color;
+layout(location = 1) out int mask;
+layout(location = 2) out float depth;
+const vec3 forwards[6] = vec3[6](vec3(0.0, 0.0, -1.0), vec3(1.0, 0.0, 0.0), vec3(0.0, 0.0, 1.0),
+                                 vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0));
+const vec3 ups[6] = vec3[6](vec3(0.0, 1.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 1.0, 0.0),
+                            vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+void main()
+{
+    const float pi = 3.14159265;
+    vec2 p = gl_FragCoord.xy / imageSize;
+    float lon = (p.x * 2.0 - 1.0) * pi;
+    float lat = (p.y - 0.5) * pi;
+    vec3 direction = vec3(cos(lat) * sin(lon), sin(lat), -cos(lat) * cos(lon));
+    int face = 0;
+    float cosine = -2.0;
+    for (int i = 0; i < 6; ++i) {
+        float c = dot(forwards[i], direction);
+        if (c > cosine) {
+            cosine = c;
+            face = i;
+        }
+    }
+    vec3 right = cross(forwards[face], ups[face]);
+    vec2 uv = vec2(dot(right, direction), dot(ups[face], direction)) / cosine;
+    ivec3 t = ivec3(clamp(ivec2((uv * 0.5 + 0.5) * float(faceSize)), 0, faceSize - 1), face);
+    color = texelFetch(colors, t, 0);
+    mask = texelFetch(masks, t, 0).r;
+    // metric depth along the face axis to the distance from the camera
+    float d = texelFetch(depths, t, 0).r;
+    depth = d > 0.0 ? d / cosine : 0.0;
+}
+)";
+
+// mask and metric depth of the first sample of each pixel of multisampled targets, drawn by the
+// reduction vertex shader, as they would be drawn without multisampling
+const char* kResolveFragmentShader = R"(
+#version 330 core
+uniform isampler2DMS masks;
+uniform sampler2DMS depths;
+layout(location = 1) out int mask;
+layout(location = 2) out float depth;
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    mask = texelFetch(masks, p, 0).r;
+    depth = texelFetch(depths, p, 0).r;
+}
+)";
+
+// image resampled from the frame targets drawn at the internal resolution of a render scale, drawn
+// by the reduction vertex shader, as render::resampleImages does on the CPU
+const char* kResampleFragmentShader = R"(
+#version 330 core
+uniform sampler2D colors; //<- bilinear filtering
+uniform isampler2D masks;
+uniform sampler2D depths;
+uniform vec2 imageSize;
+layout(location = 0) out vec4 color;
+layout(location = 1) out int mask;
+layout(location = 2) out float depth;
+void main()
+{
+    ivec2 source = textureSize(depths, 0);
+    vec2 ratio = vec2(source) / imageSize;
+    if (ratio.x <= 1.0 && ratio.y <= 1.0) {
+        // upsampled: bilinear color, depth and mask of the texel under the center
+        color = texture(colors, gl_FragCoord.xy / imageSize);
+        ivec2 t = min(ivec2(gl_FragCoord.xy * ratio), source - 1);
+        mask = texelFetch(masks, t, 0).r;
+        depth = texelFetch(depths, t, 0).r;
+        return;
+    }
+    // downsampled: box filtered color, depth and mask of the nearest texel drawn in the box
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 lower = min(ivec2(floor(vec2(pixel) * ratio)), source - 1);
+    ivec2 upper = min(max(ivec2(floor(vec2(pixel + 1) * ratio)), lower + 1), source);
+    vec4 sum = vec4(0.0);
+    float nearest = 0.0;
+    int label = -1;
+    for (int y = lower.y; y < upper.y; ++y) {
+        for (int x = lower.x; x < upper.x; ++x) {
+            ivec2 t = ivec2(x, y);
+            sum += texelFetch(colors, t, 0);
+            float d = texelFetch(depths, t, 0).r;
+            if (d > 0.0 && (nearest == 0.0 || d < nearest)) {
+                nearest = d;
+                label = texelFetch(masks, t, 0).r;
+            }
+        }
+    }
+    ivec2 count = upper - lower;
+    color = sum / float(count.x * count.y);
+    mask = label;
+    depth = nearest;
+}
+)";
+
+// image of a view with lens distortion remapped from the pinhole frame targets through the lookup
+// texture of its camera, drawn by the reduction vertex shader, as render::remapImages does on the
+// CPU
+const char* kLensFragmentShader = R"(
+#version 330 core
+uniform sampler2D colors; //<- bilinear filtering
+uniform isampler2D masks;
+uniform sampler2D depths;
+uniform sampler2D lens; //<- texture coordinates of each pixel in the frame targets, or negative
+layout(location = 0) out vec4 color;
+layout(location = 1) out int mask;
+layout(location = 2) out float depth;
+void main()
+{
+    vec2 uv = texelFetch(lens, ivec2(gl_FragCoord.xy), 0).rg;
+    if (uv.x < 0.0) {
+        // no ray of the lens
+        color = vec4(0.0);
+        mask = -1;
+        depth = 0.0;
+        return;
+    }
+    color = texture(colors, uv);
+    ivec2 source = textureSize(depths, 0);
+    ivec2 t = min(ivec2(uv * vec2(source)), source - 1);
+    mask = texelFetch(masks, t, 0).r;
+    depth = texelFetch(depths, t, 0).r;
+}
+)";
+
+// OpenGL 4.3, commands of the indirect draws, their instances zeroed if the bounding sphere of
+// the draw is out of the frustum
+const char* kCullComputeShader = R"(
+#version 430 core
+layout(local_size_x = 64) in;
+struct Cull {
+    vec4 sphere; //<- center and radius in the mesh frame
+    uint count;
+    uint firstIndex;
+    int baseVertex;
+    int transformIndex;
+};
+struct Command {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+layout(std430, binding = 0) readonly buffer Culls { Cull culls[]; };
+layout(std430, binding = 1) writeonly buffer Commands { Command commands[]; };
+uniform samplerBuffer transforms;
+uniform vec4 planes[6];
+uniform int drawCount;
+uniform int instances; //<- views drawn by each command
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= uint(drawCount))
+        return;
+    Cull cull = culls[i];
+    int t = cull.transformIndex * 8;
+    mat4 model = mat4(texelFetch(transforms, t), texelFetch(transforms, t + 1),
+                      texelFetch(transforms, t + 2), texelFetch(transforms, t + 3));
+    vec3 center = (model * vec4(cull.sphere.xyz, 1.0)).xyz;
+    float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+    float radius = cull.sphere.w * scale;
+    bool visible = true;
+    for (int p = 0; p < 6; ++p) {
+        // planes of the matrix, not normalized
+        float distance = dot(planes[p].xyz, center) + planes[p].w;
+        visible = visible && distance >= -radius * length(planes[p].xyz);
+    }
+    commands[i] = Command(cull.count, visible ? uint(instances) : 0u, cull.firstIndex,
+                          cull.baseVertex, i);
+}
+)";
+
+// OpenGL 4.3, events of the pixels whose log luminance moved by thresholds away from their
+// reference, see render::EventCamera, timed by the fraction of the interval since the last frame
+const char* kEventComputeShader = R"(
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(r32f, binding = 0) uniform image2D reference;
+layout(std430, binding = 0) buffer Events {
+    uint count; //<- events of all the pixels
+    uint written; //<- end of those fitting in the buffer
+    uvec2 padding;
+    vec4 events[]; //<- column, row from the bottom, fraction of the interval, polarity
+};
+uniform sampler2D colors;
+uniform ivec2 size;
+uniform float threshold;
+uniform uint capacity;
+uniform bool first; //<- only sets the reference
+void main()
+{
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(p, size)))
+        return;
+    vec3 rgb = texelFetch(colors, p, 0).rgb * 255.0;
+    float level = log(1.0 + dot(rgb, vec3(0.2126, 0.7152, 0.0722)));
+    if (first) {
+        imageStore(reference, p, vec4(level));
+        return;
+    }
+    float last = imageLoad(reference, p).r;
+    float delta = level - last;
+    uint n = uint(abs(delta) / threshold);
+    if (n == 0u)
+        return;
+    // ranges are handed out in order, those past the capacity are left for the next frame
+    uint start = atomicAdd(count, n);
+    if (start + n > capacity)
+        return;
+    atomicMax(written, start + n);
+    float polarity = delta > 0.0 ? 1.0 : -1.0;
+    for (uint k = 1u; k <= n; ++k)
+        events[start + k - 1u] = vec4(vec2(p), float(k) * threshold / abs(delta), polarity);
+    imageStore(reference, p, vec4(last + polarity * float(n) * threshold));
+}
+)";
+
+// OpenGL 4.3, pixels of each segmentation id of the mask target and their bounds, ids looked up
+// by bisection in those of the shapes in view, see render::countMaskPixels()
+const char* kPixelCountComputeShader = R"(
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(std430, binding = 0) buffer Counts {
+    uint missed; //<- pixels of ids not listed
+    uint padding[3];
+    uint counts[]; //<- of each listed id: pixels, cols - 1 - x0, x1, rows - 1 - y0, y1
+};
+layout(std430, binding = 1) readonly buffer Ids {
+    int ids[]; //<- increasing
+};
+uniform isampler2D mask;
+uniform ivec2 size;
+uniform int idCount;
+uniform bool boxes;
+void main()
+{
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(p, size)))
+        return;
+    int id = texelFetch(mask, p, 0).r;
+    if (id == -1)
+        return;
+    int low = 0, high = idCount;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (ids[middle] < id)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low >= idCount || ids[low] != id) {
+        atomicAdd(missed, 1u);
+        return;
+    }
+    // bounds as maxima of zeroed counters, rows from the top of the image
+    uint base = uint(low) * 5u;
+    atomicAdd(counts[base], 1u);
+    if (boxes) {
+        atomicMax(counts[base + 1u], uint(size.x - 1 - p.x));
+        atomicMax(counts[base + 2u], uint(p.x));
+        atomicMax(counts[base + 3u], uint(p.y));
+        atomicMax(counts[base + 4u], uint(size.y - 1 - p.y));
+    }
+}
+)";
+
+/**
+ * @brief Make a context current on the calling thread for the scope of the object, holding the
+ * mutex of the renderers drawing in it
+ */
+class CurrentContext
+{
+  public:
+    CurrentContext(const CurrentContext&) = delete;
+    CurrentContext& operator=(const CurrentContext&) = delete;
+
+    CurrentContext(std::mutex& mutex, EGLDisplay display, EGLSurface surface, EGLContext context)
+        : _lock(mutex), _display(display)
+    {
+        if (!eglMakeCurrent(display, surface, surface, context))
+            throw std::runtime_error("EGLRenderer: cannot make the context current");
+    }
+    ~CurrentContext() { eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT); }
+
+  private:
+    std::lock_guard<std::mutex> _lock;
+    EGLDisplay _display;
+};
+
+PFNEGLQUERYDEVICESEXTPROC queryDevicesFunction()
+{
+    return reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(eglGetProcAddress("eglQueryDevicesEXT"));
+}
+
+EGLDisplay getDisplay(int device)
+{
+    if (device < 0)
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    const auto queryDevices = queryDevicesFunction();
+    const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (!queryDevices || !getPlatformDisplay)
+        throw std::runtime_error("EGLRenderer: EGL device enumeration is not supported");
+
+    EGLDeviceEXT devices[32];
+    EGLint count = 0;
+    if (!queryDevices(32, devices, &count) || device >= count)
+        throw std::runtime_error("EGLRenderer: EGL device " + std::to_string(device) +
+                                 " not found");
+    return getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[device], nullptr);
+}
+
+GLuint compileShader(GLenum type, const char* source)
+{
+    const GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        char log[1024] = {0};
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        glDeleteShader(shader);
+        throw std::runtime_error(std::string("EGLRenderer: shader compilation failed: ") + log);
+    }
+    return shader;
+}
+
+/// vendor, renderer and version of the driver of the current context, keying program binaries
+std::string driverString()
+{
+    std::string driver;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION}) {
+        const auto value = reinterpret_cast<const char*>(glGetString(name));
+        driver += value ? value : "";
+        driver += '\n';
+    }
+    return driver;
+}
+
+GLuint linkProgram(const char* vertexShader, const char* fragmentShader)
+{
+    // drivers without binary formats, or rejecting a binary, e.g. after an update they still
+    // report as the same version, compile the shaders
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    const bool cached = formats > 0 && !shaderCacheDirectory().empty();
+    const std::vector<std::string> sources = {vertexShader, fragmentShader};
+    const auto driver = cached ? driverString() : std::string();
+    uint32_t format;
+    std::vector<char> binary;
+    if (cached && loadCachedProgram(driver, sources, format, binary)) {
+        const GLuint program = glCreateProgram();
+        glProgramBinary(program, format, binary.data(), GLsizei(binary.size()));
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (status == GL_TRUE)
+            return program;
+        glDeleteProgram(program);
+    }
+
+    const GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexShader);
+    const GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentShader);
+    const GLuint program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    if (cached)
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        glDeleteProgram(program);
+        throw std::runtime_error("EGLRenderer: shader program link failed");
+    }
+
+    if (cached) {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        binary.resize(size_t(std::max(length, 0)));
+        GLenum binaryFormat = 0;
+        if (length > 0) {
+            glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+            binary.resize(size_t(std::max(length, 0)));
+            storeCachedProgram(driver, sources, binaryFormat, binary);
+        }
+    }
+    return program;
+}
+
+/// compute program, compiled once per renderer using it
+GLuint linkComputeProgram(const char* computeShader)
+{
+    const GLuint compute = compileShader(GL_COMPUTE_SHADER, computeShader);
+    const GLuint program = glCreateProgram();
+    glAttachShader(program, compute);
+    glLinkProgram(program);
+    glDeleteShader(compute);
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        glDeleteProgram(program);
+        throw std::runtime_error("EGLRenderer: compute program link failed");
+    }
+    return program;
+}
+
+#ifdef WITH_CUDA
+void checkCuda(cudaError_t error)
+{
+    if (error != cudaSuccess)
+        throw std::runtime_error(std::string("EGLRenderer: ") + cudaGetErrorString(error));
+}
+#endif
+
+/**
+ * @brief Append the triangles of a mesh in the frame of a column-major affine matrix
+ *
+ * Normals are transformed by the cofactors of the matrix, the inverse transpose up to a scale,
+ * and normalized. Missing normals and uvs are zero, as the disabled attributes of their mesh.
+ */
+void appendTransformed(const scene::MeshData& mesh, const Matrix4f& m, int segmentation,
+                       scene::MeshBuilder& merged, std::vector<int>& segmentations)
+{
+    const auto& vertices = mesh.vertices();
+    const auto& normals = mesh.normals();
+    const auto& uvs = mesh.uvs();
+    const size_t count = vertices.size() / 3;
+    const bool withNormals = normals.size() == vertices.size();
+    const bool withUvs = uvs.size() * 3 == vertices.size() * 2;
+    const auto a = [&m](int row, int col) { return m[col * 4 + row]; };
+    float cofactors[3][3];
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 3; ++col) {
+            const int r0 = (row + 1) % 3, r1 = (row + 2) % 3;
+            const int c0 = (col + 1) % 3, c1 = (col + 2) % 3;
+            cofactors[row][col] = a(r0, c0) * a(r1, c1) - a(r0, c1) * a(r1, c0);
+        }
+    }
+
+    const int first = int(merged.vertices.size() / 3);
+    for (size_t i = 0; i < count; ++i) {
+        const float* p = &vertices[i * 3];
+        for (int row = 0; row < 3; ++row)
+            merged.vertices.push_back(a(row, 0) * p[0] + a(row, 1) * p[1] + a(row, 2) * p[2] +
+                                      a(row, 3));
+        float n[3] = {0.f, 0.f, 0.f};
+        if (withNormals) {
+            const float* v = &normals[i * 3];
+            for (int row = 0; row < 3; ++row)
+                n[row] = cofactors[row][0] * v[0] + cofactors[row][1] * v[1] +
+                         cofactors[row][2] * v[2];
+            const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length > 0.f)
+                for (float& value : n)
+                    value /= length;
+        }
+        merged.normals.insert(merged.normals.end(), n, n + 3);
+        merged.uvs.push_back(withUvs ? uvs[i * 2] : 0.f);
+        merged.uvs.push_back(withUvs ? uvs[i * 2 + 1] : 0.f);
+    }
+    segmentations.insert(segmentations.end(), count, segmentation);
+    for (int index : mesh.indices())
+        merged.indices.push_back(first + index);
+}
+
+template <class T>
+void uploadBuffer(GLuint buffer, const std::vector<T>& data, bool inPlace)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (inPlace)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, data.size() * sizeof(T), data.data());
+    else
+        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(T), data.data(), GL_DYNAMIC_DRAW);
+}
+
+const int kReuseTileSize = 32; //<- pixels a side of the tiles redrawn by incremental frames
+
+/// \p box grown by the shadow it casts along \p direction, up to where rays leave \p scene
+scene::AABB shadowBounds(const scene::AABB& box, const Vector3f& direction,
+                         const scene::AABB& scene)
+{
+    scene::AABB swept = box;
+    for (int corner = 0; corner < 8; ++corner) {
+        const Vector3f p{corner & 1 ? box.upper[0] : box.lower[0],
+                         corner & 2 ? box.upper[1] : box.lower[1],
+                         corner & 4 ? box.upper[2] : box.lower[2]};
+        // slab exit of the ray from the corner out of the scene
+        float exit = std::numeric_limits<float>::infinity();
+        for (int k = 0; k < 3; ++k) {
+            if (direction[k] != 0.f) {
+                const float bound = direction[k] > 0.f ? scene.upper[k] : scene.lower[k];
+                exit = std::min(exit, std::max((bound - p[k]) / direction[k], 0.f));
+            }
+        }
+        if (exit == std::numeric_limits<float>::infinity())
+            continue;
+        swept.extend(Vector3f{p[0] + direction[0] * exit, p[1] + direction[1] * exit,
+                              p[2] + direction[2] * exit});
+    }
+    return swept;
+}
+
+/// pixels of a world box seen through \p viewProj grown into \p rect, x0, y0, x1, y1, false if
+/// unknown, e.g. infinite or behind the camera
+bool extendScreenRect(const Matrix4f& viewProj, const scene::AABB& box, int cols, int rows,
+                      Vector4i& rect)
+{
+    if (box.empty())
+        return true;
+    if (box.infinite())
+        return false;
+    float lower[2] = {1.f, 1.f}, upper[2] = {-1.f, -1.f};
+    for (int corner = 0; corner < 8; ++corner) {
+        const Vector3f p{corner & 1 ? box.upper[0] : box.lower[0],
+                         corner & 2 ? box.upper[1] : box.lower[1],
+                         corner & 4 ? box.upper[2] : box.lower[2]};
+        const float w = viewProj[3] * p[0] + viewProj[7] * p[1] + viewProj[11] * p[2] +
+                        viewProj[15];
+        if (w <= 1e-6f)
+            return false;
+        for (int k = 0; k < 2; ++k) {
+            const float ndc = (viewProj[k] * p[0] + viewProj[4 + k] * p[1] +
+                               viewProj[8 + k] * p[2] + viewProj[12 + k]) /
+                              w;
+            lower[k] = std::min(lower[k], ndc);
+            upper[k] = std::max(upper[k], ndc);
+        }
+    }
+    // whole tiles, clamped to the frame
+    const int size[2] = {cols, rows};
+    for (int k = 0; k < 2; ++k) {
+        const float from = std::max(lower[k], -1.f), to = std::min(upper[k], 1.f);
+        if (from >= to)
+            return true;
+        const int first = int(std::floor((from + 1.f) * 0.5f * size[k] / kReuseTileSize));
+        const int last = int(std::ceil((to + 1.f) * 0.5f * size[k] / kReuseTileSize));
+        rect[k] = std::min(rect[k], std::max(first * kReuseTileSize, 0));
+        rect[2 + k] = std::max(rect[2 + k], std::min(last * kReuseTileSize, size[k]));
+    }
+    return true;
+}
+
+} // namespace
+
+struct EGLRenderer::Context {
+    /**
+     * @brief Mesh buffers on the GPU
+     */
+    struct GpuMesh {
+        std::shared_ptr<scene::MeshData> data; //<- keeps the key alive
+        GLuint vao = 0;
+        GLuint buffers[4] = {0, 0, 0, 0}; //<- positions, normals, uvs, indices
+        size_t vertexCount = 0;
+        GLsizei indexCount = 0;
+        GLenum indexType = GL_UNSIGNED_INT;
+        bool interleaved = false; //<- uploaded from the vertex buffer of the data
+        std::shared_ptr<const scene::QuantizedMesh> quantized; //<- uploaded as is if set
+        size_t bytes = 0; //<- GPU memory of the buffers
+        uint64_t lastUsed = 0; //<- frame it was last drawn in
+    };
+
+    /**
+     * @brief Heights of a heightfield shape on the GPU, tiles uploaded at their last revision
+     */
+    struct GpuHeightfield {
+        GLuint texture = 0; //<- one float per grid point
+        int columns = 0;
+        int rows = 0;
+        std::vector<uint64_t> revisions; //<- tile revisions uploaded
+        std::vector<scene::AABB> tileBounds; //<- of the uploaded tiles
+        std::vector<std::array<float, kTileLevels>> tileErrors; //<- border errors by level
+        size_t bytes = 0; //<- GPU memory of the texture
+    };
+
+    /**
+     * @brief Triangles of a tile at a level of detail, shared by all heightfields
+     */
+    struct TileGrid {
+        GLuint vao = 0;
+        GLuint indices = 0;
+        GLsizei indexCount = 0;
+    };
+
+    /**
+     * @brief Key of a texture array: layer rows and columns, single channel, block compression,
+     * and the bitmap of a texture too large to share its array
+     */
+    using TextureArrayKey =
+        std::tuple<ssize_t, ssize_t, bool, scene::Bitmap::Compression, const scene::Bitmap*>;
+
+    /**
+     * @brief Array texture of equal size layers, one texture per layer
+     */
+    struct TextureArray {
+        GLuint texture = 0;
+        std::vector<const scene::Bitmap*> layers; //<- bitmap of each layer, null if free
+        int used = 0; //<- layers holding a bitmap
+        size_t bytes = 0; //<- GPU memory of all layers
+        bool mipmaps = false; //<- mipmaps of the layers up to date, compressed ones have theirs
+    };
+
+    /**
+     * @brief Texture on the GPU, a layer of an array
+     */
+    struct GpuTexture {
+        std::shared_ptr<scene::Bitmap> bitmap; //<- keeps the key alive
+        TextureArrayKey array;
+        int layer = 0;
+        size_t bytes = 0; //<- GPU memory of the layer with mipmaps
+        uint64_t lastUsed = 0; //<- frame it was last drawn in
+        uint64_t revision = 0; //<- revision of the uploaded pixels
+        int finestLevel = 0; //<- finest mip level on the GPU, finer ones stream in above 0
+        int coarseLevel = 0; //<- level uploaded first and kept under pressure, 0 if not streamed
+        std::vector<std::vector<uint8_t>> mipPixels; //<- levels 1 and up of uncompressed ones
+    };
+
+    /**
+     * @brief Opaque mesh shapes of static nodes sharing a texture and material, merged in world
+     * space into a single draw
+     */
+    struct StaticBatch {
+        std::shared_ptr<scene::Material> material; //<- keeps the key alive
+        std::shared_ptr<scene::Bitmap> bitmap;
+        Color4f color;
+        std::vector<int> nodeIds; //<- ascending
+        int shapes = 0;
+        scene::AABB bounds = scene::AABB::Empty(); //<- world bounds of the shapes
+        GpuMesh mesh; //<- world space float attributes
+        GLuint segmentation = 0; //<- mask value of each vertex
+    };
+
+    /**
+     * @brief Key of a static batch: bitmap then material, as opaque draws are grouped
+     */
+    using StaticBatchKey = std::pair<const scene::Bitmap*, const scene::Material*>;
+
+    /**
+     * @brief Shapes of a base layer merged into batches by texture and material, shared by the
+     * renderers of the context drawing the layer
+     */
+    struct LayerBatches {
+        std::map<StaticBatchKey, StaticBatch> batches;
+        scene::AABB bounds = scene::AABB::Empty(); //<- world bounds of the batches
+    };
+
+    /**
+     * @brief Mip chain of the nearest and farthest metric depth, reduced on the GPU from the
+     * occluders down to the level read back for occlusion culling, or from the frame down to the
+     * levels of the DepthPyramid channel
+     */
+    struct DepthReduction {
+        GLuint program = 0;
+        GLint source = -1;
+        GLint finest = -1;
+        GLuint vao = 0; //<- no attributes, vertices come from their index
+        GLuint framebuffer = 0; //<- draws into one level
+        GLuint texture = 0; //<- metric depth copy, then nearest and farthest depth of each level
+        int cols = 0; //<- image size of the texture
+        int rows = 0;
+        int levels = 0; //<- last level allocated, of a single texel
+        int shift = 0; //<- level read back for occlusion culling
+        size_t bytes = 0; //<- GPU memory of all levels
+    };
+
+    /**
+     * @brief Log luminance of the last event of each pixel of the Events channel, kept on the
+     * GPU for each camera, and the events found by the compute shader
+     */
+    struct EventTargets {
+        /// reference of a camera, bottom row first
+        struct Reference {
+            GLuint texture = 0; //<- R32F
+            int cols = 0;
+            int rows = 0;
+            double time = 0.0; //<- of the previous frame
+        };
+        GLuint program = 0;
+        GLint size = -1, threshold = -1, capacity = -1, first = -1;
+        GLuint colors = 0; //<- copy of the color target
+        GLuint buffer = 0; //<- counters then room for an event per pixel
+        int cols = 0; //<- of the copy and the buffer
+        int rows = 0;
+        std::map<int, Reference> references; //<- by camera handle, -1 for unregistered cameras
+        size_t bytes = 0;
+        bool supported = false; //<- OpenGL 4.3, compute shaders and image load store
+    };
+
+    /**
+     * @brief Pixels of each segmentation id of the Visibility channel and their bounds, counted
+     * by a compute shader over a copy of the mask target
+     */
+    struct PixelCountTargets {
+        GLuint program = 0;
+        GLint size = -1, idCount = -1, boxes = -1;
+        GLuint mask = 0; //<- R32I copy of the mask target
+        GLuint counts = 0; //<- missed pixels then 5 counters per id
+        GLuint ids = 0; //<- ids looked up
+        int cols = 0; //<- of the copy
+        int rows = 0;
+        size_t capacity = 0; //<- ids the buffers hold
+        std::vector<GLuint> readback; //<- counters read back
+        size_t bytes = 0;
+        bool supported = false; //<- OpenGL 4.3, compute shaders
+    };
+
+    /**
+     * @brief Depth maps of the light, static casters kept across frames and a copy with the
+     * dynamic ones drawn over them
+     */
+    struct ShadowMaps {
+        GLuint textures[2] = {0, 0}; //<- static casters, all casters
+        GLuint framebuffers[2] = {0, 0};
+        int size = 0;
+        size_t bytes = 0;
+        int sampled = 0; //<- map of the last frame
+    };
+
+    /**
+     * @brief Cubemap faces of an equirectangular view, copied out of the frame targets after
+     * each face, and the image reprojected from them
+     */
+    struct PanoramaTarget {
+        GLuint program = 0;
+        GLint colors = -1, masks = -1, depths = -1, imageSize = -1, faceSize = -1;
+        GLuint vao = 0; //<- no attributes, vertices come from their index
+        GLuint faces[3] = {0, 0, 0}; //<- color, mask, metric depth arrays of six layers
+        GLuint framebuffer = 0; //<- the equirectangular image
+        GLuint renderbuffers[3] = {0, 0, 0}; //<- color, mask, metric depth
+        int size = 0; //<- of the faces
+        int cols = 0; //<- of the image
+        int rows = 0;
+        size_t bytes = 0;
+    };
+
+    /**
+     * @brief Copies of the frame targets drawn at the internal resolution of a render scale, and
+     * the image of the frame size resampled from them, or remapped from them through the lens of
+     * the camera for views with lens distortion
+     */
+    struct ScaledTarget {
+        /// texture coordinates of the pixels of a lens map, bottom row first
+        struct LensTexture {
+            GLuint texture = 0;
+            uint64_t revision = 0; //<- of the map uploaded
+            int cols = 0;
+            int rows = 0;
+        };
+        GLuint program = 0;
+        GLint colors = -1, masks = -1, depths = -1, imageSize = -1;
+        GLuint lensProgram = 0;
+        GLint lensColors = -1, lensMasks = -1, lensDepths = -1, lensCoords = -1;
+        std::map<int, LensTexture> lenses; //<- by camera handle, -1 for unregistered cameras
+        GLuint vao = 0; //<- no attributes, vertices come from their index
+        GLuint textures[3] = {0, 0, 0}; //<- color, mask, metric depth
+        int sourceCols = 0; //<- of the textures
+        int sourceRows = 0;
+        GLuint framebuffer = 0; //<- the image
+        GLuint renderbuffers[3] = {0, 0, 0}; //<- color, mask, metric depth
+        int cols = 0; //<- of the image
+        int rows = 0;
+        size_t bytes = 0;
+    };
+
+    /**
+     * @brief Multisampled targets of each sample count drawn, of the frame size, and the pass
+     * resolving them into the frame targets
+     */
+    struct Multisampling {
+        struct Targets {
+            GLuint framebuffer = 0;
+            GLuint renderbuffers[2] = {0, 0}; //<- color, depth buffer
+            GLuint textures[2] = {0, 0}; //<- mask, metric depth, fetched by sample
+            int cols = 0;
+            int rows = 0;
+        };
+        GLuint program = 0;
+        GLint masks = -1, depths = -1;
+        GLuint vao = 0; //<- no attributes, vertices come from their index
+        std::map<int, Targets> targets; //<- by sample count
+        int samples = 0; //<- of the current view, drawn into multisampled targets if not 0
+        GLint maxSamples = 0; //<- supported by all target formats, queried at first use
+        size_t bytes = 0;
+    };
+
+    /**
+     * @brief Model matrices of the draws of the last frames, in a ring of texture buffers read by
+     * the vertex shader, so that a frame writes them once rather than by a uniform per draw
+     *
+     * With GL_ARB_buffer_storage the buffers stay mapped, coherent, and are written in place; a
+     * fence per buffer keeps a frame from overwriting those the GPU still reads, three frames
+     * back. Without it, they are written by glBufferSubData().
+     */
+    struct TransformStream {
+        static const int kBuffers = 3;
+        GLuint buffers[kBuffers] = {0, 0, 0};
+        GLuint textures[kBuffers] = {0, 0, 0}; //<- RGBA32F views of the buffers
+        float* mapped[kBuffers] = {nullptr, nullptr, nullptr}; //<- persistent mappings
+        GLsync fences[kBuffers] = {nullptr, nullptr, nullptr}; //<- last frame reading each
+        bool persistent = false; //<- buffers mapped for good, GL_ARB_buffer_storage
+        size_t capacity = 0; //<- draws per buffer
+        int current = 0; //<- buffer of the frame
+        size_t count = 0; //<- draws written in the frame
+    };
+
+    /**
+     * @brief Point and spot lights of the view drawn and their clusters, in texture buffers
+     * rewritten by each view
+     */
+    struct LightBuffers {
+        GLuint buffers[2] = {0, 0}; //<- light texels, cluster ranges then light indices
+        GLuint textures[2] = {0, 0}; //<- RGBA32F and R32UI views of the buffers
+        LightClusters clusters; //<- of the view drawn
+    };
+
+    /**
+     * @brief Meshes in one vertex and index arena, drawn by glMultiDrawElementsIndirect from
+     * commands written by a culling compute shader, OpenGL 4.3
+     *
+     * Vertices are interleaved floats, quantized meshes decoded, indices 32 bits. The arena only
+     * grows, by copies of its buffers, and is dropped whole once most of it holds meshes not used
+     * any more. Records and culling inputs are rewritten by each list of draws.
+     */
+    struct IndirectDraws {
+        struct ArenaMesh {
+            std::shared_ptr<scene::MeshData> data; //<- keeps the key alive
+            GLuint indexCount = 0;
+            GLuint firstIndex = 0;
+            GLint baseVertex = 0;
+            Vector4f sphere; //<- bounding sphere in the mesh frame
+        };
+        /// input of the compute shader per draw, std430 layout
+        struct Cull {
+            Vector4f sphere;
+            GLuint count;
+            GLuint firstIndex;
+            GLint baseVertex;
+            GLint transformIndex;
+        };
+        /// layout of glMultiDrawElementsIndirect
+        struct Command {
+            GLuint count;
+            GLuint instanceCount;
+            GLuint firstIndex;
+            GLint baseVertex;
+            GLuint baseInstance;
+        };
+        static const int kVertexFloats = 8; //<- position, normal, uv
+
+        bool supported = false; //<- OpenGL 4.3 context
+        GLuint program = 0; //<- culling compute shader, compiled on first use
+        GLint planes = -1, drawCount = -1, instances = -1;
+        GLuint vao = 0;
+        // vertices, indices, draw indices, records, culling inputs, commands
+        GLuint buffers[6] = {0, 0, 0, 0, 0, 0};
+        GLuint recordTexture = 0; //<- RGBA32I view of the records
+        size_t vertexCapacity = 0, indexCapacity = 0; //<- bytes
+        size_t vertexCount = 0, indexCount = 0; //<- used
+        size_t drawCapacity = 0; //<- draw indices
+        std::map<const scene::MeshData*, ArenaMesh> meshes;
+        std::vector<GLint> records; //<- 8 per draw
+        std::vector<Cull> culls;
+        std::vector<std::pair<size_t, const GpuTexture*>> groups; //<- first draw, texture
+    };
+
+    /**
+     * @brief GL_TIME_ELAPSED queries of the passes of the last two frames, alternating so that
+     * those of a frame are read two frames later, once the GPU is done with them
+     *
+     * Queries do not nest: a pass ends when the next one begins. Those of a pass add up over a
+     * frame, into one sample of its stage in the stats current when the frame was drawn.
+     */
+    struct PassTimers {
+        struct Frame {
+            std::vector<GLuint> queries; //<- created as needed, reused
+            std::vector<Stage> stages; //<- of the queries issued in the frame
+            std::shared_ptr<StageStats> stats;
+        };
+        Frame frames[2];
+        int current = 0; //<- frame of the queries issued
+        Stage stage = Stage::Count; //<- of the running query, Count if none
+    };
+
+    /**
+     * @brief EGL context with the meshes, textures and tile grids drawn in it, shared by the
+     * renderers of a device created with resource sharing, a renderer's own otherwise
+     *
+     * Renderers hold the mutex while the context is current, so that one renderer at a time
+     * draws in it, whichever its thread. Resources are kept while any renderer used them at its
+     * last pruning, and evicted by their last use in a frame of any renderer.
+     */
+    struct Shared {
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLSurface surface = EGL_NO_SURFACE;
+        EGLContext context = EGL_NO_CONTEXT;
+        std::mutex mutex;
+        std::vector<const Context*> users; //<- renderers drawing in the context
+        std::map<const scene::MeshData*, GpuMesh> meshes;
+        std::map<const scene::Bitmap*, GpuTexture> textures;
+        std::map<TextureArrayKey, TextureArray> textureArrays;
+        GLuint boundArray = 0; //<- array bound to the first texture unit
+        std::map<std::pair<int, bool>, TileGrid> tileGrids; //<- by level, flipped diagonals
+        std::set<const scene::MeshData*> dirty; //<- meshes rewritten in place since drawn
+        // batches of the base layers drawn by the users, by layer and segmentation mode
+        std::map<std::pair<const scene::SceneLayer*, scene::SegmentationMode>,
+                 std::weak_ptr<LayerBatches>>
+            layers;
+        uint64_t frame = 0; //<- frames drawn by all users, for least recently used eviction
+        size_t residentBytes = 0; //<- GPU memory of meshes and textures of all users
+        size_t peakResidentBytes = 0;
+
+        ~Shared()
+        {
+            if (context == EGL_NO_CONTEXT)
+                return;
+            {
+                CurrentContext current(mutex, display, surface, context);
+                for (auto& it : meshes) {
+                    glDeleteBuffers(4, it.second.buffers);
+                    glDeleteVertexArrays(1, &it.second.vao);
+                }
+                for (auto& it : textureArrays)
+                    glDeleteTextures(1, &it.second.texture);
+                for (auto& it : tileGrids) {
+                    glDeleteBuffers(1, &it.second.indices);
+                    glDeleteVertexArrays(1, &it.second.vao);
+                }
+            }
+            // the display is shared by the process, it is never terminated
+            eglDestroyContext(display, context);
+            eglDestroySurface(display, surface);
+        }
+    };
+
+    /**
+     * @brief Shared context of a device, created on first use and released with its last
+     * renderer
+     */
+    static std::shared_ptr<Shared> sharedContext(int device)
+    {
+        static std::mutex mutex;
+        static std::map<int, std::weak_ptr<Shared>> contexts;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto shared = contexts[device].lock();
+        if (!shared) {
+            shared = std::make_shared<Shared>();
+            contexts[device] = shared;
+        }
+        return shared;
+    }
+
+    explicit Context(std::shared_ptr<Shared> shared_) : shared(std::move(shared_)) {}
+
+    std::shared_ptr<Shared> shared;
+    GLuint program = 0;
+    GLint model = -1, view = -1, viewProj = -1, diffuse = -1, textured = -1, diffuseTexture = -1;
+    GLint textureLayer = -1;
+    GLint lightDirection = -1, ambientColor = -1, diffuseColor = -1, segmentation = -1;
+    GLint positionOffset = -1, positionScale = -1, uvOffset = -1, uvScale = -1, octNormals = -1;
+    GLint heightfield = -1, heights = -1, tileOrigin = -1, tileStep = -1, tileVertices = -1;
+    GLint skirtDepth = -1, batched = -1, lightViewProj = -1, shadowed = -1, shadowMap = -1;
+    GLint maskOnly = -1;
+    GLint shadowCascades = -1, cascadeViewProjs = -1, cascadeTiles = -1;
+    GLint pointsInWorld = -1, depthScale = -1, previousModel = -1, previousViewProj = -1;
+    GLint imageSize = -1, transformBuffer = -1, transformIndex = -1;
+    GLint projective = -1, projectorViewProj = -1;
+    GLint viewCount = -1, viewMatrices = -1, viewProjs = -1, viewBands = -1;
+    GLint localLights = -1, unboundedLights = -1, boundedLights = -1, clustered = -1;
+    GLint lightClusters = -1, clusterGrid = -1, clusterDepth = -1;
+    GLint indirect = -1, drawRecords = -1;
+    GLuint framebuffer = 0;
+    GLuint renderbuffers[4] = {0, 0, 0, 0}; //<- color, mask, metric depth, depth buffer
+    GLuint pointRenderbuffer = 0; //<- XYZ of each pixel, allocated once points are requested
+    bool pointOutput = false; //<- points drawn in the current frame
+    GLuint shortRenderbuffer = 0; //<- 16-bit depth and mask, allocated once requested
+    bool shortOutput = false; //<- 16-bit depth and mask drawn in the current frame
+    GLuint motionRenderbuffer = 0; //<- motion of each pixel, allocated once requested
+    bool motionOutput = false; //<- motion drawn in the current frame
+    GLuint normalRenderbuffer = 0; //<- camera frame normals, allocated once requested
+    bool normalOutput = false; //<- normals drawn in the current frame
+    int cols = 0;
+    int rows = 0;
+    GLuint pixelBuffers[3] = {0, 0, 0}; //<- color, mask, metric depth kept on the GPU
+    size_t pixelBufferSize = 0;
+#ifdef WITH_CUDA
+    cudaGraphicsResource_t resources[3] = {nullptr, nullptr, nullptr};
+    bool mapped = false;
+#endif
+
+    std::map<std::pair<int, int>, GpuHeightfield> heightfields; //<- by node id, shape index
+    std::set<const scene::MeshData*> dirty; //<- rewritten in place, for the next frame
+    // resources of the scene at the last pruning, kept for the other users of the context
+    std::set<const scene::MeshData*> usedMeshes;
+    std::set<const scene::Bitmap*> usedBitmaps;
+    std::map<StaticBatchKey, StaticBatch> staticBatches;
+    std::shared_ptr<LayerBatches> layer; //<- of the base layer drawn, shared with other users
+    DepthReduction reduction;
+    EventTargets events;
+    PixelCountTargets pixelCounts;
+    ShadowMaps shadows;
+    PanoramaTarget panorama;
+    Multisampling multisampling;
+    ScaledTarget scaled;
+    PassTimers timers;
+    TransformStream transforms;
+    LightBuffers lights;
+    IndirectDraws indirectDraws;
+    std::vector<float> transformData; //<- matrices of the draws being streamed, 32 per draw
+    GLuint samplers[2] = {0, 0}; //<- nearest and bilinear filtering, created at first use
+    bool prune = false; //<- drop resources not used by the scene at the next frame
+    uint64_t uploads = 0;
+    uint64_t evictions = 0;
+    uint64_t tileUploads = 0;
+    uint64_t texelUploads = 0; //<- textures uploaded again over their layer
+    uint64_t streamedBytes = 0; //<- finer mip levels of streamed textures uploaded
+    uint64_t mipEvictions = 0; //<- streamed textures dropped back to their coarse level
+    int pendingTextures = 0; //<- streamed textures drawn coarser than wanted, last frame
+    size_t streamBudget = 0; //<- bytes of mip levels streamed per frame, 0 for whole textures
+    std::map<const scene::Bitmap*, float> textureDemand; //<- screen size of streamed textures
+    int materialSwitches = 0; //<- in the last frame
+    int textureBinds = 0; //<- in the last frame
+    int indirectShapes = 0; //<- drawn by indirect commands in the last frame
+    int multiDraws = 0; //<- indirect draw calls of the last frame
+    // nodes of the last frame
+    int drawnNodes = 0; //<- passing culling
+    int frustumCulledNodes = 0;
+    int occludedNodes = 0;
+    int opaqueShapes = 0;
+    int blendedShapes = 0;
+    uint64_t staticShadowUpdates = 0; //<- static shadow maps drawn
+    int shadowCasters = 0; //<- dynamic shapes drawn over the static shadow map, last frame
+    int redrawnPixels = 0; //<- pixels of the tiles drawn in the last frame, all but incremental
+
+    /// mesh buffers
+    size_t bufferBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto& it : shared->meshes)
+            bytes += it.second.bytes;
+        for (const auto& it : staticBatches)
+            bytes += it.second.mesh.bytes;
+        return bytes + layerBytes() + indirectDraws.vertexCapacity + indirectDraws.indexCapacity;
+    }
+
+    /// texture arrays with their free layers, and heightfield textures
+    size_t textureBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto& it : shared->textureArrays)
+            bytes += it.second.bytes;
+        for (const auto& it : heightfields)
+            bytes += it.second.bytes;
+        return bytes;
+    }
+
+    /// color, mask, metric depth and depth targets of 4 bytes per pixel, points target of 16,
+    /// 16-bit depth and mask and motion targets of 4, normals target of 8, pixel buffers, depth
+    /// reduction levels, event references, shadow maps, panorama, multisampled and resampling
+    /// targets
+    size_t framebufferBytes() const
+    {
+        const size_t pixelBytes = 16 + (pointRenderbuffer ? 16 : 0) +
+                                  (shortRenderbuffer ? 4 : 0) + (motionRenderbuffer ? 4 : 0) +
+                                  (normalRenderbuffer ? 8 : 0);
+        return size_t(cols) * size_t(rows) * pixelBytes + pixelBufferSize * 3 + reduction.bytes +
+               events.bytes + pixelCounts.bytes + shadows.bytes + panorama.bytes +
+               multisampling.bytes + scaled.bytes;
+    }
+
+    /// merged buffers of the base layers drawn by the users of the context
+    size_t layerBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto& it : shared->layers)
+            if (const auto batches = it.second.lock())
+                for (const auto& batch : batches->batches)
+                    bytes += batch.second.mesh.bytes;
+        return bytes;
+    }
+
+    /// GPU memory of the renderer, that of the shared meshes, textures and base layers split
+    /// evenly between the users of the context so that the renderers of a process add up to its
+    /// total
+    size_t gpuBytes() const
+    {
+        size_t sharedBytes = layerBytes(), ownBytes = framebufferBytes();
+        for (const auto& it : shared->meshes)
+            sharedBytes += it.second.bytes;
+        for (const auto& it : shared->textureArrays)
+            sharedBytes += it.second.bytes;
+        for (const auto& it : staticBatches)
+            ownBytes += it.second.mesh.bytes;
+        for (const auto& it : heightfields)
+            ownBytes += it.second.bytes;
+        ownBytes += indirectDraws.vertexCapacity + indirectDraws.indexCapacity;
+        return ownBytes + sharedBytes / std::max<size_t>(shared->users.size(), 1);
+    }
+
+    /// count the GPU memory of an upload, keeping the high-water mark
+    void addResident(size_t bytes)
+    {
+        shared->residentBytes += bytes;
+        shared->peakResidentBytes = std::max(shared->peakResidentBytes, shared->residentBytes);
+    }
+
+    const GpuMesh& mesh(const std::shared_ptr<scene::MeshData>& data)
+    {
+        auto it = shared->meshes.find(data.get());
+        const bool inPlace = it != shared->meshes.end() && shared->dirty.count(data.get()) &&
+                             it->second.vertexCount == data->numVertices() &&
+                             !it->second.interleaved && !it->second.quantized;
+        if (it != shared->meshes.end() && !shared->dirty.count(data.get())) {
+            it->second.lastUsed = shared->frame;
+            return it->second;
+        }
+
+        if (it == shared->meshes.end() || !inPlace) {
+            if (it != shared->meshes.end()) {
+                release(it->second);
+                shared->meshes.erase(it);
+            }
+            it = shared->meshes.emplace(data.get(), GpuMesh()).first;
+            auto& mesh = it->second;
+            mesh.data = data;
+            glGenVertexArrays(1, &mesh.vao);
+            glGenBuffers(4, mesh.buffers);
+        }
+        shared->dirty.erase(data.get());
+
+        auto& mesh = it->second;
+        glBindVertexArray(mesh.vao);
+        mesh.vertexCount = data->numVertices();
+        mesh.indexCount = GLsizei(data->indices().size());
+        mesh.lastUsed = shared->frame;
+        shared->residentBytes -= mesh.bytes;
+        ++uploads;
+
+        mesh.quantized = data->quantized();
+        if (const auto& quantized = mesh.quantized) {
+            // normalized attributes, dequantized by the vertex shader
+            uploadBuffer(mesh.buffers[0], quantized->positions, false);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0, nullptr);
+            if (!quantized->normals.empty()) {
+                uploadBuffer(mesh.buffers[1], quantized->normals, false);
+                glEnableVertexAttribArray(1);
+                glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, 0, nullptr);
+            }
+            else {
+                glDisableVertexAttribArray(1);
+                glVertexAttrib3f(1, 0.f, 0.f, 0.f);
+            }
+            if (!quantized->uvs.empty()) {
+                uploadBuffer(mesh.buffers[2], quantized->uvs, false);
+                glEnableVertexAttribArray(2);
+                glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, 0, nullptr);
+            }
+            else {
+                glDisableVertexAttribArray(2);
+                glVertexAttrib2f(2, 0.f, 0.f);
+            }
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[3]);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, data->indices().size() * sizeof(int),
+                         data->indices().data(), GL_STATIC_DRAW);
+            glBindVertexArray(0);
+            mesh.indexType = GL_UNSIGNED_INT;
+            mesh.interleaved = false;
+            mesh.bytes = (quantized->positions.size() + quantized->normals.size() +
+                          quantized->uvs.size()) *
+                             sizeof(uint16_t) +
+                         data->indices().size() * sizeof(int);
+            addResident(mesh.bytes);
+            return mesh;
+        }
+
+        if (const auto& buffer = data->vertexBuffer()) {
+            // interleaved once at import, uploaded as is
+            const auto& layout = buffer->layout();
+            const GLenum attributeType = layout.halfAttributes ? GL_HALF_FLOAT : GL_FLOAT;
+            const auto offset = [](int bytes) { return reinterpret_cast<const void*>(bytes); };
+            uploadBuffer(mesh.buffers[0], buffer->vertices(), false);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, layout.stride, nullptr);
+            if (layout.normalOffset >= 0) {
+                glEnableVertexAttribArray(1);
+                glVertexAttribPointer(1, 3, attributeType, GL_FALSE, layout.stride,
+                                      offset(layout.normalOffset));
+            }
+            else {
+                glDisableVertexAttribArray(1);
+                glVertexAttrib3f(1, 0.f, 0.f, 0.f);
+            }
+            if (layout.uvOffset >= 0) {
+                glEnableVertexAttribArray(2);
+                glVertexAttribPointer(2, 2, attributeType, GL_FALSE, layout.stride,
+                                      offset(layout.uvOffset));
+            }
+            else {
+                glDisableVertexAttribArray(2);
+                glVertexAttrib2f(2, 0.f, 0.f);
+            }
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[3]);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffer->indices().size(),
+                         buffer->indices().data(), GL_STATIC_DRAW);
+            glBindVertexArray(0);
+            mesh.indexType = layout.shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            mesh.interleaved = true;
+            mesh.bytes = buffer->vertices().size() + buffer->indices().size();
+            addResident(mesh.bytes);
+            return mesh;
+        }
+
+        uploadBuffer(mesh.buffers[0], data->vertices(), inPlace);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+        uploadBuffer(mesh.buffers[1], data->normals(), inPlace);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+        if (!inPlace) {
+            if (data->uvs().size() * 3 == data->vertices().size() * 2) {
+                uploadBuffer(mesh.buffers[2], data->uvs(), false);
+                glEnableVertexAttribArray(2);
+                glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+            }
+            else {
+                glDisableVertexAttribArray(2);
+                glVertexAttrib2f(2, 0.f, 0.f);
+            }
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[3]);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, data->indices().size() * sizeof(int),
+                         data->indices().data(), GL_STATIC_DRAW);
+        }
+        glBindVertexArray(0);
+        mesh.indexType = GL_UNSIGNED_INT;
+        mesh.interleaved = false;
+        mesh.bytes = (data->vertices().size() + data->normals().size() + data->uvs().size()) *
+                         sizeof(float) +
+                     data->indices().size() * sizeof(int);
+        addResident(mesh.bytes);
+        return mesh;
+    }
+
+    /// upload the merged attributes of a batch, replacing its previous buffers
+    void upload(StaticBatch& batch, const scene::MeshBuilder& merged,
+                const std::vector<int>& segmentation)
+    {
+        auto& mesh = batch.mesh;
+        if (!mesh.vao) {
+            glGenVertexArrays(1, &mesh.vao);
+            glGenBuffers(4, mesh.buffers);
+            glGenBuffers(1, &batch.segmentation);
+        }
+        glBindVertexArray(mesh.vao);
+        uploadBuffer(mesh.buffers[0], merged.vertices, false);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+        uploadBuffer(mesh.buffers[1], merged.normals, false);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+        uploadBuffer(mesh.buffers[2], merged.uvs, false);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        uploadBuffer(batch.segmentation, segmentation, false);
+        glEnableVertexAttribArray(3);
+        glVertexAttribIPointer(3, 1, GL_INT, 0, nullptr);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[3]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, merged.indices.size() * sizeof(int),
+                     merged.indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        mesh.vertexCount = segmentation.size();
+        mesh.indexCount = GLsizei(merged.indices.size());
+        mesh.indexType = GL_UNSIGNED_INT;
+        shared->residentBytes -= mesh.bytes;
+        mesh.bytes = (merged.vertices.size() + merged.normals.size() + merged.uvs.size()) *
+                         sizeof(float) +
+                     (segmentation.size() + merged.indices.size()) * sizeof(int);
+        addResident(mesh.bytes);
+        ++uploads;
+    }
+
+    /// dequantization uniforms of a mesh
+    void dequantize(const GpuMesh& mesh) const
+    {
+        static const float zero[3] = {0.f, 0.f, 0.f}, one[3] = {1.f, 1.f, 1.f};
+        const auto& quantized = mesh.quantized;
+        glUniform3fv(positionOffset, 1, quantized ? quantized->positionOffset.data() : zero);
+        glUniform3fv(positionScale, 1, quantized ? quantized->positionScale.data() : one);
+        glUniform2fv(uvOffset, 1, quantized ? quantized->uvOffset.data() : zero);
+        glUniform2fv(uvScale, 1, quantized ? quantized->uvScale.data() : one);
+        glUniform1i(octNormals, quantized && !quantized->normals.empty() ? 1 : 0);
+    }
+
+    /**
+     * @brief Upload the heights of the tiles whose revision changed since the last upload
+     */
+    const GpuHeightfield& heightfieldTiles(const std::pair<int, int>& key,
+                                           const scene::Heightfield& heightfield)
+    {
+        const int columns = heightfield.columns(), rows = heightfield.rows();
+        const int tileColumns = heightfield.tileColumns(), tileRows = heightfield.tileRows();
+        auto& gpu = heightfields[key];
+        glActiveTexture(GL_TEXTURE1);
+        if (!gpu.texture || gpu.columns != columns || gpu.rows != rows) {
+            if (!gpu.texture)
+                glGenTextures(1, &gpu.texture);
+            glBindTexture(GL_TEXTURE_2D, gpu.texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, columns, rows, 0, GL_RED, GL_FLOAT,
+                         heightfield.heights().data());
+            // complete without mipmaps, read with texelFetch
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            shared->residentBytes -= gpu.bytes;
+            gpu.columns = columns;
+            gpu.rows = rows;
+            gpu.bytes = size_t(columns) * size_t(rows) * sizeof(float);
+            addResident(gpu.bytes);
+            gpu.revisions.assign(size_t(tileColumns) * tileRows, 0);
+            gpu.tileBounds.assign(gpu.revisions.size(), scene::AABB::Empty());
+            gpu.tileErrors.resize(gpu.revisions.size());
+            ++uploads;
+        }
+        else {
+            glBindTexture(GL_TEXTURE_2D, gpu.texture);
+        }
+
+        // only the modified tiles, the shader derives normals from neighbor heights
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, columns);
+        for (int tileRow = 0; tileRow < tileRows; ++tileRow) {
+            for (int tileColumn = 0; tileColumn < tileColumns; ++tileColumn) {
+                const size_t tile = size_t(tileRow) * tileColumns + tileColumn;
+                const auto revision = heightfield.tileRevision(tileColumn, tileRow);
+                if (gpu.revisions[tile] == revision)
+                    continue;
+                const int c0 = tileColumn * scene::Heightfield::kTileCells;
+                const int r0 = tileRow * scene::Heightfield::kTileCells;
+                const int c1 = std::min(c0 + scene::Heightfield::kTileCells, columns - 1);
+                const int r1 = std::min(r0 + scene::Heightfield::kTileCells, rows - 1);
+                if (gpu.revisions[tile]) {
+                    glPixelStorei(GL_UNPACK_SKIP_PIXELS, c0);
+                    glPixelStorei(GL_UNPACK_SKIP_ROWS, r0);
+                    glTexSubImage2D(GL_TEXTURE_2D, 0, c0, r0, c1 - c0 + 1, r1 - r0 + 1, GL_RED,
+                                    GL_FLOAT, heightfield.heights().data());
+                }
+                gpu.revisions[tile] = revision;
+                gpu.tileBounds[tile] = heightfield.tileBounds(tileColumn, tileRow);
+                for (int level = 0; level < kTileLevels; ++level)
+                    gpu.tileErrors[tile][level] =
+                        heightfield.tileEdgeError(tileColumn, tileRow, 1 << level);
+                ++tileUploads;
+            }
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+        glActiveTexture(GL_TEXTURE0);
+        return gpu;
+    }
+
+    /**
+     * @brief Triangles of a tile grid with a ring of skirt vertices, indexed row by row
+     */
+    const TileGrid& tileGrid(int level, bool flipDiagonals)
+    {
+        auto& grid = shared->tileGrids[std::make_pair(level, flipDiagonals)];
+        if (grid.vao)
+            return grid;
+
+        const int size = (scene::Heightfield::kTileCells >> level) + 3;
+        std::vector<uint16_t> indices;
+        indices.reserve(size_t(size - 1) * size_t(size - 1) * 6);
+        for (int row = 0; row + 1 < size; ++row) {
+            for (int column = 0; column + 1 < size; ++column) {
+                const auto p00 = uint16_t(row * size + column), p10 = uint16_t(p00 + 1);
+                const auto p01 = uint16_t(p00 + size), p11 = uint16_t(p01 + 1);
+                if (flipDiagonals)
+                    indices.insert(indices.end(), {p00, p10, p11, p00, p11, p01});
+                else
+                    indices.insert(indices.end(), {p00, p10, p01, p10, p11, p01});
+            }
+        }
+        glGenVertexArrays(1, &grid.vao);
+        glGenBuffers(1, &grid.indices);
+        glBindVertexArray(grid.vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid.indices);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(),
+                     GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        grid.indexCount = GLsizei(indices.size());
+        return grid;
+    }
+
+    /**
+     * @brief Draw the tiles of a heightfield in \p frustum, each at its level of detail for
+     * \p camera, \p instances times for the views of multiview frames
+     */
+    void drawHeightfield(const std::pair<int, int>& key, const scene::Heightfield& heightfield,
+                         const Matrix4f& model, const scene::Camera& camera,
+                         const scene::Frustum& frustum, int viewportRows,
+                         const scene::LodPolicy& lodPolicy, int instances)
+    {
+        const auto& gpu = heightfieldTiles(key, heightfield);
+        const auto& origin = heightfield.origin();
+        const auto& cellSize = heightfield.cellSize();
+        const float offset[3] = {origin[0], origin[1], 0.f};
+        const float scale[3] = {cellSize[0], cellSize[1], 1.f};
+        glUniform3fv(positionOffset, 1, offset);
+        glUniform3fv(positionScale, 1, scale);
+        glUniform2fv(uvOffset, 1, heightfield.uvOffset().data());
+        glUniform2fv(uvScale, 1, heightfield.uvScale().data());
+        glUniform1i(octNormals, 0);
+        glUniform1i(this->heightfield, 1);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, gpu.texture);
+        glActiveTexture(GL_TEXTURE0);
+
+        // levels of all tiles first, skirts cover the cracks along coarser or finer neighbors
+        const int tileColumns = heightfield.tileColumns(), tileRows = heightfield.tileRows();
+        std::vector<int> levels(gpu.tileBounds.size());
+        for (size_t tile = 0; tile < levels.size(); ++tile)
+            levels[tile] = lodPolicy.select(gpu.tileBounds[tile].transformed(model), camera,
+                                            viewportRows, kTileLevels);
+        const auto error = [&](int tileColumn, int tileRow) {
+            if (tileColumn < 0 || tileColumn >= tileColumns || tileRow < 0 || tileRow >= tileRows)
+                return 0.f;
+            const size_t tile = size_t(tileRow) * tileColumns + tileColumn;
+            return gpu.tileErrors[tile][levels[tile]];
+        };
+
+        for (int tileRow = 0; tileRow < tileRows; ++tileRow) {
+            for (int tileColumn = 0; tileColumn < tileColumns; ++tileColumn) {
+                const size_t tile = size_t(tileRow) * tileColumns + tileColumn;
+                if (!frustum.intersects(gpu.tileBounds[tile].transformed(model)))
+                    continue;
+                const int level = levels[tile];
+                const auto& grid = tileGrid(level, heightfield.flipDiagonals());
+                const float depth =
+                    error(tileColumn, tileRow) +
+                    std::max({error(tileColumn - 1, tileRow), error(tileColumn + 1, tileRow),
+                              error(tileColumn, tileRow - 1), error(tileColumn, tileRow + 1)});
+                glUniform2i(tileOrigin, tileColumn * scene::Heightfield::kTileCells,
+                            tileRow * scene::Heightfield::kTileCells);
+                glUniform1i(tileStep, 1 << level);
+                glUniform1i(tileVertices, (scene::Heightfield::kTileCells >> level) + 3);
+                glUniform1f(skirtDepth, depth);
+                glBindVertexArray(grid.vao);
+                glDrawElementsInstanced(GL_TRIANGLES, grid.indexCount, GL_UNSIGNED_SHORT, nullptr,
+                                        instances);
+            }
+        }
+        glUniform1i(this->heightfield, 0);
+    }
+
+    /**
+     * @brief Array of a bitmap: textures up to kPackedTextureSize share arrays by size, so that
+     * drawing them needs no texture rebinds, larger ones have their own array
+     */
+    static TextureArrayKey arrayKey(const scene::Bitmap& bitmap)
+    {
+        const bool shared =
+            bitmap.rows() <= kPackedTextureSize && bitmap.cols() <= kPackedTextureSize;
+        return TextureArrayKey{bitmap.rows(), bitmap.cols(), bitmap.channels() == 1,
+                               bitmap.compression(), shared ? nullptr : &bitmap};
+    }
+
+    /**
+     * @brief Texture of a bitmap, uploaded into a free layer of its array on first use, and
+     * again over the same layer when its pixels were rewritten in place
+     */
+    const GpuTexture& texture(const std::shared_ptr<scene::Bitmap>& bitmap)
+    {
+        auto it = shared->textures.find(bitmap.get());
+        if (it != shared->textures.end() && it->second.revision != bitmap->revision() &&
+            (it->second.array != arrayKey(*bitmap) || it->second.coarseLevel)) {
+            release(it->second); //<- resized, moves to another array, or streamed again
+            shared->textures.erase(it);
+            it = shared->textures.end();
+        }
+        if (it != shared->textures.end()) {
+            auto& texture = it->second;
+            texture.lastUsed = shared->frame;
+            if (texture.revision != bitmap->revision()) {
+                auto& array = shared->textureArrays.at(texture.array);
+                bindArray(array.texture);
+                uploadLayer(*bitmap, texture.layer);
+                array.mipmaps = std::get<3>(texture.array) != scene::Bitmap::Compression::None;
+                texture.revision = bitmap->revision();
+                ++texelUploads;
+            }
+            return texture;
+        }
+
+        auto& texture = shared->textures[bitmap.get()];
+        texture.bitmap = bitmap;
+        texture.lastUsed = shared->frame;
+        texture.revision = bitmap->revision();
+        texture.array = arrayKey(*bitmap);
+        ++uploads;
+        if (streamBudget && std::get<4>(texture.array)) {
+            // alone in its array, from the coarse level up
+            texture.coarseLevel = std::max(streamedLevels(*bitmap) - 1, 0);
+            while (texture.coarseLevel > 0 &&
+                   std::max(bitmap->levelSize(texture.coarseLevel - 1)[0],
+                            bitmap->levelSize(texture.coarseLevel - 1)[1]) <=
+                       kStreamedTextureSize)
+                --texture.coarseLevel;
+        }
+        if (texture.coarseLevel) {
+            if (bitmap->compression() == scene::Bitmap::Compression::None)
+                texture.mipPixels = downsample(*bitmap);
+            auto& array = shared->textureArrays[texture.array];
+            array.layers.assign(1, bitmap.get());
+            array.used = 1;
+            array.mipmaps = true;
+            uploadLevels(texture, array, texture.coarseLevel);
+            return texture;
+        }
+        texture.bytes = bitmap->compression() != scene::Bitmap::Compression::None
+                            ? bitmap->size()
+                            : size_t(bitmap->rows()) * size_t(bitmap->cols()) * 4 * 4 / 3;
+        addResident(texture.bytes);
+
+        auto& array = shared->textureArrays[texture.array];
+        auto layer = std::find(array.layers.begin(), array.layers.end(), nullptr);
+        if (layer == array.layers.end()) {
+            grow(texture.array, array);
+            layer = std::find(array.layers.begin(), array.layers.end(), nullptr);
+        }
+        *layer = bitmap.get();
+        texture.layer = int(layer - array.layers.begin());
+        ++array.used;
+        array.mipmaps = std::get<3>(texture.array) != scene::Bitmap::Compression::None;
+        bindArray(array.texture);
+        uploadLayer(*bitmap, texture.layer);
+        return texture;
+    }
+
+    /**
+     * @brief Bind the array of a texture, generating its mipmaps if its layers changed
+     */
+    void bind(const GpuTexture& texture)
+    {
+        auto& array = shared->textureArrays.at(texture.array);
+        bindArray(array.texture);
+        if (!array.mipmaps) {
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            array.mipmaps = true;
+        }
+    }
+
+    void bindArray(GLuint texture)
+    {
+        if (texture == shared->boundArray)
+            return;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        shared->boundArray = texture;
+        ++textureBinds;
+    }
+
+    /// twice as many layers, those in use uploaded again from their bitmaps
+    void grow(const TextureArrayKey& key, TextureArray& array)
+    {
+        const GLuint previous = array.texture;
+        const int capacity = std::get<4>(key) ? 1 : std::max(int(array.layers.size()) * 2, 4);
+        const GLsizei rows = GLsizei(std::get<0>(key)), cols = GLsizei(std::get<1>(key));
+        const auto compression = std::get<3>(key);
+        glGenTextures(1, &array.texture);
+        bindArray(array.texture);
+        if (compression != scene::Bitmap::Compression::None) {
+            // every mip level allocated, the blocks of the bitmaps carry them
+            const scene::Bitmap layout({}, Size2i{rows, cols}, compression, 1);
+            int level = 0;
+            for (; level == 0 || layout.levelSize(level - 1) != Size2i{1, 1}; ++level) {
+                const auto size = layout.levelSize(level);
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, compressedFormat(compression),
+                                       size[1], size[0], capacity, 0,
+                                       GLsizei(layout.levelBytes(level) * capacity), nullptr);
+            }
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, level - 1);
+            array.bytes = 0;
+            for (int k = 0; k < level; ++k)
+                array.bytes += layout.levelBytes(k) * capacity;
+        }
+        else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, cols, rows, capacity, 0, GL_RGBA,
+                         GL_UNSIGNED_BYTE, nullptr);
+            array.bytes = size_t(rows) * size_t(cols) * 4 * 4 / 3 * capacity; //<- mipmaps
+        }
+        setSampling(std::get<2>(key));
+        array.layers.resize(capacity, nullptr);
+        for (int layer = 0; layer < capacity; ++layer)
+            if (array.layers[layer])
+                uploadLayer(*array.layers[layer], layer);
+        if (previous)
+            glDeleteTextures(1, &previous);
+    }
+
+    /// swizzle of single channel textures, trilinear filtering and repeat of the bound array
+    static void setSampling(bool singleChannel)
+    {
+        if (singleChannel) {
+            const GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+            glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    }
+
+    /// mip levels of a streamed bitmap, those in its data if compressed, down to 1 x 1 if not
+    static int streamedLevels(const scene::Bitmap& bitmap)
+    {
+        if (bitmap.compression() != scene::Bitmap::Compression::None)
+            return bitmap.levels();
+        int levels = 1;
+        while (bitmap.levelSize(levels - 1) != Size2i{1, 1})
+            ++levels;
+        return levels;
+    }
+
+    /// GPU memory of a mip level of a bitmap, 4 bytes per texel if uncompressed
+    static size_t levelBytes(const scene::Bitmap& bitmap, int level)
+    {
+        if (bitmap.compression() != scene::Bitmap::Compression::None)
+            return bitmap.levelBytes(level);
+        const auto size = bitmap.levelSize(level);
+        return size_t(size[0]) * size_t(size[1]) * 4;
+    }
+
+    /// 2 x 2 box filtered pixels of the levels 1 and up of an uncompressed bitmap
+    static std::vector<std::vector<uint8_t>> downsample(const scene::Bitmap& bitmap)
+    {
+        const ssize_t channels = bitmap.channels();
+        std::vector<std::vector<uint8_t>> levels;
+        const uint8_t* source = bitmap.data();
+        for (int level = 1; level < streamedLevels(bitmap); ++level) {
+            const auto from = bitmap.levelSize(level - 1), to = bitmap.levelSize(level);
+            std::vector<uint8_t> pixels(size_t(to[0]) * size_t(to[1]) * size_t(channels));
+            for (int r = 0; r < to[0]; ++r) {
+                const int r0 = std::min(2 * r, from[0] - 1), r1 = std::min(2 * r + 1, from[0] - 1);
+                for (int c = 0; c < to[1]; ++c) {
+                    const int c0 = std::min(2 * c, from[1] - 1);
+                    const int c1 = std::min(2 * c + 1, from[1] - 1);
+                    for (ssize_t k = 0; k < channels; ++k) {
+                        const auto at = [&](int row, int col) {
+                            return int(source[(size_t(row) * from[1] + col) * channels + k]);
+                        };
+                        pixels[(size_t(r) * to[1] + c) * channels + k] = uint8_t(
+                            (at(r0, c0) + at(r0, c1) + at(r1, c0) + at(r1, c1) + 2) / 4);
+                    }
+                }
+            }
+            levels.push_back(std::move(pixels));
+            source = levels.back().data();
+        }
+        return levels;
+    }
+
+    /**
+     * @brief Replace the array of a streamed texture by one holding its levels from \p finest
+     * down, uploaded again from the bitmap, so that dropped levels free their memory
+     */
+    void uploadLevels(GpuTexture& texture, TextureArray& array, int finest)
+    {
+        const auto& bitmap = *texture.bitmap;
+        const int levels = streamedLevels(bitmap);
+        const GLuint previous = array.texture;
+        glGenTextures(1, &array.texture);
+        bindArray(array.texture);
+        const bool compressed = bitmap.compression() != scene::Bitmap::Compression::None;
+        const GLenum formats[] = {GL_RED, GL_RED, GL_RG, GL_RGB, GL_RGBA};
+        const GLenum format = compressed ? compressedFormat(bitmap.compression())
+                                         : formats[std::min<ssize_t>(bitmap.channels(), 4)];
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        size_t offset = 0, bytes = 0;
+        for (int level = 0; level < levels; ++level) {
+            const auto size = bitmap.levelSize(level);
+            if (level >= finest && compressed)
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level - finest, format, size[1],
+                                       size[0], 1, 0, GLsizei(bitmap.levelBytes(level)),
+                                       bitmap.data() + offset);
+            else if (level >= finest)
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level - finest, GL_RGBA8, size[1], size[0], 1,
+                             0, format, GL_UNSIGNED_BYTE,
+                             level ? texture.mipPixels[level - 1].data() : bitmap.data());
+            if (level >= finest)
+                bytes += levelBytes(bitmap, level);
+            if (compressed)
+                offset += bitmap.levelBytes(level);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1 - finest);
+        setSampling(std::get<2>(texture.array));
+        if (previous)
+            glDeleteTextures(1, &previous);
+        shared->residentBytes -= texture.bytes;
+        addResident(bytes);
+        texture.bytes = array.bytes = bytes;
+        texture.finestLevel = finest;
+    }
+
+    static GLenum compressedFormat(scene::Bitmap::Compression compression)
+    {
+        return compression == scene::Bitmap::Compression::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+                                                               : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    }
+
+    /// upload a bitmap into a layer of the bound array, with all its levels if compressed
+    static void uploadLayer(const scene::Bitmap& bitmap, int layer)
+    {
+        if (bitmap.compression() != scene::Bitmap::Compression::None) {
+            const GLenum format = compressedFormat(bitmap.compression());
+            size_t offset = 0;
+            for (int level = 0; level < bitmap.levels(); ++level) {
+                const auto size = bitmap.levelSize(level);
+                const size_t bytes = bitmap.levelBytes(level);
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, size[1],
+                                          size[0], 1, format, GLsizei(bytes),
+                                          bitmap.data() + offset);
+                offset += bytes;
+            }
+            return;
+        }
+        const GLenum formats[] = {GL_RED, GL_RED, GL_RG, GL_RGB, GL_RGBA};
+        const GLenum format = formats[std::min<ssize_t>(bitmap.channels(), 4)];
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, GLsizei(bitmap.cols()),
+                        GLsizei(bitmap.rows()), 1, format, GL_UNSIGNED_BYTE,
+                        bitmap.data());
+    }
+
+    void resize(int newCols, int newRows)
+    {
+        if (framebuffer && cols == newCols && rows == newRows)
+            return;
+        if (!framebuffer) {
+            glGenFramebuffers(1, &framebuffer);
+            glGenRenderbuffers(4, renderbuffers);
+        }
+        cols = newCols;
+        rows = newRows;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        const GLenum formats[] = {GL_RGBA8, GL_R32I, GL_R32F, GL_DEPTH_COMPONENT24};
+        const GLenum attachments[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                      GL_COLOR_ATTACHMENT2, GL_DEPTH_ATTACHMENT};
+        for (int i = 0; i < 4; ++i) {
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[i]);
+            glRenderbufferStorage(GL_RENDERBUFFER, formats[i], cols, rows);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachments[i], GL_RENDERBUFFER,
+                                      renderbuffers[i]);
+        }
+        if (pointRenderbuffer) {
+            glBindRenderbuffer(GL_RENDERBUFFER, pointRenderbuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA32F, cols, rows);
+        }
+        if (shortRenderbuffer) {
+            glBindRenderbuffer(GL_RENDERBUFFER, shortRenderbuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RG16UI, cols, rows);
+        }
+        if (motionRenderbuffer) {
+            glBindRenderbuffer(GL_RENDERBUFFER, motionRenderbuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RG16F, cols, rows);
+        }
+        if (normalRenderbuffer) {
+            glBindRenderbuffer(GL_RENDERBUFFER, normalRenderbuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA16F, cols, rows);
+        }
+        const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                      GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, drawBuffers);
+        pointOutput = false;
+        shortOutput = false;
+        motionOutput = false;
+        normalOutput = false;
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            throw std::runtime_error("EGLRenderer: incomplete framebuffer");
+    }
+
+    /**
+     * @brief Draw the points of the next views into a fourth target, their 16-bit depth and mask
+     * into a fifth one, their motion into a sixth one and their normals into a seventh one, each
+     * allocated at first use
+     */
+    void setExtraOutputs(bool points, bool shorts, bool motion, bool normals)
+    {
+        if (points == pointOutput && shorts == shortOutput && motion == motionOutput &&
+            normals == normalOutput)
+            return;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        if (points && !pointRenderbuffer)
+            pointRenderbuffer = attachRenderbuffer(GL_COLOR_ATTACHMENT3, GL_RGBA32F);
+        if (shorts && !shortRenderbuffer)
+            shortRenderbuffer = attachRenderbuffer(GL_COLOR_ATTACHMENT4, GL_RG16UI);
+        if (motion && !motionRenderbuffer)
+            motionRenderbuffer = attachRenderbuffer(GL_COLOR_ATTACHMENT5, GL_RG16F);
+        // three half floats are not renderable everywhere, the fourth is not read
+        if (normals && !normalRenderbuffer)
+            normalRenderbuffer = attachRenderbuffer(GL_COLOR_ATTACHMENT6, GL_RGBA16F);
+        const GLenum none = GL_NONE;
+        const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                      GL_COLOR_ATTACHMENT2, points ? GL_COLOR_ATTACHMENT3 : none,
+                                      shorts ? GL_COLOR_ATTACHMENT4 : none,
+                                      motion ? GL_COLOR_ATTACHMENT5 : none,
+                                      normals ? GL_COLOR_ATTACHMENT6 : none};
+        glDrawBuffers(7, drawBuffers);
+        pointOutput = points;
+        shortOutput = shorts;
+        motionOutput = motion;
+        normalOutput = normals;
+    }
+
+    /// renderbuffer of the frame size attached to the bound framebuffer
+    GLuint attachRenderbuffer(GLenum attachment, GLenum format) const
+    {
+        GLuint renderbuffer;
+        glGenRenderbuffers(1, &renderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, format, cols, rows);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, renderbuffer);
+        return renderbuffer;
+    }
+
+    /**
+     * @brief Read the color, mask and metric depth attachments of the bound framebuffer into the
+     * planes requested, flipping rows to store the top row first
+     */
+    static void readImages(int cols, int rows, uint8_t* color, int* mask, float* depth)
+    {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        const auto flip = [rows](auto* data, size_t rowSize) { flipRows(data, rows, rowSize); };
+        if (color) {
+            glReadBuffer(GL_COLOR_ATTACHMENT0);
+            glReadPixels(0, 0, cols, rows, GL_RGBA, GL_UNSIGNED_BYTE, color);
+            flip(color, size_t(cols) * 4);
+        }
+        if (mask) {
+            glReadBuffer(GL_COLOR_ATTACHMENT1);
+            glReadPixels(0, 0, cols, rows, GL_RED_INTEGER, GL_INT, mask);
+            flip(mask, size_t(cols));
+        }
+        if (depth) {
+            // metric depth written by the fragment shader, zero for the background
+            glReadBuffer(GL_COLOR_ATTACHMENT2);
+            glReadPixels(0, 0, cols, rows, GL_RED, GL_FLOAT, depth);
+            flip(depth, size_t(cols));
+        }
+    }
+
+    /**
+     * @brief Read the XYZ points of the bound framebuffer, top row first
+     */
+    static void readPoints(int cols, int rows, float* points)
+    {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadBuffer(GL_COLOR_ATTACHMENT3);
+        glReadPixels(0, 0, cols, rows, GL_RGB, GL_FLOAT, points);
+        flipRows(points, rows, size_t(cols) * 3);
+    }
+
+    /**
+     * @brief Read the motion of the bound framebuffer as half floats, top row first
+     */
+    static void readMotion(int cols, int rows, uint16_t* motion)
+    {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadBuffer(GL_COLOR_ATTACHMENT5);
+        glReadPixels(0, 0, cols, rows, GL_RG, GL_HALF_FLOAT, motion);
+        flipRows(motion, rows, size_t(cols) * 2);
+    }
+
+    /**
+     * @brief Read the camera frame normals of the bound framebuffer as half floats, top row first
+     */
+    static void readNormals(int cols, int rows, uint16_t* normals)
+    {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadBuffer(GL_COLOR_ATTACHMENT6);
+        glReadPixels(0, 0, cols, rows, GL_RGB, GL_HALF_FLOAT, normals);
+        flipRows(normals, rows, size_t(cols) * 3);
+    }
+
+    /**
+     * @brief Read the planes of reduced formats of the bound framebuffer, converted by the GPU,
+     * 16-bit depth and masks in the shader, RGB colors and half floats at readback
+     */
+    static void readPackedImages(const scene::SceneView& sceneView, const FrameData& frame)
+    {
+        const int cols = frame.cols, rows = frame.rows;
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        if (frame.packedColor) {
+            glReadBuffer(GL_COLOR_ATTACHMENT0);
+            glReadPixels(0, 0, cols, rows, GL_RGB, GL_UNSIGNED_BYTE, frame.packedColor);
+            flipRows(frame.packedColor, rows, size_t(cols) * 3);
+        }
+        if (frame.packedDepth) {
+            const bool half = sceneView.depthFormat() == scene::DepthFormat::Float16;
+            glReadBuffer(half ? GL_COLOR_ATTACHMENT2 : GL_COLOR_ATTACHMENT4);
+            glReadPixels(0, 0, cols, rows, half ? GL_RED : GL_RED_INTEGER,
+                         half ? GL_HALF_FLOAT : GL_UNSIGNED_SHORT, frame.packedDepth);
+            flipRows(frame.packedDepth, rows, size_t(cols));
+        }
+        if (frame.packedMask) {
+            glReadBuffer(GL_COLOR_ATTACHMENT4);
+            glReadPixels(0, 0, cols, rows, GL_GREEN_INTEGER, GL_UNSIGNED_SHORT, frame.packedMask);
+            flipRows(frame.packedMask, rows, size_t(cols));
+        }
+    }
+
+    template <class T>
+    static void flipRows(T* data, int rows, size_t rowSize)
+    {
+        for (int i = 0; i < rows / 2; ++i)
+            std::swap_ranges(data + i * rowSize, data + (i + 1) * rowSize,
+                             data + (rows - 1 - i) * rowSize);
+    }
+
+    /**
+     * @brief Reduce the metric depth target into the levels 1 to \p last of the depth reduction,
+     * the finest level being a copy of it
+     *
+     * Levels are allocated down to a single texel when the frame size changes. Leaves the
+     * reduction framebuffer bound with the depth test disabled.
+     */
+    void reduceLevels(int last)
+    {
+        auto& r = reduction;
+        if (!r.program) {
+            r.program = linkProgram(kReduceVertexShader, kReduceFragmentShader);
+            r.source = glGetUniformLocation(r.program, "source");
+            r.finest = glGetUniformLocation(r.program, "finest");
+            glGenVertexArrays(1, &r.vao);
+            glGenFramebuffers(1, &r.framebuffer);
+        }
+        if (r.cols != cols || r.rows != rows) {
+            if (r.texture)
+                glDeleteTextures(1, &r.texture);
+            r.cols = cols;
+            r.rows = rows;
+            r.shift = 0;
+            while (depthLevelSize(std::max(cols, rows), r.shift) > kOcclusionSize)
+                ++r.shift;
+            r.levels = 0;
+            while (depthLevelSize(std::max(cols, rows), r.levels) > 1)
+                ++r.levels;
+            glGenTextures(1, &r.texture);
+            glBindTexture(GL_TEXTURE_2D, r.texture);
+            r.bytes = 0;
+            for (int level = 0; level <= r.levels; ++level) {
+                const int w = depthLevelSize(cols, level), h = depthLevelSize(rows, level);
+                glTexImage2D(GL_TEXTURE_2D, level, GL_RG32F, w, h, 0, GL_RG, GL_FLOAT, nullptr);
+                r.bytes += size_t(w) * size_t(h) * 8;
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glReadBuffer(GL_COLOR_ATTACHMENT2);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, r.framebuffer);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               r.texture, 0);
+        glBlitFramebuffer(0, 0, cols, rows, 0, 0, cols, rows, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        glDisable(GL_DEPTH_TEST);
+        glUseProgram(r.program);
+        glUniform1i(r.source, 2);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, r.texture);
+        glBindVertexArray(r.vao);
+        for (int level = 1; level <= last; ++level) {
+            // the level below is the only one sampled, never the one drawn
+            glUniform1i(r.finest, level == 1 ? 1 : 0);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                   r.texture, level);
+            glViewport(0, 0, depthLevelSize(cols, level), depthLevelSize(rows, level));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, r.levels);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    /**
+     * @brief Build a depth pyramid from the metric depth drawn so far
+     *
+     * The metric depth target is reduced by reduceLevels() down to at most kOcclusionSize texels
+     * a side, each texel keeping the farthest depth under it, then read back into \p pyramid,
+     * whose coarser levels are reduced on the CPU. Reading back waits for the draws issued so
+     * far. Leaves the framebuffer drawn into bound, with its viewport, program and depth test.
+     */
+    void reduceDepth(scene::DepthPyramid& pyramid)
+    {
+        if (multisampling.samples)
+            resolveSamples();
+        reduceLevels(reduction.shift);
+        auto& r = reduction;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, r.framebuffer);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        const int w = depthLevelSize(cols, r.shift), h = depthLevelSize(rows, r.shift);
+        float* depths = pyramid.reset(cols, rows, r.shift);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        if (r.shift == 0) {
+            // not reduced on the GPU, background still zero
+            glReadPixels(0, 0, w, h, GL_RED, GL_FLOAT, depths);
+            for (int i = 0; i < w * h; ++i)
+                if (!(depths[i] > 0.f))
+                    depths[i] = std::numeric_limits<float>::infinity();
+        }
+        else {
+            glReadPixels(0, 0, w, h, GL_GREEN, GL_FLOAT, depths);
+        }
+        pyramid.build();
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target());
+        glViewport(0, 0, cols, rows);
+        glEnable(GL_DEPTH_TEST);
+        glUseProgram(program);
+    }
+
+    /**
+     * @brief Read the levels 1 to \p levels reduced by reduceLevels() into the packed pyramid
+     * of the DepthPyramid channel, top row first, see render::depthLevelOffset()
+     *
+     * Leaves the framebuffer of the frame bound.
+     */
+    void readDepthLevels(int levels, float* pyramid)
+    {
+        auto& r = reduction;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, r.framebuffer);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        for (int level = 1; level <= levels; ++level) {
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                   r.texture, level);
+            const int w = depthLevelSize(cols, level), h = depthLevelSize(rows, level);
+            float* data = pyramid + depthLevelOffset(cols, rows, level);
+            glReadPixels(0, 0, w, h, GL_RG, GL_FLOAT, data);
+            flipRows(data, h, size_t(w) * 2);
+            for (size_t i = 0; i < size_t(w) * size_t(h) * 2; ++i)
+                if (data[i] >= 3.0e38f)
+                    data[i] = std::numeric_limits<float>::infinity();
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+
+    /**
+     * @brief Compare the color target with the reference of camera \p handle and read back the
+     * events since its previous frame into \p output, top row first, see render::EventCamera
+     *
+     * References are created, and created again when the frame size changes, by a frame only
+     * setting them. Events are written by the compute shader in no particular order, only those
+     * written being read back. Leaves the framebuffer of the frame bound.
+     *
+     * @param handle - camera handle, -1 for unregistered cameras
+     * @param time - time of the frame, seconds
+     * @param threshold - change of log luminance per event
+     * @param output - room for an event of 4 floats per pixel
+     * @return Number of events
+     */
+    int findEvents(int handle, double time, float threshold, float* output)
+    {
+        auto& e = events;
+        if (!e.program) {
+            e.program = linkComputeProgram(kEventComputeShader);
+            e.size = glGetUniformLocation(e.program, "size");
+            e.threshold = glGetUniformLocation(e.program, "threshold");
+            e.capacity = glGetUniformLocation(e.program, "capacity");
+            e.first = glGetUniformLocation(e.program, "first");
+            glUseProgram(e.program);
+            glUniform1i(glGetUniformLocation(e.program, "colors"), 4);
+            glGenBuffers(1, &e.buffer);
+        }
+        const size_t pixels = size_t(cols) * size_t(rows);
+        if (e.cols != cols || e.rows != rows) {
+            if (e.colors)
+                glDeleteTextures(1, &e.colors);
+            glGenTextures(1, &e.colors);
+            glBindTexture(GL_TEXTURE_2D, e.colors);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, cols, rows);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, e.buffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(16 + pixels * 16), nullptr,
+                         GL_DYNAMIC_READ);
+            e.cols = cols;
+            e.rows = rows;
+        }
+        auto& r = e.references[handle];
+        const bool first = r.cols != cols || r.rows != rows;
+        if (first) {
+            if (r.texture)
+                glDeleteTextures(1, &r.texture);
+            glGenTextures(1, &r.texture);
+            glBindTexture(GL_TEXTURE_2D, r.texture);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, cols, rows);
+            r.cols = cols;
+            r.rows = rows;
+        }
+        e.bytes = 16 + pixels * 20;
+        for (const auto& it : e.references)
+            e.bytes += size_t(it.second.cols) * size_t(it.second.rows) * 4;
+
+        glCopyImageSubData(renderbuffers[0], GL_RENDERBUFFER, 0, 0, 0, 0, e.colors,
+                           GL_TEXTURE_2D, 0, 0, 0, 0, cols, rows, 1);
+        const GLuint counters[4] = {0, 0, 0, 0};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, e.buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, e.buffer);
+        glBindImageTexture(0, r.texture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, e.colors);
+        glUseProgram(e.program);
+        glUniform2i(e.size, cols, rows);
+        glUniform1f(e.threshold, threshold);
+        glUniform1ui(e.capacity, GLuint(pixels));
+        glUniform1i(e.first, first ? 1 : 0);
+        glDispatchCompute(GLuint(cols + 7) / 8, GLuint(rows + 7) / 8, 1);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        // counters first, then only the events written
+        GLuint written[2] = {0, 0};
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(written), written);
+        const size_t count = first ? 0 : std::min<size_t>(written[1], pixels);
+        if (count)
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 16, GLsizeiptr(count * 16), output);
+        const double span = time - r.time;
+        for (size_t i = 0; i < count; ++i) {
+            float* event = output + i * 4;
+            event[1] = float(rows - 1) - event[1];
+            event[2] = float(r.time + span * event[2]);
+        }
+        r.time = time;
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glUseProgram(program);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        return int(count);
+    }
+
+    /**
+     * @brief Count the pixels of the mask target of each of \p ids into \p output, as
+     * render::countMaskPixels() would, without reading the mask back
+     *
+     * Only the counters are read back. Leaves the framebuffer of the frame bound.
+     *
+     * @param ids - increasing segmentation ids, e.g. those of the shapes in view
+     * @param output - room for a pair of ints per id
+     * @param boxes - room for 4 ints per id, the bounds of the pixels, null to skip them
+     * @return Number of pairs written, -1 if pixels of ids not listed were drawn
+     */
+    int countPixels(const std::vector<int>& ids, int* output, int* boxes)
+    {
+        auto& c = pixelCounts;
+        if (!c.program) {
+            c.program = linkComputeProgram(kPixelCountComputeShader);
+            c.size = glGetUniformLocation(c.program, "size");
+            c.idCount = glGetUniformLocation(c.program, "idCount");
+            c.boxes = glGetUniformLocation(c.program, "boxes");
+            glUseProgram(c.program);
+            glUniform1i(glGetUniformLocation(c.program, "mask"), 4);
+            glGenBuffers(1, &c.counts);
+            glGenBuffers(1, &c.ids);
+        }
+        if (c.cols != cols || c.rows != rows) {
+            if (c.mask)
+                glDeleteTextures(1, &c.mask);
+            glGenTextures(1, &c.mask);
+            glBindTexture(GL_TEXTURE_2D, c.mask);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32I, cols, rows);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            c.cols = cols;
+            c.rows = rows;
+        }
+        // buffers grow with the ids in view
+        if (c.capacity < std::max<size_t>(ids.size(), 1)) {
+            c.capacity = std::max({ids.size(), c.capacity * 2, size_t(64)});
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, c.counts);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(16 + c.capacity * 20), nullptr,
+                         GL_DYNAMIC_READ);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, c.ids);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(c.capacity * 4), nullptr,
+                         GL_DYNAMIC_DRAW);
+        }
+        c.bytes = size_t(cols) * size_t(rows) * 4 + 16 + c.capacity * 24;
+
+        glCopyImageSubData(renderbuffers[1], GL_RENDERBUFFER, 0, 0, 0, 0, c.mask, GL_TEXTURE_2D,
+                           0, 0, 0, 0, cols, rows, 1);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, c.ids);
+        if (!ids.empty())
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, GLsizeiptr(ids.size() * 4), ids.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, c.counts);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                          nullptr);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, c.counts);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, c.ids);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, c.mask);
+        glUseProgram(c.program);
+        glUniform2i(c.size, cols, rows);
+        glUniform1i(c.idCount, GLint(ids.size()));
+        glUniform1i(c.boxes, boxes != nullptr);
+        glDispatchCompute(GLuint(cols + 7) / 8, GLuint(rows + 7) / 8, 1);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        // missed pixels, then the ids seen in order
+        c.readback.resize(4 + ids.size() * 5);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, GLsizeiptr(c.readback.size() * 4),
+                           c.readback.data());
+        int count = -1;
+        if (!c.readback[0]) {
+            count = 0;
+            for (size_t i = 0; i < ids.size(); ++i) {
+                const GLuint* counters = c.readback.data() + 4 + i * 5;
+                if (!counters[0])
+                    continue;
+                output[count * 2] = ids[i];
+                output[count * 2 + 1] = int(counters[0]);
+                if (boxes) {
+                    int* box = boxes + count * 4;
+                    box[0] = cols - 1 - int(counters[1]);
+                    box[1] = rows - 1 - int(counters[3]);
+                    box[2] = int(counters[2]);
+                    box[3] = int(counters[4]);
+                }
+                ++count;
+            }
+        }
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glUseProgram(program);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        return count;
+    }
+
+    /**
+     * @brief Bind a shadow map as the target of a depth pass
+     *
+     * Maps are created at the first pass or when their size changes. Depth is cleared unless
+     * the map of all casters starts from a copy of the static one.
+     *
+     * @param index - 0 for the static casters, 1 for all casters
+     * @param size - texels a side
+     * @param copyStatic - start the map of all casters from the static casters
+     */
+    void beginShadowPass(int index, int size, bool copyStatic)
+    {
+        auto& maps = shadows;
+        if (maps.size != size) {
+            if (maps.textures[0]) {
+                glDeleteTextures(2, maps.textures);
+                glDeleteFramebuffers(2, maps.framebuffers);
+            }
+            glGenTextures(2, maps.textures);
+            glGenFramebuffers(2, maps.framebuffers);
+            for (int i = 0; i < 2; ++i) {
+                glBindTexture(GL_TEXTURE_2D, maps.textures[i]);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, size, size, 0,
+                             GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE,
+                                GL_COMPARE_REF_TO_TEXTURE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+                glBindFramebuffer(GL_FRAMEBUFFER, maps.framebuffers[i]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                                       maps.textures[i], 0);
+                glDrawBuffer(GL_NONE);
+                glReadBuffer(GL_NONE);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+            maps.size = size;
+            maps.bytes = size_t(size) * size_t(size) * 8;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, maps.framebuffers[index]);
+        glViewport(0, 0, size, size);
+        if (copyStatic) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, maps.framebuffers[0]);
+            glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT,
+                              GL_NEAREST);
+        }
+        else {
+            glClear(GL_DEPTH_BUFFER_BIT);
+        }
+        // depth is offset along slopes against self shadowing
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.f, 4.f);
+    }
+
+    void release(EventTargets& e)
+    {
+        if (e.program) {
+            glDeleteProgram(e.program);
+            glDeleteBuffers(1, &e.buffer);
+        }
+        if (e.colors)
+            glDeleteTextures(1, &e.colors);
+        for (const auto& it : e.references)
+            glDeleteTextures(1, &it.second.texture);
+        e = EventTargets();
+    }
+
+    void release(PixelCountTargets& c)
+    {
+        if (c.program) {
+            glDeleteProgram(c.program);
+            glDeleteBuffers(1, &c.counts);
+            glDeleteBuffers(1, &c.ids);
+        }
+        if (c.mask)
+            glDeleteTextures(1, &c.mask);
+        c = PixelCountTargets();
+    }
+
+    void release(ShadowMaps& maps)
+    {
+        if (maps.textures[0]) {
+            glDeleteTextures(2, maps.textures);
+            glDeleteFramebuffers(2, maps.framebuffers);
+        }
+        maps = ShadowMaps();
+    }
+
+    void release(DepthReduction& r)
+    {
+        if (r.texture)
+            glDeleteTextures(1, &r.texture);
+        if (r.framebuffer)
+            glDeleteFramebuffers(1, &r.framebuffer);
+        if (r.vao)
+            glDeleteVertexArrays(1, &r.vao);
+        if (r.program)
+            glDeleteProgram(r.program);
+        r = DepthReduction();
+    }
+
+    /**
+     * @brief Copy the color, mask and metric depth drawn for a cubemap face into its layer of
+     * the face arrays, created at the size of the frame targets
+     */
+    void storeFace(int face)
+    {
+        auto& p = panorama;
+        if (p.size != cols) {
+            if (p.faces[0])
+                glDeleteTextures(3, p.faces);
+            glGenTextures(3, p.faces);
+            const GLenum formats[] = {GL_RGBA8, GL_R32I, GL_R32F};
+            const GLenum layouts[] = {GL_RGBA, GL_RED_INTEGER, GL_RED};
+            const GLenum types[] = {GL_UNSIGNED_BYTE, GL_INT, GL_FLOAT};
+            for (int i = 0; i < 3; ++i) {
+                glBindTexture(GL_TEXTURE_2D_ARRAY, p.faces[i]);
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, formats[i], cols, cols, 6, 0, layouts[i],
+                             types[i], nullptr);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            }
+            p.size = cols;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        for (int i = 0; i < 3; ++i) {
+            glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, p.faces[i]);
+            glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, face, 0, 0, cols, cols);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        p.bytes = size_t(p.size) * size_t(p.size) * 72 + size_t(p.cols) * size_t(p.rows) * 12;
+    }
+
+    /**
+     * @brief Draw the equirectangular image of \p imageCols x \p imageRows pixels from the
+     * stored faces
+     *
+     * Leaves the framebuffer of the image bound, bottom row first, with the program and depth
+     * test of the frame.
+     */
+    void reprojectPanorama(int imageCols, int imageRows)
+    {
+        auto& p = panorama;
+        if (!p.program) {
+            p.program = linkProgram(kReduceVertexShader, kPanoramaFragmentShader);
+            p.colors = glGetUniformLocation(p.program, "colors");
+            p.masks = glGetUniformLocation(p.program, "masks");
+            p.depths = glGetUniformLocation(p.program, "depths");
+            p.imageSize = glGetUniformLocation(p.program, "imageSize");
+            p.faceSize = glGetUniformLocation(p.program, "faceSize");
+            glGenVertexArrays(1, &p.vao);
+            glGenFramebuffers(1, &p.framebuffer);
+            glGenRenderbuffers(3, p.renderbuffers);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, p.framebuffer);
+        if (p.cols != imageCols || p.rows != imageRows) {
+            p.cols = imageCols;
+            p.rows = imageRows;
+            const GLenum formats[] = {GL_RGBA8, GL_R32I, GL_R32F};
+            for (int i = 0; i < 3; ++i) {
+                glBindRenderbuffer(GL_RENDERBUFFER, p.renderbuffers[i]);
+                glRenderbufferStorage(GL_RENDERBUFFER, formats[i], p.cols, p.rows);
+                glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
+                                          GL_RENDERBUFFER, p.renderbuffers[i]);
+            }
+            const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                          GL_COLOR_ATTACHMENT2};
+            glDrawBuffers(3, drawBuffers);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                throw std::runtime_error("EGLRenderer: incomplete panorama framebuffer");
+            p.bytes =
+                size_t(p.size) * size_t(p.size) * 72 + size_t(p.cols) * size_t(p.rows) * 12;
+        }
+
+        glViewport(0, 0, p.cols, p.rows);
+        glDisable(GL_DEPTH_TEST);
+        glUseProgram(p.program);
+        glUniform2f(p.imageSize, float(p.cols), float(p.rows));
+        glUniform1i(p.faceSize, p.size);
+        // above the units of the frame: texture arrays, heights and shadow map
+        const GLint units[] = {p.colors, p.masks, p.depths};
+        for (int i = 0; i < 3; ++i) {
+            glUniform1i(units[i], 4 + i);
+            glActiveTexture(GL_TEXTURE4 + i);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, p.faces[i]);
+        }
+        glBindVertexArray(p.vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        for (int i = 0; i < 3; ++i) {
+            glActiveTexture(GL_TEXTURE4 + i);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glEnable(GL_DEPTH_TEST);
+        glUseProgram(program);
+    }
+
+    void release(PanoramaTarget& p)
+    {
+        if (p.faces[0])
+            glDeleteTextures(3, p.faces);
+        if (p.framebuffer) {
+            glDeleteFramebuffers(1, &p.framebuffer);
+            glDeleteRenderbuffers(3, p.renderbuffers);
+        }
+        if (p.vao)
+            glDeleteVertexArrays(1, &p.vao);
+        if (p.program)
+            glDeleteProgram(p.program);
+        p = PanoramaTarget();
+    }
+
+    /**
+     * @brief Draw the image of \p imageCols x \p imageRows pixels resampled from the frame
+     * targets, copied into textures of their size, or remapped through the lens map \p lens of
+     * the camera of handle \p handle, its lookup texture uploaded once
+     *
+     * Leaves the framebuffer of the image bound, bottom row first, with the program and depth
+     * test of the frame.
+     */
+    void resampleFrame(int imageCols, int imageRows, const LensMap* lens = nullptr,
+                       int handle = -1)
+    {
+        auto& s = scaled;
+        if (!s.program) {
+            s.program = linkProgram(kReduceVertexShader, kResampleFragmentShader);
+            s.colors = glGetUniformLocation(s.program, "colors");
+            s.masks = glGetUniformLocation(s.program, "masks");
+            s.depths = glGetUniformLocation(s.program, "depths");
+            s.imageSize = glGetUniformLocation(s.program, "imageSize");
+            glGenVertexArrays(1, &s.vao);
+            glGenTextures(3, s.textures);
+            glGenFramebuffers(1, &s.framebuffer);
+            glGenRenderbuffers(3, s.renderbuffers);
+        }
+        if (lens && !s.lensProgram) {
+            s.lensProgram = linkProgram(kReduceVertexShader, kLensFragmentShader);
+            s.lensColors = glGetUniformLocation(s.lensProgram, "colors");
+            s.lensMasks = glGetUniformLocation(s.lensProgram, "masks");
+            s.lensDepths = glGetUniformLocation(s.lensProgram, "depths");
+            s.lensCoords = glGetUniformLocation(s.lensProgram, "lens");
+        }
+        if (lens) {
+            auto& t = s.lenses[handle];
+            if (t.revision != lens->revision) {
+                // pixel coordinates of the rows top first to texture ones of the frame targets
+                std::vector<float> coords(lens->coords.size());
+                for (int row = 0; row < lens->rows; ++row) {
+                    const float* src = lens->coords.data() + size_t(row) * lens->cols * 2;
+                    float* dst = coords.data() + size_t(lens->rows - 1 - row) * lens->cols * 2;
+                    for (int col = 0; col < lens->cols; ++col) {
+                        const bool seen = src[col * 2] >= 0.f;
+                        dst[col * 2] = seen ? src[col * 2] / lens->sourceCols : -1.f;
+                        dst[col * 2 + 1] = seen ? 1.f - src[col * 2 + 1] / lens->sourceRows : -1.f;
+                    }
+                }
+                if (!t.texture)
+                    glGenTextures(1, &t.texture);
+                glBindTexture(GL_TEXTURE_2D, t.texture);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, lens->cols, lens->rows, 0, GL_RG,
+                             GL_FLOAT, coords.data());
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                glBindTexture(GL_TEXTURE_2D, 0);
+                t.revision = lens->revision;
+                t.cols = lens->cols;
+                t.rows = lens->rows;
+            }
+        }
+        const GLenum formats[] = {GL_RGBA8, GL_R32I, GL_R32F};
+        if (s.sourceCols != cols || s.sourceRows != rows) {
+            const GLenum layouts[] = {GL_RGBA, GL_RED_INTEGER, GL_RED};
+            const GLenum types[] = {GL_UNSIGNED_BYTE, GL_INT, GL_FLOAT};
+            for (int i = 0; i < 3; ++i) {
+                glBindTexture(GL_TEXTURE_2D, s.textures[i]);
+                glTexImage2D(GL_TEXTURE_2D, 0, formats[i], cols, rows, 0, layouts[i], types[i],
+                             nullptr);
+                const GLint filter = i == 0 ? GL_LINEAR : GL_NEAREST;
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            }
+            s.sourceCols = cols;
+            s.sourceRows = rows;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        for (int i = 0; i < 3; ++i) {
+            glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+            glBindTexture(GL_TEXTURE_2D, s.textures[i]);
+            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, cols, rows);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, s.framebuffer);
+        if (s.cols != imageCols || s.rows != imageRows) {
+            s.cols = imageCols;
+            s.rows = imageRows;
+            for (int i = 0; i < 3; ++i) {
+                glBindRenderbuffer(GL_RENDERBUFFER, s.renderbuffers[i]);
+                glRenderbufferStorage(GL_RENDERBUFFER, formats[i], s.cols, s.rows);
+                glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
+                                          GL_RENDERBUFFER, s.renderbuffers[i]);
+            }
+            const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                          GL_COLOR_ATTACHMENT2};
+            glDrawBuffers(3, drawBuffers);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                throw std::runtime_error("EGLRenderer: incomplete resampling framebuffer");
+        }
+        s.bytes =
+            (size_t(s.sourceCols) * size_t(s.sourceRows) + size_t(s.cols) * size_t(s.rows)) * 12;
+        for (const auto& it : s.lenses)
+            s.bytes += size_t(it.second.cols) * size_t(it.second.rows) * 8;
+
+        glViewport(0, 0, s.cols, s.rows);
+        glDisable(GL_DEPTH_TEST);
+        glUseProgram(lens ? s.lensProgram : s.program);
+        if (!lens)
+            glUniform2f(s.imageSize, float(s.cols), float(s.rows));
+        // above the units of the frame: texture arrays, heights and shadow map
+        const GLint units[] = {lens ? s.lensColors : s.colors, lens ? s.lensMasks : s.masks,
+                               lens ? s.lensDepths : s.depths, s.lensCoords};
+        const GLuint textures[] = {s.textures[0], s.textures[1], s.textures[2],
+                                   lens ? s.lenses[handle].texture : 0};
+        const int numUnits = lens ? 4 : 3;
+        for (int i = 0; i < numUnits; ++i) {
+            glUniform1i(units[i], 4 + i);
+            glActiveTexture(GL_TEXTURE4 + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+        }
+        glBindVertexArray(s.vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        for (int i = 0; i < numUnits; ++i) {
+            glActiveTexture(GL_TEXTURE4 + i);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glEnable(GL_DEPTH_TEST);
+        glUseProgram(program);
+    }
+
+    void release(ScaledTarget& s)
+    {
+        if (s.program) {
+            glDeleteTextures(3, s.textures);
+            glDeleteFramebuffers(1, &s.framebuffer);
+            glDeleteRenderbuffers(3, s.renderbuffers);
+            glDeleteVertexArrays(1, &s.vao);
+            glDeleteProgram(s.program);
+        }
+        if (s.lensProgram)
+            glDeleteProgram(s.lensProgram);
+        for (const auto& it : s.lenses)
+            glDeleteTextures(1, &it.second.texture);
+        s = ScaledTarget();
+    }
+
+    /**
+     * @brief Draw the next views with \p samples per pixel, clamped to those supported, into
+     * multisampled targets of the frame size if more than one, created at the first use of each
+     * sample count
+     */
+    void setSamples(int samples)
+    {
+        auto& m = multisampling;
+        if (samples > 1 && !m.maxSamples) {
+            GLint limits[3] = {0, 0, 0};
+            glGetIntegerv(GL_MAX_SAMPLES, &limits[0]);
+            glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &limits[1]);
+            glGetIntegerv(GL_MAX_INTEGER_SAMPLES, &limits[2]);
+            m.maxSamples = std::max(1, *std::min_element(limits, limits + 3));
+        }
+        m.samples = std::min(samples, m.maxSamples) > 1 ? std::min(samples, m.maxSamples) : 0;
+        if (!m.samples)
+            return;
+        auto& t = m.targets[m.samples];
+        if (t.framebuffer && t.cols == cols && t.rows == rows)
+            return;
+        if (!t.framebuffer) {
+            glGenFramebuffers(1, &t.framebuffer);
+            glGenRenderbuffers(2, t.renderbuffers);
+            glGenTextures(2, t.textures);
+        }
+        t.cols = cols;
+        t.rows = rows;
+        glBindFramebuffer(GL_FRAMEBUFFER, t.framebuffer);
+        const GLenum formats[] = {GL_RGBA8, GL_DEPTH_COMPONENT24};
+        const GLenum attachments[] = {GL_COLOR_ATTACHMENT0, GL_DEPTH_ATTACHMENT};
+        for (int i = 0; i < 2; ++i) {
+            glBindRenderbuffer(GL_RENDERBUFFER, t.renderbuffers[i]);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, m.samples, formats[i], cols, rows);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachments[i], GL_RENDERBUFFER,
+                                      t.renderbuffers[i]);
+        }
+        const GLenum textureFormats[] = {GL_R32I, GL_R32F};
+        for (int i = 0; i < 2; ++i) {
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, t.textures[i]);
+            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, m.samples, textureFormats[i], cols,
+                                    rows, GL_TRUE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1 + i,
+                                   GL_TEXTURE_2D_MULTISAMPLE, t.textures[i], 0);
+        }
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+        const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                      GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            throw std::runtime_error("EGLRenderer: incomplete multisampled framebuffer");
+        m.bytes = 0;
+        for (const auto& it : m.targets)
+            m.bytes += size_t(it.second.cols) * size_t(it.second.rows) * 16 * size_t(it.first);
+    }
+
+    /// framebuffer the current view is drawn into
+    GLuint target() const
+    {
+        return multisampling.samples ? multisampling.targets.at(multisampling.samples).framebuffer
+                                     : framebuffer;
+    }
+
+    /**
+     * @brief Resolve the multisampled targets into the frame targets, the color averaged over
+     * the samples of each pixel, the mask and metric depth of its first sample so that edges
+     * keep values of the shapes drawn
+     *
+     * Leaves the framebuffer of the frame bound, with the program and depth test of the frame.
+     */
+    void resolveSamples()
+    {
+        auto& m = multisampling;
+        const auto& t = m.targets.at(m.samples);
+        if (!m.program) {
+            m.program = linkProgram(kReduceVertexShader, kResolveFragmentShader);
+            m.masks = glGetUniformLocation(m.program, "masks");
+            m.depths = glGetUniformLocation(m.program, "depths");
+            glGenVertexArrays(1, &m.vao);
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, t.framebuffer);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        const GLenum none = GL_NONE;
+        const GLenum colorBuffer[] = {GL_COLOR_ATTACHMENT0};
+        glDrawBuffers(1, colorBuffer);
+        glBlitFramebuffer(0, 0, cols, rows, 0, 0, cols, rows, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        const GLenum maskDepthBuffers[] = {none, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, maskDepthBuffers);
+        glViewport(0, 0, cols, rows);
+        glDisable(GL_DEPTH_TEST);
+        glUseProgram(m.program);
+        // above the units of the frame: texture arrays, heights and shadow map
+        const GLint units[] = {m.masks, m.depths};
+        for (int i = 0; i < 2; ++i) {
+            glUniform1i(units[i], 4 + i);
+            glActiveTexture(GL_TEXTURE4 + i);
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, t.textures[i]);
+        }
+        glBindVertexArray(m.vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        for (int i = 0; i < 2; ++i) {
+            glActiveTexture(GL_TEXTURE4 + i);
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                      GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, drawBuffers);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glEnable(GL_DEPTH_TEST);
+        glUseProgram(program);
+    }
+
+    void release(Multisampling& m)
+    {
+        for (auto& it : m.targets) {
+            glDeleteFramebuffers(1, &it.second.framebuffer);
+            glDeleteRenderbuffers(2, it.second.renderbuffers);
+            glDeleteTextures(2, it.second.textures);
+        }
+        if (m.vao)
+            glDeleteVertexArrays(1, &m.vao);
+        if (m.program)
+            glDeleteProgram(m.program);
+        m = Multisampling();
+    }
+
+    /**
+     * @brief Record the passes timed two frames ago into their stats, then time the passes of
+     * a new frame if stats are current
+     */
+    void beginTimedFrame()
+    {
+        auto& t = timers;
+        endPass();
+        t.current = 1 - t.current;
+        auto& frame = t.frames[t.current];
+        if (frame.stats) {
+            std::array<double, size_t(Stage::Count)> seconds{};
+            std::array<bool, size_t(Stage::Count)> timed{};
+            for (size_t i = 0; i < frame.stages.size(); ++i) {
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &ns);
+                seconds[size_t(frame.stages[i])] += ns * 1e-9;
+                timed[size_t(frame.stages[i])] = true;
+            }
+            for (size_t stage = 0; stage < seconds.size(); ++stage)
+                if (timed[stage])
+                    frame.stats->record(Stage(stage), seconds[stage]);
+        }
+        frame.stages.clear();
+        frame.stats = StageStats::current();
+    }
+
+    /**
+     * @brief End the running pass and time the GPU commands issued until the next one as
+     * \p stage, nothing if it is running or the frame is not timed
+     */
+    void beginPass(Stage stage)
+    {
+        auto& t = timers;
+        auto& frame = t.frames[t.current];
+        if (!frame.stats || stage == t.stage)
+            return;
+        endPass();
+        if (frame.stages.size() == frame.queries.size()) {
+            GLuint query = 0;
+            glGenQueries(1, &query);
+            frame.queries.push_back(query);
+        }
+        glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.stages.size()]);
+        frame.stages.push_back(stage);
+        t.stage = stage;
+    }
+
+    /// end the running pass, if any
+    void endPass()
+    {
+        if (timers.stage == Stage::Count)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        timers.stage = Stage::Count;
+    }
+
+    void release(PassTimers& t)
+    {
+        endPass();
+        for (auto& frame : t.frames)
+            if (!frame.queries.empty())
+                glDeleteQueries(GLsizei(frame.queries.size()), frame.queries.data());
+        t = PassTimers();
+    }
+
+    /**
+     * @brief Move the transform stream to the buffer of a new frame, once the GPU is done with
+     * its last one
+     */
+    void beginTransforms()
+    {
+        auto& t = transforms;
+        t.current = (t.current + 1) % TransformStream::kBuffers;
+        t.count = 0;
+        GLsync& fence = t.fences[t.current];
+        if (fence) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+        if (t.capacity) {
+            glActiveTexture(GL_TEXTURE7);
+            glBindTexture(GL_TEXTURE_BUFFER, t.textures[t.current]);
+            glActiveTexture(GL_TEXTURE0);
+        }
+    }
+
+    /**
+     * @brief Fence the buffer of the frame, read by the draws issued in it
+     */
+    void endTransforms()
+    {
+        auto& t = transforms;
+        if (t.count && !t.fences[t.current])
+            t.fences[t.current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    /**
+     * @brief Write the matrices of transformData, model then previous model of each draw, to
+     * the buffer of the frame
+     *
+     * @return Transform index of the first draw
+     */
+    int streamTransforms()
+    {
+        auto& t = transforms;
+        const size_t draws = transformData.size() / 32;
+        if (t.count + draws > t.capacity) {
+            // the draws issued are done before the buffers are replaced, their indices restart
+            const size_t capacity = std::max(draws, std::max<size_t>(t.capacity * 2, 1024));
+            glFinish();
+            release(t);
+            t.capacity = capacity;
+            const GLsizeiptr size = GLsizeiptr(t.capacity * 32 * sizeof(float));
+            glGenBuffers(TransformStream::kBuffers, t.buffers);
+            glGenTextures(TransformStream::kBuffers, t.textures);
+            glActiveTexture(GL_TEXTURE7);
+            for (int i = 0; i < TransformStream::kBuffers; ++i) {
+                glBindBuffer(GL_TEXTURE_BUFFER, t.buffers[i]);
+                if (t.persistent) {
+                    const GLbitfield flags =
+                        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                    glBufferStorage(GL_TEXTURE_BUFFER, size, nullptr, flags);
+                    t.mapped[i] = static_cast<float*>(
+                        glMapBufferRange(GL_TEXTURE_BUFFER, 0, size, flags));
+                } else {
+                    glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+                }
+                glBindTexture(GL_TEXTURE_BUFFER, t.textures[i]);
+                glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, t.buffers[i]);
+            }
+            glBindTexture(GL_TEXTURE_BUFFER, t.textures[t.current]);
+            glActiveTexture(GL_TEXTURE0);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+            t.count = 0;
+        }
+        const size_t offset = t.count * 32;
+        if (t.persistent) {
+            std::copy(transformData.begin(), transformData.end(), t.mapped[t.current] + offset);
+        } else {
+            glBindBuffer(GL_TEXTURE_BUFFER, t.buffers[t.current]);
+            glBufferSubData(GL_TEXTURE_BUFFER, GLintptr(offset * sizeof(float)),
+                            GLsizeiptr(transformData.size() * sizeof(float)),
+                            transformData.data());
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        }
+        const int first = int(t.count);
+        t.count += draws;
+        return first;
+    }
+
+    /**
+     * @brief Upload the lights of lights.clusters, bound to texture units 8 and 9
+     */
+    void uploadLights()
+    {
+        auto& l = lights;
+        if (!l.buffers[0]) {
+            glGenBuffers(2, l.buffers);
+            glGenTextures(2, l.textures);
+        }
+        const GLenum formats[] = {GL_RGBA32F, GL_R32UI};
+        const GLsizeiptr sizes[] = {GLsizeiptr(l.clusters.lights.size() * sizeof(float)),
+                                    GLsizeiptr(l.clusters.clusters.size() * sizeof(uint32_t))};
+        const void* data[] = {l.clusters.lights.data(), l.clusters.clusters.data()};
+        for (int i = 0; i < 2; ++i) {
+            // orphaned, draws of the previous view may still read the buffer
+            glBindBuffer(GL_TEXTURE_BUFFER, l.buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, std::max<GLsizeiptr>(sizes[i], 16), nullptr,
+                         GL_STREAM_DRAW);
+            if (sizes[i])
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+            glActiveTexture(GL_TEXTURE8 + i);
+            glBindTexture(GL_TEXTURE_BUFFER, l.textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], l.buffers[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void release(LightBuffers& l)
+    {
+        if (l.buffers[0]) {
+            glDeleteTextures(2, l.textures);
+            glDeleteBuffers(2, l.buffers);
+        }
+        l = LightBuffers();
+    }
+
+    /**
+     * @brief Grow a buffer of the indirect draws to \p size bytes at least, keeping its \p used
+     * first bytes
+     */
+    void growBuffer(GLuint& buffer, size_t& capacity, size_t size, size_t used)
+    {
+        if (size <= capacity)
+            return;
+        const size_t grown = std::max(size, capacity * 2);
+        GLuint larger = 0;
+        glGenBuffers(1, &larger);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, larger);
+        glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(grown), nullptr, GL_STATIC_DRAW);
+        if (buffer) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, GLsizeiptr(used));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        addResident(grown - capacity);
+        buffer = larger;
+        capacity = grown;
+    }
+
+    /**
+     * @brief Mesh of the indirect draws, appended to the arena on first use
+     */
+    const IndirectDraws::ArenaMesh& arenaMesh(const std::shared_ptr<scene::MeshData>& data)
+    {
+        auto& d = indirectDraws;
+        auto it = d.meshes.find(data.get());
+        if (it != d.meshes.end())
+            return it->second;
+
+        const size_t count = data->numVertices();
+        const auto& positions = data->vertices();
+        const auto& normals = data->normals();
+        const auto& uvs = data->uvs();
+        std::vector<float> vertices(count * IndirectDraws::kVertexFloats, 0.f);
+        for (size_t v = 0; v < count; ++v) {
+            float* vertex = &vertices[v * IndirectDraws::kVertexFloats];
+            std::copy_n(&positions[v * 3], 3, vertex);
+            if (normals.size() == count * 3)
+                std::copy_n(&normals[v * 3], 3, vertex + 3);
+            if (uvs.size() == count * 2)
+                std::copy_n(&uvs[v * 2], 2, vertex + 6);
+        }
+        const std::vector<GLuint> indices(data->indices().begin(), data->indices().end());
+
+        const size_t vertexBytes = vertices.size() * sizeof(float);
+        const size_t indexBytes = indices.size() * sizeof(GLuint);
+        const size_t vertexUsed = d.vertexCount * IndirectDraws::kVertexFloats * sizeof(float);
+        const size_t indexUsed = d.indexCount * sizeof(GLuint);
+        const GLuint vertexBuffer = d.buffers[0], indexBuffer = d.buffers[1];
+        growBuffer(d.buffers[0], d.vertexCapacity, vertexUsed + vertexBytes, vertexUsed);
+        growBuffer(d.buffers[1], d.indexCapacity, indexUsed + indexBytes, indexUsed);
+        if (!d.vao)
+            glGenVertexArrays(1, &d.vao);
+        glBindVertexArray(d.vao);
+        if (d.buffers[0] != vertexBuffer) {
+            const GLsizei stride = IndirectDraws::kVertexFloats * sizeof(float);
+            glBindBuffer(GL_ARRAY_BUFFER, d.buffers[0]);
+            for (GLuint attribute = 0; attribute < 3; ++attribute) {
+                glEnableVertexAttribArray(attribute);
+                glVertexAttribPointer(attribute, attribute == 2 ? 2 : 3, GL_FLOAT, GL_FALSE,
+                                      stride,
+                                      reinterpret_cast<const void*>(attribute * 3 * sizeof(float)));
+            }
+        }
+        if (d.buffers[1] != indexBuffer)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, d.buffers[1]);
+        glBindBuffer(GL_ARRAY_BUFFER, d.buffers[0]);
+        glBufferSubData(GL_ARRAY_BUFFER, GLintptr(vertexUsed), GLsizeiptr(vertexBytes),
+                        vertices.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, GLintptr(indexUsed), GLsizeiptr(indexBytes),
+                        indices.data());
+        glBindVertexArray(0);
+        ++uploads;
+
+        IndirectDraws::ArenaMesh mesh;
+        mesh.data = data;
+        mesh.indexCount = GLuint(indices.size());
+        mesh.firstIndex = GLuint(d.indexCount);
+        mesh.baseVertex = GLint(d.vertexCount);
+        const auto& bounds = data->bounds();
+        float radius = 0.f;
+        for (int k = 0; k < 3; ++k) {
+            mesh.sphere[k] = (bounds.lower[k] + bounds.upper[k]) * 0.5f;
+            radius += (bounds.upper[k] - bounds.lower[k]) * (bounds.upper[k] - bounds.lower[k]);
+        }
+        mesh.sphere[3] = std::sqrt(radius) * 0.5f;
+        d.vertexCount += count;
+        d.indexCount += indices.size();
+        return d.meshes.emplace(data.get(), std::move(mesh)).first->second;
+    }
+
+    /**
+     * @brief Link the culling compute shader of the indirect draws
+     */
+    void compileIndirectDraws()
+    {
+        auto& d = indirectDraws;
+        d.program = linkComputeProgram(kCullComputeShader);
+        d.planes = glGetUniformLocation(d.program, "planes");
+        d.drawCount = glGetUniformLocation(d.program, "drawCount");
+        d.instances = glGetUniformLocation(d.program, "instances");
+        glUseProgram(d.program);
+        glUniform1i(glGetUniformLocation(d.program, "transforms"), 7);
+        glUseProgram(program);
+    }
+
+    /**
+     * @brief Upload the records and culling inputs of the indirect draws, then write their
+     * commands, each drawing \p instances views of its mesh unless out of \p frustum
+     */
+    void cullIndirect(const scene::Frustum& frustum, int instances)
+    {
+        auto& d = indirectDraws;
+        const size_t draws = d.culls.size();
+        if (draws > d.drawCapacity) {
+            // attribute of the draw index of each command, from its base instance
+            const size_t capacity = std::max(draws, std::max<size_t>(d.drawCapacity * 2, 1024));
+            std::vector<GLint> indices(capacity);
+            for (size_t i = 0; i < capacity; ++i)
+                indices[i] = GLint(i);
+            if (!d.buffers[2]) {
+                glGenBuffers(4, d.buffers + 2);
+                glGenTextures(1, &d.recordTexture);
+            }
+            glBindVertexArray(d.vao);
+            glBindBuffer(GL_ARRAY_BUFFER, d.buffers[2]);
+            glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(capacity * sizeof(GLint)), indices.data(),
+                         GL_STATIC_DRAW);
+            glEnableVertexAttribArray(4);
+            glVertexAttribIPointer(4, 1, GL_INT, 0, nullptr);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindVertexArray(0);
+            d.drawCapacity = capacity;
+        }
+
+        // orphaned, draws of the previous list may still read them
+        glBindBuffer(GL_TEXTURE_BUFFER, d.buffers[3]);
+        glBufferData(GL_TEXTURE_BUFFER, GLsizeiptr(d.records.size() * sizeof(GLint)),
+                     d.records.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE10);
+        glBindTexture(GL_TEXTURE_BUFFER, d.recordTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32I, d.buffers[3]);
+        glActiveTexture(GL_TEXTURE0);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, d.buffers[4]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(draws * sizeof(IndirectDraws::Cull)),
+                     d.culls.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, d.buffers[5]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER,
+                     GLsizeiptr(draws * sizeof(IndirectDraws::Command)), nullptr,
+                     GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, d.buffers[4]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, d.buffers[5]);
+
+        glUseProgram(d.program);
+        glUniform4fv(d.planes, 6, frustum.planes()[0].data());
+        glUniform1i(d.drawCount, GLint(draws));
+        glUniform1i(d.instances, instances);
+        glDispatchCompute(GLuint((draws + 63) / 64), 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+        glUseProgram(program);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, d.buffers[5]);
+    }
+
+    /**
+     * @brief Drop the arena once most of its meshes are used by no user of the context at its
+     * last pruning, meshes still drawn are appended again
+     */
+    void pruneArena()
+    {
+        auto& d = indirectDraws;
+        size_t unused = 0;
+        for (const auto& it : d.meshes)
+            if (!usedMeshes.count(it.first))
+                unused += it.second.data->numVertices();
+        if (unused * 2 <= d.vertexCount)
+            return;
+        d.meshes.clear();
+        d.vertexCount = 0;
+        d.indexCount = 0;
+    }
+
+    void release(IndirectDraws& d)
+    {
+        shared->residentBytes -= d.vertexCapacity + d.indexCapacity;
+        glDeleteBuffers(6, d.buffers);
+        if (d.recordTexture)
+            glDeleteTextures(1, &d.recordTexture);
+        if (d.vao)
+            glDeleteVertexArrays(1, &d.vao);
+        if (d.program)
+            glDeleteProgram(d.program);
+        d = IndirectDraws();
+    }
+
+    void release(TransformStream& t)
+    {
+        for (int i = 0; i < TransformStream::kBuffers; ++i) {
+            if (t.fences[i])
+                glDeleteSync(t.fences[i]);
+            t.fences[i] = nullptr;
+            if (t.mapped[i]) {
+                glBindBuffer(GL_TEXTURE_BUFFER, t.buffers[i]);
+                glUnmapBuffer(GL_TEXTURE_BUFFER);
+                t.mapped[i] = nullptr;
+            }
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        if (t.capacity) {
+            glDeleteTextures(TransformStream::kBuffers, t.textures);
+            glDeleteBuffers(TransformStream::kBuffers, t.buffers);
+        }
+        const bool persistent = t.persistent;
+        const int current = t.current;
+        t = TransformStream();
+        t.persistent = persistent;
+        t.current = current;
+    }
+
+    /**
+     * @brief Filter the texture arrays of the next draws by a sampler of \p filter, their own
+     * trilinear filtering being used without one
+     */
+    void setTextureFilter(scene::TextureFilter filter)
+    {
+        GLuint sampler = 0;
+        if (filter != scene::TextureFilter::Trilinear) {
+            const int index = filter == scene::TextureFilter::Nearest ? 0 : 1;
+            if (!samplers[index]) {
+                glGenSamplers(1, &samplers[index]);
+                const GLint mode = index ? GL_LINEAR : GL_NEAREST;
+                glSamplerParameteri(samplers[index], GL_TEXTURE_MIN_FILTER, mode);
+                glSamplerParameteri(samplers[index], GL_TEXTURE_MAG_FILTER, mode);
+                glSamplerParameteri(samplers[index], GL_TEXTURE_WRAP_S, GL_REPEAT);
+                glSamplerParameteri(samplers[index], GL_TEXTURE_WRAP_T, GL_REPEAT);
+            }
+            sampler = samplers[index];
+        }
+        glBindSampler(0, sampler);
+    }
+
+#ifdef WITH_CUDA
+    /**
+     * @brief Give the pixel buffers back to OpenGL, before writing them
+     */
+    void unmapPixelBuffers()
+    {
+        if (mapped)
+            checkCuda(cudaGraphicsUnmapResources(3, resources, nullptr));
+        mapped = false;
+    }
+
+    void releasePixelBuffers()
+    {
+        unmapPixelBuffers();
+        for (auto& resource : resources) {
+            if (resource)
+                cudaGraphicsUnregisterResource(resource);
+            resource = nullptr;
+        }
+        if (pixelBuffers[0])
+            glDeleteBuffers(3, pixelBuffers);
+        pixelBuffers[0] = pixelBuffers[1] = pixelBuffers[2] = 0;
+        pixelBufferSize = 0;
+    }
+
+    /**
+     * @brief Copy the attachments into the pixel buffers and map them to CUDA device memory
+     *
+     * Rows are already top first, the projection being flipped in GPU output mode.
+     */
+    void readPixelBuffers(GpuFrame& frame)
+    {
+        unmapPixelBuffers();
+        // all planes have 4 bytes per pixel
+        const size_t size = size_t(cols) * rows * 4;
+        if (size != pixelBufferSize) {
+            releasePixelBuffers();
+            glGenBuffers(3, pixelBuffers);
+            for (int i = 0; i < 3; ++i) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+                glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(size), nullptr, GL_STREAM_READ);
+                checkCuda(cudaGraphicsGLRegisterBuffer(&resources[i], pixelBuffers[i],
+                                                       cudaGraphicsRegisterFlagsReadOnly));
+            }
+            pixelBufferSize = size;
+        }
+
+        const GLenum formats[] = {GL_RGBA, GL_RED_INTEGER, GL_RED};
+        const GLenum types[] = {GL_UNSIGNED_BYTE, GL_INT, GL_FLOAT};
+        for (int i = 0; i < 3; ++i) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+            glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+            glReadPixels(0, 0, cols, rows, formats[i], types[i], nullptr);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        // mapping waits for the read backs, on the GPU only
+        checkCuda(cudaGraphicsMapResources(3, resources, nullptr));
+        mapped = true;
+        void* planes[3];
+        size_t mappedSize = 0;
+        for (int i = 0; i < 3; ++i)
+            checkCuda(cudaGraphicsResourceGetMappedPointer(&planes[i], &mappedSize, resources[i]));
+        frame.cols = cols;
+        frame.rows = rows;
+        frame.color = static_cast<uint8_t*>(planes[0]);
+        frame.mask = static_cast<int*>(planes[1]);
+        frame.depth = static_cast<float*>(planes[2]);
+    }
+#endif
+
+    void release(GpuMesh& mesh)
+    {
+        glDeleteBuffers(4, mesh.buffers);
+        glDeleteVertexArrays(1, &mesh.vao);
+        shared->residentBytes -= mesh.bytes;
+    }
+
+    void release(StaticBatch& batch)
+    {
+        release(batch.mesh);
+        glDeleteBuffers(1, &batch.segmentation);
+    }
+
+    /// stop drawing the base layer, its batches released with their last user
+    void dropLayer()
+    {
+        if (layer && layer.use_count() == 1)
+            for (auto& it : layer->batches)
+                release(it.second);
+        layer.reset();
+    }
+
+    void release(GpuTexture& texture)
+    {
+        // arrays keep the memory of their free layers until all of them are free
+        const auto it = shared->textureArrays.find(texture.array);
+        it->second.layers[texture.layer] = nullptr;
+        if (--it->second.used == 0) {
+            if (shared->boundArray == it->second.texture)
+                shared->boundArray = 0;
+            glDeleteTextures(1, &it->second.texture);
+            shared->textureArrays.erase(it);
+        }
+        shared->residentBytes -= texture.bytes;
+    }
+
+    void release(GpuHeightfield& heightfield)
+    {
+        glDeleteTextures(1, &heightfield.texture);
+        shared->residentBytes -= heightfield.bytes;
+    }
+
+    /**
+     * @brief Upload the next finer mip level of the streamed textures drawn in the frame and
+     * coarser than their screen size wants, largest on screen first, within the stream budget
+     *
+     * A level larger than the budget streams alone in its frame.
+     *
+     * @return Bytes uploaded
+     */
+    size_t streamTextures()
+    {
+        std::vector<std::pair<float, GpuTexture*>> pending;
+        for (auto& it : shared->textures) {
+            auto& texture = it.second;
+            if (!texture.finestLevel || texture.lastUsed < shared->frame)
+                continue;
+            // textures of static batches and base layers have no demand, wanted whole
+            const auto demand = textureDemand.find(it.first);
+            const float size =
+                demand != textureDemand.end() ? demand->second
+                                              : std::numeric_limits<float>::infinity();
+            const float texels = float(std::max(texture.bitmap->rows(), texture.bitmap->cols()));
+            const int wanted =
+                size < texels ? std::min(size > 1.f ? int(std::log2(texels / size))
+                                                    : texture.coarseLevel,
+                                         texture.coarseLevel)
+                              : 0;
+            if (texture.finestLevel > wanted)
+                pending.emplace_back(size, &texture);
+        }
+        textureDemand.clear();
+        std::stable_sort(pending.begin(), pending.end(),
+                         [](const std::pair<float, GpuTexture*>& a,
+                            const std::pair<float, GpuTexture*>& b) { return a.first > b.first; });
+
+        size_t streamed = 0;
+        pendingTextures = int(pending.size());
+        for (const auto& it : pending) {
+            auto& texture = *it.second;
+            const auto& bitmap = *texture.bitmap;
+            size_t bytes = 0;
+            for (int level = texture.finestLevel - 1; level < streamedLevels(bitmap); ++level)
+                bytes += levelBytes(bitmap, level);
+            if (streamed && streamed + bytes > streamBudget)
+                continue;
+            uploadLevels(texture, shared->textureArrays.at(texture.array),
+                         texture.finestLevel - 1);
+            streamed += bytes;
+            --pendingTextures;
+        }
+        streamedBytes += streamed;
+        return streamed;
+    }
+
+    /**
+     * @brief Release the resources drawn least recently, not in the current frame, until the
+     * resident ones fit the budget
+     */
+    void evict(size_t budget)
+    {
+        if (!budget || shared->residentBytes <= budget)
+            return;
+
+        // finer mip levels of streamed textures first, streamed again when drawn
+        std::vector<std::pair<uint64_t, const scene::Bitmap*>> streamed;
+        for (const auto& it : shared->textures)
+            if (it.second.lastUsed < shared->frame &&
+                it.second.finestLevel < it.second.coarseLevel)
+                streamed.emplace_back(it.second.lastUsed, it.first);
+        std::sort(streamed.begin(), streamed.end());
+        for (const auto& candidate : streamed) {
+            if (shared->residentBytes <= budget)
+                return;
+            auto& texture = shared->textures.at(candidate.second);
+            uploadLevels(texture, shared->textureArrays.at(texture.array), texture.coarseLevel);
+            ++mipEvictions;
+        }
+
+        // last use, texture or mesh, key
+        std::vector<std::tuple<uint64_t, bool, const void*>> candidates;
+        for (const auto& it : shared->meshes)
+            if (it.second.lastUsed < shared->frame)
+                candidates.emplace_back(it.second.lastUsed, false, it.first);
+        for (const auto& it : shared->textures)
+            if (it.second.lastUsed < shared->frame)
+                candidates.emplace_back(it.second.lastUsed, true, it.first);
+        std::sort(candidates.begin(), candidates.end());
+
+        for (const auto& candidate : candidates) {
+            if (shared->residentBytes <= budget)
+                break;
+            if (std::get<1>(candidate)) {
+                const auto key = static_cast<const scene::Bitmap*>(std::get<2>(candidate));
+                const auto it = shared->textures.find(key);
+                release(it->second);
+                shared->textures.erase(it);
+            }
+            else {
+                const auto key = static_cast<const scene::MeshData*>(std::get<2>(candidate));
+                const auto it = shared->meshes.find(key);
+                release(it->second);
+                shared->dirty.erase(it->first);
+                shared->meshes.erase(it);
+            }
+            ++evictions;
+        }
+    }
+
+    void pruneResources(const std::map<int, std::vector<DrawItem>>& items,
+                        std::set<const scene::Bitmap*> overrideBitmaps)
+    {
+        usedMeshes.clear();
+        usedBitmaps = std::move(overrideBitmaps);
+        std::set<std::pair<int, int>> usedHeightfields;
+        for (const auto& it : items) {
+            for (const auto& item : it.second) {
+                if (item.heightfield)
+                    usedHeightfields.emplace(it.first, item.shapeIndex);
+                usedMeshes.insert(item.mesh.get());
+                for (const auto& lod : item.lods)
+                    usedMeshes.insert(lod.get());
+                usedBitmaps.insert(item.bitmap.get());
+            }
+        }
+        if (layer)
+            for (const auto& it : layer->batches)
+                usedBitmaps.insert(it.second.bitmap.get());
+        releaseUnused();
+        pruneArena();
+        for (auto it = heightfields.begin(); it != heightfields.end();) {
+            if (usedHeightfields.count(it->first)) {
+                ++it;
+                continue;
+            }
+            release(it->second);
+            it = heightfields.erase(it);
+        }
+        prune = false;
+    }
+
+    /**
+     * @brief Release the meshes and textures of the shared context used by none of its users
+     * at their last pruning
+     */
+    void releaseUnused()
+    {
+        const auto meshUsed = [this](const scene::MeshData* data) {
+            for (const auto* user : shared->users)
+                if (user->usedMeshes.count(data))
+                    return true;
+            return false;
+        };
+        const auto bitmapUsed = [this](const scene::Bitmap* bitmap) {
+            for (const auto* user : shared->users)
+                if (user->usedBitmaps.count(bitmap))
+                    return true;
+            return false;
+        };
+        for (auto it = shared->meshes.begin(); it != shared->meshes.end();) {
+            if (meshUsed(it->first)) {
+                ++it;
+                continue;
+            }
+            release(it->second);
+            shared->dirty.erase(it->first);
+            it = shared->meshes.erase(it);
+        }
+        for (auto it = shared->textures.begin(); it != shared->textures.end();) {
+            if (bitmapUsed(it->first)) {
+                ++it;
+                continue;
+            }
+            release(it->second);
+            it = shared->textures.erase(it);
+        }
+    }
+};
+
+namespace {
+
+/// bitmap of a texture, block compressed while enabled, see setTextureCompression()
+std::shared_ptr<scene::Bitmap> textureBitmap(const scene::Texture& texture)
+{
+    auto bitmap = loadCompressedBitmap(texture);
+    if (!bitmap)
+        bitmap = loadBitmap(texture);
+    return bitmap && bitmap->channels() > 0 ? bitmap : nullptr;
+}
+
+/**
+ * @brief Create an OpenGL 3.3 context on a device, with the pbuffer surface making it current
+ */
+void createContext(int device, EGLDisplay& display, EGLSurface& surface, EGLContext& context)
+{
+    display = getDisplay(device);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+        throw std::runtime_error("EGLRenderer: cannot initialize the EGL display");
+
+    const EGLint configAttribs[] = {EGL_SURFACE_TYPE,
+                                    EGL_PBUFFER_BIT,
+                                    EGL_RENDERABLE_TYPE,
+                                    EGL_OPENGL_BIT,
+                                    EGL_RED_SIZE,
+                                    8,
+                                    EGL_GREEN_SIZE,
+                                    8,
+                                    EGL_BLUE_SIZE,
+                                    8,
+                                    EGL_ALPHA_SIZE,
+                                    8,
+                                    EGL_DEPTH_SIZE,
+                                    24,
+                                    EGL_NONE};
+    EGLConfig config;
+    EGLint count = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &count) || count < 1)
+        throw std::runtime_error("EGLRenderer: no suitable EGL config");
+
+    // rendering goes to a framebuffer object, the surface only makes the context current
+    const EGLint surfaceAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+    if (surface == EGL_NO_SURFACE)
+        throw std::runtime_error("EGLRenderer: cannot create a pbuffer surface");
+
+    eglBindAPI(EGL_OPENGL_API);
+    const EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                     3,
+                                     EGL_CONTEXT_MINOR_VERSION,
+                                     3,
+                                     EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                     EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                     EGL_NONE};
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT) {
+        eglDestroySurface(display, surface);
+        surface = EGL_NO_SURFACE;
+        throw std::runtime_error("EGLRenderer: cannot create an OpenGL 3.3 context");
+    }
+}
+
+} // namespace
+
+constexpr int EGLRenderer::ScheduledDevice;
+
+int EGLRenderer::deviceCount()
+{
+    const auto queryDevices = queryDevicesFunction();
+    EGLint count = 0;
+    if (!queryDevices || !queryDevices(0, nullptr, &count))
+        return 0;
+    return int(count);
+}
+
+std::string EGLRenderer::deviceFile(int device)
+{
+    const auto queryDevices = queryDevicesFunction();
+    const auto queryDeviceString = reinterpret_cast<PFNEGLQUERYDEVICESTRINGEXTPROC>(
+        eglGetProcAddress("eglQueryDeviceStringEXT"));
+    EGLDeviceEXT devices[32];
+    EGLint count = 0;
+    if (!queryDevices || !queryDeviceString || device < 0 ||
+        !queryDevices(32, devices, &count) || device >= count)
+        return "";
+    const char* file = queryDeviceString(devices[device], EGL_DRM_DEVICE_FILE_EXT);
+    return file ? file : "";
+}
+
+EGLRenderer::EGLRenderer(int device, bool shareResources) : _shareResources(shareResources)
+{
+    // assets of new shapes start loading before the scene update needs them, interleaved
+    setAssetPrefetch(true);
+    if (vertexBufferMode() == VertexBufferMode::Off)
+        setVertexBufferMode(VertexBufferMode::Float);
+
+    if (device == ScheduledDevice) {
+        _deviceLease = acquireDevice();
+        if (!_deviceLease)
+            throw std::runtime_error("EGLRenderer: no EGL device to schedule");
+        device = _deviceLease->device();
+    }
+    _device = device;
+
+    // renderers sharing resources draw in a single context per device
+    _context.reset(new Context(shareResources ? Context::sharedContext(device)
+                                              : std::make_shared<Context::Shared>()));
+    auto& ctx = *_context;
+    auto& shared = *ctx.shared;
+    {
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        if (shared.context == EGL_NO_CONTEXT)
+            createContext(device, shared.display, shared.surface, shared.context);
+    }
+
+    CurrentContext current(shared.mutex, shared.display, shared.surface, shared.context);
+    ctx.program = linkProgram(kVertexShader, kFragmentShader);
+    ctx.model = glGetUniformLocation(ctx.program, "model");
+    ctx.view = glGetUniformLocation(ctx.program, "view");
+    ctx.viewProj = glGetUniformLocation(ctx.program, "viewProj");
+    ctx.diffuse = glGetUniformLocation(ctx.program, "diffuse");
+    ctx.textured = glGetUniformLocation(ctx.program, "textured");
+    ctx.diffuseTexture = glGetUniformLocation(ctx.program, "diffuseTexture");
+    ctx.textureLayer = glGetUniformLocation(ctx.program, "textureLayer");
+    ctx.lightDirection = glGetUniformLocation(ctx.program, "lightDirection");
+    ctx.ambientColor = glGetUniformLocation(ctx.program, "ambientColor");
+    ctx.diffuseColor = glGetUniformLocation(ctx.program, "diffuseColor");
+    ctx.segmentation = glGetUniformLocation(ctx.program, "segmentation");
+    ctx.positionOffset = glGetUniformLocation(ctx.program, "positionOffset");
+    ctx.positionScale = glGetUniformLocation(ctx.program, "positionScale");
+    ctx.uvOffset = glGetUniformLocation(ctx.program, "uvOffset");
+    ctx.uvScale = glGetUniformLocation(ctx.program, "uvScale");
+    ctx.octNormals = glGetUniformLocation(ctx.program, "octNormals");
+    ctx.heightfield = glGetUniformLocation(ctx.program, "heightfield");
+    ctx.heights = glGetUniformLocation(ctx.program, "heights");
+    ctx.tileOrigin = glGetUniformLocation(ctx.program, "tileOrigin");
+    ctx.tileStep = glGetUniformLocation(ctx.program, "tileStep");
+    ctx.tileVertices = glGetUniformLocation(ctx.program, "tileVertices");
+    ctx.skirtDepth = glGetUniformLocation(ctx.program, "skirtDepth");
+    ctx.batched = glGetUniformLocation(ctx.program, "batched");
+    ctx.lightViewProj = glGetUniformLocation(ctx.program, "lightViewProj");
+    ctx.shadowed = glGetUniformLocation(ctx.program, "shadowed");
+    ctx.maskOnly = glGetUniformLocation(ctx.program, "maskOnly");
+    ctx.shadowMap = glGetUniformLocation(ctx.program, "shadowMap");
+    ctx.shadowCascades = glGetUniformLocation(ctx.program, "shadowCascades");
+    ctx.cascadeViewProjs = glGetUniformLocation(ctx.program, "cascadeViewProjs");
+    ctx.cascadeTiles = glGetUniformLocation(ctx.program, "cascadeTiles");
+    ctx.pointsInWorld = glGetUniformLocation(ctx.program, "pointsInWorld");
+    ctx.depthScale = glGetUniformLocation(ctx.program, "depthScale");
+    ctx.previousModel = glGetUniformLocation(ctx.program, "previousModel");
+    ctx.previousViewProj = glGetUniformLocation(ctx.program, "previousViewProj");
+    ctx.imageSize = glGetUniformLocation(ctx.program, "imageSize");
+    ctx.transformBuffer = glGetUniformLocation(ctx.program, "transforms");
+    ctx.transformIndex = glGetUniformLocation(ctx.program, "transformIndex");
+    ctx.projective = glGetUniformLocation(ctx.program, "projective");
+    ctx.projectorViewProj = glGetUniformLocation(ctx.program, "projectorViewProj");
+    ctx.viewCount = glGetUniformLocation(ctx.program, "viewCount");
+    ctx.viewMatrices = glGetUniformLocation(ctx.program, "viewMatrices");
+    ctx.viewProjs = glGetUniformLocation(ctx.program, "viewProjs");
+    ctx.viewBands = glGetUniformLocation(ctx.program, "viewBands");
+    ctx.localLights = glGetUniformLocation(ctx.program, "localLights");
+    ctx.unboundedLights = glGetUniformLocation(ctx.program, "unboundedLights");
+    ctx.boundedLights = glGetUniformLocation(ctx.program, "boundedLights");
+    ctx.clustered = glGetUniformLocation(ctx.program, "clustered");
+    ctx.lightClusters = glGetUniformLocation(ctx.program, "lightClusters");
+    ctx.clusterGrid = glGetUniformLocation(ctx.program, "clusterGrid");
+    ctx.clusterDepth = glGetUniformLocation(ctx.program, "clusterDepth");
+    ctx.indirect = glGetUniformLocation(ctx.program, "indirect");
+    ctx.drawRecords = glGetUniformLocation(ctx.program, "drawRecords");
+    // samplers of different types never share a unit, even in passes not sampling them
+    glUseProgram(ctx.program);
+    glUniform1i(ctx.diffuseTexture, 0);
+    glUniform1i(ctx.heights, 1);
+    glUniform1i(ctx.shadowMap, 3);
+    glUniform1i(ctx.transformBuffer, 7);
+    glUniform1i(ctx.transformIndex, -1);
+    glUniform1i(ctx.viewCount, 1);
+    glUniform1i(ctx.localLights, 8);
+    glUniform1i(ctx.lightClusters, 9);
+    glUniform1i(ctx.drawRecords, 10);
+    glUniform3i(ctx.clusterGrid, LightClusters::kCols, LightClusters::kRows,
+                LightClusters::kSlices);
+    glUseProgram(0);
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &_maxTextureSize);
+    // indirect draws need multi-draw indirect commands written by compute shaders
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    ctx.indirectDraws.supported = major > 4 || (major == 4 && minor >= 3);
+    ctx.events.supported = ctx.indirectDraws.supported;
+    ctx.pixelCounts.supported = ctx.indirectDraws.supported;
+
+    // compressed textures are uploaded as is if the GPU decodes their blocks, draw transforms
+    // streamed through mapped buffers if it can keep them mapped
+    GLint extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions; ++i) {
+        const auto name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+        if (name && std::string(name) == "GL_EXT_texture_compression_s3tc")
+            setTextureCompression(true);
+        if (name && std::string(name) == "GL_ARB_buffer_storage")
+            ctx.transforms.persistent = true;
+    }
+    shared.users.push_back(&ctx);
+}
+
+EGLRenderer::~EGLRenderer()
+{
+    auto& ctx = *_context;
+    auto& shared = *ctx.shared;
+    CurrentContext current(shared.mutex, shared.display, shared.surface, shared.context);
+    // meshes and textures still used by other renderers are kept, the context with its last user
+    shared.users.erase(std::find(shared.users.begin(), shared.users.end(), &ctx));
+    ctx.releaseUnused();
+    for (auto& it : ctx.staticBatches)
+        ctx.release(it.second);
+    ctx.dropLayer();
+    for (auto& it : ctx.heightfields)
+        ctx.release(it.second);
+    ctx.release(ctx.indirectDraws);
+#ifdef WITH_CUDA
+    ctx.releasePixelBuffers();
+#endif
+    if (ctx.framebuffer) {
+        glDeleteRenderbuffers(4, ctx.renderbuffers);
+        if (ctx.pointRenderbuffer)
+            glDeleteRenderbuffers(1, &ctx.pointRenderbuffer);
+        if (ctx.shortRenderbuffer)
+            glDeleteRenderbuffers(1, &ctx.shortRenderbuffer);
+        if (ctx.motionRenderbuffer)
+            glDeleteRenderbuffers(1, &ctx.motionRenderbuffer);
+        if (ctx.normalRenderbuffer)
+            glDeleteRenderbuffers(1, &ctx.normalRenderbuffer);
+        glDeleteFramebuffers(1, &ctx.framebuffer);
+    }
+    ctx.release(ctx.reduction);
+    ctx.release(ctx.events);
+    ctx.release(ctx.pixelCounts);
+    ctx.release(ctx.shadows);
+    ctx.release(ctx.panorama);
+    ctx.release(ctx.multisampling);
+    ctx.release(ctx.scaled);
+    ctx.release(ctx.timers);
+    ctx.release(ctx.transforms);
+    ctx.release(ctx.lights);
+    glDeleteSamplers(2, ctx.samplers);
+    glDeleteProgram(ctx.program);
+}
+
+void EGLRenderer::updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph, bool)
+{
+    // CPU only, GPU uploads happen lazily while rendering
+    _reuse.valid = false;
+    _items.clear();
+    _bounds.clear();
+    _overrideBitmaps.clear();
+    _segmentationMode = sceneGraph->segmentationMode();
+    _baseLayer = sceneGraph->baseLayer();
+    _baseLayerChanged = true;
+    prefetchAssets(*sceneGraph); //<- loaded in parallel, consumed in order
+    for (const auto& it : sceneGraph->nodes())
+        updateNode(it.first, it.second);
+    _context->prune = true;
+    _staticItemsChanged = true;
+    _staticShadowStale = true;
+}
+
+void EGLRenderer::applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                                  const scene::SceneGraphDelta& delta)
+{
+    // incremental frames are drawn whole again after any change but poses
+    _reuse.valid = false;
+    // new pixels are uploaded when drawn, from the revisions of the bitmaps
+    if (delta.texelsOnly())
+        return;
+    if (delta.geometryOnly()) {
+        BaseRenderer::applySceneDelta(sceneGraph, delta);
+        for (int nodeId : delta.geometryChanged())
+            _bounds.updateNode(nodeId, sceneGraph->nodes().at(nodeId));
+        _staticShadowStale = true;
+        return;
+    }
+    if (delta.materialsOnly()) {
+        // colors and textures change in place, meshes and bounds are kept
+        for (int nodeId : delta.changed()) {
+            const auto& node = sceneGraph->nodes().at(nodeId);
+            bool updated = true;
+            for (int i = 0; i < int(node.shapes().size()); ++i)
+                updated = updateShapeMaterial(nodeId, i, node.shapes()[i].material()) && updated;
+            if (!updated)
+                updateNode(nodeId, node);
+        }
+        return;
+    }
+
+    _staticItemsChanged = true;
+    _staticShadowStale = true;
+    _baseLayerChanged = _baseLayerChanged || _segmentationMode != sceneGraph->segmentationMode();
+    _segmentationMode = sceneGraph->segmentationMode();
+    for (int nodeId : delta.removed()) {
+        _items.erase(nodeId);
+        _bounds.removeNode(nodeId);
+    }
+    for (const auto* ids : {&delta.added(), &delta.changed(), &delta.geometryChanged()}) {
+        for (int nodeId : *ids) {
+            const auto it = sceneGraph->nodes().find(nodeId);
+            if (it != sceneGraph->nodes().end())
+                updateNode(nodeId, it->second);
+        }
+    }
+    for (int nodeId : delta.geometryChanged()) {
+        const auto it = _items.find(nodeId);
+        if (it != _items.end())
+            for (const auto& item : it->second)
+                if (item.mesh)
+                    _context->dirty.insert(item.mesh.get());
+    }
+    _context->prune = true;
+}
+
+bool EGLRenderer::updateShapeGeometry(int nodeId, int shapeIndex,
+                                      const std::shared_ptr<scene::MeshData>& meshData)
+{
+    _reuse.valid = false;
+    const auto it = _items.find(nodeId);
+    if (it == _items.end() || !meshData->hasNormals())
+        return false;
+
+    for (auto& item : it->second) {
+        if (item.shapeIndex != shapeIndex)
+            continue;
+        if (!item.loaded)
+            loadItem(item);
+        if (item.mesh != meshData)
+            _context->prune = true;
+        item.mesh = meshData;
+        item.lods.clear(); // simplified from the previous geometry
+        _staticItemsChanged |= item.batched;
+        _staticShadowStale = true;
+        _context->dirty.insert(meshData.get());
+        return true;
+    }
+    return false;
+}
+
+bool EGLRenderer::updateShapeHeightfield(int nodeId, int shapeIndex,
+                                         const std::shared_ptr<scene::Heightfield>& heightfield)
+{
+    _reuse.valid = false;
+    const auto it = _items.find(nodeId);
+    if (it == _items.end())
+        return false;
+
+    for (auto& item : it->second) {
+        if (item.shapeIndex != shapeIndex)
+            continue;
+        // drawn as a mesh if too large for a texture
+        if (item.loaded && !item.heightfield)
+            return false;
+        item.shape.setHeightfield(heightfield);
+        if (item.loaded)
+            item.heightfield = heightfield; //<- modified tiles uploaded at the next frame
+        return true;
+    }
+    return false;
+}
+
+bool EGLRenderer::updateShapeMaterial(int nodeId, int shapeIndex,
+                                      const std::shared_ptr<scene::Material>& material)
+{
+    _reuse.valid = false;
+    const auto it = _items.find(nodeId);
+    if (it == _items.end())
+        return false;
+
+    for (auto& item : it->second) {
+        if (item.shapeIndex != shapeIndex)
+            continue;
+        const auto& previous = item.shape.material();
+        const auto& texture = material ? material->diffuseTexture() : nullptr;
+        const auto& previousTexture = previous ? previous->diffuseTexture() : nullptr;
+        item.shape.setMaterial(material);
+        item.color = material ? material->diffuseColor() : Color4f{1.f, 1.f, 1.f, 1.f};
+        _staticItemsChanged |= item.batched;
+        if (item.loaded && texture != previousTexture) {
+            item.bitmap = texture ? textureBitmap(*texture) : nullptr;
+            _context->prune = true; //<- previous texture may be unused
+        }
+        return true;
+    }
+    return true; //<- shape not drawn
+}
+
+bool EGLRenderer::updateShapeTexels(int, int, const std::shared_ptr<scene::Texture>&)
+{
+    _reuse.valid = false;
+    return true; //<- bitmaps of the textures are shared, their revision changed
+}
+
+void EGLRenderer::updateNode(int nodeId, const scene::Node& node)
+{
+    auto& items = _items[nodeId];
+    items.clear();
+    const auto& shapes = node.shapes();
+    for (int i = 0; i < int(shapes.size()); ++i) {
+        const auto& shape = shapes[i];
+        DrawItem item;
+        item.shapeIndex = i;
+        item.shape = shape;
+        item.localMatrix = shape.pose().matrix();
+        item.color = Color4f{1.f, 1.f, 1.f, 1.f};
+        item.segmentation = node.segmentation(i, _segmentationMode);
+        if (const auto& material = shape.material())
+            item.color = material->diffuseColor();
+        if (!_lazyResidency) {
+            loadItem(item);
+            if (!item.mesh && !item.heightfield)
+                continue;
+        }
+        items.push_back(std::move(item));
+    }
+    // after loading meshes, so that mesh files have bounds
+    _bounds.updateNode(nodeId, node);
+}
+
+void EGLRenderer::loadItem(DrawItem& item) const
+{
+    item.loaded = true;
+    const auto& heightfield = item.shape.heightfield();
+    if (heightfield && !item.shape.mesh() && heightfield->columns() <= _maxTextureSize &&
+        heightfield->rows() <= _maxTextureSize) {
+        // tessellated by the vertex shader from a texture of heights
+        item.heightfield = heightfield;
+    }
+    else {
+        auto mesh = loadMeshData(item.shape);
+        if (!mesh || mesh->indices().empty())
+            return;
+        item.mesh = std::move(mesh);
+        item.lods = loadMeshLods(item.shape);
+    }
+    if (const auto& material = item.shape.material()) {
+        if (const auto& texture = material->diffuseTexture())
+            item.bitmap = textureBitmap(*texture);
+    }
+}
+
+const std::shared_ptr<scene::Bitmap>& EGLRenderer::overrideBitmap(
+    const std::shared_ptr<scene::Texture>& texture)
+{
+    static const std::shared_ptr<scene::Bitmap> none;
+    if (!texture)
+        return none;
+    auto& entry = _overrideBitmaps[texture.get()];
+    if (!entry.first) {
+        entry.first = texture; //<- keeps the key alive
+        entry.second = textureBitmap(*texture);
+    }
+    return entry.second;
+}
+
+void EGLRenderer::updateStaticBatches(const scene::SceneState& sceneState)
+{
+    if (!_staticItemsChanged && sceneState.staticGeneration() == _staticGeneration)
+        return;
+
+    // static nodes whose shapes are all loaded opaque meshes, by batch
+    std::map<Context::StaticBatchKey, std::vector<int>> members;
+    for (auto& it : _items)
+        for (auto& item : it.second)
+            item.batched = false;
+    const auto& ids = sceneState.ids();
+    const auto& statics = sceneState.statics();
+    for (size_t slot = 0; slot < ids.size(); ++slot) {
+        const auto it = statics[slot] ? _items.find(ids[slot]) : _items.end();
+        if (it == _items.end() || it->second.empty())
+            continue;
+        const bool batchable =
+            std::all_of(it->second.begin(), it->second.end(), [](const DrawItem& item) {
+                return item.loaded && item.mesh && !item.heightfield && item.color[3] >= 1.f;
+            });
+        if (!batchable)
+            continue;
+        for (auto& item : it->second) {
+            auto& nodeIds = members[{item.bitmap.get(), item.shape.material().get()}];
+            if (nodeIds.empty() || nodeIds.back() != it->first)
+                nodeIds.push_back(it->first);
+            item.batched = true;
+        }
+    }
+
+    // batches of the same nodes are kept unless their shapes changed
+    auto& ctx = *_context;
+    auto& batches = ctx.staticBatches;
+    for (auto it = batches.begin(); it != batches.end();) {
+        if (members.count(it->first)) {
+            ++it;
+            continue;
+        }
+        ctx.release(it->second);
+        it = batches.erase(it);
+    }
+    for (auto& it : members) {
+        auto& nodeIds = it.second;
+        std::sort(nodeIds.begin(), nodeIds.end());
+        auto& batch = batches[it.first];
+        if (!_staticItemsChanged && batch.nodeIds == nodeIds)
+            continue;
+
+        scene::MeshBuilder merged;
+        std::vector<int> segmentation;
+        batch.nodeIds = nodeIds;
+        batch.shapes = 0;
+        batch.bounds = scene::AABB::Empty();
+        for (int nodeId : nodeIds) {
+            for (const auto& item : _items.at(nodeId)) {
+                if (item.bitmap.get() != it.first.first ||
+                    item.shape.material().get() != it.first.second)
+                    continue;
+                const Matrix4f model = multiply(sceneState.matrix(nodeId), item.localMatrix);
+                appendTransformed(*item.mesh, model, item.segmentation, merged, segmentation);
+                batch.bounds.extend(item.mesh->bounds().transformed(model));
+                batch.material = item.shape.material();
+                batch.bitmap = item.bitmap;
+                batch.color = item.color;
+                ++batch.shapes;
+            }
+        }
+        ctx.upload(batch, merged, segmentation);
+    }
+    _staticItemsChanged = false;
+    _staticGeneration = sceneState.staticGeneration();
+}
+
+void EGLRenderer::updateLayerBatches()
+{
+    if (!_baseLayerChanged)
+        return;
+    _baseLayerChanged = false;
+    _staticShadowStale = true;
+    auto& ctx = *_context;
+    ctx.dropLayer();
+    auto& layers = ctx.shared->layers;
+    for (auto it = layers.begin(); it != layers.end();)
+        it = it->second.expired() ? layers.erase(it) : std::next(it);
+    if (!_baseLayer)
+        return;
+
+    // merged by the first renderer of the context drawing the layer
+    auto& entry = layers[{_baseLayer.get(), _segmentationMode}];
+    ctx.layer = entry.lock();
+    if (ctx.layer)
+        return;
+    auto layer = std::make_shared<Context::LayerBatches>();
+    std::map<Context::StaticBatchKey, std::pair<scene::MeshBuilder, std::vector<int>>> merged;
+    for (const auto& it : _baseLayer->nodes()) {
+        const auto& node = it.second;
+        const auto& matrix = _baseLayer->matrix(it.first);
+        for (int i = 0; i < int(node.shapes().size()); ++i) {
+            const auto& shape = node.shapes()[i];
+            const auto mesh = loadMeshData(shape);
+            if (!mesh || mesh->indices().empty())
+                continue;
+            const auto& material = shape.material();
+            std::shared_ptr<scene::Bitmap> bitmap;
+            if (material && material->diffuseTexture())
+                bitmap = textureBitmap(*material->diffuseTexture());
+            const Context::StaticBatchKey key{bitmap.get(), material.get()};
+            auto& batch = layer->batches[key];
+            auto& attributes = merged[key];
+            const Matrix4f model = multiply(matrix, shape.pose().matrix());
+            appendTransformed(*mesh, model, node.segmentation(i, _segmentationMode),
+                              attributes.first, attributes.second);
+            batch.bounds.extend(mesh->bounds().transformed(model));
+            batch.material = material;
+            batch.bitmap = bitmap;
+            batch.color = material ? material->diffuseColor() : Color4f{1.f, 1.f, 1.f, 1.f};
+            batch.nodeIds.push_back(it.first);
+            ++batch.shapes;
+        }
+    }
+    for (auto& it : layer->batches) {
+        ctx.upload(it.second, merged[it.first].first, merged[it.first].second);
+        layer->bounds.extend(it.second.bounds);
+    }
+    entry = layer;
+    ctx.layer = std::move(layer);
+}
+
+bool EGLRenderer::updateShadowMap(const scene::SceneState& sceneState, const scene::Light& light,
+                                  const scene::Camera* camera)
+{
+    auto& ctx = *_context;
+    auto bounds = _bvh.bounds();
+    if (ctx.layer)
+        bounds.extend(ctx.layer->bounds);
+    _cascades.count = 0;
+    if (bounds.empty() || _shadowMapSize <= 0)
+        return false;
+
+    // cascades over the finite nodes the camera sees, over all of them if it sees none
+    if (camera && _shadowCascades > 0) {
+        const scene::Frustum frustum(multiply(camera->projMatrix(), camera->viewMatrix()));
+        _bvh.query(frustum, _visibleNodes, _bvhStack);
+        auto receivers = scene::AABB::Empty();
+        for (int nodeId : _visibleNodes) {
+            const auto box = _bvh.worldBounds(nodeId);
+            if (!box.infinite())
+                receivers.extend(box);
+        }
+        if (ctx.layer && frustum.intersects(ctx.layer->bounds))
+            receivers.extend(ctx.layer->bounds);
+        fitShadowCascades(light.direction(), camera->viewMatrix(), camera->projMatrix(),
+                          receivers.empty() ? bounds : receivers, bounds, _shadowCascades,
+                          _shadowMapSize, _cascades);
+    }
+
+    // the projection covers the scene with a margin, refitted once nodes move out of it
+    bool contained = !_shadowBox.empty();
+    for (int k = 0; k < 3; ++k)
+        contained = contained && bounds.lower[k] >= _shadowBox.lower[k] &&
+                    bounds.upper[k] <= _shadowBox.upper[k];
+    const bool refit = !contained || light.direction() != _shadowDirection;
+    if (refit) {
+        for (int k = 0; k < 3; ++k) {
+            const float margin = (bounds.upper[k] - bounds.lower[k]) / 4 + 1e-3f;
+            _shadowBox.lower[k] = bounds.lower[k] - margin;
+            _shadowBox.upper[k] = bounds.upper[k] + margin;
+        }
+        _shadowDirection = light.direction();
+        _lightViewProj = lightProjection(_shadowDirection, _shadowBox);
+    }
+    const bool stale = refit || _staticShadowStale || ctx.shadows.size != _shadowMapSize ||
+                       sceneState.staticGeneration() != _shadowStaticGeneration;
+
+    // depth only, at full detail
+    glUniformMatrix4fv(ctx.viewProj, 1, GL_FALSE, _lightViewProj.data());
+    glUniform1i(ctx.textured, 0);
+    glUniform1i(ctx.shadowed, 0);
+    glUniform1i(ctx.maskOnly, 1);
+    glUniform1i(ctx.heightfield, 0);
+    // transforms of the casters streamed at once, then drawn by index, those out of the
+    // projection of a cascade left out
+    const auto drawCasters = [&](bool statics, const scene::Frustum* cascade) {
+        _casters.clear();
+        ctx.transformData.clear();
+        for (const auto& it : _items) {
+            if (!sceneState.hasNode(it.first) || sceneState.isStatic(it.first) != statics ||
+                (cascade && !cascade->intersects(_bvh.worldBounds(it.first))))
+                continue;
+            const auto& matrix = sceneState.matrix(it.first);
+            for (const auto& item : it.second) {
+                // heightfields are left to receive shadows
+                if (!item.mesh || item.heightfield || item.batched)
+                    continue;
+                const Matrix4f model = multiply(matrix, item.localMatrix);
+                ctx.transformData.insert(ctx.transformData.end(), model.data(), model.data() + 16);
+                ctx.transformData.insert(ctx.transformData.end(), model.data(), model.data() + 16);
+                _casters.push_back(&item);
+            }
+        }
+        if (_casters.empty())
+            return 0;
+        const int first = ctx.streamTransforms();
+        for (size_t i = 0; i < _casters.size(); ++i) {
+            glUniform1i(ctx.transformIndex, first + int(i));
+            const auto& mesh = ctx.mesh(_casters[i]->mesh);
+            ctx.dequantize(mesh);
+            glBindVertexArray(mesh.vao);
+            glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, nullptr);
+        }
+        glUniform1i(ctx.transformIndex, -1);
+        return int(_casters.size());
+    };
+
+    static const Matrix4f identity = Affine3f::Identity().matrix();
+    const auto drawBatches = [&]() {
+        glUniformMatrix4fv(ctx.model, 1, GL_FALSE, identity.data());
+        glUniform1i(ctx.batched, 1);
+        const auto drawMerged = [&](std::map<Context::StaticBatchKey, Context::StaticBatch>& b) {
+            for (auto& it : b) {
+                ctx.dequantize(it.second.mesh);
+                glBindVertexArray(it.second.mesh.vao);
+                glDrawElements(GL_TRIANGLES, it.second.mesh.indexCount, it.second.mesh.indexType,
+                               nullptr);
+            }
+        };
+        drawMerged(ctx.staticBatches);
+        if (ctx.layer)
+            drawMerged(ctx.layer->batches);
+        glUniform1i(ctx.batched, 0);
+    };
+
+    // cascades depend on the camera, all the casters are drawn into their tiles for each view
+    // over the map of all casters, drawn again from the static one once back to the scene map
+    if (_cascades.count > 0) {
+        ctx.beginPass(Stage::GpuShadow);
+        ctx.beginShadowPass(1, _shadowMapSize, false);
+        ctx.shadowCasters = 0;
+        for (int i = 0; i < _cascades.count; ++i) {
+            const float* tile = _cascades.tiles + i * 4;
+            const int tileSize = int(tile[2] * float(_shadowMapSize));
+            glViewport(int(tile[0] * float(_shadowMapSize)), int(tile[1] * float(_shadowMapSize)),
+                       tileSize, tileSize);
+            glUniformMatrix4fv(ctx.viewProj, 1, GL_FALSE, _cascades.viewProjs[i].data());
+            const scene::Frustum frustum(_cascades.viewProjs[i]);
+            drawBatches();
+            drawCasters(true, &frustum);
+            ctx.shadowCasters += drawCasters(false, &frustum);
+        }
+        ctx.shadows.sampled = 1;
+        _shadowState = nullptr;
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glBindVertexArray(0);
+        return true;
+    }
+
+    // static casters, kept until the light, the projection or the static nodes change
+    if (stale) {
+        ctx.beginPass(Stage::GpuShadow);
+        ctx.beginShadowPass(0, _shadowMapSize, false);
+        drawBatches();
+        drawCasters(true, nullptr);
+        ++ctx.staticShadowUpdates;
+        _staticShadowStale = false;
+        _shadowStaticGeneration = sceneState.staticGeneration();
+    }
+
+    // dynamic casters over a copy of them, once per scene state for all its views
+    if (stale || &sceneState != _shadowState || sceneState.generation() != _shadowPoses) {
+        ctx.beginPass(Stage::GpuShadow);
+        ctx.beginShadowPass(1, _shadowMapSize, true);
+        ctx.shadowCasters = drawCasters(false, nullptr);
+        ctx.shadows.sampled = ctx.shadowCasters > 0 ? 1 : 0;
+        _shadowState = &sceneState;
+        _shadowPoses = sceneState.generation();
+    }
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindVertexArray(0);
+    return true;
+}
+
+ResidencyStats EGLRenderer::residencyStats() const
+{
+    ResidencyStats stats;
+    const auto& ctx = *_context;
+    std::lock_guard<std::mutex> lock(ctx.shared->mutex);
+    stats.residentBytes = ctx.shared->residentBytes;
+    stats.peakResidentBytes = ctx.shared->peakResidentBytes;
+    stats.bufferBytes = ctx.bufferBytes();
+    stats.textureBytes = ctx.textureBytes();
+    stats.framebufferBytes = ctx.framebufferBytes();
+    stats.residentMeshes = int(ctx.shared->meshes.size() + ctx.heightfields.size());
+    stats.residentTextures = int(ctx.shared->textures.size());
+    stats.textureArrays = int(ctx.shared->textureArrays.size());
+    for (const auto& it : _items)
+        for (const auto& item : it.second)
+            ++(item.loaded ? stats.loadedShapes : stats.deferredShapes);
+    stats.uploads = ctx.uploads;
+    stats.evictions = ctx.evictions;
+    stats.tileUploads = ctx.tileUploads;
+    stats.texelUploads = ctx.texelUploads;
+    stats.streamedBytes = ctx.streamedBytes;
+    stats.mipEvictions = ctx.mipEvictions;
+    stats.pendingTextures = ctx.pendingTextures;
+    std::set<const scene::Material*> materials;
+    for (const auto& it : _items)
+        for (const auto& item : it.second)
+            if (item.loaded && item.shape.material())
+                materials.insert(item.shape.material().get());
+    stats.uniqueMaterials = int(materials.size());
+    stats.materialSwitches = ctx.materialSwitches;
+    stats.textureBinds = ctx.textureBinds;
+    stats.indirectShapes = ctx.indirectShapes;
+    stats.multiDraws = ctx.multiDraws;
+    stats.drawnNodes = ctx.drawnNodes;
+    stats.frustumCulledNodes = ctx.frustumCulledNodes;
+    stats.occludedNodes = ctx.occludedNodes;
+    stats.opaqueShapes = ctx.opaqueShapes;
+    stats.blendedShapes = ctx.blendedShapes;
+    stats.staticShadowUpdates = ctx.staticShadowUpdates;
+    stats.shadowCasters = ctx.shadowCasters;
+    stats.redrawnPixels = ctx.redrawnPixels;
+    stats.staticBatches = int(ctx.staticBatches.size());
+    for (const auto& it : ctx.staticBatches)
+        stats.batchedShapes += it.second.shapes;
+    return stats;
+}
+
+RendererMemory EGLRenderer::memoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(_memoryMutex);
+    return _memory;
+}
+
+bool EGLRenderer::uploadAssets(const scene::Shape& shape)
+{
+    auto mesh = shape.heightfield() && !shape.mesh() ? nullptr : loadMeshData(shape);
+    if (mesh && mesh->indices().empty())
+        mesh = nullptr;
+    std::vector<std::shared_ptr<scene::MeshData>> lods;
+    if (mesh)
+        lods = loadMeshLods(shape);
+    const auto& material = shape.material();
+    const auto texture = material ? material->diffuseTexture() : nullptr;
+    const auto bitmap = texture ? textureBitmap(*texture) : nullptr;
+    if (!mesh && !bitmap)
+        return false;
+
+    auto& ctx = *_context;
+    auto& shared = *ctx.shared;
+    CurrentContext current(shared.mutex, shared.display, shared.surface, shared.context);
+    ctx.streamBudget = _textureUploadBudget;
+    if (mesh)
+        ctx.mesh(mesh);
+    for (const auto& lod : lods)
+        ctx.mesh(lod);
+    if (bitmap)
+        ctx.texture(bitmap);
+    glBindVertexArray(0);
+    return true;
+}
+
+void EGLRenderer::publishMemory()
+{
+    const auto& ctx = *_context;
+    std::lock_guard<std::mutex> lock(_memoryMutex);
+    _memory.gpuBytes = ctx.gpuBytes();
+    _memory.peakGpuBytes = std::max(_memory.peakGpuBytes, _memory.gpuBytes);
+    if (_deviceLease)
+        _deviceLease->setBytes(_memory.gpuBytes);
+    if (_memoryUploads == ctx.uploads)
+        return;
+    // bitmaps loaded for texture files, those of the scene graph are accounted with it
+    std::set<const uint8_t*> bitmaps;
+    _memory.hostBytes = 0;
+    for (const auto& it : _items) {
+        for (const auto& item : it.second) {
+            const auto& material = item.shape.material();
+            const auto texture = material ? material->diffuseTexture() : nullptr;
+            if (item.bitmap && texture && !texture->bitmap() &&
+                bitmaps.insert(item.bitmap->data()).second)
+                _memory.hostBytes += item.bitmap->size();
+        }
+    }
+    _memoryUploads = ctx.uploads;
+}
+
+Vector4i EGLRenderer::redrawRegion(const scene::SceneState& sceneState,
+                                   const scene::SceneView& sceneView, const scene::Camera& camera,
+                                   bool shadowed)
+{
+    auto& ctx = *_context;
+    const Vector4i whole{0, 0, ctx.cols, ctx.rows};
+    // settings of the motion and event channels and the keypoints change every frame without
+    // changing the image, the camera and light are copied as their owners change them in place
+    scene::SceneView view = sceneView;
+    view.setPreviousCamera(nullptr);
+    view.setPreviousState(nullptr);
+    view.setEventTime(0.);
+    view.setKeypoints(nullptr);
+    if (sceneView.camera())
+        view.setCamera(std::make_shared<scene::Camera>(*sceneView.camera()));
+    if (sceneView.light())
+        view.setLight(std::make_shared<scene::Light>(*sceneView.light()));
+
+    auto& last = _reuse;
+    const auto& ids = sceneState.ids();
+    const auto& matrices = sceneState.matrices();
+    bool kept = last.valid && last.cols == ctx.cols && last.rows == ctx.rows &&
+                last.samples == ctx.multisampling.samples && last.shadowed == shadowed &&
+                last.view == view && last.ids == ids;
+    if (kept && shadowed) {
+        kept = last.lightViewProj == _lightViewProj && last.cascades.count == _cascades.count &&
+               std::equal(last.cascades.viewProjs, last.cascades.viewProjs + _cascades.count,
+                          _cascades.viewProjs) &&
+               std::equal(last.cascades.tiles, last.cascades.tiles + _cascades.count * 4,
+                          _cascades.tiles);
+    }
+
+    // world bounds of the nodes at their poses, those of nodes without shapes empty
+    const auto worldBounds = [this](int nodeId, const Matrix4f& matrix) {
+        const auto it = _bounds.nodes().find(nodeId);
+        return it != _bounds.nodes().end() ? it->second.transformed(matrix)
+                                           : scene::AABB::Empty();
+    };
+    // tiles covered by the nodes which moved, before and after, with their shadows
+    Vector4i rect{ctx.cols, ctx.rows, 0, 0};
+    if (kept) {
+        const Matrix4f viewProj = multiply(camera.projMatrix(), camera.viewMatrix());
+        auto scene = _shadowBox;
+        if (ctx.layer)
+            scene.extend(ctx.layer->bounds);
+        const auto extend = [&](const scene::AABB& box) {
+            return extendScreenRect(viewProj,
+                                    shadowed ? shadowBounds(box, _shadowDirection, scene) : box,
+                                    ctx.cols, ctx.rows, rect);
+        };
+        for (size_t slot = 0; kept && slot < ids.size(); ++slot) {
+            if (matrices[slot] == last.matrices[slot])
+                continue;
+            const auto bounds = worldBounds(ids[slot], matrices[slot]);
+            kept = extend(last.bounds[slot]) && extend(bounds);
+        }
+        // no gain from scissoring most of the frame
+        kept = kept && (rect[2] <= rect[0] || rect[3] <= rect[1] ||
+                        2 * int64_t(rect[2] - rect[0]) * (rect[3] - rect[1]) <=
+                            int64_t(ctx.cols) * ctx.rows);
+    }
+
+    last.valid = true;
+    last.cols = ctx.cols;
+    last.rows = ctx.rows;
+    last.samples = ctx.multisampling.samples;
+    last.shadowed = shadowed;
+    last.lightViewProj = _lightViewProj;
+    last.cascades = _cascades;
+    last.view = std::move(view);
+    last.ids = ids;
+    last.matrices = matrices;
+    last.bounds.resize(ids.size());
+    for (size_t slot = 0; slot < ids.size(); ++slot)
+        last.bounds[slot] = worldBounds(ids[slot], matrices[slot]);
+    if (!kept)
+        return whole;
+    if (rect[2] <= rect[0] || rect[3] <= rect[1])
+        return {0, 0, 0, 0};
+    return {rect[0], rect[1], rect[2] - rect[0], rect[3] - rect[1]};
+}
+
+void EGLRenderer::drawView(const scene::SceneState& sceneState, const scene::SceneView& sceneView,
+                           const scene::Camera& camera, bool flipped, bool shadowed,
+                           std::set<int>& loadedNodes, const std::vector<scene::Camera>& views)
+{
+    auto& ctx = *_context;
+    // views of multiview frames are culled at once, levels of detail picked for the first one,
+    // without occlusion culling as their depth is not that of a single view
+    const int viewCount = std::max(int(views.size()), 1);
+    const bool multiview = viewCount > 1;
+    const int viewRows = ctx.rows / viewCount;
+    const bool occlusionCulling = _occlusionCulling && !multiview;
+    const scene::Frustum frustum =
+        multiview ? sceneView.multiviewFrustum()
+                  : scene::Frustum(multiply(camera.projMatrix(), camera.viewMatrix()));
+    const auto& light = sceneView.light();
+    glUseProgram(ctx.program);
+    glUniform1i(ctx.maskOnly, _maskOnly ? 1 : 0);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glDepthMask(GL_TRUE);
+    // occluders are timed as a pre-pass up to their depth reduction
+    ctx.beginPass(occlusionCulling ? Stage::GpuPrepass : Stage::GpuMain);
+    glBindFramebuffer(GL_FRAMEBUFFER, ctx.target());
+    glViewport(0, 0, ctx.cols, ctx.rows);
+    const auto& bg = sceneView.backgroundColor();
+    const GLfloat background[] = {bg[0], bg[1], bg[2], 1.f};
+    const GLint noMask[] = {-1, 0, 0, 0};
+    const GLfloat noDepth[] = {0.f, 0.f, 0.f, 0.f};
+    glClearBufferfv(GL_COLOR, 0, background);
+    glClearBufferiv(GL_COLOR, 1, noMask);
+    glClearBufferfv(GL_COLOR, 2, noDepth);
+    if (ctx.pointOutput)
+        glClearBufferfv(GL_COLOR, 3, noDepth);
+    if (ctx.shortOutput) {
+        const GLuint noShortDepthMask[] = {0, 0xFFFF, 0, 0};
+        glClearBufferuiv(GL_COLOR, 4, noShortDepthMask);
+    }
+    if (ctx.motionOutput)
+        glClearBufferfv(GL_COLOR, 5, noDepth);
+    if (ctx.normalOutput)
+        glClearBufferfv(GL_COLOR, 6, noDepth);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    // default light close to the one of the python renderers
+    Vector3f direction{0.8f, 0.2f, -2.f};
+    Color3f ambient{0.7f, 0.7f, 0.7f}, diffuse{0.3f, 0.3f, 0.3f};
+    if (light) {
+        direction = light->direction();
+        ambient = light->ambientColor();
+        diffuse = light->diffuseColor();
+    }
+
+    Matrix4f viewProj = multiply(camera.projMatrix(), camera.viewMatrix());
+    if (flipped) {
+        for (int col = 0; col < 4; ++col)
+            viewProj[col * 4 + 1] = -viewProj[col * 4 + 1];
+    }
+    glUniformMatrix4fv(ctx.view, 1, GL_FALSE, camera.viewMatrix().data());
+    glUniformMatrix4fv(ctx.viewProj, 1, GL_FALSE, viewProj.data());
+    glUniform1i(ctx.viewCount, viewCount);
+    if (multiview) {
+        // bands top to bottom in view order, bottom to top in the targets of images upside down
+        GLfloat viewMatrices[16 * scene::kMaxViews], viewProjs[16 * scene::kMaxViews];
+        GLfloat viewBands[scene::kMaxViews];
+        for (int i = 0; i < viewCount; ++i) {
+            Matrix4f matrix = multiply(views[i].projMatrix(), views[i].viewMatrix());
+            if (flipped) {
+                for (int col = 0; col < 4; ++col)
+                    matrix[col * 4 + 1] = -matrix[col * 4 + 1];
+            }
+            std::copy_n(views[i].viewMatrix().data(), 16, viewMatrices + 16 * i);
+            std::copy_n(matrix.data(), 16, viewProjs + 16 * i);
+            viewBands[i] = float(viewCount - 1 - 2 * i) * (flipped ? -1.f : 1.f);
+        }
+        glUniformMatrix4fv(ctx.viewMatrices, viewCount, GL_FALSE, viewMatrices);
+        glUniformMatrix4fv(ctx.viewProjs, viewCount, GL_FALSE, viewProjs);
+        glUniform1fv(ctx.viewBands, viewCount, viewBands);
+        glEnable(GL_CLIP_DISTANCE0);
+        glEnable(GL_CLIP_DISTANCE1);
+    }
+    glUniform1i(ctx.heightfield, 0);
+    glUniform1i(ctx.batched, 0);
+    glUniform1i(ctx.pointsInWorld, sceneView.pointFrame() == scene::PointFrame::World ? 1 : 0);
+    // motion from the previous camera and poses, those of the view and nodes without them
+    const auto* previousState = ctx.motionOutput ? sceneView.previousState().get() : nullptr;
+    if (ctx.motionOutput) {
+        const auto previous = sceneView.previousImageCamera();
+        const Matrix4f previousViewProj = multiply(previous.projMatrix(), previous.viewMatrix());
+        const GLfloat imageSize[] = {GLfloat(ctx.cols), GLfloat(ctx.rows)};
+        glUniformMatrix4fv(ctx.previousViewProj, 1, GL_FALSE, previousViewProj.data());
+        glUniform2fv(ctx.imageSize, 1, imageSize);
+    }
+    glUniform1f(ctx.depthScale, sceneView.depthScale());
+    // projective textures in the same pass, the projector replaces the uv of textured shapes
+    const auto& projector = sceneView.projectiveTexture();
+    glUniform1i(ctx.projective, projector ? 1 : 0);
+    if (projector) {
+        const Matrix4f projectorViewProj =
+            multiply(projector->projMatrix(), projector->viewMatrix());
+        glUniformMatrix4fv(ctx.projectorViewProj, 1, GL_FALSE, projectorViewProj.data());
+    }
+    glUniform3fv(ctx.lightDirection, 1, direction.data());
+    glUniform3fv(ctx.ambientColor, 1, ambient.data());
+    glUniform3fv(ctx.diffuseColor, 1, diffuse.data());
+    // local lights clustered over the view; multiview frames light every pixel by the nearest
+    // bounded lights of the first view, as many as a cluster lists
+    auto& clusters = ctx.lights.clusters;
+    if (!sceneView.lights().empty() || !clusters.lights.empty()) {
+        Matrix4f proj = camera.projMatrix();
+        if (flipped) {
+            for (int col = 0; col < 4; ++col)
+                proj[col * 4 + 1] = -proj[col * 4 + 1];
+        }
+        buildLightClusters(sceneView.lights(), camera.viewMatrix(), proj, clusters);
+        if (!clusters.lights.empty())
+            ctx.uploadLights();
+    }
+    glUniform1i(ctx.unboundedLights, clusters.unbounded);
+    glUniform1i(ctx.boundedLights, multiview ? std::min(clusters.bounded,
+                                                        int(LightClusters::kMaxClusterLights))
+                                             : clusters.bounded);
+    glUniform1i(ctx.clustered, multiview ? 0 : 1);
+    glUniform2f(ctx.clusterDepth, clusters.nearDepth, clusters.sliceScale);
+    glUniform1i(ctx.shadowed, shadowed ? 1 : 0);
+    if (shadowed) {
+        glUniformMatrix4fv(ctx.lightViewProj, 1, GL_FALSE, _lightViewProj.data());
+        glUniform1i(ctx.shadowCascades, _cascades.count);
+        if (_cascades.count > 0) {
+            glUniformMatrix4fv(ctx.cascadeViewProjs, _cascades.count, GL_FALSE,
+                               _cascades.viewProjs[0].data());
+            glUniform4fv(ctx.cascadeTiles, _cascades.count, _cascades.tiles);
+        }
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, ctx.shadows.textures[ctx.shadows.sampled]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    ctx.setTextureFilter(sceneView.quality().textureFilter);
+    _bvh.query(frustum, _visibleNodes, _bvhStack);
+
+    // visible shapes, loaded on first sight in lazy residency mode, with the materials of the
+    // view drawn instead of their own ones, those of static batches drawn with them unless
+    // the view overrides materials or hides layers from its cameras
+    const auto& overrides = sceneView.materialOverrides();
+    const bool layered = sceneView.filtersLayers();
+    const bool batches = !overrides && !layered;
+    auto& opaque = _opaque;
+    auto& blended = _blended;
+    opaque.clear();
+    blended.clear();
+    int order = 0; //<- position in scene order of the next shape
+    const auto collect = [&](int nodeId) {
+        const auto it = _items.find(nodeId);
+        if (it == _items.end())
+            return;
+        for (auto& item : it->second) {
+            if (!item.loaded) {
+                // mesh files learn their bounds
+                loadItem(item);
+                loadedNodes.insert(nodeId);
+            }
+            if ((!item.mesh && !item.heightfield) || (batches && item.batched) ||
+                (layered && !sceneView.visible(nodeId, item.shapeIndex)))
+                continue;
+            Draw draw{nodeId, &item, item.shape.material().get(), &item.color, &item.bitmap,
+                      order++, 0.f};
+            if (overrides) {
+                const auto found = overrides->find({nodeId, item.shapeIndex});
+                if (found != overrides->end() && found->second) {
+                    draw.material = found->second.get();
+                    draw.color = &found->second->diffuseColor();
+                    draw.bitmap = &overrideBitmap(found->second->diffuseTexture());
+                }
+            }
+            if (ctx.streamBudget && *draw.bitmap && std::get<4>(Context::arrayKey(**draw.bitmap))) {
+                // streamed textures wanted as fine as their largest node on screen
+                const float size =
+                    scene::LodPolicy::screenSize(_bvh.worldBounds(nodeId), camera, ctx.rows);
+                float& demand = ctx.textureDemand[draw.bitmap->get()];
+                demand = std::max(demand, size);
+            }
+            // transparent as Material::transparent(), with the color of the view
+            ((*draw.color)[3] < 1.f ? blended : opaque).push_back(draw);
+        }
+    };
+    // opaque shapes grouped by shader path, texture array, texture and material, in scene
+    // order within a group as a stable sort would without its buffer, blended ones back to
+    // front
+    const auto state = [](const Draw& draw) {
+        const auto& bitmap = *draw.bitmap;
+        return std::make_tuple(bool(draw.item->heightfield),
+                               bitmap ? Context::arrayKey(*bitmap) : Context::TextureArrayKey{},
+                               reinterpret_cast<uintptr_t>(bitmap.get()),
+                               reinterpret_cast<uintptr_t>(draw.material), draw.order);
+    };
+    const auto sortOpaque = [&]() {
+        std::sort(opaque.begin(), opaque.end(),
+                  [&](const Draw& a, const Draw& b) { return state(a) < state(b); });
+    };
+
+    // material uniforms and texture only change between groups
+    const scene::Material* material = nullptr;
+    const scene::Bitmap* bitmap = nullptr;
+    bool first = true;
+    ctx.shared->boundArray = 0;
+    const auto useMaterial = [&](const scene::Material* drawMaterial, const Color4f& color,
+                                 const std::shared_ptr<scene::Bitmap>& drawBitmap) {
+        if ((!first && drawMaterial == material && drawBitmap.get() == bitmap) || _maskOnly)
+            return;
+        material = drawMaterial;
+        ++ctx.materialSwitches;
+        glUniform4fv(ctx.diffuse, 1, color.data());
+        if (first || drawBitmap.get() != bitmap) {
+            bitmap = drawBitmap.get();
+            glUniform1i(ctx.textured, bitmap ? 1 : 0);
+            if (bitmap) {
+                const auto& texture = ctx.texture(drawBitmap);
+                ctx.bind(texture);
+                glUniform1i(ctx.textureLayer, texture.layer);
+            }
+        }
+        first = false;
+    };
+    // leading mesh shapes of a sorted opaque list drawn by indirect commands culled on the GPU,
+    // a multi-draw per texture array, their materials read from draw records
+    const bool indirect = _indirectDraws && ctx.indirectDraws.supported;
+    if (indirect && !ctx.indirectDraws.program)
+        ctx.compileIndirectDraws();
+    const auto drawIndirect = [&](const std::vector<Draw>& draws, int firstTransform) {
+        auto& d = ctx.indirectDraws;
+        d.records.clear();
+        d.culls.clear();
+        d.groups.clear();
+        const Context::TextureArrayKey* array = nullptr;
+        size_t count = 0;
+        for (; count < draws.size() && !draws[count].item->heightfield; ++count) {
+            const auto& draw = draws[count];
+            const auto& item = *draw.item;
+            const int level =
+                _lodPolicy.select(item.mesh->bounds().transformed(_drawModels[count]), camera,
+                                  viewRows, int(item.lods.size()) + 1);
+            const auto& mesh = ctx.arenaMesh(level > 0 ? item.lods[level - 1] : item.mesh);
+            const Context::GpuTexture* texture = nullptr;
+            if (*draw.bitmap)
+                texture = &ctx.texture(*draw.bitmap);
+            if (d.groups.empty() || (texture && (!array || *array != texture->array))) {
+                d.groups.emplace_back(count, texture);
+                if (texture)
+                    array = &texture->array;
+            }
+            const auto& color = *draw.color;
+            const GLint record[] = {firstTransform + GLint(count), item.segmentation,
+                                    texture ? texture->layer : -1, 0};
+            d.records.insert(d.records.end(), record, record + 4);
+            for (float channel : color) {
+                GLint bits;
+                std::memcpy(&bits, &channel, sizeof(bits));
+                d.records.push_back(bits);
+            }
+            d.culls.push_back({mesh.sphere, mesh.indexCount, mesh.firstIndex, mesh.baseVertex,
+                               firstTransform + GLint(count)});
+        }
+        if (!count)
+            return count;
+        ctx.cullIndirect(frustum, viewCount);
+        glUniform1i(ctx.indirect, 1);
+        ctx.dequantize(Context::GpuMesh());
+        glBindVertexArray(d.vao);
+        glVertexAttribDivisor(4, GLuint(viewCount));
+        for (size_t g = 0; g < d.groups.size(); ++g) {
+            const size_t begin = d.groups[g].first;
+            const size_t end = g + 1 < d.groups.size() ? d.groups[g + 1].first : count;
+            if (d.groups[g].second)
+                ctx.bind(*d.groups[g].second);
+            glMultiDrawElementsIndirect(
+                GL_TRIANGLES, GL_UNSIGNED_INT,
+                reinterpret_cast<const void*>(begin * sizeof(Context::IndirectDraws::Command)),
+                GLsizei(end - begin), 0);
+            ++ctx.multiDraws;
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glUniform1i(ctx.indirect, 0);
+        ctx.indirectShapes += int(count);
+        // uniforms of the next material set again
+        first = true;
+        return count;
+    };
+    // transforms of a list streamed at once, then drawn by index, opaque lists by indirect
+    // commands when enabled
+    const auto drawShapes = [&](const std::vector<Draw>& draws, bool sorted) {
+        if (draws.empty())
+            return;
+        _drawModels.clear();
+        ctx.transformData.clear();
+        for (const auto& draw : draws) {
+            const auto& item = *draw.item;
+            const Matrix4f model = multiply(sceneState.matrix(draw.nodeId), item.localMatrix);
+            const bool moved =
+                ctx.motionOutput && previousState && previousState->hasNode(draw.nodeId);
+            const Matrix4f previousModel =
+                moved ? multiply(previousState->matrix(draw.nodeId), item.localMatrix) : model;
+            ctx.transformData.insert(ctx.transformData.end(), model.data(), model.data() + 16);
+            ctx.transformData.insert(ctx.transformData.end(), previousModel.data(),
+                                     previousModel.data() + 16);
+            _drawModels.push_back(model);
+        }
+        const int firstTransform = ctx.streamTransforms();
+        const size_t indirectCount = indirect && sorted ? drawIndirect(draws, firstTransform) : 0;
+        for (size_t i = indirectCount; i < draws.size(); ++i) {
+            const auto& draw = draws[i];
+            const auto& item = *draw.item;
+            const Matrix4f& model = _drawModels[i];
+            glUniform1i(ctx.transformIndex, firstTransform + int(i));
+            useMaterial(draw.material, *draw.color, *draw.bitmap);
+            glUniform1i(ctx.segmentation, item.segmentation);
+            if (item.heightfield) {
+                ctx.drawHeightfield({draw.nodeId, item.shapeIndex}, *item.heightfield, model,
+                                    camera, frustum, viewRows, _lodPolicy, viewCount);
+                continue;
+            }
+            const int level =
+                _lodPolicy.select(item.mesh->bounds().transformed(model), camera,
+                                  viewRows, int(item.lods.size()) + 1);
+            const auto& mesh = ctx.mesh(level > 0 ? item.lods[level - 1] : item.mesh);
+            ctx.dequantize(mesh);
+            glBindVertexArray(mesh.vao);
+            glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, mesh.indexType, nullptr,
+                                    viewCount);
+        }
+        glUniform1i(ctx.transformIndex, -1);
+    };
+
+    // with occlusion culling, the nodes large on screen are drawn first as occluders
+    _occluders.clear();
+    for (int nodeId : _visibleNodes) {
+        if (occlusionCulling) {
+            const auto bounds = _bvh.worldBounds(nodeId);
+            if (bounds.infinite() ||
+                scene::LodPolicy::screenSize(bounds, camera, ctx.rows) < _occluderSize)
+                continue;
+            _occluders.push_back(nodeId);
+        }
+        collect(nodeId);
+    }
+    sortOpaque();
+    ctx.opaqueShapes += int(opaque.size());
+
+    // static batches first, in world space at full detail
+    bool batchDrawn = false;
+    const auto drawBatches = [&](std::map<Context::StaticBatchKey, Context::StaticBatch>& merged,
+                                 bool solid) {
+        static const Matrix4f identity = Affine3f::Identity().matrix();
+        glUniformMatrix4fv(ctx.model, 1, GL_FALSE, identity.data());
+        glUniformMatrix4fv(ctx.previousModel, 1, GL_FALSE, identity.data());
+        glUniform1i(ctx.batched, 1);
+        for (auto& it : merged) {
+            auto& batch = it.second;
+            if ((batch.color[3] >= 1.f) != solid || !frustum.intersects(batch.bounds))
+                continue;
+            useMaterial(batch.material.get(), batch.color, batch.bitmap);
+            ctx.dequantize(batch.mesh);
+            glBindVertexArray(batch.mesh.vao);
+            glDrawElementsInstanced(GL_TRIANGLES, batch.mesh.indexCount, batch.mesh.indexType,
+                                    nullptr, viewCount);
+            batchDrawn = true;
+        }
+        glUniform1i(ctx.batched, 0);
+    };
+    if (batches && !ctx.staticBatches.empty())
+        drawBatches(ctx.staticBatches, true);
+    // the base layer keeps its own materials, it is not part of the scene of the renderer
+    if (ctx.layer)
+        drawBatches(ctx.layer->batches, true);
+    drawShapes(opaque, true);
+
+    // then the other nodes in view not hidden behind the occluders, tested down the BVH
+    ctx.frustumCulledNodes += _bvh.size() - int(_visibleNodes.size());
+    if (occlusionCulling) {
+        if (!_occluders.empty() || batchDrawn)
+            ctx.reduceDepth(_depthPyramid);
+        else
+            _depthPyramid.clear();
+        ctx.beginPass(Stage::GpuMain);
+        const auto& view = camera.viewMatrix();
+        _bvh.query(
+            frustum,
+            [&](const scene::AABB& box) { return _depthPyramid.occluded(box, viewProj, view); },
+            _unoccludedNodes, _bvhStack);
+        opaque.clear();
+        auto occluder = _occluders.begin();
+        for (int nodeId : _unoccludedNodes) {
+            while (occluder != _occluders.end() && *occluder < nodeId)
+                ++occluder;
+            if (occluder == _occluders.end() || *occluder != nodeId)
+                collect(nodeId);
+        }
+        sortOpaque();
+        ctx.opaqueShapes += int(opaque.size());
+        drawShapes(opaque, true);
+        ctx.occludedNodes += int(_visibleNodes.size() - _unoccludedNodes.size());
+    }
+
+    ctx.drawnNodes += int((occlusionCulling ? _unoccludedNodes : _visibleNodes).size());
+
+    // blended shapes over the opaque ones, farthest first, in scene order at equal depths
+    const auto& view = camera.viewMatrix();
+    for (auto& draw : blended) {
+        const Matrix4f model = multiply(sceneState.matrix(draw.nodeId), draw.item->localMatrix);
+        draw.depth = -(view[2] * model[12] + view[6] * model[13] + view[10] * model[14] + view[14]);
+    }
+    std::sort(blended.begin(), blended.end(), [](const Draw& a, const Draw& b) {
+        return a.depth != b.depth ? a.depth > b.depth
+                                  : std::make_pair(a.nodeId, a.order) <
+                                        std::make_pair(b.nodeId, b.order);
+    });
+    ctx.blendedShapes += int(blended.size());
+    glEnablei(GL_BLEND, 0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    drawShapes(blended, false);
+    if (ctx.layer)
+        drawBatches(ctx.layer->batches, false);
+    glDisablei(GL_BLEND, 0);
+    glBindVertexArray(0);
+    if (multiview) {
+        glUniform1i(ctx.viewCount, 1);
+        glDisable(GL_CLIP_DISTANCE0);
+        glDisable(GL_CLIP_DISTANCE1);
+    }
+    if (ctx.multisampling.samples) {
+        ctx.beginPass(Stage::GpuResolve);
+        ctx.resolveSamples();
+    }
+}
+
+bool EGLRenderer::renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                              const std::shared_ptr<scene::SceneView>& sceneView,
+                              FrameData& outputFrame)
+{
+    const auto& camera = sceneView->camera();
+    if (!camera || outputFrame.cols <= 0 || outputFrame.rows <= 0)
+        return false;
+    // panoramic views are drawn face by face into targets of the face size
+    const auto projection = sceneView->projection();
+    const bool panoramic = projection != scene::Projection::Perspective;
+    const int faceSize = scene::panoramaFaceSize(projection, outputFrame.cols, outputFrame.rows);
+    if (panoramic && !faceSize)
+        return false;
+    // multiview frames stack the images of their views, drawn by instances in a single pass
+    const int viewCount = sceneView->viewCount();
+    const bool multiview = viewCount > 1;
+    if (multiview && outputFrame.rows % viewCount)
+        return false;
+    // points of perspective views are drawn by the shader, see completePoints() for the others,
+    // and those of views with sensor noise, left to the CPU after applySensorNoise()
+    const bool noisy = sceneView->sensorNoise().enabled();
+    const bool points = outputFrame.points && !panoramic && !multiview && !_gpuOutput && !noisy &&
+                        sceneView->hasOutputChannel(scene::OutputChannel::Points);
+    // so are the planes of reduced formats, see packFrame() for the others
+    const bool packed = !panoramic && !_gpuOutput && !noisy &&
+                        (outputFrame.packedColor || outputFrame.packedDepth ||
+                         outputFrame.packedMask);
+    const bool shortDepth =
+        outputFrame.packedDepth && sceneView->depthFormat() == scene::DepthFormat::UInt16;
+    const bool shorts = packed && (outputFrame.packedMask || shortDepth);
+    // and the motion, see completeMotion() for the others
+    const bool motion = outputFrame.motion && !panoramic && !multiview && !_gpuOutput &&
+                        sceneView->hasOutputChannel(scene::OutputChannel::Motion);
+    // and the normals, see completeNormals() for the others
+    const bool normals = outputFrame.normals && !panoramic && !multiview && !_gpuOutput &&
+                         sceneView->hasOutputChannel(scene::OutputChannel::Normals);
+    // and the depth pyramid of the frame targets, see completeDepthPyramid() for the others
+    const bool distorted = sceneView->hasLensDistortion() && !_gpuOutput;
+    const bool scaled = sceneView->hasRenderScale() && !_gpuOutput && !distorted;
+    const int pyramidLevels = sceneView->depthPyramidLevels();
+    const bool pyramid = outputFrame.depthPyramid && !panoramic && !multiview && !_gpuOutput &&
+                         !scaled && !distorted &&
+                         sceneView->hasOutputChannel(scene::OutputChannel::DepthPyramid) &&
+                         depthLevelSize(std::max(outputFrame.cols, outputFrame.rows),
+                                        pyramidLevels - 1) > 1;
+    // and the events of the color target, see EventCamera::complete() for the others and for
+    // views with sensor noise, applied after the frame
+    const bool events = outputFrame.events && !panoramic && !multiview && !_gpuOutput && !noisy &&
+                        !scaled && !distorted && _context->events.supported &&
+                        sceneView->hasOutputChannel(scene::OutputChannel::Events);
+    // and the pixels of each segmentation id of the mask target, see completePixelCounts() for
+    // the others
+    const bool counted = outputFrame.pixelCounts && !panoramic && !multiview && !_gpuOutput &&
+                         !scaled && !distorted && _context->pixelCounts.supported &&
+                         sceneView->hasOutputChannel(scene::OutputChannel::Visibility);
+    // mask-only views draw flat ids, without textures, lights nor shadows, read the mask
+    // alone, with the depth if asked
+    _maskOnly = sceneView->hasOutputChannel(scene::OutputChannel::Mask) &&
+                !sceneView->hasOutputChannel(scene::OutputChannel::Color) && !points && !motion &&
+                !normals && !events && !_gpuOutput;
+    // views of a render scale are drawn at their internal resolution and resampled on the GPU,
+    // those with extra outputs on the CPU, images kept on the GPU ignore the scale
+    if (scaled && (points || shorts || motion || normals))
+        return _scaled.render(*this, sceneState, *sceneView, outputFrame);
+    const auto size = sceneView->renderSize({outputFrame.cols, outputFrame.rows});
+    // views with lens distortion are drawn as pinhole images and remapped on the GPU through the
+    // lookup texture of their camera, likewise on the CPU with extra outputs; images kept on the
+    // GPU ignore the lens
+    if (distorted && (points || shorts || motion || normals))
+        return _distorted.render(*this, sceneState, *sceneView, outputFrame);
+    const LensMap* lens =
+        distorted ? &_lensMaps.get(*sceneView, outputFrame.cols, outputFrame.rows) : nullptr;
+
+    auto& ctx = *_context;
+    auto& shared = *ctx.shared;
+    CurrentContext current(shared.mutex, shared.display, shared.surface, shared.context);
+    StageTimer render(Stage::Render);
+    ctx.beginTimedFrame();
+    if (!ctx.dirty.empty()) {
+        shared.dirty.insert(ctx.dirty.begin(), ctx.dirty.end());
+        ctx.dirty.clear();
+    }
+    if (ctx.prune) {
+        std::set<const scene::Bitmap*> overrideBitmaps;
+        for (const auto& it : _overrideBitmaps)
+            overrideBitmaps.insert(it.second.second.get());
+        ctx.pruneResources(_items, std::move(overrideBitmaps));
+    }
+    if (panoramic)
+        ctx.resize(faceSize, faceSize);
+    else if (lens)
+        ctx.resize(lens->sourceCols, lens->sourceRows);
+    else if (scaled)
+        ctx.resize(size[0], size[1]);
+    else
+        ctx.resize(outputFrame.cols, outputFrame.rows);
+    ctx.setExtraOutputs(points, shorts, motion, normals);
+    // multisampled targets have no extra outputs, the renderer default is none
+    const auto& quality = sceneView->quality();
+    ctx.setSamples(points || shorts || motion || normals ? 0 : quality.multisamples);
+    ++ctx.shared->frame;
+    ctx.streamBudget = _textureUploadBudget;
+    ctx.beginTransforms();
+
+    // static nodes are merged once until they move
+    {
+        StageTimer timer(Stage::StateSync);
+        _bvh.update(_bounds, *sceneState);
+        updateStaticBatches(*sceneState);
+        updateLayerBatches();
+    }
+
+    // images kept on the GPU are not flipped afterwards, draw them upside down, regions of
+    // interest are drawn alone by a camera of their projection
+    scene::Camera viewCamera = sceneView->imageCamera();
+    if (lens) {
+        viewCamera.setProjMatrix(lens->sourceProjection);
+        viewCamera.setDistortion(scene::LensDistortion());
+    }
+
+    // shadows of the light, drawn before the frame, cascades fitted to views of one camera
+    glUseProgram(ctx.program);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glDepthMask(GL_TRUE);
+    const auto& light = sceneView->light();
+    const bool shadowed =
+        !_maskOnly && quality.shadows && light && light->isShadowCaster() &&
+        updateShadowMap(*sceneState, *light, panoramic || multiview ? nullptr : &viewCamera);
+
+    // incremental frames redraw the tiles of moving nodes of a single pinhole image, drawn as is
+    const bool reusable = _incremental && !panoramic && !multiview && !lens && !scaled &&
+                          !_gpuOutput && !motion && !_occlusionCulling;
+    if (!reusable)
+        _reuse.valid = false;
+
+    // statistics add up over the faces of panoramic views
+    ctx.materialSwitches = 0;
+    ctx.textureBinds = 0;
+    ctx.indirectShapes = 0;
+    ctx.multiDraws = 0;
+    ctx.drawnNodes = 0;
+    ctx.frustumCulledNodes = 0;
+    ctx.occludedNodes = 0;
+    ctx.opaqueShapes = 0;
+    ctx.blendedShapes = 0;
+    ctx.redrawnPixels = ctx.cols * ctx.rows * (panoramic ? 6 : 1);
+    std::set<int> loadedNodes; //<- nodes whose shapes were loaded in this frame
+    if (!panoramic) {
+        _viewCameras.clear();
+        for (int i = 0; multiview && i < viewCount; ++i)
+            _viewCameras.push_back(sceneView->viewCamera(i));
+        // incremental frames keep the targets outside the tiles to redraw, clears included
+        const auto region = reusable ? redrawRegion(*sceneState, *sceneView, viewCamera, shadowed)
+                                     : Vector4i{0, 0, ctx.cols, ctx.rows};
+        const bool scissored = region[2] < ctx.cols || region[3] < ctx.rows;
+        if (scissored) {
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(region[0], region[1], region[2], region[3]);
+        }
+        drawView(*sceneState, *sceneView, viewCamera, _gpuOutput, shadowed, loadedNodes,
+                 _viewCameras);
+        if (scissored)
+            glDisable(GL_SCISSOR_TEST);
+        ctx.redrawnPixels = region[2] * region[3];
+        if (pyramid) {
+            ctx.beginPass(Stage::GpuResolve);
+            ctx.reduceLevels(pyramidLevels);
+            glBindFramebuffer(GL_FRAMEBUFFER, ctx.framebuffer);
+            glViewport(0, 0, ctx.cols, ctx.rows);
+            glEnable(GL_DEPTH_TEST);
+            glUseProgram(ctx.program);
+        }
+        if (scaled || lens) {
+            ctx.beginPass(Stage::GpuResolve);
+            ctx.resampleFrame(outputFrame.cols, outputFrame.rows, lens, camera->handle());
+        }
+    }
+    else {
+        // cubemap faces are read back into their rows of the image, those of equirectangular
+        // images kept on the GPU and reprojected at once
+        const size_t facePixels = size_t(faceSize) * size_t(faceSize);
+        for (int face = 0; face < 6; ++face) {
+            const auto faceCamera = scene::cubemapFaceCamera(*camera, scene::CubemapFace(face));
+            drawView(*sceneState, *sceneView, faceCamera, false, shadowed, loadedNodes);
+            if (projection == scene::Projection::Cubemap) {
+                ctx.beginPass(Stage::GpuReadback);
+                const size_t offset = facePixels * face;
+                Context::readImages(faceSize, faceSize,
+                                    outputFrame.color ? outputFrame.color + offset * 4 : nullptr,
+                                    outputFrame.mask ? outputFrame.mask + offset : nullptr,
+                                    outputFrame.depth ? outputFrame.depth + offset : nullptr);
+            }
+            else {
+                ctx.beginPass(Stage::GpuResolve);
+                ctx.storeFace(face);
+            }
+        }
+        if (projection == scene::Projection::Equirectangular) {
+            ctx.beginPass(Stage::GpuResolve);
+            ctx.reprojectPanorama(outputFrame.cols, outputFrame.rows);
+        }
+    }
+    ctx.endTransforms();
+
+    for (int nodeId : loadedNodes) {
+        auto bounds = scene::AABB::Empty();
+        for (const auto& item : _items[nodeId])
+            bounds.extend(item.shape.bounds().transformed(item.localMatrix));
+        _bounds.updateNode(nodeId, bounds);
+    }
+    if (!loadedNodes.empty()) {
+        // static nodes loaded, batched and casting shadows at the next frame
+        _staticGeneration = ~uint64_t(0);
+        _staticShadowStale = true;
+        _reuse.valid = false;
+    }
+    if (ctx.streamTextures())
+        _reuse.valid = false; //<- textures drawn finer from the next frame
+    ctx.evict(_memoryBudget);
+    publishMemory();
+    render.stop();
+    StageTimer readback(Stage::Readback);
+    ctx.beginPass(Stage::GpuReadback);
+
+#ifdef WITH_CUDA
+    if (_gpuOutput && !panoramic) {
+        ctx.readPixelBuffers(_gpuFrame);
+        ctx.endPass();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return true;
+    }
+#endif
+
+    // pixels counted for the ids of the nodes in view, those of all nodes if others were drawn,
+    // e.g. of shapes outside the bounds of their node; the mask is then read back only if asked
+    if (counted) {
+        int* boxes = sceneView->hasOutputChannel(scene::OutputChannel::Boxes) ? outputFrame.boxes
+                                                                              : nullptr;
+        segmentationIds(true, _countedIds);
+        outputFrame.numPixelCounts = ctx.countPixels(_countedIds, outputFrame.pixelCounts, boxes);
+        if (outputFrame.numPixelCounts < 0) {
+            segmentationIds(false, _countedIds);
+            outputFrame.numPixelCounts =
+                ctx.countPixels(_countedIds, outputFrame.pixelCounts, boxes);
+        }
+    }
+    const bool maskRead = outputFrame.numPixelCounts < 0 ||
+                          sceneView->hasOutputChannel(scene::OutputChannel::Mask);
+
+    // images are read from the frame targets, or those of the resampled, remapped or
+    // equirectangular image
+    // full planes of packed channels are skipped, but for the depth compacting points
+    if (packed) {
+        Context::readPackedImages(*sceneView, outputFrame);
+        outputFrame.packed = true;
+    }
+    if (projection != scene::Projection::Cubemap)
+        Context::readImages(outputFrame.cols, outputFrame.rows,
+                            (outputFrame.packedColor && packed) || _maskOnly ? nullptr
+                                                                             : outputFrame.color,
+                            (outputFrame.packedMask && packed) || !maskRead
+                                ? nullptr
+                                : outputFrame.mask,
+                            (outputFrame.packedDepth && packed && !outputFrame.points) ||
+                                    (_maskOnly &&
+                                     !sceneView->hasOutputChannel(scene::OutputChannel::Depth))
+                                ? nullptr
+                                : outputFrame.depth);
+    if (points) {
+        Context::readPoints(outputFrame.cols, outputFrame.rows, outputFrame.points);
+        outputFrame.numPoints = outputFrame.cols * outputFrame.rows;
+    }
+    if (motion) {
+        Context::readMotion(outputFrame.cols, outputFrame.rows, outputFrame.motion);
+        outputFrame.motionDrawn = true;
+    }
+    if (normals) {
+        Context::readNormals(outputFrame.cols, outputFrame.rows, outputFrame.normals);
+        outputFrame.normalsDrawn = true;
+    }
+    if (pyramid) {
+        ctx.readDepthLevels(pyramidLevels, outputFrame.depthPyramid);
+        outputFrame.depthPyramidDrawn = true;
+    }
+    if (events)
+        outputFrame.numEvents = ctx.findEvents(camera->handle(), sceneView->eventTime(),
+                                               sceneView->eventThreshold(), outputFrame.events);
+    ctx.endPass();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+void EGLRenderer::segmentationIds(bool inView, std::vector<int>& ids) const
+{
+    ids.clear();
+    const auto add = [&ids](const std::vector<DrawItem>& items) {
+        for (const auto& item : items)
+            ids.push_back(item.segmentation);
+    };
+    if (inView) {
+        for (int nodeId : _visibleNodes) {
+            const auto it = _items.find(nodeId);
+            if (it != _items.end())
+                add(it->second);
+        }
+    }
+    else {
+        for (const auto& it : _items)
+            add(it.second);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+void EGLRenderer::setIndirectDraws(bool enabled)
+{
+    if (enabled && !_context->indirectDraws.supported)
+        throw std::runtime_error("EGLRenderer: indirect draws require OpenGL 4.3");
+    _indirectDraws = enabled;
+}
+
+void EGLRenderer::setGpuOutput(bool enabled)
+{
+#ifdef WITH_CUDA
+    if (!enabled && _gpuOutput) {
+        auto& ctx = *_context;
+        auto& shared = *ctx.shared;
+        CurrentContext current(shared.mutex, shared.display, shared.surface, shared.context);
+        ctx.releasePixelBuffers();
+        _gpuFrame = GpuFrame();
+    }
+    _gpuOutput = enabled;
+#else
+    if (enabled)
+        throw std::runtime_error("EGLRenderer: GPU output requires a build with CUDA");
+#endif
+}
+
+} // namespace render
@@ -0,0 +1,539 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+#include "DeviceScheduler.h"
+#include "DistortedFrame.h"
+#include "ScaledFrame.h"
+#include "ShadowCascades.h"
+#include "ThreadAffinity.h"
+
+#include <scene/BVH.h>
+#include <scene/DepthPyramid.h>
+#include <scene/MeshLod.h>
+#include <scene/SceneBounds.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Images of a frame left in CUDA device memory
+ *
+ * Planes have the layout of the FrameData ones, top row first, and are null before the first
+ * frame rendered on the GPU.
+ */
+struct GpuFrame {
+    int cols = 0; //<- image width
+    int rows = 0; //<- image height
+    uint8_t* color = nullptr; //<- device pointer to the color plane
+    float* depth = nullptr; //<- device pointer to the depth plane
+    int* mask = nullptr; //<- device pointer to the mask plane
+};
+
+/**
+ * @brief GPU memory and asset loading state of an EGLRenderer
+ */
+struct ResidencyStats {
+    size_t residentBytes = 0; //<- GPU memory of the uploaded meshes and textures, of the context
+    size_t peakResidentBytes = 0; //<- highest resident bytes since the renderer was created
+    size_t bufferBytes = 0; //<- mesh buffers, part of the resident bytes
+    size_t textureBytes = 0; //<- texture arrays, free layers included, and heightfield textures
+    size_t framebufferBytes = 0; //<- render targets and pixel buffers, not resident bytes
+    int residentMeshes = 0; //<- meshes, levels of detail and heightfields on the GPU
+    int residentTextures = 0; //<- textures on the GPU
+    int textureArrays = 0; //<- array textures holding them, small textures of a size share one
+    int loadedShapes = 0; //<- shapes whose mesh and texture were loaded
+    int deferredShapes = 0; //<- shapes not in view yet in lazy residency mode, not loaded
+    uint64_t uploads = 0; //<- mesh and texture uploads since the renderer was created
+    uint64_t evictions = 0; //<- meshes and textures dropped to fit the memory budget
+    uint64_t tileUploads = 0; //<- heightfield tiles uploaded, first uploads included
+    uint64_t texelUploads = 0; //<- textures uploaded again after their pixels were rewritten
+    uint64_t streamedBytes = 0; //<- finer mip levels of streamed textures uploaded
+    uint64_t mipEvictions = 0; //<- streamed textures dropped to their coarse level for the budget
+    int pendingTextures = 0; //<- streamed textures drawn coarser than wanted in the last frame
+    int uniqueMaterials = 0; //<- distinct materials of the loaded shapes
+    int materialSwitches = 0; //<- material or texture changes between the draws of the last frame
+    int textureBinds = 0; //<- texture array changes between the draws of the last frame
+    int staticBatches = 0; //<- merged draws of the shapes of static nodes
+    int batchedShapes = 0; //<- shapes drawn through static batches
+    int drawnNodes = 0; //<- nodes passing view frustum and occlusion culling in the last frame
+    int frustumCulledNodes = 0; //<- nodes out of the view frustum in the last frame
+    int occludedNodes = 0; //<- nodes in the view frustum hidden by occluders in the last frame
+    int opaqueShapes = 0; //<- shapes drawn without blending in the last frame, batches aside
+    int blendedShapes = 0; //<- transparent shapes sorted and blended in the last frame
+    int indirectShapes = 0; //<- opaque shapes drawn by indirect commands in the last frame
+    int multiDraws = 0; //<- multi-draw indirect calls of the last frame, one per texture array
+    uint64_t staticShadowUpdates = 0; //<- shadow maps of the static casters drawn
+    int shadowCasters = 0; //<- dynamic shapes drawn in the last shadow map
+    int redrawnPixels = 0; //<- pixels of the tiles drawn in the last frame, see setIncremental()
+};
+
+/**
+ * @brief Headless OpenGL renderer on an EGL context
+ *
+ * Renders color, metric depth and segmentation mask images without a window nor python, with
+ * diffuse lighting from the scene view light. Meshes and textures are uploaded to the GPU once
+ * and shared by all shapes using them.
+ *
+ * All images come from a single pass into multiple render targets. Mask values are those of the
+ * segmentation mode of the scene, by default body + ((link + 1) << 24) as decoded by the python
+ * renderers from their segmentation colors, -1 for the background.
+ *
+ * The context is made current only for the duration of each call, so that the renderer may be
+ * driven from any thread, e.g. by an AsyncRenderer.
+ *
+ * Renderers of a device created with shareResources draw in a single context holding the meshes,
+ * textures and heightfield tile grids of all of them, so that environments of a process loading
+ * the same assets upload them once; each renderer owns its scene, static batches, heightfields,
+ * render targets, depth reduction and shadow maps. The context is current for one renderer at a
+ * time, calls of renderers on other threads waiting for it. Resident bytes, resident meshes and
+ * textures and the memory budget then cover the context, the GPU memory reported by
+ * memoryUsage() counts an even share of it.
+ *
+ * In lazy residency mode, the mesh and texture of a shape are loaded only once its node first
+ * passes view frustum culling, so that objects never seen are neither parsed nor uploaded.
+ * Nodes of mesh files with unknown bounds pass culling until their mesh is loaded. Under a
+ * memory budget, the meshes and textures drawn least recently are released from the GPU once
+ * it is exceeded, and uploaded again when drawn.
+ *
+ * Heightfields are drawn from a texture of their heights, tessellated by the vertex shader in
+ * tiles culled and simplified independently, with skirts hiding cracks between levels. Height
+ * updates upload only the modified tiles. Heightfields stay resident under a memory budget.
+ *
+ * Opaque shapes are drawn grouped by shader path, texture and material, the scene graph sharing
+ * equal materials between shapes, so that uniforms and textures change once per group.
+ *
+ * Opaque mesh shapes of the nodes the scene state classifies as static are merged in world space
+ * into one draw per texture and material, culled as a whole and drawn at full detail, without
+ * per-node transforms; a batch is rebuilt when one of its nodes moves, which makes the node
+ * dynamic again. Views overriding materials draw static shapes one by one.
+ *
+ * The base layer of a scene graph, see scene::SceneLayer, is merged the same way once per
+ * context and segmentation mode, its batches shared by all the renderers of the context drawing
+ * it, so that environments of a process sharing the layer upload and keep its geometry once.
+ * Its shapes are drawn with their own materials, by views overriding materials too, and cast
+ * shadows as static nodes; translucent ones are blended after the other shapes, unsorted.
+ *
+ * With occlusion culling, nodes in view covering at least occluderSize() pixels are drawn
+ * first, static batches with them, as occluders. The farthest depth they leave under each block
+ * of pixels is reduced on the GPU into a small hierarchical depth buffer read back into a
+ * scene::DepthPyramid, against which the remaining nodes are culled down the BVH, whole subtrees
+ * at once. The read back waits for the occluders to be drawn.
+ *
+ * With indirect draws, on OpenGL 4.3, the opaque mesh shapes of a frame are drawn from a single
+ * vertex and index arena by one multi-draw indirect call per texture array. A compute shader
+ * writes the draw commands, zeroing those whose bounding sphere is out of the frustum, and the
+ * vertex shader reads transform, segmentation and material of each draw from a buffer of draw
+ * records. The BVH still culls nodes on the CPU first; blended shapes and heightfields are drawn
+ * one by one.
+ *
+ * Lights casting shadows get a depth map of an orthographic projection covering the scene. The
+ * static casters are drawn into a map of their own, kept until the light direction, the static
+ * nodes or their shapes change; each frame the dynamic casters are drawn over a copy of it,
+ * once per scene state for all the views rendering it. Heightfields receive shadows only. With
+ * shadow cascades, views of a single camera fit them to the nodes they see instead, see
+ * ShadowCascades, and draw all the casters into the tiles of the map of all casters, each
+ * cascade culling them by its projection.
+ *
+ * Views asking for the mask without the color, nor extra channels computed from it, are drawn
+ * mask-only: fragments write their segmentation id and depth and skip textures, lights and
+ * shadows, vertices skip their normal matrix, no shadow map is drawn and only the mask, and the
+ * depth if asked, are read back, as int32 or as 16-bit ids of MaskFormat::UInt16. Shadow maps
+ * are drawn the same way.
+ *
+ * Panoramic views draw the six cubemap faces in turn within one frame, sharing its state sync,
+ * shadow map and resident resources. Cubemap faces are read back into their rows of the image;
+ * equirectangular ones are copied into layers of array textures on the GPU, from which a single
+ * pass draws the image at the output size, the only one read back.
+ *
+ * Multiview frames draw their views in a single pass into bands of rows of the same targets, each
+ * shape being drawn once for all of them by instancing, squeezed into the band of its view and
+ * clipped to it. Nodes are culled once against the union of their frustums, without occlusion
+ * culling, and the frame is read back at once.
+ *
+ * Built with CUDA, images can stay on the GPU: in GPU output mode they are copied into pixel
+ * buffers registered with CUDA instead of the planes of the output frames, which are left
+ * untouched, and are read through gpuFrame(). Panoramic views are read back into the output
+ * frames in this mode too.
+ *
+ * In incremental mode, frames of a static camera keep the targets of the previous frame and
+ * redraw, scissored, only the tiles covered by the nodes that moved since, before and after
+ * moving, and by their shadows swept across the scene. Any other change, of the view, light,
+ * shadow projection, frame size or scene, redraws the whole frame once.
+ */
+class EGLRenderer : public BaseRenderer
+{
+  public:
+    /// device argument placing the renderer on the least loaded GPU, see acquireDevice()
+    static constexpr int ScheduledDevice = -2;
+
+    /**
+     * @brief Create an EGL context
+     *
+     * @param device - index of the EGL device to render on, -1 for the default display,
+     * ScheduledDevice to let the device scheduler pick one
+     * @param shareResources - draw in the context of the other renderers of the device sharing
+     * resources, with their meshes and textures
+     * @throws std::runtime_error if no OpenGL 3.3 context can be created
+     */
+    explicit EGLRenderer(int device = -1, bool shareResources = false);
+
+    /**
+     * @brief Number of EGL devices of the system, 0 if they cannot be enumerated
+     */
+    static int deviceCount();
+
+    /**
+     * @brief DRM device file of an EGL device, e.g. /dev/dri/card1, empty if not reported
+     */
+    static std::string deviceFile(int device);
+
+    /**
+     * @brief Index of the EGL device rendered on, -1 for the default display
+     */
+    int device() const { return _device; }
+
+    /**
+     * @brief NUMA node of the PCIe root of the EGL device, -1 for the default display
+     */
+    int numaNode() const override { return deviceNumaNode(_device); }
+
+    /**
+     * @brief Base layers are drawn from batches shared within the context, see scene::SceneLayer
+     */
+    bool drawsBaseLayer() const override { return true; }
+
+    /**
+     * @brief Meshes and textures are shared with the other renderers of the device sharing them
+     */
+    bool shareResources() const { return _shareResources; }
+
+    /**
+     * @brief Release GPU resources and destroy the context
+     */
+    ~EGLRenderer() override;
+
+    /**
+     * @brief Update a scene using \p sceneGraph description
+     */
+    void updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                     bool materialsOnly) override;
+
+    /**
+     * @brief Rebuild only added and changed nodes
+     */
+    void applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                         const scene::SceneGraphDelta& delta) override;
+
+    /**
+     * @brief Re-upload vertices and normals of a shape at the next frame
+     */
+    bool updateShapeGeometry(int nodeId, int shapeIndex,
+                             const std::shared_ptr<scene::MeshData>& meshData) override;
+
+    /**
+     * @brief Upload the modified tiles of a heightfield shape at the next frame
+     */
+    bool updateShapeHeightfield(int nodeId, int shapeIndex,
+                                const std::shared_ptr<scene::Heightfield>& heightfield) override;
+
+    /**
+     * @brief Change the color uniform and texture of a shape at the next frame
+     */
+    bool updateShapeMaterial(int nodeId, int shapeIndex,
+                             const std::shared_ptr<scene::Material>& material) override;
+
+    /**
+     * @brief Upload the new pixels of a shape texture over its array layer at the next frame
+     */
+    bool updateShapeTexels(int nodeId, int shapeIndex,
+                           const std::shared_ptr<scene::Texture>& texture) override;
+
+    /**
+     * @brief Render a scene at state \p sceneState with a view settings \p sceneView
+     *
+     * @return False if the view has no camera
+     */
+    bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                     const std::shared_ptr<scene::SceneView>& sceneView,
+                     FrameData& outputFrame) override;
+
+    /**
+     * @brief Images are kept on the GPU instead of being read back into output frames
+     */
+    bool gpuOutput() const { return _gpuOutput; }
+    /**
+     * @overload
+     * @throws std::runtime_error if built without CUDA
+     */
+    void setGpuOutput(bool enabled);
+
+    /**
+     * @brief Device images of the last frame rendered in GPU output mode
+     *
+     * Pointers are valid until the next renderFrame() call, which writes the same buffers, and
+     * belong to the current CUDA device, to be the GPU of the EGL device.
+     */
+    const GpuFrame& gpuFrame() const { return _gpuFrame; }
+
+    /**
+     * @brief Load the assets of shapes added from now on only when they are first in view
+     */
+    bool lazyResidency() const { return _lazyResidency; }
+    /** @overload */
+    void setLazyResidency(bool enabled) { _lazyResidency = enabled; }
+
+    /**
+     * @brief GPU memory for meshes and textures in bytes, 0 for no limit
+     *
+     * Resources of the frame being drawn are never released, a frame may exceed the budget.
+     */
+    size_t memoryBudget() const { return _memoryBudget; }
+    /** @overload */
+    void setMemoryBudget(size_t bytes) { _memoryBudget = bytes; }
+
+    /**
+     * @brief Bytes of texture mip levels uploaded per frame, 0 to upload whole textures
+     *
+     * Textures too large to share an array are first uploaded from their mip level of 64
+     * texels, then stream in one finer level at a time, largest on screen first, up to the
+     * level their screen size needs. Under a memory budget, the finer levels of the textures
+     * not drawn in the frame are dropped before whole meshes and textures.
+     */
+    size_t textureUploadBudget() const { return _textureUploadBudget; }
+    /** @overload */
+    void setTextureUploadBudget(size_t bytes) { _textureUploadBudget = bytes; }
+
+    /**
+     * @brief Cull nodes hidden behind the largest ones in view
+     */
+    bool occlusionCulling() const { return _occlusionCulling; }
+    /** @overload */
+    void setOcclusionCulling(bool enabled) { _occlusionCulling = enabled; }
+
+    /**
+     * @brief Redraw only the tiles of static cameras covered by moving nodes, see EGLRenderer
+     *
+     * Frames of panoramic, multiview, resampled or distorted views, with motion vectors, with
+     * occlusion culling or kept on the GPU are always drawn whole.
+     */
+    bool incremental() const { return _incremental; }
+    /** @overload */
+    void setIncremental(bool enabled)
+    {
+        _incremental = enabled;
+        _reuse.valid = false;
+    }
+
+    /**
+     * @brief Draw opaque mesh shapes by multi-draw indirect commands culled on the GPU
+     *
+     * @throw std::runtime_error - enabling it without an OpenGL 4.3 context
+     */
+    bool indirectDraws() const { return _indirectDraws; }
+    /** @overload */
+    void setIndirectDraws(bool enabled);
+
+    /**
+     * @brief Smallest screen size in pixels of the bounding sphere of an occluder node
+     */
+    float occluderSize() const { return _occluderSize; }
+    /** @overload */
+    void setOccluderSize(float size) { _occluderSize = size; }
+
+    /**
+     * @brief Width and height of the shadow maps in texels, no shadows if 0
+     */
+    int shadowMapSize() const { return _shadowMapSize; }
+    /** @overload */
+    void setShadowMapSize(int size) { _shadowMapSize = std::max(0, size); }
+
+    /**
+     * @brief Shadow cascades fitted to the view, 0 for a map covering the scene by default
+     *
+     * The cascades share the texels of one map, panoramic and multiview frames keep the map
+     * covering the scene.
+     */
+    int shadowCascades() const { return _shadowCascades; }
+    /** @overload */
+    void setShadowCascades(int count)
+    {
+        _shadowCascades = std::min(std::max(0, count), int(ShadowCascades::kMaxCascades));
+    }
+
+    /**
+     * @brief GPU memory use and loading state of the scene assets
+     */
+    ResidencyStats residencyStats() const;
+
+    /**
+     * @brief Memory as of the last frame, host bytes being the bitmaps of texture files
+     */
+    RendererMemory memoryUsage() const override;
+
+    /**
+     * @brief Upload the mesh, levels of detail and texture of a shape into the context
+     *
+     * Released by the next frame if its scene does not use them. Heightfields are uploaded when
+     * drawn.
+     */
+    bool uploadAssets(const scene::Shape& shape) override;
+
+  private:
+    /**
+     * @brief Shape ready to be drawn
+     */
+    struct DrawItem {
+        int shapeIndex;
+        scene::Shape shape; //<- asset handles, for loading in lazy residency mode
+        bool loaded = false; //<- mesh and bitmap loaded, mesh null if it cannot be drawn
+        std::shared_ptr<scene::MeshData> mesh;
+        std::shared_ptr<scene::Heightfield> heightfield; //<- drawn as GPU tiles, without mesh
+        std::vector<std::shared_ptr<scene::MeshData>> lods; //<- simplified meshes, coarser last
+        std::shared_ptr<scene::Bitmap> bitmap;
+        Matrix4f localMatrix; //<- shape pose in the node frame
+        Color4f color;
+        int segmentation; //<- mask value of the shape
+        bool batched = false; //<- drawn through a static batch
+    };
+
+    /**
+     * @brief Shape drawn in a frame, with the material of the view
+     */
+    struct Draw {
+        int nodeId;
+        const DrawItem* item;
+        const scene::Material* material;
+        const Color4f* color;
+        const std::shared_ptr<scene::Bitmap>* bitmap;
+        int order; //<- position in scene order
+        float depth; //<- view depth of the shape origin, blended shapes are drawn farthest first
+    };
+
+    struct Context; //<- EGL and OpenGL objects
+
+    void updateNode(int nodeId, const scene::Node& node);
+
+    /// load the mesh, levels of detail and bitmap of an item
+    void loadItem(DrawItem& item) const;
+
+    /// merge the shapes of the static nodes once their set or their shapes changed
+    void updateStaticBatches(const scene::SceneState& sceneState);
+
+    /// find or merge the batches of the base layer once it changed
+    void updateLayerBatches();
+
+    /// draw the shadow map of a light, its cascades fitted to \p camera if not null, false if
+    /// there is nothing to cast shadows
+    bool updateShadowMap(const scene::SceneState& sceneState, const scene::Light& light,
+                         const scene::Camera* camera);
+
+    /// draw a view through \p camera into the frame targets, upside down if \p flipped,
+    /// adding the nodes whose shapes were loaded to \p loadedNodes; multiview frames draw all
+    /// \p views, the first being \p camera, in the same pass into bands of the targets
+    void drawView(const scene::SceneState& sceneState, const scene::SceneView& sceneView,
+                  const scene::Camera& camera, bool flipped, bool shadowed,
+                  std::set<int>& loadedNodes, const std::vector<scene::Camera>& views = {});
+
+    /// scissor box of the tiles of an incremental frame to redraw, x, y, width and height, the
+    /// whole frame unless the previous one is kept, then remember the frame for the next one
+    Vector4i redrawRegion(const scene::SceneState& sceneState, const scene::SceneView& sceneView,
+                          const scene::Camera& camera, bool shadowed);
+
+    /// increasing segmentation ids of the shapes of the nodes in view of the last view drawn,
+    /// or of all the nodes, into \p ids
+    void segmentationIds(bool inView, std::vector<int>& ids) const;
+
+    /// publish the memory use for memoryUsage(), after drawing a frame
+    void publishMemory();
+
+    /// bitmap of the texture of a view material, loaded once, null if none
+    const std::shared_ptr<scene::Bitmap>& overrideBitmap(
+        const std::shared_ptr<scene::Texture>& texture);
+
+    std::unique_ptr<Context> _context;
+    int _device = -1;
+    bool _shareResources = false;
+    std::shared_ptr<DeviceLease> _deviceLease; //<- placement by the device scheduler, if any
+    std::map<int, std::vector<DrawItem>> _items; //<- node id -> shapes
+    scene::SceneBounds _bounds; //<- node bounds, for frustum culling
+    scene::BVH _bvh; //<- world bounds of nodes, refitted each frame
+    // per frame lists, kept so that steady frames do not allocate
+    scene::BVH::Stack _bvhStack;
+    std::vector<int> _visibleNodes;
+    std::vector<int> _countedIds; //<- segmentation ids counted by the Visibility channel
+    std::vector<Draw> _opaque;
+    std::vector<Draw> _blended;
+    std::vector<Matrix4f> _drawModels; //<- of the draws of a list, their transforms streamed
+    std::vector<const DrawItem*> _casters; //<- shapes drawn into a shadow map
+    std::vector<int> _occluders; //<- visible nodes drawn first with occlusion culling
+    std::vector<int> _unoccludedNodes; //<- visible nodes passing occlusion culling
+    std::vector<scene::Camera> _viewCameras; //<- cameras of the views of multiview frames
+    scene::DepthPyramid _depthPyramid; //<- farthest depth of the occluders
+    scene::LodPolicy _lodPolicy; //<- mesh level of detail from its screen size
+    // static batches, see updateStaticBatches()
+    uint64_t _staticGeneration = ~uint64_t(0); //<- static generation of the batched state
+    bool _staticItemsChanged = true; //<- shapes changed, batches are rebuilt
+    std::shared_ptr<const scene::SceneLayer> _baseLayer; //<- of the scene graph
+    bool _baseLayerChanged = false; //<- its batches are looked up again
+    // shadow maps, see updateShadowMap()
+    int _shadowMapSize = 1024;
+    Vector3f _shadowDirection{}; //<- light direction of the projection
+    scene::AABB _shadowBox = scene::AABB::Empty(); //<- world box covered by the projection
+    Matrix4f _lightViewProj{};
+    uint64_t _shadowStaticGeneration = ~uint64_t(0); //<- static generation of the static map
+    bool _staticShadowStale = true; //<- shapes changed, the static map is drawn again
+    const void* _shadowState = nullptr; //<- scene state of the dynamic casters
+    uint64_t _shadowPoses = ~uint64_t(0); //<- its generation when they were drawn
+    int _shadowCascades = 0;
+    ShadowCascades _cascades; //<- fitted to the view of the frame, none for the scene map
+    std::map<const scene::Texture*,
+             std::pair<std::shared_ptr<scene::Texture>, std::shared_ptr<scene::Bitmap>>>
+        _overrideBitmaps; //<- bitmaps of the textures of view materials
+    bool _gpuOutput = false;
+    bool _maskOnly = false; //<- the frame draws flat segmentation ids alone
+    GpuFrame _gpuFrame;
+    ScaledFrame _scaled; //<- views of a render scale with extra outputs
+    DistortedFrame _distorted; //<- views with lens distortion and extra outputs
+    LensMaps _lensMaps; //<- of the views with lens distortion remapped on the GPU
+    bool _lazyResidency = false;
+    scene::SegmentationMode _segmentationMode = scene::SegmentationMode::BodyLink;
+    size_t _memoryBudget = 0;
+    size_t _textureUploadBudget = 0;
+    bool _occlusionCulling = false;
+    bool _incremental = false;
+    /// previous frame of the incremental mode, see redrawRegion()
+    struct ReusedFrame {
+        bool valid = false; //<- the frame targets hold it
+        int cols = 0;
+        int rows = 0;
+        int samples = 0;
+        bool shadowed = false;
+        Matrix4f lightViewProj{};
+        ShadowCascades cascades;
+        scene::SceneView view; //<- without its motion and event settings
+        std::vector<int> ids; //<- nodes of the scene state
+        std::vector<Matrix4f> matrices;
+        std::vector<scene::AABB> bounds; //<- world bounds, infinite for nodes without
+    };
+    ReusedFrame _reuse;
+    bool _indirectDraws = false;
+    float _occluderSize = 64.f;
+    int _maxTextureSize = 0; //<- largest heightfield drawn from a texture
+    mutable std::mutex _memoryMutex;
+    RendererMemory _memory; //<- published by the rendering thread
+    uint64_t _memoryUploads = ~uint64_t(0); //<- uploads when the host bytes were counted
+};
+
+} // namespace render
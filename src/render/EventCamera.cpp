@@ -0,0 +1,62 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "EventCamera.h"
+
+namespace render {
+
+int EventCamera::update(int cols, int rows, const uint8_t* color, double time, float threshold,
+                        float* events)
+{
+    const size_t numPixels = size_t(cols) * size_t(rows);
+    if (cols != _cols || rows != _rows || _reference.size() != numPixels) {
+        _cols = cols;
+        _rows = rows;
+        _reference.resize(numPixels);
+        for (size_t i = 0; i < numPixels; ++i)
+            _reference[i] = logLuminance(color + i * 4);
+        _time = time;
+        return 0;
+    }
+
+    const double span = time - _time;
+    size_t count = 0;
+    for (int row = 0; row < rows; ++row) {
+        for (int col = 0; col < cols; ++col) {
+            const size_t i = size_t(row) * cols + col;
+            const float delta = logLuminance(color + i * 4) - _reference[i];
+            const size_t n = size_t(std::abs(delta) / threshold);
+            if (n == 0 || count + n > numPixels)
+                continue;
+            const float polarity = delta > 0.f ? 1.f : -1.f;
+            for (size_t k = 1; k <= n; ++k) {
+                float* event = events + count++ * 4;
+                event[0] = float(col);
+                event[1] = float(row);
+                event[2] = float(_time + span * (k * threshold / std::abs(delta)));
+                event[3] = polarity;
+            }
+            _reference[i] += polarity * n * threshold;
+        }
+    }
+    _time = time;
+    return int(count);
+}
+
+void EventCamera::complete(const scene::SceneView& sceneView, FrameData& frame)
+{
+    if (!frame.events || !frame.color || frame.numEvents >= 0 ||
+        !sceneView.hasOutputChannel(scene::OutputChannel::Events))
+        return;
+    frame.numEvents = update(frame.cols, frame.rows, frame.color, sceneView.eventTime(),
+                             sceneView.eventThreshold(), frame.events);
+}
+
+void EventCamera::reset()
+{
+    _reference.clear();
+    _cols = _rows = 0;
+}
+
+} // namespace render
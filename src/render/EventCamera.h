@@ -0,0 +1,73 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Log luminance of an 8-bit RGB pixel, log(1 + Y) of its Rec. 709 luma
+ */
+inline float logLuminance(const uint8_t* pixel)
+{
+    return std::log(1.f + 0.2126f * pixel[0] + 0.7152f * pixel[1] + 0.0722f * pixel[2]);
+}
+
+/**
+ * @brief Events of an event camera from the color images of consecutive frames
+ *
+ * Each pixel keeps a reference log luminance, that of the first image at first. A pixel whose
+ * log luminance moved by n thresholds away from its reference fires n events of the sign of the
+ * change, timed as the luminance crosses each level, linearly between the previous image and this
+ * one, and moves its reference by n thresholds. Events are written (x, y, t, polarity) with x the
+ * column from the left and y the row from the top, pixel after pixel, top row first. Pixels whose
+ * events no longer fit in the output, of one event per pixel, keep their reference and fire them
+ * at a later image.
+ *
+ * Images of another size start over from a new reference, as do those after reset().
+ */
+class EventCamera
+{
+  public:
+    /**
+     * @brief Find the events of an image
+     *
+     * @param cols - image width
+     * @param rows - image height
+     * @param color - RGBA pixels, top row first
+     * @param time - time of the image, seconds
+     * @param threshold - change of log luminance per event
+     * @param events - output, room for cols * rows events of 4 floats
+     * @return Number of events written, 0 for a first image
+     */
+    int update(int cols, int rows, const uint8_t* color, double time, float threshold,
+               float* events);
+
+    /**
+     * @brief Finish the Events channel of a frame rendered with \p sceneView
+     *
+     * Compares the color plane with the reference by update() at SceneView::eventTime() unless
+     * the renderer found the events. Frames without events or a color plane are left untouched.
+     */
+    void complete(const scene::SceneView& sceneView, FrameData& frame);
+
+    /**
+     * @brief Drop the reference, the next image only setting it
+     */
+    void reset();
+
+  private:
+    std::vector<float> _reference; //<- log luminance of the last event of each pixel
+    int _cols = 0;
+    int _rows = 0;
+    double _time = 0.0; //<- of the previous image
+};
+
+} // namespace render
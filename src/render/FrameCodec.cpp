@@ -0,0 +1,162 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "FrameCodec.h"
+
+#include <scene/SceneView.h>
+#include <utils/lz4.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace render {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x45465250; //<- "PRFE"
+constexpr uint32_t kVersion = 1;
+
+struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t channels;
+    int32_t cols;
+    int32_t rows;
+};
+
+const scene::OutputChannel kChannels[] = {scene::OutputChannel::Color,
+                                          scene::OutputChannel::Depth,
+                                          scene::OutputChannel::Mask};
+
+/// differences of colors with the left pixel of the same row
+void filterColors(const uint8_t* color, int cols, int rows, std::vector<uint8_t>& out)
+{
+    const size_t stride = size_t(cols) * 4;
+    out.resize(stride * rows);
+    for (int y = 0; y < rows; ++y) {
+        const uint8_t* src = color + y * stride;
+        uint8_t* dst = out.data() + y * stride;
+        std::memcpy(dst, src, 4);
+        for (size_t i = 4; i < stride; ++i)
+            dst[i] = uint8_t(src[i] - src[i - 4]);
+    }
+}
+
+void unfilterColors(const std::vector<uint8_t>& filtered, int cols, int rows, uint8_t* color)
+{
+    const size_t stride = size_t(cols) * 4;
+    for (int y = 0; y < rows; ++y) {
+        const uint8_t* src = filtered.data() + y * stride;
+        uint8_t* dst = color + y * stride;
+        std::memcpy(dst, src, 4);
+        for (size_t i = 4; i < stride; ++i)
+            dst[i] = uint8_t(src[i] + dst[i - 4]);
+    }
+}
+
+/// differences of the bits of consecutive words, split into 4 byte planes
+void filterWords(const void* words, size_t count, std::vector<uint8_t>& out)
+{
+    out.resize(count * 4);
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t word;
+        std::memcpy(&word, static_cast<const uint8_t*>(words) + i * 4, 4);
+        const uint32_t delta = word - previous;
+        previous = word;
+        for (int b = 0; b < 4; ++b)
+            out[b * count + i] = uint8_t(delta >> (b * 8));
+    }
+}
+
+void unfilterWords(const std::vector<uint8_t>& filtered, size_t count, void* words)
+{
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t delta = 0;
+        for (int b = 0; b < 4; ++b)
+            delta |= uint32_t(filtered[b * count + i]) << (b * 8);
+        previous += delta;
+        std::memcpy(static_cast<uint8_t*>(words) + i * 4, &previous, 4);
+    }
+}
+
+} // namespace
+
+void encodeFrame(const FrameData& frame, std::vector<uint8_t>& out)
+{
+    const void* planes[] = {frame.color, frame.depth, frame.mask};
+    const size_t count = size_t(frame.cols) * size_t(frame.rows);
+
+    Header header{kMagic, kVersion, 0, frame.cols, frame.rows};
+    for (int p = 0; p < 3; ++p)
+        if (planes[p])
+            header.channels |= uint16_t(kChannels[p]);
+    out.resize(sizeof(header));
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    std::vector<uint8_t> filtered;
+    for (int p = 0; p < 3; ++p) {
+        if (!planes[p])
+            continue;
+        if (p == 0)
+            filterColors(frame.color, frame.cols, frame.rows, filtered);
+        else
+            filterWords(planes[p], count, filtered);
+
+        // plane size prefix, patched once compressed
+        const size_t start = out.size();
+        out.resize(start + 4);
+        lz4Compress(filtered.data(), filtered.size(), out);
+        const uint32_t size = uint32_t(out.size() - start - 4);
+        std::memcpy(out.data() + start, &size, 4);
+    }
+}
+
+EncodedFrameInfo encodedFrameInfo(const uint8_t* data, size_t size)
+{
+    Header header;
+    if (size < sizeof(header))
+        throw std::invalid_argument("Not an encoded frame");
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != kMagic || header.version != kVersion || header.cols < 0 ||
+        header.rows < 0)
+        throw std::invalid_argument("Not an encoded frame");
+    return {header.cols, header.rows, int(header.channels)};
+}
+
+void decodeFrame(const uint8_t* data, size_t size, FrameData& frame)
+{
+    const auto info = encodedFrameInfo(data, size);
+    if (info.cols != frame.cols || info.rows != frame.rows)
+        throw std::invalid_argument("Encoded frame size mismatch");
+
+    void* planes[] = {frame.color, frame.depth, frame.mask};
+    const size_t count = size_t(frame.cols) * size_t(frame.rows);
+    std::vector<uint8_t> filtered(count * 4);
+    size_t offset = sizeof(Header);
+    for (int p = 0; p < 3; ++p) {
+        if (!(info.channels & int(kChannels[p])))
+            continue;
+        uint32_t planeSize;
+        if (size - offset < 4)
+            throw std::invalid_argument("Truncated encoded frame");
+        std::memcpy(&planeSize, data + offset, 4);
+        offset += 4;
+        if (planeSize > size - offset)
+            throw std::invalid_argument("Truncated encoded frame");
+
+        if (planes[p]) {
+            if (!lz4Decompress(data + offset, planeSize, filtered.data(), filtered.size()))
+                throw std::invalid_argument("Corrupted encoded frame");
+            if (p == 0)
+                unfilterColors(filtered, frame.cols, frame.rows, frame.color);
+            else
+                unfilterWords(filtered, count, planes[p]);
+        }
+        offset += planeSize;
+    }
+}
+
+} // namespace render
@@ -0,0 +1,55 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Size and planes of an encoded frame
+ */
+struct EncodedFrameInfo {
+    int cols;
+    int rows;
+    int channels; //<- combination of scene::OutputChannel
+};
+
+/**
+ * @brief Losslessly compress the planes of a frame, e.g. for a transfer to a remote client
+ *
+ * Each plane is filtered, colors by a difference with the left pixel, depth and mask by a
+ * difference of the bits of consecutive pixels split into byte planes, then compressed in the
+ * LZ4 block format. Null planes are left out. Data is laid out in the byte order of the host.
+ *
+ * @param frame - rendered images
+ * @param out - encoded frame, replaced
+ */
+void encodeFrame(const FrameData& frame, std::vector<uint8_t>& out);
+
+/**
+ * @brief Read the size and planes of an encoded frame
+ *
+ * @throw std::invalid_argument - if \p data is not an encoded frame
+ */
+EncodedFrameInfo encodedFrameInfo(const uint8_t* data, size_t size);
+
+/**
+ * @brief Decode an encoded frame
+ *
+ * Planes of \p frame not in the encoded frame are left untouched, null planes are skipped.
+ *
+ * @param data - encoded frame
+ * @param size - encoded size
+ * @param frame - output planes, of the encoded size
+ * @throw std::invalid_argument - if \p data is corrupted or not of the size of \p frame
+ */
+void decodeFrame(const uint8_t* data, size_t size, FrameData& frame);
+
+} // namespace render
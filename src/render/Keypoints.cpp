@@ -0,0 +1,111 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "Keypoints.h"
+
+#include <utils/math.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace render {
+
+void projectKeypoints(const scene::SceneView& sceneView, const scene::SceneState& sceneState,
+                      int cols, int rows, const float* depth, float* output)
+{
+    const auto& keypoints = sceneView.keypoints();
+    if (!keypoints || keypoints->empty())
+        return;
+    const size_t count = keypoints->size();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    for (size_t i = 0; i < count; ++i) {
+        float* o = output + i * 4;
+        o[0] = o[1] = o[2] = nan;
+        o[3] = 0.f;
+    }
+    if (!sceneView.camera() || sceneView.projection() != scene::Projection::Perspective)
+        return;
+    // images of a multiview frame are stacked, the first one on top
+    rows /= sceneView.viewCount();
+
+    // world matrices of the nodes of the keypoints, composed with the view matrix at once
+    std::unordered_map<int, size_t> slots;
+    std::vector<int> nodes;
+    std::vector<size_t> pointSlots(count);
+    for (size_t i = 0; i < count; ++i) {
+        const int node = (*keypoints)[i].first;
+        const auto slot = slots.emplace(node, nodes.size());
+        if (slot.second)
+            nodes.push_back(node);
+        pointSlots[i] = slot.first->second;
+    }
+    std::vector<Matrix4f> worlds(nodes.size(), Matrix4f{0});
+    std::vector<bool> posed(nodes.size());
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        posed[n] = sceneState.hasNode(nodes[n]);
+        if (posed[n])
+            worlds[n] = sceneState.matrix(nodes[n]);
+    }
+    const auto& camera = *sceneView.camera();
+    std::vector<Matrix4f> modelViews(nodes.size());
+    multiplyMatrices(camera.viewMatrix(), worlds.data(), worlds.size(), modelViews.data());
+
+    // pixels of the region of interest in the whole image, as those of the lens map
+    const auto& p = camera.projMatrix();
+    const auto& viewport = sceneView.viewport();
+    const auto& lens = camera.distortion();
+    const bool distorted = sceneView.hasLensDistortion();
+    const float left = sceneView.hasRoi() ? float(sceneView.roi()[0]) : 0.f;
+    const float top = sceneView.hasRoi() ? float(sceneView.roi()[1]) : 0.f;
+    const auto imageSize = sceneView.imageSize();
+    const float scaleX = float(cols) / float(imageSize[0]);
+    const float scaleY = float(rows) / float(imageSize[1]);
+    for (size_t i = 0; i < count; ++i) {
+        if (!posed[pointSlots[i]])
+            continue;
+        const Vector3f v = transformPoint(modelViews[pointSlots[i]], (*keypoints)[i].second);
+        float nx, ny;
+        if (distorted) {
+            if (!(v[2] < 0.f))
+                continue;
+            // y down for the lens
+            float xd, yd;
+            lens.distort(v[0] / -v[2], v[1] / v[2], xd, yd);
+            nx = xd * p[0] - p[8];
+            ny = -yd * p[5] - p[9];
+        }
+        else {
+            const float w = p[3] * v[0] + p[7] * v[1] + p[11] * v[2] + p[15];
+            if (!(w > 0.f))
+                continue;
+            nx = (p[0] * v[0] + p[4] * v[1] + p[8] * v[2] + p[12]) / w;
+            ny = (p[1] * v[0] + p[5] * v[1] + p[9] * v[2] + p[13]) / w;
+        }
+        float* o = output + i * 4;
+        o[0] = ((nx * 0.5f + 0.5f) * viewport[0] - left) * scaleX;
+        o[1] = ((0.5f - ny * 0.5f) * viewport[1] - top) * scaleY;
+        o[2] = -v[2];
+        const int col = int(std::floor(o[0])), row = int(std::floor(o[1]));
+        if (!(v[2] < 0.f) || col < 0 || col >= cols || row < 0 || row >= rows)
+            continue;
+        // occluded by a surface nearer than the point, beyond the tolerance
+        const float d = depth ? depth[size_t(row) * size_t(cols) + size_t(col)] : 0.f;
+        o[3] = d > 0.f && d < o[2] - std::max(0.01f, o[2] * 0.01f) ? 0.f : 1.f;
+    }
+}
+
+void completeKeypoints(const scene::SceneView& sceneView, const scene::SceneState& sceneState,
+                       FrameData& frame)
+{
+    if (!frame.keypoints || !sceneView.hasOutputChannel(scene::OutputChannel::Keypoints))
+        return;
+    const bool depth = sceneView.hasOutputChannel(scene::OutputChannel::Depth);
+    projectKeypoints(sceneView, sceneState, frame.cols, frame.rows,
+                     depth ? frame.depth : nullptr, frame.keypoints);
+}
+
+} // namespace render
@@ -0,0 +1,42 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+namespace render {
+
+/**
+ * @brief Project the keypoints of a view into its image
+ *
+ * Each point of SceneView::keypoints() is posed by the world matrix of its node in \p sceneState,
+ * those of a node composed with the view matrix at once, and projected by the camera of the
+ * image as its pixels are drawn, through the lens if any: (x, y, depth, visible) with x, y the
+ * image position in pixels from the top left corner, pixel centers at halves, and depth the
+ * metric depth along the camera axis, as that of the depth plane. A point is visible if it is in
+ * front of the camera, within the image and not behind the surface drawn at its pixel, within 1
+ * cm or 1 % of its depth, whenever \p depth is given. Points of panoramic views and of nodes not
+ * in the state are NaN and not visible; those of multiview frames are projected in the first view.
+ *
+ * @param sceneView - view of the image
+ * @param sceneState - poses of the nodes
+ * @param cols - image width
+ * @param rows - image height
+ * @param depth - metric depth plane of the image, may be null
+ * @param output - 4 floats per keypoint
+ */
+void projectKeypoints(const scene::SceneView& sceneView, const scene::SceneState& sceneState,
+                      int cols, int rows, const float* depth, float* output);
+
+/**
+ * @brief Finish the Keypoints channel of a frame rendered with \p sceneView and \p sceneState
+ *
+ * Projects the keypoints of the view by projectKeypoints(), occluded by the depth plane if any.
+ * Frames without keypoints are left untouched.
+ */
+void completeKeypoints(const scene::SceneView& sceneView, const scene::SceneState& sceneState,
+                       FrameData& frame);
+
+} // namespace render
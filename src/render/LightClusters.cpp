@@ -0,0 +1,175 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace render {
+
+namespace {
+
+constexpr float kMinDepth = 0.05f; //<- front of the first slice at the nearest
+
+/// bounded light in the view, its tiles and depths
+struct LightBounds {
+    const scene::Light* light;
+    float distance; //<- from the camera
+    float nearDepth, farDepth;
+    int col0, col1, row0, row1;
+};
+
+/// tile of a normalized device coordinate, clamped to the view
+inline int tileOf(float ndc, int tiles)
+{
+    return std::min(std::max(int(std::floor((ndc * 0.5f + 0.5f) * tiles)), 0), tiles - 1);
+}
+
+/// screen bounds of the light sphere, false if it misses the view
+bool screenBounds(const Matrix4f& proj, const Vector3f& center, float range, LightBounds& bounds)
+{
+    bounds.col0 = bounds.row0 = 0;
+    bounds.col1 = LightClusters::kCols - 1;
+    bounds.row1 = LightClusters::kRows - 1;
+    // spheres crossing the near depth cover the whole view
+    if (bounds.nearDepth < kMinDepth)
+        return true;
+    // corners of its eye space box, all in front of the camera
+    float lo[2] = {INFINITY, INFINITY}, hi[2] = {-INFINITY, -INFINITY};
+    for (int corner = 0; corner < 8; ++corner) {
+        const float p[3] = {center[0] + (corner & 1 ? range : -range),
+                            center[1] + (corner & 2 ? range : -range),
+                            center[2] + (corner & 4 ? range : -range)};
+        const float w = proj[3] * p[0] + proj[7] * p[1] + proj[11] * p[2] + proj[15];
+        for (int k = 0; k < 2; ++k) {
+            const float ndc =
+                (proj[k] * p[0] + proj[4 + k] * p[1] + proj[8 + k] * p[2] + proj[12 + k]) / w;
+            lo[k] = std::min(lo[k], ndc);
+            hi[k] = std::max(hi[k], ndc);
+        }
+    }
+    if (hi[0] < -1.f || lo[0] > 1.f || hi[1] < -1.f || lo[1] > 1.f)
+        return false;
+    bounds.col0 = tileOf(lo[0], LightClusters::kCols);
+    bounds.col1 = tileOf(hi[0], LightClusters::kCols);
+    bounds.row0 = tileOf(lo[1], LightClusters::kRows);
+    bounds.row1 = tileOf(hi[1], LightClusters::kRows);
+    return true;
+}
+
+void appendLight(const scene::Light& light, std::vector<float>& data)
+{
+    const Vector3f position = light.position();
+    const Color3f color = light.diffuseColor();
+    Vector3f direction = light.direction();
+    const float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] +
+                                   direction[2] * direction[2]);
+    for (auto& value : direction)
+        value = length > 0.f ? value / length : 0.f;
+    // no cone for point lights, the outer fifth of the cone fading out for spot lights
+    const bool spot = light.type() == scene::LightType::SpotLight;
+    const float outer = spot ? std::cos(light.spotAngle()) : -2.f;
+    const float inner = spot ? std::cos(light.spotAngle() * 0.8f) : -2.f;
+    const float range = std::max(light.range(), 0.f);
+    const float texels[12] = {position[0],  position[1],  position[2],  range,
+                              color[0],     color[1],     color[2],     outer,
+                              direction[0], direction[1], direction[2], inner};
+    data.insert(data.end(), texels, texels + 12);
+}
+
+} // namespace
+
+void buildLightClusters(const std::vector<scene::Light>& lights, const Matrix4f& viewMatrix,
+                        const Matrix4f& projMatrix, LightClusters& clusters)
+{
+    clusters.lights.clear();
+    clusters.clusters.clear();
+    clusters.unbounded = 0;
+    clusters.bounded = 0;
+    clusters.nearDepth = 1.f;
+    clusters.sliceScale = 0.f;
+
+    std::vector<LightBounds> bounded;
+    for (const auto& light : lights) {
+        if (light.type() != scene::LightType::PointLight &&
+            light.type() != scene::LightType::SpotLight)
+            continue;
+        const float range = light.range();
+        if (range <= 0.f) {
+            if (clusters.unbounded < LightClusters::kMaxUnbounded) {
+                appendLight(light, clusters.lights);
+                ++clusters.unbounded;
+            }
+            continue;
+        }
+        const Vector3f center = transformPoint(viewMatrix, light.position());
+        LightBounds bounds;
+        bounds.light = &light;
+        bounds.distance =
+            std::sqrt(center[0] * center[0] + center[1] * center[1] + center[2] * center[2]);
+        bounds.nearDepth = -center[2] - range;
+        bounds.farDepth = -center[2] + range;
+        if (bounds.farDepth <= kMinDepth || !screenBounds(projMatrix, center, range, bounds))
+            continue;
+        bounded.push_back(bounds);
+    }
+    if (bounded.empty())
+        return;
+
+    // the nearest lights are kept by clusters listing too many
+    const auto nearer = [](const LightBounds& a, const LightBounds& b) {
+        return a.distance < b.distance;
+    };
+    std::stable_sort(bounded.begin(), bounded.end(), nearer);
+    float nearDepth = INFINITY, farDepth = 0.f;
+    for (const auto& bounds : bounded) {
+        appendLight(*bounds.light, clusters.lights);
+        nearDepth = std::min(nearDepth, bounds.nearDepth);
+        farDepth = std::max(farDepth, bounds.farDepth);
+    }
+    clusters.bounded = int(bounded.size());
+    nearDepth = std::max(nearDepth, kMinDepth);
+    farDepth = std::max(farDepth, nearDepth * 1.01f);
+    clusters.nearDepth = nearDepth;
+    clusters.sliceScale = LightClusters::kSlices / std::log(farDepth / nearDepth);
+    const auto sliceOf = [&](float depth) {
+        const float slice = std::floor(std::log(std::max(depth, nearDepth) / nearDepth) *
+                                       clusters.sliceScale);
+        return std::min(int(slice), LightClusters::kSlices - 1);
+    };
+
+    // counts, then offsets, then indices
+    auto& data = clusters.clusters;
+    data.assign(size_t(LightClusters::kCount) * 2, 0);
+    const auto forEachCluster = [&](const LightBounds& bounds, auto&& f) {
+        const int slice0 = sliceOf(bounds.nearDepth), slice1 = sliceOf(bounds.farDepth);
+        for (int slice = slice0; slice <= slice1; ++slice)
+            for (int row = bounds.row0; row <= bounds.row1; ++row)
+                for (int col = bounds.col0; col <= bounds.col1; ++col)
+                    f(LightClusters::clusterIndex(col, row, slice));
+    };
+    for (const auto& bounds : bounded) {
+        forEachCluster(bounds, [&](int cluster) {
+            auto& count = data[size_t(cluster) * 2 + 1];
+            count = std::min<uint32_t>(count + 1, LightClusters::kMaxClusterLights);
+        });
+    }
+    uint32_t offset = uint32_t(data.size());
+    for (int cluster = 0; cluster < LightClusters::kCount; ++cluster) {
+        data[size_t(cluster) * 2] = offset;
+        offset += data[size_t(cluster) * 2 + 1];
+        data[size_t(cluster) * 2 + 1] = 0;
+    }
+    data.resize(offset);
+    for (int i = 0; i < clusters.bounded; ++i) {
+        forEachCluster(bounded[i], [&](int cluster) {
+            auto& count = data[size_t(cluster) * 2 + 1];
+            if (count < LightClusters::kMaxClusterLights)
+                data[data[size_t(cluster) * 2] + count++] = uint32_t(clusters.unbounded + i);
+        });
+    }
+}
+
+} // namespace render
@@ -0,0 +1,75 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <scene/Light.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Point and spot lights of a view, assigned to the clusters of its frustum
+ *
+ * The view is split into kCols x kRows tiles of its normalized device coordinates and kSlices
+ * slices of eye depth, spaced exponentially from the nearest to the farthest depth the bounded
+ * lights reach. Each cluster lists the bounded lights whose sphere of range overlaps it, the
+ * nearest to the camera first, up to kMaxClusterLights, so that a pixel is lit by a bounded
+ * number of lights however many the scene holds. Lights without a range light every pixel, up to
+ * kMaxUnbounded of them.
+ *
+ * Lights are laid out for upload as 3 texels of 4 floats each: world position and range, diffuse
+ * color and cosine of the outer cone, spot direction and cosine of the inner cone, the cosine -2
+ * for point lights. Unbounded lights come first.
+ */
+struct LightClusters {
+    static constexpr int kCols = 16; //<- tiles across the view
+    static constexpr int kRows = 8; //<- tiles down the view
+    static constexpr int kSlices = 16; //<- depth slices
+    static constexpr int kMaxClusterLights = 32;
+    static constexpr int kMaxUnbounded = 8;
+    static constexpr int kCount = kCols * kRows * kSlices;
+
+    std::vector<float> lights; //<- 12 floats per light
+    int unbounded = 0; //<- leading lights lighting every pixel
+    int bounded = 0; //<- lights listed by the clusters, nearest first
+    float nearDepth = 1.f; //<- eye depth at the front of the first slice
+    float sliceScale = 0.f; //<- slices per unit of the log of the eye depth
+    // offset and count of the light indices of each cluster, then the indices, empty without
+    // bounded lights
+    std::vector<uint32_t> clusters;
+
+    /**
+     * @brief Index of the cluster of a tile and slice, columns first, then rows, then slices
+     */
+    static int clusterIndex(int col, int row, int slice)
+    {
+        return (slice * kRows + row) * kCols + col;
+    }
+
+    /**
+     * @brief Bounded lights listed by a cluster
+     */
+    int lightCount(int cluster) const
+    {
+        return clusters.empty() ? 0 : int(clusters[size_t(cluster) * 2 + 1]);
+    }
+};
+
+/**
+ * @brief Assign the point and spot lights of a view to its clusters
+ *
+ * Lights of other types are skipped, as are bounded ones outside of the view.
+ *
+ * @param lights - lights of the view, see scene::SceneView::lights()
+ * @param viewMatrix - view matrix of the camera
+ * @param projMatrix - projection matrix of the camera, as applied to the drawn view
+ * @param clusters - output
+ */
+void buildLightClusters(const std::vector<scene::Light>& lights, const Matrix4f& viewMatrix,
+                        const Matrix4f& projMatrix, LightClusters& clusters);
+
+} // namespace render
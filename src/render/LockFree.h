@@ -0,0 +1,131 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Lock-free triple buffer between one producer thread and one consumer thread
+ *
+ * The producer writes its back slot and publishes it, the consumer takes the latest published
+ * slot as its front one; neither ever waits for the other. A slot published while the previous
+ * one was not taken supersedes it, the superseded slot going back to the producer.
+ */
+template <class T>
+class TripleBuffer
+{
+  public:
+    /**
+     * @brief Slot written by the producer
+     */
+    T& back() { return _slots[_back]; }
+
+    /**
+     * @brief Publish the back slot, producer side
+     *
+     * @return True if the slot published before was never taken: it is the back slot again
+     */
+    bool publish()
+    {
+        const int previous = _middle.exchange(_back | kFresh, std::memory_order_acq_rel);
+        _back = previous & kIndex;
+        return (previous & kFresh) != 0;
+    }
+
+    /**
+     * @brief A slot was published since the last take
+     */
+    bool fresh() const { return (_middle.load(std::memory_order_acquire) & kFresh) != 0; }
+
+    /**
+     * @brief Make the latest published slot the front one, consumer side
+     *
+     * @return False if none was published since the last take, the front slot is unchanged
+     */
+    bool take()
+    {
+        if (!fresh())
+            return false;
+        const int previous = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front = previous & kIndex;
+        return true;
+    }
+
+    /**
+     * @brief Slot read by the consumer
+     */
+    T& front() { return _slots[_front]; }
+
+  private:
+    static constexpr int kIndex = 3;
+    static constexpr int kFresh = 4;
+
+    T _slots[3];
+    int _back = 0;               //<- owned by the producer
+    std::atomic<int> _middle{1}; //<- index of the exchanged slot, with kFresh once published
+    int _front = 2;              //<- owned by the consumer
+};
+
+/**
+ * @brief Bounded lock-free queue between one producer thread and one consumer thread
+ */
+template <class T>
+class SpscQueue
+{
+  public:
+    explicit SpscQueue(size_t capacity) : _items(capacity + 1) {}
+
+    /**
+     * @brief Append \p item, producer side
+     *
+     * @return False if the queue is full, \p item is left untouched
+     */
+    bool push(T&& item)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        const size_t next = (tail + 1) % _items.size();
+        if (next == _head.load(std::memory_order_acquire))
+            return false;
+        _items[tail] = std::move(item);
+        _tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the first item into \p item, consumer side
+     *
+     * @return False if the queue is empty
+     */
+    bool pop(T& item)
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+            return false;
+        item = std::move(_items[head]);
+        _items[head] = T(); //<- drop what the moved-from item still holds
+        _head.store((head + 1) % _items.size(), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief No item queued, exact on the consumer side
+     */
+    bool empty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+  private:
+    std::vector<T> _items; //<- one left empty to tell a full queue from an empty one
+    std::atomic<size_t> _head{0}; //<- next item popped, written by the consumer
+    std::atomic<size_t> _tail{0}; //<- next item pushed, written by the producer
+};
+
+} // namespace render
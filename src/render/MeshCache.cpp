@@ -0,0 +1,191 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "MeshCache.h"
+#include "AssetArchive.h"
+
+#include <utils/file.h>
+#include <utils/hash.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+namespace render {
+
+namespace {
+
+constexpr uint32_t kEntryMagic = 0x4d524250; //<- "PBRM"
+constexpr uint32_t kEntryVersion = 1;
+constexpr size_t kSectionAlignment = 16;
+
+/**
+ * @brief Header of a cache entry, followed by the vertices, uvs, normals and indices sections,
+ * each aligned to kSectionAlignment bytes
+ */
+struct EntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceSize; //<- size of the mesh file, against hash collisions
+    uint64_t sourceHash;
+    uint64_t numVertices; //<- floats of each section
+    uint64_t numUvs;
+    uint64_t numNormals;
+    uint64_t numIndices;
+};
+
+size_t aligned(size_t size)
+{
+    return (size + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+}
+
+std::mutex gMutex;
+bool gConfigured = false;
+std::string gDirectory;
+
+// taken across fork() so that children do not inherit it locked by a thread they lack
+const int gForkHandlers = pthread_atfork([] { gMutex.lock(); }, [] { gMutex.unlock(); },
+                                         [] { gMutex.unlock(); });
+
+std::string directory()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    if (!gConfigured) {
+        const char* directory = std::getenv("PYBULLET_RENDERING_MESH_CACHE");
+        gDirectory = directory ? directory : "";
+        gConfigured = true;
+    }
+    return gDirectory;
+}
+
+/// path of the entry of a mesh file, and the hash of the file
+std::string entryPath(const std::string& directory, const AssetFile& source,
+                      const std::string& loader, uint64_t& sourceHash)
+{
+    uint64_t hash = hashBytes(&kEntryVersion, sizeof(kEntryVersion));
+    hash = hashBytes(loader.data(), loader.size(), hash);
+    sourceHash = hashWords(source.data, source.size, hash);
+
+    char name[24];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(sourceHash));
+    return directory + "/" + name + ".mesh";
+}
+
+template <typename T>
+std::vector<T> readSection(const char*& data, uint64_t count)
+{
+    std::vector<T> values(static_cast<size_t>(count));
+    if (!values.empty())
+        std::memcpy(values.data(), data, values.size() * sizeof(T));
+    data += aligned(values.size() * sizeof(T));
+    return values;
+}
+
+template <typename T>
+void writeSection(std::ofstream& file, const std::vector<T>& values)
+{
+    static const char padding[kSectionAlignment] = {};
+    const size_t size = values.size() * sizeof(T);
+    file.write(reinterpret_cast<const char*>(values.data()), std::streamsize(size));
+    file.write(padding, std::streamsize(aligned(size) - size));
+}
+
+} // namespace
+
+void setMeshCacheDirectory(const std::string& directory)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gDirectory = directory;
+    gConfigured = true;
+}
+
+std::string meshCacheDirectory() { return directory(); }
+
+std::shared_ptr<scene::MeshData> loadCachedMesh(const std::string& filename,
+                                                const std::string& loader)
+{
+    const auto cacheDirectory = directory();
+    if (cacheDirectory.empty())
+        return nullptr;
+
+    const auto source = openAssetFile(filename);
+    if (!source)
+        return nullptr;
+    uint64_t sourceHash;
+    const MappedFile entry(entryPath(cacheDirectory, source, loader, sourceHash));
+    if (!entry.valid() || entry.size() < sizeof(EntryHeader))
+        return nullptr;
+
+    // entries are trusted only if consistent, e.g. not truncated by a full disk
+    EntryHeader header;
+    std::memcpy(&header, entry.data(), sizeof(header));
+    const uint64_t limit = entry.size() / sizeof(float);
+    if (header.magic != kEntryMagic || header.version != kEntryVersion ||
+        header.sourceSize != source.size || header.sourceHash != sourceHash ||
+        header.numVertices > limit || header.numUvs > limit || header.numNormals > limit ||
+        header.numIndices > limit || header.numVertices % 3 || header.numIndices % 3 ||
+        header.numNormals != header.numVertices)
+        return nullptr;
+    const size_t size = aligned(sizeof(EntryHeader)) +
+                        aligned(size_t(header.numVertices) * sizeof(float)) +
+                        aligned(size_t(header.numUvs) * sizeof(float)) +
+                        aligned(size_t(header.numNormals) * sizeof(float)) +
+                        aligned(size_t(header.numIndices) * sizeof(int));
+    if (size != entry.size())
+        return nullptr;
+
+    const char* data = entry.data() + aligned(sizeof(EntryHeader));
+    auto vertices = readSection<float>(data, header.numVertices);
+    auto uvs = readSection<float>(data, header.numUvs);
+    auto normals = readSection<float>(data, header.numNormals);
+    auto indices = readSection<int>(data, header.numIndices);
+    for (int index : indices)
+        if (index < 0 || uint64_t(index) * 3 >= header.numVertices)
+            return nullptr;
+
+    return std::make_shared<scene::MeshData>(std::move(vertices), std::move(uvs),
+                                             std::move(normals), std::move(indices));
+}
+
+void storeCachedMesh(const std::string& filename, const std::string& loader,
+                     const scene::MeshData& data)
+{
+    const auto cacheDirectory = directory();
+    if (cacheDirectory.empty() || data.normals().size() != data.vertices().size())
+        return;
+
+    const auto source = openAssetFile(filename);
+    if (!source || !makeDirectories(cacheDirectory))
+        return;
+    uint64_t sourceHash;
+    const auto path = entryPath(cacheDirectory, source, loader, sourceHash);
+
+    EntryHeader header = {kEntryMagic,
+                          kEntryVersion,
+                          source.size,
+                          sourceHash,
+                          data.vertices().size(),
+                          data.uvs().size(),
+                          data.normals().size(),
+                          data.indices().size()};
+
+    writeFileAtomically(path, [&](std::ofstream& file) {
+        std::vector<char> head(aligned(sizeof(header)), 0);
+        std::memcpy(head.data(), &header, sizeof(header));
+        file.write(head.data(), std::streamsize(head.size()));
+        writeSection(file, data.vertices());
+        writeSection(file, data.uvs());
+        writeSection(file, data.normals());
+        writeSection(file, data.indices());
+    });
+}
+
+} // namespace render
@@ -0,0 +1,51 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <scene/Mesh.h>
+
+#include <memory>
+#include <string>
+
+namespace render {
+
+/**
+ * @brief Set the directory of the persistent mesh cache, empty to disable it
+ *
+ * Parsed mesh files are stored there as flat binary entries, indexed and with normals, so that
+ * later processes map them instead of parsing the files again. Entries are named after the
+ * content of the mesh file and the loader, so that renamed or touched files still hit and
+ * edited ones miss. Defaults to the PYBULLET_RENDERING_MESH_CACHE environment variable.
+ *
+ * @param directory - cache directory, created on the first store
+ */
+void setMeshCacheDirectory(const std::string& directory);
+
+/**
+ * @brief Directory of the persistent mesh cache, empty if disabled
+ */
+std::string meshCacheDirectory();
+
+/**
+ * @brief Load the cached mesh of a mesh file
+ *
+ * @param filename - mesh file on disk
+ * @param loader - name of the loader which parsed the file, e.g. "native" or "trimesh"
+ * @return std::shared_ptr<scene::MeshData> - mesh data, null if not cached or cache disabled
+ */
+std::shared_ptr<scene::MeshData> loadCachedMesh(const std::string& filename,
+                                                const std::string& loader);
+
+/**
+ * @brief Store the mesh parsed from a mesh file, atomically, failures are ignored
+ *
+ * @param filename - mesh file on disk
+ * @param loader - name of the loader which parsed the file
+ * @param data - mesh data, with normals for every vertex
+ */
+void storeCachedMesh(const std::string& filename, const std::string& loader,
+                     const scene::MeshData& data);
+
+} // namespace render
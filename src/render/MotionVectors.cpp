@@ -0,0 +1,99 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "MotionVectors.h"
+#include "PackedFrame.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace render {
+
+void reprojectMotion(const scene::SceneView& sceneView, const scene::SceneGraph* sceneGraph,
+                     const scene::SceneState& sceneState, int cols, int rows, const float* depth,
+                     const int* mask, uint16_t* motion)
+{
+    std::fill_n(motion, size_t(cols) * size_t(rows) * 2, uint16_t(0));
+    if (!sceneView.camera() || sceneView.projection() != scene::Projection::Perspective)
+        return;
+    const auto camera = sceneView.imageCamera();
+    const auto previous = sceneView.previousImageCamera();
+    const Matrix4f& p = camera.projMatrix();
+    const Matrix4f& pose = camera.poseMatrix();
+    const Matrix4f previousViewProj = multiply(previous.projMatrix(), previous.viewMatrix());
+
+    // world points of the nodes which moved back to their previous poses, by segmentation id;
+    // ids shared by nodes with different motions, e.g. semantic classes, are left still
+    std::unordered_map<int, Matrix4f> moved;
+    std::unordered_set<int> still;
+    const auto& previousState = sceneView.previousState();
+    if (mask && sceneGraph && previousState) {
+        for (const auto& it : sceneGraph->nodes()) {
+            const int nodeId = it.first;
+            if (!sceneState.hasNode(nodeId) || !previousState->hasNode(nodeId))
+                continue;
+            const auto& current = sceneState.matrix(nodeId);
+            const auto& before = previousState->matrix(nodeId);
+            const bool moves = current != before;
+            const Matrix4f motion = moves ? multiply(before, affineInverse(current)) : current;
+            for (int i = 0; i < int(it.second.shapes().size()); ++i) {
+                const int id = it.second.segmentation(i, sceneGraph->segmentationMode());
+                if (!moves || (!moved.emplace(id, motion).second && moved.at(id) != motion))
+                    still.insert(id);
+            }
+        }
+        for (int id : still)
+            moved.erase(id);
+    }
+
+    for (int row = 0; row < rows; ++row) {
+        for (int col = 0; col < cols; ++col) {
+            const size_t i = size_t(row) * cols + col;
+            const float d = depth[i];
+            if (!(d > 0.f))
+                continue;
+            // metric depth along -z, w of a perspective or orthographic projection
+            const float x = (col + 0.5f) / cols * 2.f - 1.f;
+            const float y = 1.f - (row + 0.5f) / rows * 2.f;
+            const float z = -d;
+            const float w = p[11] * z + p[15];
+            const Vector3f eye{(x * w - p[8] * z - p[12]) / p[0],
+                               (y * w - p[9] * z - p[13]) / p[5], z};
+            Vector3f world = transformPoint(pose, eye);
+            if (!moved.empty()) {
+                const auto found = moved.find(mask[i]);
+                if (found != moved.end())
+                    world = transformPoint(found->second, world);
+            }
+            const auto& m = previousViewProj;
+            const float clipX = m[0] * world[0] + m[4] * world[1] + m[8] * world[2] + m[12];
+            const float clipY = m[1] * world[0] + m[5] * world[1] + m[9] * world[2] + m[13];
+            const float clipW = m[3] * world[0] + m[7] * world[1] + m[11] * world[2] + m[15];
+            if (!(clipW > 0.f))
+                continue;
+            // pixel centers of the previous frame, rows going down
+            const float previousCol = (clipX / clipW + 1.f) * 0.5f * cols;
+            const float previousRow = (1.f - clipY / clipW) * 0.5f * rows;
+            motion[i * 2] = halfFloat(col + 0.5f - previousCol);
+            motion[i * 2 + 1] = halfFloat(row + 0.5f - previousRow);
+        }
+    }
+}
+
+void completeMotion(const scene::SceneView& sceneView, const scene::SceneGraph* sceneGraph,
+                    const scene::SceneState& sceneState, FrameData& frame)
+{
+    if (!frame.motion || frame.motionDrawn ||
+        !sceneView.hasOutputChannel(scene::OutputChannel::Motion))
+        return;
+    if (!frame.depth) {
+        std::fill_n(frame.motion, size_t(frame.cols) * size_t(frame.rows) * 2, uint16_t(0));
+        return;
+    }
+    reprojectMotion(sceneView, sceneGraph, sceneState, frame.cols, frame.rows, frame.depth,
+                    frame.mask, frame.motion);
+}
+
+} // namespace render
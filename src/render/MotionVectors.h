@@ -0,0 +1,44 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+namespace render {
+
+/**
+ * @brief Reproject a metric depth image into the motion of its pixels since the previous frame
+ *
+ * Surface points are unprojected by the image camera of \p sceneView, moved back by the pose
+ * change of their node since SceneView::previousState() and projected by the previous image
+ * camera, see scene::SceneView::previousState() for the motion stored. Nodes are found by the
+ * segmentation ids of \p mask among the nodes of \p sceneGraph; points of unknown nodes, of ids
+ * shared by nodes moving differently, or all of them without a mask or a graph, are taken as
+ * static.
+ *
+ * @param sceneView - perspective view the depth was rendered with
+ * @param sceneGraph - nodes of the scene, may be null
+ * @param sceneState - current poses
+ * @param cols - image width
+ * @param rows - image height
+ * @param depth - metric depth of each pixel
+ * @param mask - segmentation id of each pixel, may be null
+ * @param motion - output, 2 half floats per pixel
+ */
+void reprojectMotion(const scene::SceneView& sceneView, const scene::SceneGraph* sceneGraph,
+                     const scene::SceneState& sceneState, int cols, int rows, const float* depth,
+                     const int* mask, uint16_t* motion);
+
+/**
+ * @brief Finish the Motion channel of a frame rendered with \p sceneView
+ *
+ * Reprojects the depth plane by reprojectMotion() unless the renderer drew the motion. Frames
+ * without a motion plane are left untouched, the motion of those without a depth plane and of
+ * panoramic views is zero.
+ */
+void completeMotion(const scene::SceneView& sceneView, const scene::SceneGraph* sceneGraph,
+                    const scene::SceneState& sceneState, FrameData& frame);
+
+} // namespace render
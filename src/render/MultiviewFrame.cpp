@@ -0,0 +1,60 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "MultiviewFrame.h"
+
+namespace render {
+
+MultiviewFrame::MultiviewFrame()
+    : _singleView(std::make_shared<scene::SceneView>()),
+      _singleCamera(std::make_shared<scene::Camera>())
+{
+}
+
+bool MultiviewFrame::render(BaseRenderer& renderer,
+                            const std::shared_ptr<scene::SceneState>& sceneState,
+                            const scene::SceneView& sceneView, FrameData& outputFrame)
+{
+    const int views = sceneView.viewCount();
+    if (!sceneView.camera() || outputFrame.rows % views)
+        return false;
+    const int cols = outputFrame.cols, rows = outputFrame.rows / views;
+
+    *_singleView = sceneView;
+    _singleView->setMultiviewCameras({});
+    _singleView->setCamera(_singleCamera);
+    _singleView->setViewport({cols, rows});
+    _singleView->setOutputChannels(sceneView.outputChannels() &
+                                   (int(scene::OutputChannel::Color) |
+                                    int(scene::OutputChannel::Depth) |
+                                    int(scene::OutputChannel::Mask)));
+
+    // views go in place into their rows, the renderer packing them or leaving it to the caller
+    const size_t pixels = size_t(cols) * size_t(rows);
+    bool packed = true;
+    for (int view = 0; view < views; ++view) {
+        *_singleCamera = sceneView.viewCamera(view);
+        const size_t offset = pixels * view;
+        const auto at = [offset](auto* plane, size_t channels) {
+            return plane ? plane + offset * channels : nullptr;
+        };
+        FrameData viewFrame{cols,
+                            rows,
+                            at(outputFrame.color, 4),
+                            at(outputFrame.depth, 1),
+                            at(outputFrame.mask, 1),
+                            nullptr,
+                            nullptr,
+                            at(outputFrame.packedColor, 3),
+                            at(outputFrame.packedDepth, 1),
+                            at(outputFrame.packedMask, 1)};
+        if (!renderer.renderFrame(sceneState, _singleView, viewFrame))
+            return false;
+        packed = packed && viewFrame.packed;
+    }
+    outputFrame.packed = packed;
+    return true;
+}
+
+} // namespace render
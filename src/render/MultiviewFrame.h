@@ -0,0 +1,39 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+#include <memory>
+
+namespace render {
+
+/**
+ * @brief Multiview frames rendered view by view into their rows of the frame
+ *
+ * For renderers without a multiview path of their own: each view is rendered through
+ * BaseRenderer::renderFrame() at the same scene state by a single view of its camera, in place in
+ * the planes of the output frame, packed ones included. See scene::SceneView::multiviewCameras().
+ */
+class MultiviewFrame
+{
+  public:
+    MultiviewFrame();
+
+    /**
+     * @brief Render the multiview view \p sceneView through \p renderer
+     *
+     * @return False if the view has no camera, if the frame rows are not a multiple of its views
+     * or if a view was not rendered
+     */
+    bool render(BaseRenderer& renderer, const std::shared_ptr<scene::SceneState>& sceneState,
+                const scene::SceneView& sceneView, FrameData& outputFrame);
+
+  private:
+    std::shared_ptr<scene::SceneView> _singleView; //<- view of the current camera
+    std::shared_ptr<scene::Camera> _singleCamera;
+};
+
+} // namespace render
@@ -0,0 +1,358 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "ObjParser.h"
+#include "AssetArchive.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace render {
+
+namespace {
+
+constexpr size_t kChunkSize = size_t(4) << 20; //<- bytes per thread when picked automatically
+
+/// exactly representable powers of ten, for the fast path of parseFloat()
+constexpr double kPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                   1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                   1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/// elements of a chunk of lines, indices resolved except the relative ones
+struct Chunk {
+    std::vector<float> positions; //<- xyz
+    std::vector<float> uvs;       //<- uv
+    std::vector<float> normals;   //<- xyz
+    std::vector<int> corners;     //<- position, uv, normal of each face corner, -1 if absent
+    std::vector<int> faceSizes;
+    std::vector<size_t> relative; //<- corners slots relative to the first element of the chunk
+    bool valid = true;
+};
+
+/// corner of a face sharing the position of a previous vertex, but not its uv or normal
+struct Corner {
+    int p, t, n;
+    bool operator==(const Corner& other) const
+    {
+        return p == other.p && t == other.t && n == other.n;
+    }
+};
+
+struct CornerHash {
+    size_t operator()(const Corner& corner) const
+    {
+        uint64_t hash = uint64_t(uint32_t(corner.p)) * 0x9e3779b97f4a7c15ull;
+        hash ^= (uint64_t(uint32_t(corner.t)) << 32 | uint32_t(corner.n)) + (hash >> 29);
+        return size_t(hash * 0xbf58476d1ce4e5b9ull);
+    }
+};
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char* skipBlanks(const char* s, const char* end)
+{
+    while (s != end && isBlank(*s))
+        ++s;
+    return s;
+}
+
+/// strtod of the token at \p s, copied since the text may not be null-terminated
+bool parseFloatSlow(const char*& s, const char* end, float& value)
+{
+    char buffer[64];
+    size_t size = 0;
+    while (s + size != end && !isBlank(s[size]) && s[size] != '\n' && size + 1 < sizeof(buffer)) {
+        buffer[size] = s[size];
+        ++size;
+    }
+    buffer[size] = '\0';
+    char* stop;
+    const double number = std::strtod(buffer, &stop);
+    if (stop == buffer)
+        return false;
+    s += stop - buffer;
+    value = float(number);
+    return true;
+}
+
+/**
+ * @brief Parse a decimal number, exactly rounded
+ *
+ * Mantissas up to 2^53 and powers of ten up to 22 are computed exactly in double precision,
+ * other numbers, infinities and nans go through strtod.
+ */
+bool parseFloat(const char*& s, const char* end, float& value)
+{
+    s = skipBlanks(s, end);
+    const char* p = s;
+    const bool negative = p != end && *p == '-';
+    if (p != end && (*p == '-' || *p == '+'))
+        ++p;
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    const char* start = p;
+    for (; p != end && isDigit(*p); ++p) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + uint64_t(*p - '0');
+            digits += mantissa != 0;
+        }
+        else {
+            ++exponent;
+        }
+    }
+    bool any = p != start;
+    if (p != end && *p == '.') {
+        const char* fraction = ++p;
+        for (; p != end && isDigit(*p); ++p) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + uint64_t(*p - '0');
+                digits += mantissa != 0;
+                --exponent;
+            }
+        }
+        any = any || p != fraction;
+    }
+    if (!any)
+        return parseFloatSlow(s, end, value);
+
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        const bool negativeExponent = e != end && *e == '-';
+        if (e != end && (*e == '-' || *e == '+'))
+            ++e;
+        if (e != end && isDigit(*e)) {
+            int number = 0;
+            for (; e != end && isDigit(*e); ++e)
+                if (number < 100000)
+                    number = number * 10 + (*e - '0');
+            exponent += negativeExponent ? -number : number;
+            p = e;
+        }
+    }
+
+    if (mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22) {
+        if (mantissa != 0)
+            return parseFloatSlow(s, end, value);
+        exponent = 0;
+    }
+    double number = double(mantissa);
+    number = exponent < 0 ? number / kPowersOfTen[-exponent] : number * kPowersOfTen[exponent];
+    value = float(negative ? -number : number);
+    s = p;
+    return true;
+}
+
+/// parse an integer, 0 if there are no digits
+int parseIndex(const char*& s, const char* end)
+{
+    const bool negative = s != end && *s == '-';
+    if (s != end && (*s == '-' || *s == '+'))
+        ++s;
+    int64_t number = 0;
+    for (; s != end && isDigit(*s); ++s)
+        if (number <= INT32_MAX)
+            number = number * 10 + (*s - '0');
+    number = std::min<int64_t>(number, INT32_MAX);
+    return int(negative ? -number : number);
+}
+
+/// parse up to \p count floats, missing ones are 0
+void parseFloats(const char* s, const char* end, int count, std::vector<float>& values)
+{
+    for (int i = 0; i < count; ++i) {
+        float value = 0.f;
+        if (s != end)
+            parseFloat(s, end, value);
+        values.push_back(value);
+    }
+}
+
+/// parse the corners of a face line after its tag
+void parseFace(const char* s, const char* end, Chunk& chunk)
+{
+    const int counts[3] = {int(chunk.positions.size() / 3), int(chunk.uvs.size() / 2),
+                           int(chunk.normals.size() / 3)};
+    int size = 0;
+    while ((s = skipBlanks(s, end)) != end) {
+        int ids[3] = {0, 0, 0};
+        ids[0] = parseIndex(s, end);
+        for (int k = 1; k < 3 && s != end && *s == '/'; ++k)
+            ids[k] = parseIndex(++s, end);
+        while (s != end && !isBlank(*s))
+            ++s;
+
+        if (ids[0] == 0) {
+            chunk.valid = false;
+            return;
+        }
+        for (int k = 0; k < 3; ++k) {
+            if (ids[k] < 0) {
+                chunk.relative.push_back(chunk.corners.size());
+                chunk.corners.push_back(counts[k] + ids[k]);
+            }
+            else {
+                chunk.corners.push_back(ids[k] - 1);
+            }
+        }
+        ++size;
+    }
+    chunk.faceSizes.push_back(size);
+}
+
+void parseChunk(const char* s, const char* end, Chunk& chunk)
+{
+    while (s < end && chunk.valid) {
+        const char* next = static_cast<const char*>(std::memchr(s, '\n', size_t(end - s)));
+        const char* lineEnd = next ? next : end;
+        s = skipBlanks(s, lineEnd);
+
+        if (lineEnd - s >= 2) {
+            if (s[0] == 'v' && isBlank(s[1]))
+                parseFloats(s + 1, lineEnd, 3, chunk.positions);
+            else if (s[0] == 'v' && s[1] == 't' && (lineEnd - s == 2 || isBlank(s[2])))
+                parseFloats(s + 2, lineEnd, 2, chunk.uvs);
+            else if (s[0] == 'v' && s[1] == 'n' && (lineEnd - s == 2 || isBlank(s[2])))
+                parseFloats(s + 2, lineEnd, 3, chunk.normals);
+            else if (s[0] == 'f' && isBlank(s[1]))
+                parseFace(s + 1, lineEnd, chunk);
+        }
+        s = lineEnd + 1;
+    }
+}
+
+template <typename T>
+void append(std::vector<T>& values, const std::vector<T>& more)
+{
+    values.insert(values.end(), more.begin(), more.end());
+}
+
+} // namespace
+
+std::shared_ptr<scene::MeshData> parseObj(const char* data, size_t size, int numThreads)
+{
+    if (numThreads <= 0) {
+        const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        numThreads = int(std::min(cores, size / kChunkSize + 1));
+    }
+
+    // line-aligned chunks, the first one parsed by the calling thread
+    std::vector<Chunk> chunks(size_t(std::max(numThreads, 1)));
+    std::vector<const char*> bounds{data};
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        const char* bound = std::max(bounds.back(), data + size * i / chunks.size());
+        const char* next = bound == data + size ? nullptr
+                                                : static_cast<const char*>(std::memchr(
+                                                      bound, '\n', size_t(data + size - bound)));
+        bounds.push_back(next ? next + 1 : data + size);
+    }
+    bounds.push_back(data + size);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunks.size(); ++i)
+        threads.emplace_back(parseChunk, bounds[i], bounds[i + 1], std::ref(chunks[i]));
+    parseChunk(bounds[0], bounds[1], chunks[0]);
+    for (auto& thread : threads)
+        thread.join();
+
+    // relative indices against the elements of the previous chunks
+    std::vector<float> positions, uvs, normals;
+    for (auto& chunk : chunks) {
+        if (!chunk.valid)
+            return nullptr;
+        const int offsets[3] = {int(positions.size() / 3), int(uvs.size() / 2),
+                                int(normals.size() / 3)};
+        for (const size_t slot : chunk.relative)
+            chunk.corners[slot] += offsets[slot % 3];
+        append(positions, chunk.positions);
+        append(uvs, chunk.uvs);
+        append(normals, chunk.normals);
+        chunk.positions = {};
+        chunk.uvs = {};
+        chunk.normals = {};
+    }
+    const int numPositions = int(positions.size() / 3);
+    const int numUvs = int(uvs.size() / 2);
+    const int numNormals = int(normals.size() / 3);
+
+    std::vector<float> meshVertices, meshUvs, meshNormals;
+    std::vector<int> meshIndices;
+    meshVertices.reserve(positions.size());
+
+    // most corners reuse the first vertex of their position, others are looked up
+    std::vector<int> positionVertex(size_t(numPositions), -1);
+    std::vector<std::pair<int, int>> vertexAttributes; //<- uv, normal
+    std::unordered_map<Corner, int, CornerHash> seams;
+
+    const auto makeVertex = [&](int p, int t, int n) {
+        meshVertices.insert(meshVertices.end(), &positions[size_t(p) * 3],
+                            &positions[size_t(p) * 3] + 3);
+        if (numUvs) {
+            const float zero[2] = {0.f, 0.f};
+            const float* uv = t >= 0 ? &uvs[size_t(t) * 2] : zero;
+            meshUvs.insert(meshUvs.end(), uv, uv + 2);
+        }
+        if (numNormals) {
+            const float zero[3] = {0.f, 0.f, 0.f};
+            const float* normal = n >= 0 ? &normals[size_t(n) * 3] : zero;
+            meshNormals.insert(meshNormals.end(), normal, normal + 3);
+        }
+        vertexAttributes.emplace_back(t, n);
+        return int(vertexAttributes.size()) - 1;
+    };
+
+    for (const auto& chunk : chunks) {
+        const int* corner = chunk.corners.data();
+        for (const int faceSize : chunk.faceSizes) {
+            int first = -1, previous = -1;
+            for (int k = 0; k < faceSize; ++k, corner += 3) {
+                const int p = corner[0], t = corner[1], n = corner[2];
+                if (p < 0 || p >= numPositions || t < -1 || t >= numUvs || n < -1 ||
+                    n >= numNormals)
+                    return nullptr;
+
+                int& vertex = positionVertex[size_t(p)];
+                int index;
+                if (vertex < 0) {
+                    vertex = index = makeVertex(p, t, n);
+                }
+                else if (vertexAttributes[size_t(vertex)] == std::make_pair(t, n)) {
+                    index = vertex;
+                }
+                else {
+                    const auto it = seams.emplace(Corner{p, t, n}, 0);
+                    if (it.second)
+                        it.first->second = makeVertex(p, t, n);
+                    index = it.first->second;
+                }
+
+                if (k >= 2)
+                    meshIndices.insert(meshIndices.end(), {first, previous, index});
+                first = k == 0 ? index : first;
+                previous = index;
+            }
+        }
+    }
+
+    return std::make_shared<scene::MeshData>(std::move(meshVertices), std::move(meshUvs),
+                                             std::move(meshNormals), std::move(meshIndices));
+}
+
+std::shared_ptr<scene::MeshData> loadObj(const std::string& filename, int numThreads)
+{
+    const auto file = openAssetFile(filename);
+    if (!file)
+        return nullptr;
+    return parseObj(file.data, file.size, numThreads);
+}
+
+} // namespace render
@@ -0,0 +1,38 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <scene/Mesh.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace render {
+
+/**
+ * @brief Parse a Wavefront OBJ text, all objects merged, materials ignored
+ *
+ * The text is split into line-aligned chunks tokenized by their own threads without allocating
+ * per token, then merged into the flat MeshData layout. Vertices are the distinct position, uv
+ * and normal triples of the face corners in order of first use, polygons are fanned.
+ *
+ * @param data - OBJ text, not necessarily null-terminated
+ * @param size - text size in bytes
+ * @param numThreads - number of chunks, 0 for one per few megabytes up to the number of cores
+ * @return std::shared_ptr<scene::MeshData> - mesh data, null if a face refers to a missing element
+ */
+std::shared_ptr<scene::MeshData> parseObj(const char* data, size_t size, int numThreads = 0);
+
+/**
+ * @brief Load a Wavefront OBJ file, memory mapped, see parseObj()
+ *
+ * @param filename - OBJ file on disk or served from memory, see openAssetFile()
+ * @param numThreads - number of chunks, 0 for one per few megabytes up to the number of cores
+ * @return std::shared_ptr<scene::MeshData> - mesh data, null if the file cannot be read or parsed
+ */
+std::shared_ptr<scene::MeshData> loadObj(const std::string& filename, int numThreads = 0);
+
+} // namespace render
@@ -0,0 +1,70 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "PackedFrame.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace render {
+
+uint16_t halfFloat(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const int exponent = int((bits >> 23) & 0xffu) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffffu;
+    if (exponent >= 31) {
+        // too large, infinite or not a number
+        const bool nan = (bits & 0x7fffffffu) > 0x7f800000u;
+        return uint16_t(sign | 0x7c00u | (nan ? 0x200u : 0u));
+    }
+    int shift = 13;
+    uint32_t half = (uint32_t(std::max(exponent, 0)) << 10);
+    if (exponent <= 0) {
+        // subnormal, or zero below the smallest one
+        if (exponent < -10)
+            return uint16_t(sign);
+        mantissa |= 0x800000u;
+        shift = 14 - exponent;
+    }
+    half |= mantissa >> shift;
+    // a carry out of the mantissa rounds up to the next exponent
+    const uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1u)))
+        ++half;
+    return uint16_t(sign | half);
+}
+
+void packFrame(const scene::SceneView& sceneView, FrameData& frame)
+{
+    if (frame.packed)
+        return;
+    const size_t numPixels = size_t(frame.cols) * size_t(frame.rows);
+    if (frame.color && frame.packedColor && sceneView.colorFormat() == scene::ColorFormat::RGB) {
+        for (size_t i = 0; i < numPixels; ++i)
+            std::copy_n(frame.color + i * 4, 3, frame.packedColor + i * 3);
+    }
+    if (frame.depth && frame.packedDepth) {
+        const float* depth = frame.depth;
+        uint16_t* packed = frame.packedDepth;
+        if (sceneView.depthFormat() == scene::DepthFormat::Float16) {
+            std::transform(depth, depth + numPixels, packed, halfFloat);
+        }
+        else if (sceneView.depthFormat() == scene::DepthFormat::UInt16) {
+            const float scale = sceneView.depthScale();
+            std::transform(depth, depth + numPixels, packed, [scale](float d) {
+                return uint16_t(std::min(std::max(std::round(d * scale), 0.f), 65535.f));
+            });
+        }
+    }
+    if (frame.mask && frame.packedMask && sceneView.maskFormat() == scene::MaskFormat::UInt16) {
+        std::transform(frame.mask, frame.mask + numPixels, frame.packedMask,
+                       [](int id) { return uint16_t(id & 0xffff); });
+    }
+}
+
+} // namespace render
@@ -0,0 +1,27 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+#include <cstdint>
+
+namespace render {
+
+/**
+ * @brief Half float of a float, rounded to nearest even, infinite if out of range
+ */
+uint16_t halfFloat(float value);
+
+/**
+ * @brief Convert the full planes of a frame rendered with \p sceneView into its packed planes
+ *
+ * Packed planes are written for the channels of reduced formats, see
+ * scene::SceneView::colorFormat(), unless the renderer set FrameData::packed. Must be called once
+ * per rendered frame; planes missing from the frame are skipped.
+ */
+void packFrame(const scene::SceneView& sceneView, FrameData& frame);
+
+} // namespace render
@@ -0,0 +1,96 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "PanoramaFaces.h"
+
+#include <algorithm>
+
+namespace render {
+
+PanoramaFaces::PanoramaFaces()
+    : _faceView(std::make_shared<scene::SceneView>()),
+      _faceCamera(std::make_shared<scene::Camera>())
+{
+}
+
+bool PanoramaFaces::render(BaseRenderer& renderer,
+                           const std::shared_ptr<scene::SceneState>& sceneState,
+                           const scene::SceneView& sceneView, FrameData& outputFrame)
+{
+    const auto& camera = sceneView.camera();
+    const auto projection = sceneView.projection();
+    const int size = scene::panoramaFaceSize(projection, outputFrame.cols, outputFrame.rows);
+    if (!camera || !size)
+        return false;
+
+    *_faceView = sceneView;
+    _faceView->setProjection(scene::Projection::Perspective);
+    // faces ignore the region of interest and render scale of the panorama
+    _faceView->setRoi({0, 0, 0, 0});
+    _faceView->setRenderScale(1.f);
+    _faceView->setViewport({size, size});
+    _faceView->setCamera(_faceCamera);
+
+    // planes of channels not requested are left untouched
+    const bool hasColor =
+        outputFrame.color && sceneView.hasOutputChannel(scene::OutputChannel::Color);
+    const bool hasDepth =
+        outputFrame.depth && sceneView.hasOutputChannel(scene::OutputChannel::Depth);
+    const bool hasMask = outputFrame.mask && sceneView.hasOutputChannel(scene::OutputChannel::Mask);
+    const size_t facePixels = size_t(size) * size_t(size);
+    const bool cubemap = projection == scene::Projection::Cubemap;
+    if (!cubemap) {
+        if (hasColor)
+            _color.resize(facePixels * 6 * 4);
+        if (hasDepth)
+            _depth.resize(facePixels * 6);
+        if (hasMask)
+            _mask.resize(facePixels * 6);
+    }
+    // faces go in place into the cubemap strip, into the buffers otherwise
+    uint8_t* color = cubemap ? outputFrame.color : _color.data();
+    float* depth = cubemap ? outputFrame.depth : _depth.data();
+    int* mask = cubemap ? outputFrame.mask : _mask.data();
+
+    for (int face = 0; face < 6; ++face) {
+        *_faceCamera = scene::cubemapFaceCamera(*camera, scene::CubemapFace(face));
+        const size_t offset = facePixels * face;
+        FrameData faceFrame{size, size, hasColor ? color + offset * 4 : nullptr,
+                            hasDepth ? depth + offset : nullptr, hasMask ? mask + offset : nullptr};
+        if (!renderer.renderFrame(sceneState, _faceView, faceFrame))
+            return false;
+    }
+    if (cubemap)
+        return true;
+
+    const int cols = outputFrame.cols, rows = outputFrame.rows;
+    if (_lookupCols != cols || _lookupRows != rows) {
+        _lookup.resize(size_t(cols) * rows);
+        for (int row = 0; row < rows; ++row) {
+            for (int col = 0; col < cols; ++col) {
+                const auto direction = scene::equirectangularDirection(col, row, cols, rows);
+                const auto texel = scene::cubemapTexel(direction, size);
+                _lookup[size_t(row) * cols + col] = {
+                    int(facePixels * texel.face) + texel.row * size + texel.col, texel.cosine};
+            }
+        }
+        _lookupCols = cols;
+        _lookupRows = rows;
+    }
+    for (size_t i = 0; i < _lookup.size(); ++i) {
+        const auto& lookup = _lookup[i];
+        if (hasColor)
+            std::copy_n(&_color[size_t(lookup.index) * 4], 4, &outputFrame.color[i * 4]);
+        if (hasDepth) {
+            // metric depth along the face axis to the distance from the camera
+            const float d = _depth[lookup.index];
+            outputFrame.depth[i] = d > 0.f ? d / lookup.cosine : 0.f;
+        }
+        if (hasMask)
+            outputFrame.mask[i] = _mask[lookup.index];
+    }
+    return true;
+}
+
+} // namespace render
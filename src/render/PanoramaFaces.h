@@ -0,0 +1,56 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Panoramic views rendered as the six perspective views of their cubemap faces
+ *
+ * For renderers without a panoramic path of their own: faces are rendered one after the other
+ * through BaseRenderer::renderFrame() at the same scene state. Cubemap faces are written in
+ * place in the planes of the output frame, equirectangular images are reprojected from faces
+ * rendered into buffers kept across frames, through a table of the face pixel of each image
+ * pixel built once per image size.
+ */
+class PanoramaFaces
+{
+  public:
+    PanoramaFaces();
+
+    /**
+     * @brief Render the panoramic view \p sceneView through \p renderer
+     *
+     * @return False if the view has no camera, if the frame size does not fit its projection
+     * or if a face was not rendered
+     */
+    bool render(BaseRenderer& renderer, const std::shared_ptr<scene::SceneState>& sceneState,
+                const scene::SceneView& sceneView, FrameData& outputFrame);
+
+  private:
+    /// face pixel and cosine to the face axis of each equirectangular pixel
+    struct Lookup {
+        int index; //<- face * size * size + row * size + col
+        float cosine;
+    };
+
+    std::shared_ptr<scene::SceneView> _faceView; //<- perspective view of the current face
+    std::shared_ptr<scene::Camera> _faceCamera;
+    // faces of equirectangular images
+    std::vector<uint8_t> _color;
+    std::vector<float> _depth;
+    std::vector<int> _mask;
+    std::vector<Lookup> _lookup;
+    int _lookupCols = 0; //<- image size of the lookup table
+    int _lookupRows = 0;
+};
+
+} // namespace render
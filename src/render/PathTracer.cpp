@@ -0,0 +1,869 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "PathTracer.h"
+#include "AssetLoader.h"
+#include "StageStats.h"
+#include "ThreadAffinity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace render {
+
+namespace {
+
+constexpr int kLeafSize = 4; //<- triangles per leaf at most
+constexpr int kStackSize = 64;
+constexpr float kNoHit = 1e30f; //<- ray length of unbounded rays
+constexpr float kLightSpread = 0.02f; //<- half angle of the light cone of soft shadows, radians
+constexpr float kShininess = 32.f; //<- exponent of the specular highlights
+constexpr float kMinAlbedo = 1e-3f; //<- darker channels are filtered as is
+constexpr int kFilterPasses = 4; //<- a-trous passes, of steps 1, 2, 4 and 8 pixels
+constexpr float kNormalPhi = 32.f; //<- exponent of the normal weights of the filter
+constexpr float kDepthPhi = 0.02f; //<- relative depth difference of weights 1/e, per step
+constexpr float kLumaPhi = 0.1f; //<- relative lighting difference of weights 1/e
+constexpr float kKernel[5] = {1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f};
+
+float dot(const Vector3f& a, const Vector3f& b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+Vector3f cross(const Vector3f& a, const Vector3f& b)
+{
+    return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+
+Vector3f normalized(const Vector3f& v)
+{
+    const float length = std::sqrt(dot(v, v));
+    return length > 0.f ? Vector3f{v[0] / length, v[1] / length, v[2] / length} : v;
+}
+
+Vector3f transformVector(const Matrix4f& m, const Vector3f& v)
+{
+    return {m[0] * v[0] + m[4] * v[1] + m[8] * v[2], m[1] * v[0] + m[5] * v[1] + m[9] * v[2],
+            m[2] * v[0] + m[6] * v[1] + m[10] * v[2]};
+}
+
+/// normal \p n of a shape frame in the world frame, from the inverse of the shape matrix
+Vector3f transformNormal(const Matrix4f& inverse, const Vector3f& n)
+{
+    return normalized({inverse[0] * n[0] + inverse[1] * n[1] + inverse[2] * n[2],
+                       inverse[4] * n[0] + inverse[5] * n[1] + inverse[6] * n[2],
+                       inverse[8] * n[0] + inverse[9] * n[1] + inverse[10] * n[2]});
+}
+
+Vector3f reflect(const Vector3f& d, const Vector3f& n)
+{
+    const float k = 2.f * dot(d, n);
+    return {d[0] - k * n[0], d[1] - k * n[1], d[2] - k * n[2]};
+}
+
+/// RGB texels of a bitmap, top row first, the last channel repeated for gray ones
+std::vector<unsigned char> rgbTexels(const scene::Bitmap& bitmap)
+{
+    const int channels = int(bitmap.channels());
+    const size_t count = size_t(bitmap.cols()) * size_t(bitmap.rows());
+    std::vector<unsigned char> texels(count * 3);
+    const uint8_t* data = bitmap.data();
+    for (size_t p = 0; p < count; ++p)
+        for (int k = 0; k < 3; ++k)
+            texels[p * 3 + k] = data[p * channels + std::min(k, channels - 1)];
+    return texels;
+}
+
+/// uniform floats in [0, 1) of a PCG generator
+class Random
+{
+  public:
+    explicit Random(uint32_t seed) : _state(hash(seed)) {}
+
+    /// integer hash of good avalanche, for seeds of neighboring pixels
+    static uint32_t hash(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    float next()
+    {
+        _state = _state * 747796405u + 2891336453u;
+        uint32_t word = ((_state >> ((_state >> 28u) + 4u)) ^ _state) * 277803737u;
+        word = (word >> 22u) ^ word;
+        return float(word >> 8) * (1.f / 16777216.f);
+    }
+
+  private:
+    uint32_t _state;
+};
+
+/// direction around the unit vector \p axis, cosine-weighted over the hemisphere with \p spread
+/// 0, uniform over a cone of half angle \p spread otherwise
+Vector3f sampleAround(const Vector3f& axis, float spread, Random& random)
+{
+    // orthonormal basis of Duff et al.
+    const float sign = std::copysign(1.f, axis[2]);
+    const float a = -1.f / (sign + axis[2]);
+    const float b = axis[0] * axis[1] * a;
+    const Vector3f t{1.f + sign * axis[0] * axis[0] * a, sign * b, -sign * axis[0]};
+    const Vector3f s{b, sign + axis[1] * axis[1] * a, -axis[1]};
+
+    const float u = random.next(), phi = 2.f * float(M_PI) * random.next();
+    float cosTheta, sinTheta;
+    if (spread > 0.f) {
+        cosTheta = 1.f - u * (1.f - std::cos(spread));
+        sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+    } else {
+        sinTheta = std::sqrt(u);
+        cosTheta = std::sqrt(std::max(0.f, 1.f - u));
+    }
+    const float x = sinTheta * std::cos(phi), y = sinTheta * std::sin(phi);
+    return {t[0] * x + s[0] * y + axis[0] * cosTheta, t[1] * x + s[1] * y + axis[1] * cosTheta,
+            t[2] * x + s[2] * y + axis[2] * cosTheta};
+}
+
+float luma(const Color3f& c) { return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2]; }
+
+/// run \p function over rows on \p numThreads threads, 0 for one per core
+template <class Function>
+void parallelRows(int rows, int numThreads, const Function& function)
+{
+    const int count = std::min(
+        numThreads > 0 ? numThreads : int(std::max(1u, std::thread::hardware_concurrency())),
+        rows);
+    std::atomic<int> next(0);
+    const auto work = [&] {
+        for (int row = next++; row < rows; row = next++)
+            function(row);
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < count; ++i)
+        workers.emplace_back([&] {
+            placeThread("path tracer worker", -1);
+            work();
+        });
+    work();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+} // namespace
+
+/**
+ * @brief Triangles of a mesh in a depth-first tree of boxes, the left child of an inner node
+ * following it, with the normals and uvs of their corners
+ */
+struct PathTracer::Blas {
+    struct Triangle {
+        Vector3f v0;
+        Vector3f e1; //<- v1 - v0
+        Vector3f e2; //<- v2 - v0
+    };
+
+    struct Corners {
+        Vector3f normals[3]; //<- zero if the mesh has none
+        float uvs[3][2];
+    };
+
+    struct Node {
+        Vector3f lower;
+        Vector3f upper;
+        int first; //<- first triangle of a leaf, right child of an inner node
+        int count; //<- triangles of a leaf, 0 for inner nodes
+        int axis; //<- split axis of an inner node
+    };
+
+    std::shared_ptr<scene::MeshData> data; //<- kept alive for the cache key
+    std::vector<Triangle> triangles;
+    std::vector<Corners> corners; //<- of each triangle
+    std::vector<Node> nodes;
+    scene::AABB bounds;
+
+    explicit Blas(const std::shared_ptr<scene::MeshData>& meshData) : data(meshData)
+    {
+        const auto& vertices = data->vertices();
+        const auto& normals = data->normals();
+        const auto& uvs = data->uvs();
+        const auto& indices = data->indices();
+        const int count = int(indices.size() / 3);
+        const size_t numVertices = vertices.size() / 3;
+        const bool hasNormals = normals.size() == vertices.size();
+        const bool hasUvs = uvs.size() == numVertices * 2;
+        std::vector<Triangle> source;
+        std::vector<Corners> sourceCorners;
+        source.reserve(count);
+        sourceCorners.reserve(count);
+        for (int t = 0; t < count; ++t) {
+            const int* index = &indices[size_t(t) * 3];
+            if (size_t(index[0]) >= numVertices || size_t(index[1]) >= numVertices ||
+                size_t(index[2]) >= numVertices)
+                continue;
+            const float* a = &vertices[size_t(index[0]) * 3];
+            const float* b = &vertices[size_t(index[1]) * 3];
+            const float* c = &vertices[size_t(index[2]) * 3];
+            source.push_back({{a[0], a[1], a[2]},
+                              {b[0] - a[0], b[1] - a[1], b[2] - a[2]},
+                              {c[0] - a[0], c[1] - a[1], c[2] - a[2]}});
+            Corners corner = {};
+            for (int k = 0; k < 3; ++k) {
+                if (hasNormals)
+                    std::copy_n(&normals[size_t(index[k]) * 3], 3, corner.normals[k].data());
+                if (hasUvs)
+                    std::copy_n(&uvs[size_t(index[k]) * 2], 2, corner.uvs[k]);
+            }
+            sourceCorners.push_back(corner);
+        }
+
+        std::vector<int> order(source.size());
+        std::vector<Vector3f> centroids(source.size());
+        for (int t = 0; t < int(source.size()); ++t) {
+            order[t] = t;
+            for (int k = 0; k < 3; ++k)
+                centroids[t][k] = source[t].v0[k] + (source[t].e1[k] + source[t].e2[k]) / 3.f;
+        }
+        bounds = scene::AABB::Empty();
+        if (!order.empty())
+            build(order.begin(), order.end(), order.begin(), source, centroids);
+        for (const auto& node : nodes) {
+            if (node.count)
+                bounds.extend(scene::AABB{node.lower, node.upper});
+        }
+        triangles.reserve(source.size());
+        corners.reserve(source.size());
+        for (int t : order) {
+            triangles.push_back(source[t]);
+            corners.push_back(sourceCorners[t]);
+        }
+    }
+
+    size_t bytes() const
+    {
+        return triangles.size() * (sizeof(Triangle) + sizeof(Corners)) +
+               nodes.size() * sizeof(Node);
+    }
+
+    /// top-down build, splitting centroids at the median of the longest axis
+    void build(std::vector<int>::iterator begin, std::vector<int>::iterator end,
+               std::vector<int>::iterator order, const std::vector<Triangle>& source,
+               const std::vector<Vector3f>& centroids)
+    {
+        const int index = int(nodes.size());
+        nodes.push_back(Node{});
+        scene::AABB box = scene::AABB::Empty(), centers = scene::AABB::Empty();
+        for (auto it = begin; it != end; ++it) {
+            const auto& t = source[*it];
+            box.extend(t.v0);
+            box.extend(Vector3f{t.v0[0] + t.e1[0], t.v0[1] + t.e1[1], t.v0[2] + t.e1[2]});
+            box.extend(Vector3f{t.v0[0] + t.e2[0], t.v0[1] + t.e2[1], t.v0[2] + t.e2[2]});
+            centers.extend(centroids[*it]);
+        }
+        nodes[index].lower = box.lower;
+        nodes[index].upper = box.upper;
+
+        const int count = int(end - begin);
+        if (count <= kLeafSize) {
+            nodes[index].first = int(begin - order);
+            nodes[index].count = count;
+            return;
+        }
+
+        int axis = 0;
+        for (int k = 1; k < 3; ++k)
+            if (centers.upper[k] - centers.lower[k] > centers.upper[axis] - centers.lower[axis])
+                axis = k;
+        const auto middle = begin + count / 2;
+        std::nth_element(begin, middle, end,
+                         [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+        nodes[index].axis = axis;
+        nodes[index].count = 0;
+        build(begin, middle, order, source, centroids);
+        nodes[index].first = int(nodes.size());
+        build(middle, end, order, source, centroids);
+    }
+
+    /// closest hit closer than \p tmax, any hit if \p any
+    bool intersect(const Vector3f& o, const Vector3f& d, float tmin, float& tmax, int& triangle,
+                   float& u, float& v, bool any) const
+    {
+        const Vector3f inv{1.f / d[0], 1.f / d[1], 1.f / d[2]};
+        int stack[kStackSize];
+        int size = 0;
+        int index = 0;
+        bool found = false;
+        while (true) {
+            const Node& node = nodes[index];
+            float t0 = tmin, t1 = tmax;
+            for (int k = 0; k < 3; ++k) {
+                float a = (node.lower[k] - o[k]) * inv[k];
+                float b = (node.upper[k] - o[k]) * inv[k];
+                if (a > b)
+                    std::swap(a, b);
+                t0 = a > t0 ? a : t0;
+                t1 = b < t1 ? b : t1;
+            }
+
+            if (t0 <= t1 && node.count) {
+                for (int t = node.first; t < node.first + node.count; ++t) {
+                    if (intersect(triangles[t], o, d, tmin, tmax, u, v)) {
+                        triangle = t;
+                        found = true;
+                        if (any)
+                            return true;
+                    }
+                }
+            }
+            else if (t0 <= t1) {
+                int near = index + 1, far = node.first;
+                if (d[node.axis] < 0.f)
+                    std::swap(near, far);
+                if (size < kStackSize)
+                    stack[size++] = far;
+                index = near;
+                continue;
+            }
+            if (!size)
+                break;
+            index = stack[--size];
+        }
+        return found;
+    }
+
+    /// Moller-Trumbore
+    static bool intersect(const Triangle& tri, const Vector3f& o, const Vector3f& d, float tmin,
+                          float& tmax, float& u, float& v)
+    {
+        const Vector3f p = cross(d, tri.e2);
+        const float det = dot(tri.e1, p);
+        if (det == 0.f)
+            return false;
+        const float inv = 1.f / det;
+        const Vector3f s{o[0] - tri.v0[0], o[1] - tri.v0[1], o[2] - tri.v0[2]};
+        const float a = dot(s, p) * inv;
+        if (a < 0.f || a > 1.f)
+            return false;
+        const Vector3f q = cross(s, tri.e1);
+        const float b = dot(d, q) * inv;
+        if (b < 0.f || a + b > 1.f)
+            return false;
+        const float t = dot(tri.e2, q) * inv;
+        if (t < tmin || t >= tmax)
+            return false;
+        tmax = t;
+        u = a;
+        v = b;
+        return true;
+    }
+};
+
+struct PathTracer::Hit {
+    float t = kNoHit;
+    const Instance* instance = nullptr;
+    int triangle = 0;
+    float u = 0.f; //<- barycentric coordinate of the second corner
+    float v = 0.f; //<- barycentric coordinate of the third corner
+};
+
+struct PathTracer::Scratch {
+    std::vector<int> candidates; //<- nodes whose bounds the ray crosses
+    scene::BVH::Stack stack;
+};
+
+/**
+ * @brief Camera and light of a frame, shading the surfaces hit by its paths
+ */
+struct PathTracer::Frame {
+    /// surface hit by a ray
+    struct Surface {
+        Vector3f position;
+        Vector3f normal; //<- interpolated, facing the ray
+        Vector3f offset; //<- along the face normal on the side of the ray, for secondary rays
+        Color3f albedo;
+        Color3f specular;
+        int segmentation;
+    };
+
+    const PathTracer& tracer;
+    Color3f background;
+    Color3f ambient; //<- light from every direction, of paths leaving the scene
+    Color3f diffuse; //<- of the light
+    Color3f highlight; //<- specular color of the light, 0 without specular quality
+    Vector3f toLight; //<- direction of a directional light, position of others
+    bool directional = true;
+    bool lit = true; //<- false for an ambient light
+    float range = 0.f; //<- of point and spot lights, 0 for unbounded
+    float spotCos = -1.f; //<- of the half angle of spot lights
+    Vector3f spotDirection; //<- light to target
+    bool shadows = false;
+
+    Frame(const PathTracer& pathTracer, const scene::SceneView& sceneView) : tracer(pathTracer)
+    {
+        background = sceneView.backgroundColor();
+        // default light close to the one of the python renderers
+        toLight = normalized({-0.8f, -0.2f, 2.f});
+        ambient = {0.6f, 0.6f, 0.6f};
+        diffuse = {0.35f, 0.35f, 0.35f};
+        highlight = {0.05f, 0.05f, 0.05f};
+        if (const auto& light = sceneView.light()) {
+            const auto& direction = light->direction();
+            ambient = light->ambientColor();
+            diffuse = light->diffuseColor();
+            highlight = light->specularColor();
+            lit = light->type() != scene::LightType::AmbientLight;
+            directional = light->type() != scene::LightType::PointLight &&
+                          light->type() != scene::LightType::SpotLight;
+            toLight = directional ? normalized({-direction[0], -direction[1], -direction[2]})
+                                  : light->position();
+            range = light->range();
+            spotDirection = normalized(direction);
+            if (light->type() == scene::LightType::SpotLight)
+                spotCos = std::cos(light->spotAngle());
+            shadows = light->isShadowCaster() && sceneView.quality().shadows;
+        }
+        if (!sceneView.quality().specular)
+            highlight = {0.f, 0.f, 0.f};
+    }
+
+    Surface surface(const Hit& hit, const Vector3f& origin, const Vector3f& direction) const
+    {
+        const Instance& instance = *hit.instance;
+        const auto& tri = instance.blas->triangles[hit.triangle];
+        const auto& corners = instance.blas->corners[hit.triangle];
+        const float w = 1.f - hit.u - hit.v;
+
+        Surface s;
+        for (int k = 0; k < 3; ++k)
+            s.position[k] = origin[k] + direction[k] * hit.t;
+        Vector3f face = transformNormal(instance.inverse, cross(tri.e1, tri.e2));
+        if (dot(face, direction) > 0.f)
+            face = {-face[0], -face[1], -face[2]};
+        Vector3f n;
+        for (int k = 0; k < 3; ++k)
+            n[k] = corners.normals[0][k] * w + corners.normals[1][k] * hit.u +
+                   corners.normals[2][k] * hit.v;
+        s.normal = dot(n, n) > 0.f ? transformNormal(instance.inverse, n) : face;
+        if (dot(s.normal, face) < 0.f)
+            s.normal = {-s.normal[0], -s.normal[1], -s.normal[2]};
+        const float scale = 1e-4f * (1.f + std::max({std::abs(s.position[0]),
+                                                     std::abs(s.position[1]),
+                                                     std::abs(s.position[2])}));
+        for (int k = 0; k < 3; ++k)
+            s.offset[k] = s.position[k] + face[k] * scale;
+
+        s.albedo = instance.albedo;
+        if (!instance.texels.empty()) {
+            // OpenGL convention, v from the bottom row
+            const float u = corners.uvs[0][0] * w + corners.uvs[1][0] * hit.u +
+                            corners.uvs[2][0] * hit.v;
+            const float v = corners.uvs[0][1] * w + corners.uvs[1][1] * hit.u +
+                            corners.uvs[2][1] * hit.v;
+            const int col = int((u - std::floor(u)) * instance.cols) % instance.cols;
+            const int row = int((1.f - (v - std::floor(v))) * instance.rows) % instance.rows;
+            const unsigned char* texel = &instance.texels[(size_t(row) * instance.cols + col) * 3];
+            for (int k = 0; k < 3; ++k)
+                s.albedo[k] *= texel[k] / 255.f;
+        }
+        s.specular = instance.specular;
+        s.segmentation = instance.segmentation;
+        return s;
+    }
+
+    /// light reflected by \p s towards the origin of the ray of unit \p direction
+    Color3f shade(const Surface& s, const Vector3f& direction, int depth, Random& random,
+                  Scratch& scratch) const
+    {
+        Color3f light = {0.f, 0.f, 0.f}, reflected = {0.f, 0.f, 0.f};
+
+        // direct light through a cone, for soft shadows
+        if (lit) {
+            Vector3f axis = toLight;
+            float distance = kNoHit, fade = 1.f;
+            if (!directional) {
+                const Vector3f to{toLight[0] - s.position[0], toLight[1] - s.position[1],
+                                  toLight[2] - s.position[2]};
+                distance = std::sqrt(dot(to, to));
+                axis = normalized(to);
+                if (range > 0.f && distance > range)
+                    fade = 0.f;
+                if (spotCos > -1.f) {
+                    const float c = -dot(axis, spotDirection);
+                    fade *= std::min(1.f, std::max(0.f, (c - spotCos) / (0.2f * (1.f - spotCos))));
+                }
+            }
+            const Vector3f l = sampleAround(axis, kLightSpread, random);
+            const float cosine = dot(s.normal, l);
+            if (fade > 0.f && cosine > 0.f &&
+                !(shadows && tracer.intersect(s.offset, l, 0.f, distance, nullptr, scratch))) {
+                for (int k = 0; k < 3; ++k)
+                    light[k] += diffuse[k] * cosine * fade;
+                const float power = std::pow(std::max(0.f, dot(reflect(direction, s.normal), l)),
+                                             kShininess);
+                for (int k = 0; k < 3; ++k)
+                    reflected[k] += highlight[k] * s.specular[k] * power * fade;
+            }
+        }
+
+        // ambient light, occluded and interreflected by the diffuse bounces
+        if (depth < tracer._bounces) {
+            const Color3f in = trace(s.offset, sampleAround(s.normal, 0.f, random), depth + 1,
+                                     random, scratch, ambient);
+            for (int k = 0; k < 3; ++k)
+                light[k] += in[k];
+        } else {
+            for (int k = 0; k < 3; ++k)
+                light[k] += ambient[k];
+        }
+
+        // mirror reflection of specular materials
+        const float mirror = std::max({highlight[0] * s.specular[0], highlight[1] * s.specular[1],
+                                       highlight[2] * s.specular[2]});
+        if (depth < tracer._bounces && mirror > 0.f) {
+            const Color3f in = trace(s.offset, reflect(direction, s.normal), depth + 1, random,
+                                     scratch, ambient);
+            for (int k = 0; k < 3; ++k)
+                reflected[k] += highlight[k] * s.specular[k] * in[k];
+        }
+
+        return {s.albedo[0] * light[0] + reflected[0], s.albedo[1] * light[1] + reflected[1],
+                s.albedo[2] * light[2] + reflected[2]};
+    }
+
+    /// light along a ray of unit \p direction, \p miss if it leaves the scene
+    Color3f trace(const Vector3f& origin, const Vector3f& direction, int depth, Random& random,
+                  Scratch& scratch, const Color3f& miss) const
+    {
+        Hit hit;
+        if (!tracer.intersect(origin, direction, 0.f, kNoHit, &hit, scratch))
+            return miss;
+        return shade(surface(hit, origin, direction), direction, depth, random, scratch);
+    }
+};
+
+PathTracer::PathTracer(int numThreads) : _numThreads(numThreads)
+{
+    // assets of new shapes start loading before the scene update needs them
+    setAssetPrefetch(true);
+}
+
+PathTracer::~PathTracer() = default;
+
+size_t PathTracer::numTriangles() const
+{
+    size_t count = 0;
+    for (const auto& it : _blas)
+        count += it.second->triangles.size();
+    return count;
+}
+
+RendererMemory PathTracer::memoryUsage() const
+{
+    RendererMemory memory;
+    memory.hostBytes = _sceneBytes + _frameBytes;
+    return memory;
+}
+
+void PathTracer::updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph, bool)
+{
+    // hierarchies of meshes still in the scene are moved over, the others released
+    std::map<const void*, std::shared_ptr<Blas>> previous;
+    previous.swap(_blas);
+    _nodes.clear();
+    _bounds.clear();
+    _bvh.invalidate();
+    _segmentationMode = sceneGraph->segmentationMode();
+    prefetchAssets(*sceneGraph); //<- loaded in parallel, consumed in order
+    for (const auto& it : sceneGraph->nodes()) {
+        for (const auto& shape : it.second.shapes()) {
+            const auto mesh = loadMeshData(shape);
+            const auto cached = mesh ? previous.find(mesh.get()) : previous.end();
+            if (cached != previous.end())
+                _blas.insert(*cached);
+        }
+        updateNode(it.first, it.second);
+    }
+
+    size_t bytes = 0;
+    for (const auto& it : _blas)
+        bytes += it.second->bytes();
+    for (const auto& it : _nodes)
+        for (const auto& instance : it.second)
+            bytes += sizeof(Instance) + instance.texels.size();
+    _sceneBytes = bytes;
+}
+
+void PathTracer::updateNode(int nodeId, const scene::Node& node)
+{
+    std::vector<Instance> instances;
+    scene::AABB bounds = scene::AABB::Empty();
+    const auto& shapes = node.shapes();
+    for (int i = 0; i < int(shapes.size()); ++i) {
+        const auto& shape = shapes[i];
+        const auto mesh = loadMeshData(shape);
+        if (!mesh || mesh->indices().empty())
+            continue;
+        auto& blas = _blas[mesh.get()];
+        if (!blas)
+            blas = std::make_shared<Blas>(mesh);
+        if (blas->triangles.empty())
+            continue;
+
+        Instance instance;
+        instance.shapeIndex = i;
+        instance.blas = blas;
+        instance.matrix = shape.pose().matrix();
+        instance.inverse = affineInverse(instance.matrix);
+        instance.segmentation = node.segmentation(i, _segmentationMode);
+        instance.albedo = {1.f, 1.f, 1.f};
+        instance.specular = {1.f, 1.f, 1.f};
+        instance.cols = instance.rows = 0;
+        if (const auto& material = shape.material()) {
+            const auto& color = material->diffuseColor();
+            instance.albedo = {color[0], color[1], color[2]};
+            instance.specular = material->specularColor();
+            const auto& texture = material->diffuseTexture();
+            const auto bitmap = texture ? loadBitmap(*texture) : nullptr;
+            if (bitmap && bitmap->channels() > 0 && bitmap->cols() > 0 && bitmap->rows() > 0) {
+                instance.texture = texture;
+                instance.texels = rgbTexels(*bitmap);
+                instance.cols = int(bitmap->cols());
+                instance.rows = int(bitmap->rows());
+            }
+        }
+        bounds.extend(blas->bounds.transformed(instance.matrix));
+        instances.push_back(std::move(instance));
+    }
+    if (instances.empty())
+        return;
+    _bounds.updateNode(nodeId, bounds);
+    _nodes[nodeId] = std::move(instances);
+}
+
+bool PathTracer::updateShapeMaterial(int nodeId, int shapeIndex,
+                                     const std::shared_ptr<scene::Material>& material)
+{
+    const auto it = _nodes.find(nodeId);
+    if (it == _nodes.end())
+        return true; //<- shape not drawn
+    for (auto& instance : it->second) {
+        if (instance.shapeIndex != shapeIndex)
+            continue;
+        const auto texture = material ? material->diffuseTexture() : nullptr;
+        if (texture != instance.texture)
+            return false;
+        const Color4f color = material ? material->diffuseColor() : Color4f{1.f, 1.f, 1.f, 1.f};
+        instance.albedo = {color[0], color[1], color[2]};
+        instance.specular = material ? material->specularColor() : Color3f{1.f, 1.f, 1.f};
+    }
+    return true;
+}
+
+bool PathTracer::intersect(const Vector3f& origin, const Vector3f& direction, float tmin,
+                           float tmax, Hit* hit, Scratch& scratch) const
+{
+    const Vector3f inv{1.f / direction[0], 1.f / direction[1], 1.f / direction[2]};
+    float distance = 0.f;
+    _bvh.collect(
+        [&](const scene::AABB& box) { return box.intersectsRay(origin, inv, tmax, distance); },
+        scratch.candidates, scratch.stack);
+
+    bool found = false;
+    for (int nodeId : scratch.candidates) {
+        const auto it = _nodes.find(nodeId);
+        if (it == _nodes.end() || !_sceneState->hasNode(nodeId))
+            continue;
+        for (const auto& instance : it->second) {
+            // distances along rays are kept by the affine transform to the shape frame
+            const Vector3f o = transformPoint(instance.inverse, origin);
+            const Vector3f d = transformVector(instance.inverse, direction);
+            int triangle = -1;
+            float u = 0.f, v = 0.f;
+            if (!instance.blas->intersect(o, d, tmin, tmax, triangle, u, v, !hit))
+                continue;
+            if (!hit)
+                return true;
+            *hit = {tmax, &instance, triangle, u, v};
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool PathTracer::renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                             const std::shared_ptr<scene::SceneView>& sceneView,
+                             FrameData& outputFrame)
+{
+    const int cols = outputFrame.cols, rows = outputFrame.rows;
+    if (!sceneView->camera() || cols <= 0 || rows <= 0)
+        return false;
+    if (sceneView->projection() != scene::Projection::Perspective)
+        return _panorama.render(*this, sceneState, *sceneView, outputFrame);
+    if (sceneView->hasMultiview())
+        return _multiview.render(*this, sceneState, *sceneView, outputFrame);
+    if (sceneView->hasLensDistortion())
+        return _distorted.render(*this, sceneState, *sceneView, outputFrame);
+    if (sceneView->hasRenderScale())
+        return _scaled.render(*this, sceneState, *sceneView, outputFrame);
+    // a region of interest is traced alone by a camera of its projection
+    const scene::Camera camera = sceneView->imageCamera();
+
+    // planes of channels not requested are not written, depth and mask only frames not shaded
+    uint8_t* const colorPlane =
+        sceneView->hasOutputChannel(scene::OutputChannel::Color) ? outputFrame.color : nullptr;
+    float* const depthPlane =
+        sceneView->hasOutputChannel(scene::OutputChannel::Depth) ? outputFrame.depth : nullptr;
+    int* const maskPlane =
+        sceneView->hasOutputChannel(scene::OutputChannel::Mask) ? outputFrame.mask : nullptr;
+
+    StageTimer render(Stage::Render);
+    {
+        StageTimer timer(Stage::StateSync);
+        _bvh.update(_bounds, *sceneState);
+        for (auto& it : _nodes) {
+            if (!sceneState->hasNode(it.first))
+                continue;
+            const Matrix4f& nodeMatrix = sceneState->matrix(it.first);
+            for (auto& instance : it.second)
+                instance.inverse = affineInverse(multiply(nodeMatrix, instance.matrix));
+        }
+        _sceneState = sceneState.get();
+    }
+
+    // rays of unit depth along the camera axis, so that distances are metric depths
+    const Matrix4f& p = camera.projMatrix();
+    const bool orthographic = p[11] == 0.f;
+    const float znear = orthographic ? (p[14] + 1.f) / p[10] : p[14] / (p[10] - 1.f);
+    const float zfar = orthographic ? (p[14] - 1.f) / p[10]
+                                    : (p[10] + 1.f != 0.f ? p[14] / (p[10] + 1.f) : kNoHit);
+    const Matrix4f cameraToWorld = affineInverse(camera.viewMatrix());
+    const Frame frame(*this, *sceneView);
+    const int samples = colorPlane ? _samples : 1;
+
+    const size_t pixels = size_t(cols) * size_t(rows);
+    _pixels.resize(pixels);
+    parallelRows(rows, _numThreads, [&](int row) {
+        Scratch scratch;
+        for (int col = 0; col < cols; ++col) {
+            const size_t index = size_t(row) * cols + col;
+            Pixel& pixel = _pixels[index];
+            pixel = {{0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}, 0.f, -1};
+            Random random(static_cast<uint32_t>(index));
+            for (int sample = 0; sample < samples; ++sample) {
+                // the first sample through the pixel center, for depth, mask and guides
+                const float x = (col + (sample ? random.next() : 0.5f)) / cols * 2.f - 1.f;
+                const float y = 1.f - (row + (sample ? random.next() : 0.5f)) / rows * 2.f;
+                const Vector3f viewOrigin =
+                    orthographic ? Vector3f{(x - p[12]) / p[0], (y - p[13]) / p[5], 0.f}
+                                 : Vector3f{0.f, 0.f, 0.f};
+                const Vector3f viewDirection =
+                    orthographic ? Vector3f{0.f, 0.f, -1.f}
+                                 : Vector3f{(x + p[8]) / p[0], (y + p[9]) / p[5], -1.f};
+                const Vector3f origin = transformPoint(cameraToWorld, viewOrigin);
+                const Vector3f direction = transformVector(cameraToWorld, viewDirection);
+
+                Hit hit;
+                Color3f radiance = frame.background, albedo = {1.f, 1.f, 1.f};
+                if (intersect(origin, direction, znear, zfar, &hit, scratch)) {
+                    const auto s = frame.surface(hit, origin, direction);
+                    if (!sample) {
+                        pixel.normal = s.normal;
+                        pixel.depth = hit.t;
+                        pixel.id = s.segmentation;
+                    }
+                    if (colorPlane)
+                        radiance = frame.shade(s, normalized(direction), 0, random, scratch);
+                    albedo = s.albedo;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    pixel.radiance[k] += radiance[k] / samples;
+                    pixel.albedo[k] += albedo[k] / samples;
+                }
+            }
+            if (depthPlane)
+                depthPlane[index] = pixel.depth;
+            if (maskPlane)
+                maskPlane[index] = pixel.id;
+        }
+    });
+
+    if (colorPlane) {
+        // lighting of the paths, demodulated from the surface colors
+        auto* lighting = &_filtered[0];
+        lighting->resize(pixels);
+        for (size_t i = 0; i < pixels; ++i) {
+            const Pixel& pixel = _pixels[i];
+            for (int k = 0; k < 3; ++k)
+                (*lighting)[i][k] = pixel.albedo[k] > kMinAlbedo
+                                        ? pixel.radiance[k] / pixel.albedo[k]
+                                        : pixel.radiance[k];
+        }
+
+        // edge-avoiding a-trous passes of growing steps, across surfaces of the same id only
+        for (int pass = 0; _denoise && pass < kFilterPasses; ++pass) {
+            const int step = 1 << pass;
+            const auto& source = _filtered[pass % 2];
+            auto& target = _filtered[(pass + 1) % 2];
+            target.resize(pixels);
+            parallelRows(rows, _numThreads, [&](int row) {
+                for (int col = 0; col < cols; ++col) {
+                    const size_t index = size_t(row) * cols + col;
+                    const Pixel& center = _pixels[index];
+                    const float centerLuma = luma(source[index]);
+                    Color3f sum = {0.f, 0.f, 0.f};
+                    float total = 0.f;
+                    for (int dy = -2; dy <= 2; ++dy) {
+                        const int y = row + dy * step;
+                        if (y < 0 || y >= rows)
+                            continue;
+                        for (int dx = -2; dx <= 2; ++dx) {
+                            const int x = col + dx * step;
+                            if (x < 0 || x >= cols)
+                                continue;
+                            const size_t other = size_t(y) * cols + x;
+                            const Pixel& q = _pixels[other];
+                            if (q.id != center.id)
+                                continue;
+                            float weight = kKernel[dx + 2] * kKernel[dy + 2];
+                            if (center.id != -1) {
+                                weight *= std::pow(std::max(0.f, dot(center.normal, q.normal)),
+                                                   kNormalPhi);
+                                weight *= std::exp(-std::abs(center.depth - q.depth) /
+                                                   (kDepthPhi * step * center.depth + 1e-6f));
+                            }
+                            weight *= std::exp(-std::abs(centerLuma - luma(source[other])) /
+                                               (kLumaPhi * centerLuma + 1e-2f));
+                            for (int k = 0; k < 3; ++k)
+                                sum[k] += weight * source[other][k];
+                            total += weight;
+                        }
+                    }
+                    // the center weight is 1 at least
+                    for (int k = 0; k < 3; ++k)
+                        target[index][k] = sum[k] / total;
+                }
+            });
+            lighting = &target;
+        }
+
+        // surface colors applied back, at full resolution
+        for (size_t i = 0; i < pixels; ++i) {
+            const Pixel& pixel = _pixels[i];
+            uint8_t* rgba = colorPlane + i * 4;
+            for (int k = 0; k < 3; ++k) {
+                const float value = pixel.albedo[k] > kMinAlbedo
+                                        ? (*lighting)[i][k] * pixel.albedo[k]
+                                        : (*lighting)[i][k];
+                rgba[k] = uint8_t(std::min(1.f, std::max(0.f, value)) * 255.f + 0.5f);
+            }
+            rgba[3] = 255;
+        }
+    }
+    _frameBytes = _pixels.capacity() * sizeof(Pixel) +
+                  (_filtered[0].capacity() + _filtered[1].capacity()) * sizeof(Color3f);
+    return true;
+}
+
+} // namespace render
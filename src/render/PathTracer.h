@@ -0,0 +1,178 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+#include "DistortedFrame.h"
+#include "MultiviewFrame.h"
+#include "PanoramaFaces.h"
+#include "ScaledFrame.h"
+
+#include <scene/BVH.h>
+#include <scene/SceneBounds.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief CPU renderer tracing paths through triangle hierarchies, for datasets favoring image
+ * fidelity over speed
+ *
+ * Each mesh has a hierarchy of its triangles built once from the loaded mesh data and shared by
+ * all shapes using it, kept across scene updates while the mesh is in the scene. Nodes are
+ * placed in a scene BVH refitted from the dirty flags of the poses each frame, so that moving
+ * bodies cost no rebuild of their triangles.
+ *
+ * Color pixels average a few jittered paths: soft shadows of the light, diffuse interreflections
+ * and ambient occlusion, and mirror reflections of specular materials. The noise of the low
+ * sample count is filtered by an edge-avoiding a-trous wavelet filter of the lighting, guided by
+ * the normals, depths and segmentation ids of the surfaces seen, textures being applied after
+ * filtering so that they stay sharp. Depth and mask are those of the ray through the pixel
+ * center, as rasterizers output them; paths are seeded by pixel and sample, the same frame
+ * renders the same image. Panoramic views are rendered face by face, see PanoramaFaces, views
+ * of a render scale at their internal resolution, see ScaledFrame, views with lens distortion as
+ * pinhole images, see DistortedFrame, and multiview views one after the other, see
+ * MultiviewFrame.
+ */
+class PathTracer : public BaseRenderer
+{
+  public:
+    /**
+     * @brief Construct a new path tracer
+     *
+     * @param numThreads - number of threads tracing rows, 0 for one per core
+     */
+    explicit PathTracer(int numThreads = 0);
+
+    /**
+     * @brief Destroy the path tracer
+     */
+    ~PathTracer() override;
+
+    /**
+     * @brief Update a scene using \p sceneGraph description
+     *
+     * Triangle hierarchies of meshes already in the scene are reused.
+     */
+    void updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                     bool materialsOnly) override;
+
+    /**
+     * @brief Change the colors of a shape in place, false for a new texture
+     */
+    bool updateShapeMaterial(int nodeId, int shapeIndex,
+                             const std::shared_ptr<scene::Material>& material) override;
+
+    /**
+     * @brief Render a scene at state \p sceneState with a view settings \p sceneView
+     *
+     * @return False if the view has no camera
+     */
+    bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                     const std::shared_ptr<scene::SceneView>& sceneView,
+                     FrameData& outputFrame) override;
+
+    /**
+     * @brief Triangle hierarchies, textures and frame buffers in memory
+     */
+    RendererMemory memoryUsage() const override;
+
+    /**
+     * @brief Paths traced per pixel, 4 by default
+     */
+    int samples() const { return _samples; }
+    /** @overload */
+    void setSamples(int samples) { _samples = samples > 0 ? samples : 1; }
+
+    /**
+     * @brief Diffuse and mirror bounces of a path after the surface seen, 1 by default
+     *
+     * With 0 bounces the ambient light is not occluded and nothing is reflected, as rasterizers
+     * light the scene.
+     */
+    int bounces() const { return _bounces; }
+    /** @overload */
+    void setBounces(int bounces) { _bounces = bounces > 0 ? bounces : 0; }
+
+    /**
+     * @brief Filter the noise of the paths, on by default
+     */
+    bool denoise() const { return _denoise; }
+    /** @overload */
+    void setDenoise(bool enabled) { _denoise = enabled; }
+
+    /**
+     * @brief Number of threads tracing rows, 0 for one per core
+     */
+    int numThreads() const { return _numThreads; }
+    /** @overload */
+    void setNumThreads(int numThreads) { _numThreads = numThreads; }
+
+    /**
+     * @brief Number of triangles in the hierarchies of the scene
+     */
+    size_t numTriangles() const;
+
+  private:
+    struct Blas; //<- triangle hierarchy of a mesh
+    struct Hit; //<- closest surface along a ray
+    struct Scratch; //<- traversal stacks of a thread
+    struct Frame; //<- camera and light of the frame being rendered, tracing its paths
+
+    /// shape of a node with triangles
+    struct Instance {
+        int shapeIndex;
+        std::shared_ptr<Blas> blas;
+        Matrix4f matrix; //<- shape frame to node frame
+        Matrix4f inverse; //<- world frame to shape frame, at the current frame
+        int segmentation; //<- mask value of the shape
+        Color3f albedo; //<- diffuse color of the material
+        Color3f specular; //<- specular color of the material
+        std::shared_ptr<scene::Texture> texture; //<- converted into the texels
+        std::vector<unsigned char> texels; //<- RGB, top row first
+        int cols;
+        int rows;
+    };
+
+    /// samples of a pixel, guides of the denoiser from its center ray
+    struct Pixel {
+        Color3f radiance; //<- average of the paths
+        Color3f albedo; //<- average of the surfaces seen, 1 for the background
+        Vector3f normal; //<- facing the camera
+        float depth; //<- 0 for the background
+        int id; //<- segmentation id, -1 for the background
+    };
+
+    void updateNode(int nodeId, const scene::Node& node);
+    /// closest hit along a ray into \p hit, any hit if null, \p tmin and \p tmax in units of
+    /// \p direction
+    bool intersect(const Vector3f& origin, const Vector3f& direction, float tmin, float tmax,
+                   Hit* hit, Scratch& scratch) const;
+
+    int _samples = 4;
+    int _bounces = 1;
+    bool _denoise = true;
+    int _numThreads = 0;
+    std::map<const void*, std::shared_ptr<Blas>> _blas; //<- by mesh data
+    std::map<int, std::vector<Instance>> _nodes; //<- node id -> shapes with triangles
+    const scene::SceneState* _sceneState = nullptr; //<- of the frame being rendered
+    scene::SegmentationMode _segmentationMode = scene::SegmentationMode::BodyLink;
+    scene::SceneBounds _bounds; //<- node bounds of the instanced triangles
+    scene::BVH _bvh; //<- world bounds of nodes, refitted each frame
+    std::vector<Pixel> _pixels; //<- of the frame being rendered
+    std::vector<Color3f> _filtered[2]; //<- lighting of the passes of the denoiser
+    std::atomic<size_t> _sceneBytes{0}; //<- of the hierarchies and textures
+    std::atomic<size_t> _frameBytes{0}; //<- of the pixel buffers
+    PanoramaFaces _panorama; //<- faces of panoramic views
+    ScaledFrame _scaled; //<- views of a render scale
+    DistortedFrame _distorted; //<- views with lens distortion
+    MultiviewFrame _multiview; //<- views of several cameras
+};
+
+} // namespace render
@@ -0,0 +1,91 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "PinnedMemory.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef WITH_CUDA
+#include <cuda_runtime.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace render {
+
+namespace {
+
+size_t pageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return std::max<size_t>(info.dwPageSize, 64);
+#else
+    static const size_t size = std::max<size_t>(size_t(sysconf(_SC_PAGESIZE)), 64);
+    return size;
+#endif
+}
+
+/// whole pages, locked and registered as a unit
+size_t pinnedSize(size_t bytes)
+{
+    const size_t alignment = pageSize();
+    return (std::max<size_t>(bytes, 1) + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+void* allocatePinned(size_t bytes)
+{
+    const size_t alignment = pageSize();
+    const size_t size = pinnedSize(bytes);
+#ifdef _WIN32
+    void* pointer = _aligned_malloc(size, alignment);
+    if (!pointer)
+        throw std::bad_alloc();
+    VirtualLock(pointer, size);
+#else
+    void* pointer = nullptr;
+    if (posix_memalign(&pointer, alignment, size) != 0)
+        throw std::bad_alloc();
+    // best effort, beyond RLIMIT_MEMLOCK the memory stays pageable
+    mlock(pointer, size);
+#endif
+#ifdef WITH_CUDA
+    // DMA straight into the buffer rather than through a driver staging copy
+    if (cudaHostRegister(pointer, size, cudaHostRegisterDefault) != cudaSuccess)
+        cudaGetLastError();
+#endif
+    return pointer;
+}
+
+void freePinned(void* pointer, size_t bytes)
+{
+    if (!pointer)
+        return;
+    const size_t size = pinnedSize(bytes);
+#ifdef WITH_CUDA
+    if (cudaHostUnregister(pointer) != cudaSuccess)
+        cudaGetLastError();
+#endif
+#ifdef _WIN32
+    VirtualUnlock(pointer, size);
+    _aligned_free(pointer);
+#else
+    munlock(pointer, size);
+    free(pointer);
+#endif
+}
+
+} // namespace render
@@ -0,0 +1,64 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Allocate host memory the GPU transfers into without a staging copy
+ *
+ * Aligned to a page, at least 64 bytes, locked in RAM when the memory lock limit allows and
+ * registered with CUDA in WITH_CUDA builds; plain aligned memory otherwise.
+ *
+ * @param bytes - size of the allocation
+ * @return Allocated memory, released with freePinned()
+ * @throw std::bad_alloc - if the memory cannot be allocated
+ */
+void* allocatePinned(size_t bytes);
+
+/**
+ * @brief Release memory of allocatePinned()
+ */
+void freePinned(void* pointer, size_t bytes);
+
+/**
+ * @brief Allocator of page-locked host memory, for the planes images are read back into
+ */
+template <class T>
+struct PinnedAllocator {
+    using value_type = T;
+
+    PinnedAllocator() = default;
+    template <class U>
+    PinnedAllocator(const PinnedAllocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(size_t n) { return static_cast<T*>(allocatePinned(n * sizeof(T))); }
+    void deallocate(T* pointer, size_t n) { freePinned(pointer, n * sizeof(T)); }
+};
+
+template <class T, class U>
+bool operator==(const PinnedAllocator<T>&, const PinnedAllocator<U>&)
+{
+    return true;
+}
+
+template <class T, class U>
+bool operator!=(const PinnedAllocator<T>&, const PinnedAllocator<U>&)
+{
+    return false;
+}
+
+/**
+ * @brief Vector of page-locked memory, kept allocated across frames as any vector
+ */
+template <class T>
+using PinnedVector = std::vector<T, PinnedAllocator<T>>;
+
+} // namespace render
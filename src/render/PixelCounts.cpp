@@ -0,0 +1,71 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "PixelCounts.h"
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace render {
+
+namespace {
+
+/// pixels and bounds of an id
+struct IdPixels {
+    int pixels = 0;
+    std::array<int, 4> box; //<- x0, y0, x1, y1
+};
+
+} // namespace
+
+int countMaskPixels(int cols, int rows, const int* mask, int* counts, int* boxes)
+{
+    // runs of a shape along rows are counted at once, ids looked up once per run
+    std::unordered_map<int, IdPixels> pixels;
+    for (int row = 0; row < rows; ++row) {
+        const int* line = mask + size_t(row) * size_t(cols);
+        for (int col = 0; col < cols;) {
+            const int id = line[col];
+            int end = col + 1;
+            while (end < cols && line[end] == id)
+                ++end;
+            if (id != -1) {
+                auto it = pixels.find(id);
+                if (it == pixels.end())
+                    it = pixels.emplace(id, IdPixels{0, {col, row, end - 1, row}}).first;
+                auto& p = it->second;
+                p.pixels += end - col;
+                p.box = {std::min(p.box[0], col), p.box[1], std::max(p.box[2], end - 1), row};
+            }
+            col = end;
+        }
+    }
+    std::vector<std::pair<int, IdPixels>> sorted(pixels.begin(), pixels.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<int, IdPixels>& a, const std::pair<int, IdPixels>& b) {
+                  return a.first < b.first;
+              });
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        counts[i * 2] = sorted[i].first;
+        counts[i * 2 + 1] = sorted[i].second.pixels;
+        if (boxes)
+            std::copy_n(sorted[i].second.box.data(), 4, boxes + i * 4);
+    }
+    return int(sorted.size());
+}
+
+void completePixelCounts(const scene::SceneView& sceneView, FrameData& frame)
+{
+    if (!frame.pixelCounts || !frame.mask || frame.numPixelCounts >= 0 ||
+        !sceneView.hasOutputChannel(scene::OutputChannel::Visibility))
+        return;
+    const bool boxes = sceneView.hasOutputChannel(scene::OutputChannel::Boxes);
+    frame.numPixelCounts = countMaskPixels(frame.cols, frame.rows, frame.mask, frame.pixelCounts,
+                                           boxes ? frame.boxes : nullptr);
+}
+
+} // namespace render
@@ -0,0 +1,36 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+namespace render {
+
+/**
+ * @brief Count the pixels of each segmentation id of a mask image
+ *
+ * Pixels are counted by id as the Visibility channel lists them: (id, pixels) pairs of the ids
+ * seen, by increasing id, the background of id -1 left out. Boxes of the Boxes channel bound the
+ * pixels of each id in the same order, (x0, y0, x1, y1) of the first and last columns and rows
+ * holding some, rows from the top.
+ *
+ * @param cols - image width
+ * @param rows - image height
+ * @param mask - segmentation id of each pixel
+ * @param counts - output, room for cols * rows pairs of ints
+ * @param boxes - output, room for cols * rows boxes of 4 ints, may be null
+ * @return Number of pairs written
+ */
+int countMaskPixels(int cols, int rows, const int* mask, int* counts, int* boxes = nullptr);
+
+/**
+ * @brief Finish the Visibility channel of a frame rendered with \p sceneView
+ *
+ * Counts and bounds the mask plane by countMaskPixels() unless the renderer counted the pixels.
+ * Frames without counts or a mask plane are left untouched.
+ */
+void completePixelCounts(const scene::SceneView& sceneView, FrameData& frame);
+
+} // namespace render
@@ -0,0 +1,212 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "PointCloud.h"
+#include "DistortedFrame.h"
+#include "PackedFrame.h"
+
+#include <scene/Panorama.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace render {
+
+namespace {
+
+/// camera frame direction of a pixel center along which the depth is measured
+class PixelRays
+{
+  public:
+    PixelRays(const scene::SceneView& sceneView, int cols, int rows)
+        : _projection(sceneView.projection()), _proj(sceneView.imageCamera().projMatrix()),
+          _cols(cols), _rows(rows),
+          _faceSize(scene::panoramaFaceSize(_projection, cols, rows))
+    {
+        // rays of distorted images, of the lens map of the camera
+        thread_local LensMaps lensMaps;
+        if (sceneView.hasLensDistortion())
+            _lensRays = lensMaps.get(sceneView, cols, rows).rays.data();
+    }
+
+    Vector3f point(int col, int row, float d) const
+    {
+        if (_lensRays) {
+            const float* ray = _lensRays + (size_t(row) * _cols + col) * 2;
+            if (std::isnan(ray[0]))
+                return {0.f, 0.f, 0.f};
+            return {ray[0] * d, ray[1] * d, -d};
+        }
+        if (_projection == scene::Projection::Equirectangular) {
+            // distance to the camera
+            const auto v = scene::equirectangularDirection(col, row, _cols, _rows);
+            return {v[0] * d, v[1] * d, v[2] * d};
+        }
+        if (_projection == scene::Projection::Cubemap) {
+            // metric depth along the face axis
+            const auto& axes = scene::cubemapFaceAxes()[std::min(row / _faceSize, 5)];
+            const auto& f = axes.forward;
+            const auto& u = axes.up;
+            const Vector3f r{f[1] * u[2] - f[2] * u[1], f[2] * u[0] - f[0] * u[2],
+                             f[0] * u[1] - f[1] * u[0]};
+            const float x = (col + 0.5f) / _faceSize * 2.f - 1.f;
+            const float y = 1.f - (row % _faceSize + 0.5f) / _faceSize * 2.f;
+            return {(r[0] * x + u[0] * y + f[0]) * d, (r[1] * x + u[1] * y + f[1]) * d,
+                    (r[2] * x + u[2] * y + f[2]) * d};
+        }
+        // metric depth along -z, w of a perspective or orthographic projection
+        const auto& p = _proj;
+        const float x = (col + 0.5f) / _cols * 2.f - 1.f;
+        const float y = 1.f - (row + 0.5f) / _rows * 2.f;
+        const float z = -d;
+        const float w = p[11] * z + p[15];
+        return {(x * w - p[8] * z - p[12]) / p[0], (y * w - p[9] * z - p[13]) / p[5], z};
+    }
+
+    /// pixels of different faces of cubemaps are not neighbors
+    int face(int row) const
+    {
+        return _projection == scene::Projection::Cubemap ? row / _faceSize : 0;
+    }
+
+  private:
+    scene::Projection _projection;
+    Matrix4f _proj;
+    int _cols;
+    int _rows;
+    int _faceSize;
+    const float* _lensRays = nullptr; //<- x, y over the depth of each pixel, of distorted images
+};
+
+} // namespace
+
+void unprojectDepth(const scene::SceneView& sceneView, int cols, int rows, const float* depth,
+                    float* points)
+{
+    const auto& camera = sceneView.camera();
+    if (!camera)
+        return;
+    const PixelRays rays(sceneView, cols, rows);
+    const bool world = sceneView.pointFrame() == scene::PointFrame::World;
+    const Matrix4f& m = camera->poseMatrix();
+    for (int row = 0; row < rows; ++row) {
+        for (int col = 0; col < cols; ++col) {
+            const size_t i = size_t(row) * cols + col;
+            float* point = points + i * 3;
+            const float d = depth[i];
+            if (!(d > 0.f)) {
+                std::fill_n(point, 3, 0.f);
+                continue;
+            }
+            const auto p = rays.point(col, row, d);
+            if (!world) {
+                std::copy_n(p.data(), 3, point);
+                continue;
+            }
+            for (int k = 0; k < 3; ++k)
+                point[k] = m[k] * p[0] + m[4 + k] * p[1] + m[8 + k] * p[2] + m[12 + k];
+        }
+    }
+}
+
+int compactPoints(int numPixels, const float* depth, const int* mask, float* points, int* ids)
+{
+    int count = 0;
+    for (int i = 0; i < numPixels; ++i) {
+        if (!(depth[i] > 0.f))
+            continue;
+        if (count != i)
+            std::copy_n(points + size_t(i) * 3, 3, points + size_t(count) * 3);
+        if (ids)
+            ids[count] = mask ? mask[i] : -1;
+        ++count;
+    }
+    return count;
+}
+
+void completePoints(const scene::SceneView& sceneView, FrameData& frame)
+{
+    if (!frame.points || !frame.depth || !sceneView.hasOutputChannel(scene::OutputChannel::Points))
+        return;
+    if (frame.numPoints < 0) {
+        unprojectDepth(sceneView, frame.cols, frame.rows, frame.depth, frame.points);
+        frame.numPoints = frame.cols * frame.rows;
+    }
+    if (sceneView.compactPoints())
+        frame.numPoints = compactPoints(frame.cols * frame.rows, frame.depth, frame.mask,
+                                        frame.points, frame.pointIds);
+}
+
+void estimateNormals(const scene::SceneView& sceneView, int cols, int rows, const float* depth,
+                     const int* mask, uint16_t* normals)
+{
+    std::fill_n(normals, size_t(cols) * size_t(rows) * 3, uint16_t(0));
+    if (!sceneView.camera())
+        return;
+    const PixelRays rays(sceneView, cols, rows);
+    const auto point = [&](int col, int row) {
+        return rays.point(col, row, depth[size_t(row) * cols + col]);
+    };
+    for (int row = 0; row < rows; ++row) {
+        for (int col = 0; col < cols; ++col) {
+            const size_t i = size_t(row) * cols + col;
+            const float d = depth[i];
+            if (!(d > 0.f))
+                continue;
+            const auto p = point(col, row);
+            // the neighbor of the nearest depth of the same surface along an axis, its offset
+            const auto nearest = [&](int dCol, int dRow, Vector3f& tangent) {
+                int best = 0;
+                float bestGap = 0.f;
+                for (int side : {-1, 1}) {
+                    const int c = col + dCol * side, r = row + dRow * side;
+                    if (c < 0 || c >= cols || r < 0 || r >= rows || rays.face(r) != rays.face(row))
+                        continue;
+                    const size_t j = size_t(r) * cols + c;
+                    if (!(depth[j] > 0.f) || (mask && mask[j] != mask[i]))
+                        continue;
+                    const float gap = std::abs(depth[j] - d);
+                    if (!best || gap < bestGap) {
+                        best = side;
+                        bestGap = gap;
+                    }
+                }
+                if (!best)
+                    return false;
+                const auto q = point(col + dCol * best, row + dRow * best);
+                for (int k = 0; k < 3; ++k)
+                    tangent[k] = (q[k] - p[k]) * best;
+                return true;
+            };
+            // along the columns and down the rows, facing the camera otherwise
+            Vector3f right, down;
+            Vector3f n{-p[0], -p[1], -p[2]};
+            if (nearest(1, 0, right) && nearest(0, 1, down))
+                n = {down[1] * right[2] - down[2] * right[1],
+                     down[2] * right[0] - down[0] * right[2],
+                     down[0] * right[1] - down[1] * right[0]};
+            if (n[0] * p[0] + n[1] * p[1] + n[2] * p[2] > 0.f)
+                n = {-n[0], -n[1], -n[2]};
+            const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (!(length > 0.f))
+                continue;
+            for (int k = 0; k < 3; ++k)
+                normals[i * 3 + k] = halfFloat(n[k] / length);
+        }
+    }
+}
+
+void completeNormals(const scene::SceneView& sceneView, FrameData& frame)
+{
+    if (!frame.normals || frame.normalsDrawn ||
+        !sceneView.hasOutputChannel(scene::OutputChannel::Normals))
+        return;
+    if (!frame.depth) {
+        std::fill_n(frame.normals, size_t(frame.cols) * size_t(frame.rows) * 3, uint16_t(0));
+        return;
+    }
+    estimateNormals(sceneView, frame.cols, frame.rows, frame.depth, frame.mask, frame.normals);
+}
+
+} // namespace render
@@ -0,0 +1,75 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+namespace render {
+
+/**
+ * @brief Unproject a metric depth image into XYZ points
+ *
+ * Points are those of the pixel centers seen by the camera of \p sceneView, top row first, in
+ * the frame of SceneView::pointFrame(), zero where the depth is zero. Panoramic views unproject
+ * along the directions of their pixels, see scene::Projection, and views with lens distortion
+ * along the rays of their lens map, see LensMap.
+ *
+ * @param sceneView - view the depth was rendered with
+ * @param cols - image width
+ * @param rows - image height
+ * @param depth - metric depth of each pixel
+ * @param points - output, 3 floats per pixel
+ */
+void unprojectDepth(const scene::SceneView& sceneView, int cols, int rows, const float* depth,
+                    float* points);
+
+/**
+ * @brief Pack the points of the pixels with a positive depth at the front, in place
+ *
+ * @param numPixels - number of pixels
+ * @param depth - metric depth of each pixel
+ * @param mask - segmentation id of each pixel, may be null
+ * @param points - points of each pixel, 3 floats per pixel
+ * @param ids - output segmentation id of each point kept, -1 without \p mask, may be null
+ * @return Number of points kept
+ */
+int compactPoints(int numPixels, const float* depth, const int* mask, float* points, int* ids);
+
+/**
+ * @brief Finish the Points channel of a frame rendered with \p sceneView
+ *
+ * Unprojects the depth plane unless the renderer computed the points, then packs them if the
+ * view asks for compact points. Must be called once per rendered frame; frames without a points
+ * or a depth plane are left untouched.
+ */
+void completePoints(const scene::SceneView& sceneView, FrameData& frame);
+
+/**
+ * @brief Estimate the surface normals of a metric depth image
+ *
+ * Normals are those of the camera frame, unit and facing the camera, from the differences of the
+ * points of each pixel with those of its neighbors along rows and columns. Of the two neighbors
+ * along an axis, that of the nearest depth is used, skipping those with another segmentation id
+ * so that edges do not blend surfaces. Zero where the depth is zero.
+ *
+ * @param sceneView - view the depth was rendered with
+ * @param cols - image width
+ * @param rows - image height
+ * @param depth - metric depth of each pixel
+ * @param mask - segmentation id of each pixel, may be null
+ * @param normals - output, 3 half floats per pixel
+ */
+void estimateNormals(const scene::SceneView& sceneView, int cols, int rows, const float* depth,
+                     const int* mask, uint16_t* normals);
+
+/**
+ * @brief Finish the Normals channel of a frame rendered with \p sceneView
+ *
+ * Estimates the normals from the depth plane unless the renderer drew them, zero without a depth
+ * plane. Frames without a normals plane are left untouched.
+ */
+void completeNormals(const scene::SceneView& sceneView, FrameData& frame);
+
+} // namespace render
@@ -0,0 +1,276 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "RemoteConnection.h"
+
+#include "SharedMemoryChannel.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace render {
+
+namespace {
+
+#ifdef _WIN32
+using Socket = SOCKET;
+const Socket kInvalidSocket = INVALID_SOCKET;
+
+void closeSocket(Socket socket) { closesocket(socket); }
+
+/// winsock is initialized once per process and never released
+void initSockets()
+{
+    static const bool initialized = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    if (!initialized)
+        throw std::runtime_error("RemoteConnection: cannot initialize winsock");
+}
+#else
+using Socket = int;
+const Socket kInvalidSocket = -1;
+
+void closeSocket(Socket socket) { ::close(socket); }
+
+void initSockets() {}
+#endif
+
+/// frames are small requests answered at once, do not wait to coalesce them
+void setNoDelay(Socket socket)
+{
+    int flag = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&flag),
+               sizeof(flag));
+}
+
+/// send all bytes, false if the connection is broken
+bool sendAll(Socket socket, const uint8_t* data, size_t size)
+{
+    while (size > 0) {
+#ifdef _WIN32
+        const int count = ::send(socket, reinterpret_cast<const char*>(data), int(size), 0);
+#else
+        // a closed peer fails with EPIPE instead of killing the process
+        const ssize_t count = ::send(socket, data, size, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+            continue;
+#endif
+        if (count <= 0)
+            return false;
+        data += count;
+        size -= size_t(count);
+    }
+    return true;
+}
+
+/// receive exactly \p size bytes, return the number received before the end of the stream
+size_t receiveAll(Socket socket, uint8_t* data, size_t size)
+{
+    size_t received = 0;
+    while (received < size) {
+#ifdef _WIN32
+        const int count =
+            ::recv(socket, reinterpret_cast<char*>(data + received), int(size - received), 0);
+#else
+        const ssize_t count = ::recv(socket, data + received, size - received, 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+#endif
+        if (count < 0)
+            throw std::runtime_error("RemoteConnection: receive failed");
+        if (count == 0)
+            break;
+        received += size_t(count);
+    }
+    return received;
+}
+
+} // namespace
+
+std::unique_ptr<RemoteConnection> RemoteConnection::connect(const std::string& host, int port)
+{
+    initSockets();
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+        throw std::runtime_error("RemoteConnection: cannot resolve " + host);
+
+    Socket socket = kInvalidSocket;
+    for (addrinfo* address = addresses; address; address = address->ai_next) {
+        socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (socket == kInvalidSocket)
+            continue;
+        if (::connect(socket, address->ai_addr, int(address->ai_addrlen)) == 0)
+            break;
+        closeSocket(socket);
+        socket = kInvalidSocket;
+    }
+    freeaddrinfo(addresses);
+    if (socket == kInvalidSocket)
+        throw std::runtime_error("RemoteConnection: cannot connect to " + host + ":" +
+                                 std::to_string(port));
+    setNoDelay(socket);
+    return std::unique_ptr<RemoteConnection>(new RemoteConnection(intptr_t(socket)));
+}
+
+RemoteConnection::RemoteConnection(intptr_t socket) : _socket(socket) {}
+
+RemoteConnection::RemoteConnection(std::unique_ptr<SharedMemoryChannel> channel)
+    : _socket(intptr_t(kInvalidSocket)), _channel(std::move(channel))
+{
+}
+
+RemoteConnection::~RemoteConnection()
+{
+    if (!_channel)
+        closeSocket(Socket(_socket));
+}
+
+void RemoteConnection::send(RemoteMessage type, const std::vector<uint8_t>& payload)
+{
+    if (payload.size() > kMaxMessageSize)
+        throw std::runtime_error("RemoteConnection: message too large");
+    uint8_t header[5];
+    const uint32_t size = uint32_t(payload.size());
+    std::memcpy(header, &size, 4);
+    header[4] = uint8_t(type);
+    if (_channel) {
+        _channel->write(header, sizeof(header));
+        _channel->write(payload.data(), payload.size());
+        return;
+    }
+    if (!sendAll(Socket(_socket), header, sizeof(header)) ||
+        !sendAll(Socket(_socket), payload.data(), payload.size()))
+        throw std::runtime_error("RemoteConnection: send failed");
+}
+
+bool RemoteConnection::receive(RemoteMessage& type, std::vector<uint8_t>& payload)
+{
+    const auto receiveBytes = [this](uint8_t* data, size_t size) {
+        return _channel ? _channel->read(data, size) : receiveAll(Socket(_socket), data, size);
+    };
+    uint8_t header[5];
+    const size_t received = receiveBytes(header, sizeof(header));
+    if (received == 0)
+        return false;
+    if (received < sizeof(header))
+        throw std::runtime_error("RemoteConnection: truncated message");
+
+    uint32_t size;
+    std::memcpy(&size, header, 4);
+    if (size > kMaxMessageSize)
+        throw std::runtime_error("RemoteConnection: message too large");
+    type = RemoteMessage(header[4]);
+    payload.resize(size);
+    if (receiveBytes(payload.data(), size) < size)
+        throw std::runtime_error("RemoteConnection: truncated message");
+    return true;
+}
+
+void RemoteConnection::shutdown()
+{
+    if (_channel) {
+        _channel->shutdown();
+        return;
+    }
+#ifdef _WIN32
+    ::shutdown(Socket(_socket), SD_BOTH);
+#else
+    ::shutdown(Socket(_socket), SHUT_RDWR);
+#endif
+}
+
+RemoteListener::RemoteListener(int port, const std::string& address)
+{
+    initSockets();
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(address.empty() ? nullptr : address.c_str(), std::to_string(port).c_str(),
+                    &hints, &addresses) != 0)
+        throw std::runtime_error("RemoteListener: cannot resolve " + address);
+
+    Socket socket = kInvalidSocket;
+    for (addrinfo* it = addresses; it; it = it->ai_next) {
+        socket = ::socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+        if (socket == kInvalidSocket)
+            continue;
+        // restarted servers must not wait for connections of the previous one to time out
+        int flag = 1;
+        setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&flag),
+                   sizeof(flag));
+        if (::bind(socket, it->ai_addr, int(it->ai_addrlen)) == 0 && ::listen(socket, 16) == 0)
+            break;
+        closeSocket(socket);
+        socket = kInvalidSocket;
+    }
+    freeaddrinfo(addresses);
+    if (socket == kInvalidSocket)
+        throw std::runtime_error("RemoteListener: cannot listen to port " + std::to_string(port));
+
+    sockaddr_storage bound{};
+    socklen_t length = sizeof(bound);
+    getsockname(socket, reinterpret_cast<sockaddr*>(&bound), &length);
+    _port = bound.ss_family == AF_INET6
+                ? ntohs(reinterpret_cast<const sockaddr_in6*>(&bound)->sin6_port)
+                : ntohs(reinterpret_cast<const sockaddr_in*>(&bound)->sin_port);
+    _socket = intptr_t(socket);
+}
+
+RemoteListener::~RemoteListener()
+{
+#ifdef _WIN32
+    if (_closed)
+        return;
+#endif
+    closeSocket(Socket(_socket));
+}
+
+std::unique_ptr<RemoteConnection> RemoteListener::accept()
+{
+    while (!_closed) {
+        const Socket socket = ::accept(Socket(_socket), nullptr, nullptr);
+        if (socket != kInvalidSocket) {
+            setNoDelay(socket);
+            return std::unique_ptr<RemoteConnection>(new RemoteConnection(intptr_t(socket)));
+        }
+#ifndef _WIN32
+        if (errno == EINTR || errno == ECONNABORTED)
+            continue;
+#endif
+        break;
+    }
+    return nullptr;
+}
+
+void RemoteListener::close()
+{
+    // only closing the socket wakes accept() on windows, elsewhere the destructor closes it
+    // once accept() returned
+    _closed = true;
+#ifdef _WIN32
+    closesocket(Socket(_socket));
+#else
+    ::shutdown(Socket(_socket), SHUT_RDWR);
+#endif
+}
+
+} // namespace render
@@ -0,0 +1,161 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <utils/serialization.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace render {
+
+class SharedMemoryChannel;
+
+/**
+ * @brief Messages of the remote rendering protocol, see RemoteRenderer and RenderServer
+ */
+enum class RemoteMessage : uint8_t {
+    Hello = 1, //<- protocol magic and version, sent by both ends on connection
+    Scene = 2, //<- materials-only flag, then the scene graph with asset references
+    SceneDelta = 3, //<- scene graph delta, then the added and changed nodes, with references
+    // request: id, state delta and views, response: id, status and frames, each compressed or
+    // in the frame slot of the request on shared memory channels, see RenderServer::FrameKind
+    Frames = 4,
+};
+
+/**
+ * @brief TCP connection, or shared memory channel, exchanging length-prefixed messages
+ *
+ * A message is its payload size as a 32-bit little-endian integer, its type byte, then
+ * its payload. Calls block, except that shutdown() may be called from another thread to
+ * wake a blocked receive().
+ */
+class RemoteConnection
+{
+  public:
+    static constexpr uint32_t kMagic = 0x53524250; //<- "PBRS"
+    static constexpr uint32_t kVersion = 6;
+    static constexpr size_t kMaxMessageSize = size_t(1) << 30;
+
+    /**
+     * @brief Connect to a server
+     *
+     * @param host - host name or address
+     * @param port - server port
+     * @throw std::runtime_error - if the server cannot be reached
+     */
+    static std::unique_ptr<RemoteConnection> connect(const std::string& host, int port);
+
+    /// take ownership of a connected socket
+    explicit RemoteConnection(intptr_t socket);
+
+    /// exchange messages through a shared memory channel instead
+    explicit RemoteConnection(std::unique_ptr<SharedMemoryChannel> channel);
+
+    /// close the socket
+    ~RemoteConnection();
+
+    RemoteConnection(const RemoteConnection&) = delete;
+    RemoteConnection& operator=(const RemoteConnection&) = delete;
+
+    /**
+     * @brief Send a message
+     *
+     * @throw std::runtime_error - if the connection is broken
+     */
+    void send(RemoteMessage type, const std::vector<uint8_t>& payload);
+
+    /**
+     * @brief Receive the next message
+     *
+     * @return False if the peer closed the connection between two messages
+     * @throw std::runtime_error - if the connection is broken or the message too large
+     */
+    bool receive(RemoteMessage& type, std::vector<uint8_t>& payload);
+
+    /// stop both directions, pending and later calls fail
+    void shutdown();
+
+    /// shared memory channel of the connection, null over TCP
+    SharedMemoryChannel* channel() const { return _channel.get(); }
+
+  private:
+    intptr_t _socket;
+    std::unique_ptr<SharedMemoryChannel> _channel; //<- instead of the socket, if any
+};
+
+/**
+ * @brief Listening TCP socket of a server
+ */
+class RemoteListener
+{
+  public:
+    /**
+     * @brief Listen for connections
+     *
+     * @param port - port to listen to, 0 for any free port
+     * @param address - local address to bind
+     * @throw std::runtime_error - if the port cannot be bound
+     */
+    RemoteListener(int port, const std::string& address);
+
+    /// close the socket
+    ~RemoteListener();
+
+    RemoteListener(const RemoteListener&) = delete;
+    RemoteListener& operator=(const RemoteListener&) = delete;
+
+    /// bound port
+    int port() const { return _port; }
+
+    /**
+     * @brief Wait for the next connection
+     *
+     * @return Connection, null once the listener is closed
+     */
+    std::unique_ptr<RemoteConnection> accept();
+
+    /// stop listening, wakes a blocked accept()
+    void close();
+
+  private:
+    intptr_t _socket;
+    int _port;
+    std::atomic<bool> _closed{false};
+};
+
+/**
+ * @brief Append a varint size then bytes
+ */
+inline void writeBlob(std::vector<uint8_t>& out, const void* data, size_t size)
+{
+    writeVarint(out, size);
+    const auto bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+/**
+ * @brief Read bytes written by writeBlob
+ *
+ * @return Address and size of the bytes
+ * @throw std::runtime_error - if the buffer is too short
+ */
+inline std::pair<const uint8_t*, size_t> readBlob(const uint8_t*& data, const uint8_t* end)
+{
+    const uint64_t size = readVarint(data, end);
+    if (size > uint64_t(end - data))
+        throw std::runtime_error("readBlob: truncated blob");
+    const uint8_t* blob = data;
+    data += size;
+    return {blob, size_t(size)};
+}
+
+} // namespace render
@@ -0,0 +1,254 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "RemoteRenderer.h"
+
+#include "FrameCodec.h"
+#include "RenderServer.h"
+#include "SharedMemoryChannel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+namespace render {
+
+namespace {
+
+/// copy the raw planes of a response frame into those of \p frame, false if of another size
+template <class ResponseFrame>
+bool copySlotFrame(const ResponseFrame& source, FrameData& frame)
+{
+    if (source.cols != frame.cols || source.rows != frame.rows)
+        return false;
+    const size_t planeBytes = size_t(frame.cols) * size_t(frame.rows) * 4;
+    const uint8_t* planes = source.planes;
+    void* outputs[] = {frame.color, frame.depth, frame.mask};
+    const uint8_t flags[] = {RenderServer::kColorPlane, RenderServer::kDepthPlane,
+                             RenderServer::kMaskPlane};
+    for (int i = 0; i < 3; ++i) {
+        if (!(source.slotPlanes & flags[i]))
+            continue;
+        if (outputs[i])
+            std::memcpy(outputs[i], planes, planeBytes);
+        planes += planeBytes;
+    }
+    return true;
+}
+
+} // namespace
+
+RemoteRenderer::RemoteRenderer(const std::string& host, int port, int maxPending, bool quantize)
+    : RemoteRenderer(RemoteConnection::connect(host, port), maxPending, quantize)
+{
+}
+
+RemoteRenderer::RemoteRenderer(std::unique_ptr<RemoteConnection> connection, int maxPending,
+                               bool quantize)
+    : _connection(std::move(connection)), _maxPending(std::max(maxPending, 1)),
+      _encoder(quantize)
+{
+    std::vector<uint8_t> hello;
+    writeRaw(hello, RemoteConnection::kMagic);
+    writeRaw(hello, RemoteConnection::kVersion);
+    _connection->send(RemoteMessage::Hello, hello);
+
+    RemoteMessage type;
+    std::vector<uint8_t> reply;
+    if (!_connection->receive(type, reply) || type != RemoteMessage::Hello || reply != hello)
+        throw std::runtime_error("RemoteRenderer: not a compatible server");
+}
+
+std::shared_ptr<RemoteRenderer> RemoteRenderer::sharedMemory(const std::string& name,
+                                                             int maxPending, bool quantize,
+                                                             size_t slotBytes, double timeout)
+{
+    maxPending = std::max(maxPending, 1);
+    auto channel = SharedMemoryChannel::create(name, maxPending, slotBytes);
+    channel->waitHost(timeout);
+    return std::make_shared<RemoteRenderer>(
+        std::unique_ptr<RemoteConnection>(new RemoteConnection(std::move(channel))), maxPending,
+        quantize);
+}
+
+RemoteRenderer::~RemoteRenderer() = default;
+
+void RemoteRenderer::updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                                 bool materialsOnly)
+{
+    drain();
+    _segmentationMode = sceneGraph->segmentationMode();
+    const std::string scene = scene::serializeWithReferences(*sceneGraph, _assets);
+    _message.assign(1, uint8_t(materialsOnly));
+    _message.insert(_message.end(), scene.begin(), scene.end());
+    send(RemoteMessage::Scene, _message);
+}
+
+void RemoteRenderer::applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                                     const scene::SceneGraphDelta& delta)
+{
+    // deltas do not carry the segmentation mode, the server gets it with the whole scene
+    if (sceneGraph->segmentationMode() != _segmentationMode) {
+        updateScene(sceneGraph, false);
+        return;
+    }
+    // nodes whose description changed, the removed ones are only named by the delta
+    std::map<int, scene::Node> nodes;
+    for (const auto* ids :
+         {&delta.added(), &delta.changed(), &delta.geometryChanged(), &delta.texelsChanged()}) {
+        for (int nodeId : *ids) {
+            const auto it = sceneGraph->nodes().find(nodeId);
+            if (it != sceneGraph->nodes().end())
+                nodes.emplace(nodeId, it->second);
+        }
+    }
+    const auto message = std::make_pair(delta, nodes);
+
+    drain();
+    const std::string bytes = scene::serializeWithReferences(message, _assets);
+    _message.assign(bytes.begin(), bytes.end());
+    send(RemoteMessage::SceneDelta, _message);
+}
+
+bool RemoteRenderer::renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                                 const std::shared_ptr<scene::SceneView>& sceneView,
+                                 FrameData& outputFrame)
+{
+    std::vector<FrameData> outputFrames{outputFrame};
+    return renderFrames(sceneState, {sceneView}, outputFrames);
+}
+
+bool RemoteRenderer::renderFrames(const std::shared_ptr<scene::SceneState>& sceneState,
+                                  const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                                  std::vector<FrameData>& outputFrames)
+{
+    if (!_connection)
+        return false;
+
+    const uint32_t request = _nextRequest++;
+    _message.clear();
+    writeRaw(_message, request);
+    std::vector<uint8_t> stateDelta;
+    _encoder.encode(*sceneState, stateDelta);
+    writeBlob(_message, stateDelta.data(), stateDelta.size());
+
+    // unchanged views are only flagged
+    _views.resize(sceneViews.size());
+    writeVarint(_message, sceneViews.size());
+    for (size_t i = 0; i < sceneViews.size(); ++i) {
+        const std::string view = BinarySerialize(*sceneViews[i]);
+        const bool changed = !std::equal(view.begin(), view.end(), _views[i].begin(),
+                                         _views[i].end());
+        _message.push_back(uint8_t(changed));
+        if (changed) {
+            _views[i].assign(view.begin(), view.end());
+            writeBlob(_message, view.data(), view.size());
+        }
+    }
+    if (!send(RemoteMessage::Frames, _message))
+        return false;
+    _pending.push_back(request);
+
+    while (int(_pending.size()) >= _maxPending)
+        if (!receiveResponse())
+            return false;
+    if (!_rendered || _frames.size() != outputFrames.size())
+        return false;
+
+    // a lagging frame may be of another size
+    try {
+        for (size_t i = 0; i < outputFrames.size(); ++i) {
+            const auto& frame = _frames[i];
+            if (frame.planes && !copySlotFrame(frame, outputFrames[i]))
+                return false;
+            if (!frame.planes)
+                decodeFrame(frame.encoded.data(), frame.encoded.size(), outputFrames[i]);
+        }
+    }
+    catch (const std::invalid_argument&) {
+        return false;
+    }
+    return true;
+}
+
+bool RemoteRenderer::send(RemoteMessage type, const std::vector<uint8_t>& payload)
+{
+    if (!_connection)
+        return false;
+    try {
+        _connection->send(type, payload);
+        return true;
+    }
+    catch (const std::runtime_error&) {
+        _connection.reset();
+        _pending.clear();
+        return false;
+    }
+}
+
+bool RemoteRenderer::receiveResponse()
+{
+    try {
+        RemoteMessage type;
+        if (!_connection->receive(type, _message) || type != RemoteMessage::Frames)
+            throw std::runtime_error("RemoteRenderer: unexpected message");
+
+        const uint8_t* data = _message.data();
+        const uint8_t* end = data + _message.size();
+        uint32_t request;
+        uint8_t status;
+        readRaw(data, end, request);
+        readRaw(data, end, status);
+        if (request != _pending.front())
+            throw std::runtime_error("RemoteRenderer: response out of order");
+        _pending.pop_front();
+
+        // the server lost track of the state, e.g. after an error, send it whole again
+        if (status & RenderServer::kResync)
+            _encoder.reset();
+        _rendered = status & RenderServer::kRendered;
+        // raw frames are read in place, their slot is written again only by a later request
+        _frames.resize(size_t(readVarint(data, end)));
+        auto* channel = _connection->channel();
+        for (auto& frame : _frames) {
+            uint8_t kind;
+            readRaw(data, end, kind);
+            frame.planes = nullptr;
+            if (kind == RenderServer::kEncoded) {
+                const auto blob = readBlob(data, end);
+                frame.encoded.assign(blob.first, blob.first + blob.second);
+                continue;
+            }
+            const uint64_t offset = readVarint(data, end);
+            frame.cols = int(readVarint(data, end));
+            frame.rows = int(readVarint(data, end));
+            readRaw(data, end, frame.slotPlanes);
+            int numPlanes = 0;
+            for (int i = 0; i < 3; ++i)
+                numPlanes += (frame.slotPlanes >> i) & 1;
+            if (kind != RenderServer::kInSlot || !channel || channel->numSlots() <= 0 ||
+                offset + uint64_t(frame.cols) * uint64_t(frame.rows) * 4 * uint64_t(numPlanes) >
+                    channel->slotBytes())
+                throw std::runtime_error("RemoteRenderer: invalid frame");
+            frame.planes = channel->slot(int(request % uint32_t(channel->numSlots()))) + offset;
+        }
+        return true;
+    }
+    catch (const std::runtime_error&) {
+        _connection.reset();
+        _pending.clear();
+        _rendered = false;
+        return false;
+    }
+}
+
+void RemoteRenderer::drain()
+{
+    // the server may block writing responses while a large message is sent
+    while (_connection && !_pending.empty())
+        receiveResponse();
+}
+
+} // namespace render
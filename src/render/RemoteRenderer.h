@@ -0,0 +1,157 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+#include "RemoteConnection.h"
+
+#include <scene/AssetTable.h>
+#include <scene/SceneStateDelta.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Renderer forwarding scenes and frame requests to a RenderServer over TCP
+ *
+ * Scene updates send the whole scene graph, deltas only the added and changed nodes, the data
+ * of cached meshes and textures once per connection and by content hash afterwards, see
+ * scene::AssetTable. Frame
+ * requests send the state changes since the previous request, see scene::SceneStateEncoder,
+ * and the views that changed. The server streams back losslessly compressed frames.
+ *
+ * Requests are pipelined: up to maxPending() requests are in flight, renderFrame() waiting
+ * for the oldest response only once that many are outstanding. With one pending request,
+ * frames are rendered synchronously, otherwise renderFrame() returns the frame of the request
+ * made maxPending() - 1 calls earlier, and false until the first response.
+ *
+ * A broken connection makes renderFrame() return false instead of throwing.
+ *
+ * Renderers of a host process on the same machine, e.g. python renderers that would block the
+ * simulation under the GIL, are reached through a shared memory channel instead, see
+ * sharedMemory(): the same messages go through rings of the channel, and the host renders
+ * frames straight into its frame slots, copied out without compression.
+ */
+class RemoteRenderer : public BaseRenderer
+{
+  public:
+    static constexpr size_t kSlotBytes = size_t(32) << 20; //<- e.g. 1920 x 1080 images, 3 planes
+
+    /**
+     * @brief Connect to a render server
+     *
+     * @param host - server host name or address
+     * @param port - server port
+     * @param maxPending - requests in flight, at least 1
+     * @param quantize - quantize the node poses sent, see scene::SceneStateEncoder
+     * @throw std::runtime_error - if the server cannot be reached
+     */
+    RemoteRenderer(const std::string& host, int port, int maxPending = 1, bool quantize = false);
+
+    /**
+     * @brief Talk to a server through a connection
+     *
+     * @param connection - connected to a server, e.g. through a shared memory channel
+     * @param maxPending - requests in flight, at least 1
+     * @param quantize - quantize the node poses sent, see scene::SceneStateEncoder
+     * @throw std::runtime_error - if the server does not answer as a render server
+     */
+    RemoteRenderer(std::unique_ptr<RemoteConnection> connection, int maxPending = 1,
+                   bool quantize = false);
+
+    /**
+     * @brief Create a shared memory channel and wait for a host process to serve it
+     *
+     * The channel has a frame slot per request in flight, frames of the views of a request not
+     * fitting in its slot are sent compressed. See RenderServer::serveChannel().
+     *
+     * @param name - shared memory name of the channel, unique on the machine
+     * @param maxPending - requests in flight, at least 1
+     * @param quantize - quantize the node poses sent, see scene::SceneStateEncoder
+     * @param slotBytes - bytes of the frame planes of a request, 4 per pixel and plane
+     * @param timeout - seconds to wait for the host
+     * @throw std::runtime_error - if the channel cannot be created or no host opened it in time
+     */
+    static std::shared_ptr<RemoteRenderer> sharedMemory(const std::string& name,
+                                                        int maxPending = 1, bool quantize = false,
+                                                        size_t slotBytes = kSlotBytes,
+                                                        double timeout = 30.);
+
+    /**
+     * @brief Close the connection, responses still in flight are dropped
+     */
+    ~RemoteRenderer() override;
+
+    /// requests in flight
+    int maxPending() const { return _maxPending; }
+
+    /// the connection to the server works
+    bool connected() const { return bool(_connection); }
+
+    /**
+     * @brief Send the whole scene
+     */
+    void updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                     bool materialsOnly) override;
+
+    /**
+     * @brief Send the added and changed nodes of the scene
+     */
+    void applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                         const scene::SceneGraphDelta& delta) override;
+
+    /**
+     * @brief Request a frame, see renderFrames()
+     */
+    bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                     const std::shared_ptr<scene::SceneView>& sceneView,
+                     FrameData& outputFrame) override;
+
+    /**
+     * @brief Request the frames of several views in one message
+     *
+     * @return True if the response returned now was rendered and matches the output frames
+     */
+    bool renderFrames(const std::shared_ptr<scene::SceneState>& sceneState,
+                      const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                      std::vector<FrameData>& outputFrames) override;
+
+  private:
+    /// send a message, dropping the connection on failure
+    bool send(RemoteMessage type, const std::vector<uint8_t>& payload);
+
+    /// wait for the oldest pending response
+    bool receiveResponse();
+
+    /// wait for all pending responses, e.g. before a large scene message
+    void drain();
+
+    std::unique_ptr<RemoteConnection> _connection; //<- null once broken
+    int _maxPending;
+    uint32_t _nextRequest = 0;
+    std::deque<uint32_t> _pending; //<- ids of requests in flight
+    scene::SceneStateEncoder _encoder;
+    scene::AssetTable _assets{true}; //<- data sent to the server
+    std::vector<std::vector<uint8_t>> _views; //<- serialized views of the last request
+    std::vector<uint8_t> _message; //<- reused message buffer
+    /// frame of the last response, encoded or raw in the slot of the request
+    struct ResponseFrame {
+        std::vector<uint8_t> encoded;
+        const uint8_t* planes = nullptr; //<- in the slot, null if encoded
+        int cols = 0;
+        int rows = 0;
+        uint8_t slotPlanes = 0; //<- see RenderServer::SlotPlanes
+    };
+    std::vector<ResponseFrame> _frames;
+    bool _rendered = false; //<- the last response was rendered
+    scene::SegmentationMode _segmentationMode = scene::SegmentationMode::BodyLink; //<- sent last
+};
+
+} // namespace render
@@ -0,0 +1,339 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "RenderScheduler.h"
+#include "ThreadAffinity.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace render {
+
+/**
+ * @brief Scene of a client as last updated, its frame requests queued as jobs
+ */
+struct RenderScheduler::Client : public BaseRenderer,
+                                 public std::enable_shared_from_this<Client> {
+    Client(const std::shared_ptr<State>& state, uint64_t id, double deadline)
+        : state(state), id(id),
+          deadline(std::chrono::duration_cast<Clock::duration>(
+              std::chrono::duration<double>(std::max(deadline, 0.))))
+    {
+    }
+
+    void updateScene(const std::shared_ptr<scene::SceneGraph>& graph, bool) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sceneGraph = graph;
+        ++sceneRevision;
+    }
+
+    void applySceneDelta(const std::shared_ptr<scene::SceneGraph>& graph,
+                         const scene::SceneGraphDelta&) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sceneGraph = graph;
+        ++sceneRevision;
+    }
+
+    bool updateShapeGeometry(int, int, const std::shared_ptr<scene::MeshData>&) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++sceneRevision;
+        return true;
+    }
+
+    bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                     const std::shared_ptr<scene::SceneView>& sceneView,
+                     FrameData& outputFrame) override
+    {
+        std::vector<FrameData> outputFrames{outputFrame};
+        const bool rendered = request(sceneState, {sceneView}, outputFrames);
+        // what the renderer wrote besides the planes
+        const auto& frame = outputFrames.front();
+        outputFrame.numPoints = frame.numPoints;
+        outputFrame.packed = frame.packed;
+        outputFrame.motionDrawn = frame.motionDrawn;
+        outputFrame.normalsDrawn = frame.normalsDrawn;
+        outputFrame.depthPyramidDrawn = frame.depthPyramidDrawn;
+        return rendered;
+    }
+
+    bool renderFrames(const std::shared_ptr<scene::SceneState>& sceneState,
+                      const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                      std::vector<FrameData>& outputFrames) override
+    {
+        if (sceneViews.size() > outputFrames.size())
+            return false;
+        return request(sceneState, sceneViews, outputFrames);
+    }
+
+    /// queue a job and wait for it to be drawn
+    bool request(const std::shared_ptr<scene::SceneState>& sceneState,
+                 const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                 std::vector<FrameData>& outputFrames)
+    {
+        auto job = std::unique_ptr<Job>(new Job());
+        job->client = shared_from_this();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->sceneGraph = sceneGraph;
+            job->sceneRevision = sceneRevision;
+            job->frame = ++frames;
+        }
+        job->sceneState = sceneState;
+        job->sceneViews = sceneViews;
+        job->outputFrames = &outputFrames;
+        job->queued = Clock::now();
+        job->deadline = job->queued + deadline;
+        job->stats = StageStats::current();
+        auto done = job->done.get_future();
+        if (!state->submit(std::move(job)))
+            return false;
+        return done.get();
+    }
+
+    std::shared_ptr<State> state;
+    const uint64_t id;
+    const Clock::duration deadline;
+    std::atomic<int> home{-1}; //<- worker which last drew the scene, -1 for none
+    std::mutex mutex; //<- guards the scene and frame sequence
+    std::shared_ptr<scene::SceneGraph> sceneGraph;
+    uint64_t sceneRevision = 0; //<- scene changes since the client was added
+    uint64_t frames = 0; //<- frames requested
+};
+
+RenderScheduler::RenderScheduler(const std::vector<std::shared_ptr<BaseRenderer>>& renderers)
+    : _state(std::make_shared<State>())
+{
+    if (renderers.empty())
+        throw std::invalid_argument("RenderScheduler: no renderers");
+    for (const auto& renderer : renderers) {
+        if (!renderer)
+            throw std::invalid_argument("RenderScheduler: null renderer");
+        _state->workers.emplace_back(new Worker());
+        _state->workers.back()->renderer = renderer;
+    }
+    for (int i = 0; i < numWorkers(); ++i)
+        _state->workers[i]->thread = std::thread(&RenderScheduler::run, _state, i);
+}
+
+RenderScheduler::~RenderScheduler()
+{
+    _state->stop = true;
+    _state->condition.notify_all();
+    for (auto& worker : _state->workers) {
+        // the running job may wait for resources held by the caller (e.g. python GIL)
+        worker->thread.detach();
+        std::deque<std::unique_ptr<Job>> jobs;
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            jobs.swap(worker->jobs);
+        }
+        _state->pending -= int(jobs.size());
+        for (auto& job : jobs)
+            job->done.set_value(false);
+    }
+}
+
+std::shared_ptr<BaseRenderer> RenderScheduler::addClient(double deadline)
+{
+    static std::atomic<uint64_t> lastId{0};
+    return std::make_shared<Client>(_state, ++lastId, deadline);
+}
+
+std::vector<int> RenderScheduler::queueLengths() const
+{
+    std::vector<int> lengths;
+    for (const auto& worker : _state->workers) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        lengths.push_back(int(worker->jobs.size()));
+    }
+    return lengths;
+}
+
+SchedulerStats RenderScheduler::stats() const
+{
+    std::lock_guard<std::mutex> lock(_state->statsMutex);
+    return _state->stats;
+}
+
+StageSummary RenderScheduler::queueLatency() const
+{
+    return _state->queueStats->summary(Stage::Queue);
+}
+
+void RenderScheduler::resetStats()
+{
+    std::lock_guard<std::mutex> lock(_state->statsMutex);
+    _state->stats = SchedulerStats();
+    _state->queueStats->reset();
+}
+
+bool RenderScheduler::State::submit(std::unique_ptr<Job> job)
+{
+    // the worker holding the scene of the client, the least busy one otherwise
+    int index = job->client->home;
+    if (index < 0) {
+        size_t shortest = SIZE_MAX;
+        for (int i = 0; i < int(workers.size()); ++i) {
+            std::lock_guard<std::mutex> lock(workers[i]->mutex);
+            if (workers[i]->jobs.size() < shortest) {
+                shortest = workers[i]->jobs.size();
+                index = i;
+            }
+        }
+    }
+    {
+        auto& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (stop)
+            return false;
+        worker.jobs.push_back(std::move(job));
+        ++pending;
+    }
+    // a notification missed by a worker about to wait delays it by its wait period at most
+    condition.notify_all();
+    return true;
+}
+
+std::vector<std::unique_ptr<RenderScheduler::Job>> RenderScheduler::take(State& state, int index)
+{
+    std::vector<std::unique_ptr<Job>> batch;
+    // the job of the earliest deadline of its own deque, the latest of the longest other one
+    int victim = index;
+    {
+        std::lock_guard<std::mutex> lock(state.workers[index]->mutex);
+        if (state.workers[index]->jobs.empty())
+            victim = -1;
+    }
+    if (victim < 0) {
+        size_t longest = 0;
+        for (int i = 0; i < int(state.workers.size()); ++i) {
+            if (i == index)
+                continue;
+            std::lock_guard<std::mutex> lock(state.workers[i]->mutex);
+            if (state.workers[i]->jobs.size() > longest) {
+                longest = state.workers[i]->jobs.size();
+                victim = i;
+            }
+        }
+        if (victim < 0)
+            return batch;
+    }
+
+    auto& jobs = state.workers[victim]->jobs;
+    std::lock_guard<std::mutex> lock(state.workers[victim]->mutex);
+    if (jobs.empty())
+        return batch; //<- taken meanwhile
+    auto first = jobs.end() - 1;
+    if (victim == index)
+        first = std::min_element(jobs.begin(), jobs.end(), [](const auto& a, const auto& b) {
+            return a->deadline < b->deadline;
+        });
+    const auto sceneGraph = (*first)->sceneGraph;
+    const uint64_t client = (*first)->client->id, revision = (*first)->sceneRevision;
+    batch.push_back(std::move(*first));
+    jobs.erase(first);
+    // along with the jobs of the same scene, in the order they were requested
+    for (auto it = jobs.begin(); it != jobs.end();) {
+        if ((*it)->client->id == client && (*it)->sceneRevision == revision) {
+            batch.push_back(std::move(*it));
+            it = jobs.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    std::stable_sort(batch.begin(), batch.end(),
+                     [](const auto& a, const auto& b) { return a->frame < b->frame; });
+    state.pending -= int(batch.size());
+    if (victim != index) {
+        std::lock_guard<std::mutex> statsLock(state.statsMutex);
+        state.stats.steals += batch.size();
+    }
+    return batch;
+}
+
+void RenderScheduler::draw(State& state, int index, std::vector<std::unique_ptr<Job>>& batch)
+{
+    auto& worker = *state.workers[index];
+    {
+        std::lock_guard<std::mutex> lock(state.statsMutex);
+        ++state.stats.batches;
+    }
+    for (auto& job : batch) {
+        const auto start = Clock::now();
+        const double wait = std::chrono::duration<double>(start - job->queued).count();
+        state.queueStats->record(Stage::Queue, wait);
+        if (job->stats)
+            job->stats->record(Stage::Queue, wait);
+        const bool missed = start > job->deadline;
+
+        // stages are timed into the stats of the client which requested the frame
+        StageStats::Scope stats(job->stats);
+        TraceScope trace("scheduled_frame");
+        bool rendered = false, switched = false;
+        try {
+            auto sceneState = job->sceneState;
+            switched = worker.client != job->client->id ||
+                                  worker.sceneRevision != job->sceneRevision ||
+                                  !job->sceneGraph;
+            if (switched) {
+                worker.renderer->updateScene(job->sceneGraph
+                                                 ? job->sceneGraph
+                                                 : std::make_shared<scene::SceneGraph>(),
+                                             false);
+            }
+            // poses moved in frames drawn elsewhere are not flagged in this one
+            if (switched || worker.frame + 1 != job->frame) {
+                sceneState = std::make_shared<scene::SceneState>(*sceneState);
+                sceneState->markAllDirty();
+            }
+            worker.client = job->client->id;
+            worker.sceneRevision = job->sceneRevision;
+            worker.frame = job->frame;
+            job->client->home = index;
+
+            auto& outputFrames = *job->outputFrames;
+            rendered = job->sceneViews.size() == 1
+                           ? worker.renderer->renderFrame(sceneState, job->sceneViews.front(),
+                                                          outputFrames.front())
+                           : worker.renderer->renderFrames(sceneState, job->sceneViews,
+                                                           outputFrames);
+        }
+        catch (const std::exception&) {
+            // the scene held by the renderer is unknown
+            worker.client = 0;
+        }
+        {
+            // counted before the caller is woken up
+            std::lock_guard<std::mutex> lock(state.statsMutex);
+            ++state.stats.jobs;
+            state.stats.sceneSwitches += switched;
+            state.stats.missedDeadlines += missed;
+        }
+        job->done.set_value(rendered);
+    }
+}
+
+void RenderScheduler::run(std::shared_ptr<State> state, int index)
+{
+    Trace::setThreadName("render worker");
+    const auto& renderer = *state->workers[index]->renderer;
+    while (!state->stop) {
+        placeThread("render worker", renderer.numaNode());
+        auto batch = take(*state, index);
+        if (!batch.empty()) {
+            draw(*state, index, batch);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->condition.wait_for(lock, std::chrono::milliseconds(1),
+                                  [&] { return state->stop || state->pending > 0; });
+    }
+}
+
+} // namespace render
@@ -0,0 +1,169 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+#include "StageStats.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Counters of a RenderScheduler since it was created or reset
+ */
+struct SchedulerStats {
+    uint64_t jobs = 0; //<- frame requests rendered
+    uint64_t batches = 0; //<- runs of jobs of the same scene, uploaded at most once
+    uint64_t sceneSwitches = 0; //<- full scene updates of a worker renderer
+    uint64_t steals = 0; //<- jobs taken from the deque of another worker
+    uint64_t missedDeadlines = 0; //<- jobs started after their deadline
+};
+
+/**
+ * @brief Camera image requests of many clients spread over a pool of renderers, e.g. one per GPU
+ *
+ * Each client gets a lightweight renderer from addClient(), to bind to its physics client. Its
+ * frame requests become jobs with a deadline, queued to the deque of the worker which last drew
+ * its scene, or the shortest one for a first job. Each worker runs one renderer on a thread of
+ * its own, takes the job of its deque with the earliest deadline, and when its deque is empty
+ * steals the latest job of the longest other one. Jobs queued for the scene of the job taken,
+ * e.g. frames a client requests from several threads, are taken along and drawn back to back,
+ * so that the scene is uploaded at most once per batch. The views of a job, e.g. a camera batch,
+ * are drawn with a single BaseRenderer::renderFrames().
+ *
+ * As with BatchRenderer, workers switch scenes between clients with a full scene update:
+ * renderers keep GPU meshes and textures keyed by the asset cache data shared by all clients,
+ * so a switch between clients loading the same assets uploads nothing. Jobs late for their
+ * deadline are still drawn, and counted.
+ *
+ * Thread-safe: clients may request frames concurrently, each waits for its own frame. The wait
+ * of a job for a worker is recorded as Stage::Queue into the stats current on the requesting
+ * thread and into queueLatency(). Worker renderers calling into python wait for the GIL, which
+ * requesting threads must not hold.
+ */
+class RenderScheduler
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Start a worker per renderer
+     *
+     * @param renderers - renderers drawing the jobs, e.g. EGL renderers of different devices
+     * @throw std::invalid_argument - if there are no renderers or one is null
+     */
+    explicit RenderScheduler(const std::vector<std::shared_ptr<BaseRenderer>>& renderers);
+
+    /**
+     * @brief Stop the workers once their current jobs are done, queued jobs fail
+     */
+    ~RenderScheduler();
+
+    RenderScheduler(const RenderScheduler&) = delete;
+    RenderScheduler& operator=(const RenderScheduler&) = delete;
+
+    /**
+     * @brief Append a client
+     *
+     * @param deadline - seconds from a request to the start of its drawing
+     * @return Renderer to bind to the physics client
+     */
+    std::shared_ptr<BaseRenderer> addClient(double deadline = 0.1);
+
+    /**
+     * @brief Number of workers
+     */
+    int numWorkers() const { return int(_state->workers.size()); }
+
+    /**
+     * @brief Jobs waiting in the deque of each worker
+     */
+    std::vector<int> queueLengths() const;
+
+    /**
+     * @brief Counters since the scheduler was created or reset
+     */
+    SchedulerStats stats() const;
+
+    /**
+     * @brief Last waits of the jobs of all clients for a worker, as Stage::Queue
+     */
+    StageSummary queueLatency() const;
+
+    /**
+     * @brief Reset the counters and waits
+     */
+    void resetStats();
+
+  private:
+    struct Client;
+
+    /**
+     * @brief Frame request of a client, drawn into the memory of the waiting caller
+     */
+    struct Job {
+        std::shared_ptr<Client> client;
+        std::shared_ptr<scene::SceneGraph> sceneGraph;
+        uint64_t sceneRevision = 0; //<- of the client scene when requested
+        uint64_t frame = 0; //<- sequence of the request among those of the client, from 1
+        std::shared_ptr<scene::SceneState> sceneState;
+        std::vector<std::shared_ptr<scene::SceneView>> sceneViews;
+        std::vector<FrameData>* outputFrames = nullptr;
+        Clock::time_point queued;
+        Clock::time_point deadline;
+        std::shared_ptr<StageStats> stats; //<- stats current on the requesting thread
+        std::promise<bool> done;
+    };
+
+    /**
+     * @brief Renderer of a worker and its deque of jobs
+     */
+    struct Worker {
+        std::shared_ptr<BaseRenderer> renderer;
+        mutable std::mutex mutex; //<- guards jobs
+        std::deque<std::unique_ptr<Job>> jobs;
+        std::thread thread;
+        // scene held by the renderer, worker thread only
+        uint64_t client = 0; //<- id of its client, 0 for none
+        uint64_t sceneRevision = 0;
+        uint64_t frame = 0; //<- last frame of the client drawn
+    };
+
+    /**
+     * @brief State shared with the workers and clients, outliving this object if needed
+     */
+    struct State {
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<int> pending{0}; //<- jobs in all deques
+        std::atomic<bool> stop{false};
+        // wakes idle workers, notified without the lock
+        std::mutex mutex;
+        std::condition_variable condition;
+        // counters and waits
+        mutable std::mutex statsMutex;
+        SchedulerStats stats;
+        std::shared_ptr<StageStats> queueStats = std::make_shared<StageStats>();
+
+        bool submit(std::unique_ptr<Job> job);
+    };
+
+    static void run(std::shared_ptr<State> state, int index);
+    static std::vector<std::unique_ptr<Job>> take(State& state, int index);
+    static void draw(State& state, int index, std::vector<std::unique_ptr<Job>>& batch);
+
+    std::shared_ptr<State> _state;
+};
+
+} // namespace render
@@ -0,0 +1,279 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "RenderServer.h"
+
+#include "FrameCodec.h"
+#include "SharedMemoryChannel.h"
+
+#include <scene/AssetTable.h>
+#include <scene/SceneStateDelta.h>
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace render {
+
+namespace {
+
+constexpr size_t kNoOffset = ~size_t(0); //<- of frames not in the slot of their request
+
+/// rendered images of a view, owned by a session
+struct ViewBuffers {
+    std::vector<uint8_t> color;
+    std::vector<float> depth;
+    std::vector<int> mask;
+};
+
+/// resize the planes of the requested channels, lend them as a frame
+FrameData viewFrame(const scene::SceneView& view, ViewBuffers& buffers)
+{
+    const auto size = view.imageSize();
+    const int cols = size[0], rows = size[1];
+    const size_t numPixels = size_t(std::max(cols, 0)) * size_t(std::max(rows, 0));
+    const bool color = view.hasOutputChannel(scene::OutputChannel::Color);
+    const bool depth = view.hasOutputChannel(scene::OutputChannel::Depth);
+    const bool mask = view.hasOutputChannel(scene::OutputChannel::Mask);
+    buffers.color.resize(color ? numPixels * 4 : 0);
+    buffers.depth.resize(depth ? numPixels : 0);
+    buffers.mask.resize(mask ? numPixels : 0);
+    return FrameData{cols, rows, color ? buffers.color.data() : nullptr,
+                     depth ? buffers.depth.data() : nullptr, mask ? buffers.mask.data() : nullptr};
+}
+
+/// lend the planes of the requested channels from a frame slot past its \p used bytes as the
+/// next frame, false if they do not fit
+bool slotFrame(const scene::SceneView& view, uint8_t* slot, size_t slotBytes, size_t& used,
+               std::vector<FrameData>& frames)
+{
+    const auto size = view.imageSize();
+    const int cols = size[0], rows = size[1];
+    const size_t planeBytes = size_t(std::max(cols, 0)) * size_t(std::max(rows, 0)) * 4;
+    const bool color = view.hasOutputChannel(scene::OutputChannel::Color);
+    const bool depth = view.hasOutputChannel(scene::OutputChannel::Depth);
+    const bool mask = view.hasOutputChannel(scene::OutputChannel::Mask);
+    const size_t bytes = planeBytes * (int(color) + int(depth) + int(mask));
+    if (bytes > slotBytes - used)
+        return false;
+    uint8_t* planes = slot + used;
+    uint8_t* colorPlane = color ? planes : nullptr;
+    planes += color ? planeBytes : 0;
+    float* depthPlane = depth ? reinterpret_cast<float*>(planes) : nullptr;
+    planes += depth ? planeBytes : 0;
+    int* maskPlane = mask ? reinterpret_cast<int*>(planes) : nullptr;
+    frames.push_back(FrameData{cols, rows, colorPlane, depthPlane, maskPlane});
+    used += bytes;
+    return true;
+}
+
+} // namespace
+
+RenderServer::RenderServer(const RendererFactory& factory, int port, const std::string& address)
+    : _factory(factory), _listener(port, address)
+{
+    _acceptor = std::thread(&RenderServer::acceptSessions, this);
+}
+
+RenderServer::~RenderServer() { stop(); }
+
+void RenderServer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stopped)
+            return;
+        _stopped = true;
+    }
+    _listener.close();
+    _acceptor.join();
+
+    // sessions end on their next receive, after the request being rendered
+    for (auto& session : _sessions)
+        session.connection->shutdown();
+    for (auto& session : _sessions)
+        session.thread.join();
+    _sessions.clear();
+}
+
+void RenderServer::acceptSessions()
+{
+    while (auto connection = _listener.accept()) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stopped)
+            break;
+
+        // threads of disconnected clients
+        for (auto it = _sessions.begin(); it != _sessions.end();) {
+            if (it->done) {
+                it->thread.join();
+                it = _sessions.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        _sessions.emplace_back();
+        auto& session = _sessions.back();
+        session.connection = std::move(connection);
+        ++_numSessions;
+        session.thread = std::thread(&RenderServer::serve, this, std::ref(session));
+    }
+}
+
+void RenderServer::serveChannel(const RendererFactory& factory, const std::string& name,
+                                double timeout)
+{
+    RemoteConnection connection(SharedMemoryChannel::open(name, timeout));
+    serveConnection(factory, connection);
+}
+
+void RenderServer::serve(Session& session)
+{
+    serveConnection(_factory, *session.connection);
+    --_numSessions;
+    session.done = true;
+}
+
+void RenderServer::serveConnection(const RendererFactory& factory, RemoteConnection& connection)
+{
+    auto* channel = connection.channel();
+    // a failing client only ends its own session
+    try {
+        std::vector<uint8_t> hello;
+        writeRaw(hello, RemoteConnection::kMagic);
+        writeRaw(hello, RemoteConnection::kVersion);
+        RemoteMessage type;
+        std::vector<uint8_t> message;
+        if (!connection.receive(type, message) || type != RemoteMessage::Hello)
+            throw std::runtime_error("RenderServer: not a client");
+        connection.send(RemoteMessage::Hello, hello);
+        if (message != hello)
+            throw std::runtime_error("RenderServer: incompatible client");
+
+        const auto renderer = factory();
+        if (!renderer)
+            throw std::runtime_error("RenderServer: no renderer");
+        auto sceneGraph = std::make_shared<scene::SceneGraph>();
+        scene::AssetTable assets; //<- data sent by the client, referenced afterwards
+        const auto sceneState = std::make_shared<scene::SceneState>();
+        scene::SceneStateDecoder decoder;
+        std::vector<std::shared_ptr<scene::SceneView>> views;
+        std::vector<ViewBuffers> buffers;
+        std::vector<uint8_t> response, encoded;
+
+        while (connection.receive(type, message)) {
+            const uint8_t* data = message.data();
+            const uint8_t* end = data + message.size();
+
+            if (type == RemoteMessage::Scene) {
+                uint8_t materialsOnly;
+                readRaw(data, end, materialsOnly);
+                // the renderer may keep the previous scene
+                sceneGraph = std::make_shared<scene::SceneGraph>();
+                scene::deserializeWithReferences(data, size_t(end - data), *sceneGraph, assets);
+                renderer->updateScene(sceneGraph, materialsOnly != 0);
+            }
+            else if (type == RemoteMessage::SceneDelta) {
+                std::pair<scene::SceneGraphDelta, std::map<int, scene::Node>> delta;
+                scene::deserializeWithReferences(data, message.size(), delta, assets);
+                for (int nodeId : delta.first.removed())
+                    sceneGraph->removeNode(nodeId);
+                for (auto& it : delta.second) {
+                    sceneGraph->removeNode(it.first);
+                    sceneGraph->appendNode(it.first, std::move(it.second));
+                }
+                // rewritten textures arrive as new bitmaps, their materials are replaced
+                for (int nodeId : std::set<int>(delta.first.texelsChanged()))
+                    delta.first.nodeChanged(nodeId);
+                sceneGraph->resetDelta();
+                renderer->applySceneDelta(sceneGraph, delta.first);
+            }
+            else if (type == RemoteMessage::Frames) {
+                uint32_t request;
+                readRaw(data, end, request);
+                const auto stateDelta = readBlob(data, end);
+                const size_t numViews = size_t(readVarint(data, end));
+                views.resize(numViews);
+                buffers.resize(numViews);
+                for (auto& view : views) {
+                    uint8_t changed;
+                    readRaw(data, end, changed);
+                    if (changed) {
+                        const auto blob = readBlob(data, end);
+                        view = std::make_shared<scene::SceneView>();
+                        BinaryDeserializeFrom(blob.first, blob.second, *view);
+                    }
+                    else if (!view) {
+                        throw std::runtime_error("RenderServer: unknown view");
+                    }
+                }
+
+                uint8_t status = 0;
+                try {
+                    decoder.decode(stateDelta.first, stateDelta.second, *sceneState);
+                }
+                catch (const std::runtime_error&) {
+                    status |= kResync;
+                }
+
+                // frames of shared memory channels are rendered into the slot of the request
+                uint8_t* slot =
+                    channel && channel->numSlots() > 0
+                        ? channel->slot(int(request % uint32_t(channel->numSlots())))
+                        : nullptr;
+                size_t slotUsed = 0;
+                std::vector<FrameData> frames;
+                std::vector<size_t> offsets(numViews, kNoOffset); //<- of the frames in the slot
+                if (!(status & kResync)) {
+                    for (size_t i = 0; i < numViews; ++i) {
+                        const size_t offset = slotUsed;
+                        if (slot && slotFrame(*views[i], slot, channel->slotBytes(), slotUsed,
+                                              frames))
+                            offsets[i] = offset;
+                        else
+                            frames.push_back(viewFrame(*views[i], buffers[i]));
+                    }
+                    if (renderer->renderFrames(sceneState, views, frames))
+                        status |= kRendered;
+                    sceneState->clearDirty();
+                }
+
+                response.clear();
+                writeRaw(response, request);
+                writeRaw(response, status);
+                writeVarint(response, (status & kRendered) ? frames.size() : 0);
+                if (status & kRendered) {
+                    for (size_t i = 0; i < frames.size(); ++i) {
+                        const auto& frame = frames[i];
+                        if (offsets[i] == kNoOffset) {
+                            response.push_back(kEncoded);
+                            encodeFrame(frame, encoded);
+                            writeBlob(response, encoded.data(), encoded.size());
+                            continue;
+                        }
+                        response.push_back(kInSlot);
+                        writeVarint(response, offsets[i]);
+                        writeVarint(response, size_t(frame.cols));
+                        writeVarint(response, size_t(frame.rows));
+                        response.push_back(uint8_t((frame.color ? kColorPlane : 0) |
+                                                   (frame.depth ? kDepthPlane : 0) |
+                                                   (frame.mask ? kMaskPlane : 0)));
+                    }
+                }
+                connection.send(RemoteMessage::Frames, response);
+            }
+            else {
+                throw std::runtime_error("RenderServer: unexpected message");
+            }
+        }
+    }
+    catch (const std::exception&) {
+    }
+}
+
+} // namespace render
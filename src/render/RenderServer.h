@@ -0,0 +1,120 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+#include "RemoteConnection.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace render {
+
+/**
+ * @brief Server rendering the scenes of RemoteRenderer clients
+ *
+ * Each client connection is a session served by its own thread, with its own renderer made
+ * by the factory on that thread, e.g. to own a GL context, its own scene graph and state.
+ * Requests of a session are handled in order, a client may send several before reading the
+ * responses. Frames are rendered into session buffers and sent compressed with encodeFrame().
+ *
+ * A host process may also serve a single client of the same machine through a shared memory
+ * channel, see serveChannel(); frames are then rendered straight into the frame slot of the
+ * request and left uncompressed.
+ */
+class RenderServer
+{
+  public:
+    /// response status flags
+    enum Status : uint8_t {
+        kRendered = 1, //<- the frames rendered
+        kResync = 2, //<- the state delta was rejected, the next one must be a keyframe
+    };
+
+    /// how each frame of a response is sent
+    enum FrameKind : uint8_t {
+        kEncoded = 0, //<- then the frame compressed with encodeFrame()
+        kInSlot = 1, //<- then its offset in the frame slot, size and SlotPlanes
+    };
+
+    /// planes of a frame in a slot, in this order, each of 4 bytes per pixel
+    enum SlotPlanes : uint8_t { kColorPlane = 1, kDepthPlane = 2, kMaskPlane = 4 };
+
+    using RendererFactory = std::function<std::shared_ptr<BaseRenderer>()>;
+
+    /**
+     * @brief Start listening and serving sessions
+     *
+     * @param factory - makes the renderer of a session, on the session thread
+     * @param port - port to listen to, 0 for any free port
+     * @param address - local address to bind, empty for all
+     * @throw std::runtime_error - if the port cannot be bound
+     */
+    RenderServer(const RendererFactory& factory, int port = 0, const std::string& address = "");
+
+    /// stop the server
+    ~RenderServer();
+
+    RenderServer(const RenderServer&) = delete;
+    RenderServer& operator=(const RenderServer&) = delete;
+
+    /// bound port
+    int port() const { return _listener.port(); }
+
+    /// number of connected clients
+    int numSessions() const { return _numSessions; }
+
+    /**
+     * @brief Close the listener and all sessions, and wait for their threads
+     */
+    void stop();
+
+    /**
+     * @brief Serve the client of a shared memory channel on the calling thread, until it closes
+     *
+     * Frames of the n-th request are rendered into slot n modulo the number of slots, those of
+     * views not fitting in it are sent compressed.
+     *
+     * @param factory - makes the renderer of the session
+     * @param name - shared memory name of the channel, see RemoteRenderer::sharedMemory()
+     * @param timeout - seconds to wait for the client to create the channel
+     * @throw std::runtime_error - if there is no such channel in time
+     */
+    static void serveChannel(const RendererFactory& factory, const std::string& name,
+                             double timeout = 30.);
+
+  private:
+    struct Session {
+        std::unique_ptr<RemoteConnection> connection;
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+
+    /// accept connections until stopped
+    void acceptSessions();
+
+    /// serve the requests of a client until it disconnects
+    void serve(Session& session);
+
+    /// serve the requests of a connection with a renderer of \p factory, until it closes
+    static void serveConnection(const RendererFactory& factory, RemoteConnection& connection);
+
+    RendererFactory _factory;
+    RemoteListener _listener;
+    std::atomic<int> _numSessions{0};
+
+    std::mutex _mutex;
+    std::list<Session> _sessions;
+    bool _stopped = false;
+    std::thread _acceptor;
+};
+
+} // namespace render
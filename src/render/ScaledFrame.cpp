@@ -0,0 +1,238 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "ScaledFrame.h"
+#include "PackedFrame.h"
+
+#include <utils/serialization.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace render {
+
+namespace {
+
+/// source pixels [lower, upper) under each pixel of an axis, at least one
+struct Span {
+    int lower;
+    int upper;
+};
+
+std::vector<Span> boxSpans(int srcSize, int size)
+{
+    const double ratio = double(srcSize) / size;
+    std::vector<Span> spans(static_cast<size_t>(size));
+    for (int i = 0; i < size; ++i) {
+        const int lower = std::min(int(std::floor(i * ratio)), srcSize - 1);
+        const int upper =
+            std::min(std::max(int(std::floor((i + 1) * ratio)), lower + 1), srcSize);
+        spans[size_t(i)] = {lower, upper};
+    }
+    return spans;
+}
+
+/// bilinear taps of each pixel of an axis, as sampled by GL_LINEAR with clamping to the edges
+struct Taps {
+    int first;
+    int second;
+    float weight; //<- of the second
+};
+
+std::vector<Taps> bilinearTaps(int srcSize, int size)
+{
+    const double ratio = double(srcSize) / size;
+    std::vector<Taps> taps(static_cast<size_t>(size));
+    for (int i = 0; i < size; ++i) {
+        const double position = (i + 0.5) * ratio - 0.5;
+        const int first = int(std::floor(position));
+        taps[size_t(i)] = {std::min(std::max(first, 0), srcSize - 1),
+                           std::min(std::max(first + 1, 0), srcSize - 1),
+                           float(position - first)};
+    }
+    return taps;
+}
+
+} // namespace
+
+void resampleImages(int srcCols, int srcRows, const uint8_t* srcColor, const float* srcDepth,
+                    const int* srcMask, int cols, int rows, uint8_t* color, float* depth,
+                    int* mask, const uint16_t* srcMotion, uint16_t* motion,
+                    const uint16_t* srcNormals, uint16_t* normals)
+{
+    // motion of a source pixel, in pixels of the images
+    const float motionScale[2] = {float(cols) / srcCols, float(rows) / srcRows};
+    const auto copyMotion = [&](size_t src, size_t pixel) {
+        for (int k = 0; k < 2; ++k)
+            motion[pixel * 2 + k] =
+                srcMotion ? halfFloat(halfToFloat(srcMotion[src * 2 + k]) * motionScale[k]) : 0;
+    };
+    const auto copyNormal = [&](size_t src, size_t pixel) {
+        for (int k = 0; k < 3; ++k)
+            normals[pixel * 3 + k] = srcNormals ? srcNormals[src * 3 + k] : 0;
+    };
+    const bool downsampled = srcCols > cols || srcRows > rows;
+    if (downsampled) {
+        const auto colSpans = boxSpans(srcCols, cols);
+        const auto rowSpans = boxSpans(srcRows, rows);
+        for (int row = 0; row < rows; ++row) {
+            const auto& rs = rowSpans[size_t(row)];
+            for (int col = 0; col < cols; ++col) {
+                const auto& cs = colSpans[size_t(col)];
+                const size_t pixel = size_t(row) * size_t(cols) + size_t(col);
+                unsigned sums[4] = {0, 0, 0, 0};
+                float nearest = 0.f;
+                int label = -1;
+                size_t nearestSrc = size_t(rs.lower) * size_t(srcCols) + size_t(cs.lower);
+                for (int y = rs.lower; y < rs.upper; ++y) {
+                    for (int x = cs.lower; x < cs.upper; ++x) {
+                        const size_t src = size_t(y) * size_t(srcCols) + size_t(x);
+                        if (color)
+                            for (int c = 0; c < 4; ++c)
+                                sums[c] += srcColor[src * 4 + c];
+                        // the nearest surface drawn, its depth and label together
+                        const float d = srcDepth ? srcDepth[src] : 0.f;
+                        if (d > 0.f && (nearest == 0.f || d < nearest)) {
+                            nearest = d;
+                            label = srcMask ? srcMask[src] : -1;
+                            nearestSrc = src;
+                        }
+                    }
+                }
+                // without depth, the label of the first pixel
+                if (!srcDepth && srcMask)
+                    label = srcMask[size_t(rs.lower) * size_t(srcCols) + size_t(cs.lower)];
+                const unsigned count = unsigned((rs.upper - rs.lower) * (cs.upper - cs.lower));
+                if (color)
+                    for (int c = 0; c < 4; ++c)
+                        color[pixel * 4 + c] = uint8_t((sums[c] + count / 2) / count);
+                if (depth)
+                    depth[pixel] = nearest;
+                if (mask)
+                    mask[pixel] = label;
+                if (motion)
+                    copyMotion(nearestSrc, pixel);
+                if (normals)
+                    copyNormal(nearestSrc, pixel);
+            }
+        }
+        return;
+    }
+
+    const auto colTaps = bilinearTaps(srcCols, cols);
+    const auto rowTaps = bilinearTaps(srcRows, rows);
+    for (int row = 0; row < rows; ++row) {
+        const auto& rt = rowTaps[size_t(row)];
+        // pixel under the center, that of the larger weight
+        const int nearestRow = rt.weight < 0.5f ? rt.first : rt.second;
+        for (int col = 0; col < cols; ++col) {
+            const auto& ct = colTaps[size_t(col)];
+            const size_t pixel = size_t(row) * size_t(cols) + size_t(col);
+            if (color) {
+                const auto texel = [&](int y, int x) {
+                    return srcColor + (size_t(y) * size_t(srcCols) + size_t(x)) * 4;
+                };
+                const uint8_t* p00 = texel(rt.first, ct.first);
+                const uint8_t* p01 = texel(rt.first, ct.second);
+                const uint8_t* p10 = texel(rt.second, ct.first);
+                const uint8_t* p11 = texel(rt.second, ct.second);
+                for (int c = 0; c < 4; ++c) {
+                    const float top = p00[c] + (p01[c] - p00[c]) * ct.weight;
+                    const float bottom = p10[c] + (p11[c] - p10[c]) * ct.weight;
+                    color[pixel * 4 + c] = uint8_t(top + (bottom - top) * rt.weight + 0.5f);
+                }
+            }
+            const int nearestCol = ct.weight < 0.5f ? ct.first : ct.second;
+            const size_t src = size_t(nearestRow) * size_t(srcCols) + size_t(nearestCol);
+            if (depth)
+                depth[pixel] = srcDepth ? srcDepth[src] : 0.f;
+            if (mask)
+                mask[pixel] = srcMask ? srcMask[src] : -1;
+            if (motion)
+                copyMotion(src, pixel);
+            if (normals)
+                copyNormal(src, pixel);
+        }
+    }
+}
+
+ScaledFrame::ScaledFrame()
+    : _scaledView(std::make_shared<scene::SceneView>()),
+      _scaledCamera(std::make_shared<scene::Camera>()),
+      _scaledPreviousCamera(std::make_shared<scene::Camera>())
+{
+}
+
+bool ScaledFrame::render(BaseRenderer& renderer,
+                         const std::shared_ptr<scene::SceneState>& sceneState,
+                         const scene::SceneView& sceneView, FrameData& outputFrame)
+{
+    if (!sceneView.camera())
+        return false;
+    const auto size = sceneView.renderSize({outputFrame.cols, outputFrame.rows});
+
+    // the region of interest is drawn whole at the internal size by the camera of the images
+    *_scaledCamera = sceneView.imageCamera();
+    *_scaledPreviousCamera = sceneView.previousImageCamera();
+    *_scaledView = sceneView;
+    _scaledView->setRoi({0, 0, 0, 0});
+    _scaledView->setRenderScale(1.f);
+    _scaledView->setViewport(size);
+    _scaledView->setCamera(_scaledCamera);
+    _scaledView->setPreviousCamera(_scaledPreviousCamera);
+
+    // planes of channels not requested are left untouched
+    const bool hasColor =
+        outputFrame.color && sceneView.hasOutputChannel(scene::OutputChannel::Color);
+    const bool hasDepth =
+        outputFrame.depth && sceneView.hasOutputChannel(scene::OutputChannel::Depth);
+    const bool hasMask = outputFrame.mask && sceneView.hasOutputChannel(scene::OutputChannel::Mask);
+    const bool hasMotion =
+        outputFrame.motion && sceneView.hasOutputChannel(scene::OutputChannel::Motion);
+    const size_t pixels = size_t(size[0]) * size_t(size[1]);
+    if (hasColor)
+        _color.resize(pixels * 4);
+    if (hasDepth || hasMask)
+        _depth.resize(pixels); //<- also picks the labels of downsampled masks
+    if (hasMask)
+        _mask.resize(pixels);
+    const bool hasNormals =
+        outputFrame.normals && sceneView.hasOutputChannel(scene::OutputChannel::Normals);
+    if (hasMotion)
+        _motion.resize(pixels * 2);
+    if (hasNormals)
+        _normals.resize(pixels * 3);
+    if (hasMask && !hasDepth)
+        _scaledView->setOutputChannels(sceneView.outputChannels() |
+                                       int(scene::OutputChannel::Depth));
+
+    FrameData scaledFrame{size[0],
+                          size[1],
+                          hasColor ? _color.data() : nullptr,
+                          hasDepth || hasMask ? _depth.data() : nullptr,
+                          hasMask ? _mask.data() : nullptr,
+                          nullptr,
+                          nullptr,
+                          nullptr,
+                          nullptr,
+                          nullptr,
+                          hasMotion ? _motion.data() : nullptr,
+                          hasNormals ? _normals.data() : nullptr};
+    if (!renderer.renderFrame(sceneState, _scaledView, scaledFrame))
+        return false;
+    // motion and normals the renderer did not draw are left to the caller, from the resampled
+    // depth
+    const bool motion = hasMotion && scaledFrame.motionDrawn;
+    const bool normals = hasNormals && scaledFrame.normalsDrawn;
+    resampleImages(size[0], size[1], scaledFrame.color, scaledFrame.depth, scaledFrame.mask,
+                   outputFrame.cols, outputFrame.rows, hasColor ? outputFrame.color : nullptr,
+                   hasDepth ? outputFrame.depth : nullptr, hasMask ? outputFrame.mask : nullptr,
+                   motion ? _motion.data() : nullptr, motion ? outputFrame.motion : nullptr,
+                   normals ? _normals.data() : nullptr, normals ? outputFrame.normals : nullptr);
+    outputFrame.motionDrawn = motion;
+    outputFrame.normalsDrawn = normals;
+    return true;
+}
+
+} // namespace render
@@ -0,0 +1,64 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Resample images of \p srcCols x \p srcRows pixels to \p cols x \p rows, see
+ * scene::SceneView::renderScale()
+ *
+ * Colors are box filtered over the source pixels under each pixel when downsampled, bilinear
+ * when upsampled; depth and masks are those of the nearest pixel drawn under each pixel, where
+ * depth is above zero, or of the pixel under its center when upsampled. Null planes are skipped.
+ * The motion and normals, half floats, are those of the same pixel as depth, the motion scaled to
+ * the image size.
+ */
+void resampleImages(int srcCols, int srcRows, const uint8_t* srcColor, const float* srcDepth,
+                    const int* srcMask, int cols, int rows, uint8_t* color, float* depth,
+                    int* mask, const uint16_t* srcMotion = nullptr, uint16_t* motion = nullptr,
+                    const uint16_t* srcNormals = nullptr, uint16_t* normals = nullptr);
+
+/**
+ * @brief Views of a render scale rendered at their internal resolution and resampled to the
+ * frame size
+ *
+ * For renderers without a resampling path of their own: the view is rendered through
+ * BaseRenderer::renderFrame() by the camera of its images into buffers of the internal size kept
+ * across frames, then resampled by resampleImages(). Points are left to the caller, which
+ * computes them from the resampled depth, as are the motion and normals of renderers not
+ * drawing them.
+ */
+class ScaledFrame
+{
+  public:
+    ScaledFrame();
+
+    /**
+     * @brief Render the scaled view \p sceneView through \p renderer
+     *
+     * @return False if the view has no camera or was not rendered
+     */
+    bool render(BaseRenderer& renderer, const std::shared_ptr<scene::SceneState>& sceneState,
+                const scene::SceneView& sceneView, FrameData& outputFrame);
+
+  private:
+    std::shared_ptr<scene::SceneView> _scaledView; //<- the view at its internal resolution
+    std::shared_ptr<scene::Camera> _scaledCamera;
+    std::shared_ptr<scene::Camera> _scaledPreviousCamera;
+    std::vector<uint8_t> _color;
+    std::vector<float> _depth;
+    std::vector<int> _mask;
+    std::vector<uint16_t> _motion;
+    std::vector<uint16_t> _normals;
+};
+
+} // namespace render
@@ -0,0 +1,163 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "SensorNoise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace render {
+
+namespace {
+
+/// uniform 32 bits of a counter, the same on every platform
+inline uint32_t mixBits(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+/// random bits of a value of a frame, e.g. the channel of a pixel
+inline uint32_t valueBits(uint32_t key, uint32_t index)
+{
+    return mixBits(index * 0x9e3779b9u + key);
+}
+
+/// uniform in [0, 1)
+inline float uniform(uint32_t bits)
+{
+    return float(bits >> 8) * (1.f / 16777216.f);
+}
+
+/// about a standard normal, the sum of the 4 bytes of \p bits, without transcendentals so that
+/// the loops drawing it vectorize
+inline float gaussian(uint32_t bits)
+{
+    const float sum = float(bits & 0xffu) + float((bits >> 8) & 0xffu) +
+                      float((bits >> 16) & 0xffu) + float(bits >> 24);
+    return (sum - 510.f) * (1.f / 147.8f); //<- the mean and deviation of the sum
+}
+
+/// key of a stream of random values of a frame
+uint32_t streamKey(uint32_t seed, uint64_t frameIndex, uint32_t stream)
+{
+    return mixBits(seed ^ mixBits(uint32_t(frameIndex) ^ mixBits(uint32_t(frameIndex >> 32) +
+                                                                 stream * 0x85ebca6bu)));
+}
+
+void noiseDepth(const scene::SceneView& sceneView, int view, const scene::SensorNoise& noise,
+                uint64_t frameIndex, FrameData& frame)
+{
+    const int cols = frame.cols, rows = frame.rows;
+    float* const depth = frame.depth;
+
+    // pixels at edges, of the depth drawn
+    thread_local std::vector<uint8_t> edges;
+    const bool dropout = noise.edgeDropout > 0.f;
+    if (dropout) {
+        edges.assign(size_t(cols) * rows, 0);
+        const float threshold = noise.edgeThreshold;
+        for (int row = 0; row < rows; ++row) {
+            const float* line = depth + size_t(row) * cols;
+            uint8_t* edge = edges.data() + size_t(row) * cols;
+            for (int col = 0; col + 1 < cols; ++col) {
+                const uint8_t jump = std::abs(line[col] - line[col + 1]) > threshold;
+                edge[col] |= jump;
+                edge[col + 1] |= jump;
+            }
+            if (row + 1 < rows) {
+                const float* next = line + cols;
+                uint8_t* nextEdge = edge + cols;
+                for (int col = 0; col < cols; ++col) {
+                    const uint8_t jump = std::abs(line[col] - next[col]) > threshold;
+                    edge[col] |= jump;
+                    nextEdge[col] |= jump;
+                }
+            }
+        }
+    }
+
+    // disparities of the focal length in pixels
+    float focalBaseline = 0.f;
+    if (noise.baseline > 0.f && noise.subpixel > 0.f && sceneView.camera() &&
+        sceneView.projection() == scene::Projection::Perspective)
+        focalBaseline = sceneView.viewCamera(view).projMatrix()[5] * rows * 0.5f * noise.baseline;
+    const float step = noise.subpixel, invStep = 1.f / step;
+    const float sigma = noise.axialSigma, dropoutRate = noise.edgeDropout;
+    const uint32_t axialKey = streamKey(noise.seed, frameIndex, view * 3);
+    const uint32_t dropoutKey = streamKey(noise.seed, frameIndex, view * 3 + 1);
+
+    const size_t numPixels = size_t(cols) * rows;
+    for (size_t i = 0; i < numPixels; ++i) {
+        float z = depth[i];
+        if (focalBaseline > 0.f) {
+            // at least one step, far surfaces do not read at infinity
+            const float disparity = std::max(std::round(focalBaseline / z * invStep), 1.f) * step;
+            z = z > 0.f ? focalBaseline / disparity : 0.f;
+        }
+        const float axial = sigma * z * z * gaussian(valueBits(axialKey, uint32_t(i)));
+        z = z > 0.f ? std::max(z + axial, 0.f) : 0.f;
+        if (dropout && edges[i] && uniform(valueBits(dropoutKey, uint32_t(i))) < dropoutRate)
+            z = 0.f;
+        depth[i] = z;
+    }
+}
+
+void noiseColor(int view, const scene::SensorNoise& noise, uint64_t frameIndex, FrameData& frame)
+{
+    const int cols = frame.cols, rows = frame.rows;
+    const float shot2 = noise.shotNoise * noise.shotNoise;
+    const float read2 = noise.readNoise * noise.readNoise;
+    const Color3f& balance = noise.whiteBalance;
+    const float vignetting = noise.vignetting;
+    const uint32_t key = streamKey(noise.seed, frameIndex, view * 3 + 2);
+
+    for (int row = 0; row < rows; ++row) {
+        uint8_t* line = frame.color + size_t(row) * cols * 4;
+        const float y = (row + 0.5f) / rows * 2.f - 1.f;
+        const uint32_t first = uint32_t(size_t(row) * cols * 3);
+        for (int col = 0; col < cols; ++col) {
+            // quadratic falloff of the squared distance to the center, 1 at the corners
+            const float x = (col + 0.5f) / cols * 2.f - 1.f;
+            const float falloff = 1.f - vignetting * (x * x + y * y) * 0.5f;
+            for (int c = 0; c < 3; ++c) {
+                const float value = std::max(line[col * 4 + c] * balance[c] * falloff, 0.f);
+                const float deviation = std::sqrt(shot2 * value + read2);
+                const uint32_t bits = valueBits(key, first + uint32_t(col) * 3 + c);
+                const float noisy = value + deviation * gaussian(bits);
+                line[col * 4 + c] = uint8_t(std::min(std::max(noisy + 0.5f, 0.f), 255.f));
+            }
+        }
+    }
+}
+
+} // namespace
+
+void applySensorNoise(const scene::SceneView& sceneView, FrameData& frame, uint64_t frameIndex)
+{
+    const auto& noise = sceneView.sensorNoise();
+    const bool depth = frame.depth && noise.depthEnabled() &&
+                       sceneView.hasOutputChannel(scene::OutputChannel::Depth);
+    const bool color = frame.color && noise.colorEnabled() &&
+                       sceneView.hasOutputChannel(scene::OutputChannel::Color);
+    // each image of a multiview frame is a sensor of its own
+    const int views = sceneView.viewCount();
+    const int rows = frame.rows / views;
+    const size_t pixels = size_t(frame.cols) * size_t(rows);
+    for (int view = 0; view < views; ++view) {
+        FrameData image{frame.cols, rows, frame.color ? frame.color + pixels * view * 4 : nullptr,
+                        frame.depth ? frame.depth + pixels * view : nullptr, nullptr};
+        if (depth)
+            noiseDepth(sceneView, view, noise, frameIndex, image);
+        if (color)
+            noiseColor(view, noise, frameIndex, image);
+    }
+}
+
+} // namespace render
@@ -0,0 +1,27 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+
+#include <cstdint>
+
+namespace render {
+
+/**
+ * @brief Apply the noise models of scene::SceneView::sensorNoise() to a frame rendered with
+ * \p sceneView, in place
+ *
+ * Noise is written into the full color and depth planes, so must be applied before the points,
+ * packed planes and other planes derived from them are completed, see packFrame(). Renderers
+ * leave those to the CPU for views with noise, except the motion, normals and depth pyramid they
+ * draw of the surfaces themselves. Disparities are quantized in perspective views only. Planes
+ * missing from the frame are skipped. The images of multiview frames are noised independently.
+ *
+ * @param frameIndex - frame drawn, noise is drawn from it and the seed of the view
+ */
+void applySensorNoise(const scene::SceneView& sceneView, FrameData& frame, uint64_t frameIndex);
+
+} // namespace render
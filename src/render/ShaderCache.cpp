@@ -0,0 +1,123 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "ShaderCache.h"
+
+#include <utils/file.h>
+#include <utils/hash.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+#include <pthread.h>
+
+namespace render {
+
+namespace {
+
+constexpr uint32_t kEntryMagic = 0x50524250; //<- "PBRP"
+constexpr uint32_t kEntryVersion = 1;
+
+/**
+ * @brief Header of a cache entry, followed by the program binary
+ */
+struct EntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key; //<- hash of the driver and sources, against renamed entries
+    uint32_t format;
+    uint32_t reserved;
+    uint64_t size; //<- bytes of the binary
+};
+
+std::mutex gMutex;
+bool gConfigured = false;
+std::string gDirectory;
+
+// taken across fork() so that children do not inherit it locked by a thread they lack
+const int gForkHandlers = pthread_atfork([] { gMutex.lock(); }, [] { gMutex.unlock(); },
+                                         [] { gMutex.unlock(); });
+
+std::string directory()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    if (!gConfigured) {
+        const char* directory = std::getenv("PYBULLET_RENDERING_SHADER_CACHE");
+        gDirectory = directory ? directory : "";
+        gConfigured = true;
+    }
+    return gDirectory;
+}
+
+/// path of the entry of a program, and its key
+std::string entryPath(const std::string& directory, const std::string& driver,
+                      const std::vector<std::string>& sources, uint64_t& key)
+{
+    key = hashBytes(&kEntryVersion, sizeof(kEntryVersion));
+    key = hashBytes(driver.data(), driver.size(), key);
+    for (const auto& source : sources) {
+        const uint64_t size = source.size();
+        key = hashBytes(&size, sizeof(size), key);
+        key = hashBytes(source.data(), source.size(), key);
+    }
+
+    char name[24];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return directory + "/" + name + ".program";
+}
+
+} // namespace
+
+void setShaderCacheDirectory(const std::string& directory)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gDirectory = directory;
+    gConfigured = true;
+}
+
+std::string shaderCacheDirectory() { return directory(); }
+
+bool loadCachedProgram(const std::string& driver, const std::vector<std::string>& sources,
+                       uint32_t& format, std::vector<char>& binary)
+{
+    const auto cacheDirectory = directory();
+    if (cacheDirectory.empty())
+        return false;
+
+    uint64_t key;
+    const MappedFile entry(entryPath(cacheDirectory, driver, sources, key));
+    if (!entry.valid() || entry.size() < sizeof(EntryHeader))
+        return false;
+
+    EntryHeader header;
+    std::memcpy(&header, entry.data(), sizeof(header));
+    if (header.magic != kEntryMagic || header.version != kEntryVersion || header.key != key ||
+        header.size == 0 || header.size != entry.size() - sizeof(EntryHeader))
+        return false;
+
+    format = header.format;
+    binary.assign(entry.data() + sizeof(EntryHeader), entry.data() + entry.size());
+    return true;
+}
+
+void storeCachedProgram(const std::string& driver, const std::vector<std::string>& sources,
+                        uint32_t format, const std::vector<char>& binary)
+{
+    const auto cacheDirectory = directory();
+    if (cacheDirectory.empty() || binary.empty() || !makeDirectories(cacheDirectory))
+        return;
+
+    uint64_t key;
+    const auto path = entryPath(cacheDirectory, driver, sources, key);
+    const EntryHeader header = {kEntryMagic, kEntryVersion, key, format, 0, binary.size()};
+    writeFileAtomically(path, [&](std::ofstream& file) {
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), std::streamsize(binary.size()));
+    });
+}
+
+} // namespace render
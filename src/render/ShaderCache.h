@@ -0,0 +1,53 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Set the directory of the persistent shader program cache, empty to disable it
+ *
+ * Native renderers store there the binaries of the programs they link, as the driver returns
+ * them, so that later processes load them instead of compiling the shaders again. Entries are
+ * named after the driver, its version and the shader sources, so that driver updates and new
+ * shaders miss. Defaults to the PYBULLET_RENDERING_SHADER_CACHE environment variable.
+ *
+ * @param directory - cache directory, created on the first store
+ */
+void setShaderCacheDirectory(const std::string& directory);
+
+/**
+ * @brief Directory of the persistent shader program cache, empty if disabled
+ */
+std::string shaderCacheDirectory();
+
+/**
+ * @brief Load the cached binary of a program
+ *
+ * @param driver - vendor, renderer and version strings of the driver
+ * @param sources - sources of the shaders of the program
+ * @param format - binary format, as glGetProgramBinary returned it
+ * @param binary - program binary
+ * @return True if cached, false if not cached or cache disabled
+ */
+bool loadCachedProgram(const std::string& driver, const std::vector<std::string>& sources,
+                       uint32_t& format, std::vector<char>& binary);
+
+/**
+ * @brief Store the binary of a program, atomically, failures are ignored
+ *
+ * @param driver - vendor, renderer and version strings of the driver
+ * @param sources - sources of the shaders of the program
+ * @param format - binary format
+ * @param binary - program binary
+ */
+void storeCachedProgram(const std::string& driver, const std::vector<std::string>& sources,
+                        uint32_t format, const std::vector<char>& binary);
+
+} // namespace render
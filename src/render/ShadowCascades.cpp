@@ -0,0 +1,191 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace render {
+
+namespace {
+
+constexpr float kLogSplit = 0.75f; //<- weight of the logarithmic split over the uniform one
+
+/// light frame: x, y across the rays, z against them as for a camera
+void lightAxes(const Vector3f& direction, Vector3f axes[3])
+{
+    const auto normalized = [](const Vector3f& v) {
+        const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        return Vector3f{v[0] / length, v[1] / length, v[2] / length};
+    };
+    const auto cross = [](const Vector3f& a, const Vector3f& b) {
+        return Vector3f{a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2],
+                        a[0] * b[1] - a[1] * b[0]};
+    };
+    const Vector3f forward = normalized(direction);
+    const Vector3f up = std::fabs(forward[2]) < 0.9f ? Vector3f{0.f, 0.f, 1.f}
+                                                     : Vector3f{0.f, 1.f, 0.f};
+    axes[0] = normalized(cross(forward, up));
+    axes[1] = cross(axes[0], forward);
+    axes[2] = {-forward[0], -forward[1], -forward[2]};
+}
+
+/// coordinate of a world point along an axis of the light frame
+inline float along(const Vector3f& axis, const Vector3f& p)
+{
+    return axis[0] * p[0] + axis[1] * p[1] + axis[2] * p[2];
+}
+
+/// bounds in the light frame of the corners of a world box, grown into \p lower and \p upper
+void lightBounds(const Vector3f axes[3], const scene::AABB& box, float lower[3], float upper[3])
+{
+    for (int corner = 0; corner < 8; ++corner) {
+        const Vector3f p{corner & 1 ? box.upper[0] : box.lower[0],
+                         corner & 2 ? box.upper[1] : box.lower[1],
+                         corner & 4 ? box.upper[2] : box.lower[2]};
+        for (int k = 0; k < 3; ++k) {
+            lower[k] = std::min(lower[k], along(axes[k], p));
+            upper[k] = std::max(upper[k], along(axes[k], p));
+        }
+    }
+}
+
+/// rows of the light frame scaled and offset into clip space, nearest depth at -1
+Matrix4f lightMatrix(const Vector3f axes[3], const float lower[3], const float upper[3])
+{
+    Matrix4f m{};
+    for (int k = 0; k < 3; ++k) {
+        const float extent = std::max(upper[k] - lower[k], 1e-6f);
+        const float sign = k == 2 ? -1.f : 1.f;
+        for (int col = 0; col < 3; ++col)
+            m[col * 4 + k] = sign * 2.f * axes[k][col] / extent;
+        m[12 + k] = k == 2 ? (upper[k] + lower[k]) / extent : -(upper[k] + lower[k]) / extent;
+    }
+    m[15] = 1.f;
+    return m;
+}
+
+/// world point of a camera at normalized device coordinates \p x, \p y and eye depth \p depth
+Vector3f viewPoint(const Matrix4f& view, const Matrix4f& proj, float x, float y, float depth)
+{
+    // perspective rays widen with depth, orthographic ones do not
+    const bool perspective = proj[11] != 0.f;
+    const float ex = perspective ? depth * (x + proj[8]) / proj[0] : (x - proj[12]) / proj[0];
+    const float ey = perspective ? depth * (y + proj[9]) / proj[5] : (y - proj[13]) / proj[5];
+    const float e[3] = {ex - view[12], ey - view[13], -depth - view[14]};
+    // the view is rigid, its inverse rotation is its transpose
+    Vector3f p;
+    for (int k = 0; k < 3; ++k)
+        p[k] = view[k * 4] * e[0] + view[k * 4 + 1] * e[1] + view[k * 4 + 2] * e[2];
+    return p;
+}
+
+} // namespace
+
+Matrix4f lightProjection(const Vector3f& direction, const scene::AABB& box)
+{
+    Vector3f axes[3];
+    lightAxes(direction, axes);
+    const float inf = std::numeric_limits<float>::infinity();
+    float lower[3] = {inf, inf, inf}, upper[3] = {-inf, -inf, -inf};
+    lightBounds(axes, box, lower, upper);
+    return lightMatrix(axes, lower, upper);
+}
+
+void fitShadowCascades(const Vector3f& direction, const Matrix4f& viewMatrix,
+                       const Matrix4f& projMatrix, const scene::AABB& receivers,
+                       const scene::AABB& casters, int count, int atlasSize,
+                       ShadowCascades& cascades)
+{
+    cascades.count = 0;
+    count = std::min(count, int(ShadowCascades::kMaxCascades));
+    if (count <= 0 || atlasSize <= 0 || receivers.empty() || casters.empty() ||
+        projMatrix[0] == 0.f || projMatrix[5] == 0.f || projMatrix[10] == 0.f)
+        return;
+
+    // eye depths of the receivers, within the clipping depths of the camera
+    const auto& proj = projMatrix;
+    const bool perspective = proj[11] != 0.f;
+    const float znear = perspective ? proj[14] / (proj[10] - 1.f) : (proj[14] + 1.f) / proj[10];
+    const float zfar = perspective ? proj[14] / (proj[10] + 1.f) : (proj[14] - 1.f) / proj[10];
+    const float inf = std::numeric_limits<float>::infinity();
+    float nearDepth = inf, farDepth = -inf;
+    for (int corner = 0; corner < 8; ++corner) {
+        const Vector3f p{corner & 1 ? receivers.upper[0] : receivers.lower[0],
+                         corner & 2 ? receivers.upper[1] : receivers.lower[1],
+                         corner & 4 ? receivers.upper[2] : receivers.lower[2]};
+        const float depth = -(viewMatrix[2] * p[0] + viewMatrix[6] * p[1] +
+                              viewMatrix[10] * p[2] + viewMatrix[14]);
+        nearDepth = std::min(nearDepth, depth);
+        farDepth = std::max(farDepth, depth);
+    }
+    nearDepth = std::max(nearDepth, znear);
+    farDepth = std::min(farDepth, zfar);
+    if (!(nearDepth < farDepth))
+        return;
+
+    Vector3f axes[3];
+    lightAxes(direction, axes);
+    float receiverLower[3] = {inf, inf, inf}, receiverUpper[3] = {-inf, -inf, -inf};
+    lightBounds(axes, receivers, receiverLower, receiverUpper);
+    // along the rays everything casting onto the receivers
+    float lower[3] = {inf, inf, inf}, upper[3] = {-inf, -inf, -inf};
+    lightBounds(axes, casters, lower, upper);
+    lower[2] = std::min(lower[2], receiverLower[2]);
+    upper[2] = std::max(upper[2], receiverUpper[2]);
+
+    const int grid = count > 1 ? 2 : 1;
+    const int tileSize = std::max(atlasSize / grid, 1);
+    float sliceNear = nearDepth;
+    for (int i = 0; i < count; ++i) {
+        const float t = float(i + 1) / float(count);
+        const float uniform = nearDepth + (farDepth - nearDepth) * t;
+        const float logarithmic =
+            nearDepth > 0.f ? nearDepth * std::pow(farDepth / nearDepth, t) : uniform;
+        const float sliceFar =
+            i + 1 == count ? farDepth : kLogSplit * logarithmic + (1.f - kLogSplit) * uniform;
+
+        // sphere around the corners of the slice
+        Vector3f corners[8];
+        Vector3f center{0.f, 0.f, 0.f};
+        for (int corner = 0; corner < 8; ++corner) {
+            corners[corner] = viewPoint(viewMatrix, proj, corner & 1 ? 1.f : -1.f,
+                                        corner & 2 ? 1.f : -1.f, corner & 4 ? sliceFar : sliceNear);
+            for (int k = 0; k < 3; ++k)
+                center[k] += corners[corner][k] / 8.f;
+        }
+        float radius = 0.f;
+        for (const auto& corner : corners) {
+            const float dx = corner[0] - center[0], dy = corner[1] - center[1],
+                        dz = corner[2] - center[2];
+            radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+
+        // across the rays, clipped to the receivers and snapped to texels of the sphere
+        const float texel = std::max(2.f * radius / float(tileSize), 1e-6f);
+        for (int k = 0; k < 2; ++k) {
+            const float c = along(axes[k], center);
+            lower[k] = std::max(c - radius, receiverLower[k]);
+            upper[k] = std::min(c + radius, receiverUpper[k]);
+            if (!(lower[k] < upper[k])) {
+                lower[k] = c - radius;
+                upper[k] = c + radius;
+            }
+            lower[k] = std::floor(lower[k] / texel) * texel;
+            upper[k] = std::ceil(upper[k] / texel) * texel;
+        }
+        cascades.viewProjs[i] = lightMatrix(axes, lower, upper);
+        float* tile = cascades.tiles + i * 4;
+        tile[0] = float(i % grid) / float(grid);
+        tile[1] = float(i / grid) / float(grid);
+        tile[2] = 1.f / float(grid);
+        tile[3] = sliceFar;
+        sliceNear = sliceFar;
+    }
+    cascades.count = count;
+}
+
+} // namespace render
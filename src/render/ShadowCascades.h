@@ -0,0 +1,59 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <scene/Bounds.h>
+
+namespace render {
+
+/**
+ * @brief Orthographic projection of the corners of a world box as seen from a light
+ *
+ * The light frame has x, y across the rays and z against them, as for a camera; the nearest depth
+ * is at -1 in clip space. The direction goes from the light to its target, as in
+ * scene::Light::position().
+ */
+Matrix4f lightProjection(const Vector3f& direction, const scene::AABB& box);
+
+/**
+ * @brief Shadow maps of a directional light fitted to the view of a camera
+ *
+ * The eye depths the receivers span are split into slices, spaced between a uniform and a
+ * logarithmic split so that near slices get more texels per meter than far ones. Each slice has
+ * its own projection, across the rays the sphere around its corners clipped to the receivers,
+ * so that its size does not change as the camera turns, and snapped to whole texels, so that
+ * shadows do not crawl as it moves; along them all the casters, wherever they are. Projections
+ * are drawn into tiles of a single square atlas, the total size of the maps is that of one map.
+ */
+struct ShadowCascades {
+    static constexpr int kMaxCascades = 4;
+
+    int count = 0;
+    Matrix4f viewProjs[kMaxCascades]; //<- world to the clip space of each cascade
+    // atlas offset x and y and scale of the tile of each cascade, in units of the atlas size,
+    // then the eye depth up to which it is sampled
+    float tiles[kMaxCascades * 4];
+};
+
+/**
+ * @brief Fit the shadow cascades of a directional light to a camera
+ *
+ * No cascade is fitted to empty receivers and casters or a camera without a projection.
+ *
+ * @param direction - from the light to its target
+ * @param viewMatrix - view matrix of the camera
+ * @param projMatrix - perspective or orthographic projection matrix of the camera
+ * @param receivers - world bounds of the nodes the camera sees, finite
+ * @param casters - world bounds of the nodes casting shadows, finite
+ * @param count - number of cascades, up to kMaxCascades
+ * @param atlasSize - texels a side of the atlas, tiles of 2 x 2 from 2 cascades on
+ * @param cascades - output
+ */
+void fitShadowCascades(const Vector3f& direction, const Matrix4f& viewMatrix,
+                       const Matrix4f& projMatrix, const scene::AABB& receivers,
+                       const scene::AABB& casters, int count, int atlasSize,
+                       ShadowCascades& cascades);
+
+} // namespace render
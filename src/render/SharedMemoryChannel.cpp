@@ -0,0 +1,386 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "SharedMemoryChannel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <ctime>
+#include <fstream>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "SharedMemoryChannel requires lock-free 64-bit atomics");
+
+namespace render {
+
+#ifdef _WIN32
+
+std::unique_ptr<SharedMemoryChannel> SharedMemoryChannel::create(const std::string&, int, size_t,
+                                                                 size_t)
+{
+    throw std::runtime_error("SharedMemoryChannel: not supported on Windows");
+}
+
+std::unique_ptr<SharedMemoryChannel> SharedMemoryChannel::open(const std::string&, double)
+{
+    throw std::runtime_error("SharedMemoryChannel: not supported on Windows");
+}
+
+// no channel exists on Windows, the members below are never called
+
+SharedMemoryChannel::SharedMemoryChannel(const std::string& name, void* memory, size_t size,
+                                         bool host)
+    : _name(name), _memory(memory), _size(size), _host(host)
+{
+}
+
+SharedMemoryChannel::~SharedMemoryChannel() = default;
+
+int SharedMemoryChannel::numSlots() const { return 0; }
+
+size_t SharedMemoryChannel::slotBytes() const { return 0; }
+
+uint8_t* SharedMemoryChannel::slot(int) const { return nullptr; }
+
+void SharedMemoryChannel::waitHost(double) const {}
+
+void SharedMemoryChannel::write(const void*, size_t) {}
+
+size_t SharedMemoryChannel::read(void*, size_t) { return 0; }
+
+void SharedMemoryChannel::shutdown() {}
+
+bool SharedMemoryChannel::closed(bool) const { return true; }
+
+#else
+
+namespace {
+
+constexpr uint32_t kMagic = 0x43534250; //<- "PBSC"
+constexpr uint32_t kVersion = 1;
+constexpr size_t kAlignment = 64;
+constexpr long kPollNanoseconds = 100000000; //<- between checks of a peer that may have exited
+
+/**
+ * @brief Byte ring of one direction, written and read at increasing byte counts
+ */
+struct Ring {
+    alignas(kAlignment) std::atomic<uint64_t> written;
+    alignas(kAlignment) std::atomic<uint64_t> read;
+    sem_t readable; //<- posted by the writer
+    sem_t writable; //<- posted by the reader
+};
+
+/**
+ * @brief Channel layout, written by the client before the magic number, followed by the data
+ * of the rings then the slots
+ */
+struct ChannelHeader {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint64_t ringBytes;
+    uint64_t slotBytes;
+    int32_t numSlots;
+    std::atomic<int32_t> pids[2]; //<- of the client and host processes, 0 until opened
+    std::atomic<uint32_t> closed; //<- by either side
+    Ring rings[2]; //<- client to host, host to client
+};
+
+size_t aligned(size_t bytes)
+{
+    return (bytes + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+size_t headerSize()
+{
+    return aligned(sizeof(ChannelHeader));
+}
+
+/// total bytes of a channel
+size_t channelSize(size_t ringBytes, int numSlots, size_t slotBytes)
+{
+    return headerSize() + 2 * ringBytes + size_t(numSlots) * slotBytes;
+}
+
+ChannelHeader& header(void* memory)
+{
+    return *static_cast<ChannelHeader*>(memory);
+}
+
+uint8_t* ringData(void* memory, int index)
+{
+    return static_cast<uint8_t*>(memory) + headerSize() + index * header(memory).ringBytes;
+}
+
+std::string sharedName(const std::string& name)
+{
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+/// wait for a post of \p semaphore, false after a while so that the caller checks its peer
+bool waitPost(sem_t& semaphore)
+{
+    timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += kPollNanoseconds;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_nsec -= 1000000000;
+        ++deadline.tv_sec;
+    }
+    return sem_timedwait(&semaphore, &deadline) == 0;
+}
+
+/// the process exited, or is a zombie of a parent blocked in a channel call
+bool processExited(int32_t pid)
+{
+    if (kill(pid_t(pid), 0) != 0)
+        return errno == ESRCH;
+#ifdef __linux__
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    std::getline(stat, line);
+    const size_t name = line.rfind(')');
+    return name != std::string::npos && name + 2 < line.size() && line[name + 2] == 'Z';
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+std::unique_ptr<SharedMemoryChannel> SharedMemoryChannel::create(const std::string& name,
+                                                                 int numSlots, size_t slotBytes,
+                                                                 size_t ringBytes)
+{
+    if (numSlots < 0 || ringBytes == 0)
+        throw std::invalid_argument("SharedMemoryChannel: rings must not be empty");
+    ringBytes = aligned(ringBytes);
+    slotBytes = aligned(slotBytes);
+
+    const std::string path = sharedName(name);
+    const size_t size = channelSize(ringBytes, numSlots, slotBytes);
+    shm_unlink(path.c_str());
+    const int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        throw std::runtime_error("SharedMemoryChannel: cannot create shared memory " + path);
+    // pages are only allocated once written, large slots cost the frames drawn into them
+    void* memory = nullptr;
+    if (ftruncate(fd, off_t(size)) == 0)
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (!memory || memory == MAP_FAILED) {
+        shm_unlink(path.c_str());
+        throw std::runtime_error("SharedMemoryChannel: cannot map shared memory " + path);
+    }
+
+    // new mappings are zero-filled: empty rings, no host
+    std::unique_ptr<SharedMemoryChannel> channel(
+        new SharedMemoryChannel(path, memory, size, false));
+    auto& channelHeader = header(memory);
+    for (auto& ring : channelHeader.rings) {
+        if (sem_init(&ring.readable, 1, 0) != 0 || sem_init(&ring.writable, 1, 0) != 0)
+            throw std::runtime_error("SharedMemoryChannel: no process-shared semaphores");
+    }
+    channelHeader.version = kVersion;
+    channelHeader.ringBytes = ringBytes;
+    channelHeader.slotBytes = slotBytes;
+    channelHeader.numSlots = numSlots;
+    channelHeader.pids[0] = int32_t(getpid());
+    channelHeader.magic.store(kMagic, std::memory_order_release);
+    return channel;
+}
+
+std::unique_ptr<SharedMemoryChannel> SharedMemoryChannel::open(const std::string& name,
+                                                               double timeout)
+{
+    const std::string path = sharedName(name);
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                              std::chrono::duration<double>(timeout));
+    while (true) {
+        // the client may not have created the channel, nor written its header, yet
+        const int fd = shm_open(path.c_str(), O_RDWR, 0);
+        void* memory = nullptr;
+        size_t size = 0;
+        struct stat info;
+        if (fd >= 0 && fstat(fd, &info) == 0 && size_t(info.st_size) >= headerSize()) {
+            size = size_t(info.st_size);
+            memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (fd >= 0)
+            close(fd);
+        if (memory && memory != MAP_FAILED) {
+            auto& channelHeader = header(memory);
+            if (channelHeader.magic.load(std::memory_order_acquire) == kMagic) {
+                // channels of others are left open
+                int32_t none = 0;
+                const char* error = nullptr;
+                if (channelHeader.version != kVersion ||
+                    size < channelSize(channelHeader.ringBytes, channelHeader.numSlots,
+                                       channelHeader.slotBytes))
+                    error = " is not a channel";
+                else if (!channelHeader.pids[1].compare_exchange_strong(none, int32_t(getpid())))
+                    error = " has a host";
+                if (error) {
+                    munmap(memory, size);
+                    throw std::runtime_error("SharedMemoryChannel: " + path + error);
+                }
+                return std::unique_ptr<SharedMemoryChannel>(
+                    new SharedMemoryChannel(path, memory, size, true));
+            }
+            munmap(memory, size);
+        }
+        if (std::chrono::steady_clock::now() >= deadline)
+            throw std::runtime_error("SharedMemoryChannel: no channel " + path);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+SharedMemoryChannel::SharedMemoryChannel(const std::string& name, void* memory, size_t size,
+                                         bool host)
+    : _name(name), _memory(memory), _size(size), _host(host)
+{
+}
+
+SharedMemoryChannel::~SharedMemoryChannel()
+{
+    auto& channelHeader = header(_memory);
+    const bool unhosted = !_host && channelHeader.pids[1].load() == 0;
+    shutdown();
+    munmap(_memory, _size);
+    // hosted channels lost their name when the host opened them
+    if (unhosted)
+        shm_unlink(_name.c_str());
+}
+
+int SharedMemoryChannel::numSlots() const
+{
+    return header(_memory).numSlots;
+}
+
+size_t SharedMemoryChannel::slotBytes() const
+{
+    return size_t(header(_memory).slotBytes);
+}
+
+uint8_t* SharedMemoryChannel::slot(int index) const
+{
+    const auto& channelHeader = header(_memory);
+    return static_cast<uint8_t*>(_memory) + headerSize() + 2 * channelHeader.ringBytes +
+           size_t(index) * channelHeader.slotBytes;
+}
+
+void SharedMemoryChannel::waitHost(double timeout) const
+{
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                              std::chrono::duration<double>(timeout));
+    while (!header(_memory).pids[1].load()) {
+        if (std::chrono::steady_clock::now() >= deadline)
+            throw std::runtime_error("SharedMemoryChannel: no host opened " + _name);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // both processes map the memory, the name is no longer needed, nor left behind on a crash
+    shm_unlink(_name.c_str());
+}
+
+void SharedMemoryChannel::write(const void* data, size_t size)
+{
+    auto& channelHeader = header(_memory);
+    auto& ring = channelHeader.rings[_host ? 1 : 0];
+    uint8_t* buffer = ringData(_memory, _host ? 1 : 0);
+    const size_t capacity = size_t(channelHeader.ringBytes);
+    auto bytes = static_cast<const uint8_t*>(data);
+    bool posted = true; //<- the peer is only looked for after waiting in vain
+    while (size > 0) {
+        if (closed(!posted))
+            throw std::runtime_error("SharedMemoryChannel: channel closed");
+        const uint64_t written = ring.written.load(std::memory_order_relaxed);
+        const size_t room = capacity - size_t(written - ring.read.load(std::memory_order_acquire));
+        if (room == 0) {
+            posted = waitPost(ring.writable);
+            continue;
+        }
+        const size_t count = std::min(size, room);
+        const size_t offset = size_t(written % capacity);
+        const size_t first = std::min(count, capacity - offset);
+        std::memcpy(buffer + offset, bytes, first);
+        std::memcpy(buffer, bytes + first, count - first);
+        ring.written.store(written + count, std::memory_order_release);
+        sem_post(&ring.readable);
+        bytes += count;
+        size -= count;
+    }
+}
+
+size_t SharedMemoryChannel::read(void* data, size_t size)
+{
+    auto& channelHeader = header(_memory);
+    auto& ring = channelHeader.rings[_host ? 0 : 1];
+    const uint8_t* buffer = ringData(_memory, _host ? 0 : 1);
+    const size_t capacity = size_t(channelHeader.ringBytes);
+    auto bytes = static_cast<uint8_t*>(data);
+    size_t received = 0;
+    bool posted = true;
+    while (received < size) {
+        const uint64_t read = ring.read.load(std::memory_order_relaxed);
+        const size_t available =
+            size_t(ring.written.load(std::memory_order_acquire) - read);
+        if (available == 0) {
+            // bytes written before the channel closed are still read
+            if (closed(!posted) && ring.written.load(std::memory_order_acquire) == read)
+                break;
+            posted = waitPost(ring.readable);
+            continue;
+        }
+        const size_t count = std::min(size - received, available);
+        const size_t offset = size_t(read % capacity);
+        const size_t first = std::min(count, capacity - offset);
+        std::memcpy(bytes + received, buffer + offset, first);
+        std::memcpy(bytes + received + first, buffer, count - first);
+        ring.read.store(read + count, std::memory_order_release);
+        sem_post(&ring.writable);
+        received += count;
+    }
+    return received;
+}
+
+void SharedMemoryChannel::shutdown()
+{
+    auto& channelHeader = header(_memory);
+    if (channelHeader.closed.exchange(1))
+        return;
+    for (auto& ring : channelHeader.rings) {
+        sem_post(&ring.readable);
+        sem_post(&ring.writable);
+    }
+}
+
+bool SharedMemoryChannel::closed(bool checkPeer) const
+{
+    const auto& channelHeader = header(_memory);
+    if (channelHeader.closed.load())
+        return true;
+    // a process killed before closing its side
+    const int32_t peer = channelHeader.pids[_host ? 0 : 1].load();
+    return checkPeer && peer != 0 && processExited(peer);
+}
+
+#endif
+
+} // namespace render
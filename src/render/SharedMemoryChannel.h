@@ -0,0 +1,108 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace render {
+
+/**
+ * @brief Two-way byte channel and frame slots in named shared memory, between a renderer of one
+ * process and a host process rendering for it, see RemoteRenderer::sharedMemory()
+ *
+ * The client creates the channel, a host opens it by name. Each direction is a byte ring written
+ * by one thread of one side and read by one thread of the other, blocking on process-shared
+ * semaphores while the ring is full or empty, so that messages stream through it as through a
+ * socket. The host also writes frames straight into the numSlots() slots of slotBytes() each,
+ * which the client reads in place.
+ *
+ * Either side closing the channel, or its process exiting, fails the blocked and later writes
+ * of the other; reads return what was written before. POSIX only.
+ */
+class SharedMemoryChannel
+{
+  public:
+    static constexpr size_t kRingBytes = size_t(4) << 20;
+
+    /**
+     * @brief Create a channel, replacing a previous one of the same name
+     *
+     * @param name - shared memory name, a leading '/' is added if missing
+     * @param numSlots - number of frame slots
+     * @param slotBytes - bytes of each slot
+     * @param ringBytes - bytes of the ring of each direction
+     * @throw std::runtime_error - if the shared memory cannot be created
+     */
+    static std::unique_ptr<SharedMemoryChannel> create(const std::string& name, int numSlots,
+                                                       size_t slotBytes,
+                                                       size_t ringBytes = kRingBytes);
+
+    /**
+     * @brief Open the channel of a client as its host
+     *
+     * @param name - shared memory name, a leading '/' is added if missing
+     * @param timeout - seconds to wait for the client to create it
+     * @throw std::runtime_error - if there is no such channel in time, or it has a host
+     */
+    static std::unique_ptr<SharedMemoryChannel> open(const std::string& name, double timeout);
+
+    /// close the channel and unmap it, removing the name of a channel created by this object
+    ~SharedMemoryChannel();
+
+    SharedMemoryChannel(const SharedMemoryChannel&) = delete;
+    SharedMemoryChannel& operator=(const SharedMemoryChannel&) = delete;
+
+    /// shared memory name
+    const std::string& name() const { return _name; }
+
+    /// number of frame slots
+    int numSlots() const;
+
+    /// bytes of each slot
+    size_t slotBytes() const;
+
+    /// first byte of a slot, aligned to 64 bytes
+    uint8_t* slot(int index) const;
+
+    /**
+     * @brief Wait for a host to open the channel, see open()
+     *
+     * @throw std::runtime_error - if none did in time
+     */
+    void waitHost(double timeout) const;
+
+    /**
+     * @brief Write bytes to the other side, waiting for room in its ring
+     *
+     * @throw std::runtime_error - if the channel is closed
+     */
+    void write(const void* data, size_t size);
+
+    /**
+     * @brief Read exactly \p size bytes written by the other side
+     *
+     * @return Number of bytes read before the channel was closed
+     */
+    size_t read(void* data, size_t size);
+
+    /// close the channel, wakes the blocked calls of both sides
+    void shutdown();
+
+  private:
+    SharedMemoryChannel(const std::string& name, void* memory, size_t size, bool host);
+
+    /// the channel was closed, or the other process exited if \p checkPeer
+    bool closed(bool checkPeer) const;
+
+    std::string _name;
+    void* _memory; //<- mapped header, rings and slots
+    size_t _size;
+    bool _host; //<- opened by the host, created by the client otherwise
+};
+
+} // namespace render
@@ -0,0 +1,130 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "StageStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace render {
+
+namespace {
+
+thread_local std::shared_ptr<StageStats> tCurrentStats;
+
+} // namespace
+
+const char* stageName(Stage stage)
+{
+    switch (stage) {
+    case Stage::SceneSync:
+        return "scene_sync";
+    case Stage::StateSync:
+        return "state_sync";
+    case Stage::Python:
+        return "python";
+    case Stage::Render:
+        return "render";
+    case Stage::Readback:
+        return "readback";
+    case Stage::Copy:
+        return "copy";
+    case Stage::GpuShadow:
+        return "gpu_shadow";
+    case Stage::GpuPrepass:
+        return "gpu_prepass";
+    case Stage::GpuMain:
+        return "gpu_main";
+    case Stage::GpuResolve:
+        return "gpu_resolve";
+    case Stage::GpuReadback:
+        return "gpu_readback";
+    case Stage::Queue:
+        return "queue";
+    default:
+        return "unknown";
+    }
+}
+
+StageStats::Scope::Scope(const std::shared_ptr<StageStats>& stats) : _previous(tCurrentStats)
+{
+    tCurrentStats = stats;
+}
+
+StageStats::Scope::~Scope()
+{
+    tCurrentStats = std::move(_previous);
+}
+
+const std::shared_ptr<StageStats>& StageStats::current()
+{
+    return tCurrentStats;
+}
+
+void StageStats::record(Stage stage, double seconds)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& samples = _samples[size_t(stage)];
+    samples.seconds[samples.count % kWindow] = float(seconds);
+    ++samples.count;
+}
+
+std::vector<float> StageStats::sorted(Stage stage, uint64_t* count) const
+{
+    std::vector<float> seconds;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const auto& samples = _samples[size_t(stage)];
+        if (count)
+            *count = samples.count;
+        seconds.assign(samples.seconds.begin(),
+                       samples.seconds.begin() + std::min<uint64_t>(samples.count, kWindow));
+    }
+    std::sort(seconds.begin(), seconds.end());
+    return seconds;
+}
+
+StageSummary StageStats::summary(Stage stage) const
+{
+    StageSummary summary;
+    const auto seconds = sorted(stage, &summary.count);
+    if (seconds.empty())
+        return summary;
+
+    const auto percentile = [&seconds](double q) {
+        return 1e3 * seconds[size_t(q * (seconds.size() - 1) + 0.5)];
+    };
+    double sum = 0.;
+    for (float value : seconds) {
+        sum += value;
+        const double us = value * 1e6;
+        const int bucket = us < 2. ? 0 : int(std::log2(us));
+        ++summary.histogram[std::min(bucket, StageSummary::kBuckets - 1)];
+    }
+    summary.window = int(seconds.size());
+    summary.mean = 1e3 * sum / seconds.size();
+    summary.p50 = percentile(0.5);
+    summary.p90 = percentile(0.9);
+    summary.p99 = percentile(0.99);
+    summary.max = 1e3 * seconds.back();
+    return summary;
+}
+
+double StageStats::percentile(Stage stage, double q) const
+{
+    const auto seconds = sorted(stage, nullptr);
+    if (seconds.empty())
+        return -1.;
+    const size_t index = size_t(std::max(q, 0.) * (seconds.size() - 1) + 0.5);
+    return 1e3 * seconds[std::min(index, seconds.size() - 1)];
+}
+
+void StageStats::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& samples : _samples)
+        samples.count = 0;
+}
+
+} // namespace render
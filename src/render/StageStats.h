@@ -0,0 +1,174 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Trace.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Steps of a camera image request, timed with StageTimer
+ */
+enum class Stage
+{
+    SceneSync, //<- scene graph changes passed to the renderer
+    StateSync, //<- node poses applied by the renderer, part of its render stage
+    Python,    //<- calls into python renderers, waiting for the GIL included
+    Render,    //<- drawing, only its submission for GPU renderers
+    Readback,  //<- transfer of the images from the GPU, waiting for the drawing
+    Copy,      //<- copy of the images into the buffers of the caller
+    // GPU time of the passes of the EGL renderer, from timer queries read two frames later
+    GpuShadow,   //<- shadow maps of the light
+    GpuPrepass,  //<- occluders and their depth reduction, with occlusion culling
+    GpuMain,     //<- shapes of the view
+    GpuResolve,  //<- multisample resolve, resampling and panorama faces
+    GpuReadback, //<- transfer of the images from the frame targets
+    Queue, //<- wait of a request for a worker of a RenderScheduler
+    Count,
+};
+
+/**
+ * @brief Name of a stage, as in the stats of the bindings
+ */
+const char* stageName(Stage stage);
+
+/**
+ * @brief Durations of the last samples of a stage, in milliseconds
+ */
+struct StageSummary {
+    static constexpr int kBuckets = 20;
+
+    uint64_t count = 0; //<- samples recorded since the last reset
+    int window = 0; //<- last samples the values below are computed from
+    double mean = 0.;
+    double p50 = 0.;
+    double p90 = 0.;
+    double p99 = 0.;
+    double max = 0.;
+    std::array<uint32_t, kBuckets> histogram{}; //<- samples of [2^k, 2^(k+1)) us, first and
+                                                //   last buckets open
+};
+
+/**
+ * @brief Rolling durations of the stages of the camera images of a client
+ *
+ * Timers record into the stats made current on their thread with Scope, so that renderers
+ * time their steps without knowing their client; timers without current stats do nothing.
+ * Recording and summaries may happen on different threads.
+ */
+class StageStats
+{
+  public:
+    static constexpr int kWindow = 512; //<- samples kept per stage
+
+    /**
+     * @brief Make stats current on the calling thread while in scope, null for none
+     */
+    class Scope
+    {
+      public:
+        explicit Scope(const std::shared_ptr<StageStats>& stats);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        std::shared_ptr<StageStats> _previous;
+    };
+
+    /**
+     * @brief Stats current on the calling thread, null if none
+     */
+    static const std::shared_ptr<StageStats>& current();
+
+    /**
+     * @brief Record a duration of a stage
+     */
+    void record(Stage stage, double seconds);
+
+    /**
+     * @brief Summary of the last durations of a stage
+     */
+    StageSummary summary(Stage stage) const;
+
+    /**
+     * @brief Percentile of the last durations of a stage, in milliseconds
+     *
+     * @param stage - timed stage
+     * @param q - percentile in [0, 1], 1 for the maximum
+     * @return double - duration, negative if no samples
+     */
+    double percentile(Stage stage, double q) const;
+
+    /**
+     * @brief Forget all durations
+     */
+    void reset();
+
+  private:
+    /// last durations of a stage in seconds, sorted, and the number of samples
+    std::vector<float> sorted(Stage stage, uint64_t* count) const;
+
+    struct Samples {
+        std::array<float, kWindow> seconds;
+        uint64_t count = 0;
+    };
+
+    mutable std::mutex _mutex;
+    std::array<Samples, size_t(Stage::Count)> _samples;
+};
+
+/**
+ * @brief Time a stage until the end of the scope, into the current stats of the thread and
+ * the trace
+ */
+class StageTimer
+{
+  public:
+    explicit StageTimer(Stage stage)
+        : _stage(stage), _stats(StageStats::current().get()), _traced(Trace::enabled())
+    {
+        if (_stats)
+            _start = std::chrono::steady_clock::now();
+        if (_traced)
+            Trace::begin(stageName(stage));
+    }
+
+    ~StageTimer() { stop(); }
+
+    /**
+     * @brief End the stage before the end of the scope, later calls do nothing
+     */
+    void stop()
+    {
+        if (_stats)
+            _stats->record(_stage, std::chrono::duration<double>(
+                                       std::chrono::steady_clock::now() - _start)
+                                       .count());
+        if (_traced)
+            Trace::end(stageName(_stage));
+        _stats = nullptr;
+        _traced = false;
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+  private:
+    Stage _stage;
+    StageStats* _stats; //<- null if no stats are current
+    bool _traced; //<- a span was opened in the trace
+    std::chrono::steady_clock::time_point _start;
+};
+
+} // namespace render
@@ -0,0 +1,406 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "TextureCache.h"
+#include "AssetArchive.h"
+
+#include <utils/file.h>
+#include <utils/hash.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+namespace render {
+
+namespace {
+
+using Compression = scene::Bitmap::Compression;
+
+constexpr uint32_t kEntryMagic = 0x54524250; //<- "PBRT"
+constexpr uint32_t kEntryVersion = 1;
+constexpr size_t kSectionAlignment = 16;
+constexpr int kMaxSize = 1 << 15;
+
+/**
+ * @brief Header of a cache entry, followed by the blocks of all mip levels, aligned to
+ * kSectionAlignment bytes
+ */
+struct EntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceSize; //<- size of the texture file, against hash collisions
+    uint64_t sourceHash;
+    int32_t rows;
+    int32_t cols;
+    int32_t compression;
+    int32_t levels;
+    uint64_t dataSize;
+};
+
+size_t aligned(size_t size)
+{
+    return (size + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+}
+
+std::mutex gMutex;
+bool gConfigured = false;
+std::string gDirectory;
+
+// taken across fork() so that children do not inherit it locked by a thread they lack
+const int gForkHandlers = pthread_atfork([] { gMutex.lock(); }, [] { gMutex.unlock(); },
+                                         [] { gMutex.unlock(); });
+
+std::string directory()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    if (!gConfigured) {
+        const char* directory = std::getenv("PYBULLET_RENDERING_TEXTURE_CACHE");
+        gDirectory = directory ? directory : "";
+        gConfigured = true;
+    }
+    return gDirectory;
+}
+
+/// path of the entry of a texture file, and the hash of the file
+std::string entryPath(const std::string& directory, const AssetFile& source,
+                      uint64_t& sourceHash)
+{
+    const uint64_t hash = hashBytes(&kEntryVersion, sizeof(kEntryVersion));
+    sourceHash = hashWords(source.data, source.size, hash);
+
+    char name[24];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(sourceHash));
+    return directory + "/" + name + ".tex";
+}
+
+/// number of mip levels down to 1x1
+int levelCount(int rows, int cols)
+{
+    int levels = 1;
+    while ((rows >> levels) > 0 || (cols >> levels) > 0)
+        ++levels;
+    return levels;
+}
+
+/// size of the blocks of all mip levels
+size_t dataSize(int rows, int cols, Compression compression, int levels)
+{
+    const scene::Bitmap layout({}, Size2i{rows, cols}, compression, levels);
+    size_t size = 0;
+    for (int level = 0; level < levels; ++level)
+        size += layout.levelBytes(level);
+    return size;
+}
+
+/// RGBA pixels of an uncompressed bitmap
+std::vector<uint8_t> expandRgba(const scene::Bitmap& bitmap)
+{
+    const size_t count = size_t(bitmap.rows()) * size_t(bitmap.cols());
+    const size_t channels = size_t(bitmap.channels());
+    const uint8_t* data = bitmap.data();
+    std::vector<uint8_t> pixels(count * 4);
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* in = &data[i * channels];
+        uint8_t* out = &pixels[i * 4];
+        out[0] = in[0];
+        out[1] = channels == 1 ? in[0] : in[1];
+        out[2] = channels == 1 ? in[0] : channels == 2 ? 0 : in[2];
+        out[3] = channels == 4 ? in[3] : 255;
+    }
+    return pixels;
+}
+
+/// next mip level, each pixel the mean of up to 2x2 pixels
+std::vector<uint8_t> halve(const std::vector<uint8_t>& pixels, int rows, int cols)
+{
+    const int newRows = std::max(rows >> 1, 1), newCols = std::max(cols >> 1, 1);
+    std::vector<uint8_t> result(size_t(newRows) * size_t(newCols) * 4);
+    for (int row = 0; row < newRows; ++row) {
+        const int r0 = std::min(row * 2, rows - 1), r1 = std::min(row * 2 + 1, rows - 1);
+        for (int col = 0; col < newCols; ++col) {
+            const int c0 = std::min(col * 2, cols - 1), c1 = std::min(col * 2 + 1, cols - 1);
+            const uint8_t* p[4] = {&pixels[(size_t(r0) * cols + c0) * 4],
+                                   &pixels[(size_t(r0) * cols + c1) * 4],
+                                   &pixels[(size_t(r1) * cols + c0) * 4],
+                                   &pixels[(size_t(r1) * cols + c1) * 4]};
+            uint8_t* out = &result[(size_t(row) * newCols + col) * 4];
+            for (int k = 0; k < 4; ++k)
+                out[k] = uint8_t((p[0][k] + p[1][k] + p[2][k] + p[3][k] + 2) / 4);
+        }
+    }
+    return result;
+}
+
+uint16_t pack565(const float color[3])
+{
+    const auto quantize = [](float value, int levels) {
+        return int(std::lround(std::min(std::max(value, 0.f), 255.f) * levels / 255.f));
+    };
+    return uint16_t(quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 |
+                    quantize(color[2], 31));
+}
+
+std::array<int, 3> unpack565(uint16_t color)
+{
+    const int r = color >> 11 & 31, g = color >> 5 & 63, b = color & 31;
+    return {r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2};
+}
+
+/**
+ * @brief BC1 color block of 4x4 RGBA pixels, always in four color mode
+ *
+ * Endpoints are the extremes of the pixels along their principal axis.
+ */
+void encodeColorBlock(const uint8_t block[16][4], uint8_t* out)
+{
+    float mean[3] = {0.f, 0.f, 0.f};
+    for (int i = 0; i < 16; ++i)
+        for (int k = 0; k < 3; ++k)
+            mean[k] += block[i][k] / 16.f;
+    float covariance[6] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f}; //<- rr, rg, rb, gg, gb, bb
+    for (int i = 0; i < 16; ++i) {
+        const float d[3] = {block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2]};
+        covariance[0] += d[0] * d[0];
+        covariance[1] += d[0] * d[1];
+        covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1];
+        covariance[4] += d[1] * d[2];
+        covariance[5] += d[2] * d[2];
+    }
+    // principal axis by power iteration, from the luminance direction
+    float axis[3] = {0.577f, 0.577f, 0.577f};
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        const float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]};
+        const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (!(length > 1e-6f))
+            break;
+        for (int k = 0; k < 3; ++k)
+            axis[k] = next[k] / length;
+    }
+    float lower = 0.f, upper = 0.f;
+    for (int i = 0; i < 16; ++i) {
+        float t = 0.f;
+        for (int k = 0; k < 3; ++k)
+            t += (block[i][k] - mean[k]) * axis[k];
+        lower = std::min(lower, t);
+        upper = std::max(upper, t);
+    }
+    float endpoints[2][3];
+    for (int k = 0; k < 3; ++k) {
+        endpoints[0][k] = mean[k] + axis[k] * upper;
+        endpoints[1][k] = mean[k] + axis[k] * lower;
+    }
+    uint16_t color0 = pack565(endpoints[0]), color1 = pack565(endpoints[1]);
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        // four color mode needs color0 > color1: 0, 1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+        const auto c0 = unpack565(color0), c1 = unpack565(color1);
+        int palette[4][3];
+        for (int k = 0; k < 3; ++k) {
+            palette[0][k] = c0[k];
+            palette[1][k] = c1[k];
+            palette[2][k] = (2 * c0[k] + c1[k]) / 3;
+            palette[3][k] = (c0[k] + 2 * c1[k]) / 3;
+        }
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestDistance = -1;
+            for (int entry = 0; entry < 4; ++entry) {
+                int distance = 0;
+                for (int k = 0; k < 3; ++k) {
+                    const int d = block[i][k] - palette[entry][k];
+                    distance += d * d;
+                }
+                if (bestDistance < 0 || distance < bestDistance) {
+                    best = entry;
+                    bestDistance = distance;
+                }
+            }
+            indices |= uint32_t(best) << (i * 2);
+        }
+    }
+    out[0] = uint8_t(color0 & 0xff);
+    out[1] = uint8_t(color0 >> 8);
+    out[2] = uint8_t(color1 & 0xff);
+    out[3] = uint8_t(color1 >> 8);
+    for (int k = 0; k < 4; ++k)
+        out[4 + k] = uint8_t(indices >> (k * 8));
+}
+
+/**
+ * @brief BC3 alpha block of 4x4 RGBA pixels, in eight level mode between the extremes
+ */
+void encodeAlphaBlock(const uint8_t block[16][4], uint8_t* out)
+{
+    int alpha0 = 0, alpha1 = 255;
+    for (int i = 0; i < 16; ++i) {
+        alpha0 = std::max<int>(alpha0, block[i][3]);
+        alpha1 = std::min<int>(alpha1, block[i][3]);
+    }
+    uint64_t indices = 0;
+    if (alpha0 > alpha1) {
+        // 0, 1, then (7 - j) / 7 a0 + j / 7 a1 for j in 1..6
+        int levels[8] = {alpha0, alpha1};
+        for (int j = 1; j < 7; ++j)
+            levels[j + 1] = ((7 - j) * alpha0 + j * alpha1) / 7;
+        for (int i = 0; i < 16; ++i) {
+            int best = 0;
+            for (int entry = 1; entry < 8; ++entry)
+                if (std::abs(block[i][3] - levels[entry]) < std::abs(block[i][3] - levels[best]))
+                    best = entry;
+            indices |= uint64_t(best) << (i * 3);
+        }
+    }
+    out[0] = uint8_t(alpha0);
+    out[1] = uint8_t(alpha1);
+    for (int k = 0; k < 6; ++k)
+        out[2 + k] = uint8_t(indices >> (k * 8));
+}
+
+/// blocks of a mip level, pixels past the borders clamped
+void encodeLevel(const std::vector<uint8_t>& pixels, int rows, int cols, Compression compression,
+                 std::vector<uint8_t>& data)
+{
+    const bool alpha = compression == Compression::BC3;
+    for (int blockRow = 0; blockRow < rows; blockRow += 4) {
+        for (int blockCol = 0; blockCol < cols; blockCol += 4) {
+            uint8_t block[16][4];
+            for (int i = 0; i < 16; ++i) {
+                const int row = std::min(blockRow + i / 4, rows - 1);
+                const int col = std::min(blockCol + i % 4, cols - 1);
+                std::memcpy(block[i], &pixels[(size_t(row) * cols + col) * 4], 4);
+            }
+            const size_t offset = data.size();
+            data.resize(offset + (alpha ? 16 : 8));
+            if (alpha)
+                encodeAlphaBlock(block, &data[offset]);
+            encodeColorBlock(block, &data[offset + (alpha ? 8 : 0)]);
+        }
+    }
+}
+
+} // namespace
+
+void setTextureCacheDirectory(const std::string& directory)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gDirectory = directory;
+    gConfigured = true;
+}
+
+std::string textureCacheDirectory() { return directory(); }
+
+std::shared_ptr<scene::Bitmap> compressBitmap(const scene::Bitmap& bitmap)
+{
+    if (bitmap.compression() != Compression::None || bitmap.channels() < 1 ||
+        bitmap.rows() > kMaxSize || bitmap.cols() > kMaxSize)
+        return nullptr;
+
+    int rows = int(bitmap.rows()), cols = int(bitmap.cols());
+    auto pixels = expandRgba(bitmap);
+    bool opaque = true;
+    for (size_t i = 3; i < pixels.size() && opaque; i += 4)
+        opaque = pixels[i] == 255;
+    const auto compression = opaque ? Compression::BC1 : Compression::BC3;
+    const int levels = levelCount(rows, cols);
+
+    std::vector<uint8_t> data;
+    data.reserve(dataSize(rows, cols, compression, levels));
+    for (int level = 0; level < levels; ++level) {
+        if (level > 0) {
+            pixels = halve(pixels, rows, cols);
+            rows = std::max(rows >> 1, 1);
+            cols = std::max(cols >> 1, 1);
+        }
+        encodeLevel(pixels, rows, cols, compression, data);
+    }
+    return std::make_shared<scene::Bitmap>(
+        std::move(data), Size2i{int(bitmap.rows()), int(bitmap.cols())}, compression, levels);
+}
+
+std::shared_ptr<scene::Bitmap> loadCachedTexture(const std::string& filename)
+{
+    const auto cacheDirectory = directory();
+    if (cacheDirectory.empty())
+        return nullptr;
+
+    const auto source = openAssetFile(filename);
+    if (!source)
+        return nullptr;
+    uint64_t sourceHash;
+    const MappedFile entry(entryPath(cacheDirectory, source, sourceHash));
+    if (!entry.valid() || entry.size() < sizeof(EntryHeader))
+        return nullptr;
+
+    // entries are trusted only if consistent, e.g. not truncated by a full disk
+    EntryHeader header;
+    std::memcpy(&header, entry.data(), sizeof(header));
+    if (header.magic != kEntryMagic || header.version != kEntryVersion ||
+        header.sourceSize != source.size || header.sourceHash != sourceHash ||
+        header.rows < 1 || header.rows > kMaxSize || header.cols < 1 || header.cols > kMaxSize ||
+        (header.compression != int(Compression::BC1) &&
+         header.compression != int(Compression::BC3)) ||
+        header.levels != levelCount(header.rows, header.cols))
+        return nullptr;
+    const auto compression = Compression(header.compression);
+    const size_t size = dataSize(header.rows, header.cols, compression, header.levels);
+    if (header.dataSize != size || aligned(sizeof(EntryHeader)) + aligned(size) != entry.size())
+        return nullptr;
+
+    const char* blocks = entry.data() + aligned(sizeof(EntryHeader));
+    std::vector<uint8_t> data(blocks, blocks + size);
+    return std::make_shared<scene::Bitmap>(std::move(data), Size2i{header.rows, header.cols},
+                                           compression, header.levels);
+}
+
+void storeCachedTexture(const std::string& filename, const scene::Bitmap& bitmap)
+{
+    const auto cacheDirectory = directory();
+    if (cacheDirectory.empty() || bitmap.compression() == Compression::None)
+        return;
+
+    const auto source = openAssetFile(filename);
+    if (!source || !makeDirectories(cacheDirectory))
+        return;
+    uint64_t sourceHash;
+    const auto path = entryPath(cacheDirectory, source, sourceHash);
+
+    EntryHeader header = {kEntryMagic,
+                          kEntryVersion,
+                          source.size,
+                          sourceHash,
+                          int32_t(bitmap.rows()),
+                          int32_t(bitmap.cols()),
+                          int32_t(bitmap.compression()),
+                          int32_t(bitmap.levels()),
+                          bitmap.size()};
+
+    writeFileAtomically(path, [&](std::ofstream& file) {
+        static const char padding[kSectionAlignment] = {};
+        std::vector<char> head(aligned(sizeof(header)), 0);
+        std::memcpy(head.data(), &header, sizeof(header));
+        file.write(head.data(), std::streamsize(head.size()));
+        const size_t size = bitmap.size();
+        file.write(reinterpret_cast<const char*>(bitmap.data()), std::streamsize(size));
+        file.write(padding, std::streamsize(aligned(size) - size));
+    });
+}
+
+} // namespace render
@@ -0,0 +1,60 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <scene/Texture.h>
+
+#include <memory>
+#include <string>
+
+namespace render {
+
+/**
+ * @brief Set the directory of the persistent texture cache, empty to disable it
+ *
+ * Texture files are stored there block compressed with all their mip levels, see
+ * compressBitmap(), so that later processes map them instead of decoding the files again, and
+ * native renderers upload them as is with a quarter to an eighth of the GPU memory. Entries are
+ * named after the content of the texture file. Defaults to the PYBULLET_RENDERING_TEXTURE_CACHE
+ * environment variable.
+ *
+ * @param directory - cache directory, created on the first store
+ */
+void setTextureCacheDirectory(const std::string& directory);
+
+/**
+ * @brief Directory of the persistent texture cache, empty if disabled
+ */
+std::string textureCacheDirectory();
+
+/**
+ * @brief Block compress a bitmap, with mip levels down to 1x1 box filtered from the previous
+ *
+ * Opaque bitmaps are compressed to BC1, others to BC3. Single channel bitmaps are compressed as
+ * gray, two and three channel ones with the missing channels 0 and an opaque alpha, as they are
+ * uploaded uncompressed.
+ *
+ * @param bitmap - uncompressed bitmap
+ * @return std::shared_ptr<scene::Bitmap> - compressed bitmap, null for empty or compressed ones
+ */
+std::shared_ptr<scene::Bitmap> compressBitmap(const scene::Bitmap& bitmap);
+
+/**
+ * @brief Load the cached compressed bitmap of a texture file
+ *
+ * @param filename - texture file on disk
+ * @return std::shared_ptr<scene::Bitmap> - compressed bitmap, null if not cached or disabled
+ */
+std::shared_ptr<scene::Bitmap> loadCachedTexture(const std::string& filename);
+
+/**
+ * @brief Store the compressed bitmap of a texture file, atomically, failures are ignored
+ *
+ * @param filename - texture file on disk
+ * @param bitmap - compressed bitmap with all its mip levels
+ */
+void storeCachedTexture(const std::string& filename, const scene::Bitmap& bitmap);
+
+} // namespace render
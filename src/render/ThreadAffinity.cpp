@@ -0,0 +1,300 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "ThreadAffinity.h"
+
+#include "DeviceScheduler.h"
+
+#ifdef WITH_EGL
+#include "EGLRenderer.h"
+#endif
+
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+namespace render {
+
+namespace {
+
+/**
+ * @brief Settings and pinned threads of the process, never destroyed so that threads exiting
+ * after static destruction can still leave
+ */
+struct Registry {
+    std::mutex mutex;
+    ThreadAffinity affinity = ThreadAffinity::Off;
+    std::map<int, int> deviceNodes; //<- set by setDeviceNumaNode()
+    std::map<int, int> sysfsNodes; //<- read from sysfs, by device
+    std::map<std::thread::id, ThreadPlacement> threads;
+    std::map<int, size_t> nextCpu; //<- by node, for ThreadAffinity::Core
+    size_t nextNode = 0; //<- for threads of no node
+    std::atomic<uint64_t> revision{1}; //<- of the settings
+};
+
+Registry& registry()
+{
+    static auto* instance = new Registry();
+    return *instance;
+}
+
+/**
+ * @brief Placement of the calling thread, left with it
+ */
+struct ThreadState {
+    uint64_t revision = 0; //<- of the settings it was placed with
+    int node = -1; //<- asked for
+    bool pinned = false;
+
+    ~ThreadState()
+    {
+        if (!pinned)
+            return;
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.erase(std::this_thread::get_id());
+    }
+};
+
+thread_local ThreadState tState;
+
+/// CPUs of a sysfs cpulist, e.g. "0-15,32-47"
+std::vector<int> parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        char* end = nullptr;
+        const long first = std::strtol(list.c_str() + pos, &end, 10);
+        if (end == list.c_str() + pos)
+            break;
+        long last = first;
+        if (*end == '-')
+            last = std::strtol(end + 1, &end, 10);
+        for (long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(int(cpu));
+        pos = size_t(end - list.c_str());
+        if (pos < list.size() && list[pos] == ',')
+            ++pos;
+        else
+            break;
+    }
+    return cpus;
+}
+
+std::vector<NumaNode> readNodes()
+{
+    std::vector<NumaNode> nodes;
+#ifdef __linux__
+    if (DIR* dir = opendir("/sys/devices/system/node")) {
+        while (const dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") || name.size() == 4 ||
+                name.find_first_not_of("0123456789", 4) != std::string::npos)
+                continue;
+            std::ifstream file("/sys/devices/system/node/" + name + "/cpulist");
+            std::string list;
+            std::getline(file, list);
+            NumaNode node;
+            node.id = std::atoi(name.c_str() + 4);
+            node.cpus = parseCpuList(list);
+            if (!node.cpus.empty())
+                nodes.push_back(std::move(node));
+        }
+        closedir(dir);
+    }
+#endif
+    if (nodes.empty()) {
+        NumaNode node;
+        for (int cpu = 0; cpu < int(std::max(std::thread::hardware_concurrency(), 1u)); ++cpu)
+            node.cpus.push_back(cpu);
+        nodes.push_back(std::move(node));
+    }
+    std::sort(nodes.begin(), nodes.end(),
+              [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+    return nodes;
+}
+
+#ifdef WITH_EGL
+/// node of a DRM device file, e.g. /dev/dri/card1, -1 if unknown
+int drmNumaNode(const std::string& deviceFile)
+{
+    const size_t slash = deviceFile.rfind('/');
+    if (deviceFile.empty() || slash == std::string::npos)
+        return -1;
+    std::ifstream file("/sys/class/drm/" + deviceFile.substr(slash + 1) + "/device/numa_node");
+    int node = -1;
+    if (!(file >> node))
+        return -1;
+    return node;
+}
+#endif
+
+#ifdef __linux__
+/// restrict the calling thread to \p cpus and prefer the memory of \p node, -1 for the default
+void applyPlacement(const std::vector<int>& cpus, int node)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    // the system call of libnuma, whose node mask counts one bit more than it holds
+    std::vector<unsigned long> mask(size_t(std::max(node, 0)) / 64 + 1, 0ul);
+    if (node >= 0) {
+        mask[size_t(node) / 64] = 1ul << (node % 64);
+        syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * 64 + 1);
+    }
+    else {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+    }
+}
+#endif
+
+} // namespace
+
+const std::vector<NumaNode>& numaNodes()
+{
+    static const std::vector<NumaNode> nodes = readNodes();
+    return nodes;
+}
+
+int deviceNumaNode(int device)
+{
+    auto& r = registry();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        const auto set = r.deviceNodes.find(device);
+        if (set != r.deviceNodes.end())
+            return set->second;
+        const auto read = r.sysfsNodes.find(device);
+        if (read != r.sysfsNodes.end())
+            return read->second;
+    }
+    int node = -1;
+#ifdef WITH_EGL
+    if (device >= 0)
+        node = drmNumaNode(EGLRenderer::deviceFile(device));
+#endif
+    // nodes the system does not list, e.g. of a single-node machine, are unknown
+    const auto& nodes = numaNodes();
+    if (std::none_of(nodes.begin(), nodes.end(),
+                     [node](const NumaNode& n) { return n.id == node; }))
+        node = -1;
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.sysfsNodes[device] = node;
+    return node;
+}
+
+std::vector<int> deviceNumaNodes()
+{
+    std::vector<int> nodes;
+    for (int device = 0; device < deviceCount(); ++device) {
+        const int node = deviceNumaNode(device);
+        if (node >= 0 && std::find(nodes.begin(), nodes.end(), node) == nodes.end())
+            nodes.push_back(node);
+    }
+    std::sort(nodes.begin(), nodes.end());
+    return nodes;
+}
+
+void setDeviceNumaNode(int device, int node)
+{
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (node < 0)
+        r.deviceNodes.erase(device);
+    else
+        r.deviceNodes[device] = node;
+    ++r.revision;
+}
+
+ThreadAffinity threadAffinity()
+{
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.affinity;
+}
+
+void setThreadAffinity(ThreadAffinity affinity)
+{
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.affinity = affinity;
+    ++r.revision;
+}
+
+void placeThread(const char* name, int node)
+{
+    auto& r = registry();
+    const uint64_t revision = r.revision;
+    if (tState.revision == revision && tState.node == node)
+        return;
+    tState.revision = revision;
+    tState.node = node;
+    const auto& nodes = numaNodes();
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.affinity == ThreadAffinity::Off) {
+        if (tState.pinned) {
+            std::vector<int> cpus;
+            for (const auto& n : nodes)
+                cpus.insert(cpus.end(), n.cpus.begin(), n.cpus.end());
+#ifdef __linux__
+            applyPlacement(cpus, -1);
+#endif
+            r.threads.erase(std::this_thread::get_id());
+            tState.pinned = false;
+        }
+        return;
+    }
+
+    auto it = std::find_if(nodes.begin(), nodes.end(),
+                           [node](const NumaNode& n) { return n.id == node; });
+    if (it == nodes.end())
+        it = nodes.begin() + r.nextNode++ % nodes.size();
+    ThreadPlacement placement;
+    placement.name = name;
+    placement.node = it->id;
+    placement.cpus = it->cpus;
+    if (r.affinity == ThreadAffinity::Core)
+        placement.cpus = {it->cpus[r.nextCpu[it->id]++ % it->cpus.size()]};
+#ifdef __linux__
+    // a single node has no remote memory to avoid
+    applyPlacement(placement.cpus, nodes.size() > 1 ? placement.node : -1);
+#endif
+    r.threads[std::this_thread::get_id()] = std::move(placement);
+    tState.pinned = true;
+}
+
+std::vector<ThreadPlacement> threadPlacements()
+{
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<ThreadPlacement> placements;
+    for (const auto& it : r.threads)
+        placements.push_back(it.second);
+    std::sort(placements.begin(), placements.end(),
+              [](const ThreadPlacement& a, const ThreadPlacement& b) {
+                  return std::tie(a.node, a.name) < std::tie(b.node, b.name);
+              });
+    return placements;
+}
+
+} // namespace render
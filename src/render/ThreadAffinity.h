@@ -0,0 +1,95 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief How the threads of the renderers are pinned, see placeThread()
+ */
+enum class ThreadAffinity {
+    Off, //<- threads float over all CPUs, the default
+    Node, //<- on the CPUs of a NUMA node, memory preferably allocated on it
+    Core, //<- each on a core of a NUMA node, round robin, memory preferably allocated on it
+};
+
+/**
+ * @brief CPUs of a NUMA node
+ */
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+/**
+ * @brief Placement of a thread pinned by placeThread()
+ */
+struct ThreadPlacement {
+    std::string name; //<- e.g. "render worker", as named for traces
+    int node = -1; //<- NUMA node
+    std::vector<int> cpus; //<- CPUs it may run on
+};
+
+/**
+ * @brief NUMA nodes of the system and their CPUs
+ *
+ * Read once from /sys/devices/system/node, a single node 0 of all CPUs where not reported,
+ * e.g. on single-socket machines or outside Linux.
+ */
+const std::vector<NumaNode>& numaNodes();
+
+/**
+ * @brief NUMA node of the PCIe root of a GPU, -1 if unknown
+ *
+ * Read from sysfs through the DRM device file of the EGL device when built with EGL, unless
+ * set by setDeviceNumaNode(), e.g. for machines whose firmware reports none.
+ *
+ * @param device - EGL device index
+ */
+int deviceNumaNode(int device);
+
+/**
+ * @brief Distinct known NUMA nodes of the GPUs renderers are placed on, see deviceCount()
+ */
+std::vector<int> deviceNumaNodes();
+
+/**
+ * @brief Place \p device on NUMA \p node, -1 to read it from sysfs again
+ */
+void setDeviceNumaNode(int device, int node);
+
+/**
+ * @brief How renderer threads are pinned, Off by default
+ *
+ * Threads follow a change at their next job or frame.
+ */
+ThreadAffinity threadAffinity();
+/** @overload */
+void setThreadAffinity(ThreadAffinity affinity);
+
+/**
+ * @brief Pin the calling thread as set by setThreadAffinity(), once per change of the settings
+ * or of \p node
+ *
+ * Threads of a node run on its CPUs, or each on one of them in turn with ThreadAffinity::Core,
+ * and their memory is preferably allocated on it: buffers first touched by the thread, e.g. the
+ * frame buffers of an async renderer or the assets decoded by a loader, are local to the node.
+ * Threads of no node are spread over the nodes in turn. Cheap when nothing changed, so that
+ * pool threads call it before each job; with ThreadAffinity::Off pinned threads float again.
+ *
+ * @param name - name of the thread in threadPlacements()
+ * @param node - NUMA node, e.g. that of the GPU the thread draws on, -1 for any
+ */
+void placeThread(const char* name, int node);
+
+/**
+ * @brief Threads pinned by placeThread(), while they run
+ */
+std::vector<ThreadPlacement> threadPlacements();
+
+} // namespace render
@@ -0,0 +1,573 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "TinyRendererBackend.h"
+#include "AssetLoader.h"
+#include "StageStats.h"
+#include "ThreadAffinity.h"
+
+#include <LinearMath/btThreads.h>
+#include <TinyRenderer/TinyRenderer.h>
+
+#include <algorithm>
+#include <mutex>
+
+namespace render {
+
+namespace {
+
+constexpr float kNoDepth = -1e30f; //<- depth buffer value of the background
+
+std::mutex gSchedulerMutex; //<- btParallelFor cannot be entered from two threads at once
+thread_local bool tCalling = false; //<- the thread calling btParallelFor, not a tile worker
+
+/**
+ * @brief Process-wide task scheduler, multithreaded if Bullet is built thread-safe
+ */
+btITaskScheduler* taskScheduler()
+{
+    static btITaskScheduler* scheduler = [] {
+        if (btITaskScheduler* ts = btCreateDefaultTaskScheduler())
+            btSetTaskScheduler(ts);
+        return btGetTaskScheduler();
+    }();
+    return scheduler;
+}
+
+template <class Function>
+class ParallelForBody : public btIParallelForBody
+{
+  public:
+    explicit ParallelForBody(const Function& function) : _function(function) {}
+
+    void forLoop(int iBegin, int iEnd) const override
+    {
+        if (!tCalling)
+            placeThread("tinyrenderer worker", -1);
+        for (int i = iBegin; i < iEnd; ++i)
+            _function(i);
+    }
+
+  private:
+    const Function& _function;
+};
+
+template <class Function>
+void parallelFor(int count, const Function& function)
+{
+    if (count > 0) {
+        tCalling = true;
+        btParallelFor(0, count, 1, ParallelForBody<Function>(function));
+        tCalling = false;
+    }
+}
+
+TinyRender::Matrix toMatrix(const Matrix4f& m)
+{
+    TinyRender::Matrix matrix;
+    for (int row = 0; row < 4; ++row)
+        for (int col = 0; col < 4; ++col)
+            matrix[row][col] = m[col * 4 + row];
+    return matrix;
+}
+
+/// RGB texels of a bitmap, top row first, the last channel repeated for gray ones
+std::vector<unsigned char> rgbTexels(const scene::Bitmap& bitmap)
+{
+    const int channels = int(bitmap.channels());
+    const size_t count = size_t(bitmap.cols()) * size_t(bitmap.rows());
+    std::vector<unsigned char> texels(count * 3);
+    const uint8_t* data = bitmap.data();
+    for (size_t p = 0; p < count; ++p)
+        for (int k = 0; k < 3; ++k)
+            texels[p * 3 + k] = data[p * channels + std::min(k, channels - 1)];
+    return texels;
+}
+
+/// what the shadow map of a frame depends on, the camera pose aside
+struct ShadowKey {
+    const scene::SceneState* state = nullptr; //<- null for no shadow map
+    uint64_t generation = 0; //<- of the poses of the state
+    float lightDirection[3] = {0.f, 0.f, 0.f};
+    float lightDistance = 0.f;
+    Matrix4f projMatrix = {};
+    int cols = 0;
+    int rows = 0;
+
+    bool operator==(const ShadowKey& other) const
+    {
+        return state == other.state && generation == other.generation &&
+               std::equal(lightDirection, lightDirection + 3, other.lightDirection) &&
+               lightDistance == other.lightDistance && projMatrix == other.projMatrix &&
+               cols == other.cols && rows == other.rows;
+    }
+};
+
+} // namespace
+
+struct TinyRendererBackend::Target {
+    TGAImage color; //<- bound to the objects, not drawn: they draw into rgba
+    TinyRenderRgbaImage rgba; //<- color plane of the frame, or scratch
+    b3AlignedObjectArray<float> depth; //<- depth plane of the frame, or scratch
+    b3AlignedObjectArray<int> mask; //<- mask plane of the frame, empty if not requested
+    std::vector<uint8_t> scratchColor; //<- colors of frames requesting masks without colors
+    std::vector<float> scratchDepth; //<- depth buffer of frames without the depth channel
+    b3AlignedObjectArray<float> shadow; //<- shadowMap if the frame is shadowed, else empty
+    std::vector<float> shadowMap; //<- depth from the light, kept for the next views of a step
+    ShadowKey shadowKey; //<- what shadowMap was rendered for
+
+    Target() : color(1, 1, TGAImage::RGB) {}
+
+    /**
+     * @brief Bind the planes of a frame, top row first, and clear them
+     *
+     * Null planes are replaced by scratch buffers kept across frames, except the mask which is
+     * not drawn. Depth is the window depth of TinyRenderer until converted by renderFrame().
+     */
+    void reset(int cols, int rows, uint8_t* colorPlane, float* depthPlane, int* maskPlane,
+               const Color3f& background, bool depthOnly)
+    {
+        const int pixels = cols * rows;
+        if (!depthPlane) {
+            scratchDepth.resize(size_t(pixels));
+            depthPlane = scratchDepth.data();
+        }
+        depth.initializeFromBuffer(depthPlane, pixels, pixels);
+        std::fill_n(depthPlane, pixels, kNoDepth);
+        mask.initializeFromBuffer(maskPlane, maskPlane ? pixels : 0, maskPlane ? pixels : 0);
+        if (depthOnly)
+            return;
+
+        if (!colorPlane) {
+            scratchColor.resize(size_t(pixels) * 4);
+            colorPlane = scratchColor.data();
+        }
+        rgba.m_pixels = colorPlane;
+        rgba.m_width = cols;
+        rgba.m_height = rows;
+        const uint8_t texel[4] = {static_cast<uint8_t>(background[0] * 255.f),
+                                  static_cast<uint8_t>(background[1] * 255.f),
+                                  static_cast<uint8_t>(background[2] * 255.f), 255};
+        for (int i = 0; i < pixels; ++i)
+            std::copy_n(texel, 4, colorPlane + size_t(i) * 4);
+        if (maskPlane)
+            std::fill_n(maskPlane, pixels, -1);
+    }
+};
+
+struct TinyRendererBackend::Object {
+    int shapeIndex = 0;
+    Matrix4f localMatrix; //<- shape pose in the node frame
+    scene::AABB bounds; //<- mesh bounds in the shape frame
+    std::unique_ptr<TinyRenderObjectData> data;
+    std::vector<std::unique_ptr<TinyRenderObjectData>> lods; //<- simplified models, coarser last
+    TinyRenderObjectData* drawn = nullptr; //<- model drawn in the current frame, null if culled
+    float viewDepth = 0.f; //<- of the bounds center in the current frame, when drawn front to back
+    std::shared_ptr<scene::Texture> texture; //<- baked into the models
+};
+
+TinyRendererBackend::TinyRendererBackend(int numThreads) : _target(new Target())
+{
+    // assets of new shapes start loading before the scene update needs them
+    setAssetPrefetch(true);
+
+    std::lock_guard<std::mutex> lock(gSchedulerMutex);
+    btITaskScheduler* scheduler = taskScheduler();
+    if (numThreads > 0)
+        scheduler->setNumThreads(std::min(numThreads, scheduler->getMaxNumThreads()));
+}
+
+TinyRendererBackend::~TinyRendererBackend() = default;
+
+void TinyRendererBackend::updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph, bool)
+{
+    _target->shadowKey = ShadowKey();
+    _objects.clear();
+    _bounds.clear();
+    _segmentationMode = sceneGraph->segmentationMode();
+    prefetchAssets(*sceneGraph); //<- loaded in parallel, consumed in order
+    for (const auto& it : sceneGraph->nodes())
+        updateNode(it.first, it.second);
+}
+
+void TinyRendererBackend::applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                                          const scene::SceneGraphDelta& delta)
+{
+    _target->shadowKey = ShadowKey();
+    if (delta.geometryOnly() || delta.texelsOnly()) {
+        BaseRenderer::applySceneDelta(sceneGraph, delta);
+        for (int nodeId : delta.geometryChanged())
+            _bounds.updateNode(nodeId, sceneGraph->nodes().at(nodeId));
+        return;
+    }
+
+    // models keep their own copy of the texels, converted again
+    for (int nodeId : delta.texelsChanged()) {
+        const auto& node = sceneGraph->nodes().at(nodeId);
+        bool updated = true;
+        for (int i = 0; i < int(node.shapes().size()); ++i) {
+            const auto& material = node.shapes()[i].material();
+            if (material && material->diffuseTexture())
+                updated = updateShapeTexels(nodeId, i, material->diffuseTexture()) && updated;
+        }
+        if (!updated)
+            updateNode(nodeId, node);
+    }
+
+    if (delta.materialsOnly()) {
+        // colors change in place, nodes with new textures are converted again
+        for (int nodeId : delta.changed()) {
+            const auto& node = sceneGraph->nodes().at(nodeId);
+            bool updated = true;
+            for (int i = 0; i < int(node.shapes().size()); ++i)
+                updated = updateShapeMaterial(nodeId, i, node.shapes()[i].material()) && updated;
+            if (!updated)
+                updateNode(nodeId, node);
+        }
+        return;
+    }
+
+    _segmentationMode = sceneGraph->segmentationMode();
+    for (int nodeId : delta.removed()) {
+        _objects.erase(nodeId);
+        _bounds.removeNode(nodeId);
+    }
+    for (const auto* ids : {&delta.added(), &delta.changed(), &delta.geometryChanged()}) {
+        for (int nodeId : *ids) {
+            const auto it = sceneGraph->nodes().find(nodeId);
+            if (it != sceneGraph->nodes().end())
+                updateNode(nodeId, it->second);
+        }
+    }
+}
+
+bool TinyRendererBackend::updateShapeGeometry(int nodeId, int shapeIndex,
+                                              const std::shared_ptr<scene::MeshData>& meshData)
+{
+    const auto it = _objects.find(nodeId);
+    if (it == _objects.end())
+        return false;
+
+    _target->shadowKey = ShadowKey();
+    for (auto& object : it->second) {
+        if (object->shapeIndex != shapeIndex)
+            continue;
+        TinyRender::Model* model = object->data->m_model;
+        const auto& vertices = meshData->vertices();
+        const auto& normals = meshData->normals();
+        const int count = int(vertices.size() / 3);
+        if (!model || model->nverts() != count || model->nnormals() != count ||
+            normals.size() != vertices.size())
+            return false;
+
+        TinyRender::Vec3f* modelVertices = model->readWriteVertices();
+        TinyRender::Vec3f* modelNormals = model->readWriteNormals();
+        for (int i = 0; i < count; ++i) {
+            modelVertices[i] = TinyRender::Vec3f(vertices[i * 3], vertices[i * 3 + 1],
+                                                 vertices[i * 3 + 2]);
+            modelNormals[i] = TinyRender::Vec3f(normals[i * 3], normals[i * 3 + 1],
+                                                normals[i * 3 + 2]);
+        }
+        object->data->invalidateTriangles();
+        object->bounds = meshData->bounds();
+        object->lods.clear(); // simplified from the previous geometry
+        return true;
+    }
+    return false;
+}
+
+bool TinyRendererBackend::updateShapeMaterial(int nodeId, int shapeIndex,
+                                              const std::shared_ptr<scene::Material>& material)
+{
+    const auto it = _objects.find(nodeId);
+    if (it == _objects.end())
+        return false;
+
+    const auto& texture = material ? material->diffuseTexture() : nullptr;
+    for (auto& object : it->second) {
+        if (object->shapeIndex != shapeIndex)
+            continue;
+        if (texture != object->texture &&
+            !(texture && object->texture && *texture == *object->texture))
+            return false;
+        const Color4f color = material ? material->diffuseColor() : Color4f{1.f, 1.f, 1.f, 1.f};
+        object->data->m_model->setColorRGBA(color.data());
+        for (auto& lod : object->lods)
+            lod->m_model->setColorRGBA(color.data());
+        return true;
+    }
+    return true; //<- shape not drawn
+}
+
+bool TinyRendererBackend::updateShapeTexels(int nodeId, int shapeIndex,
+                                           const std::shared_ptr<scene::Texture>& texture)
+{
+    const auto it = _objects.find(nodeId);
+    if (it == _objects.end())
+        return false;
+
+    for (auto& object : it->second) {
+        if (object->shapeIndex != shapeIndex)
+            continue;
+        const auto bitmap = object->texture == texture ? loadBitmap(*texture) : nullptr;
+        if (!bitmap || bitmap->channels() < 1)
+            return false;
+        auto texels = rgbTexels(*bitmap);
+        const int cols = int(bitmap->cols()), rows = int(bitmap->rows());
+        object->data->m_model->setDiffuseTextureFromData(texels.data(), cols, rows);
+        for (auto& lod : object->lods)
+            lod->m_model->setDiffuseTextureFromData(texels.data(), cols, rows);
+        return true;
+    }
+    return true; //<- shape not drawn
+}
+
+void TinyRendererBackend::updateNode(int nodeId, const scene::Node& node)
+{
+    auto& objects = _objects[nodeId];
+    objects.clear();
+
+    Target& target = *_target;
+    const auto& shapes = node.shapes();
+    for (int i = 0; i < int(shapes.size()); ++i) {
+        const auto& shape = shapes[i];
+        const auto mesh = loadMeshData(shape);
+        if (!mesh || mesh->indices().empty())
+            continue;
+
+        Color4f color{1.f, 1.f, 1.f, 1.f};
+        std::vector<unsigned char> texels; //<- RGB, top row first
+        int cols = 0, rows = 0;
+        if (const auto& material = shape.material()) {
+            color = material->diffuseColor();
+            const auto& texture = material->diffuseTexture();
+            const auto bitmap = texture ? loadBitmap(*texture) : nullptr;
+            const int channels = bitmap ? int(bitmap->channels()) : 0;
+            if (channels > 0) {
+                cols = int(bitmap->cols());
+                rows = int(bitmap->rows());
+                texels = rgbTexels(*bitmap);
+            }
+        }
+
+        // drawn as body + ((link + 1) << 24), i.e. as is with a link of -1
+        const int segmentation = node.segmentation(i, _segmentationMode);
+        // each level of detail is a model of its own, with its own copy of the texture
+        const auto makeData = [&](const scene::MeshData& levelMesh) {
+            // TinyRenderer takes interleaved position (x, y, z, w), normal and uv vertices
+            std::vector<float> decoded[3]; //<- quantized attributes, not kept by the mesh
+            if (const auto& quantized = levelMesh.quantized())
+                quantized->decode(decoded[0], decoded[1], decoded[2]);
+            const bool isQuantized = bool(levelMesh.quantized());
+            const auto& positions = isQuantized ? decoded[0] : levelMesh.vertices();
+            const auto& normals = isQuantized ? decoded[1] : levelMesh.normals();
+            const auto& uvs = isQuantized ? decoded[2] : levelMesh.uvs();
+            const int count = int(positions.size() / 3);
+            const bool hasUvs = int(uvs.size()) == count * 2;
+            std::vector<float> vertices(size_t(count) * 9, 0.f);
+            for (int j = 0; j < count; ++j) {
+                float* vertex = &vertices[j * 9];
+                std::copy_n(&positions[j * 3], 3, vertex);
+                vertex[3] = 1.f;
+                std::copy_n(&normals[j * 3], 3, vertex + 4);
+                if (hasUvs)
+                    std::copy_n(&uvs[j * 2], 2, vertex + 7);
+            }
+
+            std::unique_ptr<TinyRenderObjectData> data(new TinyRenderObjectData(
+                target.color, target.depth, &target.shadow, &target.mask, segmentation, -1));
+            data->m_rgbaBuffer = &target.rgba;
+            data->m_topRowFirst = true;
+            data->registerMeshShape(vertices.data(), count, levelMesh.indices().data(),
+                                    int(levelMesh.indices().size()), color.data(),
+                                    texels.empty() ? nullptr : texels.data(), cols, rows);
+            data->m_doubleSided = shape.type() == scene::ShapeType::Plane;
+            return data;
+        };
+
+        std::unique_ptr<Object> object(new Object());
+        object->shapeIndex = i;
+        object->localMatrix = shape.pose().matrix();
+        object->bounds = mesh->bounds();
+        object->texture = cols > 0 ? shape.material()->diffuseTexture() : nullptr;
+        object->data = makeData(*mesh);
+        for (const auto& lod : loadMeshLods(shape))
+            object->lods.push_back(makeData(*lod));
+        objects.push_back(std::move(object));
+    }
+    // after loading meshes, so that mesh files have bounds
+    _bounds.updateNode(nodeId, node);
+}
+
+bool TinyRendererBackend::renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                                      const std::shared_ptr<scene::SceneView>& sceneView,
+                                      FrameData& outputFrame)
+{
+    const int cols = outputFrame.cols, rows = outputFrame.rows;
+    if (!sceneView->camera() || cols <= 0 || rows <= 0)
+        return false;
+    if (sceneView->projection() != scene::Projection::Perspective)
+        return _panorama.render(*this, sceneState, *sceneView, outputFrame);
+    if (sceneView->hasMultiview())
+        return _multiview.render(*this, sceneState, *sceneView, outputFrame);
+    if (sceneView->hasLensDistortion())
+        return _distorted.render(*this, sceneState, *sceneView, outputFrame);
+    if (sceneView->hasRenderScale())
+        return _scaled.render(*this, sceneState, *sceneView, outputFrame);
+    // a region of interest is drawn alone by a camera of its projection
+    const scene::Camera camera = sceneView->imageCamera();
+
+    // planes of channels not requested are not drawn, depth only frames are not shaded
+    uint8_t* const colorPlane =
+        sceneView->hasOutputChannel(scene::OutputChannel::Color) ? outputFrame.color : nullptr;
+    float* const depthPlane =
+        sceneView->hasOutputChannel(scene::OutputChannel::Depth) ? outputFrame.depth : nullptr;
+    int* const maskPlane =
+        sceneView->hasOutputChannel(scene::OutputChannel::Mask) ? outputFrame.mask : nullptr;
+    const bool depthOnly = !colorPlane && !maskPlane;
+
+    std::lock_guard<std::mutex> lock(gSchedulerMutex);
+    StageTimer render(Stage::Render);
+
+    // default light close to the one of the python renderers
+    btVector3 lightDirection(-0.8, -0.2, 2.0), lightColor(1.0, 1.0, 1.0);
+    float lightDistance = 10.f, ambient = 0.6f, diffuse = 0.35f, specular = 0.05f;
+    if (const auto& light = sceneView->light()) {
+        const auto& direction = light->direction();
+        const auto& color = light->color();
+        lightDirection.setValue(-direction[0], -direction[1], -direction[2]);
+        lightColor.setValue(color[0], color[1], color[2]);
+        if (light->distance() > 0.f)
+            lightDistance = light->distance();
+        ambient = light->ambientCoeff();
+        diffuse = light->diffuseCoeff();
+        specular = light->specularCoeff();
+    }
+    // the only feature of quality tiers the software rasterizer has
+    if (!sceneView->quality().specular)
+        specular = 0.f;
+    if (lightDirection.length2() > 0)
+        lightDirection.normalize();
+
+    // shadow map of a shadow casting light, shared by the views of a step: it depends on the
+    // light, the projection and the poses, not on the camera pose
+    Target& target = *_target;
+    const auto& light = sceneView->light();
+    if (depthOnly || !light || !light->isShadowCaster() || !sceneView->quality().shadows) {
+        target.shadow.initializeFromBuffer(nullptr, 0, 0);
+    } else {
+        ShadowKey key;
+        key.state = sceneState.get();
+        key.generation = sceneState->generation();
+        for (int k = 0; k < 3; ++k)
+            key.lightDirection[k] = float(lightDirection[k]);
+        key.lightDistance = lightDistance;
+        key.projMatrix = camera.projMatrix();
+        key.cols = cols;
+        key.rows = rows;
+        const int pixels = cols * rows;
+        target.shadowMap.resize(size_t(pixels));
+        target.shadow.initializeFromBuffer(target.shadowMap.data(), pixels, pixels);
+        if (!(key == target.shadowKey)) {
+            // every shape casts shadows, those out of the view frustum included
+            std::fill_n(target.shadowMap.data(), pixels, kNoDepth);
+            const TinyRender::Matrix proj = toMatrix(camera.projMatrix());
+            for (const auto& it : _objects) {
+                if (!sceneState->hasNode(it.first))
+                    continue;
+                const Matrix4f& nodeMatrix = sceneState->matrix(it.first);
+                for (const auto& object : it.second) {
+                    TinyRenderObjectData& data = *object->data;
+                    data.m_modelMatrix = toMatrix(multiply(nodeMatrix, object->localMatrix));
+                    data.m_projectionMatrix = proj;
+                    data.m_lightDirWorld = lightDirection;
+                    data.m_lightDistance = lightDistance;
+                    TinyRenderer::renderObjectDepth(data);
+                }
+            }
+            target.shadowKey = key;
+        }
+    }
+
+    // per object setup, for shapes of the nodes in the view frustum
+    {
+        StageTimer timer(Stage::StateSync);
+        _bvh.update(_bounds, *sceneState);
+    }
+    // shapes of layers the camera does not see are culled with the others
+    const bool layered = sceneView->filtersLayers();
+    std::vector<std::pair<Object*, const Matrix4f*>> objects;
+    for (int nodeId : _bvh.query(camera)) {
+        const auto it = _objects.find(nodeId);
+        if (it == _objects.end())
+            continue;
+        for (const auto& object : it->second)
+            if (!layered || sceneView->visible(nodeId, object->shapeIndex))
+                objects.emplace_back(object.get(), &sceneState->matrix(nodeId));
+    }
+
+    const auto& projMatrix = camera.projMatrix();
+    const Matrix4f viewProj = multiply(projMatrix, camera.viewMatrix());
+    const TinyRender::Matrix view = toMatrix(camera.viewMatrix());
+    const TinyRender::Matrix proj = toMatrix(projMatrix);
+    parallelFor(int(objects.size()), [&](int i) {
+        Object& object = *objects[i].first;
+        const Matrix4f model = multiply(*objects[i].second, object.localMatrix);
+        object.drawn = nullptr;
+        if (!scene::Frustum(multiply(viewProj, model)).intersects(object.bounds))
+            return;
+
+        const int level = _lodPolicy.select(object.bounds.transformed(model), camera, rows,
+                                            int(object.lods.size()) + 1);
+        TinyRenderObjectData& data = level > 0 ? *object.lods[level - 1] : *object.data;
+        data.m_modelMatrix = toMatrix(model);
+        data.m_viewMatrix = view;
+        data.m_projectionMatrix = proj;
+        data.m_lightDirWorld = lightDirection;
+        data.m_lightColor = lightColor;
+        data.m_lightDistance = lightDistance;
+        data.m_lightAmbientCoeff = ambient;
+        data.m_lightDiffuseCoeff = diffuse;
+        data.m_lightSpecularCoeff = specular;
+        object.drawn = &data;
+        if (_frontToBack) {
+            const Vector3f center =
+                object.bounds.infinite()
+                    ? Vector3f{0.f, 0.f, 0.f}
+                    : Vector3f{(object.bounds.lower[0] + object.bounds.upper[0]) * 0.5f,
+                               (object.bounds.lower[1] + object.bounds.upper[1]) * 0.5f,
+                               (object.bounds.lower[2] + object.bounds.upper[2]) * 0.5f};
+            object.viewDepth = -transformPoint(multiply(camera.viewMatrix(), model), center)[2];
+        }
+    });
+    if (_frontToBack)
+        std::stable_sort(objects.begin(), objects.end(), [](const auto& a, const auto& b) {
+            return a.first->viewDepth < b.first->viewDepth;
+        });
+
+    // binned rasterization of visible objects, in node order or front to back, into the planes
+    // of the frame
+    target.reset(cols, rows, colorPlane, depthPlane, maskPlane, sceneView->backgroundColor(),
+                 depthOnly);
+    std::vector<TinyRenderObjectData*> visible;
+    for (const auto& it : objects)
+        if (it.first->drawn)
+            visible.push_back(it.first->drawn);
+    if (!visible.empty() && depthOnly)
+        TinyRenderer::renderObjectsDepthOnly(visible.data(), int(visible.size()));
+    else if (!visible.empty())
+        TinyRenderer::renderObjects(visible.data(), int(visible.size()));
+
+    // metric depth in place, zero for the background
+    if (depthPlane) {
+        parallelFor(rows, [&](int y) {
+            float* row = depthPlane + size_t(y) * cols;
+            for (int x = 0; x < cols; ++x)
+                row[x] = row[x] > kNoDepth ? (row[x] + projMatrix[14]) / projMatrix[10] : 0.f;
+        });
+    }
+    return true;
+}
+
+} // namespace render
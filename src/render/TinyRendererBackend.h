@@ -0,0 +1,125 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+#include "DistortedFrame.h"
+#include "MultiviewFrame.h"
+#include "PanoramaFaces.h"
+#include "ScaledFrame.h"
+
+#include <scene/BVH.h>
+#include <scene/MeshLod.h>
+#include <scene/SceneBounds.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief CPU renderer rasterizing the scene with the TinyRenderer shipped with Bullet
+ *
+ * Each shape is converted once to a TinyRenderObjectData kept across frames, only its matrices
+ * are updated per frame. Triangles of the objects in view are binned into screen tiles, tiles
+ * being rasterized in parallel with the Bullet task scheduler. Nodes and shapes out of the view
+ * frustum are skipped, meshes with simplified levels of detail are drawn at the level matching
+ * their screen size.
+ *
+ * Renders color, metric depth and segmentation mask images, rasterized directly into the planes
+ * of the frame, top row first, skipping pixel blocks of triangles behind those drawn before them,
+ * see frontToBack(). Shadow casting lights cast the shadows of every shape, their shadow map
+ * being rendered once for the views of a step sharing the light, projection and poses. Frames
+ * requesting the depth channel only are rasterized from vertex positions, without shading.
+ * Panoramic views are rendered face by face, see PanoramaFaces, views of a render scale at
+ * their internal resolution, see ScaledFrame, views with lens distortion as pinhole images,
+ * see DistortedFrame, and multiview views one after the other, see MultiviewFrame.
+ */
+class TinyRendererBackend : public BaseRenderer
+{
+  public:
+    /**
+     * @brief Construct a new TinyRenderer backend
+     *
+     * @param numThreads - number of threads of the process-wide Bullet task scheduler, 0 keeps
+     * its current setting
+     */
+    explicit TinyRendererBackend(int numThreads = 0);
+
+    /**
+     * @brief Destroy the TinyRenderer backend
+     */
+    ~TinyRendererBackend() override;
+
+    /**
+     * @brief Update a scene using \p sceneGraph description
+     */
+    void updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                     bool materialsOnly) override;
+
+    /**
+     * @brief Rebuild only added and changed nodes
+     */
+    void applySceneDelta(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                         const scene::SceneGraphDelta& delta) override;
+
+    /**
+     * @brief Rewrite vertices and normals of a cached shape model in place
+     */
+    bool updateShapeGeometry(int nodeId, int shapeIndex,
+                             const std::shared_ptr<scene::MeshData>& meshData) override;
+
+    /**
+     * @brief Change the color of the models of a shape in place, false for a new texture
+     */
+    bool updateShapeMaterial(int nodeId, int shapeIndex,
+                             const std::shared_ptr<scene::Material>& material) override;
+
+    /**
+     * @brief Convert the new texels of a shape texture into its models
+     */
+    bool updateShapeTexels(int nodeId, int shapeIndex,
+                           const std::shared_ptr<scene::Texture>& texture) override;
+
+    /**
+     * @brief Render a scene at state \p sceneState with a view settings \p sceneView
+     *
+     * @return False if the view has no camera
+     */
+    bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                     const std::shared_ptr<scene::SceneView>& sceneView,
+                     FrameData& outputFrame) override;
+
+    /**
+     * @brief Draw objects in view from the nearest to the farthest, by the center of their bounds
+     *
+     * Lets the rasterizer reject more hidden pixel blocks early, at the cost of a sort per frame.
+     * Surfaces at the same depth may then be drawn in another order than that of the nodes.
+     */
+    bool frontToBack() const { return _frontToBack; }
+    /** @overload */
+    void setFrontToBack(bool enabled) { _frontToBack = enabled; }
+
+  private:
+    struct Target; //<- color, depth and mask buffers of the frame
+    struct Object; //<- shape converted to TinyRenderer
+
+    void updateNode(int nodeId, const scene::Node& node);
+
+    std::unique_ptr<Target> _target; //<- the binding target of objects
+    std::map<int, std::vector<std::unique_ptr<Object>>> _objects; //<- node id -> shapes
+    scene::SceneBounds _bounds; //<- node bounds, for frustum culling
+    scene::BVH _bvh; //<- world bounds of nodes, refitted each frame
+    scene::LodPolicy _lodPolicy; //<- mesh level of detail from its screen size
+    PanoramaFaces _panorama; //<- faces of panoramic views
+    ScaledFrame _scaled; //<- views of a render scale
+    DistortedFrame _distorted; //<- views with lens distortion
+    MultiviewFrame _multiview; //<- views of several cameras
+    bool _frontToBack = false;
+    scene::SegmentationMode _segmentationMode = scene::SegmentationMode::BodyLink;
+};
+
+} // namespace render
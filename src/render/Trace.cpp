@@ -0,0 +1,381 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace render {
+
+namespace {
+
+struct Event {
+    const char* name;
+    uint64_t start; //<- nanoseconds
+    uint64_t end; //<- nanoseconds, complete events only
+    const char* argName; //<- null if none
+    int arg;
+    char phase; //<- 'B', 'E' or 'X' as in the trace event format
+};
+
+constexpr size_t kChunkEvents = 4096;
+constexpr size_t kMaxChunks = 256; //<- about a million events per thread and recording
+constexpr size_t kRingChunks = 16; //<- last 65536 events per thread of a capture
+constexpr size_t kMinMedianFrames = 8; //<- frames before the median makes outliers
+
+/**
+ * @brief Events of a thread in a recording, appended by that thread only
+ *
+ * Chunks are never moved, so that writers read the events below the published size while
+ * the thread appends more. Ring buffers of a capture overwrite their oldest chunk instead of
+ * dropping events, writers keep the events they copied only if not overwritten meanwhile.
+ */
+struct ThreadBuffer {
+    explicit ThreadBuffer(int tid, const char* name, size_t ringChunks)
+        : tid(tid), name(name), ringChunks(ringChunks)
+    {
+    }
+
+    ~ThreadBuffer()
+    {
+        for (auto& chunk : chunks)
+            delete[] chunk.load();
+    }
+
+    void append(const Event& event)
+    {
+        const size_t index = size.load(std::memory_order_relaxed);
+        size_t chunk = index / kChunkEvents;
+        if (ringChunks)
+            chunk %= ringChunks;
+        else if (chunk >= kMaxChunks) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Event* events = chunks[chunk].load(std::memory_order_relaxed);
+        if (!events) {
+            events = new Event[kChunkEvents];
+            chunks[chunk].store(events, std::memory_order_release);
+        }
+        events[index % kChunkEvents] = event;
+        size.store(index + 1, std::memory_order_release);
+    }
+
+    /// \p visit(event) for each event still in the buffer, in order
+    template <typename Visit>
+    void read(Visit&& visit) const
+    {
+        const size_t end = size.load(std::memory_order_acquire);
+        const size_t capacity = ringChunks * kChunkEvents;
+        const size_t first = capacity && end > capacity ? end - capacity : 0;
+        for (size_t i = first; i < end; ++i) {
+            const size_t chunk = i / kChunkEvents;
+            const auto* events =
+                chunks[ringChunks ? chunk % ringChunks : chunk].load(std::memory_order_acquire);
+            const Event event = events[i % kChunkEvents];
+            if (capacity) {
+                // the event at i + capacity overwrites it, appended once the size reaches it
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (size.load(std::memory_order_relaxed) >= i + capacity)
+                    continue;
+            }
+            visit(event);
+        }
+    }
+
+    const int tid;
+    std::atomic<const char*> name;
+    const size_t ringChunks; //<- 0 unless capturing
+    std::atomic<size_t> size{0};
+    std::atomic<uint64_t> dropped{0};
+    std::array<std::atomic<Event*>, kMaxChunks> chunks{};
+};
+
+/**
+ * @brief Buffers of the current recording
+ */
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::string path;
+    uint64_t origin = 0; //<- start time of the recording
+    int threads = 0; //<- thread ids handed out
+
+    // capture of the outliers, see Trace::startCapture()
+    bool capturing = false;
+    std::string directory;
+    size_t frames = 0;
+    double thresholdMs = 0.;
+    double medianFactor = 0.;
+    std::deque<uint64_t> frameStarts; //<- of the last frames, oldest first
+    std::deque<double> frameMs;
+    int captured = 0;
+};
+
+Registry& registry()
+{
+    static auto* registry = new Registry(); //<- never destroyed, threads may outlive statics
+    return *registry;
+}
+
+std::atomic<uint64_t> gRecording{0}; //<- recording number, buffers of older ones are stale
+
+/**
+ * @brief Buffer of the calling thread
+ */
+struct ThreadState {
+    std::shared_ptr<ThreadBuffer> buffer;
+    uint64_t recording = ~uint64_t(0); //<- no buffer yet
+    int tid = 0;
+    const char* name = nullptr;
+};
+
+thread_local ThreadState tState;
+
+ThreadBuffer& threadBuffer()
+{
+    if (tState.recording != gRecording.load(std::memory_order_acquire)) {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if (!tState.tid)
+            tState.tid = ++reg.threads;
+        // released by this thread once it records into a later recording
+        tState.buffer = std::make_shared<ThreadBuffer>(tState.tid, tState.name,
+                                                       reg.capturing ? kRingChunks : 0);
+        tState.recording = gRecording.load(std::memory_order_relaxed);
+        reg.buffers.push_back(tState.buffer);
+    }
+    return *tState.buffer;
+}
+
+int processId()
+{
+#ifdef _WIN32
+    return _getpid();
+#else
+    return getpid();
+#endif
+}
+
+/**
+ * @brief Write the events of \p buffers starting from \p since in the trace event format
+ *
+ * @param otherData - JSON members of the metadata of the trace, none if empty
+ */
+bool writeEvents(const std::string& path,
+                 const std::vector<std::shared_ptr<ThreadBuffer>>& buffers, uint64_t origin,
+                 uint64_t since, const std::string& otherData)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    const int pid = processId();
+    const auto us = [origin](uint64_t ns) { return double(ns - std::min(ns, origin)) * 1e-3; };
+    file << "{\"displayTimeUnit\": \"ms\", ";
+    if (!otherData.empty())
+        file << "\"otherData\": {" << otherData << "}, ";
+    file << "\"traceEvents\": [";
+    bool first = true;
+    const auto separator = [&] {
+        file << (first ? "\n" : ",\n");
+        first = false;
+    };
+    for (const auto& buffer : buffers) {
+        const auto* name = buffer->name.load();
+        if (name) {
+            separator();
+            file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid
+                 << ", \"tid\": " << buffer->tid << ", \"args\": {\"name\": \"" << name << "\"}}";
+        }
+        buffer->read([&](const Event& event) {
+            if (event.start < since)
+                return;
+            separator();
+            file << "{\"name\": \"" << event.name << "\", \"ph\": \"" << event.phase
+                 << "\", \"ts\": " << us(event.start) << ", \"pid\": " << pid
+                 << ", \"tid\": " << buffer->tid;
+            if (event.phase == 'X')
+                file << ", \"dur\": " << double(event.end - event.start) * 1e-3;
+            if (event.argName)
+                file << ", \"args\": {\"" << event.argName << "\": " << event.arg << "}";
+            file << "}";
+        });
+    }
+    file << "\n]}\n";
+    return bool(file.flush());
+}
+
+/// median of durations, reordering a copy
+double median(std::vector<double> values)
+{
+    auto middle = values.begin() + values.size() / 2;
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+} // namespace
+
+std::atomic<bool> Trace::sEnabled{false};
+
+void Trace::start(const std::string& path)
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.buffers.clear();
+    reg.path = path;
+    reg.origin = now();
+    reg.capturing = false;
+    gRecording.fetch_add(1, std::memory_order_release);
+    sEnabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::startCapture(const std::string& directory, int frames, double thresholdMs,
+                         double medianFactor)
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.buffers.clear();
+    reg.path.clear();
+    reg.origin = now();
+    reg.capturing = true;
+    reg.directory = directory;
+    reg.frames = size_t(std::max(frames, 1));
+    reg.thresholdMs = thresholdMs;
+    reg.medianFactor = medianFactor;
+    reg.frameStarts.clear();
+    reg.frameMs.clear();
+    reg.captured = 0;
+    gRecording.fetch_add(1, std::memory_order_release);
+    sEnabled.store(true, std::memory_order_relaxed);
+}
+
+int Trace::capturedFrames()
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return reg.captured;
+}
+
+void Trace::endFrame(uint64_t start, uint64_t end, int client)
+{
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::string path, otherData;
+    uint64_t origin, since;
+    {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if (!reg.capturing || !sEnabled.load(std::memory_order_relaxed))
+            return;
+        const double ms = double(end - start) * 1e-6;
+        // the median of the previous frames, before the outlier skews it
+        const double typical = reg.frameMs.size() >= kMinMedianFrames
+                                   ? median({reg.frameMs.begin(), reg.frameMs.end()})
+                                   : 0.;
+        reg.frameStarts.push_back(start);
+        reg.frameMs.push_back(ms);
+        while (reg.frameStarts.size() > reg.frames) {
+            reg.frameStarts.pop_front();
+            reg.frameMs.pop_front();
+        }
+        const bool outlier = (reg.thresholdMs > 0. && ms > reg.thresholdMs) ||
+                             (reg.medianFactor > 0. && typical > 0. &&
+                              ms > reg.medianFactor * typical);
+        if (!outlier)
+            return;
+        path = reg.directory + "/outlier_" + std::to_string(reg.captured++) + ".json";
+        otherData = "\"frame_ms\": " + std::to_string(ms) +
+                    ", \"median_ms\": " + std::to_string(typical) +
+                    ", \"client\": " + std::to_string(client);
+        buffers = reg.buffers;
+        origin = reg.origin;
+        since = reg.frameStarts.front();
+    }
+    writeEvents(path, buffers, origin, since, otherData);
+}
+
+bool Trace::stop()
+{
+    if (!sEnabled.exchange(false))
+        return true;
+    std::string path;
+    {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        path = reg.path;
+    }
+    return path.empty() || write(path);
+}
+
+bool Trace::write(const std::string& path)
+{
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::string output = path;
+    uint64_t origin;
+    {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffers = reg.buffers;
+        origin = reg.origin;
+        if (output.empty())
+            output = reg.path;
+    }
+    if (output.empty())
+        return false;
+    return writeEvents(output, buffers, origin, 0, {});
+}
+
+uint64_t Trace::droppedEvents()
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    uint64_t dropped = 0;
+    for (const auto& buffer : reg.buffers)
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    return dropped;
+}
+
+void Trace::setThreadName(const char* name)
+{
+    tState.name = name;
+    if (tState.buffer)
+        tState.buffer->name.store(name);
+}
+
+uint64_t Trace::now()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch())
+                        .count());
+}
+
+void Trace::begin(const char* name, int client)
+{
+    threadBuffer().append(Event{name, now(), 0, client >= 0 ? "client" : nullptr, client, 'B'});
+}
+
+void Trace::end(const char* name)
+{
+    threadBuffer().append(Event{name, now(), 0, nullptr, 0, 'E'});
+}
+
+void Trace::complete(const char* name, uint64_t start, uint64_t end, const char* argName,
+                     int arg)
+{
+    threadBuffer().append(Event{name, start, end, argName, arg, 'X'});
+}
+
+} // namespace render
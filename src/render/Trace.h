@@ -0,0 +1,195 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace render {
+
+/**
+ * @brief Process-wide timeline of the rendering work of all clients and threads
+ *
+ * While recording, spans of the plugin and renderers are appended to a buffer of their thread,
+ * without locks: a thread only takes a lock the first time it records into a new recording. A
+ * recording is written in the Chrome trace event format, that chrome://tracing and the
+ * Perfetto UI open, one track per thread. Span names must be string literals.
+ *
+ * A capture records into rings of the last events of each thread instead, and writes the last
+ * frames into a file of their own each time a frame, see TraceFrame, takes longer than a
+ * threshold or than a multiple of the median of the last frames. Rare slow frames are then
+ * caught with their stages, scene updates and asset loads at the cost of always-on recording,
+ * without keeping or writing the others.
+ */
+class Trace
+{
+  public:
+    /**
+     * @brief Start a new recording, dropping the events of the previous one
+     *
+     * @param path - file the recording is written to by stop() and by unloaded plugins,
+     *               may be empty
+     */
+    static void start(const std::string& path);
+
+    /**
+     * @brief Stop recording and write the recording to the path given to start(), if any
+     *
+     * @return bool - false if the file could not be written
+     */
+    static bool stop();
+
+    /**
+     * @brief Start capturing the frames slower than a threshold, see Trace, dropping the events
+     * of the previous recording
+     *
+     * Captures are written to outlier_<n>.json in \p directory, each holding the events of the
+     * last \p frames frames, stop() ends the capture.
+     *
+     * @param directory - directory of the captures, must exist
+     * @param frames - frames written with an outlier, itself included, and of the median
+     * @param thresholdMs - duration of the outliers, ignored if 0
+     * @param medianFactor - multiple of the median of the last frames making an outlier,
+     *                       ignored if 0
+     */
+    static void startCapture(const std::string& directory, int frames, double thresholdMs,
+                             double medianFactor);
+
+    /**
+     * @brief Outliers written since the capture started
+     */
+    static int capturedFrames();
+
+    /**
+     * @brief End a frame of the capture, written with the previous ones if an outlier
+     *
+     * Called by TraceFrame, nothing is done unless capturing.
+     *
+     * @param start - start time of the frame, see now()
+     * @param end - end time
+     * @param client - physics client id shown with the capture
+     */
+    static void endFrame(uint64_t start, uint64_t end, int client);
+
+    /**
+     * @brief Write the events recorded so far, recording goes on
+     *
+     * @param path - output file, the path given to start() if empty
+     * @return bool - false if the file could not be written or no path is known
+     */
+    static bool write(const std::string& path);
+
+    /**
+     * @brief Recording in progress
+     */
+    static bool enabled() { return sEnabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Events dropped by threads whose buffer of this recording was full
+     */
+    static uint64_t droppedEvents();
+
+    /**
+     * @brief Name the track of the calling thread, e.g. "physics" or "async render"
+     */
+    static void setThreadName(const char* name);
+
+    /**
+     * @brief Monotonic time in nanoseconds, the time base of the events
+     */
+    static uint64_t now();
+
+    /**
+     * @brief Open a span on the calling thread
+     *
+     * @param name - span name, a string literal
+     * @param client - physics client id shown with the span, -1 if unknown
+     */
+    static void begin(const char* name, int client = -1);
+
+    /**
+     * @brief Close the last span opened on the calling thread
+     */
+    static void end(const char* name);
+
+    /**
+     * @brief Record a span which already ended, e.g. a burst of calls
+     *
+     * @param name - span name, a string literal
+     * @param start - start time, see now()
+     * @param end - end time
+     * @param argName - name of a value shown with the span, a string literal, null for none
+     * @param arg - value, e.g. the client or the number of calls of a burst
+     */
+    static void complete(const char* name, uint64_t start, uint64_t end,
+                         const char* argName = nullptr, int arg = 0);
+
+  private:
+    static std::atomic<bool> sEnabled;
+};
+
+/**
+ * @brief Span of the calling thread until the end of the scope, if recording
+ */
+class TraceScope
+{
+  public:
+    explicit TraceScope(const char* name, int client = -1)
+        : _name(Trace::enabled() ? name : nullptr)
+    {
+        if (_name)
+            Trace::begin(_name, client);
+    }
+
+    ~TraceScope()
+    {
+        if (_name)
+            Trace::end(_name);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+    const char* _name; //<- null if not recording
+};
+
+/**
+ * @brief Span of a frame until the end of the scope, checked against the outliers of a capture
+ *
+ * Spans not \p counted, e.g. the copies of the later chunks of an image, are only recorded.
+ */
+class TraceFrame
+{
+  public:
+    explicit TraceFrame(const char* name, int client = -1, bool counted = true)
+        : _name(Trace::enabled() ? name : nullptr), _client(client)
+    {
+        // no later than the span, that a capture starting with the frame includes
+        _start = _name && counted ? Trace::now() : 0;
+        if (_name)
+            Trace::begin(_name, client);
+    }
+
+    ~TraceFrame()
+    {
+        if (!_name)
+            return;
+        Trace::end(_name);
+        if (_start)
+            Trace::endFrame(_start, Trace::now(), _client);
+    }
+
+    TraceFrame(const TraceFrame&) = delete;
+    TraceFrame& operator=(const TraceFrame&) = delete;
+
+  private:
+    const char* _name; //<- null if not recording
+    int _client;
+    uint64_t _start; //<- 0 if not counted
+};
+
+} // namespace render
@@ -0,0 +1,1413 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "VulkanRenderer.h"
+#include "AssetLoader.h"
+#include "StageStats.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// SPIR-V of shaders/vulkan.vert and shaders/vulkan.frag, compiled by the build
+#include "vulkan.frag.h"
+#include "vulkan.vert.h"
+
+namespace render {
+
+namespace {
+
+const VkFormat kColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+const VkFormat kDepthFormat = VK_FORMAT_R32_SFLOAT; //<- metric depth
+const VkFormat kMaskFormat = VK_FORMAT_R32_SINT;
+const VkFormat kDepthBufferFormat = VK_FORMAT_D32_SFLOAT;
+const uint32_t kVertexFloats = 8; //<- position, normal, uv
+const uint32_t kDescriptorPoolSets = 256; //<- sets of each descriptor pool
+
+void check(VkResult result, const char* call)
+{
+    if (result != VK_SUCCESS)
+        throw std::runtime_error(std::string("VulkanRenderer: ") + call + " failed, error " +
+                                 std::to_string(int(result)));
+}
+
+/// uniforms of a view, std140
+struct ViewUniforms {
+    Matrix4f view;
+    Matrix4f viewProj;
+    float lightDirection[4];
+    float ambientColor[4];
+    float diffuseColor[4];
+};
+
+/// push constants of a draw
+struct DrawConstants {
+    Matrix4f model;
+    Color4f diffuse;
+    int32_t segmentation;
+    int32_t textured;
+};
+
+/**
+ * @brief Instance and logical device of a physical device, shared by its renderers
+ */
+struct Shared {
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physical = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    uint32_t queueFamily = 0;
+    VkPhysicalDeviceMemoryProperties memory;
+    bool external = false; //<- memory and semaphores exportable as file descriptors
+    PFN_vkGetMemoryFdKHR getMemoryFd = nullptr;
+    PFN_vkGetSemaphoreFdKHR getSemaphoreFd = nullptr;
+    std::mutex queueMutex; //<- submissions of all renderers of the device
+
+    explicit Shared(int index);
+    ~Shared()
+    {
+        if (device)
+            vkDestroyDevice(device, nullptr);
+        if (instance)
+            vkDestroyInstance(instance, nullptr);
+    }
+
+    Shared(const Shared&) = delete;
+    Shared& operator=(const Shared&) = delete;
+
+    /**
+     * @brief Memory type among \p bits with the \p preferred properties, else the \p required
+     * ones
+     */
+    uint32_t memoryType(uint32_t bits, VkMemoryPropertyFlags required,
+                        VkMemoryPropertyFlags preferred) const
+    {
+        for (VkMemoryPropertyFlags flags : {preferred | required, required}) {
+            for (uint32_t i = 0; i < memory.memoryTypeCount; ++i)
+                if ((bits & (1u << i)) && (memory.memoryTypes[i].propertyFlags & flags) == flags)
+                    return i;
+        }
+        throw std::runtime_error("VulkanRenderer: no suitable memory type");
+    }
+};
+
+Shared::Shared(int index)
+{
+    VkApplicationInfo application{VK_STRUCTURE_TYPE_APPLICATION_INFO};
+    application.pApplicationName = "pybullet_rendering";
+    application.apiVersion = VK_API_VERSION_1_2;
+    VkInstanceCreateInfo instanceInfo{VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+    instanceInfo.pApplicationInfo = &application;
+    check(vkCreateInstance(&instanceInfo, nullptr, &instance), "vkCreateInstance");
+
+    uint32_t count = 0;
+    vkEnumeratePhysicalDevices(instance, &count, nullptr);
+    std::vector<VkPhysicalDevice> devices(count);
+    vkEnumeratePhysicalDevices(instance, &count, devices.data());
+    // the first device with a graphics queue by default
+    for (size_t i = 0; i < devices.size(); ++i) {
+        if (index >= 0 && int(i) != index)
+            continue;
+        uint32_t families = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &families, nullptr);
+        std::vector<VkQueueFamilyProperties> properties(families);
+        vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &families, properties.data());
+        for (uint32_t f = 0; f < families && !physical; ++f) {
+            if (properties[f].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                physical = devices[i];
+                queueFamily = f;
+            }
+        }
+        if (physical)
+            break;
+    }
+    if (!physical)
+        throw std::runtime_error("VulkanRenderer: no Vulkan device " +
+                                 (index >= 0 ? std::to_string(index) : std::string()) +
+                                 " with a graphics queue");
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical, &properties);
+    VkPhysicalDeviceVulkan12Features features12{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2 features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    features.pNext = &features12;
+    if (properties.apiVersion >= VK_API_VERSION_1_2)
+        vkGetPhysicalDeviceFeatures2(physical, &features);
+    if (!features12.timelineSemaphore)
+        throw std::runtime_error("VulkanRenderer: device without timeline semaphores, "
+                                 "Vulkan 1.2 is required");
+    vkGetPhysicalDeviceMemoryProperties(physical, &memory);
+
+    // file descriptors of memory and semaphores for CUDA interop, where available
+    vkEnumerateDeviceExtensionProperties(physical, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> available(count);
+    vkEnumerateDeviceExtensionProperties(physical, nullptr, &count, available.data());
+    const auto supported = [&](const char* name) {
+        return std::any_of(available.begin(), available.end(), [&](const auto& extension) {
+            return std::strcmp(extension.extensionName, name) == 0;
+        });
+    };
+    std::vector<const char*> extensions;
+    external = supported(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME) &&
+               supported(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME);
+    if (external) {
+        extensions.push_back(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME);
+    }
+
+    const float priority = 1.f;
+    VkDeviceQueueCreateInfo queueInfo{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+    queueInfo.queueFamilyIndex = queueFamily;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+    VkPhysicalDeviceVulkan12Features enabled{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    enabled.timelineSemaphore = VK_TRUE;
+    VkDeviceCreateInfo deviceInfo{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+    deviceInfo.pNext = &enabled;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    deviceInfo.enabledExtensionCount = uint32_t(extensions.size());
+    deviceInfo.ppEnabledExtensionNames = extensions.data();
+    check(vkCreateDevice(physical, &deviceInfo, nullptr, &device), "vkCreateDevice");
+    vkGetDeviceQueue(device, queueFamily, 0, &queue);
+    if (external) {
+        getMemoryFd = reinterpret_cast<PFN_vkGetMemoryFdKHR>(
+            vkGetDeviceProcAddr(device, "vkGetMemoryFdKHR"));
+        getSemaphoreFd = reinterpret_cast<PFN_vkGetSemaphoreFdKHR>(
+            vkGetDeviceProcAddr(device, "vkGetSemaphoreFdKHR"));
+        external = getMemoryFd && getSemaphoreFd;
+    }
+}
+
+/**
+ * @brief Device shared by the renderers of a physical device, created by the first one
+ */
+std::shared_ptr<Shared> sharedDevice(int index)
+{
+    static std::mutex mutex;
+    static std::map<int, std::weak_ptr<Shared>> devices;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto shared = devices[index].lock();
+    if (!shared) {
+        shared = std::make_shared<Shared>(index);
+        devices[index] = shared;
+    }
+    return shared;
+}
+
+/// buffer with its own memory
+struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr; //<- host visible buffers, mapped for good
+};
+
+/// image with its own memory and a view of it
+struct Image {
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+};
+
+VkShaderModule shaderModule(VkDevice device, const uint32_t* code, size_t bytes)
+{
+    VkShaderModuleCreateInfo info{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+    info.codeSize = bytes;
+    info.pCode = code;
+    VkShaderModule module = VK_NULL_HANDLE;
+    check(vkCreateShaderModule(device, &info, nullptr, &module), "vkCreateShaderModule");
+    return module;
+}
+
+/// RGBA texels of a bitmap, gray ones repeated
+std::vector<uint8_t> rgbaTexels(const scene::Bitmap& bitmap)
+{
+    const int channels = int(bitmap.channels());
+    const size_t count = size_t(bitmap.cols()) * size_t(bitmap.rows());
+    std::vector<uint8_t> texels(count * 4);
+    const uint8_t* data = bitmap.data();
+    for (size_t p = 0; p < count; ++p) {
+        const uint8_t* texel = data + p * channels;
+        uint8_t* rgba = &texels[p * 4];
+        if (channels < 3) {
+            std::fill_n(rgba, 3, texel[0]);
+            rgba[3] = channels == 2 ? texel[1] : 255;
+        } else {
+            std::copy_n(texel, 3, rgba);
+            rgba[3] = channels == 4 ? texel[3] : 255;
+        }
+    }
+    return texels;
+}
+
+void imageBarrier(VkCommandBuffer commands, VkImage image, VkImageLayout from, VkImageLayout to,
+                  VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage,
+                  VkPipelineStageFlags dstStage)
+{
+    VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = from;
+    barrier.newLayout = to;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commands, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+} // namespace
+
+struct VulkanRenderer::Context {
+    /**
+     * @brief Interleaved vertices and 32-bit indices of a mesh data in device local memory
+     */
+    struct Mesh {
+        std::shared_ptr<scene::MeshData> data; //<- keeps the key alive
+        Buffer vertices;
+        Buffer indices;
+        uint32_t indexCount = 0;
+        bool used = false; //<- by a shape of the scene, at its last update
+    };
+
+    /**
+     * @brief RGBA image of a bitmap and the descriptor set sampling it
+     */
+    struct Texture {
+        std::shared_ptr<scene::Bitmap> bitmap; //<- keeps the key alive
+        Image image;
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        VkDescriptorPool pool = VK_NULL_HANDLE; //<- of the set
+        bool used = false;
+    };
+
+    /**
+     * @brief Attachments, commands and readback of a view, one per view of renderFrames()
+     */
+    struct Target {
+        int cols = 0;
+        int rows = 0;
+        Image color, depth, mask, depthBuffer;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VkCommandPool pool = VK_NULL_HANDLE; //<- of the thread recording the view
+        VkCommandBuffer commands = VK_NULL_HANDLE;
+        Buffer uniforms; //<- ViewUniforms, host visible
+        VkDescriptorSet viewSet = VK_NULL_HANDLE;
+        Buffer readback; //<- planes copied by the GPU, host visible, or exported
+        uint64_t timelineValue = 0; //<- signaled once drawn
+    };
+
+    std::shared_ptr<Shared> shared;
+    bool externalMemory = false;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkDescriptorSetLayout viewLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout textureLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline opaque = VK_NULL_HANDLE;
+    VkPipeline blended = VK_NULL_HANDLE; //<- alpha blending of the color attachment
+    VkSampler sampler = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool> descriptorPools; //<- the last one allocates
+    uint32_t poolSets = 0; //<- allocated from the last pool
+    VkSemaphore timeline = VK_NULL_HANDLE; //<- signaled by the views in submission order
+    uint64_t timelineValue = 0; //<- last value submitted
+    VkCommandPool uploadPool = VK_NULL_HANDLE;
+    VkCommandBuffer uploads = VK_NULL_HANDLE; //<- recording copies of new assets, or null
+    std::vector<Buffer> staging; //<- sources of the recorded copies
+    VkFence uploadFence = VK_NULL_HANDLE;
+    Texture white; //<- sampled by untextured draws
+    std::map<const scene::MeshData*, std::unique_ptr<Mesh>> meshes;
+    std::map<const scene::Bitmap*, std::unique_ptr<Texture>> textures;
+    std::vector<std::unique_ptr<Target>> targets;
+    size_t assetBytes = 0; //<- device memory of meshes and textures
+    size_t peakGpuBytes = 0;
+
+    Context(const std::shared_ptr<Shared>& shared, bool externalMemory);
+    ~Context();
+
+    VkDevice device() const { return shared->device; }
+
+    Buffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                        VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0,
+                        bool exported = false)
+    {
+        Buffer buffer;
+        buffer.size = size;
+        VkExternalMemoryBufferCreateInfo externalInfo{
+            VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO};
+        externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+        VkBufferCreateInfo info{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+        info.pNext = exported ? &externalInfo : nullptr;
+        info.size = size;
+        info.usage = usage;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        check(vkCreateBuffer(device(), &info, nullptr, &buffer.buffer), "vkCreateBuffer");
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(device(), buffer.buffer, &requirements);
+        VkExportMemoryAllocateInfo exportInfo{VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO};
+        exportInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+        VkMemoryAllocateInfo allocation{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        allocation.pNext = exported ? &exportInfo : nullptr;
+        allocation.allocationSize = requirements.size;
+        allocation.memoryTypeIndex =
+            shared->memoryType(requirements.memoryTypeBits, required, preferred);
+        check(vkAllocateMemory(device(), &allocation, nullptr, &buffer.memory),
+              "vkAllocateMemory");
+        vkBindBufferMemory(device(), buffer.buffer, buffer.memory, 0);
+        if (required & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+            check(vkMapMemory(device(), buffer.memory, 0, VK_WHOLE_SIZE, 0, &buffer.mapped),
+                  "vkMapMemory");
+        return buffer;
+    }
+
+    Image createImage(int cols, int rows, VkFormat format, VkImageUsageFlags usage,
+                      VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT)
+    {
+        Image image;
+        VkImageCreateInfo info{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = format;
+        info.extent = {uint32_t(cols), uint32_t(rows), 1};
+        info.mipLevels = 1;
+        info.arrayLayers = 1;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = usage;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        check(vkCreateImage(device(), &info, nullptr, &image.image), "vkCreateImage");
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(device(), image.image, &requirements);
+        VkMemoryAllocateInfo allocation{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        allocation.allocationSize = requirements.size;
+        allocation.memoryTypeIndex = shared->memoryType(
+            requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+        check(vkAllocateMemory(device(), &allocation, nullptr, &image.memory),
+              "vkAllocateMemory");
+        vkBindImageMemory(device(), image.image, image.memory, 0);
+        image.size = requirements.size;
+
+        VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+        viewInfo.image = image.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = {aspect, 0, 1, 0, 1};
+        check(vkCreateImageView(device(), &viewInfo, nullptr, &image.view),
+              "vkCreateImageView");
+        return image;
+    }
+
+    void release(Buffer& buffer)
+    {
+        if (buffer.buffer)
+            vkDestroyBuffer(device(), buffer.buffer, nullptr);
+        if (buffer.memory)
+            vkFreeMemory(device(), buffer.memory, nullptr);
+        buffer = Buffer();
+    }
+
+    void release(Image& image)
+    {
+        if (image.view)
+            vkDestroyImageView(device(), image.view, nullptr);
+        if (image.image)
+            vkDestroyImage(device(), image.image, nullptr);
+        if (image.memory)
+            vkFreeMemory(device(), image.memory, nullptr);
+        image = Image();
+    }
+
+    VkDescriptorSet allocateSet(VkDescriptorSetLayout layout)
+    {
+        // a new pool once the last one is full, freed sets are not reused
+        if (descriptorPools.empty() || poolSets == kDescriptorPoolSets) {
+            const VkDescriptorPoolSize sizes[] = {
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kDescriptorPoolSets},
+                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kDescriptorPoolSets}};
+            VkDescriptorPoolCreateInfo info{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+            info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+            info.maxSets = kDescriptorPoolSets;
+            info.poolSizeCount = 2;
+            info.pPoolSizes = sizes;
+            VkDescriptorPool pool = VK_NULL_HANDLE;
+            check(vkCreateDescriptorPool(device(), &info, nullptr, &pool),
+                  "vkCreateDescriptorPool");
+            descriptorPools.push_back(pool);
+            poolSets = 0;
+        }
+        VkDescriptorSetAllocateInfo info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        info.descriptorPool = descriptorPools.back();
+        info.descriptorSetCount = 1;
+        info.pSetLayouts = &layout;
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        check(vkAllocateDescriptorSets(device(), &info, &set), "vkAllocateDescriptorSets");
+        ++poolSets;
+        return set;
+    }
+
+    /// command buffer recording the copies of new assets, submitted by flushUploads()
+    VkCommandBuffer uploadCommands()
+    {
+        if (uploads)
+            return uploads;
+        VkCommandBufferAllocateInfo info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        info.commandPool = uploadPool;
+        info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        info.commandBufferCount = 1;
+        check(vkAllocateCommandBuffers(device(), &info, &uploads), "vkAllocateCommandBuffers");
+        VkCommandBufferBeginInfo begin{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(uploads, &begin);
+        return uploads;
+    }
+
+    /// host visible copy of \p bytes, released once the uploads are flushed
+    const Buffer& stage(const void* data, size_t bytes)
+    {
+        staging.push_back(createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+        std::memcpy(staging.back().mapped, data, bytes);
+        return staging.back();
+    }
+
+    /**
+     * @brief Submit the recorded uploads and wait for them
+     */
+    void flushUploads()
+    {
+        if (!uploads)
+            return;
+        vkEndCommandBuffer(uploads);
+        VkSubmitInfo submit{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &uploads;
+        {
+            std::lock_guard<std::mutex> lock(shared->queueMutex);
+            check(vkQueueSubmit(shared->queue, 1, &submit, uploadFence), "vkQueueSubmit");
+        }
+        vkWaitForFences(device(), 1, &uploadFence, VK_TRUE, UINT64_MAX);
+        vkResetFences(device(), 1, &uploadFence);
+        vkFreeCommandBuffers(device(), uploadPool, 1, &uploads);
+        uploads = VK_NULL_HANDLE;
+        for (auto& buffer : staging)
+            release(buffer);
+        staging.clear();
+    }
+
+    /**
+     * @brief Mesh of a mesh data, uploaded on first use
+     */
+    const Mesh& mesh(const std::shared_ptr<scene::MeshData>& data)
+    {
+        auto& mesh = meshes[data.get()];
+        if (mesh) {
+            mesh->used = true;
+            return *mesh;
+        }
+
+        const size_t count = data->numVertices();
+        const auto& positions = data->vertices();
+        const auto& normals = data->normals();
+        const auto& uvs = data->uvs();
+        std::vector<float> vertices(count * kVertexFloats, 0.f);
+        for (size_t v = 0; v < count; ++v) {
+            float* vertex = &vertices[v * kVertexFloats];
+            std::copy_n(&positions[v * 3], 3, vertex);
+            if (normals.size() == count * 3)
+                std::copy_n(&normals[v * 3], 3, vertex + 3);
+            if (uvs.size() == count * 2)
+                std::copy_n(&uvs[v * 2], 2, vertex + 6);
+        }
+        const std::vector<uint32_t> indices(data->indices().begin(), data->indices().end());
+
+        mesh.reset(new Mesh());
+        mesh->data = data;
+        mesh->indexCount = uint32_t(indices.size());
+        const size_t vertexBytes = vertices.size() * sizeof(float);
+        const size_t indexBytes = indices.size() * sizeof(uint32_t);
+        mesh->vertices = createBuffer(
+            vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        mesh->indices = createBuffer(
+            indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VkCommandBuffer commands = uploadCommands();
+        const VkBufferCopy vertexCopy{0, 0, vertexBytes}, indexCopy{0, 0, indexBytes};
+        vkCmdCopyBuffer(commands, stage(vertices.data(), vertexBytes).buffer,
+                        mesh->vertices.buffer, 1, &vertexCopy);
+        vkCmdCopyBuffer(commands, stage(indices.data(), indexBytes).buffer, mesh->indices.buffer,
+                        1, &indexCopy);
+        assetBytes += vertexBytes + indexBytes;
+        mesh->used = true;
+        return *mesh;
+    }
+
+    /**
+     * @brief Texture of a bitmap, uploaded on first use, without mipmaps
+     */
+    const Texture& texture(const std::shared_ptr<scene::Bitmap>& bitmap)
+    {
+        auto& texture = textures[bitmap.get()];
+        if (texture) {
+            texture->used = true;
+            return *texture;
+        }
+        texture.reset(new Texture());
+        texture->bitmap = bitmap;
+        texture->used = true;
+        upload(*texture, int(bitmap->cols()), int(bitmap->rows()), rgbaTexels(*bitmap).data());
+        return *texture;
+    }
+
+    void upload(Texture& texture, int cols, int rows, const uint8_t* texels)
+    {
+        texture.image = createImage(cols, rows, VK_FORMAT_R8G8B8A8_UNORM,
+                                    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+        const size_t bytes = size_t(cols) * size_t(rows) * 4;
+        VkCommandBuffer commands = uploadCommands();
+        imageBarrier(commands, texture.image.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        VkBufferImageCopy copy{};
+        copy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        copy.imageExtent = {uint32_t(cols), uint32_t(rows), 1};
+        vkCmdCopyBufferToImage(commands, stage(texels, bytes).buffer, texture.image.image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+        imageBarrier(commands, texture.image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        assetBytes += texture.image.size;
+
+        texture.set = allocateSet(textureLayout);
+        texture.pool = descriptorPools.back();
+        VkDescriptorImageInfo image{sampler, texture.image.view,
+                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        write.dstSet = texture.set;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &image;
+        vkUpdateDescriptorSets(device(), 1, &write, 0, nullptr);
+    }
+
+    void release(Mesh& mesh)
+    {
+        assetBytes -= mesh.vertices.size + mesh.indices.size;
+        release(mesh.vertices);
+        release(mesh.indices);
+    }
+
+    void release(Texture& texture)
+    {
+        assetBytes -= texture.image.size;
+        release(texture.image);
+        if (texture.set)
+            vkFreeDescriptorSets(device(), texture.pool, 1, &texture.set);
+        texture.set = VK_NULL_HANDLE;
+    }
+
+    /**
+     * @brief Release the meshes and textures used by no shape since the last scene update
+     */
+    void releaseUnused()
+    {
+        for (auto it = meshes.begin(); it != meshes.end();) {
+            if (it->second->used) {
+                it->second->used = false;
+                ++it;
+                continue;
+            }
+            release(*it->second);
+            it = meshes.erase(it);
+        }
+        for (auto it = textures.begin(); it != textures.end();) {
+            if (it->second->used) {
+                it->second->used = false;
+                ++it;
+                continue;
+            }
+            release(*it->second);
+            it = textures.erase(it);
+        }
+    }
+
+    /**
+     * @brief Target of view \p index at a size, made again when resized
+     */
+    Target& target(size_t index, int cols, int rows);
+
+    void release(Target& target)
+    {
+        for (Image* image : {&target.color, &target.depth, &target.mask, &target.depthBuffer})
+            release(*image);
+        if (target.framebuffer)
+            vkDestroyFramebuffer(device(), target.framebuffer, nullptr);
+        target.framebuffer = VK_NULL_HANDLE;
+        release(target.readback);
+        target.cols = target.rows = 0;
+    }
+
+    /// bytes of the planes of a target, packed
+    static VkDeviceSize planeBytes(int cols, int rows) { return VkDeviceSize(cols) * rows * 4; }
+
+    size_t gpuBytes() const
+    {
+        size_t bytes = assetBytes;
+        for (const auto& target : targets) {
+            bytes += target->color.size + target->depth.size + target->mask.size +
+                     target->depthBuffer.size;
+            if (externalMemory)
+                bytes += target->readback.size;
+        }
+        return bytes;
+    }
+
+    size_t hostBytes() const
+    {
+        size_t bytes = 0;
+        if (!externalMemory)
+            for (const auto& target : targets)
+                bytes += target->readback.size;
+        return bytes;
+    }
+};
+
+VulkanRenderer::Context::Context(const std::shared_ptr<Shared>& sharedDevice,
+                                 bool exportMemory)
+    : shared(sharedDevice), externalMemory(exportMemory)
+{
+    // color, metric depth and mask attachments read back once drawn, and a depth buffer
+    VkAttachmentDescription attachments[4] = {};
+    const VkFormat formats[] = {kColorFormat, kDepthFormat, kMaskFormat, kDepthBufferFormat};
+    for (int i = 0; i < 4; ++i) {
+        attachments[i].format = formats[i];
+        attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[i].storeOp = i < 3 ? VK_ATTACHMENT_STORE_OP_STORE
+                                       : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[i].finalLayout = i < 3 ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                           : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    }
+    const VkAttachmentReference colorReferences[] = {
+        {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+        {1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+        {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
+    const VkAttachmentReference depthReference{3,
+                                               VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 3;
+    subpass.pColorAttachments = colorReferences;
+    subpass.pDepthStencilAttachment = &depthReference;
+    // attachments copied out once drawn
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = 0;
+    dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    VkRenderPassCreateInfo passInfo{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+    passInfo.attachmentCount = 4;
+    passInfo.pAttachments = attachments;
+    passInfo.subpassCount = 1;
+    passInfo.pSubpasses = &subpass;
+    passInfo.dependencyCount = 1;
+    passInfo.pDependencies = &dependency;
+    check(vkCreateRenderPass(device(), &passInfo, nullptr, &renderPass), "vkCreateRenderPass");
+
+    // set 0 the view uniforms, set 1 the diffuse texture, constants per draw
+    VkDescriptorSetLayoutBinding viewBinding{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1,
+                                             VK_SHADER_STAGE_VERTEX_BIT |
+                                                 VK_SHADER_STAGE_FRAGMENT_BIT,
+                                             nullptr};
+    VkDescriptorSetLayoutCreateInfo layoutInfo{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &viewBinding;
+    check(vkCreateDescriptorSetLayout(device(), &layoutInfo, nullptr, &viewLayout),
+          "vkCreateDescriptorSetLayout");
+    VkDescriptorSetLayoutBinding textureBinding{0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
+                                                VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+    layoutInfo.pBindings = &textureBinding;
+    check(vkCreateDescriptorSetLayout(device(), &layoutInfo, nullptr, &textureLayout),
+          "vkCreateDescriptorSetLayout");
+    const VkDescriptorSetLayout setLayouts[] = {viewLayout, textureLayout};
+    const VkPushConstantRange constants{VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                                        0, sizeof(DrawConstants)};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &constants;
+    check(vkCreatePipelineLayout(device(), &pipelineLayoutInfo, nullptr, &pipelineLayout),
+          "vkCreatePipelineLayout");
+
+    const VkShaderModule vertexShader =
+        shaderModule(device(), kVulkanVertexShader, sizeof(kVulkanVertexShader));
+    const VkShaderModule fragmentShader =
+        shaderModule(device(), kVulkanFragmentShader, sizeof(kVulkanFragmentShader));
+    VkPipelineShaderStageCreateInfo stages[2] = {
+        {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO},
+        {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO}};
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertexShader;
+    stages[0].pName = "main";
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragmentShader;
+    stages[1].pName = "main";
+
+    const VkVertexInputBindingDescription binding{0, kVertexFloats * sizeof(float),
+                                                  VK_VERTEX_INPUT_RATE_VERTEX};
+    const VkVertexInputAttributeDescription vertexAttributes[] = {
+        {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0},
+        {1, 0, VK_FORMAT_R32G32B32_SFLOAT, 3 * sizeof(float)},
+        {2, 0, VK_FORMAT_R32G32_SFLOAT, 6 * sizeof(float)}};
+    VkPipelineVertexInputStateCreateInfo vertexInput{
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    vertexInput.vertexBindingDescriptionCount = 1;
+    vertexInput.pVertexBindingDescriptions = &binding;
+    vertexInput.vertexAttributeDescriptionCount = 3;
+    vertexInput.pVertexAttributeDescriptions = vertexAttributes;
+    VkPipelineInputAssemblyStateCreateInfo assembly{
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+    assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPipelineViewportStateCreateInfo viewport{
+        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+    // faces are not culled, as by the other renderers
+    VkPipelineRasterizationStateCreateInfo rasterization{
+        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_NONE;
+    rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization.lineWidth = 1.f;
+    VkPipelineMultisampleStateCreateInfo multisample{
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkPipelineDepthStencilStateCreateInfo depthStencil{
+        VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    VkPipelineColorBlendAttachmentState blend[3] = {};
+    for (auto& attachment : blend)
+        attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                    VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo colorBlend{
+        VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+    colorBlend.attachmentCount = 3;
+    colorBlend.pAttachments = blend;
+    const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic{VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamic.dynamicStateCount = 2;
+    dynamic.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = stages;
+    pipelineInfo.pVertexInputState = &vertexInput;
+    pipelineInfo.pInputAssemblyState = &assembly;
+    pipelineInfo.pViewportState = &viewport;
+    pipelineInfo.pRasterizationState = &rasterization;
+    pipelineInfo.pMultisampleState = &multisample;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlend;
+    pipelineInfo.pDynamicState = &dynamic;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    check(vkCreateGraphicsPipelines(device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &opaque),
+          "vkCreateGraphicsPipelines");
+    // transparent shapes blend their color only, as in the EGLRenderer
+    blend[0].blendEnable = VK_TRUE;
+    blend[0].srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blend[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend[0].colorBlendOp = VK_BLEND_OP_ADD;
+    blend[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blend[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend[0].alphaBlendOp = VK_BLEND_OP_ADD;
+    check(vkCreateGraphicsPipelines(device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &blended),
+          "vkCreateGraphicsPipelines");
+    vkDestroyShaderModule(device(), vertexShader, nullptr);
+    vkDestroyShaderModule(device(), fragmentShader, nullptr);
+
+    VkSamplerCreateInfo samplerInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    check(vkCreateSampler(device(), &samplerInfo, nullptr, &sampler), "vkCreateSampler");
+
+    VkExportSemaphoreCreateInfo exportInfo{VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO};
+    exportInfo.handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+    VkSemaphoreTypeCreateInfo typeInfo{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    typeInfo.pNext = externalMemory ? &exportInfo : nullptr;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+    VkSemaphoreCreateInfo semaphoreInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    semaphoreInfo.pNext = &typeInfo;
+    check(vkCreateSemaphore(device(), &semaphoreInfo, nullptr, &timeline), "vkCreateSemaphore");
+
+    VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    poolInfo.queueFamilyIndex = shared->queueFamily;
+    check(vkCreateCommandPool(device(), &poolInfo, nullptr, &uploadPool), "vkCreateCommandPool");
+    VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    check(vkCreateFence(device(), &fenceInfo, nullptr, &uploadFence), "vkCreateFence");
+
+    const uint8_t white_[4] = {255, 255, 255, 255};
+    upload(white, 1, 1, white_);
+    flushUploads();
+}
+
+VulkanRenderer::Context::~Context()
+{
+    vkDeviceWaitIdle(device());
+    for (auto& it : meshes)
+        release(*it.second);
+    for (auto& it : textures)
+        release(*it.second);
+    release(white);
+    for (auto& target : targets) {
+        release(*target);
+        release(target->uniforms);
+        vkDestroyCommandPool(device(), target->pool, nullptr);
+    }
+    for (VkDescriptorPool pool : descriptorPools)
+        vkDestroyDescriptorPool(device(), pool, nullptr);
+    vkDestroyFence(device(), uploadFence, nullptr);
+    vkDestroyCommandPool(device(), uploadPool, nullptr);
+    vkDestroySemaphore(device(), timeline, nullptr);
+    vkDestroySampler(device(), sampler, nullptr);
+    vkDestroyPipeline(device(), opaque, nullptr);
+    vkDestroyPipeline(device(), blended, nullptr);
+    vkDestroyPipelineLayout(device(), pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device(), viewLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device(), textureLayout, nullptr);
+    vkDestroyRenderPass(device(), renderPass, nullptr);
+}
+
+VulkanRenderer::Context::Target& VulkanRenderer::Context::target(size_t index, int cols, int rows)
+{
+    while (targets.size() <= index) {
+        std::unique_ptr<Target> target(new Target());
+        VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = shared->queueFamily;
+        check(vkCreateCommandPool(device(), &poolInfo, nullptr, &target->pool),
+              "vkCreateCommandPool");
+        VkCommandBufferAllocateInfo info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        info.commandPool = target->pool;
+        info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        info.commandBufferCount = 1;
+        check(vkAllocateCommandBuffers(device(), &info, &target->commands),
+              "vkAllocateCommandBuffers");
+        target->uniforms = createBuffer(sizeof(ViewUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        target->viewSet = allocateSet(viewLayout);
+        VkDescriptorBufferInfo buffer{target->uniforms.buffer, 0, sizeof(ViewUniforms)};
+        VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        write.dstSet = target->viewSet;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        write.pBufferInfo = &buffer;
+        vkUpdateDescriptorSets(device(), 1, &write, 0, nullptr);
+        targets.push_back(std::move(target));
+    }
+
+    Target& target = *targets[index];
+    if (target.cols == cols && target.rows == rows)
+        return target;
+    release(target);
+    const VkImageUsageFlags usage =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    target.color = createImage(cols, rows, kColorFormat, usage);
+    target.depth = createImage(cols, rows, kDepthFormat, usage);
+    target.mask = createImage(cols, rows, kMaskFormat, usage);
+    target.depthBuffer =
+        createImage(cols, rows, kDepthBufferFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                    VK_IMAGE_ASPECT_DEPTH_BIT);
+    const VkImageView views[] = {target.color.view, target.depth.view, target.mask.view,
+                                 target.depthBuffer.view};
+    VkFramebufferCreateInfo info{VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    info.renderPass = renderPass;
+    info.attachmentCount = 4;
+    info.pAttachments = views;
+    info.width = uint32_t(cols);
+    info.height = uint32_t(rows);
+    info.layers = 1;
+    check(vkCreateFramebuffer(device(), &info, nullptr, &target.framebuffer),
+          "vkCreateFramebuffer");
+    // cached host memory reads back faster, exported memory stays on the device
+    const VkDeviceSize bytes = 3 * planeBytes(cols, rows);
+    if (externalMemory)
+        target.readback = createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, true);
+    else
+        target.readback = createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    target.cols = cols;
+    target.rows = rows;
+    peakGpuBytes = std::max(peakGpuBytes, gpuBytes());
+    return target;
+}
+
+struct VulkanRenderer::Item {
+    int shapeIndex = 0;
+    Matrix4f localMatrix; //<- shape pose in the node frame
+    scene::AABB bounds; //<- mesh bounds in the shape frame
+    const Context::Mesh* mesh = nullptr;
+    std::vector<const Context::Mesh*> lods; //<- simplified meshes, coarser last
+    const Context::Texture* texture = nullptr; //<- null for untextured shapes
+    std::shared_ptr<scene::Texture> sceneTexture; //<- of the material, to detect changes
+    Color4f color;
+    int segmentation = -1;
+};
+
+VulkanRenderer::VulkanRenderer(int device, int numThreads, bool externalMemory)
+    : _device(device), _externalMemory(externalMemory)
+{
+    // assets of new shapes start loading before the scene update needs them
+    setAssetPrefetch(true);
+
+    auto shared = sharedDevice(device);
+    if (externalMemory && !shared->external)
+        throw std::runtime_error("VulkanRenderer: device without external memory and "
+                                 "semaphore file descriptors");
+    _context.reset(new Context(shared, externalMemory));
+    if (numThreads <= 0)
+        numThreads = int(std::min(std::max(std::thread::hardware_concurrency(), 1u), 8u));
+    _numThreads = numThreads;
+}
+
+VulkanRenderer::~VulkanRenderer() = default;
+
+void VulkanRenderer::updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph, bool)
+{
+    _items.clear();
+    _bounds.clear();
+    _segmentationMode = sceneGraph->segmentationMode();
+    prefetchAssets(*sceneGraph); //<- loaded in parallel, consumed in order
+    for (const auto& it : sceneGraph->nodes())
+        updateNode(it.first, it.second);
+    _context->flushUploads();
+    _context->releaseUnused();
+    updateMemory();
+}
+
+bool VulkanRenderer::updateShapeMaterial(int nodeId, int shapeIndex,
+                                         const std::shared_ptr<scene::Material>& material)
+{
+    const auto it = _items.find(nodeId);
+    if (it == _items.end())
+        return false;
+
+    const auto& texture = material ? material->diffuseTexture() : nullptr;
+    for (auto& item : it->second) {
+        if (item.shapeIndex != shapeIndex)
+            continue;
+        if (texture != item.sceneTexture)
+            return false; //<- uploaded by a scene update
+        item.color = material ? material->diffuseColor() : Color4f{1.f, 1.f, 1.f, 1.f};
+        return true;
+    }
+    return true; //<- shape not drawn
+}
+
+void VulkanRenderer::updateNode(int nodeId, const scene::Node& node)
+{
+    auto& items = _items[nodeId];
+    items.clear();
+
+    auto& ctx = *_context;
+    const auto& shapes = node.shapes();
+    for (int i = 0; i < int(shapes.size()); ++i) {
+        const auto& shape = shapes[i];
+        const auto mesh = loadMeshData(shape);
+        if (!mesh || mesh->indices().empty())
+            continue;
+
+        Item item;
+        item.shapeIndex = i;
+        item.localMatrix = shape.pose().matrix();
+        item.bounds = mesh->bounds();
+        item.mesh = &ctx.mesh(mesh);
+        for (const auto& lod : loadMeshLods(shape))
+            item.lods.push_back(&ctx.mesh(lod));
+        item.color = {1.f, 1.f, 1.f, 1.f};
+        if (const auto& material = shape.material()) {
+            item.color = material->diffuseColor();
+            item.sceneTexture = material->diffuseTexture();
+            const auto bitmap = item.sceneTexture ? loadBitmap(*item.sceneTexture) : nullptr;
+            if (bitmap && bitmap->channels() > 0 &&
+                bitmap->compression() == scene::Bitmap::Compression::None)
+                item.texture = &ctx.texture(bitmap);
+        }
+        // drawn as body + ((link + 1) << 24), i.e. as is with a link of -1
+        item.segmentation = node.segmentation(i, _segmentationMode);
+        items.push_back(std::move(item));
+    }
+    // after loading meshes, so that mesh files have bounds
+    _bounds.updateNode(nodeId, node);
+}
+
+void VulkanRenderer::recordView(size_t index, const scene::SceneState& sceneState,
+                                const scene::SceneView& sceneView, int cols, int rows)
+{
+    auto& ctx = *_context;
+    auto& target = *ctx.targets[index];
+    // a region of interest is drawn alone by a camera of its projection
+    const scene::Camera camera = sceneView.imageCamera();
+    const Matrix4f viewProj = multiply(camera.projMatrix(), camera.viewMatrix());
+
+    // default light close to the one of the python renderers
+    ViewUniforms uniforms;
+    uniforms.view = camera.viewMatrix();
+    uniforms.viewProj = viewProj;
+    Vector3f direction{0.8f, 0.2f, -2.f};
+    Color3f ambient{0.7f, 0.7f, 0.7f}, diffuse{0.3f, 0.3f, 0.3f};
+    if (const auto& light = sceneView.light()) {
+        direction = light->direction();
+        ambient = light->ambientColor();
+        diffuse = light->diffuseColor();
+    }
+    for (int k = 0; k < 3; ++k) {
+        uniforms.lightDirection[k] = direction[k];
+        uniforms.ambientColor[k] = ambient[k];
+        uniforms.diffuseColor[k] = diffuse[k];
+    }
+    uniforms.lightDirection[3] = uniforms.ambientColor[3] = uniforms.diffuseColor[3] = 0.f;
+    std::memcpy(target.uniforms.mapped, &uniforms, sizeof(uniforms));
+
+    // shapes of the nodes in view, opaque ones grouped by texture, blended ones back to front
+    struct Draw {
+        const Item* item;
+        const Context::Mesh* mesh;
+        Matrix4f model;
+        float depth;
+    };
+    std::vector<Draw> opaque, blended;
+    const auto& view = camera.viewMatrix();
+    const bool layered = sceneView.filtersLayers();
+    for (int nodeId : _bvh.query(scene::Frustum(viewProj))) {
+        const auto it = _items.find(nodeId);
+        if (it == _items.end())
+            continue;
+        for (const auto& item : it->second) {
+            if (layered && !sceneView.visible(nodeId, item.shapeIndex))
+                continue;
+            const Matrix4f model = multiply(sceneState.matrix(nodeId), item.localMatrix);
+            if (!scene::Frustum(multiply(viewProj, model)).intersects(item.bounds))
+                continue;
+            const int level = _lodPolicy.select(item.bounds.transformed(model), camera, rows,
+                                                int(item.lods.size()) + 1);
+            const float depth =
+                -(view[2] * model[12] + view[6] * model[13] + view[10] * model[14] + view[14]);
+            Draw draw{&item, level > 0 ? item.lods[level - 1] : item.mesh, model, depth};
+            (item.color[3] < 1.f ? blended : opaque).push_back(draw);
+        }
+    }
+    std::stable_sort(opaque.begin(), opaque.end(), [](const Draw& a, const Draw& b) {
+        return a.item->texture < b.item->texture;
+    });
+    std::stable_sort(blended.begin(), blended.end(),
+                     [](const Draw& a, const Draw& b) { return a.depth > b.depth; });
+
+    VkCommandBuffer commands = target.commands;
+    vkResetCommandPool(ctx.device(), target.pool, 0);
+    VkCommandBufferBeginInfo begin{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commands, &begin);
+
+    const auto& bg = sceneView.backgroundColor();
+    VkClearValue clears[4];
+    clears[0].color.float32[0] = bg[0];
+    clears[0].color.float32[1] = bg[1];
+    clears[0].color.float32[2] = bg[2];
+    clears[0].color.float32[3] = 1.f;
+    clears[1].color.float32[0] = 0.f; //<- no depth
+    clears[2].color.int32[0] = -1; //<- no mask
+    clears[3].depthStencil = {1.f, 0};
+    VkRenderPassBeginInfo pass{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+    pass.renderPass = ctx.renderPass;
+    pass.framebuffer = target.framebuffer;
+    pass.renderArea.extent = {uint32_t(cols), uint32_t(rows)};
+    pass.clearValueCount = 4;
+    pass.pClearValues = clears;
+    vkCmdBeginRenderPass(commands, &pass, VK_SUBPASS_CONTENTS_INLINE);
+    const VkViewport viewport{0.f, 0.f, float(cols), float(rows), 0.f, 1.f};
+    vkCmdSetViewport(commands, 0, 1, &viewport);
+    vkCmdSetScissor(commands, 0, 1, &pass.renderArea);
+
+    const auto drawShapes = [&](const std::vector<Draw>& draws, VkPipeline pipeline) {
+        if (draws.empty())
+            return;
+        vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx.pipelineLayout, 0,
+                                1, &target.viewSet, 0, nullptr);
+        VkDescriptorSet bound = VK_NULL_HANDLE;
+        for (const auto& draw : draws) {
+            const auto* texture = draw.item->texture ? draw.item->texture : &ctx.white;
+            if (texture->set != bound) {
+                bound = texture->set;
+                vkCmdBindDescriptorSets(commands, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                        ctx.pipelineLayout, 1, 1, &bound, 0, nullptr);
+            }
+            DrawConstants constants;
+            constants.model = draw.model;
+            constants.diffuse = draw.item->color;
+            constants.segmentation = draw.item->segmentation;
+            constants.textured = draw.item->texture ? 1 : 0;
+            vkCmdPushConstants(commands, ctx.pipelineLayout,
+                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                               sizeof(constants), &constants);
+            const VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commands, 0, 1, &draw.mesh->vertices.buffer, &offset);
+            vkCmdBindIndexBuffer(commands, draw.mesh->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+            vkCmdDrawIndexed(commands, draw.mesh->indexCount, 1, 0, 0, 0);
+        }
+    };
+    drawShapes(opaque, ctx.opaque);
+    drawShapes(blended, ctx.blended);
+    vkCmdEndRenderPass(commands);
+
+    // planes packed into the readback buffer, rows top first as drawn
+    const VkDeviceSize plane = Context::planeBytes(cols, rows);
+    const VkImage images[] = {target.color.image, target.depth.image, target.mask.image};
+    for (int i = 0; i < 3; ++i) {
+        VkBufferImageCopy copy{};
+        copy.bufferOffset = plane * i;
+        copy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        copy.imageExtent = {uint32_t(cols), uint32_t(rows), 1};
+        vkCmdCopyImageToBuffer(commands, images[i], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               target.readback.buffer, 1, &copy);
+    }
+    VkBufferMemoryBarrier barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = _externalMemory ? VK_ACCESS_MEMORY_READ_BIT : VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = target.readback.buffer;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         _externalMemory ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+                                         : VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 0, nullptr, 1, &barrier, 0, nullptr);
+    check(vkEndCommandBuffer(commands), "vkEndCommandBuffer");
+}
+
+void VulkanRenderer::readBack(size_t index, const scene::SceneView& sceneView,
+                              FrameData& outputFrame)
+{
+    auto& ctx = *_context;
+    const auto& target = *ctx.targets[index];
+    {
+        StageTimer timer(Stage::Readback);
+        VkSemaphoreWaitInfo wait{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+        wait.semaphoreCount = 1;
+        wait.pSemaphores = &ctx.timeline;
+        wait.pValues = &target.timelineValue;
+        check(vkWaitSemaphores(ctx.device(), &wait, UINT64_MAX), "vkWaitSemaphores");
+    }
+    // exported images are left on the device, see exportFrame()
+    if (_externalMemory)
+        return;
+
+    StageTimer timer(Stage::Copy);
+    const size_t pixels = size_t(target.cols) * size_t(target.rows);
+    const auto* planes = static_cast<const uint8_t*>(target.readback.mapped);
+    if (outputFrame.color && sceneView.hasOutputChannel(scene::OutputChannel::Color))
+        std::memcpy(outputFrame.color, planes, pixels * 4);
+    if (outputFrame.depth && sceneView.hasOutputChannel(scene::OutputChannel::Depth))
+        std::memcpy(outputFrame.depth, planes + pixels * 4, pixels * sizeof(float));
+    if (outputFrame.mask && sceneView.hasOutputChannel(scene::OutputChannel::Mask))
+        std::memcpy(outputFrame.mask, planes + pixels * 8, pixels * sizeof(int));
+}
+
+bool VulkanRenderer::renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                                 const std::shared_ptr<scene::SceneView>& sceneView,
+                                 FrameData& outputFrame)
+{
+    const int cols = outputFrame.cols, rows = outputFrame.rows;
+    if (!sceneView->camera() || cols <= 0 || rows <= 0)
+        return false;
+    if (sceneView->projection() != scene::Projection::Perspective)
+        return _panorama.render(*this, sceneState, *sceneView, outputFrame);
+    if (sceneView->hasMultiview())
+        return _multiview.render(*this, sceneState, *sceneView, outputFrame);
+    if (sceneView->hasLensDistortion())
+        return _distorted.render(*this, sceneState, *sceneView, outputFrame);
+    if (sceneView->hasRenderScale())
+        return _scaled.render(*this, sceneState, *sceneView, outputFrame);
+
+    std::vector<FrameData> frames{outputFrame};
+    const bool rendered = renderFrames(sceneState, {sceneView}, frames);
+    outputFrame.numPoints = frames[0].numPoints;
+    return rendered;
+}
+
+bool VulkanRenderer::renderFrames(const std::shared_ptr<scene::SceneState>& sceneState,
+                                  const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                                  std::vector<FrameData>& outputFrames)
+{
+    auto& ctx = *_context;
+    const size_t count = std::min(sceneViews.size(), outputFrames.size());
+    // single pass views drawn at once, the others by renderFrame() afterwards
+    std::vector<size_t> views, others;
+    for (size_t i = 0; i < count; ++i) {
+        const auto& view = *sceneViews[i];
+        const auto& frame = outputFrames[i];
+        if (!view.camera() || frame.cols <= 0 || frame.rows <= 0)
+            continue;
+        const bool singlePass = view.projection() == scene::Projection::Perspective &&
+                                !view.hasMultiview() && !view.hasLensDistortion() &&
+                                !view.hasRenderScale();
+        (singlePass ? views : others).push_back(i);
+    }
+
+    bool rendered = views.size() + others.size() == count;
+    if (!views.empty()) {
+        StageTimer render(Stage::Render);
+        {
+            StageTimer timer(Stage::StateSync);
+            _bvh.update(_bounds, *sceneState);
+        }
+        for (size_t v = 0; v < views.size(); ++v)
+            ctx.target(v, outputFrames[views[v]].cols, outputFrames[views[v]].rows);
+
+        // command buffers of the views recorded by parallel threads, a pool per target
+        std::atomic<size_t> next{0};
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        const auto record = [&]() {
+            for (size_t v = next++; v < views.size(); v = next++) {
+                try {
+                    const auto& frame = outputFrames[views[v]];
+                    recordView(v, *sceneState, *sceneViews[views[v]], frame.cols, frame.rows);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    error = std::current_exception();
+                }
+            }
+        };
+        const size_t numThreads = std::min(size_t(_numThreads), views.size());
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < numThreads; ++t)
+            threads.emplace_back(record);
+        record();
+        for (auto& thread : threads)
+            thread.join();
+        if (error)
+            std::rethrow_exception(error);
+
+        // one submission, each view signaling the timeline semaphore once drawn
+        std::vector<VkSubmitInfo> submits(views.size());
+        std::vector<VkTimelineSemaphoreSubmitInfo> timelines(views.size());
+        for (size_t v = 0; v < views.size(); ++v) {
+            auto& target = *ctx.targets[v];
+            target.timelineValue = ++ctx.timelineValue;
+            timelines[v] = VkTimelineSemaphoreSubmitInfo{
+                VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+            timelines[v].signalSemaphoreValueCount = 1;
+            timelines[v].pSignalSemaphoreValues = &target.timelineValue;
+            submits[v] = VkSubmitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+            submits[v].pNext = &timelines[v];
+            submits[v].commandBufferCount = 1;
+            submits[v].pCommandBuffers = &target.commands;
+            submits[v].signalSemaphoreCount = 1;
+            submits[v].pSignalSemaphores = &ctx.timeline;
+        }
+        {
+            std::lock_guard<std::mutex> lock(ctx.shared->queueMutex);
+            check(vkQueueSubmit(ctx.shared->queue, uint32_t(submits.size()), submits.data(),
+                                VK_NULL_HANDLE),
+                  "vkQueueSubmit");
+        }
+    }
+    // each view copied out while the next ones are drawn
+    for (size_t v = 0; v < views.size(); ++v)
+        readBack(v, *sceneViews[views[v]], outputFrames[views[v]]);
+    for (size_t i : others)
+        rendered = renderFrame(sceneState, sceneViews[i], outputFrames[i]) && rendered;
+    updateMemory();
+    return rendered;
+}
+
+ExternalFrame VulkanRenderer::exportFrame(size_t index) const
+{
+    if (!_externalMemory)
+        throw std::runtime_error("VulkanRenderer: images are not exported, see externalMemory");
+    const auto& ctx = *_context;
+    if (index >= ctx.targets.size() || !ctx.targets[index]->cols)
+        throw std::runtime_error("VulkanRenderer: no view " + std::to_string(index) + " drawn");
+    const auto& target = *ctx.targets[index];
+
+    ExternalFrame frame;
+    VkMemoryGetFdInfoKHR info{VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR};
+    info.memory = target.readback.memory;
+    info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+    check(ctx.shared->getMemoryFd(ctx.device(), &info, &frame.fd), "vkGetMemoryFdKHR");
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(ctx.device(), target.readback.buffer, &requirements);
+    frame.size = size_t(requirements.size);
+    const size_t plane = size_t(Context::planeBytes(target.cols, target.rows));
+    frame.colorOffset = 0;
+    frame.depthOffset = plane;
+    frame.maskOffset = plane * 2;
+    frame.cols = target.cols;
+    frame.rows = target.rows;
+    frame.timelineValue = target.timelineValue;
+    return frame;
+}
+
+int VulkanRenderer::exportTimelineSemaphore() const
+{
+    if (!_externalMemory)
+        throw std::runtime_error("VulkanRenderer: semaphore not exported, see externalMemory");
+    const auto& ctx = *_context;
+    VkSemaphoreGetFdInfoKHR info{VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR};
+    info.semaphore = ctx.timeline;
+    info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+    int fd = -1;
+    check(ctx.shared->getSemaphoreFd(ctx.device(), &info, &fd), "vkGetSemaphoreFdKHR");
+    return fd;
+}
+
+void VulkanRenderer::updateMemory()
+{
+    const auto& ctx = *_context;
+    std::lock_guard<std::mutex> lock(_memoryMutex);
+    _memory.gpuBytes = ctx.gpuBytes();
+    _memory.peakGpuBytes = std::max(ctx.peakGpuBytes, _memory.gpuBytes);
+    _memory.hostBytes = ctx.hostBytes();
+}
+
+RendererMemory VulkanRenderer::memoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(_memoryMutex);
+    return _memory;
+}
+
+} // namespace render
@@ -0,0 +1,177 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BaseRenderer.h"
+#include "DistortedFrame.h"
+#include "MultiviewFrame.h"
+#include "PanoramaFaces.h"
+#include "ScaledFrame.h"
+
+#include <scene/BVH.h>
+#include <scene/MeshLod.h>
+#include <scene/SceneBounds.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace render {
+
+/**
+ * @brief Images of a view left in exported device memory, see VulkanRenderer::exportFrame()
+ *
+ * Planes are packed in one buffer, top row first: RGBA8 color, float metric depth and int mask,
+ * at their offsets. They are written once the timeline semaphore reaches timelineValue.
+ */
+struct ExternalFrame {
+    int fd = -1; //<- opaque file descriptor of the memory, owned by the caller
+    size_t size = 0; //<- bytes of the memory
+    size_t colorOffset = 0;
+    size_t depthOffset = 0;
+    size_t maskOffset = 0;
+    int cols = 0; //<- image width
+    int rows = 0; //<- image height
+    uint64_t timelineValue = 0; //<- semaphore value signaled once the frame is drawn
+};
+
+/**
+ * @brief Headless Vulkan renderer
+ *
+ * Renders color, metric depth and segmentation mask images with diffuse lighting from the scene
+ * view light, as the EGLRenderer without its shadows, heightfields and extra outputs. Meshes
+ * and textures are uploaded once to device local memory and shared by all shapes using them.
+ *
+ * Renderers of a device share its VkDevice and queue, each with command pools and targets of
+ * its own, so that renderers of several environments draw from as many threads at once, only
+ * their submissions being serialized. renderFrames() records the command buffers of its views
+ * in parallel, each view drawing into a target of its own, submits them at once and reads each
+ * view back as soon as the timeline semaphore of the renderer reaches its value, while the GPU
+ * draws the next ones.
+ *
+ * With external memory, the images of each view are copied into device memory exported as an
+ * opaque file descriptor, e.g. for cudaImportExternalMemory, instead of being read back, the
+ * timeline semaphore being exported likewise for cudaImportExternalSemaphore.
+ *
+ * Panoramic views are rendered face by face, see PanoramaFaces, views of a render scale at
+ * their internal resolution, see ScaledFrame, views with lens distortion as pinhole images,
+ * see DistortedFrame, and multiview views one after the other, see MultiviewFrame.
+ */
+class VulkanRenderer : public BaseRenderer
+{
+  public:
+    /**
+     * @brief Create a renderer on a Vulkan device
+     *
+     * @param device - index of the physical device with a graphics queue, -1 for the first one
+     * @param numThreads - threads recording the views of renderFrames(), 0 for one per core up
+     * to 8
+     * @param externalMemory - export the images and the timeline semaphore, see exportFrame()
+     *
+     * @throw std::runtime_error - no such device, or one without timeline semaphores, or without
+     * external memory when requested
+     */
+    explicit VulkanRenderer(int device = -1, int numThreads = 0, bool externalMemory = false);
+
+    /**
+     * @brief Destroy the renderer, waiting for its frames
+     */
+    ~VulkanRenderer() override;
+
+    VulkanRenderer(const VulkanRenderer&) = delete;
+    VulkanRenderer& operator=(const VulkanRenderer&) = delete;
+
+    /**
+     * @brief Index of the physical device
+     */
+    int device() const { return _device; }
+
+    /**
+     * @brief Images are exported instead of read back, see exportFrame()
+     */
+    bool externalMemory() const { return _externalMemory; }
+
+    /**
+     * @brief Update a scene using \p sceneGraph description
+     */
+    void updateScene(const std::shared_ptr<scene::SceneGraph>& sceneGraph,
+                     bool materialsOnly) override;
+
+    /**
+     * @brief Change the color of a shape in place, false for a new texture
+     */
+    bool updateShapeMaterial(int nodeId, int shapeIndex,
+                             const std::shared_ptr<scene::Material>& material) override;
+
+    /**
+     * @brief Render a scene at state \p sceneState with a view settings \p sceneView
+     *
+     * @return False if the view has no camera
+     */
+    bool renderFrame(const std::shared_ptr<scene::SceneState>& sceneState,
+                     const std::shared_ptr<scene::SceneView>& sceneView,
+                     FrameData& outputFrame) override;
+
+    /**
+     * @brief Render views recorded in parallel and submitted at once, read back in turn
+     *
+     * Views needing several passes, e.g. panoramic ones, are rendered after the others by
+     * renderFrame().
+     */
+    bool renderFrames(const std::shared_ptr<scene::SceneState>& sceneState,
+                      const std::vector<std::shared_ptr<scene::SceneView>>& sceneViews,
+                      std::vector<FrameData>& outputFrames) override;
+
+    /**
+     * @brief Exported images of view \p index of the last renderFrame() or renderFrames()
+     *
+     * Each call exports a new file descriptor of the memory.
+     *
+     * @throw std::runtime_error - without external memory, or no such view
+     */
+    ExternalFrame exportFrame(size_t index = 0) const;
+
+    /**
+     * @brief New file descriptor of the timeline semaphore, see ExternalFrame::timelineValue
+     *
+     * @throw std::runtime_error - without external memory
+     */
+    int exportTimelineSemaphore() const;
+
+    /**
+     * @brief GPU memory of the meshes, textures and targets, host memory of the readback
+     */
+    RendererMemory memoryUsage() const override;
+
+  private:
+    struct Context; //<- Vulkan objects of the renderer, see EGLRenderer::Context
+    struct Item; //<- shape drawn
+
+    void updateNode(int nodeId, const scene::Node& node);
+    void recordView(size_t index, const scene::SceneState& sceneState,
+                    const scene::SceneView& sceneView, int cols, int rows);
+    void readBack(size_t index, const scene::SceneView& sceneView, FrameData& outputFrame);
+    void updateMemory();
+
+    std::unique_ptr<Context> _context;
+    int _device = -1;
+    int _numThreads = 1;
+    bool _externalMemory = false;
+    std::map<int, std::vector<Item>> _items; //<- node id -> shapes drawn
+    scene::SceneBounds _bounds; //<- node bounds, for frustum culling
+    scene::BVH _bvh; //<- world bounds of nodes, refitted each frame
+    scene::LodPolicy _lodPolicy; //<- mesh level of detail from its screen size
+    scene::SegmentationMode _segmentationMode = scene::SegmentationMode::BodyLink;
+    PanoramaFaces _panorama; //<- faces of panoramic views
+    ScaledFrame _scaled; //<- views of a render scale
+    DistortedFrame _distorted; //<- views with lens distortion
+    MultiviewFrame _multiview; //<- views of several cameras
+    mutable std::mutex _memoryMutex;
+    RendererMemory _memory; //<- published by the rendering thread
+};
+
+} // namespace render
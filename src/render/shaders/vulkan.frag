@@ -0,0 +1,33 @@
+#version 450
+// color, metric depth and mask of the VulkanRenderer, lit as by the EGLRenderer
+layout(set = 0, binding = 0) uniform View {
+    mat4 view;
+    mat4 viewProj;
+    vec4 lightDirection;
+    vec4 ambientColor;
+    vec4 diffuseColor;
+};
+layout(set = 1, binding = 0) uniform sampler2D diffuseTexture;
+layout(push_constant) uniform Draw {
+    mat4 model;
+    vec4 diffuse;
+    int segmentation;
+    int textured;
+};
+layout(location = 0) in vec3 worldNormal;
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) in float eyeDepth;
+layout(location = 0) out vec4 color;
+layout(location = 1) out float depth;
+layout(location = 2) out int mask;
+void main()
+{
+    vec4 albedo = diffuse;
+    if (textured != 0)
+        albedo *= texture(diffuseTexture, texCoord);
+    // faces are not culled, light both sides
+    float lambert = abs(dot(normalize(worldNormal), normalize(lightDirection.xyz)));
+    color = vec4(albedo.rgb * (ambientColor.rgb + diffuseColor.rgb * lambert), albedo.a);
+    depth = eyeDepth;
+    mask = segmentation;
+}
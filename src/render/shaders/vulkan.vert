@@ -0,0 +1,33 @@
+#version 450
+// mesh shapes of the VulkanRenderer, interleaved position, normal and uv vertices
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+layout(set = 0, binding = 0) uniform View {
+    mat4 view;
+    mat4 viewProj;
+    vec4 lightDirection;
+    vec4 ambientColor;
+    vec4 diffuseColor;
+};
+layout(push_constant) uniform Draw {
+    mat4 model;
+    vec4 diffuse;
+    int segmentation;
+    int textured;
+};
+layout(location = 0) out vec3 worldNormal;
+layout(location = 1) out vec2 texCoord;
+layout(location = 2) out float eyeDepth;
+void main()
+{
+    worldNormal = transpose(inverse(mat3(model))) * normal;
+    // bitmaps are stored top row first
+    texCoord = vec2(uv.x, 1.0 - uv.y);
+    vec4 world = model * vec4(position, 1.0);
+    eyeDepth = -(view * world).z;
+    gl_Position = viewProj * world;
+    // projections are those of OpenGL: rows go down and depth starts at 0 in Vulkan clip space
+    gl_Position.y = -gl_Position.y;
+    gl_Position.z = (gl_Position.z + gl_Position.w) * 0.5;
+}
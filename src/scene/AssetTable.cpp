@@ -0,0 +1,123 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "AssetTable.h"
+#include "Mesh.h"
+#include "Texture.h"
+
+#include <utility>
+
+namespace scene {
+
+namespace {
+
+/// payloads of fetch(), by hash
+using MeshPayloads = std::vector<std::pair<uint64_t, std::shared_ptr<MeshData>>>;
+using BitmapPayloads = std::vector<std::pair<uint64_t, std::shared_ptr<Bitmap>>>;
+
+/// register data written, true if it must be written in full
+template <class T>
+bool writeData(const std::shared_ptr<T>& data, uint64_t hash, bool embedNew,
+               std::unordered_map<uint64_t, std::shared_ptr<T>>& table,
+               std::set<uint64_t>& written)
+{
+    if (!embedNew) {
+        table.emplace(hash, data); //<- kept for fetch()
+        return false;
+    }
+    return table.count(hash) == 0 && written.insert(hash).second;
+}
+
+/// data of the table, \p data itself or the placeholder waiting for it filled
+template <class T>
+std::shared_ptr<T> readData(uint64_t hash, std::shared_ptr<T>&& data,
+                            std::unordered_map<uint64_t, std::shared_ptr<T>>& table,
+                            std::set<uint64_t>& missing)
+{
+    auto& entry = table[hash];
+    if (!entry) {
+        entry = std::move(data);
+    }
+    else if (missing.erase(hash)) {
+        *entry = std::move(*data);
+    }
+    return entry;
+}
+
+} // namespace
+
+bool AssetTable::write(const std::shared_ptr<MeshData>& data)
+{
+    return writeData(data, data->hash(), _embedNew, _meshes, _written);
+}
+
+bool AssetTable::write(const std::shared_ptr<Bitmap>& bitmap)
+{
+    return writeData(bitmap, bitmap->hash(), _embedNew, _bitmaps, _written);
+}
+
+std::shared_ptr<MeshData> AssetTable::read(uint64_t hash, std::shared_ptr<MeshData>&& data)
+{
+    return readData(hash, std::move(data), _meshes, _missing);
+}
+
+std::shared_ptr<Bitmap> AssetTable::read(uint64_t hash, std::shared_ptr<Bitmap>&& bitmap)
+{
+    return readData(hash, std::move(bitmap), _bitmaps, _missing);
+}
+
+std::shared_ptr<MeshData> AssetTable::meshData(uint64_t hash)
+{
+    auto& entry = _meshes[hash];
+    if (!entry) {
+        // distinct placeholders compare unequal until filled
+        entry = std::make_shared<MeshData>();
+        entry->_hash.set(hash);
+        _missing.insert(hash);
+    }
+    return entry;
+}
+
+std::shared_ptr<Bitmap> AssetTable::bitmap(uint64_t hash)
+{
+    auto& entry = _bitmaps[hash];
+    if (!entry) {
+        entry = std::make_shared<Bitmap>();
+        entry->_hash.set(hash);
+        _missing.insert(hash);
+    }
+    return entry;
+}
+
+std::string AssetTable::fetch(const std::vector<uint64_t>& hashes) const
+{
+    std::pair<MeshPayloads, BitmapPayloads> payloads;
+    for (uint64_t hash : hashes) {
+        if (_missing.count(hash))
+            continue; //<- a placeholder of this table
+        const auto mesh = _meshes.find(hash);
+        if (mesh != _meshes.end())
+            payloads.first.emplace_back(hash, mesh->second);
+        const auto bitmap = _bitmaps.find(hash);
+        if (bitmap != _bitmaps.end())
+            payloads.second.emplace_back(hash, bitmap->second);
+    }
+    return BinarySerialize(payloads);
+}
+
+int AssetTable::supply(const std::string& payloads)
+{
+    std::pair<MeshPayloads, BitmapPayloads> data;
+    BinaryDeserialize(payloads, data);
+    const size_t missing = _missing.size();
+    for (auto& it : data.first)
+        if (it.second)
+            read(it.first, std::move(it.second));
+    for (auto& it : data.second)
+        if (it.second)
+            read(it.first, std::move(it.second));
+    return int(missing - _missing.size());
+}
+
+} // namespace scene
@@ -0,0 +1,164 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <utils/serialization.h>
+
+#include <cereal/archives/adapters.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace scene {
+
+class Bitmap;
+class MeshData;
+
+/**
+ * @brief Mesh data and bitmaps exchanged by content hash, see serializeWithReferences()
+ *
+ * Each end of a link, e.g. a remote renderer and its server or a process and its workers,
+ * keeps one table. Written with a table, a mesh or texture of the asset caches, with an asset
+ * id, carries the content hash of its data instead of the data itself, except for new data of
+ * a table made with embedNew, written in full once and by hash afterwards. Other data, which
+ * may be rewritten in place, is still written in full and left out of the tables.
+ *
+ * Read with a table, hashes resolve to the data of the table, received in full before or
+ * supplied. Data not found is an empty placeholder listed in missing(), filled in place by
+ * supply() with the payloads fetch() returns on the writing end, so that objects read before
+ * see it too.
+ *
+ * Not thread-safe. Full payloads, the default without a table, remain for standalone archives.
+ */
+class AssetTable
+{
+  public:
+    /**
+     * @brief Construct a new AssetTable object
+     *
+     * @param embedNew - write data the table does not know in full, once, e.g. over a
+     * connection to a single reader; otherwise only hashes are written and data is kept for
+     * fetch()
+     */
+    explicit AssetTable(bool embedNew = false) : _embedNew(embedNew) {}
+
+    /**
+     * @brief Data is written in full the first time
+     */
+    bool embedNew() const { return _embedNew; }
+
+    /**
+     * @brief Register data being written
+     *
+     * @return True if the data must be written in full, false for its hash only
+     */
+    bool write(const std::shared_ptr<MeshData>& data);
+    /** @overload */
+    bool write(const std::shared_ptr<Bitmap>& bitmap);
+
+    /**
+     * @brief Register data read in full
+     *
+     * @return Data of the table with this hash, \p data unless a placeholder was waiting for it
+     */
+    std::shared_ptr<MeshData> read(uint64_t hash, std::shared_ptr<MeshData>&& data);
+    /** @overload */
+    std::shared_ptr<Bitmap> read(uint64_t hash, std::shared_ptr<Bitmap>&& bitmap);
+
+    /**
+     * @brief Data of the table with this hash, a new placeholder listed missing if none
+     */
+    std::shared_ptr<MeshData> meshData(uint64_t hash);
+    /** @overload */
+    std::shared_ptr<Bitmap> bitmap(uint64_t hash);
+
+    /**
+     * @brief Hashes of the placeholders waiting for their data
+     */
+    const std::set<uint64_t>& missing() const { return _missing; }
+
+    /**
+     * @brief Payloads of data held by the table, for supply() on the reading end
+     *
+     * @param hashes - requested hashes, those unknown are skipped
+     */
+    std::string fetch(const std::vector<uint64_t>& hashes) const;
+
+    /**
+     * @brief Fill the placeholders with payloads made by fetch()
+     *
+     * @return Number of placeholders filled
+     * @throw cereal::Exception - if the payloads are truncated
+     */
+    int supply(const std::string& payloads);
+
+    /**
+     * @brief Number of distinct data known, placeholders included
+     */
+    size_t size() const { return _meshes.size() + _bitmaps.size() + _written.size(); }
+
+    /**
+     * @brief Forget all data, e.g. when the other end starts over
+     */
+    void clear()
+    {
+        _meshes.clear();
+        _bitmaps.clear();
+        _written.clear();
+        _missing.clear();
+    }
+
+  private:
+    bool _embedNew;
+    std::unordered_map<uint64_t, std::shared_ptr<MeshData>> _meshes;
+    std::unordered_map<uint64_t, std::shared_ptr<Bitmap>> _bitmaps;
+    std::set<uint64_t> _written; //<- hashes written in full with embedNew, data not kept
+    std::set<uint64_t> _missing;
+};
+
+/**
+ * @brief Table of an archive wrapped by serializeWithReferences(), null for full payloads
+ */
+template <class Archive>
+AssetTable* assetTable(Archive& ar)
+{
+    auto adapter = dynamic_cast<cereal::UserDataAdapter<AssetTable, Archive>*>(&ar);
+    return adapter ? &adapter->userdata : nullptr;
+}
+
+/**
+ * @brief Serialize an object, its mesh data and bitmaps as references into \p table
+ *
+ * The bytes are read by deserializeWithReferences() only.
+ */
+template <class T>
+std::string serializeWithReferences(const T& object, AssetTable& table)
+{
+    std::ostringstream stream;
+    {
+        cereal::UserDataAdapter<AssetTable, cereal::BinaryOutputArchive> archive(table, stream);
+        archive(object);
+    }
+    return stream.str();
+}
+
+/**
+ * @brief Deserialize an object written by serializeWithReferences()
+ *
+ * @throw cereal::Exception - if the buffer is too short
+ */
+template <class T>
+void deserializeWithReferences(const uint8_t* data, size_t size, T& object, AssetTable& table)
+{
+    cereal::UserDataAdapter<AssetTable, cereal::BufferInputArchive> archive(table, data, size);
+    archive(object);
+}
+
+} // namespace scene
@@ -0,0 +1,423 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Bounds.h"
+#include "SceneBounds.h"
+#include "SceneGraph.h"
+#include "SceneState.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Bounding volume hierarchy over the world bounds of scene nodes
+ *
+ * A binary tree of boxes, one leaf per node, in the spirit of Bullet's btDbvt. The tree is
+ * rebuilt when the set of nodes or their local bounds change, and refitted from the dirty flags
+ * of the SceneState otherwise, moving only the leaves of moved nodes. It answers frustum, ray
+ * and box overlap queries in time proportional to the number of hits, so that culling,
+ * picking and ray-cast sensors can share it.
+ *
+ * Nodes with infinite bounds are kept out of the tree and reported by every query, nodes with
+ * empty bounds are never reported.
+ */
+class BVH
+{
+  public:
+    /**
+     * @brief Synchronize with the bounds cached by a renderer
+     *
+     * Rebuilds the tree when \p bounds changed since the previous call, refits the leaves of
+     * the nodes flagged dirty in \p sceneState otherwise. Must be called before dirty flags are
+     * cleared, e.g. once per frame.
+     *
+     * @param bounds - node bounds in node frames
+     * @param sceneState - scene state holding node poses
+     */
+    void update(const SceneBounds& bounds, const SceneState& sceneState)
+    {
+        if (needsRebuild(&bounds, bounds.generation(), sceneState))
+            rebuild(&bounds, bounds.generation(), bounds.nodes(), sceneState,
+                    [](const AABB& local) { return local; });
+        else
+            refit(sceneState);
+    }
+
+    /**
+     * @brief Synchronize with a scene
+     *
+     * Rebuilds the tree when \p sceneGraph changed since the previous call, refits the leaves of
+     * the nodes flagged dirty in \p sceneState otherwise.
+     *
+     * @param sceneGraph - scene description
+     * @param sceneState - scene state holding node poses
+     */
+    void update(const SceneGraph& sceneGraph, const SceneState& sceneState)
+    {
+        if (needsRebuild(&sceneGraph, sceneGraph.generation(), sceneState))
+            rebuild(&sceneGraph, sceneGraph.generation(), sceneGraph.nodes(), sceneState,
+                    [](const Node& node) { return node.bounds(); });
+        else
+            refit(sceneState);
+    }
+
+    /**
+     * @brief Force a rebuild at the next update, e.g. to restore the tree quality after large
+     * motions
+     */
+    void invalidate() { _source = nullptr; }
+
+    /**
+     * @brief Remove all nodes
+     */
+    void clear()
+    {
+        _tree.clear();
+        _leaves.clear();
+        _unbounded.clear();
+        _root = -1;
+        _source = nullptr;
+    }
+
+    /**
+     * @brief Number of nodes in the hierarchy, with infinite bounds or not
+     */
+    int size() const { return int(_leaves.size()); }
+
+    /**
+     * @brief Bounds of the nodes in the tree, empty if none
+     */
+    AABB bounds() const { return _root >= 0 ? _tree[_root].box : AABB::Empty(); }
+
+    /**
+     * @brief World bounds of a node as last updated
+     *
+     * @param nodeId - unique node id
+     * @throw std::out_of_range - if the node is not in the hierarchy
+     */
+    AABB worldBounds(int nodeId) const
+    {
+        const int leaf = _leaves.at(nodeId);
+        return leaf >= 0 ? _tree[leaf].box : AABB::Infinite();
+    }
+
+    /**
+     * @brief Nodes left to visit by a query, kept by callers querying every frame
+     */
+    using Stack = std::vector<std::pair<int, bool>>;
+
+    /**
+     * @brief Ids of nodes whose bounds intersect a frustum, in increasing order
+     */
+    std::vector<int> query(const Frustum& frustum) const
+    {
+        std::vector<int> ids;
+        Stack stack;
+        query(frustum, ids, stack);
+        return ids;
+    }
+
+    /**
+     * @brief Ids of nodes whose bounds intersect a frustum into \p ids, in increasing order
+     *
+     * Reuses the capacity of \p ids and \p stack, so that repeated queries do not allocate.
+     */
+    void query(const Frustum& frustum, std::vector<int>& ids, Stack& stack) const
+    {
+        ids.assign(_unbounded.begin(), _unbounded.end());
+        traverse([&](const AABB& box) { return frustum.intersects(box); },
+                 [&](const AABB& box) { return frustum.contains(box); }, ids, stack);
+        std::sort(ids.begin(), ids.end());
+    }
+
+    /**
+     * @brief Ids of nodes whose bounds intersect a frustum and are not hidden, in increasing
+     * order
+     *
+     * Subtrees whose bounds are hidden are skipped as a whole: \p hidden must be conservative,
+     * a box holding a visible one never being hidden, as occlusion tests are. Reuses the
+     * capacity of \p ids and \p stack.
+     *
+     * @param frustum - view frustum
+     * @param hidden - box test, true if nothing in the box can be seen
+     */
+    template <class Hidden>
+    void query(const Frustum& frustum, const Hidden& hidden, std::vector<int>& ids,
+               Stack& stack) const
+    {
+        ids.assign(_unbounded.begin(), _unbounded.end());
+        traverse([&](const AABB& box) { return frustum.intersects(box) && !hidden(box); },
+                 [](const AABB&) { return false; }, ids, stack);
+        std::sort(ids.begin(), ids.end());
+    }
+
+    /**
+     * @brief Ids of nodes whose bounds may be seen by a camera, in increasing order
+     */
+    std::vector<int> query(const Camera& camera) const
+    {
+        return query(Frustum(multiply(camera.projMatrix(), camera.viewMatrix())));
+    }
+
+    /**
+     * @brief Ids of nodes whose bounds overlap a box, in increasing order
+     */
+    std::vector<int> query(const AABB& box) const
+    {
+        std::vector<int> ids;
+        if (box.empty())
+            return ids;
+
+        ids = _unbounded;
+        traverse([&](const AABB& node) { return node.overlaps(box); },
+                 [](const AABB&) { return false; }, ids);
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    /**
+     * @brief Nodes whose bounds are hit by a ray, closest first
+     *
+     * Nodes with infinite bounds are reported at distance 0.
+     *
+     * @param origin - ray origin
+     * @param direction - ray direction, not necessarily normalized
+     * @param maxDistance - ray length, in units of \p direction
+     * @return Pairs of node id and distance at which the ray enters its bounds
+     */
+    std::vector<std::pair<int, float>> raycast(const Vector3f& origin, const Vector3f& direction,
+                                               float maxDistance) const
+    {
+        std::vector<std::pair<int, float>> hits;
+        for (int nodeId : _unbounded)
+            hits.emplace_back(nodeId, 0.f);
+
+        const Vector3f invDirection{1.f / direction[0], 1.f / direction[1], 1.f / direction[2]};
+        float distance = 0.f;
+        std::vector<int> ids;
+        traverse(
+            [&](const AABB& box) {
+                return box.intersectsRay(origin, invDirection, maxDistance, distance);
+            },
+            [](const AABB&) { return false; }, ids);
+        for (int nodeId : ids) {
+            _tree[_leaves.at(nodeId)].box.intersectsRay(origin, invDirection, maxDistance,
+                                                        distance);
+            hits.emplace_back(nodeId, distance);
+        }
+        std::sort(hits.begin(), hits.end(), [](const std::pair<int, float>& a,
+                                               const std::pair<int, float>& b) {
+            return a.second < b.second || (a.second == b.second && a.first < b.first);
+        });
+        return hits;
+    }
+
+    /**
+     * @brief Ids of nodes whose bounds are accepted by \p test into \p ids, in no order
+     *
+     * Nodes with infinite bounds are always reported. For custom queries, e.g. a packet of
+     * rays tested at once, that reuse the capacity of \p ids and \p stack.
+     *
+     * @param test - box test, true if the box may hold a node of interest
+     */
+    template <class Test>
+    void collect(const Test& test, std::vector<int>& ids, Stack& stack) const
+    {
+        ids.assign(_unbounded.begin(), _unbounded.end());
+        traverse(test, [](const AABB&) { return false; }, ids, stack);
+    }
+
+  private:
+    struct TreeNode {
+        AABB box; //<- world bounds of the subtree
+        AABB local; //<- leaf bounds in the node frame
+        int parent;
+        int left; //<- -1 for leaves
+        int right;
+        int nodeId; //<- scene node of a leaf, -1 for inner nodes
+    };
+
+    bool needsRebuild(const void* source, uint64_t generation, const SceneState& sceneState) const
+    {
+        return source != _source || generation != _generation || sceneState.size() != _stateSize;
+    }
+
+    template <class Map, class BoundsOf>
+    void rebuild(const void* source, uint64_t generation, const Map& nodes,
+                 const SceneState& sceneState, const BoundsOf& boundsOf)
+    {
+        clear();
+        for (const auto& it : nodes) {
+            if (!sceneState.hasNode(it.first))
+                continue;
+            const AABB local = boundsOf(it.second);
+            if (local.empty())
+                continue;
+            if (local.infinite()) {
+                _leaves.emplace(it.first, -1);
+                _unbounded.push_back(it.first);
+                continue;
+            }
+            _leaves.emplace(it.first, int(_tree.size()));
+            _tree.push_back(TreeNode{local.transformed(sceneState.matrix(it.first)), local, -1,
+                                     -1, -1, it.first});
+        }
+
+        std::vector<int> leaves(_tree.size());
+        for (int i = 0; i < int(leaves.size()); ++i)
+            leaves[i] = i;
+        _root = leaves.empty() ? -1 : split(leaves.begin(), leaves.end(), -1);
+
+        _source = source;
+        _generation = generation;
+        _stateSize = sceneState.size();
+    }
+
+    /**
+     * @brief Top-down build, splitting leaf centroids at the median of the longest axis
+     */
+    int split(std::vector<int>::iterator begin, std::vector<int>::iterator end, int parent)
+    {
+        if (end - begin == 1) {
+            _tree[*begin].parent = parent;
+            return *begin;
+        }
+
+        AABB centroids = AABB::Empty();
+        for (auto it = begin; it != end; ++it)
+            centroids.extend(centroid(_tree[*it].box));
+        int axis = 0;
+        for (int k = 1; k < 3; ++k)
+            if (centroids.upper[k] - centroids.lower[k] >
+                centroids.upper[axis] - centroids.lower[axis])
+                axis = k;
+
+        const auto middle = begin + (end - begin) / 2;
+        std::nth_element(begin, middle, end, [&](int a, int b) {
+            return centroid(_tree[a].box)[axis] < centroid(_tree[b].box)[axis];
+        });
+
+        const int node = int(_tree.size());
+        _tree.push_back(TreeNode{AABB::Empty(), AABB::Empty(), parent, -1, -1, -1});
+        const int left = split(begin, middle, node);
+        const int right = split(middle, end, node);
+        _tree[node].left = left;
+        _tree[node].right = right;
+        _tree[node].box = _tree[left].box;
+        _tree[node].box.extend(_tree[right].box);
+        return node;
+    }
+
+    /**
+     * @brief Move the leaves of dirty nodes, growing or shrinking their ancestors
+     *
+     * Leaves of the dirty nodes are transformed at once, see transformBoxes().
+     */
+    void refit(const SceneState& sceneState)
+    {
+        const auto& ids = sceneState.ids();
+        const auto& dirty = sceneState.dirty();
+        const auto& matrices = sceneState.matrices();
+        _moved.clear();
+        _movedLocal.clear();
+        _movedMatrices.clear();
+        for (int slot = 0; slot < int(ids.size()); ++slot) {
+            if (!dirty[slot])
+                continue;
+            const auto it = _leaves.find(ids[slot]);
+            if (it == _leaves.end() || it->second < 0)
+                continue;
+            _moved.push_back(it->second);
+            _movedLocal.push_back(_tree[it->second].local);
+            _movedMatrices.push_back(matrices[slot]);
+        }
+        _movedBoxes.resize(_moved.size());
+        transformBoxes(_movedLocal.data(), _movedMatrices.data(), _moved.size(),
+                       _movedBoxes.data());
+
+        for (size_t i = 0; i < _moved.size(); ++i) {
+            TreeNode& leaf = _tree[_moved[i]];
+            const AABB& box = _movedBoxes[i];
+            if (box == leaf.box)
+                continue;
+            leaf.box = box;
+            for (int node = leaf.parent; node >= 0; node = _tree[node].parent) {
+                AABB parentBox = _tree[_tree[node].left].box;
+                parentBox.extend(_tree[_tree[node].right].box);
+                if (parentBox == _tree[node].box)
+                    break;
+                _tree[node].box = parentBox;
+            }
+        }
+    }
+
+    /**
+     * @brief Collect leaves of subtrees accepted by \p test, without testing the leaves of
+     * subtrees accepted by \p inside
+     */
+    template <class Test, class Inside>
+    void traverse(const Test& test, const Inside& inside, std::vector<int>& ids) const
+    {
+        Stack stack;
+        traverse(test, inside, ids, stack);
+    }
+
+    /** @overload */
+    template <class Test, class Inside>
+    void traverse(const Test& test, const Inside& inside, std::vector<int>& ids,
+                  Stack& stack) const
+    {
+        if (_root < 0)
+            return;
+
+        stack.assign(1, {_root, false}); //<- node, known inside
+        while (!stack.empty()) {
+            const int index = stack.back().first;
+            bool known = stack.back().second;
+            stack.pop_back();
+
+            const TreeNode& node = _tree[index];
+            if (!known) {
+                if (!test(node.box))
+                    continue;
+                known = inside(node.box);
+            }
+            if (node.nodeId >= 0) {
+                ids.push_back(node.nodeId);
+                continue;
+            }
+            stack.emplace_back(node.left, known);
+            stack.emplace_back(node.right, known);
+        }
+    }
+
+    static Vector3f centroid(const AABB& box)
+    {
+        return {(box.lower[0] + box.upper[0]) / 2, (box.lower[1] + box.upper[1]) / 2,
+                (box.lower[2] + box.upper[2]) / 2};
+    }
+
+    std::vector<TreeNode> _tree; //<- leaves first, then inner nodes
+    std::map<int, int> _leaves; //<- node id -> leaf index, -1 for infinite bounds
+    std::vector<int> _unbounded; //<- ids of nodes with infinite bounds
+    int _root = -1;
+    // synchronization state
+    const void* _source = nullptr; //<- scene graph or scene bounds the tree was built from
+    uint64_t _generation = 0;
+    int _stateSize = 0;
+    // scratch of refit(): leaves of the dirty nodes, their local bounds, matrices and boxes
+    std::vector<int> _moved;
+    std::vector<AABB> _movedLocal;
+    std::vector<Matrix4f> _movedMatrices;
+    std::vector<AABB> _movedBoxes;
+};
+
+} // namespace scene
@@ -0,0 +1,321 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <utils/math.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Axis aligned bounding box
+ *
+ * An empty box (lower above upper) contains nothing, an infinite one stands for unknown bounds,
+ * e.g. a mesh file not loaded yet, and is never culled.
+ */
+struct AABB {
+    Vector3f lower;
+    Vector3f upper;
+
+    /**
+     * @brief Box containing nothing
+     */
+    static AABB Empty()
+    {
+        const float inf = std::numeric_limits<float>::infinity();
+        return AABB{{inf, inf, inf}, {-inf, -inf, -inf}};
+    }
+
+    /**
+     * @brief Box containing everything
+     */
+    static AABB Infinite()
+    {
+        const float inf = std::numeric_limits<float>::infinity();
+        return AABB{{-inf, -inf, -inf}, {inf, inf, inf}};
+    }
+
+    /**
+     * @brief Bounds of packed (x, y, z) vertex coordinates
+     */
+    static AABB FromVertices(const std::vector<float>& vertices)
+    {
+        AABB box = Empty();
+        for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+            box.extend(Vector3f{vertices[i], vertices[i + 1], vertices[i + 2]});
+        return box;
+    }
+
+    /**
+     * @brief Box contains nothing
+     */
+    bool empty() const
+    {
+        return lower[0] > upper[0] || lower[1] > upper[1] || lower[2] > upper[2];
+    }
+
+    /**
+     * @brief Box has an infinite side
+     */
+    bool infinite() const
+    {
+        for (int k = 0; k < 3; ++k)
+            if (std::isinf(lower[k]) || std::isinf(upper[k]))
+                return !empty();
+        return false;
+    }
+
+    /**
+     * @brief Grow the box to contain point \p p
+     */
+    void extend(const Vector3f& p)
+    {
+        for (int k = 0; k < 3; ++k) {
+            lower[k] = std::min(lower[k], p[k]);
+            upper[k] = std::max(upper[k], p[k]);
+        }
+    }
+
+    /**
+     * @brief Grow the box to contain box \p other
+     */
+    void extend(const AABB& other)
+    {
+        if (other.empty())
+            return;
+        extend(other.lower);
+        extend(other.upper);
+    }
+
+    /**
+     * @brief Bounds of the box transformed by a column-major 4x4 affine matrix
+     */
+    AABB transformed(const Matrix4f& m) const
+    {
+        if (empty() || infinite())
+            return *this;
+
+        // extent of each row of the rotation-scale part over the box
+        AABB box{{m[12], m[13], m[14]}, {m[12], m[13], m[14]}};
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 3; ++col) {
+                const float a = m[col * 4 + row] * lower[col];
+                const float b = m[col * 4 + row] * upper[col];
+                box.lower[row] += std::min(a, b);
+                box.upper[row] += std::max(a, b);
+            }
+        }
+        return box;
+    }
+
+    /**
+     * @brief Boxes share at least one point
+     */
+    bool overlaps(const AABB& other) const
+    {
+        for (int k = 0; k < 3; ++k)
+            if (lower[k] > other.upper[k] || upper[k] < other.lower[k])
+                return false;
+        return true;
+    }
+
+    /**
+     * @brief Distance along a ray at which it enters the box
+     *
+     * @param origin - ray origin
+     * @param invDirection - inverse of the ray direction components
+     * @param maxDistance - ray length, in units of the direction
+     * @param distance - entry distance, 0 if the origin is inside the box
+     * @return True if the ray hits the box within \p maxDistance
+     */
+    bool intersectsRay(const Vector3f& origin, const Vector3f& invDirection, float maxDistance,
+                       float& distance) const
+    {
+        float tmin = 0.f, tmax = maxDistance;
+        for (int k = 0; k < 3; ++k) {
+            float t0 = (lower[k] - origin[k]) * invDirection[k];
+            float t1 = (upper[k] - origin[k]) * invDirection[k];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            // NaN from a zero direction on a slab boundary keeps the previous bounds
+            tmin = t0 > tmin ? t0 : tmin;
+            tmax = t1 < tmax ? t1 : tmax;
+            if (tmin > tmax)
+                return false;
+        }
+        distance = tmin;
+        return true;
+    }
+
+    /**
+     * @brief Comparison operators
+     */
+    bool operator==(const AABB& other) const
+    {
+        return lower == other.lower && upper == other.upper;
+    }
+    bool operator!=(const AABB& other) const { return !(*this == other); }
+
+    /**
+     * @brief Serialization
+     */
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(lower, upper);
+    }
+};
+
+/**
+ * @brief Bounds of boxes transformed by their matrices, as AABB::transformed() for each one
+ *
+ * Boxes are transformed kWidth at a time, see MathLanes, empty and infinite ones being kept.
+ *
+ * @param boxes - boxes, e.g. local bounds of nodes
+ * @param matrices - column-major affine matrices, one per box
+ * @param count - number of boxes
+ * @param result - output bounds, may be \p boxes
+ */
+inline void transformBoxes(const AABB* boxes, const Matrix4f* matrices, size_t count,
+                           AABB* result)
+{
+    size_t i = 0;
+#ifdef PYBULLET_RENDERING_MATH_SIMD
+    using L = MathLanes;
+    for (; i + L::kWidth <= count; i += L::kWidth) {
+        unsigned kept = 0;
+        for (size_t j = 0; j < L::kWidth; ++j)
+            if (boxes[i + j].empty() || boxes[i + j].infinite())
+                kept |= 1u << j;
+
+        L::Type m[16], lower[3], upper[3];
+        L::loadMatrices([&](size_t j) { return matrices[i + j].data(); }, m);
+        for (int k = 0; k < 3; ++k) {
+            lower[k] = L::gather([&](size_t j) { return boxes[i + j].lower[k]; });
+            upper[k] = L::gather([&](size_t j) { return boxes[i + j].upper[k]; });
+        }
+        // operands of min and max swapped, as std::min and std::max select the first on ties
+        alignas(32) float bounds[6][L::kWidth];
+        for (int row = 0; row < 3; ++row) {
+            L::Type low = m[12 + row], high = m[12 + row];
+            for (int col = 0; col < 3; ++col) {
+                const L::Type a = L::mul(m[col * 4 + row], lower[col]);
+                const L::Type b = L::mul(m[col * 4 + row], upper[col]);
+                low = L::add(low, L::min(b, a));
+                high = L::add(high, L::max(b, a));
+            }
+            L::store(bounds[row], low);
+            L::store(bounds[3 + row], high);
+        }
+        for (size_t j = 0; j < L::kWidth; ++j) {
+            AABB& box = result[i + j];
+            if (kept & (1u << j)) {
+                box = boxes[i + j];
+                continue;
+            }
+            for (int k = 0; k < 3; ++k) {
+                box.lower[k] = bounds[k][j];
+                box.upper[k] = bounds[3 + k][j];
+            }
+        }
+    }
+#endif
+    for (; i < count; ++i)
+        result[i] = boxes[i].transformed(matrices[i]);
+}
+
+/**
+ * @brief View frustum of a camera
+ *
+ * Planes are extracted from a column-major projection * view matrix, in OpenGL clip space.
+ */
+class Frustum
+{
+  public:
+    /**
+     * @brief Construct a new Frustum object
+     *
+     * @param viewProj - projection matrix times view matrix
+     */
+    explicit Frustum(const Matrix4f& viewProj)
+    {
+        // plane i is row 3 plus or minus row i / 2 of the matrix
+        for (int i = 0; i < 6; ++i) {
+            const float sign = i % 2 ? -1.f : 1.f;
+            for (int k = 0; k < 4; ++k)
+                _planes[i][k] = viewProj[k * 4 + 3] + sign * viewProj[k * 4 + i / 2];
+        }
+    }
+
+    /**
+     * @brief Box intersects or may intersect the frustum
+     *
+     * Conservative test: a box is culled only if it is fully out of one of the planes.
+     */
+    bool intersects(const AABB& box) const
+    {
+        if (box.empty())
+            return false;
+        if (box.infinite())
+            return true;
+
+        for (const auto& plane : _planes) {
+            // corner the furthest along the plane normal
+            float distance = plane[3];
+            for (int k = 0; k < 3; ++k)
+                distance += plane[k] * (plane[k] > 0.f ? box.upper[k] : box.lower[k]);
+            if (distance < 0.f)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Push the planes out so that \p point is inside, e.g. the corners of other frustums
+     * to cull once for several views
+     */
+    void enclose(const Vector3f& point)
+    {
+        for (auto& plane : _planes) {
+            const float distance =
+                plane[0] * point[0] + plane[1] * point[1] + plane[2] * point[2] + plane[3];
+            if (distance < 0.f)
+                plane[3] -= distance;
+        }
+    }
+
+    /**
+     * @brief Box is fully inside the frustum
+     */
+    bool contains(const AABB& box) const
+    {
+        if (box.empty() || box.infinite())
+            return false;
+
+        for (const auto& plane : _planes) {
+            // corner the furthest against the plane normal
+            float distance = plane[3];
+            for (int k = 0; k < 3; ++k)
+                distance += plane[k] * (plane[k] > 0.f ? box.lower[k] : box.upper[k]);
+            if (distance < 0.f)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Planes, unnormalized, a point p is inside where dot(plane.xyz, p) + plane.w >= 0
+     */
+    const Vector4f* planes() const { return _planes; }
+
+  private:
+    Vector4f _planes[6]; //<- left, right, bottom, top, near, far
+};
+
+} // namespace scene
@@ -6,11 +6,166 @@
 
 #include <utils/math.h>
 
+#include <algorithm>
+#include <cmath>
+
 namespace scene {
 
+/**
+ * @brief Projection of a region of an image only
+ *
+ * Maps the region onto the whole clip space: an image of the region size drawn with the result
+ * holds the pixels of the region of the image drawn with \p projMatrix, rows going down.
+ *
+ * @param projMatrix - projection of the image
+ * @param size - image size
+ * @param region - x, y of the top-left pixel of the region, width and height
+ */
+inline Matrix4f cropProjection(const Matrix4f& projMatrix, const Size2i& size,
+                               const Vector4i& region)
+{
+    // scale clip x and y about the region center, taken along w to keep perspective
+    const float sx = float(size[0]) / region[2], sy = float(size[1]) / region[3];
+    const float cx = float(2 * region[0] + region[2]) / size[0] - 1.f;
+    const float cy = 1.f - float(2 * region[1] + region[3]) / size[1];
+    Matrix4f result = projMatrix;
+    for (int col = 0; col < 4; ++col) {
+        const float w = projMatrix[col * 4 + 3];
+        result[col * 4 + 0] = sx * (projMatrix[col * 4 + 0] - cx * w);
+        result[col * 4 + 1] = sy * (projMatrix[col * 4 + 1] - cy * w);
+    }
+    return result;
+}
+
+/**
+ * @brief Distortion model of a camera lens
+ */
+enum class LensModel
+{
+    Pinhole, //<- no distortion
+    BrownConrady, //<- radial k1, k2, k3 and tangential p1, p2 coefficients
+    Fisheye, //<- equidistant, radial k1 to k4 coefficients of the angle to the axis
+};
+
+/**
+ * @brief Largest angle to the axis of rays seen through a lens, about 80 degrees
+ */
+constexpr float kLensMaxAngle = 1.4f;
+
+/**
+ * @brief Lens distortion of the images of a camera, coefficients as those of OpenCV
+ *
+ * Coefficients apply to normalized image coordinates, x right and y down over the depth, of the
+ * pinhole projection of the camera. Images of the camera are those of the projection distorted by
+ * the lens, see render::LensMap.
+ */
+struct LensDistortion
+{
+    LensModel model = LensModel::Pinhole;
+    float k1 = 0.f;
+    float k2 = 0.f;
+    float k3 = 0.f;
+    float k4 = 0.f; //<- of fisheye lenses only
+    float p1 = 0.f; //<- of Brown-Conrady lenses only
+    float p2 = 0.f;
+
+    /**
+     * @brief The lens distorts images
+     */
+    bool enabled() const { return model != LensModel::Pinhole; }
+
+    /**
+     * @brief Distorted coordinates of undistorted ones
+     */
+    void distort(float x, float y, float& xd, float& yd) const
+    {
+        const float r2 = x * x + y * y;
+        if (model == LensModel::Fisheye) {
+            const float r = std::sqrt(r2);
+            if (!(r > 0.f)) {
+                xd = x;
+                yd = y;
+                return;
+            }
+            const float t = std::atan(r), t2 = t * t;
+            const float td = t * (1.f + t2 * (k1 + t2 * (k2 + t2 * (k3 + t2 * k4))));
+            xd = x * td / r;
+            yd = y * td / r;
+            return;
+        }
+        const float radial = model == LensModel::BrownConrady
+                                 ? 1.f + r2 * (k1 + r2 * (k2 + r2 * k3))
+                                 : 1.f;
+        xd = x * radial + 2.f * p1 * x * y + p2 * (r2 + 2.f * x * x);
+        yd = y * radial + p1 * (r2 + 2.f * y * y) + 2.f * p2 * x * y;
+    }
+
+    /**
+     * @brief Undistorted coordinates of distorted ones, iteratively
+     *
+     * @return False if no ray of less than kLensMaxAngle off the axis is distorted there
+     */
+    bool undistort(float xd, float yd, float& x, float& y) const
+    {
+        if (model == LensModel::Fisheye) {
+            // the angle of the distorted radius, by Newton's method
+            const float rd = std::sqrt(xd * xd + yd * yd);
+            float t = std::min(rd, kLensMaxAngle);
+            for (int i = 0; i < 20; ++i) {
+                const float t2 = t * t;
+                const float f = t * (1.f + t2 * (k1 + t2 * (k2 + t2 * (k3 + t2 * k4)))) - rd;
+                const float df = 1.f + t2 * (3.f * k1 + t2 * (5.f * k2 + t2 * (7.f * k3 +
+                                                                             9.f * t2 * k4)));
+                if (!(std::abs(df) > 1e-6f))
+                    return false;
+                t -= f / df;
+            }
+            if (!(t >= 0.f && t < kLensMaxAngle))
+                return false;
+            const float scale = rd > 0.f ? std::tan(t) / rd : 1.f;
+            x = xd * scale;
+            y = yd * scale;
+        }
+        else {
+            // fixed point of the distortion, as cv::undistortPoints
+            x = xd;
+            y = yd;
+            for (int i = 0; i < 20; ++i) {
+                float dx, dy;
+                distort(x, y, dx, dy);
+                x += xd - dx;
+                y += yd - dy;
+            }
+            if (!(x * x + y * y < std::tan(kLensMaxAngle) * std::tan(kLensMaxAngle)))
+                return false;
+        }
+        // of a distorted position the lens reaches, within a thousandth of the focal length
+        float dx, dy;
+        distort(x, y, dx, dy);
+        return std::abs(dx - xd) + std::abs(dy - yd) < 1e-3f;
+    }
+
+    bool operator==(const LensDistortion& other) const
+    {
+        return model == other.model && k1 == other.k1 && k2 == other.k2 && k3 == other.k3 &&
+               k4 == other.k4 && p1 == other.p1 && p2 == other.p2;
+    }
+    bool operator!=(const LensDistortion& other) const { return !(*this == other); }
+
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(model, k1, k2, k3, k4, p1, p2);
+    }
+};
+
 /**
  * @brief Camera configuration
  *
+ * Values derived from the matrices, the intrinsics of the projection and the pose, are computed
+ * once when a matrix is set rather than by each renderer for each frame. Cameras registered in
+ * the plugin carry a handle, the same for all the images of a sensor, under which renderers may
+ * keep per camera objects such as lenses and render targets.
  */
 class Camera
 {
@@ -19,7 +174,11 @@ class Camera
      * @brief Construct a new Camera object
      *
      */
-    Camera() noexcept : _viewMatrix{0}, _projMatrix{0} {}
+    Camera() noexcept : _viewMatrix{0}, _projMatrix{0}
+    {
+        updateIntrinsics();
+        updatePose();
+    }
 
     /**
      * @brief Construct a new Camera object
@@ -28,6 +187,8 @@ class Camera
     Camera(const Matrix4f& viewMatrix, const Matrix4f& projMatrix)
         : _viewMatrix{viewMatrix}, _projMatrix{projMatrix}
     {
+        updateIntrinsics();
+        updatePose();
     }
 
     /**
@@ -35,55 +196,137 @@ class Camera
      */
     const Matrix4f& projMatrix() const { return _projMatrix; }
     /** @overload */
-    void setProjMatrix(const Matrix4f& m) { _projMatrix = m; }
+    void setProjMatrix(const Matrix4f& m)
+    {
+        _projMatrix = m;
+        updateIntrinsics();
+    }
 
     /**
      * @brief Camera view 4x4 matrix
      */
     const Matrix4f& viewMatrix() const { return _viewMatrix; }
     /** @overload */
-    void setViewMatrix(const Matrix4f& m) { _viewMatrix = m; }
+    void setViewMatrix(const Matrix4f& m)
+    {
+        _viewMatrix = m;
+        updatePose();
+    }
 
     /**
      * @brief Camera transformation 4x4 matrix
      *
      * This matrix is equal to inv(viewMatrix)
      */
-    inline Matrix4f poseMatrix() const
-    {
-        const auto m00 = _viewMatrix[0], m01 = _viewMatrix[1], m02 = _viewMatrix[2];
-        const auto m10 = _viewMatrix[4], m11 = _viewMatrix[5], m12 = _viewMatrix[6];
-        const auto m20 = _viewMatrix[8], m21 = _viewMatrix[9], m22 = _viewMatrix[10];
-        const auto p0 = _viewMatrix[12], p1 = _viewMatrix[13], p2 = _viewMatrix[14];
+    const Matrix4f& poseMatrix() const { return _poseMatrix; }
 
-        const auto h0 = -m00 * p0 - m01 * p1 - m02 * p2;
-        const auto h1 = -m10 * p0 - m11 * p1 - m12 * p2;
-        const auto h2 = -m20 * p0 - m21 * p1 - m22 * p2;
+    /**
+     * @brief The projection is a perspective one the intrinsics below are read from
+     */
+    bool hasIntrinsics() const { return _hasIntrinsics; }
 
-        return {m00, m10, m20, 0.f, m01, m11, m21, 0.f, m02, m12, m22, 0.f, h0, h1, h2, 1.f};
-    }
+    /**
+     * @brief Vertical field of view in radians
+     */
+    float yfov() const { return _yfov; }
+
+    /**
+     * @brief Near and far clipping distances
+     */
+    float znear() const { return _znear; }
+    float zfar() const { return _zfar; }
+
+    /**
+     * @brief Width over height of the image
+     */
+    float aspect() const { return _aspect; }
+
+    /**
+     * @brief Distortion of the lens, that of a pinhole by default
+     */
+    const LensDistortion& distortion() const { return _distortion; }
+    /** @overload */
+    void setDistortion(const LensDistortion& distortion) { _distortion = distortion; }
+
+    /**
+     * @brief Handle of the registered camera, -1 if not registered
+     */
+    int handle() const { return _handle; }
+    /** @overload */
+    void setHandle(int handle) { _handle = handle; }
 
     /**
      * @brief Comparison operator
+     *
+     * Handles are not compared: cameras of the same matrices and lens render the same images.
      */
     bool operator==(const Camera& other) const
     {
-        return _projMatrix == other._projMatrix && _viewMatrix == other._viewMatrix;
+        return _projMatrix == other._projMatrix && _viewMatrix == other._viewMatrix &&
+               _distortion == other._distortion;
     }
     bool operator!=(const Camera& other) const { return !(*this == other); }
 
     /**
-     * @brief Serialization
+     * @brief Serialization, derived values are computed again on loading
      */
     template <class Archive>
-    void serialize(Archive& ar)
+    void save(Archive& ar) const
+    {
+        ar(_projMatrix, _viewMatrix, _distortion);
+    }
+    /** @overload */
+    template <class Archive>
+    void load(Archive& ar)
     {
-        ar(_projMatrix, _viewMatrix);
+        ar(_projMatrix, _viewMatrix, _distortion);
+        updateIntrinsics();
+        updatePose();
     }
 
   private:
+    /// field of view, clipping distances and aspect of a pybullet projection matrix
+    void updateIntrinsics()
+    {
+        const auto& m = _projMatrix;
+        _hasIntrinsics = m[0] != 0.f && m[5] != 0.f && std::abs(m[10]) != 1.f;
+        if (!_hasIntrinsics) {
+            _yfov = _znear = _zfar = _aspect = 0.f;
+            return;
+        }
+        _yfov = 2.f * std::atan(1.f / m[5]);
+        _znear = m[14] / (m[10] - 1.f);
+        _zfar = _znear * (m[10] - 1.f) / (m[10] + 1.f);
+        _aspect = m[5] / m[0];
+    }
+
+    /// inverse of the rigid view matrix
+    void updatePose()
+    {
+        const auto m00 = _viewMatrix[0], m01 = _viewMatrix[1], m02 = _viewMatrix[2];
+        const auto m10 = _viewMatrix[4], m11 = _viewMatrix[5], m12 = _viewMatrix[6];
+        const auto m20 = _viewMatrix[8], m21 = _viewMatrix[9], m22 = _viewMatrix[10];
+        const auto p0 = _viewMatrix[12], p1 = _viewMatrix[13], p2 = _viewMatrix[14];
+
+        const auto h0 = -m00 * p0 - m01 * p1 - m02 * p2;
+        const auto h1 = -m10 * p0 - m11 * p1 - m12 * p2;
+        const auto h2 = -m20 * p0 - m21 * p1 - m22 * p2;
+
+        _poseMatrix = {m00, m10, m20, 0.f, m01, m11, m21, 0.f,
+                       m02, m12, m22, 0.f, h0,  h1,  h2,  1.f};
+    }
+
     Matrix4f _projMatrix;
     Matrix4f _viewMatrix;
+    // derived from the matrices
+    Matrix4f _poseMatrix;
+    bool _hasIntrinsics;
+    float _yfov;
+    float _znear;
+    float _zfar;
+    float _aspect;
+    LensDistortion _distortion;
+    int _handle = -1;
 };
 
 } // namespace scene
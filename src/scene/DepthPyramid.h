@@ -0,0 +1,188 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Bounds.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Hierarchical depth buffer of the farthest eye depth under each texel, for occlusion
+ * culling
+ *
+ * The finest level covers an image by texels of 2^shift pixels a side, as reduced by a renderer
+ * from the depth of the occluders it drew; each coarser level halves the previous one, rounding
+ * up, keeping the farthest depth of the texels it covers. A box is occluded when its nearest
+ * corner lies behind the farthest depth of all texels under its screen rectangle, tested at the
+ * level where the rectangle spans at most 2 x 2 texels. Texels where nothing was drawn hold an
+ * infinite depth and occlude nothing.
+ */
+class DepthPyramid
+{
+  public:
+    /**
+     * @brief Start a new pyramid, returning the finest level to fill
+     *
+     * Reuses the storage of the previous pyramid, so that steady frames do not allocate.
+     *
+     * @param imageCols - image width in pixels
+     * @param imageRows - image height in pixels
+     * @param shift - log2 of the pixels per texel side of the finest level
+     * @return Farthest depth of each texel of the finest level, bottom row first, to be written
+     * before build()
+     */
+    float* reset(int imageCols, int imageRows, int shift)
+    {
+        _imageCols = imageCols;
+        _imageRows = imageRows;
+        _shift = shift;
+        _sizes.clear();
+        _offsets.clear();
+        const int cols = (imageCols + (1 << shift) - 1) >> shift;
+        const int rows = (imageRows + (1 << shift) - 1) >> shift;
+        _sizes.push_back({cols, rows});
+        _offsets.push_back(0);
+        _depths.resize(size_t(cols) * size_t(rows));
+        _built = false;
+        return _depths.data();
+    }
+
+    /**
+     * @brief Reduce the finest level into the coarser ones, down to a single texel
+     */
+    void build()
+    {
+        int level = 0;
+        while (_sizes[level][0] > 1 || _sizes[level][1] > 1) {
+            const int cols = _sizes[level][0], rows = _sizes[level][1];
+            const int nextCols = (cols + 1) / 2, nextRows = (rows + 1) / 2;
+            const size_t source = _offsets[level];
+            const size_t offset = _depths.size();
+            _depths.resize(offset + size_t(nextCols) * size_t(nextRows));
+            for (int y = 0; y < nextRows; ++y) {
+                const int y0 = 2 * y, y1 = std::min(2 * y + 1, rows - 1);
+                for (int x = 0; x < nextCols; ++x) {
+                    const int x0 = 2 * x, x1 = std::min(2 * x + 1, cols - 1);
+                    const float* row0 = &_depths[source + size_t(y0) * cols];
+                    const float* row1 = &_depths[source + size_t(y1) * cols];
+                    _depths[offset + size_t(y) * nextCols + x] =
+                        std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+                }
+            }
+            _sizes.push_back({nextCols, nextRows});
+            _offsets.push_back(offset);
+            ++level;
+        }
+        _built = true;
+    }
+
+    /**
+     * @brief No pyramid was built since the last clear()
+     */
+    bool empty() const { return !_built; }
+
+    /**
+     * @brief Drop the pyramid, nothing is occluded until the next build()
+     */
+    void clear() { _built = false; }
+
+    /**
+     * @brief Number of levels, the finest first
+     */
+    int levels() const { return _built ? int(_sizes.size()) : 0; }
+
+    /**
+     * @brief Texel columns and rows of a level
+     */
+    int cols(int level) const { return _sizes[level][0]; }
+    int rows(int level) const { return _sizes[level][1]; }
+
+    /**
+     * @brief Farthest depth under a texel of a level, rows bottom first
+     */
+    float depth(int level, int col, int row) const
+    {
+        return _depths[_offsets[level] + size_t(row) * _sizes[level][0] + col];
+    }
+
+    /**
+     * @brief Box is hidden behind the depths of the pyramid
+     *
+     * Conservative test: boxes crossing the camera plane, infinite or empty ones are never
+     * occluded.
+     *
+     * @param box - box in world frame
+     * @param viewProj - projection matrix times view matrix the depths were drawn with
+     * @param view - view matrix, for eye depths
+     */
+    bool occluded(const AABB& box, const Matrix4f& viewProj, const Matrix4f& view) const
+    {
+        if (!_built || box.empty() || box.infinite())
+            return false;
+
+        // screen rectangle in pixels and nearest eye depth of the corners
+        float lower[2] = {std::numeric_limits<float>::infinity(),
+                          std::numeric_limits<float>::infinity()};
+        float upper[2] = {-lower[0], -lower[1]};
+        float nearest = std::numeric_limits<float>::infinity();
+        for (int corner = 0; corner < 8; ++corner) {
+            const float p[3] = {corner & 1 ? box.upper[0] : box.lower[0],
+                                corner & 2 ? box.upper[1] : box.lower[1],
+                                corner & 4 ? box.upper[2] : box.lower[2]};
+            float clip[4];
+            for (int row = 0; row < 4; ++row)
+                clip[row] = viewProj[row] * p[0] + viewProj[4 + row] * p[1] +
+                            viewProj[8 + row] * p[2] + viewProj[12 + row];
+            if (!(clip[3] > 0.f))
+                return false;
+            const float size[2] = {float(_imageCols), float(_imageRows)};
+            for (int k = 0; k < 2; ++k) {
+                const float pixel = (clip[k] / clip[3] * 0.5f + 0.5f) * size[k];
+                lower[k] = std::min(lower[k], pixel);
+                upper[k] = std::max(upper[k], pixel);
+            }
+            nearest = std::min(nearest, -(view[2] * p[0] + view[6] * p[1] + view[10] * p[2] +
+                                          view[14]));
+        }
+        if (!(nearest > 0.f) || upper[0] < 0.f || upper[1] < 0.f ||
+            lower[0] >= float(_imageCols) || lower[1] >= float(_imageRows))
+            return false;
+
+        // texels of the finest level under the rectangle
+        const float last[2] = {float(_imageCols - 1), float(_imageRows - 1)};
+        int first[2], end[2];
+        for (int k = 0; k < 2; ++k) {
+            first[k] = int(std::max(0.f, std::min(last[k], std::floor(lower[k])))) >> _shift;
+            end[k] = int(std::max(0.f, std::min(last[k], std::floor(upper[k])))) >> _shift;
+        }
+        int level = 0;
+        while (level + 1 < int(_sizes.size()) &&
+               ((end[0] >> level) - (first[0] >> level) > 1 ||
+                (end[1] >> level) - (first[1] >> level) > 1))
+            ++level;
+        for (int row = first[1] >> level; row <= end[1] >> level; ++row)
+            for (int col = first[0] >> level; col <= end[0] >> level; ++col)
+                if (!(depth(level, col, row) < nearest))
+                    return false;
+        return true;
+    }
+
+  private:
+    std::vector<float> _depths; //<- all levels, the finest first
+    std::vector<std::array<int, 2>> _sizes; //<- columns and rows of each level
+    std::vector<size_t> _offsets; //<- first texel of each level
+    int _imageCols = 0;
+    int _imageRows = 0;
+    int _shift = 0;
+    bool _built = false;
+};
+
+} // namespace scene
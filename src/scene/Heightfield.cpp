@@ -0,0 +1,223 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "Heightfield.h"
+
+#include <cmath>
+#include <limits>
+
+namespace scene {
+
+namespace {
+
+/// number of grid points and spacing along an axis of interleaved coordinates, 0 if irregular
+int gridAxis(const std::vector<float>& vertices, int axis, float& lower, float& spacing)
+{
+    const size_t count = vertices.size() / 3;
+    lower = std::numeric_limits<float>::infinity();
+    float upper = -lower;
+    for (size_t i = 0; i < count; ++i) {
+        lower = std::min(lower, vertices[i * 3 + axis]);
+        upper = std::max(upper, vertices[i * 3 + axis]);
+    }
+    if (!(upper > lower) || !std::isfinite(upper - lower))
+        return 0;
+
+    // smallest gap to the lower coordinate, a cell
+    const float epsilon = (upper - lower) * 1e-6f;
+    float gap = upper - lower;
+    for (size_t i = 0; i < count; ++i) {
+        const float d = vertices[i * 3 + axis] - lower;
+        if (d > epsilon)
+            gap = std::min(gap, d);
+    }
+    const long cells = std::lround((upper - lower) / gap);
+    if (cells < 1 || cells > (1 << 20))
+        return 0;
+    spacing = (upper - lower) / float(cells);
+    return int(cells) + 1;
+}
+
+} // namespace
+
+std::shared_ptr<Heightfield> Heightfield::fromTriangles(const std::vector<float>& vertices,
+                                                        const std::vector<float>& uvs,
+                                                        const std::vector<int>& indices)
+{
+    const size_t numVertices = vertices.size() / 3;
+    if (!numVertices || indices.empty() || indices.size() % 3 ||
+        (!uvs.empty() && uvs.size() != numVertices * 2))
+        return nullptr;
+
+    std::array<float, 2> origin, cellSize;
+    const int columns = gridAxis(vertices, 0, origin[0], cellSize[0]);
+    const int rows = gridAxis(vertices, 1, origin[1], cellSize[1]);
+    const size_t numCells = size_t(columns - 1) * size_t(rows - 1);
+    if (!columns || !rows || indices.size() != numCells * 6)
+        return nullptr;
+
+    auto heightfield = std::make_shared<Heightfield>();
+    heightfield->_columns = columns;
+    heightfield->_rows = rows;
+    heightfield->_origin = origin;
+    heightfield->_cellSize = cellSize;
+
+    // grid point of each vertex, every grid point with a single height
+    const float unset = std::numeric_limits<float>::quiet_NaN();
+    heightfield->_heights.assign(size_t(columns) * size_t(rows), unset);
+    std::vector<int> points(numVertices);
+    for (size_t i = 0; i < numVertices; ++i) {
+        int column, row;
+        if (!heightfield->gridPoint(vertices[i * 3], vertices[i * 3 + 1], column, row))
+            return nullptr;
+        const float z = vertices[i * 3 + 2];
+        auto& height = heightfield->_heights[heightfield->index(column, row)];
+        if (std::isnan(height))
+            height = z;
+        else if (std::abs(height - z) > 1e-6f * std::max(std::abs(z), 1.f))
+            return nullptr;
+        points[i] = int(heightfield->index(column, row));
+    }
+    for (float height : heightfield->_heights)
+        if (std::isnan(height))
+            return nullptr;
+
+    // two triangles per cell, missing opposite corners of the same diagonal everywhere
+    std::vector<uint8_t> missing(numCells, 0); //<- bit per missing corner, first to last
+    int diagonal = -1; //<- 0 for the bullet default, 1 for flipped
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        int corners[3][2];
+        for (int k = 0; k < 3; ++k) {
+            const int vertex = indices[t + k];
+            if (vertex < 0 || size_t(vertex) >= numVertices)
+                return nullptr;
+            corners[k][0] = points[vertex] % columns;
+            corners[k][1] = points[vertex] / columns;
+        }
+        const int c = std::min({corners[0][0], corners[1][0], corners[2][0]});
+        const int r = std::min({corners[0][1], corners[1][1], corners[2][1]});
+        int present = 0;
+        for (const auto& corner : corners) {
+            const int dc = corner[0] - c, dr = corner[1] - r;
+            if (dc > 1 || dr > 1)
+                return nullptr;
+            present |= 1 << (dr * 2 + dc);
+        }
+        const int absent = 0xf & ~present;
+        if (absent != 1 && absent != 2 && absent != 4 && absent != 8)
+            return nullptr; //<- degenerate
+        const int flip = absent == 2 || absent == 4 ? 1 : 0;
+        if (diagonal >= 0 && flip != diagonal)
+            return nullptr;
+        diagonal = flip;
+        auto& cell = missing[size_t(r) * (columns - 1) + c];
+        if (cell & absent)
+            return nullptr;
+        cell |= absent;
+    }
+    heightfield->_flipDiagonals = diagonal == 1;
+
+    // affine texture coordinates from the corners, checked at every vertex
+    if (!uvs.empty()) {
+        const auto uvAt = [&](int column, int row) -> const float* {
+            for (size_t i = 0; i < numVertices; ++i)
+                if (points[i] == int(heightfield->index(column, row)))
+                    return &uvs[i * 2];
+            return nullptr;
+        };
+        const float* first = uvAt(0, 0);
+        const float* lastColumn = uvAt(columns - 1, 0);
+        const float* lastRow = uvAt(0, rows - 1);
+        heightfield->_uvOffset = {first[0], first[1]};
+        heightfield->_uvScale = {lastColumn[0] - first[0], lastRow[1] - first[1]};
+        const float tolerance =
+            1e-4f * std::max({std::abs(first[0]), std::abs(first[1]), std::abs(lastColumn[0]),
+                              std::abs(lastRow[1]), 1.f});
+        for (size_t i = 0; i < numVertices; ++i) {
+            const float u = float(points[i] % columns) / float(columns - 1);
+            const float v = float(points[i] / columns) / float(rows - 1);
+            if (std::abs(uvs[i * 2] - (first[0] + heightfield->_uvScale[0] * u)) > tolerance ||
+                std::abs(uvs[i * 2 + 1] - (first[1] + heightfield->_uvScale[1] * v)) > tolerance)
+                return nullptr;
+        }
+    }
+    heightfield->resetTiles();
+    return heightfield;
+}
+
+AABB Heightfield::tileBounds(int tileColumn, int tileRow) const
+{
+    const int c0 = tileColumn * kTileCells, c1 = std::min(c0 + kTileCells, _columns - 1);
+    const int r0 = tileRow * kTileCells, r1 = std::min(r0 + kTileCells, _rows - 1);
+    float lower = height(c0, r0), upper = lower;
+    for (int row = r0; row <= r1; ++row)
+        for (int column = c0; column <= c1; ++column) {
+            lower = std::min(lower, height(column, row));
+            upper = std::max(upper, height(column, row));
+        }
+    return AABB{{_origin[0] + _cellSize[0] * float(c0), _origin[1] + _cellSize[1] * float(r0),
+                 lower},
+                {_origin[0] + _cellSize[0] * float(c1), _origin[1] + _cellSize[1] * float(r1),
+                 upper}};
+}
+
+float Heightfield::tileEdgeError(int tileColumn, int tileRow, int step) const
+{
+    const int c0 = tileColumn * kTileCells, c1 = std::min(c0 + kTileCells, _columns - 1);
+    const int r0 = tileRow * kTileCells, r1 = std::min(r0 + kTileCells, _rows - 1);
+    float error = 0.f;
+    // border points first to last, stride apart, against their samples every step
+    const auto border = [&](const float* start, size_t stride, int first, int last) {
+        for (int i = first; i <= last; ++i) {
+            const int a = first + (i - first) / step * step, b = std::min(a + step, last);
+            const float t = b > a ? float(i - a) / float(b - a) : 0.f;
+            const float h = start[a * stride] * (1.f - t) + start[b * stride] * t;
+            error = std::max(error, std::abs(start[i * stride] - h));
+        }
+    };
+    for (int row : {r0, r1})
+        border(&_heights[index(0, row)], 1, c0, c1);
+    for (int column : {c0, c1})
+        border(&_heights[index(column, 0)], size_t(_columns), r0, r1);
+    return error;
+}
+
+std::shared_ptr<MeshData> Heightfield::meshData() const
+{
+    if (_columns < 2 || _rows < 2)
+        return nullptr;
+
+    const size_t count = size_t(_columns) * size_t(_rows);
+    std::vector<float> vertices(count * 3), uvs(count * 2), normals(count * 3);
+    for (int row = 0; row < _rows; ++row) {
+        for (int column = 0; column < _columns; ++column) {
+            const size_t i = index(column, row);
+            vertices[i * 3] = _origin[0] + _cellSize[0] * float(column);
+            vertices[i * 3 + 1] = _origin[1] + _cellSize[1] * float(row);
+            vertices[i * 3 + 2] = _heights[i];
+            uvs[i * 2] = _uvOffset[0] + _uvScale[0] * float(column) / float(_columns - 1);
+            uvs[i * 2 + 1] = _uvOffset[1] + _uvScale[1] * float(row) / float(_rows - 1);
+            const auto n = normal(column, row);
+            std::copy(n.begin(), n.end(), &normals[i * 3]);
+        }
+    }
+
+    // counter-clockwise seen from above
+    std::vector<int> indices;
+    indices.reserve(size_t(_columns - 1) * size_t(_rows - 1) * 6);
+    for (int row = 0; row + 1 < _rows; ++row) {
+        for (int column = 0; column + 1 < _columns; ++column) {
+            const int p00 = int(index(column, row)), p10 = p00 + 1;
+            const int p01 = p00 + _columns, p11 = p01 + 1;
+            if (_flipDiagonals)
+                indices.insert(indices.end(), {p00, p10, p11, p00, p11, p01});
+            else
+                indices.insert(indices.end(), {p00, p10, p01, p10, p11, p01});
+        }
+    }
+    return std::make_shared<MeshData>(std::move(vertices), std::move(uvs), std::move(normals),
+                                      std::move(indices));
+}
+
+} // namespace scene
@@ -0,0 +1,343 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Bounds.h"
+#include "Mesh.h"
+
+#include <utils/math.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Regular grid of heights, along z over the xy plane
+ *
+ * Grid points are stored row by row, a row along x. Each cell is split in two triangles along
+ * one of its diagonals. The grid is divided in tiles of kTileCells x kTileCells cells whose
+ * revision changes with their heights, so that renderers update only the modified tiles.
+ */
+class Heightfield
+{
+  public:
+    static constexpr int kTileCells = 64; //<- cells along each side of a tile
+
+    /**
+     * @brief Construct a new empty Heightfield object
+     */
+    Heightfield() noexcept = default;
+
+    /**
+     * @brief Construct a new Heightfield object
+     *
+     * @param columns - number of grid points along x, at least 2
+     * @param rows - number of grid points along y, at least 2
+     * @param origin - xy coordinates of the first grid point
+     * @param cellSize - distance between grid points along x and y
+     * @param heights - columns * rows heights, row by row
+     */
+    Heightfield(int columns, int rows, const std::array<float, 2>& origin,
+                const std::array<float, 2>& cellSize, std::vector<float>&& heights)
+        : _columns(columns), _rows(rows), _origin(origin), _cellSize(cellSize),
+          _heights(std::move(heights))
+    {
+        resetTiles();
+    }
+
+    /**
+     * @brief Recover the grid of a triangle soup or mesh sampling a heightfield
+     *
+     * Vertices must lie on a regular xy grid, every grid point covered with a single height,
+     * each cell made of two triangles along the same diagonal for all cells, and uvs an affine
+     * function of the grid coordinates.
+     *
+     * @param vertices - vertex coordinates
+     * @param uvs - texture coordinates, one per vertex or none
+     * @param indices - triangle indices
+     * @return std::shared_ptr<Heightfield> - null if the mesh does not sample a regular grid
+     */
+    static std::shared_ptr<Heightfield> fromTriangles(const std::vector<float>& vertices,
+                                                      const std::vector<float>& uvs,
+                                                      const std::vector<int>& indices);
+
+    /**
+     * @brief Number of grid points along x
+     */
+    int columns() const { return _columns; }
+
+    /**
+     * @brief Number of grid points along y
+     */
+    int rows() const { return _rows; }
+
+    /**
+     * @brief xy coordinates of the first grid point
+     */
+    const std::array<float, 2>& origin() const { return _origin; }
+
+    /**
+     * @brief Distance between grid points along x and y
+     */
+    const std::array<float, 2>& cellSize() const { return _cellSize; }
+
+    /**
+     * @brief Heights of all grid points, row by row
+     */
+    const std::vector<float>& heights() const { return _heights; }
+
+    /**
+     * @brief Bytes held in memory by the heights and tile revisions
+     */
+    size_t memoryBytes() const
+    {
+        return _heights.size() * sizeof(float) + _tileRevisions.size() * sizeof(uint64_t);
+    }
+
+    /**
+     * @brief Height of a grid point
+     */
+    float height(int column, int row) const { return _heights[index(column, row)]; }
+
+    /**
+     * @brief Change the height of a grid point, bumping the revision of its tiles if it differs
+     *
+     * Points along tile borders belong to all tiles sharing them.
+     *
+     * Bounds only grow with updates, they stay conservative.
+     *
+     * @return True if the height changed
+     */
+    bool setHeight(int column, int row, float value)
+    {
+        auto& height = _heights[index(column, row)];
+        if (height == value)
+            return false;
+        height = value;
+        _hash.reset();
+        _minHeight = std::min(_minHeight, value);
+        _maxHeight = std::max(_maxHeight, value);
+        const auto revision = nextRevision();
+        for (int tileRow = firstTileOf(row); tileRow <= tileOf(row, _rows); ++tileRow)
+            for (int tileColumn = firstTileOf(column); tileColumn <= tileOf(column, _columns);
+                 ++tileColumn)
+                _tileRevisions[size_t(tileRow) * tileColumns() + tileColumn] = revision;
+        return true;
+    }
+
+    /**
+     * @brief Grid point closest to xy coordinates
+     *
+     * @return True if the coordinates are within 1% of a cell of a grid point
+     */
+    bool gridPoint(float x, float y, int& column, int& row) const
+    {
+        const float u = (x - _origin[0]) / _cellSize[0], v = (y - _origin[1]) / _cellSize[1];
+        column = int(std::lround(u));
+        row = int(std::lround(v));
+        return column >= 0 && column < _columns && row >= 0 && row < _rows &&
+               std::abs(u - column) < 0.01f && std::abs(v - row) < 0.01f;
+    }
+
+    /**
+     * @brief Cells split along the diagonal from their first to their last grid point
+     *
+     * False for the other diagonal, the default of bullet.
+     */
+    bool flipDiagonals() const { return _flipDiagonals; }
+    /** @overload */
+    void setFlipDiagonals(bool flip)
+    {
+        _flipDiagonals = flip;
+        _hash.reset();
+    }
+
+    /**
+     * @brief Texture coordinates of the first grid point
+     *
+     * Texture coordinates are uvOffset() + uvScale() * (column, row) / (columns - 1, rows - 1).
+     */
+    const std::array<float, 2>& uvOffset() const { return _uvOffset; }
+
+    /**
+     * @brief Texture coordinates of the last grid point minus those of the first one
+     */
+    const std::array<float, 2>& uvScale() const { return _uvScale; }
+
+    /**
+     * @brief Set the affine texture coordinates, see uvOffset()
+     */
+    void setUvTransform(const std::array<float, 2>& offset, const std::array<float, 2>& scale)
+    {
+        _uvOffset = offset;
+        _uvScale = scale;
+        _hash.reset();
+    }
+
+    /**
+     * @brief Bounds of the grid
+     */
+    AABB bounds() const
+    {
+        if (_heights.empty())
+            return AABB::Empty();
+        return AABB{{_origin[0], _origin[1], _minHeight},
+                    {_origin[0] + _cellSize[0] * float(_columns - 1),
+                     _origin[1] + _cellSize[1] * float(_rows - 1), _maxHeight}};
+    }
+
+    /**
+     * @brief Number of tiles along x
+     */
+    int tileColumns() const { return std::max((_columns - 2) / kTileCells + 1, 1); }
+
+    /**
+     * @brief Number of tiles along y
+     */
+    int tileRows() const { return std::max((_rows - 2) / kTileCells + 1, 1); }
+
+    /**
+     * @brief Revision of the heights of a tile, unique across all heightfields of the process
+     *
+     * Copies keep the revisions of the original, a renderer may then update only the tiles
+     * whose revision differs from those it drew last.
+     */
+    uint64_t tileRevision(int tileColumn, int tileRow) const
+    {
+        return _tileRevisions[size_t(tileRow) * tileColumns() + tileColumn];
+    }
+
+    /**
+     * @brief Bounds of the grid points of a tile
+     */
+    AABB tileBounds(int tileColumn, int tileRow) const;
+
+    /**
+     * @brief Largest height difference along the borders of a tile between its grid points
+     * and the same border sampled every \p step points
+     *
+     * Bounds the cracks along a neighbor tile drawn at another level of detail.
+     */
+    float tileEdgeError(int tileColumn, int tileRow, int step) const;
+
+    /**
+     * @brief Smooth normal of a grid point, from central differences of the heights
+     */
+    Vector3f normal(int column, int row) const
+    {
+        const int c0 = std::max(column - 1, 0), c1 = std::min(column + 1, _columns - 1);
+        const int r0 = std::max(row - 1, 0), r1 = std::min(row + 1, _rows - 1);
+        const float dx = (height(c1, row) - height(c0, row)) / (float(c1 - c0) * _cellSize[0]);
+        const float dy =
+            (height(column, r1) - height(column, r0)) / (float(r1 - r0) * _cellSize[1]);
+        const float length = std::sqrt(dx * dx + dy * dy + 1.f);
+        return {-dx / length, -dy / length, 1.f / length};
+    }
+
+    /**
+     * @brief Triangle mesh of the grid, a vertex per grid point with smooth normals
+     *
+     * For renderers without native heightfields. Generated at each call.
+     */
+    std::shared_ptr<MeshData> meshData() const;
+
+    /**
+     * @brief Hash of the grid and heights, computed once until they change
+     *
+     * Bitwise: equal hashes stand for equal heights, see operator==().
+     */
+    uint64_t hash() const
+    {
+        return _hash.get([this] {
+            const int grid[] = {_columns, _rows, int(_flipDiagonals)};
+            uint64_t h = hashBytes(grid, sizeof(grid));
+            const std::array<float, 2> layout[] = {_origin, _cellSize, _uvOffset, _uvScale};
+            h = hashBytes(layout, sizeof(layout), h);
+            return hashWords(_heights.data(), _heights.size() * sizeof(float), h);
+        });
+    }
+
+    /**
+     * @brief Comparison operators
+     *
+     * By hash, without walking the heights once both hashes are cached.
+     */
+    bool operator==(const Heightfield& other) const
+    {
+        return _columns == other._columns && _rows == other._rows && _origin == other._origin &&
+               _cellSize == other._cellSize && _flipDiagonals == other._flipDiagonals &&
+               _uvOffset == other._uvOffset && _uvScale == other._uvScale &&
+               hash() == other.hash();
+    }
+    bool operator!=(const Heightfield& other) const { return !(*this == other); }
+
+    /**
+     * @brief Serialization
+     */
+    template <class Archive>
+    void save(Archive& ar) const
+    {
+        ar(_columns, _rows, _origin, _cellSize, _flipDiagonals, _uvOffset, _uvScale, _heights);
+    }
+    /** @overload */
+    template <class Archive>
+    void load(Archive& ar)
+    {
+        ar(_columns, _rows, _origin, _cellSize, _flipDiagonals, _uvOffset, _uvScale, _heights);
+        resetTiles();
+    }
+
+  private:
+    size_t index(int column, int row) const { return size_t(row) * _columns + column; }
+
+    /// last tile of a grid point along an axis of \p count points
+    static int tileOf(int point, int count)
+    {
+        return std::min(point / kTileCells, std::max((count - 2) / kTileCells, 0));
+    }
+
+    /// first tile of a grid point, the previous one for points on a tile border
+    static int firstTileOf(int point)
+    {
+        return point > 0 && point % kTileCells == 0 ? point / kTileCells - 1 : point / kTileCells;
+    }
+
+    static uint64_t nextRevision()
+    {
+        static std::atomic<uint64_t> revision{0};
+        return ++revision;
+    }
+
+    /// new revisions and height range of all tiles
+    void resetTiles()
+    {
+        const auto range = std::minmax_element(_heights.begin(), _heights.end());
+        _minHeight = _heights.empty() ? 0.f : *range.first;
+        _maxHeight = _heights.empty() ? 0.f : *range.second;
+        _hash.reset();
+        _tileRevisions.assign(size_t(tileColumns()) * tileRows(), nextRevision());
+    }
+
+    int _columns = 0;
+    int _rows = 0;
+    std::array<float, 2> _origin{0.f, 0.f};
+    std::array<float, 2> _cellSize{1.f, 1.f};
+    bool _flipDiagonals = false;
+    std::array<float, 2> _uvOffset{0.f, 0.f};
+    std::array<float, 2> _uvScale{1.f, 1.f};
+    std::vector<float> _heights;
+    // derived from heights (not serialized)
+    float _minHeight = 0.f;
+    float _maxHeight = 0.f;
+    std::vector<uint64_t> _tileRevisions;
+    CachedHash _hash;
+};
+
+} // namespace scene
@@ -18,6 +18,7 @@ enum class LightType
     AmbientLight,
     DirectionalLight,
     PointLight,
+    SpotLight,
 };
 
 /**
@@ -93,6 +94,32 @@ class Light
                 _target[2] - _direction[2] * _distance};
     }
 
+    /** @overload */
+    void setPosition(const Vector3f& position)
+    {
+        _target = {position[0] + _direction[0] * _distance, position[1] + _direction[1] * _distance,
+                   position[2] + _direction[2] * _distance};
+    }
+
+    /**
+     * @brief Distance beyond which a point or spot light lights nothing, 0 for unbounded
+     *
+     * Bounded lights are assigned to the clusters of the view they reach, unbounded ones light
+     * every pixel.
+     */
+    float range() const { return _range; }
+    /** @overload */
+    void setRange(float range) { _range = range; }
+
+    /**
+     * @brief Half angle of the cone of a spot light around its direction, in radians
+     *
+     * The light fades out over the outer fifth of the cone.
+     */
+    float spotAngle() const { return _spotAngle; }
+    /** @overload */
+    void setSpotAngle(float angle) { _spotAngle = angle; }
+
     /**
      * @brief Light ambient coeffitient
      */
@@ -153,7 +180,8 @@ class Light
         return _type == other._type && _direction == other._direction && _color == other._color &&
                _distance == other._distance && _target == other._target &&
                _ambientCoeff == other._ambientCoeff && _diffuseCoeff == other._diffuseCoeff &&
-               _specularCoeff == other._specularCoeff && _isShadowCaster == other._isShadowCaster;
+               _specularCoeff == other._specularCoeff && _isShadowCaster == other._isShadowCaster &&
+               _range == other._range && _spotAngle == other._spotAngle;
     }
     bool operator!=(const Light& other) const { return !(*this == other); }
 
@@ -164,7 +192,7 @@ class Light
     void serialize(Archive& ar)
     {
         ar(_type, _target, _direction, _distance, _color, _ambientCoeff, _diffuseCoeff,
-           _specularCoeff, _isShadowCaster);
+           _specularCoeff, _isShadowCaster, _range, _spotAngle);
     }
 
   private:
@@ -177,6 +205,8 @@ class Light
     float _diffuseCoeff = 1.f;
     float _specularCoeff = 1.f;
     bool _isShadowCaster = false;
+    float _range = 0.f;
+    float _spotAngle = 0.785398f;
 };
 
 } // namespace scene
@@ -5,8 +5,11 @@
 #pragma once
 
 #include "Texture.h"
+#include <utils/hash.h>
 #include <utils/math.h>
 
+#include <algorithm>
+
 namespace scene {
 
 /**
@@ -56,6 +59,14 @@ class Material
     /** @overload */
     void setDiffuseTexture(const std::shared_ptr<Texture>& texture) { _texture = texture; }
 
+    /**
+     * @brief Blended over opaque shapes, with a diffuse alpha below 1
+     *
+     * Renderers draw the other shapes without blending, keeping early depth tests, and sort
+     * only the transparent ones.
+     */
+    bool transparent() const { return _diffuseColor[3] < 1.f; }
+
     /**
      * @brief Comparison operators
      */
@@ -67,6 +78,22 @@ class Material
     }
     bool operator!=(const Material& other) const { return !(*this == other); }
 
+    /**
+     * @brief Hash of the content, equal for equal materials (see SceneGraph::internMaterial())
+     *
+     * Made at each call from the colors and the cached hash of the texture bitmap.
+     */
+    uint64_t hash() const
+    {
+        uint64_t h = hashBytes(_diffuseColor.data(), sizeof(_diffuseColor));
+        h = hashBytes(_specularColor.data(), sizeof(_specularColor), h);
+        if (_texture) {
+            const uint64_t texture = _texture->hash();
+            h = hashBytes(&texture, sizeof(texture), h);
+        }
+        return h;
+    }
+
     /**
      * @brief Serialization
      */
@@ -0,0 +1,145 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "MemoryUsage.h"
+#include "VertexBuffer.h"
+
+namespace scene {
+
+namespace {
+
+/**
+ * @brief Call \p function with the key and bytes of the data of a mesh and its levels of detail
+ */
+template <class Function>
+void forEachMeshData(const Mesh& mesh, const Function& function)
+{
+    if (const auto& data = mesh.data())
+        function(data.get(), data->memoryBytes());
+    for (const auto& lod : mesh.lods())
+        function(lod.get(), lod->memoryBytes());
+}
+
+/**
+ * @brief Bitmap pixels of a texture, keyed by their memory shared by bitmap copies
+ */
+const Bitmap* loadedBitmap(const Texture& texture)
+{
+    const auto& bitmap = texture.bitmap();
+    return bitmap && bitmap->data() ? bitmap.get() : nullptr;
+}
+
+/**
+ * @brief Call \p function with the key and bytes of each asset referenced by a node
+ */
+template <class Function>
+void forEachAsset(const Node& node, const Function& function)
+{
+    for (const auto& shape : node.shapes()) {
+        if (const auto& mesh = shape.mesh())
+            forEachMeshData(*mesh, function);
+        if (const auto& heightfield = shape.heightfield())
+            function(heightfield.get(), heightfield->memoryBytes());
+        const auto& material = shape.material();
+        const auto texture = material ? material->diffuseTexture() : nullptr;
+        if (const auto* bitmap = texture ? loadedBitmap(*texture) : nullptr)
+            function(bitmap->data(), bitmap->size());
+    }
+}
+
+} // namespace
+
+size_t MeshData::memoryBytes() const
+{
+    size_t bytes = (_vertices.size() + _uvs.size() + _normals.size()) * sizeof(float) +
+                   _indices.size() * sizeof(int);
+    if (_quantized)
+        bytes += (_quantized->positions.size() + _quantized->normals.size() +
+                  _quantized->uvs.size()) *
+                 sizeof(uint16_t);
+    if (const auto decoded = std::atomic_load(&_decoded))
+        bytes += (decoded->vertices.size() + decoded->uvs.size() + decoded->normals.size()) *
+                 sizeof(float);
+    if (_vertexBuffer)
+        bytes += _vertexBuffer->vertices().size() + _vertexBuffer->indices().size();
+    return bytes;
+}
+
+void MemoryAccounting::add(const SceneGraph& graph)
+{
+    for (const auto& it : graph.nodes()) {
+        for (const auto& shape : it.second.shapes()) {
+            if (const auto& mesh = shape.mesh())
+                add(*mesh);
+            if (const auto& heightfield = shape.heightfield())
+                add(heightfield.get(), heightfield->memoryBytes(), Kind::Heightfield);
+            const auto& material = shape.material();
+            if (const auto texture = material ? material->diffuseTexture() : nullptr)
+                add(*texture);
+        }
+    }
+}
+
+void MemoryAccounting::add(const Mesh& mesh)
+{
+    forEachMeshData(mesh, [this](const void* key, size_t bytes) { add(key, bytes, Kind::Mesh); });
+}
+
+void MemoryAccounting::add(const Texture& texture)
+{
+    if (const auto* bitmap = loadedBitmap(texture))
+        add(bitmap->data(), bitmap->size(), Kind::Texture);
+}
+
+void MemoryAccounting::add(const void* key, size_t bytes, Kind kind)
+{
+    if (!_seen.emplace(key, bytes).second) {
+        _assets.sharedBytes += bytes;
+        return;
+    }
+    switch (kind) {
+    case Kind::Mesh:
+        _assets.meshBytes += bytes;
+        ++_assets.meshes;
+        break;
+    case Kind::Texture:
+        _assets.textureBytes += bytes;
+        ++_assets.textures;
+        break;
+    case Kind::Heightfield:
+        _assets.heightfieldBytes += bytes;
+        ++_assets.heightfields;
+        break;
+    }
+}
+
+std::map<int, NodeMemory> MemoryAccounting::nodes(const SceneGraph& graph)
+{
+    // distinct assets of each node, then the number of nodes referencing each asset
+    std::map<int, std::map<const void*, size_t>> assets;
+    std::unordered_map<const void*, int> references;
+    for (const auto& it : graph.nodes()) {
+        auto& nodeAssets = assets[it.first];
+        forEachAsset(it.second, [&](const void* key, size_t bytes) {
+            if (nodeAssets.emplace(key, bytes).second)
+                ++references[key];
+        });
+    }
+
+    std::map<int, NodeMemory> nodes;
+    for (const auto& it : assets) {
+        auto& node = nodes[it.first];
+        const auto& graphNode = graph.nodes().at(it.first);
+        node.body = graphNode.body();
+        node.link = graphNode.link();
+        for (const auto& asset : it.second) {
+            node.bytes += asset.second;
+            if (references[asset.first] == 1)
+                node.ownedBytes += asset.second;
+        }
+    }
+    return nodes;
+}
+
+} // namespace scene
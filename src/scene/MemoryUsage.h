@@ -0,0 +1,87 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "SceneGraph.h"
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+
+namespace scene {
+
+/**
+ * @brief Bytes of the assets of scene graphs held in memory, shared assets counted once
+ */
+struct AssetMemory {
+    size_t meshBytes = 0; //<- mesh data and levels of detail, see MeshData::memoryBytes()
+    size_t textureBytes = 0; //<- bitmap pixels, wrapped ones included
+    size_t heightfieldBytes = 0;
+    size_t sharedBytes = 0; //<- saved by sharing, bytes of the references after the first
+    int meshes = 0; //<- distinct mesh data, levels of detail included
+    int textures = 0; //<- distinct bitmap pixels
+    int heightfields = 0;
+
+    /**
+     * @brief Bytes of all distinct assets
+     */
+    size_t total() const { return meshBytes + textureBytes + heightfieldBytes; }
+};
+
+/**
+ * @brief Bytes of the assets referenced by a node
+ */
+struct NodeMemory {
+    int body = -1;
+    int link = -1;
+    size_t bytes = 0; //<- distinct assets of the node, shared ones included
+    size_t ownedBytes = 0; //<- assets referenced by no other node of the graph
+};
+
+/**
+ * @brief Memory of the assets of one or more scene graphs
+ *
+ * Assets are told apart by their data in memory: copies of a bitmap share their pixels, and
+ * the asset caches hand out the same mesh data to all identical shapes, of all clients.
+ * Textures known by their file name only are not loaded in the scene graph and not counted,
+ * renderers account for their copies.
+ */
+class MemoryAccounting
+{
+  public:
+    /**
+     * @brief Account the assets of a graph, those already accounted are counted as shared
+     */
+    void add(const SceneGraph& graph);
+    /** @overload */
+    void add(const Mesh& mesh);
+    /** @overload */
+    void add(const Texture& texture);
+
+    /**
+     * @brief Bytes of the assets accounted so far
+     */
+    const AssetMemory& assets() const { return _assets; }
+
+    /**
+     * @brief Bytes of the assets of each node of a graph, by node id
+     */
+    static std::map<int, NodeMemory> nodes(const SceneGraph& graph);
+
+  private:
+    enum class Kind
+    {
+        Mesh,
+        Texture,
+        Heightfield,
+    };
+
+    void add(const void* key, size_t bytes, Kind kind);
+
+    std::unordered_map<const void*, size_t> _seen; //<- bytes of the accounted assets
+    AssetMemory _assets;
+};
+
+} // namespace scene
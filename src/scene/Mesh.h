@@ -4,12 +4,21 @@
 
 #pragma once
 
+#include "AssetTable.h"
+#include "Bounds.h"
+#include "QuantizedMesh.h"
+
+#include <utils/hash.h>
 #include <utils/math.h>
 
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace scene {
 
+class VertexBuffer;
+
 /**
  * @brief In-memory mesh data
  *
@@ -34,37 +43,202 @@ class MeshData
     MeshData(std::vector<float>&& vertices, std::vector<float>&& uvs, std::vector<float>&& normals,
              std::vector<int>&& indices) noexcept
         : _vertices(std::move(vertices)), _uvs(std::move(uvs)), _normals(std::move(normals)),
-          _indices(std::move(indices))
+          _indices(std::move(indices)), _bounds(AABB::FromVertices(_vertices))
+    {
+    }
+
+    /**
+     * @brief Copy, sharing the quantized attributes and their decoded floats
+     */
+    MeshData(const MeshData& other)
+        : _vertices(other._vertices), _uvs(other._uvs), _normals(other._normals),
+          _indices(other._indices), _bounds(other._bounds), _vertexBuffer(other._vertexBuffer),
+          _quantized(other._quantized), _decoded(std::atomic_load(&other._decoded)),
+          _hash(other._hash)
     {
     }
+    /** @overload */
+    MeshData& operator=(const MeshData& other)
+    {
+        if (this != &other)
+            *this = MeshData(other);
+        return *this;
+    }
+    MeshData(MeshData&&) noexcept = default;
+    MeshData& operator=(MeshData&&) noexcept = default;
 
     /**
-     * @brief Vertex coordinates
+     * @brief Vertex coordinates, decoded on first access if quantized
      */
-    const std::vector<float>& vertices() const { return _vertices; }
+    const std::vector<float>& vertices() const
+    {
+        return _quantized ? decoded().vertices : _vertices;
+    }
 
     /**
-     * @brief Vertex texture coordinates
+     * @brief Vertex texture coordinates, decoded on first access if quantized
      */
-    const std::vector<float>& uvs() const { return _uvs; }
+    const std::vector<float>& uvs() const { return _quantized ? decoded().uvs : _uvs; }
 
     /**
-     * @brief Vertex normals
+     * @brief Vertex normals, decoded on first access if quantized
      */
-    const std::vector<float>& normals() const { return _normals; }
+    const std::vector<float>& normals() const
+    {
+        return _quantized ? decoded().normals : _normals;
+    }
+
+    /**
+     * @brief Vertex coordinates to rewrite in place, quantized data is decoded for good
+     *
+     * Call updateBounds() once done.
+     */
+    std::vector<float>& mutableVertices()
+    {
+        unquantize();
+        _hash.reset();
+        return _vertices;
+    }
+
+    /**
+     * @brief Vertex normals to rewrite in place, quantized data is decoded for good
+     */
+    std::vector<float>& mutableNormals()
+    {
+        unquantize();
+        _hash.reset();
+        return _normals;
+    }
 
     /**
      * @brief Triangle indices
      */
     const std::vector<int>& indices() const { return _indices; }
 
+    /**
+     * @brief Number of vertices, without decoding quantized data
+     */
+    size_t numVertices() const
+    {
+        return _quantized ? _quantized->numVertices() : _vertices.size() / 3;
+    }
+
+    /**
+     * @brief Each vertex has a normal, without decoding quantized data
+     */
+    bool hasNormals() const
+    {
+        return _quantized ? _quantized->normals.size() / 2 == _quantized->numVertices()
+                          : _normals.size() == _vertices.size();
+    }
+
+    /**
+     * @brief Bytes held in memory: attributes, indices, quantized and decoded attributes, vertex
+     * buffer
+     */
+    size_t memoryBytes() const;
+
+    /**
+     * @brief Bounds of the vertices, cached
+     */
+    const AABB& bounds() const { return _bounds; }
+
+    /**
+     * @brief Recompute the cached bounds once vertices have been rewritten in place
+     *
+     * The vertex buffer, outdated, is dropped, and the hash computed again.
+     */
+    void updateBounds()
+    {
+        _bounds = _quantized ? quantizedBounds(*_quantized) : AABB::FromVertices(_vertices);
+        _vertexBuffer.reset();
+        _hash.reset();
+    }
+
+    /**
+     * @brief Interleaved copy for the GPU, made once when the data enters an asset cache
+     *
+     * Null unless enabled, see render::setVertexBufferMode(). Not serialized.
+     */
+    const std::shared_ptr<const VertexBuffer>& vertexBuffer() const { return _vertexBuffer; }
+    /** @overload */
+    void setVertexBuffer(const std::shared_ptr<const VertexBuffer>& vertexBuffer)
+    {
+        _vertexBuffer = vertexBuffer;
+    }
+
+    /**
+     * @brief Replace the float attributes by 16 bits ones, see QuantizedMesh
+     *
+     * Only for data not shared with other threads yet. The bounds become those of the
+     * quantization, the vertex buffer is dropped. Readers of vertices(), normals() and uvs()
+     * get decoded floats, kept from then on: backends able to read the quantized attributes
+     * should check quantized() first.
+     *
+     * @return false if the attributes cannot be quantized, e.g. counts do not match
+     */
+    bool quantize()
+    {
+        if (_quantized)
+            return true;
+        auto quantized = QuantizedMesh::make(_vertices, _normals, _uvs);
+        if (!quantized)
+            return false;
+        _quantized = std::move(quantized);
+        std::vector<float>().swap(_vertices);
+        std::vector<float>().swap(_uvs);
+        std::vector<float>().swap(_normals);
+        updateBounds();
+        return true;
+    }
+
+    /**
+     * @brief Quantized attributes, null for float data
+     */
+    const std::shared_ptr<const QuantizedMesh>& quantized() const { return _quantized; }
+
+    /**
+     * @brief Hash of the attributes and indices, computed once until they are rewritten
+     *
+     * Of the quantized attributes for quantized data, so that data quantized or not hash
+     * differently. Bitwise: equal hashes stand for equal data, see operator==().
+     */
+    uint64_t hash() const
+    {
+        return _hash.get([this] {
+            uint64_t h = hashWords(_indices.data(), _indices.size() * sizeof(int));
+            if (!_quantized) {
+                const uint64_t sizes[] = {_vertices.size(), _uvs.size(), _normals.size()};
+                h = hashBytes(sizes, sizeof(sizes), h);
+                h = hashWords(_vertices.data(), _vertices.size() * sizeof(float), h);
+                h = hashWords(_uvs.data(), _uvs.size() * sizeof(float), h);
+                return hashWords(_normals.data(), _normals.size() * sizeof(float), h);
+            }
+            const auto& q = *_quantized;
+            const uint64_t sizes[] = {q.positions.size(), q.uvs.size(), q.normals.size()};
+            h = hashBytes(sizes, sizeof(sizes), h);
+            h = hashBytes(q.positionOffset.data(), sizeof(q.positionOffset), h);
+            h = hashBytes(q.positionScale.data(), sizeof(q.positionScale), h);
+            h = hashBytes(q.uvOffset.data(), sizeof(q.uvOffset), h);
+            h = hashBytes(q.uvScale.data(), sizeof(q.uvScale), h);
+            h = hashWords(q.positions.data(), q.positions.size() * sizeof(uint16_t), h);
+            h = hashWords(q.uvs.data(), q.uvs.size() * sizeof(uint16_t), h);
+            return hashWords(q.normals.data(), q.normals.size() * sizeof(int16_t), h);
+        });
+    }
+
     /**
      * @brief Comparison operators
+     *
+     * By hash unless only one of the data is quantized, without walking the attributes once
+     * both hashes are cached.
      */
     bool operator==(const MeshData& other) const
     {
-        return _vertices == other._vertices && _uvs == other._uvs && _normals == other._normals &&
-               _indices == other._indices;
+        if (bool(_quantized) == bool(other._quantized))
+            return _indices.size() == other._indices.size() && hash() == other.hash();
+        return _indices == other._indices && vertices() == other.vertices() &&
+               uvs() == other.uvs() && normals() == other.normals();
     }
     bool operator!=(const MeshData& other) const { return !(*this == other); }
 
@@ -72,16 +246,91 @@ class MeshData
      * @brief Serialization
      */
     template <class Archive>
-    void serialize(Archive& ar)
+    void save(Archive& ar) const
+    {
+        ar(_vertices, _uvs, _normals, _indices);
+        const bool quantized = bool(_quantized);
+        ar(quantized);
+        if (quantized)
+            ar(*_quantized);
+    }
+    /** @overload */
+    template <class Archive>
+    void load(Archive& ar)
     {
         ar(_vertices, _uvs, _normals, _indices);
+        bool quantized = false;
+        ar(quantized);
+        if (quantized) {
+            auto data = std::make_shared<QuantizedMesh>();
+            ar(*data);
+            _quantized = std::move(data);
+        }
+        _decoded.reset();
+        updateBounds();
     }
 
   private:
+    /// float attributes of quantized data
+    struct DecodedAttributes {
+        std::vector<float> vertices;
+        std::vector<float> uvs;
+        std::vector<float> normals;
+    };
+
+    /// attributes decoded on first access, by the first of concurrent readers to publish them
+    const DecodedAttributes& decoded() const
+    {
+        auto decoded = std::atomic_load(&_decoded);
+        if (!decoded) {
+            auto attributes = std::make_shared<DecodedAttributes>();
+            _quantized->decode(attributes->vertices, attributes->normals, attributes->uvs);
+            decoded = std::move(attributes);
+            std::shared_ptr<const DecodedAttributes> published;
+            if (!std::atomic_compare_exchange_strong(&_decoded, &published, decoded))
+                decoded = published;
+        }
+        return *decoded; //<- owned by _decoded as well
+    }
+
+    /// back to float attributes
+    void unquantize()
+    {
+        if (!_quantized)
+            return;
+        const auto& attributes = decoded();
+        _vertices = attributes.vertices;
+        _uvs = attributes.uvs;
+        _normals = attributes.normals;
+        _quantized.reset();
+        _decoded.reset();
+        updateBounds();
+    }
+
+    static AABB quantizedBounds(const QuantizedMesh& quantized)
+    {
+        if (quantized.positions.empty())
+            return AABB::Empty();
+        AABB box = AABB::Empty();
+        box.extend(quantized.positionOffset);
+        Vector3f upper;
+        for (int k = 0; k < 3; ++k)
+            upper[k] = quantized.positionOffset[k] + quantized.positionScale[k];
+        box.extend(upper);
+        return box;
+    }
+
     std::vector<float> _vertices;
     std::vector<float> _uvs;
     std::vector<float> _normals;
     std::vector<int> _indices;
+    AABB _bounds = AABB::Empty(); //<- derived from vertices (not serialized)
+    std::shared_ptr<const VertexBuffer> _vertexBuffer; //<- derived from all (not serialized)
+    std::shared_ptr<const QuantizedMesh> _quantized; //<- replaces the float attributes if set
+    mutable std::shared_ptr<const DecodedAttributes> _decoded; //<- atomic, of _quantized
+    CachedHash _hash; //<- of the attributes and indices (not serialized)
+
+    friend class AssetTable; //<- placeholders hash like the data they wait for
 };
 
 /**
@@ -121,6 +370,44 @@ class Mesh
      */
     const std::shared_ptr<MeshData>& data() const { return _data; }
 
+    /**
+     * @brief Bounds of the mesh vertices
+     *
+     * Bounds of in-memory data, or of a mesh file as set by the loader caching it. Infinite
+     * until a mesh file is loaded.
+     */
+    const AABB& bounds() const { return _data ? _data->bounds() : _bounds; }
+    /** @overload */
+    void setBounds(const AABB& bounds) { _bounds = bounds; }
+
+    /**
+     * @brief Simplified versions of the mesh, coarser last
+     *
+     * Generated once when the mesh enters an asset cache, empty for meshes not worth
+     * simplifying or rewritten in place. Not serialized.
+     */
+    const std::vector<std::shared_ptr<MeshData>>& lods() const { return _lods; }
+    /** @overload */
+    void setLods(std::vector<std::shared_ptr<MeshData>>&& lods) { _lods = std::move(lods); }
+
+    /**
+     * @brief Process-wide asset id shared by identical meshes, -1 if not cached
+     *
+     * Renderers may use it to load or upload a mesh once per process.
+     */
+    int assetId() const { return _assetId; }
+    /** @overload */
+    void setAssetId(int assetId) { _assetId = assetId; }
+
+    /**
+     * @brief Hash of the file name and in-memory data, equal for equal meshes
+     */
+    uint64_t hash() const
+    {
+        const uint64_t h = hashBytes(_filename.data(), _filename.size());
+        return _data ? hashBytes(&h, sizeof(h), _data->hash()) : h;
+    }
+
     /**
      * @brief Comparison operators
      */
@@ -132,17 +419,55 @@ class Mesh
     bool operator!=(const Mesh& other) const { return !(*this == other); }
 
     /**
-     * @brief Serialization
+     * @brief Serialization, the data by content hash with an AssetTable
      */
     template <class Archive>
-    void serialize(Archive& ar)
+    void save(Archive& ar) const
+    {
+        ar(_filename);
+        AssetTable* table = assetTable(ar);
+        if (!table) {
+            ar(_data);
+            return;
+        }
+        // cached assets only, others may be rewritten in place and are sent in full
+        const bool shared = _data && _assetId >= 0;
+        const uint64_t hash = shared ? _data->hash() : 0;
+        const bool embedded = shared ? table->write(_data) : bool(_data);
+        ar(hash, embedded);
+        if (embedded)
+            ar(*_data);
+    }
+    /** @overload */
+    template <class Archive>
+    void load(Archive& ar)
     {
-        ar(_filename, _data);
+        ar(_filename);
+        AssetTable* table = assetTable(ar);
+        if (!table) {
+            ar(_data);
+            return;
+        }
+        uint64_t hash;
+        bool embedded;
+        ar(hash, embedded);
+        if (embedded) {
+            auto data = std::make_shared<MeshData>();
+            ar(*data);
+            _data = hash ? table->read(hash, std::move(data)) : std::move(data);
+        }
+        else {
+            _data = hash ? table->meshData(hash) : nullptr;
+        }
     }
 
   private:
     std::string _filename;
     std::shared_ptr<MeshData> _data;
+    // process-local (not serialized)
+    int _assetId = -1;
+    AABB _bounds = AABB::Infinite(); //<- bounds of the file mesh once loaded
+    std::vector<std::shared_ptr<MeshData>> _lods;
 };
 
 } // namespace scene
@@ -0,0 +1,83 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Mesh.h"
+
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Mesh under construction
+ */
+struct MeshBuilder {
+    std::vector<float> vertices;
+    std::vector<float> uvs;
+    std::vector<float> normals;
+    std::vector<int> indices;
+
+    int vertex(const Vector3f& p, const Vector3f& n, float u = 0.f, float v = 0.f)
+    {
+        vertices.insert(vertices.end(), p.begin(), p.end());
+        normals.insert(normals.end(), n.begin(), n.end());
+        uvs.push_back(u);
+        uvs.push_back(v);
+        return int(vertices.size() / 3) - 1;
+    }
+
+    void triangle(int a, int b, int c) { indices.insert(indices.end(), {a, b, c}); }
+
+    void quad(int a, int b, int c, int d)
+    {
+        triangle(a, b, c);
+        triangle(a, c, d);
+    }
+
+    std::shared_ptr<MeshData> build()
+    {
+        return std::make_shared<MeshData>(std::move(vertices), std::move(uvs),
+                                          std::move(normals), std::move(indices));
+    }
+};
+
+/**
+ * @brief Smooth vertex normals, the area-weighted average of the normals of adjacent triangles
+ *
+ * @param vertices - vertex coordinates
+ * @param indices - triangle indices
+ * @return Normal coordinates, zero for vertices of no triangle
+ */
+inline std::vector<float> smoothNormals(const std::vector<float>& vertices,
+                                        const std::vector<int>& indices)
+{
+    std::vector<float> normals(vertices.size(), 0.f);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const float* a = &vertices[indices[i] * 3];
+        const float* b = &vertices[indices[i + 1] * 3];
+        const float* c = &vertices[indices[i + 2] * 3];
+        const float u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const float v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        const float n[3] = {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2],
+                            u[0] * v[1] - u[1] * v[0]};
+        for (int k = 0; k < 3; ++k)
+            for (int j = 0; j < 3; ++j)
+                normals[indices[i + k] * 3 + j] += n[j];
+    }
+    for (size_t i = 0; i < normals.size(); i += 3) {
+        const float length =
+            std::sqrt(normals[i] * normals[i] + normals[i + 1] * normals[i + 1] +
+                      normals[i + 2] * normals[i + 2]);
+        if (length > 0.f)
+            for (int j = 0; j < 3; ++j)
+                normals[i + j] /= length;
+    }
+    return normals;
+}
+
+} // namespace scene
@@ -0,0 +1,261 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Bounds.h"
+#include "Camera.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Simplify a mesh by vertex clustering
+ *
+ * Vertices are merged per cell of a uniform grid dividing the longest side of the mesh bounds
+ * in \p resolution cells, and per dominant normal direction so that opposite faces of thin
+ * walls do not collapse. Merged vertices are averaged, triangles made degenerate or duplicated
+ * by the merge are dropped.
+ *
+ * @param mesh - mesh to simplify
+ * @param resolution - number of cells along the longest side of the bounds
+ * @return std::shared_ptr<MeshData>
+ */
+inline std::shared_ptr<MeshData> simplifyMesh(const MeshData& mesh, int resolution)
+{
+    const auto& vertices = mesh.vertices();
+    const auto& normals = mesh.normals();
+    const auto& uvs = mesh.uvs();
+    const auto& indices = mesh.indices();
+    const int count = int(vertices.size() / 3);
+    const bool hasNormals = normals.size() == vertices.size();
+    const bool hasUvs = int(uvs.size()) == count * 2;
+
+    const AABB& bounds = mesh.bounds();
+    float extent = 0.f;
+    for (int k = 0; k < 3; ++k)
+        extent = std::max(extent, bounds.upper[k] - bounds.lower[k]);
+    const float cell = extent > 0.f ? extent / std::max(resolution, 1) : 1.f;
+
+    // cluster key of each vertex: 3 x 20 bits of grid coordinates and 3 bits of normal direction
+    std::vector<std::pair<uint64_t, int>> keys(count);
+    for (int i = 0; i < count; ++i) {
+        uint64_t key = 0;
+        for (int k = 0; k < 3; ++k) {
+            const float t = (vertices[i * 3 + k] - bounds.lower[k]) / cell;
+            key = (key << 20) | uint64_t(std::min(std::max(int(t), 0), (1 << 20) - 1));
+        }
+        int direction = 0;
+        if (hasNormals) {
+            const float* n = &normals[i * 3];
+            int axis = 0;
+            for (int k = 1; k < 3; ++k)
+                if (std::abs(n[k]) > std::abs(n[axis]))
+                    axis = k;
+            direction = axis * 2 + (n[axis] < 0.f ? 1 : 0);
+        }
+        keys[i] = {(key << 3) | uint64_t(direction), i};
+    }
+    std::sort(keys.begin(), keys.end());
+
+    // one averaged vertex per cluster
+    std::vector<int> remap(count);
+    std::vector<float> newVertices, newNormals, newUvs;
+    for (int i = 0; i < count;) {
+        int j = i;
+        float p[3] = {0.f, 0.f, 0.f}, n[3] = {0.f, 0.f, 0.f}, uv[2] = {0.f, 0.f};
+        for (; j < count && keys[j].first == keys[i].first; ++j) {
+            const int v = keys[j].second;
+            remap[v] = int(newVertices.size() / 3);
+            for (int k = 0; k < 3; ++k) {
+                p[k] += vertices[v * 3 + k];
+                if (hasNormals)
+                    n[k] += normals[v * 3 + k];
+            }
+            if (hasUvs) {
+                uv[0] += uvs[v * 2];
+                uv[1] += uvs[v * 2 + 1];
+            }
+        }
+        const float weight = 1.f / float(j - i);
+        for (int k = 0; k < 3; ++k)
+            newVertices.push_back(p[k] * weight);
+        if (hasNormals) {
+            const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k)
+                newNormals.push_back(length > 0.f ? n[k] / length : 0.f);
+        }
+        if (hasUvs) {
+            newUvs.push_back(uv[0] * weight);
+            newUvs.push_back(uv[1] * weight);
+        }
+        i = j;
+    }
+
+    // surviving triangles, rotated to start with their smallest index to spot duplicates
+    std::vector<std::array<int, 3>> triangles;
+    triangles.reserve(indices.size() / 3);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        std::array<int, 3> t{remap[indices[i]], remap[indices[i + 1]], remap[indices[i + 2]]};
+        if (t[0] == t[1] || t[1] == t[2] || t[2] == t[0])
+            continue;
+        std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+        triangles.push_back(t);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+    std::vector<int> newIndices;
+    newIndices.reserve(triangles.size() * 3);
+    for (const auto& t : triangles)
+        newIndices.insert(newIndices.end(), t.begin(), t.end());
+    return std::make_shared<MeshData>(std::move(newVertices), std::move(newUvs),
+                                      std::move(newNormals), std::move(newIndices));
+}
+
+/**
+ * @brief Chain of simplified versions of a mesh
+ *
+ * Each level has about a quarter of the triangles of the previous one, i.e. it suits a mesh
+ * covering half the screen size. The chain stops when a level would have less than
+ * \p minTriangles triangles or would not simplify further. Meshes below \p minTriangles * 4
+ * triangles get no levels.
+ *
+ * @param mesh - full detail mesh
+ * @param maxLevels - maximum number of simplified levels
+ * @param minTriangles - smallest number of triangles of a level
+ * @return Simplified levels, coarser last
+ */
+inline std::vector<std::shared_ptr<MeshData>> makeMeshLods(const MeshData& mesh,
+                                                           int maxLevels = 4,
+                                                           int minTriangles = 128)
+{
+    std::vector<std::shared_ptr<MeshData>> lods;
+    int triangles = int(mesh.indices().size() / 3);
+    int resolution = 1024;
+    for (int level = 0; level < maxLevels; ++level) {
+        const int target = triangles / 4;
+        if (target < minTriangles)
+            break;
+
+        // coarsest grid still keeping more than the target triangle count, each level being
+        // simplified from the previous one
+        const MeshData& source = lods.empty() ? mesh : *lods.back();
+        std::shared_ptr<MeshData> best;
+        int low = 1, high = resolution;
+        while (low <= high) {
+            const int middle = (low + high) / 2;
+            auto lod = simplifyMesh(source, middle);
+            if (int(lod->indices().size() / 3) >= target) {
+                best = std::move(lod);
+                resolution = middle;
+                high = middle - 1;
+            }
+            else {
+                low = middle + 1;
+            }
+        }
+        const int simplified = best ? int(best->indices().size() / 3) : triangles;
+        if (!best || simplified > triangles * 3 / 4)
+            break;
+
+        lods.push_back(std::move(best));
+        triangles = simplified;
+    }
+    return lods;
+}
+
+/**
+ * @brief Level of detail selection from the projected screen size of bounds
+ *
+ * A mesh is drawn at full detail while its bounding sphere covers at least \p fullDetailSize
+ * pixels vertically, then one level coarser at each halving of this size.
+ */
+class LodPolicy
+{
+  public:
+    /**
+     * @brief Construct a new LodPolicy object
+     *
+     * @param fullDetailSize - smallest screen size in pixels drawn at full detail, 0 disables
+     * simplified levels
+     */
+    explicit LodPolicy(float fullDetailSize = 256.f) : _fullDetailSize(fullDetailSize) {}
+
+    /**
+     * @brief Smallest screen size in pixels drawn at full detail
+     */
+    float fullDetailSize() const { return _fullDetailSize; }
+    /** @overload */
+    void setFullDetailSize(float size) { _fullDetailSize = size; }
+
+    /**
+     * @brief Projected diameter in pixels of the bounding sphere of a box
+     *
+     * @param worldBounds - box in world frame
+     * @param camera - camera
+     * @param viewportRows - viewport height in pixels
+     * @return Size, infinite if the camera is inside the sphere or the box is infinite
+     */
+    static float screenSize(const AABB& worldBounds, const Camera& camera, int viewportRows)
+    {
+        const float inf = std::numeric_limits<float>::infinity();
+        if (worldBounds.empty())
+            return 0.f;
+        if (worldBounds.infinite())
+            return inf;
+
+        float center[3], radius2 = 0.f;
+        for (int k = 0; k < 3; ++k) {
+            center[k] = (worldBounds.lower[k] + worldBounds.upper[k]) / 2;
+            const float half = (worldBounds.upper[k] - worldBounds.lower[k]) / 2;
+            radius2 += half * half;
+        }
+        const float radius = std::sqrt(radius2);
+        const auto& view = camera.viewMatrix();
+        const auto& proj = camera.projMatrix();
+        const float scale = proj[5] * float(viewportRows); //<- radius to diameter in pixels at unit depth
+        if (proj[15] == 1.f)
+            return radius * scale; // orthographic
+
+        const float depth =
+            -(view[2] * center[0] + view[6] * center[1] + view[10] * center[2] + view[14]);
+        return depth > radius ? radius / depth * scale : inf;
+    }
+
+    /**
+     * @brief Level to draw a mesh at, 0 for full detail
+     *
+     * @param worldBounds - mesh bounds in world frame
+     * @param camera - camera
+     * @param viewportRows - viewport height in pixels
+     * @param numLevels - number of levels of the mesh, full detail included
+     */
+    int select(const AABB& worldBounds, const Camera& camera, int viewportRows,
+               int numLevels) const
+    {
+        if (numLevels <= 1 || _fullDetailSize <= 0.f)
+            return 0;
+
+        const float size = screenSize(worldBounds, camera, viewportRows);
+        if (!(size < _fullDetailSize))
+            return 0;
+        const int level = size > 0.f ? int(std::log2(_fullDetailSize / size)) + 1 : numLevels;
+        return std::min(level, numLevels - 1);
+    }
+
+  private:
+    float _fullDetailSize;
+};
+
+} // namespace scene
@@ -0,0 +1,393 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "MeshOptimizer.h"
+
+#include <utils/hash.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace scene {
+
+namespace {
+
+constexpr int kFifoSize = 16;           //<- simulated cache of the reported ratios
+constexpr int kOptimizerCacheSize = 32; //<- LRU cache modelled by the triangle ordering
+constexpr float kOverdrawThreshold = 1.05f; //<- cache miss ratio traded against overdraw
+
+/**
+ * @brief Triangles of each vertex, the live ones first
+ */
+struct Adjacency {
+    std::vector<int> offsets; //<- first triangle of each vertex, and the end
+    std::vector<int> triangles;
+
+    Adjacency(const std::vector<int>& indices, int numVertices) : offsets(numVertices + 1, 0)
+    {
+        for (int index : indices)
+            ++offsets[index + 1];
+        for (int v = 0; v < numVertices; ++v)
+            offsets[v + 1] += offsets[v];
+        triangles.resize(indices.size());
+        std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            triangles[cursor[indices[i]]++] = int(i / 3);
+    }
+};
+
+/**
+ * @brief Simulated FIFO post-transform cache
+ */
+class FifoCache
+{
+  public:
+    explicit FifoCache(int numVertices) : _stamps(size_t(numVertices), 0) {}
+
+    /// transformed vertices of a triangle
+    int misses(const int* triangle)
+    {
+        int count = 0;
+        for (int k = 0; k < 3; ++k) {
+            const int v = triangle[k];
+            if (_stamps[v] == 0 || _time - _stamps[v] >= kFifoSize) {
+                _stamps[v] = ++_time;
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    /// evict all vertices
+    void reset() { _time += kFifoSize; }
+
+  private:
+    std::vector<uint32_t> _stamps; //<- miss count when each vertex entered the cache
+    uint32_t _time = 0;
+};
+
+/// first vertex of the bitwise identical attributes of each vertex
+void mergeVertices(const MeshData& mesh, std::vector<int>& remap)
+{
+    const auto& vertices = mesh.vertices();
+    const auto& normals = mesh.normals();
+    const auto& uvs = mesh.uvs();
+    const int count = int(vertices.size() / 3);
+    const bool hasNormals = normals.size() == vertices.size();
+    const bool hasUvs = int(uvs.size()) == count * 2;
+
+    const auto hash = [&](int v) {
+        uint64_t h = hashBytes(&vertices[v * 3], 3 * sizeof(float));
+        if (hasNormals)
+            h = hashBytes(&normals[v * 3], 3 * sizeof(float), h);
+        if (hasUvs)
+            h = hashBytes(&uvs[v * 2], 2 * sizeof(float), h);
+        return h;
+    };
+    const auto equal = [&](int a, int b) {
+        return !std::memcmp(&vertices[a * 3], &vertices[b * 3], 3 * sizeof(float)) &&
+               (!hasNormals ||
+                !std::memcmp(&normals[a * 3], &normals[b * 3], 3 * sizeof(float))) &&
+               (!hasUvs || !std::memcmp(&uvs[a * 2], &uvs[b * 2], 2 * sizeof(float)));
+    };
+
+    // open addressing, first vertex of each distinct attribute set
+    size_t size = 16;
+    while (size < size_t(count) * 2)
+        size *= 2;
+    std::vector<int> table(size, -1);
+    remap.resize(count);
+    for (int v = 0; v < count; ++v) {
+        size_t slot = size_t(hash(v)) & (size - 1);
+        while (table[slot] >= 0 && !equal(table[slot], v))
+            slot = (slot + 1) & (size - 1);
+        if (table[slot] < 0)
+            table[slot] = v;
+        remap[v] = table[slot];
+    }
+}
+
+/// triangles reordered for an LRU post-transform cache, Forsyth's linear-speed algorithm
+std::vector<int> cacheOrder(const std::vector<int>& indices, int numVertices)
+{
+    const int numTriangles = int(indices.size() / 3);
+    Adjacency adjacency(indices, numVertices);
+    std::vector<int> live(numVertices);
+    for (int v = 0; v < numVertices; ++v)
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+    float positionScores[kOptimizerCacheSize];
+    for (int i = 0; i < kOptimizerCacheSize; ++i)
+        positionScores[i] =
+            i < 3 ? 0.75f
+                  : std::pow(1.f - float(i - 3) / float(kOptimizerCacheSize - 3), 1.5f);
+    std::vector<int> positions(numVertices, -1);
+    const auto vertexScore = [&](int v) {
+        if (live[v] == 0)
+            return -1.f;
+        const float cached = positions[v] >= 0 ? positionScores[positions[v]] : 0.f;
+        return cached + 2.f / std::sqrt(float(live[v])); //<- favours finishing lone vertices
+    };
+
+    std::vector<float> vertexScores(numVertices);
+    for (int v = 0; v < numVertices; ++v)
+        vertexScores[v] = vertexScore(v);
+    const auto triangleScore = [&](int t) {
+        return vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] +
+               vertexScores[indices[t * 3 + 2]];
+    };
+    int best = -1;
+    for (int t = 0; t < numTriangles; ++t)
+        if (best < 0 || triangleScore(t) > triangleScore(best))
+            best = t;
+
+    std::vector<char> emitted(numTriangles, 0);
+    std::vector<int> cache, next;
+    cache.reserve(kOptimizerCacheSize + 3);
+    next.reserve(kOptimizerCacheSize + 3);
+    std::vector<int> order;
+    order.reserve(indices.size());
+    int cursor = 0;
+    for (int n = 0; n < numTriangles; ++n) {
+        if (best < 0) {
+            // dead end, no cached vertex has triangles left
+            while (emitted[cursor])
+                ++cursor;
+            best = cursor;
+        }
+        const int t = best;
+        const int* triangle = &indices[t * 3];
+        emitted[t] = 1;
+        order.insert(order.end(), triangle, triangle + 3);
+
+        // the triangle leaves the live triangles of its vertices
+        for (int k = 0; k < 3; ++k) {
+            const int v = triangle[k];
+            int* begin = &adjacency.triangles[adjacency.offsets[v]];
+            std::swap(*std::find(begin, begin + live[v], t), begin[live[v] - 1]);
+            --live[v];
+        }
+
+        // its vertices move to the front of the cache
+        next.assign(triangle, triangle + 3);
+        for (int v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                next.push_back(v);
+        for (size_t i = 0; i < next.size(); ++i) {
+            positions[next[i]] = i < size_t(kOptimizerCacheSize) ? int(i) : -1;
+            vertexScores[next[i]] = vertexScore(next[i]);
+        }
+
+        // best triangle of the cached vertices
+        next.resize(std::min(next.size(), size_t(kOptimizerCacheSize)));
+        best = -1;
+        float bestScore = -1.f;
+        for (int v : next) {
+            const int* begin = &adjacency.triangles[adjacency.offsets[v]];
+            for (const int* it = begin; it != begin + live[v]; ++it) {
+                const float score = triangleScore(*it);
+                if (score > bestScore) {
+                    best = *it;
+                    bestScore = score;
+                }
+            }
+        }
+        std::swap(cache, next);
+    }
+    return order;
+}
+
+/// cache ordered triangles split in clusters drawn outward-facing first
+std::vector<int> overdrawOrder(const std::vector<float>& vertices,
+                               const std::vector<int>& indices, int numVertices)
+{
+    const int numTriangles = int(indices.size() / 3);
+
+    // hard boundaries where the cache order restarts, no vertex of the triangle being cached
+    std::vector<int> hard;
+    {
+        FifoCache cache(numVertices);
+        for (int t = 0; t < numTriangles; ++t)
+            if (cache.misses(&indices[t * 3]) == 3)
+                hard.push_back(t);
+        hard.push_back(numTriangles);
+    }
+
+    // soft boundaries inside, once a cluster drawn from a cold cache is efficient enough
+    std::vector<int> starts;
+    FifoCache cache(numVertices);
+    for (size_t h = 0; h + 1 < hard.size(); ++h) {
+        int misses = 0;
+        for (int t = hard[h]; t < hard[h + 1]; ++t)
+            misses += cache.misses(&indices[t * 3]);
+        const float limit = kOverdrawThreshold * float(misses) / float(hard[h + 1] - hard[h]);
+
+        cache.reset();
+        int start = hard[h];
+        misses = 0;
+        starts.push_back(start);
+        for (int t = start; t + 1 < hard[h + 1]; ++t) {
+            misses += cache.misses(&indices[t * 3]);
+            if (float(misses) <= limit * float(t + 1 - start)) {
+                cache.reset();
+                start = t + 1;
+                misses = 0;
+                starts.push_back(start);
+            }
+        }
+        cache.reset();
+    }
+    starts.push_back(numTriangles);
+
+    // clusters facing away from the mesh centroid occlude the others, drawn first
+    const int numClusters = int(starts.size()) - 1;
+    std::vector<double> areas(numClusters, 0.), centroids(numClusters * 3, 0.),
+        normals(numClusters * 3, 0.);
+    double meshArea = 0., meshCentroid[3] = {0., 0., 0.};
+    for (int c = 0; c < numClusters; ++c) {
+        for (int t = starts[c]; t < starts[c + 1]; ++t) {
+            const float* a = &vertices[indices[t * 3] * 3];
+            const float* b = &vertices[indices[t * 3 + 1] * 3];
+            const float* p = &vertices[indices[t * 3 + 2] * 3];
+            const double u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            const double v[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+            const double n[3] = {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2],
+                                 u[0] * v[1] - u[1] * v[0]};
+            const double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            areas[c] += area;
+            for (int k = 0; k < 3; ++k) {
+                centroids[c * 3 + k] += area * (a[k] + b[k] + p[k]) / 3;
+                normals[c * 3 + k] += n[k];
+            }
+        }
+        meshArea += areas[c];
+        for (int k = 0; k < 3; ++k)
+            meshCentroid[k] += centroids[c * 3 + k];
+    }
+    std::vector<std::pair<double, int>> keys(numClusters);
+    for (int c = 0; c < numClusters; ++c) {
+        double key = 0.;
+        const double* n = &normals[c * 3];
+        const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (areas[c] > 0. && length > 0.)
+            for (int k = 0; k < 3; ++k)
+                key += (centroids[c * 3 + k] / areas[c] - meshCentroid[k] / meshArea) * n[k] /
+                       length;
+        keys[c] = {-key, c};
+    }
+    std::stable_sort(keys.begin(), keys.end(),
+                     [](const std::pair<double, int>& a, const std::pair<double, int>& b) {
+                         return a.first < b.first;
+                     });
+
+    std::vector<int> order;
+    order.reserve(indices.size());
+    for (const auto& key : keys)
+        order.insert(order.end(), indices.begin() + starts[key.second] * 3,
+                     indices.begin() + starts[key.second + 1] * 3);
+    return order;
+}
+
+} // namespace
+
+float cacheMissRatio(const std::vector<int>& indices, int cacheSize)
+{
+    const size_t numTriangles = indices.size() / 3;
+    if (numTriangles == 0)
+        return 0.f;
+
+    // vertices are cached while fewer than cacheSize others were transformed after them
+    int numVertices = 0;
+    for (int index : indices)
+        numVertices = std::max(numVertices, index + 1);
+    std::vector<uint32_t> stamps(size_t(numVertices), 0);
+    uint32_t time = 0;
+    size_t misses = 0;
+    for (size_t i = 0; i < numTriangles * 3; ++i) {
+        const int v = indices[i];
+        if (v < 0) {
+            ++misses; //<- invalid, never cached
+        }
+        else if (stamps[v] == 0 || time - stamps[v] >= uint32_t(cacheSize)) {
+            stamps[v] = ++time;
+            ++misses;
+        }
+    }
+    return float(misses) / float(numTriangles);
+}
+
+std::shared_ptr<MeshData> optimizeMesh(const MeshData& mesh, MeshOptimizationStats* stats)
+{
+    const auto& vertices = mesh.vertices();
+    const auto& normals = mesh.normals();
+    const auto& uvs = mesh.uvs();
+    const auto& indices = mesh.indices();
+    const int count = int(vertices.size() / 3);
+    const bool hasNormals = normals.size() == vertices.size();
+    const bool hasUvs = int(uvs.size()) == count * 2;
+
+    MeshOptimizationStats result;
+    result.acmrBefore = cacheMissRatio(indices, kFifoSize);
+    result.verticesBefore = count;
+
+    const bool valid = indices.size() % 3 == 0 &&
+                       std::all_of(indices.begin(), indices.end(),
+                                   [count](int index) { return index >= 0 && index < count; });
+    if (!valid) {
+        result.acmrAfter = result.acmrBefore;
+        result.verticesAfter = count;
+        result.triangles = int(indices.size() / 3);
+        if (stats)
+            *stats = result;
+        return std::make_shared<MeshData>(std::vector<float>(vertices), std::vector<float>(uvs),
+                                          std::vector<float>(normals), std::vector<int>(indices));
+    }
+
+    // duplicated vertices merged, collapsed triangles dropped
+    std::vector<int> remap;
+    mergeVertices(mesh, remap);
+    std::vector<int> merged;
+    merged.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        const int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+        if (a != b && b != c && c != a)
+            merged.insert(merged.end(), {a, b, c});
+    }
+
+    auto order = cacheOrder(merged, count);
+    auto sorted = overdrawOrder(vertices, order, count);
+    if (cacheMissRatio(sorted, kFifoSize) <=
+        kOverdrawThreshold * cacheMissRatio(order, kFifoSize))
+        order = std::move(sorted);
+
+    // vertices in order of first use
+    std::vector<int> fetch(count, -1);
+    std::vector<float> newVertices, newNormals, newUvs;
+    newVertices.reserve(vertices.size());
+    for (int& index : order) {
+        const int v = index;
+        if (fetch[v] < 0) {
+            fetch[v] = int(newVertices.size() / 3);
+            newVertices.insert(newVertices.end(), &vertices[v * 3], &vertices[v * 3] + 3);
+            if (hasNormals)
+                newNormals.insert(newNormals.end(), &normals[v * 3], &normals[v * 3] + 3);
+            if (hasUvs)
+                newUvs.insert(newUvs.end(), &uvs[v * 2], &uvs[v * 2] + 2);
+        }
+        index = fetch[v];
+    }
+
+    result.acmrAfter = cacheMissRatio(order, kFifoSize);
+    result.verticesAfter = int(newVertices.size() / 3);
+    result.triangles = int(order.size() / 3);
+    if (stats)
+        *stats = result;
+    return std::make_shared<MeshData>(std::move(newVertices), std::move(newUvs),
+                                      std::move(newNormals), std::move(order));
+}
+
+} // namespace scene
@@ -0,0 +1,53 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Mesh.h"
+
+#include <memory>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Post-transform cache efficiency of a mesh before and after optimizeMesh()
+ */
+struct MeshOptimizationStats {
+    float acmrBefore = 0.f; //<- average cache miss ratio, transformed vertices per triangle
+    float acmrAfter = 0.f;
+    int verticesBefore = 0;
+    int verticesAfter = 0;
+    int triangles = 0; //<- after dropping triangles with a repeated vertex
+};
+
+/**
+ * @brief Average cache miss ratio of a triangle list, vertices transformed per triangle
+ *
+ * Simulates a FIFO post-transform cache, as found in most GPUs. 3 means no reuse at all, a
+ * well ordered regular grid gets close to 0.5.
+ *
+ * @param indices - triangle indices
+ * @param cacheSize - number of vertices in the cache
+ * @return Misses per triangle, 0 for no triangles
+ */
+float cacheMissRatio(const std::vector<int>& indices, int cacheSize = 16);
+
+/**
+ * @brief Reorder a mesh for the vertex pipeline of GPUs, without changing its rendering
+ *
+ * Vertices with identical attributes are merged, triangles are reordered for post-transform
+ * cache locality (Forsyth's linear-speed algorithm), then clusters of them sorted to draw
+ * outward-facing ones first against overdraw (Sander et al.) as long as the cache miss ratio
+ * stays within 5%, and vertices are finally renumbered in order of first use for fetch
+ * locality. Triangles with a repeated vertex are dropped.
+ *
+ * @param mesh - mesh data
+ * @param stats - if not null, cache miss ratios and counts before and after
+ * @return std::shared_ptr<MeshData> - reordered copy, a plain copy if indices are out of range
+ */
+std::shared_ptr<MeshData> optimizeMesh(const MeshData& mesh,
+                                       MeshOptimizationStats* stats = nullptr);
+
+} // namespace scene
@@ -6,10 +6,21 @@
 
 #include "Shape.h"
 
+#include <algorithm>
 #include <vector>
 
 namespace scene {
 
+/**
+ * @brief Values drawn into the segmentation masks, see Node::segmentation()
+ */
+enum class SegmentationMode
+{
+    BodyLink, //<- body + ((link + 1) << 24), as decoded by the python renderers
+    Instance, //<- instance id of the shape, else of its node, else the BodyLink value
+    Semantic, //<- semantic class id of the shape, else of its node, else 0
+};
+
 /**
  * @brief Scene node
  *
@@ -45,6 +56,39 @@ class Node
      */
     bool noCache() const { return _noCache; }
 
+    /**
+     * @brief User instance id of the shapes without their own, -1 for none
+     */
+    int instanceId() const { return _instanceId; }
+    /** @overload */
+    void setInstanceId(int instanceId) { _instanceId = instanceId; }
+
+    /**
+     * @brief User semantic class id of the shapes without their own, -1 for none
+     */
+    int semanticId() const { return _semanticId; }
+    /** @overload */
+    void setSemanticId(int semanticId) { _semanticId = semanticId; }
+
+    /**
+     * @brief Mask value of a shape
+     *
+     * @param shapeIndex - shape index
+     * @param mode - id scheme of the scene, see SceneGraph::segmentationMode()
+     * @return int - value drawn into the segmentation masks
+     */
+    int segmentation(int shapeIndex, SegmentationMode mode) const
+    {
+        const Shape& shape = _shapes[shapeIndex];
+        if (mode == SegmentationMode::Semantic)
+            return shape.semanticId() >= 0 ? shape.semanticId() : std::max(_semanticId, 0);
+        if (mode == SegmentationMode::Instance && shape.instanceId() >= 0)
+            return shape.instanceId();
+        if (mode == SegmentationMode::Instance && _instanceId >= 0)
+            return _instanceId;
+        return _body + ((_link + 1) << 24);
+    }
+
     /**
      * @brief Vector of object's shapes
      *
@@ -63,13 +107,39 @@ class Node
     /** @overload */
     const Shape& shape(int index) const { return _shapes.at(index); }
 
+    /**
+     * @brief Bounds of the shapes in the node frame
+     */
+    AABB bounds() const
+    {
+        AABB box = AABB::Empty();
+        for (const auto& shape : _shapes)
+            box.extend(shape.bounds().transformed(shape.pose().matrix()));
+        return box;
+    }
+
+    /**
+     * @brief Hash of the content, equal for equal nodes, see Shape::hash()
+     */
+    uint64_t hash() const
+    {
+        const int ids[] = {_body, _link, int(_noCache), _instanceId, _semanticId};
+        uint64_t h = hashBytes(ids, sizeof(ids));
+        for (const auto& shape : _shapes) {
+            const uint64_t part = shape.hash();
+            h = hashBytes(&part, sizeof(part), h);
+        }
+        return h;
+    }
+
     /**
      * @brief Comparison operators
      */
     bool operator==(const Node& other) const
     {
         return _body == other._body && _link == other._link && _noCache == other._noCache &&
-               _shapes == other._shapes;
+               _shapes == other._shapes && _instanceId == other._instanceId &&
+               _semanticId == other._semanticId;
     }
     bool operator!=(const Node& other) const { return !(*this == other); }
 
@@ -79,7 +149,7 @@ class Node
     template <class Archive>
     void serialize(Archive& ar)
     {
-        ar(_body, _link, _noCache, _shapes);
+        ar(_body, _link, _noCache, _shapes, _instanceId, _semanticId);
     }
 
   private:
@@ -87,6 +157,8 @@ class Node
     int _link;
     bool _noCache;
     std::vector<Shape> _shapes;
+    int _instanceId = -1;
+    int _semanticId = -1;
 };
 
 } // namespace scene
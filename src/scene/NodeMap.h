@@ -0,0 +1,264 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Node.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Handle of a node in a NodeMap, stable while the node lives
+ *
+ * Unlike dense indices, handles are not changed by the removal of other nodes, and a handle of
+ * a removed node never finds the node reusing its slot.
+ */
+struct NodeHandle {
+    uint32_t slot = ~0u;     //<- slot of the node
+    uint32_t generation = 0; //<- generation of the slot when the node was appended
+
+    bool valid() const { return slot != ~0u; }
+    bool operator==(const NodeHandle& other) const
+    {
+        return slot == other.slot && generation == other.generation;
+    }
+    bool operator!=(const NodeHandle& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Nodes of a scene graph by id, stored densely
+ *
+ * Nodes lie contiguously in a vector, as pairs of id and node iterated like those of a map,
+ * with parallel arrays of ids, bodies and links for bulk access. Removing a node moves the last
+ * one in its place, as SceneState does with its slots, so that the order of the nodes is that
+ * of their insertion until nodes are removed. Ids are looked up in a hash table; handles give
+ * direct access through a slot table.
+ */
+class NodeMap
+{
+  public:
+    using value_type = std::pair<int, Node>;
+    using const_iterator = std::vector<value_type>::const_iterator;
+    using iterator = std::vector<value_type>::iterator;
+
+    /**
+     * @brief Iteration over id - node pairs
+     */
+    const_iterator begin() const { return _entries.begin(); }
+    const_iterator end() const { return _entries.end(); }
+    iterator begin() { return _entries.begin(); }
+    iterator end() { return _entries.end(); }
+
+    /**
+     * @brief Number of nodes
+     */
+    size_t size() const { return _entries.size(); }
+
+    /**
+     * @brief No nodes
+     */
+    bool empty() const { return _entries.empty(); }
+
+    /**
+     * @brief Number of nodes with an id, 0 or 1
+     */
+    size_t count(int nodeId) const { return _indices.count(nodeId); }
+
+    /**
+     * @brief Node of an id, end() if none
+     */
+    const_iterator find(int nodeId) const
+    {
+        const auto it = _indices.find(nodeId);
+        return it != _indices.end() ? _entries.begin() + it->second : _entries.end();
+    }
+
+    /**
+     * @brief Node of an id
+     *
+     * @param nodeId - unique node id
+     * @throw std::out_of_range - if no such element exists
+     */
+    const Node& at(int nodeId) const { return _entries[_indices.at(nodeId)].second; }
+    /** @overload */
+    Node& at(int nodeId) { return _entries[_indices.at(nodeId)].second; }
+
+    /**
+     * @brief Append a node, nothing if the id is already used
+     *
+     * @return bool - the node was appended
+     */
+    bool emplace(int nodeId, Node&& node)
+    {
+        const auto index = uint32_t(_entries.size());
+        if (!_indices.emplace(nodeId, index).second)
+            return false;
+
+        uint32_t slot;
+        if (_freeSlots.empty()) {
+            slot = uint32_t(_slots.size());
+            _slots.push_back({index, 0});
+        }
+        else {
+            slot = _freeSlots.back();
+            _freeSlots.pop_back();
+            _slots[slot].index = index;
+        }
+        _ids.push_back(nodeId);
+        _bodies.push_back(node.body());
+        _links.push_back(node.link());
+        _slotOfIndex.push_back(slot);
+        _entries.emplace_back(nodeId, std::move(node));
+        return true;
+    }
+
+    /**
+     * @brief Remove a node, the last node taking its place
+     *
+     * @return size_t - number of removed nodes, 0 or 1
+     */
+    size_t erase(int nodeId)
+    {
+        const auto it = _indices.find(nodeId);
+        if (it == _indices.end())
+            return 0;
+
+        const uint32_t index = it->second;
+        const uint32_t last = uint32_t(_entries.size()) - 1;
+        auto& slot = _slots[_slotOfIndex[index]];
+        ++slot.generation;
+        _freeSlots.push_back(_slotOfIndex[index]);
+        if (index != last) {
+            _entries[index] = std::move(_entries[last]);
+            _ids[index] = _ids[last];
+            _bodies[index] = _bodies[last];
+            _links[index] = _links[last];
+            _slotOfIndex[index] = _slotOfIndex[last];
+            _slots[_slotOfIndex[index]].index = index;
+            _indices[_ids[index]] = index;
+        }
+        _entries.pop_back();
+        _ids.pop_back();
+        _bodies.pop_back();
+        _links.pop_back();
+        _slotOfIndex.pop_back();
+        _indices.erase(it);
+        return 1;
+    }
+
+    /**
+     * @brief Remove all nodes, invalidating all handles
+     */
+    void clear()
+    {
+        for (uint32_t slot : _slotOfIndex) {
+            ++_slots[slot].generation;
+            _freeSlots.push_back(slot);
+        }
+        _entries.clear();
+        _ids.clear();
+        _bodies.clear();
+        _links.clear();
+        _slotOfIndex.clear();
+        _indices.clear();
+    }
+
+    /**
+     * @brief Handle of a node, invalid if there is no such node
+     */
+    NodeHandle handle(int nodeId) const
+    {
+        const auto it = _indices.find(nodeId);
+        if (it == _indices.end())
+            return {};
+        const uint32_t slot = _slotOfIndex[it->second];
+        return {slot, _slots[slot].generation};
+    }
+
+    /**
+     * @brief Index of the node of a handle in the dense arrays, -1 if removed since
+     */
+    int index(NodeHandle handle) const
+    {
+        if (handle.slot >= _slots.size() || _slots[handle.slot].generation != handle.generation)
+            return -1;
+        return int(_slots[handle.slot].index);
+    }
+
+    /**
+     * @brief Node of a handle, null if removed since
+     */
+    const Node* get(NodeHandle handle) const
+    {
+        const int i = index(handle);
+        return i >= 0 ? &_entries[i].second : nullptr;
+    }
+
+    /**
+     * @brief Node ids, bodies and links, one per node in iteration order
+     */
+    const std::vector<int>& ids() const { return _ids; }
+    const std::vector<int>& bodies() const { return _bodies; }
+    const std::vector<int>& links() const { return _links; }
+
+    /**
+     * @brief Comparison operators
+     *
+     * Maps are equal if they hold equal nodes with the same ids, whatever the order.
+     */
+    bool operator==(const NodeMap& other) const
+    {
+        if (size() != other.size())
+            return false;
+        for (const auto& it : _entries) {
+            const auto jt = other.find(it.first);
+            if (jt == other.end() || it.second != jt->second)
+                return false;
+        }
+        return true;
+    }
+    bool operator!=(const NodeMap& other) const { return !(*this == other); }
+
+    /**
+     * @brief Serialization
+     */
+    template <class Archive>
+    void save(Archive& ar) const
+    {
+        ar(_entries);
+    }
+    /** @overload */
+    template <class Archive>
+    void load(Archive& ar)
+    {
+        std::vector<value_type> entries;
+        ar(entries);
+        *this = NodeMap();
+        for (auto& it : entries)
+            emplace(it.first, std::move(it.second));
+    }
+
+  private:
+    struct Slot {
+        uint32_t index;      //<- index of the node in the dense arrays
+        uint32_t generation; //<- incremented each time the node of the slot is removed
+    };
+
+    std::vector<value_type> _entries;
+    std::vector<int> _ids;
+    std::vector<int> _bodies;
+    std::vector<int> _links;
+    std::vector<uint32_t> _slotOfIndex; //<- dense index -> slot
+    std::unordered_map<int, uint32_t> _indices; //<- node id -> dense index
+    std::vector<Slot> _slots;
+    std::vector<uint32_t> _freeSlots;
+};
+
+} // namespace scene
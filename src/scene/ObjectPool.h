@@ -0,0 +1,174 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Blocks of a single size carved out of large chunks
+ *
+ * Allocations are served from a free list, chunks are only freed with the pool, all at once.
+ * The block size is that of the first allocation; allocations of other sizes fall back to
+ * operator new. Thread safe: objects of a scene graph may die on a render thread.
+ */
+class ObjectPool
+{
+  public:
+    /**
+     * @brief Construct a new ObjectPool object
+     *
+     * @param blocksPerChunk - blocks of each chunk
+     */
+    explicit ObjectPool(size_t blocksPerChunk = 256) : _blocksPerChunk(blocksPerChunk) {}
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    /**
+     * @brief Allocate \p size bytes
+     */
+    void* allocate(size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_blockSize)
+                _blockSize = roundUp(std::max(size, sizeof(Block)));
+            if (roundUp(std::max(size, sizeof(Block))) == _blockSize) {
+                if (!_free)
+                    grow();
+                Block* block = _free;
+                _free = block->next;
+                ++_used;
+                return block;
+            }
+        }
+        return ::operator new(size);
+    }
+
+    /**
+     * @brief Free memory returned by allocate() for the same \p size
+     */
+    void deallocate(void* ptr, size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (roundUp(std::max(size, sizeof(Block))) == _blockSize) {
+                auto* block = static_cast<Block*>(ptr);
+                block->next = _free;
+                _free = block;
+                --_used;
+                return;
+            }
+        }
+        ::operator delete(ptr);
+    }
+
+    /**
+     * @brief Blocks in use
+     */
+    size_t used() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _used;
+    }
+
+    /**
+     * @brief Bytes of the chunks
+     */
+    size_t capacity() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _chunks.size() * _blocksPerChunk * _blockSize;
+    }
+
+  private:
+    struct Block {
+        Block* next;
+    };
+
+    static size_t roundUp(size_t size)
+    {
+        constexpr size_t align = alignof(std::max_align_t);
+        return (size + align - 1) / align * align;
+    }
+
+    /// new chunk threaded onto the free list, in address order
+    void grow()
+    {
+        _chunks.emplace_back(new unsigned char[_blocksPerChunk * _blockSize]);
+        unsigned char* chunk = _chunks.back().get();
+        for (size_t i = _blocksPerChunk; i-- > 0;) {
+            auto* block = reinterpret_cast<Block*>(chunk + i * _blockSize);
+            block->next = _free;
+            _free = block;
+        }
+    }
+
+    mutable std::mutex _mutex;
+    size_t _blocksPerChunk;
+    size_t _blockSize = 0; //<- 0 until the first allocation
+    size_t _used = 0;
+    Block* _free = nullptr;
+    std::vector<std::unique_ptr<unsigned char[]>> _chunks;
+};
+
+/**
+ * @brief Allocator of std::allocate_shared drawing from an ObjectPool
+ *
+ * The control block of each object keeps a copy of the allocator, hence the pool, alive: objects
+ * may outlive the owner of the pool, e.g. in renderer snapshots.
+ */
+template <class T>
+class PoolAllocator
+{
+  public:
+    using value_type = T;
+
+    explicit PoolAllocator(std::shared_ptr<ObjectPool> pool) noexcept : _pool(std::move(pool)) {}
+
+    template <class U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept : _pool(other.pool())
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(n == 1 ? _pool->allocate(sizeof(T))
+                                      : ::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n)
+    {
+        if (n == 1)
+            _pool->deallocate(ptr, sizeof(T));
+        else
+            ::operator delete(ptr);
+    }
+
+    const std::shared_ptr<ObjectPool>& pool() const { return _pool; }
+
+    template <class U>
+    bool operator==(const PoolAllocator<U>& other) const
+    {
+        return _pool == other.pool();
+    }
+    template <class U>
+    bool operator!=(const PoolAllocator<U>& other) const
+    {
+        return _pool != other.pool();
+    }
+
+  private:
+    std::shared_ptr<ObjectPool> _pool;
+};
+
+} // namespace scene
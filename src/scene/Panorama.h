@@ -0,0 +1,158 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Camera.h"
+
+#include <utils/math.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace scene {
+
+/**
+ * @brief Projection of a view, perspective or panoramic all around the camera position
+ *
+ * Perspective images are those of the camera projection matrix. Cubemap images stack six square
+ * faces top to bottom, in the order of the CubemapFace values, each a 90 degrees perspective
+ * image of the face direction; their depth is the metric depth
+ * along the face direction. Equirectangular images map longitude from -pi on the left column to
+ * pi on the right one, the camera direction in the middle, and latitude from pi / 2 on the top
+ * row to -pi / 2 on the bottom one; their depth is the distance to the camera position.
+ */
+enum class Projection
+{
+    Perspective, //<- projection matrix of the camera
+    Cubemap, //<- six faces of cols x cols pixels, rows = 6 x cols
+    Equirectangular, //<- longitude along the columns, latitude along the rows
+};
+
+/**
+ * @brief Faces of a cubemap, in camera frame directions
+ */
+enum class CubemapFace
+{
+    Front, //<- along the camera direction
+    Right,
+    Back,
+    Left,
+    Up, //<- the top of the image towards the back
+    Down, //<- the top of the image towards the front
+};
+
+/**
+ * @brief Direction and up vector of each cubemap face, in the camera frame looking along -z
+ */
+struct CubemapFaceAxes {
+    Vector3f forward;
+    Vector3f up;
+};
+
+/**
+ * @brief Axes of the six cubemap faces, in CubemapFace order
+ */
+inline const std::array<CubemapFaceAxes, 6>& cubemapFaceAxes()
+{
+    static const std::array<CubemapFaceAxes, 6> axes = {{
+        {{0.f, 0.f, -1.f}, {0.f, 1.f, 0.f}},
+        {{1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}},
+        {{0.f, 0.f, 1.f}, {0.f, 1.f, 0.f}},
+        {{-1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}},
+        {{0.f, 1.f, 0.f}, {0.f, 0.f, 1.f}},
+        {{0.f, -1.f, 0.f}, {0.f, 0.f, -1.f}},
+    }};
+    return axes;
+}
+
+/**
+ * @brief Side in pixels of the faces rendered for a panoramic image, 0 if it cannot be rendered
+ *
+ * Cubemap images are 6 faces high, equirectangular ones span 4 faces along their width.
+ */
+inline int panoramaFaceSize(Projection projection, int cols, int rows)
+{
+    if (cols <= 0 || rows <= 0)
+        return 0;
+    if (projection == Projection::Cubemap)
+        return rows == cols * 6 ? cols : 0;
+    if (projection == Projection::Equirectangular)
+        return std::max((cols + 3) / 4, 1);
+    return 0;
+}
+
+/**
+ * @brief Camera of a cubemap face, at the pose of \p camera
+ *
+ * Faces keep the clipping distances of a perspective camera, 0.01 to 100 otherwise.
+ */
+inline Camera cubemapFaceCamera(const Camera& camera, CubemapFace face)
+{
+    const auto& axes = cubemapFaceAxes()[int(face)];
+    const auto& f = axes.forward;
+    const auto& u = axes.up;
+    const Vector3f r{f[1] * u[2] - f[2] * u[1], f[2] * u[0] - f[0] * u[2],
+                     f[0] * u[1] - f[1] * u[0]};
+    // rows right, up and backward, column-major
+    const Matrix4f rotation{r[0], u[0], -f[0], 0.f, r[1], u[1], -f[1], 0.f,
+                            r[2], u[2], -f[2], 0.f, 0.f,  0.f,  0.f,   1.f};
+
+    const float n = camera.hasIntrinsics() ? camera.znear() : 0.01f;
+    const float z = camera.hasIntrinsics() ? camera.zfar() : 100.f;
+    const Matrix4f proj{1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, (z + n) / (n - z), -1.f,
+                        0.f, 0.f, 2.f * z * n / (n - z), 0.f};
+    Camera result(multiply(rotation, camera.viewMatrix()), proj);
+    result.setHandle(camera.handle());
+    return result;
+}
+
+/**
+ * @brief Camera frame direction of the center of a pixel of an equirectangular image
+ */
+inline Vector3f equirectangularDirection(int col, int row, int cols, int rows)
+{
+    const float lon = ((col + 0.5f) / cols * 2.f - 1.f) * float(M_PI);
+    const float lat = (0.5f - (row + 0.5f) / rows) * float(M_PI);
+    return {std::cos(lat) * std::sin(lon), std::sin(lat), -std::cos(lat) * std::cos(lon)};
+}
+
+/**
+ * @brief Pixel of the cubemap faces seen along a camera frame direction
+ */
+struct CubemapTexel {
+    int face;
+    int col;
+    int row; //<- top row first
+    float cosine; //<- of the angle between the direction and the face axis
+};
+
+/**
+ * @brief Face pixel seen along the unit direction \p d, in faces of \p size pixels a side
+ */
+inline CubemapTexel cubemapTexel(const Vector3f& d, int size)
+{
+    const auto& axes = cubemapFaceAxes();
+    CubemapTexel texel{0, 0, 0, -2.f};
+    for (int i = 0; i < 6; ++i) {
+        const auto& f = axes[i].forward;
+        const float c = f[0] * d[0] + f[1] * d[1] + f[2] * d[2];
+        if (c > texel.cosine) {
+            texel.cosine = c;
+            texel.face = i;
+        }
+    }
+    const auto& f = axes[texel.face].forward;
+    const auto& u = axes[texel.face].up;
+    const Vector3f r{f[1] * u[2] - f[2] * u[1], f[2] * u[0] - f[0] * u[2],
+                     f[0] * u[1] - f[1] * u[0]};
+    const float x = (r[0] * d[0] + r[1] * d[1] + r[2] * d[2]) / texel.cosine;
+    const float y = (u[0] * d[0] + u[1] * d[1] + u[2] * d[2]) / texel.cosine;
+    texel.col = std::min(std::max(int((x * 0.5f + 0.5f) * size), 0), size - 1);
+    texel.row = std::min(std::max(int((0.5f - y * 0.5f) * size), 0), size - 1);
+    return texel;
+}
+
+} // namespace scene
@@ -0,0 +1,175 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "Primitives.h"
+#include "MeshBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace scene {
+
+namespace {
+
+constexpr float kPi = 3.14159265358979f;
+constexpr int kSegments = 32; //<- tessellation around the z axis, per level
+constexpr int kRings = 16; //<- tessellation of a sphere from pole to pole, per level
+
+std::shared_ptr<MeshData> makeBox(const Vector3f& extents)
+{
+    MeshBuilder mesh;
+    const float h[3] = {extents[0] / 2, extents[1] / 2, extents[2] / 2};
+    for (int axis = 0; axis < 3; ++axis) {
+        for (float sign : {-1.f, 1.f}) {
+            const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+            Vector3f n{0.f, 0.f, 0.f};
+            n[axis] = sign;
+            int corners[4];
+            for (int i = 0; i < 4; ++i) {
+                const float su = (i == 1 || i == 2) ? 1.f : -1.f;
+                const float sv = (i >= 2) ? 1.f : -1.f;
+                Vector3f p;
+                p[axis] = sign * h[axis];
+                p[u] = su * sign * h[u];
+                p[v] = sv * h[v];
+                corners[i] = mesh.vertex(p, n, (su + 1) / 2, (sv + 1) / 2);
+            }
+            mesh.quad(corners[0], corners[1], corners[2], corners[3]);
+        }
+    }
+    return mesh.build();
+}
+
+std::shared_ptr<MeshData> makePlane()
+{
+    // same size as the plane drawn by the python renderers
+    MeshBuilder mesh;
+    const Vector3f n{0.f, 0.f, 1.f};
+    const int a = mesh.vertex({-5.f, -5.f, 0.f}, n, 0.f, 0.f);
+    const int b = mesh.vertex({5.f, -5.f, 0.f}, n, 1.f, 0.f);
+    const int c = mesh.vertex({5.f, 5.f, 0.f}, n, 1.f, 1.f);
+    const int d = mesh.vertex({-5.f, 5.f, 0.f}, n, 0.f, 1.f);
+    mesh.quad(a, b, c, d);
+    return mesh.build();
+}
+
+/**
+ * @brief Sphere, or capsule if \p height is positive, centered and aligned along z
+ */
+std::shared_ptr<MeshData> makeCapsule(float radius, float height, int segments, int rings)
+{
+    MeshBuilder mesh;
+    const int rows = rings + 1 + (height > 0.f ? 1 : 0);
+    for (int i = 0; i <= rings + (height > 0.f ? 1 : 0); ++i) {
+        // an extra ring duplicates the equator to stretch the cylinder part
+        const int ring = height > 0.f && i > rings / 2 ? i - 1 : i;
+        const float theta = kPi * ring / rings;
+        const float offset = height > 0.f ? (i <= rings / 2 ? height / 2 : -height / 2) : 0.f;
+        for (int j = 0; j <= segments; ++j) {
+            const float phi = 2 * kPi * j / segments;
+            const Vector3f n{std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi),
+                             std::cos(theta)};
+            mesh.vertex({n[0] * radius, n[1] * radius, n[2] * radius + offset}, n,
+                        float(j) / segments, 1.f - float(i) / (rows - 1));
+        }
+    }
+    for (int i = 0; i < rows - 1; ++i) {
+        for (int j = 0; j < segments; ++j) {
+            const int a = i * (segments + 1) + j, b = a + segments + 1;
+            mesh.quad(a, b, b + 1, a + 1);
+        }
+    }
+    return mesh.build();
+}
+
+std::shared_ptr<MeshData> makeCylinder(float radius, float height, int segments)
+{
+    MeshBuilder mesh;
+    for (int j = 0; j <= segments; ++j) {
+        const float phi = 2 * kPi * j / segments;
+        const Vector3f n{std::cos(phi), std::sin(phi), 0.f};
+        const float u = float(j) / segments;
+        mesh.vertex({n[0] * radius, n[1] * radius, -height / 2}, n, u, 0.f);
+        mesh.vertex({n[0] * radius, n[1] * radius, height / 2}, n, u, 1.f);
+    }
+    for (int j = 0; j < segments; ++j)
+        mesh.quad(j * 2, j * 2 + 2, j * 2 + 3, j * 2 + 1);
+
+    for (float sign : {-1.f, 1.f}) {
+        const Vector3f n{0.f, 0.f, sign};
+        const int center = mesh.vertex({0.f, 0.f, sign * height / 2}, n, 0.5f, 0.5f);
+        for (int j = 0; j <= segments; ++j) {
+            const float phi = 2 * kPi * j / segments;
+            const float x = std::cos(phi), y = std::sin(phi);
+            mesh.vertex({x * radius, y * radius, sign * height / 2}, n, (x + 1) / 2, (y + 1) / 2);
+        }
+        for (int j = 0; j < segments; ++j) {
+            if (sign > 0)
+                mesh.triangle(center, center + 1 + j, center + 2 + j);
+            else
+                mesh.triangle(center, center + 2 + j, center + 1 + j);
+        }
+    }
+    return mesh.build();
+}
+
+using PrimitiveKey = std::tuple<ShapeType, Vector3f, int>; //<- type, dimensions, tessellation
+
+std::mutex gMutex;
+std::map<PrimitiveKey, std::shared_ptr<MeshData>> gPrimitives;
+
+} // namespace
+
+std::shared_ptr<MeshData> primitiveMesh(const Shape& shape, int tessellation)
+{
+    switch (shape.type()) {
+    case ShapeType::Cube:
+    case ShapeType::Plane:
+    case ShapeType::Sphere:
+    case ShapeType::Cylinder:
+    case ShapeType::Capsule:
+        break;
+    case ShapeType::Heightfield:
+        return shape.heightfield() && !shape.mesh() ? shape.heightfield()->meshData() : nullptr;
+    default:
+        return nullptr;
+    }
+    if (shape.mesh())
+        return nullptr;
+
+    // boxes and planes are exact at any level
+    const bool flat = shape.type() == ShapeType::Cube || shape.type() == ShapeType::Plane;
+    const int level = flat ? 1 : std::max(tessellation, 1);
+    const int segments = kSegments * level, rings = kRings * level;
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    auto& data = gPrimitives[std::make_tuple(shape.type(), shape.extents(), level)];
+    if (!data) {
+        switch (shape.type()) {
+        case ShapeType::Cube:
+            data = makeBox(shape.extents());
+            break;
+        case ShapeType::Plane:
+            data = makePlane();
+            break;
+        case ShapeType::Sphere:
+            data = makeCapsule(shape.radius(), 0.f, segments, rings);
+            break;
+        case ShapeType::Capsule:
+            data = makeCapsule(shape.radius(), shape.height(), segments, rings);
+            break;
+        case ShapeType::Cylinder:
+            data = makeCylinder(shape.radius(), shape.height(), segments);
+            break;
+        default:
+            break;
+        }
+    }
+    return data;
+}
+
+} // namespace scene
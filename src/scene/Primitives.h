@@ -0,0 +1,30 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Mesh.h"
+#include "Shape.h"
+
+#include <memory>
+
+namespace scene {
+
+/**
+ * @brief Triangle mesh of a primitive shape
+ *
+ * Cubes, planes, spheres, cylinders and capsules are tessellated once per process for each set
+ * of dimensions and tessellation level, centered and aligned along z. The returned data is
+ * shared by all callers and must not be modified. Planes are a single 10 x 10 quad facing +z.
+ * Heightfields without a mesh are triangulated at each call instead, see
+ * Heightfield::meshData().
+ *
+ * @param shape - shape description
+ * @param tessellation - tessellation level, 1 for 32 segments around z and 16 rings from pole
+ * to pole, each level adding as many
+ * @return std::shared_ptr<MeshData> - mesh data, null if the shape is not a primitive
+ */
+std::shared_ptr<MeshData> primitiveMesh(const Shape& shape, int tessellation = 1);
+
+} // namespace scene
@@ -0,0 +1,187 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <utils/math.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Octahedral encoding of a unit vector, two signed normalized 16 bits values
+ */
+inline std::array<int16_t, 2> octEncode(const float* n)
+{
+    const float length = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+    if (!(length > 0.f))
+        return {0, 0};
+    float u = n[0] / length, v = n[1] / length;
+    if (n[2] < 0.f) {
+        // lower hemisphere folded over the diagonals
+        const float fu = (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f);
+        const float fv = (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+        u = fu;
+        v = fv;
+    }
+    return {int16_t(std::lround(std::min(std::max(u, -1.f), 1.f) * 32767.f)),
+            int16_t(std::lround(std::min(std::max(v, -1.f), 1.f) * 32767.f))};
+}
+
+/**
+ * @brief Unit vector of an octahedral encoding, see octEncode()
+ */
+inline Vector3f octDecode(const int16_t* e)
+{
+    float u = std::max(float(e[0]) / 32767.f, -1.f), v = std::max(float(e[1]) / 32767.f, -1.f);
+    const float w = 1.f - std::abs(u) - std::abs(v);
+    if (w < 0.f) {
+        const float fu = (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f);
+        const float fv = (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+        u = fu;
+        v = fv;
+    }
+    const float length = std::sqrt(u * u + v * v + w * w);
+    return {u / length, v / length, w / length};
+}
+
+/**
+ * @brief Mesh vertex attributes quantized to 16 bits
+ *
+ * Positions are unsigned normalized values across the bounds of the vertices, normals are
+ * octahedral encoded, uvs are unsigned normalized values across their range. 14 bytes per
+ * vertex instead of 32, with uniform errors of 1/65535 of the extents. GPUs read them as
+ * normalized attributes, the offsets and scales apply them back.
+ */
+struct QuantizedMesh {
+    Vector3f positionOffset{0.f, 0.f, 0.f}; //<- lower corner of the bounds
+    Vector3f positionScale{0.f, 0.f, 0.f};  //<- extents of the bounds
+    std::array<float, 2> uvOffset{0.f, 0.f};
+    std::array<float, 2> uvScale{0.f, 0.f};
+    std::vector<uint16_t> positions; //<- 3 per vertex
+    std::vector<int16_t> normals;    //<- 2 per vertex, empty without normals
+    std::vector<uint16_t> uvs;       //<- 2 per vertex, empty without uvs
+
+    /**
+     * @brief Quantize planar attributes
+     *
+     * @param vertices - vertex coordinates
+     * @param normals - vertex normals, one per vertex or none
+     * @param uvs - texture coordinates, one per vertex or none
+     * @return std::shared_ptr<QuantizedMesh> - null if the attribute counts do not match or
+     * coordinates are not finite
+     */
+    static std::shared_ptr<QuantizedMesh> make(const std::vector<float>& vertices,
+                                               const std::vector<float>& normals,
+                                               const std::vector<float>& uvs)
+    {
+        const size_t count = vertices.size() / 3;
+        if (vertices.size() % 3 || (!normals.empty() && normals.size() != vertices.size()) ||
+            (!uvs.empty() && uvs.size() != count * 2))
+            return nullptr;
+
+        auto mesh = std::make_shared<QuantizedMesh>();
+        if (!range(vertices, 3, mesh->positionOffset.data(), mesh->positionScale.data()) ||
+            !range(uvs, 2, mesh->uvOffset.data(), mesh->uvScale.data()))
+            return nullptr;
+        quantize(vertices, 3, mesh->positionOffset.data(), mesh->positionScale.data(),
+                 mesh->positions);
+        quantize(uvs, 2, mesh->uvOffset.data(), mesh->uvScale.data(), mesh->uvs);
+        mesh->normals.resize(count * 2 * !normals.empty());
+        for (size_t i = 0; i < mesh->normals.size() / 2; ++i) {
+            const auto e = octEncode(&normals[i * 3]);
+            mesh->normals[i * 2] = e[0];
+            mesh->normals[i * 2 + 1] = e[1];
+        }
+        return mesh;
+    }
+
+    /**
+     * @brief Number of vertices
+     */
+    size_t numVertices() const { return positions.size() / 3; }
+
+    /**
+     * @brief Decode the attributes back to floats
+     */
+    void decode(std::vector<float>& vertices, std::vector<float>& normals,
+                std::vector<float>& uvs) const
+    {
+        dequantize(positions, 3, positionOffset.data(), positionScale.data(), vertices);
+        dequantize(this->uvs, 2, uvOffset.data(), uvScale.data(), uvs);
+        normals.resize(this->normals.size() / 2 * 3);
+        for (size_t i = 0; i < normals.size() / 3; ++i) {
+            const auto n = octDecode(&this->normals[i * 2]);
+            std::copy(n.begin(), n.end(), &normals[i * 3]);
+        }
+    }
+
+    /**
+     * @brief Comparison operators
+     */
+    bool operator==(const QuantizedMesh& other) const
+    {
+        return positionOffset == other.positionOffset && positionScale == other.positionScale &&
+               uvOffset == other.uvOffset && uvScale == other.uvScale &&
+               positions == other.positions && normals == other.normals && uvs == other.uvs;
+    }
+    bool operator!=(const QuantizedMesh& other) const { return !(*this == other); }
+
+    /**
+     * @brief Serialization
+     */
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(positionOffset, positionScale, uvOffset, uvScale, positions, normals, uvs);
+    }
+
+  private:
+    /// lower corner and extents of interleaved values, false if not finite
+    static bool range(const std::vector<float>& values, int components, float* offset,
+                      float* scale)
+    {
+        for (int k = 0; k < components; ++k) {
+            float lower = values.empty() ? 0.f : values[k], upper = lower;
+            for (size_t i = k; i < values.size(); i += components) {
+                lower = std::min(lower, values[i]);
+                upper = std::max(upper, values[i]);
+            }
+            offset[k] = lower;
+            scale[k] = upper - lower;
+            if (!std::isfinite(scale[k]))
+                return false;
+        }
+        return true;
+    }
+
+    static void quantize(const std::vector<float>& values, int components, const float* offset,
+                         const float* scale, std::vector<uint16_t>& quantized)
+    {
+        quantized.resize(values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            const int k = int(i % components);
+            const float t = scale[k] > 0.f ? (values[i] - offset[k]) / scale[k] : 0.f;
+            quantized[i] = uint16_t(std::lround(std::min(std::max(t, 0.f), 1.f) * 65535.f));
+        }
+    }
+
+    static void dequantize(const std::vector<uint16_t>& quantized, int components,
+                           const float* offset, const float* scale, std::vector<float>& values)
+    {
+        values.resize(quantized.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            const int k = int(i % components);
+            values[i] = offset[k] + float(quantized[i]) / 65535.f * scale[k];
+        }
+    }
+};
+
+} // namespace scene
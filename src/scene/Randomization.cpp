@@ -0,0 +1,142 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "Randomization.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+namespace scene {
+
+namespace {
+
+uint64_t mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/// splitmix64 stream, the same values on every platform unlike standard distributions
+class Stream
+{
+  public:
+    Stream(uint64_t seed, uint64_t index, int body, int link, int shape)
+        : _state(mix(mix(mix(mix(seed) ^ index) ^ uint32_t(body)) ^ uint32_t(link)) ^
+                 uint32_t(shape))
+    {
+    }
+
+    /// uniform value in [lower, upper]
+    float uniform(float lower, float upper)
+    {
+        _state += 0x9e3779b97f4a7c15ull;
+        const float t = float(mix(_state) >> 40) / float(1 << 24);
+        return lower + (upper - lower) * t;
+    }
+
+  private:
+    uint64_t _state;
+};
+
+} // namespace
+
+Light Randomization::sampleLight(uint64_t index, const Light& base) const
+{
+    Stream stream(seed, index, -1, -1, -1);
+    Light light(base);
+    Vector3f direction;
+    Color3f color;
+    for (int k = 0; k < 3; ++k)
+        direction[k] = stream.uniform(lightDirectionLower[k], lightDirectionUpper[k]);
+    for (int k = 0; k < 3; ++k)
+        color[k] = stream.uniform(lightColorLower[k], lightColorUpper[k]);
+    light.setDirection(direction);
+    light.setColor(color);
+    light.setAmbientCoeff(stream.uniform(ambientRange[0], ambientRange[1]));
+    light.setDiffuseCoeff(stream.uniform(diffuseRange[0], diffuseRange[1]));
+    light.setSpecularCoeff(stream.uniform(specularRange[0], specularRange[1]));
+    return light;
+}
+
+std::shared_ptr<MaterialOverrides>
+Randomization::sampleMaterials(uint64_t index, const SceneGraph& sceneGraph,
+                               const std::vector<std::shared_ptr<Texture>>& atlas) const
+{
+    auto materials = std::make_shared<MaterialOverrides>();
+    const std::set<int> selected(bodies.begin(), bodies.end());
+    for (const auto& it : sceneGraph.nodes()) {
+        const auto& node = it.second;
+        if (!selected.empty() && !selected.count(node.body()))
+            continue;
+        const auto& shapes = node.shapes();
+        for (int shapeIndex = 0; shapeIndex < int(shapes.size()); ++shapeIndex) {
+            const auto& original = shapes[shapeIndex].material();
+            auto material = original ? std::make_shared<Material>(*original)
+                                     : std::make_shared<Material>(Color4f{1.f, 1.f, 1.f, 1.f},
+                                                                  Color3f{0.f, 0.f, 0.f});
+            // every value is drawn, used or not, so that ranges do not shift the others
+            Stream stream(seed, index, node.body(), node.link(), shapeIndex);
+            Color4f color;
+            for (int k = 0; k < 4; ++k)
+                color[k] = stream.uniform(colorLower[k], colorUpper[k]);
+            const float choice = stream.uniform(0.f, 1.f);
+            const float pick = stream.uniform(0.f, float(atlas.size()));
+            if (colors)
+                material->setDiffuseColor(color);
+            if (!atlas.empty() && choice < textureProbability) {
+                const auto& texture = atlas[std::min(size_t(pick), atlas.size() - 1)];
+                if (texture)
+                    material->setDiffuseTexture(texture);
+            }
+            materials->emplace(std::make_pair(it.first, shapeIndex), std::move(material));
+        }
+    }
+    return materials;
+}
+
+std::string Randomization::record(uint64_t index, const Light* light,
+                                  const MaterialOverrides& materials, const SceneGraph& sceneGraph,
+                                  const std::vector<std::shared_ptr<Texture>>& atlas) const
+{
+    std::ostringstream out;
+    out << std::setprecision(9);
+    const auto array = [&out](const float* values, int count) {
+        out << '[';
+        for (int k = 0; k < count; ++k)
+            out << (k ? ", " : "") << values[k];
+        out << ']';
+    };
+    out << "{\"seed\": " << seed << ", \"index\": " << index;
+    if (light) {
+        out << ", \"light\": {\"direction\": ";
+        array(light->direction().data(), 3);
+        out << ", \"color\": ";
+        array(light->color().data(), 3);
+        out << ", \"ambient\": " << light->ambientCoeff()
+            << ", \"diffuse\": " << light->diffuseCoeff()
+            << ", \"specular\": " << light->specularCoeff() << '}';
+    }
+    out << ", \"shapes\": [";
+    bool first = true;
+    for (const auto& it : materials) {
+        const auto& node = sceneGraph.nodes().at(it.first.first);
+        const auto& material = *it.second;
+        const auto texture = material.diffuseTexture()
+                                 ? std::find(atlas.begin(), atlas.end(), material.diffuseTexture())
+                                 : atlas.end();
+        out << (first ? "" : ", ") << '[' << node.body() << ", " << node.link() << ", "
+            << it.first.second;
+        for (float value : material.diffuseColor())
+            out << ", " << value;
+        out << ", " << (texture != atlas.end() ? textures[texture - atlas.begin()] : -1) << ']';
+        first = false;
+    }
+    out << "]}";
+    return out.str();
+}
+
+} // namespace scene
@@ -0,0 +1,95 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Light.h"
+#include "SceneGraph.h"
+#include "SceneView.h"
+
+#include <utils/math.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Distributions of the materials and light drawn in a view, see SceneView
+ *
+ * Values are uniform within their ranges. Each shape and the light draw them from their own
+ * random stream, seeded by the seed, the sample index and the body, link and shape indices of
+ * the shape: a sample is reproduced from these only, whatever the other shapes of the scene.
+ */
+struct Randomization {
+    /**
+     * @brief When a new sample is drawn
+     */
+    enum class Mode
+    {
+        PerEpisode, //<- once per episode, the sample index is the episode
+        PerFrame,   //<- for each rendered frame, the sample index is the frame
+    };
+
+    uint64_t seed = 0;
+    Mode mode = Mode::PerEpisode;
+    std::vector<int> bodies; //<- randomized bodies, all of them if empty
+
+    bool colors = true; //<- draw the diffuse colors, keep those of the materials otherwise
+    Color4f colorLower{0.f, 0.f, 0.f, 1.f};
+    Color4f colorUpper{1.f, 1.f, 1.f, 1.f};
+
+    std::vector<int> textures;       //<- atlas of texture ids, textures are kept if empty
+    float textureProbability = 0.5f; //<- chance of a shape to draw a texture from the atlas
+
+    bool light = false; //<- draw the light parameters, keep those of the view otherwise
+    Vector3f lightDirectionLower{-1.f, -1.f, -2.f};
+    Vector3f lightDirectionUpper{1.f, 1.f, -1.f};
+    Color3f lightColorLower{0.8f, 0.8f, 0.8f};
+    Color3f lightColorUpper{1.f, 1.f, 1.f};
+    std::array<float, 2> ambientRange{0.5f, 0.8f};
+    std::array<float, 2> diffuseRange{0.2f, 0.5f};
+    std::array<float, 2> specularRange{0.f, 0.2f};
+
+    /**
+     * @brief Light of a sample
+     *
+     * @param index - sample index
+     * @param base - light whose type, target, distance and shadows are kept
+     */
+    Light sampleLight(uint64_t index, const Light& base) const;
+
+    /**
+     * @brief Materials of the randomized shapes of a sample
+     *
+     * @param index - sample index
+     * @param sceneGraph - scene whose materials are randomized, not modified
+     * @param atlas - textures of the texture ids, null for unknown ones
+     * @return std::shared_ptr<MaterialOverrides> - materials by node id and shape index
+     */
+    std::shared_ptr<MaterialOverrides>
+    sampleMaterials(uint64_t index, const SceneGraph& sceneGraph,
+                    const std::vector<std::shared_ptr<Texture>>& atlas) const;
+
+    /**
+     * @brief Sampled values as a line of json, for logs
+     *
+     * Shapes are listed as [body, link, shape, r, g, b, a, texture id], the texture id -1 for
+     * textures out of the atlas.
+     *
+     * @param index - sample index
+     * @param light - sampled light, null if not randomized
+     * @param materials - sampled materials
+     * @param sceneGraph - scene of the materials
+     * @param atlas - textures of the texture ids
+     */
+    std::string record(uint64_t index, const Light* light, const MaterialOverrides& materials,
+                       const SceneGraph& sceneGraph,
+                       const std::vector<std::shared_ptr<Texture>>& atlas) const;
+};
+
+} // namespace scene
@@ -0,0 +1,489 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#include "RaySensor.h"
+#include "Primitives.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+namespace scene {
+
+namespace {
+
+#ifdef PYBULLET_RENDERING_MATH_SIMD
+constexpr int kLanes = int(MathLanes::kWidth); //<- rays per packet, one per SIMD lane
+#else
+constexpr int kLanes = 4; //<- rays per packet
+#endif
+constexpr int kLeafSize = 4; //<- triangles per leaf at most
+constexpr int kStackSize = 64;
+
+Vector3f transformVector(const Matrix4f& m, const Vector3f& v)
+{
+    return {m[0] * v[0] + m[4] * v[1] + m[8] * v[2], m[1] * v[0] + m[5] * v[1] + m[9] * v[2],
+            m[2] * v[0] + m[6] * v[1] + m[10] * v[2]};
+}
+
+std::shared_ptr<MeshData> defaultMeshData(const Shape& shape)
+{
+    const auto& mesh = shape.mesh();
+    if (mesh)
+        return mesh->data();
+    return primitiveMesh(shape);
+}
+
+/// rays of a packet in the frame of a shape, sharing their origin
+struct Packet {
+    Vector3f origin;
+    alignas(32) float dir[3][kLanes]; //<- lanes of each axis
+    alignas(32) float inv[3][kLanes];
+    alignas(32) float tmax[kLanes]; //<- closest hit so far, negative for inactive lanes
+    float tmin;
+    int hit; //<- bit of each lane hit by the current instance
+};
+
+} // namespace
+
+/**
+ * @brief Triangles of a mesh in a depth-first tree of boxes, the left child of an inner node
+ * following it
+ */
+struct RaySensor::Blas {
+    struct Triangle {
+        Vector3f v0;
+        Vector3f e1; //<- v1 - v0
+        Vector3f e2; //<- v2 - v0
+    };
+
+    struct Node {
+        Vector3f lower;
+        Vector3f upper;
+        int first; //<- first triangle of a leaf, right child of an inner node
+        int count; //<- triangles of a leaf, 0 for inner nodes
+        int axis; //<- split axis of an inner node
+    };
+
+    std::shared_ptr<MeshData> data; //<- kept alive for the cache key
+    std::vector<Triangle> triangles;
+    std::vector<Node> nodes;
+    AABB bounds;
+
+    explicit Blas(const std::shared_ptr<MeshData>& meshData) : data(meshData)
+    {
+        const auto& vertices = data->vertices();
+        const auto& indices = data->indices();
+        const int count = int(indices.size() / 3);
+        const int numVertices = int(vertices.size() / 3);
+        std::vector<Triangle> source;
+        source.reserve(count);
+        for (int t = 0; t < count; ++t) {
+            const int* index = &indices[size_t(t) * 3];
+            if (index[0] >= numVertices || index[1] >= numVertices || index[2] >= numVertices)
+                continue;
+            const float* a = &vertices[size_t(index[0]) * 3];
+            const float* b = &vertices[size_t(index[1]) * 3];
+            const float* c = &vertices[size_t(index[2]) * 3];
+            source.push_back({{a[0], a[1], a[2]},
+                              {b[0] - a[0], b[1] - a[1], b[2] - a[2]},
+                              {c[0] - a[0], c[1] - a[1], c[2] - a[2]}});
+        }
+
+        std::vector<int> order(source.size());
+        std::vector<Vector3f> centroids(source.size());
+        for (int t = 0; t < int(source.size()); ++t) {
+            order[t] = t;
+            for (int k = 0; k < 3; ++k)
+                centroids[t][k] = source[t].v0[k] + (source[t].e1[k] + source[t].e2[k]) / 3.f;
+        }
+        bounds = AABB::Empty();
+        if (!order.empty())
+            build(order.begin(), order.end(), order.begin(), source, centroids);
+        triangles.reserve(source.size());
+        for (const auto& node : nodes) {
+            if (node.count)
+                bounds.extend(AABB{node.lower, node.upper});
+        }
+        for (int t : order)
+            triangles.push_back(source[t]);
+    }
+
+    /// top-down build, splitting centroids at the median of the longest axis
+    void build(std::vector<int>::iterator begin, std::vector<int>::iterator end,
+               std::vector<int>::iterator order, const std::vector<Triangle>& source,
+               const std::vector<Vector3f>& centroids)
+    {
+        const int index = int(nodes.size());
+        nodes.push_back(Node{});
+        AABB box = AABB::Empty(), centers = AABB::Empty();
+        for (auto it = begin; it != end; ++it) {
+            const auto& t = source[*it];
+            box.extend(t.v0);
+            box.extend(Vector3f{t.v0[0] + t.e1[0], t.v0[1] + t.e1[1], t.v0[2] + t.e1[2]});
+            box.extend(Vector3f{t.v0[0] + t.e2[0], t.v0[1] + t.e2[1], t.v0[2] + t.e2[2]});
+            centers.extend(centroids[*it]);
+        }
+        nodes[index].lower = box.lower;
+        nodes[index].upper = box.upper;
+
+        const int count = int(end - begin);
+        if (count <= kLeafSize) {
+            nodes[index].first = int(begin - order);
+            nodes[index].count = count;
+            return;
+        }
+
+        int axis = 0;
+        for (int k = 1; k < 3; ++k)
+            if (centers.upper[k] - centers.lower[k] > centers.upper[axis] - centers.lower[axis])
+                axis = k;
+        const auto middle = begin + count / 2;
+        std::nth_element(begin, middle, end,
+                         [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+        nodes[index].axis = axis;
+        nodes[index].count = 0;
+        build(begin, middle, order, source, centroids);
+        nodes[index].first = int(nodes.size());
+        build(middle, end, order, source, centroids);
+    }
+
+    /// closest hits of the active lanes of a packet, flagging the lanes hit
+    void intersect(Packet& packet) const
+    {
+        int stack[kStackSize];
+        int size = 0;
+        int index = 0;
+        const auto& o = packet.origin;
+        while (true) {
+            const Node& node = nodes[index];
+#ifdef PYBULLET_RENDERING_MATH_SIMD
+            // selects rather than min and max, NaN of rays parallel to a slab as in the scalar
+            // comparisons
+            using L = MathLanes;
+            L::Type tmin = L::splat(packet.tmin), tmax = L::load(packet.tmax);
+            for (int k = 0; k < 3; ++k) {
+                const L::Type inv = L::load(packet.inv[k]);
+                const L::Type t0 = L::mul(L::splat(node.lower[k] - o[k]), inv);
+                const L::Type t1 = L::mul(L::splat(node.upper[k] - o[k]), inv);
+                const L::Type swap = L::less(t1, t0);
+                const L::Type near = L::select(swap, t1, t0), far = L::select(swap, t0, t1);
+                tmin = L::select(L::less(tmin, near), near, tmin);
+                tmax = L::select(L::less(far, tmax), far, tmax);
+            }
+            const bool any = L::moveMask(L::lessEqual(tmin, tmax)) != 0;
+#else
+            bool any = false;
+            for (int lane = 0; lane < kLanes; ++lane) {
+                float tmin = packet.tmin, tmax = packet.tmax[lane];
+                for (int k = 0; k < 3; ++k) {
+                    float t0 = (node.lower[k] - o[k]) * packet.inv[k][lane];
+                    float t1 = (node.upper[k] - o[k]) * packet.inv[k][lane];
+                    if (t0 > t1)
+                        std::swap(t0, t1);
+                    tmin = t0 > tmin ? t0 : tmin;
+                    tmax = t1 < tmax ? t1 : tmax;
+                }
+                any |= tmin <= tmax;
+            }
+#endif
+
+            if (any && node.count) {
+                for (int t = node.first; t < node.first + node.count; ++t)
+                    intersect(packet, triangles[t]);
+            }
+            else if (any) {
+                // nearest child first, from the direction of the first lane
+                int near = index + 1, far = node.first;
+                if (packet.dir[node.axis][0] < 0.f)
+                    std::swap(near, far);
+                if (size < kStackSize)
+                    stack[size++] = far;
+                index = near;
+                continue;
+            }
+            if (!size)
+                break;
+            index = stack[--size];
+        }
+    }
+
+    /// Moller-Trumbore, terms of the shared origin computed once for the packet
+    static void intersect(Packet& packet, const Triangle& tri)
+    {
+        const auto& e1 = tri.e1;
+        const auto& e2 = tri.e2;
+        const Vector3f s{packet.origin[0] - tri.v0[0], packet.origin[1] - tri.v0[1],
+                         packet.origin[2] - tri.v0[2]};
+        const Vector3f q{s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2],
+                         s[0] * e1[1] - s[1] * e1[0]};
+        const float qe2 = q[0] * e2[0] + q[1] * e2[1] + q[2] * e2[2];
+#ifdef PYBULLET_RENDERING_MATH_SIMD
+        using L = MathLanes;
+        const L::Type zero = L::splat(0.f), one = L::splat(1.f);
+        const L::Type dx = L::load(packet.dir[0]), dy = L::load(packet.dir[1]),
+                      dz = L::load(packet.dir[2]);
+        const auto dot = [](L::Type x, L::Type y, L::Type z, const Vector3f& w) {
+            return L::add(L::add(L::mul(x, L::splat(w[0])), L::mul(y, L::splat(w[1]))),
+                          L::mul(z, L::splat(w[2])));
+        };
+        const L::Type px = L::sub(L::mul(dy, L::splat(e2[2])), L::mul(dz, L::splat(e2[1])));
+        const L::Type py = L::sub(L::mul(dz, L::splat(e2[0])), L::mul(dx, L::splat(e2[2])));
+        const L::Type pz = L::sub(L::mul(dx, L::splat(e2[1])), L::mul(dy, L::splat(e2[0])));
+        const L::Type det = dot(px, py, pz, e1);
+        const L::Type inv = L::div(one, det);
+        const L::Type u = L::mul(dot(px, py, pz, s), inv);
+        const L::Type v = L::mul(dot(dx, dy, dz, q), inv);
+        const L::Type t = L::mul(L::splat(qe2), inv);
+        const L::Type tmax = L::load(packet.tmax);
+        L::Type hit = L::bitAnd(L::notEqual(det, zero), L::lessEqual(zero, u));
+        hit = L::bitAnd(hit, L::lessEqual(zero, v));
+        hit = L::bitAnd(hit, L::lessEqual(L::add(u, v), one));
+        hit = L::bitAnd(hit, L::lessEqual(L::splat(packet.tmin), t));
+        hit = L::bitAnd(hit, L::less(t, tmax));
+        L::store(packet.tmax, L::select(hit, t, tmax));
+        packet.hit |= L::moveMask(hit);
+#else
+        for (int lane = 0; lane < kLanes; ++lane) {
+            const float dx = packet.dir[0][lane], dy = packet.dir[1][lane],
+                        dz = packet.dir[2][lane];
+            const float px = dy * e2[2] - dz * e2[1];
+            const float py = dz * e2[0] - dx * e2[2];
+            const float pz = dx * e2[1] - dy * e2[0];
+            const float det = e1[0] * px + e1[1] * py + e1[2] * pz;
+            const float inv = 1.f / det;
+            const float u = (s[0] * px + s[1] * py + s[2] * pz) * inv;
+            const float v = (dx * q[0] + dy * q[1] + dz * q[2]) * inv;
+            const float t = qe2 * inv;
+            const bool hit = det != 0.f && u >= 0.f && v >= 0.f && u + v <= 1.f &&
+                             t >= packet.tmin && t < packet.tmax[lane];
+            packet.tmax[lane] = hit ? t : packet.tmax[lane];
+            packet.hit |= int(hit) << lane;
+        }
+#endif
+    }
+};
+
+RaySensor::RaySensor(MeshLoader loader)
+    : _loader(loader ? std::move(loader) : MeshLoader(defaultMeshData)),
+      _directions(1, Vector3f{0.f, 0.f, -1.f})
+{
+}
+
+RaySensor::~RaySensor() = default;
+
+void RaySensor::setPinhole(int cols, int rows, const Matrix4f& projMatrix)
+{
+    if (cols <= 0 || rows <= 0)
+        throw std::invalid_argument("Sensor size must be positive");
+    if (projMatrix[0] == 0.f || projMatrix[5] == 0.f || projMatrix[11] != -1.f)
+        throw std::invalid_argument("Projection matrix is not a perspective projection");
+
+    _cols = cols;
+    _rows = rows;
+    _directions.resize(size_t(cols) * rows);
+    for (int row = 0; row < rows; ++row) {
+        const float y = 1.f - (row + 0.5f) / rows * 2.f;
+        for (int col = 0; col < cols; ++col) {
+            const float x = (col + 0.5f) / cols * 2.f - 1.f;
+            // unit depth along -z, so that distances along rays are metric depths
+            _directions[size_t(row) * cols + col] = {(x + projMatrix[8]) / projMatrix[0],
+                                                     (y + projMatrix[9]) / projMatrix[5], -1.f};
+        }
+    }
+
+    const Matrix4f identity{1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f,
+                            0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f};
+    const Camera camera(identity, projMatrix);
+    if (camera.hasIntrinsics())
+        setRange(camera.znear(), camera.zfar());
+}
+
+void RaySensor::setLidar(int channels, int columns, float minElevation, float maxElevation)
+{
+    if (channels <= 0 || columns <= 0)
+        throw std::invalid_argument("Sensor size must be positive");
+
+    _cols = columns;
+    _rows = channels;
+    _directions.resize(size_t(columns) * channels);
+    for (int row = 0; row < channels; ++row) {
+        const float lat = channels > 1 ? maxElevation - (maxElevation - minElevation) * row /
+                                                            float(channels - 1)
+                                       : (minElevation + maxElevation) / 2.f;
+        for (int col = 0; col < columns; ++col) {
+            const float lon = ((col + 0.5f) / columns * 2.f - 1.f) * float(M_PI);
+            _directions[size_t(row) * columns + col] = {std::cos(lat) * std::sin(lon),
+                                                        std::sin(lat),
+                                                        -std::cos(lat) * std::cos(lon)};
+        }
+    }
+}
+
+size_t RaySensor::numTriangles() const
+{
+    size_t count = 0;
+    for (const auto& it : _blas)
+        count += it.second->triangles.size();
+    return count;
+}
+
+void RaySensor::sync(const SceneGraph& sceneGraph, const SceneState& sceneState)
+{
+    const bool graphChanged =
+        &sceneGraph != _sceneGraph || sceneGraph.generation() != _graphGeneration;
+    if (graphChanged) {
+        std::map<const void*, std::shared_ptr<Blas>> used;
+        _nodes.clear();
+        _bounds.clear();
+        for (const auto& it : sceneGraph.nodes()) {
+            const Node& node = it.second;
+            NodeGeometry geometry;
+            AABB bounds = AABB::Empty();
+            for (int i = 0; i < int(node.shapes().size()); ++i) {
+                const auto& shape = node.shapes()[i];
+                const auto data = _loader(shape);
+                if (!data || data->indices().empty())
+                    continue;
+                auto& blas = used[data.get()];
+                if (!blas) {
+                    const auto cached = _blas.find(data.get());
+                    blas = cached != _blas.end() ? cached->second : std::make_shared<Blas>(data);
+                }
+                if (blas->triangles.empty())
+                    continue;
+                const Matrix4f matrix = shape.pose().matrix();
+                geometry.instances.push_back(
+                    {blas.get(), matrix, matrix,
+                     node.segmentation(i, sceneGraph.segmentationMode())});
+                bounds.extend(blas->bounds.transformed(matrix));
+            }
+            if (geometry.instances.empty())
+                continue;
+            _bounds.updateNode(it.first, bounds);
+            _nodes.emplace(it.first, std::move(geometry));
+        }
+        _blas.swap(used); //<- meshes no longer in the scene are released
+        _sceneGraph = &sceneGraph;
+        _graphGeneration = sceneGraph.generation();
+    }
+
+    if (graphChanged || &sceneState != _sceneState ||
+        sceneState.generation() != _stateGeneration) {
+        // poses may have moved without dirty flags, cleared by a renderer
+        _bvh.invalidate();
+        for (auto& it : _nodes) {
+            if (!sceneState.hasNode(it.first))
+                continue;
+            const Matrix4f& nodeMatrix = sceneState.matrix(it.first);
+            for (auto& instance : it.second.instances)
+                instance.inverse = affineInverse(multiply(nodeMatrix, instance.matrix));
+        }
+        _sceneState = &sceneState;
+        _stateGeneration = sceneState.generation();
+    }
+    _bvh.update(_bounds, sceneState);
+}
+
+void RaySensor::cast(const SceneGraph& sceneGraph, const SceneState& sceneState,
+                     const Matrix4f& viewMatrix, float* ranges, int* ids)
+{
+    sync(sceneGraph, sceneState);
+
+    const Matrix4f sensorToWorld = affineInverse(viewMatrix);
+    const Vector3f origin{sensorToWorld[12], sensorToWorld[13], sensorToWorld[14]};
+
+    const int numThreads = std::min(
+        _numThreads > 0 ? _numThreads : int(std::max(1u, std::thread::hardware_concurrency())),
+        _rows);
+    std::atomic<int> next(0);
+    const auto work = [&] {
+        std::vector<int> candidates;
+        BVH::Stack stack;
+        for (int row = next++; row < _rows; row = next++)
+            castRow(row, origin, sensorToWorld, ranges, ids, candidates, stack);
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < numThreads; ++i)
+        workers.emplace_back(work);
+    work();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void RaySensor::castRow(int row, const Vector3f& origin, const Matrix4f& sensorToWorld,
+                        float* ranges, int* ids, std::vector<int>& candidates,
+                        BVH::Stack& stack) const
+{
+    for (int col = 0; col < _cols; col += kLanes) {
+        const int lanes = std::min(kLanes, _cols - col);
+        const size_t first = size_t(row) * _cols + col;
+
+        Vector3f dirs[kLanes];
+        Vector3f invs[kLanes];
+        float best[kLanes];
+        int hitIds[kLanes];
+        bool found[kLanes];
+        for (int lane = 0; lane < kLanes; ++lane) {
+            // inactive lanes repeat the last sample and never hit
+            const auto& direction = _directions[first + std::min(lane, lanes - 1)];
+            dirs[lane] = transformVector(sensorToWorld, direction);
+            for (int k = 0; k < 3; ++k)
+                invs[lane][k] = 1.f / dirs[lane][k];
+            best[lane] = lane < lanes ? _maxRange : -1.f;
+            hitIds[lane] = -1;
+            found[lane] = false;
+        }
+
+        float distance = 0.f;
+        _bvh.collect(
+            [&](const AABB& box) {
+                for (int lane = 0; lane < lanes; ++lane)
+                    if (box.intersectsRay(origin, invs[lane], _maxRange, distance))
+                        return true;
+                return false;
+            },
+            candidates, stack);
+
+        Packet packet;
+        packet.tmin = _minRange;
+        for (int nodeId : candidates) {
+            const auto it = _nodes.find(nodeId);
+            if (it == _nodes.end() || !_sceneState->hasNode(nodeId))
+                continue;
+            for (const auto& instance : it->second.instances) {
+                // distances along rays are kept by the affine transform to the shape frame
+                packet.origin = transformPoint(instance.inverse, origin);
+                packet.hit = 0;
+                for (int lane = 0; lane < kLanes; ++lane) {
+                    const Vector3f d = transformVector(instance.inverse, dirs[lane]);
+                    for (int k = 0; k < 3; ++k) {
+                        packet.dir[k][lane] = d[k];
+                        packet.inv[k][lane] = 1.f / d[k];
+                    }
+                    packet.tmax[lane] = best[lane];
+                }
+                instance.blas->intersect(packet);
+                for (int lane = 0; lane < lanes; ++lane) {
+                    if ((packet.hit >> lane) & 1) {
+                        best[lane] = packet.tmax[lane];
+                        hitIds[lane] = instance.segmentation;
+                        found[lane] = true;
+                    }
+                }
+            }
+        }
+
+        for (int lane = 0; lane < lanes; ++lane) {
+            if (ranges)
+                ranges[first + lane] = found[lane] ? best[lane] : 0.f;
+            if (ids)
+                ids[first + lane] = hitIds[lane];
+        }
+    }
+}
+
+} // namespace scene
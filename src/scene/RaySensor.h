@@ -0,0 +1,168 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "BVH.h"
+#include "Mesh.h"
+#include "SceneBounds.h"
+#include "SceneGraph.h"
+#include "SceneState.h"
+
+#include <utils/math.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Ray-cast range sensor over the visual meshes of a scene
+ *
+ * Casts one ray per sample of a pinhole depth camera or of a spinning LiDAR pattern against the
+ * triangles of the shapes, posed by a SceneState, without rasterizing. Nodes are culled by a
+ * scene BVH, each mesh has a triangle hierarchy of its own built once and shared by all shapes
+ * using the mesh data. Rays are traced in packets of adjacent samples of a row sharing their
+ * origin, one per lane of the SIMD kernels of utils/math.h (4, 8 with AVX), rows spread over
+ * worker threads.
+ *
+ * Triangle hierarchies are built when the scene graph changes, the scene BVH is rebuilt when
+ * the scene state changes, so that dirty flags cleared by a renderer are not relied upon.
+ */
+class RaySensor
+{
+  public:
+    /**
+     * @brief Mesh data of a shape, null if the shape has no triangles to hit
+     */
+    using MeshLoader = std::function<std::shared_ptr<MeshData>(const Shape&)>;
+
+    /**
+     * @brief Construct a sensor of 1 x 1 sample along the view direction
+     *
+     * @param loader - mesh data of shapes, by default the data of in-memory meshes and the
+     * tessellation of primitives, file meshes being skipped
+     */
+    explicit RaySensor(MeshLoader loader = nullptr);
+    ~RaySensor();
+
+    RaySensor(const RaySensor&) = delete;
+    RaySensor& operator=(const RaySensor&) = delete;
+
+    /**
+     * @brief Sample the pixels of a pinhole camera, ranges being metric depths along its axis
+     *
+     * The range is set to the clipping distances of \p projMatrix when it has some.
+     *
+     * @param cols - image width
+     * @param rows - image height
+     * @param projMatrix - OpenGL projection matrix
+     */
+    void setPinhole(int cols, int rows, const Matrix4f& projMatrix);
+
+    /**
+     * @brief Sample a spinning LiDAR, ranges being distances to the sensor origin
+     *
+     * Columns sweep the azimuth from -pi to pi with the sensor direction in the middle, as
+     * equirectangular images do, rows go from the highest elevation down.
+     *
+     * @param channels - number of lasers, rows of the output
+     * @param columns - samples per revolution
+     * @param minElevation - elevation of the lowest laser, in radians
+     * @param maxElevation - elevation of the highest laser, in radians
+     */
+    void setLidar(int channels, int columns, float minElevation, float maxElevation);
+
+    /**
+     * @brief Number of samples per row
+     */
+    int cols() const { return _cols; }
+
+    /**
+     * @brief Number of rows
+     */
+    int rows() const { return _rows; }
+
+    /**
+     * @brief Range of valid hits, closer and farther ones being misses
+     */
+    void setRange(float minRange, float maxRange)
+    {
+        _minRange = minRange;
+        _maxRange = maxRange;
+    }
+
+    float minRange() const { return _minRange; }
+    float maxRange() const { return _maxRange; }
+
+    /**
+     * @brief Number of threads casting rows, 0 for one per core
+     */
+    int numThreads() const { return _numThreads; }
+
+    /** @overload */
+    void setNumThreads(int numThreads) { _numThreads = numThreads; }
+
+    /**
+     * @brief Number of triangles in the hierarchies built so far
+     */
+    size_t numTriangles() const;
+
+    /**
+     * @brief Cast the rays of the sensor
+     *
+     * Outputs hold rows x cols samples, top row first. Misses have a range of 0 and an id of -1,
+     * hits the mask value of their shape in the segmentation mode of the scene, see
+     * Node::segmentation().
+     *
+     * @param sceneGraph - scene description
+     * @param sceneState - scene state holding node poses
+     * @param viewMatrix - world to sensor transform, looking along -z with y up
+     * @param ranges - output ranges, may be null
+     * @param ids - output segmentation ids, may be null
+     */
+    void cast(const SceneGraph& sceneGraph, const SceneState& sceneState,
+              const Matrix4f& viewMatrix, float* ranges, int* ids);
+
+  private:
+    struct Blas; //<- triangle hierarchy of a mesh
+
+    struct Instance {
+        const Blas* blas;
+        Matrix4f matrix; //<- shape frame to node frame
+        Matrix4f inverse; //<- world frame to shape frame, at the current cast
+        int segmentation; //<- mask value of the shape
+    };
+
+    struct NodeGeometry {
+        std::vector<Instance> instances;
+    };
+
+    void sync(const SceneGraph& sceneGraph, const SceneState& sceneState);
+    void castRow(int row, const Vector3f& origin, const Matrix4f& sensorToWorld, float* ranges,
+                 int* ids, std::vector<int>& candidates, BVH::Stack& stack) const;
+
+    MeshLoader _loader;
+    // sampling pattern
+    int _cols = 1;
+    int _rows = 1;
+    std::vector<Vector3f> _directions; //<- sensor frame ray of each sample, row-major
+    float _minRange = 0.f;
+    float _maxRange = 100.f;
+    int _numThreads = 0;
+    // scene
+    std::map<const void*, std::shared_ptr<Blas>> _blas; //<- by mesh data
+    std::map<int, NodeGeometry> _nodes;
+    SceneBounds _bounds; //<- node bounds of the instanced triangles
+    BVH _bvh;
+    const SceneGraph* _sceneGraph = nullptr;
+    uint64_t _graphGeneration = 0;
+    const SceneState* _sceneState = nullptr;
+    uint64_t _stateGeneration = 0;
+};
+
+} // namespace scene
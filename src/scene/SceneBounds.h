@@ -0,0 +1,150 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Bounds.h"
+#include "Camera.h"
+#include "SceneGraph.h"
+#include "SceneState.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Bounds of scene nodes, for view frustum culling
+ *
+ * Caches the bounds of each node in its own frame, world bounds are derived from the node poses
+ * of a SceneState. A renderer updates the cached nodes along with its own copy of the scene.
+ */
+class SceneBounds
+{
+  public:
+    /**
+     * @brief Cache bounds of all nodes of a scene
+     *
+     * @param sceneGraph - scene description
+     */
+    void update(const SceneGraph& sceneGraph)
+    {
+        _bounds.clear();
+        for (const auto& it : sceneGraph.nodes())
+            _bounds.emplace(it.first, it.second.bounds());
+        ++_generation;
+    }
+
+    /**
+     * @brief Cache bounds of an appended or changed node
+     *
+     * @param nodeId - unique node id
+     * @param node - node description
+     */
+    void updateNode(int nodeId, const Node& node)
+    {
+        _bounds[nodeId] = node.bounds();
+        ++_generation;
+    }
+
+    /** @overload */
+    void updateNode(int nodeId, const AABB& bounds)
+    {
+        _bounds[nodeId] = bounds;
+        ++_generation;
+    }
+
+    /**
+     * @brief Forget a removed node
+     *
+     * @param nodeId - unique node id
+     */
+    void removeNode(int nodeId)
+    {
+        _bounds.erase(nodeId);
+        ++_generation;
+    }
+
+    /**
+     * @brief Forget all nodes
+     */
+    void clear()
+    {
+        _bounds.clear();
+        ++_generation;
+    }
+
+    /**
+     * @brief Map id - node bounds in the node frame
+     */
+    const std::map<int, AABB>& nodes() const { return _bounds; }
+
+    /**
+     * @brief Counter incremented each time cached bounds change
+     */
+    uint64_t generation() const { return _generation; }
+
+    /**
+     * @brief Bounds of a node in world frame
+     *
+     * @param nodeId - unique node id
+     * @param sceneState - scene state holding the node pose
+     * @throw std::out_of_range - if the node is not cached or has no state
+     */
+    AABB worldBounds(int nodeId, const SceneState& sceneState) const
+    {
+        return _bounds.at(nodeId).transformed(sceneState.matrix(nodeId));
+    }
+
+    /**
+     * @brief Ids of nodes which may be seen by a camera, in increasing order
+     *
+     * Nodes without a state are skipped.
+     *
+     * @param sceneState - scene state holding node poses
+     * @param camera - camera
+     */
+    std::vector<int> visibleNodes(const SceneState& sceneState, const Camera& camera) const
+    {
+        const Frustum frustum(multiply(camera.projMatrix(), camera.viewMatrix()));
+        std::vector<int> ids;
+        for (const auto& it : _bounds) {
+            if (!sceneState.hasNode(it.first))
+                continue;
+            if (frustum.intersects(it.second.transformed(sceneState.matrix(it.first))))
+                ids.push_back(it.first);
+        }
+        return ids;
+    }
+
+    /**
+     * @brief Ids of nodes of a scene which may be seen by a camera, in increasing order
+     *
+     * Bounds are computed on the fly, for callers not keeping a SceneBounds in sync.
+     *
+     * @param sceneGraph - scene description
+     * @param sceneState - scene state holding node poses
+     * @param camera - camera
+     */
+    static std::vector<int> visibleNodes(const SceneGraph& sceneGraph,
+                                         const SceneState& sceneState, const Camera& camera)
+    {
+        const Frustum frustum(multiply(camera.projMatrix(), camera.viewMatrix()));
+        std::vector<int> ids;
+        for (const auto& it : sceneGraph.nodes()) {
+            if (!sceneState.hasNode(it.first))
+                continue;
+            if (frustum.intersects(it.second.bounds().transformed(sceneState.matrix(it.first))))
+                ids.push_back(it.first);
+        }
+        return ids;
+    }
+
+  private:
+    std::map<int, AABB> _bounds; //<- node id -> bounds in the node frame
+    uint64_t _generation = 0;
+};
+
+} // namespace scene
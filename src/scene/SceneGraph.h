@@ -4,14 +4,200 @@
 
 #pragma once
 
-#include "Node.h"
+#include "NodeMap.h"
+#include "ObjectPool.h"
+#include "Primitives.h"
+#include "VisibilityLayers.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
 namespace scene {
 
+class SceneLayer;
+
+/**
+ * @brief Changes made to a scene graph since the last synchronization
+ *
+ * Lets a renderer update only affected nodes instead of rebuilding the whole scene.
+ */
+class SceneGraphDelta
+{
+  public:
+    /**
+     * @brief Ids of nodes appended to the scene
+     */
+    const std::set<int>& added() const { return _added; }
+
+    /**
+     * @brief Ids of nodes removed from the scene
+     */
+    const std::set<int>& removed() const { return _removed; }
+
+    /**
+     * @brief Ids of nodes with changed shape materials
+     */
+    const std::set<int>& changed() const { return _changed; }
+
+    /**
+     * @brief Ids of nodes with mesh vertices rewritten in place, topology unchanged
+     *
+     * A node may also have changed materials, e.g. a deformable body recolored mid-episode.
+     */
+    const std::set<int>& geometryChanged() const { return _geometryChanged; }
+
+    /**
+     * @brief Ids of nodes with texture pixels rewritten in place, sizes unchanged
+     *
+     * Independent of the other changes: a node may also be rebuilt or have changed materials.
+     */
+    const std::set<int>& texelsChanged() const { return _texelsChanged; }
+
+    /**
+     * @brief Nothing changed
+     */
+    bool empty() const
+    {
+        return _added.empty() && _removed.empty() && _changed.empty() &&
+               _geometryChanged.empty() && _texelsChanged.empty();
+    }
+
+    /**
+     * @brief Only texture pixels changed
+     */
+    bool texelsOnly() const
+    {
+        return _added.empty() && _removed.empty() && _changed.empty() &&
+               _geometryChanged.empty() && !_texelsChanged.empty();
+    }
+
+    /**
+     * @brief Only shape materials changed, no mesh vertices
+     */
+    bool materialsOnly() const
+    {
+        return _added.empty() && _removed.empty() && !_changed.empty() && _geometryChanged.empty();
+    }
+
+    /**
+     * @brief Only mesh vertices changed, no shape materials
+     */
+    bool geometryOnly() const
+    {
+        return _added.empty() && _removed.empty() && _changed.empty() && !_geometryChanged.empty();
+    }
+
+    /**
+     * @brief Register an appended node
+     */
+    void nodeAdded(int nodeId)
+    {
+        _changed.erase(nodeId);
+        _geometryChanged.erase(nodeId);
+        _texelsChanged.erase(nodeId);
+        _added.insert(nodeId);
+    }
+
+    /**
+     * @brief Register a removed node
+     *
+     * A node appended and removed within the same delta is dropped entirely.
+     */
+    void nodeRemoved(int nodeId)
+    {
+        _changed.erase(nodeId);
+        _geometryChanged.erase(nodeId);
+        _texelsChanged.erase(nodeId);
+        if (!_added.erase(nodeId))
+            _removed.insert(nodeId);
+    }
+
+    /**
+     * @brief Register a node to convert again, e.g. with new segmentation ids
+     */
+    void nodeRebuilt(int nodeId)
+    {
+        nodeRemoved(nodeId);
+        nodeAdded(nodeId);
+    }
+
+    /**
+     * @brief Register a node with changed materials
+     */
+    void nodeChanged(int nodeId)
+    {
+        if (!_added.count(nodeId))
+            _changed.insert(nodeId);
+    }
+
+    /**
+     * @brief Register a node with mesh vertices rewritten in place
+     *
+     * Appended nodes are not registered, they are converted with their vertices anyway.
+     */
+    void nodeGeometryChanged(int nodeId)
+    {
+        if (!_added.count(nodeId))
+            _geometryChanged.insert(nodeId);
+    }
+
+    /**
+     * @brief Register a node with texture pixels rewritten in place
+     *
+     * Appended nodes are not registered, they load their textures anyway.
+     */
+    void nodeTexelsChanged(int nodeId)
+    {
+        if (!_added.count(nodeId))
+            _texelsChanged.insert(nodeId);
+    }
+
+    /**
+     * @brief Forget all changes
+     */
+    void clear()
+    {
+        _added.clear();
+        _removed.clear();
+        _changed.clear();
+        _geometryChanged.clear();
+        _texelsChanged.clear();
+    }
+
+    /**
+     * @brief Comparison operators
+     */
+    bool operator==(const SceneGraphDelta& other) const
+    {
+        return _added == other._added && _removed == other._removed &&
+               _changed == other._changed && _geometryChanged == other._geometryChanged &&
+               _texelsChanged == other._texelsChanged;
+    }
+    bool operator!=(const SceneGraphDelta& other) const { return !(*this == other); }
+
+    /**
+     * @brief Serialization
+     */
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(_added, _removed, _changed, _geometryChanged, _texelsChanged);
+    }
+
+  private:
+    std::set<int> _added;
+    std::set<int> _removed;
+    std::set<int> _changed;
+    std::set<int> _geometryChanged;
+    std::set<int> _texelsChanged;
+};
+
 /**
  * @brief Scene graph description
  *
@@ -20,11 +206,11 @@ class SceneGraph
 {
   public:
     /**
-     * @brief Map id - node
+     * @brief Map id - node, stored densely with arrays of ids, bodies and links
      *
      * @return const container
      */
-    const std::map<int, Node>& nodes() const { return _nodes; }
+    const NodeMap& nodes() const { return _nodes; }
 
     /**
      * @brief Append an object to the scene
@@ -32,14 +218,35 @@ class SceneGraph
      * @param nodeId - unique node id
      * @param node - node description
      */
-    void appendNode(int nodeId, Node node) { _nodes.emplace(nodeId, std::move(node)); }
+    void appendNode(int nodeId, Node node)
+    {
+        for (int i = 0; i < int(node.shapes().size()); ++i)
+            node.shape(i).setMaterial(internMaterial(node.shape(i).material()));
+        _nodes.emplace(nodeId, std::move(node));
+        regroup(nodeId);
+        _delta.nodeAdded(nodeId);
+        ++_generation;
+    }
 
     /**
      * @brief Remove an object from the scene
      *
      * @param nodeId - unique node id
      */
-    void removeNode(int nodeId) { _nodes.erase(nodeId); }
+    void removeNode(int nodeId)
+    {
+        if (_nodes.count(nodeId)) {
+            ungroup(nodeId);
+            _nodes.erase(nodeId);
+            _delta.nodeRemoved(nodeId);
+            ++_generation;
+        }
+        if (_visibilityLayers && _visibilityLayers->hasNode(nodeId)) {
+            auto layers = std::make_shared<VisibilityLayers>(*_visibilityLayers);
+            layers->removeNode(nodeId);
+            _visibilityLayers = layers->empty() ? nullptr : layers;
+        }
+    }
 
     /**
      * @brief Change shape texture
@@ -51,9 +258,12 @@ class SceneGraph
     void changeShapeTexture(int nodeId, int shapeIndex, const std::shared_ptr<Texture>& texture)
     {
         auto& shape = _nodes.at(nodeId).shape(shapeIndex);
-        auto material = !shape.material() ? std::make_shared<Material>() : shape.material();
-        material->setDiffuseTexture(texture);
-        shape.setMaterial(material);
+        auto material = shape.material() ? *shape.material() : Material();
+        material.setDiffuseTexture(texture);
+        shape.setMaterial(internMaterial(material));
+        regroup(nodeId);
+        _delta.nodeChanged(nodeId);
+        ++_generation;
     }
 
     /**
@@ -66,9 +276,310 @@ class SceneGraph
     void changeShapeColor(int nodeId, int shapeIndex, const Color4f& color)
     {
         auto& shape = _nodes.at(nodeId).shape(shapeIndex);
-        auto material = !shape.material() ? std::make_shared<Material>() : shape.material();
-        material->setDiffuseColor(color);
-        shape.setMaterial(material);
+        auto material = shape.material() ? *shape.material() : Material();
+        material.setDiffuseColor(color);
+        shape.setMaterial(internMaterial(material));
+        regroup(nodeId);
+        _delta.nodeChanged(nodeId);
+        ++_generation;
+    }
+
+    /**
+     * @brief Register pixels of a texture bitmap rewritten in place, e.g. a video frame
+     *
+     * The bitmap gets a new revision, see Bitmap::touch(), and all nodes drawing the texture
+     * are registered in the delta, so that renderers upload its pixels again. The size and
+     * channels of the bitmap must be unchanged.
+     *
+     * @param texture - texture whose bitmap pixels were rewritten
+     * @return Number of nodes drawing the texture
+     */
+    int changeTexels(const std::shared_ptr<Texture>& texture)
+    {
+        if (!texture || !texture->bitmap())
+            return 0;
+        texture->bitmap()->touch();
+        int count = 0;
+        for (const auto& it : _nodes) {
+            for (const auto& shape : it.second.shapes()) {
+                const auto& material = shape.material();
+                if (material && material->diffuseTexture() == texture) {
+                    _delta.nodeTexelsChanged(it.first);
+                    ++count;
+                    break;
+                }
+            }
+        }
+        ++_generation;
+        return count;
+    }
+
+    /**
+     * @brief Prepare in-place vertex update of a mesh shape
+     *
+     * A mesh shared with other shapes, the asset cache or a renderer snapshot is copied first,
+     * so that the update never leaks outside this shape. The caller then writes vertices and
+     * normals into the returned data, see MeshData::mutableVertices(). The vertex count is kept,
+     * as the indices, uvs and normals of the mesh refer to its vertices.
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node
+     * @param numVertices - number of vertices written, that of the mesh
+     * @throw std::invalid_argument - if the shape has no in-memory mesh or another vertex count
+     * @return MeshData& - mesh data to write
+     */
+    MeshData& changeShapeGeometry(int nodeId, int shapeIndex, int numVertices)
+    {
+        auto& shape = _nodes.at(nodeId).shape(shapeIndex);
+        const auto& mesh = shape.mesh();
+        if (!mesh || !mesh->data())
+            throw std::invalid_argument("Shape has no in-memory mesh");
+        if (int(mesh->data()->numVertices()) != numVertices)
+            throw std::invalid_argument("Number of vertices of the mesh mismatch");
+
+        if (mesh->assetId() >= 0 || mesh.use_count() > 1 || mesh->data().use_count() > 1) {
+            shape.setMesh(std::make_shared<Mesh>(std::make_shared<MeshData>(*mesh->data())));
+            // the node does not share its mesh any more
+            regroup(nodeId);
+        }
+
+        auto& data = *shape.mesh()->data();
+        data.setVertexBuffer(nullptr); //<- outdated by the caller
+        _delta.nodeGeometryChanged(nodeId);
+        ++_generation;
+        return data;
+    }
+
+    /**
+     * @brief Prepare in-place height update of a heightfield shape
+     *
+     * A heightfield shared with other shapes or a renderer snapshot is copied first, keeping the
+     * revisions of its tiles. The caller then writes heights with Heightfield::setHeight(), which
+     * bumps the revisions of the modified tiles only.
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node
+     * @throw std::invalid_argument - if the shape has no heightfield
+     * @return Heightfield& - heightfield to write
+     */
+    Heightfield& changeShapeHeightfield(int nodeId, int shapeIndex)
+    {
+        auto& shape = _nodes.at(nodeId).shape(shapeIndex);
+        const auto& heightfield = shape.heightfield();
+        if (!heightfield)
+            throw std::invalid_argument("Shape has no heightfield");
+
+        if (heightfield.use_count() > 1)
+            shape.setHeightfield(std::make_shared<Heightfield>(*heightfield));
+        _delta.nodeGeometryChanged(nodeId);
+        ++_generation;
+        return *shape.heightfield();
+    }
+
+    /**
+     * @brief Shared nodes drawn under those of the graph, null if none, see SceneLayer
+     *
+     * Changing it bumps the generation and renderers update their whole scene. Renderers not
+     * drawing base layers ignore it, as do scene bounds and serialization.
+     */
+    const std::shared_ptr<const SceneLayer>& baseLayer() const { return _baseLayer; }
+    /** @overload */
+    void setBaseLayer(const std::shared_ptr<const SceneLayer>& layer)
+    {
+        if (layer == _baseLayer)
+            return;
+        _baseLayer = layer;
+        ++_generation;
+    }
+
+    /**
+     * @brief Values drawn into the segmentation masks
+     */
+    SegmentationMode segmentationMode() const { return _segmentationMode; }
+
+    /**
+     * @brief Change the values drawn into the segmentation masks, all nodes are rebuilt
+     */
+    void setSegmentationMode(SegmentationMode mode)
+    {
+        if (mode == _segmentationMode)
+            return;
+        _segmentationMode = mode;
+        for (const auto& it : _nodes)
+            _delta.nodeRebuilt(it.first);
+        ++_generation;
+    }
+
+    /**
+     * @brief Mask value of a shape in the current segmentation mode, see Node::segmentation()
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node
+     * @return int - value drawn into the segmentation masks
+     */
+    int segmentation(int nodeId, int shapeIndex) const
+    {
+        return _nodes.at(nodeId).segmentation(shapeIndex, _segmentationMode);
+    }
+
+    /**
+     * @brief Change the user segmentation ids of a node or of one of its shapes
+     *
+     * The node is rebuilt, so that renderers draw the new values into their masks.
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node, -1 for the node itself
+     * @param instanceId - id of SegmentationMode::Instance, -1 for that of the node
+     * @param semanticId - class id of SegmentationMode::Semantic, -1 for that of the node
+     */
+    void changeSegmentationIds(int nodeId, int shapeIndex, int instanceId, int semanticId)
+    {
+        auto& node = _nodes.at(nodeId);
+        if (shapeIndex < 0) {
+            node.setInstanceId(instanceId);
+            node.setSemanticId(semanticId);
+        }
+        else {
+            node.shape(shapeIndex).setInstanceId(instanceId);
+            node.shape(shapeIndex).setSemanticId(semanticId);
+        }
+        _delta.nodeRebuilt(nodeId);
+        ++_generation;
+    }
+
+    /**
+     * @brief Visibility layers of the nodes and shapes, null if all are in all layers
+     *
+     * Layers are not modified once set, a change replaces them, so that views share them
+     * with the graph, see SceneView::visibilityLayers(). They are no change of the scene:
+     * neither the delta nor the generation change with them.
+     */
+    const std::shared_ptr<VisibilityLayers>& visibilityLayers() const
+    {
+        return _visibilityLayers;
+    }
+
+    /**
+     * @brief Change the visibility layers of a node or of one of its shapes
+     *
+     * @param nodeId - unique node id
+     * @param shapeIndex - shape index inside the node, -1 for the node itself
+     * @param layers - bitmask of layers, VisibilityLayers::kAll for all
+     */
+    void setVisibilityLayers(int nodeId, int shapeIndex, uint32_t layers)
+    {
+        auto visibility = _visibilityLayers ? std::make_shared<VisibilityLayers>(*_visibilityLayers)
+                                            : std::make_shared<VisibilityLayers>();
+        visibility->setLayers(nodeId, shapeIndex, layers);
+        _visibilityLayers = visibility->empty() ? nullptr : visibility;
+    }
+
+    /**
+     * @brief Instance group of a node
+     *
+     * @param nodeId - unique node id
+     * @return int - group id, -1 if the node is not instanced
+     */
+    int instanceGroup(int nodeId) const
+    {
+        const auto it = _instanceGroups.find(nodeId);
+        return it != _instanceGroups.end() ? it->second : -1;
+    }
+
+    /**
+     * @brief Map group id - ids of nodes drawing the same mesh with the same material
+     *
+     * Nodes made of a single mesh shape are grouped when they share the Mesh or MeshData object,
+     * which the asset cache ensures for identical meshes, and have equal materials. Nodes of a
+     * single primitive are grouped with the primitives of the same type and dimensions. A renderer
+     * can then upload the mesh once and issue a single instanced draw per group, only poses
+     * differ between instances.
+     *
+     * @return container
+     */
+    std::map<int, std::vector<int>> instanceGroups() const
+    {
+        std::map<int, std::vector<int>> groups;
+        for (const auto& it : _groups)
+            groups.emplace(it.first, std::vector<int>(it.second.nodes.begin(),
+                                                      it.second.nodes.end()));
+        return groups;
+    }
+
+    /**
+     * @brief Shared material equal to \p material, \p material itself if none is known yet
+     *
+     * Materials of appended nodes and changed shapes are interned, so that shapes with equal
+     * colors and textures share a single Material object and renderers can sort their draws by
+     * it. Interned materials must not be modified in place, shapes change theirs with
+     * changeShapeColor() and changeShapeTexture().
+     *
+     * @param material - material to intern, may be null
+     * @return std::shared_ptr<Material> - interned material
+     */
+    std::shared_ptr<Material> internMaterial(const std::shared_ptr<Material>& material)
+    {
+        if (!material)
+            return material;
+
+        const uint64_t hash = material->hash();
+        if (auto interned = findMaterial(*material, hash))
+            return interned;
+        storeMaterial(hash, material);
+        return material;
+    }
+
+    /**
+     * @brief Shared material equal to \p material, allocated if none is known yet
+     *
+     * New materials are allocated from the material pool of the scene graph, so that the
+     * materials of a scene lie next to each other and are freed at once, see ObjectPool.
+     * Converters should intern values rather than allocate materials themselves: equal
+     * materials, the most common case, then allocate nothing.
+     *
+     * @param material - material to intern
+     * @return std::shared_ptr<Material> - interned material
+     */
+    std::shared_ptr<Material> internMaterial(const Material& material)
+    {
+        const uint64_t hash = material.hash();
+        if (auto interned = findMaterial(material, hash))
+            return interned;
+        auto pooled =
+            std::allocate_shared<Material>(PoolAllocator<Material>(_materialPool), material);
+        storeMaterial(hash, pooled);
+        return pooled;
+    }
+
+    /**
+     * @brief Pool of the materials interned since the last clear()
+     */
+    const ObjectPool& materialPool() const { return *_materialPool; }
+
+    /**
+     * @brief Number of distinct Material objects used by the shapes of the nodes
+     */
+    size_t uniqueMaterials() const
+    {
+        std::set<const Material*> materials;
+        for (const auto& it : _nodes)
+            for (const auto& shape : it.second.shapes())
+                if (shape.material())
+                    materials.insert(shape.material().get());
+        return materials.size();
+    }
+
+    /**
+     * @brief Number of shapes with a transparent material, see Material::transparent()
+     */
+    size_t transparentShapes() const
+    {
+        size_t count = 0;
+        for (const auto& it : _nodes)
+            for (const auto& shape : it.second.shapes())
+                if (shape.material() && shape.material()->transparent())
+                    ++count;
+        return count;
     }
 
     /**
@@ -78,15 +589,41 @@ class SceneGraph
     void clear()
     {
         _nodes.clear();
+        _materials.clear();
+        // a new pool, the chunks of the last one are freed with its last material
+        _materialPool = std::make_shared<ObjectPool>();
+        _instanceGroups.clear();
+        _groups.clear();
+        _groupsByGeometry.clear();
         _textures.clear();
+        _baseLayer.reset();
+        _visibilityLayers.reset();
+        _delta.clear();
+        ++_generation;
     }
 
+    /**
+     * @brief Changes accumulated since the last call to resetDelta()
+     */
+    const SceneGraphDelta& delta() const { return _delta; }
+
+    /**
+     * @brief Mark the scene graph as synchronized with a renderer
+     */
+    void resetDelta() { _delta.clear(); }
+
+    /**
+     * @brief Counter incremented each time the scene changes
+     */
+    uint64_t generation() const { return _generation; }
+
     /**
      * @brief Comparison operators
      */
     bool operator==(const SceneGraph& other) const
     {
-        return _nodes == other._nodes && _textures == other._textures;
+        return _nodes == other._nodes && _textures == other._textures &&
+               _segmentationMode == other._segmentationMode;
     }
     bool operator!=(const SceneGraph& other) const { return !(*this == other); }
 
@@ -94,15 +631,156 @@ class SceneGraph
      * @brief Serialization
      */
     template <class Archive>
-    void serialize(Archive& ar)
+    void save(Archive& ar) const
+    {
+        ar(_nodes, _textures, _segmentationMode);
+    }
+    /** @overload */
+    template <class Archive>
+    void load(Archive& ar)
     {
-        ar(_nodes, _textures);
+        ar(_nodes, _textures, _segmentationMode);
+
+        _materials.clear();
+        for (auto& it : _nodes)
+            for (int i = 0; i < int(it.second.shapes().size()); ++i)
+                it.second.shape(i).setMaterial(internMaterial(it.second.shape(i).material()));
+        _instanceGroups.clear();
+        _groups.clear();
+        _groupsByGeometry.clear();
+        for (const auto& it : _nodes)
+            regroup(it.first);
+        ++_generation;
     }
 
   private:
-    std::map<int, Node> _nodes;
+    /**
+     * @brief Interned material equal to \p material, null if none
+     */
+    std::shared_ptr<Material> findMaterial(const Material& material, uint64_t hash) const
+    {
+        const auto range = _materials.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            auto interned = it->second.lock();
+            if (interned && (interned.get() == &material || *interned == material))
+                return interned;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Register a new interned material
+     */
+    void storeMaterial(uint64_t hash, const std::shared_ptr<Material>& material)
+    {
+        // materials of removed nodes, dropped once the table doubled
+        if (_materials.size() >= _materialsPruneSize) {
+            for (auto it = _materials.begin(); it != _materials.end();)
+                it = it->second.expired() ? _materials.erase(it) : std::next(it);
+            _materialsPruneSize = std::max(size_t(64), _materials.size() * 2);
+        }
+        _materials.emplace(hash, material);
+    }
+
+    /**
+     * @brief Nodes drawing the same geometry with the same material
+     */
+    struct InstanceGroup {
+        const void* geometry; //<- shared Mesh or MeshData
+        std::shared_ptr<Material> material;
+        std::set<int> nodes;
+    };
+
+    /**
+     * @brief Geometry identifying the instance group of a node, null if it cannot be instanced
+     */
+    static const void* instanceGeometry(const Node& node)
+    {
+        if (node.shapes().size() != 1)
+            return nullptr;
+
+        // primitives of equal dimensions share their tessellation, kept for the process
+        const auto& shape = node.shapes()[0];
+        const auto& mesh = shape.mesh();
+        if (!mesh)
+            return shape.type() != ShapeType::Heightfield ? primitiveMesh(shape).get() : nullptr;
+        return mesh->data() ? static_cast<const void*>(mesh->data().get()) : mesh.get();
+    }
+
+    /**
+     * @brief Remove a node from its instance group, dropping the group once empty
+     */
+    void ungroup(int nodeId)
+    {
+        const auto it = _instanceGroups.find(nodeId);
+        if (it == _instanceGroups.end())
+            return;
+
+        const auto jt = _groups.find(it->second);
+        jt->second.nodes.erase(nodeId);
+        if (jt->second.nodes.empty()) {
+            const auto range = _groupsByGeometry.equal_range(jt->second.geometry);
+            for (auto kt = range.first; kt != range.second; ++kt) {
+                if (kt->second == jt->first) {
+                    _groupsByGeometry.erase(kt);
+                    break;
+                }
+            }
+            _groups.erase(jt);
+        }
+        _instanceGroups.erase(it);
+    }
+
+    /**
+     * @brief Move a node to the instance group matching its geometry and material
+     */
+    void regroup(int nodeId)
+    {
+        ungroup(nodeId);
+
+        const auto& node = _nodes.at(nodeId);
+        const void* geometry = instanceGeometry(node);
+        if (!geometry)
+            return;
+
+        const auto& material = node.shapes()[0].material();
+        int groupId = -1;
+        const auto range = _groupsByGeometry.equal_range(geometry);
+        for (auto it = range.first; it != range.second; ++it) {
+            const auto& other = _groups.at(it->second).material;
+            if (material == other || material && other && *material == *other) {
+                groupId = it->second;
+                break;
+            }
+        }
+        if (groupId < 0) {
+            groupId = _nextInstanceGroup++;
+            _groups.emplace(groupId, InstanceGroup{geometry, material, {}});
+            _groupsByGeometry.emplace(geometry, groupId);
+        }
+        _groups.at(groupId).nodes.insert(nodeId);
+        _instanceGroups.emplace(nodeId, groupId);
+    }
+
+    NodeMap _nodes;
     // assets
     std::vector<Texture> _textures;
+    // interned materials by content hash (not serialized)
+    std::unordered_multimap<uint64_t, std::weak_ptr<Material>> _materials;
+    size_t _materialsPruneSize = 64;
+    // storage of the materials interned by value, shared with copies (not serialized)
+    std::shared_ptr<ObjectPool> _materialPool = std::make_shared<ObjectPool>();
+    // instance groups, derived from nodes (not serialized)
+    std::map<int, int> _instanceGroups; //<- node id -> group id
+    std::map<int, InstanceGroup> _groups;
+    std::multimap<const void*, int> _groupsByGeometry;
+    int _nextInstanceGroup = 0;
+    // changes not yet seen by a renderer (not serialized)
+    std::shared_ptr<const SceneLayer> _baseLayer;
+    std::shared_ptr<VisibilityLayers> _visibilityLayers; //<- null if all visible
+    SceneGraphDelta _delta;
+    uint64_t _generation = 0;
+    SegmentationMode _segmentationMode = SegmentationMode::BodyLink; //<- kept by clear()
 };
 
 } // namespace scene
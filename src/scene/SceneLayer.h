@@ -0,0 +1,89 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "NodeMap.h"
+#include "SceneState.h"
+
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+namespace scene {
+
+/**
+ * @brief Immutable nodes posed once, shared by the scene graphs of several clients
+ *
+ * Vectorized environments often load the same static scenery, e.g. a room and its furniture,
+ * and differ only in a few dynamic bodies. A layer freezes the nodes of the bodies of that
+ * scenery with their world matrices once; scene graphs then reference it as their base layer,
+ * see SceneGraph::baseLayer(), and hold only their own nodes on top of it. Renderers drawing
+ * base layers keep the resources of a layer once for all the scenes sharing it, see
+ * BaseRenderer::drawsBaseLayer().
+ *
+ * Nothing of a layer changes after its construction, so that it is read by the renderers of
+ * any client without locking; its shapes share the meshes, materials and textures of the scene
+ * graph it was built from.
+ */
+class SceneLayer
+{
+  public:
+    /**
+     * @brief Freeze the nodes of some bodies of a scene at their current poses
+     *
+     * @param nodes - nodes of the scene graph, see SceneGraph::nodes()
+     * @param sceneState - poses of the nodes
+     * @param bodies - unique ids of the bodies of the layer
+     * @throw std::invalid_argument - if a node of the bodies has no pose
+     */
+    SceneLayer(const NodeMap& nodes, const SceneState& sceneState, const std::set<int>& bodies)
+        : _bodies(bodies), _bounds(AABB::Empty())
+    {
+        for (const auto& it : nodes) {
+            if (!bodies.count(it.second.body()))
+                continue;
+            if (!sceneState.hasNode(it.first))
+                throw std::invalid_argument("Node " + std::to_string(it.first) +
+                                            " of a layer has no pose");
+            const auto& matrix = sceneState.matrix(it.first);
+            Node node = it.second;
+            _nodes.emplace(it.first, std::move(node));
+            _matrices.emplace(it.first, matrix);
+            _bounds.extend(it.second.bounds().transformed(matrix));
+        }
+    }
+
+    /**
+     * @brief Nodes of the layer, by their id in the scene the layer was built from
+     */
+    const NodeMap& nodes() const { return _nodes; }
+
+    /**
+     * @brief World matrix of a node
+     *
+     * @param nodeId - node id in the layer
+     * @throw std::out_of_range - if the node is not in the layer
+     */
+    const Matrix4f& matrix(int nodeId) const { return _matrices.at(nodeId); }
+
+    /**
+     * @brief Unique ids of the bodies of the layer
+     */
+    const std::set<int>& bodies() const { return _bodies; }
+
+    /**
+     * @brief World bounds of the shapes, infinite if some are unknown
+     */
+    const AABB& bounds() const { return _bounds; }
+
+  private:
+    NodeMap _nodes;
+    std::map<int, Matrix4f> _matrices;
+    std::set<int> _bodies;
+    AABB _bounds;
+};
+
+} // namespace scene
@@ -6,82 +6,520 @@
 
 #include <utils/math.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <vector>
 
 namespace scene {
 
 /**
  * @brief Scene state
  *
- * Contatins poses for all movable objects on a scene
+ * Contatins poses for all movable objects on a scene.
+ *
+ * Poses are stored densely: each node owns a slot in contiguous origin, rotation, scale and
+ * world matrix arrays, so that a renderer can grab all transforms at once.
+ *
+ * Each slot also carries a dirty flag raised whenever its pose actually changes, so that a
+ * renderer can upload only the transforms that moved since the last clearDirty().
+ *
+ * Nodes classified as static, e.g. fixed bases, are expected not to move: a renderer may merge
+ * their geometry in world space and skip their transforms. A static node whose pose changes
+ * becomes dynamic again, see staticGeneration().
+ *
+ * Poses can be saved and restored cheaply, e.g. along the branches of a planner, see snapshot().
  */
 class SceneState
 {
   public:
+    /// slots per chunk of a snapshot
+    static constexpr int kSnapshotChunk = 64;
+
+    /**
+     * @brief Poses of a scene state at some point, see snapshot()
+     *
+     * Immutable once made. Slots are split into chunks of kSnapshotChunk slots, shared by the
+     * snapshots and the state which did not change them since.
+     */
+    class Snapshot
+    {
+      public:
+        /**
+         * @brief Number of nodes
+         */
+        size_t size() const { return _ids->size(); }
+
+      private:
+        friend class SceneState;
+
+        struct Chunk {
+            std::vector<Vector3f> origins;
+            std::vector<Quaternionf> quats;
+            std::vector<Vector3f> scales;
+        };
+
+        uint64_t _layout; //<- layout of the nodes in the slots of the state
+        std::shared_ptr<const std::vector<int>> _ids; //<- node of each slot
+        std::vector<std::shared_ptr<const Chunk>> _chunks;
+    };
+
     /**
      * @brief Append a state for a node
      *
      * @param nodeId - unique node id
-     * @param node - node description
      */
-    void appendNode(int nodeId) { _poses.emplace(nodeId, Affine3f::Identity()); }
+    void appendNode(int nodeId)
+    {
+        if (_slots.count(nodeId))
+            return;
+
+        const auto pose = Affine3f::Identity();
+        _slots.emplace(nodeId, int(_ids.size()));
+        _ids.push_back(nodeId);
+        _origins.push_back(pose.origin);
+        _quats.push_back(pose.quat);
+        _scales.push_back(pose.scale);
+        _matrices.push_back(pose.matrix());
+        _dirty.push_back(1);
+        _static.push_back(0);
+        ++_generation;
+        newLayout();
+    }
 
     /**
      * @brief Remove a state fora node
      *
+     * The last slot is moved in place of the removed one to keep arrays contiguous.
+     *
      * @param nodeId - unique node id
      */
-    void removeNode(int nodeId) { _poses.erase(nodeId); }
+    void removeNode(int nodeId)
+    {
+        auto it = _slots.find(nodeId);
+        if (it == _slots.end())
+            return;
+
+        const int slot = it->second;
+        const int last = int(_ids.size()) - 1;
+        if (_static[slot])
+            ++_staticGeneration;
+        if (slot != last) {
+            _ids[slot] = _ids[last];
+            _origins[slot] = _origins[last];
+            _quats[slot] = _quats[last];
+            _scales[slot] = _scales[last];
+            _matrices[slot] = _matrices[last];
+            _dirty[slot] = _dirty[last];
+            _static[slot] = _static[last];
+            _slots[_ids[slot]] = slot;
+        }
+        _ids.pop_back();
+        _origins.pop_back();
+        _quats.pop_back();
+        _scales.pop_back();
+        _matrices.pop_back();
+        _dirty.pop_back();
+        _static.pop_back();
+        _slots.erase(it);
+        ++_generation;
+        newLayout();
+    }
 
     /**
      * @brief Remove all states
      *
      */
-    void clear() { _poses.clear(); }
+    void clear()
+    {
+        _slots.clear();
+        _ids.clear();
+        _origins.clear();
+        _quats.clear();
+        _scales.clear();
+        _matrices.clear();
+        _dirty.clear();
+        _static.clear();
+        ++_generation;
+        ++_staticGeneration;
+        newLayout();
+    }
 
     /**
      * @brief Number of elements in state
      *
      * @return int
      */
-    int size() const { return _poses.size(); }
+    int size() const { return _ids.size(); }
+
+    /**
+     * @brief Node has a state
+     *
+     * @param nodeId - unique node id
+     */
+    bool hasNode(int nodeId) const { return _slots.count(nodeId) > 0; }
+
+    /**
+     * @brief Slot of a specific node in the contiguous arrays
+     *
+     * @param nodeId - unique node id
+     * @throw std::out_of_range - if no such element exists
+     */
+    int slot(int nodeId) const { return _slots.at(nodeId); }
 
-    const std::map<int, Affine3f>& poses() const { return _poses; }
+    /**
+     * @brief Node ids, one per slot
+     */
+    const std::vector<int>& ids() const { return _ids; }
+
+    /**
+     * @brief Node origins, one per slot
+     */
+    const std::vector<Vector3f>& origins() const { return _origins; }
+
+    /**
+     * @brief Node rotations (w, x, y, z), one per slot
+     */
+    const std::vector<Quaternionf>& quats() const { return _quats; }
+
+    /**
+     * @brief Node scales, one per slot
+     */
+    const std::vector<Vector3f>& scales() const { return _scales; }
+
+    /**
+     * @brief Node world matrices 4x4, one per slot
+     */
+    const std::vector<Matrix4f>& matrices() const { return _matrices; }
+
+    /**
+     * @brief Dirty flags, one per slot
+     *
+     * A flag is set when the node pose changed since the last clearDirty().
+     */
+    const std::vector<uint8_t>& dirty() const { return _dirty; }
+
+    /**
+     * @brief Ids of nodes with dirty poses
+     */
+    std::vector<int> dirtyIds() const
+    {
+        std::vector<int> ids;
+        for (int i = 0; i < int(_ids.size()); ++i)
+            if (_dirty[i])
+                ids.push_back(_ids[i]);
+        return ids;
+    }
+
+    /**
+     * @brief Force a node pose to be considered as changed
+     *
+     * @param nodeId - unique node id
+     * @throw std::out_of_range - if no such element exists
+     */
+    void markDirty(int nodeId) { _dirty[_slots.at(nodeId)] = 1; }
+
+    /**
+     * @brief Force all node poses to be considered as changed
+     */
+    void markAllDirty() { std::fill(_dirty.begin(), _dirty.end(), 1); }
+
+    /**
+     * @brief Mark all poses as synchronized with a renderer
+     */
+    void clearDirty() { std::fill(_dirty.begin(), _dirty.end(), 0); }
+
+    /**
+     * @brief Raise flags of poses that are dirty in \p other
+     *
+     * Used when a newer state supersedes an older one that never reached a renderer.
+     *
+     * @param other - older state
+     */
+    void mergeDirty(const SceneState& other)
+    {
+        for (int i = 0; i < int(other._ids.size()); ++i) {
+            if (!other._dirty[i])
+                continue;
+            const auto it = _slots.find(other._ids[i]);
+            if (it != _slots.end())
+                _dirty[it->second] = 1;
+        }
+    }
+
+    /**
+     * @brief Counter incremented each time any pose changes
+     */
+    uint64_t generation() const { return _generation; }
+
+    /**
+     * @brief Static flags, one per slot
+     */
+    const std::vector<uint8_t>& statics() const { return _static; }
+
+    /**
+     * @brief Node is classified as static
+     *
+     * @param nodeId - unique node id
+     * @throw std::out_of_range - if no such element exists
+     */
+    bool isStatic(int nodeId) const { return _static[_slots.at(nodeId)] != 0; }
+
+    /**
+     * @brief Classify a node as static or dynamic
+     *
+     * @param nodeId - unique node id
+     * @param value - node is not expected to move
+     * @throw std::out_of_range - if no such element exists
+     */
+    void setStatic(int nodeId, bool value)
+    {
+        auto& flag = _static[_slots.at(nodeId)];
+        if (flag == uint8_t(value))
+            return;
+        flag = uint8_t(value);
+        ++_staticGeneration;
+    }
+
+    /**
+     * @brief Counter incremented each time the set of static nodes changes
+     *
+     * Static nodes change when classified, removed, or when their pose changes: they are then
+     * dynamic again. Renderers merging static geometry rebuild it on a new value.
+     */
+    uint64_t staticGeneration() const { return _staticGeneration; }
 
     /**
      * @brief Pose for a specific node
      *
      * @param id - unique node id
      * @throw std::out_of_range - if no such element exists
-     * @return Affine3f&
+     * @return Affine3f
+     */
+    Affine3f pose(int nodeId) const
+    {
+        const int i = _slots.at(nodeId);
+        return Affine3f{_origins[i], _quats[i], _scales[i]};
+    }
+
+    /**
+     * @brief World matrix for a specific node
+     *
+     * @param id - unique node id
+     * @throw std::out_of_range - if no such element exists
+     * @return Matrix4f&
      */
-    const Affine3f& pose(int nodeId) const { return _poses.at(nodeId); }
+    const Matrix4f& matrix(int nodeId) const { return _matrices[_slots.at(nodeId)]; }
 
     /**
      * @brief Update pose for a specific node
      *
      * @param id - unique node id
      * @throw std::out_of_range - if no such element exists
+     * @return True if the pose changed
+     */
+    bool setPose(int nodeId, const Affine3f& pose)
+    {
+        return setSlotPose(_slots.at(nodeId), pose.origin, pose.quat, pose.scale);
+    }
+
+    /**
+     * @brief Save the poses of all nodes
+     *
+     * Copy-on-write: only the chunks of slots whose poses changed since the last snapshot or
+     * restore are copied, the others are shared with it.
+     *
+     * @return Snapshot, for restore()
+     */
+    std::shared_ptr<const Snapshot> snapshot()
+    {
+        const size_t numChunks = (_ids.size() + kSnapshotChunk - 1) / kSnapshotChunk;
+        _chunks.resize(numChunks);
+        _chunkChanged.resize(numChunks, 1);
+        if (!_snapshotIds)
+            _snapshotIds = std::make_shared<const std::vector<int>>(_ids);
+
+        for (size_t c = 0; c < numChunks; ++c) {
+            if (!_chunkChanged[c] && _chunks[c])
+                continue;
+            const size_t first = c * kSnapshotChunk;
+            const size_t last = std::min(first + kSnapshotChunk, _ids.size());
+            auto chunk = std::make_shared<Snapshot::Chunk>();
+            chunk->origins.assign(_origins.begin() + first, _origins.begin() + last);
+            chunk->quats.assign(_quats.begin() + first, _quats.begin() + last);
+            chunk->scales.assign(_scales.begin() + first, _scales.begin() + last);
+            _chunks[c] = std::move(chunk);
+            _chunkChanged[c] = 0;
+        }
+
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->_layout = _layout;
+        snapshot->_ids = _snapshotIds;
+        snapshot->_chunks = _chunks;
+        return snapshot;
+    }
+
+    /**
+     * @brief Set the poses saved by snapshot(), only the ones that differ change
+     *
+     * Chunks still shared with the snapshot are skipped, so that restoring costs the poses
+     * changed in between plus one check per chunk. After nodes were added or removed, the nodes
+     * of the snapshot still in the state are restored by id, the others keep their pose.
+     *
+     * @param snapshot - snapshot of this state or of a copy of it
      */
-    void setPose(int nodeId, const Affine3f& pose) { _poses.at(nodeId) = pose; }
+    void restore(const Snapshot& snapshot)
+    {
+        if (snapshot._layout == _layout && snapshot._ids->size() == _ids.size()) {
+            _chunks.resize(snapshot._chunks.size());
+            _chunkChanged.resize(snapshot._chunks.size(), 1);
+            for (size_t c = 0; c < snapshot._chunks.size(); ++c) {
+                const auto& chunk = snapshot._chunks[c];
+                if (!_chunkChanged[c] && _chunks[c] == chunk)
+                    continue;
+                // matrices of the chunk converted at once if any pose changed
+                const int first = int(c) * kSnapshotChunk;
+                const size_t size = chunk->origins.size();
+                bool changed = false;
+                for (int k = 0; k < int(size); ++k)
+                    changed = storeSlotPose(first + k, chunk->origins[k], chunk->quats[k],
+                                            chunk->scales[k]) ||
+                              changed;
+                if (changed)
+                    poseMatrices(&_origins[first], &_quats[first], &_scales[first], size,
+                                 &_matrices[first]);
+                _chunks[c] = chunk;
+                _chunkChanged[c] = 0;
+            }
+            return;
+        }
+
+        const auto& ids = *snapshot._ids;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            const auto it = _slots.find(ids[i]);
+            if (it == _slots.end())
+                continue;
+            const auto& chunk = *snapshot._chunks[i / kSnapshotChunk];
+            const size_t k = i % kSnapshotChunk;
+            setSlotPose(it->second, chunk.origins[k], chunk.quats[k], chunk.scales[k]);
+        }
+    }
 
     /**
      * @brief Comparison operators
+     *
+     * States are equal if they hold the same poses, whatever the slot order.
      */
-    bool operator==(const SceneState& other) const { return _poses == other._poses; }
+    bool operator==(const SceneState& other) const
+    {
+        if (_ids.size() != other._ids.size())
+            return false;
+
+        for (const auto& it : _slots) {
+            const auto jt = other._slots.find(it.first);
+            if (jt == other._slots.end())
+                return false;
+
+            const int i = it.second, j = jt->second;
+            if (_origins[i] != other._origins[j] || _quats[i] != other._quats[j] ||
+                _scales[i] != other._scales[j])
+                return false;
+        }
+        return true;
+    }
     bool operator!=(const SceneState& other) const { return !(*this == other); }
 
     /**
      * @brief Serialization
      */
     template <class Archive>
-    void serialize(Archive& ar)
+    void save(Archive& ar) const
     {
-        ar(_poses);
+        // one block per field, which buffer archives may keep out of band
+        saveBlock(ar, _ids);
+        saveBlock(ar, _origins);
+        saveBlock(ar, _quats);
+        saveBlock(ar, _scales);
+    }
+    /** @overload */
+    template <class Archive>
+    void load(Archive& ar)
+    {
+        loadBlock(ar, _ids);
+        loadBlock(ar, _origins);
+        loadBlock(ar, _quats);
+        loadBlock(ar, _scales);
+
+        _slots.clear();
+        _dirty.assign(_ids.size(), 1);
+        _static.assign(_ids.size(), 0);
+        ++_generation;
+        ++_staticGeneration;
+        newLayout();
+        for (int i = 0; i < int(_ids.size()); ++i)
+            _slots.emplace(_ids[i], i);
+        _matrices.resize(_ids.size());
+        poseMatrices(_origins.data(), _quats.data(), _scales.data(), _ids.size(), _matrices.data());
     }
 
   private:
-    std::map<int, Affine3f> _poses;
+    /// update the pose of a slot, see setPose()
+    bool setSlotPose(int i, const Vector3f& origin, const Quaternionf& quat, const Vector3f& scale)
+    {
+        if (!storeSlotPose(i, origin, quat, scale))
+            return false;
+        _matrices[i] = Affine3f{origin, quat, scale}.matrix();
+        return true;
+    }
+
+    /// update the pose of a slot but not its matrix, see poseMatrices()
+    bool storeSlotPose(int i, const Vector3f& origin, const Quaternionf& quat,
+                       const Vector3f& scale)
+    {
+        if (_origins[i] == origin && _quats[i] == quat && _scales[i] == scale)
+            return false;
+
+        _origins[i] = origin;
+        _quats[i] = quat;
+        _scales[i] = scale;
+        _dirty[i] = 1;
+        ++_generation;
+        if (_static[i]) {
+            // moved, no longer part of the merged geometry
+            _static[i] = 0;
+            ++_staticGeneration;
+        }
+        if (size_t(i / kSnapshotChunk) < _chunkChanged.size())
+            _chunkChanged[i / kSnapshotChunk] = 1;
+        return true;
+    }
+
+    /// nodes were added or removed, snapshots no longer match the slots
+    void newLayout()
+    {
+        ++_layout;
+        _chunks.clear();
+        _chunkChanged.clear();
+        _snapshotIds.reset();
+    }
+
+    std::map<int, int> _slots; //<- node id -> slot
+    std::vector<int> _ids;
+    std::vector<Vector3f> _origins;
+    std::vector<Quaternionf> _quats;
+    std::vector<Vector3f> _scales;
+    std::vector<Matrix4f> _matrices;
+    // synchronization state (not serialized)
+    std::vector<uint8_t> _dirty;
+    std::vector<uint8_t> _static;
+    uint64_t _generation = 0;
+    uint64_t _staticGeneration = 0;
+    // chunks of the last snapshot or restore, see snapshot()
+    uint64_t _layout = 0;
+    std::vector<std::shared_ptr<const Snapshot::Chunk>> _chunks;
+    std::vector<uint8_t> _chunkChanged; //<- poses of the chunk changed since
+    std::shared_ptr<const std::vector<int>> _snapshotIds;
 };
 
 } // namespace scene
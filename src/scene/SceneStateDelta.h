@@ -0,0 +1,251 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "SceneState.h"
+
+#include <utils/serialization.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Delta encoding of a stream of scene states, e.g. for a remote renderer
+ *
+ * Each delta holds what changed since the previously encoded state: removed nodes, then
+ * added nodes and changed pose fields. The layout is:
+ *  - a flags byte: keyframe, quantized,
+ *  - the base and new state generations as varints,
+ *  - the varint count of removed nodes, then their ids in increasing order,
+ *  - the varint count of updated nodes, then for each one its id, in increasing order, and a
+ *    field mask (origin, rotation, scale) sharing a varint, followed by the changed fields.
+ *
+ * Ids are written as a zigzag varint for the first one and differences to the previous one
+ * for the others. Fields are raw floats, so that the decoded state is equal to the encoded
+ * one, or with quantization half float origins and rotations packed on 48 bits with the
+ * smallest three method. Scales are always exact.
+ *
+ * Deltas must reach the decoder in order: after a lost delta, reset() makes the next one a
+ * keyframe, which holds the whole state.
+ */
+class SceneStateEncoder
+{
+  public:
+    /// delta flags
+    enum Flags : uint8_t {
+        kKeyframe = 1, //<- the state is rebuilt from scratch
+        kQuantized = 2, //<- origins and rotations are quantized
+    };
+
+    /// changed pose fields of an updated node
+    enum Fields : uint8_t {
+        kOrigin = 1,
+        kRotation = 2,
+        kScale = 4,
+    };
+
+    /**
+     * @brief Construct a new Scene State Encoder object
+     *
+     * @param quantize - quantize origins and rotations instead of round-tripping exactly
+     */
+    explicit SceneStateEncoder(bool quantize = false) : _quantize(quantize) {}
+
+    /// origins and rotations are quantized
+    bool quantize() const { return _quantize; }
+
+    /// generation of the last encoded state
+    uint64_t generation() const { return _generation; }
+
+    /// make the next delta a keyframe
+    void reset() { _keyframe = true; }
+
+    /**
+     * @brief Encode the changes of a state since the previously encoded one
+     *
+     * @param state - state to encode
+     * @param out - buffer the delta is appended to
+     */
+    void encode(const SceneState& state, std::vector<uint8_t>& out)
+    {
+        static const SceneState kEmpty;
+        const SceneState& base = _keyframe ? kEmpty : _base;
+
+        std::vector<int> removed;
+        for (int id : base.ids())
+            if (!state.hasNode(id))
+                removed.push_back(id);
+        std::sort(removed.begin(), removed.end());
+
+        // nodes added or with changed fields, added nodes start from the identity
+        std::vector<std::pair<int, int>> updated; //<- node id, fields
+        const Affine3f identity = Affine3f::Identity();
+        for (int i = 0; i < state.size(); ++i) {
+            const int id = state.ids()[i];
+            const bool added = !base.hasNode(id);
+            const Affine3f from = added ? identity : base.pose(id);
+            const int fields = (state.origins()[i] != from.origin ? kOrigin : 0) |
+                               (state.quats()[i] != from.quat ? kRotation : 0) |
+                               (state.scales()[i] != from.scale ? kScale : 0);
+            if (added || fields)
+                updated.emplace_back(id, fields);
+        }
+        std::sort(updated.begin(), updated.end());
+
+        out.push_back(uint8_t((_keyframe ? kKeyframe : 0) | (_quantize ? kQuantized : 0)));
+        writeVarint(out, _keyframe ? 0 : _generation);
+        writeVarint(out, state.generation());
+
+        writeVarint(out, removed.size());
+        for (size_t i = 0; i < removed.size(); ++i)
+            writeVarint(out, i == 0 ? zigzagEncode(removed[i])
+                                    : uint64_t(removed[i] - removed[i - 1]));
+
+        writeVarint(out, updated.size());
+        for (size_t i = 0; i < updated.size(); ++i) {
+            const int id = updated[i].first, fields = updated[i].second;
+            const uint64_t key = i == 0 ? zigzagEncode(id) : uint64_t(id - updated[i - 1].first);
+            writeVarint(out, (key << 3) | uint64_t(fields));
+
+            const int slot = state.slot(id);
+            if (fields & kOrigin) {
+                for (float value : state.origins()[slot]) {
+                    if (_quantize)
+                        writeRaw(out, floatToHalf(value));
+                    else
+                        writeRaw(out, value);
+                }
+            }
+            if (fields & kRotation) {
+                if (_quantize) {
+                    const uint64_t bits = packQuaternion(state.quats()[slot]);
+                    for (int shift = 0; shift < 48; shift += 8)
+                        out.push_back(uint8_t(bits >> shift));
+                }
+                else {
+                    writeRaw(out, state.quats()[slot]);
+                }
+            }
+            if (fields & kScale)
+                writeRaw(out, state.scales()[slot]);
+        }
+
+        _base = state;
+        _generation = state.generation();
+        _keyframe = false;
+    }
+
+  private:
+    bool _quantize;
+    bool _keyframe = true; //<- the next delta is a keyframe
+    SceneState _base; //<- previously encoded state, as given to encode()
+    uint64_t _generation = 0; //<- generation of _base
+};
+
+/**
+ * @brief Decoder of the deltas of a SceneStateEncoder
+ */
+class SceneStateDecoder
+{
+  public:
+    /// a keyframe was decoded since construction or the last error
+    bool synchronized() const { return _synchronized; }
+
+    /// encoder generation of the last decoded state
+    uint64_t generation() const { return _generation; }
+
+    /**
+     * @brief Apply a delta to the state the previous deltas were applied to
+     *
+     * Decoded nodes are marked dirty as their poses change, keyframes clear the state.
+     *
+     * @param data - delta bytes
+     * @param size - number of bytes
+     * @param state - decoded state
+     * @throw std::runtime_error - if the delta is corrupted or not based on the last decoded
+     *  state, the decoder then waits for a keyframe
+     */
+    void decode(const uint8_t* data, size_t size, SceneState& state)
+    {
+        const uint8_t* end = data + size;
+        uint8_t flags;
+        readRaw(data, end, flags);
+        const uint64_t baseGeneration = readVarint(data, end);
+        const uint64_t generation = readVarint(data, end);
+
+        const bool keyframe = flags & SceneStateEncoder::kKeyframe;
+        if (!keyframe && (!_synchronized || baseGeneration != _generation))
+            throw std::runtime_error("SceneStateDecoder: delta of another state generation");
+        _synchronized = false;
+        if (keyframe)
+            state.clear();
+
+        const bool quantized = flags & SceneStateEncoder::kQuantized;
+        int id = 0;
+        for (uint64_t i = 0, count = readVarint(data, end); i < count; ++i) {
+            const uint64_t key = readVarint(data, end);
+            id = i == 0 ? int(zigzagDecode(key)) : id + int(key);
+            state.removeNode(id);
+        }
+        for (uint64_t i = 0, count = readVarint(data, end); i < count; ++i) {
+            const uint64_t key = readVarint(data, end);
+            id = i == 0 ? int(zigzagDecode(key >> 3)) : id + int(key >> 3);
+            const int fields = int(key & 7);
+
+            state.appendNode(id);
+            Affine3f pose = state.pose(id);
+            if (fields & SceneStateEncoder::kOrigin) {
+                for (float& value : pose.origin) {
+                    if (quantized) {
+                        uint16_t half;
+                        readRaw(data, end, half);
+                        value = halfToFloat(half);
+                    }
+                    else {
+                        readRaw(data, end, value);
+                    }
+                }
+            }
+            if (fields & SceneStateEncoder::kRotation) {
+                if (quantized) {
+                    uint8_t bytes[6];
+                    readRaw(data, end, bytes);
+                    uint64_t bits = 0;
+                    for (int k = 5; k >= 0; --k)
+                        bits = (bits << 8) | bytes[k];
+                    pose.quat = unpackQuaternion(bits);
+                }
+                else {
+                    readRaw(data, end, pose.quat);
+                }
+            }
+            if (fields & SceneStateEncoder::kScale)
+                readRaw(data, end, pose.scale);
+            state.setPose(id, pose);
+        }
+        if (data != end)
+            throw std::runtime_error("SceneStateDecoder: trailing bytes");
+
+        _generation = generation;
+        _synchronized = true;
+    }
+
+    /** @overload */
+    void decode(const std::vector<uint8_t>& delta, SceneState& state)
+    {
+        decode(delta.data(), delta.size(), state);
+    }
+
+  private:
+    bool _synchronized = false;
+    uint64_t _generation = 0;
+};
+
+} // namespace scene
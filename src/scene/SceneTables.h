@@ -0,0 +1,182 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "SceneGraph.h"
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief Row of SceneTables::nodes()
+ */
+struct NodeRecord {
+    int32_t uid;
+    int32_t body;
+    int32_t link;
+    int32_t firstShape; //<- index of the first shape of the node in SceneTables::shapes()
+    int32_t numShapes;
+};
+
+/**
+ * @brief Row of SceneTables::shapes()
+ */
+struct ShapeRecord {
+    int32_t node; //<- index of the node in SceneTables::nodes()
+    int32_t type; //<- ShapeType
+    float dimensions[3];
+    float matrix[16];    //<- local pose, column-major
+    int32_t mesh;        //<- index in SceneTables::meshes(), -1 if none
+    int32_t heightfield; //<- index in SceneTables::heightfields(), -1 if none
+    int32_t material;    //<- index in SceneTables::materials(), -1 if none
+};
+
+/**
+ * @brief Row of SceneTables::materials()
+ */
+struct MaterialRecord {
+    float diffuseColor[4];
+    float specularColor[3];
+    int32_t texture; //<- index in SceneTables::textures(), -1 if none
+};
+
+/**
+ * @brief Flat tables of the nodes, shapes and materials of a scene
+ *
+ * Lets a backend walk a scene with vectorized code rather than object by object: shapes of a
+ * node are consecutive, nodes follow the order of the scene graph, and meshes, heightfields,
+ * materials and textures shared by several rows are listed once, in order of first use. The
+ * tables are rebuilt only when the scene changes.
+ */
+class SceneTables
+{
+  public:
+    /**
+     * @brief Synchronize with a scene
+     *
+     * @param sceneGraph - scene description
+     * @return True if the tables were rebuilt
+     */
+    bool update(const SceneGraph& sceneGraph)
+    {
+        if (&sceneGraph == _source && sceneGraph.generation() == _generation)
+            return false;
+        rebuild(sceneGraph);
+        return true;
+    }
+
+    /**
+     * @brief Force a rebuild at the next update
+     */
+    void invalidate() { _source = nullptr; }
+
+    /**
+     * @brief One row per node
+     */
+    const std::vector<NodeRecord>& nodes() const { return _nodes; }
+
+    /**
+     * @brief One row per shape
+     */
+    const std::vector<ShapeRecord>& shapes() const { return _shapes; }
+
+    /**
+     * @brief One row per distinct material
+     */
+    const std::vector<MaterialRecord>& materials() const { return _materials; }
+
+    /**
+     * @brief Distinct meshes of the shapes
+     */
+    const std::vector<std::shared_ptr<Mesh>>& meshes() const { return _meshes; }
+
+    /**
+     * @brief Distinct heightfields of the shapes
+     */
+    const std::vector<std::shared_ptr<Heightfield>>& heightfields() const
+    {
+        return _heightfields;
+    }
+
+    /**
+     * @brief Distinct textures of the materials
+     */
+    const std::vector<std::shared_ptr<Texture>>& textures() const { return _textures; }
+
+  private:
+    /// index of \p object in \p list, appended on first use, -1 for null
+    template <class T>
+    static int32_t indexOf(const std::shared_ptr<T>& object, std::vector<std::shared_ptr<T>>& list,
+                           std::unordered_map<const void*, int32_t>& indices)
+    {
+        if (!object)
+            return -1;
+        const auto it = indices.emplace(object.get(), int32_t(list.size()));
+        if (it.second)
+            list.push_back(object);
+        return it.first->second;
+    }
+
+    void rebuild(const SceneGraph& sceneGraph)
+    {
+        _nodes.clear();
+        _shapes.clear();
+        _materials.clear();
+        _meshes.clear();
+        _heightfields.clear();
+        _textures.clear();
+        std::unordered_map<const void*, int32_t> meshes, heightfields, textures, materials;
+        std::vector<std::shared_ptr<Material>> materialList;
+
+        _nodes.reserve(sceneGraph.nodes().size());
+        for (const auto& it : sceneGraph.nodes()) {
+            const auto& node = it.second;
+            const int32_t nodeIndex = int32_t(_nodes.size());
+            _nodes.push_back({it.first, node.body(), node.link(), int32_t(_shapes.size()),
+                              int32_t(node.shapes().size())});
+            for (const auto& shape : node.shapes()) {
+                ShapeRecord record;
+                record.node = nodeIndex;
+                record.type = int32_t(shape.type());
+                std::memcpy(record.dimensions, shape.extents().data(), sizeof(record.dimensions));
+                std::memcpy(record.matrix, shape.pose().matrix().data(), sizeof(record.matrix));
+                record.mesh = indexOf(shape.mesh(), _meshes, meshes);
+                record.heightfield = indexOf(shape.heightfield(), _heightfields, heightfields);
+                record.material = indexOf(shape.material(), materialList, materials);
+                _shapes.push_back(record);
+            }
+        }
+
+        _materials.reserve(materialList.size());
+        for (const auto& material : materialList) {
+            MaterialRecord record;
+            std::memcpy(record.diffuseColor, material->diffuseColor().data(),
+                        sizeof(record.diffuseColor));
+            std::memcpy(record.specularColor, material->specularColor().data(),
+                        sizeof(record.specularColor));
+            record.texture = indexOf(material->diffuseTexture(), _textures, textures);
+            _materials.push_back(record);
+        }
+
+        _source = &sceneGraph;
+        _generation = sceneGraph.generation();
+    }
+
+    std::vector<NodeRecord> _nodes;
+    std::vector<ShapeRecord> _shapes;
+    std::vector<MaterialRecord> _materials;
+    std::vector<std::shared_ptr<Mesh>> _meshes;
+    std::vector<std::shared_ptr<Heightfield>> _heightfields;
+    std::vector<std::shared_ptr<Texture>> _textures;
+    // scene the tables were built from
+    const void* _source = nullptr;
+    uint64_t _generation = 0;
+};
+
+} // namespace scene
@@ -6,11 +6,197 @@
 
 #include <utils/math.h>
 
+#include "Bounds.h"
 #include "Camera.h"
 #include "Light.h"
+#include "Material.h"
+#include "Panorama.h"
+#include "SceneState.h"
+#include "VisibilityLayers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
 
 namespace scene {
 
+/// views of a multiview frame, that of the camera included, see SceneView::multiviewCameras()
+constexpr int kMaxViews = 8;
+
+/**
+ * @brief Output image channels, combined into a bitmask
+ *
+ */
+enum class OutputChannel
+{
+    Color = 1 << 0,
+    Depth = 1 << 1,
+    Mask = 1 << 2,
+    Points = 1 << 3, //<- XYZ of each pixel, see SceneView::pointFrame()
+    Motion = 1 << 4, //<- pixel motion since the previous frame, see SceneView::previousState()
+    Normals = 1 << 5, //<- unit surface normal of each pixel in the camera frame, facing it
+    DepthPyramid = 1 << 6, //<- depth bounds of pixel blocks, see SceneView::depthPyramidLevels()
+    Events = 1 << 7, //<- brightness changes since the previous frame, see SceneView::eventTime()
+    Visibility = 1 << 8, //<- pixels covered by each segmentation id, see render::FrameData
+    Boxes = 1 << 9, //<- image bounds of each segmentation id seen, along with Visibility
+    Keypoints = 1 << 10, //<- image positions of the points of SceneView::keypoints()
+};
+
+/**
+ * @brief Frame of the points of the Points channel
+ */
+enum class PointFrame
+{
+    Camera, //<- camera frame, looking along -z with y up
+    World,
+};
+
+/**
+ * @brief Pixel format of color images
+ */
+enum class ColorFormat
+{
+    RGBA, //<- 4 bytes per pixel
+    RGB, //<- 3 bytes per pixel, without alpha
+};
+
+/**
+ * @brief Pixel format of depth images, of metric depth, zero where nothing was drawn
+ */
+enum class DepthFormat
+{
+    Float32,
+    Float16, //<- half floats
+    UInt16, //<- depth times SceneView::depthScale(), rounded and clamped, e.g. millimeters
+};
+
+/**
+ * @brief Pixel format of segmentation masks
+ */
+enum class MaskFormat
+{
+    Int32, //<- Node::segmentation() values, -1 where nothing was drawn
+    UInt16, //<- low 16 bits of those, the body unique id, 0xFFFF where nothing was drawn
+};
+
+/**
+ * @brief Filtering of material textures
+ */
+enum class TextureFilter
+{
+    Nearest,
+    Bilinear, //<- of the full resolution level, without mipmaps
+    Trilinear, //<- between mipmap levels
+};
+
+/**
+ * @brief Quality tier of a view, its features honored by renderers supporting them
+ *
+ * Renderers keep the pipeline states of each tier drawn, switching tiers between views is cheap.
+ */
+struct Quality
+{
+    int multisamples = -1; //<- MSAA samples per pixel, 0 for none, -1 for the renderer default
+    bool shadows = true; //<- shadows of shadow casting lights
+    bool specular = true; //<- specular highlights
+    TextureFilter textureFilter = TextureFilter::Trilinear;
+
+    /**
+     * @brief Renderer defaults
+     */
+    static Quality High() { return Quality(); }
+
+    /**
+     * @brief No multisampling, shadows or specular highlights, nearest texels
+     */
+    static Quality Fast() { return {0, false, false, TextureFilter::Nearest}; }
+
+    bool operator==(const Quality& other) const
+    {
+        return multisamples == other.multisamples && shadows == other.shadows &&
+               specular == other.specular && textureFilter == other.textureFilter;
+    }
+    bool operator!=(const Quality& other) const { return !(*this == other); }
+
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(multisamples, shadows, specular, textureFilter);
+    }
+};
+
+/**
+ * @brief Noise models of the sensor of a view, applied to its images after each frame
+ *
+ * Depth follows a structured light sensor: disparities of a stereo baseline quantized to
+ * subpixel steps, Gaussian axial noise growing with the square of the depth and dropouts at
+ * depth edges. Colors get vignetting, white balance gains, then shot noise growing with the
+ * square root of the intensity and read noise. Noise is drawn from the seed and the frame index,
+ * frames of the same seed and index are noised alike. All models are off by default.
+ */
+struct SensorNoise
+{
+    float baseline = 0.f; //<- stereo baseline in meters of quantized disparities, 0 for none
+    float subpixel = 0.125f; //<- disparity step in pixels
+    float axialSigma = 0.f; //<- standard deviation of the depth in meters at 1 meter
+    float edgeDropout = 0.f; //<- probability of a pixel at a depth edge to read no depth
+    float edgeThreshold = 0.05f; //<- depth difference in meters with a neighbor at an edge
+    float vignetting = 0.f; //<- intensity lost at the image corners, falling off quadratically
+    Color3f whiteBalance = {1.f, 1.f, 1.f}; //<- gains of the red, green and blue channels
+    float shotNoise = 0.f; //<- standard deviation over the square root of 8-bit intensities
+    float readNoise = 0.f; //<- standard deviation in 8-bit levels
+    uint32_t seed = 0;
+
+    /**
+     * @brief A depth model is on
+     */
+    bool depthEnabled() const { return baseline > 0.f || axialSigma > 0.f || edgeDropout > 0.f; }
+
+    /**
+     * @brief A color model is on
+     */
+    bool colorEnabled() const
+    {
+        return vignetting != 0.f || shotNoise > 0.f || readNoise > 0.f ||
+               whiteBalance != Color3f{1.f, 1.f, 1.f};
+    }
+
+    /**
+     * @brief Any model is on
+     */
+    bool enabled() const { return depthEnabled() || colorEnabled(); }
+
+    bool operator==(const SensorNoise& other) const
+    {
+        return baseline == other.baseline && subpixel == other.subpixel &&
+               axialSigma == other.axialSigma && edgeDropout == other.edgeDropout &&
+               edgeThreshold == other.edgeThreshold && vignetting == other.vignetting &&
+               whiteBalance == other.whiteBalance && shotNoise == other.shotNoise &&
+               readNoise == other.readNoise && seed == other.seed;
+    }
+    bool operator!=(const SensorNoise& other) const { return !(*this == other); }
+
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(baseline, subpixel, axialSigma, edgeDropout, edgeThreshold, vignetting, whiteBalance,
+           shotNoise, readNoise, seed);
+    }
+};
+
+/**
+ * @brief Materials drawn instead of those of the scene, by node id and shape index
+ */
+using MaterialOverrides = std::map<std::pair<int, int>, std::shared_ptr<Material>>;
+
+/**
+ * @brief Points projected by the Keypoints channel, by node id and position in the node frame
+ */
+using Keypoints = std::vector<std::pair<int, Vector3f>>;
+
 /**
  * @brief View configuration
  *
@@ -25,7 +211,15 @@ class SceneView
      * @brief Construct a new empty SceneView object
      *
      */
-    SceneView() noexcept : _flags(0), _bg_texture(-1){};
+    SceneView() noexcept
+        : _flags(0), _bg_texture(-1),
+          _channels(int(OutputChannel::Color) | int(OutputChannel::Depth) |
+                    int(OutputChannel::Mask)),
+          _projection(Projection::Perspective), _pointFrame(PointFrame::Camera),
+          _compactPoints(false), _roi({0, 0, 0, 0}), _colorFormat(ColorFormat::RGBA),
+          _depthFormat(DepthFormat::Float32), _maskFormat(MaskFormat::Int32),
+          _depthScale(1000.f), _renderScale(1.f), _depthPyramidLevels(3),
+          _eventThreshold(0.2f), _eventTime(0.0){};
 
     /**
      * @brief Flags
@@ -55,6 +249,39 @@ class SceneView
     /** @overload */
     void setViewport(const Size2i& s) { _viewport = s; }
 
+    /**
+     * @brief Region of interest of the viewport, x, y of its top-left pixel, width and height
+     *
+     * Images then hold the pixels of the region only, drawn by imageCamera() at imageSize().
+     * Regions of zero size are ignored, as are those of panoramic and multiview views.
+     */
+    const Vector4i& roi() const { return _roi; }
+    /** @overload */
+    void setRoi(const Vector4i& roi) { _roi = roi; }
+    /** @overload */
+    bool hasRoi() const
+    {
+        return _roi[2] > 0 && _roi[3] > 0 && _projection == Projection::Perspective &&
+               _multiviewCameras.empty();
+    }
+
+    /**
+     * @brief Size of the images, that of the region of interest if any, the viewport otherwise
+     */
+    Size2i imageSize() const { return hasRoi() ? Size2i{_roi[2], _roi[3]} : _viewport; }
+
+    /**
+     * @brief Camera drawing the images, whose projection is restricted to the region of interest
+     * if any, the camera of the view otherwise, which must be set
+     */
+    Camera imageCamera() const
+    {
+        Camera camera = *_camera;
+        if (hasRoi())
+            camera.setProjMatrix(cropProjection(_camera->projMatrix(), _viewport, _roi));
+        return camera;
+    }
+
     /**
      * @brief Camera parameters
      */
@@ -62,6 +289,100 @@ class SceneView
     /** @overload */
     void setCamera(const std::shared_ptr<Camera>& camera) { _camera = camera; }
 
+    /**
+     * @brief Cameras of the views drawn after that of camera() in a multiview frame, e.g. the
+     * other eye of a stereo rig
+     *
+     * Multiview frames stack the images of each view top to bottom, that of camera() first,
+     * rows being viewCount() times those of an image; renderers supporting it draw them in a
+     * single pass, culled once against the union of their frustums. They hold the Color, Depth
+     * and Mask channels, in any format, and ignore the region of interest, render scale and lens
+     * distortion. Perspective views only, cameras past kMaxViews views are ignored.
+     */
+    const std::vector<std::shared_ptr<Camera>>& multiviewCameras() const
+    {
+        return _multiviewCameras;
+    }
+    /** @overload */
+    void setMultiviewCameras(const std::vector<std::shared_ptr<Camera>>& cameras)
+    {
+        _multiviewCameras = cameras;
+    }
+    /** @overload */
+    int viewCount() const
+    {
+        if (_projection != Projection::Perspective)
+            return 1;
+        return std::min(1 + int(_multiviewCameras.size()), kMaxViews);
+    }
+    /** @overload */
+    bool hasMultiview() const { return viewCount() > 1; }
+
+    /**
+     * @brief Camera of view \p index of a multiview frame, imageCamera() for the first one
+     */
+    Camera viewCamera(int index) const
+    {
+        return index > 0 ? *_multiviewCameras[index - 1] : imageCamera();
+    }
+
+    /**
+     * @brief Frustum of the images of all the views, that of the first one pushed out over the
+     * corners of the others, to cull nodes once for a multiview frame
+     *
+     * Views of cameras without perspective intrinsics cull nothing.
+     */
+    Frustum multiviewFrustum() const
+    {
+        const Camera first = viewCamera(0);
+        Frustum frustum(multiply(first.projMatrix(), first.viewMatrix()));
+        for (int i = 1; i < viewCount(); ++i) {
+            const Camera& camera = *_multiviewCameras[i - 1];
+            if (!camera.hasIntrinsics())
+                return Frustum(Matrix4f{});
+            // corners on the clipping planes, in the camera frame looking along -z
+            const auto& p = camera.projMatrix();
+            for (const float d : {camera.znear(), camera.zfar()})
+                for (const float y : {-1.f, 1.f})
+                    for (const float x : {-1.f, 1.f})
+                        frustum.enclose(transformPoint(
+                            camera.poseMatrix(),
+                            {d * (x + p[8]) / p[0], d * (y + p[9]) / p[5], -d}));
+        }
+        return frustum;
+    }
+
+    /**
+     * @brief Camera of the previous frame, null for the camera of the view, see previousState()
+     */
+    const std::shared_ptr<Camera>& previousCamera() const { return _previousCamera; }
+    /** @overload */
+    void setPreviousCamera(const std::shared_ptr<Camera>& camera) { _previousCamera = camera; }
+
+    /**
+     * @brief Camera of the previous frame restricted to the region of interest, as imageCamera()
+     */
+    Camera previousImageCamera() const
+    {
+        Camera camera = _previousCamera ? *_previousCamera : *_camera;
+        if (hasRoi())
+            camera.setProjMatrix(cropProjection(camera.projMatrix(), _viewport, _roi));
+        return camera;
+    }
+
+    /**
+     * @brief Poses of the previous frame, null for the current ones
+     *
+     * The Motion channel holds the motion of each pixel since then, in pixels, x to the right
+     * and y down the rows: its position minus that of the same surface point in the previous
+     * frame, drawn by previousImageCamera() at the previous poses of its node. Zero where nothing
+     * was drawn and for panoramic views. The state is not modified once set, views compare it
+     * by pointer.
+     */
+    const std::shared_ptr<SceneState>& previousState() const { return _previousState; }
+    /** @overload */
+    void setPreviousState(const std::shared_ptr<SceneState>& state) { _previousState = state; }
+
     /**
      * @brief Light parameters
      */
@@ -69,6 +390,247 @@ class SceneView
     /** @overload */
     void setLight(const std::shared_ptr<Light>& light) { _light = light; }
 
+    /**
+     * @brief Point and spot lights added to light()
+     *
+     * Lit with clustered forward shading by the native backend: the view is split into screen
+     * tiles and depth slices, each listing the bounded lights reaching it, so that the cost of a
+     * pixel grows with the lights nearby rather than with all those of the scene. Lights of other
+     * types are skipped, those without a range light every pixel. Local lights cast no shadows.
+     */
+    const std::vector<Light>& lights() const { return _lights; }
+    /** @overload */
+    void setLights(const std::vector<Light>& lights) { _lights = lights; }
+
+    /**
+     * @brief Projector of the diffuse textures, null to map them by the uvs of the shapes
+     *
+     * Textured shapes sample their texture at the projection of their surface through the view
+     * and projection matrices of the projector, as pybullet's ER_USE_PROJECTIVE_TEXTURE does,
+     * and keep their diffuse color outside of its frustum.
+     */
+    const std::shared_ptr<Camera>& projectiveTexture() const { return _projectiveTexture; }
+    /** @overload */
+    void setProjectiveTexture(const std::shared_ptr<Camera>& projector)
+    {
+        _projectiveTexture = projector;
+    }
+
+    /**
+     * @brief Bitmask of OutputChannel to render, others are not requested
+     */
+    int outputChannels() const { return _channels; }
+    /** @overload */
+    void setOutputChannels(int channels) { _channels = channels; }
+    /** @overload */
+    bool hasOutputChannel(OutputChannel channel) const { return _channels & int(channel); }
+
+    /**
+     * @brief Perspective or panoramic projection, see Projection
+     *
+     * Panoramic views only take the clipping distances from the camera projection matrix.
+     */
+    Projection projection() const { return _projection; }
+    /** @overload */
+    void setProjection(Projection projection) { _projection = projection; }
+
+    /**
+     * @brief Frame of the points of the Points channel
+     */
+    PointFrame pointFrame() const { return _pointFrame; }
+    /** @overload */
+    void setPointFrame(PointFrame frame) { _pointFrame = frame; }
+
+    /**
+     * @brief Points of the Points channel packed at the front of the buffer, those of pixels
+     * where something was drawn only, with their segmentation ids, instead of one per pixel
+     */
+    bool compactPoints() const { return _compactPoints; }
+    /** @overload */
+    void setCompactPoints(bool compact) { _compactPoints = compact; }
+
+    /**
+     * @brief Levels of the DepthPyramid channel, 1 to 16, the first of half the image size
+     *
+     * Each texel of a level holds the nearest and the farthest depth of the pixels under it,
+     * those where nothing was drawn being infinitely far, see render::depthLevelOffset().
+     */
+    int depthPyramidLevels() const { return _depthPyramidLevels; }
+    /** @overload */
+    void setDepthPyramidLevels(int levels)
+    {
+        _depthPyramidLevels = std::min(std::max(levels, 1), 16);
+    }
+
+    /**
+     * @brief Contrast threshold of the Events channel, change of log luminance firing an event
+     *
+     * Pixels fire an event each time their log luminance, log(1 + Y) of the 8-bit luma of the
+     * color image, moves by the threshold away from the level of their previous event, see
+     * render::EventCamera. Thresholds not above 0 are raised to 0.01.
+     */
+    float eventThreshold() const { return _eventThreshold; }
+    /** @overload */
+    void setEventThreshold(float threshold) { _eventThreshold = std::max(threshold, 0.01f); }
+
+    /**
+     * @brief Time of the frame in seconds, events being spread between the previous frame of
+     * the camera and this one
+     */
+    double eventTime() const { return _eventTime; }
+    /** @overload */
+    void setEventTime(double time) { _eventTime = time; }
+
+    /**
+     * @brief Formats of the images, reduced ones packed by the renderer or by packFrame()
+     */
+    ColorFormat colorFormat() const { return _colorFormat; }
+    /** @overload */
+    void setColorFormat(ColorFormat format) { _colorFormat = format; }
+    /** @overload */
+    DepthFormat depthFormat() const { return _depthFormat; }
+    /** @overload */
+    void setDepthFormat(DepthFormat format) { _depthFormat = format; }
+    /** @overload */
+    MaskFormat maskFormat() const { return _maskFormat; }
+    /** @overload */
+    void setMaskFormat(MaskFormat format) { _maskFormat = format; }
+
+    /**
+     * @brief Units per meter of DepthFormat::UInt16 depth, 1000 for millimeters
+     */
+    float depthScale() const { return _depthScale; }
+    /** @overload */
+    void setDepthScale(float scale) { _depthScale = scale; }
+
+    /**
+     * @brief Quality tier the view is drawn at
+     */
+    const Quality& quality() const { return _quality; }
+    /** @overload */
+    void setQuality(const Quality& quality) { _quality = quality; }
+
+    /**
+     * @brief Noise models of the sensor applied to the color and depth images, see
+     * render::applySensorNoise()
+     */
+    const SensorNoise& sensorNoise() const { return _sensorNoise; }
+    /** @overload */
+    void setSensorNoise(const SensorNoise& noise) { _sensorNoise = noise; }
+
+    /**
+     * @brief Scale of the internal resolution of images, drawn at renderSize() and resampled to
+     * imageSize(), e.g. 4 to supersample small images or 0.5 to upsample cheap large ones
+     *
+     * Colors are box filtered when downsampled and bilinear when upsampled, depth and masks
+     * take those of the nearest surface drawn under each pixel so that they keep drawn values.
+     * Panoramic views ignore the scale, as do scales not above 0.
+     */
+    float renderScale() const { return _renderScale; }
+    /** @overload */
+    void setRenderScale(float scale) { _renderScale = scale; }
+    /** @overload */
+    bool hasRenderScale() const
+    {
+        return _renderScale > 0.f && _renderScale != 1.f &&
+               _projection == Projection::Perspective && _multiviewCameras.empty();
+    }
+
+    /**
+     * @brief Internal resolution of images of \p size, at least one pixel a side
+     */
+    Size2i renderSize(const Size2i& size) const
+    {
+        if (!hasRenderScale())
+            return size;
+        return {std::max(1, int(std::lround(size[0] * _renderScale))),
+                std::max(1, int(std::lround(size[1] * _renderScale)))};
+    }
+
+    /**
+     * @brief The lens of the camera distorts the images, of perspective views only
+     *
+     * Renderers draw pinhole images covering the rays of the pixels and remap them, see
+     * render::LensMap; with a render scale the pinhole images are drawn at their density times
+     * the scale.
+     */
+    bool hasLensDistortion() const
+    {
+        return _camera && _camera->distortion().enabled() &&
+               _projection == Projection::Perspective && _multiviewCameras.empty();
+    }
+
+    /**
+     * @brief Materials of some shapes replaced in this view only, e.g. randomized ones
+     *
+     * Overrides are not modified once set, views compare them by pointer.
+     */
+    const std::shared_ptr<MaterialOverrides>& materialOverrides() const
+    {
+        return _materialOverrides;
+    }
+    /** @overload */
+    void setMaterialOverrides(const std::shared_ptr<MaterialOverrides>& overrides)
+    {
+        _materialOverrides = overrides;
+    }
+
+    /**
+     * @brief Visibility layers of the nodes and shapes, null if all are in all layers, see
+     * SceneGraph::visibilityLayers()
+     *
+     * Layers are not modified once set, views compare them by pointer.
+     */
+    const std::shared_ptr<VisibilityLayers>& visibilityLayers() const
+    {
+        return _visibilityLayers;
+    }
+    /** @overload */
+    void setVisibilityLayers(const std::shared_ptr<VisibilityLayers>& layers)
+    {
+        _visibilityLayers = layers;
+    }
+
+    /**
+     * @brief Layers the cameras of the view see, VisibilityLayers::kAll by default
+     *
+     * Shapes of no such layer are not drawn into the images of the view. They still cast
+     * shadows, the light sees every layer.
+     */
+    uint32_t cameraLayers() const { return _cameraLayers; }
+    /** @overload */
+    void setCameraLayers(uint32_t layers) { _cameraLayers = layers & VisibilityLayers::kAll; }
+
+    /**
+     * @brief Some nodes or shapes are in none of the layers of the cameras
+     */
+    bool filtersLayers() const
+    {
+        return _visibilityLayers && _cameraLayers != VisibilityLayers::kAll;
+    }
+
+    /**
+     * @brief A shape is drawn by the cameras of the view
+     *
+     * @param nodeId - node id
+     * @param shapeIndex - shape index inside the node, -1 for the node as a whole
+     */
+    bool visible(int nodeId, int shapeIndex) const
+    {
+        return !_visibilityLayers ||
+               (_visibilityLayers->layers(nodeId, shapeIndex) & _cameraLayers) != 0;
+    }
+
+    /**
+     * @brief Points of nodes whose image position the Keypoints channel holds, see
+     * render::projectKeypoints()
+     *
+     * Keypoints are not modified once set, views compare them by pointer.
+     */
+    const std::shared_ptr<Keypoints>& keypoints() const { return _keypoints; }
+    /** @overload */
+    void setKeypoints(const std::shared_ptr<Keypoints>& keypoints) { _keypoints = keypoints; }
+
     /**
      * @brief Comparison operators
      */
@@ -76,9 +638,33 @@ class SceneView
     {
         return _viewport == other._viewport && _bg_color == other._bg_color &&
                _bg_texture == other._bg_texture && _flags == other._flags &&
+               _channels == other._channels && _projection == other._projection &&
+               _pointFrame == other._pointFrame && _compactPoints == other._compactPoints &&
+               _roi == other._roi && _colorFormat == other._colorFormat &&
+               _depthFormat == other._depthFormat && _maskFormat == other._maskFormat &&
+               _depthScale == other._depthScale && _quality == other._quality &&
+               _sensorNoise == other._sensorNoise && _renderScale == other._renderScale &&
+               _depthPyramidLevels == other._depthPyramidLevels &&
+               _eventThreshold == other._eventThreshold && _eventTime == other._eventTime &&
+               _materialOverrides == other._materialOverrides &&
+               _visibilityLayers == other._visibilityLayers &&
+               _cameraLayers == other._cameraLayers && _keypoints == other._keypoints &&
+               _previousState == other._previousState &&
                (_camera == other._camera ||
                 _camera && other._camera && *_camera == *other._camera) &&
-               (_light == other._light || _light && other._light && *_light == *other._light);
+               std::equal(_multiviewCameras.begin(), _multiviewCameras.end(),
+                          other._multiviewCameras.begin(), other._multiviewCameras.end(),
+                          [](const std::shared_ptr<Camera>& a, const std::shared_ptr<Camera>& b) {
+                              return a == b || a && b && *a == *b;
+                          }) &&
+               (_previousCamera == other._previousCamera ||
+                _previousCamera && other._previousCamera &&
+                    *_previousCamera == *other._previousCamera) &&
+               (_light == other._light || _light && other._light && *_light == *other._light) &&
+               _lights == other._lights &&
+               (_projectiveTexture == other._projectiveTexture ||
+                _projectiveTexture && other._projectiveTexture &&
+                    *_projectiveTexture == *other._projectiveTexture);
     }
     bool operator!=(const SceneView& other) const { return !(*this == other); }
 
@@ -88,7 +674,11 @@ class SceneView
     template <class Archive>
     void serialize(Archive& ar)
     {
-        ar(_viewport, _bg_color, _bg_texture, _flags, _camera, _light);
+        ar(_viewport, _bg_color, _bg_texture, _flags, _channels, _projection, _pointFrame,
+           _compactPoints, _roi, _colorFormat, _depthFormat, _maskFormat, _depthScale, _quality,
+           _renderScale, _depthPyramidLevels, _camera, _previousCamera, _previousState, _light,
+           _materialOverrides, _projectiveTexture, _sensorNoise, _multiviewCameras, _lights,
+           _eventThreshold, _eventTime, _keypoints, _visibilityLayers, _cameraLayers);
     }
 
   private:
@@ -96,9 +686,32 @@ class SceneView
     Color3f _bg_color;
     int _bg_texture;
     int _flags;
+    int _channels;
+    Projection _projection;
+    PointFrame _pointFrame;
+    bool _compactPoints;
+    Vector4i _roi;
+    ColorFormat _colorFormat;
+    DepthFormat _depthFormat;
+    MaskFormat _maskFormat;
+    float _depthScale;
+    Quality _quality;
+    SensorNoise _sensorNoise;
+    float _renderScale;
+    int _depthPyramidLevels;
+    float _eventThreshold;
+    double _eventTime;
     std::shared_ptr<Camera> _camera;
+    std::vector<std::shared_ptr<Camera>> _multiviewCameras;
+    std::shared_ptr<Camera> _previousCamera;
+    std::shared_ptr<SceneState> _previousState;
     std::shared_ptr<Light> _light;
-    /** @todo: projective texture matrices */
+    std::vector<Light> _lights;
+    std::shared_ptr<MaterialOverrides> _materialOverrides;
+    std::shared_ptr<VisibilityLayers> _visibilityLayers;
+    uint32_t _cameraLayers = VisibilityLayers::kAll;
+    std::shared_ptr<Keypoints> _keypoints;
+    std::shared_ptr<Camera> _projectiveTexture;
 };
 
 } // namespace scene
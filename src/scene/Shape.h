@@ -6,6 +6,7 @@
 
 #include <utils/math.h>
 
+#include "Heightfield.h"
 #include "Material.h"
 #include "Mesh.h"
 
@@ -51,6 +52,20 @@ class Shape
     Shape(ShapeType type, const Affine3f& pose, const std::shared_ptr<Mesh>& mesh, const std::shared_ptr<Material>& material)
         : _type(type), _pose(pose), _dimensions{}, _mesh(mesh), _material(material)
     {
+    }
+
+    /**
+     * @brief Construct a new heightfield Shape object
+     *
+     * @param type - shape type
+     * @param pose - shape position depending parent node
+     * @param heightfield - grid of heights
+     * @param material - shape material
+     */
+    Shape(ShapeType type, const Affine3f& pose, const std::shared_ptr<Heightfield>& heightfield,
+          const std::shared_ptr<Material>& material)
+        : _type(type), _pose(pose), _dimensions{}, _material(material), _heightfield(heightfield)
+    {
     }
 
       /**
@@ -96,10 +111,53 @@ class Shape
      */
     const Vector3f& extents() const { return _dimensions; }
 
+    /**
+     * @brief Bounds in the shape frame, before the shape pose
+     *
+     * Analytic for primitives, those of the mesh vertices otherwise. Infinite if unknown.
+     */
+    AABB bounds() const
+    {
+        if (_mesh)
+            return _mesh->bounds();
+        if (_heightfield)
+            return _heightfield->bounds();
+
+        const float r = radius(), h = height() / 2;
+        switch (_type) {
+        case ShapeType::Cube:
+            return AABB{{-_dimensions[0] / 2, -_dimensions[1] / 2, -_dimensions[2] / 2},
+                        {_dimensions[0] / 2, _dimensions[1] / 2, _dimensions[2] / 2}};
+        case ShapeType::Plane:
+            // same size as the plane drawn by the renderers
+            return AABB{{-5.f, -5.f, 0.f}, {5.f, 5.f, 0.f}};
+        case ShapeType::Sphere:
+            return AABB{{-r, -r, -r}, {r, r, r}};
+        case ShapeType::Cylinder:
+            return AABB{{-r, -r, -h}, {r, r, h}};
+        case ShapeType::Capsule:
+            return AABB{{-r, -r, -h - r}, {r, r, h + r}};
+        default:
+            return AABB::Infinite();
+        }
+    }
+
     /**
      * @brief Shape mesh description (only for ShapeType::Mesh shape)
      */
     const std::shared_ptr<Mesh>& mesh() const { return _mesh; }
+    /** @overload */
+    void setMesh(const std::shared_ptr<Mesh>& mesh) { _mesh = mesh; }
+
+    /**
+     * @brief Grid of heights (only for ShapeType::Heightfield shape without mesh)
+     */
+    const std::shared_ptr<Heightfield>& heightfield() const { return _heightfield; }
+    /** @overload */
+    void setHeightfield(const std::shared_ptr<Heightfield>& heightfield)
+    {
+        _heightfield = heightfield;
+    }
 
     /**
      * @brief Associated material
@@ -108,6 +166,41 @@ class Shape
     /** @overload */
     void setMaterial(const std::shared_ptr<Material>& material) { _material = material; }
 
+    /**
+     * @brief User instance id, drawn into the masks of SegmentationMode::Instance, -1 for that
+     * of the node
+     */
+    int instanceId() const { return _instanceId; }
+    /** @overload */
+    void setInstanceId(int instanceId) { _instanceId = instanceId; }
+
+    /**
+     * @brief User semantic class id, drawn into the masks of SegmentationMode::Semantic, -1 for
+     * that of the node
+     */
+    int semanticId() const { return _semanticId; }
+    /** @overload */
+    void setSemanticId(int semanticId) { _semanticId = semanticId; }
+
+    /**
+     * @brief Hash of the content, equal for equal shapes
+     *
+     * Made at each call from the cached hashes of the mesh data, heightfield and texture
+     * bitmap, shared with other shapes and rewritten in place.
+     */
+    uint64_t hash() const
+    {
+        const int ids[] = {int(_type), _instanceId, _semanticId};
+        uint64_t h = hashBytes(ids, sizeof(ids));
+        h = hashBytes(_pose.origin.data(), sizeof(_pose.origin), h);
+        h = hashBytes(_pose.quat.data(), sizeof(_pose.quat), h);
+        h = hashBytes(_pose.scale.data(), sizeof(_pose.scale), h);
+        h = hashBytes(_dimensions.data(), sizeof(_dimensions), h);
+        const uint64_t parts[] = {_material ? _material->hash() : 0, _mesh ? _mesh->hash() : 0,
+                                  _heightfield ? _heightfield->hash() : 0};
+        return hashBytes(parts, sizeof(parts), h);
+    }
+
     /**
      * @brief Comparison operators
      */
@@ -116,7 +209,10 @@ class Shape
         return _type == other._type && _pose == other._pose && _dimensions == other._dimensions &&
                (_material == other._material ||
                 _material && other._material && *_material == *other._material) &&
-               (_mesh == other._mesh || _mesh && other._mesh && *_mesh == *other._mesh);
+               (_mesh == other._mesh || _mesh && other._mesh && *_mesh == *other._mesh) &&
+               (_heightfield == other._heightfield ||
+                _heightfield && other._heightfield && *_heightfield == *other._heightfield) &&
+               _instanceId == other._instanceId && _semanticId == other._semanticId;
     }
     bool operator!=(const Shape& other) const { return !(*this == other); }
 
@@ -126,7 +222,7 @@ class Shape
     template <class Archive>
     void serialize(Archive& ar)
     {
-        ar(_type, _pose, _dimensions, _material, _mesh);
+        ar(_type, _pose, _dimensions, _material, _mesh, _heightfield, _instanceId, _semanticId);
     }
 
   private:
@@ -135,6 +231,9 @@ class Shape
     Vector3f _dimensions;
     std::shared_ptr<Material> _material;
     std::shared_ptr<Mesh> _mesh;
+    std::shared_ptr<Heightfield> _heightfield;
+    int _instanceId = -1;
+    int _semanticId = -1;
 };
 
 } // namespace scene
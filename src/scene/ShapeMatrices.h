@@ -0,0 +1,153 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "SceneGraph.h"
+#include "SceneState.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief World matrices of all shapes of a scene, in one contiguous array
+ *
+ * Each shape gets the product of the world matrix of its node and of its local pose, column
+ * major as OpenGL expects, so that a renderer uploads the transforms of a frame as a single
+ * buffer instead of composing them per draw. Shapes of a node are consecutive, nodes follow the
+ * order of the scene graph. The layout is rebuilt when the scene changes, only the shapes of
+ * the nodes flagged dirty in the SceneState are recomputed otherwise.
+ */
+class ShapeMatrices
+{
+  public:
+    /**
+     * @brief Synchronize with a scene
+     *
+     * Must be called before dirty flags are cleared, e.g. once per frame, as BVH::update().
+     *
+     * @param sceneGraph - scene description
+     * @param sceneState - scene state holding node poses
+     */
+    void update(const SceneGraph& sceneGraph, const SceneState& sceneState)
+    {
+        if (&sceneGraph != _source || sceneGraph.generation() != _generation ||
+            sceneState.size() != _stateSize) {
+            rebuild(sceneGraph, sceneState);
+            return;
+        }
+
+        const auto& dirty = sceneState.dirty();
+        const auto& matrices = sceneState.matrices();
+        _updated = 0;
+        for (const auto& range : _ranges) {
+            if (!dirty[range.slot])
+                continue;
+            compose(matrices[range.slot], range.first, range.count);
+            _updated += range.count;
+        }
+    }
+
+    /**
+     * @brief Force a rebuild at the next update
+     */
+    void invalidate() { _source = nullptr; }
+
+    /**
+     * @brief Number of shapes
+     */
+    size_t size() const { return _matrices.size(); }
+
+    /**
+     * @brief World matrix of each shape
+     */
+    const std::vector<Matrix4f>& matrices() const { return _matrices; }
+
+    /**
+     * @brief Node of each shape
+     */
+    const std::vector<int>& nodeIds() const { return _nodeIds; }
+
+    /**
+     * @brief Index of each shape in its node
+     */
+    const std::vector<int>& shapeIndices() const { return _shapeIndices; }
+
+    /**
+     * @brief Index of the first shape of a node, -1 if the node has no shapes or no state
+     */
+    int offset(int nodeId) const
+    {
+        const auto it = _offsets.find(nodeId);
+        return it != _offsets.end() ? it->second : -1;
+    }
+
+    /**
+     * @brief Number of matrices computed by the last update
+     */
+    size_t updated() const { return _updated; }
+
+  private:
+    /// shapes of a node
+    struct Range {
+        int slot;  //<- state slot of the node
+        int first; //<- first shape
+        int count;
+    };
+
+    void rebuild(const SceneGraph& sceneGraph, const SceneState& sceneState)
+    {
+        _ranges.clear();
+        _local.clear();
+        _nodeIds.clear();
+        _shapeIndices.clear();
+        _offsets.clear();
+        for (const auto& it : sceneGraph.nodes()) {
+            const auto& shapes = it.second.shapes();
+            if (shapes.empty() || !sceneState.hasNode(it.first))
+                continue;
+            const int first = int(_local.size());
+            _ranges.push_back({sceneState.slot(it.first), first, int(shapes.size())});
+            _offsets.emplace(it.first, first);
+            for (int i = 0; i < int(shapes.size()); ++i) {
+                _local.push_back(shapes[i].pose().matrix());
+                _nodeIds.push_back(it.first);
+                _shapeIndices.push_back(i);
+            }
+        }
+
+        _matrices.resize(_local.size());
+        const auto& matrices = sceneState.matrices();
+        for (const auto& range : _ranges)
+            compose(matrices[range.slot], range.first, range.count);
+        _updated = _matrices.size();
+
+        _source = &sceneGraph;
+        _generation = sceneGraph.generation();
+        _stateSize = sceneState.size();
+    }
+
+    /// world matrices of \p count shapes from \p first, given the matrix of their node
+    void compose(const Matrix4f& node, int first, int count)
+    {
+        multiplyMatrices(node, &_local[first], size_t(count), &_matrices[first]);
+    }
+
+    std::vector<Range> _ranges;
+    std::vector<Matrix4f> _local; //<- local pose of each shape
+    std::vector<Matrix4f> _matrices;
+    std::vector<int> _nodeIds;
+    std::vector<int> _shapeIndices;
+    std::unordered_map<int, int> _offsets; //<- node id -> first shape
+    size_t _updated = 0;
+    // scene the layout was built from
+    const void* _source = nullptr;
+    uint64_t _generation = 0;
+    int _stateSize = -1;
+};
+
+} // namespace scene
@@ -4,8 +4,14 @@
 
 #pragma once
 
+#include "AssetTable.h"
+
+#include <utils/hash.h>
 #include <utils/math.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -15,10 +21,27 @@ namespace scene {
 /**
  * @brief Bitmap data
  *
+ * Uncompressed bitmaps hold rows x cols pixels of 1 to 4 channels. Block compressed bitmaps,
+ * made by native renderers only and not meant to be serialized, hold all their mip levels,
+ * largest first, each one made of 4x4 pixel blocks.
+ *
+ * Pixels are either owned or wrapped from memory kept alive by its owner, e.g. a numpy array
+ * or a video decoder buffer. The owner may rewrite wrapped pixels in place, then call touch()
+ * so that renderers upload them again, see SceneGraph::changeTexels().
  */
 class Bitmap
 {
   public:
+    /**
+     * @brief Block compression formats
+     */
+    enum class Compression
+    {
+        None,
+        BC1, //<- 8 bytes per block, opaque (S3TC DXT1)
+        BC3, //<- 16 bytes per block, with alpha (S3TC DXT5)
+    };
+
     /**
      * @brief Construct a new Bitmap object
      *
@@ -31,7 +54,33 @@ class Bitmap
      * @param data - bitmap data
      * @param size - bitmap size
      */
-    Bitmap(std::vector<uint8_t>&& data, const Size2i& size) : _data(std::move(data)), _size(size) {}
+    Bitmap(std::vector<uint8_t>&& data, const Size2i& size) : _size(size) { own(std::move(data)); }
+
+    /**
+     * @brief Construct a new Bitmap object wrapping external pixels, without copy
+     *
+     * @param pixels - rows x cols x channels bytes, released with the last copy of the bitmap
+     * @param bytes - number of bytes
+     * @param size - bitmap size
+     */
+    Bitmap(const std::shared_ptr<const uint8_t>& pixels, size_t bytes, const Size2i& size)
+        : _size(size), _data(pixels), _bytes(bytes), _wrapped(true)
+    {
+    }
+
+    /**
+     * @brief Construct a new block compressed Bitmap object
+     *
+     * @param data - blocks of all mip levels, largest first
+     * @param size - size of the first level
+     * @param compression - block format
+     * @param levels - number of mip levels
+     */
+    Bitmap(std::vector<uint8_t>&& data, const Size2i& size, Compression compression, int levels)
+        : _size(size), _compression(compression), _levels(levels)
+    {
+        own(std::move(data));
+    }
 
     /**
      * @brief Bitmap rows
@@ -48,36 +97,146 @@ class Bitmap
      */
     ssize_t channels() const
     {
+        if (_compression != Compression::None)
+            return 4; //<- once decoded
         auto sq = _size[0] * _size[1];
-        return sq > 0 ? _data.size() / sq : 0;
+        return sq > 0 ? _bytes / sq : 0;
+    }
+
+    /**
+     * @brief Bitmap data, size() bytes
+     */
+    const uint8_t* data() const { return _data.get(); }
+
+    /**
+     * @brief Number of bytes of data
+     */
+    size_t size() const { return _bytes; }
+
+    /**
+     * @brief Pixels wrapped from external memory, see the constructor
+     */
+    bool wrapped() const { return _wrapped; }
+
+    /**
+     * @brief Revision of the pixels, unique across all bitmaps of the process
+     *
+     * Copies keep the revision of the original, a renderer may then upload again the bitmaps
+     * whose revision differs from the one it uploaded.
+     */
+    uint64_t revision() const { return _revision; }
+
+    /**
+     * @brief Give the pixels a new revision, after their owner rewrote them in place
+     */
+    void touch()
+    {
+        _revision = nextRevision();
+        _hash.reset();
     }
 
     /**
-     * @brief Bitmap data
+     * @brief Block format, None for uncompressed bitmaps
      */
-    const std::vector<uint8_t>& data() const { return _data; }
+    Compression compression() const { return _compression; }
+
+    /**
+     * @brief Number of mip levels in data, 1 for uncompressed bitmaps
+     */
+    int levels() const { return _levels; }
+
+    /**
+     * @brief Rows and cols of a mip level
+     */
+    Size2i levelSize(int level) const
+    {
+        return {std::max(_size[0] >> level, 1), std::max(_size[1] >> level, 1)};
+    }
+
+    /**
+     * @brief Bytes of a compressed mip level
+     */
+    size_t levelBytes(int level) const
+    {
+        const auto size = levelSize(level);
+        const size_t blocks = size_t((size[0] + 3) / 4) * size_t((size[1] + 3) / 4);
+        return blocks * (_compression == Compression::BC1 ? 8 : 16);
+    }
+
+    /**
+     * @brief Hash of the size, format and pixels, computed once until touch()
+     *
+     * Bitwise: equal hashes stand for equal pixels, see operator==().
+     */
+    uint64_t hash() const
+    {
+        return _hash.get([this] {
+            uint64_t h = hashBytes(_size.data(), sizeof(_size));
+            const int format[] = {int(_compression), _levels};
+            h = hashBytes(format, sizeof(format), h);
+            return hashWords(data(), _bytes, h);
+        });
+    }
 
     /**
      * @brief Comparison operators
+     *
+     * By hash, without walking the pixels once both hashes are cached.
      */
     bool operator==(const Bitmap& other) const
     {
-        return _size == other._size && _data == other._data;
+        return _size == other._size && _compression == other._compression &&
+               _levels == other._levels && _bytes == other._bytes &&
+               ((_data && _data == other._data) || hash() == other.hash());
     }
     bool operator!=(const Bitmap& other) const { return !(*this == other); }
 
     /**
-     * @brief Serialization
+     * @brief Serialization, wrapped pixels are loaded owned
      */
     template <class Archive>
-    void serialize(Archive& ar)
+    void save(Archive& ar) const
+    {
+        ar(_size, std::vector<uint8_t>(data(), data() + _bytes));
+    }
+    /** @overload */
+    template <class Archive>
+    void load(Archive& ar)
     {
-        ar(_size, _data);
+        std::vector<uint8_t> data;
+        ar(_size, data);
+        own(std::move(data));
+        _wrapped = false;
+        _revision = nextRevision();
+        _hash.reset();
     }
 
   private:
+    static uint64_t nextRevision()
+    {
+        static std::atomic<uint64_t> revision{0};
+        return ++revision;
+    }
+
+    /// pixels owned by the bitmap, shared by its copies
+    void own(std::vector<uint8_t>&& data)
+    {
+        const auto owner = std::make_shared<std::vector<uint8_t>>(std::move(data));
+        _data = std::shared_ptr<const uint8_t>(owner, owner->data());
+        _bytes = owner->size();
+    }
+
     Size2i _size;
-    std::vector<uint8_t> _data;
+    std::shared_ptr<const uint8_t> _data;
+    size_t _bytes = 0;
+    // renderer side (not serialized)
+    Compression _compression = Compression::None;
+    int _levels = 1;
+    bool _wrapped = false;
+    uint64_t _revision = nextRevision();
+    CachedHash _hash; //<- of the pixels, until touch()
+
+    friend class AssetTable; //<- placeholders hash like the pixels they wait for
 };
 
 /**
@@ -111,6 +270,13 @@ class Texture
     {
     }
 
+    /**
+     * @brief Construct a new Texture object sharing a bitmap, e.g. wrapping external pixels
+     *
+     * @param bitmap - texture bitmap
+     */
+    explicit Texture(const std::shared_ptr<Bitmap>& bitmap) : _bitmap(bitmap) {}
+
     /**
      * @brief Texture file name
      */
@@ -121,11 +287,29 @@ class Texture
      */
     const std::shared_ptr<Bitmap>& bitmap() const { return _bitmap; }
 
+    /**
+     * @brief Process-wide asset id shared by identical textures, -1 if not cached
+     *
+     * Renderers may use it to keep one GPU texture per process.
+     */
+    int assetId() const { return _assetId; }
+    /** @overload */
+    void setAssetId(int assetId) { _assetId = assetId; }
+
     /**
      * @brief @brief Texture empty
      */
     bool empty() const { return _filename.empty() && !_bitmap; }
 
+    /**
+     * @brief Hash of the file name and bitmap, equal for equal textures
+     */
+    uint64_t hash() const
+    {
+        const uint64_t h = hashBytes(_filename.data(), _filename.size());
+        return _bitmap ? hashBytes(&h, sizeof(h), _bitmap->hash()) : h;
+    }
+
     /**
      * @brief Comparison operators
      */
@@ -137,17 +321,53 @@ class Texture
     bool operator!=(const Texture& other) const { return !(*this == other); }
 
     /**
-     * @brief Serialization
+     * @brief Serialization, the bitmap by content hash with an AssetTable
      */
     template <class Archive>
-    void serialize(Archive& ar)
+    void save(Archive& ar) const
+    {
+        ar(_filename);
+        AssetTable* table = assetTable(ar);
+        if (!table) {
+            ar(_bitmap);
+            return;
+        }
+        // cached assets only, others may be rewritten in place and are sent in full
+        const bool shared = _bitmap && _assetId >= 0;
+        const uint64_t hash = shared ? _bitmap->hash() : 0;
+        const bool embedded = shared ? table->write(_bitmap) : bool(_bitmap);
+        ar(hash, embedded);
+        if (embedded)
+            ar(*_bitmap);
+    }
+    /** @overload */
+    template <class Archive>
+    void load(Archive& ar)
     {
-        ar(_filename, _bitmap);
+        ar(_filename);
+        AssetTable* table = assetTable(ar);
+        if (!table) {
+            ar(_bitmap);
+            return;
+        }
+        uint64_t hash;
+        bool embedded;
+        ar(hash, embedded);
+        if (embedded) {
+            auto bitmap = std::make_shared<Bitmap>();
+            ar(*bitmap);
+            _bitmap = hash ? table->read(hash, std::move(bitmap)) : std::move(bitmap);
+        }
+        else {
+            _bitmap = hash ? table->bitmap(hash) : nullptr;
+        }
     }
 
   private:
     std::string _filename;
     std::shared_ptr<Bitmap> _bitmap;
+    // process-local (not serialized)
+    int _assetId = -1;
 };
 
 } // namespace scene
@@ -0,0 +1,156 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include "Mesh.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace scene {
+
+/**
+ * @brief IEEE half float of a float, rounded to nearest even
+ */
+inline uint16_t toHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t magnitude = bits & 0x7fffffffu;
+
+    if (magnitude >= 0x7f800000u) //<- infinity or nan
+        return uint16_t(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+    if (magnitude >= 0x477ff000u) //<- rounds above the largest half
+        return uint16_t(sign | 0x7c00u);
+    if (magnitude < 0x38800000u) { //<- below the smallest normal half, 2^-24 units
+        float scaled;
+        std::memcpy(&scaled, &magnitude, sizeof(scaled));
+        return uint16_t(sign | uint32_t(std::nearbyint(scaled * 16777216.f)));
+    }
+    const uint32_t rounded = magnitude + 0xfffu + ((magnitude >> 13) & 1u);
+    return uint16_t(sign | ((rounded - 0x38000000u) >> 13));
+}
+
+/**
+ * @brief Layout of the vertices of a VertexBuffer
+ *
+ * Each vertex is a float position, then the normal and uv if the mesh has them, either as
+ * floats (v3n3t2) or as half floats, normals padded to four halves to keep attributes 4 bytes
+ * aligned.
+ */
+struct VertexLayout {
+    bool halfAttributes = false; //<- normals and uvs as half floats
+    bool shortIndices = false;   //<- 16 bits indices, else 32 bits
+    int stride = 12;             //<- bytes per vertex
+    int normalOffset = -1;       //<- bytes from the vertex start, -1 without normals
+    int uvOffset = -1;           //<- bytes from the vertex start, -1 without uvs
+};
+
+/**
+ * @brief Interleaved copy of a MeshData, ready to be uploaded as is to the GPU
+ */
+class VertexBuffer
+{
+  public:
+    /**
+     * @brief Interleave a mesh
+     *
+     * Indices are 16 bits wide when the vertex count allows it.
+     *
+     * @param mesh - mesh data
+     * @param halfAttributes - store normals and uvs as half floats
+     */
+    VertexBuffer(const MeshData& mesh, bool halfAttributes)
+    {
+        const auto& positions = mesh.vertices();
+        const auto& normals = mesh.normals();
+        const auto& uvs = mesh.uvs();
+        const auto& indices = mesh.indices();
+        _numVertices = positions.size() / 3;
+        _numIndices = indices.size();
+
+        _layout.halfAttributes = halfAttributes;
+        _layout.shortIndices = _numVertices < 0xffff;
+        if (normals.size() == positions.size()) {
+            _layout.normalOffset = _layout.stride;
+            _layout.stride += halfAttributes ? 8 : 12;
+        }
+        if (uvs.size() * 3 == positions.size() * 2 && !uvs.empty()) {
+            _layout.uvOffset = _layout.stride;
+            _layout.stride += halfAttributes ? 4 : 8;
+        }
+
+        _vertices.resize(_numVertices * size_t(_layout.stride));
+        for (size_t i = 0; i < _numVertices; ++i) {
+            uint8_t* vertex = &_vertices[i * size_t(_layout.stride)];
+            std::memcpy(vertex, &positions[i * 3], 3 * sizeof(float));
+            if (_layout.normalOffset >= 0)
+                store(vertex + _layout.normalOffset, &normals[i * 3], 3);
+            if (_layout.uvOffset >= 0)
+                store(vertex + _layout.uvOffset, &uvs[i * 2], 2);
+        }
+
+        if (_layout.shortIndices) {
+            std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+            _indices.resize(_numIndices * sizeof(uint16_t));
+            if (_numIndices)
+                std::memcpy(_indices.data(), shortIndices.data(), _indices.size());
+        }
+        else {
+            _indices.resize(_numIndices * sizeof(uint32_t));
+            if (_numIndices)
+                std::memcpy(_indices.data(), indices.data(), _indices.size());
+        }
+    }
+
+    /**
+     * @brief Vertex layout
+     */
+    const VertexLayout& layout() const { return _layout; }
+
+    /**
+     * @brief Interleaved vertices, layout().stride bytes each
+     */
+    const std::vector<uint8_t>& vertices() const { return _vertices; }
+
+    /**
+     * @brief Triangle indices, 16 or 32 bits unsigned integers
+     */
+    const std::vector<uint8_t>& indices() const { return _indices; }
+
+    /**
+     * @brief Number of vertices
+     */
+    size_t numVertices() const { return _numVertices; }
+
+    /**
+     * @brief Number of indices
+     */
+    size_t numIndices() const { return _numIndices; }
+
+  private:
+    void store(uint8_t* dst, const float* values, int count) const
+    {
+        if (!_layout.halfAttributes) {
+            std::memcpy(dst, values, size_t(count) * sizeof(float));
+            return;
+        }
+        uint16_t halves[4] = {0, 0, 0, 0};
+        for (int k = 0; k < count; ++k)
+            halves[k] = toHalf(values[k]);
+        std::memcpy(dst, halves, size_t(count == 3 ? 4 : count) * sizeof(uint16_t));
+    }
+
+    VertexLayout _layout;
+    std::vector<uint8_t> _vertices;
+    std::vector<uint8_t> _indices;
+    size_t _numVertices = 0;
+    size_t _numIndices = 0;
+};
+
+} // namespace scene
@@ -0,0 +1,102 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <utility>
+
+namespace scene {
+
+/**
+ * @brief Visibility layers of the nodes and shapes of a scene, drawn only by the cameras
+ * seeing one of their layers, see SceneView::cameraLayers()
+ *
+ * Layers are a bitmask of 24 layers, so that they fit in the instance flags of pybullet above
+ * its own ones. Nodes and shapes are in all layers unless set otherwise; a shape is in the
+ * layers of both itself and its node. Layers change no node of the scene graph: renderers
+ * filter shapes by layer as they cull them, without rebuilding anything.
+ */
+class VisibilityLayers
+{
+  public:
+    static constexpr uint32_t kAll = 0xffffff;
+
+    /**
+     * @brief Layers of a shape, those of its node and its own
+     *
+     * @param nodeId - node id
+     * @param shapeIndex - shape index, -1 for those of the node only
+     */
+    uint32_t layers(int nodeId, int shapeIndex) const
+    {
+        const auto node = _layers.find({nodeId, -1});
+        uint32_t layers = node != _layers.end() ? node->second : kAll;
+        if (shapeIndex >= 0) {
+            const auto shape = _layers.find({nodeId, shapeIndex});
+            if (shape != _layers.end())
+                layers &= shape->second;
+        }
+        return layers;
+    }
+
+    /**
+     * @brief Set the layers of a node or one of its shapes
+     *
+     * @param nodeId - node id
+     * @param shapeIndex - shape index, -1 for the node
+     * @param layers - bitmask of layers, kAll to reset
+     */
+    void setLayers(int nodeId, int shapeIndex, uint32_t layers)
+    {
+        layers &= kAll;
+        if (layers == kAll)
+            _layers.erase({nodeId, shapeIndex});
+        else
+            _layers[{nodeId, shapeIndex}] = layers;
+    }
+
+    /**
+     * @brief Forget the layers of a node and its shapes
+     */
+    void removeNode(int nodeId)
+    {
+        _layers.erase(_layers.lower_bound({nodeId, -1}), _layers.lower_bound({nodeId + 1, -1}));
+    }
+
+    /**
+     * @brief Some node or shape has layers of its own
+     */
+    bool hasNode(int nodeId) const
+    {
+        const auto it = _layers.lower_bound({nodeId, -1});
+        return it != _layers.end() && it->first.first == nodeId;
+    }
+
+    /**
+     * @brief Every node and shape is in all layers
+     */
+    bool empty() const { return _layers.empty(); }
+
+    /**
+     * @brief Comparison operators
+     */
+    bool operator==(const VisibilityLayers& other) const { return _layers == other._layers; }
+    bool operator!=(const VisibilityLayers& other) const { return !(*this == other); }
+
+    /**
+     * @brief Serialization
+     */
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(_layers);
+    }
+
+  private:
+    std::map<std::pair<int, int>, uint32_t> _layers; //<- by node id and shape index, -1 for node
+};
+
+} // namespace scene
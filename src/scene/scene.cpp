@@ -2,6 +2,8 @@
 // This source code is licensed under the LGPLv3 license found in the
 // LICENSE file in the root directory of this source tree.
 
+#include "BVH.h"
+#include "SceneBounds.h"
 #include "SceneGraph.h"
 #include "SceneState.h"
 #include "SceneView.h"
@@ -0,0 +1,107 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+// Serves the scenes of RemoteRenderer clients with a native backend, one renderer per client,
+// until interrupted:
+//
+//   render_server [--port 7420] [--address ADDRESS] [--backend egl|tiny] [--device N]
+//                 [--threads N]
+//
+// --device selects the EGL device, --threads the TinyRenderer threads of each client.
+
+#include <render/RenderServer.h>
+
+#ifdef WITH_EGL
+#include <render/EGLRenderer.h>
+#endif
+#ifdef WITH_TINYRENDERER
+#include <render/TinyRendererBackend.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace {
+
+std::atomic<bool> gInterrupted(false);
+
+void interrupt(int) { gInterrupted = true; }
+
+int usage(const char* program)
+{
+    std::fprintf(stderr,
+                 "usage: %s [--port N] [--address ADDRESS] [--backend egl|tiny] [--device N] "
+                 "[--threads N]\n",
+                 program);
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int port = 7420, device = -1, threads = 0;
+    std::string address;
+#ifdef WITH_EGL
+    std::string backend = "egl";
+#else
+    std::string backend = "tiny";
+#endif
+
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 >= argc)
+            return usage(argv[0]);
+        const char* value = argv[++i];
+        if (!std::strcmp(argv[i - 1], "--port"))
+            port = std::atoi(value);
+        else if (!std::strcmp(argv[i - 1], "--address"))
+            address = value;
+        else if (!std::strcmp(argv[i - 1], "--backend"))
+            backend = value;
+        else if (!std::strcmp(argv[i - 1], "--device"))
+            device = std::atoi(value);
+        else if (!std::strcmp(argv[i - 1], "--threads"))
+            threads = std::atoi(value);
+        else
+            return usage(argv[0]);
+    }
+
+    render::RenderServer::RendererFactory factory;
+#ifdef WITH_EGL
+    if (backend == "egl")
+        factory = [device] { return std::make_shared<render::EGLRenderer>(device); };
+#endif
+#ifdef WITH_TINYRENDERER
+    if (backend == "tiny")
+        factory = [threads] { return std::make_shared<render::TinyRendererBackend>(threads); };
+#endif
+    if (!factory) {
+        std::fprintf(stderr, "%s: backend %s not built\n", argv[0], backend.c_str());
+        return 2;
+    }
+    (void)device;
+    (void)threads;
+
+    try {
+        render::RenderServer server(factory, port, address);
+        std::signal(SIGINT, interrupt);
+        std::signal(SIGTERM, interrupt);
+        std::printf("render_server: %s backend on port %d\n", backend.c_str(), server.port());
+        std::fflush(stdout);
+        while (!gInterrupted)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        server.stop();
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <iterator>
+#include <process.h>
+#include <sys/stat.h>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Read-only file contents, memory mapped where supported
+ */
+class MappedFile
+{
+  public:
+    explicit MappedFile(const std::string& filename)
+    {
+#ifdef _WIN32
+        std::ifstream file(filename, std::ios::binary);
+        if (file)
+            _buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        _data = _buffer.data();
+        _size = _buffer.size();
+        _valid = bool(file);
+#else
+        const int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat info;
+        if (fstat(fd, &info) == 0) {
+            _size = size_t(info.st_size);
+            _valid = true;
+            if (_size > 0) {
+                void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+                _valid = data != MAP_FAILED;
+                _data = _valid ? static_cast<const char*>(data) : nullptr;
+            }
+        }
+        close(fd);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (_data)
+            munmap(const_cast<char*>(_data), _size);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool valid() const { return _valid; }
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+
+  private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+    bool _valid = false;
+#ifdef _WIN32
+    std::vector<char> _buffer;
+#endif
+};
+
+/**
+ * @brief Make a directory and its parents
+ *
+ * @return True if the directory exists
+ */
+inline bool makeDirectories(const std::string& path)
+{
+    for (size_t i = 1; i <= path.size(); ++i) {
+        if (i < path.size() && path[i] != '/' && path[i] != '\\')
+            continue;
+        const std::string parent = path.substr(0, i);
+        struct stat info;
+        if (stat(parent.c_str(), &info) == 0)
+            continue;
+#ifdef _WIN32
+        if (_mkdir(parent.c_str()) != 0)
+#else
+        if (mkdir(parent.c_str(), 0755) != 0)
+#endif
+            return stat(parent.c_str(), &info) == 0; //<- made concurrently
+    }
+    return true;
+}
+
+/**
+ * @brief Write a file with \p write(std::ofstream&) aside, then rename it to \p path, so that
+ * concurrent processes never read a partial file; failures are ignored
+ */
+template <class Writer>
+inline void writeFileAtomically(const std::string& path, const Writer& write)
+{
+#ifdef _WIN32
+    const int process = _getpid();
+#else
+    const int process = getpid();
+#endif
+    const auto thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    const auto temporary = path + "." + std::to_string(process) + "." + std::to_string(thread);
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        write(file);
+        if (!file.flush()) {
+            file.close();
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str()); //<- rename does not replace files on windows
+#endif
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        std::remove(temporary.c_str());
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+static constexpr uint64_t kHashSeed = 14695981039346656037ull;
+
+/**
+ * @brief FNV-1a hash of a memory block, chained with \p hash
+ *
+ * @param data - memory block
+ * @param size - block size in bytes
+ * @param hash - previous hash value
+ * @return uint64_t
+ */
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = kHashSeed)
+{
+    const auto bytes = reinterpret_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/** @overload */
+template <typename T>
+inline uint64_t hashBytes(const std::vector<T>& data, uint64_t hash = kHashSeed)
+{
+    return hashBytes(data.data(), data.size() * sizeof(T), hash);
+}
+
+/**
+ * @brief Hash of a memory block taken 8 bytes at a time, chained with \p hash
+ *
+ * Several times faster than hashBytes() on large blocks such as files, with other values.
+ *
+ * @param data - memory block
+ * @param size - block size in bytes
+ * @param hash - previous hash value
+ * @return uint64_t
+ */
+inline uint64_t hashWords(const void* data, size_t size, uint64_t hash = kHashSeed)
+{
+    const auto bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+        hash ^= hash >> 32; //<- high bits of the words reach the low bits of the hash
+    }
+    return hashBytes(bytes + i, size - i, hash);
+}
+
+/**
+ * @brief Hash of the content of an object, computed on first use and kept until reset()
+ *
+ * Owners reset it whenever their content changes. Copies keep the cached value. Concurrent
+ * readers may compute it twice, they store the same value.
+ */
+class CachedHash
+{
+  public:
+    CachedHash() noexcept = default;
+    CachedHash(const CachedHash& other) noexcept
+        : _value(other._value.load(std::memory_order_relaxed))
+    {
+    }
+    CachedHash& operator=(const CachedHash& other) noexcept
+    {
+        _value.store(other._value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    /**
+     * @brief Cached value, made by \p compute if none
+     */
+    template <class Compute>
+    uint64_t get(Compute compute) const
+    {
+        uint64_t value = _value.load(std::memory_order_relaxed);
+        if (value == 0) {
+            value = compute() | 1; //<- zero stands for none
+            _value.store(value, std::memory_order_relaxed);
+        }
+        return value;
+    }
+
+    /**
+     * @brief Cache a value known beforehand, e.g. that of content still to come
+     */
+    void set(uint64_t value) { _value.store(value | 1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Drop the cached value, the content changed
+     */
+    void reset() { _value.store(0, std::memory_order_relaxed); }
+
+  private:
+    mutable std::atomic<uint64_t> _value{0};
+};
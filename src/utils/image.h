@@ -0,0 +1,122 @@
+// Copyright (c) 2019-2020 INRIA.
+// This source code is licensed under the LGPLv3 license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// SSE2 kernels are selected at compile time, define PYBULLET_RENDERING_NO_SIMD for scalar ones
+#if !defined(PYBULLET_RENDERING_NO_SIMD) &&                                                      \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define PYBULLET_RENDERING_IMAGE_SSE2
+#endif
+
+/**
+ * @brief Smallest number of pixels converted on several threads
+ */
+static constexpr size_t kParallelImageSize = size_t(1) << 20;
+
+/**
+ * @brief Run kernel(begin, end) over [0, count), split over a few threads for large images
+ */
+template <class Kernel>
+inline void parallelPixels(size_t count, const Kernel& kernel)
+{
+    const size_t threads = count < kParallelImageSize
+                               ? 1
+                               : std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u),
+                                                  count / (kParallelImageSize / 4));
+    if (threads <= 1) {
+        kernel(size_t(0), count);
+        return;
+    }
+
+    // chunks aligned to 16 pixels so that only the last one has a scalar tail
+    const size_t chunk = (count / threads + 15) & ~size_t(15);
+    std::vector<std::thread> workers;
+    for (size_t begin = chunk; begin < count; begin += chunk)
+        workers.emplace_back(kernel, begin, std::min(begin + chunk, count));
+    kernel(size_t(0), std::min(chunk, count));
+    for (auto& worker : workers)
+        worker.join();
+}
+
+/**
+ * @brief Convert OpenGL Z-buffer values in [0, 1] to metric depth, 0 for the far plane
+ *
+ * \p zbuffer and \p depth may be the same memory for an in-place conversion.
+ *
+ * @param zbuffer - Z-buffer values
+ * @param count - number of pixels
+ * @param znear - near plane distance
+ * @param zfar - far plane distance
+ * @param depth - metric depth output
+ */
+inline void depthFromZBuffer(const float* zbuffer, size_t count, float znear, float zfar,
+                             float* depth)
+{
+    const float numerator = znear * zfar;
+    const float range = zfar - znear;
+    parallelPixels(count, [=](size_t begin, size_t end) {
+        size_t i = begin;
+#ifdef PYBULLET_RENDERING_IMAGE_SSE2
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 n = _mm_set1_ps(numerator);
+        const __m128 r = _mm_set1_ps(range);
+        const __m128 f = _mm_set1_ps(zfar);
+        for (; i + 4 <= end; i += 4) {
+            const __m128 z = _mm_loadu_ps(zbuffer + i);
+            const __m128 d = _mm_div_ps(n, _mm_sub_ps(f, _mm_mul_ps(z, r)));
+            _mm_storeu_ps(depth + i, _mm_and_ps(_mm_cmpneq_ps(z, one), d));
+        }
+#endif
+        for (; i < end; ++i) {
+            const float z = zbuffer[i];
+            depth[i] = z != 1.f ? numerator / (zfar - z * range) : 0.f;
+        }
+    });
+}
+
+/**
+ * @brief Decode segmentation mask values from RGB-encoded pixels
+ *
+ * The value of a pixel is r + (g << 8) + (b << 24) - 1, the inverse of the encoding of the
+ * python mask_to_rgb helper.
+ *
+ * @param rgb - interleaved 8-bit pixels
+ * @param count - number of pixels
+ * @param channels - number of channels per pixel, at least 3, extra channels are ignored
+ * @param mask - mask output
+ */
+inline void rgbToMask(const uint8_t* rgb, size_t count, int channels, int* mask)
+{
+    parallelPixels(count, [=](size_t begin, size_t end) {
+        size_t i = begin;
+#ifdef PYBULLET_RENDERING_IMAGE_SSE2
+        if (channels == 4) {
+            // the (b << 24) term wraps as in the int32 dot product of numpy
+            const __m128i red = _mm_set1_epi32(0xff);
+            const __m128i green = _mm_set1_epi32(0xff00);
+            const __m128i blue = _mm_set1_epi32(0xff0000);
+            const __m128i minusOne = _mm_set1_epi32(-1);
+            for (; i + 4 <= end; i += 4) {
+                const __m128i p =
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 4));
+                __m128i v = _mm_or_si128(_mm_and_si128(p, _mm_or_si128(red, green)),
+                                         _mm_slli_epi32(_mm_and_si128(p, blue), 8));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i), _mm_add_epi32(v, minusOne));
+            }
+        }
+#endif
+        for (; i < end; ++i) {
+            const uint8_t* p = rgb + i * channels;
+            mask[i] = int(uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 24)) - 1;
+        }
+    });
+}
@@ -6,10 +6,31 @@
 
 #include "serialization.h"
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstddef>
+
+// batched kernels are vectorized at compile time with AVX, SSE2 or NEON, define
+// PYBULLET_RENDERING_NO_SIMD for scalar ones
+#if !defined(PYBULLET_RENDERING_NO_SIMD) && defined(__AVX__)
+#include <immintrin.h>
+#define PYBULLET_RENDERING_MATH_AVX
+#elif !defined(PYBULLET_RENDERING_NO_SIMD) &&                                                    \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define PYBULLET_RENDERING_MATH_SSE2
+#elif !defined(PYBULLET_RENDERING_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PYBULLET_RENDERING_MATH_NEON
+#endif
+#if defined(PYBULLET_RENDERING_MATH_AVX) || defined(PYBULLET_RENDERING_MATH_SSE2) ||            \
+    defined(PYBULLET_RENDERING_MATH_NEON)
+#define PYBULLET_RENDERING_MATH_SIMD
+#endif
 
 typedef std::array<int, 2> Size2i;
+typedef std::array<int, 4> Vector4i;
 typedef std::array<float, 3> Vector3f;
 typedef std::array<float, 4> Vector4f;
 typedef std::array<float, 4 * 4> Matrix4f;
@@ -90,3 +111,472 @@ struct Affine3f {
         ar(origin, quat, scale);
     }
 };
+
+/**
+ * @brief Transform a fraction \p t of the way from \p a to \p b
+ *
+ * Origins and scales are interpolated linearly, rotations along the shortest arc.
+ */
+inline Affine3f interpolate(const Affine3f& a, const Affine3f& b, float t)
+{
+    Affine3f result;
+    for (int k = 0; k < 3; ++k) {
+        result.origin[k] = a.origin[k] + t * (b.origin[k] - a.origin[k]);
+        result.scale[k] = a.scale[k] + t * (b.scale[k] - a.scale[k]);
+    }
+
+    float cosine = 0.f;
+    for (int k = 0; k < 4; ++k)
+        cosine += a.quat[k] * b.quat[k];
+    const float sign = cosine < 0.f ? -1.f : 1.f;
+    cosine = std::min(cosine * sign, 1.f);
+    float wa = 1.f - t, wb = t * sign;
+    if (cosine < 0.9995f) {
+        const float angle = std::acos(cosine);
+        const float sine = std::sin(angle);
+        wa = std::sin((1.f - t) * angle) / sine;
+        wb = std::sin(t * angle) / sine * sign;
+    }
+    float norm = 0.f;
+    for (int k = 0; k < 4; ++k) {
+        result.quat[k] = wa * a.quat[k] + wb * b.quat[k];
+        norm += result.quat[k] * result.quat[k];
+    }
+    // nearly equal rotations are blended linearly, normalized back
+    norm = std::sqrt(norm);
+    for (int k = 0; k < 4; ++k)
+        result.quat[k] /= norm;
+    return result;
+}
+
+/**
+ * @brief Product of two column-major 4x4 matrices
+ */
+inline Matrix4f multiply(const Matrix4f& a, const Matrix4f& b)
+{
+    Matrix4f result;
+    for (int col = 0; col < 4; ++col) {
+        for (int row = 0; row < 4; ++row) {
+            float value = 0.f;
+            for (int k = 0; k < 4; ++k)
+                value += a[k * 4 + row] * b[col * 4 + k];
+            result[col * 4 + row] = value;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Inverse of an affine transform, scaled or not
+ */
+inline Matrix4f affineInverse(const Matrix4f& m)
+{
+    const float a = m[0], b = m[4], c = m[8];
+    const float d = m[1], e = m[5], f = m[9];
+    const float g = m[2], h = m[6], i = m[10];
+    const float c00 = e * i - f * h, c01 = c * h - b * i, c02 = b * f - c * e;
+    const float c10 = f * g - d * i, c11 = a * i - c * g, c12 = c * d - a * f;
+    const float c20 = d * h - e * g, c21 = b * g - a * h, c22 = a * e - b * d;
+    const float det = a * c00 + b * c10 + c * c20;
+    const float s = det != 0.f ? 1.f / det : 0.f;
+    // rows of the inverse rotation part, column-major storage
+    const Matrix4f r{c00 * s, c10 * s, c20 * s, 0.f, c01 * s, c11 * s, c21 * s, 0.f,
+                     c02 * s, c12 * s, c22 * s, 0.f, 0.f,     0.f,     0.f,     1.f};
+    Matrix4f result = r;
+    for (int k = 0; k < 3; ++k)
+        result[12 + k] = -(r[k] * m[12] + r[4 + k] * m[13] + r[8 + k] * m[14]);
+    return result;
+}
+
+/**
+ * @brief Point \p p transformed by \p m
+ */
+inline Vector3f transformPoint(const Matrix4f& m, const Vector3f& p)
+{
+    return {m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12],
+            m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13],
+            m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14]};
+}
+
+#ifdef PYBULLET_RENDERING_MATH_SIMD
+/**
+ * @brief Float lanes of the batched kernels, one transform per lane
+ *
+ * Groups of four consecutive floats, e.g. a quaternion or a matrix column, are loaded from
+ * kWidth transforms and transposed to one lane per transform. With AVX a register holds two
+ * groups of four lanes, those of transforms j and j + 4, as the shuffles work per 128-bit half.
+ */
+struct MathLanes {
+#if defined(PYBULLET_RENDERING_MATH_AVX)
+    typedef __m256 Type;
+    static constexpr size_t kWidth = 8;
+
+    static Type splat(float a) { return _mm256_set1_ps(a); }
+    static Type load(const float* p) { return _mm256_load_ps(p); }
+    static void store(float* p, Type a) { _mm256_store_ps(p, a); }
+    static Type add(Type a, Type b) { return _mm256_add_ps(a, b); }
+    static Type sub(Type a, Type b) { return _mm256_sub_ps(a, b); }
+    static Type mul(Type a, Type b) { return _mm256_mul_ps(a, b); }
+    static Type div(Type a, Type b) { return _mm256_div_ps(a, b); }
+    static Type neg(Type a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.f)); }
+    // (a < b) ? a : b, std::min(b, a)
+    static Type min(Type a, Type b) { return _mm256_min_ps(a, b); }
+    // (a > b) ? a : b, std::max(b, a)
+    static Type max(Type a, Type b) { return _mm256_max_ps(a, b); }
+    static Type notEqual(Type a, Type b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+    static Type less(Type a, Type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Type lessEqual(Type a, Type b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static Type bitAnd(Type a, Type b) { return _mm256_and_ps(a, b); }
+    static Type select(Type mask, Type a, Type b) { return _mm256_blendv_ps(b, a, mask); }
+    // bit j set for lane j of a comparison mask
+    static int moveMask(Type mask) { return _mm256_movemask_ps(mask); }
+
+    static Type loadGroup(const float* lower, const float* upper)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lower)),
+                                    _mm_loadu_ps(upper), 1);
+    }
+    static void storeGroup(float* lower, float* upper, Type a)
+    {
+        _mm_storeu_ps(lower, _mm256_castps256_ps128(a));
+        _mm_storeu_ps(upper, _mm256_extractf128_ps(a, 1));
+    }
+    static void transpose(Type& a, Type& b, Type& c, Type& d)
+    {
+        const Type ab0 = _mm256_shuffle_ps(a, b, 0x44), ab1 = _mm256_shuffle_ps(a, b, 0xee);
+        const Type cd0 = _mm256_shuffle_ps(c, d, 0x44), cd1 = _mm256_shuffle_ps(c, d, 0xee);
+        a = _mm256_shuffle_ps(ab0, cd0, 0x88);
+        b = _mm256_shuffle_ps(ab0, cd0, 0xdd);
+        c = _mm256_shuffle_ps(ab1, cd1, 0x88);
+        d = _mm256_shuffle_ps(ab1, cd1, 0xdd);
+    }
+#elif defined(PYBULLET_RENDERING_MATH_SSE2)
+    typedef __m128 Type;
+    static constexpr size_t kWidth = 4;
+
+    static Type splat(float a) { return _mm_set1_ps(a); }
+    static Type load(const float* p) { return _mm_load_ps(p); }
+    static void store(float* p, Type a) { _mm_store_ps(p, a); }
+    static Type add(Type a, Type b) { return _mm_add_ps(a, b); }
+    static Type sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+    static Type mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+    static Type div(Type a, Type b) { return _mm_div_ps(a, b); }
+    static Type neg(Type a) { return _mm_xor_ps(a, _mm_set1_ps(-0.f)); }
+    static Type min(Type a, Type b) { return _mm_min_ps(a, b); }
+    static Type max(Type a, Type b) { return _mm_max_ps(a, b); }
+    static Type notEqual(Type a, Type b) { return _mm_cmpneq_ps(a, b); }
+    static Type less(Type a, Type b) { return _mm_cmplt_ps(a, b); }
+    static Type lessEqual(Type a, Type b) { return _mm_cmple_ps(a, b); }
+    static Type bitAnd(Type a, Type b) { return _mm_and_ps(a, b); }
+    static Type select(Type mask, Type a, Type b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+    static int moveMask(Type mask) { return _mm_movemask_ps(mask); }
+
+    static Type loadGroup(const float* p, const float*) { return _mm_loadu_ps(p); }
+    static void storeGroup(float* p, float*, Type a) { _mm_storeu_ps(p, a); }
+    static void transpose(Type& a, Type& b, Type& c, Type& d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+#else
+    typedef float32x4_t Type;
+    static constexpr size_t kWidth = 4;
+
+    static Type splat(float a) { return vdupq_n_f32(a); }
+    static Type load(const float* p) { return vld1q_f32(p); }
+    static void store(float* p, Type a) { vst1q_f32(p, a); }
+    static Type add(Type a, Type b) { return vaddq_f32(a, b); }
+    static Type sub(Type a, Type b) { return vsubq_f32(a, b); }
+    static Type mul(Type a, Type b) { return vmulq_f32(a, b); }
+    static Type div(Type a, Type b) { return vdivq_f32(a, b); }
+    static Type neg(Type a) { return vnegq_f32(a); }
+    static Type min(Type a, Type b) { return vminq_f32(a, b); }
+    static Type max(Type a, Type b) { return vmaxq_f32(a, b); }
+    static Type notEqual(Type a, Type b)
+    {
+        return vreinterpretq_f32_u32(vmvnq_u32(vceqq_f32(a, b)));
+    }
+    static Type less(Type a, Type b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+    static Type lessEqual(Type a, Type b) { return vreinterpretq_f32_u32(vcleq_f32(a, b)); }
+    static Type bitAnd(Type a, Type b)
+    {
+        return vreinterpretq_f32_u32(
+            vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+    }
+    static Type select(Type mask, Type a, Type b)
+    {
+        return vbslq_f32(vreinterpretq_u32_f32(mask), a, b);
+    }
+    static int moveMask(Type mask)
+    {
+        static const int32x4_t shifts = {0, 1, 2, 3};
+        const uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(mask), 31);
+        return int(vaddvq_u32(vshlq_u32(bits, shifts)));
+    }
+
+    static Type loadGroup(const float* p, const float*) { return vld1q_f32(p); }
+    static void storeGroup(float* p, float*, Type a) { vst1q_f32(p, a); }
+    static void transpose(Type& a, Type& b, Type& c, Type& d)
+    {
+        const float32x4x2_t ab = vtrnq_f32(a, b), cd = vtrnq_f32(c, d);
+        a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+        b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+        c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+        d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+    }
+#endif
+
+    /**
+     * @brief Groups of four floats \p group(j) of the transforms, lane j of \p values[0..3]
+     */
+    template <class Group>
+    static void loadTransposed(const Group& group, Type* values)
+    {
+        const size_t upper = kWidth > 4 ? 4 : 0; //<- groups of the upper AVX halves
+        for (size_t k = 0; k < 4; ++k)
+            values[k] = loadGroup(group(k), group(k + upper));
+        transpose(values[0], values[1], values[2], values[3]);
+    }
+
+    /**
+     * @brief Store lane j of \p values[0..3] as the group of four floats \p group(j)
+     */
+    template <class Group>
+    static void storeTransposed(const Group& group, const Type* values)
+    {
+        const size_t upper = kWidth > 4 ? 4 : 0;
+        Type rows[4] = {values[0], values[1], values[2], values[3]};
+        transpose(rows[0], rows[1], rows[2], rows[3]);
+        for (size_t k = 0; k < 4; ++k)
+            storeGroup(group(k), group(k + upper), rows[k]);
+    }
+
+    /**
+     * @brief Float \p value(j) of each transform in lane j
+     */
+    template <class Value>
+    static Type gather(const Value& value)
+    {
+        alignas(32) float values[kWidth];
+        for (size_t j = 0; j < kWidth; ++j)
+            values[j] = value(j);
+        return load(values);
+    }
+
+    /**
+     * @brief Components of the vectors \p vectors[0..kWidth), lane j of \p values[0..3)
+     *
+     * Vectors are read four floats at a time, the last one of the array being gathered.
+     */
+    static void loadVectors(const Vector3f* vectors, bool last, Type* values)
+    {
+        if (last) {
+            for (size_t k = 0; k < 3; ++k)
+                values[k] = gather([&](size_t j) { return vectors[j][k]; });
+            return;
+        }
+        Type rows[4];
+        loadTransposed([&](size_t j) { return vectors[j].data(); }, rows);
+        std::copy(rows, rows + 3, values);
+    }
+
+    /**
+     * @brief Entry \p col * 4 + row of the column-major matrices \p matrix(j) in lane j
+     */
+    template <class Matrix>
+    static void loadMatrices(const Matrix& matrix, Type* entries)
+    {
+        for (size_t col = 0; col < 4; ++col)
+            loadTransposed([&](size_t j) { return matrix(j) + col * 4; }, entries + col * 4);
+    }
+
+    /** @overload */
+    template <class Matrix>
+    static void storeMatrices(const Matrix& matrix, const Type* entries)
+    {
+        for (size_t col = 0; col < 4; ++col)
+            storeTransposed([&](size_t j) { return matrix(j) + col * 4; }, entries + col * 4);
+    }
+};
+#endif
+
+/**
+ * @brief Matrices of transforms given as dense arrays, as Affine3f::matrix() for each one
+ *
+ * Quaternions are converted kWidth at a time, e.g. over the origins, rotations and scales of a
+ * SceneState, with the arithmetic of Affine3f::matrix(), hence the same matrices.
+ *
+ * @param origins - translations
+ * @param quats - rotations, (w, x, y, z)
+ * @param scales - scale vectors
+ * @param count - number of transforms
+ * @param matrices - output column-major matrices
+ */
+inline void poseMatrices(const Vector3f* origins, const Quaternionf* quats,
+                         const Vector3f* scales, size_t count, Matrix4f* matrices)
+{
+    size_t i = 0;
+#ifdef PYBULLET_RENDERING_MATH_SIMD
+    using L = MathLanes;
+    const L::Type zero = L::splat(0.f), one = L::splat(1.f), two = L::splat(2.f);
+    for (; i + L::kWidth <= count; i += L::kWidth) {
+        L::Type q[4];
+        L::loadTransposed([&](size_t j) { return quats[i + j].data(); }, q);
+        const L::Type qw = q[0], qx = q[1], qy = q[2], qz = q[3];
+        const auto twice = [&](L::Type a) { return L::mul(two, a); };
+        const auto oneMinusTwice = [&](L::Type a) { return L::sub(one, twice(a)); };
+
+        const L::Type m00 = oneMinusTwice(L::add(L::mul(qy, qy), L::mul(qz, qz)));
+        const L::Type m01 = twice(L::sub(L::mul(qx, qy), L::mul(qz, qw)));
+        const L::Type m02 = twice(L::add(L::mul(qx, qz), L::mul(qy, qw)));
+
+        const L::Type m10 = twice(L::add(L::mul(qx, qy), L::mul(qz, qw)));
+        const L::Type m11 = oneMinusTwice(L::add(L::mul(qx, qx), L::mul(qz, qz)));
+        const L::Type m12 = twice(L::sub(L::mul(qy, qz), L::mul(qx, qw)));
+
+        const L::Type m20 = twice(L::sub(L::mul(qx, qz), L::mul(qy, qw)));
+        const L::Type m21 = twice(L::add(L::mul(qy, qz), L::mul(qx, qw)));
+        const L::Type m22 = oneMinusTwice(L::add(L::mul(qx, qx), L::mul(qy, qy)));
+
+        L::Type s[3], o[3];
+        L::loadVectors(scales + i, i + L::kWidth == count, s);
+        L::loadVectors(origins + i, i + L::kWidth == count, o);
+        const L::Type entries[16] = {
+            L::mul(m00, s[0]), L::mul(m10, s[1]), L::mul(m20, s[2]), zero,
+            L::mul(m01, s[0]), L::mul(m11, s[1]), L::mul(m21, s[2]), zero,
+            L::mul(m02, s[0]), L::mul(m12, s[1]), L::mul(m22, s[2]), zero,
+            o[0],              o[1],              o[2],              one};
+        L::storeMatrices([&](size_t j) { return matrices[i + j].data(); }, entries);
+    }
+#endif
+    for (; i < count; ++i)
+        matrices[i] = Affine3f{origins[i], quats[i], scales[i]}.matrix();
+}
+
+/**
+ * @brief Product of two column-major 4x4 matrices into \p result, which may be \p b
+ */
+inline void multiplyInto(const float* a, const float* b, float* result)
+{
+#if defined(PYBULLET_RENDERING_MATH_AVX)
+    // two columns of the product per register
+    const auto column = [a](int k) {
+        const __m128 value = _mm_loadu_ps(a + k * 4);
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(value), value, 1);
+    };
+    const __m256 a0 = column(0), a1 = column(1), a2 = column(2), a3 = column(3);
+    for (int col = 0; col < 4; col += 2) {
+        const float* c = b + col * 4;
+        const auto factor = [c](int k) {
+            return _mm256_insertf128_ps(_mm256_set1_ps(c[k]), _mm_set1_ps(c[4 + k]), 1);
+        };
+        __m256 value = _mm256_mul_ps(a0, factor(0));
+        value = _mm256_add_ps(value, _mm256_mul_ps(a1, factor(1)));
+        value = _mm256_add_ps(value, _mm256_mul_ps(a2, factor(2)));
+        value = _mm256_add_ps(value, _mm256_mul_ps(a3, factor(3)));
+        _mm256_storeu_ps(result + col * 4, value);
+    }
+#elif defined(PYBULLET_RENDERING_MATH_SSE2)
+    const __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4);
+    const __m128 a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+    for (int col = 0; col < 4; ++col) {
+        const float* c = b + col * 4;
+        __m128 value = _mm_mul_ps(a0, _mm_set1_ps(c[0]));
+        value = _mm_add_ps(value, _mm_mul_ps(a1, _mm_set1_ps(c[1])));
+        value = _mm_add_ps(value, _mm_mul_ps(a2, _mm_set1_ps(c[2])));
+        value = _mm_add_ps(value, _mm_mul_ps(a3, _mm_set1_ps(c[3])));
+        _mm_storeu_ps(result + col * 4, value);
+    }
+#elif defined(PYBULLET_RENDERING_MATH_NEON)
+    const float32x4_t a0 = vld1q_f32(a), a1 = vld1q_f32(a + 4);
+    const float32x4_t a2 = vld1q_f32(a + 8), a3 = vld1q_f32(a + 12);
+    for (int col = 0; col < 4; ++col) {
+        const float32x4_t c = vld1q_f32(b + col * 4);
+        float32x4_t value = vmulq_laneq_f32(a0, c, 0);
+        value = vaddq_f32(value, vmulq_laneq_f32(a1, c, 1));
+        value = vaddq_f32(value, vmulq_laneq_f32(a2, c, 2));
+        value = vaddq_f32(value, vmulq_laneq_f32(a3, c, 3));
+        vst1q_f32(result + col * 4, value);
+    }
+#else
+    float product[16];
+    for (int col = 0; col < 4; ++col) {
+        for (int row = 0; row < 4; ++row) {
+            float value = 0.f;
+            for (int k = 0; k < 4; ++k)
+                value += a[k * 4 + row] * b[col * 4 + k];
+            product[col * 4 + row] = value;
+        }
+    }
+    std::copy(product, product + 16, result);
+#endif
+}
+
+/**
+ * @brief Products of a matrix with each of \p count matrices, e.g. shape matrices of a node
+ *
+ * @param a - left matrix, e.g. the world matrix of a node
+ * @param b - right matrices, e.g. the local poses of its shapes
+ * @param count - number of right matrices
+ * @param result - output products a * b[i]
+ */
+inline void multiplyMatrices(const Matrix4f& a, const Matrix4f* b, size_t count,
+                             Matrix4f* result)
+{
+    for (size_t i = 0; i < count; ++i)
+        multiplyInto(a.data(), b[i].data(), result[i].data());
+}
+
+/**
+ * @brief Products of matrices two by two, a[i] * b[i]
+ */
+inline void multiplyMatrices(const Matrix4f* a, const Matrix4f* b, size_t count,
+                             Matrix4f* result)
+{
+    for (size_t i = 0; i < count; ++i)
+        multiplyInto(a[i].data(), b[i].data(), result[i].data());
+}
+
+/**
+ * @brief Inverses of affine transforms, as affineInverse() for each one
+ *
+ * @param matrices - column-major affine matrices, scaled or not
+ * @param count - number of matrices
+ * @param result - output inverses, may be \p matrices
+ */
+inline void affineInverses(const Matrix4f* matrices, size_t count, Matrix4f* result)
+{
+    size_t i = 0;
+#ifdef PYBULLET_RENDERING_MATH_SIMD
+    using L = MathLanes;
+    const L::Type zero = L::splat(0.f), one = L::splat(1.f);
+    for (; i + L::kWidth <= count; i += L::kWidth) {
+        L::Type m[16];
+        L::loadMatrices([&](size_t j) { return matrices[i + j].data(); }, m);
+        const L::Type a = m[0], b = m[4], c = m[8];
+        const L::Type d = m[1], e = m[5], f = m[9];
+        const L::Type g = m[2], h = m[6], k = m[10];
+        const auto cofactor = [](L::Type x, L::Type y, L::Type z, L::Type w) {
+            return L::sub(L::mul(x, y), L::mul(z, w));
+        };
+        const L::Type c00 = cofactor(e, k, f, h), c01 = cofactor(c, h, b, k);
+        const L::Type c02 = cofactor(b, f, c, e), c10 = cofactor(f, g, d, k);
+        const L::Type c11 = cofactor(a, k, c, g), c12 = cofactor(c, d, a, f);
+        const L::Type c20 = cofactor(d, h, e, g), c21 = cofactor(b, g, a, h);
+        const L::Type c22 = cofactor(a, e, b, d);
+        const L::Type det = L::add(L::add(L::mul(a, c00), L::mul(b, c10)), L::mul(c, c20));
+        const L::Type s = L::select(L::notEqual(det, zero), L::div(one, det), zero);
+
+        L::Type r[16] = {L::mul(c00, s), L::mul(c10, s), L::mul(c20, s), zero,
+                         L::mul(c01, s), L::mul(c11, s), L::mul(c21, s), zero,
+                         L::mul(c02, s), L::mul(c12, s), L::mul(c22, s), zero,
+                         zero,           zero,           zero,           one};
+        for (int row = 0; row < 3; ++row) {
+            const L::Type t = L::add(L::mul(r[row], m[12]), L::mul(r[4 + row], m[13]));
+            r[12 + row] = L::neg(L::add(t, L::mul(r[8 + row], m[14])));
+        }
+        L::storeMatrices([&](size_t j) { return result[i + j].data(); }, r);
+    }
+#endif
+    for (; i < count; ++i)
+        result[i] = affineInverse(matrices[i]);
+}
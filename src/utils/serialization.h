@@ -8,24 +8,454 @@
 #include <cereal/types/array.hpp>
 #include <cereal/types/map.hpp>
 #include <cereal/types/memory.hpp>
+#include <cereal/types/set.hpp>
 #include <cereal/types/string.hpp>
+#include <cereal/types/utility.hpp>
 #include <cereal/types/vector.hpp>
 
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Blocks of bytes serialized apart from the archive, in serialization order
+ */
+using SerializedBlocks = std::vector<std::pair<const void*, size_t>>;
+
+namespace cereal {
+
+/**
+ * @brief Binary archive written into a preallocated buffer
+ *
+ * The bytes are those of BinaryOutputArchive, except for binary blocks of at least
+ * outOfBandSize bytes, e.g. large vectors, which are left out of the buffer and only listed.
+ * Without a buffer the archive only measures its size.
+ */
+class BufferOutputArchive : public OutputArchive<BufferOutputArchive, AllowEmptyClassElision>
+{
+  public:
+    /**
+     * @brief Construct a new Buffer Output Archive object
+     *
+     * @param data - buffer of size() bytes, null to measure the archive
+     * @param outOfBandSize - smallest block left out of the buffer
+     * @param blocks - left out blocks, appended to if not null
+     */
+    BufferOutputArchive(uint8_t* data,
+                        size_t outOfBandSize = std::numeric_limits<size_t>::max(),
+                        SerializedBlocks* blocks = nullptr)
+        : OutputArchive<BufferOutputArchive, AllowEmptyClassElision>(this), _data(data),
+          _size(0), _outOfBandSize(outOfBandSize), _blocks(blocks)
+    {
+    }
+
+    /// bytes written to the buffer
+    size_t size() const { return _size; }
+
+    /// write a block of bytes
+    void saveBinary(const void* data, std::streamsize size)
+    {
+        if (size_t(size) >= _outOfBandSize) {
+            if (_blocks)
+                _blocks->emplace_back(data, size_t(size));
+            return;
+        }
+        if (_data)
+            std::memcpy(_data + _size, data, size_t(size));
+        _size += size_t(size);
+    }
+
+  private:
+    uint8_t* _data;
+    size_t _size;
+    size_t _outOfBandSize;
+    SerializedBlocks* _blocks;
+};
+
+/**
+ * @brief Binary archive read from a buffer and out-of-band blocks of BufferOutputArchive
+ */
+class BufferInputArchive : public InputArchive<BufferInputArchive, AllowEmptyClassElision>
+{
+  public:
+    /**
+     * @brief Construct a new Buffer Input Archive object
+     *
+     * @param data - archive bytes
+     * @param size - number of bytes
+     * @param outOfBandSize - smallest block left out of the buffer
+     * @param blocks - left out blocks
+     */
+    BufferInputArchive(const uint8_t* data, size_t size,
+                       size_t outOfBandSize = std::numeric_limits<size_t>::max(),
+                       const SerializedBlocks* blocks = nullptr)
+        : InputArchive<BufferInputArchive, AllowEmptyClassElision>(this), _data(data),
+          _size(size), _offset(0), _outOfBandSize(outOfBandSize), _blocks(blocks), _block(0)
+    {
+    }
+
+    /// read a block of bytes
+    void loadBinary(void* data, std::streamsize size)
+    {
+        if (size_t(size) >= _outOfBandSize) {
+            if (!_blocks || _block >= _blocks->size() || (*_blocks)[_block].second != size_t(size))
+                throw Exception("BufferInputArchive: missing out-of-band block");
+            std::memcpy(data, (*_blocks)[_block++].first, size_t(size));
+            return;
+        }
+        if (size_t(size) > _size - _offset)
+            throw Exception("BufferInputArchive: read past the end of the buffer");
+        std::memcpy(data, _data + _offset, size_t(size));
+        _offset += size_t(size);
+    }
+
+  private:
+    const uint8_t* _data;
+    size_t _size;
+    size_t _offset;
+    size_t _outOfBandSize;
+    const SerializedBlocks* _blocks;
+    size_t _block; //<- next out-of-band block
+};
+
+// same layout as the binary archives
 
 template <class T>
-inline std::string BinarySerialize(const T& object)
+inline typename std::enable_if<std::is_arithmetic<T>::value, void>::type
+    CEREAL_SAVE_FUNCTION_NAME(BufferOutputArchive& ar, const T& t)
 {
-    std::ostringstream ss;
-    cereal::BinaryOutputArchive archive{ss};
+    ar.saveBinary(std::addressof(t), sizeof(t));
+}
+
+template <class T>
+inline typename std::enable_if<std::is_arithmetic<T>::value, void>::type
+    CEREAL_LOAD_FUNCTION_NAME(BufferInputArchive& ar, T& t)
+{
+    ar.loadBinary(std::addressof(t), sizeof(t));
+}
+
+template <class Archive, class T>
+inline CEREAL_ARCHIVE_RESTRICT(BufferInputArchive, BufferOutputArchive)
+    CEREAL_SERIALIZE_FUNCTION_NAME(Archive& ar, NameValuePair<T>& t)
+{
+    ar(t.value);
+}
+
+template <class Archive, class T>
+inline CEREAL_ARCHIVE_RESTRICT(BufferInputArchive, BufferOutputArchive)
+    CEREAL_SERIALIZE_FUNCTION_NAME(Archive& ar, SizeTag<T>& t)
+{
+    ar(t.size);
+}
+
+template <class T>
+inline void CEREAL_SAVE_FUNCTION_NAME(BufferOutputArchive& ar, const BinaryData<T>& bd)
+{
+    ar.saveBinary(bd.data, static_cast<std::streamsize>(bd.size));
+}
+
+template <class T>
+inline void CEREAL_LOAD_FUNCTION_NAME(BufferInputArchive& ar, BinaryData<T>& bd)
+{
+    ar.loadBinary(bd.data, static_cast<std::streamsize>(bd.size));
+}
+
+} // namespace cereal
+
+CEREAL_REGISTER_ARCHIVE(cereal::BufferOutputArchive)
+CEREAL_REGISTER_ARCHIVE(cereal::BufferInputArchive)
+CEREAL_SETUP_ARCHIVE_TRAITS(cereal::BufferInputArchive, cereal::BufferOutputArchive)
+
+/**
+ * @brief Save a vector of trivially copyable elements as one binary block
+ *
+ * The bytes are those of the element by element cereal binary layout, while the block may be
+ * serialized out of band by buffer archives.
+ */
+template <class Archive, class T>
+inline void saveBlock(Archive& ar, const std::vector<T>& values)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "saveBlock: elements must be PODs");
+    ar(cereal::make_size_tag(static_cast<cereal::size_type>(values.size())));
+    ar(cereal::binary_data(values.data(), values.size() * sizeof(T)));
+}
+
+/** @overload */
+template <class Archive, class T>
+inline void loadBlock(Archive& ar, std::vector<T>& values)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "loadBlock: elements must be PODs");
+    cereal::size_type size;
+    ar(cereal::make_size_tag(size));
+    values.resize(static_cast<size_t>(size));
+    ar(cereal::binary_data(values.data(), values.size() * sizeof(T)));
+}
+
+/**
+ * @brief Size of the buffer of an object serialized with BinarySerializeInto
+ *
+ * @param object - object to serialize
+ * @param outOfBandSize - smallest block left out of the buffer
+ * @param blocks - left out blocks, pointing into \p object, appended to if not null
+ */
+template <class T>
+inline size_t BinarySerializedSize(const T& object,
+                                   size_t outOfBandSize = std::numeric_limits<size_t>::max(),
+                                   SerializedBlocks* blocks = nullptr)
+{
+    cereal::BufferOutputArchive archive{nullptr, outOfBandSize, blocks};
     archive(object);
-    return ss.str();
+    return archive.size();
 }
 
+/**
+ * @brief Serialize an object into a buffer of BinarySerializedSize bytes
+ */
 template <class T>
-inline void BinaryDeserialize(const std::string& buffer, T& object)
+inline void BinarySerializeInto(const T& object, uint8_t* data,
+                                size_t outOfBandSize = std::numeric_limits<size_t>::max())
+{
+    cereal::BufferOutputArchive archive{data, outOfBandSize};
+    archive(object);
+}
+
+/**
+ * @brief Deserialize an object from a buffer and the blocks left out of it
+ *
+ * @throw cereal::Exception - if the buffer or blocks are too short
+ */
+template <class T>
+inline void BinaryDeserializeFrom(const uint8_t* data, size_t size, T& object,
+                                  size_t outOfBandSize = std::numeric_limits<size_t>::max(),
+                                  const SerializedBlocks* blocks = nullptr)
 {
-    std::istringstream ss{buffer};
-    cereal::BinaryInputArchive archive{ss};
+    cereal::BufferInputArchive archive{data, size, outOfBandSize, blocks};
     archive(object);
 }
+
+template <class T>
+inline std::string BinarySerialize(const T& object)
+{
+    std::string buffer(BinarySerializedSize(object), '\0');
+    BinarySerializeInto(object, reinterpret_cast<uint8_t*>(&buffer[0]));
+    return buffer;
+}
+
+template <class T>
+inline void BinaryDeserialize(const std::string& buffer, T& object)
+{
+    BinaryDeserializeFrom(reinterpret_cast<const uint8_t*>(buffer.data()), buffer.size(),
+                          object);
+}
+
+// compact encodings of streamed values, see scene::SceneStateEncoder
+
+/**
+ * @brief Append an unsigned integer as a LEB128 varint, 7 bits per byte
+ */
+inline void writeVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+/**
+ * @brief Read a varint written by writeVarint
+ *
+ * @param data - read position, advanced past the varint
+ * @param end - end of the buffer
+ * @throw cereal::Exception - if the varint is truncated or too long
+ */
+inline uint64_t readVarint(const uint8_t*& data, const uint8_t* end)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (data == end)
+            throw cereal::Exception("readVarint: truncated varint");
+        const uint8_t byte = *data++;
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    throw cereal::Exception("readVarint: varint too long");
+}
+
+/**
+ * @brief Map a signed integer to an unsigned one with small magnitudes kept small
+ */
+inline uint64_t zigzagEncode(int64_t value)
+{
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+/** @overload */
+inline int64_t zigzagDecode(uint64_t value)
+{
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+/**
+ * @brief Append the raw bytes of trivially copyable values, in host (little-endian) order
+ */
+template <class T>
+inline void writeRaw(std::vector<uint8_t>& out, const T& value)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "writeRaw: value must be a POD");
+    const auto bytes = reinterpret_cast<const uint8_t*>(std::addressof(value));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+/**
+ * @brief Read values written by writeRaw
+ *
+ * @throw cereal::Exception - if the buffer is too short
+ */
+template <class T>
+inline void readRaw(const uint8_t*& data, const uint8_t* end, T& value)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "readRaw: value must be a POD");
+    if (size_t(end - data) < sizeof(T))
+        throw cereal::Exception("readRaw: truncated value");
+    std::memcpy(std::addressof(value), data, sizeof(T));
+    data += sizeof(T);
+}
+
+/**
+ * @brief IEEE half precision bits of a float, rounded to nearest even
+ *
+ * Values beyond the half range become infinities, NaNs stay NaNs.
+ */
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    const uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+    const uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff) // infinity or NaN
+        return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    const int halfExponent = int(exponent) - 127 + 15;
+    if (halfExponent >= 0x1f) // overflow
+        return uint16_t(sign | 0x7c00);
+    if (halfExponent <= 0) { // subnormal or zero
+        if (halfExponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        const int shift = 14 - halfExponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            ++half;
+        return uint16_t(sign | half);
+    }
+    uint32_t half = (uint32_t(halfExponent) << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1fff;
+    // a carry into the exponent rounds up to the next power of two, or infinity
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        ++half;
+    return uint16_t(sign | half);
+}
+
+/**
+ * @brief Float value of IEEE half precision bits
+ */
+inline float halfToFloat(uint16_t half)
+{
+    const uint32_t sign = uint32_t(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        }
+        else { // normalize the subnormal
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+        }
+    }
+    else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return value;
+}
+
+/**
+ * @brief Pack a unit quaternion into 48 bits with the smallest three method
+ *
+ * The largest component is dropped, its index kept in 2 bits and its sign made positive, the
+ * three others, within +-1/sqrt(2), are stored on 15 bits each: about 4e-5 of error.
+ *
+ * @param quat - rotation, any component order, normalized before packing
+ * @return Packed bits, the lowest 48 ones used
+ */
+inline uint64_t packQuaternion(const std::array<float, 4>& quat)
+{
+    constexpr double kRange = 0.70710678118654752440; //<- 1/sqrt(2)
+    constexpr double kSteps = (1 << 15) - 1;
+
+    double norm = 0;
+    int largest = 0;
+    for (int i = 0; i < 4; ++i) {
+        norm += double(quat[i]) * quat[i];
+        if (std::abs(quat[i]) > std::abs(quat[largest]))
+            largest = i;
+    }
+    norm = std::sqrt(norm);
+    if (norm == 0)
+        return packQuaternion({1, 0, 0, 0});
+    const double scale = (quat[largest] < 0 ? -1 : 1) / norm;
+
+    uint64_t bits = uint64_t(largest);
+    for (int i = 0; i < 4; ++i) {
+        if (i == largest)
+            continue;
+        const double value = std::min(std::max(quat[i] * scale, -kRange), kRange);
+        bits = (bits << 15) | uint64_t(std::lround((value / kRange + 1) * 0.5 * kSteps));
+    }
+    return bits;
+}
+
+/**
+ * @brief Unit quaternion of bits packed by packQuaternion
+ */
+inline std::array<float, 4> unpackQuaternion(uint64_t bits)
+{
+    constexpr double kRange = 0.70710678118654752440;
+    constexpr double kSteps = (1 << 15) - 1;
+
+    const int largest = int((bits >> 45) & 3);
+    std::array<float, 4> quat;
+    double sum = 0;
+    for (int i = 3, shift = 0; i >= 0; --i) {
+        if (i == largest)
+            continue;
+        const double value = (double((bits >> shift) & 0x7fff) / kSteps * 2 - 1) * kRange;
+        quat[i] = float(value);
+        sum += value * value;
+        shift += 15;
+    }
+    quat[largest] = float(std::sqrt(std::max(0., 1 - sum)));
+    return quat;
+}
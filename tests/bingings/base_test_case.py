@@ -5,6 +5,7 @@ import pybullet as pb
 import pybullet_data
 from pybullet_utils.bullet_client import BulletClient
 
+import pybullet_rendering as pr
 from pybullet_rendering import RenderingPlugin, BaseRenderer
 
 __all__ = ['BaseTestCase']
@@ -16,6 +17,7 @@ class RendererMock(BaseRenderer):
         super().__init__()
         self.scene_graph = None
         self.materials_only = None
+        self.scene_delta = None
         self.scene_state = None
         self.scene_view = None
         self.render_frame_fn = None
@@ -24,6 +26,10 @@ class RendererMock(BaseRenderer):
         self.scene_graph = scene_graph
         self.materials_only = materials_only
 
+    def apply_scene_delta(self, scene_graph, delta):
+        self.scene_delta = delta
+        super().apply_scene_delta(scene_graph, delta)
+
     def render_frame(self, scene_state, scene_view, frame):
         self.scene_state = scene_state
         self.scene_view = scene_view
@@ -44,3 +50,18 @@ class BaseTestCase(unittest.TestCase):
     def tearDown(self):
         self.plugin.unload()
         self.client.disconnect()
+
+    def egl_renderer(self, set_renderer=True, **kwargs):
+        """EGL renderer made with kwargs, the renderer of the plugin if set_renderer.
+
+        Skips the test if the build or the machine has no EGL.
+        """
+        if not hasattr(pr, 'EGLRenderer'):
+            self.skipTest('built without --with-egl')
+        try:
+            renderer = pr.EGLRenderer(**kwargs)
+        except RuntimeError as error:
+            self.skipTest(str(error))
+        if set_renderer:
+            self.plugin.set_renderer(renderer)
+        return renderer
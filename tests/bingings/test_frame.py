@@ -1,8 +1,20 @@
 import numpy as np
+import os
 import pickle
+import tempfile
+import time
+import unittest
 
-from pybullet_rendering import LightType
-from .base_test_case import BaseTestCase
+import pybullet as pb
+import pybullet_data
+from pybullet_utils.bullet_client import BulletClient
+
+import pybullet_rendering as pr
+from pybullet_rendering import (ColorFormat, DepthFormat, LightType, MaskFormat, OutputChannel,
+                                PointFrame, Projection, Quality, SceneState, SensorNoise,
+                                TextureFilter)
+from pybullet_rendering.bindings import Camera, SceneView
+from .base_test_case import BaseTestCase, RendererMock
 
 
 class FrameTest(BaseTestCase):
@@ -41,3 +53,1494 @@ class FrameTest(BaseTestCase):
         np.testing.assert_almost_equal(color, color_img)
         np.testing.assert_almost_equal(depth, depth_img)
         np.testing.assert_almost_equal(mask, mask_img)
+
+    def test_frame_planes(self):
+        width, height = 16, 8
+        color_img = self.random.randint(0, 255, size=(height, width, 4), dtype=np.uint8)
+
+        def render_frame_fn(frame):
+            color, depth, mask = frame.planes
+            self.assertTrue(np.shares_memory(color, frame.color_img))
+            self.assertTrue(color.flags.writeable)
+            np.copyto(color, color_img)
+            depth.fill(2.0)
+            mask.fill(7)
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+
+        _, _, color, depth, mask = self.client.getCameraImage(width, height)
+        np.testing.assert_equal(color, color_img)
+        np.testing.assert_equal(depth, 2.0)
+        np.testing.assert_equal(mask, 7)
+
+    def test_steady_frames_reuse_wrappers(self):
+        frames = []
+
+        def render_frame_fn(frame):
+            frames.append((frame, frame.planes))
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+
+        for _ in range(3):
+            self.client.getCameraImage(16, 8)
+        self.assertEqual(len(frames), 3)
+        for frame, planes in frames[1:]:
+            self.assertIs(frame, frames[0][0])
+            self.assertIs(planes, frames[0][1])
+
+        # new buffers, new wrappers
+        self.client.getCameraImage(32, 8)
+        self.assertIsNot(frames[-1][0], frames[0][0])
+        self.assertEqual(frames[-1][1][0].shape, (8, 32, 4))
+
+    def test_convert_in_place(self):
+        width, height = 16, 8
+        zbuffer = self.random.random_sample((height, width)).astype(np.float32)
+        zbuffer[0, :] = 1.0
+        mask_rgb = self.random.randint(0, 255, size=(height, width, 3), dtype=np.uint8)
+
+        def render_frame_fn(frame):
+            pr.bindings.depth_from_zbuffer(zbuffer, 0.1, 10.0, out=frame.depth_img)
+            pr.bindings.rgb_to_mask(mask_rgb, out=frame.mask_img)
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+
+        _, _, _, depth, mask = self.client.getCameraImage(width, height)
+        expected = 0.1 * 10.0 / (10.0 - zbuffer * (10.0 - 0.1))
+        expected[0, :] = 0.0
+        np.testing.assert_allclose(depth, expected, rtol=1e-5)
+        np.testing.assert_equal(mask, np.dot(mask_rgb, np.int32([1, 1 << 8, 1 << 24])) - 1)
+        with self.assertRaises(ValueError):
+            pr.bindings.rgb_to_mask(mask_rgb, out=np.zeros((height, width), np.int64))
+
+    def test_encoded_camera_image(self):
+        width, height = 32, 24
+        color = self.random.randint(0, 255, size=(height, width, 4), dtype=np.uint8)
+        depth = self.random.random_sample((height, width)).astype(np.float32)
+        mask = np.full((height, width), -1, np.int32)
+        mask[4:12, 8:20] = 1 + (2 << 24)
+
+        def render_frame_fn(frame):
+            np.copyto(frame.color_img, color)
+            np.copyto(frame.depth_img, depth)
+            if frame.mask_img is not None:
+                np.copyto(frame.mask_img, mask)
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+
+        # the encoded frame fits in the first request, or takes a second one
+        for num_pixels, flags in ((None, 0), (1, 0), (1, pb.ER_NO_SEGMENTATION_MASK)):
+            w, h, rgba, z, seg = pr.get_encoded_camera_image(
+                self.plugin._plugin_id, width, height, self.client._client,
+                num_pixels=num_pixels, flags=flags)
+            self.assertEqual((w, h), (width, height))
+            np.testing.assert_equal(rgba, color)
+            np.testing.assert_equal(z, depth)
+            if flags:
+                self.assertIsNone(seg)
+            else:
+                np.testing.assert_equal(seg, mask)
+
+        # plain requests are not affected
+        _, _, rgba, _, _ = self.client.getCameraImage(width, height)
+        np.testing.assert_equal(np.reshape(rgba, (height, width, 4)), color)
+
+        encoded = pr.bindings.encode_frame(color, depth)
+        self.assertLess(len(encoded), color.nbytes + depth.nbytes + 64)
+        rgba, z, seg = pr.bindings.decode_frame(encoded)
+        np.testing.assert_equal(z, depth)
+        self.assertIsNone(seg)
+
+    def test_bulk_camera_image(self):
+        width, height = 32, 24
+        color = self.random.randint(0, 255, size=(height, width, 4), dtype=np.uint8)
+
+        def render_frame_fn(frame):
+            np.copyto(frame.color_img, color)
+            frame.depth_img[:] = 2
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+
+        transfer = pr.BulkCameraTransfer(self.plugin._plugin_id, width, height,
+                                         physicsClientId=self.client._client)
+        for flags in (0, pb.ER_NO_SEGMENTATION_MASK):
+            w, h, rgba, z, seg = transfer.get_camera_image(flags=flags)
+            self.assertEqual((w, h), (width, height))
+            np.testing.assert_equal(rgba, color)
+            np.testing.assert_equal(z, 2)
+            self.assertEqual(seg is None, bool(flags))
+        self.assertEqual(transfer.ring.latest, 2)
+
+        # the requested size is ignored until the transfer is closed
+        _, _, rgba, _, _ = self.client.getCameraImage(width, height)
+        self.assertEqual(np.asarray(rgba, np.uint8).reshape(-1)[:4].view(np.uint32)[0], 3)
+        transfer.close()
+        _, _, rgba, _, _ = self.client.getCameraImage(width, height)
+        np.testing.assert_equal(np.reshape(rgba, (height, width, 4)), color)
+
+    def test_render_cameras(self):
+        width, height, num_views = 16, 8, 3
+        views = []
+
+        def render_frame_fn(frame):
+            views.append(self.render.scene_view)
+            frame.depth_img[:] = len(views)
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+
+        view_matrices = [self.random.random_sample(16) for _ in range(num_views)]
+        proj_matrices = [self.random.random_sample(16) for _ in range(num_views)]
+        color, depth, mask = self.plugin.render_cameras(
+            width, height, view_matrices, proj_matrices)
+        self.assertEqual(color.shape, (num_views, height, width, 4))
+        self.assertEqual(depth.shape, (num_views, height, width))
+        self.assertEqual(mask.shape, (num_views, height, width))
+        self.assertEqual(len(views), num_views)
+        for i, view in enumerate(views):
+            np.testing.assert_almost_equal(depth[i], i + 1)
+            self.assertEqual(view.viewport, [width, height])
+            np.testing.assert_almost_equal(
+                view.camera.view_matrix, view_matrices[i].reshape(4, 4))
+            np.testing.assert_almost_equal(
+                view.camera.projection_matrix, proj_matrices[i].reshape(4, 4))
+
+    def test_render_cameras_failed_request(self):
+        width, height = 16, 8
+        frames = []
+
+        def render_frame_fn(frame):
+            frames.append(frame.depth_img.shape)
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        view_matrices = [self.random.random_sample(16) for _ in range(2)]
+        proj_matrices = [self.random.random_sample(16) for _ in range(2)]
+        with self.assertRaises(TypeError):
+            self.plugin.render_cameras(width, height, view_matrices, proj_matrices,
+                                       unknown_argument=1)
+        # the batch was cleared, the next request renders its own image
+        self.client.getCameraImage(width, height)
+        self.assertEqual(frames, [(height, width)])
+
+    def test_render_camera(self):
+        width, height = 16, 8
+        views = []
+
+        def render_frame_fn(frame):
+            views.append(self.render.scene_view)
+            frame.depth_img[:] = 2
+            frame.mask_img[:] = 5
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+
+        view_matrix = self.random.random_sample(16)
+        proj_matrix = self.random.random_sample(16)
+        color, depth, mask = self.plugin.render_camera(width, height, view_matrix, proj_matrix)
+        self.assertEqual(len(views), 1)
+        self.assertEqual(views[0].viewport, [width, height])
+        np.testing.assert_almost_equal(views[0].camera.view_matrix, view_matrix.reshape(4, 4))
+        np.testing.assert_almost_equal(
+            views[0].camera.projection_matrix, proj_matrix.reshape(4, 4))
+        # the same images as a request with these matrices
+        _, _, _, request_depth, request_mask = self.client.getCameraImage(
+            width, height, viewMatrix=view_matrix, projectionMatrix=proj_matrix)
+        np.testing.assert_almost_equal(depth, np.reshape(request_depth, (height, width)))
+        np.testing.assert_equal(mask, np.reshape(request_mask, (height, width)))
+
+        # into arrays of the caller, channels of None skipped
+        color = np.zeros((height, width, 4), np.uint8)
+        depth = np.zeros((height, width), np.float32)
+        result = self.plugin.render_camera(width, height, view_matrix, proj_matrix,
+                                           out=(color, depth, None))
+        self.assertIs(result[0], color)
+        self.assertIsNone(result[2])
+        np.testing.assert_almost_equal(depth, 2)
+
+        # the async renderer would write the frame of an earlier request
+        rendered = len(views)
+        self.plugin.configure('async', 1)
+        try:
+            with self.assertRaises(RuntimeError):
+                self.plugin.render_camera(width, height, view_matrix, proj_matrix)
+            self.assertEqual(len(views), rendered)
+        finally:
+            self.plugin.configure('async', 0)
+
+    def test_render_batch(self):
+        width, height = 16, 8
+        other_client = BulletClient(pb.DIRECT)
+        other_render = RendererMock()
+        other_plugin = pr.RenderingPlugin(other_client, other_render)
+        self.addCleanup(other_client.disconnect)
+        self.addCleanup(other_plugin.unload)
+
+        def depth_fn(value):
+            def render_frame_fn(frame):
+                self.assertIsNone(frame.mask_img)
+                frame.depth_img[:] = value
+                return True
+            return render_frame_fn
+
+        self.render.render_frame_fn = depth_fn(1.0)
+        other_render.render_frame_fn = depth_fn(2.0)
+
+        # cameras of a client spread over the batch are scattered back in order
+        client_ids = [self.client._client, other_client._client, self.client._client]
+        view_matrices = [self.random.random_sample(16) for _ in range(3)]
+        proj_matrices = [self.random.random_sample(16) for _ in range(3)]
+        channels = int(OutputChannel.Color) | int(OutputChannel.Depth)
+        color, depth, mask = pr.render_batch(client_ids, view_matrices, proj_matrices,
+                                             (width, height), channels)
+        self.assertIsNone(mask)
+        self.assertEqual(color.shape, (3, height, width, 4))
+        np.testing.assert_almost_equal(depth[:, 0, 0], [1.0, 2.0, 1.0])
+        np.testing.assert_almost_equal(other_render.scene_view.camera.view_matrix,
+                                       view_matrices[1].reshape(4, 4))
+
+        # caller buffers are written in place
+        out_depth = np.zeros((3, height, width), np.float32)
+        _, result, _ = pr.render_batch(client_ids, view_matrices, proj_matrices,
+                                       (width, height), int(OutputChannel.Depth),
+                                       out=(None, out_depth, None))
+        self.assertIs(result, out_depth)
+        np.testing.assert_almost_equal(out_depth[:, -1, -1], [1.0, 2.0, 1.0])
+
+    def test_async_mode(self):
+        width, height = 16, 8
+        depth_img = self.random.random_sample((height, width)).astype(np.float32)
+
+        def render_frame_fn(frame):
+            frame.depth_img[:] = depth_img
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        self.plugin.set_async(True)
+
+        # no frame completed yet
+        w, h, _, _, _ = self.client.getCameraImage(width, height)
+        self.assertEqual((w, h), (0, 0))
+
+        for _ in range(100):
+            time.sleep(0.01)
+            w, h, _, depth, _ = self.client.getCameraImage(width, height)
+            if (w, h) == (width, height):
+                break
+        self.assertEqual((w, h), (width, height))
+        np.testing.assert_almost_equal(depth, depth_img)
+
+    def test_async_stop(self):
+        started, finished = [], []
+
+        def render_frame_fn(frame):
+            started.append(frame)
+            time.sleep(0.1)
+            finished.append(frame)
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        self.plugin.set_async(True)
+        self.client.getCameraImage(16, 8)
+        for _ in range(100):
+            if started:
+                break
+            time.sleep(0.01)
+        self.assertTrue(started)
+
+        # the render thread is joined, its python render completing without deadlock
+        self.plugin.set_async(False)
+        self.assertEqual(len(finished), len(started))
+
+    def test_async_poses(self):
+        body_ids = [
+            self.client.loadURDF("cube_small.urdf", basePosition=(0, i, 1)) for i in range(8)
+        ]
+        torn = []
+
+        def render_frame_fn(frame):
+            # all bodies of a frame are at the position of the same request
+            xs = self.render.scene_state.origins[:, 0]
+            if np.ptp(xs) > 1e-6:
+                torn.append(xs)
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        self.plugin.set_async(True)
+        for step in range(200):
+            for i, body_id in enumerate(body_ids):
+                self.client.resetBasePositionAndOrientation(body_id, (step * 0.01, i, 1),
+                                                            (0, 0, 0, 1))
+            self.client.getCameraImage(8, 8)
+        self.assertEqual(torn, [])
+
+    def test_frame_cache(self):
+        width, height = 16, 8
+        depth_img = self.random.random_sample((height, width)).astype(np.float32)
+        calls = []
+
+        def render_frame_fn(frame):
+            calls.append(frame)
+            frame.depth_img[:] = depth_img
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        self.plugin.set_frame_cache(True)
+
+        view_matrix = self.random.random_sample(16)
+        for _ in range(2):
+            w, h, _, depth, _ = self.client.getCameraImage(width, height, viewMatrix=view_matrix)
+            self.assertEqual((w, h), (width, height))
+            np.testing.assert_almost_equal(depth, depth_img)
+        self.assertEqual(len(calls), 1)
+        self.assertEqual(self.plugin.frame_cache_stats, (1, 1))
+
+        # another camera
+        self.client.getCameraImage(width, height, viewMatrix=self.random.random_sample(16))
+        self.assertEqual(len(calls), 2)
+        self.assertEqual(self.plugin.frame_cache_stats, (1, 2))
+
+    def test_output_channels(self):
+        width, height = 16, 8
+        frames = []
+
+        def render_frame_fn(frame):
+            frames.append((self.render.scene_view.output_channels, frame.mask_img))
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+
+        self.client.getCameraImage(width, height)
+        self.client.getCameraImage(width, height, flags=self.client.ER_NO_SEGMENTATION_MASK)
+        (channels, mask_img), (channels_no_mask, no_mask_img) = frames
+        self.assertEqual(channels, OutputChannel.Color | OutputChannel.Depth | OutputChannel.Mask)
+        self.assertEqual(mask_img.shape, (height, width))
+        self.assertEqual(channels_no_mask, OutputChannel.Color | OutputChannel.Depth)
+        self.assertIsNone(no_mask_img)
+
+    def test_mask_only(self):
+        width, height = 16, 8
+        frames = []
+
+        def render_frame_fn(frame):
+            frames.append((self.render.scene_view.output_channels, frame.planes))
+            if frame.color_img is not None:
+                frame.color_img[:] = 200
+                frame.depth_img[:] = 0.5
+            frame.mask_img[:] = 7
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        self.client.getCameraImage(width, height)
+        self.plugin.configure('channels', int(OutputChannel.Mask))
+        self.assertEqual(self.plugin.config('channels'), int(OutputChannel.Mask))
+        _, _, color, depth, mask = self.client.getCameraImage(width, height)
+        _, (channels, (color_img, depth_img, mask_img)) = frames
+        self.assertEqual(channels, int(OutputChannel.Mask))
+        self.assertIsNone(color_img)
+        self.assertIsNone(depth_img)
+        self.assertEqual(mask_img.shape, (height, width))
+        np.testing.assert_equal(np.reshape(mask, (height, width)), 7)
+        # no color nor depth of the previous image next to the mask
+        np.testing.assert_equal(np.reshape(color, (height, width, 4)), 0)
+        np.testing.assert_equal(np.reshape(depth, (height, width)), 1.0)
+
+    def test_panorama_faces(self):
+        size = 8
+        views = []
+
+        def render_frame_fn(frame):
+            # each face is a perspective frame, filled with its index
+            face = len(views)
+            views.append((self.render.scene_view.projection,
+                          np.array(self.render.scene_view.camera.view_matrix)))
+            self.assertEqual(frame.color_img.shape, (size, size, 4))
+            frame.color_img[:] = face
+            frame.depth_img[:] = 1.0
+            frame.mask_img[:] = face
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+
+        self.plugin.set_projection(Projection.Cubemap)
+        w, h, color, depth, mask = self.client.getCameraImage(size, size * 6)
+        self.assertEqual((w, h), (size, size * 6))
+        self.assertEqual(len(views), 6)
+        self.assertTrue(all(projection == Projection.Perspective for projection, _ in views))
+        self.assertFalse(np.allclose(views[0][1], views[1][1]))
+        for face in range(6):
+            np.testing.assert_equal(mask[face * size:(face + 1) * size], face)
+            np.testing.assert_equal(color[face * size:(face + 1) * size], face)
+
+        # front face in the middle, back one on the sides, up and down faces at the poles
+        views.clear()
+        self.plugin.set_projection(Projection.Equirectangular)
+        w, h, color, depth, mask = self.client.getCameraImage(64, 32)
+        self.assertEqual((w, h), (64, 32))
+        self.assertEqual(len(views), 6)
+        self.assertEqual((mask[16, 32], mask[16, 48], mask[16, 0], mask[16, 16]), (0, 1, 2, 3))
+        self.assertEqual((mask[0, 32], mask[31, 32]), (4, 5))
+        # distance to the camera of a metric depth of 1 along the face axes
+        self.assertAlmostEqual(depth[16, 32], 1.0, places=2)
+        self.assertTrue(np.all((depth >= 1.0) & (depth <= np.sqrt(3.0) + 1e-5)))
+
+        self.plugin.set_projection(Projection.Perspective)
+        views.clear()
+        self.client.getCameraImage(16, 8)
+        self.assertEqual(views[0][0], Projection.Perspective)
+
+    def test_points(self):
+
+        def render_frame_fn(frame):
+            # a wall at a depth of 2 on the left half
+            frame.depth_img[:] = 0.0
+            frame.depth_img[:, :4] = 2.0
+            frame.mask_img[:] = -1
+            frame.mask_img[:, :4] = 7
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(90, 2, 0.1, 10.0)
+        self.assertIsNone(self.plugin.get_points())
+
+        self.plugin.set_point_output()
+        self.client.getCameraImage(8, 4, view, proj)
+        self.assertTrue(self.render.scene_view.has_output_channel(OutputChannel.Points))
+        points, ids = self.plugin.get_points()
+        self.assertIsNone(ids)
+        self.assertEqual(points.shape, (4, 8, 3))
+        np.testing.assert_equal(points[:, 4:], 0.0)
+        np.testing.assert_almost_equal(points[:, :4, 2], -2.0)
+        # pixel centers through the 90 degrees vertical field of view, twice as wide
+        x = ((np.arange(8) + 0.5) / 8 * 2 - 1) * 2
+        y = 1 - (np.arange(4) + 0.5) / 4 * 2
+        np.testing.assert_almost_equal(points[0, :4, 0], x[:4] * 2.0, decimal=5)
+        np.testing.assert_almost_equal(points[:, 0, 1], y * 2.0, decimal=5)
+
+        # compact points in the world frame, 2 in front of the camera at z = 5
+        self.plugin.set_point_output(frame=PointFrame.World, compact=True)
+        self.client.getCameraImage(8, 4, view, proj)
+        world, ids = self.plugin.get_points()
+        self.assertEqual(world.shape, (16, 3))
+        np.testing.assert_equal(ids, 7)
+        np.testing.assert_almost_equal(world[:, 2], 3.0, decimal=5)
+        np.testing.assert_almost_equal(world[:, :2], points[:, :4, :2].reshape(-1, 2), decimal=5)
+
+        self.plugin.set_point_output(False)
+        self.client.getCameraImage(8, 4, view, proj)
+        self.assertIsNone(self.plugin.get_points())
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_points(self):
+        renderer = self.egl_renderer()
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        body_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+
+        # the front face of the box, at z = 0.5 in the world frame
+        self.plugin.set_point_output(frame=PointFrame.World, compact=True)
+        _, _, _, _, mask = self.client.getCameraImage(64, 48, view, proj)
+        points, ids = self.plugin.get_points()
+        self.assertEqual(len(points), np.count_nonzero(mask >= 0))
+        np.testing.assert_equal(ids, body_id)
+        np.testing.assert_almost_equal(points[:, 2], 0.5, decimal=4)
+        self.assertTrue(np.all(np.abs(points[:, :2]) <= 0.5 + 1e-4))
+        self.plugin.set_point_output(False)
+
+    def test_motion(self):
+
+        def render_frame_fn(frame):
+            # a wall at a depth of 2
+            frame.depth_img[:] = 2.0
+            frame.mask_img[:] = -1
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        proj = self.client.computeProjectionMatrixFOV(90, 2, 0.1, 10.0)
+
+        def view(x):
+            return self.client.computeViewMatrix((x, 0, 5), (x, 0, 0), (0, 1, 0))
+
+        self.client.getCameraImage(8, 4, view(0.0), proj)
+        self.assertIsNone(self.plugin.get_motion())
+
+        # the first image has no previous one
+        self.plugin.set_motion_output()
+        self.client.getCameraImage(8, 4, view(0.0), proj)
+        self.assertTrue(self.render.scene_view.has_output_channel(OutputChannel.Motion))
+        motion = self.plugin.get_motion()
+        self.assertEqual(motion.shape, (4, 8, 2))
+        self.assertEqual(motion.dtype, np.float16)
+        np.testing.assert_equal(motion, 0.0)
+
+        # the wall is 8 wide at a depth of 2, a pixel per unit: moving right shifts it left
+        self.client.getCameraImage(8, 4, view(0.5), proj)
+        motion = self.plugin.get_motion()
+        np.testing.assert_almost_equal(motion[..., 0], -0.5, decimal=3)
+        np.testing.assert_almost_equal(motion[..., 1], 0.0, decimal=3)
+
+        self.plugin.set_motion_output(False)
+        self.client.getCameraImage(8, 4, view(0.5), proj)
+        self.assertIsNone(self.plugin.get_motion())
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_motion(self):
+        renderer = self.egl_renderer()
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        body_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+
+        self.plugin.set_motion_output()
+        self.client.getCameraImage(64, 48, view, proj)
+        self.client.resetBasePositionAndOrientation(body_id, (0.5, 0, 0), (0, 0, 0, 1))
+        _, _, _, _, mask = self.client.getCameraImage(64, 48, view, proj)
+        motion = self.plugin.get_motion().astype(np.float32)
+
+        # the front face at a depth of 4.5 moved right by 0.5, 24 / (4.5 tan 30) pixels per unit
+        shift = 0.5 * 24 / (4.5 * np.tan(np.radians(30)))
+        drawn = mask == body_id
+        np.testing.assert_allclose(motion[drawn, 0], shift, atol=0.05)
+        np.testing.assert_allclose(motion[drawn, 1], 0.0, atol=0.05)
+        np.testing.assert_equal(motion[~drawn], 0.0)
+        self.plugin.set_motion_output(False)
+
+    def test_normals(self):
+
+        def render_frame_fn(frame):
+            # a wall at a depth of 2 on the left half, a farther one on the right half
+            frame.depth_img[:, :4] = 2.0
+            frame.depth_img[:, 4:] = 3.0
+            frame.mask_img[:, :4] = 7
+            frame.mask_img[:, 4:] = 8
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(90, 2, 0.1, 10.0)
+        self.assertIsNone(self.plugin.get_normals())
+
+        # both walls face the camera, the edge between them included
+        self.plugin.set_normal_output()
+        self.client.getCameraImage(8, 4, view, proj)
+        self.assertTrue(self.render.scene_view.has_output_channel(OutputChannel.Normals))
+        normals = self.plugin.get_normals()
+        self.assertEqual(normals.shape, (4, 8, 3))
+        self.assertEqual(normals.dtype, np.float16)
+        np.testing.assert_almost_equal(normals.reshape(-1, 3), [(0.0, 0.0, 1.0)] * 32, decimal=3)
+
+        self.plugin.set_normal_output(False)
+        self.client.getCameraImage(8, 4, view, proj)
+        self.assertIsNone(self.plugin.get_normals())
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_normals(self):
+        renderer = self.egl_renderer()
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        body_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+
+        # the front face of the box seen head on
+        self.plugin.set_normal_output()
+        _, _, _, _, mask = self.client.getCameraImage(64, 48, view, proj)
+        normals = self.plugin.get_normals().astype(np.float32)
+        drawn = mask == body_id
+        np.testing.assert_allclose(normals[drawn], [(0.0, 0.0, 1.0)] * np.count_nonzero(drawn),
+                                   atol=1e-3)
+        np.testing.assert_equal(normals[~drawn], 0.0)
+        self.plugin.set_normal_output(False)
+
+    def test_depth_pyramid(self):
+        depth_img = self.random.uniform(1.0, 4.0, size=(5, 8)).astype(np.float32)
+        depth_img[0, :3] = 0.0
+
+        def render_frame_fn(frame):
+            frame.depth_img[:] = depth_img
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(90, 8 / 5, 0.1, 10.0)
+        self.assertIsNone(self.plugin.get_depth_pyramid())
+
+        self.plugin.set_depth_pyramid_output(3)
+        self.client.getCameraImage(8, 5, view, proj)
+        self.assertTrue(self.render.scene_view.has_output_channel(OutputChannel.DepthPyramid))
+        levels = self.plugin.get_depth_pyramid()
+        self.assertEqual([level.shape for level in levels], [(3, 4, 2), (2, 2, 2), (1, 1, 2)])
+
+        # blocks from the bottom left corner, the background infinitely far
+        bottom_up = np.where(depth_img > 0, depth_img, np.inf)[::-1]
+        for shift, level in enumerate(levels, 1):
+            size = 1 << shift
+            for y in range(level.shape[0]):
+                for x in range(level.shape[1]):
+                    row = level.shape[0] - 1 - y
+                    block = bottom_up[row * size:(row + 1) * size, x * size:(x + 1) * size]
+                    np.testing.assert_equal(level[y, x], (block.min(), block.max()))
+        self.assertEqual(levels[0][0, 0, 1], np.inf)
+
+        self.plugin.set_depth_pyramid_output(0)
+        self.client.getCameraImage(8, 5, view, proj)
+        self.assertIsNone(self.plugin.get_depth_pyramid())
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_depth_pyramid(self):
+        renderer = self.egl_renderer()
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+
+        # the front face of the box at a depth of 4.5 over the background
+        self.plugin.set_depth_pyramid_output(2)
+        self.client.getCameraImage(64, 48, view, proj)
+        levels = self.plugin.get_depth_pyramid()
+        self.assertEqual([level.shape for level in levels], [(24, 32, 2), (12, 16, 2)])
+        for level in levels:
+            self.assertTrue(np.all(level[..., 0] <= level[..., 1]))
+            finite = level[np.isfinite(level)]
+            self.assertGreater(finite.size, 0)
+            np.testing.assert_allclose(finite, 4.5, atol=1e-3)
+            self.assertTrue(np.isinf(level[0, 0]).all())
+        self.plugin.set_depth_pyramid_output(0)
+
+    def test_events(self):
+        color_img = np.full((3, 4, 4), 100, np.uint8)
+
+        def render_frame_fn(frame):
+            frame.color_img[:] = color_img
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(90, 4 / 3, 0.1, 10.0)
+        self.assertIsNone(self.plugin.get_events())
+
+        # the first image only sets the reference
+        self.plugin.set_event_output(threshold=0.2, time_step=0.01)
+        self.client.getCameraImage(4, 3, view, proj)
+        self.assertTrue(self.render.scene_view.has_output_channel(OutputChannel.Events))
+        self.assertEqual(self.plugin.get_events().shape, (0, 4))
+
+        color_img[1, 2, :3] = 200
+        color_img[0, 0, :3] = 50
+        self.client.stepSimulation()
+        self.client.stepSimulation()
+        self.client.getCameraImage(4, 3, view, proj)
+        events = self.plugin.get_events()
+        np.testing.assert_equal(events[:, [0, 1, 3]], [(0, 0, -1), (0, 0, -1), (0, 0, -1),
+                                                       (2, 1, 1), (2, 1, 1), (2, 1, 1)])
+        # timed as the log luminance crosses each level over the two steps
+        for delta, times in ((np.log(51 / 101), events[:3, 2]), (np.log(201 / 101),
+                                                                  events[3:, 2])):
+            np.testing.assert_allclose(np.diff(times), 0.02 * 0.2 / abs(delta), rtol=1e-3)
+
+        # references moved by three thresholds, no events until they are crossed again
+        self.client.getCameraImage(4, 3, view, proj)
+        self.assertEqual(self.plugin.get_events().shape, (0, 4))
+
+        self.plugin.set_event_output(False)
+        self.client.getCameraImage(4, 3, view, proj)
+        self.assertIsNone(self.plugin.get_events())
+
+    def test_pixel_counts(self):
+        mask_img = np.full((3, 4), -1, np.int32)
+        mask_img[0, :3] = 7
+        mask_img[2, 1:] = 2
+
+        def render_frame_fn(frame):
+            frame.mask_img[:] = mask_img
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(90, 4 / 3, 0.1, 10.0)
+        self.assertIsNone(self.plugin.get_pixel_counts())
+
+        # counted on a scratch mask without the segmentation mask of the image
+        self.plugin.set_visibility_output()
+        self.client.getCameraImage(4, 3, view, proj, flags=pb.ER_NO_SEGMENTATION_MASK)
+        self.assertTrue(self.render.scene_view.has_output_channel(OutputChannel.Visibility))
+        self.assertFalse(self.render.scene_view.has_output_channel(OutputChannel.Mask))
+        np.testing.assert_equal(self.plugin.get_pixel_counts(), [(2, 3), (7, 3)])
+        np.testing.assert_equal(pr.count_mask_pixels(mask_img), [(2, 3), (7, 3)])
+        self.assertIsNone(self.plugin.get_boxes())
+
+        # boxes of the first and last columns and rows of each id, in the order of the counts
+        self.plugin.set_visibility_output(boxes=True)
+        self.client.getCameraImage(4, 3, view, proj)
+        self.assertTrue(self.render.scene_view.has_output_channel(OutputChannel.Boxes))
+        np.testing.assert_equal(self.plugin.get_boxes(), [(1, 2, 3, 2), (0, 0, 2, 0)])
+        counts, boxes = pr.count_mask_pixels(mask_img, boxes=True)
+        np.testing.assert_equal(counts, [(2, 3), (7, 3)])
+        np.testing.assert_equal(boxes, [(1, 2, 3, 2), (0, 0, 2, 0)])
+
+        self.plugin.set_visibility_output(False)
+        self.client.getCameraImage(4, 3, view, proj)
+        self.assertIsNone(self.plugin.get_pixel_counts())
+        self.assertIsNone(self.plugin.get_boxes())
+
+    def test_keypoints(self):
+        wall = [3.0]
+
+        def render_frame_fn(frame):
+            frame.depth_img[:] = wall[0]
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        body_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(90, 4 / 3, 0.1, 10.0)
+        self.client.getCameraImage(8, 6, view, proj)
+        self.assertIsNone(self.plugin.get_keypoints())
+
+        # the center of the top face and a point to its right, then one of an unknown body
+        count = self.plugin.set_keypoints([body_id, body_id, body_id + 1], [-1, -1, -1],
+                                          [(0, 0, 0.5), (3, 0, 0.5), (0, 0, 0)])
+        self.assertEqual(count, 3)
+        self.client.getCameraImage(8, 6, view, proj)
+        self.assertTrue(self.render.scene_view.has_output_channel(OutputChannel.Keypoints))
+        keypoints = self.plugin.get_keypoints()
+        self.assertEqual(keypoints.shape, (3, 4))
+        np.testing.assert_almost_equal(keypoints[:2, :3], [(4, 3, 4.5), (6, 3, 4.5)], decimal=4)
+        # hidden by the wall in front of them
+        np.testing.assert_equal(keypoints[:2, 3], 0)
+        self.assertTrue(np.all(np.isnan(keypoints[2, :3])))
+        self.assertEqual(keypoints[2, 3], 0)
+
+        # posed with their link
+        wall[0] = 4.5
+        self.client.resetBasePositionAndOrientation(body_id, (0, 1, 0), (0, 0, 0, 1))
+        self.client.getCameraImage(8, 6, view, proj)
+        keypoints = self.plugin.get_keypoints()
+        np.testing.assert_almost_equal(keypoints[0], (4, 3 - 3 / 4.5, 4.5, 1), decimal=4)
+
+        self.plugin.set_keypoints([], [], [])
+        self.client.getCameraImage(8, 6, view, proj)
+        self.assertIsNone(self.plugin.get_keypoints())
+
+    def test_roi(self):
+        shapes = []
+
+        def render_frame_fn(frame):
+            shapes.append(frame.color_img.shape)
+            frame.depth_img[:] = 2.0
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(90, 2, 0.1, 10.0)
+
+        # a region of 6 x 3 pixels at column 4, row 2, returned alone
+        self.plugin.set_roi(4, 2, 6, 3)
+        w, h, _, depth, _ = self.client.getCameraImage(16, 8, view, proj)
+        self.assertEqual((w, h), (6, 3))
+        self.assertEqual(shapes[-1], (3, 6, 4))
+        np.testing.assert_almost_equal(depth, 2.0)
+        scene_view = self.render.scene_view
+        self.assertTrue(scene_view.has_roi)
+        self.assertEqual(tuple(scene_view.roi), (4, 2, 6, 3))
+        self.assertEqual(tuple(scene_view.image_size), (6, 3))
+
+        # a point lands on the same pixel of the image and of the region, offset by its corner
+        def pixel(matrix, cols, rows):
+            clip = np.reshape(matrix, (4, 4)).T @ np.array([0.3, -0.2, -2.0, 1.0])
+            ndc = clip[:2] / clip[3]
+            return np.array([(ndc[0] + 1) / 2 * cols, (1 - ndc[1]) / 2 * rows])
+
+        roi_matrix = scene_view.image_camera.projection_matrix.ravel()
+        np.testing.assert_almost_equal(pixel(roi_matrix, 6, 3), pixel(proj, 16, 8) - (4, 2),
+                                       decimal=5)
+
+        # regions are clipped to the image, those of zero size render it whole
+        self.plugin.set_roi(12, 6, 10, 10)
+        w, h, _, _, _ = self.client.getCameraImage(16, 8, view, proj)
+        self.assertEqual((w, h), (4, 2))
+        self.plugin.set_roi()
+        w, h, _, _, _ = self.client.getCameraImage(16, 8, view, proj)
+        self.assertEqual((w, h), (16, 8))
+        self.assertEqual(shapes[-1], (8, 16, 4))
+        self.assertFalse(self.render.scene_view.has_roi)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_roi(self):
+        renderer = self.egl_renderer()
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        _, _, _, depth, mask = self.client.getCameraImage(64, 48, view, proj)
+
+        # only the region is rasterized, matching the crop of the whole image
+        self.plugin.set_roi(20, 10, 24, 16)
+        w, h, _, roi_depth, roi_mask = self.client.getCameraImage(64, 48, view, proj)
+        self.plugin.set_roi()
+        self.assertEqual((w, h), (24, 16))
+        same = roi_mask == mask[10:26, 20:44]
+        self.assertGreater(np.mean(same), 0.95)
+        np.testing.assert_almost_equal(roi_depth[same], depth[10:26, 20:44][same], decimal=3)
+
+    def test_formats(self):
+
+        def render_frame_fn(frame):
+            frame.color_img[:] = (10, 20, 30, 255)
+            frame.depth_img[:] = 1.25
+            frame.depth_img[0, 0] = 0.0
+            frame.mask_img[:] = 3 + (2 << 24)
+            frame.mask_img[0, 0] = -1
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        view = SceneView()
+        view.viewport = (8, 4)
+        view.camera = Camera(pb.computeViewMatrix((1, 0, 0), (0, 0, 0), (0, 0, 1)),
+                             pb.computeProjectionMatrixFOV(60, 2, 0.1, 10))
+        view.color_format = ColorFormat.RGB
+        view.depth_format = DepthFormat.UInt16
+        view.mask_format = MaskFormat.UInt16
+
+        # packed from the full planes written by the renderer
+        color, depth, mask = self.render.render_view(SceneState(), view)
+        self.assertEqual(color.shape, (4, 8, 3))
+        np.testing.assert_equal(color, np.broadcast_to([10, 20, 30], (4, 8, 3)))
+        self.assertEqual(depth.dtype, np.uint16)
+        self.assertEqual(depth[0, 0], 0)
+        np.testing.assert_equal(depth.ravel()[1:], 1250)
+        self.assertEqual(mask.dtype, np.uint16)
+        self.assertEqual(mask[0, 0], 0xFFFF)
+        np.testing.assert_equal(mask.ravel()[1:], 3)
+
+        view.depth_format = DepthFormat.Float16
+        view.depth_scale = 100.0
+        _, depth, _ = self.render.render_view(SceneState(), view)
+        self.assertEqual(depth.dtype, np.float16)
+        np.testing.assert_equal(depth.ravel()[1:], 1.25)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_formats(self):
+        renderer = self.egl_renderer(set_renderer=False)
+
+        # the scene of the plugin, drawn by the renderer directly
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        self.render.render_frame_fn = lambda frame: True
+        self.client.getCameraImage(1, 1)
+        renderer.update_scene(self.render.scene_graph, False)
+        state = self.render.scene_state
+        view = SceneView()
+        view.viewport = (64, 48)
+        view.camera = Camera(pb.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0)),
+                             pb.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0))
+        color, depth, mask = renderer.render_view(state, view)
+
+        # converted on the GPU
+        view.color_format = ColorFormat.RGB
+        view.depth_format = DepthFormat.UInt16
+        view.mask_format = MaskFormat.UInt16
+        rgb, millimeters, ids = renderer.render_view(state, view)
+        np.testing.assert_equal(rgb, color[..., :3])
+        self.assertLessEqual(np.abs(millimeters - np.round(depth * 1000)).max(), 1)
+        np.testing.assert_equal(ids, mask & 0xFFFF)
+
+        view.depth_format = DepthFormat.Float16
+        _, half, _ = renderer.render_view(state, view)
+        np.testing.assert_allclose(half.astype(np.float32), depth, rtol=1e-3)
+
+    def test_path_tracer(self):
+        renderer = pr.PathTracer(num_threads=2)
+        self.assertEqual((renderer.samples, renderer.bounces, renderer.denoise), (4, 1, True))
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        body = self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        self.render.render_frame_fn = lambda frame: True
+        self.client.getCameraImage(1, 1)
+        renderer.update_scene(self.render.scene_graph, False)
+        self.assertEqual(renderer.num_triangles, 12)
+        state = self.render.scene_state
+        view = SceneView()
+        view.viewport = (64, 48)
+        view.camera = Camera(pb.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0)),
+                             pb.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0))
+        color, depth, mask = renderer.render_view(state, view)
+
+        # depth and mask of the rays through the pixel centers
+        self.assertAlmostEqual(depth[24, 32], 4.5, places=4)
+        self.assertEqual(mask[24, 32], body)
+        self.assertEqual((depth[0, 0], mask[0, 0]), (0, -1))
+        self.assertGreater(color[24, 32, :3].min(), 0)
+        # paths are seeded by pixel, the same frame renders the same image
+        again, _, _ = renderer.render_view(state, view)
+        np.testing.assert_equal(again, color)
+
+        renderer.denoise = False
+        renderer.bounces = 0
+        raw, _, _ = renderer.render_view(state, view)
+        np.testing.assert_equal(raw[mask == -1], color[mask == -1])
+
+    def test_quality(self):
+        self.render.render_frame_fn = lambda frame: True
+        self.assertEqual(SceneView().quality, Quality.high())
+        fast = Quality.fast()
+        self.assertEqual((fast.multisamples, fast.shadows, fast.specular, fast.texture_filter),
+                         (0, False, False, TextureFilter.Nearest))
+
+        # the tier of the next images reaches the renderer with their view
+        quality = Quality()
+        quality.multisamples = 4
+        quality.texture_filter = TextureFilter.Bilinear
+        self.plugin.set_quality(quality)
+        self.client.getCameraImage(16, 8)
+        self.assertEqual(self.render.scene_view.quality, quality)
+        self.plugin.set_quality(Quality.fast())
+        self.client.getCameraImage(16, 8)
+        self.assertEqual(self.render.scene_view.quality, Quality.fast())
+        self.plugin.set_quality()
+        self.client.getCameraImage(16, 8)
+        self.assertEqual(self.render.scene_view.quality, Quality.high())
+
+        # views are edited in place and pickled with their tier
+        view = SceneView()
+        view.quality.shadows = False
+        self.assertFalse(view.quality.shadows)
+        self.assertNotEqual(view, SceneView())
+        self.assertEqual(pickle.loads(pickle.dumps(view)), view)
+
+    def test_sensor_noise(self):
+        def render_frame_fn(frame):
+            frame.color_img[:] = (100, 100, 100, 255)
+            frame.depth_img[:] = 2.0
+            frame.depth_img[:, :8] = 1.0
+            frame.mask_img[:] = 0
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        view = SceneView()
+        view.viewport = (16, 12)
+        view.camera = Camera(pb.computeViewMatrix((1, 0, 0), (0, 0, 0), (0, 0, 1)),
+                             pb.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10))
+        color, depth, _ = self.render.render_view(SceneState(), view)
+        self.assertFalse(view.sensor_noise.enabled)
+        np.testing.assert_equal(color[..., :3], 100)
+
+        # drawn from the seed and the frame index, on the color and depth planes
+        view.sensor_noise.shot_noise = 1.0
+        view.sensor_noise.vignetting = 0.5
+        view.sensor_noise.axial_sigma = 0.01
+        view.sensor_noise.edge_dropout = 1.0
+        view.sensor_noise.seed = 7
+        noisy, noisy_depth, _ = self.render.render_view(SceneState(), view, frame_index=3)
+        again, again_depth, _ = self.render.render_view(SceneState(), view, frame_index=3)
+        other, _, _ = self.render.render_view(SceneState(), view, frame_index=4)
+        np.testing.assert_equal(noisy, again)
+        np.testing.assert_equal(noisy_depth, again_depth)
+        self.assertFalse(np.array_equal(noisy, other))
+        np.testing.assert_equal(noisy[..., 3], 255)
+        # vignetting darkens the corners
+        self.assertLess(noisy[[0, 0, -1, -1], [0, -1, 0, -1], :3].mean(),
+                        noisy[5:7, 7:9, :3].mean())
+        # the columns at the depth edge read no depth, the others keep about theirs
+        np.testing.assert_equal(noisy_depth[:, 7:9], 0.0)
+        self.assertLess(np.abs(noisy_depth[:, :7] - 1.0).max(), 0.1)
+        self.assertLess(np.abs(noisy_depth[:, 9:] - 2.0).max(), 0.4)
+
+        # disparities of a baseline quantize far depth more coarsely
+        view.sensor_noise = SensorNoise()
+        view.sensor_noise.baseline = 0.075
+        view.sensor_noise.subpixel = 1.0
+        _, quantized, _ = self.render.render_view(SceneState(), view)
+        focal = 6 / np.tan(np.radians(30))
+        for z in (1.0, 2.0):
+            disparity = np.round(focal * 0.075 / z)
+            self.assertAlmostEqual(quantized[0, 0 if z == 1.0 else -1], focal * 0.075 / disparity,
+                                   places=5)
+        self.assertEqual(pickle.loads(pickle.dumps(view)), view)
+        self.assertNotEqual(view, SceneView())
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_quality(self):
+        renderer = self.egl_renderer(set_renderer=False)
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        self.render.render_frame_fn = lambda frame: True
+        self.client.getCameraImage(1, 1)
+        renderer.update_scene(self.render.scene_graph, False)
+        state = self.render.scene_state
+        view = SceneView()
+        view.viewport = (64, 48)
+        view.camera = Camera(pb.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0)),
+                             pb.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0))
+        color, depth, mask = renderer.render_view(state, view)
+
+        # multisampling smooths the color edges only, masks and depth keep drawn values
+        view.quality.multisamples = 4
+        smooth, sampled_depth, sampled_mask = renderer.render_view(state, view)
+        self.assertGreater(len(np.unique(smooth[..., :3].reshape(-1, 3), axis=0)),
+                           len(np.unique(color[..., :3].reshape(-1, 3), axis=0)))
+        self.assertTrue(set(np.unique(sampled_mask)) <= set(np.unique(mask)))
+        self.assertTrue(np.all((sampled_depth == 0) | (np.abs(sampled_depth - 4.5) < 1e-3)))
+
+        # switching back to the default tier draws the same images
+        view.quality = Quality.high()
+        again, _, _ = renderer.render_view(state, view)
+        np.testing.assert_equal(again, color)
+
+    def test_render_scale(self):
+        shapes = []
+
+        def render_frame_fn(frame):
+            shapes.append(frame.color_img.shape)
+            rows, cols = frame.depth_img.shape
+            # columns alternate, rows get farther, the right half is background
+            frame.color_img[:] = 0
+            frame.color_img[:, ::2] = 200
+            frame.depth_img[:] = np.arange(1, rows + 1, dtype=np.float32)[:, None]
+            frame.depth_img[:, cols // 2:] = 0.0
+            frame.mask_img[:] = np.arange(rows, dtype=np.int32)[:, None]
+            frame.mask_img[:, cols // 2:] = -1
+            return True
+
+        self.render.render_frame_fn = render_frame_fn
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(90, 2, 0.1, 10.0)
+
+        # supersampled: colors averaged, depth and mask of the nearest surface under each pixel
+        self.plugin.set_render_scale(2.0)
+        w, h, color, depth, mask = self.client.getCameraImage(8, 4, view, proj)
+        self.assertEqual((w, h), (8, 4))
+        self.assertEqual(shapes[-1], (8, 16, 4))
+        np.testing.assert_equal(color[..., :3], 100)
+        np.testing.assert_almost_equal(depth[:, :4], np.repeat([[1], [3], [5], [7]], 4, axis=1))
+        np.testing.assert_equal(depth[:, 4:], 0.0)
+        np.testing.assert_equal(mask[:, :4], np.repeat([[0], [2], [4], [6]], 4, axis=1))
+        np.testing.assert_equal(mask[:, 4:], -1)
+        self.assertEqual(tuple(self.render.scene_view.render_size((8, 4))), (16, 8))
+
+        # upsampled: depth and mask of the pixel under each center
+        self.plugin.set_render_scale(0.5)
+        w, h, _, depth, mask = self.client.getCameraImage(8, 4, view, proj)
+        self.assertEqual((w, h), (8, 4))
+        self.assertEqual(shapes[-1], (2, 4, 4))
+        np.testing.assert_almost_equal(depth[:, :4], np.repeat([[1], [1], [2], [2]], 4, axis=1))
+        np.testing.assert_equal(mask[:, 4:], -1)
+
+        self.plugin.set_render_scale()
+        self.client.getCameraImage(8, 4, view, proj)
+        self.assertEqual(shapes[-1], (4, 8, 4))
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_render_scale(self):
+        renderer = self.egl_renderer(set_renderer=False)
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        self.render.render_frame_fn = lambda frame: True
+        self.client.getCameraImage(1, 1)
+        renderer.update_scene(self.render.scene_graph, False)
+        state = self.render.scene_state
+        view = SceneView()
+        view.viewport = (64, 48)
+        view.camera = Camera(pb.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0)),
+                             pb.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0))
+        color, depth, mask = renderer.render_view(state, view)
+
+        # resampled on the GPU at the requested size, depth and labels keep drawn values
+        for scale in (4.0, 0.5):
+            view.render_scale = scale
+            scaled_color, scaled_depth, scaled_mask = renderer.render_view(state, view)
+            self.assertEqual(scaled_color.shape, color.shape)
+            self.assertTrue(set(np.unique(scaled_mask)) <= set(np.unique(mask)))
+            self.assertTrue(np.all((scaled_depth == 0) | (np.abs(scaled_depth - 4.5) < 1e-3)))
+            self.assertGreater(np.mean(scaled_mask == mask), 0.95)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_gpu_stage_stats(self):
+        renderer = self.egl_renderer()
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        self.plugin.stage_stats(reset=True)
+        for _ in range(4):
+            self.client.getCameraImage(32, 24)
+        # passes of a frame are recorded two frames later, once per frame
+        stats = self.plugin.stage_stats()
+        for stage in ('gpu_main', 'gpu_readback'):
+            self.assertIn(stats[stage]['count'], (1, 2))
+            self.assertGreaterEqual(stats[stage]['mean'], 0.0)
+        self.assertEqual(stats['gpu_prepass']['count'], 0)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_single_pass(self):
+        renderer = self.egl_renderer()
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        body_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        _, _, color, depth, mask = self.client.getCameraImage(64, 48, view, proj)
+        # color, metric depth and mask come from one pass
+        np.testing.assert_almost_equal(depth[24, 32], 4.5, decimal=4)
+        self.assertEqual(depth[0, 0], 0.0)
+        # same encoding as the mask color of the python renderers, see render.utils.mask_to_rgb
+        r, g, b = (body_id + 1) & 0xff, ((body_id + 1) & 0xff00) >> 8, 0
+        self.assertEqual(mask[24, 32], r + (g << 8) + (b << 24) - 1)
+        self.assertEqual(mask[0, 0], -1)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_panorama(self):
+        renderer = self.egl_renderer()
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 1, 0.1, 10.0)
+
+        # the box is in front only, at a distance of 4.5 along the camera axis
+        self.plugin.set_projection(Projection.Cubemap)
+        _, _, _, depth, mask = self.client.getCameraImage(32, 32 * 6, view, proj)
+        np.testing.assert_almost_equal(depth[16, 16], 4.5, decimal=4)
+        np.testing.assert_equal(mask[32:], -1)
+
+        self.plugin.set_projection(Projection.Equirectangular)
+        _, _, _, depth, mask = self.client.getCameraImage(128, 64, view, proj)
+        np.testing.assert_almost_equal(depth[32, 64], 4.5, decimal=2)
+        self.assertEqual((depth[32, 0], mask[32, 0]), (0.0, -1))
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_lazy_residency(self):
+        renderer = self.egl_renderer(set_renderer=False)
+        renderer.lazy_residency = True
+        self.plugin.set_renderer(renderer)
+
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        for x in (0, 100):
+            self.client.createMultiBody(baseVisualShapeIndex=vis_id, basePosition=(x, 0, 0))
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        _, _, _, depth, _ = self.client.getCameraImage(64, 48, view, proj)
+        np.testing.assert_almost_equal(depth[24, 32], 4.5, decimal=4)
+        # the box out of view is not loaded
+        stats = renderer.residency_stats()
+        self.assertEqual(stats['loaded_shapes'], 1)
+        self.assertEqual(stats['deferred_shapes'], 1)
+        self.assertGreater(stats['resident_bytes'], 0)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_base_layer(self):
+        renderer = self.egl_renderer()
+
+        table_id = self.client.loadURDF("table/table.urdf")
+        view = self.client.computeViewMatrix((0, -3, 2), (0, 0, 0.5), (0, 0, 1))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        before = self.client.getCameraImage(64, 48, view, proj)[2:]
+        layer = self.plugin.make_base_layer([table_id])
+        self.plugin.set_base_layer(layer)
+        # the renderer draws the frozen layer, moving the body changes nothing
+        self.client.resetBasePositionAndOrientation(table_id, (5, 0, 0), (0, 0, 0, 1))
+        layered = self.client.getCameraImage(64, 48, view, proj)[2:]
+        for plane, plane_layered in zip(before[:2], layered[:2]):
+            np.testing.assert_array_equal(plane, plane_layered)
+        self.plugin.set_base_layer(None)
+        moved = self.client.getCameraImage(64, 48, view, proj)[2:]
+        self.assertFalse(np.array_equal(before[0], moved[0]))
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_texture_arrays(self):
+        renderer = self.egl_renderer()
+
+        tex_uid = self.client.loadTexture("table/table.png")
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.2, 0.2, 0.2])
+        for x in (-1, 0, 1):
+            body_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id,
+                                                  basePosition=(x, 0, 0))
+            self.client.changeVisualShape(body_id, -1, textureUniqueId=tex_uid)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        self.client.getCameraImage(64, 48, view, proj)
+        self.client.getCameraImage(64, 48, view, proj)
+        # the boxes share a layer of one array, bound once per frame
+        stats = renderer.residency_stats()
+        self.assertEqual(stats['resident_textures'], 1)
+        self.assertEqual(stats['texture_arrays'], 1)
+        self.assertEqual(stats['texture_binds'], 1)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_texture_streaming(self):
+        renderer = self.egl_renderer()
+
+        pixels = np.full((1024, 1024, 3), 128, dtype=np.uint8)
+        tex_uid = self.plugin.register_texture(pixels)
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[2, 2, 0.1])
+        body_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        self.client.changeVisualShape(body_id, -1, textureUniqueId=tex_uid)
+        view = self.client.computeViewMatrix((0, 0, 1), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        renderer.texture_upload_budget = 64 << 10
+        self.client.getCameraImage(64, 48, view, proj)
+        # the 64 x 64 level first, then one finer level per frame for the box filling the view
+        stats = renderer.residency_stats()
+        self.assertGreater(stats['streamed_bytes'], 0)
+        self.assertLess(stats['resident_bytes'], 1024 * 1024 * 4)
+        for _ in range(8):
+            self.client.getCameraImage(64, 48, view, proj)
+        self.assertEqual(renderer.residency_stats()['pending_textures'], 0)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_occlusion_culling(self):
+        renderer = self.egl_renderer()
+
+        wall_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[3, 3, 0.1])
+        self.client.createMultiBody(baseVisualShapeIndex=wall_id)
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.1, 0.1, 0.1])
+        for x in (-1, 0, 1):
+            self.client.createMultiBody(baseVisualShapeIndex=vis_id, basePosition=(x, 0, -1))
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        renderer.occluder_size = 16
+        images = []
+        for enabled in (False, True):
+            renderer.occlusion_culling = enabled
+            images.append(self.client.getCameraImage(64, 48, view, proj)[2:])
+        # the boxes behind the wall are not drawn, the images are the same
+        stats = renderer.residency_stats()
+        self.assertEqual(stats['occluded_nodes'], 3)
+        self.assertEqual(stats['drawn_nodes'], 1)
+        for plane, plane_culled in zip(*images):
+            np.testing.assert_array_equal(plane, plane_culled)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_incremental_frames(self):
+        renderer = self.egl_renderer()
+
+        floor_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[3, 3, 0.1])
+        self.client.createMultiBody(baseVisualShapeIndex=floor_id, basePosition=(0, 0, -1))
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.1, 0.1, 0.1])
+        box_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id, basePosition=(-1, 0, 0))
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        renderer.incremental = True
+        self.client.getCameraImage(64, 48, view, proj)
+        self.client.resetBasePositionAndOrientation(box_id, (-1.1, 0, 0), (0, 0, 0, 1))
+        incremental = self.client.getCameraImage(64, 48, view, proj)[2:]
+        # only the tile of the box is drawn again
+        redrawn = renderer.residency_stats()['redrawn_pixels']
+        self.assertGreater(redrawn, 0)
+        self.assertLess(redrawn, 64 * 48)
+        renderer.incremental = False
+        whole = self.client.getCameraImage(64, 48, view, proj)[2:]
+        self.assertEqual(renderer.residency_stats()['redrawn_pixels'], 64 * 48)
+        for plane, plane_whole in zip(incremental, whole):
+            np.testing.assert_array_equal(plane, plane_whole)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_shadow_maps(self):
+        renderer = self.egl_renderer()
+
+        floor_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[3, 3, 0.1])
+        self.client.createMultiBody(baseVisualShapeIndex=floor_id)
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        box_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id, basePosition=(0, 0, 1))
+        view = self.client.computeViewMatrix((0, 0, 8), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 20.0)
+        light = dict(lightDirection=(-1, -0.5, -2), shadow=1)
+        lit = self.client.getCameraImage(64, 48, view, proj, lightDirection=(-1, -0.5, -2))[2]
+        shadowed = self.client.getCameraImage(64, 48, view, proj, **light)[2]
+        self.assertTrue((shadowed[..., :3] < lit[..., :3]).any())
+        # the box moves, the static casters are not drawn again
+        self.client.resetBasePositionAndOrientation(box_id, (0.2, 0, 1), (0, 0, 0, 1))
+        self.client.getCameraImage(64, 48, view, proj, **light)
+        stats = renderer.residency_stats()
+        self.assertEqual(stats['static_shadow_updates'], 1)
+        self.assertEqual(stats['shadow_casters'], 2)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_shadow_cascades(self):
+        renderer = self.egl_renderer()
+        self.assertEqual(renderer.shadow_cascades, 0)
+        renderer.shadow_cascades = 8
+        self.assertEqual(renderer.shadow_cascades, 4)
+
+        floor_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[3, 3, 0.1])
+        self.client.createMultiBody(baseVisualShapeIndex=floor_id)
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        self.client.createMultiBody(baseVisualShapeIndex=vis_id, basePosition=(0, 0, 1))
+        view = self.client.computeViewMatrix((0, -6, 4), (0, 0, 0), (0, 0, 1))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 20.0)
+        lit = self.client.getCameraImage(64, 48, view, proj, lightDirection=(-1, -0.5, -2))[2]
+        shadowed = self.client.getCameraImage(64, 48, view, proj, lightDirection=(-1, -0.5, -2),
+                                              shadow=1)[2]
+        self.assertTrue((shadowed[..., :3] < lit[..., :3]).any())
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_shared_resources(self):
+        first = self.egl_renderer(set_renderer=False, share_resources=True)
+        second = self.egl_renderer(set_renderer=False, share_resources=True)
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        view = self.client.computeViewMatrix((0, -3, 2), (0, 0, 0), (0, 0, 1))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        images = []
+        for renderer in (first, second):
+            self.plugin.set_renderer(renderer)
+            images.append(self.client.getCameraImage(64, 48, view, proj)[2])
+        np.testing.assert_array_equal(images[0], images[1])
+        # the second renderer draws the box uploaded by the first
+        self.assertTrue(second.share_resources)
+        self.assertGreater(first.residency_stats()['uploads'], 0)
+        self.assertEqual(second.residency_stats()['uploads'], 0)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_texture_cache(self):
+        renderer = self.egl_renderer(set_renderer=False)
+        filename = os.path.join(pybullet_data.getDataPath(), 'table/table.png')
+        if not pr.compress_texture_file(filename):
+            self.skipTest('built without stb_image')
+        with tempfile.TemporaryDirectory() as directory:
+            pr.set_texture_cache_directory(directory)
+            try:
+                self.plugin.set_renderer(renderer)
+                if not pr.bindings.texture_compression():
+                    self.skipTest('no S3TC support')
+                tex_uid = self.client.loadTexture("table/table.png")
+                vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.2, 0.2, 0.2])
+                body_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+                self.client.changeVisualShape(body_id, -1, textureUniqueId=tex_uid)
+                view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+                proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+                self.client.getCameraImage(64, 48, view, proj)
+                # the texture was compressed once, into a single entry
+                self.assertEqual(len(os.listdir(directory)), 1)
+                self.assertEqual(renderer.residency_stats()['resident_textures'], 1)
+            finally:
+                pr.set_texture_cache_directory('')
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_shader_cache(self):
+        with tempfile.TemporaryDirectory() as directory:
+            pr.set_shader_cache_directory(directory)
+            try:
+                renderer = self.egl_renderer(set_renderer=False)
+                entries = sorted(os.listdir(directory))
+                # the program binary is stored once and loaded by the next renderers
+                renderer = pr.EGLRenderer()
+                self.assertEqual(sorted(os.listdir(directory)), entries)
+                self.plugin.set_renderer(renderer)
+                vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+                body_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+                view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+                proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+                _, _, _, _, mask = self.client.getCameraImage(64, 48, view, proj)
+                self.assertIn(body_id, np.unique(mask))
+            finally:
+                pr.set_shader_cache_directory('')
+
+    @unittest.skipUnless(hasattr(pr, 'TinyRendererBackend'), 'built without TinyRenderer')
+    def test_tiny_renderer_backend(self):
+        self.plugin.set_renderer(pr.TinyRendererBackend())
+        # the same scene drawn by the TinyRenderer of pybullet itself
+        reference = BulletClient(pb.DIRECT)
+        reference.setAdditionalSearchPath(pybullet_data.getDataPath())
+        near, far = 0.1, 10.0
+        view = self.client.computeViewMatrix((0, -3, 2), (0, 0, 0), (0, 0, 1))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, near, far)
+        try:
+            for client in (self.client, reference):
+                client.loadURDF('plane.urdf')
+                client.loadURDF('cube_small.urdf', basePosition=(0, 0, 0.5), globalScaling=8)
+            images = self.client.getCameraImage(64, 48, view, proj)[2:]
+            ref_images = reference.getCameraImage(64, 48, view, proj,
+                                                  renderer=pb.ER_TINY_RENDERER)[2:]
+        finally:
+            reference.disconnect()
+        shapes = ((48, 64, 4), (48, 64), (48, 64))
+        color, depth, mask = (np.reshape(image, shape) for image, shape in zip(images, shapes))
+        ref_color, ref_zbuffer, ref_mask = (np.reshape(image, shape)
+                                            for image, shape in zip(ref_images, shapes))
+
+        # masks match but for a few edge pixels, both bodies in view
+        self.assertGreater(np.mean(mask == ref_mask), 0.98)
+        self.assertEqual(set(np.unique(mask)), set(np.unique(ref_mask)))
+        # metric depth of the pybullet depth buffer where both drew the same body
+        drawn = (mask == ref_mask) & (mask >= 0)
+        ref_depth = far * near / (far - (far - near) * ref_zbuffer)
+        np.testing.assert_allclose(depth[drawn], ref_depth[drawn], rtol=1e-2, atol=1e-2)
+        # shaded alike
+        difference = np.abs(color[..., :3].astype(int) - ref_color[..., :3].astype(int))
+        self.assertLess(difference[drawn].mean(), 8)
+
+    @unittest.skipUnless(hasattr(pr, 'EGLRenderer'), 'built without --with-egl')
+    def test_native_gpu_output(self):
+        renderer = self.egl_renderer(set_renderer=False)
+        renderer.gpu_output = True
+        self.plugin.set_renderer(renderer)
+
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        self.client.getCameraImage(64, 48, view, proj)
+        color, depth, mask = renderer.gpu_frame()
+        self.assertEqual(color.shape, (48, 64, 4))
+        self.assertEqual(depth.__cuda_array_interface__['typestr'], '<f4')
+        self.assertEqual(mask.__cuda_array_interface__['shape'], (48, 64))
+
+    def test_device_scheduler(self):
+        pr.set_device_count(2)
+        try:
+            leases = [pr.acquire_device() for _ in range(3)]
+            self.assertEqual([lease.device for lease in leases], [0, 1, 0])
+            self.assertEqual([load['sessions'] for load in pr.device_loads()], [2, 1])
+            # by memory, the device with the smaller renderers gets the next one
+            leases[0].bytes = 1 << 20
+            pr.set_device_policy(pr.DevicePolicy.LeastMemory)
+            leases.append(pr.acquire_device(expected_bytes=1 << 10))
+            self.assertEqual(leases[-1].device, 1)
+            self.assertEqual(pr.device_loads()[1]['bytes'], 1 << 10)
+            del leases
+            self.assertEqual([load['sessions'] for load in pr.device_loads()], [0, 0])
+        finally:
+            pr.set_device_policy(pr.DevicePolicy.LeastSessions)
+            pr.set_device_count(-1)
+
+    def test_thread_affinity(self):
+        pr.set_thread_affinity(pr.ThreadAffinity.Core)
+        try:
+            pr.set_device_count(1)
+            pr.set_device_numa_node(0, 0)
+            topology = pr.get_thread_topology()
+            self.assertEqual(topology['affinity'], pr.ThreadAffinity.Core)
+            self.assertTrue(topology['nodes'])
+            self.assertTrue(all(node['cpus'] for node in topology['nodes']))
+            self.assertEqual(topology['devices'], [0])
+            self.assertEqual(pr.device_loads()[0]['numa_node'], 0)
+            # the async render thread is pinned to a single core of the node at its first frame
+            self.plugin.configure('async', 1)
+            self.plugin.configure('numa_node', 0)
+            self.assertEqual(self.plugin.config('numa_node'), 0)
+            view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+            proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+            for _ in range(2):
+                self.client.getCameraImage(32, 24, view, proj)
+            threads = [thread for thread in pr.get_thread_topology()['threads']
+                       if thread['name'] == 'async render']
+            self.assertEqual([(thread['node'], len(thread['cpus'])) for thread in threads],
+                             [(0, 1)])
+        finally:
+            self.plugin.configure('numa_node', -1)
+            self.plugin.configure('async', 0)
+            pr.set_thread_affinity(pr.ThreadAffinity.Off)
+            pr.set_device_numa_node(0, -1)
+            pr.set_device_count(-1)
@@ -0,0 +1,258 @@
+import json
+import os
+import unittest
+from timeit import default_timer as timer
+
+import numpy as np
+import pybullet as pb
+import pybullet_data
+from pybullet_utils.bullet_client import BulletClient
+
+import pybullet_rendering as pr
+from pybullet_rendering import RenderingPlugin
+
+# images of each scene drawn by each backend, written by a run with
+# PYBULLET_RENDERING_UPDATE_BASELINES=1 on a reference machine
+BASELINE_DIR = os.path.join(os.path.dirname(__file__), 'baselines')
+UPDATE_BASELINES = os.environ.get('PYBULLET_RENDERING_UPDATE_BASELINES') == '1'
+# outputs and throughput of the run, written as JSON if set
+REPORT_PATH = os.environ.get('PYBULLET_RENDERING_PARITY_REPORT')
+# ratio of the baseline frame time above which a backend fails, throughput recorded only if unset
+MAX_SLOWDOWN = float(os.environ.get('PYBULLET_RENDERING_MAX_SLOWDOWN', 'inf'))
+
+MIN_PSNR = 40.0  # dB, of the color
+MAX_DEPTH_ERROR = 1e-3  # m, of the pixels drawn in both images
+WIDTH, HEIGHT = 160, 120
+TIMED_FRAMES = 20
+
+
+def scene_primitives(client):
+    """Colored primitives on a plane."""
+    ground = client.createVisualShape(pb.GEOM_BOX, halfExtents=[2, 2, 0.01],
+                                      rgbaColor=[0.6, 0.6, 0.6, 1])
+    client.createMultiBody(baseVisualShapeIndex=ground, basePosition=[0, 0, -0.01])
+    shapes = [
+        client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.2, 0.2, 0.2],
+                                 rgbaColor=[0.9, 0.2, 0.2, 1]),
+        client.createVisualShape(pb.GEOM_SPHERE, radius=0.25, rgbaColor=[0.2, 0.8, 0.3, 1]),
+        client.createVisualShape(pb.GEOM_CYLINDER, radius=0.15, length=0.5,
+                                 rgbaColor=[0.2, 0.3, 0.9, 1]),
+        client.createVisualShape(pb.GEOM_CAPSULE, radius=0.1, length=0.4,
+                                 rgbaColor=[0.9, 0.8, 0.2, 1]),
+    ]
+    for i, shape in enumerate(shapes):
+        client.createMultiBody(baseVisualShapeIndex=shape,
+                               basePosition=[(i % 2 - 0.5) * 0.8, (i // 2 - 0.5) * 0.8, 0.25])
+
+
+def scene_textured(client):
+    """A checkered plane and a textured cube."""
+    client.loadURDF('plane.urdf')
+    cube = client.loadURDF('cube.urdf', basePosition=[0, 0, 0.5], globalScaling=0.6)
+    client.changeVisualShape(cube, -1, textureUniqueId=client.loadTexture('checker_blue.png'))
+
+
+def scene_robot(client):
+    """An articulated URDF robot of meshes."""
+    client.loadURDF('plane.urdf')
+    client.loadURDF('r2d2.urdf', basePosition=[0, 0, 0.5])
+
+
+SCENES = {
+    'primitives': scene_primitives,
+    'textured': scene_textured,
+    'robot': scene_robot,
+}
+
+
+def create_backend(name, **kwargs):
+    """Renderer of a backend, None if it is not available, python ones given kwargs."""
+    try:
+        if 'native-egl' == name and hasattr(pr, 'EGLRenderer'):
+            return pr.EGLRenderer()
+        if 'native-tiny' == name and hasattr(pr, 'TinyRendererBackend'):
+            return pr.TinyRendererBackend()
+        if 'native-vulkan' == name and hasattr(pr, 'VulkanRenderer'):
+            return pr.VulkanRenderer()
+        if 'pyrender' == name:
+            from pybullet_rendering.render.pyrender import PyrRenderer
+            return PyrRenderer(platform='egl', **kwargs)
+        if 'panda3d' == name:
+            from pybullet_rendering.render.panda3d import P3dRenderer
+            return P3dRenderer(multisamples=0, **kwargs)
+    except (ImportError, RuntimeError):
+        pass
+    return None
+
+
+def psnr(a, b):
+    """Peak signal to noise ratio of 8-bit images, in dB."""
+    mse = np.mean((a.astype(np.float64) - b.astype(np.float64))**2)
+    return float('inf') if mse == 0 else 10 * np.log10(255.0**2 / mse)
+
+
+class ParityTest(unittest.TestCase):
+    """Images of every backend compared to their baselines, with the throughput drawing them.
+
+    Each backend has its own baselines, as backends shade differently: color has to keep its PSNR
+    above MIN_PSNR, depth to stay within MAX_DEPTH_ERROR where both images drew something, and
+    masks to match exactly. Backends missing from the build or without baselines are skipped.
+    """
+
+    report = {}
+
+    @classmethod
+    def tearDownClass(cls):
+        if REPORT_PATH and cls.report:
+            with open(REPORT_PATH, 'w') as file:
+                json.dump(cls.report, file, indent=2)
+
+    def render_scene(self, renderer, scene):
+        client = BulletClient(pb.DIRECT)
+        client.setAdditionalSearchPath(pybullet_data.getDataPath())
+        plugin = RenderingPlugin(client, renderer)
+        # every timed frame is drawn
+        plugin.set_frame_cache(False)
+        try:
+            SCENES[scene](client)
+            view = client.computeViewMatrixFromYawPitchRoll((0, 0, 0.2), 2.5, 35, -30, 0, 2)
+            proj = client.computeProjectionMatrixFOV(60, WIDTH / HEIGHT, 0.1, 10.0)
+
+            def frame():
+                return client.getCameraImage(WIDTH, HEIGHT, view, proj)[2:]
+
+            color, depth, mask = frame()
+            start = timer()
+            for _ in range(TIMED_FRAMES):
+                frame()
+            frame_time = (timer() - start) / TIMED_FRAMES
+            return (np.array(color)[..., :3], np.array(depth, np.float32), np.array(mask),
+                    frame_time)
+        finally:
+            plugin.unload()
+            client.disconnect()
+
+    def check_backend(self, backend):
+        if create_backend(backend) is None:
+            self.skipTest(f'{backend} is not available')
+        for scene in SCENES:
+            with self.subTest(backend=backend, scene=scene):
+                # a renderer of its own per scene, as a fresh process would draw it
+                color, depth, mask, frame_time = self.render_scene(create_backend(backend), scene)
+                path = os.path.join(BASELINE_DIR, backend, f'{scene}.npz')
+                if UPDATE_BASELINES:
+                    os.makedirs(os.path.dirname(path), exist_ok=True)
+                    np.savez_compressed(path, color=color, depth=depth, mask=mask,
+                                        frame_time=frame_time)
+                    continue
+                if not os.path.exists(path):
+                    self.skipTest(f'no baseline {path}')
+                baseline = np.load(path)
+
+                drawn = (mask >= 0) & (baseline['mask'] >= 0)
+                depth_error = float(np.abs(depth - baseline['depth'])[drawn].max(initial=0.0))
+                result = {
+                    'psnr': psnr(color, baseline['color']),
+                    'depth_error': depth_error,
+                    'mask_mismatches': int(np.count_nonzero(mask != baseline['mask'])),
+                    'frame_ms': frame_time * 1e3,
+                    'baseline_frame_ms': float(baseline['frame_time']) * 1e3,
+                }
+                self.report.setdefault(backend, {})[scene] = result
+
+                self.assertGreaterEqual(result['psnr'], MIN_PSNR)
+                self.assertLessEqual(depth_error, MAX_DEPTH_ERROR)
+                self.assertEqual(result['mask_mismatches'], 0)
+                self.assertLessEqual(frame_time, float(baseline['frame_time']) * MAX_SLOWDOWN)
+
+    def test_native_egl(self):
+        self.check_backend('native-egl')
+
+    def test_native_tiny(self):
+        self.check_backend('native-tiny')
+
+    def test_native_vulkan(self):
+        self.check_backend('native-vulkan')
+
+    def test_pyrender(self):
+        self.check_backend('pyrender')
+
+    def test_panda3d(self):
+        self.check_backend('panda3d')
+
+
+class CallbackViewsTest(unittest.TestCase):
+    """Python backends lending the images of bullet's buffers to their callback."""
+
+    def check_backend(self, backend):
+        received = []
+
+        def callback_fn(color, depth, mask):
+            received.append((color, depth, mask, np.array(color)))
+
+        renderer = create_backend(backend, callback_fn=callback_fn, callback_views=True)
+        if renderer is None:
+            self.skipTest(f'{backend} is not available')
+        client = BulletClient(pb.DIRECT)
+        client.setAdditionalSearchPath(pybullet_data.getDataPath())
+        plugin = RenderingPlugin(client, renderer)
+        try:
+            scene_primitives(client)
+            view = client.computeViewMatrixFromYawPitchRoll((0, 0, 0.2), 2.5, 35, -30, 0, 2)
+            proj = client.computeProjectionMatrixFOV(60, WIDTH / HEIGHT, 0.1, 10.0)
+            width, height, color, _, _ = client.getCameraImage(WIDTH, HEIGHT, view, proj)
+        finally:
+            plugin.unload()
+            client.disconnect()
+
+        # the frame was rendered and bullet got the images the callback saw
+        self.assertEqual((width, height), (WIDTH, HEIGHT))
+        self.assertEqual(len(received), 1)
+        color_view, depth_view, _, color_copy = received[0]
+        self.assertTrue(color_view.readonly)
+        self.assertTrue(depth_view.readonly)
+        np.testing.assert_equal(np.reshape(color, (HEIGHT, WIDTH, 4)), color_copy)
+        # views are released with the block
+        with self.assertRaises(ValueError):
+            color_view.tobytes()
+
+    def test_pyrender(self):
+        self.check_backend('pyrender')
+
+    def test_panda3d(self):
+        self.check_backend('panda3d')
+
+
+class PipelinedTest(unittest.TestCase):
+    """Panda3D frames drawn while the previous ones are read back, one call behind."""
+
+    def test_panda3d(self):
+        renderer = create_backend('panda3d', pipelined=True)
+        if renderer is None:
+            self.skipTest('panda3d is not available')
+        client = BulletClient(pb.DIRECT)
+        client.setAdditionalSearchPath(pybullet_data.getDataPath())
+        plugin = RenderingPlugin(client, renderer)
+        plugin.set_frame_cache(False)
+        try:
+            scene_primitives(client)
+            near = (client.computeViewMatrixFromYawPitchRoll((0, 0, 0.2), 2.5, 35, -30, 0, 2),
+                    client.computeProjectionMatrixFOV(60, WIDTH / HEIGHT, 0.1, 10.0))
+            far = (client.computeViewMatrixFromYawPitchRoll((0, 0, 0.2), 4.0, 80, -45, 0, 2),
+                   client.computeProjectionMatrixFOV(60, WIDTH / HEIGHT, 1.0, 20.0))
+            images = [client.getCameraImage(WIDTH, HEIGHT, *camera)
+                      for camera in (near, far, near, near)]
+        finally:
+            plugin.unload()
+            client.disconnect()
+
+        # the first call gets no image, each later one that of the call before
+        self.assertEqual(images[0][:2], (0, 0))
+        for image in images[1:]:
+            self.assertEqual(image[:2], (WIDTH, HEIGHT))
+        first, second, third = ((np.reshape(color, (HEIGHT, WIDTH, 4)), np.array(depth))
+                                for _, _, color, depth, _ in images[1:])
+        self.assertGreater(np.abs(first[1] - second[1]).max(), 1e-2)
+        np.testing.assert_equal(first[0], third[0])
+        # drawn through the same lens, converted with it rather than the next request's
+        np.testing.assert_allclose(first[1], third[1], rtol=1e-5, atol=1e-6)
@@ -1,10 +1,26 @@
 import gc
+import json
+import os
+import stat
+import sys
+import tempfile
+import threading
+import time
 import unittest
+from concurrent.futures import ThreadPoolExecutor
 
+import numpy as np
 import pybullet as pb
+import pybullet_data
 from pybullet_utils.bullet_client import BulletClient
 
-from pybullet_rendering import BaseRenderer, RenderingPlugin
+from pybullet_rendering import (AssetPrefetch, AutoRenderer, BaseRenderer, BatchRenderer,
+                                FrameRing,
+                                RemoteRenderer, RenderingPlugin, RenderScheduler, RenderServer,
+                                SceneState, TrajectoryRecorder, capture_trace_outliers,
+                                get_process_memory_report, load_trajectory, preload_assets,
+                                replay, start_trace, stop_trace, trace_captured_frames)
+from pybullet_rendering.bindings import Camera, OutputChannel, SceneGraph, SceneView
 
 
 class RendererMock(BaseRenderer):
@@ -18,16 +34,643 @@ class RendererMock(BaseRenderer):
         return False
 
 
+class CountingRenderer(BaseRenderer):
+    """Fills depth with the number of nodes of the current scene."""
+
+    def __init__(self):
+        super().__init__()
+        self.num_nodes = 0
+
+    def update_scene(self, scene_graph, materials_only):
+        self.num_nodes = len(scene_graph.nodes)
+
+    def render_frame(self, scene_state, scene_view, frame):
+        frame.depth_img.fill(self.num_nodes)
+        return True
+
+
+class UpdateCountingRenderer(CountingRenderer):
+    """Counts the scene updates it receives."""
+
+    def __init__(self):
+        super().__init__()
+        self.num_updates = 0
+
+    def update_scene(self, scene_graph, materials_only):
+        super().update_scene(scene_graph, materials_only)
+        self.num_updates += 1
+
+
+class LayerRenderer(UpdateCountingRenderer):
+    """Records whether the cameras see the nodes of the scene."""
+
+    def __init__(self):
+        super().__init__()
+        self.node_ids = []
+        self.visible = []
+
+    def update_scene(self, scene_graph, materials_only):
+        super().update_scene(scene_graph, materials_only)
+        self.node_ids = list(scene_graph.nodes.keys())
+
+    def render_frame(self, scene_state, scene_view, frame):
+        self.visible = [scene_view.visible(node_id) for node_id in self.node_ids]
+        return super().render_frame(scene_state, scene_view, frame)
+
+
+class FrameCountingRenderer(CountingRenderer):
+    """Counts the frames it renders."""
+
+    def __init__(self):
+        super().__init__()
+        self.num_frames = 0
+
+    def render_frame(self, scene_state, scene_view, frame):
+        self.num_frames += 1
+        return super().render_frame(scene_state, scene_view, frame)
+
+
+def counting_renderer(worker):
+    return CountingRenderer()
+
+
+def read_array(directory, name):
+    """Read an uncompressed zarr array."""
+    with open(os.path.join(directory, name, '.zarray')) as file:
+        meta = json.load(file)
+    chunks = sorted((c for c in os.listdir(os.path.join(directory, name)) if c[0] != '.'),
+                    key=lambda c: int(c.split('.')[0]))
+    data = b''.join(open(os.path.join(directory, name, c), 'rb').read() for c in chunks)
+    array = np.frombuffer(data, np.dtype(meta['dtype']))
+    return array[:int(np.prod(meta['shape']))].reshape(meta['shape'])
+
+
 class PluginTest(unittest.TestCase):
 
     def test_load_nonempty_world(self):
         client = BulletClient(pb.DIRECT)
-        client.loadURDF("table/table.urdf")
-        with self.assertRaises(AssertionError):
-            RenderingPlugin(client, RendererMock())
+        client.setAdditionalSearchPath(pybullet_data.getDataPath())
+        table_id = client.loadURDF("table/table.urdf")
+        shape_id = client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.1, 0.1, 0.1])
+        box_id = client.createMultiBody(baseVisualShapeIndex=shape_id, basePosition=[0, 0, 2])
+        num_shapes = len(client.getVisualShapeData(table_id))
+        table_links = {data[1] for data in client.getVisualShapeData(table_id)}
+
+        # bodies loaded before the plugin are imported with their visual shapes
+        renderer = CountingRenderer()
+        RenderingPlugin(client, renderer)
+        client.getCameraImage(8, 4)
+        self.assertEqual(renderer.num_nodes, len(table_links) + 1)
+        self.assertEqual(len(client.getVisualShapeData(table_id)), num_shapes)
+        self.assertEqual(len(client.getVisualShapeData(box_id)), 1)
+        client.loadURDF("table/table.urdf", basePosition=[0, 2, 0])
+        client.getCameraImage(8, 4)
+        self.assertEqual(renderer.num_nodes, 2 * len(table_links) + 1)
 
     def test_keep_reference(self):
         client = BulletClient(pb.DIRECT)
         RenderingPlugin(client, RendererMock())
         gc.collect()
         _ = client.getCameraImage(16, 16)
+
+    def test_batch_renderer(self):
+        batch = BatchRenderer(CountingRenderer())
+        clients, plugins = [], []
+        for num_bodies in (1, 3):
+            client = BulletClient(pb.DIRECT)
+            plugins.append(RenderingPlugin(client, batch.add_environment()))
+            vis_id = client.createVisualShape(pb.GEOM_SPHERE, radius=0.1)
+            for _ in range(num_bodies):
+                client.createMultiBody(baseVisualShapeIndex=vis_id)
+            # records the scene and poses, the image itself is rendered by render_all
+            w, h, *_ = client.getCameraImage(1, 1)
+            self.assertEqual((w, h), (0, 0))
+            clients.append(client)
+
+        eye = np.eye(4).flatten()
+        for env in range(batch.num_environments):
+            batch.set_cameras(env, [eye, eye], [eye, eye])
+        color, depth, mask = batch.render_all(8, 4)
+        self.assertEqual(color.shape, (2, 2, 4, 8, 4))
+        self.assertEqual(mask.shape, (2, 2, 4, 8))
+        np.testing.assert_equal(depth[0], 1)
+        np.testing.assert_equal(depth[1], 3)
+
+    def test_render_scheduler(self):
+        class FillRenderer(BaseRenderer):
+            def __init__(self, value):
+                super().__init__()
+                self.value = value
+
+            def update_scene(self, scene_graph, materials_only):
+                pass
+
+            def render_frame(self, scene_state, scene_view, frame):
+                frame.depth_img.fill(self.value)
+                return True
+
+        scheduler = RenderScheduler([FillRenderer(1), FillRenderer(2)])
+        self.assertEqual(scheduler.num_workers, 2)
+        clients = [scheduler.add_client(deadline=1.0) for _ in range(4)]
+        for client in clients:
+            client.update_scene(SceneGraph(), False)
+        view = SceneView()
+        view.viewport = (8, 4)
+        view.camera = Camera(np.eye(4).flatten(), np.eye(4).flatten())
+
+        # render_view waits for the workers without the GIL
+        def request(client):
+            return [client.render_view(SceneState(), view)[1] for _ in range(4)]
+
+        with ThreadPoolExecutor(len(clients)) as executor:
+            depths = sum(executor.map(request, clients), [])
+        self.assertEqual(len(depths), 16)
+        for depth in depths:
+            self.assertIn(depth[0, 0], (1, 2))
+            np.testing.assert_equal(depth, depth[0, 0])
+        stats = scheduler.stats()
+        self.assertEqual(stats['jobs'], 16)
+        self.assertGreaterEqual(stats['scene_switches'], 1)
+        self.assertEqual(scheduler.queue_latency()['count'], 16)
+        self.assertEqual(scheduler.queue_lengths(), [0, 0])
+        scheduler.reset_stats()
+        self.assertEqual(scheduler.stats()['jobs'], 0)
+
+    def test_auto_renderer(self):
+        class TimedRenderer(BaseRenderer):
+            def __init__(self, value, delay):
+                super().__init__()
+                self.value = value
+                self.delay = delay
+                self.num_updates = 0
+
+            def update_scene(self, scene_graph, materials_only):
+                self.num_updates += 1
+
+            def render_frame(self, scene_state, scene_view, frame):
+                time.sleep(self.delay)
+                frame.depth_img.fill(self.value)
+                return True
+
+        slow, fast = TimedRenderer(1, 0.02), TimedRenderer(2, 0.0)
+        auto = AutoRenderer({'slow': slow, 'fast': fast}, calibration_frames=2)
+        auto.quiet = True
+        self.assertEqual(auto.candidates, ['fast', 'slow'])
+        client = BulletClient(pb.DIRECT)
+        plugin = RenderingPlugin(client, auto)
+        client.createMultiBody(baseVisualShapeIndex=client.createVisualShape(pb.GEOM_SPHERE))
+        for _ in range(2):
+            *_, depth, _ = client.getCameraImage(8, 4)
+            np.testing.assert_equal(depth, 2)
+        self.assertEqual(auto.backend, 'fast')
+        decisions = auto.decisions()
+        self.assertEqual(len(decisions), 1)
+        self.assertEqual((decisions[0]['cols'], decisions[0]['rows']), (8, 4))
+        self.assertGreater(decisions[0]['frame_times']['slow'],
+                           decisions[0]['frame_times']['fast'])
+        # scene updates only reach the chosen backend
+        updates = slow.num_updates
+        client.createMultiBody(baseVisualShapeIndex=client.createVisualShape(pb.GEOM_SPHERE))
+        client.getCameraImage(8, 4)
+        self.assertEqual(slow.num_updates, updates)
+        auto.recalibrate()
+        client.getCameraImage(8, 4)
+        self.assertEqual(len(auto.decisions()), 2)
+        self.assertGreater(slow.num_updates, updates)
+        plugin.unload()
+        client.disconnect()
+
+    def test_concurrent_clients(self):
+        clients = [BulletClient(pb.DIRECT) for _ in range(4)]
+        plugins = [RenderingPlugin(client, CountingRenderer()) for client in clients]
+
+        def step(client):
+            client.createMultiBody(
+                baseVisualShapeIndex=client.createVisualShape(pb.GEOM_SPHERE, radius=0.1))
+            return [client.getCameraImage(8, 4)[3][0, 0] for _ in range(10)]
+
+        with ThreadPoolExecutor(len(clients)) as pool:
+            # rebinding renderers while other clients render
+            results = pool.map(step, clients)
+            for plugin in plugins:
+                plugin.set_renderer(CountingRenderer())
+            for depths in results:
+                self.assertEqual(depths[-1], 1)
+
+    def test_override_cache(self):
+        for cache_overrides in (False, True):
+            client = BulletClient(pb.DIRECT)
+            plugin = RenderingPlugin(client)
+            plugin.set_renderer(CountingRenderer(), cache_overrides)
+            client.createMultiBody(
+                baseVisualShapeIndex=client.createVisualShape(pb.GEOM_SPHERE, radius=0.1))
+            self.assertEqual(client.getCameraImage(8, 4)[3][0, 0], 1)
+
+    def test_stage_stats(self):
+        client = BulletClient(pb.DIRECT)
+        plugin = RenderingPlugin(client, CountingRenderer())
+        client.createMultiBody(
+            baseVisualShapeIndex=client.createVisualShape(pb.GEOM_SPHERE, radius=0.1))
+        for _ in range(3):
+            client.getCameraImage(8, 4)
+        stats = plugin.stage_stats(reset=True)
+        self.assertEqual(set(stats), {'scene_sync', 'state_sync', 'python', 'render',
+                                      'readback', 'copy', 'gpu_shadow', 'gpu_prepass',
+                                      'gpu_main', 'gpu_resolve', 'gpu_readback'})
+        # python renderers have no GPU passes timed
+        self.assertEqual(stats['gpu_main']['count'], 0)
+        self.assertGreaterEqual(stats['python']['count'], 4)  # scene update and frames
+        self.assertEqual(stats['copy']['count'], 3)
+        self.assertEqual(sum(stats['copy']['histogram']), 3)
+        self.assertLessEqual(stats['copy']['p50'], stats['copy']['max'])
+        self.assertEqual(plugin.stage_stats()['copy']['count'], 0)
+        # the same percentiles through plugin commands, in microseconds
+        client.getCameraImage(8, 4)
+        python = 2
+        self.assertGreaterEqual(
+            client.executePluginCommand(plugin._plugin_id, "stats", intArgs=[python, 50]), 0)
+        self.assertEqual(
+            client.executePluginCommand(plugin._plugin_id, "stats", intArgs=[python]), 1)
+
+    def test_trace(self):
+        client = BulletClient(pb.DIRECT)
+        RenderingPlugin(client, CountingRenderer())
+        client.createMultiBody(
+            baseVisualShapeIndex=client.createVisualShape(pb.GEOM_SPHERE, radius=0.1))
+        with tempfile.TemporaryDirectory() as tmpdir:
+            path = os.path.join(tmpdir, 'trace.json')
+            start_trace(path)
+            client.stepSimulation()
+            for _ in range(2):
+                client.getCameraImage(8, 4)
+            self.assertTrue(stop_trace())
+            with open(path) as f:
+                events = json.load(f)['traceEvents']
+        names = {event['name'] for event in events}
+        self.assertTrue({'physics_step', 'camera_image', 'python', 'copy'} <= names)
+        spans = [event for event in events if event['name'] == 'camera_image']
+        self.assertGreaterEqual(sum(event['ph'] == 'B' for event in spans), 2)
+        self.assertEqual(spans[0]['args']['client'], client._client)
+
+    def test_visibility_layers(self):
+        client = BulletClient(pb.DIRECT)
+        renderer = LayerRenderer()
+        plugin = RenderingPlugin(client, renderer)
+        body = client.createMultiBody(
+            baseVisualShapeIndex=client.createVisualShape(pb.GEOM_SPHERE, radius=0.1))
+        client.getCameraImage(8, 4)
+        self.assertEqual(renderer.visible, [True])
+        num_updates = renderer.num_updates
+
+        # the body in the second layer only, cameras in the first one
+        client.changeVisualShape(body, -1, flags=2 << 8)
+        plugin.configure('layers', 1)
+        self.assertEqual(plugin.config('layers'), 1)
+        client.getCameraImage(8, 4)
+        self.assertEqual(renderer.visible, [False])
+        plugin.configure('layers', 3)
+        client.getCameraImage(8, 4)
+        self.assertEqual(renderer.visible, [True])
+        self.assertEqual(plugin.set_visibility_layers([body], [-1], [1]), 1)
+        plugin.configure('layers', 2)
+        client.getCameraImage(8, 4)
+        self.assertEqual(renderer.visible, [False])
+        self.assertEqual(renderer.num_updates, num_updates)
+
+    def test_trace_outliers(self):
+        client = BulletClient(pb.DIRECT)
+        RenderingPlugin(client, CountingRenderer())
+        with tempfile.TemporaryDirectory() as tmpdir:
+            # every image is an outlier
+            capture_trace_outliers(tmpdir, frames=2, threshold_ms=1e-6)
+            for _ in range(3):
+                client.getCameraImage(8, 4)
+            self.assertTrue(stop_trace())
+            self.assertEqual(trace_captured_frames(), 3)
+            with open(os.path.join(tmpdir, 'outlier_2.json')) as f:
+                trace = json.load(f)
+        self.assertEqual(trace['otherData']['client'], client._client)
+        spans = [event for event in trace['traceEvents']
+                 if event['name'] == 'camera_image' and event['ph'] == 'B']
+        self.assertEqual(len(spans), 2)
+
+    def test_memory_report(self):
+        client = BulletClient(pb.DIRECT)
+        plugin = RenderingPlugin(client, CountingRenderer())
+        vertices = np.random.rand(30, 3)
+        indices = np.arange(30)
+        shape_id = client.createVisualShape(pb.GEOM_MESH, vertices=vertices, indices=indices)
+        for _ in range(2):
+            client.createMultiBody(baseVisualShapeIndex=shape_id)
+        client.getCameraImage(8, 4)
+
+        report = plugin.memory_report()
+        assets = report['assets']
+        self.assertEqual(assets['meshes'], 1)
+        self.assertGreaterEqual(assets['mesh_bytes'], vertices.size * 4 + indices.size * 4)
+        self.assertEqual(assets['shared_bytes'], assets['mesh_bytes'])
+        self.assertEqual(len(report['nodes']), 2)
+        for node in report['nodes']:
+            self.assertEqual((node['link'], node['bytes'], node['owned_bytes']),
+                             (-1, assets['mesh_bytes'], 0))
+        self.assertGreater(report['frame_bytes'], 0)
+        self.assertGreaterEqual(report['peak_bytes'], report['total_bytes'])
+        self.assertGreaterEqual(report['total_bytes'], assets['total_bytes'])
+        process = get_process_memory_report()
+        self.assertGreaterEqual(process['clients'], 1)
+        self.assertGreaterEqual(process['assets']['total_bytes'], assets['total_bytes'])
+
+    def test_warm_reset(self):
+        client = BulletClient(pb.DIRECT)
+        renderer = UpdateCountingRenderer()
+        plugin = RenderingPlugin(client, renderer)
+        plugin.set_warm_reset(True)
+
+        def load(num_bodies):
+            for i in range(num_bodies):
+                extents = [0.1, 0.1, 0.1 * (i + 1)]
+                shape_id = client.createVisualShape(pb.GEOM_BOX, halfExtents=extents)
+                client.createMultiBody(baseVisualShapeIndex=shape_id)
+            client.getCameraImage(8, 4)
+
+        load(3)
+        num_updates = renderer.num_updates
+        client.resetSimulation()
+        load(3)
+        self.assertEqual(renderer.num_updates, num_updates)
+        self.assertEqual(renderer.num_nodes, 3)
+        client.resetSimulation()
+        load(2)
+        self.assertEqual(renderer.num_nodes, 2)
+
+    def test_render_rate(self):
+        client = BulletClient(pb.DIRECT)
+        client.setTimeStep(1. / 240.)
+        renderer = FrameCountingRenderer()
+        plugin = RenderingPlugin(client, renderer)
+        shape_id = client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.1, 0.1, 0.1])
+        client.createMultiBody(1., baseVisualShapeIndex=shape_id)
+        plugin.set_render_rate(10., interpolate=True)
+
+        for _ in range(48):
+            client.getCameraImage(8, 4)
+            client.stepSimulation()
+        client.getCameraImage(8, 4)
+        self.assertEqual(renderer.num_frames, 3)
+        self.assertAlmostEqual(plugin.frame_time, 0.2)
+
+    def test_deferred_conversion(self):
+        def load(deferred):
+            client = BulletClient(pb.DIRECT)
+            client.setAdditionalSearchPath(pybullet_data.getDataPath())
+            renderer = CountingRenderer()
+            plugin = RenderingPlugin(client, renderer)
+            plugin.set_deferred_conversion(deferred)
+            body_ids = client.loadSDF("kuka_iiwa/kuka_with_gripper2.sdf")
+            num_shapes = sum(len(client.getVisualShapeData(i)) for i in body_ids)
+            client.getCameraImage(8, 4)
+            return renderer.num_nodes, num_shapes
+
+        num_nodes, num_shapes = load(False)
+        self.assertGreater(num_nodes, 1)
+        self.assertEqual(load(True), (num_nodes, num_shapes))
+
+    def test_staged_loading(self):
+        def load(wait):
+            client = BulletClient(pb.DIRECT)
+            client.setAdditionalSearchPath(pybullet_data.getDataPath())
+            renderer = CountingRenderer()
+            plugin = RenderingPlugin(client, renderer)
+            client.getCameraImage(8, 4)
+            plugin.set_staged_loading(True, upload_budget=0.0, wait=wait)
+            client.loadURDF("r2d2.urdf")
+            for _ in range(1000):
+                client.getCameraImage(8, 4)
+                if plugin.config('staged_nodes') == 0:
+                    break
+                time.sleep(0.01)
+            return renderer.num_nodes
+
+        num_nodes = load(True)
+        self.assertGreater(num_nodes, 1)
+        self.assertEqual(load(False), num_nodes)
+
+    def test_config(self):
+        client = BulletClient(pb.DIRECT)
+        plugin = RenderingPlugin(client, CountingRenderer())
+        self.assertEqual(plugin.config('frame_cache'), 0)
+        plugin.configure('frame_cache', 1)
+        self.assertEqual(plugin.config('frame_cache'), 1)
+
+        channels = int(OutputChannel.Normals) | int(OutputChannel.DepthPyramid)
+        plugin.configure('channels', channels)
+        self.assertEqual(plugin.config('channels'), channels)
+        self.assertEqual(plugin.config('quality'), 1)
+        plugin.configure('quality', 0)
+        self.assertEqual(plugin.config('quality'), 0)
+        self.assertGreaterEqual(plugin.config('memory'), 0)
+
+        with self.assertRaises(AssertionError):
+            plugin.configure('channels', int(OutputChannel.Color))
+        with self.assertRaises(AssertionError):
+            plugin.configure('memory', 0)
+        with self.assertRaises(AssertionError):
+            plugin.config('unknown')
+
+    @unittest.skipUnless(hasattr(os, 'fork'), 'fork() is not available')
+    def test_preload_assets(self):
+        with tempfile.TemporaryDirectory() as directory:
+            filename = os.path.join(directory, 'triangle.obj')
+            with open(filename, 'w') as file:
+                file.write('v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n')
+            missing = os.path.join(directory, 'missing.stl')
+            self.assertEqual(preload_assets([filename, missing]), 1)
+
+            pid = os.fork()
+            if pid == 0:
+                status = 1
+                try:
+                    client = BulletClient(pb.DIRECT)
+                    RenderingPlugin(client, CountingRenderer())
+                    shape_id = client.createVisualShape(pb.GEOM_MESH, fileName=filename)
+                    client.createMultiBody(baseVisualShapeIndex=shape_id)
+                    client.getCameraImage(8, 4)
+                    status = 0
+                finally:
+                    os._exit(status)
+            self.assertEqual(os.waitpid(pid, 0)[1], 0)
+
+    def test_prefetch_assets(self):
+        with tempfile.TemporaryDirectory() as directory:
+            filename = os.path.join(directory, 'square.obj')
+            with open(filename, 'w') as file:
+                file.write('v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\nf 1 2 3\nf 2 4 3\n')
+            missing = os.path.join(directory, 'missing.png')
+            prefetch = AssetPrefetch([filename, missing], CountingRenderer())
+            self.assertTrue(prefetch.wait(timeout=10.0))
+            self.assertTrue(prefetch.done())
+            times = prefetch.times()
+            self.assertEqual([time['filename'] for time in times], [filename, missing])
+            self.assertEqual([time['loaded'] for time in times], [True, False])
+            # python renderers upload nothing
+            self.assertFalse(any(time['uploaded'] for time in times))
+            self.assertGreaterEqual(times[0]['load_seconds'], 0.0)
+
+            client = BulletClient(pb.DIRECT)
+            plugin = RenderingPlugin(client, CountingRenderer())
+            self.assertTrue(plugin.prefetch_assets([]).done())
+            prefetch = plugin.prefetch_assets([filename])
+            self.assertTrue(prefetch.wait())
+            self.assertTrue(prefetch.times()[0]['loaded'])
+            plugin.unload()
+            client.disconnect()
+
+    def test_frame_sink(self):
+        client = BulletClient(pb.DIRECT)
+        plugin = RenderingPlugin(client, CountingRenderer())
+        plugin.set_frame_sink('pybullet_rendering_test', 8, 4, num_slots=2)
+        ring = FrameRing('pybullet_rendering_test')
+        self.assertEqual((ring.width, ring.height, ring.num_slots, ring.latest), (8, 4, 2, 0))
+
+        client.createMultiBody(
+            baseVisualShapeIndex=client.createVisualShape(pb.GEOM_SPHERE, radius=0.1))
+        client.getCameraImage(8, 4)
+        client.getCameraImage(16, 16)  # not of the ring size
+        sequence, color, depth, mask = ring.frame()
+        self.assertEqual(sequence, 1)
+        self.assertEqual(color.shape, (4, 8, 4))
+        np.testing.assert_equal(depth, 1)
+        self.assertFalse(depth.flags.writeable)
+
+        for _ in range(2):
+            client.getCameraImage(8, 4, flags=pb.ER_NO_SEGMENTATION_MASK)
+        self.assertFalse(ring.valid(1))
+        self.assertIsNone(ring.frame(3)[3])
+        plugin.set_frame_sink(None)
+
+    @unittest.skipIf(sys.platform == 'win32', 'shell script encoder')
+    def test_video_sink(self):
+        with tempfile.TemporaryDirectory() as directory:
+            # stand-in for ffmpeg, copying the raw frames to the output given last
+            encoder = os.path.join(directory, 'encoder.sh')
+            with open(encoder, 'w') as file:
+                file.write('#!/bin/sh\nfor last; do :; done\ncat > "$last"\n')
+            os.chmod(encoder, os.stat(encoder).st_mode | stat.S_IEXEC)
+            os.environ['PYBULLET_RENDERING_FFMPEG'] = encoder
+            try:
+                client = BulletClient(pb.DIRECT)
+                plugin = RenderingPlugin(client, CountingRenderer())
+                output = os.path.join(directory, 'video.raw')
+                plugin.start_video(output, 8, 4)
+                for _ in range(3):
+                    client.getCameraImage(8, 4)
+                client.getCameraImage(16, 16)  # not of the video size
+                plugin.stop_video()
+            finally:
+                del os.environ['PYBULLET_RENDERING_FFMPEG']
+            self.assertEqual(os.path.getsize(output), 3 * 8 * 4 * 4)
+
+    def test_recorder(self):
+        client = BulletClient(pb.DIRECT)
+        plugin = RenderingPlugin(client, CountingRenderer())
+        client.createMultiBody(
+            baseVisualShapeIndex=client.createVisualShape(pb.GEOM_SPHERE, radius=0.1))
+        with tempfile.TemporaryDirectory() as directory:
+            plugin.start_recording(directory, chunk_frames=2, compress=False)
+            for _ in range(3):
+                client.getCameraImage(8, 4)
+            client.getCameraImage(16, 16)  # not of the first frame size
+            plugin.stop_recording()
+
+            self.assertEqual(read_array(directory, 'depth').shape, (3, 4, 8))
+            np.testing.assert_equal(read_array(directory, 'depth'), 1)
+            self.assertEqual(read_array(directory, 'pose_begin').tolist(), [0, 1, 2])
+            self.assertEqual(read_array(directory, 'node_id').shape, (3,))
+
+    def test_remote_renderer(self):
+        client = BulletClient(pb.DIRECT)
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'trajectory.pkl')
+            recorder = TrajectoryRecorder(path)
+            plugin = RenderingPlugin(client, recorder)
+            client.createMultiBody(
+                baseVisualShapeIndex=client.createVisualShape(pb.GEOM_SPHERE, radius=0.1))
+            client.getCameraImage(1, 1)
+            plugin.unload()
+            recorder.close()
+            graphs, steps = load_trajectory(path)
+
+        renderer = CountingRenderer()
+        server = RenderServer(lambda: renderer)
+        remote = RemoteRenderer('127.0.0.1', server.port, max_pending=2)
+        remote.update_scene(graphs[0][1], False)
+        view = SceneView()
+        view.viewport = (8, 4)
+        view.camera = Camera(pb.computeViewMatrix((1, 0, 0), (0, 0, 0), (0, 0, 1)),
+                             pb.computeProjectionMatrixFOV(60, 2, 0.1, 10))
+        state = steps[0][0]
+        # the first response is still in flight
+        self.assertIsNone(remote.render_view(state, view))
+        color, depth, mask = remote.render_view(state, view)
+        self.assertEqual(color.shape, (4, 8, 4))
+        np.testing.assert_equal(depth, 1)
+        self.assertEqual(server.num_sessions, 1)
+        self.assertTrue(remote.connected)
+        del remote
+        server.stop()
+
+    @unittest.skipIf(sys.platform == 'win32', 'shared memory channels are POSIX only')
+    def test_shared_memory_renderer(self):
+        class FillingRenderer(CountingRenderer):
+            def update_scene(self, scene_graph, materials_only):
+                self.num_nodes = 3
+
+        renderer = FillingRenderer()
+        name = '/pbr_test_{}'.format(os.getpid())
+        host = threading.Thread(target=RenderServer.serve_shared_memory,
+                                args=(lambda: renderer, name))
+        host.start()
+        remote = RemoteRenderer.shared_memory(name, max_pending=2, timeout=10.)
+        scene_graph = SceneGraph()
+        remote.update_scene(scene_graph, False)
+        view = SceneView()
+        view.viewport = (8, 4)
+        view.camera = Camera(pb.computeViewMatrix((1, 0, 0), (0, 0, 0), (0, 0, 1)),
+                             pb.computeProjectionMatrixFOV(60, 2, 0.1, 10))
+        # frames come back from the slot of their request, one call later
+        self.assertIsNone(remote.render_view(SceneState(), view))
+        color, depth, mask = remote.render_view(SceneState(), view)
+        self.assertEqual(color.shape, (4, 8, 4))
+        np.testing.assert_equal(depth, 3)
+        self.assertTrue(remote.connected)
+        # the host returns once the renderer is gone
+        del remote
+        host.join(10.)
+        self.assertFalse(host.is_alive())
+
+    def test_replay(self):
+        client = BulletClient(pb.DIRECT)
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'trajectory.pkl')
+            recorder = TrajectoryRecorder(path)
+            plugin = RenderingPlugin(client, recorder)
+            client.createMultiBody(
+                baseVisualShapeIndex=client.createVisualShape(pb.GEOM_SPHERE, radius=0.1))
+            for _ in range(3):
+                client.getCameraImage(1, 1)
+            self.assertEqual(recorder.num_steps, 3)
+            plugin.unload()
+            recorder.close()
+
+            view = SceneView()
+            view.viewport = (8, 4)
+            view.camera = Camera(pb.computeViewMatrix((1, 0, 0), (0, 0, 0), (0, 0, 1)),
+                                 pb.computeProjectionMatrixFOV(60, 2, 0.1, 10))
+            parts = replay(path, [view, view], counting_renderer, directory, num_workers=0,
+                           compress=False)
+            self.assertEqual([part[1:] for part in parts], [(0, 3)])
+            depth = read_array(parts[0][0], 'depth')
+            self.assertEqual(depth.shape, (6, 4, 8))
+            np.testing.assert_equal(depth, 1)
+            np.testing.assert_allclose(
+                read_array(parts[0][0], 'view_matrix')[0], np.ravel(view.camera.view_matrix))
@@ -1,8 +1,20 @@
 import numpy as np
+import os
 import pickle
 import pybullet as pb
+import tempfile
+import zipfile
 
-from pybullet_rendering import ShapeType
+from pybullet_rendering import (AABB, BVH, AssetTable, BaseRenderer, LodPolicy, RaySensor,
+                                SceneTables, SegmentationMode, ShapeMatrices, ShapeType)
+from pybullet_rendering.bindings import (VertexBufferMode, cache_miss_ratio, clear_asset_files,
+                                         load_bitmap, load_cached_mesh, load_obj,
+                                         mesh_cache_directory, mesh_quantization,
+                                         mount_asset_archive, optimize_mesh, primitive_mesh,
+                                         prune_asset_cache, register_asset_file,
+                                         set_mesh_cache_directory, set_mesh_quantization,
+                                         set_texture_prefetch, set_vertex_buffer_mode,
+                                         store_cached_mesh, vertex_buffer_mode)
 from .base_test_case import BaseTestCase
 
 
@@ -97,9 +109,67 @@ class SceneGraphTest(BaseTestCase):
         self.assertIsNotNone(shape.mesh.data)
         np.testing.assert_almost_equal(shape.mesh.data.vertices, vertices)
         np.testing.assert_almost_equal(shape.mesh.data.faces.ravel(), indices)
+        np.testing.assert_equal(shape.mesh.data.indices, indices)
+        self.assertTrue(shape.mesh.data.indices.flags['C_CONTIGUOUS'])
         np.testing.assert_almost_equal(shape.mesh.data.uvs, uvs)
         np.testing.assert_almost_equal(shape.mesh.data.normals, normals)
 
+    def test_mesh_vertex_buffer(self):
+        vertices = self.random.rand(100, 3)
+        indices = self.random.randint(0, 100, size=90)
+        uvs = self.random.rand(100, 2)
+        normals = self.random.rand(100, 3)
+        mode = vertex_buffer_mode()
+        set_vertex_buffer_mode(VertexBufferMode.Float)
+        try:
+            shape = self._test_primitive(
+                shapeType=pb.GEOM_MESH, vertices=vertices, indices=indices, uvs=uvs,
+                normals=normals)
+        finally:
+            set_vertex_buffer_mode(mode)
+        buffer = shape.mesh.data.vertex_buffer
+        self.assertIsNotNone(buffer)
+        self.assertFalse(buffer.half_attributes)
+        self.assertEqual((buffer.stride, buffer.normal_offset, buffer.uv_offset), (32, 12, 24))
+        self.assertEqual(buffer.vertices.shape, (100, 32))
+        interleaved = buffer.vertices.view(np.float32)
+        np.testing.assert_almost_equal(interleaved[:, :3], vertices)
+        np.testing.assert_almost_equal(interleaved[:, 3:6], normals)
+        np.testing.assert_almost_equal(interleaved[:, 6:], uvs)
+        self.assertTrue(buffer.short_indices)
+        self.assertEqual(buffer.indices.dtype, np.uint16)
+        np.testing.assert_equal(buffer.indices, indices)
+
+    def test_mesh_quantization(self):
+        vertices = self.random.rand(1000, 3) * 4 - 2
+        indices = self.random.randint(0, 1000, size=3000)
+        uvs = self.random.rand(1000, 2)
+        normals = self.random.randn(1000, 3)
+        normals /= np.linalg.norm(normals, axis=1, keepdims=True)
+        enabled = mesh_quantization()
+        set_mesh_quantization(True)
+        try:
+            shape = self._test_primitive(
+                shapeType=pb.GEOM_MESH, vertices=vertices, indices=indices, uvs=uvs,
+                normals=normals)
+        finally:
+            set_mesh_quantization(enabled)
+        data = shape.mesh.data
+        self.assertTrue(data.quantized)
+        self.assertIsNone(data.vertex_buffer)
+        # pickled as 16 bits attributes
+        copy = pickle.loads(pickle.dumps(self.render.scene_graph))
+        _uid, node = next(copy.nodes.items())
+        self.assertTrue(node.shapes[0].mesh.data.quantized)
+        self.assertEqual(node.shapes[0].mesh.data, data)
+        float_size = (indices.size + vertices.size + uvs.size + normals.size) * 4
+        self.assertLess(len(pickle.dumps(self.render.scene_graph)), 0.7 * float_size)
+        # decoded on first access
+        np.testing.assert_allclose(data.vertices, vertices, atol=1e-4)
+        np.testing.assert_allclose(data.uvs, uvs, atol=1e-4)
+        np.testing.assert_allclose(data.normals, normals, atol=1e-3)
+        np.testing.assert_equal(data.indices, indices)
+
     def test_heightfield_primitive(self):
         shape = self._test_primitive(
             collision=True,
@@ -108,11 +178,19 @@ class SceneGraphTest(BaseTestCase):
             fileName="heightmaps/ground0.txt",
             heightfieldTextureScaling=128)
         self.assertEqual(shape.type, ShapeType.Heightfield)
-        self.assertIsNotNone(shape.mesh.data)
-        self.assertEqual(shape.mesh.data.vertices.shape, (960000, 3))
-        self.assertEqual(shape.mesh.data.uvs.shape, (960000, 2))
-        self.assertEqual(shape.mesh.data.normals.shape, (960000, 3))
-        self.assertEqual(shape.mesh.data.faces.shape, (320000, 3))
+        self.assertIsNone(shape.mesh)
+        heightfield = shape.heightfield
+        self.assertIsNotNone(heightfield)
+        self.assertEqual((heightfield.columns - 1) * (heightfield.rows - 1) * 2, 320000)
+        self.assertEqual(heightfield.heights.shape, (heightfield.rows, heightfield.columns))
+        self.assertEqual(heightfield.cell_size, [.5, .5])
+        data = primitive_mesh(shape)
+        points = heightfield.columns * heightfield.rows
+        self.assertEqual(data.vertices.shape, (points, 3))
+        self.assertEqual(data.uvs.shape, (points, 2))
+        self.assertEqual(data.normals.shape, (points, 3))
+        self.assertEqual(data.faces.shape, (320000, 3))
+        np.testing.assert_allclose(data.vertices[:, 2], heightfield.heights.ravel())
 
     def test_load_urdf(self):
         body_id = self.client.loadURDF("table/table.urdf")
@@ -131,6 +209,548 @@ class SceneGraphTest(BaseTestCase):
             self.assertIsNotNone(shape.material)
             self.assertIsNone(shape.material.diffuse_texture)
 
+    def test_mesh_asset_cache(self):
+        self.client.loadURDF("table/table.urdf")
+        self.client.loadURDF("table/table.urdf")
+        self.client.getCameraImage(320, 240)
+        asset_ids = {shape.mesh.asset_id
+                     for node in self.render.scene_graph.nodes.values()
+                     for shape in node.shapes}
+        self.assertEqual(len(asset_ids), 1)
+        asset_id, = asset_ids
+        self.assertGreaterEqual(asset_id, 0)
+        # kept across resets
+        self.client.resetSimulation()
+        self.client.loadURDF("table/table.urdf")
+        self.client.getCameraImage(320, 240)
+        _uid, node = next(self.render.scene_graph.nodes.items())
+        self.assertEqual(node.shapes[0].mesh.asset_id, asset_id)
+
+    def test_soft_body_geometry(self):
+        self.client.resetSimulation(pb.RESET_USE_DEFORMABLE_WORLD)
+        self.client.loadSoftBody("cloth_z_up.obj", basePosition=(0, 0, 1), scale=0.5, mass=1,
+                                 useNeoHookean=0, useBendingSprings=1, useMassSpring=1,
+                                 springElasticStiffness=40, springDampingStiffness=.1,
+                                 useSelfCollision=0, frictionCoeff=.5, useFaceContact=1)
+        self.client.getCameraImage(32, 24)
+        for _ in range(10):
+            self.client.stepSimulation()
+        self.client.getCameraImage(32, 24)
+
+        # streamed vertices keep the indices, uvs and normals of the mesh valid
+        shapes = [shape for node in self.render.scene_graph.nodes.values()
+                  for shape in node.shapes if shape.mesh is not None]
+        meshes = [shape.mesh.data for shape in shapes if shape.mesh.data is not None]
+        self.assertTrue(meshes)
+        for data in meshes:
+            count = len(data.vertices)
+            if len(data.uvs):
+                self.assertEqual(len(data.uvs), count)
+            if len(data.normals):
+                self.assertEqual(len(data.normals), count)
+            self.assertLess(data.indices.max(initial=0), count)
+
+    def test_soft_body_recolored_geometry(self):
+        self.client.resetSimulation(pb.RESET_USE_DEFORMABLE_WORLD)
+        body_id = self.client.loadSoftBody(
+            "cloth_z_up.obj", basePosition=(0, 0, 1), scale=0.5, mass=1, useNeoHookean=0,
+            useBendingSprings=1, useMassSpring=1, springElasticStiffness=40,
+            springDampingStiffness=.1, useSelfCollision=0, frictionCoeff=.5, useFaceContact=1)
+        self.client.getCameraImage(32, 24)
+        for _ in range(10):
+            self.client.stepSimulation()
+        self.client.changeVisualShape(body_id, -1, rgbaColor=(1.0, 0.5, 0.2, 1.0))
+        self.client.getCameraImage(32, 24)
+
+        # vertices streamed along with a new color are not dropped for a material update
+        delta = self.render.scene_delta
+        self.assertTrue(delta.changed)
+        self.assertEqual(delta.geometry_changed, delta.changed)
+        self.assertFalse(delta.materials_only)
+        self.assertFalse(self.render.materials_only)
+        for uid in delta.changed:
+            shape = self.render.scene_graph.nodes[uid].shapes[0]
+            np.testing.assert_almost_equal(shape.material.diffuse_color, (1.0, 0.5, 0.2, 1.0))
+
+    def test_asset_keyed_cache(self):
+        try:
+            from pybullet_rendering.render.utils import asset_keyed_cache, evict_pruned_assets
+        except ImportError:
+            self.skipTest('trimesh is not available')
+        body_id = self.client.loadURDF("table/table.urdf")
+        self.client.getCameraImage(32, 24)
+        _uid, node = next(self.render.scene_graph.nodes.items())
+        asset_id = node.shapes[0].mesh.asset_id
+        del node
+
+        cache = asset_keyed_cache()
+        cache[asset_id] = 'table'
+        cache['table.obj'] = 'uncached table'
+        # assets in use are kept
+        prune_asset_cache()
+        evict_pruned_assets()
+        self.assertEqual(cache, {asset_id: 'table'})
+        self.client.removeBody(body_id)
+        self.client.getCameraImage(32, 24)
+        prune_asset_cache()
+        evict_pruned_assets()
+        self.assertEqual(cache, {})
+
+    def test_base_layer(self):
+        table_id = self.client.loadURDF("table/table.urdf", basePosition=(1, 2, 0))
+        self.client.loadURDF("table/table.urdf", basePosition=(-1, 0, 0))
+        self.client.getCameraImage(320, 240)
+        layer = self.plugin.make_base_layer([table_id])
+        self.assertEqual(layer.size, 1)
+        self.assertEqual(layer.body_ids, {table_id})
+        node_id, = layer.node_ids
+        np.testing.assert_almost_equal(layer.matrix(node_id),
+                                       self.render.scene_state.matrix(node_id))
+        self.assertGreater(layer.bounds.lower[0], 0)
+        # renderers not drawing layers keep the nodes of its bodies
+        self.plugin.set_base_layer(layer)
+        self.client.getCameraImage(320, 240)
+        self.assertEqual(len(self.render.scene_graph.nodes), 2)
+        self.plugin.set_base_layer(None)
+
+
+        body_ids = [self.client.loadURDF("table/table.urdf") for _ in range(2)]
+        scaled_id = self.client.loadURDF("table/table.urdf", globalScaling=2.0)
+        # shapes of the second load are shared, not changed along with the first
+        self.client.changeVisualShape(
+            body_ids[0], -1, shapeIndex=2, rgbaColor=(1.0, 0.5, 0.2, 1.0))
+        self.client.getCameraImage(320, 240)
+        nodes = {node.body: node for node in self.render.scene_graph.nodes.values()}
+        np.testing.assert_almost_equal(
+            nodes[body_ids[0]].shapes[2].material.diffuse_color, (1.0, 0.5, 0.2, 1.0))
+        self.assertFalse(np.allclose(
+            nodes[body_ids[1]].shapes[2].material.diffuse_color, (1.0, 0.5, 0.2, 1.0)))
+        # other loading options convert the link again
+        np.testing.assert_almost_equal(
+            nodes[scaled_id].shapes[0].pose.scale,
+            np.multiply(nodes[body_ids[1]].shapes[0].pose.scale, 2.0))
+
+    def test_material_interning(self):
+        self.client.loadURDF("table/table.urdf")
+        self.client.getCameraImage(320, 240)
+        count = self.render.scene_graph.unique_materials
+        self.assertGreater(count, 0)
+        # converted again with other options, equal materials are shared
+        self.client.loadURDF("table/table.urdf", globalScaling=2.0)
+        self.client.getCameraImage(320, 240)
+        self.assertEqual(self.render.scene_graph.unique_materials, count)
+        # equal colors given to shapes of both bodies share a single material
+        for node in self.render.scene_graph.nodes.values():
+            self.client.changeVisualShape(
+                node.body, -1, shapeIndex=2, rgbaColor=(1.0, 0.5, 0.2, 1.0))
+        self.client.getCameraImage(320, 240)
+        self.assertLessEqual(self.render.scene_graph.unique_materials, count + 1)
+
+    def test_node_arrays(self):
+        vis_id = self.client.createVisualShape(pb.GEOM_SPHERE, radius=0.5)
+        body_ids = self.client.createMultiBody(
+            baseVisualShapeIndex=vis_id, batchPositions=[(i, 0, 0) for i in range(5)])
+        self.client.getCameraImage(32, 24)
+        nodes = self.render.scene_graph.nodes
+        self.assertEqual(list(nodes.ids), list(nodes.keys()))
+        self.assertEqual(list(nodes.bodies), [node.body for node in nodes.values()])
+        self.assertEqual(list(nodes.links), [node.link for node in nodes.values()])
+        self.assertEqual(sorted(nodes.bodies), sorted(body_ids))
+        # the last node takes the place of a removed one
+        self.client.removeBody(body_ids[1])
+        self.client.getCameraImage(32, 24)
+        nodes = self.render.scene_graph.nodes
+        self.assertEqual(len(nodes.ids), 4)
+        self.assertEqual(sorted(nodes.bodies), sorted(body_ids[:1] + body_ids[2:]))
+        self.assertEqual(list(nodes.ids), list(nodes))
+        self.assertNotIn('a', nodes)
+
+    def test_material_pool(self):
+        vis_id = self.client.createVisualShape(
+            pb.GEOM_BOX, halfExtents=[0.1, 0.1, 0.1], rgbaColor=[0.3, 0.6, 0.9, 1.0])
+        for i in range(10):
+            self.client.createMultiBody(baseVisualShapeIndex=vis_id, basePosition=[i, 0, 0])
+        self.client.getCameraImage(32, 24)
+        # converted materials are interned by value, only the first one allocated
+        self.assertEqual(self.render.scene_graph.unique_materials, 1)
+        self.assertEqual(self.render.scene_graph.pooled_materials, 1)
+
+    def test_mesh_file_cache(self):
+        previous = mesh_cache_directory()
+        with tempfile.TemporaryDirectory() as directory:
+            filename = os.path.join(directory, 'triangle.obj')
+            with open(filename, 'w') as file:
+                file.write('v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n')
+            vertices = np.eye(3, dtype=np.float32)[::-1]
+            normals = np.tile(np.float32([0, 0, 1]), (3, 1))
+            faces = np.int32([[0, 1, 2]])
+            try:
+                set_mesh_cache_directory(os.path.join(directory, 'cache'))
+                self.assertIsNone(load_cached_mesh(filename, 'test'))
+                store_cached_mesh(filename, 'test', vertices, np.zeros((0, 2)), normals, faces)
+                data = load_cached_mesh(filename, 'test')
+                np.testing.assert_equal(data.vertices, vertices)
+                np.testing.assert_equal(data.normals, normals)
+                np.testing.assert_equal(data.faces, faces)
+                self.assertEqual(len(data.uvs), 0)
+                # entries are keyed by loader and file content
+                self.assertIsNone(load_cached_mesh(filename, 'other'))
+                with open(filename, 'a') as file:
+                    file.write('f 3 2 1\n')
+                self.assertIsNone(load_cached_mesh(filename, 'test'))
+            finally:
+                set_mesh_cache_directory(previous)
+
+    def test_load_obj(self):
+        with tempfile.TemporaryDirectory() as directory:
+            filename = os.path.join(directory, 'quads.obj')
+            with open(filename, 'w') as file:
+                file.write('# two quads\n'
+                           'v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n'
+                           'vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvt 0.5 0.5\n'
+                           'o first\nf 1/1 2/2 3/3 4/4\n'
+                           'o second\r\nf -4/5 -3/2 -2/3 -1/4\r\n')
+            data = load_obj(filename)
+            # the first corner of the second quad is a new vertex, other ones are shared
+            self.assertEqual(data.vertices.shape, (5, 3))
+            np.testing.assert_equal(data.faces, [[0, 1, 2], [0, 2, 3], [4, 1, 2], [4, 2, 3]])
+            np.testing.assert_almost_equal(data.uvs[4], [0.5, 0.5])
+            self.assertEqual(len(data.normals), 0)
+            # chunks parsed by several threads yield the same mesh
+            chunked = load_obj(filename, num_threads=3)
+            np.testing.assert_equal(chunked.vertices, data.vertices)
+            np.testing.assert_equal(chunked.faces, data.faces)
+            with open(filename, 'a') as file:
+                file.write('f 1 2 9\n')
+            self.assertIsNone(load_obj(filename))
+
+    def test_segmentation_ids(self):
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=(1, 1, 1))
+        body_ids = [self.client.createMultiBody(baseVisualShapeIndex=vis_id) for _ in range(2)]
+        self.client.getCameraImage(32, 24)
+        nodes = self.render.scene_graph.nodes
+        uids = {nodes[uid].body: uid for uid in nodes}
+
+        # ids of links already in the scene and of links loaded later
+        self.assertEqual(self.plugin.set_segmentation_ids([body_ids[0]], [-1], instance_ids=[7],
+                                                          semantic_ids=[3]), 1)
+        self.assertEqual(self.plugin.set_segmentation_ids([9], [-1], [0], [8], [4]), 0)
+        self.plugin.set_segmentation_mode(SegmentationMode.Instance)
+        self.client.getCameraImage(32, 24)
+        scene_graph = self.render.scene_graph
+        self.assertEqual(scene_graph.segmentation_mode, SegmentationMode.Instance)
+        self.assertLessEqual(set(uids.values()), self.render.scene_delta.added)
+        self.assertEqual(scene_graph.segmentation(uids[body_ids[0]], 0), 7)
+        self.assertEqual(scene_graph.segmentation(uids[body_ids[1]], 0), body_ids[1])
+
+        node = scene_graph.nodes[uids[body_ids[0]]]
+        self.assertEqual((node.instance_id, node.semantic_id), (7, 3))
+        self.assertEqual(node.shapes[0].instance_id, -1)
+        self.assertEqual(node.segmentation(0, SegmentationMode.Semantic), 3)
+        self.assertEqual(node.segmentation(0, SegmentationMode.BodyLink), body_ids[0])
+        other = scene_graph.nodes[uids[body_ids[1]]]
+        self.assertEqual(other.segmentation(0, SegmentationMode.Semantic), 0)
+        self.assertEqual(pickle.loads(pickle.dumps(scene_graph)), scene_graph)
+
+        # shape ids override those of the link
+        self.plugin.set_segmentation_ids([body_ids[0]], [-1], [0], [11], [5])
+        self.client.getCameraImage(32, 24)
+        self.assertEqual(self.render.scene_graph.segmentation(uids[body_ids[0]], 0), 11)
+
+    def test_transparent_shapes(self):
+        for alpha in (1.0, 0.5, 0.2):
+            vis_id = self.client.createVisualShape(pb.GEOM_SPHERE, radius=0.5,
+                                                   rgbaColor=(1, 0, 0, alpha))
+            self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        self.client.getCameraImage(32, 24)
+        scene_graph = self.render.scene_graph
+        self.assertEqual(scene_graph.transparent_shapes, 2)
+        transparent = [node.shapes[0].material.transparent for node in scene_graph.nodes.values()]
+        self.assertEqual(sorted(transparent), [False, True, True])
+
+    def test_asset_archive(self):
+        text = 'v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\nf 1 2 3\nf 2 4 3\n' * 100
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'assets.zip')
+            with zipfile.ZipFile(path, 'w') as archive:
+                archive.writestr('meshes/stored.obj', text, compress_type=zipfile.ZIP_STORED)
+                archive.writestr('meshes/deflated.obj', text, compress_type=zipfile.ZIP_DEFLATED)
+                archive.writestr('meshes/', '')
+            filename = os.path.join(directory, 'quads.obj')
+            with open(filename, 'w') as file:
+                file.write(text)
+            expected = load_obj(filename)
+            try:
+                self.assertEqual(mount_asset_archive(filename), -1)
+                self.assertEqual(mount_asset_archive(path, prefix='data/'), 2)
+                for name in ('data/meshes/stored.obj', 'data/meshes/deflated.obj'):
+                    data = load_obj(name)
+                    np.testing.assert_equal(data.vertices, expected.vertices)
+                    np.testing.assert_equal(data.faces, expected.faces)
+                self.assertIsNone(load_obj('meshes/stored.obj'))
+                # registered files come first
+                triangle = b'v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n'
+                register_asset_file('data/meshes/stored.obj', triangle)
+                self.assertEqual(len(load_obj('data/meshes/stored.obj').faces), 1)
+            finally:
+                clear_asset_files()
+            self.assertIsNone(load_obj('data/meshes/deflated.obj'))
+
+    def test_optimize_mesh(self):
+        # 30 x 30 quads grid, triangles shuffled and each with its own corners
+        quads = np.arange(31 * 30).reshape(30, 31)[:, :30].ravel()
+        faces = np.concatenate([np.stack([quads, quads + 1, quads + 32], axis=1),
+                                np.stack([quads, quads + 32, quads + 31], axis=1)])
+        faces = faces[self.random.permutation(len(faces))]
+        with tempfile.TemporaryDirectory() as directory:
+            filename = os.path.join(directory, 'grid.obj')
+            with open(filename, 'w') as file:
+                for corner in faces.ravel():
+                    file.write('v {} {} 0\n'.format(corner % 31, corner // 31))
+                for i in range(len(faces)):
+                    file.write('f {} {} {}\n'.format(i * 3 + 1, i * 3 + 2, i * 3 + 3))
+            data = load_obj(filename)
+        self.assertEqual(len(data.vertices), len(faces) * 3)
+        optimized, stats = optimize_mesh(data)
+        self.assertEqual(stats.vertices_before, len(faces) * 3)
+        self.assertEqual(stats.vertices_after, 31 * 31)
+        self.assertEqual(stats.triangles, len(faces))
+        self.assertAlmostEqual(stats.acmr_before, 3.0)
+        self.assertLess(stats.acmr_after, 1.0)
+        self.assertAlmostEqual(stats.acmr_after, cache_miss_ratio(optimized.indices), places=5)
+        # same triangles, vertices in order of first use
+        self.assertEqual(
+            sorted(map(sorted, data.vertices[data.faces].tolist())),
+            sorted(map(sorted, optimized.vertices[optimized.faces].tolist())))
+        np.testing.assert_equal(np.unique(optimized.indices, return_index=True)[1],
+                                np.sort(np.unique(optimized.indices, return_index=True)[1]))
+
+    def test_instance_groups(self):
+        vis_id = self.client.createVisualShape(pb.GEOM_MESH, fileName='cube.obj')
+        body_ids = self.client.createMultiBody(
+            baseVisualShapeIndex=vis_id,
+            batchPositions=[(0, 0, 0), (1, 0, 0), (2, 0, 0)])
+        self.client.getCameraImage(320, 240)
+        groups = self.render.scene_graph.instance_groups
+        self.assertEqual(len(groups), 1)
+        node_ids, = groups.values()
+        self.assertEqual(len(node_ids), len(body_ids))
+        nodes = self.render.scene_graph.nodes
+        asset_ids = {nodes[uid].shapes[0].mesh.asset_id for uid in node_ids}
+        self.assertEqual(len(asset_ids), 1)
+        # one world matrix per instance
+        matrices = BaseRenderer.instance_matrices(
+            self.render.scene_graph, self.render.scene_state, node_ids)
+        self.assertEqual(matrices.shape, (3, 4, 4))
+        np.testing.assert_almost_equal(sorted(matrices[:, 3, 0]), [0, 1, 2])
+        # a node with a different material leaves the group
+        self.client.changeVisualShape(body_ids[0], -1, rgbaColor=(1.0, 0.5, 0.2, 1.0))
+        self.client.getCameraImage(320, 240)
+        sizes = sorted(map(len, self.render.scene_graph.instance_groups.values()))
+        self.assertEqual(sizes, [1, 2])
+
+    def test_collision_instance_groups(self):
+        col_id = self.client.createCollisionShape(pb.GEOM_BOX, halfExtents=(0.5, 0.5, 0.5))
+        self.client.createMultiBody(baseCollisionShapeIndex=col_id,
+                                    batchPositions=[(0, 0, 0), (1, 0, 0), (2, 0, 0)])
+        self.client.getCameraImage(32, 24)
+        scene_graph = self.render.scene_graph
+        # boxes of equal size share their tessellation and the palette material
+        self.assertEqual(list(map(len, scene_graph.instance_groups.values())), [3])
+        self.assertEqual(scene_graph.unique_materials, 1)
+
+    def test_bounds(self):
+        shape = self._test_primitive(
+            shapeType=pb.GEOM_BOX, halfExtents=[1.0, 2.0, 3.0])
+        np.testing.assert_almost_equal(shape.bounds.lower, [-1, -2, -3])
+        np.testing.assert_almost_equal(shape.bounds.upper, [1, 2, 3])
+        uid, node = next(self.render.scene_graph.nodes.items())
+        # in the node frame, shifted by the shape pose
+        np.testing.assert_almost_equal(node.bounds.lower, [-4, -4, -4])
+        np.testing.assert_almost_equal(node.bounds.upper, [-2, 0, 2])
+        world = self.render.scene_graph.world_bounds(uid, self.render.scene_state)
+        self.assertEqual(world, node.bounds)
+
+    def test_visible_nodes(self):
+        vis_id = self.client.createVisualShape(pb.GEOM_SPHERE, radius=0.5)
+        body_ids = self.client.createMultiBody(
+            baseVisualShapeIndex=vis_id,
+            batchPositions=[(0, 0, 0), (1, 0, 0), (100, 0, 0), (0, 0, 10)])
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        self.client.getCameraImage(320, 240, view, proj)
+        scene_graph = self.render.scene_graph
+        visible = scene_graph.visible_nodes(
+            self.render.scene_state, self.render.scene_view.camera)
+        self.assertEqual(sorted(scene_graph.nodes[uid].body for uid in visible),
+                         sorted(body_ids[:2]))
+
+    def test_bvh(self):
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        body_ids = self.client.createMultiBody(
+            baseVisualShapeIndex=vis_id,
+            batchPositions=[(0, 0, 0), (3, 0, 0), (6, 0, 0)])
+        bvh = BVH()
+
+        def refit(_frame):
+            # dirty poses are those of the frame being rendered
+            bvh.update(self.render.scene_graph, self.render.scene_state)
+            return False
+
+        self.render.render_frame_fn = refit
+        self.client.getCameraImage(320, 240)
+        scene_graph = self.render.scene_graph
+        self.assertEqual(bvh.size, 3)
+        uids = {scene_graph.nodes[uid].body: uid for uid in scene_graph.nodes.keys()}
+        # overlap
+        hits = bvh.query(AABB((2, -1, -1), (4, 1, 1)))
+        self.assertEqual(hits, [uids[body_ids[1]]])
+        # ray along x, closest first
+        hits = bvh.raycast((-5, 0, 0), (1, 0, 0), 100.0)
+        self.assertEqual([uid for uid, _ in hits], [uids[i] for i in body_ids])
+        self.assertAlmostEqual(hits[0][1], 4.5, places=5)
+        # refit after a move
+        self.client.resetBasePositionAndOrientation(body_ids[0], (20, 0, 0), (0, 0, 0, 1))
+        self.client.getCameraImage(320, 240)
+        np.testing.assert_almost_equal(bvh.world_bounds(uids[body_ids[0]]).lower,
+                                       [19.5, -0.5, -0.5])
+
+    def test_ray_sensor(self):
+        vis_id = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5])
+        body_id = self.client.createMultiBody(baseVisualShapeIndex=vis_id)
+        self.client.getCameraImage(32, 24)
+        scene_graph, scene_state = self.render.scene_graph, self.render.scene_state
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(90, 1.0, 0.1, 20.0)
+        sensor = RaySensor()
+        # pinhole depth
+        sensor.set_pinhole(9, 9, proj)
+        self.assertAlmostEqual(sensor.range[0], 0.1, places=5)
+        ranges, ids = sensor.cast(scene_graph, scene_state, view)
+        self.assertEqual(ranges.shape, (9, 9))
+        self.assertAlmostEqual(ranges[4, 4], 4.5, places=4)
+        self.assertEqual(ids[4, 4], body_id)
+        self.assertEqual((ranges[0, 0], ids[0, 0]), (0, -1))
+        self.assertEqual(sensor.num_triangles, 12)
+        # spinning lidar into preallocated buffers
+        sensor.set_lidar(3, 9, -0.3, 0.3)
+        sensor.num_threads = 2
+        ranges = np.zeros((3, 9), np.float32)
+        ids = np.zeros((3, 9), np.int32)
+        sensor.cast(scene_graph, scene_state, view, ranges, ids)
+        self.assertAlmostEqual(ranges[1, 4], 4.5, places=4)
+        self.assertEqual(ids[1, 4], body_id)
+        self.assertEqual((ranges[1, 0], ids[1, 0]), (0, -1))
+        with self.assertRaises(ValueError):
+            sensor.cast(scene_graph, scene_state, view, np.zeros((3, 9), np.float64))
+
+    def test_shape_matrices(self):
+        vis_id = self.client.createVisualShape(
+            pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5], visualFramePosition=[0, 0, 1])
+        body_ids = self.client.createMultiBody(
+            baseVisualShapeIndex=vis_id, batchPositions=[(0, 0, 0), (3, 0, 0), (6, 0, 0)])
+        matrices = ShapeMatrices()
+
+        def update(_frame):
+            matrices.update(self.render.scene_graph, self.render.scene_state)
+            return False
+
+        self.render.render_frame_fn = update
+        self.client.getCameraImage(32, 24)
+        self.assertEqual(len(matrices), 3)
+        self.assertEqual(matrices.updated, 3)
+
+        def check():
+            scene_graph, scene_state = self.render.scene_graph, self.render.scene_state
+            for i, (uid, index) in enumerate(zip(matrices.node_ids, matrices.shape_indices)):
+                local = scene_graph.nodes[uid].shapes[index].pose.matrix
+                # column-major matrices read row-major, hence transposed
+                np.testing.assert_almost_equal(matrices.matrices[i],
+                                               local @ scene_state.matrix(uid), decimal=5)
+
+        check()
+        # only the shapes of moved nodes are computed again
+        self.client.getCameraImage(32, 24)
+        self.assertEqual(matrices.updated, 0)
+        self.client.resetBasePositionAndOrientation(body_ids[1], (0, 5, 0), (0, 0, 1, 0))
+        self.client.getCameraImage(32, 24)
+        self.assertEqual(matrices.updated, 1)
+        check()
+
+    def test_scene_tables(self):
+        box = self.client.createVisualShape(pb.GEOM_BOX, halfExtents=[0.5, 0.5, 0.5],
+                                            rgbaColor=[1, 0, 0, 1])
+        sphere = self.client.createVisualShape(pb.GEOM_SPHERE, radius=0.25,
+                                               rgbaColor=[0, 1, 0, 1])
+        self.client.createMultiBody(baseVisualShapeIndex=box, batchPositions=[(0, 0, 0), (3, 0, 0)])
+        self.client.createMultiBody(baseVisualShapeIndex=sphere, basePosition=(6, 0, 0))
+        self.client.getCameraImage(32, 24)
+        scene_graph = self.render.scene_graph
+        tables = SceneTables(scene_graph)
+
+        nodes, shapes, materials = tables.nodes, tables.shapes, tables.materials
+        np.testing.assert_equal(nodes['uid'], scene_graph.nodes.ids)
+        np.testing.assert_equal(nodes['body'], scene_graph.nodes.bodies)
+        self.assertEqual(nodes['num_shapes'].sum(), len(shapes))
+        for row, (uid, node) in enumerate(scene_graph.nodes.items()):
+            first = nodes['first_shape'][row]
+            for i, shape in enumerate(node.shapes):
+                record = shapes[first + i]
+                self.assertEqual(record['node'], row)
+                self.assertEqual(record['type'], int(shape.type))
+                np.testing.assert_almost_equal(record['matrix'].reshape(4, 4),
+                                               shape.pose.matrix, decimal=5)
+                color = materials['diffuse_color'][record['material']]
+                np.testing.assert_almost_equal(color, shape.material.diffuse_color)
+        # materials shared by the boxes are listed once
+        self.assertEqual(len(materials), 2)
+        self.assertEqual(len(tables.textures), 0)
+        self.assertTrue(np.all(materials['texture'] == -1))
+
+        # rebuilt only when the scene changes
+        self.assertFalse(tables.update(scene_graph))
+        self.client.createMultiBody(baseVisualShapeIndex=sphere, basePosition=(9, 0, 0))
+        self.client.getCameraImage(32, 24)
+        self.assertTrue(tables.update(self.render.scene_graph))
+        self.assertEqual(len(tables.nodes), 4)
+
+    def test_primitive_mesh(self):
+        shape = self._test_primitive(shapeType=pb.GEOM_SPHERE, radius=0.5)
+        data = primitive_mesh(shape)
+        np.testing.assert_almost_equal(np.linalg.norm(data.vertices, axis=1), 0.5, decimal=5)
+        np.testing.assert_almost_equal(data.bounds.upper, [0.5, 0.5, 0.5], decimal=5)
+        # tessellated once per set of dimensions and level
+        self.assertIs(primitive_mesh(shape), data)
+        finer = primitive_mesh(shape, tessellation=2)
+        self.assertGreater(len(finer.faces), len(data.faces))
+
+    def test_mesh_lods(self):
+        # 40 x 40 quads grid
+        xs, ys = np.meshgrid(np.linspace(-1, 1, 41), np.linspace(-1, 1, 41))
+        vertices = np.stack([xs.ravel(), ys.ravel(), np.zeros(xs.size)], axis=1)
+        quads = np.arange(41 * 40).reshape(40, 41)[:, :40].ravel()
+        indices = np.stack([quads, quads + 1, quads + 42, quads, quads + 42, quads + 41],
+                           axis=1).ravel()
+        shape = self._test_primitive(
+            shapeType=pb.GEOM_MESH, vertices=vertices, indices=indices)
+        # missing normals are computed when the shape is converted
+        np.testing.assert_almost_equal(
+            shape.mesh.data.normals, np.tile([0, 0, 1], (len(vertices), 1)))
+        counts = [len(lod.faces) for lod in shape.mesh.lods]
+        self.assertGreater(len(counts), 0)
+        self.assertLess(counts[0], len(indices) // 3)
+        self.assertEqual(counts, sorted(counts, reverse=True))
+        # coarser levels as the mesh gets away from the camera
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        self.client.getCameraImage(320, 240, view, proj)
+        policy = LodPolicy(256)
+        camera = self.render.scene_view.camera
+        levels = [policy.select(AABB((-1, -1, z), (1, 1, z)), camera, 240, 5)
+                  for z in (-2, -8, -32, -1000)]
+        self.assertEqual(levels, sorted(levels))
+        self.assertEqual(levels[-1], 4)
+
     def test_load_urdf_external_materials(self):
         self.client.loadURDF("table/table.urdf",
                              flags=pb.URDF_USE_MATERIAL_COLORS_FROM_MTL)
@@ -147,6 +767,66 @@ class SceneGraphTest(BaseTestCase):
         np.testing.assert_almost_equal(
             node.shapes[2].material.diffuse_color, (1.0, 0.5, 0.2, 1.0))
 
+    def test_change_materials(self):
+        body_ids = [self.client.loadURDF("table/table.urdf") for _ in range(2)]
+        tex_uid = self.client.loadTexture("table/table.png")
+        self.client.getCameraImage(320, 240)
+        changed = self.plugin.change_materials(
+            body_ids, [-1, -1], shape_ids=[2, -1],
+            colors=[(1.0, 0.5, 0.2, 1.0), (0.0, 0.0, 0.0, -1.0)], texture_ids=[-2, tex_uid])
+        self.assertEqual(changed, 6)
+        self.client.getCameraImage(320, 240)
+        self.assertTrue(self.render.scene_delta.materials_only)
+        self.assertTrue(self.render.materials_only)
+        nodes = {node.body: node for node in self.render.scene_graph.nodes.values()}
+        np.testing.assert_almost_equal(
+            nodes[body_ids[0]].shapes[2].material.diffuse_color, (1.0, 0.5, 0.2, 1.0))
+        self.assertIsNone(nodes[body_ids[0]].shapes[2].material.diffuse_texture)
+        for shape in nodes[body_ids[1]].shapes:
+            self.assertTrue(shape.material.diffuse_texture.filename.endswith("table.png"))
+        np.testing.assert_almost_equal(
+            self.client.getVisualShapeData(body_ids[0])[2][7], (1.0, 0.5, 0.2, 1.0))
+
+    def test_change_materials_deformed(self):
+        self.client.resetSimulation(pb.RESET_USE_DEFORMABLE_WORLD)
+        body_id = self.client.loadSoftBody(
+            "cloth_z_up.obj", basePosition=(0, 0, 1), scale=0.5, mass=1, useNeoHookean=0,
+            useBendingSprings=1, useMassSpring=1, springElasticStiffness=40,
+            springDampingStiffness=.1, useSelfCollision=0, frictionCoeff=.5, useFaceContact=1)
+        self.client.getCameraImage(32, 24)
+        for _ in range(10):
+            self.client.stepSimulation()
+        self.assertGreater(self.plugin.change_materials(
+            [body_id], [-1], shape_ids=[-1], colors=[(1.0, 0.5, 0.2, 1.0)], texture_ids=[-2]), 0)
+        self.client.getCameraImage(32, 24)
+        # materials are not swapped in place alone, the deformed vertices come along
+        delta = self.render.scene_delta
+        self.assertTrue(delta.changed)
+        self.assertEqual(delta.geometry_changed, delta.changed)
+        self.assertFalse(delta.materials_only)
+        self.assertFalse(self.render.materials_only)
+
+    def test_texture_prefetch(self):
+        set_texture_prefetch(True)
+        try:
+            body_id = self.client.loadURDF("table/table.urdf")
+            tex_uid = self.client.loadTexture("table/table.png")
+            self.client.changeVisualShape(body_id, -1, textureUniqueId=tex_uid)
+            self.client.getCameraImage(32, 24)
+        finally:
+            set_texture_prefetch(False)
+        _uid, node = next(self.render.scene_graph.nodes.items())
+        texture = node.shapes[0].material.diffuse_texture
+        self.assertGreaterEqual(texture.asset_id, 0)
+        bitmap = load_bitmap(texture)
+        if bitmap is None:
+            self.skipTest('built without stb_image')
+        pixels = np.asarray(bitmap)
+        self.assertEqual(pixels.ndim, 3)
+        self.assertEqual(pixels.shape[2], 4)
+        # decoded once per process
+        self.assertIs(load_bitmap(texture), bitmap)
+
     def test_change_texture(self):
         body_id = self.client.loadURDF("table/table.urdf")
         tex_uid = self.client.loadTexture("table/table.png")
@@ -160,6 +840,40 @@ class SceneGraphTest(BaseTestCase):
             filename = shape.material.diffuse_texture.filename
             self.assertTrue(filename.endswith("table.png"))
 
+    def test_update_texture(self):
+        body_id = self.client.loadURDF("table/table.urdf")
+        pixels = np.zeros((4, 8, 3), dtype=np.uint8)
+        tex_uid = self.plugin.register_texture(pixels)
+        self.client.changeVisualShape(body_id, -1, textureUniqueId=tex_uid)
+        self.client.getCameraImage(320, 240)
+        _uid, node = next(self.render.scene_graph.nodes.items())
+        revision = node.shapes[0].material.diffuse_texture.bitmap.revision
+        # the texture reads the pixels of the array itself
+        pixels[..., 0] = 255
+        self.assertEqual(self.plugin.update_texture(tex_uid), 1)
+        self.client.getCameraImage(320, 240)
+        delta = self.render.scene_delta
+        self.assertTrue(delta.texels_only)
+        self.assertEqual(len(delta.texels_changed), 1)
+        _uid, node = next(self.render.scene_graph.nodes.items())
+        bitmap = node.shapes[0].material.diffuse_texture.bitmap
+        self.assertTrue(bitmap.wrapped)
+        self.assertGreater(bitmap.revision, revision)
+        np.testing.assert_equal(np.asarray(bitmap), pixels)
+
+    def test_texture_dedupe(self):
+        body_id = self.client.loadURDF("table/table.urdf")
+        tex_uid_0 = self.client.loadTexture("table/table.png")
+        tex_uid_1 = self.client.loadTexture("table/table.png")
+        self.client.changeVisualShape(body_id, -1, shapeIndex=0, textureUniqueId=tex_uid_0)
+        self.client.changeVisualShape(body_id, -1, shapeIndex=1, textureUniqueId=tex_uid_1)
+        self.client.getCameraImage(320, 240)
+        _uid, node = next(self.render.scene_graph.nodes.items())
+        texture_0 = node.shapes[0].material.diffuse_texture
+        texture_1 = node.shapes[1].material.diffuse_texture
+        self.assertGreaterEqual(texture_0.asset_id, 0)
+        self.assertEqual(texture_0.asset_id, texture_1.asset_id)
+
     def test_update_materials_only(self):
         body_id = self.client.loadURDF("table/table.urdf")
         self.client.getCameraImage(320, 240)
@@ -170,6 +884,32 @@ class SceneGraphTest(BaseTestCase):
         self.client.getCameraImage(320, 240)
         self.assertTrue(self.render.materials_only)
 
+    def test_scene_delta(self):
+        self.client.getCameraImage(320, 240)
+        self.assertIsNone(self.render.scene_delta)
+        # add a body
+        body_id = self.client.loadURDF("table/table.urdf")
+        self.client.getCameraImage(320, 240)
+        uid, _node = next(self.render.scene_graph.nodes.items())
+        delta = self.render.scene_delta
+        self.assertEqual(delta.added, {uid})
+        self.assertEqual(delta.removed, set())
+        self.assertEqual(delta.changed, set())
+        # change materials
+        self.client.changeVisualShape(
+            body_id, -1, shapeIndex=2, rgbaColor=(1, 1, 1, 1))
+        self.client.getCameraImage(320, 240)
+        delta = self.render.scene_delta
+        self.assertTrue(delta.materials_only)
+        self.assertEqual(delta.changed, {uid})
+        # remove a body
+        self.client.removeBody(body_id)
+        self.client.getCameraImage(320, 240)
+        delta = self.render.scene_delta
+        self.assertEqual(delta.added, set())
+        self.assertEqual(delta.removed, {uid})
+        self.assertEqual(len(self.render.scene_graph.nodes), 0)
+
     def test_scene_graph_pickle(self):
         body_id = self.client.loadURDF("table/table.urdf")
         tex_uid = self.client.loadTexture("table/table.png")
@@ -180,3 +920,78 @@ class SceneGraphTest(BaseTestCase):
         buffer = pickle.dumps(self.render.scene_graph)
         scene_graph_copy = pickle.loads(buffer)
         self.assertEqual(self.render.scene_graph, scene_graph_copy)
+
+    def test_content_hash(self):
+        body_id = self.client.loadURDF("table/table.urdf")
+        pixels = np.zeros((4, 8, 3), dtype=np.uint8)
+        tex_uid = self.plugin.register_texture(pixels)
+        self.client.changeVisualShape(body_id, -1, textureUniqueId=tex_uid)
+        self.client.getCameraImage(32, 24)
+
+        # copies hash like the original
+        scene_graph_copy = pickle.loads(pickle.dumps(self.render.scene_graph))
+        uid, node = next(self.render.scene_graph.nodes.items())
+        node_copy = scene_graph_copy.nodes[uid]
+        self.assertEqual(node.content_hash, node_copy.content_hash)
+        for shape, shape_copy in zip(node.shapes, node_copy.shapes):
+            self.assertEqual(shape.content_hash, shape_copy.content_hash)
+            self.assertEqual(shape.material.content_hash, shape_copy.material.content_hash)
+            self.assertEqual(shape.mesh.content_hash, shape_copy.mesh.content_hash)
+        self.assertEqual(self.render.scene_graph, scene_graph_copy)
+
+        # pixels rewritten in place hash anew
+        bitmap = node.shapes[0].material.diffuse_texture.bitmap
+        content_hash = bitmap.content_hash
+        pixels[..., 0] = 255
+        self.assertEqual(self.plugin.update_texture(tex_uid), 1)
+        self.client.getCameraImage(32, 24)
+        self.assertNotEqual(bitmap.content_hash, content_hash)
+        self.assertNotEqual(self.render.scene_graph, scene_graph_copy)
+
+    def test_asset_references(self):
+        vertices = self.random.rand(100, 3)
+        indices = self.random.randint(0, 100, size=90)
+        shape = self._test_primitive(shapeType=pb.GEOM_MESH, vertices=vertices, indices=indices)
+        scene_graph = self.render.scene_graph
+        self.assertGreaterEqual(shape.mesh.asset_id, 0)
+
+        # cached mesh data is written by hash, the reader fetches it once
+        writer, reader = AssetTable(), AssetTable()
+        data = writer.dumps(scene_graph)
+        self.assertLess(len(data), len(pickle.dumps(scene_graph)) / 2)
+        graph_copy = reader.loads(data)
+        self.assertEqual(reader.missing, [shape.mesh.data.content_hash])
+        self.assertNotEqual(graph_copy, scene_graph)
+        self.assertEqual(reader.supply(writer.fetch(reader.missing)), 1)
+        self.assertEqual(reader.missing, [])
+        self.assertEqual(graph_copy, scene_graph)
+        self.assertEqual(reader.loads(writer.dumps(scene_graph)), scene_graph)
+        self.assertEqual(reader.missing, [])
+
+        # or in full the first time only
+        writer, reader = AssetTable(embed_new=True), AssetTable()
+        first, second = writer.dumps(scene_graph), writer.dumps(scene_graph)
+        self.assertGreater(len(first), len(second))
+        self.assertEqual(reader.loads(first), scene_graph)
+        self.assertEqual(reader.loads(second), scene_graph)
+        self.assertEqual(reader.missing, [])
+
+    def test_scene_graph_pickle_out_of_band(self):
+        body_id = self.client.loadURDF("table/table.urdf")
+        tex_uid = self.client.loadTexture("table/table.png")
+        self.client.changeVisualShape(body_id, -1, textureUniqueId=tex_uid)
+        self.client.getCameraImage(320, 240)
+
+        buffers = []
+        data = pickle.dumps(self.render.scene_graph, 5, buffer_callback=buffers.append)
+        self.assertGreater(len(buffers), 0)
+        scene_graph_copy = pickle.loads(data, buffers=buffers)
+        self.assertEqual(self.render.scene_graph, scene_graph_copy)
+        # in-band protocol 5 and older protocols read the same state
+        for protocol in (2, 5):
+            data = pickle.dumps(self.render.scene_graph, protocol)
+            self.assertEqual(self.render.scene_graph, pickle.loads(data))
+
+        buffers = []
+        data = pickle.dumps(self.render.scene_state, 5, buffer_callback=buffers.append)
+        self.assertEqual(self.render.scene_state, pickle.loads(data, buffers=buffers))
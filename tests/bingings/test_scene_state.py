@@ -1,7 +1,9 @@
-import numpy as np
+import copy
 import pickle
 
-from pybullet_rendering import LightType
+import numpy as np
+
+from pybullet_rendering import LightType, SceneState, SceneStateDecoder, SceneStateEncoder
 from .base_test_case import BaseTestCase
 
 
@@ -43,6 +45,39 @@ class SceneStateTest(BaseTestCase):
                 np.asarray(pose.matrix).reshape((4, 4))[:3, :3],
                 np.asarray(matrix).reshape((3, 3)).T, decimal=3)
 
+    def test_dense_poses(self):
+        self.client.loadSDF("kuka_iiwa/kuka_with_gripper2.sdf")[0]
+        self.client.getCameraImage(320, 240)
+        state = self.render.scene_state
+        nodes = self.render.scene_graph.nodes
+        self.assertEqual(len(state), len(nodes))
+        self.assertEqual(set(state.ids), set(uid for uid, _ in nodes.items()))
+        self.assertEqual(state.matrices.shape, (len(state), 4, 4))
+        for i, uid in enumerate(state.ids):
+            self.assertEqual(state.slot(uid), i)
+            pose = state.pose(uid)
+            np.testing.assert_almost_equal(state.origins[i], pose.origin)
+            np.testing.assert_almost_equal(state.quats[i], pose.quat)
+            np.testing.assert_almost_equal(state.scales[i], pose.scale)
+            np.testing.assert_almost_equal(state.matrices[i], state.matrix(uid))
+
+    def test_dirty_poses(self):
+        body_id = self.client.loadURDF("table/table.urdf")
+        dirty_ids = []
+
+        def render_frame_fn(frame):
+            dirty_ids.append(set(self.render.scene_state.dirty_ids))
+            return False
+
+        self.render.render_frame_fn = render_frame_fn
+        self.client.getCameraImage(320, 240)
+        self.client.getCameraImage(320, 240)
+        self.client.resetBasePositionAndOrientation(body_id, (1, 2, 3), (0, 0, 0, 1))
+        self.client.getCameraImage(320, 240)
+
+        uid, _node = next(self.render.scene_graph.nodes.items())
+        self.assertEqual(dirty_ids, [{uid}, set(), {uid}])
+
     def test_scene_state_pickle(self):
         self.client.loadSDF("kuka_iiwa/kuka_with_gripper2.sdf")[0]
         self.client.getCameraImage(320, 240)
@@ -51,3 +86,111 @@ class SceneStateTest(BaseTestCase):
         buffer = pickle.dumps(self.render.scene_state)
         scene_state_copy = pickle.loads(buffer)
         self.assertEqual(self.render.scene_state, scene_state_copy)
+
+    def test_scene_state_delta(self):
+        body_id = self.client.loadSDF("kuka_iiwa/kuka_with_gripper2.sdf")[0]
+        self.client.getCameraImage(320, 240)
+
+        for quantize in (False, True):
+            encoder, decoder = SceneStateEncoder(quantize), SceneStateDecoder()
+            decoded = SceneState()
+            keyframe = encoder.encode(self.render.scene_state)
+            decoder.decode(keyframe, decoded)
+            self.assertTrue(decoder.synchronized)
+
+            self.client.resetBasePositionAndOrientation(body_id, (1, 2, 3), (0, 0, 0.6, 0.8))
+            self.client.getCameraImage(320, 240)
+            delta = encoder.encode(self.render.scene_state)
+            self.assertLess(len(delta), len(keyframe))
+            decoder.decode(delta, decoded)
+            if quantize:
+                state = self.render.scene_state
+                order = [decoded.slot(uid) for uid in state.ids]
+                np.testing.assert_allclose(decoded.origins[order], state.origins, atol=2e-3)
+                # q and -q are the same rotation
+                dots = np.abs(np.sum(decoded.quats[order] * state.quats, axis=1))
+                np.testing.assert_allclose(dots, 1, atol=1e-4)
+            else:
+                self.assertEqual(self.render.scene_state, decoded)
+
+            # a delta only applies on top of the previous one
+            with self.assertRaises(RuntimeError):
+                SceneStateDecoder().decode(delta, SceneState())
+
+    def test_static_nodes(self):
+        self.plugin.set_static_classification(unchanged_syncs=2, fixed_bases=True)
+        table_id = self.client.loadURDF("table/table.urdf", useFixedBase=True)
+        self.client.loadURDF("cube_small.urdf", basePosition=(0, 0, 1))
+        self.client.getCameraImage(320, 240)
+        state = self.render.scene_state
+        nodes = {node.body: uid for uid, node in self.render.scene_graph.nodes.items()}
+        table, cube = nodes[table_id], nodes[table_id + 1]
+        self.assertTrue(state.is_static(table))
+        self.assertFalse(state.is_static(cube))
+
+        # still for two syncs
+        self.client.getCameraImage(320, 240)
+        self.client.getCameraImage(320, 240)
+        self.assertTrue(state.is_static(cube))
+        np.testing.assert_equal(state.statics, 1)
+
+        generation = state.static_generation
+        self.client.resetBasePositionAndOrientation(table_id, (1, 2, 3), (0, 0, 0, 1))
+        self.client.getCameraImage(320, 240)
+        self.assertFalse(state.is_static(table))
+        self.assertGreater(state.static_generation, generation)
+
+    def test_step_sync(self):
+        self.plugin.set_step_sync(True)
+        body_id = self.client.loadURDF("cube_small.urdf", basePosition=(0, 0, 1))
+        self.client.getCameraImage(32, 24)
+        state = self.render.scene_state
+        uid, _node = next(self.render.scene_graph.nodes.items())
+
+        # the other cameras of the step keep the poses synced for the first one
+        self.client.resetBasePositionAndOrientation(body_id, (1, 2, 3), (0, 0, 0, 1))
+        self.client.getCameraImage(32, 24)
+        np.testing.assert_almost_equal(state.pose(uid).origin, (0, 0, 1))
+
+        self.client.stepSimulation()
+        self.client.getCameraImage(32, 24)
+        np.testing.assert_almost_equal(state.pose(uid).origin, (1, 2, 3), decimal=3)
+
+    def test_copy(self):
+        body_id = self.client.loadURDF("cube_small.urdf", basePosition=(0, 0, 1))
+        self.client.getCameraImage(32, 24)
+        state = copy.copy(self.render.scene_state)
+        graph = copy.copy(self.render.scene_graph)
+        self.assertEqual(state, self.render.scene_state)
+        self.assertEqual(graph, self.render.scene_graph)
+
+        # copies do not follow the simulation
+        self.client.resetBasePositionAndOrientation(body_id, (1, 2, 3), (0, 0, 0, 1))
+        self.client.getCameraImage(32, 24)
+        uid, _node = next(graph.nodes.items())
+        np.testing.assert_almost_equal(state.pose(uid).origin, (0, 0, 1))
+        state.mark_all_dirty()
+        self.assertEqual(state.dirty_ids, [uid])
+
+    def test_snapshots(self):
+        body_id = self.client.loadURDF("cube_small.urdf", basePosition=(0, 0, 1))
+        self.client.getCameraImage(32, 24)
+        state = self.render.scene_state
+        uid, _node = next(self.render.scene_graph.nodes.items())
+        snapshot = state.snapshot()
+        self.assertEqual(len(snapshot), len(state))
+
+        state_id = self.plugin.save_state()
+        self.client.resetBasePositionAndOrientation(body_id, (1, 2, 3), (0, 0, 0, 1))
+        self.client.getCameraImage(32, 24)
+        np.testing.assert_almost_equal(state.pose(uid).origin, (1, 2, 3))
+
+        # only the restored poses change
+        generation = state.generation
+        self.plugin.restore_state(state_id)
+        np.testing.assert_almost_equal(state.pose(uid).origin, (0, 0, 1))
+        self.assertGreater(state.generation, generation)
+        generation = state.generation
+        state.restore(snapshot)
+        self.assertEqual(state.generation, generation)
+        self.plugin.remove_state(state_id)
@@ -1,7 +1,12 @@
-import numpy as np
+import json
+import os
 import pickle
+import tempfile
+
+import numpy as np
+import pybullet as pb
 
-from pybullet_rendering import LightType
+from pybullet_rendering import AABB, LensDistortion, LensModel, Light, LightType, Randomization
 from .base_test_case import BaseTestCase
 
 
@@ -66,6 +71,37 @@ class SceneViewTest(BaseTestCase):
         self.assertIsNone(self.render.scene_view.camera)
         self.assertIsNone(self.render.scene_view.light)
 
+    def test_light_kept(self):
+        self.client.getCameraImage(64, 48, lightDirection=(-1, -0.5, -2))
+        light = self.render.scene_view.light
+        # the same settings keep the light of the previous images, new ones replace it
+        self.client.getCameraImage(64, 48, lightDirection=(-1, -0.5, -2))
+        self.assertIs(self.render.scene_view.light, light)
+        self.client.getCameraImage(64, 48, lightDirection=(1, 0.5, -2))
+        self.assertIsNot(self.render.scene_view.light, light)
+        np.testing.assert_almost_equal(self.render.scene_view.light.direction, (1, 0.5, -2))
+        np.testing.assert_almost_equal(light.direction, (-1, -0.5, -2))
+        self.client.getCameraImage(64, 48)
+        self.assertIsNone(self.render.scene_view.light)
+
+    def test_projective_texture(self):
+        proj = self.client.computeProjectionMatrixFOV(60, 1.0, 0.1, 10.0)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        self.client.getCameraImage(64, 64)
+        self.assertIsNone(self.render.scene_view.projective_texture)
+
+        self.client.getCameraImage(64,
+                                   64,
+                                   flags=pb.ER_USE_PROJECTIVE_TEXTURE,
+                                   projectiveTextureView=view,
+                                   projectiveTextureProj=proj)
+        projector = self.render.scene_view.projective_texture
+        self.assertIsNotNone(projector)
+        np.testing.assert_almost_equal(projector.view_matrix.ravel(), view)
+        np.testing.assert_almost_equal(projector.projection_matrix.ravel(), proj)
+        scene_view_copy = pickle.loads(pickle.dumps(self.render.scene_view))
+        self.assertEqual(self.render.scene_view, scene_view_copy)
+
     def test_scene_view_pickle(self):
         projectionMatrix = list(np.eye(4).flatten())
         viewMatrix = list(np.eye(4).flatten())
@@ -80,3 +116,160 @@ class SceneViewTest(BaseTestCase):
         buffer = pickle.dumps(self.render.scene_view)
         scene_view_copy = pickle.loads(buffer)
         self.assertEqual(self.render.scene_view, scene_view_copy)
+
+    def test_registered_camera(self):
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        handle = self.plugin.register_camera(proj)
+        self.plugin.select_camera(handle)
+
+        # the projection of the request is ignored, the intrinsics are those registered
+        self.client.getCameraImage(64, 48, view, list(np.eye(4).flatten()))
+        camera = self.render.scene_view.camera
+        self.assertEqual(camera.handle, handle)
+        np.testing.assert_almost_equal(camera.projection_matrix.ravel(), proj)
+        np.testing.assert_almost_equal(camera.view_matrix.ravel(), view)
+        yfov, znear, zfar, aspect = camera.intrinsics
+        self.assertAlmostEqual(np.rad2deg(yfov), 60, places=4)
+        self.assertAlmostEqual(znear, 0.1, places=5)
+        self.assertAlmostEqual(zfar, 10.0, places=3)
+        self.assertAlmostEqual(aspect, 4 / 3, places=5)
+
+        self.plugin.select_camera(-1)
+        self.client.getCameraImage(64, 48, view, proj)
+        self.assertEqual(self.render.scene_view.camera.handle, -1)
+        with self.assertRaises(AssertionError):
+            self.plugin.select_camera(handle + 1)
+
+    def test_lens_distortion(self):
+        # undistortion inverts the distortion of the rays the lens sees
+        barrel = LensDistortion(LensModel.BrownConrady, k1=-0.25, k2=0.05, p1=0.001)
+        fisheye = LensDistortion(LensModel.Fisheye, k1=0.05, k2=0.01)
+        self.assertFalse(LensDistortion().enabled)
+        for lens in (barrel, fisheye):
+            self.assertTrue(lens.enabled)
+            xd, yd = lens.distort(0.5, -0.3)
+            np.testing.assert_allclose(lens.undistort(xd, yd), (0.5, -0.3), atol=1e-4)
+        self.assertLess(barrel.distort(0.5, 0.0)[0], 0.5)
+        self.assertIsNone(fisheye.undistort(5.0, 0.0))
+
+        # registered with the camera, whose images are distorted
+        proj = self.client.computeProjectionMatrixFOV(60, 4 / 3, 0.1, 10.0)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        handle = self.plugin.register_camera(proj, distortion=barrel)
+        self.plugin.select_camera(handle)
+        self.client.getCameraImage(64, 48, view, proj)
+        scene_view = self.render.scene_view
+        self.assertEqual(scene_view.camera.distortion, barrel)
+        self.assertTrue(scene_view.has_lens_distortion)
+        self.assertEqual(pickle.loads(pickle.dumps(scene_view)).camera.distortion, barrel)
+
+        self.plugin.select_camera(-1)
+        self.client.getCameraImage(64, 48, view, proj)
+        self.assertFalse(self.render.scene_view.has_lens_distortion)
+
+    def test_multiview(self):
+        # a stereo rig, the right eye 10 cm along the camera x axis
+        proj = self.client.computeProjectionMatrixFOV(60, 1.0, 0.1, 10.0)
+        view = self.client.computeViewMatrix((0, 0, 5), (0, 0, 0), (0, 1, 0))
+        right = np.eye(4)
+        right[0, 3] = 0.1
+        self.plugin.set_multiview([right])
+        self.client.getCameraImage(32, 64, view, proj)
+        scene_view = self.render.scene_view
+        self.assertEqual(scene_view.view_count, 2)
+        self.assertEqual(len(scene_view.multiview_cameras), 1)
+        np.testing.assert_allclose(scene_view.view_camera(1).pose_matrix[3, :3], (0.1, 0, 5),
+                                   atol=1e-5)
+        np.testing.assert_allclose(scene_view.view_camera(1).projection_matrix,
+                                   scene_view.camera.projection_matrix)
+        self.assertIsNone(scene_view.view_camera(2))
+
+        # culled once against both eyes, right of the left eye frustum but not of the right one
+        self.assertTrue(scene_view.multiview_intersects(AABB((2.93, -0.01, -0.01),
+                                                             (2.95, 0.01, 0.01))))
+        self.assertFalse(scene_view.multiview_intersects(AABB((3.2, -0.01, -0.01),
+                                                              (3.3, 0.01, 0.01))))
+        self.assertEqual(pickle.loads(pickle.dumps(scene_view)), scene_view)
+
+        # regions of interest are ignored, none is single view again
+        scene_view.roi = (0, 0, 16, 16)
+        self.assertFalse(scene_view.has_roi)
+        with self.assertRaises(AssertionError):
+            self.plugin.set_multiview([right] * 8)
+        self.plugin.set_multiview()
+        self.client.getCameraImage(32, 32, view, proj)
+        self.assertEqual(self.render.scene_view.view_count, 1)
+
+    def test_lights(self):
+        lights = []
+        for i in range(24):
+            light = Light(LightType.SpotLight if i % 2 else LightType.PointLight)
+            light.position = (i * 0.5, 1.0, 2.5)
+            light.direction = (0, 0, -1)
+            light.color = (1.0, 0.9, 0.8)
+            light.range = 3.0
+            light.spot_angle = 0.5
+            lights.append(light)
+        self.plugin.set_lights(lights)
+        self.client.getCameraImage(64, 64)
+        scene_view = self.render.scene_view
+        self.assertEqual(scene_view.lights, lights)
+        self.assertEqual(scene_view.lights[23].type, LightType.SpotLight)
+        np.testing.assert_allclose(scene_view.lights[23].position, (11.5, 1.0, 2.5))
+        self.assertAlmostEqual(scene_view.lights[1].spot_angle, 0.5)
+        self.assertEqual(pickle.loads(pickle.dumps(scene_view)), scene_view)
+
+        # lights are kept until replaced, of point and spot types only
+        self.plugin.set_lights(lights[:3])
+        self.client.getCameraImage(64, 64)
+        self.assertEqual(self.render.scene_view.lights, lights[:3])
+        with self.assertRaises(AssertionError):
+            self.plugin.set_lights([Light(LightType.DirectionalLight)])
+        self.plugin.set_lights()
+        self.client.getCameraImage(64, 64)
+        self.assertEqual(self.render.scene_view.lights, [])
+
+    def test_randomization(self):
+        body_id = self.client.loadURDF("table/table.urdf")
+        tex_uid = self.client.loadTexture("table/table.png")
+        randomization = Randomization()
+        randomization.seed = 5
+        randomization.textures = [tex_uid]
+        randomization.light = True
+
+        def sample():
+            self.client.getCameraImage(64, 64)
+            view = self.render.scene_view
+            colors = {key: tuple(material.diffuse_color)
+                      for key, material in view.material_overrides.items()}
+            return colors, tuple(view.light.direction)
+
+        with tempfile.TemporaryDirectory() as directory:
+            log_path = os.path.join(directory, 'samples.jsonl')
+            self.plugin.set_randomization(randomization, log_path)
+            first = sample()
+            self.assertEqual(sample(), first)
+            self.assertEqual(self.plugin.next_episode(), 1)
+            second = sample()
+            self.assertNotEqual(second, first)
+            self.plugin.set_randomization(randomization)
+            self.assertEqual(sample(), first)
+
+            with open(log_path) as f:
+                records = [json.loads(line) for line in f]
+            self.assertEqual([record['index'] for record in records], [0, 1])
+            self.assertEqual(len(records[0]['shapes']), len(first[0]))
+            self.assertTrue(all(shape[0] == body_id for shape in records[0]['shapes']))
+
+        # the scene keeps its materials
+        uid, node = next(self.render.scene_graph.nodes.items())
+        self.assertNotEqual(tuple(node.shapes[0].material.diffuse_color), first[0][(uid, 0)])
+
+        randomization.mode = Randomization.Mode.PerFrame
+        self.plugin.set_randomization(randomization)
+        self.assertEqual(sample(), first)
+        self.assertEqual(sample(), second)
+        self.plugin.set_randomization(None)
+        self.client.getCameraImage(64, 64)
+        self.assertIsNone(self.render.scene_view.material_overrides)